@@ -32,6 +32,7 @@
 
 #include <app.h>
 #include <debug.h>
+#include <stdarg.h>
 #include <arch/arm.h>
 #include <string.h>
 #include <stdlib.h>
@@ -43,6 +44,7 @@
 #include <dev/flash-ubi.h>
 #include <lib/ptable.h>
 #include <dev/keys.h>
+#include <dev/uart.h>
 #include <dev/fbcon.h>
 #include <baseband.h>
 #include <target.h>
@@ -59,6 +61,7 @@
 #include <boot_verifier.h>
 #include <image_verify.h>
 #include <decompress.h>
+#include <rpm-ipc.h>
 #include <platform/timer.h>
 #include <sys/types.h>
 #if USE_RPMB_FOR_DEVINFO
@@ -85,6 +88,8 @@
 #include "bootimg.h"
 #include "fastboot.h"
 #include "sparse_format.h"
+#include "sparse.h"
+#include "unpack.h"
 #include "meta_format.h"
 #include "mmc.h"
 #include "devinfo.h"
@@ -99,9 +104,17 @@
 #include "ums.h"
 #endif
 
+#if WITH_LIB_FS
+#include <lib/fs.h>
+#endif
 #if WITH_LK2ND
+#include <lib/heap.h>
+#include <lk2nd/cpufreq.h>
 #include <lk2nd/init.h>
 #include <lk2nd/device/menu.h>
+#include <lk2nd/util/highmem.h>
+#include <lk2nd/util/mmu.h>
+#include <lk2nd/util/region.h>
 #endif
 #if WITH_LK2ND_DEVICE
 #include <lk2nd/device.h>
@@ -109,6 +122,9 @@
 #if WITH_LK2ND_BOOT
 #include <lk2nd/boot.h>
 #endif
+#if WITH_LK2ND_SMP
+#include <lk2nd/smp.h>
+#endif
 
 extern  bool target_use_signed_kernel(void);
 extern void platform_uninit(void);
@@ -1227,6 +1243,16 @@ void boot_linux(void *kernel, unsigned *tags,
 	if (strcmp(cmdline, "lk2nd") == 0)
 		boot_type |= BOOT_LK2ND;
 
+#if WITH_LK2ND
+	/* Asynchronous init stages must not touch the hardware during boot */
+	lk2nd_init_wait_all();
+#endif
+
+#if WITH_LK2ND_SMP
+	/* Hand the secondary CPUs back to PSCI before the OS brings them up */
+	lk2nd_smp_stop();
+#endif
+
 	final_cmdline = update_cmdline2(cmdline, boot_type);
 
 	if (boot_type & BOOT_ATAGS_COPY) {
@@ -1290,6 +1316,12 @@ tags_done:
 	target_display_shutdown();
 #endif
 
+#if MMC_SDHCI_SUPPORT
+	/* Linux resets the card, writes still in its cache would be lost */
+	if (mmc_flush_write_cache())
+		dprintf(CRITICAL, "Failed to flush the eMMC write cache\n");
+#endif
+
 	/* Perform target specific cleanup */
 	target_uninit();
 #if VERIFIED_BOOT_2
@@ -1298,8 +1330,18 @@ tags_done:
 	if (final_cmdline)
 		free(final_cmdline);
 
+#if WITH_LK2ND
+	/* The kernel may overwrite the high memory the heap grew into */
+	if (heap_release_regions())
+		dprintf(INFO, "Heap memory is still in use in high memory\n");
+#endif
+
 	dprintf(INFO, "booting linux @ %p, ramdisk @ %p (%d), tags/device tree @ %p\n",
 		entry, ramdisk, ramdisk_size, (void *)tags_phys);
+#if WITH_DEBUG_UART
+	uart_flush_tx(0);
+#endif
+	debug_fbcon_flush();
 
 	enter_critical_section();
 
@@ -1390,7 +1432,12 @@ int getimage(void **image_buffer, uint32_t *imgsize,
 	return -1;
 }
 
-static void verify_signed_bootimg(uint32_t bootimg_addr, uint32_t bootimg_size)
+/*
+ * @digest is the hash of the image if it was calculated while the image was
+ * read, or NULL.
+ */
+static void verify_signed_bootimg(uint32_t bootimg_addr, uint32_t bootimg_size,
+				  unsigned char *digest)
 {
 	int ret;
 
@@ -1422,10 +1469,15 @@ static void verify_signed_bootimg(uint32_t bootimg_addr, uint32_t bootimg_size)
 	}
 	boot_verify_print_state();
 #else
-	ret = image_verify((unsigned char *)bootimg_addr,
-					   (unsigned char *)(bootimg_addr + bootimg_size),
-					   bootimg_size,
-					   auth_algo);
+	if (digest)
+		ret = image_verify_digest(digest,
+					  (unsigned char *)(bootimg_addr + bootimg_size),
+					  auth_algo);
+	else
+		ret = image_verify((unsigned char *)bootimg_addr,
+						   (unsigned char *)(bootimg_addr + bootimg_size),
+						   bootimg_size,
+						   auth_algo);
 #endif
 	dprintf(INFO, "Authenticating boot image: done return value = %d\n", ret);
 
@@ -1583,6 +1635,83 @@ void get_recovery_dtbo_info(uint32_t *dtbo_size, void **dtbo_buf)
 	return;
 }
 
+#if WITH_LK2ND_SMP
+static bool ranges_overlap(const void *a, size_t alen, const void *b, size_t blen)
+{
+	return (uintptr_t)a < (uintptr_t)b + blen && (uintptr_t)b < (uintptr_t)a + alen;
+}
+
+/*
+ * Move the kernel on the secondary CPUs while the boot CPU moves the ramdisk.
+ * This is only possible if neither of them is moved over the other one,
+ * otherwise the order of the memmove() calls matters and false is returned.
+ */
+static bool lk2nd_move_kernel_ramdisk(void *kernel, const void *kernel_src,
+				      size_t kernel_size, void *ramdisk,
+				      const void *ramdisk_src, size_t ramdisk_size)
+{
+	if (ranges_overlap(kernel, kernel_size, ramdisk, ramdisk_size) ||
+	    ranges_overlap(kernel, kernel_size, ramdisk_src, ramdisk_size) ||
+	    ranges_overlap(kernel_src, kernel_size, ramdisk, ramdisk_size))
+		return false;
+
+	lk2nd_smp_memmove_async(kernel, kernel_src, kernel_size);
+	memmove(ramdisk, ramdisk_src, ramdisk_size);
+	lk2nd_smp_memmove_wait();
+	return true;
+}
+#endif
+
+#if !VERIFIED_BOOT && !VERIFIED_BOOT_2
+#define BOOT_HASH_CHUNK_SIZE	(1024 * 1024)
+
+struct boot_hash_read {
+	unsigned long long ptn;
+	unsigned pos;
+	unsigned loaded;
+};
+
+static int boot_hash_read(void *cookie, unsigned char *buf, unsigned int size)
+{
+	struct boot_hash_read *r = cookie;
+	unsigned skip = 0;
+
+	/* The header is in memory already */
+	if (r->pos < r->loaded)
+		skip = MIN(size, r->loaded - r->pos);
+
+	if (size > skip && mmc_read(r->ptn + r->pos + skip, (void *)(buf + skip), size - skip))
+		return -1;
+
+	r->pos += size;
+	return 0;
+}
+
+/*
+ * Read the rest of the boot image after the header and hash it at the same
+ * time: the crypto engine hashes each chunk while the next one is read, so
+ * the image does not need a second pass over the memory for the signature
+ * check. Returns 0 if the digest is valid.
+ */
+static int boot_read_hashed(unsigned long long ptn, unsigned char *image_addr,
+			    unsigned image_size, unsigned page_size,
+			    unsigned char *digest)
+{
+	struct boot_hash_read r = { ptn, 0, page_size };
+#if IMAGE_VERIF_ALGO_SHA1
+	crypto_auth_alg_type auth_algo = CRYPTO_AUTH_ALG_SHA1;
+#else
+	crypto_auth_alg_type auth_algo = CRYPTO_AUTH_ALG_SHA256;
+#endif
+
+	if (hash_find_read_to(boot_hash_read, &r, image_addr, image_size,
+			      BOOT_HASH_CHUNK_SIZE, digest, auth_algo) != CRYPTO_SHA_ERR_NONE)
+		return -1;
+
+	return 0;
+}
+#endif
+
 int boot_linux_from_mmc(void)
 {
 	boot_img_hdr *hdr = (void*) buf;
@@ -1617,6 +1746,10 @@ int boot_linux_from_mmc(void)
 	uint32_t dtbo_image_sz = 0;
 	void *vbmeta_image_buf = NULL;
 	uint32_t vbmeta_image_sz = 0;
+#endif
+#if !VERIFIED_BOOT_2
+	unsigned char boot_digest[SHA256_SIZE];
+	bool boot_hashed = false;
 #endif
 	char *ptn_name = "boot";
 #if DEVICE_TREE
@@ -1681,6 +1814,12 @@ int boot_linux_from_mmc(void)
                 return ERR_INVALID_BOOT_MAGIC;
 	}
 
+#if WITH_LK2ND_BOOT
+	/* v3+ headers are not a boot_img_hdr, the sections are loaded one by one */
+	if (lk2nd_bootimg_is_v3(hdr))
+		return lk2nd_boot_bootimg_v3(ptn_name);
+#endif
+
 	if (hdr->page_size && (hdr->page_size != page_size)) {
 
 		if (hdr->page_size > BOOT_IMG_MAX_PAGE_SIZE) {
@@ -1861,6 +2000,13 @@ int boot_linux_from_mmc(void)
 		return -1;
 	}
 	offset = page_size;
+#if !VERIFIED_BOOT && !VERIFIED_BOOT_2
+	/* Hash the image while it is read if it is checked below anyway */
+	if (((target_use_signed_kernel() && (!device.is_unlocked)) || is_test_mode_enabled()) &&
+	    !boot_read_hashed(ptn, image_addr, imagesize_actual, page_size, boot_digest))
+		boot_hashed = true;
+	else
+#endif
 	/* Read image without signature and header*/
 	if (mmc_read(ptn + offset, (void *)(image_addr + offset), imagesize_actual - page_size))
 	{
@@ -1972,7 +2118,8 @@ int boot_linux_from_mmc(void)
 			return -1;
 		}
 
-		verify_signed_bootimg((uint32_t)image_addr, imagesize_actual);
+		verify_signed_bootimg((uint32_t)image_addr, imagesize_actual,
+				      boot_hashed ? boot_digest : NULL);
 		/* The purpose of our test is done here */
 		if(is_test_mode_enabled() && auth_kernel_img)
 			return 0;
@@ -2038,9 +2185,15 @@ int boot_linux_from_mmc(void)
 			out_avai_len -= DTBO_IMG_BUF;
 #endif
 		dprintf(INFO, "decompressing kernel image: start\n");
+#if WITH_LK2ND
+		lk2nd_cpufreq_boost();
+#endif
 		rc = decompress((unsigned char *)(image_addr + page_size),
 				hdr->kernel_size, out_addr, out_avai_len,
 				&dtb_offset, &out_len);
+#if WITH_LK2ND
+		lk2nd_cpufreq_unboost();
+#endif
 		if (rc)
 		{
 			dprintf(CRITICAL, "decompressing kernel image failed!!!\n");
@@ -2222,8 +2375,15 @@ int boot_linux_from_mmc(void)
 	#endif
 
 	/* Move kernel, ramdisk and device tree to correct address */
-	memmove((void*) hdr->kernel_addr, kernel_start_addr, kernel_size);
-	memmove((void*) hdr->ramdisk_addr, (char *)(image_addr + page_size + kernel_actual), hdr->ramdisk_size);
+#if WITH_LK2ND_SMP
+	if (!lk2nd_move_kernel_ramdisk((void*) hdr->kernel_addr, kernel_start_addr, kernel_size,
+				       (void*) hdr->ramdisk_addr, (char *)(image_addr + page_size + kernel_actual),
+				       hdr->ramdisk_size))
+#endif
+	{
+		memmove((void*) hdr->kernel_addr, kernel_start_addr, kernel_size);
+		memmove((void*) hdr->ramdisk_addr, (char *)(image_addr + page_size + kernel_actual), hdr->ramdisk_size);
+	}
 
 	if (boot_into_recovery && !device.is_unlocked && !device.is_tampered)
 		target_load_ssd_keystore();
@@ -2420,7 +2580,7 @@ int boot_linux_from_flash(void)
 			return -1;
 		}
 
-		verify_signed_bootimg((uint32_t)image_addr, imagesize_actual);
+		verify_signed_bootimg((uint32_t)image_addr, imagesize_actual, NULL);
 	}
 	offset = page_size;
 	if(hdr->second_size != 0) {
@@ -3321,7 +3481,7 @@ void cmd_boot(const char *arg, void *data, unsigned sz)
 		/* Pass size excluding signature size, otherwise we would try to
 		 * access signature beyond its length
 		 */
-		verify_signed_bootimg((uint32_t)data, image_actual);
+		verify_signed_bootimg((uint32_t)data, image_actual, NULL);
 	}
 #ifdef MDTP_SUPPORT
 	else
@@ -3372,9 +3532,15 @@ void cmd_boot(const char *arg, void *data, unsigned sz)
 			out_avai_len -= DTBO_IMG_BUF;
 #endif
 		dprintf(INFO, "decompressing kernel image: start\n");
+#if WITH_LK2ND
+		lk2nd_cpufreq_boost();
+#endif
 		ret = decompress((unsigned char *)(ptr + page_size),
 				hdr->kernel_size, out_addr, out_avai_len,
 				&dtb_offset, &out_len);
+#if WITH_LK2ND
+		lk2nd_cpufreq_unboost();
+#endif
 		if (ret)
 		{
 			dprintf(CRITICAL, "decompressing image failed!!!\n");
@@ -3464,8 +3630,15 @@ void cmd_boot(const char *arg, void *data, unsigned sz)
 #endif
 
 	/* Load ramdisk & kernel */
-	memmove((void*) hdr->ramdisk_addr, ptr + page_size + kernel_actual, hdr->ramdisk_size);
-	memmove((void*) hdr->kernel_addr, (char*) (kernel_start_addr), kernel_size);
+#if WITH_LK2ND_SMP
+	if (!lk2nd_move_kernel_ramdisk((void*) hdr->kernel_addr, kernel_start_addr, kernel_size,
+				       (void*) hdr->ramdisk_addr, ptr + page_size + kernel_actual,
+				       hdr->ramdisk_size))
+#endif
+	{
+		memmove((void*) hdr->ramdisk_addr, ptr + page_size + kernel_actual, hdr->ramdisk_size);
+		memmove((void*) hdr->kernel_addr, (char*) (kernel_start_addr), kernel_size);
+	}
 
 	fastboot_okay("");
 	fastboot_stop();
@@ -3491,6 +3664,263 @@ boot_failed:
 	return;
 }
 
+#if !VERIFIED_BOOT && !VERIFIED_BOOT_2 && !defined(MDTP_SUPPORT)
+/*
+ * Placed boot: "oem boot-placed" sets up the following download to be a boot
+ * image that is received straight at the kernel and ramdisk load addresses,
+ * instead of staging it and moving everything out of the download buffer:
+ *	fastboot oem boot-placed
+ *	fastboot stage boot.img
+ * The header and the start of the kernel arrive first and decide where the
+ * rest goes. The device boots once the download is complete. Only unsigned
+ * images with an uncompressed kernel can be placed, "fastboot boot" handles
+ * everything else.
+ */
+struct boot_placed {
+	struct fastboot_stream stream;
+	unsigned char *scratch;
+	unsigned len;
+	unsigned kernel_start, kernel_end, ramdisk_end;
+	bool placed;
+	const char *error;
+};
+
+static struct boot_placed boot_placed;
+
+static bool boot_placed_overlaps(uintptr_t a, unsigned a_len, uintptr_t b, unsigned b_len)
+{
+	return a < b + b_len && b < a + a_len;
+}
+
+/* Check the header, the first FASTBOOT_PLACE_ALIGN bytes of the image */
+static const char *boot_placed_check_header(struct boot_placed *bp)
+{
+	boot_img_hdr *hdr = (boot_img_hdr *)bp->scratch;
+	uint32_t image_actual;
+
+	if (memcmp(hdr->magic, BOOT_MAGIC, BOOT_MAGIC_SIZE))
+		return "invalid bootimage header";
+
+	/* ensure commandline is terminated */
+	hdr->cmdline[BOOT_ARGS_SIZE-1] = 0;
+
+	if (hdr->page_size < FASTBOOT_PLACE_ALIGN ||
+	    hdr->page_size & (hdr->page_size - 1) || !hdr->kernel_size)
+		return "bootimage header fields are invalid";
+
+	page_size = hdr->page_size;
+	page_mask = page_size - 1;
+#ifndef OSVERSION_IN_BOOTIMAGE
+	dt_size = hdr->dt_size;
+#endif
+
+	bp->kernel_start = page_size;
+	bp->kernel_end = ADD_OF(bp->kernel_start, ROUND_TO_PAGE(hdr->kernel_size, page_mask));
+	bp->ramdisk_end = ADD_OF(bp->kernel_end, ROUND_TO_PAGE(hdr->ramdisk_size, page_mask));
+
+	image_actual = ADD_OF(bp->ramdisk_end, ROUND_TO_PAGE(hdr->second_size, page_mask));
+#if DEVICE_TREE
+	image_actual = ADD_OF(image_actual, ROUND_TO_PAGE(dt_size, page_mask));
+#endif
+	if (image_actual > bp->len)
+		return "bootimage header fields are invalid";
+
+	return NULL;
+}
+
+/*
+ * Choose the load addresses once the start of the kernel is there, it is
+ * moved to the kernel address right away and the rest of the kernel follows.
+ */
+static const char *boot_placed_layout(struct boot_placed *bp)
+{
+	boot_img_hdr *hdr = (boot_img_hdr *)bp->scratch;
+	struct kernel64_hdr *kptr;
+	unsigned kernel_actual = bp->kernel_end - bp->kernel_start;
+	unsigned ramdisk_actual = bp->ramdisk_end - bp->kernel_end;
+
+	kptr = (struct kernel64_hdr *)(bp->scratch + bp->kernel_start);
+	if (is_gzip_package((unsigned char *)kptr, hdr->kernel_size))
+		return "compressed kernel, use fastboot boot";
+
+	if (kptr->text_offset > 2 * 1024 * 1024)
+		kptr->text_offset = 0; // HACK
+
+	update_ker_tags_rdisk_addr(hdr, kptr);
+
+	/* Get virtual addresses since the hdr saves physical addresses. */
+	hdr->kernel_addr = VA(hdr->kernel_addr);
+	hdr->ramdisk_addr = VA(hdr->ramdisk_addr);
+	hdr->tags_addr = VA(hdr->tags_addr);
+
+	if (check_aboot_addr_range_overlap(hdr->kernel_addr, kernel_actual) ||
+		check_ddr_addr_range_bound(hdr->kernel_addr, kernel_actual) ||
+		check_aboot_addr_range_overlap(hdr->ramdisk_addr, ramdisk_actual) ||
+		check_ddr_addr_range_bound(hdr->ramdisk_addr, ramdisk_actual))
+		return "kernel/ramdisk addresses are not valid";
+
+	/* The header and the rest of the image stay in the scratch memory */
+	if (boot_placed_overlaps(hdr->kernel_addr, kernel_actual,
+				 (uintptr_t)bp->scratch, bp->len) ||
+	    boot_placed_overlaps(hdr->ramdisk_addr, ramdisk_actual,
+				 (uintptr_t)bp->scratch, bp->len) ||
+	    boot_placed_overlaps(hdr->kernel_addr, kernel_actual,
+				 hdr->ramdisk_addr, ramdisk_actual))
+		return "kernel/ramdisk overlap the download buffer";
+
+	if (hdr->kernel_addr % CACHE_LINE || hdr->ramdisk_addr % CACHE_LINE)
+		return "kernel/ramdisk addresses are not aligned";
+
+	memcpy((void *)hdr->kernel_addr, kptr, FASTBOOT_PLACE_ALIGN);
+	bp->placed = true;
+	return NULL;
+}
+
+static int boot_placed_begin(struct fastboot_stream *stream, unsigned len)
+{
+	struct boot_placed *bp = containerof(stream, struct boot_placed, stream);
+
+	if (len > target_get_max_flash_size()) {
+		fastboot_fail("data too large");
+		return -1;
+	}
+
+	bp->scratch = target_get_scratch_address();
+	bp->len = len;
+	bp->placed = false;
+	bp->error = NULL;
+	return 0;
+}
+
+static void *boot_placed_place(struct fastboot_stream *stream, unsigned offset, unsigned *len)
+{
+	struct boot_placed *bp = containerof(stream, struct boot_placed, stream);
+	boot_img_hdr *hdr = (boot_img_hdr *)bp->scratch;
+	unsigned kernel_head;
+
+	if (offset < FASTBOOT_PLACE_ALIGN) {
+		*len = MIN(*len, FASTBOOT_PLACE_ALIGN);
+		return bp->scratch;
+	}
+
+	if (offset == FASTBOOT_PLACE_ALIGN) {
+		bp->error = boot_placed_check_header(bp);
+		if (bp->error)
+			return NULL;
+	}
+
+	kernel_head = bp->kernel_start + FASTBOOT_PLACE_ALIGN;
+
+	if (offset < kernel_head) {
+		*len = MIN(*len, kernel_head - offset);
+		return bp->scratch + offset;
+	}
+
+	if (offset == kernel_head) {
+		bp->error = boot_placed_layout(bp);
+		if (bp->error)
+			return NULL;
+	}
+
+	if (offset < bp->kernel_end) {
+		*len = MIN(*len, bp->kernel_end - offset);
+		return (void *)(hdr->kernel_addr + offset - bp->kernel_start);
+	}
+	if (offset < bp->ramdisk_end) {
+		*len = MIN(*len, bp->ramdisk_end - offset);
+		return (void *)(hdr->ramdisk_addr + offset - bp->kernel_end);
+	}
+
+	/* Second stage, dt.img and signature stay where "fastboot boot" has them */
+	return bp->scratch + offset;
+}
+
+static void boot_placed_end(struct fastboot_stream *stream, int status)
+{
+	struct boot_placed *bp = containerof(stream, struct boot_placed, stream);
+	boot_img_hdr *hdr = (boot_img_hdr *)bp->scratch;
+	enum boot_type boot_type = 0;
+	unsigned kernel_actual = bp->kernel_end - bp->kernel_start;
+
+#if FBCON_DISPLAY_MSG
+	/* Exit keys' detection thread firstly */
+	exit_menu_keys_detection();
+#endif
+
+	if (status || !bp->placed) {
+		fastboot_fail(bp->error ? bp->error : "invalid bootimage header");
+		goto boot_failed;
+	}
+
+#if DEVICE_TREE
+	/* find correct dtb and copy it to right location */
+	if (copy_dtb(bp->scratch, bp->len)) {
+		void *dtb;
+
+		/* look for appended DTB in the kernel */
+		dtb = dev_tree_appended((void *)hdr->kernel_addr, hdr->kernel_size, 0,
+					(void *)hdr->tags_addr);
+#if WITH_LK2ND_DEVICE_2ND
+		if (!dtb && lk2nd_device2nd_have_atags())
+			boot_type |= BOOT_ATAGS_COPY;
+		else
+#endif
+		if (!dtb) {
+			fastboot_fail("dtb not found");
+			goto boot_failed;
+		}
+	}
+
+	if (check_aboot_addr_range_overlap(hdr->tags_addr, kernel_actual) ||
+		check_ddr_addr_range_bound(hdr->tags_addr, kernel_actual))
+#else
+	if (check_aboot_addr_range_overlap(hdr->tags_addr, MAX_TAGS_SIZE) ||
+		check_ddr_addr_range_bound(hdr->tags_addr, MAX_TAGS_SIZE))
+#endif
+	{
+		fastboot_fail("tags addresses are not valid");
+		goto boot_failed;
+	}
+
+	fastboot_okay("");
+	fastboot_stop();
+
+#ifdef LK2ND_FASTBOOT_DELAY
+	dprintf(INFO, "Waiting %ums before boot\n", LK2ND_FASTBOOT_DELAY);
+	thread_sleep(LK2ND_FASTBOOT_DELAY);
+#endif
+
+	boot_linux((void*) hdr->kernel_addr, (void*) hdr->tags_addr,
+		   (const char*) hdr->cmdline, board_machtype(),
+		   (void*) hdr->ramdisk_addr, hdr->ramdisk_size,
+		   boot_type);
+	return;
+
+boot_failed:
+#if FBCON_DISPLAY_MSG
+	/* revert to fastboot menu if boot failed */
+	display_fastboot_menu();
+#endif
+	return;
+}
+
+void cmd_oem_boot_placed(const char *arg, void *data, unsigned sz)
+{
+	struct boot_placed *bp = &boot_placed;
+
+	if (target_use_signed_kernel() && !device.is_unlocked) {
+		fastboot_fail("signed boot images can not be placed, use fastboot boot");
+		return;
+	}
+
+	bp->stream.begin = boot_placed_begin;
+	bp->stream.place = boot_placed_place;
+	bp->stream.end = boot_placed_end;
+	fastboot_stream_download(&bp->stream);
+	fastboot_okay("");
+}
+#endif
+
 void cmd_erase_nand(const char *arg, void *data, unsigned sz)
 {
 	struct ptentry *ptn;
@@ -3639,6 +4069,18 @@ void cmd_erase_mmc(const char *arg, void *data, unsigned sz)
 	fastboot_okay("");
 }
 
+/*
+ * Filesystems kept mounted by lib/fs would read stale data from a partition
+ * that was written. The partition may also hold other block devices (e.g.
+ * A/B slots), so all of them are dropped.
+ */
+static void flash_invalidate_mounts(void)
+{
+#if WITH_LIB_FS
+	fs_invalidate(NULL);
+#endif
+}
+
 void cmd_erase(const char *arg, void *data, unsigned sz)
 {
 #if VERIFIED_BOOT || VERIFIED_BOOT_2
@@ -3652,9 +4094,10 @@ void cmd_erase(const char *arg, void *data, unsigned sz)
 	}
 #endif
 
-	if(target_is_emmc_boot())
+	if(target_is_emmc_boot()) {
+		flash_invalidate_mounts();
 		cmd_erase_mmc(arg, data, sz);
-	else
+	} else
 		cmd_erase_nand(arg, data, sz);
 }
 
@@ -4088,23 +4531,30 @@ void cmd_flash_meta_img(const char *arg, void *data, unsigned sz)
 #endif
 }
 
+/* Set by "oem flash-delta", sparse images only write the blocks that changed */
+static bool flash_delta;
+
+void cmd_oem_flash_delta(const char *arg, void *data, unsigned sz)
+{
+	while (*arg == ' ')
+		arg++;
+
+	if (!strcmp(arg, "on")) {
+		flash_delta = true;
+	} else if (!strcmp(arg, "off")) {
+		flash_delta = false;
+	} else {
+		fastboot_fail("usage: fastboot oem flash-delta <on|off>");
+		return;
+	}
+	fastboot_okay("");
+}
+
 void cmd_flash_mmc_sparse_img(const char *arg, void *data, unsigned sz)
 {
-	unsigned int chunk;
-	uint64_t chunk_data_sz;
-	uint32_t *fill_buf = NULL;
-	uint32_t fill_val;
-	uint32_t blk_sz_actual = 0;
-	sparse_header_t *sparse_header;
-	chunk_header_t *chunk_header;
-	uint32_t total_blocks = 0;
+	struct sparse_writer sw;
 	unsigned long long ptn = 0;
-	unsigned long long size = 0;
 	int index = INVALID_PTN;
-	uint32_t i;
-	uint8_t lun = 0;
-	/*End of the sparse image address*/
-	uintptr_t data_end = (uintptr_t)data + sz;
 
 	index = partition_get_index(arg);
 	ptn = partition_get_offset(index);
@@ -4113,245 +4563,27 @@ void cmd_flash_mmc_sparse_img(const char *arg, void *data, unsigned sz)
 		return;
 	}
 
-	size = partition_get_size(index);
-
-	lun = partition_get_lun(index);
-	mmc_set_lun(lun);
-
-	if (sz < sizeof(sparse_header_t)) {
-		fastboot_fail("size too low");
-		return;
-	}
+	mmc_set_lun(partition_get_lun(index));
 
-	/* Read and skip over sparse image header */
-	sparse_header = (sparse_header_t *) data;
+#if WITH_LK2ND
+	lk2nd_cpufreq_boost();
+#endif
+	sparse_writer_init(&sw, ptn, partition_get_size(index));
+	sw.delta = flash_delta;
+	if (sparse_writer_write(&sw, data, sz) || sparse_writer_finish(&sw))
+		fastboot_fail(sw.error);
+	else
+		fastboot_okay("");
+	sparse_writer_free(&sw);
+#if WITH_LK2ND
+	lk2nd_cpufreq_unboost();
+#endif
+}
 
-	if (!sparse_header->blk_sz || (sparse_header->blk_sz % 4)){
-		fastboot_fail("Invalid block size\n");
-		return;
-	}
-
-	if (((uint64_t)sparse_header->total_blks * (uint64_t)sparse_header->blk_sz) > size) {
-		fastboot_fail("size too large");
-		return;
-	}
-
-	data += sizeof(sparse_header_t);
-
-	if (data_end < (uintptr_t)data) {
-		fastboot_fail("buffer overreads occured due to invalid sparse header");
-		return;
-	}
-
-	if(sparse_header->file_hdr_sz != sizeof(sparse_header_t))
-	{
-		fastboot_fail("sparse header size mismatch");
-		return;
-	}
-
-	dprintf (SPEW, "=== Sparse Image Header ===\n");
-	dprintf (SPEW, "magic: 0x%x\n", sparse_header->magic);
-	dprintf (SPEW, "major_version: 0x%x\n", sparse_header->major_version);
-	dprintf (SPEW, "minor_version: 0x%x\n", sparse_header->minor_version);
-	dprintf (SPEW, "file_hdr_sz: %d\n", sparse_header->file_hdr_sz);
-	dprintf (SPEW, "chunk_hdr_sz: %d\n", sparse_header->chunk_hdr_sz);
-	dprintf (SPEW, "blk_sz: %d\n", sparse_header->blk_sz);
-	dprintf (SPEW, "total_blks: %d\n", sparse_header->total_blks);
-	dprintf (SPEW, "total_chunks: %d\n", sparse_header->total_chunks);
-
-	/* Start processing chunks */
-	for (chunk=0; chunk<sparse_header->total_chunks; chunk++)
-	{
-		/* Make sure the total image size does not exceed the partition size */
-		if(((uint64_t)total_blocks * (uint64_t)sparse_header->blk_sz) >= size) {
-			fastboot_fail("size too large");
-			return;
-		}
-		/* Read and skip over chunk header */
-		chunk_header = (chunk_header_t *) data;
-		data += sizeof(chunk_header_t);
-
-		if (data_end < (uintptr_t)data) {
-			fastboot_fail("buffer overreads occured due to invalid sparse header");
-			return;
-		}
-
-		dprintf (SPEW, "=== Chunk Header ===\n");
-		dprintf (SPEW, "chunk_type: 0x%x\n", chunk_header->chunk_type);
-		dprintf (SPEW, "chunk_data_sz: 0x%x\n", chunk_header->chunk_sz);
-		dprintf (SPEW, "total_size: 0x%x\n", chunk_header->total_sz);
-
-		if(sparse_header->chunk_hdr_sz != sizeof(chunk_header_t))
-		{
-			fastboot_fail("chunk header size mismatch");
-			return;
-		}
-
-		chunk_data_sz = (uint64_t)sparse_header->blk_sz * chunk_header->chunk_sz;
-
-		/* Make sure that the chunk size calculated from sparse image does not
-		 * exceed partition size
-		 */
-		if ((uint64_t)total_blocks * (uint64_t)sparse_header->blk_sz + chunk_data_sz > size)
-		{
-			fastboot_fail("Chunk data size exceeds partition size");
-			return;
-		}
-
-		switch (chunk_header->chunk_type)
-		{
-			case CHUNK_TYPE_RAW:
-			if((uint64_t)chunk_header->total_sz != ((uint64_t)sparse_header->chunk_hdr_sz +
-											chunk_data_sz))
-			{
-				fastboot_fail("Bogus chunk size for chunk type Raw");
-				return;
-			}
-
-			if (data_end < (uintptr_t)data + chunk_data_sz) {
-				fastboot_fail("buffer overreads occured due to invalid sparse header");
-				return;
-			}
-
-			/* chunk_header->total_sz is uint32,So chunk_data_sz is now less than 2^32
-			   otherwise it will return in the line above
-			 */
-			if(mmc_write(ptn + ((uint64_t)total_blocks*sparse_header->blk_sz),
-						(uint32_t)chunk_data_sz,
-						(unsigned int*)data))
-			{
-				fastboot_fail("flash write failure");
-				return;
-			}
-			if(total_blocks > (UINT_MAX - chunk_header->chunk_sz)) {
-				fastboot_fail("Bogus size for RAW chunk type");
-				return;
-			}
-			total_blocks += chunk_header->chunk_sz;
-			data += (uint32_t)chunk_data_sz;
-			break;
-
-			case CHUNK_TYPE_FILL:
-			if(chunk_header->total_sz != (sparse_header->chunk_hdr_sz +
-											sizeof(uint32_t)))
-			{
-				fastboot_fail("Bogus chunk size for chunk type FILL");
-				return;
-			}
-
-			blk_sz_actual = ROUNDUP(sparse_header->blk_sz, CACHE_LINE);
-			/* Integer overflow detected */
-			if (blk_sz_actual < sparse_header->blk_sz)
-			{
-				fastboot_fail("Invalid block size");
-				return;
-			}
-
-			fill_buf = (uint32_t *)memalign(CACHE_LINE, blk_sz_actual);
-			if (!fill_buf)
-			{
-				fastboot_fail("Malloc failed for: CHUNK_TYPE_FILL");
-				return;
-			}
-
-			if (data_end < (uintptr_t)data + sizeof(uint32_t)) {
-				fastboot_fail("buffer overreads occured due to invalid sparse header");
-				free(fill_buf);
-				return;
-			}
-			fill_val = *(uint32_t *)data;
-			data = (char *) data + sizeof(uint32_t);
-
-			for (i = 0; i < (sparse_header->blk_sz / sizeof(fill_val)); i++)
-			{
-				fill_buf[i] = fill_val;
-			}
-
-			if(total_blocks > (UINT_MAX - chunk_header->chunk_sz))
-			{
-				fastboot_fail("bogus size for chunk FILL type");
-				free(fill_buf);
-				return;
-			}
-
-			for (i = 0; i < chunk_header->chunk_sz; i++)
-			{
-				/* Make sure that the data written to partition does not exceed partition size */
-				if ((uint64_t)total_blocks * (uint64_t)sparse_header->blk_sz + sparse_header->blk_sz > size)
-				{
-					fastboot_fail("Chunk data size for fill type exceeds partition size");
-					free(fill_buf);
-					return;
-				}
-
-				if(mmc_write(ptn + ((uint64_t)total_blocks*sparse_header->blk_sz),
-							sparse_header->blk_sz,
-							fill_buf))
-				{
-					fastboot_fail("flash write failure");
-					free(fill_buf);
-					return;
-				}
-
-				total_blocks++;
-			}
-
-			free(fill_buf);
-			break;
-
-			case CHUNK_TYPE_DONT_CARE:
-			if(total_blocks > (UINT_MAX - chunk_header->chunk_sz)) {
-				fastboot_fail("bogus size for chunk DONT CARE type");
-				return;
-			}
-			total_blocks += chunk_header->chunk_sz;
-			break;
-
-			case CHUNK_TYPE_CRC32:
-			if(chunk_header->total_sz != sparse_header->chunk_hdr_sz)
-			{
-				fastboot_fail("Bogus chunk size for chunk type CRC");
-				return;
-			}
-			if(total_blocks > (UINT_MAX - chunk_header->chunk_sz)) {
-				fastboot_fail("bogus size for chunk CRC type");
-				return;
-			}
-			total_blocks += chunk_header->chunk_sz;
-			if ((uintptr_t)data > UINT_MAX - chunk_data_sz) {
-				fastboot_fail("integer overflow occured");
-				return;
-			}
-			data += (uint32_t)chunk_data_sz;
-			if (data_end < (uintptr_t)data) {
-				fastboot_fail("buffer overreads occured due to invalid sparse header");
-				return;
-			}
-			break;
-
-			default:
-			dprintf(CRITICAL, "Unkown chunk type: %x\n",chunk_header->chunk_type);
-			fastboot_fail("Unknown chunk type");
-			return;
-		}
-	}
-
-	dprintf(INFO, "Wrote %d blocks, expected to write %d blocks\n",
-					total_blocks, sparse_header->total_blks);
-
-	if(total_blocks != sparse_header->total_blks)
-	{
-		fastboot_fail("sparse image write failure");
-	}
-
-	fastboot_okay("");
-	return;
-}
-
-static bool CheckVirtualAbCriticalPartition (const char *PartitionName)
-{
-	VirtualAbMergeStatus SnapshotMergeStatus;
-	uint32 Iter = 0;
+static bool CheckVirtualAbCriticalPartition (const char *PartitionName)
+{
+	VirtualAbMergeStatus SnapshotMergeStatus;
+	uint32 Iter = 0;
 
 	SnapshotMergeStatus = GetSnapshotMergeStatus ();
 	if ((SnapshotMergeStatus == MERGING || SnapshotMergeStatus == SNAPSHOTTED)) {
@@ -4521,6 +4753,711 @@ void cmd_flash_mmc(const char *arg, void *data, unsigned sz)
 	return;
 }
 
+/*
+ * Streaming flash: "oem flash-stream <partition>" sets up the following
+ * download to be written to the partition chunk by chunk while the next
+ * chunk is still being received, e.g.
+ *	fastboot oem flash-stream system
+ *	fastboot stage system.img
+ * Unlike "flash:", the image size is only limited by the partition size.
+ * Sparse images are decoded on the fly. With lk2nd, gzip and LZ4 compressed
+ * images are decompressed on the fly as well (before the sparse decoding),
+ * so only the compressed image has to be sent over USB.
+ */
+struct flash_stream {
+	struct fastboot_stream stream;
+	char pname[MAX_GPT_NAME_SIZE];
+	int index;
+	unsigned long long ptn;
+	unsigned long long size;
+	unsigned long long offset;
+	unsigned long long len;
+	bool sparse;
+	struct sparse_writer sw;
+#if WITH_LK2ND
+	/*
+	 * Decompression buffers, allocated above busy: the end of the data in
+	 * the download buffer that is still needed. NULL for streamed downloads,
+	 * which only use two chunks at the start of the download buffer.
+	 */
+	void *unpack_work;
+	const char *busy;
+	struct unpack_writer uw;
+#endif
+	const char *error;
+};
+
+static struct flash_stream flash_stream;
+
+static void flash_stream_reset(struct flash_stream *fs, unsigned long long len)
+{
+	fs->len = len;
+	fs->offset = 0;
+	fs->sparse = false;
+	fs->error = NULL;
+#if WITH_LK2ND
+	fs->busy = NULL;
+#endif
+}
+
+static int flash_stream_begin(struct fastboot_stream *stream, unsigned len)
+{
+	flash_stream_reset(containerof(stream, struct flash_stream, stream), len);
+	return 0;
+}
+
+/* Write the next piece of the (decompressed) image */
+static int flash_stream_put(struct flash_stream *fs, void *data, unsigned len)
+{
+	if (fs->offset == 0 && sparse_is_image(data, len)) {
+		fs->sparse = true;
+#if WITH_LK2ND
+		lk2nd_cpufreq_boost();
+#endif
+		sparse_writer_init(&fs->sw, fs->ptn, fs->size);
+		fs->sw.delta = flash_delta;
+	}
+
+	if (fs->sparse) {
+		fs->offset += len;
+		if (sparse_writer_write(&fs->sw, data, len)) {
+			fs->error = fs->sw.error;
+			return -1;
+		}
+		return 0;
+	}
+
+	if (fs->offset == 0) {
+		/* Sparse images are checked against the partition while decoding */
+		if (ROUND_TO_PAGE(fs->len, mmc_blocksize_mask) > fs->size) {
+			fs->error = "size too large";
+			return -1;
+		}
+
+		if (!strncmp(fs->pname, "boot", strlen("boot"))
+				|| !strcmp(fs->pname, "recovery"))
+		{
+			if (!IS_ENABLED(WITH_LK2ND_BOOT) &&
+			    ((len < BOOT_MAGIC_SIZE) || memcmp(data, BOOT_MAGIC, BOOT_MAGIC_SIZE))) {
+				fs->error = "image is not a boot image";
+				return -1;
+			}
+
+			/* Reset multislot_partition attributes in case of flashing boot */
+			if (partition_multislot_is_supported())
+				partition_reset_attributes(fs->index);
+		}
+	}
+
+	/* The size of a compressed image is only known once it is decompressed */
+	if (fs->offset + len > fs->size) {
+		fs->error = "size too large";
+		return -1;
+	}
+
+	if (mmc_write(fs->ptn + fs->offset, len, data)) {
+		fs->error = "flash write failure";
+		return -1;
+	}
+
+	fs->offset += len;
+	return 0;
+}
+
+#if WITH_LK2ND
+static int flash_stream_unpack_out(void *arg, void *data, unsigned len)
+{
+	return flash_stream_put(arg, data, len);
+}
+
+/* Start decompressing if the image is compressed, returns < 0 on failure */
+static int flash_stream_unpack_start(struct flash_stream *fs, void *data, unsigned len)
+{
+	enum unpack_format format = unpack_detect(data, len);
+	void *work;
+
+	if (format == UNPACK_NONE)
+		return 0;
+
+	work = lk2nd_region_alloc("unpack", unpack_work_size(format));
+	if (!work || (fs->busy && (char *)work < fs->busy)) {
+		if (work)
+			lk2nd_region_free(work);
+		fs->error = "not enough memory to decompress";
+		return -1;
+	}
+
+	dprintf(INFO, "Decompressing %s image for %s\n",
+		format == UNPACK_GZIP ? "gzip" : "lz4", fs->pname);
+	lk2nd_cpufreq_boost();
+	fs->unpack_work = work;
+	if (unpack_writer_init(&fs->uw, format, work, flash_stream_unpack_out, fs)) {
+		fs->error = fs->uw.error;
+		return -1;
+	}
+	return 0;
+}
+#endif
+
+static int flash_stream_write(struct fastboot_stream *stream, void *data, unsigned len)
+{
+	struct flash_stream *fs = containerof(stream, struct flash_stream, stream);
+
+#if WITH_LK2ND
+	if (fs->offset == 0 && !fs->unpack_work &&
+	    flash_stream_unpack_start(fs, data, len))
+		return -1;
+
+	if (fs->unpack_work) {
+		if (unpack_writer_write(&fs->uw, data, len)) {
+			/* Without a reason, writing the output failed */
+			if (fs->uw.error)
+				fs->error = fs->uw.error;
+			return -1;
+		}
+		return 0;
+	}
+#endif
+
+	return flash_stream_put(fs, data, len);
+}
+
+/* Complete the image after its last write, returns < 0 with fs->error set */
+static int flash_stream_finish(struct flash_stream *fs, int status)
+{
+#if WITH_LK2ND
+	/* The end of the decompressed data may still have to be written */
+	if (fs->unpack_work) {
+		if (!status && unpack_writer_finish(&fs->uw)) {
+			if (fs->uw.error)
+				fs->error = fs->uw.error;
+			status = -1;
+		}
+		unpack_writer_free(&fs->uw);
+		lk2nd_region_free(fs->unpack_work);
+		fs->unpack_work = NULL;
+		lk2nd_cpufreq_unboost();
+	}
+#endif
+
+	if (fs->sparse) {
+		if (!status && sparse_writer_finish(&fs->sw)) {
+			fs->error = fs->sw.error;
+			status = -1;
+		}
+		sparse_writer_free(&fs->sw);
+		fs->sparse = false;
+#if WITH_LK2ND
+		lk2nd_cpufreq_unboost();
+#endif
+	}
+
+	if (!status)
+		dprintf(INFO, "Streamed %llu bytes to %s\n", fs->offset, fs->pname);
+
+	return status;
+}
+
+static void flash_stream_end(struct fastboot_stream *stream, int status)
+{
+	struct flash_stream *fs = containerof(stream, struct flash_stream, stream);
+
+	if (flash_stream_finish(fs, status)) {
+		fastboot_fail(fs->error);
+		return;
+	}
+
+	fastboot_okay("");
+}
+
+/* Look up the partition to be written, returns why if it is not allowed */
+static const char *flash_stream_setup(struct flash_stream *fs, const char *pname)
+{
+	if (!target_is_emmc_boot())
+		return "streaming flash requires eMMC";
+
+#if VERIFIED_BOOT || VERIFIED_BOOT_2
+	if (target_build_variant_user() && !device.is_unlocked)
+		return "Device is locked, streaming flash is not allowed";
+#endif
+
+	if (target_virtual_ab_supported() && CheckVirtualAbCriticalPartition(pname))
+		return "Flashing is not allowed in snapshot state";
+
+	fs->index = partition_get_index(pname);
+	fs->ptn = partition_get_offset(fs->index);
+	if (fs->ptn == 0)
+		return "partition table doesn't exist";
+
+	fs->size = partition_get_size(fs->index);
+	mmc_set_lun(partition_get_lun(fs->index));
+	strlcpy(fs->pname, pname, sizeof(fs->pname));
+	flash_invalidate_mounts();
+#if MMC_SDHCI_SUPPORT
+	mmc_enable_write_cache();
+#endif
+	return NULL;
+}
+
+void cmd_oem_flash_stream(const char *arg, void *data, unsigned sz)
+{
+	struct flash_stream *fs = &flash_stream;
+	const char *error;
+
+	error = flash_stream_setup(fs, arg);
+	if (error) {
+		fastboot_fail(error);
+		return;
+	}
+
+	fs->stream.begin = flash_stream_begin;
+	fs->stream.write = flash_stream_write;
+	fs->stream.end = flash_stream_end;
+	fastboot_stream_download(&fs->stream);
+	fastboot_okay("");
+}
+
+/*
+ * Bundled flash: "oem flash-bundle" sets up the following download to be a
+ * tar archive with several images, each one is streamed to its partition
+ * like with "oem flash-stream" while the rest is still being received, e.g.
+ *	fastboot oem flash-bundle
+ *	fastboot stage bundle.tar
+ * The first member must be a "manifest" with one "<partition> <file>" line
+ * for each image in the archive, all of them have to be flashed to succeed.
+ */
+#define FLASH_BUNDLE_BLOCK	512
+#define FLASH_BUNDLE_MANIFEST_SIZE	4096
+#define FLASH_BUNDLE_MAX_ENTRIES	32
+
+enum flash_bundle_state {
+	FLASH_BUNDLE_HEADER,
+	FLASH_BUNDLE_MANIFEST,
+	FLASH_BUNDLE_IMAGE,
+	FLASH_BUNDLE_SKIP,
+	FLASH_BUNDLE_END,
+};
+
+struct flash_bundle_entry {
+	const char *pname;
+	const char *file;
+	bool done;
+};
+
+struct flash_bundle {
+	struct fastboot_stream stream;
+	enum flash_bundle_state state;
+
+	/* the current tar header, it may be split between two chunks */
+	char hdr[FLASH_BUNDLE_BLOCK];
+	unsigned hdr_len;
+
+	/* data of the current member left, followed by pad bytes of padding */
+	unsigned long long left;
+	unsigned pad;
+
+	char manifest[FLASH_BUNDLE_MANIFEST_SIZE];
+	unsigned manifest_len;
+	struct flash_bundle_entry entries[FLASH_BUNDLE_MAX_ENTRIES];
+	unsigned count;
+
+	const char *error;
+	char errbuf[MAX_RSP_SIZE];
+};
+
+static struct flash_bundle flash_bundle;
+
+static int flash_bundle_fail(struct flash_bundle *fb, const char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	vsnprintf(fb->errbuf, sizeof(fb->errbuf), fmt, ap);
+	va_end(ap);
+	fb->error = fb->errbuf;
+	return -1;
+}
+
+static int flash_bundle_parse_manifest(struct flash_bundle *fb)
+{
+	struct flash_bundle_entry *e;
+	char *line, *next, *p;
+
+	fb->manifest[fb->manifest_len] = '\0';
+	fb->count = 0;
+
+	for (line = fb->manifest; line; line = next) {
+		next = strchr(line, '\n');
+		if (next)
+			*next++ = '\0';
+
+		p = strtok(line, " \t\r");
+		if (!p || *p == '#')
+			continue;
+
+		if (fb->count == FLASH_BUNDLE_MAX_ENTRIES)
+			return flash_bundle_fail(fb, "too many manifest entries");
+
+		e = &fb->entries[fb->count++];
+		e->pname = p;
+		e->file = strtok(NULL, " \t\r");
+		e->done = false;
+		if (!e->file || strtok(NULL, " \t\r"))
+			return flash_bundle_fail(fb, "invalid manifest entry for %s", p);
+	}
+
+	if (!fb->count)
+		return flash_bundle_fail(fb, "empty manifest");
+
+	return 0;
+}
+
+static int flash_bundle_header(struct flash_bundle *fb)
+{
+	struct flash_stream *fs = &flash_stream;
+	char name[101];
+	const char *error;
+	unsigned i;
+
+	for (i = 0; i < FLASH_BUNDLE_BLOCK; i++)
+		if (fb->hdr[i])
+			break;
+	if (i == FLASH_BUNDLE_BLOCK) {
+		/* end of archive, anything that follows is ignored */
+		fb->state = FLASH_BUNDLE_END;
+		return 0;
+	}
+
+	if (memcmp(fb->hdr + 257, "ustar", 5))
+		return flash_bundle_fail(fb, "not a tar archive");
+
+	strlcpy(name, fb->hdr, sizeof(name));
+	fb->left = 0;
+	for (i = 124; i < 136 && fb->hdr[i] >= '0' && fb->hdr[i] <= '7'; i++)
+		fb->left = fb->left * 8 + fb->hdr[i] - '0';
+	fb->pad = -fb->left & (FLASH_BUNDLE_BLOCK - 1);
+
+	/* pax and GNU extension headers, directories, ... */
+	if (fb->hdr[156] != '0' && fb->hdr[156] != '\0') {
+		fb->state = FLASH_BUNDLE_SKIP;
+		return 0;
+	}
+
+	if (!fb->count) {
+		if (strcmp(name, "manifest"))
+			return flash_bundle_fail(fb, "manifest must come first");
+		if (fb->left >= sizeof(fb->manifest))
+			return flash_bundle_fail(fb, "manifest too large");
+		fb->manifest_len = 0;
+		fb->state = FLASH_BUNDLE_MANIFEST;
+		return 0;
+	}
+
+	for (i = 0; i < fb->count; i++)
+		if (!fb->entries[i].done && !strcmp(fb->entries[i].file, name))
+			break;
+	if (i == fb->count) {
+		dprintf(INFO, "flash-bundle: skipping %s\n", name);
+		fb->state = FLASH_BUNDLE_SKIP;
+		return 0;
+	}
+
+	error = flash_stream_setup(fs, fb->entries[i].pname);
+	if (error)
+		return flash_bundle_fail(fb, "%s: %s", fb->entries[i].pname, error);
+
+	dprintf(INFO, "flash-bundle: writing %s to %s\n", name, fs->pname);
+	fb->entries[i].done = true;
+	flash_stream_reset(fs, fb->left);
+	fb->state = FLASH_BUNDLE_IMAGE;
+	return 0;
+}
+
+/* Consume data of the current member, called with at most fb->left bytes */
+static int flash_bundle_data(struct flash_bundle *fb, char *data, unsigned len)
+{
+	struct flash_stream *fs = &flash_stream;
+	int ret;
+
+	switch (fb->state) {
+	case FLASH_BUNDLE_MANIFEST:
+		memcpy(fb->manifest + fb->manifest_len, data, len);
+		fb->manifest_len += len;
+		break;
+	case FLASH_BUNDLE_IMAGE:
+		if (len && flash_stream_write(&fs->stream, data, len))
+			return flash_bundle_fail(fb, "%s: %s", fs->pname, fs->error);
+		break;
+	default:
+		break;
+	}
+
+	fb->left -= len;
+	if (fb->left)
+		return 0;
+
+	/* the member is complete */
+	switch (fb->state) {
+	case FLASH_BUNDLE_MANIFEST:
+		ret = flash_bundle_parse_manifest(fb);
+		if (ret)
+			return ret;
+		break;
+	case FLASH_BUNDLE_IMAGE:
+		if (flash_stream_finish(fs, 0))
+			return flash_bundle_fail(fb, "%s: %s", fs->pname, fs->error);
+		break;
+	default:
+		break;
+	}
+
+	fb->state = FLASH_BUNDLE_SKIP;
+	return 0;
+}
+
+static int flash_bundle_begin(struct fastboot_stream *stream, unsigned len)
+{
+	struct flash_bundle *fb = containerof(stream, struct flash_bundle, stream);
+
+	fb->state = FLASH_BUNDLE_HEADER;
+	fb->hdr_len = 0;
+	fb->left = 0;
+	fb->pad = 0;
+	fb->count = 0;
+	fb->error = NULL;
+	return 0;
+}
+
+static int flash_bundle_write(struct fastboot_stream *stream, void *_data, unsigned len)
+{
+	struct flash_bundle *fb = containerof(stream, struct flash_bundle, stream);
+	char *data = _data;
+	unsigned n;
+
+	while (len && fb->state != FLASH_BUNDLE_END) {
+		if (fb->state == FLASH_BUNDLE_HEADER) {
+			n = MIN(len, FLASH_BUNDLE_BLOCK - fb->hdr_len);
+			memcpy(fb->hdr + fb->hdr_len, data, n);
+			fb->hdr_len += n;
+			data += n;
+			len -= n;
+			if (fb->hdr_len < FLASH_BUNDLE_BLOCK)
+				break;
+
+			fb->hdr_len = 0;
+			if (flash_bundle_header(fb))
+				return -1;
+			if (fb->state == FLASH_BUNDLE_END)
+				break;
+			/* complete empty members right away */
+			if (!fb->left && flash_bundle_data(fb, data, 0))
+				return -1;
+			continue;
+		}
+
+		if (fb->left) {
+			n = MIN(len, fb->left);
+			if (flash_bundle_data(fb, data, n))
+				return -1;
+			data += n;
+			len -= n;
+			continue;
+		}
+
+		n = MIN(len, fb->pad);
+		fb->pad -= n;
+		data += n;
+		len -= n;
+		if (!fb->pad)
+			fb->state = FLASH_BUNDLE_HEADER;
+	}
+
+	return 0;
+}
+
+static void flash_bundle_end(struct fastboot_stream *stream, int status)
+{
+	struct flash_bundle *fb = containerof(stream, struct flash_bundle, stream);
+	unsigned i;
+
+	if (fb->state == FLASH_BUNDLE_IMAGE)
+		flash_stream_finish(&flash_stream, -1);
+
+	if (status) {
+		fastboot_fail(fb->error ? fb->error : "flash-bundle failed");
+		return;
+	}
+
+	if (fb->state != FLASH_BUNDLE_END) {
+		fastboot_fail("truncated archive");
+		return;
+	}
+
+	for (i = 0; i < fb->count; i++) {
+		if (!fb->entries[i].done) {
+			flash_bundle_fail(fb, "%s missing in archive", fb->entries[i].file);
+			fastboot_fail(fb->error);
+			return;
+		}
+	}
+
+	if (!fb->count) {
+		fastboot_fail("no manifest in archive");
+		return;
+	}
+
+	fastboot_okay("");
+}
+
+void cmd_oem_flash_bundle(const char *arg, void *data, unsigned sz)
+{
+	struct flash_bundle *fb = &flash_bundle;
+
+	if (!target_is_emmc_boot()) {
+		fastboot_fail("streaming flash requires eMMC");
+		return;
+	}
+
+	fb->stream.begin = flash_bundle_begin;
+	fb->stream.write = flash_bundle_write;
+	fb->stream.end = flash_bundle_end;
+	fastboot_stream_download(&fb->stream);
+	fastboot_okay("");
+}
+
+/*
+ * "flash:" for downloads that did not fit into the download buffer and were
+ * received into the regions from aboot_add_download_regions() instead. They
+ * are written region by region like "oem flash-stream", so the chunks of a
+ * sparse image may span regions.
+ */
+static void cmd_flash_mmc_scattered(const char *arg,
+				    const struct fastboot_region *regions,
+				    unsigned count, unsigned len)
+{
+	struct flash_stream *fs = &flash_stream;
+	const char *error;
+	int status = 0;
+	unsigned i, n;
+
+	error = flash_stream_setup(fs, arg);
+	if (error) {
+		fastboot_fail(error);
+		return;
+	}
+
+	flash_stream_reset(fs, len);
+#if WITH_LK2ND
+	/* Decompression buffers must not overlap the download buffer */
+	fs->busy = (char *)regions[0].base + MIN(len, regions[0].size);
+#endif
+	for (i = 0; i < count && len && !status; i++) {
+		n = MIN(len, regions[i].size);
+		status = flash_stream_write(&fs->stream, regions[i].base, n);
+		len -= n;
+	}
+
+	flash_stream_end(&fs->stream, status);
+}
+
+#if WITH_LIB_FS
+/*
+ * "oem flash-file <partition> <path>" writes a file from a filesystem to a
+ * partition, going through the same path as "oem flash-stream" (including
+ * sparse decoding) without any USB transfer. The first component of the
+ * path is a block device, which is mounted if it is not mounted yet, e.g.
+ *	fastboot oem flash-file system /mmc1p1/system.img
+ */
+#define FLASH_FILE_CHUNK	(4 * 1024 * 1024)
+
+static int flash_file_open(const char *path, filehandle **handle,
+			   char *mountpoint, size_t len)
+{
+	const char *end;
+
+	mountpoint[0] = '\0';
+	if (fs_open_file(path, handle) >= 0)
+		return 0;
+
+	/* Not mounted yet: mount the device named by the first component */
+	end = strchr(path + 1, '/');
+	if (path[0] != '/' || !end || (size_t)(end - path) >= len)
+		return -1;
+
+	strlcpy(mountpoint, path, end - path + 1);
+	if (fs_mount_auto(mountpoint, mountpoint + 1) < 0) {
+		mountpoint[0] = '\0';
+		return -1;
+	}
+
+	return fs_open_file(path, handle) < 0 ? -1 : 0;
+}
+
+void cmd_oem_flash_file(const char *arg, void *data, unsigned sz)
+{
+	struct flash_stream *fs = &flash_stream;
+	char pname[MAX_GPT_NAME_SIZE];
+	char mountpoint[FS_MAX_FILE_LEN + 1];
+	struct file_stat stat;
+	filehandle *handle;
+	const char *path, *error;
+	unsigned long long off = 0;
+	unsigned len;
+	ssize_t ret;
+	int status = 0;
+
+	path = strchr(arg, ' ');
+	if (!path || path == arg || (size_t)(path - arg) >= sizeof(pname)) {
+		fastboot_fail("usage: fastboot oem flash-file <partition> <path>");
+		return;
+	}
+	strlcpy(pname, arg, path - arg + 1);
+	while (*path == ' ')
+		path++;
+
+	error = flash_stream_setup(fs, pname);
+	if (error) {
+		fastboot_fail(error);
+		return;
+	}
+
+	if (flash_file_open(path, &handle, mountpoint, sizeof(mountpoint)) < 0) {
+		fastboot_fail("file not found");
+		goto out_unmount;
+	}
+
+	if (fs_stat_file(handle, &stat) < 0 || stat.is_dir) {
+		fastboot_fail("not a file");
+		goto out_close;
+	}
+
+	/* The download buffer is not needed, it holds each chunk in turn */
+	flash_stream_reset(fs, stat.size);
+#if WITH_LK2ND
+	fs->busy = (char *)data + FLASH_FILE_CHUNK;
+#endif
+	while (!status && off < (unsigned long long)stat.size) {
+		len = MIN((unsigned long long)stat.size - off, FLASH_FILE_CHUNK);
+		ret = fs_read_file(handle, data, off, len);
+		if (ret != (ssize_t)len) {
+			fs->error = "file read failure";
+			status = -1;
+			break;
+		}
+
+		status = flash_stream_write(&fs->stream, data, len);
+		off += len;
+	}
+	flash_stream_end(&fs->stream, status);
+
+out_close:
+	fs_close_file(handle);
+out_unmount:
+	if (mountpoint[0])
+		fs_unmount(mountpoint);
+}
+#endif
+
 void cmd_updatevol(const char *vol_name, void *data, unsigned sz)
 {
 	struct ptentry *sys_ptn;
@@ -4659,8 +5596,32 @@ static inline uint64_t validate_partition_size(struct ptentry *ptn)
 
 void cmd_flash(const char *arg, void *data, unsigned sz)
 {
+	const struct fastboot_region *regions;
+	unsigned count, len;
+
 	if(target_is_emmc_boot())
-		cmd_flash_mmc(arg, data, sz);
+	{
+		flash_invalidate_mounts();
+#if MMC_SDHCI_SUPPORT
+		/* Flushed before the OKAY of each command, see fastboot_okay() */
+		mmc_enable_write_cache();
+#endif
+		rpm_bw_request();
+		len = fastboot_download_scattered(&regions, &count);
+		if (len) {
+			cmd_flash_mmc_scattered(arg, regions, count, len);
+#if WITH_LK2ND
+		} else if (unpack_detect(data, sz) != UNPACK_NONE) {
+			/* Decompressed while it is written, like a scattered one */
+			struct fastboot_region region = { data, sz };
+
+			cmd_flash_mmc_scattered(arg, &region, 1, sz);
+#endif
+		} else {
+			cmd_flash_mmc(arg, data, sz);
+		}
+		rpm_bw_release();
+	}
 	else
 		cmd_flash_nand(arg, data, sz);
 }
@@ -5332,6 +6293,36 @@ bool is_verity_enforcing(void)
 }
 
 /* register commands and variables for fastboot */
+/*
+ * In fastboot mode, the DDR above the scratch region is not used otherwise.
+ * Downloads that do not fit into the scratch region are received there and
+ * flashed to eMMC from there, so large (sparse) images need not be split by
+ * the host. Returns the size available for such downloads.
+ */
+static unsigned long long aboot_add_download_regions(void)
+{
+	unsigned long long total = 0;
+#if WITH_LK2ND
+	const struct lk2nd_region *ranges;
+	/* The download length is 32-bit */
+	uint32_t limit = ROUNDDOWN(UINT_MAX, MB);
+	uint32_t i, count, size;
+
+	if (!target_is_emmc_boot())
+		return 0;
+
+	count = lk2nd_highmem_map(&ranges);
+	for (i = 0; i < count && total < limit; i++) {
+		size = MIN(ranges[i].size, limit - total);
+		dprintf(INFO, "Download region: 0x%lx - 0x%lx\n",
+			ranges[i].start, ranges[i].start + size);
+		fastboot_add_download_region((void *)ranges[i].start, size);
+		total += size;
+	}
+#endif
+	return total;
+}
+
 void aboot_fastboot_register_commands(void)
 {
 	int i;
@@ -5348,7 +6339,16 @@ void aboot_fastboot_register_commands(void)
 						/* Register the following commands only for non-user builds */
 						{"flash:", cmd_flash},
 						{"erase:", cmd_erase},
+						{"oem flash-stream", cmd_oem_flash_stream},
+						{"oem flash-bundle", cmd_oem_flash_bundle},
+						{"oem flash-delta", cmd_oem_flash_delta},
+#if WITH_LIB_FS
+						{"oem flash-file", cmd_oem_flash_file},
+#endif
 						{"boot", cmd_boot},
+#if !VERIFIED_BOOT && !VERIFIED_BOOT_2 && !defined(MDTP_SUPPORT)
+						{"oem boot-placed", cmd_oem_boot_placed},
+#endif
 						{"continue", cmd_continue},
 						{"reboot", cmd_reboot},
 						{"reboot-bootloader", cmd_reboot_bootloader},
@@ -5415,8 +6415,8 @@ void aboot_fastboot_register_commands(void)
 
 	/* Max download size supported */
 #if !VERIFIED_BOOT_2
-	snprintf(max_download_size, MAX_RSP_SIZE, "\t0x%x",
-			target_get_max_flash_size());
+	snprintf(max_download_size, MAX_RSP_SIZE, "\t0x%llx",
+			MAX(target_get_max_flash_size(), aboot_add_download_regions()));
 #else
 	snprintf(max_download_size, MAX_RSP_SIZE, "\t0x%x",
 			SUB_SALT_BUFF_OFFSET(target_get_max_flash_size()));
@@ -5493,6 +6493,50 @@ void aboot_fastboot_register_commands(void)
 	}
 }
 
+#if DISPLAY_SPLASH_SCREEN
+#if WITH_LK2ND && LK2ND_QUICK_BOOT
+/* Called on demand, once the boot attempt needs or failed without the panel */
+void aboot_display_init(void)
+{
+	static bool display_init_done;
+
+	if (display_init_done)
+		return;
+	display_init_done = true;
+#else
+static void aboot_display_init(void)
+{
+#endif
+#if NO_ALARM_DISPLAY
+	if (check_alarm_boot())
+		return;
+#endif
+	dprintf(SPEW, "Display Init: Start\n");
+#if DISPLAY_HDMI_PRIMARY
+	if (!strlen(device.display_panel))
+		strlcpy(device.display_panel, DISPLAY_PANEL_HDMI,
+			sizeof(device.display_panel));
+#endif
+#if ENABLE_WBC
+	/* Wait if the display shutdown is in progress */
+	while(pm_app_display_shutdown_in_prgs());
+	if (!pm_appsbl_display_init_done())
+		target_display_init(device.display_panel);
+	else
+		display_image_on_screen();
+#else
+	target_display_init(device.display_panel);
+#endif
+	dprintf(SPEW, "Display Init: Done\n");
+}
+
+#if WITH_LK2ND && LK2ND_DISPLAY_ASYNC && !LK2ND_QUICK_BOOT
+/* Bring up the panel while aboot continues with loading the boot image */
+LK2ND_INIT_STAGE(aboot_display_init, LK2ND_INIT_ASYNC);
+LK2ND_INIT_AFTER(aboot_display_init, lk2nd_device_init);
+#endif
+#endif
+
 void aboot_init(const struct app_descriptor *app)
 {
 	unsigned reboot_mode = 0;
@@ -5548,30 +6592,8 @@ void aboot_init(const struct app_descriptor *app)
 #endif
 
 	/* Display splash screen if enabled */
-#if DISPLAY_SPLASH_SCREEN
-#if NO_ALARM_DISPLAY
-	if (!check_alarm_boot()) {
-#endif
-		dprintf(SPEW, "Display Init: Start\n");
-#if DISPLAY_HDMI_PRIMARY
-	if (!strlen(device.display_panel))
-		strlcpy(device.display_panel, DISPLAY_PANEL_HDMI,
-			sizeof(device.display_panel));
-#endif
-#if ENABLE_WBC
-		/* Wait if the display shutdown is in progress */
-		while(pm_app_display_shutdown_in_prgs());
-		if (!pm_appsbl_display_init_done())
-			target_display_init(device.display_panel);
-		else
-			display_image_on_screen();
-#else
-		target_display_init(device.display_panel);
-#endif
-		dprintf(SPEW, "Display Init: Done\n");
-#if NO_ALARM_DISPLAY
-	}
-#endif
+#if DISPLAY_SPLASH_SCREEN && !(WITH_LK2ND && (LK2ND_DISPLAY_ASYNC || LK2ND_QUICK_BOOT))
+	aboot_display_init();
 #endif
 
 	if (!IS_ENABLED(WITH_LK2ND) || !sn_buf[0])
@@ -5587,7 +6609,13 @@ void aboot_init(const struct app_descriptor *app)
 	if (is_user_force_reset())
 		goto normal_boot;
 
-#if defined(LK2ND_BOOT_COUNTDOWN) && WITH_LK2ND_DEVICE_MENU
+#if LK2ND_QUICK_BOOT && WITH_LK2ND_DEVICE_MENU
+	/* No countdown, only a key that is already pending enters the shell */
+	if (boot_menu_quick_check()) {
+		boot_into_fastboot = true;
+		dprintf(INFO, "User requested lk2nd shell via serial\n");
+	}
+#elif defined(LK2ND_BOOT_COUNTDOWN) && WITH_LK2ND_DEVICE_MENU
 	/* Boot countdown - interrupting it over serial enters the lk2nd shell */
 	if (boot_menu_countdown_check()) {
 		boot_into_fastboot = true;
@@ -5665,6 +6693,16 @@ void aboot_init(const struct app_descriptor *app)
 #endif
 
 normal_boot:
+#if WITH_LK2ND_BOOT
+	/* The countdown preloaded lk2nd_boot()'s files, drop them if unused */
+	if (boot_into_fastboot || boot_into_recovery)
+		lk2nd_boot_preload_discard();
+#endif
+
+	/* Let the host enumerate the device while the rest of init finishes */
+	if (boot_into_fastboot)
+		fastboot_init_early();
+
 	if (!boot_into_fastboot)
 	{
 #if WITH_LK2ND_BOOT
@@ -5738,6 +6776,12 @@ retry_boot:
 
 fastboot:
 	/* We are here means regular boot did not happen. Start fastboot. */
+#if DISPLAY_SPLASH_SCREEN && WITH_LK2ND && LK2ND_QUICK_BOOT
+	aboot_display_init();
+#endif
+#if WITH_LK2ND
+	lk2nd_init_wait_all();
+#endif
 
 	/* register aboot specific fastboot commands */
 	fastboot_register_commands();
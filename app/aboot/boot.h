@@ -14,6 +14,11 @@ enum boot_type {
 
 unsigned char *update_cmdline(const char *cmdline);
 
+#if DISPLAY_SPLASH_SCREEN && WITH_LK2ND && LK2ND_QUICK_BOOT
+/* The display is only brought up when needed with quick boot */
+void aboot_display_init(void);
+#endif
+
 #if DEVICE_TREE
 struct dt_update_handler {
 	const char *name;
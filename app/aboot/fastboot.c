@@ -36,8 +36,14 @@
 #include <kernel/thread.h>
 #include <kernel/event.h>
 #include <dev/udc.h>
+#include <crypto_hash.h>
+#include <rpm-ipc.h>
 #include "fastboot.h"
 
+#if MMC_SDHCI_SUPPORT
+#include <mmc.h>
+#endif
+
 #ifdef USB30_SUPPORT
 #include <usb30_udc.h>
 #endif
@@ -56,12 +62,44 @@ typedef struct
 
 	int (*usb_read)(void *buf, unsigned len);
 	int (*usb_write)(void *buf, unsigned len);
+
+	/* usb_read() and usb_write() split in two, the transfer runs between the calls */
+	int (*usb_read_start)(void *buf, unsigned len);
+	int (*usb_read_finish)(void);
+	int (*usb_write_start)(void *buf, unsigned len);
+	int (*usb_write_finish)(void);
 } usb_controller_interface_t;
 
 usb_controller_interface_t usb_if;
 
-#define MAX_USBFS_BULK_SIZE (32 * 1024)
-#define MAX_USBSS_BULK_SIZE (0x1000000)
+/*
+ * hsusb_usb_read() keeps several OUT requests in flight so the
+ * controller continues with the next TD chain while the completed
+ * one is handed back, instead of idling until it is queued again.
+ */
+#define USBFS_RX_QUEUE_DEPTH 4
+#define MAX_USBFS_RX_SIZE (128 * 1024)
+
+/*
+ * hsusb_usb_write() primes the next IN request while the controller is
+ * still sending the current one. Each request is a TD chain of up to
+ * MAX_USBFS_TX_SIZE.
+ */
+#define USBFS_TX_QUEUE_DEPTH 2
+#define MAX_USBFS_TX_SIZE (1024 * 1024)
+
+/*
+ * Streamed transfers alternate between two halves of the download buffer.
+ * A chunk fits into the OUT requests queued by a single usb_read_start()
+ * and into one IN request (32 TDs of 16 KiB on HSUSB), so the transfer
+ * does not stall while the other half is processed.
+ */
+#define FASTBOOT_STREAM_CHUNK (USBFS_RX_QUEUE_DEPTH * MAX_USBFS_RX_SIZE)
+/*
+ * The DWC driver chains up to 65 TRBs of 16 MiB for one request, so
+ * large downloads need few request turnarounds.
+ */
+#define MAX_USBSS_BULK_SIZE (0x4000000)
 
 void boot_linux(void *bootimg, unsigned sz);
 static void fastboot_notify(struct udc_gadget *gadget, unsigned event);
@@ -115,6 +153,7 @@ static unsigned hex2unsigned(const char *x)
 
 struct fastboot_cmd {
 	struct fastboot_cmd *next;
+	struct fastboot_cmd *hash_next;
 	const char *prefix;
 	unsigned prefix_len;
 	void (*handle)(const char *arg, void *data, unsigned sz);
@@ -122,16 +161,38 @@ struct fastboot_cmd {
 
 struct fastboot_var {
 	struct fastboot_var *next;
+	struct fastboot_var *hash_next;
 	const char *name;
 	const char *value;
 };
 
+/*
+ * Commands and variables are kept in registration order for "oem help" and
+ * "getvar:all", and additionally in small hash tables so that a lookup only
+ * compares against the few entries in one bucket. Commands are hashed by
+ * their first word (up to the first ' ' or ':'), a command can only match
+ * prefixes that start with the same word.
+ */
+#define FASTBOOT_HASH_SIZE	32
+
+static unsigned fastboot_hash(const char *str, const char *stop)
+{
+	unsigned hash = 5381;
+
+	for (; *str && !strchr(stop, *str); str++)
+		hash = hash * 33 + (unsigned char)*str;
+
+	return hash % FASTBOOT_HASH_SIZE;
+}
+
 static struct fastboot_cmd *cmdlist;
+static struct fastboot_cmd *cmdhash[FASTBOOT_HASH_SIZE];
 
 void fastboot_register(const char *prefix,
 		       void (*handle)(const char *arg, void *data, unsigned sz))
 {
 	struct fastboot_cmd *cmd;
+	unsigned hash;
 	cmd = malloc(sizeof(*cmd));
 	if (cmd) {
 		cmd->prefix = prefix;
@@ -139,33 +200,64 @@ void fastboot_register(const char *prefix,
 		cmd->handle = handle;
 		cmd->next = cmdlist;
 		cmdlist = cmd;
+
+		hash = fastboot_hash(prefix, " :");
+		cmd->hash_next = cmdhash[hash];
+		cmdhash[hash] = cmd;
 	}
 }
 
 static struct fastboot_var *varlist;
+static struct fastboot_var *varhash[FASTBOOT_HASH_SIZE];
 
 void fastboot_publish(const char *name, const char *value)
 {
 	struct fastboot_var *var;
+	unsigned hash;
 	var = malloc(sizeof(*var));
 	if (var) {
 		var->name = name;
 		var->value = value;
 		var->next = varlist;
 		varlist = var;
+
+		hash = fastboot_hash(name, "");
+		var->hash_next = varhash[hash];
+		varhash[hash] = var;
 	}
 }
 
-
 static event_t usb_online;
 static event_t txn_done;
+static event_t fastboot_ready;
+static bool fastboot_started;
 static struct udc_endpoint *in, *out;
 static struct udc_request *req;
+static struct udc_request *rx_req[USBFS_RX_QUEUE_DEPTH];
+static volatile unsigned rx_completed;
+static struct udc_request *tx_req[USBFS_TX_QUEUE_DEPTH];
+static volatile unsigned tx_completed;
 int txn_status;
 
 static void *download_base;
 static unsigned download_max;
 static unsigned download_size;
+/*
+ * Memory for downloads larger than the download buffer, which is not used
+ * for them so the lk2nd regions at its end stay intact. The sizes are
+ * rounded down to 4 KiB so only the end of a download can be a partial
+ * USB packet.
+ */
+#define FASTBOOT_DOWNLOAD_REGIONS	8
+static struct fastboot_region download_regions[FASTBOOT_DOWNLOAD_REGIONS];
+static unsigned download_nregions;
+static unsigned download_scattered;
+static struct fastboot_stream *download_stream;
+static struct fastboot_stream *upload_stream;
+static unsigned upload_stream_len;
+static bool download_hash;
+/* Two chars per byte for hexadecimal and null terminator */
+static char download_sha256[SHA256_INIT_VECTOR_SIZE * sizeof(uint32_t) * 2 + 1];
 
 #define STATE_OFFLINE	0
 #define STATE_COMMAND	1
@@ -182,6 +274,26 @@ static void req_complete(struct udc_request *req, unsigned actual, int status)
 	event_signal(&txn_done, 0);
 }
 
+static void rx_req_complete(struct udc_request *req, unsigned actual, int status)
+{
+	if (status < 0)
+		txn_status = status;
+	req->length = actual;
+	rx_completed++;
+
+	event_signal(&txn_done, 0);
+}
+
+static void tx_req_complete(struct udc_request *req, unsigned actual, int status)
+{
+	if (status < 0)
+		txn_status = status;
+	req->length = actual;
+	tx_completed++;
+
+	event_signal(&txn_done, 0);
+}
+
 #ifdef USB30_SUPPORT
 static int usb30_usb_read(void *_buf, unsigned len)
 {
@@ -254,6 +366,64 @@ oops:
 	return -1;
 }
 
+static struct udc_request usb30_rx_req;
+static unsigned char *usb30_rx_buf;
+static unsigned usb30_rx_len;
+
+static int usb30_usb_read_start(void *buf, unsigned len)
+{
+	int r;
+
+	ASSERT(buf);
+	ASSERT(len && len <= MAX_USBSS_BULK_SIZE);
+
+	if (fastboot_state == STATE_ERROR)
+		goto oops;
+
+	usb30_rx_buf = buf;
+	usb30_rx_len = len;
+	usb30_rx_req.buf      = (void*) PA((addr_t)buf);
+	usb30_rx_req.length   = len;
+	usb30_rx_req.complete = req_complete;
+
+	r = usb30_udc_request_queue(out, &usb30_rx_req);
+	if (r < 0) {
+		dprintf(CRITICAL, "usb_read() queue failed. r = %d\n", r);
+		goto oops;
+	}
+	return 0;
+
+oops:
+	fastboot_state = STATE_ERROR;
+	return -1;
+}
+
+static int usb30_usb_read_finish(void)
+{
+	unsigned count;
+	int r;
+
+	event_wait(&txn_done);
+	if (txn_status < 0) {
+		dprintf(CRITICAL, "usb_read() transaction failed. txn_status = %d\n",
+				txn_status);
+		fastboot_state = STATE_ERROR;
+		return -1;
+	}
+	count = usb30_rx_req.length;
+
+	/* Short packets complete the request early, see usb30_usb_read() */
+	if (count < usb30_rx_len) {
+		r = usb30_usb_read(usb30_rx_buf + count, usb30_rx_len - count);
+		if (r < 0)
+			return -1;
+		count += r;
+	}
+
+	arch_invalidate_cache_range((addr_t) usb30_rx_buf, ROUNDUP(count, CACHE_LINE));
+	return count;
+}
+
 static int usb30_usb_write(void *buf, unsigned len)
 {
 	int r;
@@ -297,95 +467,272 @@ oops:
 	dprintf(CRITICAL, "usb_write(): DONE: ERROR: len = %d\n", len);
 	return -1;
 }
-#endif
 
-static int hsusb_usb_read(void *_buf, unsigned len)
+static struct udc_request usb30_tx_req;
+
+static int usb30_usb_write_start(void *buf, unsigned len)
 {
 	int r;
-	unsigned xfer;
-	unsigned char *buf = _buf;
-	int count = 0;
+
+	ASSERT(buf);
+	ASSERT(len && len <= MAX_USBSS_BULK_SIZE);
 
 	if (fastboot_state == STATE_ERROR)
 		goto oops;
 
-	while (len > 0) {
-		xfer = (len > MAX_USBFS_BULK_SIZE) ? MAX_USBFS_BULK_SIZE : len;
-		req->buf = (unsigned char *)PA((addr_t)buf);
-		req->length = xfer;
-		req->complete = req_complete;
-		r = udc_request_queue(out, req);
+	/* flush buffer to main memory before giving to udc */
+	arch_clean_invalidate_cache_range((addr_t) buf, len);
+
+	usb30_tx_req.buf      = (void*) PA((addr_t)buf);
+	usb30_tx_req.length   = len;
+	usb30_tx_req.complete = req_complete;
+
+	r = usb30_udc_request_queue(in, &usb30_tx_req);
+	if (r < 0) {
+		dprintf(CRITICAL, "usb_write() queue failed. r = %d\n", r);
+		goto oops;
+	}
+	return 0;
+
+oops:
+	fastboot_state = STATE_ERROR;
+	return -1;
+}
+
+static int usb30_usb_write_finish(void)
+{
+	event_wait(&txn_done);
+	if (txn_status < 0) {
+		dprintf(CRITICAL, "usb_write() transaction failed. txn_status = %d\n",
+				txn_status);
+		fastboot_state = STATE_ERROR;
+		return -1;
+	}
+	return usb30_tx_req.length;
+}
+#endif
+
+/* OUT transfer in progress, see hsusb_usb_read_start() */
+static struct {
+	unsigned char *buf;
+	unsigned len;
+	unsigned queued;
+	unsigned nqueued, ndone;
+	unsigned xfer[USBFS_RX_QUEUE_DEPTH];
+	int count;
+} hsusb_rx;
+
+static int hsusb_rx_queue(void)
+{
+	int r;
+	struct udc_request *rx;
+	unsigned slot;
+
+	/* Keep the endpoint busy with up to USBFS_RX_QUEUE_DEPTH requests */
+	while (hsusb_rx.queued < hsusb_rx.len &&
+	       hsusb_rx.nqueued - hsusb_rx.ndone < USBFS_RX_QUEUE_DEPTH) {
+		slot = hsusb_rx.nqueued % USBFS_RX_QUEUE_DEPTH;
+		rx = rx_req[slot];
+		hsusb_rx.xfer[slot] = MIN(hsusb_rx.len - hsusb_rx.queued, MAX_USBFS_RX_SIZE);
+		rx->buf = (unsigned char *)PA((addr_t)(hsusb_rx.buf + hsusb_rx.queued));
+		rx->length = hsusb_rx.xfer[slot];
+		rx->complete = rx_req_complete;
+		r = udc_request_queue(out, rx);
 		if (r < 0) {
 			dprintf(INFO, "usb_read() queue failed\n");
-			goto oops;
+			return -1;
 		}
-		event_wait(&txn_done);
+		hsusb_rx.queued += hsusb_rx.xfer[slot];
+		hsusb_rx.nqueued++;
+	}
+
+	return 0;
+}
+
+/*
+ * Drop the requests that are still queued after a failed or short transfer,
+ * otherwise they would receive the next command or be queued twice.
+ */
+static void hsusb_rx_cancel(void)
+{
+	if (hsusb_rx.ndone < hsusb_rx.nqueued)
+		udc_request_cancel(out, rx_req[hsusb_rx.ndone % USBFS_RX_QUEUE_DEPTH]);
+	hsusb_rx.nqueued = hsusb_rx.ndone;
+}
+
+static int hsusb_usb_read_start(void *buf, unsigned len)
+{
+	if (fastboot_state == STATE_ERROR)
+		goto oops;
+
+	txn_status = 0;
+	rx_completed = 0;
+
+	hsusb_rx.buf = buf;
+	hsusb_rx.len = len;
+	hsusb_rx.queued = 0;
+	hsusb_rx.nqueued = 0;
+	hsusb_rx.ndone = 0;
+	hsusb_rx.count = 0;
+
+	if (hsusb_rx_queue() < 0)
+		goto oops;
+	return 0;
+
+oops:
+	hsusb_rx_cancel();
+	fastboot_state = STATE_ERROR;
+	return -1;
+}
+
+static int hsusb_usb_read_finish(void)
+{
+	struct udc_request *rx;
+	unsigned slot;
+
+	while (hsusb_rx.ndone < hsusb_rx.nqueued) {
+		/* Requests complete in the order they were queued */
+		while (rx_completed == hsusb_rx.ndone)
+			event_wait(&txn_done);
 
 		if (txn_status < 0) {
 			dprintf(INFO, "usb_read() transaction failed\n");
 			goto oops;
 		}
 
-		count += req->length;
-		buf += req->length;
-		len -= req->length;
+		slot = hsusb_rx.ndone % USBFS_RX_QUEUE_DEPTH;
+		rx = rx_req[slot];
+		hsusb_rx.count += rx->length;
+		hsusb_rx.ndone++;
 
 		/* short transfer? */
-		if (req->length != xfer) break;
+		if (rx->length != hsusb_rx.xfer[slot]) {
+			/* The host must not stop early while more data is queued */
+			if (hsusb_rx.ndone != hsusb_rx.nqueued) {
+				dprintf(INFO, "usb_read() short transfer\n");
+				goto oops;
+			}
+			break;
+		}
+
+		if (hsusb_rx_queue() < 0)
+			goto oops;
 	}
 	/*
 	 * Force reload of buffer from memory
 	 * since transaction is complete now.
 	 */
-	arch_invalidate_cache_range((addr_t)_buf, ROUNDUP(count, CACHE_LINE));
-	return count;
+	arch_invalidate_cache_range((addr_t)hsusb_rx.buf, ROUNDUP(hsusb_rx.count, CACHE_LINE));
+	return hsusb_rx.count;
 
 oops:
+	hsusb_rx_cancel();
 	fastboot_state = STATE_ERROR;
 	return -1;
 }
 
+static int hsusb_usb_read(void *buf, unsigned len)
+{
+	if (hsusb_usb_read_start(buf, len) < 0)
+		return -1;
+	return hsusb_usb_read_finish();
+}
+
 static int hsusb_usb_write(void *buf, unsigned len)
 {
 	int r;
-	uint32_t xfer;
+	struct udc_request *tx;
 	unsigned char *_buf = buf;
+	unsigned queued = 0, nqueued = 0, ndone = 0;
+	unsigned slot, xfer;
 	int count = 0;
 
 	if (fastboot_state == STATE_ERROR)
 		goto oops;
 
-	while (len > 0) {
-		xfer = (len > MAX_USBFS_BULK_SIZE) ? MAX_USBFS_BULK_SIZE : len;
-		req->buf = (unsigned char *)PA((addr_t)_buf);
-		req->length = xfer;
-		req->complete = req_complete;
-		r = udc_request_queue(in, req);
-		if (r < 0) {
-			dprintf(INFO, "usb_write() queue failed\n");
-			goto oops;
+	txn_status = 0;
+	tx_completed = 0;
+
+	for (;;) {
+		/* Keep the next request primed behind the one being sent */
+		while (queued < len && nqueued - ndone < USBFS_TX_QUEUE_DEPTH) {
+			tx = tx_req[nqueued % USBFS_TX_QUEUE_DEPTH];
+			tx->buf = (unsigned char *)PA((addr_t)(_buf + queued));
+			xfer = MIN(len - queued, MAX_USBFS_TX_SIZE);
+			tx->length = xfer;
+			tx->complete = tx_req_complete;
+			r = udc_request_queue(in, tx);
+			if (r < 0) {
+				dprintf(INFO, "usb_write() queue failed\n");
+				goto oops;
+			}
+			queued += xfer;
+			nqueued++;
 		}
-		event_wait(&txn_done);
+
+		if (ndone == nqueued)
+			break;
+
+		/* Requests complete in the order they were queued */
+		while (tx_completed == ndone)
+			event_wait(&txn_done);
+
 		if (txn_status < 0) {
 			dprintf(INFO, "usb_write() transaction failed\n");
 			goto oops;
 		}
 
-		count += req->length;
-		_buf += req->length;
-		len -= req->length;
-
-		/* short transfer? */
-		if (req->length != xfer) break;
+		slot = ndone % USBFS_TX_QUEUE_DEPTH;
+		count += tx_req[slot]->length;
+		ndone++;
 	}
 
 	return count;
 
 oops:
+	if (ndone < nqueued)
+		udc_request_cancel(in, tx_req[ndone % USBFS_TX_QUEUE_DEPTH]);
 	fastboot_state = STATE_ERROR;
 	return -1;
 }
 
+static int hsusb_usb_write_start(void *buf, unsigned len)
+{
+	int r;
+
+	ASSERT(len <= FASTBOOT_STREAM_CHUNK);
+
+	if (fastboot_state == STATE_ERROR)
+		goto oops;
+
+	arch_clean_invalidate_cache_range((addr_t)buf, ROUNDUP(len, CACHE_LINE));
+
+	req->buf = (unsigned char *)PA((addr_t)buf);
+	req->length = len;
+	req->complete = req_complete;
+	r = udc_request_queue(in, req);
+	if (r < 0) {
+		dprintf(INFO, "usb_write() queue failed\n");
+		goto oops;
+	}
+	return 0;
+
+oops:
+	fastboot_state = STATE_ERROR;
+	return -1;
+}
+
+static int hsusb_usb_write_finish(void)
+{
+	event_wait(&txn_done);
+	if (txn_status < 0) {
+		dprintf(INFO, "usb_write() transaction failed\n");
+		fastboot_state = STATE_ERROR;
+		return -1;
+	}
+	return req->length;
+}
+
 void fastboot_ack(const char *code, const char *reason)
 {
 	STACKBUF_DMA_ALIGN(response, LARGE_RSP_SIZE);
@@ -425,12 +772,20 @@ void fastboot_fail(const char *reason)
 
 void fastboot_okay(const char *info)
 {
+#if MMC_SDHCI_SUPPORT
+	/* The data written by the command must be on the flash before OKAY */
+	if (mmc_flush_write_cache()) {
+		fastboot_fail("failed to flush the eMMC write cache");
+		return;
+	}
+#endif
 	fastboot_ack("OKAY", info);
 }
 
 void fastboot_stage(const void *data, unsigned sz)
 {
 	download_size = 0;
+	download_scattered = 0;
 	if (sz > download_max) {
 		fastboot_fail("data too large");
 		return;
@@ -475,7 +830,7 @@ static void cmd_getvar(const char *arg, void *data, unsigned sz)
 		return;
 	}
 
-	for (var = varlist; var; var = var->next) {
+	for (var = varhash[fastboot_hash(arg, "")]; var; var = var->hash_next) {
 		if (!strcmp(var->name, arg)) {
 			fastboot_okay(var->value);
 			return;
@@ -484,15 +839,275 @@ static void cmd_getvar(const char *arg, void *data, unsigned sz)
 	fastboot_okay("");
 }
 
-static void cmd_download(const char *arg, void *data, unsigned sz)
+void fastboot_stream_download(struct fastboot_stream *stream)
+{
+	download_stream = stream;
+}
+
+/*
+ * Receive the download straight to where stream->place() wants each part,
+ * e.g. the final load addresses of a kernel, without any copy.
+ */
+static void cmd_download_placed(struct fastboot_stream *stream, unsigned len)
+{
+	STACKBUF_DMA_ALIGN(response, MAX_RSP_SIZE);
+	unsigned offset = 0, xfer;
+	int status = 0;
+	void *buf;
+	int r;
+
+	if (stream->begin && stream->begin(stream, len) < 0)
+		return;
+
+	snprintf((char *)response, MAX_RSP_SIZE, "DATA%08x", len);
+	if (usb_if.usb_write(response, strlen((const char *)response)) < 0)
+		return;
+
+	while (offset < len) {
+		xfer = len - offset;
+		buf = NULL;
+		if (!status)
+			buf = stream->place(stream, offset, &xfer);
+
+		/* Parts must end on a packet boundary, except for the last one */
+		if (buf && (!xfer || xfer > len - offset ||
+			    (xfer < len - offset && xfer % FASTBOOT_PLACE_ALIGN))) {
+			dprintf(CRITICAL, "fastboot: invalid placement of %u bytes at %u\n",
+				xfer, offset);
+			buf = NULL;
+		}
+
+		/* After a failure the rest is still received, but discarded */
+		if (!buf) {
+			status = -1;
+			buf = download_base;
+			xfer = MIN(len - offset, ROUNDDOWN(download_max, FASTBOOT_PLACE_ALIGN));
+		}
+
+		arch_invalidate_cache_range((addr_t) buf, ROUNDUP(xfer, CACHE_LINE));
+		r = usb_if.usb_read(buf, xfer);
+		if ((r < 0) || ((unsigned) r != xfer)) {
+			fastboot_state = STATE_ERROR;
+			return;
+		}
+		offset += xfer;
+	}
+
+	stream->end(stream, status);
+}
+
+static void cmd_download_stream(struct fastboot_stream *stream, unsigned len)
+{
+	STACKBUF_DMA_ALIGN(response, MAX_RSP_SIZE);
+	const unsigned chunk = FASTBOOT_STREAM_CHUNK;
+	unsigned char *buf[2] = { download_base, download_base + chunk };
+	unsigned cur = 0;
+	unsigned xfer, next;
+	int status = 0;
+	int r;
+
+	if (stream->place) {
+		cmd_download_placed(stream, len);
+		return;
+	}
+
+	if (download_max < 2 * chunk) {
+		fastboot_fail("download buffer too small");
+		return;
+	}
+
+	if (stream->begin && stream->begin(stream, len) < 0)
+		return;
+
+	snprintf((char *)response, MAX_RSP_SIZE, "DATA%08x", len);
+	if (usb_if.usb_write(response, strlen((const char *)response)) < 0)
+		return;
+
+	/* Discard the cache contents before starting the download */
+	arch_invalidate_cache_range((addr_t) download_base, 2 * chunk);
+
+	xfer = MIN(len, chunk);
+	if (xfer && usb_if.usb_read_start(buf[cur], xfer) < 0)
+		return;
+
+	while (len) {
+		r = usb_if.usb_read_finish();
+		if ((r < 0) || ((unsigned) r != xfer)) {
+			fastboot_state = STATE_ERROR;
+			return;
+		}
+		len -= xfer;
+
+		/* Receive the next chunk into the other half while this one is written */
+		next = MIN(len, chunk);
+		if (next && usb_if.usb_read_start(buf[cur ^ 1], next) < 0)
+			return;
+
+		/* After a failure the rest is still received, but discarded */
+		if (!status)
+			status = stream->write(stream, buf[cur], xfer);
+
+		cur ^= 1;
+		xfer = next;
+	}
+
+	stream->end(stream, status);
+}
+
+static void download_set_sha256(const uint8_t *digest)
+{
+	unsigned i;
+
+	for (i = 0; i < SHA256_INIT_VECTOR_SIZE * sizeof(uint32_t); i++)
+		snprintf(download_sha256 + 2 * i, 3, "%02x", digest[i]);
+}
+
+/*
+ * Receive the download in chunks and hash each chunk with the crypto engine
+ * while the next one is received, so the digest is ready as soon as the
+ * data is complete. The chunks are a multiple of the SHA block size.
+ */
+static int cmd_download_hashed(unsigned len)
+{
+	const unsigned chunk = FASTBOOT_STREAM_CHUNK;
+	uint8_t digest[SHA256_INIT_VECTOR_SIZE * sizeof(uint32_t)];
+	unsigned char *buf = download_base;
+	crypto_hash_ctx ctx;
+	unsigned xfer, next;
+	bool ok;
+	int r;
+
+	ok = (hash_init(&ctx, CRYPTO_AUTH_ALG_SHA256) == CRYPTO_SHA_ERR_NONE);
+
+	xfer = MIN(len, chunk);
+	if (usb_if.usb_read_start(buf, xfer) < 0)
+		return -1;
+
+	while (len) {
+		r = usb_if.usb_read_finish();
+		if ((r < 0) || ((unsigned) r != xfer)) {
+			fastboot_state = STATE_ERROR;
+			return -1;
+		}
+		len -= xfer;
+
+		next = MIN(len, chunk);
+		if (next && usb_if.usb_read_start(buf + xfer, next) < 0)
+			return -1;
+
+		if (ok && next)
+			ok = (hash_update(&ctx, buf, xfer) == CRYPTO_SHA_ERR_NONE);
+		else if (ok)
+			ok = (hash_final(&ctx, buf, xfer, digest) == CRYPTO_SHA_ERR_NONE);
+
+		buf += xfer;
+		xfer = next;
+	}
+
+	if (ok)
+		download_set_sha256(digest);
+	return 0;
+}
+
+void fastboot_add_download_region(void *base, unsigned size)
+{
+	if (download_nregions == FASTBOOT_DOWNLOAD_REGIONS) {
+		dprintf(INFO, "fastboot: ignoring download region %p\n", base);
+		return;
+	}
+
+	download_regions[download_nregions].base = base;
+	download_regions[download_nregions].size = ROUNDDOWN(size, 4096);
+	download_nregions++;
+}
+
+unsigned fastboot_download_scattered(const struct fastboot_region **regions,
+				     unsigned *count)
+{
+	*regions = download_regions;
+	*count = download_nregions;
+	return download_scattered;
+}
+
+/*
+ * The regions are hashed in place once the download is complete, they are
+ * not contiguous and the download buffer is too small to copy them.
+ */
+static void download_hash_scattered(unsigned len, unsigned count)
+{
+	uint8_t digest[SHA256_INIT_VECTOR_SIZE * sizeof(uint32_t)];
+	struct crypto_sg sg[FASTBOOT_DOWNLOAD_REGIONS];
+	unsigned i;
+
+	for (i = 0; i < count; i++) {
+		sg[i].addr = download_regions[i].base;
+		sg[i].len = MIN(len, download_regions[i].size);
+		len -= sg[i].len;
+	}
+
+	if (hash_find_sg(sg, count, digest, CRYPTO_AUTH_ALG_SHA256) != CRYPTO_SHA_ERR_NONE) {
+		fastboot_info("failed to hash download");
+		return;
+	}
+	download_set_sha256(digest);
+}
+
+/* Receive a download that does not fit into the download buffer */
+static void cmd_download_scattered(unsigned len)
+{
+	STACKBUF_DMA_ALIGN(response, MAX_RSP_SIZE);
+	unsigned long long max = 0;
+	unsigned left = len, xfer, i;
+	int r;
+
+	for (i = 0; i < download_nregions; i++)
+		max += download_regions[i].size;
+	if (len > max) {
+		fastboot_fail("data too large");
+		return;
+	}
+
+	snprintf((char *)response, MAX_RSP_SIZE, "DATA%08x", len);
+	if (usb_if.usb_write(response, strlen((const char *)response)) < 0)
+		return;
+
+	for (i = 0; left; i++) {
+		xfer = MIN(left, download_regions[i].size);
+		arch_invalidate_cache_range((addr_t) download_regions[i].base,
+					    ROUNDUP(xfer, CACHE_LINE));
+
+		r = usb_if.usb_read(download_regions[i].base, xfer);
+		if ((r < 0) || ((unsigned) r != xfer)) {
+			fastboot_state = STATE_ERROR;
+			return;
+		}
+		left -= xfer;
+	}
+
+	if (download_hash)
+		download_hash_scattered(len, i);
+	download_scattered = len;
+	fastboot_okay("");
+}
+
+static void cmd_download_data(const char *arg)
 {
 	STACKBUF_DMA_ALIGN(response, MAX_RSP_SIZE);
 	unsigned len = hex2unsigned(arg);
+	struct fastboot_stream *stream = download_stream;
 	int r;
 
 	download_size = 0;
+	download_scattered = 0;
+	if (stream) {
+		download_stream = NULL;
+		cmd_download_stream(stream, len);
+		return;
+	}
+
+	download_sha256[0] = 0;
 	if (len > download_max) {
-		fastboot_fail("data too large");
+		cmd_download_scattered(len);
 		return;
 	}
 
@@ -504,15 +1119,36 @@ static void cmd_download(const char *arg, void *data, unsigned sz)
 	 */
 	arch_invalidate_cache_range((addr_t) download_base, ROUNDUP(len, CACHE_LINE));
 
-	r = usb_if.usb_read(download_base, len);
-	if ((r < 0) || ((unsigned) r != len)) {
-		fastboot_state = STATE_ERROR;
-		return;
+	if (download_hash && len) {
+		if (cmd_download_hashed(len) < 0)
+			return;
+		if (!download_sha256[0])
+			fastboot_info("failed to hash download");
+	} else {
+		r = usb_if.usb_read(download_base, len);
+		if ((r < 0) || ((unsigned) r != len)) {
+			fastboot_state = STATE_ERROR;
+			return;
+		}
 	}
 	download_size = len;
 	fastboot_okay("");
 }
 
+static void cmd_download(const char *arg, void *data, unsigned sz)
+{
+	/* USB DMA and the writes of streamed images need the bandwidth */
+	rpm_bw_request();
+	cmd_download_data(arg);
+	rpm_bw_release();
+}
+
+void fastboot_download_hash(bool enable)
+{
+	download_hash = enable;
+	download_sha256[0] = 0;
+}
+
 void fastboot_write_data(void *data, unsigned sz)
 {
 	STACKBUF_DMA_ALIGN(response, MAX_RSP_SIZE);
@@ -530,8 +1166,104 @@ void fastboot_write_data(void *data, unsigned sz)
 	fastboot_okay("");
 }
 
+void fastboot_write_data_stream(struct fastboot_stream *stream, unsigned len)
+{
+	STACKBUF_DMA_ALIGN(response, MAX_RSP_SIZE);
+	const unsigned chunk = FASTBOOT_STREAM_CHUNK;
+	unsigned char *buf[2] = { download_base, download_base + chunk };
+	unsigned cur = 0;
+	unsigned xfer, pending = 0;
+	void *data;
+	int status = 0;
+	int r;
+
+	download_size = 0;
+	download_scattered = 0;
+	if (download_max < 2 * chunk) {
+		fastboot_fail("download buffer too small");
+		return;
+	}
+
+	if (stream->begin && stream->begin(stream, len) < 0)
+		return;
+
+	snprintf((char *)response, MAX_RSP_SIZE, "DATA%08x", len);
+	if (usb_if.usb_write(response, strlen((const char *)response)) < 0)
+		return;
+
+	while (len) {
+		xfer = MIN(len, chunk);
+		data = buf[cur];
+
+		/* Produce the next chunk while the previous one is sent */
+		if (!status && stream->peek) {
+			data = stream->peek(stream, &xfer);
+			if (!data) {
+				status = -1;
+				data = buf[cur];
+			}
+		} else if (!status) {
+			status = stream->read(stream, buf[cur], xfer);
+		}
+
+		/* The host waits for all data, send zeros after a failure */
+		if (status)
+			memset(data, 0, xfer);
+
+		if (pending) {
+			r = usb_if.usb_write_finish();
+			if ((r < 0) || ((unsigned) r != pending)) {
+				fastboot_state = STATE_ERROR;
+				return;
+			}
+		}
+
+		if (usb_if.usb_write_start(data, xfer) < 0)
+			return;
+
+		pending = xfer;
+		len -= xfer;
+		cur ^= 1;
+	}
+
+	if (pending) {
+		r = usb_if.usb_write_finish();
+		if ((r < 0) || ((unsigned) r != pending)) {
+			fastboot_state = STATE_ERROR;
+			return;
+		}
+	}
+
+	stream->end(stream, status);
+}
+
+static void fastboot_stream_drop(struct fastboot_stream **pending)
+{
+	struct fastboot_stream *stream = *pending;
+
+	*pending = NULL;
+	if (stream && stream->cancel)
+		stream->cancel(stream);
+}
+
+void fastboot_stream_upload(struct fastboot_stream *stream, unsigned len)
+{
+	if (upload_stream != stream)
+		fastboot_stream_drop(&upload_stream);
+	upload_stream = stream;
+	upload_stream_len = len;
+}
+
 static void cmd_upload(const char *arg, void *data, unsigned sz)
 {
+	struct fastboot_stream *stream = upload_stream;
+
+	if (stream) {
+		upload_stream = NULL;
+		fastboot_write_data_stream(stream, upload_stream_len);
+		return;
+	}
+
 	if (!sz) {
 		fastboot_fail("no data staged");
 		return;
@@ -603,7 +1335,8 @@ again:
 
 		fastboot_state = STATE_COMMAND;
 
-		for (cmd = cmdlist; cmd; cmd = cmd->next) {
+		cmd = cmdhash[fastboot_hash((const char *)buffer, " :")];
+		for (; cmd; cmd = cmd->hash_next) {
 			const char *arg = (const char*)&buffer[cmd->prefix_len];
 
 			/* Check if command prefix matches */
@@ -621,6 +1354,12 @@ again:
 			else if (arg[0] && arg[-1] != ':')
 				continue;
 
+			/* A streamed transfer must immediately follow its setup */
+			if (cmd->handle != cmd_download)
+				fastboot_stream_drop(&download_stream);
+			if (cmd->handle != cmd_upload)
+				fastboot_stream_drop(&upload_stream);
+
 			cmd->handle(arg, download_base, download_size);
 			if (fastboot_state == STATE_COMMAND)
 				fastboot_fail("unknown reason");
@@ -649,6 +1388,9 @@ again:
 
 static int fastboot_handler(void *arg)
 {
+	/* The host may already send commands, they wait until fastboot_init() */
+	event_wait(&fastboot_ready);
+
 	for (;;) {
 		event_wait(&usb_online);
 		fastboot_command_loop();
@@ -663,15 +1405,15 @@ static void fastboot_notify(struct udc_gadget *gadget, unsigned event)
 	}
 }
 
-int fastboot_init(void *base, unsigned size)
+/* Set up the USB controller and let the host enumerate the device */
+static int fastboot_usb_init(void)
 {
 	extern char sn_buf[MAX_RSP_SIZE];
 	char serialno[MAX_RSP_SIZE] = "";
 	thread_t *thr;
-	dprintf(INFO, "fastboot_init()\n");
+	unsigned i;
 
-	download_base = base;
-	download_max = size;
+	event_init(&fastboot_ready, 0, 0);
 
 	/* target specific initialization before going into fastboot. */
 	target_fastboot_init();
@@ -701,6 +1443,10 @@ int fastboot_init(void *base, unsigned size)
 
 		usb_if.usb_read            = usb30_usb_read;
 		usb_if.usb_write           = usb30_usb_write;
+		usb_if.usb_read_start      = usb30_usb_read_start;
+		usb_if.usb_read_finish     = usb30_usb_read_finish;
+		usb_if.usb_write_start     = usb30_usb_write_start;
+		usb_if.usb_write_finish    = usb30_usb_write_finish;
 #else
 		dprintf(CRITICAL, "USB30 needs to be enabled for this target.\n");
 		ASSERT(0);
@@ -720,6 +1466,10 @@ int fastboot_init(void *base, unsigned size)
 
 		usb_if.usb_read            = hsusb_usb_read;
 		usb_if.usb_write           = hsusb_usb_write;
+		usb_if.usb_read_start      = hsusb_usb_read_start;
+		usb_if.usb_read_finish     = hsusb_usb_read_finish;
+		usb_if.usb_write_start     = hsusb_usb_write_start;
+		usb_if.usb_write_finish    = hsusb_usb_write_finish;
 	}
 
 	/* register udc device */
@@ -742,6 +1492,19 @@ int fastboot_init(void *base, unsigned size)
 	if (!req)
 		goto fail_alloc_req;
 
+	if (usb_if.usb_read == hsusb_usb_read) {
+		for (i = 0; i < USBFS_RX_QUEUE_DEPTH; i++) {
+			rx_req[i] = usb_if.udc_request_alloc();
+			if (!rx_req[i])
+				goto fail_alloc_rx;
+		}
+		for (i = 0; i < USBFS_TX_QUEUE_DEPTH; i++) {
+			tx_req[i] = usb_if.udc_request_alloc();
+			if (!tx_req[i])
+				goto fail_alloc_rx;
+		}
+	}
+
 	/* register gadget */
 	if (usb_if.udc_register_gadget(&fastboot_gadget))
 		goto fail_udc_register;
@@ -753,6 +1516,7 @@ int fastboot_init(void *base, unsigned size)
 	fastboot_register("download:", cmd_download);
 	fastboot_register("upload", cmd_upload);
 	fastboot_publish("version", "0.5");
+	fastboot_publish("download-sha256", download_sha256);
 
 	thr = thread_create("fastboot", fastboot_handler, 0, DEFAULT_PRIORITY, DEFAULT_STACK_SIZE);
 	if (!thr)
@@ -766,6 +1530,17 @@ int fastboot_init(void *base, unsigned size)
 	return 0;
 
 fail_udc_register:
+fail_alloc_rx:
+	for (i = 0; i < USBFS_RX_QUEUE_DEPTH; i++) {
+		if (rx_req[i])
+			usb_if.udc_request_free(rx_req[i]);
+		rx_req[i] = NULL;
+	}
+	for (i = 0; i < USBFS_TX_QUEUE_DEPTH; i++) {
+		if (tx_req[i])
+			usb_if.udc_request_free(tx_req[i]);
+		tx_req[i] = NULL;
+	}
 	usb_if.udc_request_free(req);
 fail_alloc_req:
 	usb_if.udc_endpoint_free(out);
@@ -775,6 +1550,34 @@ fail_alloc_in:
 	return -1;
 }
 
+int fastboot_init_early(void)
+{
+	dprintf(INFO, "fastboot_init_early()\n");
+
+	fastboot_started = true;
+	return fastboot_usb_init();
+}
+
+int fastboot_init(void *base, unsigned size)
+{
+	int ret;
+
+	dprintf(INFO, "fastboot_init()\n");
+
+	download_base = base;
+	download_max = size;
+
+	if (!fastboot_started) {
+		fastboot_started = true;
+		ret = fastboot_usb_init();
+		if (ret)
+			return ret;
+	}
+
+	event_signal(&fastboot_ready, true);
+	return 0;
+}
+
 void fastboot_stop(void)
 {
 	usb_if.udc_stop();
@@ -31,11 +31,15 @@
 #ifndef __APP_FASTBOOT_H
 #define __APP_FASTBOOT_H
 
+#include <sys/types.h>
+
 #define MAX_RSP_SIZE            64
 #define LARGE_RSP_SIZE          256
 #define MAX_GET_VAR_NAME_SIZE   256
 
 int fastboot_init(void *xfer_buffer, unsigned max);
+/* let the host enumerate the device, commands wait for fastboot_init() */
+int fastboot_init_early(void);
 void fastboot_stop(void);
 
 /* register a command handler
@@ -56,6 +60,65 @@ void fastboot_info(const char *reason);
 void fastboot_stage(const void *data, unsigned sz);
 void fastboot_write_data(void *data, unsigned sz);
 
+/* data transferred in chunks, not staged in the download buffer */
+struct fastboot_stream {
+	/* optional, before the data phase: may fastboot_fail() and return < 0 */
+	int (*begin)(struct fastboot_stream *stream, unsigned len);
+	/* download: for every chunk in order, return < 0 to discard the remaining data */
+	int (*write)(struct fastboot_stream *stream, void *data, unsigned len);
+	/*
+	 * download: optional instead of write, return a cache line aligned
+	 * buffer that receives the data at offset directly, up to *len bytes
+	 * (may be lowered, but only to a multiple of FASTBOOT_PLACE_ALIGN).
+	 * Return NULL to discard the rest.
+	 */
+	void *(*place)(struct fastboot_stream *stream, unsigned offset, unsigned *len);
+	/* upload: fill data with the next len bytes, return < 0 on failure */
+	int (*read)(struct fastboot_stream *stream, void *data, unsigned len);
+	/*
+	 * upload: optional instead of read, return the next bytes in place, up
+	 * to *len bytes (may be lowered, but only to a multiple of
+	 * FASTBOOT_PLACE_ALIGN). They are sent while the following ones are
+	 * produced, so they must stay unchanged until then. NULL on failure.
+	 */
+	void *(*peek)(struct fastboot_stream *stream, unsigned *len);
+	/* after the data phase: replies with fastboot_okay() or fastboot_fail() */
+	void (*end)(struct fastboot_stream *stream, int status);
+	/*
+	 * optional: dropped without a data phase, e.g. because another command
+	 * came first. Releases what the setup allocated, no reply.
+	 */
+	void (*cancel)(struct fastboot_stream *stream);
+};
+
+#define FASTBOOT_PLACE_ALIGN	2048
+
+/* hand the data of the following download command to stream */
+void fastboot_stream_download(struct fastboot_stream *stream);
+/* have the following upload command send len bytes produced by stream */
+void fastboot_stream_upload(struct fastboot_stream *stream, unsigned len);
+/* like fastboot_write_data(), but len bytes are produced by stream */
+void fastboot_write_data_stream(struct fastboot_stream *stream, unsigned len);
+
+/* compute the SHA-256 of every download while it is received (getvar download-sha256) */
+void fastboot_download_hash(bool enable);
+
+/* memory for downloads that do not fit into the download buffer */
+struct fastboot_region {
+	void *base;
+	unsigned size;
+};
+
+/* add a region for downloads that are larger than the download buffer */
+void fastboot_add_download_region(void *base, unsigned size);
+/*
+ * Returns the size of the last download if it did not fit into the download
+ * buffer, 0 otherwise. Command handlers get no data for such a download, it
+ * fills the added regions in order.
+ */
+unsigned fastboot_download_scattered(const struct fastboot_region **regions,
+				     unsigned *count);
+
 static inline void fastboot_register_commands(void)
 {
 	extern void (*__fastboot_init_start)(void);
@@ -9,7 +9,9 @@ MODULES += lib/zlib_inflate
 OBJS += \
 	$(LOCAL_DIR)/aboot.o \
 	$(LOCAL_DIR)/fastboot.o \
-	$(LOCAL_DIR)/recovery.o
+	$(LOCAL_DIR)/recovery.o \
+	$(LOCAL_DIR)/sparse.o \
+	$(LOCAL_DIR)/unpack.o
 
 ifeq ($(LK2ND_UMS), 1)
 OBJS += \
@@ -0,0 +1,435 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/*
+ * Incremental decoder for Android sparse images.
+ *
+ * The image is passed in pieces of any size, so it can be written while it is
+ * still being received. Raw data is written straight from the input, only a
+ * block that is split between two pieces goes through a bounce buffer. Fill
+ * chunks are written from a single pattern buffer that is reused for the
+ * whole image, consecutive don't care chunks are merged into one run.
+ *
+ * Large zero fills are erased instead of written if the card reads erased
+ * blocks back as zeros. Don't care runs are left alone: fastboot splits large
+ * images into several sparse images that cover the other parts with don't
+ * care chunks, so those runs must keep what is already on the card.
+ *
+ * In delta mode, data and fill patterns are read back from the card first,
+ * in pieces of SPARSE_DELTA_SIZE, and only the blocks from the first to the
+ * last one that differs are written. Reading is much faster than writing on
+ * eMMC, so reflashing a mostly unchanged image gets faster and wears the
+ * card less. Erased zero fills are not compared, the erase is cheaper.
+ */
+
+#include <debug.h>
+#include <limits.h>
+#include <malloc.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mmc.h>
+
+#include "sparse.h"
+
+/* Written per mmc_write() for fill chunks */
+#define SPARSE_FILL_BUF_SIZE	(256 * 1024)
+/* Zero fills smaller than this are cheaper to write than to erase */
+#define SPARSE_ERASE_MIN	(1024 * 1024)
+/* Read back and compared at once in delta mode */
+#define SPARSE_DELTA_SIZE	(256 * 1024)
+
+static int sparse_fail(struct sparse_writer *sw, const char *error)
+{
+	sw->error = error;
+	sw->state = SPARSE_ERROR;
+	return -1;
+}
+
+void sparse_writer_init(struct sparse_writer *sw, uint64_t ptn, uint64_t size)
+{
+	memset(sw, 0, sizeof(*sw));
+	sw->ptn = ptn;
+	sw->size = size;
+	sw->state = SPARSE_FILE_HEADER;
+}
+
+void sparse_writer_free(struct sparse_writer *sw)
+{
+	free(sw->block_buf);
+	free(sw->fill_buf);
+	free(sw->cmp_buf);
+	sw->block_buf = NULL;
+	sw->fill_buf = NULL;
+	sw->cmp_buf = NULL;
+}
+
+/* Write only the blocks of one piece that differ from the card */
+static int sparse_delta_write(struct sparse_writer *sw, const uint8_t *data, uint32_t len)
+{
+	uint32_t bs = mmc_get_device_blocksize();
+	uint32_t first, last;
+
+	if (mmc_read(sw->ptn + sw->offset, (uint32_t *)sw->cmp_buf, len))
+		return sparse_fail(sw, "flash read failure");
+
+	for (first = 0; first < len; first += bs)
+		if (memcmp(sw->cmp_buf + first, data + first, bs))
+			break;
+
+	if (first == len) {
+		sw->delta_same += len;
+		return 0;
+	}
+
+	for (last = len; last > first + bs; last -= bs)
+		if (memcmp(sw->cmp_buf + last - bs, data + last - bs, bs))
+			break;
+
+	sw->delta_same += len - (last - first);
+	if (mmc_write(sw->ptn + sw->offset + first, last - first, (void *)(data + first)))
+		return sparse_fail(sw, "flash write failure");
+
+	return 0;
+}
+
+static int sparse_mmc_write(struct sparse_writer *sw, const void *data, uint32_t len)
+{
+	uint32_t n;
+
+	if (!sw->delta) {
+		if (mmc_write(sw->ptn + sw->offset, len, (void *)data))
+			return sparse_fail(sw, "flash write failure");
+
+		sw->offset += len;
+		return 0;
+	}
+
+	if (!sw->cmp_buf) {
+		sw->cmp_buf = memalign(CACHE_LINE, SPARSE_DELTA_SIZE);
+		if (!sw->cmp_buf)
+			return sparse_fail(sw, "Malloc failed for delta flash");
+	}
+
+	while (len) {
+		n = MIN(len, SPARSE_DELTA_SIZE);
+		if (sparse_delta_write(sw, data, n))
+			return -1;
+		sw->offset += n;
+		data = (const uint8_t *)data + n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+/* Pass on the pending run of don't care blocks */
+static void sparse_flush_skip(struct sparse_writer *sw)
+{
+	if (!sw->skip_len)
+		return;
+
+	dprintf(SPEW, "Skipping 0x%llx bytes at 0x%llx\n",
+		sw->skip_len, sw->skip_start);
+	sw->skip_len = 0;
+}
+
+static void sparse_next_chunk(struct sparse_writer *sw)
+{
+	sw->hdr_len = 0;
+	if (++sw->chunk_index == sw->header.total_chunks)
+		sw->state = SPARSE_DONE;
+	else
+		sw->state = SPARSE_CHUNK_HEADER;
+}
+
+static int sparse_file_header(struct sparse_writer *sw)
+{
+	sparse_header_t *header = &sw->hdr.file;
+
+	if (header->magic != SPARSE_HEADER_MAGIC)
+		return sparse_fail(sw, "not a sparse image");
+
+	if (!header->blk_sz || (header->blk_sz % 4) ||
+	    (header->blk_sz % mmc_get_device_blocksize()))
+		return sparse_fail(sw, "Invalid block size");
+
+	if (((uint64_t)header->total_blks * (uint64_t)header->blk_sz) > sw->size)
+		return sparse_fail(sw, "size too large");
+
+	if (header->file_hdr_sz != sizeof(sparse_header_t))
+		return sparse_fail(sw, "sparse header size mismatch");
+
+	if (header->chunk_hdr_sz != sizeof(chunk_header_t))
+		return sparse_fail(sw, "chunk header size mismatch");
+
+	dprintf (SPEW, "=== Sparse Image Header ===\n");
+	dprintf (SPEW, "magic: 0x%x\n", header->magic);
+	dprintf (SPEW, "major_version: 0x%x\n", header->major_version);
+	dprintf (SPEW, "minor_version: 0x%x\n", header->minor_version);
+	dprintf (SPEW, "file_hdr_sz: %d\n", header->file_hdr_sz);
+	dprintf (SPEW, "chunk_hdr_sz: %d\n", header->chunk_hdr_sz);
+	dprintf (SPEW, "blk_sz: %d\n", header->blk_sz);
+	dprintf (SPEW, "total_blks: %d\n", header->total_blks);
+	dprintf (SPEW, "total_chunks: %d\n", header->total_chunks);
+
+	sw->header = *header;
+	sw->hdr_len = 0;
+	sw->state = header->total_chunks ? SPARSE_CHUNK_HEADER : SPARSE_DONE;
+	return 0;
+}
+
+static int sparse_chunk_header(struct sparse_writer *sw)
+{
+	chunk_header_t *chunk = &sw->hdr.chunk;
+	uint64_t chunk_data_sz = (uint64_t)sw->header.blk_sz * chunk->chunk_sz;
+	uint64_t offset = (uint64_t)sw->total_blocks * sw->header.blk_sz;
+
+	dprintf (SPEW, "=== Chunk Header ===\n");
+	dprintf (SPEW, "chunk_type: 0x%x\n", chunk->chunk_type);
+	dprintf (SPEW, "chunk_data_sz: 0x%x\n", chunk->chunk_sz);
+	dprintf (SPEW, "total_size: 0x%x\n", chunk->total_sz);
+
+	/* Make sure the total image size does not exceed the partition size */
+	if (offset + chunk_data_sz > sw->size)
+		return sparse_fail(sw, "Chunk data size exceeds partition size");
+
+	if (sw->total_blocks > (UINT_MAX - chunk->chunk_sz) ||
+	    chunk->total_sz < sizeof(chunk_header_t))
+		return sparse_fail(sw, "Bogus chunk size");
+
+	sw->chunk = *chunk;
+	sw->offset = offset;
+	sw->total_blocks += chunk->chunk_sz;
+	sw->left = chunk->total_sz - sizeof(chunk_header_t);
+	sw->hdr_len = 0;
+
+	switch (chunk->chunk_type) {
+	case CHUNK_TYPE_RAW:
+		if (sw->left != chunk_data_sz)
+			return sparse_fail(sw, "Bogus chunk size for chunk type Raw");
+		sparse_flush_skip(sw);
+		sw->state = SPARSE_RAW;
+		break;
+
+	case CHUNK_TYPE_FILL:
+		if (sw->left != sizeof(uint32_t))
+			return sparse_fail(sw, "Bogus chunk size for chunk type FILL");
+		sparse_flush_skip(sw);
+		sw->state = SPARSE_FILL;
+		break;
+
+	case CHUNK_TYPE_CRC32:
+		if (sw->left != 0 && sw->left != sizeof(uint32_t))
+			return sparse_fail(sw, "Bogus chunk size for chunk type CRC");
+		/* fallthrough */
+	case CHUNK_TYPE_DONT_CARE:
+		if (!sw->skip_len)
+			sw->skip_start = offset;
+		sw->skip_len += chunk_data_sz;
+		sw->state = SPARSE_SKIP;
+		break;
+
+	default:
+		dprintf(CRITICAL, "Unkown chunk type: %x\n", chunk->chunk_type);
+		return sparse_fail(sw, "Unknown chunk type");
+	}
+
+	if (!sw->left)
+		sparse_next_chunk(sw);
+	return 0;
+}
+
+static int sparse_write_raw(struct sparse_writer *sw, const uint8_t *data, uint32_t len)
+{
+	uint32_t blk_sz = sw->header.blk_sz;
+	uint32_t n;
+
+	/* Complete the block started by the previous piece */
+	if (sw->block_len) {
+		n = MIN(len, blk_sz - sw->block_len);
+		memcpy(sw->block_buf + sw->block_len, data, n);
+		sw->block_len += n;
+		data += n;
+		len -= n;
+
+		if (sw->block_len < blk_sz)
+			return 0;
+		if (sparse_mmc_write(sw, sw->block_buf, blk_sz))
+			return -1;
+		sw->block_len = 0;
+	}
+
+	n = len - len % blk_sz;
+	if (n && sparse_mmc_write(sw, data, n))
+		return -1;
+
+	/* Keep the start of a block that continues in the next piece */
+	if (len > n) {
+		if (!sw->block_buf) {
+			sw->block_buf = memalign(CACHE_LINE, ROUNDUP(blk_sz, CACHE_LINE));
+			if (!sw->block_buf)
+				return sparse_fail(sw, "Malloc failed for: CHUNK_TYPE_RAW");
+		}
+		memcpy(sw->block_buf, data + n, len - n);
+		sw->block_len = len - n;
+	}
+
+	return 0;
+}
+
+static int sparse_write_pattern(struct sparse_writer *sw, uint32_t fill_val, uint64_t len)
+{
+	uint32_t blk_sz = sw->header.blk_sz;
+	uint32_t n, i;
+
+	if (!sw->fill_buf) {
+		sw->fill_size = MAX(SPARSE_FILL_BUF_SIZE - SPARSE_FILL_BUF_SIZE % blk_sz, blk_sz);
+		sw->fill_buf = memalign(CACHE_LINE, ROUNDUP(sw->fill_size, CACHE_LINE));
+		if (!sw->fill_buf)
+			return sparse_fail(sw, "Malloc failed for: CHUNK_TYPE_FILL");
+	}
+
+	if (!sw->fill_valid || sw->fill_val != fill_val) {
+		for (i = 0; i < sw->fill_size / sizeof(fill_val); i++)
+			sw->fill_buf[i] = fill_val;
+		sw->fill_val = fill_val;
+		sw->fill_valid = true;
+	}
+
+	while (len) {
+		n = MIN(len, sw->fill_size);
+		if (sparse_mmc_write(sw, sw->fill_buf, n))
+			return -1;
+		len -= n;
+	}
+
+	return 0;
+}
+
+/* Erase the aligned middle of a zero fill, only the edges are written */
+static int sparse_write_zero(struct sparse_writer *sw, uint64_t len)
+{
+	uint64_t unit = mmc_get_zero_erase_size();
+	uint64_t start = sw->ptn + sw->offset;
+	uint64_t head, body;
+
+	if (!unit || len < MAX(unit, SPARSE_ERASE_MIN))
+		return sparse_write_pattern(sw, 0, len);
+
+	head = MIN((unit - start % unit) % unit, len);
+	body = (len - head) - (len - head) % unit;
+	if (!body)
+		return sparse_write_pattern(sw, 0, len);
+
+	if (head && sparse_write_pattern(sw, 0, head))
+		return -1;
+
+	if (mmc_zero_erase(start + head, body)) {
+		dprintf(INFO, "Failed to erase 0x%llx bytes, writing zeros\n", body);
+		if (sparse_write_pattern(sw, 0, body))
+			return -1;
+	} else {
+		sw->offset += body;
+	}
+
+	return sparse_write_pattern(sw, 0, len - head - body);
+}
+
+static int sparse_write_fill(struct sparse_writer *sw, uint32_t fill_val)
+{
+	uint64_t len = (uint64_t)sw->chunk.chunk_sz * sw->header.blk_sz;
+
+	if (fill_val == 0)
+		return sparse_write_zero(sw, len);
+
+	return sparse_write_pattern(sw, fill_val, len);
+}
+
+/* Collect up to size bytes of a header in sw->hdr, returns the bytes used */
+static unsigned sparse_collect(struct sparse_writer *sw, const uint8_t *data,
+			       unsigned len, unsigned size)
+{
+	unsigned n = MIN(len, size - sw->hdr_len);
+
+	memcpy(sw->hdr.bytes + sw->hdr_len, data, n);
+	sw->hdr_len += n;
+	return n;
+}
+
+int sparse_writer_write(struct sparse_writer *sw, const void *_data, unsigned len)
+{
+	const uint8_t *data = _data;
+	unsigned n;
+
+	while (len) {
+		switch (sw->state) {
+		case SPARSE_FILE_HEADER:
+			n = sparse_collect(sw, data, len, sizeof(sparse_header_t));
+			if (sw->hdr_len == sizeof(sparse_header_t) && sparse_file_header(sw))
+				return -1;
+			break;
+
+		case SPARSE_CHUNK_HEADER:
+			n = sparse_collect(sw, data, len, sizeof(chunk_header_t));
+			if (sw->hdr_len == sizeof(chunk_header_t) && sparse_chunk_header(sw))
+				return -1;
+			break;
+
+		case SPARSE_RAW:
+			n = MIN(len, sw->left);
+			if (sparse_write_raw(sw, data, n))
+				return -1;
+			sw->left -= n;
+			if (!sw->left)
+				sparse_next_chunk(sw);
+			break;
+
+		case SPARSE_FILL:
+			n = sparse_collect(sw, data, len, sizeof(uint32_t));
+			if (sw->hdr_len < sizeof(uint32_t))
+				break;
+			if (sparse_write_fill(sw, sw->hdr.fill_val))
+				return -1;
+			sparse_next_chunk(sw);
+			break;
+
+		case SPARSE_SKIP:
+			n = MIN(len, sw->left);
+			sw->left -= n;
+			if (!sw->left)
+				sparse_next_chunk(sw);
+			break;
+
+		case SPARSE_DONE:
+			/* Anything after the last chunk is ignored */
+			return 0;
+
+		default:
+			return -1;
+		}
+
+		data += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+int sparse_writer_finish(struct sparse_writer *sw)
+{
+	if (sw->state == SPARSE_ERROR)
+		return -1;
+	if (sw->state != SPARSE_DONE)
+		return sparse_fail(sw, "buffer overreads occured due to invalid sparse header");
+
+	sparse_flush_skip(sw);
+
+	dprintf(INFO, "Wrote %d blocks, expected to write %d blocks\n",
+		sw->total_blocks, sw->header.total_blks);
+	if (sw->delta)
+		dprintf(INFO, "Delta flash: 0x%llx bytes already matched\n",
+			sw->delta_same);
+
+	if (sw->total_blocks != sw->header.total_blks)
+		return sparse_fail(sw, "sparse image write failure");
+
+	return 0;
+}
@@ -0,0 +1,86 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+#ifndef __APP_SPARSE_H
+#define __APP_SPARSE_H
+
+#include <sys/types.h>
+#include "sparse_format.h"
+
+enum sparse_state {
+	SPARSE_FILE_HEADER,
+	SPARSE_CHUNK_HEADER,
+	SPARSE_RAW,
+	SPARSE_FILL,
+	SPARSE_SKIP,
+	SPARSE_DONE,
+	SPARSE_ERROR,
+};
+
+struct sparse_writer {
+	/* output partition, byte offset and size on the card */
+	uint64_t ptn;
+	uint64_t size;
+
+	enum sparse_state state;
+	const char *error;
+
+	/* header being collected, may be split between two pieces */
+	union {
+		sparse_header_t file;
+		chunk_header_t chunk;
+		uint32_t fill_val;
+		uint8_t bytes[sizeof(sparse_header_t)];
+	} hdr;
+	unsigned hdr_len;
+
+	sparse_header_t header;
+	chunk_header_t chunk;
+	uint32_t chunk_index;
+	uint32_t total_blocks;
+
+	/* output offset of the next write, relative to ptn */
+	uint64_t offset;
+
+	/* input bytes left in the current chunk */
+	uint32_t left;
+
+	/* raw data of a block split between two pieces */
+	uint8_t *block_buf;
+	uint32_t block_len;
+
+	/* pattern of the last fill chunk, reused while the value is the same */
+	uint32_t *fill_buf;
+	uint32_t fill_size;
+	uint32_t fill_val;
+	bool fill_valid;
+
+	/* run of consecutive don't care chunks not passed on yet */
+	uint64_t skip_start;
+	uint64_t skip_len;
+
+	/* delta mode: only write the blocks that differ from the card */
+	bool delta;
+	uint8_t *cmp_buf;
+	uint64_t delta_same;
+};
+
+static inline bool sparse_is_image(const void *data, unsigned len)
+{
+	return len >= sizeof(uint32_t) &&
+	       ((const sparse_header_t *)data)->magic == SPARSE_HEADER_MAGIC;
+}
+
+/*
+ * Decode a sparse image into the area at ptn (in bytes) of size bytes.
+ * The image is passed through sparse_writer_write() in pieces of any size,
+ * in order. All functions return a negative value on error with a reason in
+ * sw->error, the writer must be released with sparse_writer_free() anyway.
+ * Set sw->delta after sparse_writer_init() to compare the data with what is
+ * already on the card first and skip the blocks that match.
+ */
+void sparse_writer_init(struct sparse_writer *sw, uint64_t ptn, uint64_t size);
+int sparse_writer_write(struct sparse_writer *sw, const void *data, unsigned len);
+int sparse_writer_finish(struct sparse_writer *sw);
+void sparse_writer_free(struct sparse_writer *sw);
+
+#endif /* __APP_SPARSE_H */
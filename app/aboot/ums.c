@@ -22,6 +22,7 @@
  */
 
 #include <debug.h>
+#include <err.h>
 #include <sys/types.h>
 #include <list.h>
 #include <string.h>
@@ -39,25 +40,61 @@
 #include <usb30_udc.h>
 #endif
 #include <lib/bio.h>
+#if WITH_LIB_FS
+#include <lib/fs.h>
+#endif
 #include <lib/partition.h>
 #include <platform/timer.h>
+#include <rpm-ipc.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <lk2nd/util/highmem.h>
+#include "fastboot.h"
 #include "ums.h"
+#if MMC_SDHCI_SUPPORT
+#include <mmc.h>
+#endif
 
 /* Fallback for CACHE_LINE if not defined */
 #ifndef CACHE_LINE
 #define CACHE_LINE 64
 #endif
 
-/* Global UMS device state */
-static struct ums_device g_ums_device = {0};
-static struct udc_endpoint *ums_endpoints[2];
+/*
+ * One LUN per exported block device. Commands operate on ums_cur, which
+ * is selected from the LUN field of each CBW / Command IU. All LUNs share
+ * the transfer buffer, so only one command is processed at a time.
+ */
+static struct ums_device ums_luns[UMS_MAX_LUNS];
+static unsigned ums_num_luns = 0;
+static struct ums_device *ums_cur = &ums_luns[0];
+static void *ums_transfer_buffer = NULL;
+static struct udc_endpoint *ums_endpoints[4];
 static struct udc_request *ums_req_in = NULL;
 static struct udc_request *ums_req_out = NULL;
 static event_t ums_online;
 static event_t ums_txn_done;
 static bool ums_active = false;
 
+/*
+ * USB Attached SCSI: the data pipes reuse the BOT endpoints, the status
+ * and command pipes get their own endpoints and requests. Only supported
+ * on the hsusb controller, since the DWC3 driver cannot do the streams
+ * that hosts require for UAS at SuperSpeed.
+ */
+static bool ums_uas = false;
+static struct udc_request *ums_req_status = NULL;
+static struct udc_request *ums_req_cmd = NULL;
+static event_t ums_status_done;
+static event_t ums_cmd_done;
+static unsigned ums_cmd_length;
+static uint16_t ums_uas_tag;
+static bool ums_uas_ready_sent;
+
+static const unsigned char ums_uas_pipes[] = {
+    UAS_PIPE_DATA_IN, UAS_PIPE_DATA_OUT, UAS_PIPE_STATUS, UAS_PIPE_COMMAND,
+};
+
 /* Controller-specific transfer limit */
 static bool ums_is_dwc = false;
 static unsigned ums_max_usb_xfer = UMS_HSUSB_MAX_XFER;
@@ -65,6 +102,47 @@ static unsigned ums_max_usb_xfer = UMS_HSUSB_MAX_XFER;
 /* Actual transfer buffer size (set at init time) */
 static unsigned ums_buffer_size = 0;
 
+/*
+ * Optional write-back cache in the RAM above the scratch region if there is
+ * any, otherwise after the transfer buffer in the scratch region. It holds
+ * one extent of consecutive dirty blocks, so small adjacent WRITE(10)s are
+ * merged into one larger bio_write(). It is flushed on SYNCHRONIZE CACHE,
+ * when the host is idle, on exit and when a different LUN is written.
+ */
+#define UMS_WCACHE_SIZE     (4 * 1024 * 1024)
+/* Limits how long a flush takes, hosts may time out SYNCHRONIZE CACHE */
+#define UMS_WCACHE_HIGHMEM_SIZE (32 * 1024 * 1024)
+#define UMS_WCACHE_IDLE_MS  1000
+
+static struct {
+    uint8_t *buf;
+    unsigned size;      /* bytes, 0 if disabled */
+    struct ums_device *lun;  /* LUN the dirty blocks belong to */
+    uint64_t lba;
+    uint32_t blocks;    /* dirty blocks starting at lba, 0 if empty */
+} ums_wcache;
+
+/*
+ * Small read cache in the scratch region after the write cache. Hosts read
+ * the same few blocks again and again while probing a device (partition
+ * tables, superblocks, the last blocks), so small READs are served from
+ * aligned slots that are replaced least recently used first. Slots are
+ * dropped when a WRITE or UNMAP overlaps them.
+ */
+#define UMS_RCACHE_SLOTS        16
+#define UMS_RCACHE_SLOT_SIZE    4096
+
+static struct {
+    uint8_t *buf;       /* NULL if disabled */
+    uint32_t clock;
+    struct {
+        struct ums_device *lun;  /* NULL if unused */
+        uint64_t lba;
+        uint32_t blocks;
+        uint32_t last_used;
+    } slot[UMS_RCACHE_SLOTS];
+} ums_rcache;
+
 /* Static CBW/CSW buffers - MUST NOT be on stack as USB DMA accesses them */
 static struct cbw ums_cbw_buffer __attribute__((aligned(CACHE_LINE)));
 static struct csw ums_csw_buffer __attribute__((aligned(CACHE_LINE)));
@@ -73,6 +151,14 @@ static struct csw ums_csw_buffer __attribute__((aligned(CACHE_LINE)));
 #define UMS_SMALL_BUF_SIZE 256
 static uint8_t ums_small_buf[UMS_SMALL_BUF_SIZE] __attribute__((aligned(CACHE_LINE)));
 
+/*
+ * UAS command IUs are received alternately into two buffers, so the next
+ * command can arrive while the previous one is being processed.
+ */
+#define UMS_UAS_CMD_BUF_SIZE 64
+static uint8_t ums_uas_cmd_bufs[2][UMS_UAS_CMD_BUF_SIZE] __attribute__((aligned(CACHE_LINE)));
+static struct uas_sense_iu ums_uas_status_buffer __attribute__((aligned(CACHE_LINE)));
+
 /* Controller abstraction (hsusb vs dwc), modeled after fastboot */
 typedef struct {
     int (*udc_init)(struct udc_device *devinfo);
@@ -123,6 +209,51 @@ static void ums_req_complete(struct udc_request *req, unsigned actual, int statu
     event_signal(&ums_txn_done, 0);
 }
 
+static void ums_status_complete(struct udc_request *req, unsigned actual, int status)
+{
+    event_signal(&ums_status_done, 0);
+}
+
+static void ums_cmd_complete(struct udc_request *req, unsigned actual, int status)
+{
+    ums_cmd_length = (status < 0) ? 0 : actual;
+    event_signal(&ums_cmd_done, 0);
+}
+
+/* Send an IU on the UAS status pipe and wait until the host took it. */
+static void ums_uas_send_status(unsigned len)
+{
+    arch_clean_invalidate_cache_range((addr_t)&ums_uas_status_buffer,
+                                      ROUNDUP(sizeof(ums_uas_status_buffer), CACHE_LINE));
+
+    ums_req_status->buf = (void *)PA((addr_t)&ums_uas_status_buffer);
+    ums_req_status->length = len;
+    ums_req_status->complete = ums_status_complete;
+
+    if (usb_if.udc_request_queue(ums_endpoints[2], ums_req_status) < 0) {
+        dprintf(CRITICAL, "UMS: UAS status queue failed\n");
+        return;
+    }
+    event_wait(&ums_status_done);
+}
+
+/*
+ * Without streams the host only starts the data phase of a UAS command
+ * after a READ READY or WRITE READY IU, so send one before the first
+ * data transfer of each command.
+ */
+static void ums_uas_data_ready(uint8_t iu_id)
+{
+    if (!ums_uas || ums_uas_ready_sent)
+        return;
+
+    memset(&ums_uas_status_buffer, 0, 4);
+    ums_uas_status_buffer.iu_id = iu_id;
+    ums_uas_status_buffer.tag = ums_uas_tag;
+    ums_uas_send_status(4);
+    ums_uas_ready_sent = true;
+}
+
 /*
  * Async single-request USB primitives, used to pipeline storage I/O
  * with USB DMA. @len must not exceed ums_max_usb_xfer.
@@ -131,6 +262,7 @@ static void ums_req_complete(struct udc_request *req, unsigned actual, int statu
 /* Queue a send to the host; returns 0 on success. */
 static int ums_usb_start_write(void *buf, unsigned len)
 {
+	ums_uas_data_ready(UAS_IU_READ_READY);
 	arch_clean_invalidate_cache_range((addr_t)buf, ROUNDUP(len, CACHE_LINE));
 
 	ums_req_in->buf = (void *)PA((addr_t)buf);
@@ -154,6 +286,7 @@ static int ums_usb_finish_write(void)
 /* Queue a receive from the host; returns 0 on success. */
 static int ums_usb_start_read(void *buf, unsigned len)
 {
+	ums_uas_data_ready(UAS_IU_WRITE_READY);
 	ums_req_out->buf = (void *)PA((addr_t)buf);
 	ums_req_out->length = len;
 	ums_req_out->complete = ums_req_complete;
@@ -184,6 +317,7 @@ static struct {
 	uint64_t bytes;
 	uint64_t total_mb;
 	time_t busy_ms;
+	uint32_t last_kbps;
 } ums_stats[2]; /* 0 = read (to host), 1 = write (from host) */
 
 static void ums_stats_update(int dir, unsigned bytes, time_t busy_ms)
@@ -198,6 +332,7 @@ static void ums_stats_update(int dir, unsigned bytes, time_t busy_ms)
 	uint32_t kbps = ums_stats[dir].busy_ms ?
 		(uint32_t)(ums_stats[dir].bytes / ums_stats[dir].busy_ms) : 0;
 	ums_stats[dir].total_mb += ums_stats[dir].bytes / (1024 * 1024);
+	ums_stats[dir].last_kbps = kbps;
 
 	dprintf(INFO, "UMS: %s %llu MiB total, %u.%u MB/s\n",
 		dir ? "written" : "read", ums_stats[dir].total_mb,
@@ -220,6 +355,11 @@ static int ums_usb_write(void *buf, unsigned len)
     unsigned xfer;
     int count = 0;
 
+    if (len == 0)
+        return 0;
+
+    ums_uas_data_ready(UAS_IU_READ_READY);
+
     /* Flush entire buffer to main memory before DMA */
     arch_clean_invalidate_cache_range((addr_t)buf, ROUNDUP(len, CACHE_LINE));
 
@@ -267,9 +407,9 @@ static void ums_notify(struct udc_gadget *gadget, unsigned event)
 /* Set SCSI sense data */
 static void ums_set_sense(uint8_t key, uint8_t asc, uint8_t ascq)
 {
-    g_ums_device.sense_key = key;
-    g_ums_device.asc = asc;
-    g_ums_device.ascq = ascq;
+    ums_cur->sense_key = key;
+    ums_cur->asc = asc;
+    ums_cur->ascq = ascq;
 }
 
 /* Send Command Status Wrapper */
@@ -288,7 +428,7 @@ static int ums_scsi_test_unit_ready(struct cbw *cbw)
 {
     dprintf(SPEW, "UMS: TEST UNIT READY\n");
 
-    if (g_ums_device.is_mounted) {
+    if (ums_cur->is_mounted) {
         ums_set_sense(SCSI_SENSE_NO_SENSE, 0, 0);
         return 0;
     } else {
@@ -297,6 +437,17 @@ static int ums_scsi_test_unit_ready(struct cbw *cbw)
     }
 }
 
+/* Fill 18 bytes of fixed format sense data */
+static void ums_fill_sense(uint8_t *buf)
+{
+    memset(buf, 0, 18);
+    buf[0] = 0x70;  /* Response Code */
+    buf[2] = ums_cur->sense_key;
+    buf[7] = 10;    /* Additional Sense Length */
+    buf[12] = ums_cur->asc;
+    buf[13] = ums_cur->ascq;
+}
+
 /* SCSI REQUEST SENSE command */
 static int ums_scsi_request_sense(struct cbw *cbw)
 {
@@ -304,12 +455,7 @@ static int ums_scsi_request_sense(struct cbw *cbw)
 
     dprintf(SPEW, "UMS: REQUEST SENSE\n");
 
-    memset(ums_small_buf, 0, 18);
-    ums_small_buf[0] = 0x70;  /* Response Code */
-    ums_small_buf[2] = g_ums_device.sense_key;
-    ums_small_buf[7] = 10;    /* Additional Sense Length */
-    ums_small_buf[12] = g_ums_device.asc;
-    ums_small_buf[13] = g_ums_device.ascq;
+    ums_fill_sense(ums_small_buf);
 
     len = MIN(cbw->data_transfer_length, 18);
     ums_usb_write(ums_small_buf, len);
@@ -320,6 +466,63 @@ static int ums_scsi_request_sense(struct cbw *cbw)
     return 0;
 }
 
+static uint32_t ums_get_be32(const uint8_t *p)
+{
+    return (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static uint64_t ums_get_be64(const uint8_t *p)
+{
+    return ((uint64_t)ums_get_be32(p) << 32) | ums_get_be32(p + 4);
+}
+
+static void ums_put_be32(uint8_t *p, uint32_t val)
+{
+    p[0] = val >> 24;
+    p[1] = val >> 16;
+    p[2] = val >> 8;
+    p[3] = val;
+}
+
+/*
+ * Vital product data pages: the block limits and logical block
+ * provisioning pages tell the host that UNMAP is supported.
+ */
+static int ums_scsi_inquiry_vpd(struct cbw *cbw)
+{
+    uint8_t page = cbw->cb[2];
+    unsigned len;
+
+    memset(ums_small_buf, 0, 64);
+    ums_small_buf[1] = page;
+
+    switch (page) {
+    case 0x00:  /* Supported VPD pages */
+        ums_small_buf[3] = 3;
+        ums_small_buf[4] = 0x00;
+        ums_small_buf[5] = 0xb0;
+        ums_small_buf[6] = 0xb2;
+        break;
+    case 0xb0:  /* Block limits */
+        ums_small_buf[3] = 0x3c;
+        ums_put_be32(ums_small_buf + 20, UINT32_MAX);  /* Max unmap LBA count */
+        ums_put_be32(ums_small_buf + 24, UMS_UNMAP_MAX_DESCRIPTORS);
+        break;
+    case 0xb2:  /* Logical block provisioning */
+        ums_small_buf[3] = 4;
+        ums_small_buf[5] = 0x80;  /* LBPU */
+        break;
+    default:
+        ums_set_sense(SCSI_SENSE_ILLEGAL_REQUEST, SCSI_ASC_INVALID_FIELD_IN_CDB, 0);
+        return -1;
+    }
+
+    len = MIN(cbw->data_transfer_length, 4u + ums_small_buf[3]);
+    ums_usb_write(ums_small_buf, len);
+
+    return 0;
+}
+
 /* SCSI INQUIRY command */
 static int ums_scsi_inquiry(struct cbw *cbw)
 {
@@ -328,11 +531,14 @@ static int ums_scsi_inquiry(struct cbw *cbw)
 
     dprintf(SPEW, "UMS: INQUIRY\n");
 
+    if (cbw->cb[1] & 0x01)  /* EVPD */
+        return ums_scsi_inquiry_vpd(cbw);
+
     memset(inquiry, 0, sizeof(*inquiry));
     inquiry->peripheral_device_type = 0;  /* Direct access block device */
     inquiry->peripheral_qualifier = 0;
     inquiry->rmb = 1;  /* Removable medium */
-    inquiry->version = 4;  /* SPC-2 */
+    inquiry->version = 5;  /* SPC-3, so hosts use READ CAPACITY 16 and VPD */
     inquiry->response_data_format = 2;
     inquiry->additional_length = sizeof(*inquiry) - 5;
 
@@ -355,15 +561,16 @@ static int ums_scsi_read_capacity(struct cbw *cbw)
 
     dprintf(SPEW, "UMS: READ CAPACITY\n");
 
-    if (!g_ums_device.is_mounted) {
+    if (!ums_cur->is_mounted) {
         ums_set_sense(SCSI_SENSE_NOT_READY, SCSI_ASC_MEDIUM_NOT_PRESENT, 0);
         return -1;
     }
 
     memset(capacity, 0, sizeof(*capacity));
-    /* Convert to big-endian */
-    capacity->last_logical_block = __builtin_bswap32(g_ums_device.block_count - 1);
-    capacity->logical_block_length = __builtin_bswap32(g_ums_device.block_size);
+    /* Convert to big-endian, the host uses READ CAPACITY 16 if it overflows */
+    capacity->last_logical_block =
+        __builtin_bswap32(MIN(ums_cur->block_count - 1, UINT32_MAX));
+    capacity->logical_block_length = __builtin_bswap32(ums_cur->block_size);
 
     len = MIN(cbw->data_transfer_length, sizeof(*capacity));
     ums_usb_write(ums_small_buf, len);
@@ -371,71 +578,376 @@ static int ums_scsi_read_capacity(struct cbw *cbw)
     return 0;
 }
 
+/* SCSI READ CAPACITY 16 command (SERVICE ACTION IN) */
+static int ums_scsi_read_capacity_16(struct cbw *cbw)
+{
+    uint64_t last = ums_cur->block_count - 1;
+    unsigned len;
+
+    dprintf(SPEW, "UMS: READ CAPACITY 16\n");
+
+    if ((cbw->cb[1] & 0x1f) != 0x10) {
+        ums_set_sense(SCSI_SENSE_ILLEGAL_REQUEST, SCSI_ASC_INVALID_COMMAND, 0);
+        return -1;
+    }
+
+    if (!ums_cur->is_mounted) {
+        ums_set_sense(SCSI_SENSE_NOT_READY, SCSI_ASC_MEDIUM_NOT_PRESENT, 0);
+        return -1;
+    }
+
+    memset(ums_small_buf, 0, 32);
+    ums_put_be32(ums_small_buf, last >> 32);
+    ums_put_be32(ums_small_buf + 4, last);
+    ums_put_be32(ums_small_buf + 8, ums_cur->block_size);
+    ums_small_buf[14] = 0x80;  /* LBPME: UNMAP is supported */
+
+    len = MIN(cbw->data_transfer_length, 32);
+    ums_usb_write(ums_small_buf, len);
+
+    return 0;
+}
+
+static uint32_t ums_wcache_capacity(void)
+{
+    return ums_wcache.size / ums_cur->block_size;
+}
+
+static bool ums_wcache_overlaps(uint64_t lba, uint32_t blocks)
+{
+    return ums_wcache.blocks && ums_wcache.lun == ums_cur &&
+           lba < ums_wcache.lba + ums_wcache.blocks &&
+           ums_wcache.lba < lba + blocks;
+}
+
+/* Write the dirty extent of the write cache to storage */
+static int ums_wcache_flush(void)
+{
+    struct ums_device *lun = ums_wcache.lun;
+    int ret;
+
+    if (!ums_wcache.blocks)
+        return 0;
+
+    dprintf(SPEW, "UMS: flush write cache - LBA %llu, length %u\n",
+            ums_wcache.lba, ums_wcache.blocks);
+
+    ret = bio_write(lun->bio_dev, ums_wcache.buf,
+                    (uint64_t)ums_wcache.lba * lun->block_size,
+                    ums_wcache.blocks * lun->block_size);
+    if (ret < 0) {
+        dprintf(CRITICAL, "UMS: write cache flush failed at LBA %llu: %d\n",
+                ums_wcache.lba, ret);
+    }
+
+    ums_wcache.blocks = 0;
+    return ret < 0 ? -1 : 0;
+}
+
+/*
+ * The eMMC write cache is enabled for the session, it is flushed on
+ * SYNCHRONIZE CACHE and on exit like the write cache above.
+ */
+static int ums_emmc_cache_flush(void)
+{
+#if MMC_SDHCI_SUPPORT
+    if (mmc_flush_write_cache()) {
+        dprintf(CRITICAL, "UMS: eMMC cache flush failed\n");
+        return -1;
+    }
+#endif
+    return 0;
+}
+
+/*
+ * Receive a WRITE(10) into the write cache. It is merged with the dirty
+ * extent if it overlaps or directly follows it, otherwise the extent is
+ * flushed first.
+ */
+static int ums_wcache_write(uint64_t lba, uint32_t blocks)
+{
+    uint32_t bs = ums_cur->block_size;
+    uint32_t offset, remaining, chunk;
+    int ret;
+
+    if (ums_wcache.blocks &&
+        (ums_wcache.lun != ums_cur || lba < ums_wcache.lba || lba > ums_wcache.lba + ums_wcache.blocks ||
+         lba + blocks > ums_wcache.lba + ums_wcache_capacity())) {
+        if (ums_wcache_flush() < 0) {
+            ums_set_sense(SCSI_SENSE_MEDIUM_ERROR, 0, 0);
+            return -1;
+        }
+    }
+    if (!ums_wcache.blocks) {
+        ums_wcache.lun = ums_cur;
+        ums_wcache.lba = lba;
+    }
+
+    offset = (lba - ums_wcache.lba) * bs;
+    remaining = blocks * bs;
+    while (remaining > 0) {
+        chunk = MIN(remaining, ums_max_usb_xfer);
+        if (ums_usb_start_read(ums_wcache.buf + offset, chunk) < 0)
+            return -1;
+        ret = ums_usb_finish_read(ums_wcache.buf + offset);
+        if (ret != (int)chunk) {
+            dprintf(CRITICAL, "UMS: short usb_read at LBA %llu (%d/%u)\n",
+                    lba, ret, chunk);
+            return -1;
+        }
+        offset += chunk;
+        remaining -= chunk;
+    }
+
+    ums_wcache.blocks = MAX(ums_wcache.blocks, lba + blocks - ums_wcache.lba);
+    return 0;
+}
+
+static void ums_rcache_invalidate(uint64_t lba, uint32_t blocks)
+{
+    unsigned i;
+
+    for (i = 0; i < UMS_RCACHE_SLOTS; i++) {
+        if (ums_rcache.slot[i].lun == ums_cur &&
+            lba < ums_rcache.slot[i].lba + ums_rcache.slot[i].blocks &&
+            ums_rcache.slot[i].lba < lba + blocks)
+            ums_rcache.slot[i].lun = NULL;
+    }
+}
+
+/*
+ * Serve a READ from the read cache if it fits into one slot, filling the
+ * least recently used slot on a miss. Returns 1 if the READ was handled,
+ * 0 if it is too large and -1 on error.
+ */
+static int ums_rcache_read(uint64_t lba, uint32_t blocks)
+{
+    uint32_t bs = ums_cur->block_size;
+    uint32_t slot_blocks = UMS_RCACHE_SLOT_SIZE / bs;
+    uint64_t start;
+    unsigned i, victim = 0;
+    uint8_t *buf;
+    int ret;
+
+    if (!ums_rcache.buf || !slot_blocks || !blocks)
+        return 0;
+
+    start = lba - lba % slot_blocks;
+    if (lba + blocks > start + slot_blocks)
+        return 0;
+
+    for (i = 0; i < UMS_RCACHE_SLOTS; i++) {
+        if (ums_rcache.slot[i].lun == ums_cur && ums_rcache.slot[i].lba == start)
+            break;
+        if (ums_rcache.slot[i].last_used < ums_rcache.slot[victim].last_used)
+            victim = i;
+    }
+
+    if (i == UMS_RCACHE_SLOTS) {
+        i = victim;
+        ums_rcache.slot[i].lun = NULL;
+        ums_rcache.slot[i].blocks = MIN(slot_blocks, ums_cur->block_count - start);
+        ret = bio_read(ums_cur->bio_dev, ums_rcache.buf + i * UMS_RCACHE_SLOT_SIZE,
+                       start * bs, ums_rcache.slot[i].blocks * bs);
+        if (ret < 0) {
+            dprintf(CRITICAL, "UMS: bio_read failed at LBA %llu: %d\n", start, ret);
+            ums_set_sense(SCSI_SENSE_MEDIUM_ERROR, 0, 0);
+            return -1;
+        }
+        ums_rcache.slot[i].lun = ums_cur;
+        ums_rcache.slot[i].lba = start;
+    } else {
+        dprintf(SPEW, "UMS: read cache hit - LBA %llu, length %u\n", lba, blocks);
+    }
+    ums_rcache.slot[i].last_used = ++ums_rcache.clock;
+
+    buf = ums_rcache.buf + i * UMS_RCACHE_SLOT_SIZE + (lba - start) * bs;
+    ums_usb_write(buf, blocks * bs);
+    return 1;
+}
+
 /*
- * Max blocks per pipeline chunk: half the transfer buffer (double
+ * Max bytes per pipeline chunk: half the transfer buffer (double
  * buffering) and at most one USB request per chunk.
  */
-static uint32_t ums_chunk_blocks(void)
+static uint32_t ums_chunk_max(void)
 {
     unsigned half = ums_buffer_size / 2;
 
     if (half > ums_max_usb_xfer)
         half = ums_max_usb_xfer;
 
-    return half / g_ums_device.block_size;
+    return half;
+}
+
+/*
+ * The best chunk size depends on the storage (SD cards prefer smaller
+ * chunks, eMMC larger ones) and on the direction, so it is searched at
+ * runtime for each partition and direction. Starting from the largest
+ * chunk, the throughput of large commands is measured over a window and
+ * the chunk is halved (or doubled) as long as that gets faster. When it
+ * does not, the other direction is tried from the best size once before
+ * the search settles. Results are kept across UMS sessions.
+ */
+#define UMS_TUNE_WINDOW     (16 * 1024 * 1024)
+#define UMS_TUNE_MIN_CHUNK  (32 * 1024)
+#define UMS_TUNE_SLOTS      8
+
+static struct {
+    char name[UMS_MAX_PARTITION_NAME];
+    struct ums_tune dir[2];  /* 0 = read, 1 = write */
+} ums_tunes[UMS_TUNE_SLOTS];
+static unsigned ums_tune_next;
+
+/* Find the tuning state of a partition, or start a new one */
+static struct ums_tune *ums_tune_get(const char *name)
+{
+    unsigned i, slot;
+
+    for (i = 0; i < UMS_TUNE_SLOTS; i++)
+        if (!strcmp(ums_tunes[i].name, name))
+            return ums_tunes[i].dir;
+
+    slot = ums_tune_next++ % UMS_TUNE_SLOTS;
+    memset(&ums_tunes[slot], 0, sizeof(ums_tunes[slot]));
+    strlcpy(ums_tunes[slot].name, name, sizeof(ums_tunes[slot].name));
+    for (i = 0; i < 2; i++) {
+        ums_tunes[slot].dir[i].chunk = ums_chunk_max();
+        ums_tunes[slot].dir[i].best_chunk = ums_chunk_max();
+        ums_tunes[slot].dir[i].step = -1;
+    }
+
+    return ums_tunes[slot].dir;
+}
+
+/* Account a command that used more than one chunk */
+static void ums_tune_update(int dir, unsigned bytes, time_t busy_ms)
+{
+    struct ums_tune *t = &ums_cur->tune[dir];
+    uint32_t next = 0;
+
+    if (!t->step)
+        return;
+
+    t->bytes += bytes;
+    t->busy_ms += busy_ms;
+    if (t->bytes < UMS_TUNE_WINDOW)
+        return;
+
+    /* bytes/ms ~= KB/s */
+    t->kbps = t->busy_ms ? (uint32_t)(t->bytes / t->busy_ms) : 0;
+    t->bytes = 0;
+    t->busy_ms = 0;
+
+    if (t->kbps > t->best_kbps) {
+        t->best_kbps = t->kbps;
+        t->best_chunk = t->chunk;
+    } else {
+        t->step = t->reversed ? 0 : -t->step;
+        t->reversed = true;
+    }
+
+    while (t->step) {
+        next = t->step > 0 ? t->best_chunk * 2 : t->best_chunk / 2;
+        if (next >= UMS_TUNE_MIN_CHUNK && next <= ums_chunk_max())
+            break;
+        t->step = t->reversed ? 0 : -t->step;
+        t->reversed = true;
+    }
+    t->chunk = t->step ? next : t->best_chunk;
+
+    dprintf(INFO, "UMS: %s %s chunk %u KiB: %u.%u MB/s, next %u KiB%s\n",
+            ums_cur->partition_name, dir ? "write" : "read",
+            t->best_chunk / 1024, t->best_kbps / 1000,
+            (t->best_kbps % 1000) / 100, t->chunk / 1024,
+            t->step ? "" : " (settled)");
+}
+
+/* Blocks per pipeline chunk for the current LUN and direction */
+static uint32_t ums_chunk_blocks(int dir)
+{
+    uint32_t chunk = MIN(ums_cur->tune[dir].chunk, ums_chunk_max());
+
+    return MAX(chunk / ums_cur->block_size, 1u);
+}
+
+/*
+ * Extract LBA and transfer length from a READ/WRITE (10) or (16) CDB
+ * and validate them against the medium.
+ */
+static int ums_cdb_lba(const uint8_t *cb, uint64_t *lba, uint32_t *blocks)
+{
+    if (cb[0] == SCSI_READ_16 || cb[0] == SCSI_WRITE_16) {
+        *lba = ums_get_be64(cb + 2);
+        *blocks = ums_get_be32(cb + 10);
+    } else {
+        *lba = ums_get_be32(cb + 2);
+        *blocks = (cb[7] << 8) | cb[8];
+    }
+
+    if (*lba >= ums_cur->block_count ||
+        *blocks > ums_cur->block_count - *lba) {
+        ums_set_sense(SCSI_SENSE_ILLEGAL_REQUEST, SCSI_ASC_INVALID_FIELD_IN_CDB, 0);
+        return -1;
+    }
+    return 0;
 }
 
 /*
- * SCSI READ 10 command.
+ * SCSI READ 10/16 command.
  *
  * Double-buffered: while the USB controller is sending chunk N out of
  * one half of the transfer buffer, chunk N+1 is read from storage into
  * the other half, so the eMMC and USB DMA engines run concurrently.
  */
-static int ums_scsi_read_10(struct cbw *cbw)
+static int ums_scsi_read(struct cbw *cbw)
 {
-    uint32_t lba, transfer_length, remaining, chunk_blocks;
+    uint64_t lba;
+    uint32_t transfer_length, remaining, chunk_blocks;
     uint32_t max_blocks_per_chunk;
     uint64_t offset;
     unsigned chunk_bytes, pending_bytes = 0;
     bool pending = false;
     uint8_t *bufs[2];
-    time_t start_ms;
+    time_t start_ms, elapsed_ms;
     int cur = 0;
     int ret;
 
-    if (!g_ums_device.is_mounted || !g_ums_device.bio_dev) {
+    if (!ums_cur->is_mounted || !ums_cur->bio_dev) {
         ums_set_sense(SCSI_SENSE_NOT_READY, SCSI_ASC_MEDIUM_NOT_PRESENT, 0);
         return -1;
     }
 
-    /* Extract LBA and transfer length from CDB */
-    lba = (cbw->cb[2] << 24) | (cbw->cb[3] << 16) | (cbw->cb[4] << 8) | cbw->cb[5];
-    transfer_length = (cbw->cb[7] << 8) | cbw->cb[8];
+    if (ums_cdb_lba(cbw->cb, &lba, &transfer_length))
+        return -1;
 
-    dprintf(SPEW, "UMS: READ 10 - LBA %u, length %u\n", lba, transfer_length);
+    dprintf(SPEW, "UMS: READ - LBA %llu, length %u\n", lba, transfer_length);
 
-    /* Validate bounds */
-    if (lba >= g_ums_device.block_count || (lba + transfer_length) > g_ums_device.block_count) {
-        ums_set_sense(SCSI_SENSE_ILLEGAL_REQUEST, SCSI_ASC_INVALID_FIELD_IN_CDB, 0);
+    /* Make sure cached writes are read back */
+    if (ums_wcache_overlaps(lba, transfer_length) && ums_wcache_flush() < 0) {
+        ums_set_sense(SCSI_SENSE_MEDIUM_ERROR, 0, 0);
         return -1;
     }
 
-    max_blocks_per_chunk = ums_chunk_blocks();
-    bufs[0] = g_ums_device.transfer_buffer;
+    ret = ums_rcache_read(lba, transfer_length);
+    if (ret)
+        return ret < 0 ? -1 : 0;
+
+    max_blocks_per_chunk = ums_chunk_blocks(0);
+    bufs[0] = ums_transfer_buffer;
     bufs[1] = bufs[0] + ums_buffer_size / 2;
     start_ms = current_time();
 
     remaining = transfer_length;
     while (remaining > 0) {
         chunk_blocks = (remaining > max_blocks_per_chunk) ? max_blocks_per_chunk : remaining;
-        chunk_bytes = chunk_blocks * g_ums_device.block_size;
-        offset = (uint64_t)lba * g_ums_device.block_size;
+        chunk_bytes = chunk_blocks * ums_cur->block_size;
+        offset = (uint64_t)lba * ums_cur->block_size;
 
         /* Read from storage while USB sends the previous chunk */
-        ret = bio_read(g_ums_device.bio_dev, bufs[cur], offset, chunk_bytes);
+        ret = bio_read(ums_cur->bio_dev, bufs[cur], offset, chunk_bytes);
         if (ret < 0) {
-            dprintf(CRITICAL, "UMS: bio_read failed at LBA %u: %d\n", lba, ret);
+            dprintf(CRITICAL, "UMS: bio_read failed at LBA %llu: %d\n", lba, ret);
             if (pending)
                 ums_usb_finish_write();
             ums_set_sense(SCSI_SENSE_MEDIUM_ERROR, 0, 0);
@@ -451,7 +963,7 @@ static int ums_scsi_read_10(struct cbw *cbw)
 
         ret = ums_usb_start_write(bufs[cur], chunk_bytes);
         if (ret < 0) {
-            dprintf(CRITICAL, "UMS: usb_write failed at LBA %u\n", lba);
+            dprintf(CRITICAL, "UMS: usb_write failed at LBA %llu\n", lba);
             return -1;
         }
         pending = true;
@@ -465,55 +977,62 @@ static int ums_scsi_read_10(struct cbw *cbw)
     if (pending)
         ums_usb_finish_write();
 
-    ums_stats_update(0, transfer_length * g_ums_device.block_size,
-                     current_time() - start_ms);
+    elapsed_ms = current_time() - start_ms;
+    ums_stats_update(0, transfer_length * ums_cur->block_size, elapsed_ms);
+    if (transfer_length > max_blocks_per_chunk)
+        ums_tune_update(0, transfer_length * ums_cur->block_size, elapsed_ms);
 
     return 0;
 }
 
 /*
- * SCSI WRITE 10 command.
+ * SCSI WRITE 10/16 command.
  *
  * Double-buffered: while chunk N is written to storage from one half
  * of the transfer buffer, the USB controller receives chunk N+1 into
  * the other half.
  */
-static int ums_scsi_write_10(struct cbw *cbw)
+static int ums_scsi_write(struct cbw *cbw)
 {
-    uint32_t lba, transfer_length, remaining, chunk_blocks, next_blocks;
+    uint64_t lba;
+    uint32_t transfer_length, remaining, chunk_blocks, next_blocks;
     uint32_t max_blocks_per_chunk;
     uint64_t offset;
     unsigned chunk_bytes;
     bool pending;
     uint8_t *bufs[2];
-    time_t start_ms;
+    time_t start_ms, elapsed_ms;
     int cur = 0;
     int ret;
 
-    if (!g_ums_device.is_mounted || !g_ums_device.bio_dev) {
+    if (!ums_cur->is_mounted || !ums_cur->bio_dev) {
         ums_set_sense(SCSI_SENSE_NOT_READY, SCSI_ASC_MEDIUM_NOT_PRESENT, 0);
         return -1;
     }
 
-    if (g_ums_device.is_read_only) {
+    if (ums_cur->is_read_only) {
         ums_set_sense(SCSI_SENSE_ILLEGAL_REQUEST, 0x27, 0);  /* Write protected */
         return -1;
     }
 
-    /* Extract LBA and transfer length from CDB */
-    lba = (cbw->cb[2] << 24) | (cbw->cb[3] << 16) | (cbw->cb[4] << 8) | cbw->cb[5];
-    transfer_length = (cbw->cb[7] << 8) | cbw->cb[8];
+    if (ums_cdb_lba(cbw->cb, &lba, &transfer_length))
+        return -1;
 
-    dprintf(SPEW, "UMS: WRITE 10 - LBA %u, length %u\n", lba, transfer_length);
+    dprintf(SPEW, "UMS: WRITE - LBA %llu, length %u\n", lba, transfer_length);
 
-    /* Validate bounds */
-    if (lba >= g_ums_device.block_count || (lba + transfer_length) > g_ums_device.block_count) {
-        ums_set_sense(SCSI_SENSE_ILLEGAL_REQUEST, SCSI_ASC_INVALID_FIELD_IN_CDB, 0);
+    ums_rcache_invalidate(lba, transfer_length);
+
+    if (transfer_length <= ums_wcache_capacity())
+        return ums_wcache_write(lba, transfer_length);
+
+    /* Large writes bypass the cache, but must not be overwritten by it */
+    if (ums_wcache_overlaps(lba, transfer_length) && ums_wcache_flush() < 0) {
+        ums_set_sense(SCSI_SENSE_MEDIUM_ERROR, 0, 0);
         return -1;
     }
 
-    max_blocks_per_chunk = ums_chunk_blocks();
-    bufs[0] = g_ums_device.transfer_buffer;
+    max_blocks_per_chunk = ums_chunk_blocks(1);
+    bufs[0] = ums_transfer_buffer;
     bufs[1] = bufs[0] + ums_buffer_size / 2;
     start_ms = current_time();
 
@@ -521,20 +1040,20 @@ static int ums_scsi_write_10(struct cbw *cbw)
 
     /* Prime the pipeline: receive the first chunk */
     chunk_blocks = (remaining > max_blocks_per_chunk) ? max_blocks_per_chunk : remaining;
-    ret = ums_usb_start_read(bufs[cur], chunk_blocks * g_ums_device.block_size);
+    ret = ums_usb_start_read(bufs[cur], chunk_blocks * ums_cur->block_size);
     if (ret < 0)
         return -1;
     pending = true;
 
     while (remaining > 0) {
         chunk_blocks = (remaining > max_blocks_per_chunk) ? max_blocks_per_chunk : remaining;
-        chunk_bytes = chunk_blocks * g_ums_device.block_size;
+        chunk_bytes = chunk_blocks * ums_cur->block_size;
 
         /* Wait for the chunk the host is sending into bufs[cur] */
         ret = ums_usb_finish_read(bufs[cur]);
         pending = false;
         if (ret != (int)chunk_bytes) {
-            dprintf(CRITICAL, "UMS: short usb_read at LBA %u (%d/%u)\n",
+            dprintf(CRITICAL, "UMS: short usb_read at LBA %llu (%d/%u)\n",
                     lba, ret, chunk_bytes);
             return -1;
         }
@@ -545,17 +1064,17 @@ static int ums_scsi_write_10(struct cbw *cbw)
             next_blocks = max_blocks_per_chunk;
         if (next_blocks > 0) {
             ret = ums_usb_start_read(bufs[cur ^ 1],
-                                     next_blocks * g_ums_device.block_size);
+                                     next_blocks * ums_cur->block_size);
             if (ret < 0)
                 return -1;
             pending = true;
         }
 
         /* Write to storage */
-        offset = (uint64_t)lba * g_ums_device.block_size;
-        ret = bio_write(g_ums_device.bio_dev, bufs[cur], offset, chunk_bytes);
+        offset = (uint64_t)lba * ums_cur->block_size;
+        ret = bio_write(ums_cur->bio_dev, bufs[cur], offset, chunk_bytes);
         if (ret < 0) {
-            dprintf(CRITICAL, "UMS: bio_write failed at LBA %u: %d\n", lba, ret);
+            dprintf(CRITICAL, "UMS: bio_write failed at LBA %llu: %d\n", lba, ret);
             /* Absorb the queued receive so it can't swallow the next CBW */
             if (pending)
                 ums_usb_finish_read(bufs[cur ^ 1]);
@@ -568,8 +1087,10 @@ static int ums_scsi_write_10(struct cbw *cbw)
         remaining -= chunk_blocks;
     }
 
-    ums_stats_update(1, transfer_length * g_ums_device.block_size,
-                     current_time() - start_ms);
+    elapsed_ms = current_time() - start_ms;
+    ums_stats_update(1, transfer_length * ums_cur->block_size, elapsed_ms);
+    if (transfer_length > max_blocks_per_chunk)
+        ums_tune_update(1, transfer_length * ums_cur->block_size, elapsed_ms);
 
     return 0;
 }
@@ -577,17 +1098,136 @@ static int ums_scsi_write_10(struct cbw *cbw)
 /* SCSI MODE SENSE 6 command */
 static int ums_scsi_mode_sense_6(struct cbw *cbw)
 {
-    unsigned len;
+    uint8_t page = cbw->cb[2] & 0x3f;
+    unsigned len = 4;
 
     dprintf(SPEW, "UMS: MODE SENSE 6\n");
 
     memset(ums_small_buf, 0, 4);
-    ums_small_buf[0] = 3;  /* Mode data length */
     ums_small_buf[1] = 0;  /* Medium type */
-    ums_small_buf[2] = g_ums_device.is_read_only ? 0x80 : 0x00;  /* Device-specific parameter */
+    ums_small_buf[2] = ums_cur->is_read_only ? 0x80 : 0x00;  /* Device-specific parameter */
     ums_small_buf[3] = 0;  /* Block descriptor length */
 
-    len = MIN(cbw->data_transfer_length, 4);
+    /* Caching mode page, so the host knows it must SYNCHRONIZE CACHE */
+    if (page == 0x08 || page == 0x3f) {
+        memset(ums_small_buf + len, 0, 20);
+        ums_small_buf[len] = 0x08;
+        ums_small_buf[len + 1] = 18;
+        ums_small_buf[len + 2] = ums_wcache.size ? 0x04 : 0x00;  /* WCE */
+        len += 20;
+    }
+    ums_small_buf[0] = len - 1;  /* Mode data length */
+
+    len = MIN(cbw->data_transfer_length, len);
+    ums_usb_write(ums_small_buf, len);
+
+    return 0;
+}
+
+/* SCSI SYNCHRONIZE CACHE (10) command */
+static int ums_scsi_synchronize_cache(struct cbw *cbw)
+{
+    dprintf(SPEW, "UMS: SYNCHRONIZE CACHE\n");
+
+    if (ums_wcache_flush() < 0 || ums_emmc_cache_flush() < 0) {
+        ums_set_sense(SCSI_SENSE_MEDIUM_ERROR, 0, 0);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * SCSI UNMAP command. The block descriptors are erased on the storage
+ * (e.g. using eMMC erase) instead of having the host write zeros.
+ */
+static int ums_scsi_unmap(struct cbw *cbw)
+{
+    uint32_t param_len = (cbw->cb[7] << 8) | cbw->cb[8];
+    uint32_t bs = ums_cur->block_size;
+    uint32_t desc_len, blocks;
+    uint8_t *desc;
+    uint64_t lba;
+    ssize_t ret;
+
+    dprintf(SPEW, "UMS: UNMAP\n");
+
+    if (!ums_cur->is_mounted || !ums_cur->bio_dev) {
+        ums_set_sense(SCSI_SENSE_NOT_READY, SCSI_ASC_MEDIUM_NOT_PRESENT, 0);
+        return -1;
+    }
+
+    if (ums_cur->is_read_only) {
+        ums_set_sense(SCSI_SENSE_ILLEGAL_REQUEST, 0x27, 0);  /* Write protected */
+        return -1;
+    }
+
+    if (param_len == 0)
+        return 0;
+
+    if (param_len < 8 || param_len > UMS_SMALL_BUF_SIZE) {
+        ums_set_sense(SCSI_SENSE_ILLEGAL_REQUEST, SCSI_ASC_INVALID_FIELD_IN_CDB, 0);
+        return -1;
+    }
+
+    if (ums_usb_start_read(ums_small_buf, param_len) < 0 ||
+        ums_usb_finish_read(ums_small_buf) != (int)param_len)
+        return -1;
+
+    desc_len = (ums_small_buf[2] << 8) | ums_small_buf[3];
+    desc_len = MIN(desc_len, param_len - 8);
+
+    for (desc = ums_small_buf + 8; desc_len >= 16; desc += 16, desc_len -= 16) {
+        lba = ums_get_be64(desc);
+        blocks = ums_get_be32(desc + 8);
+        if (!blocks)
+            continue;
+
+        if (lba >= ums_cur->block_count ||
+            blocks > ums_cur->block_count - lba) {
+            ums_set_sense(SCSI_SENSE_ILLEGAL_REQUEST, SCSI_ASC_LBA_OUT_OF_RANGE, 0);
+            return -1;
+        }
+
+        /* Cached writes must not end up on top of the unmapped blocks */
+        if (ums_wcache_overlaps(lba, blocks) && ums_wcache_flush() < 0) {
+            ums_set_sense(SCSI_SENSE_MEDIUM_ERROR, 0, 0);
+            return -1;
+        }
+
+        dprintf(SPEW, "UMS: UNMAP - LBA %llu, length %u\n", lba, blocks);
+        ums_rcache_invalidate(lba, blocks);
+        while (blocks) {
+            /* size_t is 32-bit, so erase large ranges in pieces */
+            uint32_t count = MIN(blocks, UMS_UNMAP_MAX_BLOCKS);
+
+            ret = bio_erase(ums_cur->bio_dev, lba * bs, (size_t)count * bs);
+            if (ret != (ssize_t)count * bs) {
+                dprintf(CRITICAL, "UMS: bio_erase failed at LBA %llu: %ld\n", lba, ret);
+                ums_set_sense(SCSI_SENSE_MEDIUM_ERROR, 0, 0);
+                return -1;
+            }
+            lba += count;
+            blocks -= count;
+        }
+    }
+
+    return 0;
+}
+
+/* SCSI REPORT LUNS command */
+static int ums_scsi_report_luns(struct cbw *cbw)
+{
+    unsigned len = 8 + ums_num_luns * 8;
+    unsigned i;
+
+    dprintf(SPEW, "UMS: REPORT LUNS\n");
+
+    memset(ums_small_buf, 0, len);
+    ums_put_be32(ums_small_buf, ums_num_luns * 8);  /* LUN list length */
+    for (i = 0; i < ums_num_luns; i++)
+        ums_small_buf[8 + i * 8 + 1] = i;  /* Peripheral device addressing */
+
+    len = MIN(cbw->data_transfer_length, len);
     ums_usb_write(ums_small_buf, len);
 
     return 0;
@@ -611,15 +1251,30 @@ static int ums_handle_scsi_command(struct cbw *cbw)
     case SCSI_READ_CAPACITY:
         ret = ums_scsi_read_capacity(cbw);
         break;
+    case SCSI_READ_CAPACITY_16:
+        ret = ums_scsi_read_capacity_16(cbw);
+        break;
     case SCSI_READ_10:
-        ret = ums_scsi_read_10(cbw);
+    case SCSI_READ_16:
+        ret = ums_scsi_read(cbw);
         break;
     case SCSI_WRITE_10:
-        ret = ums_scsi_write_10(cbw);
+    case SCSI_WRITE_16:
+        ret = ums_scsi_write(cbw);
+        break;
+    case SCSI_UNMAP:
+        ret = ums_scsi_unmap(cbw);
         break;
     case SCSI_MODE_SENSE_6:
         ret = ums_scsi_mode_sense_6(cbw);
         break;
+    case SCSI_REPORT_LUNS:
+        ret = ums_scsi_report_luns(cbw);
+        break;
+    case SCSI_SYNCHRONIZE_CACHE:
+    case SCSI_SYNCHRONIZE_CACHE_16:
+        ret = ums_scsi_synchronize_cache(cbw);
+        break;
     case SCSI_START_STOP_UNIT:
     case SCSI_ALLOW_MEDIUM_REMOVAL:
     case SCSI_VERIFY_10:
@@ -651,11 +1306,17 @@ static int ums_handle_cbw(struct cbw *cbw)
         return -1;
     }
 
-    dprintf(SPEW, "UMS: CBW tag=0x%08x, SCSI=0x%02x, length=%u\n",
-            cbw->tag, cbw->cb[0], cbw->data_transfer_length);
+    dprintf(SPEW, "UMS: CBW tag=0x%08x, LUN=%u, SCSI=0x%02x, length=%u\n",
+            cbw->tag, cbw->lun, cbw->cb[0], cbw->data_transfer_length);
 
     /* Handle SCSI command */
-    ret = ums_handle_scsi_command(cbw);
+    if (cbw->lun < ums_num_luns) {
+        ums_cur = &ums_luns[cbw->lun];
+        ret = ums_handle_scsi_command(cbw);
+    } else {
+        dprintf(INFO, "UMS: CBW for invalid LUN %u\n", cbw->lun);
+        ret = -1;
+    }
 
     if (ret < 0) {
         status = CSW_STATUS_FAILED;
@@ -668,11 +1329,175 @@ static int ums_handle_cbw(struct cbw *cbw)
     return ret;
 }
 
+/* Wait for the next command, flushing the write cache while the host is idle */
+static void ums_wait_command(event_t *event)
+{
+    while (ums_wcache.blocks) {
+        if (event_wait_timeout(event, UMS_WCACHE_IDLE_MS) != ERR_TIMED_OUT)
+            return;
+        ums_wcache_flush();
+    }
+    event_wait(event);
+}
+
+/*
+ * UAS command IUs do not have the expected transfer length of BOT, so
+ * derive it from the allocation/transfer length in the CDB.
+ */
+static uint32_t ums_cdb_data_length(const uint8_t *cb)
+{
+    switch (cb[0]) {
+    case SCSI_REQUEST_SENSE:
+    case SCSI_MODE_SENSE_6:
+        return cb[4];
+    case SCSI_INQUIRY:
+        return (cb[3] << 8) | cb[4];
+    case SCSI_READ_CAPACITY:
+        return sizeof(struct scsi_read_capacity_data);
+    case SCSI_REPORT_LUNS:
+        return (cb[6] << 24) | (cb[7] << 16) | (cb[8] << 8) | cb[9];
+    case SCSI_READ_CAPACITY_16:
+        return ums_get_be32(cb + 10);
+    case SCSI_READ_10:
+    case SCSI_WRITE_10:
+        return ((cb[7] << 8) | cb[8]) * ums_cur->block_size;
+    case SCSI_READ_16:
+    case SCSI_WRITE_16:
+        return ums_get_be32(cb + 10) * ums_cur->block_size;
+    case SCSI_UNMAP:
+        return (cb[7] << 8) | cb[8];
+    default:
+        return 0;
+    }
+}
+
+/* Complete a UAS command with a Sense IU */
+static void ums_uas_send_sense(uint16_t tag, bool failed)
+{
+    unsigned len = failed ? sizeof(ums_uas_status_buffer.sense) : 0;
+
+    memset(&ums_uas_status_buffer, 0, sizeof(ums_uas_status_buffer));
+    ums_uas_status_buffer.iu_id = UAS_IU_SENSE;
+    ums_uas_status_buffer.tag = tag;
+    if (failed) {
+        ums_uas_status_buffer.status = SCSI_STATUS_CHECK_CONDITION;
+        ums_fill_sense(ums_uas_status_buffer.sense);
+        /* Sense data is delivered with the status, like REQUEST SENSE */
+        ums_set_sense(SCSI_SENSE_NO_SENSE, 0, 0);
+    }
+    ums_uas_status_buffer.length = __builtin_bswap16(len);
+
+    ums_uas_send_status(offsetof(struct uas_sense_iu, sense) + len);
+}
+
+static void ums_uas_send_response(uint16_t tag, uint8_t code)
+{
+    struct uas_response_iu *resp = (struct uas_response_iu *)&ums_uas_status_buffer;
+
+    memset(resp, 0, sizeof(*resp));
+    resp->iu_id = UAS_IU_RESPONSE;
+    resp->tag = tag;
+    resp->response_code = code;
+
+    ums_uas_send_status(sizeof(*resp));
+}
+
+/* Handle UAS Command IU */
+static void ums_uas_handle_command(struct uas_command_iu *iu)
+{
+    struct cbw cbw = {0};
+    unsigned i;
+    int ret = -1;
+
+    dprintf(SPEW, "UMS: UAS tag=0x%04x, LUN=%u, SCSI=0x%02x\n",
+            __builtin_bswap16(iu->tag), iu->lun[1], iu->cdb[0]);
+
+    ums_uas_tag = iu->tag;
+    ums_uas_ready_sent = false;
+
+    /* Only single level peripheral device addressing (LUN in byte 1) */
+    for (i = 2; i < sizeof(iu->lun); i++)
+        if (iu->lun[i])
+            break;
+
+    if (iu->lun[0] || iu->lun[1] >= ums_num_luns || i < sizeof(iu->lun)) {
+        ums_cur = &ums_luns[0];
+        ums_set_sense(SCSI_SENSE_ILLEGAL_REQUEST, SCSI_ASC_LUN_NOT_SUPPORTED, 0);
+    } else {
+        ums_cur = &ums_luns[iu->lun[1]];
+        memcpy(cbw.cb, iu->cdb, sizeof(iu->cdb));
+        cbw.cb_length = sizeof(iu->cdb);
+        cbw.data_transfer_length = ums_cdb_data_length(cbw.cb);
+        ret = ums_handle_scsi_command(&cbw);
+    }
+
+    ums_uas_send_sense(iu->tag, ret < 0);
+}
+
+/* Queue receiving the next UAS Command IU into the given buffer */
+static int ums_uas_queue_cmd(int slot)
+{
+    arch_clean_invalidate_cache_range((addr_t)ums_uas_cmd_bufs[slot],
+                                      UMS_UAS_CMD_BUF_SIZE);
+
+    ums_req_cmd->buf = (void *)PA((addr_t)ums_uas_cmd_bufs[slot]);
+    ums_req_cmd->length = UMS_UAS_CMD_BUF_SIZE;
+    ums_req_cmd->complete = ums_cmd_complete;
+
+    return usb_if.udc_request_queue(ums_endpoints[3], ums_req_cmd);
+}
+
+/*
+ * UAS command loop. The host may queue many tagged commands; they are
+ * executed one after another, but the next Command IU is always being
+ * received while the current command runs, so there is no turnaround
+ * between commands like with BOT.
+ */
+static void ums_uas_loop(void)
+{
+    struct uas_command_iu *iu;
+    unsigned len;
+    int slot = 0;
+
+    if (ums_uas_queue_cmd(slot)) {
+        dprintf(CRITICAL, "UMS: Failed to queue UAS command request\n");
+        return;
+    }
+
+    while (ums_active) {
+        ums_wait_command(&ums_cmd_done);
+        len = ums_cmd_length;
+
+        iu = (struct uas_command_iu *)ums_uas_cmd_bufs[slot];
+        arch_invalidate_cache_range((addr_t)iu, UMS_UAS_CMD_BUF_SIZE);
+
+        if (ums_uas_queue_cmd(slot ^ 1)) {
+            dprintf(CRITICAL, "UMS: Failed to queue UAS command request\n");
+            break;
+        }
+
+        if (len < 4) {
+            /* Zero-length packet or error, nothing to answer */
+        } else if (iu->iu_id == UAS_IU_COMMAND && len >= sizeof(*iu)) {
+            ums_uas_handle_command(iu);
+        } else if (iu->iu_id == UAS_IU_TASK_MGMT) {
+            ums_uas_send_response(iu->tag, UAS_RC_TMF_NOT_SUPPORTED);
+        } else {
+            ums_uas_send_response(iu->tag, UAS_RC_INVALID_IU);
+        }
+
+        slot ^= 1;
+    }
+}
+
 /* UMS main thread */
 static int ums_thread(void *arg)
 {
-    dprintf(ALWAYS, "UMS: Starting mass storage mode for partition '%s'\n",
-            g_ums_device.partition_name);
+    unsigned i;
+
+    for (i = 0; i < ums_num_luns; i++)
+        dprintf(ALWAYS, "UMS: Starting mass storage mode for partition '%s' (LUN %u)\n",
+                ums_luns[i].partition_name, i);
 
     dprintf(INFO, "UMS: Waiting for USB connection...\n");
 
@@ -684,7 +1509,14 @@ static int ums_thread(void *arg)
     /* Give the host time to enumerate and send SET_CONFIGURATION */
     thread_sleep(500);
 
-    dprintf(INFO, "UMS: Ready - processing SCSI commands\n");
+    dprintf(INFO, "UMS: Ready - processing SCSI commands (%s)\n",
+            ums_uas ? "UAS" : "BOT");
+
+    if (ums_uas) {
+        ums_uas_loop();
+        dprintf(INFO, "UMS: Mass storage mode ended\n");
+        return 0;
+    }
 
     while (ums_active) {
         /* Clear the CBW buffer before receiving new data */
@@ -705,7 +1537,7 @@ static int ums_thread(void *arg)
         }
 
         /* Wait for command to be received */
-        event_wait(&ums_txn_done);
+        ums_wait_command(&ums_txn_done);
 
         /* Invalidate cache to ensure CPU reads fresh CBW data written by USB DMA */
         arch_invalidate_cache_range((addr_t)&ums_cbw_buffer, ROUNDUP(sizeof(ums_cbw_buffer), CACHE_LINE));
@@ -720,9 +1552,10 @@ static int ums_thread(void *arg)
     return 0;
 }
 
-/* Mount partition for UMS access */
+/* Mount partition for UMS access as the next LUN */
 int ums_mount_partition(const char *partition_name)
 {
+    struct ums_device *lun = &ums_luns[ums_num_luns];
     bdev_t *dev;
     const char *mapped_name = NULL;
 
@@ -731,6 +1564,11 @@ int ums_mount_partition(const char *partition_name)
         return -1;
     }
 
+    if (ums_num_luns >= UMS_MAX_LUNS) {
+        dprintf(CRITICAL, "UMS: Too many partitions (max %d)\n", UMS_MAX_LUNS);
+        return -1;
+    }
+
     /* Open block device for partition by name; if it fails, try label mapping */
     dev = bio_open(partition_name);
     if (!dev) {
@@ -769,31 +1607,38 @@ int ums_mount_partition(const char *partition_name)
         return -1;
     }
 
-    g_ums_device.bio_dev = dev;
-    g_ums_device.block_count = dev->block_count;
-    g_ums_device.block_size = dev->block_size;
-    strlcpy(g_ums_device.partition_name, mapped_name ? mapped_name : partition_name, sizeof(g_ums_device.partition_name));
-    g_ums_device.is_mounted = true;
-    g_ums_device.is_read_only = false;
+    memset(lun, 0, sizeof(*lun));
+    lun->bio_dev = dev;
+    lun->block_count = dev->block_count;
+    lun->block_size = dev->block_size;
+    strlcpy(lun->partition_name, mapped_name ? mapped_name : partition_name, sizeof(lun->partition_name));
+    lun->is_mounted = true;
+    lun->is_read_only = false;
+    lun->tune = ums_tune_get(lun->partition_name);
 
-    dprintf(INFO, "UMS: Mounted '%s' (%llu blocks x %u bytes)\n",
-            partition_name, g_ums_device.block_count, g_ums_device.block_size);
+    dprintf(INFO, "UMS: Mounted '%s' as LUN %u (%llu blocks x %u bytes)\n",
+            partition_name, ums_num_luns, lun->block_count, lun->block_size);
+    ums_num_luns++;
 
     return 0;
 }
 
-/* Unmount partition */
+/* Unmount all partitions */
 void ums_unmount_partition(void)
 {
-    if (g_ums_device.bio_dev) {
-        bio_close(g_ums_device.bio_dev);
-        g_ums_device.bio_dev = NULL;
+    unsigned i;
+
+    for (i = 0; i < ums_num_luns; i++) {
+        if (ums_luns[i].bio_dev)
+            bio_close(ums_luns[i].bio_dev);
+        memset(&ums_luns[i], 0, sizeof(ums_luns[i]));
     }
 
-    g_ums_device.is_mounted = false;
-    memset(g_ums_device.partition_name, 0, sizeof(g_ums_device.partition_name));
+    ums_num_luns = 0;
+    ums_cur = &ums_luns[0];
+    memset(ums_rcache.slot, 0, sizeof(ums_rcache.slot));
 
-    dprintf(INFO, "UMS: Partition unmounted\n");
+    dprintf(INFO, "UMS: Partitions unmounted\n");
 }
 
 /* Initialize UMS */
@@ -811,6 +1656,12 @@ int ums_init(void)
         maxpkt = 512;   /* USB2 High Speed */
     }
 
+#if LK2ND_UMS_UAS
+    ums_uas = !ums_is_dwc;
+    if (ums_is_dwc)
+        dprintf(INFO, "UMS: UAS needs streams on DWC3, using BOT\n");
+#endif
+
     /*
      * Use the scratch region for the transfer buffer (same region fastboot uses).
      * This gives us a large, page-aligned, DMA-safe buffer without malloc.
@@ -818,6 +1669,10 @@ int ums_init(void)
      */
     void *scratch = target_get_scratch_address();
     unsigned scratch_max = target_get_max_flash_size();
+    unsigned scratch_used;
+#if LK2ND_UMS_WRITE_CACHE
+    const struct lk2nd_region *highmem;
+#endif
 
     ums_buffer_size = UMS_BUFFER_SIZE_DEFAULT;
     if (ums_buffer_size > scratch_max / 2)
@@ -825,13 +1680,38 @@ int ums_init(void)
     /* Align down to block size (512) */
     ums_buffer_size &= ~(512U - 1);
 
-    g_ums_device.transfer_buffer = scratch;
+    ums_transfer_buffer = scratch;
+    scratch_used = ums_buffer_size;
+
+#if LK2ND_UMS_WRITE_CACHE
+    if (lk2nd_highmem_map(&highmem)) {
+        /* Not used by fastboot downloads while UMS is running */
+        ums_wcache.buf = (uint8_t *)highmem[0].start;
+        ums_wcache.size = MIN(highmem[0].size, UMS_WCACHE_HIGHMEM_SIZE);
+    } else if (ums_buffer_size + UMS_WCACHE_SIZE <= scratch_max) {
+        ums_wcache.buf = (uint8_t *)scratch + ums_buffer_size;
+        ums_wcache.size = UMS_WCACHE_SIZE;
+        scratch_used += ums_wcache.size;
+    }
+    if (ums_wcache.size) {
+        ums_wcache.blocks = 0;
+        dprintf(INFO, "UMS: Write cache @%p, size %u KiB\n",
+                ums_wcache.buf, ums_wcache.size / 1024);
+    }
+#endif
+    ums_rcache.buf = NULL;
+    if (scratch_used + UMS_RCACHE_SLOTS * UMS_RCACHE_SLOT_SIZE <= scratch_max) {
+        ums_rcache.buf = (uint8_t *)scratch + scratch_used;
+        memset(ums_rcache.slot, 0, sizeof(ums_rcache.slot));
+    }
     dprintf(INFO, "UMS: Transfer buffer @%p, size %u KiB (scratch region)\n",
             scratch, ums_buffer_size / 1024);
 
     /* Initialize events */
     event_init(&ums_online, false, EVENT_FLAG_AUTOUNSIGNAL);
     event_init(&ums_txn_done, false, EVENT_FLAG_AUTOUNSIGNAL);
+    event_init(&ums_status_done, false, EVENT_FLAG_AUTOUNSIGNAL);
+    event_init(&ums_cmd_done, false, EVENT_FLAG_AUTOUNSIGNAL);
 
     /* Select controller implementation (dwc vs hsusb) */
     if (ums_is_dwc) {
@@ -880,6 +1760,22 @@ int ums_init(void)
         return -1;
     }
 
+    if (ums_uas) {
+        ums_endpoints[2] = usb_if.udc_endpoint_alloc(UDC_TYPE_BULK_IN, maxpkt);
+        ums_endpoints[3] = usb_if.udc_endpoint_alloc(UDC_TYPE_BULK_OUT, maxpkt);
+        ums_req_status = usb_if.udc_request_alloc();
+        ums_req_cmd = usb_if.udc_request_alloc();
+        if (!ums_endpoints[2] || !ums_endpoints[3] ||
+            !ums_req_status || !ums_req_cmd) {
+            dprintf(CRITICAL, "UMS: Failed to allocate UAS pipes\n");
+            return -1;
+        }
+
+        ums_gadget.ifc_protocol = UMS_PROTOCOL_UAS;
+        ums_gadget.ifc_endpoints = 4;
+        ums_gadget.pipe_usage = ums_uas_pipes;
+    }
+
     /* Allocate requests */
     ums_req_in = usb_if.udc_request_alloc();
     ums_req_out = usb_if.udc_request_alloc();
@@ -902,6 +1798,8 @@ int ums_init(void)
 /* Enter UMS mode */
 int ums_enter_mode(const char *partition_name)
 {
+    char names[UMS_MAX_LUNS * UMS_MAX_PARTITION_NAME];
+    char *name, *save;
     thread_t *thr;
     int ret;
 
@@ -913,27 +1811,46 @@ int ums_enter_mode(const char *partition_name)
     dprintf(INFO, "UMS: Starting mass storage mode for partition '%s'\n",
             partition_name ? partition_name : "(null)");
 
+    if (!partition_name || strlen(partition_name) >= sizeof(names)) {
+        dprintf(CRITICAL, "UMS: Invalid partition name\n");
+        return -1;
+    }
+
     /* Initialize UMS */
     if (ums_init()) {
         dprintf(CRITICAL, "UMS: Initialization failed\n");
         return -1;
     }
 
-    /* Mount partition with retry in case block devices not yet published */
-    int mount_attempts = 0;
+    /*
+     * Mount each partition of the comma separated list as its own LUN,
+     * with retry in case block devices are not yet published.
+     */
     const int max_attempts = 30; /* ~3s total (100ms sleep) */
-    while (mount_attempts < max_attempts) {
-        if (ums_mount_partition(partition_name) == 0)
+    strlcpy(names, partition_name, sizeof(names));
+    for (name = strtok_r(names, ",", &save); name; name = strtok_r(NULL, ",", &save)) {
+        int mount_attempts = 0;
+        while (mount_attempts < max_attempts) {
+            if (ums_mount_partition(name) == 0)
+                break;
+            if (mount_attempts == 0)
+                dprintf(INFO, "UMS: Waiting for block devices...\n");
+            mount_attempts++;
+            thread_sleep(100);
+        }
+        if (mount_attempts == max_attempts)
             break;
-        if (mount_attempts == 0)
-            dprintf(INFO, "UMS: Waiting for block devices...\n");
-        mount_attempts++;
-        thread_sleep(100);
     }
-    if (!g_ums_device.is_mounted) {
+    if (name || !ums_num_luns) {
         dprintf(CRITICAL, "UMS: Failed to mount partition\n");
+        ums_unmount_partition();
         return -1;
     }
+    ums_gadget.max_lun = ums_num_luns - 1;
+
+#if MMC_SDHCI_SUPPORT
+    mmc_enable_write_cache();
+#endif
 
     /* Start USB */
     dprintf(INFO, "UMS: Starting USB device\n");
@@ -945,11 +1862,15 @@ int ums_enter_mode(const char *partition_name)
 
     ums_active = true;
 
+    /* Released again by ums_exit_mode() */
+    rpm_bw_request();
+
     /* Start UMS thread */
     thr = thread_create("ums", &ums_thread, NULL, DEFAULT_PRIORITY, DEFAULT_STACK_SIZE);
     if (!thr) {
         dprintf(CRITICAL, "UMS: Failed to create thread\n");
         ums_active = false;
+        rpm_bw_release();
         return -1;
     }
     thread_resume(thr);
@@ -992,11 +1913,21 @@ void ums_exit_mode(void)
     /* Stop USB */
     usb_if.udc_stop();
 
+    ums_wcache_flush();
+    memset(&ums_wcache, 0, sizeof(ums_wcache));
+    ums_emmc_cache_flush();
+    rpm_bw_release();
+
     /* Unmount partition */
     ums_unmount_partition();
 
+#if WITH_LIB_FS
+    /* The host may have changed any filesystem that lk2nd keeps mounted */
+    fs_invalidate(NULL);
+#endif
+
     /* Release resources (transfer buffer is scratch region, not freed) */
-    g_ums_device.transfer_buffer = NULL;
+    ums_transfer_buffer = NULL;
 
     if (ums_req_in) {
         usb_if.udc_request_free(ums_req_in);
@@ -1018,7 +1949,62 @@ void ums_exit_mode(void)
         ums_endpoints[1] = NULL;
     }
 
-    memset(&g_ums_device, 0, sizeof(g_ums_device));
+    if (ums_uas) {
+        usb_if.udc_request_free(ums_req_status);
+        usb_if.udc_request_free(ums_req_cmd);
+        ums_req_status = NULL;
+        ums_req_cmd = NULL;
+
+        if (usb_if.udc_endpoint_free) {
+            usb_if.udc_endpoint_free(ums_endpoints[2]);
+            usb_if.udc_endpoint_free(ums_endpoints[3]);
+        }
+        ums_endpoints[2] = NULL;
+        ums_endpoints[3] = NULL;
+
+        ums_gadget.ifc_protocol = UMS_PROTOCOL;
+        ums_gadget.ifc_endpoints = 2;
+        ums_gadget.pipe_usage = NULL;
+        ums_uas = false;
+    }
+
+    ums_gadget.max_lun = 0;
 
     dprintf(INFO, "UMS: Cleanup complete\n");
 }
+
+/* Throughput and chunk tuning of the previous UMS sessions */
+static void cmd_oem_ums_stats(const char *arg, void *data, unsigned sz)
+{
+    char response[MAX_RSP_SIZE];
+    struct ums_tune *t;
+    unsigned i, dir;
+
+    for (dir = 0; dir < 2; dir++) {
+        snprintf(response, sizeof(response), "%s: %llu MiB, last %u.%u MB/s",
+                 dir ? "write" : "read",
+                 ums_stats[dir].total_mb + ums_stats[dir].bytes / (1024 * 1024),
+                 ums_stats[dir].last_kbps / 1000,
+                 (ums_stats[dir].last_kbps % 1000) / 100);
+        fastboot_info(response);
+    }
+
+    for (i = 0; i < UMS_TUNE_SLOTS; i++) {
+        if (!ums_tunes[i].name[0])
+            continue;
+
+        for (dir = 0; dir < 2; dir++) {
+            t = &ums_tunes[i].dir[dir];
+            snprintf(response, sizeof(response),
+                     "%s %s: chunk %u KiB, best %u KiB @ %u.%u MB/s%s",
+                     ums_tunes[i].name, dir ? "write" : "read",
+                     t->chunk / 1024, t->best_chunk / 1024,
+                     t->best_kbps / 1000, (t->best_kbps % 1000) / 100,
+                     t->step ? " (tuning)" : "");
+            fastboot_info(response);
+        }
+    }
+
+    fastboot_okay("");
+}
+FASTBOOT_REGISTER("oem ums-stats", cmd_oem_ums_stats);
@@ -35,6 +35,7 @@ struct cbw;
 #define UMS_CLASS               0x08
 #define UMS_SUBCLASS            0x06    /* SCSI transparent command set */
 #define UMS_PROTOCOL            0x50    /* Bulk-Only Transport */
+#define UMS_PROTOCOL_UAS        0x62    /* USB Attached SCSI */
 
 /* Bulk-Only Transport (BOT) definitions */
 #define CBW_SIGNATURE           0x43425355  /* "USBC" */
@@ -47,6 +48,26 @@ struct cbw;
 #define CSW_STATUS_FAILED       0x01
 #define CSW_STATUS_PHASE_ERROR  0x02
 
+/* USB Attached SCSI (UAS) definitions */
+#define UAS_PIPE_COMMAND        1
+#define UAS_PIPE_STATUS         2
+#define UAS_PIPE_DATA_IN        3
+#define UAS_PIPE_DATA_OUT       4
+
+#define UAS_IU_COMMAND          0x01
+#define UAS_IU_SENSE            0x03
+#define UAS_IU_RESPONSE         0x04
+#define UAS_IU_TASK_MGMT        0x05
+#define UAS_IU_READ_READY       0x06
+#define UAS_IU_WRITE_READY      0x07
+
+#define UAS_RC_INVALID_IU       0x02
+#define UAS_RC_TMF_NOT_SUPPORTED 0x04
+
+/* SCSI status */
+#define SCSI_STATUS_GOOD        0x00
+#define SCSI_STATUS_CHECK_CONDITION 0x02
+
 /* SCSI commands */
 #define SCSI_TEST_UNIT_READY    0x00
 #define SCSI_REQUEST_SENSE      0x03
@@ -59,10 +80,17 @@ struct cbw;
 #define SCSI_READ_10            0x28
 #define SCSI_WRITE_10           0x2A
 #define SCSI_VERIFY_10          0x2F
+#define SCSI_SYNCHRONIZE_CACHE  0x35
+#define SCSI_UNMAP              0x42
 #define SCSI_MODE_SELECT_6      0x15
 #define SCSI_MODE_SENSE_6       0x1A
 #define SCSI_MODE_SELECT_10     0x55
 #define SCSI_MODE_SENSE_10      0x5A
+#define SCSI_READ_16            0x88
+#define SCSI_WRITE_16           0x8A
+#define SCSI_SYNCHRONIZE_CACHE_16 0x91
+#define SCSI_READ_CAPACITY_16   0x9E    /* SERVICE ACTION IN (16) */
+#define SCSI_REPORT_LUNS        0xA0
 
 /* SCSI sense keys */
 #define SCSI_SENSE_NO_SENSE     0x00
@@ -74,10 +102,18 @@ struct cbw;
 /* Additional Sense Codes */
 #define SCSI_ASC_INVALID_COMMAND    0x20
 #define SCSI_ASC_INVALID_FIELD_IN_CDB 0x24
+#define SCSI_ASC_LBA_OUT_OF_RANGE   0x21
+#define SCSI_ASC_LUN_NOT_SUPPORTED  0x25
 #define SCSI_ASC_MEDIUM_NOT_PRESENT 0x3A
 
 /* Configuration */
 #define UMS_MAX_PARTITION_NAME  32
+#define UMS_MAX_LUNS            8
+
+/* UNMAP parameter list must fit in the small response buffer (256 bytes) */
+#define UMS_UNMAP_MAX_DESCRIPTORS 15
+/* Blocks erased per bio_erase() call */
+#define UMS_UNMAP_MAX_BLOCKS    0x100000
 
 /*
  * Transfer buffer sizing.
@@ -88,12 +124,11 @@ struct cbw;
 #define UMS_BUFFER_SIZE_DEFAULT (1 * 1024 * 1024)
 
 /*
- * USB controller transfer limits (must match HSUSB / DWC drivers).
- * HSUSB: MAX_TDS_PER_REQUEST (32) TDs x 16 KiB = 512 KiB per
- *        udc_request_queue() call.
+ * USB controller transfer limits per udc_request_queue() call.
+ * HSUSB: one TD per 16 KiB, the TD pool of a request grows as needed.
  * DWC:   single TRB can do ~16 MiB.
  */
-#define UMS_HSUSB_MAX_XFER      (512 * 1024)
+#define UMS_HSUSB_MAX_XFER      (4 * 1024 * 1024)
 #define UMS_DWC_MAX_XFER         (16 * 1024 * 1024)
 
 /* Command Block Wrapper (CBW) */
@@ -115,6 +150,40 @@ struct csw {
     uint8_t status;
 } __attribute__((packed));
 
+/* UAS Command IU (without additional CDB bytes) */
+struct uas_command_iu {
+    uint8_t iu_id;
+    uint8_t reserved1;
+    uint16_t tag;           /* big-endian, echoed back as-is */
+    uint8_t prio_attr;
+    uint8_t reserved2;
+    uint8_t add_cdb_length;
+    uint8_t reserved3;
+    uint8_t lun[8];
+    uint8_t cdb[16];
+} __attribute__((packed));
+
+/* UAS Sense IU, also used for READ READY / WRITE READY (first 4 bytes) */
+struct uas_sense_iu {
+    uint8_t iu_id;
+    uint8_t reserved1;
+    uint16_t tag;
+    uint16_t status_qualifier;
+    uint8_t status;
+    uint8_t reserved2[7];
+    uint16_t length;        /* big-endian */
+    uint8_t sense[18];
+} __attribute__((packed));
+
+/* UAS Response IU */
+struct uas_response_iu {
+    uint8_t iu_id;
+    uint8_t reserved;
+    uint16_t tag;
+    uint8_t add_response_info[3];
+    uint8_t response_code;
+} __attribute__((packed));
+
 /* SCSI Standard Inquiry Data */
 struct scsi_inquiry_data {
     uint8_t peripheral_device_type:5;
@@ -157,7 +226,19 @@ struct scsi_read_capacity_data {
     uint32_t logical_block_length;
 } __attribute__((packed));
 
-/* UMS device state */
+/* Runtime tuning of the pipeline chunk size */
+struct ums_tune {
+    uint32_t chunk;         /* bytes, currently used */
+    uint32_t best_chunk;
+    uint32_t best_kbps;
+    uint32_t kbps;          /* of the last window */
+    int8_t step;            /* -1 halve, +1 double, 0 settled */
+    bool reversed;
+    uint64_t bytes;
+    time_t busy_ms;
+};
+
+/* UMS device (LUN) state */
 struct ums_device {
     bdev_t *bio_dev;
     uint64_t block_count;
@@ -165,9 +246,9 @@ struct ums_device {
     char partition_name[UMS_MAX_PARTITION_NAME];
     bool is_mounted;
     bool is_read_only;
+    struct ums_tune *tune;  /* [0] read, [1] write */
 
     /* Transfer state */
-    void *transfer_buffer;
     uint32_t transfer_length;
     uint32_t transfer_offset;
     bool transfer_in_progress;
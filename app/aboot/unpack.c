@@ -0,0 +1,307 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/*
+ * Incremental decompression of images that are flashed while they are being
+ * received, so the host only sends the compressed image over USB.
+ *
+ * The decompressed data is collected in a buffer and passed on in large
+ * pieces, which are a multiple of the block size of the card except for the
+ * last one. That way it can be written with mmc_write() or decoded as a
+ * sparse image just like uncompressed data.
+ */
+
+#include <debug.h>
+#include <err.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "unpack.h"
+
+/* gzip member header, see RFC 1952 */
+#define GZIP_HEADER_LEN			10
+#define GZIP_TRAILER_LEN		8
+#define GZIP_FHCRC			0x02
+#define GZIP_FEXTRA			0x04
+#define GZIP_FNAME			0x08
+#define GZIP_FCOMMENT			0x10
+
+enum {
+	GZ_HEADER,
+	GZ_EXTRA_LEN,
+	GZ_EXTRA,
+	GZ_NAME,
+	GZ_COMMENT,
+	GZ_HCRC,
+	GZ_DATA,
+	GZ_TRAILER,
+};
+
+static int unpack_fail(struct unpack_writer *uw, const char *error)
+{
+	uw->error = error;
+	return -1;
+}
+
+enum unpack_format unpack_detect(const void *data, unsigned len)
+{
+	const uint8_t *p = data;
+
+	if (len >= 3 && p[0] == 0x1f && p[1] == 0x8b && p[2] == Z_DEFLATED)
+		return UNPACK_GZIP;
+#if WITH_LIB_LZ4
+	if (lz4_is_compressed(data, len))
+		return UNPACK_LZ4;
+#endif
+	return UNPACK_NONE;
+}
+
+size_t unpack_work_size(enum unpack_format format)
+{
+#if WITH_LIB_LZ4
+	if (format == UNPACK_LZ4)
+		return UNPACK_OUT_SIZE + LZ4_STREAM_WORK_SIZE;
+#endif
+	return UNPACK_OUT_SIZE;
+}
+
+static int unpack_flush(struct unpack_writer *uw)
+{
+	unsigned len = uw->buf_len;
+
+	uw->buf_len = 0;
+	if (len && uw->out(uw->arg, uw->buf, len) < 0) {
+		uw->stopped = true;
+		return unpack_fail(uw, NULL);
+	}
+	return 0;
+}
+
+#if WITH_LIB_LZ4
+static int unpack_lz4_out(void *arg, const void *data, size_t len)
+{
+	struct unpack_writer *uw = arg;
+	const uint8_t *p = data;
+	unsigned n;
+
+	while (len) {
+		n = MIN(len, UNPACK_OUT_SIZE - uw->buf_len);
+		memcpy(uw->buf + uw->buf_len, p, n);
+		uw->buf_len += n;
+		p += n;
+		len -= n;
+
+		if (uw->buf_len == UNPACK_OUT_SIZE && unpack_flush(uw))
+			return -1;
+	}
+
+	return 0;
+}
+#endif
+
+int unpack_writer_init(struct unpack_writer *uw, enum unpack_format format,
+		       void *work, unpack_out out, void *arg)
+{
+	memset(uw, 0, sizeof(*uw));
+	uw->format = format;
+	uw->out = out;
+	uw->arg = arg;
+	uw->buf = work;
+
+	switch (format) {
+	case UNPACK_GZIP:
+		/* lib/zlib_inflate is built without gzip support, use raw inflate */
+		if (inflateInit2(&uw->zs, -MAX_WBITS) != Z_OK)
+			return unpack_fail(uw, "out of memory");
+		uw->zs_init = true;
+		return 0;
+#if WITH_LIB_LZ4
+	case UNPACK_LZ4:
+		lz4_stream_init(&uw->lz4, uw->buf + UNPACK_OUT_SIZE,
+				unpack_lz4_out, uw);
+		return 0;
+#endif
+	default:
+		return unpack_fail(uw, "unknown compression");
+	}
+}
+
+/* Collect a header field of @n bytes in gz_hdr, true once it is complete */
+static bool gzip_collect(struct unpack_writer *uw, const uint8_t **p,
+			 unsigned *len, unsigned n)
+{
+	unsigned c = MIN(*len, n - uw->gz_pos);
+
+	memcpy(uw->gz_hdr + uw->gz_pos, *p, c);
+	uw->gz_pos += c;
+	*p += c;
+	*len -= c;
+
+	if (uw->gz_pos < n)
+		return false;
+
+	uw->gz_pos = 0;
+	return true;
+}
+
+/* The optional header fields that follow @state, in the order of RFC 1952 */
+static unsigned gzip_next_field(struct unpack_writer *uw, unsigned state)
+{
+	switch (state) {
+	case GZ_HEADER:
+		if (uw->gz_flags & GZIP_FEXTRA)
+			return GZ_EXTRA_LEN;
+		/* fall through */
+	case GZ_EXTRA:
+		if (uw->gz_flags & GZIP_FNAME)
+			return GZ_NAME;
+		/* fall through */
+	case GZ_NAME:
+		if (uw->gz_flags & GZIP_FCOMMENT)
+			return GZ_COMMENT;
+		/* fall through */
+	case GZ_COMMENT:
+		if (uw->gz_flags & GZIP_FHCRC)
+			return GZ_HCRC;
+		/* fall through */
+	default:
+		return GZ_DATA;
+	}
+}
+
+static int unpack_inflate(struct unpack_writer *uw, const uint8_t **p, unsigned *len)
+{
+	z_stream *zs = &uw->zs;
+	int rc;
+
+	zs->next_in = (Bytef *)*p;
+	zs->avail_in = *len;
+	zs->next_out = uw->buf + uw->buf_len;
+	zs->avail_out = UNPACK_OUT_SIZE - uw->buf_len;
+
+	rc = inflate(zs, Z_NO_FLUSH);
+
+	uw->buf_len = UNPACK_OUT_SIZE - zs->avail_out;
+	*p = zs->next_in;
+	*len = zs->avail_in;
+
+	if (rc == Z_STREAM_END) {
+		uw->gz_size = zs->total_out;
+		if (inflateReset(zs) != Z_OK)
+			return unpack_fail(uw, "invalid gzip data");
+		uw->gz_state = GZ_TRAILER;
+	} else if (rc != Z_OK) {
+		return unpack_fail(uw, "invalid gzip data");
+	}
+
+	if (uw->buf_len == UNPACK_OUT_SIZE)
+		return unpack_flush(uw);
+	return 0;
+}
+
+/*
+ * gzip members may be concatenated, e.g. by pigz. The CRC in the trailer is
+ * not checked (just like for the kernel in lk2nd/boot), only the size.
+ */
+static int unpack_gzip_write(struct unpack_writer *uw, const void *data, unsigned len)
+{
+	const uint8_t *p = data, *end;
+	const uint8_t *h = uw->gz_hdr;
+	unsigned n;
+
+	while (len) {
+		switch (uw->gz_state) {
+		case GZ_HEADER:
+			if (!gzip_collect(uw, &p, &len, GZIP_HEADER_LEN))
+				break;
+			if (h[0] != 0x1f || h[1] != 0x8b || h[2] != Z_DEFLATED)
+				return unpack_fail(uw, "invalid gzip header");
+			uw->gz_flags = h[3];
+			uw->gz_state = gzip_next_field(uw, GZ_HEADER);
+			break;
+		case GZ_EXTRA_LEN:
+			if (!gzip_collect(uw, &p, &len, 2))
+				break;
+			uw->gz_skip = h[0] | h[1] << 8;
+			uw->gz_state = GZ_EXTRA;
+			break;
+		case GZ_EXTRA:
+			n = MIN(len, uw->gz_skip);
+			p += n;
+			len -= n;
+			uw->gz_skip -= n;
+			if (!uw->gz_skip)
+				uw->gz_state = gzip_next_field(uw, GZ_EXTRA);
+			break;
+		case GZ_NAME:
+		case GZ_COMMENT:
+			/* zero terminated */
+			end = memchr(p, 0, len);
+			n = end ? (unsigned)(end - p) + 1 : len;
+			p += n;
+			len -= n;
+			if (end)
+				uw->gz_state = gzip_next_field(uw, uw->gz_state);
+			break;
+		case GZ_HCRC:
+			if (gzip_collect(uw, &p, &len, 2))
+				uw->gz_state = GZ_DATA;
+			break;
+		case GZ_DATA:
+			if (unpack_inflate(uw, &p, &len))
+				return -1;
+			break;
+		case GZ_TRAILER:
+			if (!gzip_collect(uw, &p, &len, GZIP_TRAILER_LEN))
+				break;
+			if ((h[4] | h[5] << 8 | h[6] << 16 | (uint32_t)h[7] << 24) != uw->gz_size)
+				return unpack_fail(uw, "gzip size mismatch");
+			uw->gz_members++;
+			uw->gz_state = GZ_HEADER;
+			break;
+		}
+	}
+
+	return 0;
+}
+
+int unpack_writer_write(struct unpack_writer *uw, const void *data, unsigned len)
+{
+	switch (uw->format) {
+	case UNPACK_GZIP:
+		return unpack_gzip_write(uw, data, len);
+#if WITH_LIB_LZ4
+	case UNPACK_LZ4:
+		if (lz4_stream_write(&uw->lz4, data, len))
+			return uw->stopped ? -1 : unpack_fail(uw, "invalid lz4 data");
+		return 0;
+#endif
+	default:
+		return unpack_fail(uw, "unknown compression");
+	}
+}
+
+int unpack_writer_finish(struct unpack_writer *uw)
+{
+	switch (uw->format) {
+	case UNPACK_GZIP:
+		if (uw->gz_state != GZ_HEADER || uw->gz_pos || !uw->gz_members)
+			return unpack_fail(uw, "truncated gzip data");
+		break;
+#if WITH_LIB_LZ4
+	case UNPACK_LZ4:
+		if (lz4_stream_finish(&uw->lz4))
+			return unpack_fail(uw, "truncated lz4 data");
+		break;
+#endif
+	default:
+		return unpack_fail(uw, "unknown compression");
+	}
+
+	return unpack_flush(uw);
+}
+
+void unpack_writer_free(struct unpack_writer *uw)
+{
+	if (uw->zs_init)
+		inflateEnd(&uw->zs);
+	uw->zs_init = false;
+}
@@ -0,0 +1,68 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+#ifndef __APP_UNPACK_H
+#define __APP_UNPACK_H
+
+#include <sys/types.h>
+#include <zlib.h>
+#if WITH_LIB_LZ4
+#include <lib/lz4.h>
+#endif
+
+enum unpack_format {
+	UNPACK_NONE,
+	UNPACK_GZIP,
+	UNPACK_LZ4,
+};
+
+/* decompressed data is passed on in pieces of this size, except the last */
+#define UNPACK_OUT_SIZE		(1024 * 1024)
+
+typedef int (*unpack_out)(void *arg, void *data, unsigned len);
+
+struct unpack_writer {
+	enum unpack_format format;
+	const char *error;
+
+	/* receives the decompressed data, returns < 0 to stop */
+	unpack_out out;
+	void *arg;
+	bool stopped;	/* out() failed */
+
+	/* decompressed data not passed on yet, UNPACK_OUT_SIZE bytes */
+	uint8_t *buf;
+	unsigned buf_len;
+
+	/* gzip: zlib only inflates the raw deflate data of each member */
+	z_stream zs;
+	bool zs_init;
+	unsigned gz_state;
+	uint8_t gz_hdr[10];	/* header or trailer field being collected */
+	unsigned gz_pos;
+	unsigned gz_skip;
+	uint8_t gz_flags;
+	uint32_t gz_size;	/* decompressed size of the current member */
+	unsigned gz_members;	/* complete members */
+#if WITH_LIB_LZ4
+	struct lz4_stream lz4;
+#endif
+};
+
+enum unpack_format unpack_detect(const void *data, unsigned len);
+
+/* size of the work area for unpack_writer_init(), cache line aligned */
+size_t unpack_work_size(enum unpack_format format);
+
+/*
+ * Decompress a gzip or LZ4 image that is passed through unpack_writer_write()
+ * in pieces of any size, in order. All functions return a negative value on
+ * error with a reason in uw->error (NULL if out() failed), the writer must be
+ * released with unpack_writer_free() anyway.
+ */
+int unpack_writer_init(struct unpack_writer *uw, enum unpack_format format,
+		       void *work, unpack_out out, void *arg);
+int unpack_writer_write(struct unpack_writer *uw, const void *data, unsigned len);
+int unpack_writer_finish(struct unpack_writer *uw);
+void unpack_writer_free(struct unpack_writer *uw);
+
+#endif /* __APP_UNPACK_H */
@@ -28,6 +28,10 @@
 #include <arch/defines.h>
 #include <platform.h>
 
+#if ARM_WITH_NEON
+int arm_neon_enabled;
+#endif
+
 #if ARM_CPU_CORTEX_A8
 static void set_vector_base(addr_t addr)
 {
@@ -66,6 +70,9 @@ void arch_early_init(void)
 	__asm__ volatile("mrc  p10, 7, %0, c8, c0, 0" : "=r" (val));
 	val |= (1<<30);
 	__asm__ volatile("mcr  p10, 7, %0, c8, c0, 0" :: "r" (val));
+
+	/* the string functions may use NEON from now on */
+	arm_neon_enabled = 1;
 #endif
 
 #if ARM_CPU_CORTEX_A8
@@ -32,6 +32,11 @@ extern "C" {
 
 void arm_context_switch(vaddr_t *old_sp, vaddr_t new_sp);
 
+#if ARM_WITH_NEON
+/* set once NEON is enabled, checked by memcpy/memset before using it */
+extern int arm_neon_enabled;
+#endif
+
 static inline uint32_t read_cpsr(void)
 {
 	uint32_t cpsr;
@@ -90,6 +95,10 @@ void arm_invalidate_tlb(void);
 void arm_write_mair0(uint32_t);
 void arm_write_mair1(uint32_t);
 void arm_write_ttbcr(uint32_t);
+void arm_clean_cache_lines(addr_t start, size_t len);
+void arm_clean_cache_all(void);
+void arm_clean_invalidate_cache_lines(addr_t start, size_t len);
+void arm_clean_invalidate_cache_all(void);
 void dump_fault_frame(struct arm_fault_frame *frame);
 
 uint32_t arm_read_dfsr(void);
@@ -53,6 +53,17 @@ void arm_mmu_init(void);
 
 #define MMU_MEMORY_XN               (0x1 << 4)
 #define MMU_MEMORY_PXN              (0x1 << 0)
+
+struct arm_mmu_mapping {
+	addr_t vaddr;
+	addr_t paddr;
+	uint size;
+	uint flags;
+	bool supersection;
+};
+
+typedef void (*arm_mmu_walk_cb)(const struct arm_mmu_mapping *map, void *data);
+void arm_mmu_walk_mappings(arm_mmu_walk_cb cb, void *data);
 #else /* LPAE */
 
 typedef enum
@@ -42,6 +42,14 @@
  #error unknown cpu
 #endif
 
+/*
+ * Above this size, cleaning the cache range line by line takes longer than
+ * cleaning the whole cache by set/way. Set to 0 to always clean by line.
+ */
+#ifndef CACHE_SETWAY_THRESHOLD
+#define CACHE_SETWAY_THRESHOLD (4*1024*1024)
+#endif
+
 #define IS_CACHE_LINE_ALIGNED(addr)  !((uint32_t) (addr) & (CACHE_LINE - 1))
 
 #if ARM_ISA_ARMV7
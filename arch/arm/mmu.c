@@ -34,6 +34,13 @@
 
 #define MB (1024*1024)
 
+/* Supersections map 16 MB with 16 identical consecutive entries */
+#define SUPERSECTION_MB		16
+#define SUPERSECTION_SIZE	(SUPERSECTION_MB*MB)
+#define DESC_TYPE_MASK		0x3
+#define DESC_TYPE_SECTION	0x2
+#define DESC_SUPERSECTION	(1<<18)
+
 /* the location of the table may be brought in from outside */
 #if WITH_EXTERNAL_TRANSLATION_TABLE
 #if !defined(MMU_TRANSLATION_TABLE_ADDR)
@@ -55,12 +62,77 @@ static inline uint32_t arm_mmu_section_desc(addr_t paddr, uint flags)
 	return (paddr & ~(MB-1)) | (0<<5) | (2<<0) | flags;
 }
 
+static inline uint32_t arm_mmu_supersection_desc(addr_t paddr, uint flags)
+{
+	/* Same as sections, but the domain bits are part of the address */
+	return (paddr & ~(SUPERSECTION_SIZE-1)) | DESC_SUPERSECTION |
+	       DESC_TYPE_SECTION | flags;
+}
+
+static inline bool arm_mmu_is_supersection(uint32_t desc)
+{
+	return (desc & DESC_TYPE_MASK) == DESC_TYPE_SECTION &&
+	       (desc & DESC_SUPERSECTION);
+}
+
+/* Section descriptor for the part of a supersection at the given index */
+static inline uint32_t arm_mmu_supersection_part(uint32_t desc, uint index)
+{
+	return ((desc & ~(SUPERSECTION_SIZE-1)) + (index % SUPERSECTION_MB) * MB) |
+	       (desc & (MB-1) & ~DESC_SUPERSECTION);
+}
+
+static bool arm_mmu_has_supersections(void)
+{
+#if ARM_ISA_ARMV7
+	uint32_t mmfr3;
+
+	/* ID_MMFR3.SuperSec: 0 if supersections are supported */
+	__asm__ volatile("mrc p15, 0, %0, c0, c1, 7" : "=r" (mmfr3));
+	return (mmfr3 >> 28) == 0;
+#else
+	return false;
+#endif
+}
+
+static bool arm_mmu_is_unmapped(uint index, uint count)
+{
+	uint i;
+
+	for (i = 0; i < count; ++i)
+		if (tt[index + i])
+			return false;
+	return true;
+}
+
+/*
+ * Split up the supersection at the given index into sections, so that parts
+ * of it can be changed. The entries must be removed from the TLB before
+ * they are replaced with the smaller sections.
+ */
+static void arm_mmu_split_supersection(uint index)
+{
+	uint i, first = index & ~(SUPERSECTION_MB-1);
+	uint32_t desc = tt[first];
+
+	if (!arm_mmu_is_supersection(desc))
+		return;
+
+	for (i = 0; i < SUPERSECTION_MB; ++i)
+		tt[first + i] = 0;
+	arm_mmu_flush();
+
+	for (i = 0; i < SUPERSECTION_MB; ++i)
+		tt[first + i] = arm_mmu_supersection_part(desc, first + i);
+}
+
 void arm_mmu_map_section(addr_t paddr, addr_t vaddr, uint flags)
 {
 	int index;
 
 	/* Get the index into the translation table */
 	index = vaddr / MB;
+	arm_mmu_split_supersection(index);
 
 	/* Set the entry value */
 	tt[index] = arm_mmu_section_desc(paddr, flags);
@@ -118,8 +190,8 @@ bool arm_mmu_try_map_sections(addr_t paddr, addr_t vaddr, uint size, uint flags)
 {
 	/* Round up to next MB and handle offsets within sections */
 	uint mb = (size + (paddr % MB) + MB - 1) / MB;
-	uint i, index = vaddr / MB;
-	bool fully_mapped = true;
+	uint i, j, index = vaddr / MB;
+	bool fully_mapped = true, super;
 
 	/* Offset within mapped section must be equal */
 	if (size == 0 || (paddr % MB) != (vaddr % MB))
@@ -128,11 +200,15 @@ bool arm_mmu_try_map_sections(addr_t paddr, addr_t vaddr, uint size, uint flags)
 	/* Check if any existing mappings conflict */
 	for (i = 0; i < mb; ++i) {
 		uint32_t desc = arm_mmu_section_desc(paddr + i * MB, flags);
-		if (!tt[index + i]) {
+		uint32_t cur = tt[index + i];
+
+		if (!cur) {
 			fully_mapped = false;
 			continue;
 		}
-		if (tt[index + i] != desc) {
+		if (arm_mmu_is_supersection(cur))
+			cur = arm_mmu_supersection_part(cur, index + i);
+		if (cur != desc) {
 			dprintf(CRITICAL, "MMU mapping mismatch @ %#08x: %#08x != %#08x\n",
 				(index + i) * MB, tt[index + i], desc);
 			return false;
@@ -141,13 +217,74 @@ bool arm_mmu_try_map_sections(addr_t paddr, addr_t vaddr, uint size, uint flags)
 	if (fully_mapped)
 		return true;
 
-	/* Add the new mappings */
-	for (i = 0; i < mb; ++i)
-		tt[index + i] = arm_mmu_section_desc(paddr + i * MB, flags);
+	/*
+	 * Add the new mappings, using supersections where they cover 16 MB
+	 * that are aligned. Only entries that were not mapped before are
+	 * combined, changing the size of existing entries would need them
+	 * to be unmapped for a moment first.
+	 */
+	super = arm_mmu_has_supersections() &&
+		(paddr % SUPERSECTION_SIZE) == (vaddr % SUPERSECTION_SIZE);
+	for (i = 0; i < mb; ++i) {
+		if (super && (index + i) % SUPERSECTION_MB == 0 &&
+		    mb - i >= SUPERSECTION_MB &&
+		    arm_mmu_is_unmapped(index + i, SUPERSECTION_MB)) {
+			uint32_t desc = arm_mmu_supersection_desc(paddr + i * MB, flags);
+
+			for (j = 0; j < SUPERSECTION_MB; ++j)
+				tt[index + i + j] = desc;
+			i += SUPERSECTION_MB - 1;
+			continue;
+		}
+		if (!tt[index + i])
+			tt[index + i] = arm_mmu_section_desc(paddr + i * MB, flags);
+	}
 	arm_mmu_flush();
 	return true;
 }
 
+void arm_mmu_walk_mappings(arm_mmu_walk_cb cb, void *data)
+{
+	struct arm_mmu_mapping map = {0};
+	uint i;
+
+	/* Merge consecutive entries with the same type and flags */
+	for (i = 0; i < 4096; ++i) {
+		uint32_t desc = tt[i];
+		bool super;
+		uint flags;
+
+		if ((desc & DESC_TYPE_MASK) != DESC_TYPE_SECTION) {
+			if (map.size)
+				cb(&map, data);
+			map.size = 0;
+			continue;
+		}
+
+		super = arm_mmu_is_supersection(desc);
+		if (super)
+			desc = arm_mmu_supersection_part(desc, i);
+		flags = desc & (MB-1) & ~DESC_TYPE_MASK;
+
+		if (map.size && map.supersection == super && map.flags == flags &&
+		    map.vaddr + map.size == i * MB &&
+		    map.paddr + map.size == (desc & ~(MB-1))) {
+			map.size += MB;
+			continue;
+		}
+
+		if (map.size)
+			cb(&map, data);
+		map.vaddr = i * MB;
+		map.paddr = desc & ~(MB-1);
+		map.size = MB;
+		map.flags = flags;
+		map.supersection = super;
+	}
+	if (map.size)
+		cb(&map, data);
+}
+
 void arm_mmu_flush(void)
 {
 	arch_clean_cache_range((vaddr_t)&tt, sizeof(tt));
@@ -21,6 +21,10 @@ DEFINES += \
 	ARM_WITH_L2=1
 CFLAGS += -mcpu=$(ARM_CPU)
 #CFLAGS += -mcpu=arm1136jf-s # compiler doesn't understand cortex yet
+# ARMv8 platforms still build for ARMv7, but can schedule for their cores
+ifneq ($(ARM_TUNE),)
+CFLAGS += -mtune=$(ARM_TUNE)
+endif
 HANDLED_CORE := true
 #CFLAGS += -mfpu=vfp -mfloat-abi=softfp
 endif
@@ -39,6 +39,11 @@ struct context_switch_frame {
 	vaddr_t lr;
 	vaddr_t usp;
 	vaddr_t ulr;
+#if ARM_WITH_NEON
+	uint32_t neon[64];	/* d0-d31 */
+	uint32_t fpscr;
+	uint32_t pad;
+#endif
 };
 
 extern void arm_context_switch(addr_t *old_sp, addr_t new_sp);
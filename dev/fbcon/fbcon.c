@@ -42,6 +42,10 @@
 
 #include "font5x12.h"
 
+#if WITH_LK2ND_PERF
+#include <lk2nd/perf.h>
+#endif
+
 struct pos {
 	int x;
 	int y;
@@ -86,6 +90,11 @@ static uint32_t			SELECT_BGCOLOR;
 
 static struct pos		cur_pos;
 static struct pos		max_pos;
+
+/* rows of pixels changed since the last flush, empty if dirty_y0 >= dirty_y1 */
+static unsigned			dirty_y0;
+static unsigned			dirty_y1;
+
 static struct fb_color		*fb_color_formats;
 static struct fb_color		fb_color_formats_555[] = {
 					[FBCON_COMMON_MSG] = {RGB565_WHITE, RGB565_BLACK},
@@ -110,71 +119,126 @@ static struct fb_color		fb_color_formats_888[] = {
 					[FBCON_SELECT_MSG_BG_COLOR] = {RGB888_WHITE, RGB888_BLUE}};
 
 
+static void fbcon_mark_dirty(unsigned y, unsigned h)
+{
+	unsigned y1 = MIN(y + h, config->height);
+
+	if (y >= y1)
+		return;
+
+	if (dirty_y0 >= dirty_y1) {
+		dirty_y0 = y;
+		dirty_y1 = y1;
+	} else {
+		dirty_y0 = MIN(dirty_y0, y);
+		dirty_y1 = MAX(dirty_y1, y1);
+	}
+}
+
+static void fbcon_mark_all_dirty(void)
+{
+	fbcon_mark_dirty(0, config->height);
+}
+
+/*
+ * Fill whole rows with one color. Only the first pixel is written one byte at
+ * a time, the rest is copied from the part that is already filled, so most of
+ * the work is done by a few large memcpy() calls.
+ */
+static void fbcon_fill_rows(unsigned y, unsigned h, uint32_t color)
+{
+	unsigned bpp = config->bpp / 8;
+	size_t total = (size_t)config->width * h * bpp;
+	uint8_t *pixels = (uint8_t *)config->base + y * config->width * bpp;
+	size_t filled, n;
+	unsigned j;
+
+	if (!total)
+		return;
+
+	for (j = 0; j < bpp; j++)
+		pixels[j] = color >> (j * 8);
+
+	/* All bytes the same (e.g. black) */
+	for (j = 1; j < bpp && pixels[j] == pixels[0]; j++);
+	if (j == bpp) {
+		memset(pixels, pixels[0], total);
+		return;
+	}
+
+	for (filled = bpp; filled < total; filled += n) {
+		n = MIN(filled, total - filled);
+		memcpy(pixels + filled, pixels, n);
+	}
+}
+
+/*
+ * A line of pixels in the current text color, in framebuffer format. Glyphs
+ * are drawn by copying runs of set pixels out of it, so each pixel does not
+ * have to be expanded from the font byte by byte. The size is a multiple of
+ * all supported bytes per pixel.
+ */
+static uint8_t			glyph_line[480];
+static uint32_t			glyph_line_color;
+static unsigned			glyph_line_bpp;
+
+static void fbcon_glyph_line_setup(uint32_t paint, unsigned bpp)
+{
+	unsigned i, j;
+
+	if (glyph_line_bpp == bpp && glyph_line_color == paint)
+		return;
+
+	for (i = 0; i < sizeof(glyph_line); i += bpp)
+		for (j = 0; j < bpp; j++)
+			glyph_line[i + j] = paint >> (j * 8);
+
+	glyph_line_color = paint;
+	glyph_line_bpp = bpp;
+}
+
+static void fbcon_glyph_run(char *pixels, size_t len)
+{
+	size_t n;
+
+	while (len) {
+		n = MIN(len, sizeof(glyph_line));
+		memcpy(pixels, glyph_line, n);
+		pixels += n;
+		len -= n;
+	}
+}
+
 static void fbcon_drawglyph(char *pixels, uint32_t paint, unsigned stride,
 			    unsigned bpp, unsigned *glyph, unsigned scale_factor)
 {
-	unsigned x, y, i, j, k;
-	unsigned data, temp;
-	uint32_t fg_color = paint;
-	stride -= FONT_WIDTH * scale_factor;
+	unsigned x, y, i, start, bits;
+	size_t scaled = scale_factor * bpp;
+#if WITH_LK2ND_PERF
+	LK2ND_PERF_SCOPE("fbcon_drawglyph");
+#endif
+
 	last_scale_factor = scale_factor;
+	fbcon_glyph_line_setup(paint, bpp);
 
-	data = glyph[0];
-	for (y = 0; y < FONT_HEIGHT / 2; ++y) {
-		temp = data;
-		for (i = 0; i < scale_factor; i++) {
-			data = temp;
-			for (x = 0; x < FONT_WIDTH; ++x) {
-				if (data & 1) {
-					for (j = 0; j < scale_factor; j++) {
-						fg_color = paint;
-						for (k = 0; k < bpp; k++) {
-							*pixels = (unsigned char) fg_color;
-							fg_color = fg_color >> 8;
-							pixels++;
-						}
-					}
-				}
-				else
-				{
-					for (j = 0; j < scale_factor; j++) {
-						pixels = pixels + bpp;
-					}
-				}
-				data >>= 1;
-			}
-			pixels += (stride * bpp);
-		}
-	}
+	/* Each word of the glyph holds 6 rows of 5 bits each */
+	for (y = 0; y < FONT_HEIGHT; ++y) {
+		bits = glyph[y / (FONT_HEIGHT / 2)] >> ((y % (FONT_HEIGHT / 2)) * FONT_WIDTH);
 
-	data = glyph[1];
-	for (y = 0; y < FONT_HEIGHT / 2; ++y) {
-		temp = data;
 		for (i = 0; i < scale_factor; i++) {
-			data = temp;
+			/* Only the set pixels are drawn, the rest stays as it is */
 			for (x = 0; x < FONT_WIDTH; ++x) {
-				if (data & 1) {
-					for (j = 0; j < scale_factor; j++) {
-						fg_color = paint;
-						for (k = 0; k < bpp; k++) {
-							*pixels = (unsigned char) fg_color;
-							fg_color = fg_color >> 8;
-							pixels++;
-						}
-					}
-				}
-				else
-				{
-					for (j = 0; j < scale_factor; j++) {
-						pixels = pixels + bpp;
-					}
-				}
-				data >>= 1;
+				if (!(bits & (1 << x)))
+					continue;
+
+				start = x;
+				while (x + 1 < FONT_WIDTH && (bits & (1 << (x + 1))))
+					x++;
+				fbcon_glyph_run(pixels + start * scaled, (x - start + 1) * scaled);
 			}
-			pixels += (stride * bpp);
+			pixels += stride * bpp;
 		}
 	}
-
 }
 
 void fbcon_draw_msg_background(unsigned y_start, unsigned y_end,
@@ -192,6 +256,7 @@ void fbcon_draw_msg_background(unsigned y_start, unsigned y_end,
 	count = config->width * (FONT_HEIGHT * (y_end - y_start) - 1);
 	pixels = config->base;
 	pixels += y_start * ((config->bpp / 8) * FONT_HEIGHT * config->width);
+	fbcon_mark_dirty(y_start * FONT_HEIGHT, (y_end - y_start) * FONT_HEIGHT);
 
 	if (update) {
 		bg_color = SELECT_BGCOLOR;
@@ -221,24 +286,38 @@ void fbcon_draw_msg_background(unsigned y_start, unsigned y_end,
 	fbcon_flush();
 }
 
+/*
+ * Write back the rows that were drawn since the last flush and start a display
+ * update. If nothing was drawn through fbcon, the caller wrote to the
+ * framebuffer directly and the whole screen is flushed.
+ */
 void fbcon_flush(void)
 {
-	unsigned total_x, total_y;
-	unsigned bytes_per_bpp;
+	unsigned row_bytes, y, h;
+#if WITH_LK2ND_PERF
+	LK2ND_PERF_SCOPE("fbcon_flush");
+#endif
 
 	/* ignore anything that happens before fbcon is initialized */
 	if (!config)
 		return;
 
-	if (config->update_start)
+	if (dirty_y0 >= dirty_y1)
+		fbcon_mark_all_dirty();
+
+	y = dirty_y0;
+	h = dirty_y1 - dirty_y0;
+	row_bytes = config->width * (config->bpp / 8);
+	arch_clean_invalidate_cache_range((addr_t)config->base + y * row_bytes,
+					  h * row_bytes);
+	dirty_y0 = dirty_y1 = 0;
+
+	if (config->update_rows)
+		config->update_rows(y, h);
+	else if (config->update_start)
 		config->update_start();
 	if (config->update_done)
 		while (!config->update_done());
-
-	total_x = config->width;
-	total_y = config->height;
-	bytes_per_bpp = ((config->bpp) / 8);
-	arch_clean_invalidate_cache_range((addr_t) config->base, (total_x * total_y * bytes_per_bpp));
 }
 
 static void fbcon_scroll_up(void)
@@ -258,10 +337,10 @@ static void fbcon_scroll_up(void)
 	count = config->width * (config->height - font_h) * bpp;
 	memmove(dst, src, count);
 
-	dst += count;
-	count = config->width * font_h * bpp;
-	memset(dst, 0, count); /* FIXME: ignores color */
+	fbcon_fill_rows(config->height - font_h, font_h,
+			fb_color_formats[FBCON_COMMON_MSG].bg);
 
+	fbcon_mark_all_dirty();
 	fbcon_flush();
 }
 
@@ -281,6 +360,7 @@ void fbcon_draw_line(uint32_t type)
 	pixels = config->base;
 	pixels += cur_pos.y * ((config->bpp / 8) * FONT_HEIGHT * config->width);
 	pixels += cur_pos.x * ((config->bpp / 8) * (FONT_WIDTH + 1));
+	fbcon_mark_dirty(cur_pos.y * FONT_HEIGHT, 1);
 
 	for (i = 0; i < (int)config->width; i++) {
 		tmp_color = line_color;
@@ -308,55 +388,29 @@ static void fbcon_set_colors(int type)
 
 void fbcon_clear(void)
 {
-	unsigned long i = 0, j = 0;
-	unsigned char *pixels = NULL;
-	unsigned count;
-	uint32_t bg_color;
-
 	/* ignore anything that happens before fbcon is initialized */
 	if (!config)
 		return;
 
-	pixels = config->base;
-	count =  config->width * config->height;
-
 	fbcon_set_colors(FBCON_COMMON_MSG);
-	for (i = 0; i < count; i++) {
-		bg_color = BGCOLOR;
-		for (j = 0; j < (config->bpp / 8); j++) {
-			*pixels = (unsigned char) bg_color;
-			bg_color = bg_color >> 8;
-			pixels++;
-		}
-	}
+	fbcon_fill_rows(0, config->height, BGCOLOR);
+	fbcon_mark_all_dirty();
 	cur_pos.x = 0;
 	cur_pos.y = 0;
 }
 
 void fbcon_clear_msg(unsigned y_start, unsigned y_end)
 {
-	unsigned i, j;
-	uint32_t bg_color;
-	char *pixels;
-	unsigned count;
-
 	/* ignore anything that happens before fbcon is initialized */
-	if (!config)
+	if (!config || y_end <= y_start)
 		return;
 
-	count = config->width * (FONT_HEIGHT * (y_end - y_start) - 1);
-	pixels = config->base;
-	pixels += y_start * ((config->bpp / 8) * FONT_HEIGHT * config->width);
+	fbcon_mark_dirty(y_start * FONT_HEIGHT, (y_end - y_start) * FONT_HEIGHT);
 
+	/* the last row of pixels is left alone */
 	fbcon_set_colors(FBCON_COMMON_MSG);
-	for (i = 0; i < count; i++) {
-		bg_color = BGCOLOR;
-		for (j = 0; j < (config->bpp / 8); j++) {
-			*pixels = (unsigned char) bg_color;
-			bg_color = bg_color >> 8;
-			pixels++;
-		}
-	}
+	fbcon_fill_rows(y_start * FONT_HEIGHT,
+			FONT_HEIGHT * (y_end - y_start) - 1, BGCOLOR);
 }
 
 void fbcon_putc_factor_xy(char c, int type, unsigned scale_factor, int x, int y)
@@ -375,6 +429,7 @@ void fbcon_putc_factor_xy(char c, int type, unsigned scale_factor, int x, int y)
 	pixels = config->base;
 	pixels += y * (config->bpp / 8) * config->width;
 	pixels += x * (config->bpp / 8);
+	fbcon_mark_dirty(y, FONT_HEIGHT * scale_factor);
 
 	fbcon_drawglyph(pixels, FGCOLOR, config->stride, (config->bpp / 8),
 			font5x12 + (c - 32) * 2, scale_factor);
@@ -417,6 +472,7 @@ void fbcon_putc_factor(char c, int type, unsigned scale_factor, int y_start)
 	}
 	pixels += cur_pos.y * ((config->bpp / 8) * FONT_HEIGHT * config->width);
 	pixels += cur_pos.x * scale_factor * ((config->bpp / 8) * (FONT_WIDTH + 1));
+	fbcon_mark_dirty(cur_pos.y * FONT_HEIGHT, FONT_HEIGHT * scale_factor);
 
 	fbcon_drawglyph(pixels, FGCOLOR, config->stride, (config->bpp / 8),
 			font5x12 + (c - 32) * 2, scale_factor);
@@ -442,6 +498,103 @@ void fbcon_putc(char c, int y_start)
 	fbcon_putc_factor(c, FBCON_COMMON_MSG, SCALE_FACTOR, y_start);
 }
 
+/*
+ * Move pos over c like fbcon_putc() does. glyph is set to the position c is
+ * drawn at, or x = -1 if nothing is drawn. Returns 1 if the screen scrolls.
+ */
+static unsigned fbcon_console_step(char c, struct pos *pos, struct pos *glyph)
+{
+	glyph->x = -1;
+
+	if ((unsigned char)c > 127)
+		return 0;
+
+	if ((unsigned char)c < 32) {
+		if (c == '\n')
+			goto newline;
+		if (c == '\r')
+			pos->x = 0;
+		return 0;
+	}
+
+	if (pos->x == 0 && c == ' ')
+		return 0;
+
+	*glyph = *pos;
+	pos->x++;
+	if (pos->x < (int)(max_pos.x / SCALE_FACTOR))
+		return 0;
+
+newline:
+	pos->y += SCALE_FACTOR;
+	pos->x = 0;
+	if (pos->y < max_pos.y)
+		return 0;
+
+	pos->y = max_pos.y - 1;
+	return 1;
+}
+
+/*
+ * Same output as fbcon_putc() for every character of str, but the screen is
+ * scrolled once by all the lines of the text and flushed once at the end.
+ * Lines that the rest of the text scrolls out of the screen are not drawn.
+ */
+void fbcon_write(const char *str, size_t len)
+{
+	unsigned font_h = FONT_HEIGHT * SCALE_FACTOR;
+	unsigned bpp, shift, scrolls = 0, i;
+	struct pos pos, glyph;
+	char *pixels;
+	int y;
+
+	/* ignore anything that happens before fbcon is initialized */
+	if (!config)
+		return;
+
+	pos = cur_pos;
+	for (i = 0; i < len; i++)
+		scrolls += fbcon_console_step(str[i], &pos, &glyph);
+
+	bpp = config->bpp / 8;
+	if (scrolls) {
+		if (scrolls > config->height / font_h)
+			shift = config->height;
+		else
+			shift = scrolls * font_h;
+		memmove(config->base,
+			(char *)config->base + config->width * shift * bpp,
+			config->width * (config->height - shift) * bpp);
+		fbcon_fill_rows(config->height - shift, shift,
+				fb_color_formats[FBCON_COMMON_MSG].bg);
+		fbcon_mark_all_dirty();
+	}
+
+	fbcon_set_colors(FBCON_COMMON_MSG);
+	for (i = 0; i < len; i++) {
+		/* The glyph moves up with all scrolls from here on */
+		y = -(int)(scrolls * font_h);
+		scrolls -= fbcon_console_step(str[i], &cur_pos, &glyph);
+		if (glyph.x < 0)
+			continue;
+
+		y += glyph.y * FONT_HEIGHT;
+		if (y < 0)
+			continue;
+
+		pixels = config->base;
+		pixels += y * bpp * config->width;
+		pixels += glyph.x * SCALE_FACTOR * (bpp * (FONT_WIDTH + 1));
+		fbcon_mark_dirty(y, font_h);
+
+		fbcon_drawglyph(pixels, FGCOLOR, config->stride, bpp,
+				font5x12 + (str[i] - 32) * 2, SCALE_FACTOR);
+	}
+
+	if (dirty_y0 < dirty_y1)
+		fbcon_flush();
+}
+
 uint32_t fbcon_get_current_line(void)
 {
 	return cur_pos.y;
@@ -499,6 +652,7 @@ void fbcon_setup(struct fbcon_config *_config)
 	cur_pos.y = 0;
 	max_pos.x = config->width / (FONT_WIDTH+1);
 	max_pos.y = (config->height - 1) / FONT_HEIGHT - 1;
+	dirty_y0 = dirty_y1 = 0;
 
 #if !DISPLAY_SPLASH_SCREEN
 	fbcon_clear();
@@ -538,30 +692,41 @@ void fbcon_extract_to_screen(logo_img_header *header, void* address)
 		uint8_t run = *(imagestart + pos);
 		bool repeat_run = (run & 0x80);
 		uint runlen = (run & 0x7f) + 1;
-		uint runpos;
 
 		/* consume the run byte */
 		pos++;
 
 		p = base + (y * config->width + x) * 3;
 
-		/* start of a run */
-		for (runpos = 0; runpos < runlen; runpos++) {
-			*p++ = *(imagestart + pos);
-			*p++ = *(imagestart + pos + 1);
-			*p++ = *(imagestart + pos + 2);
-			count++;
-
-			x++;
+		/*
+		 * Copy the whole run at once. A repeated pixel is written once
+		 * and then doubled with memcpy(), like fbcon_fill_rows().
+		 */
+		if (repeat_run) {
+			const uint8_t *px = imagestart + pos;
+			size_t filled, n, total = runlen * 3;
+
+			p[0] = px[0];
+			p[1] = px[1];
+			p[2] = px[2];
+			if (px[0] == px[1] && px[1] == px[2]) {
+				memset(p, px[0], total);
+			} else {
+				for (filled = 3; filled < total; filled += n) {
+					n = MIN(filled, total - filled);
+					memcpy(p + filled, p, n);
+				}
+			}
 
-			/* if a run of raw pixels, consume an input pixel */
-			if (!repeat_run)
-				pos += 3;
+			/* consume the one input pixel we repeated */
+			pos += 3;
+		} else {
+			memcpy(p, imagestart + pos, runlen * 3);
+			pos += runlen * 3;
 		}
 
-		/* if this was a run of repeated pixels, consume the one input pixel we repeated */
-		if (repeat_run)
-			pos += 3;
+		count += runlen;
+		x += runlen;
 
 		/* the generator will keep compressing data line by line */
 		/* don't cross the lines */
@@ -37,6 +37,7 @@
 #include <board.h>
 #include <mdp5.h>
 #include <qtimer.h>
+#include <kernel/thread.h>
 #include <platform/gpio.h>
 #include <mipi_dsi.h>
 #include <partition_parser.h>
@@ -146,7 +147,7 @@ static int mdss_dsi_panel_pre_init(void)
 	}
 
 	if(panelstruct.paneldata->panel_init_delay)
-		udelay(panelstruct.paneldata->panel_init_delay);
+		thread_usleep(panelstruct.paneldata->panel_init_delay);
 
 	dprintf(SPEW, "Panel pre init done\n");
 	return ret;
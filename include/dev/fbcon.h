@@ -31,6 +31,7 @@
 #ifndef __DEV_FBCON_H
 #define __DEV_FBCON_H
 
+#include <stddef.h>
 #include <stdint.h>
 #define LOGO_IMG_OFFSET (12*1024*1024)
 #define LOGO_IMG_MAGIC "SPLASH!!"
@@ -102,10 +103,13 @@ struct fbcon_config {
 
 	void		(*update_start)(void);
 	int		(*update_done)(void);
+	/* optional, used instead of update_start() to update only some rows */
+	void		(*update_rows)(unsigned y, unsigned h);
 };
 
 void fbcon_setup(struct fbcon_config *cfg);
 void fbcon_putc(char c, int y_start);
+void fbcon_write(const char *str, size_t len);
 void fbcon_clear(void);
 void fbcon_clear_msg(unsigned y_start, unsigned y_end);
 struct fbcon_config* fbcon_display(void);
@@ -134,6 +134,78 @@ struct __attribute__ ((packed)) ubi_vid_hdr {
 #define UBI_VID_DYNAMIC 1
 #define UBI_LAYOUT_VOLUME_TYPE UBI_VID_DYNAMIC
 #define UBI_FM_SB_VOLUME_ID	(UBI_INTERNAL_VOL_START + 1)
+#define UBI_FM_DATA_VOLUME_ID	(UBI_INTERNAL_VOL_START + 2)
+
+/* Fastmap, as written by Linux (CONFIG_MTD_UBI_FASTMAP) */
+#define UBI_FM_FMT_VERSION	2
+#define UBI_FM_SB_MAGIC		0x7B11D69F
+#define UBI_FM_HDR_MAGIC	0xD4B82EF7
+#define UBI_FM_VHDR_MAGIC	0xFA370ED1
+#define UBI_FM_POOL_MAGIC	0x67AF4D08
+#define UBI_FM_EBA_MAGIC	0xf0c040a8
+/* The superblock is in one of the first UBI_FM_MAX_START PEBs */
+#define UBI_FM_MAX_START	64
+#define UBI_FM_MAX_BLOCKS	32
+#define UBI_FM_MAX_POOL_SIZE	256
+
+/* Fastmap superblock, at the start of the LEB data of its PEB */
+struct __attribute__ ((packed)) ubi_fm_sb {
+	uint32_t  magic;
+	uint8_t   version;
+	uint8_t   padding1[3];
+	uint32_t  data_crc;
+	uint32_t  used_blocks;
+	uint32_t  block_loc[UBI_FM_MAX_BLOCKS];
+	uint32_t  block_ec[UBI_FM_MAX_BLOCKS];
+	uint64_t  sqnum;
+	uint8_t   padding2[32];
+};
+
+/* Follows the superblock, counts of the lists that follow */
+struct __attribute__ ((packed)) ubi_fm_hdr {
+	uint32_t  magic;
+	uint32_t  free_peb_count;
+	uint32_t  used_peb_count;
+	uint32_t  scrub_peb_count;
+	uint32_t  bad_peb_count;
+	uint32_t  erase_peb_count;
+	uint32_t  vol_count;
+	uint8_t   padding[4];
+};
+
+/* PEBs that may have been written after the fastmap, two of them */
+struct __attribute__ ((packed)) ubi_fm_scan_pool {
+	uint32_t  magic;
+	uint16_t  size;
+	uint16_t  max_size;
+	uint32_t  pebs[UBI_FM_MAX_POOL_SIZE];
+	uint32_t  padding[4];
+};
+
+/* Entry of the free, used, scrub and erase lists */
+struct __attribute__ ((packed)) ubi_fm_ec {
+	uint32_t  pnum;
+	uint32_t  ec;
+};
+
+/* Per volume, followed by struct ubi_fm_eba */
+struct __attribute__ ((packed)) ubi_fm_volhdr {
+	uint32_t  magic;
+	uint32_t  vol_id;
+	uint8_t   vol_type;
+	uint8_t   padding1[3];
+	uint32_t  data_pad;
+	uint32_t  used_ebs;
+	uint32_t  last_eb_bytes;
+	uint8_t   padding2[8];
+};
+
+/* LEB to PEB map of a volume, unmapped LEBs are -1 */
+struct __attribute__ ((packed)) ubi_fm_eba {
+	uint32_t  magic;
+	uint32_t  reserved_pebs;
+	uint32_t  pnum[0];
+};
 
 /* A record in the UBI volume table. */
 struct __attribute__ ((packed)) ubi_vtbl_record {
@@ -71,6 +71,12 @@ struct udc_gadget {
 	unsigned flags;
 
 	struct udc_endpoint **ept;
+
+	/* UAS pipe IDs of the endpoints, adds pipe usage descriptors if set */
+	const unsigned char *pipe_usage;
+
+	/* Reported by the mass storage GET MAX LUN request */
+	unsigned char max_lun;
 };
 
 struct udc_device {
@@ -135,6 +141,7 @@ int udc_stop(void);
 #define TYPE_OTHER_SPEED_CONFIG        7
 #define TYPE_BOS             15
 #define TYPE_DEVICE_CAP      16
+#define TYPE_PIPE_USAGE      36
 #define TYPE_SS_EP_COMP      48
 
 #define DEVICE_READ          0x80
@@ -32,7 +32,39 @@ typedef void (*dpc_callback)(void *arg);
 
 #define DPC_FLAG_NORESCHED 0x1
 
+/*
+ * dpc_queue() allocates the entry, so it must not be used from interrupt
+ * handlers. Callbacks queued with it run on the high priority worker.
+ */
 status_t dpc_queue(dpc_callback, void *arg, uint flags);
 
+/*
+ * Work items are deferred calls provided by the caller, usually embedded in
+ * a driver struct, so queueing one does not allocate and is safe from
+ * interrupt handlers (use DPC_FLAG_NORESCHED there). Each priority has its
+ * own worker thread, so a long low priority job (e.g. hashing) does not
+ * delay the high priority ones (e.g. I/O completion bookkeeping).
+ *
+ * An item can be queued again as soon as its callback has started, also
+ * from the callback itself. The callback may free the item.
+ */
+enum dpc_work_priority {
+	DPC_WORK_LOW,
+	DPC_WORK_NORMAL,
+	DPC_WORK_HIGH,
+	DPC_WORK_NUM_PRIORITIES,
+};
+
+struct dpc_work {
+	struct list_node node;
+	dpc_callback cb;
+	void *arg;
+	bool queued;
+};
+
+void dpc_work_init(struct dpc_work *work, dpc_callback cb, void *arg);
+status_t dpc_work_queue(struct dpc_work *work, enum dpc_work_priority prio, uint flags);
+bool dpc_work_cancel(struct dpc_work *work);
+
 #endif
 
@@ -28,6 +28,7 @@
 #include <compiler.h>
 #include <arch/ops.h>
 #include <arch/thread.h>
+#include <kernel/dpc.h>
 
 enum thread_state {
 	THREAD_SUSPENDED = 0,
@@ -47,6 +48,15 @@ enum thread_tls_list {
 
 #define THREAD_MAGIC 'thrd'
 
+/* thread level statistics, can also be enabled through DEFINES */
+#ifndef THREAD_STATS
+#if DEBUGLEVEL > 1
+#define THREAD_STATS 1
+#else
+#define THREAD_STATS 0
+#endif
+#endif
+
 typedef struct thread {
 	int magic;
 	struct list_node thread_list_node;
@@ -76,9 +86,19 @@ typedef struct thread {
 	/* return code */
 	int retcode;
 
+	/* frees the thread after it exited, without allocating in thread_exit() */
+	struct dpc_work cleanup_work;
+
 	/* thread local storage */
 	uint32_t tls[MAX_TLS_ENTRY];
 
+#if THREAD_STATS
+	/* time spent running and how often the thread was switched to */
+	bigtime_t runtime;
+	bigtime_t last_run_timestamp;
+	uint context_switches;
+#endif
+
 	char name[32];
 } thread_t;
 
@@ -95,6 +115,15 @@ typedef struct thread {
 /* stack size  - 12kb per thread (12 * 1024) */
 #define DEFAULT_STACK_SIZE 12288
 
+/*
+ * for threads that only poll or wait for hardware in a loop, with room for
+ * interrupt handlers, which run on the stack of the interrupted thread
+ */
+#define SMALL_STACK_SIZE 4096
+
+/* shorter delays in thread_usleep() are busy-waits, in us */
+#define THREAD_USLEEP_MIN 2000
+
 /* functions */
 void thread_init_early(void);
 void thread_init(void);
@@ -105,6 +134,7 @@ thread_t *thread_create(const char *name, thread_start_routine entry, void *arg,
 status_t thread_resume(thread_t *);
 void thread_exit(int retcode) __NO_RETURN;
 void thread_sleep(time_t delay);
+void thread_usleep(unsigned usecs);
 
 void dump_thread(thread_t *t);
 void dump_all_threads(void);
@@ -204,12 +234,6 @@ int wait_queue_wake_all(wait_queue_t *, bool reschedule, status_t wait_queue_err
  */
 status_t thread_unblock_from_wait_queue(thread_t *t, bool reschedule, status_t wait_queue_error);
 
-/* thread level statistics */
-#if DEBUGLEVEL > 1
-#define THREAD_STATS 1
-#else
-#define THREAD_STATS 0
-#endif
 #if THREAD_STATS
 struct thread_stats {
 	bigtime_t idle_time;
@@ -27,6 +27,22 @@
 
 typedef void * bcache_t;
 
+struct bcache_stats {
+	uint32_t hits;
+	uint32_t depth;
+	uint32_t misses;
+	uint32_t reads;
+	uint32_t writes;
+	uint32_t flushes;
+};
+
+struct bcache_info {
+	const char *name;
+	size_t block_size;
+	int count;
+	struct bcache_stats stats;
+};
+
 bcache_t bcache_create(bdev_t *dev, size_t block_size, int block_count);
 void bcache_destroy(bcache_t);
 
@@ -36,5 +52,16 @@ int bcache_read_block(bcache_t, void *, uint block);
 int bcache_get_block(bcache_t, void **, uint block);
 int bcache_put_block(bcache_t, uint block);
 
+// writes are kept in the cache until bcache_flush() or a dirty block is
+// evicted, then all dirty blocks are written back sorted and merged
+int bcache_mark_block_dirty(bcache_t, uint block);
+int bcache_zero_block(bcache_t, uint block);
+int bcache_flush(bcache_t);
+
+// statistics, bcache_next(NULL) returns the first cache
+void bcache_get_info(bcache_t, struct bcache_info *);
+bcache_t bcache_next(bcache_t);
+void bcache_dump(bcache_t, const char *name);
+
 #endif
 
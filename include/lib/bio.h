@@ -26,10 +26,72 @@
 #include <sys/types.h>
 #include <list.h>
 
+#include <kernel/event.h>
 #include <kernel/mutex.h>
 
 typedef uint32_t bnum_t;
 
+struct bio_queue;
+
+/* asynchronous request, see bio_submit() */
+struct bio_request {
+	struct list_node node;
+	struct bdev *dev;
+
+	bool write;
+	void *buf;
+	off_t offset;
+	size_t len;
+
+	/* bytes transferred or negative error, valid after completion */
+	ssize_t result;
+
+	/* optional, called in the context of the I/O thread on completion */
+	void (*complete)(struct bio_request *req);
+	void *cookie;
+
+	event_t done;
+};
+
+/* one extent of a scatter-gather read, see bio_readv() */
+struct bio_vec {
+	void *buf;
+	off_t offset;
+	size_t len;
+};
+
+/*
+ * I/O accounting of a block device: requests handed to the driver hooks
+ * and their latency. Requests to a subdevice are also counted on the
+ * parent. See bio_dump_devices() and "fastboot oem bio-stats".
+ */
+#define BIO_STATS_HIST_BUCKETS		16
+
+struct bio_stats_dir {
+	uint32_t ops;
+	uint32_t errors;
+	uint64_t bytes;
+	bigtime_t total_us;
+	/* requests that took < (2 << i) us, the last bucket counts the rest */
+	uint32_t hist[BIO_STATS_HIST_BUCKETS];
+};
+
+struct bio_stats {
+	struct bio_stats_dir read;
+	struct bio_stats_dir write;
+	uint32_t merged;	/* extents read together with the previous one by readv */
+	uint32_t bounced;	/* (partial) blocks copied through a temporary buffer */
+};
+
+/* bdev flags */
+#define BIO_FLAGS_NONE			(0 << 0)
+/* read_block DMAs into the buffer, so it must be cache line aligned */
+#define BIO_FLAG_CACHE_ALIGNED_READS	(1 << 0)
+/* may contain a partition table that was not looked at yet */
+#define BIO_FLAG_UNPROBED		(1 << 1)
+/* erased blocks read back as zeros, so erase can replace writing zeros */
+#define BIO_FLAG_ERASE_ZEROES		(1 << 2)
+
 typedef struct bdev {
 	struct list_node node;
 	volatile int ref;
@@ -41,13 +103,23 @@ typedef struct bdev {
 	bnum_t block_count;
 	char *label;
 	bool is_leaf;
+	uint32_t flags;
+
+	/* I/O thread for asynchronous requests, shared with subdevices */
+	struct bio_queue *queue;
+
+	struct bio_stats stats;
 
 	/* function pointers */
 	ssize_t (*read)(struct bdev *, void *buf, off_t offset, size_t len);
 	ssize_t (*read_block)(struct bdev *, void *buf, bnum_t block, uint count);
+	/* optional, only gets whole blocks into buffers suitable for read_block */
+	ssize_t (*readv)(struct bdev *, const struct bio_vec *vecs, uint count);
 	ssize_t (*write)(struct bdev *, const void *buf, off_t offset, size_t len);
 	ssize_t (*write_block)(struct bdev *, const void *buf, bnum_t block, uint count);
 	ssize_t (*erase)(struct bdev *, off_t offset, size_t len);
+	/* optional, for devices backed by memory, see bio_map() */
+	const void *(*map)(struct bdev *, off_t offset, size_t len);
 	int (*ioctl)(struct bdev *, int request, void *argp);
 	void (*close)(struct bdev *);
 } bdev_t;
@@ -59,6 +131,8 @@ struct bdev_struct {
 
 /* user api */
 bdev_t *bio_open(const char *name);
+/* like bio_open(), but by label, e.g. the GPT partition name */
+bdev_t *bio_open_by_label(const char *label);
 void bio_close(bdev_t *dev);
 ssize_t bio_read(bdev_t *dev, void *buf, off_t offset, size_t len);
 ssize_t bio_read_block(bdev_t *dev, void *buf, bnum_t block, uint count);
@@ -67,6 +141,36 @@ ssize_t bio_write_block(bdev_t *dev, const void *buf, bnum_t block, uint count);
 ssize_t bio_erase(bdev_t *dev, off_t offset, size_t len);
 int bio_ioctl(bdev_t *dev, int request, void *argp);
 
+/*
+ * pointer to the data of devices backed by memory (e.g. the memory block
+ * device), so it can be used in place instead of being copied with
+ * bio_read(). NULL if the device is not backed by memory or the range
+ * is not within the device.
+ */
+const void *bio_map(bdev_t *dev, off_t offset, size_t len);
+
+/*
+ * scatter-gather read of a list of extents, e.g. a fragmented file.
+ * Devices may merge the extents into fewer commands.
+ */
+ssize_t bio_readv(bdev_t *dev, const struct bio_vec *vecs, uint count);
+
+/*
+ * asynchronous api: queue the requests and return immediately, on devices
+ * without an I/O queue the requests are completed before returning
+ */
+status_t bio_submit(bdev_t *dev, struct bio_request *reqs, uint count);
+ssize_t bio_wait(struct bio_request *req);
+
+/*
+ * sequential readahead for filesystems issuing many small reads, a NULL
+ * context (readahead disabled or out of memory) reads straight from dev
+ */
+struct bio_readahead;
+struct bio_readahead *bio_readahead_create(bdev_t *dev);
+void bio_readahead_destroy(struct bio_readahead *ra);
+ssize_t bio_readahead_read(struct bio_readahead *ra, bdev_t *dev, void *buf, off_t offset, size_t len);
+
 /* intialize the block device layer */
 void bio_init(void);
 
@@ -76,13 +180,21 @@ void bio_unregister_device(bdev_t *dev);
 
 /* used during bdev construction */
 void bio_initialize_bdev(bdev_t *dev, const char *name, size_t block_size, bnum_t block_count);
+void bio_initialize_queue(bdev_t *dev);
 
 /* debug stuff */
 void bio_dump_devices(void);
+void bio_reset_stats(void);
 
 /* low level access to the device list, user must lock the mutex */
 struct bdev_struct *bio_get_bdevs(void);
 
+/*
+ * Called by bio_open() for names that are not registered, so devices can be
+ * published on demand. Returns true if it published any devices.
+ */
+void bio_set_open_hook(bool (*hook)(const char *name));
+
 /* subdevice support */
 status_t bio_publish_subdevice(const char *parent_dev, const char *subdev, bnum_t startblock, size_t len);
 
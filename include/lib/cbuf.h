@@ -35,8 +35,19 @@ typedef struct cbuf {
 } cbuf_t;
 
 void cbuf_initialize(cbuf_t *cbuf, size_t len);
+void cbuf_initialize_etc(cbuf_t *cbuf, size_t len, void *buf);
 size_t cbuf_read(cbuf_t *cbuf, void *_buf, size_t buflen, bool block);
 size_t cbuf_write(cbuf_t *cbuf, const void *_buf, size_t len, bool canreschedule);
 
+/*
+ * Lock-free access for exactly one producer and one consumer, e.g. a thread
+ * and an interrupt handler. The event is not used. The consumer can work on
+ * the data in place: peek returns the largest contiguous span of data, which
+ * stays valid until it is consumed.
+ */
+bool cbuf_spsc_put(cbuf_t *cbuf, char c);
+size_t cbuf_spsc_peek(cbuf_t *cbuf, char **data);
+void cbuf_spsc_consume(cbuf_t *cbuf, size_t len);
+
 #endif
 
@@ -40,7 +40,14 @@ typedef struct filehandle filehandle;
 typedef struct dirhandle dirhandle;
 
 status_t fs_mount(const char *path, const char *fs, const char *device) __NONNULL();
+/* mount with whatever registered filesystem is found on device */
+status_t fs_mount_auto(const char *path, const char *device) __NONNULL();
 status_t fs_unmount(const char *path) __NONNULL();
+/*
+ * drop the filesystem state kept for device and the partitions inside of it
+ * (all devices if NULL) after it was written to by something else
+ */
+void fs_invalidate(const char *device);
 
 /* file api */
 status_t fs_create_file(const char *path, filehandle **handle, uint64_t len) __NONNULL();
@@ -67,7 +74,13 @@ typedef struct fscookie fscookie;
 typedef struct filecookie filecookie;
 typedef struct dircookie dircookie;
 struct bdev;
+
+/* amount of data from the start of the device passed to fs_api.probe */
+#define FS_PROBE_SIZE 4096
+
 struct fs_api {
+    /* optional, check if buf (len bytes from the start) holds this filesystem */
+    bool (*probe)(const void *buf, size_t len);
     status_t (*mount)(struct bdev *, fscookie **);
     status_t (*unmount)(fscookie *);
     status_t (*open)(fscookie *, const char *, filecookie **);
@@ -29,8 +29,49 @@ void *heap_alloc(size_t, unsigned int alignment);
 void *heap_realloc(void *ptr, size_t size);
 void heap_free(void *);
 
+// same as above, caller is the call site accounted with HEAP_PROFILE
+void *heap_alloc_caller(size_t, unsigned int alignment, void *caller);
+void *heap_realloc_caller(void *ptr, size_t size, void *caller);
+
 void heap_init(void);
 
+struct heap_stats {
+	size_t size;		// total size of the heap
+	size_t used;		// bytes allocated, including headers
+	size_t peak_used;	// maximum of used since boot
+	size_t free;		// bytes in the free list
+	size_t cached;		// bytes in free chunks kept by the size classes
+	size_t largest_free;	// largest chunk in the free list
+	unsigned int free_chunks;
+	unsigned int fragmentation;	// percentage of free not in the largest chunk
+	unsigned int regions;	// regions the heap was grown by
+};
+
+void heap_get_stats(struct heap_stats *stats);
+
+// may be provided by the platform to grow the heap, called in a critical section:
+// heap_get_region returns the base of a region of at least *len bytes and updates *len, or NULL
+void *heap_get_region(size_t *len);
+void heap_put_region(void *base, size_t len);
+
+// give back the regions that are completely free, returns the number still in use
+unsigned int heap_release_regions(void);
+
+#if HEAP_PROFILE
+// allocations made from one call site, the return address of the caller
+struct heap_site {
+	void *caller;		// NULL for the sites that did not fit the table
+	size_t used;		// bytes allocated, including headers
+	size_t peak_used;
+	time_t peak_time;	// current_time() when peak_used was reached
+	unsigned int allocs;	// allocations since boot
+	unsigned int live;	// allocations that were not freed yet
+};
+
+// copy up to count sites with the highest peak usage, returns the number copied
+unsigned int heap_get_sites(struct heap_site *sites, unsigned int count);
+#endif
+
 
 
 #endif
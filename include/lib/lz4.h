@@ -0,0 +1,76 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#ifndef __LIB_LZ4_H
+#define __LIB_LZ4_H
+
+#include <sys/types.h>
+
+bool lz4_is_compressed(const void *buf, size_t len);
+
+/*
+ * Decompress a LZ4 file (frame or legacy format) from src into dst.
+ * Returns 0 with the decompressed size in out_len, ERR_TOO_BIG when dst
+ * is too small (dst still holds the first dst_size bytes of the data) or
+ * another negative error if src is invalid.
+ */
+int lz4_decompress(const void *src, size_t src_size, void *dst,
+		   size_t dst_size, size_t *out_len);
+
+/*
+ * Decompress a single raw LZ4 block (without frame or legacy header) from
+ * src into dst. Decoding stops once dst_size bytes were produced, so src
+ * may be padded or hold more data than needed. Returns the decompressed
+ * size or a negative error if src is invalid.
+ */
+ssize_t lz4_decompress_raw(const void *src, size_t src_size, void *dst,
+			   size_t dst_size);
+
+/*
+ * Streaming decompression for data that arrives in pieces, e.g. over USB.
+ * Frames (with independent or linked blocks), legacy files and skippable
+ * frames are supported like by lz4_decompress(), except that nothing may
+ * follow the last block of a legacy file. Each block is passed to out() as
+ * soon as it is decompressed. The buffers are kept in a work area of
+ * LZ4_STREAM_WORK_SIZE bytes provided by the caller.
+ */
+#define LZ4_STREAM_WORK_SIZE	(17 * 1024 * 1024)
+
+typedef int (*lz4_stream_out)(void *arg, const void *buf, size_t len);
+
+struct lz4_stream {
+	lz4_stream_out out;
+	void *arg;
+	unsigned char *in;	/* header or block being collected */
+	unsigned char *win;	/* history, followed by the current block */
+	size_t in_len;
+	size_t need;
+	size_t win_pos;
+	size_t block_max;
+	uint32_t block;
+	uint32_t skip;
+	unsigned char flg;
+	int state;
+};
+
+void lz4_stream_init(struct lz4_stream *s, void *work, lz4_stream_out out,
+		     void *arg);
+
+/*
+ * Both return 0 on success or a negative error, either the one returned by
+ * out() or ERR_NOT_VALID if the data is invalid or (for lz4_stream_finish())
+ * truncated.
+ */
+int lz4_stream_write(struct lz4_stream *s, const void *buf, size_t len);
+int lz4_stream_finish(struct lz4_stream *s);
+
+/* Worst case size of the output of lz4_compress() for size bytes. */
+size_t lz4_compress_bound(size_t size);
+
+/*
+ * Compress src_size bytes from src into dst in the legacy LZ4 format
+ * (lz4 -l), which can be decompressed with "lz4 -d". dst must have room
+ * for lz4_compress_bound(src_size) bytes. Returns the compressed size or
+ * 0 if there is not enough memory.
+ */
+size_t lz4_compress(const void *src, size_t src_size, void *dst);
+
+#endif
@@ -0,0 +1,18 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#ifndef __LIB_ZSTD_H
+#define __LIB_ZSTD_H
+
+#include <sys/types.h>
+
+bool zstd_is_compressed(const void *buf, size_t len);
+
+/*
+ * Decompress the zstd frames in src into dst. Returns 0 with the
+ * decompressed size in out_len, ERR_TOO_BIG when dst is too small (dst
+ * still holds the first dst_size bytes of the data) or another negative
+ * error if src is invalid.
+ */
+int zstd_decompress(const void *src, size_t src_size, void *dst,
+		    size_t dst_size, size_t *out_len);
+
+#endif
@@ -50,6 +50,7 @@ void display_init(void);
 void display_shutdown(void);
 void display_image_on_screen(void);
 void display_fbcon_message(char *str);
+void debug_fbcon_flush(void);
 
 unsigned board_machtype(void);
 unsigned board_platform_id(void);
@@ -34,6 +34,12 @@ extern "C" {
 
 void debug_init(void);
 unsigned log_copy(void *dst);
+/*
+ * Move the log ring buffer to buf, keeping the existing log. The write
+ * position and the number of valid bytes are kept up to date in *idx and
+ * *used for whoever reads the buffer later (e.g. the OS).
+ */
+void log_relocate(void *buf, unsigned size, unsigned *idx, unsigned *used);
 
 void debug_dump_regs(void);
 
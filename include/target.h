@@ -141,6 +141,7 @@ uint32_t target_get_pmic(void);
 int target_update_cmdline(char *cmdline);
 
 struct mmc_device *target_get_sd_mmc(void);
+int target_sdc_set_io_voltage(uint8_t slot, uint32_t voltage_uv);
 
 static inline bool target_is_ssd_enabled(void)
 {
@@ -28,30 +28,94 @@
 #include <kernel/thread.h>
 #include <kernel/event.h>
 
-struct dpc {
-	struct list_node node;	
+struct dpc_worker {
+	const char *name;
+	int priority;
+	struct list_node list;
+	event_t event;
+};
 
+static struct dpc_worker dpc_workers[DPC_WORK_NUM_PRIORITIES] = {
+	[DPC_WORK_LOW] = { "dpc-low", LOW_PRIORITY },
+	[DPC_WORK_NORMAL] = { "dpc-normal", HIGH_PRIORITY },
+	[DPC_WORK_HIGH] = { "dpc", DPC_PRIORITY },
+};
+
+/* dpc_queue() entry, freed after the callback has run */
+struct dpc {
+	struct dpc_work work;
 	dpc_callback cb;
 	void *arg;
 };
 
-static struct list_node dpc_list = LIST_INITIAL_VALUE(dpc_list);
-static event_t dpc_event;
-
 static int dpc_thread_routine(void *arg);
 
 void dpc_init(void)
 {
+	struct dpc_worker *w;
 	thread_t *thr;
+	int i;
+
+	for (i = 0; i < DPC_WORK_NUM_PRIORITIES; i++) {
+		w = &dpc_workers[i];
+		list_initialize(&w->list);
+		event_init(&w->event, false, 0);
+
+		thr = thread_create(w->name, &dpc_thread_routine, w, w->priority, DEFAULT_STACK_SIZE);
+		if (!thr)
+		{
+			panic("failed to create dpc thread\n");
+		}
+		thread_resume(thr);
+	}
+}
 
-	event_init(&dpc_event, false, 0);
+void dpc_work_init(struct dpc_work *work, dpc_callback cb, void *arg)
+{
+	work->cb = cb;
+	work->arg = arg;
+	work->queued = false;
+}
+
+status_t dpc_work_queue(struct dpc_work *work, enum dpc_work_priority prio, uint flags)
+{
+	struct dpc_worker *w = &dpc_workers[prio];
 
-	thr = thread_create("dpc", &dpc_thread_routine, NULL, DPC_PRIORITY, DEFAULT_STACK_SIZE);
-	if (!thr)
-	{
-		panic("failed to create dpc thread\n");
+	enter_critical_section();
+	if (work->queued) {
+		exit_critical_section();
+		return ERR_ALREADY_STARTED;
 	}
-	thread_resume(thr);
+	work->queued = true;
+	list_add_tail(&w->list, &work->node);
+	event_signal(&w->event, (flags & DPC_FLAG_NORESCHED) ? false : true);
+	exit_critical_section();
+
+	return NO_ERROR;
+}
+
+/* Returns true if the work was removed before its callback started */
+bool dpc_work_cancel(struct dpc_work *work)
+{
+	bool queued;
+
+	enter_critical_section();
+	queued = work->queued;
+	if (queued) {
+		list_delete(&work->node);
+		work->queued = false;
+	}
+	exit_critical_section();
+
+	return queued;
+}
+
+static void dpc_call(void *arg)
+{
+	struct dpc *dpc = arg;
+
+	dpc->cb(dpc->arg);
+	free(dpc);
 }
 
 status_t dpc_queue(dpc_callback cb, void *arg, uint flags)
@@ -59,37 +123,36 @@ status_t dpc_queue(dpc_callback cb, void *arg, uint flags)
 	struct dpc *dpc;
 
 	dpc = malloc(sizeof(struct dpc));
+	if (!dpc)
+		return ERR_NO_MEMORY;
 
 	dpc->cb = cb;
 	dpc->arg = arg;
-	enter_critical_section();
-	list_add_tail(&dpc_list, &dpc->node);
-	event_signal(&dpc_event, (flags & DPC_FLAG_NORESCHED) ? false : true);
-	exit_critical_section();
+	dpc_work_init(&dpc->work, dpc_call, dpc);
 
-	return NO_ERROR;
+	return dpc_work_queue(&dpc->work, DPC_WORK_HIGH, flags);
 }
 
 static int dpc_thread_routine(void *arg)
 {
+	struct dpc_worker *w = arg;
+
 	for (;;) {
-		event_wait(&dpc_event);
+		event_wait(&w->event);
 
 		enter_critical_section();
-		struct dpc *dpc = list_remove_head_type(&dpc_list, struct dpc, node);
-		if (!dpc)
-			event_unsignal(&dpc_event);
+		struct dpc_work *work = list_remove_head_type(&w->list, struct dpc_work, node);
+		if (work)
+			work->queued = false;
+		else
+			event_unsignal(&w->event);
 		exit_critical_section();
 
-		if (dpc) {
-//			dprintf("dpc calling %p, arg %p\n", dpc->cb, dpc->arg);
-			dpc->cb(dpc->arg);
-
-			free(dpc);
+		if (work) {
+//			dprintf("dpc calling %p, arg %p\n", work->cb, work->arg);
+			work->cb(work->arg);
 		}
 	}
 
 	return 0;
 }
-
-
@@ -41,6 +41,11 @@
 #include <kernel/timer.h>
 #include <kernel/dpc.h>
 #include <platform.h>
+#include <platform/timer.h>
+
+#if WITH_LK2ND_TRACE
+#include <lk2nd/trace.h>
+#endif
 
 #if DEBUGLEVEL > 1
 #define THREAD_CHECKS 1
@@ -69,6 +74,20 @@ static thread_t bootstrap_thread;
 /* the idle thread */
 thread_t *idle_thread;
 
+/*
+ * Stacks of DEFAULT_STACK_SIZE are kept when threads exit and reused for
+ * the next thread, so threads that are started often (e.g. the boot loader
+ * threads) do not need to allocate them from the heap.
+ */
+#define STACK_POOL_SIZE 4
+static void *stack_pool[STACK_POOL_SIZE];
+static uint stack_pool_count;
+
+#if THREAD_STATS
+/* stacks are painted with this to find out how much of them was used */
+#define STACK_FILL 0x5a
+#endif
+
 /* local routines */
 static void thread_resched(void);
 static void idle_thread_routine(void) __NO_RETURN;
@@ -76,6 +95,11 @@ static void idle_thread_routine(void) __NO_RETURN;
 #if PLATFORM_HAS_DYNAMIC_TIMER
 /* preemption timer */
 static timer_t preempt_timer;
+
+static enum handler_return preempt_timer_tick(struct timer *t, time_t now, void *arg)
+{
+	return thread_timer_tick();
+}
 #endif
 
 /* run queue manipulation */
@@ -112,6 +136,41 @@ static void init_thread_struct(thread_t *t, const char *name)
 	strlcpy(t->name, name, sizeof(t->name));
 }
 
+static void *thread_alloc_stack(size_t stack_size)
+{
+	void *stack = NULL;
+
+	if (stack_size == DEFAULT_STACK_SIZE) {
+		enter_critical_section();
+		if (stack_pool_count)
+			stack = stack_pool[--stack_pool_count];
+		exit_critical_section();
+	}
+
+	if (!stack)
+		stack = malloc(stack_size);
+
+#if THREAD_STATS
+	if (stack)
+		memset(stack, STACK_FILL, stack_size);
+#endif
+	return stack;
+}
+
+static void thread_free_stack(void *stack, size_t stack_size)
+{
+	if (stack_size == DEFAULT_STACK_SIZE) {
+		enter_critical_section();
+		if (stack_pool_count < STACK_POOL_SIZE) {
+			stack_pool[stack_pool_count++] = stack;
+			stack = NULL;
+		}
+		exit_critical_section();
+	}
+
+	free(stack);
+}
+
 /**
  * @brief  Create a new thread
  *
@@ -135,7 +194,9 @@ static void init_thread_struct(thread_t *t, const char *name)
  *	IDLE_PRIORITY
  *	LOWEST_PRIORITY
  *
- * Stack size is typically set to DEFAULT_STACK_SIZE
+ * Stack size is typically set to DEFAULT_STACK_SIZE, or SMALL_STACK_SIZE for
+ * simple polling loops. With THREAD_STATS, dump_thread() shows how much of
+ * the stack was used so far.
  *
  * @return  Pointer to thread object, or NULL on failure.
  */
@@ -158,7 +219,7 @@ thread_t *thread_create(const char *name, thread_start_routine entry, void *arg,
 	t->wait_queue_block_ret = NO_ERROR;
 
 	/* create the stack */
-	t->stack = malloc(stack_size);
+	t->stack = thread_alloc_stack(stack_size);
 	if (!t->stack) {
 		free(t);
 		return NULL;
@@ -230,7 +291,7 @@ static void thread_cleanup_dpc(void *thread)
 
 	/* free its stack and the thread structure itself */
 	if (t->stack)
-		free(t->stack);
+		thread_free_stack(t->stack, t->stack_size);
 
 	free(t);
 }
@@ -258,7 +319,8 @@ void thread_exit(int retcode)
 	current_thread->retcode = retcode;
 
 	/* schedule a dpc to clean ourselves up */
-	dpc_queue(thread_cleanup_dpc, (void *)current_thread, DPC_FLAG_NORESCHED);
+	dpc_work_init(&current_thread->cleanup_work, thread_cleanup_dpc, (void *)current_thread);
+	dpc_work_queue(&current_thread->cleanup_work, DPC_WORK_HIGH, DPC_FLAG_NORESCHED);
 
 	/* reschedule */
 	thread_resched();
@@ -347,12 +409,16 @@ void thread_resched(void)
 #if THREAD_STATS
 	thread_stats.context_switches++;
 
+	bigtime_t now = current_time_hires();
+	oldthread->runtime += now - oldthread->last_run_timestamp;
+	newthread->last_run_timestamp = now;
+	newthread->context_switches++;
+
 	if (oldthread == idle_thread) {
-		bigtime_t now = current_time_hires();
 		thread_stats.idle_time += now - thread_stats.last_idle_timestamp;
 	}
 	if (newthread == idle_thread) {
-		thread_stats.last_idle_timestamp = current_time_hires();
+		thread_stats.last_idle_timestamp = now;
 	}
 #endif
 
@@ -366,12 +432,16 @@ void thread_resched(void)
 	 * timer to run our preemption tick.
 	 */
 	if (oldthread == idle_thread) {
-		timer_set_periodic(&preempt_timer, 10, (timer_callback)thread_timer_tick, NULL);
+		timer_set_periodic(&preempt_timer, 10, preempt_timer_tick, NULL);
 	} else if (newthread == idle_thread) {
 		timer_cancel(&preempt_timer);
 	}
 #endif
 
+#if WITH_LK2ND_TRACE
+	lk2nd_trace_switch(newthread);
+#endif
+
 	/* do the switch */
 	oldthread->saved_critical_section_count = critical_section_count;
 	current_thread = newthread;
@@ -531,6 +601,36 @@ void thread_sleep(time_t delay)
 	exit_critical_section();
 }
 
+/**
+ * @brief  Delay the current thread; delay specified in us
+ *
+ * Long delays sleep for most of the time so other threads can run meanwhile
+ * and only busy-wait the last part to end on time. Short delays, and delays
+ * in a critical section (early boot, interrupt handlers) where sleeping is
+ * not possible, are busy-waits like udelay().
+ *
+ * Like thread_sleep(), this could take longer than the specified delay if
+ * other threads are running.
+ */
+void thread_usleep(unsigned usecs)
+{
+	bigtime_t end, now;
+
+	if (usecs < THREAD_USLEEP_MIN || in_critical_section()) {
+		udelay(usecs);
+		return;
+	}
+
+	end = current_time_hires() + usecs;
+
+	/* The timer tick may fire early in the first ms, so sleep one less */
+	thread_sleep(usecs / 1000 - 1);
+
+	now = current_time_hires();
+	if (now < end)
+		udelay(end - now);
+}
+
 /**
  * @brief  Initialize threading system
  *
@@ -608,6 +708,19 @@ void thread_become_idle(void)
 	idle_thread_routine();
 }
 
+#if THREAD_STATS
+/* stacks grow down, so the paint is left at the bottom of the stack */
+static size_t thread_stack_used(thread_t *t)
+{
+	const uint8_t *stack = t->stack;
+	size_t i;
+
+	for (i = 0; i < t->stack_size && stack[i] == STACK_FILL; i++)
+		;
+	return t->stack_size - i;
+}
+#endif
+
 /**
  * @brief  Dump debugging info about the specified thread.
  */
@@ -618,6 +731,18 @@ void dump_thread(thread_t *t)
 	dprintf(INFO, "\tstack %p, stack_size %zd\n", t->stack, t->stack_size);
 	dprintf(INFO, "\tentry %p, arg %p\n", t->entry, t->arg);
 	dprintf(INFO, "\twait queue %p, wait queue ret %d\n", t->blocking_wait_queue, t->wait_queue_block_ret);
+#if THREAD_STATS
+	bigtime_t runtime = t->runtime;
+	if (t == current_thread)
+		runtime += current_time_hires() - t->last_run_timestamp;
+	dprintf(INFO, "\truntime %llu us, context switches %u\n", runtime, t->context_switches);
+	if (t->stack) {
+		size_t used = thread_stack_used(t);
+
+		dprintf(INFO, "\tstack used %zu of %zd bytes%s\n", used, t->stack_size,
+				used == t->stack_size ? " (overflow)" : "");
+	}
+#endif
 	dprintf(INFO, "\ttls:");
 	int i;
 	for (i=0; i < MAX_TLS_ENTRY; i++) {
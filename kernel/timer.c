@@ -253,7 +253,11 @@ static enum handler_return timer_tick(void *arg, time_t now)
 		/* has to be the case or it would have fired already */
 		ASSERT(TIME_GT(timer->scheduled_time, now));
 
-		time_t delay = timer->scheduled_time - now;
+		/* the callbacks may have taken a while, so start from the time now */
+		time_t delay = 0;
+		now = current_time();
+		if (TIME_GT(timer->scheduled_time, now))
+			delay = timer->scheduled_time - now;
 
 //		TRACEF("setting new timer for %u msecs for event %p\n", (uint)delay, timer);
 		platform_set_oneshot_timer(timer_tick, NULL, delay);
@@ -274,8 +278,10 @@ void timer_init(void)
 {
 	list_initialize(&timer_queue);
 
+#if !PLATFORM_HAS_DYNAMIC_TIMER
 	/* register for a periodic timer tick */
 	platform_set_periodic_timer(timer_tick, NULL, 10); /* 10ms */
+#endif
 }
 
 
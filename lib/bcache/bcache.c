@@ -30,23 +30,20 @@
 
 #define LOCAL_TRACE 0
 
+/* dirty blocks are written back in runs of up to this many bytes */
+#define FLUSH_RUN_MAX (64 * 1024)
+
 struct bcache_block {
 	struct list_node node;
+	struct list_node hash_node;
 	bnum_t blocknum;
 	int ref_count;
 	bool is_dirty;
 	void *ptr;
 };
 
-struct bcache_stats {
-	uint32_t hits;
-	uint32_t depth;
-	uint32_t misses;
-	uint32_t reads;
-	uint32_t writes;
-};
-
 struct bcache {
+	struct list_node node;
 	bdev_t *dev;
 	size_t block_size;
 	int count;
@@ -55,12 +52,24 @@ struct bcache {
 	struct list_node free_list;
 	struct list_node lru_list;
 
+	/* blocks on the lru list, hashed by block number */
+	struct list_node *hash;
+	uint hash_mask;
+
 	struct bcache_block *blocks;
+
+	/* dirty blocks sorted for write back, and a buffer to merge runs of them */
+	struct bcache_block **dirty;
+	void *flush_buf;
 };
 
+/* all caches that currently exist, for statistics */
+static struct list_node bcache_list = LIST_INITIAL_VALUE(bcache_list);
+
 bcache_t bcache_create(bdev_t *dev, size_t block_size, int block_count)
 {
 	struct bcache *cache;
+	uint hash_size = 1;
 
 	cache = malloc(sizeof(struct bcache));
 	
@@ -72,34 +81,128 @@ bcache_t bcache_create(bdev_t *dev, size_t block_size, int block_count)
 	list_initialize(&cache->free_list);
 	list_initialize(&cache->lru_list);
 
+	/* one bucket per block, rounded up to a power of two */
+	while (hash_size < (uint)block_count)
+		hash_size <<= 1;
+	cache->hash = malloc(sizeof(struct list_node) * hash_size);
+	cache->hash_mask = hash_size - 1;
+	uint j;
+	for (j=0; j < hash_size; j++)
+		list_initialize(&cache->hash[j]);
+
+	cache->dirty = malloc(sizeof(struct bcache_block *) * block_count);
+	cache->flush_buf = NULL;
+
 	cache->blocks = malloc(sizeof(struct bcache_block) * block_count);
 	int i;
 	for (i=0; i < block_count; i++) {
 		cache->blocks[i].ref_count = 0;
 		cache->blocks[i].is_dirty = false;
 		cache->blocks[i].ptr = memalign(CACHE_LINE, block_size);
+		list_clear_node(&cache->blocks[i].hash_node);
 		// add to the free list
 		list_add_head(&cache->free_list, &cache->blocks[i].node);	
 	}
 
+	list_add_tail(&bcache_list, &cache->node);
+
 	return (bcache_t)cache;
 }
 
-static int flush_block(struct bcache *cache, struct bcache_block *block)
+static void hash_insert(struct bcache *cache, struct bcache_block *block)
 {
-	int rc;
+	list_add_head(&cache->hash[block->blocknum & cache->hash_mask], &block->hash_node);
+}
 
-	rc = bio_write(cache->dev, block->ptr,
-			(off_t)block->blocknum * cache->block_size,
-			cache->block_size);
-	if (rc < 0)
-		goto exit;
+static void hash_remove(struct bcache_block *block)
+{
+	if (list_in_list(&block->hash_node))
+		list_delete(&block->hash_node);
+}
 
-	block->is_dirty = false;
-	cache->stats.writes++;
-	rc = 0;
-exit:
-	return (rc);
+/*
+ * Sort the dirty blocks by block number. Caches only hold a handful of
+ * blocks, so a simple insertion sort is enough.
+ */
+static void sort_dirty(struct bcache_block **dirty, uint count)
+{
+	struct bcache_block *block;
+	uint i, j;
+
+	for (i = 1; i < count; i++) {
+		block = dirty[i];
+		for (j = i; j > 0 && dirty[j - 1]->blocknum > block->blocknum; j--)
+			dirty[j] = dirty[j - 1];
+		dirty[j] = block;
+	}
+}
+
+/* write a run of blocks with consecutive block numbers in one go */
+static int flush_run(struct bcache *cache, struct bcache_block **run, uint count)
+{
+	size_t len = count * cache->block_size;
+	void *buf = run[0]->ptr;
+	ssize_t rc;
+	uint i;
+
+	if (count > 1) {
+		buf = cache->flush_buf;
+		for (i = 0; i < count; i++)
+			memcpy((uint8_t *)buf + i * cache->block_size, run[i]->ptr,
+			       cache->block_size);
+	}
+
+	rc = bio_write(cache->dev, buf, (off_t)run[0]->blocknum * cache->block_size, len);
+	if (rc < 0 || (size_t)rc != len)
+		return -1;
+
+	for (i = 0; i < count; i++)
+		run[i]->is_dirty = false;
+	cache->stats.writes += count;
+	cache->stats.flushes++;
+	return 0;
+}
+
+/*
+ * Write back all dirty blocks. They are sorted by block number so that
+ * consecutive blocks are merged into one write, instead of writing them
+ * one at a time in LRU order.
+ */
+static int flush_dirty(struct bcache *cache)
+{
+	struct bcache_block *block;
+	uint max_run = 1, count = 0, i, n;
+	int err;
+
+	list_for_every_entry(&cache->lru_list, block, struct bcache_block, node) {
+		if (block->is_dirty)
+			cache->dirty[count++] = block;
+	}
+	if (!count)
+		return 0;
+
+	sort_dirty(cache->dirty, count);
+
+	if (cache->block_size < FLUSH_RUN_MAX) {
+		if (!cache->flush_buf)
+			cache->flush_buf = memalign(CACHE_LINE, FLUSH_RUN_MAX);
+		/* without the buffer every block is written on its own */
+		if (cache->flush_buf)
+			max_run = FLUSH_RUN_MAX / cache->block_size;
+	}
+
+	for (i = 0; i < count; i += n) {
+		for (n = 1; i + n < count && n < max_run; n++) {
+			if (cache->dirty[i + n]->blocknum != cache->dirty[i]->blocknum + n)
+				break;
+		}
+
+		err = flush_run(cache, &cache->dirty[i], n);
+		if (err)
+			return err;
+	}
+
+	return 0;
 }
 
 void bcache_destroy(bcache_t _cache)
@@ -117,6 +220,11 @@ void bcache_destroy(bcache_t _cache)
 		free(cache->blocks[i].ptr);
 	}
 
+	list_delete(&cache->node);
+	free(cache->flush_buf);
+	free(cache->dirty);
+	free(cache->blocks);
+	free(cache->hash);
 	free(cache);
 }
 
@@ -125,11 +233,12 @@ static struct bcache_block *find_block(struct bcache *cache, uint blocknum)
 {
 	uint32_t depth = 0;
 	struct bcache_block *block;
+	struct list_node *bucket = &cache->hash[blocknum & cache->hash_mask];
 
 	LTRACEF("num %u\n", blocknum);
 
 	block = NULL;
-	list_for_every_entry(&cache->lru_list, block, struct bcache_block, node) {
+	list_for_every_entry(bucket, block, struct bcache_block, hash_node) {
 		LTRACEF("looking at entry %p, num %u\n", block, block->blocknum);
 		depth++;
 
@@ -165,8 +274,9 @@ static struct bcache_block *alloc_block(struct bcache *cache)
 	list_for_every_entry(&cache->lru_list, block, struct bcache_block, node) {
 		LTRACEF("looking at %p, num %u\n", block, block->blocknum);
 		if (block->ref_count == 0) {
+			/* write back everything dirty while at it, not just this block */
 			if (block->is_dirty) {
-				err = flush_block(cache, block);
+				err = flush_dirty(cache);
 				if (err)
 					return NULL;
 			}
@@ -174,6 +284,7 @@ static struct bcache_block *alloc_block(struct bcache *cache)
 			// add it to the tail of the lru
 			list_delete(&block->node);
 			list_add_tail(&cache->lru_list, &block->node);
+			hash_remove(block);
 			return block;
 		}
 	}
@@ -202,10 +313,13 @@ static struct bcache_block *find_or_fill_block(struct bcache *cache, uint blockn
 		err = bio_read(cache->dev, block->ptr, (off_t)blocknum * cache->block_size, cache->block_size);
 		if (err < 0) {
 			/* free the block, return an error */
+			list_delete(&block->node);
 			list_add_tail(&cache->free_list, &block->node);
 			return NULL;
 		}
 
+		hash_insert(cache, block);
+
 		cache->stats.reads++;
 	}
 
@@ -214,12 +328,29 @@ static struct bcache_block *find_or_fill_block(struct bcache *cache, uint blockn
 	return block;
 }
 
+/* blocks of devices backed by memory are used in place, not cached */
+static void *map_block(struct bcache *cache, uint blocknum)
+{
+	if (!cache->dev->map)
+		return NULL;
+
+	return (void *)bio_map(cache->dev, (off_t)blocknum * cache->block_size,
+			       cache->block_size);
+}
+
 int bcache_read_block(bcache_t _cache, void *buf, uint blocknum)
 {
 	struct bcache *cache = _cache;
+	void *ptr;
 
 	LTRACEF("buf %p, blocknum %u\n", buf, blocknum);
 
+	ptr = map_block(cache, blocknum);
+	if (ptr) {
+		memcpy(buf, ptr, cache->block_size);
+		return 0;
+	}
+
 	struct bcache_block *block = find_or_fill_block(cache, blocknum);
 	if (block == NULL) {
 		/* error */
@@ -238,6 +369,10 @@ int bcache_get_block(bcache_t _cache, void **ptr, uint blocknum)
 
 	DEBUG_ASSERT(ptr);
 
+	*ptr = map_block(cache, blocknum);
+	if (*ptr)
+		return 0;
+
 	struct bcache_block *block = find_or_fill_block(cache, blocknum);
 	if (block == NULL) {
 		/* error */
@@ -259,6 +394,10 @@ int bcache_put_block(bcache_t _cache, uint blocknum)
 
 	struct bcache_block *block = find_block(cache, blocknum);
 
+	/* blocks used in place are not in the cache, nothing to release */
+	if (!block && map_block(cache, blocknum))
+		return 0;
+
 	/* be pretty hard on the caller for now */
 	DEBUG_ASSERT(block);
 	DEBUG_ASSERT(block->ref_count > 0);
@@ -301,6 +440,7 @@ int bcache_zero_block(bcache_t priv, uint blocknum)
 		}
 
 		block->blocknum = blocknum;
+		hash_insert(cache, block);
 	}
 
 	memset(block->ptr, 0, cache->block_size);
@@ -312,21 +452,9 @@ exit:
 
 int bcache_flush(bcache_t priv)
 {
-	int err;
 	struct bcache *cache = priv;
-	struct bcache_block *block;
-
-	list_for_every_entry(&cache->lru_list, block, struct bcache_block, node) {
-		if (block->is_dirty) {
-			err = flush_block(cache, block);
-			if (err)
-				goto exit;
-		}
-	}
 
-	err = 0;
-exit:
-	return (err);
+	return flush_dirty(cache);
 }
 
 void bcache_dump(bcache_t priv, const char *name)
@@ -336,7 +464,7 @@ void bcache_dump(bcache_t priv, const char *name)
 
 	finds = cache->stats.hits + cache->stats.misses;
 
-	printf("%s: hits=%u(%u%%) depth=%u misses=%u(%u%%) reads=%u writes=%u\n",
+	printf("%s: hits=%u(%u%%) depth=%u misses=%u(%u%%) reads=%u writes=%u flushes=%u\n",
 		name,
 		cache->stats.hits,
 		finds ? (cache->stats.hits * 100) / finds : 0,
@@ -344,5 +472,26 @@ void bcache_dump(bcache_t priv, const char *name)
 		cache->stats.misses,
 		finds ? (cache->stats.misses * 100) / finds : 0,
 		cache->stats.reads,
-		cache->stats.writes);
+		cache->stats.writes,
+		cache->stats.flushes);
+}
+
+void bcache_get_info(bcache_t priv, struct bcache_info *info)
+{
+	struct bcache *cache = priv;
+
+	info->name = cache->dev->name;
+	info->block_size = cache->block_size;
+	info->count = cache->count;
+	info->stats = cache->stats;
+}
+
+bcache_t bcache_next(bcache_t priv)
+{
+	struct bcache *cache = priv;
+
+	if (!cache)
+		return list_peek_head_type(&bcache_list, struct bcache, node);
+
+	return list_next_type(&bcache_list, &cache->node, struct bcache, node);
 }
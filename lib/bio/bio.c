@@ -20,22 +20,95 @@
  * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
  * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
+#include <arch/defines.h>
 #include <stdlib.h>
+#include <malloc.h>
 #include <debug.h>
 #include <err.h>
 #include <string.h>
 #include <list.h>
+#include <platform.h>
 #include <lib/bio.h>
 #include <kernel/mutex.h>
+#include "bio_priv.h"
+
+#if WITH_LK2ND_PERF
+#include <lk2nd/perf.h>
+#endif
+#if WITH_LK2ND_TRACE
+#include <lk2nd/trace.h>
+#endif
 
 #define LOCAL_TRACE 0
 
 static struct bdev_struct *bdevs;
+static bool (*bio_open_hook)(const char *name);
 
 /* low level access to the device list, user must lock the mutex */
 struct bdev_struct *bio_get_bdevs(void) { return bdevs; }
 
-/* default implementation is to use the read_block hook to 'deblock' the device */
+void bio_set_open_hook(bool (*hook)(const char *name)) { bio_open_hook = hook; }
+
+void bio_stats_add(struct bio_stats_dir *dir, ssize_t ret, bigtime_t start)
+{
+	bigtime_t us = current_time_hires() - start;
+	unsigned i = 0;
+
+	while (i < BIO_STATS_HIST_BUCKETS - 1 && us >= (2ULL << i))
+		i++;
+
+	dir->ops++;
+	dir->hist[i]++;
+	dir->total_us += us;
+	if (ret < 0)
+		dir->errors++;
+	else
+		dir->bytes += ret;
+}
+
+/* size of the bounce buffer for reads to buffers that are not cache line aligned */
+#define BIO_BOUNCE_SIZE (64 * 1024)
+
+/*
+ * Read whole blocks to a buffer that is not cache line aligned. The devices
+ * cannot safely DMA into it, since the cache maintenance would also hit the
+ * data sharing the first and last cache line, so the blocks go through an
+ * aligned bounce buffer instead.
+ */
+static ssize_t bio_read_block_bounce(struct bdev *dev, uint8_t *buf, bnum_t block, size_t count)
+{
+	size_t chunk = MAX(BIO_BOUNCE_SIZE / dev->block_size, 1U);
+	ssize_t err = 0;
+	uint8_t *bounce;
+	size_t n;
+
+	bounce = memalign(CACHE_LINE, MIN(count, chunk) * dev->block_size);
+	if (!bounce)
+		return ERR_NO_MEMORY;
+
+	while (count > 0) {
+		n = MIN(count, chunk);
+		err = bio_read_block(dev, bounce, block, n);
+		if (err < 0)
+			break;
+
+		memcpy(buf, bounce, n * dev->block_size);
+		dev->stats.bounced++;
+		buf += n * dev->block_size;
+		block += n;
+		count -= n;
+	}
+
+	free(bounce);
+	return (err < 0) ? err : 0;
+}
+
+/*
+ * default implementation is to use the read_block hook to 'deblock' the device.
+ * Partial blocks at the start and end go through a temporary block, the rest
+ * is read straight into buf if it is cache line aligned there or the device
+ * does not need aligned buffers (BIO_FLAG_CACHE_ALIGNED_READS).
+ */
 static ssize_t bio_default_read(struct bdev *dev, void *_buf, off_t offset, size_t len)
 {
 	uint8_t *buf = (uint8_t *)_buf;
@@ -59,6 +132,7 @@ static ssize_t bio_default_read(struct bdev *dev, void *_buf, off_t offset, size
 		size_t block_offset = offset % dev->block_size;
 		size_t tocopy = MIN(dev->block_size - block_offset, len);
 		memcpy(buf, temp + block_offset, tocopy);
+		dev->stats.bounced++;
 
 		/* increment our buffers */
 		buf += tocopy;
@@ -72,7 +146,10 @@ static ssize_t bio_default_read(struct bdev *dev, void *_buf, off_t offset, size
 	if (len >= dev->block_size) {
 		/* do the middle reads */
 		size_t block_count = len / dev->block_size;
-		err = bio_read_block(dev, buf, block, block_count);
+		if (!(dev->flags & BIO_FLAG_CACHE_ALIGNED_READS) || IS_CACHE_LINE_ALIGNED(buf))
+			err = bio_read_block(dev, buf, block, block_count);
+		else
+			err = bio_read_block_bounce(dev, buf, block, block_count);
 		if (err < 0)
 			goto err;
 
@@ -96,6 +173,7 @@ static ssize_t bio_default_read(struct bdev *dev, void *_buf, off_t offset, size
 
 		/* copy the partial block from our temp buffer */
 		memcpy(buf, temp, len);
+		dev->stats.bounced++;
 
 		bytes_read += len;
 	}
@@ -128,6 +206,7 @@ static ssize_t bio_default_write(struct bdev *dev, const void *_buf, off_t offse
 		size_t block_offset = offset % dev->block_size;
 		size_t tocopy = MIN(dev->block_size - block_offset, len);
 		memcpy(temp + block_offset, buf, tocopy);
+		dev->stats.bounced++;
 
 		/* write it back out */
 		err = bio_write_block(dev, temp, block, 1);
@@ -170,6 +249,7 @@ static ssize_t bio_default_write(struct bdev *dev, const void *_buf, off_t offse
 
 		/* copy the partial block from our temp buffer */
 		memcpy(temp, buf, len);
+		dev->stats.bounced++;
 
 		/* write it back out */
 		err = bio_write_block(dev, temp, block, 1);
@@ -246,7 +326,7 @@ static void bdev_dec_ref(bdev_t *dev)
 	}
 }
 
-bdev_t *bio_open(const char *name)
+static bdev_t *bio_lookup(const char *name)
 {
 	bdev_t *bdev = NULL;
 
@@ -266,6 +346,35 @@ bdev_t *bio_open(const char *name)
 	return bdev;
 }
 
+bdev_t *bio_open(const char *name)
+{
+	bdev_t *bdev = bio_lookup(name);
+
+	/* the device may be a partition that was not probed yet */
+	if (!bdev && bio_open_hook && bio_open_hook(name))
+		bdev = bio_lookup(name);
+
+	return bdev;
+}
+
+bdev_t *bio_open_by_label(const char *label)
+{
+	bdev_t *bdev = NULL;
+	bdev_t *entry;
+
+	mutex_acquire(&bdevs->lock);
+	list_for_every_entry(&bdevs->list, entry, bdev_t, node) {
+		if (entry->label && !strcmp(entry->label, label)) {
+			bdev = entry;
+			bdev_inc_ref(bdev);
+			break;
+		}
+	}
+	mutex_release(&bdevs->lock);
+
+	return bdev;
+}
+
 void bio_close(bdev_t *dev)
 {
 	DEBUG_ASSERT(dev);
@@ -275,6 +384,13 @@ void bio_close(bdev_t *dev)
 
 ssize_t bio_read(bdev_t *dev, void *buf, off_t offset, size_t len)
 {
+#if WITH_LK2ND_PERF
+	LK2ND_PERF_SCOPE("bio_read");
+	LK2ND_PERF_COUNT("bio_read_bytes", len);
+#endif
+#if WITH_LK2ND_TRACE
+	LK2ND_TRACE_SCOPE("bio_read", len);
+#endif
 	LTRACEF("dev '%s', buf %p, offset %lld, len %zd\n", dev->name, buf, offset, len);
 
 	DEBUG_ASSERT(dev->ref > 0);
@@ -289,7 +405,15 @@ ssize_t bio_read(bdev_t *dev, void *buf, off_t offset, size_t len)
 	if (offset + len > dev->size)
 		len = dev->size - offset;
 
-	return dev->read(dev, buf, offset, len);
+	/* the default hook is accounted in bio_read_block() */
+	if (dev->read == bio_default_read)
+		return dev->read(dev, buf, offset, len);
+
+	bigtime_t start = current_time_hires();
+	ssize_t ret = dev->read(dev, buf, offset, len);
+	bio_stats_add(&dev->stats.read, ret, start);
+
+	return ret;
 }
 
 ssize_t bio_read_block(bdev_t *dev, void *buf, bnum_t block, uint count)
@@ -306,7 +430,63 @@ ssize_t bio_read_block(bdev_t *dev, void *buf, bnum_t block, uint count)
 	if (block + count > dev->block_count)
 		count = dev->block_count - block;
 
-	return dev->read_block(dev, buf, block, count);
+	bio_queue_lock(dev);
+	bigtime_t start = current_time_hires();
+	ssize_t ret = dev->read_block(dev, buf, block, count);
+	bio_stats_add(&dev->stats.read, ret, start);
+	bio_queue_unlock(dev);
+
+	return ret;
+}
+
+/* extents the readv hook can take: whole blocks into a buffer read_block can use */
+bool bio_vec_is_direct(bdev_t *dev, const struct bio_vec *vec)
+{
+	return vec->len > 0 &&
+	       vec->offset % dev->block_size == 0 &&
+	       vec->len % dev->block_size == 0 &&
+	       (!(dev->flags & BIO_FLAG_CACHE_ALIGNED_READS) || IS_CACHE_LINE_ALIGNED(vec->buf));
+}
+
+ssize_t bio_readv(bdev_t *dev, const struct bio_vec *vecs, uint count)
+{
+	ssize_t ret, total = 0;
+	uint i, end;
+
+	LTRACEF("dev '%s', vecs %p, count %u\n", dev->name, vecs, count);
+
+	DEBUG_ASSERT(dev->ref > 0);
+
+	/* range check, extents are not trimmed */
+	for (i = 0; i < count; i++)
+		if (vecs[i].offset < 0 || vecs[i].offset + (off_t)vecs[i].len > dev->size)
+			return ERR_INVALID_ARGS;
+
+	for (i = 0; i < count; i = end) {
+		/* hand runs of suitable extents to the device together */
+		end = i;
+		if (dev->readv)
+			while (end < count && bio_vec_is_direct(dev, &vecs[end]))
+				end++;
+
+		if (end > i) {
+			bio_queue_lock(dev);
+			bigtime_t start = current_time_hires();
+			ret = dev->readv(dev, vecs + i, end - i);
+			bio_stats_add(&dev->stats.read, ret, start);
+			dev->stats.merged += end - i - 1;
+			bio_queue_unlock(dev);
+		} else {
+			ret = bio_read(dev, vecs[i].buf, vecs[i].offset, vecs[i].len);
+			end = i + 1;
+		}
+
+		if (ret < 0)
+			return ret;
+		total += ret;
+	}
+
+	return total;
 }
 
 ssize_t bio_write(bdev_t *dev, const void *buf, off_t offset, size_t len)
@@ -325,7 +505,15 @@ ssize_t bio_write(bdev_t *dev, const void *buf, off_t offset, size_t len)
 	if (offset + len > dev->size)
 		len = dev->size - offset;
 
-	return dev->write(dev, buf, offset, len);
+	/* the default hook is accounted in bio_write_block() */
+	if (dev->write == bio_default_write)
+		return dev->write(dev, buf, offset, len);
+
+	bigtime_t start = current_time_hires();
+	ssize_t ret = dev->write(dev, buf, offset, len);
+	bio_stats_add(&dev->stats.write, ret, start);
+
+	return ret;
 }
 
 ssize_t bio_write_block(bdev_t *dev, const void *buf, bnum_t block, uint count)
@@ -342,7 +530,13 @@ ssize_t bio_write_block(bdev_t *dev, const void *buf, bnum_t block, uint count)
 	if (block + count > dev->block_count)
 		count = dev->block_count - block;
 
-	return dev->write_block(dev, buf, block, count);
+	bio_queue_lock(dev);
+	bigtime_t start = current_time_hires();
+	ssize_t ret = dev->write_block(dev, buf, block, count);
+	bio_stats_add(&dev->stats.write, ret, start);
+	bio_queue_unlock(dev);
+
+	return ret;
 }
 
 ssize_t bio_erase(bdev_t *dev, off_t offset, size_t len)
@@ -364,6 +558,22 @@ ssize_t bio_erase(bdev_t *dev, off_t offset, size_t len)
 	return dev->erase(dev, offset, len);
 }
 
+const void *bio_map(bdev_t *dev, off_t offset, size_t len)
+{
+	LTRACEF("dev '%s', offset %lld, len %zd\n", dev->name, offset, len);
+
+	DEBUG_ASSERT(dev->ref > 0);
+
+	if (!dev->map)
+		return NULL;
+
+	/* range check, the whole range must be there */
+	if (offset < 0 || offset > dev->size || (off_t)len > dev->size - offset)
+		return NULL;
+
+	return dev->map(dev, offset, len);
+}
+
 int bio_ioctl(bdev_t *dev, int request, void *argp)
 {
 	LTRACEF("dev '%s', request %08x, argp %p\n", dev->name, request, argp);
@@ -389,14 +599,19 @@ void bio_initialize_bdev(bdev_t *dev, const char *name, size_t block_size, bnum_
 	dev->ref = 0;
 
 	dev->is_leaf = false;
+	dev->flags = BIO_FLAGS_NONE;
 	dev->label = NULL;
+	dev->queue = NULL;
+	memset(&dev->stats, 0, sizeof(dev->stats));
 
 	/* set up the default hooks, the sub driver should override the block operations at least */
 	dev->read = bio_default_read;
 	dev->read_block = bio_default_read_block;
+	dev->readv = NULL;
 	dev->write = bio_default_write;
 	dev->write_block = bio_default_write_block;
 	dev->erase = bio_default_erase;
+	dev->ioctl = NULL;
 	dev->close = NULL;
 }
 
@@ -427,6 +642,40 @@ void bio_unregister_device(bdev_t *dev)
 	bdev_dec_ref(dev); // remove the ref the list used to have
 }
 
+static void bio_dump_stats_dir(const char *what, const struct bio_stats_dir *dir)
+{
+	unsigned i;
+
+	if (!dir->ops)
+		return;
+
+	printf("\t\t%s: %u ops, %u errors, %llu bytes, avg %llu us, hist:", what,
+	       dir->ops, dir->errors, dir->bytes, dir->total_us / dir->ops);
+	for (i = 0; i < BIO_STATS_HIST_BUCKETS; i++)
+		if (dir->hist[i])
+			printf(" %s%u:%u", i < BIO_STATS_HIST_BUCKETS - 1 ? "<" : ">=",
+			       i < BIO_STATS_HIST_BUCKETS - 1 ? 2U << i : 1U << i, dir->hist[i]);
+	printf("\n");
+}
+
+static void bio_dump_stats(bdev_t *dev)
+{
+	bio_dump_stats_dir("read", &dev->stats.read);
+	bio_dump_stats_dir("write", &dev->stats.write);
+	if (dev->stats.merged || dev->stats.bounced)
+		printf("\t\tmerged %u, bounced %u\n", dev->stats.merged, dev->stats.bounced);
+}
+
+void bio_reset_stats(void)
+{
+	bdev_t *entry;
+
+	mutex_acquire(&bdevs->lock);
+	list_for_every_entry(&bdevs->list, entry, bdev_t, node)
+		memset(&entry->stats, 0, sizeof(entry->stats));
+	mutex_release(&bdevs->lock);
+}
+
 void bio_dump_devices(void)
 {
 	printf("block devices:\n");
@@ -434,6 +683,7 @@ void bio_dump_devices(void)
 	mutex_acquire(&bdevs->lock);
 	list_for_every_entry(&bdevs->list, entry, bdev_t, node) {
 		printf("\t%s (%s), size %lld, bsize %zd, ref %d\n", entry->name, entry->label, entry->size, entry->block_size, entry->ref);
+		bio_dump_stats(entry);
 	}
 	mutex_release(&bdevs->lock);
 }
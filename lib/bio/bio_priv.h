@@ -0,0 +1,17 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#ifndef __LIB_BIO_PRIV_H
+#define __LIB_BIO_PRIV_H
+
+#include <lib/bio.h>
+
+/* queue.c: serialize block I/O of queued devices between threads */
+void bio_queue_lock(bdev_t *dev);
+void bio_queue_unlock(bdev_t *dev);
+
+/* bio.c: account a request to the driver hooks of dev, see struct bio_stats */
+void bio_stats_add(struct bio_stats_dir *dir, ssize_t ret, bigtime_t start);
+
+/* bio.c: extent that can be passed to the readv hook of dev */
+bool bio_vec_is_direct(bdev_t *dev, const struct bio_vec *vec);
+
+#endif
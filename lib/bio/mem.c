@@ -79,6 +79,13 @@ static ssize_t mem_bdev_write_block(struct bdev *bdev, const void *buf, bnum_t b
 	return count * BLOCKSIZE;
 }
 
+static const void *mem_bdev_map(bdev_t *bdev, off_t offset, size_t len)
+{
+	mem_bdev_t *mem = (mem_bdev_t *)bdev;
+
+	return (uint8_t *)mem->ptr + offset;
+}
+
 int create_membdev(const char *name, void *ptr, size_t len)
 {
 	mem_bdev_t *mem = malloc(sizeof(mem_bdev_t));
@@ -92,6 +99,7 @@ int create_membdev(const char *name, void *ptr, size_t len)
 	mem->dev.read_block = mem_bdev_read_block;
 	mem->dev.write = mem_bdev_write;
 	mem->dev.write_block = mem_bdev_write_block;
+	mem->dev.map = mem_bdev_map;
 
 	/* register it */
 	bio_register_device(&mem->dev);
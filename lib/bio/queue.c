@@ -0,0 +1,225 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <debug.h>
+#include <err.h>
+#include <stdlib.h>
+#include <string.h>
+#include <kernel/thread.h>
+#include <lib/bio.h>
+#include "bio_priv.h"
+
+#define LOCAL_TRACE 0
+
+struct bio_queue {
+	/* the device that owns the queue, subdevices share it */
+	bdev_t *dev;
+
+	struct list_node pending;
+	event_t work;
+	thread_t *thread;
+
+	/* held during block I/O to the owning device */
+	mutex_t lock;
+};
+
+void bio_queue_lock(bdev_t *dev)
+{
+	if (dev->queue && dev->queue->dev == dev)
+		mutex_acquire(&dev->queue->lock);
+}
+
+void bio_queue_unlock(bdev_t *dev)
+{
+	if (dev->queue && dev->queue->dev == dev)
+		mutex_release(&dev->queue->lock);
+}
+
+/* Reads handed to the readv hook of the device at once by the I/O thread. */
+#define BIO_QUEUE_BATCH 8
+
+static void bio_complete(struct bio_request *req)
+{
+	if (req->complete)
+		req->complete(req);
+
+	event_signal(&req->done, false);
+}
+
+static void bio_execute(struct bio_request *req)
+{
+	LTRACEF("dev '%s', %s buf %p, offset %lld, len %zu\n", req->dev->name,
+		req->write ? "write" : "read", req->buf, req->offset, req->len);
+
+	if (req->write)
+		req->result = bio_write(req->dev, req->buf, req->offset, req->len);
+	else
+		req->result = bio_read(req->dev, req->buf, req->offset, req->len);
+
+	bio_complete(req);
+}
+
+static bool bio_can_batch(struct bio_request *req)
+{
+	struct bio_vec vec = { req->buf, req->offset, req->len };
+
+	return !req->write && req->dev->readv && bio_vec_is_direct(req->dev, &vec) &&
+	       req->offset + (off_t)req->len <= req->dev->size;
+}
+
+/*
+ * Read queued requests with one bio_readv(), so that drivers can combine
+ * them or keep several commands in flight. If that fails the requests are
+ * repeated one by one to get the result of each one.
+ */
+static void bio_execute_batch(struct bio_request **reqs, uint count)
+{
+	struct bio_vec vecs[BIO_QUEUE_BATCH];
+	ssize_t ret, total = 0;
+	uint i;
+
+	if (count == 1) {
+		bio_execute(reqs[0]);
+		return;
+	}
+
+	for (i = 0; i < count; i++) {
+		vecs[i].buf = reqs[i]->buf;
+		vecs[i].offset = reqs[i]->offset;
+		vecs[i].len = reqs[i]->len;
+		total += reqs[i]->len;
+	}
+
+	LTRACEF("dev '%s', %u reads\n", reqs[0]->dev->name, count);
+
+	ret = bio_readv(reqs[0]->dev, vecs, count);
+	for (i = 0; i < count; i++) {
+		if (ret != total) {
+			bio_execute(reqs[i]);
+			continue;
+		}
+		reqs[i]->result = reqs[i]->len;
+		bio_complete(reqs[i]);
+	}
+}
+
+static int bio_queue_thread(void *arg)
+{
+	struct bio_queue *queue = arg;
+	struct bio_request *reqs[BIO_QUEUE_BATCH], *next;
+	uint count;
+
+	/* Run the requests back-to-back until the queue is empty. */
+	for (;;) {
+		enter_critical_section();
+		reqs[0] = list_remove_head_type(&queue->pending, struct bio_request, node);
+		count = 1;
+		while (reqs[0] && count < BIO_QUEUE_BATCH && bio_can_batch(reqs[0])) {
+			next = list_peek_head_type(&queue->pending, struct bio_request, node);
+			if (!next || next->dev != reqs[0]->dev || !bio_can_batch(next))
+				break;
+			list_delete(&next->node);
+			reqs[count++] = next;
+		}
+		exit_critical_section();
+
+		if (!reqs[0]) {
+			event_wait(&queue->work);
+			continue;
+		}
+
+		bio_execute_batch(reqs, count);
+	}
+
+	return 0;
+}
+
+/* The thread is only started once it is actually needed. */
+static bool bio_queue_start(struct bio_queue *queue)
+{
+	char name[32];
+
+	if (queue->thread)
+		return true;
+
+	snprintf(name, sizeof(name), "bio:%s", queue->dev->name);
+	queue->thread = thread_create(name, bio_queue_thread, queue,
+				      DEFAULT_PRIORITY, DEFAULT_STACK_SIZE);
+	if (!queue->thread)
+		return false;
+
+	thread_resume(queue->thread);
+	return true;
+}
+
+/**
+ * bio_submit() - Queue asynchronous I/O requests.
+ * @dev:   Block device to operate on
+ * @reqs:  Array of requests, filled in by the caller
+ * @count: Number of requests
+ *
+ * The requests are processed in order. Each request must stay valid
+ * until it has completed, use bio_wait() or the completion callback to
+ * find out when that happened. Devices without an I/O queue complete
+ * all requests synchronously before this function returns.
+ */
+status_t bio_submit(bdev_t *dev, struct bio_request *reqs, uint count)
+{
+	uint i;
+
+	DEBUG_ASSERT(dev->ref > 0);
+
+	for (i = 0; i < count; i++) {
+		reqs[i].dev = dev;
+		reqs[i].result = 0;
+		event_init(&reqs[i].done, false, 0);
+	}
+
+	if (!dev->queue || !bio_queue_start(dev->queue)) {
+		for (i = 0; i < count; i++)
+			bio_execute(&reqs[i]);
+		return NO_ERROR;
+	}
+
+	enter_critical_section();
+	for (i = 0; i < count; i++)
+		list_add_tail(&dev->queue->pending, &reqs[i].node);
+	exit_critical_section();
+
+	event_signal(&dev->queue->work, true);
+	return NO_ERROR;
+}
+
+/**
+ * bio_wait() - Wait for an asynchronous request to complete.
+ *
+ * Returns: Number of bytes transferred or negative error.
+ */
+ssize_t bio_wait(struct bio_request *req)
+{
+	event_wait(&req->done);
+	event_destroy(&req->done);
+
+	return req->result;
+}
+
+/**
+ * bio_initialize_queue() - Process asynchronous requests in a thread.
+ *
+ * Should be used by drivers that can make progress while the submitter
+ * does something else (e.g. USB transfers). Must be called before any
+ * subdevices are published so that they share the queue.
+ */
+void bio_initialize_queue(bdev_t *dev)
+{
+	struct bio_queue *queue = calloc(1, sizeof(*queue));
+
+	if (!queue)
+		return;
+
+	queue->dev = dev;
+	list_initialize(&queue->pending);
+	event_init(&queue->work, false, EVENT_FLAG_AUTOUNSIGNAL);
+	mutex_init(&queue->lock);
+
+	dev->queue = queue;
+}
@@ -0,0 +1,136 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Sequential readahead for small reads.
+ *
+ * Filesystem drivers tend to read a sector or block at a time (FatFs does
+ * everything through its one-sector window, ext2 reads partial blocks), and
+ * each of those round trips to the storage controller. The readahead context
+ * keeps a window of the device in memory: reads that continue where the
+ * previous one stopped grow the window up to BIO_READAHEAD_SIZE, anything
+ * else shrinks it back to a single block. Reads that are as large as the
+ * window bypass it and go straight to the device.
+ */
+
+#include <arch/ops.h>
+#include <debug.h>
+#include <err.h>
+#include <stdlib.h>
+#include <string.h>
+#include <lib/bio.h>
+
+#define LOCAL_TRACE 0
+
+struct bio_readahead {
+	bdev_t *dev;
+
+	uint8_t *buf;
+	size_t max_size;
+
+	/* current window size, adjusted by the access pattern */
+	size_t size;
+
+	/* part of the device held in buf */
+	off_t win_offset;
+	size_t win_len;
+
+	/* offset right after the last read, to detect sequential access */
+	off_t next;
+};
+
+struct bio_readahead *bio_readahead_create(bdev_t *dev)
+{
+	struct bio_readahead *ra;
+	size_t max_size = ROUNDUP(BIO_READAHEAD_SIZE, dev->block_size);
+
+	/* Reads from memory are cheap, a copy into the window would not help */
+	if (BIO_READAHEAD_SIZE == 0 || dev->map)
+		return NULL;
+
+	ra = calloc(1, sizeof(*ra));
+	if (!ra)
+		return NULL;
+
+	ra->buf = memalign(CACHE_LINE, ROUNDUP(max_size, CACHE_LINE));
+	if (!ra->buf) {
+		free(ra);
+		return NULL;
+	}
+
+	ra->dev = dev;
+	ra->max_size = max_size;
+	ra->size = dev->block_size;
+	ra->next = -1;
+
+	return ra;
+}
+
+void bio_readahead_destroy(struct bio_readahead *ra)
+{
+	if (!ra)
+		return;
+
+	free(ra->buf);
+	free(ra);
+}
+
+ssize_t bio_readahead_read(struct bio_readahead *ra, bdev_t *dev, void *_buf,
+			   off_t offset, size_t len)
+{
+	uint8_t *buf = _buf;
+	size_t bytes_read = 0;
+	ssize_t ret;
+
+	if (!ra)
+		return bio_read(dev, buf, offset, len);
+
+	DEBUG_ASSERT(ra->dev == dev);
+
+	LTRACEF("offset %lld, len %zu, window %lld+%zu, size %zu\n",
+		offset, len, ra->win_offset, ra->win_len, ra->size);
+
+	while (len > 0) {
+		/* serve whatever the window already holds */
+		if (offset >= ra->win_offset &&
+		    offset < ra->win_offset + (off_t)ra->win_len) {
+			size_t pos = offset - ra->win_offset;
+			size_t n = MIN(len, ra->win_len - pos);
+
+			memcpy(buf, ra->buf + pos, n);
+			buf += n;
+			offset += n;
+			len -= n;
+			bytes_read += n;
+			ra->next = offset;
+			continue;
+		}
+
+		/* large reads gain nothing from the extra copy */
+		if (len >= ra->max_size) {
+			ret = bio_read(dev, buf, offset, len);
+			if (ret < 0)
+				return ret;
+
+			ra->next = offset + ret;
+			return bytes_read + ret;
+		}
+
+		if (offset == ra->next)
+			ra->size = MIN(ra->size * 2, ra->max_size);
+		else
+			ra->size = dev->block_size;
+
+		/* refill the window starting at the block containing offset */
+		ra->win_offset = ROUNDDOWN(offset, (off_t)dev->block_size);
+		ra->win_len = 0;
+
+		ret = bio_read(dev, ra->buf, ra->win_offset, ra->size);
+		if (ret < 0)
+			return ret;
+		if (ret <= offset - ra->win_offset)
+			break; /* end of device */
+
+		ra->win_len = ret;
+	}
+
+	return bytes_read;
+}
@@ -6,4 +6,11 @@ OBJS += \
 	$(LOCAL_DIR)/bio.o \
 	$(LOCAL_DIR)/debug.o \
 	$(LOCAL_DIR)/mem.o \
-	$(LOCAL_DIR)/subdev.o 
+	$(LOCAL_DIR)/queue.o \
+	$(LOCAL_DIR)/readahead.o \
+	$(LOCAL_DIR)/subdev.o
+
+# Maximum readahead window per mounted filesystem in bytes, 0 disables it
+BIO_READAHEAD_SIZE ?= 32768
+
+DEFINES += BIO_READAHEAD_SIZE=$(BIO_READAHEAD_SIZE)
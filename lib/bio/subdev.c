@@ -22,10 +22,15 @@
  */
 #include <debug.h>
 #include <stdlib.h>
+#include <platform.h>
 #include <lib/bio.h>
+#include "bio_priv.h"
 
 #define LOCAL_TRACE 0
 
+/* extents remapped on the stack per call of the parent's readv hook */
+#define SUBDEV_READV_BATCH 16
+
 typedef struct {
 	// inheirit the usual bits
 	bdev_t dev;
@@ -44,11 +49,60 @@ static ssize_t subdev_read(struct bdev *_dev, void *buf, off_t offset, size_t le
 	return bio_read(subdev->parent, buf, offset + (off_t)subdev->offset * subdev->dev.block_size, len);
 }
 
+/*
+ * bio_read_block() already clamped the range to the subdevice, which lies
+ * within the parent, so the block is remapped and handed to the parent's
+ * hook directly. The parent is locked instead since it owns the queue and
+ * the request is accounted on it as well.
+ */
 static ssize_t subdev_read_block(struct bdev *_dev, void *buf, bnum_t block, uint count)
 {
 	subdev_t *subdev = (subdev_t *)_dev;
+	bdev_t *parent = subdev->parent;
+	bigtime_t start;
+	ssize_t ret;
+
+	bio_queue_lock(parent);
+	start = current_time_hires();
+	ret = parent->read_block(parent, buf, block + subdev->offset, count);
+	bio_stats_add(&parent->stats.read, ret, start);
+	bio_queue_unlock(parent);
+
+	return ret;
+}
 
-	return bio_read_block(subdev->parent, buf, block + subdev->offset, count);
+static ssize_t subdev_readv(struct bdev *_dev, const struct bio_vec *vecs, uint count)
+{
+	subdev_t *subdev = (subdev_t *)_dev;
+	bdev_t *parent = subdev->parent;
+	struct bio_vec batch[SUBDEV_READV_BATCH];
+	off_t start = (off_t)subdev->offset * subdev->dev.block_size;
+	ssize_t ret, total = 0;
+	bigtime_t begin;
+	uint i, n;
+
+	while (count > 0) {
+		n = MIN(count, SUBDEV_READV_BATCH);
+		for (i = 0; i < n; i++) {
+			batch[i] = vecs[i];
+			batch[i].offset += start;
+		}
+
+		bio_queue_lock(parent);
+		begin = current_time_hires();
+		ret = parent->readv(parent, batch, n);
+		bio_stats_add(&parent->stats.read, ret, begin);
+		parent->stats.merged += n - 1;
+		bio_queue_unlock(parent);
+		if (ret < 0)
+			return ret;
+
+		total += ret;
+		vecs += n;
+		count -= n;
+	}
+
+	return total;
 }
 
 static ssize_t subdev_write(struct bdev *_dev, const void *buf, off_t offset, size_t len)
@@ -61,8 +115,17 @@ static ssize_t subdev_write(struct bdev *_dev, const void *buf, off_t offset, si
 static ssize_t subdev_write_block(struct bdev *_dev, const void *buf, bnum_t block, uint count)
 {
 	subdev_t *subdev = (subdev_t *)_dev;
+	bdev_t *parent = subdev->parent;
+	bigtime_t start;
+	ssize_t ret;
 
-	return bio_write_block(subdev->parent, buf, block + subdev->offset, count);
+	bio_queue_lock(parent);
+	start = current_time_hires();
+	ret = parent->write_block(parent, buf, block + subdev->offset, count);
+	bio_stats_add(&parent->stats.write, ret, start);
+	bio_queue_unlock(parent);
+
+	return ret;
 }
 
 static ssize_t subdev_erase(struct bdev *_dev, off_t offset, size_t len)
@@ -72,6 +135,13 @@ static ssize_t subdev_erase(struct bdev *_dev, off_t offset, size_t len)
 	return bio_erase(subdev->parent, offset + subdev->offset * subdev->dev.block_size, len);
 }
 
+static const void *subdev_map(struct bdev *_dev, off_t offset, size_t len)
+{
+	subdev_t *subdev = (subdev_t *)_dev;
+
+	return bio_map(subdev->parent, offset + (off_t)subdev->offset * subdev->dev.block_size, len);
+}
+
 static void subdev_close(struct bdev *_dev)
 {
 	subdev_t *subdev = (subdev_t *)_dev;
@@ -85,18 +155,44 @@ status_t bio_publish_subdevice(const char *parent_dev, const char *subdev, bnum_
 	LTRACEF("parent %s, sub %s, startblock %u, len %zd\n", parent_dev, subdev, startblock, len);
 
 	bdev_t *parent = bio_open(parent_dev);
+	bdev_t *base;
 	if (!parent)
 		return -1;
 
 	/* make sure we're able to do this */
-	if (startblock + len > parent->block_count)
+	if (startblock + len > parent->block_count) {
+		bio_close(parent);
 		return -1;
+	}
+
+	/*
+	 * Subdevices of subdevices (e.g. partitions inside a partition) are
+	 * remapped straight to the device below, so reads only go through
+	 * one level of offset arithmetic no matter how deep they are nested.
+	 */
+	base = parent;
+	if (parent->read_block == subdev_read_block && ((subdev_t *)parent)->parent) {
+		startblock += ((subdev_t *)parent)->offset;
+		base = bio_open(((subdev_t *)parent)->parent->name);
+		if (!base) {
+			bio_close(parent);
+			return -1;
+		}
+	}
 
 	subdev_t *sub = malloc(sizeof(subdev_t));
+	if (!sub) {
+		if (base != parent)
+			bio_close(base);
+		bio_close(parent);
+		return -1;
+	}
 	bio_initialize_bdev(&sub->dev, subdev, parent->block_size, len);
 
-	sub->parent = parent;
+	sub->parent = base;
 	sub->offset = startblock;
+	sub->dev.queue = base->queue;
+	sub->dev.flags = base->flags & ~BIO_FLAG_UNPROBED;
 
 	/*
 	 * NOTE: We only mark leaf devices if there are subpartitions.
@@ -105,11 +201,18 @@ status_t bio_publish_subdevice(const char *parent_dev, const char *subdev, bnum_
 	parent->is_leaf = false;
 	sub->dev.is_leaf = true;
 
+	if (base != parent)
+		bio_close(parent);
+
 	sub->dev.read = &subdev_read;
 	sub->dev.read_block = &subdev_read_block;
+	if (base->readv)
+		sub->dev.readv = &subdev_readv;
 	sub->dev.write = &subdev_write;
 	sub->dev.write_block = &subdev_write_block;
 	sub->dev.erase = &subdev_erase;
+	if (base->map)
+		sub->dev.map = &subdev_map;
 	sub->dev.close = &subdev_close;
 
 	bio_register_device(&sub->dev);
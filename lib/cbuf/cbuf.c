@@ -26,13 +26,26 @@
 #include <string.h>
 #include <lib/cbuf.h>
 #include <kernel/event.h>
+#include <arch/defines.h>
 
 #define LOCAL_TRACE 0
 
 #define INC_POINTER(cbuf, ptr, inc) \
 	modpow2(((ptr) + (inc)), (cbuf)->len_pow2)
 
+/* order the accesses to the data against the index updates */
+#ifdef dmb
+#define cbuf_barrier() dmb()
+#else
+#define cbuf_barrier() __asm__ volatile ("" : : : "memory")
+#endif
+
 void cbuf_initialize(cbuf_t *cbuf, size_t len)
+{
+	cbuf_initialize_etc(cbuf, len, malloc(len));
+}
+
+void cbuf_initialize_etc(cbuf_t *cbuf, size_t len, void *buf)
 {
 	DEBUG_ASSERT(cbuf);
 	DEBUG_ASSERT(len > 0);
@@ -40,8 +53,8 @@ void cbuf_initialize(cbuf_t *cbuf, size_t len)
 
 	cbuf->head = 0;
 	cbuf->tail = 0;
-	cbuf->len_pow2 = log2(len);
-	cbuf->buf = malloc(len);
+	cbuf->len_pow2 = log2_uint(len);
+	cbuf->buf = buf;
 	event_init(&cbuf->event, false, 0);
 
 	LTRACEF("len %zd, len_pow2 %u\n", len, cbuf->len_pow2);
@@ -144,3 +157,40 @@ size_t cbuf_read(cbuf_t *cbuf, void *_buf, size_t buflen, bool block)
 	return ret;
 }
 
+/* Only the producer writes head, only the consumer writes tail */
+bool cbuf_spsc_put(cbuf_t *cbuf, char c)
+{
+	uint head = cbuf->head;
+	uint next = INC_POINTER(cbuf, head, 1);
+
+	if (next == *(volatile uint *)&cbuf->tail)
+		return false;
+
+	cbuf->buf[head] = c;
+	cbuf_barrier();
+	*(volatile uint *)&cbuf->head = next;
+
+	return true;
+}
+
+size_t cbuf_spsc_peek(cbuf_t *cbuf, char **data)
+{
+	uint head = *(volatile uint *)&cbuf->head;
+	uint tail = cbuf->tail;
+
+	cbuf_barrier();
+	*data = cbuf->buf + tail;
+
+	// up to the end of the buffer, the rest is in the next span
+	if (head >= tail)
+		return head - tail;
+	return valpow2(cbuf->len_pow2) - tail;
+}
+
+void cbuf_spsc_consume(cbuf_t *cbuf, size_t len)
+{
+	DEBUG_ASSERT(len <= valpow2(cbuf->len_pow2));
+
+	cbuf_barrier();
+	*(volatile uint *)&cbuf->tail = INC_POINTER(cbuf, cbuf->tail, len);
+}
@@ -0,0 +1,201 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <debug.h>
+#include <endian.h>
+#include <err.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "erofs_priv.h"
+
+#define LOCAL_TRACE 0
+
+/*
+ * Map offset of an uncompressed inode to its position on the device (or -1
+ * for a hole) and the number of bytes that are contiguous from there.
+ */
+int erofs_map_flat(erofs_t *erofs, struct erofs_inode *inode, off_t offset,
+		   off_t *pa, off_t *plen)
+{
+	const uint blksz = EROFS_BLKSIZ(erofs);
+	off_t lastblk, start, end;
+
+	switch (inode->datalayout) {
+	case EROFS_INODE_FLAT_PLAIN:
+		*pa = ((off_t)inode->u << erofs->blkszbits) + offset;
+		*plen = inode->size - offset;
+		return 0;
+
+	case EROFS_INODE_FLAT_INLINE:
+		/* all but the last block are stored like FLAT_PLAIN */
+		lastblk = (inode->size - 1) >> erofs->blkszbits;
+		if (offset < lastblk << erofs->blkszbits) {
+			*pa = ((off_t)inode->u << erofs->blkszbits) + offset;
+			*plen = (lastblk << erofs->blkszbits) - offset;
+			return 0;
+		}
+
+		/* the tail follows the inode and must not cross a block */
+		start = inode->iloc + inode->isize;
+		if ((start & (blksz - 1)) + (inode->size - (lastblk << erofs->blkszbits)) > blksz)
+			return ERR_NOT_VALID;
+
+		*pa = start + (offset & (blksz - 1));
+		*plen = inode->size - offset;
+		return 0;
+
+	case EROFS_INODE_CHUNK_BASED: {
+		const uint chunkbits = erofs->blkszbits + (inode->u & EROFS_CHUNK_FORMAT_BLKBITS_MASK);
+		const off_t chunknr = offset >> chunkbits;
+		struct erofs_inode_chunk_index idx;
+		uint32_t blkaddr;
+		uint unit;
+		int err;
+
+		if (chunkbits > 30)
+			return ERR_NOT_SUPPORTED;
+
+		unit = (inode->u & EROFS_CHUNK_FORMAT_INDEXES) ? sizeof(idx) : sizeof(blkaddr);
+		start = ROUNDUP(inode->iloc + inode->isize, (off_t)unit) + chunknr * unit;
+		err = erofs_read_meta(erofs, &idx, start, unit);
+		if (err < 0)
+			return err;
+
+		if (unit == sizeof(idx)) {
+			if (LE16(idx.device_id))
+				return ERR_NOT_SUPPORTED;
+			blkaddr = LE32(idx.blkaddr);
+		} else {
+			memcpy(&blkaddr, &idx, sizeof(blkaddr));
+			blkaddr = LE32(blkaddr);
+		}
+
+		end = MIN((chunknr + 1) << chunkbits, inode->size);
+		*plen = end - offset;
+		if (blkaddr == EROFS_NULL_ADDR)
+			*pa = -1;
+		else
+			*pa = ((off_t)blkaddr << erofs->blkszbits) +
+			      (offset & ((1 << chunkbits) - 1));
+		return 0;
+	}
+	}
+
+	return ERR_NOT_SUPPORTED;
+}
+
+static ssize_t erofs_read_flat(erofs_t *erofs, struct erofs_inode *inode,
+			       uint8_t *buf, off_t offset, size_t len,
+			       int (*read)(erofs_t *, void *, off_t, size_t))
+{
+	size_t done = 0, n;
+	off_t pa, plen;
+	int err;
+
+	while (done < len) {
+		err = erofs_map_flat(erofs, inode, offset + done, &pa, &plen);
+		if (err < 0)
+			return err;
+
+		n = MIN((off_t)(len - done), plen);
+		if (pa < 0) {
+			memset(buf + done, 0, n);
+		} else {
+			err = read(erofs, buf + done, pa, n);
+			if (err < 0)
+				return err;
+		}
+		done += n;
+	}
+
+	return done;
+}
+
+/*
+ * Read from an uncompressed inode through the block cache, for directories
+ * and symlinks. mkfs.erofs never compresses those.
+ */
+ssize_t erofs_read_inode(erofs_t *erofs, struct erofs_inode *inode, void *buf,
+			 off_t offset, size_t len)
+{
+	if (offset >= inode->size)
+		return 0;
+	len = MIN((off_t)len, inode->size - offset);
+
+	if (inode->datalayout == EROFS_INODE_COMPRESSED_FULL ||
+	    inode->datalayout == EROFS_INODE_COMPRESSED_COMPACT)
+		return ERR_NOT_SUPPORTED;
+
+	return erofs_read_flat(erofs, inode, buf, offset, len, erofs_read_meta);
+}
+
+status_t erofs_open_file(fscookie *cookie, const char *path, filecookie **fcookie)
+{
+	erofs_t *erofs = (erofs_t *)cookie;
+	erofs_file_t *file;
+	int err;
+
+	file = calloc(1, sizeof(*file));
+	if (!file)
+		return ERR_NO_MEMORY;
+
+	file->erofs = erofs;
+	err = erofs_lookup(erofs, path, &file->inode);
+	if (err < 0)
+		goto err;
+
+	if (file->inode.datalayout == EROFS_INODE_COMPRESSED_FULL ||
+	    file->inode.datalayout == EROFS_INODE_COMPRESSED_COMPACT) {
+		err = z_erofs_init_inode(erofs, &file->inode);
+		if (err < 0)
+			goto err;
+	}
+
+	*fcookie = (filecookie *)file;
+	return 0;
+
+err:
+	free(file);
+	return err;
+}
+
+ssize_t erofs_read_file(filecookie *fcookie, void *buf, off_t offset, size_t len)
+{
+	erofs_file_t *file = (erofs_file_t *)fcookie;
+	struct erofs_inode *inode = &file->inode;
+
+	LTRACEF("nid %llu, offset %lld, len %zu\n", inode->nid, offset, len);
+
+	if (offset < 0)
+		return ERR_INVALID_ARGS;
+	if (offset >= inode->size)
+		return 0;
+	len = MIN((off_t)len, inode->size - offset);
+
+	if (inode->datalayout == EROFS_INODE_COMPRESSED_FULL ||
+	    inode->datalayout == EROFS_INODE_COMPRESSED_COMPACT)
+		return z_erofs_read_file(file, buf, offset, len);
+
+	return erofs_read_flat(file->erofs, inode, buf, offset, len, erofs_read_data);
+}
+
+status_t erofs_stat_file(filecookie *fcookie, struct file_stat *stat)
+{
+	erofs_file_t *file = (erofs_file_t *)fcookie;
+
+	stat->size = file->inode.size;
+	stat->is_dir = EROFS_S_ISDIR(file->inode.mode);
+
+	return 0;
+}
+
+status_t erofs_close_file(filecookie *fcookie)
+{
+	erofs_file_t *file = (erofs_file_t *)fcookie;
+
+	free(file->zbuf);
+	free(file->cbuf);
+	free(file);
+
+	return 0;
+}
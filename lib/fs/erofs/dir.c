@@ -0,0 +1,287 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <debug.h>
+#include <endian.h>
+#include <err.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "erofs_priv.h"
+
+#define LOCAL_TRACE 0
+
+/*
+ * A directory consists of blocks that start with an array of struct
+ * erofs_dirent, followed by the names. The names are not terminated, each
+ * one ends where the next starts, the last one at the end of the block or
+ * at the first '\0'. Entries are sorted by name, within each block and
+ * across the blocks, so a lookup is a binary search over the blocks and
+ * then over the entries of one block.
+ */
+
+/* Load directory block nr into dirbuf, returns the number of entries */
+static int erofs_dir_load_block(erofs_t *erofs, struct erofs_inode *dir,
+				off_t nr, size_t *blklen)
+{
+	const struct erofs_dirent *de = (const void *)erofs->dirbuf;
+	ssize_t ret;
+	uint nameoff;
+
+	ret = erofs_read_inode(erofs, dir, erofs->dirbuf,
+			       nr * EROFS_DIRBLKSIZ(erofs), EROFS_DIRBLKSIZ(erofs));
+	if (ret < 0)
+		return ret;
+
+	nameoff = LE16(de[0].nameoff);
+	if ((size_t)ret < sizeof(*de) || nameoff < sizeof(*de) ||
+	    nameoff % sizeof(*de) || nameoff >= (size_t)ret) {
+		dprintf(INFO, "erofs: Invalid directory block %lld of %llu\n", nr, dir->nid);
+		return ERR_NOT_VALID;
+	}
+
+	*blklen = ret;
+	return nameoff / sizeof(*de);
+}
+
+static const char *erofs_dir_name(erofs_t *erofs, size_t blklen, uint count,
+				  uint i, size_t *namelen)
+{
+	const struct erofs_dirent *de = (const void *)erofs->dirbuf;
+	uint start = LE16(de[i].nameoff);
+	uint end = (i + 1 < count) ? LE16(de[i + 1].nameoff) : blklen;
+
+	if (start > end || end > blklen)
+		return NULL;
+
+	*namelen = strnlen((const char *)erofs->dirbuf + start, end - start);
+	return (const char *)erofs->dirbuf + start;
+}
+
+static int erofs_namecmp(const char *a, size_t alen, const char *b, size_t blen)
+{
+	int ret = memcmp(a, b, MIN(alen, blen));
+
+	if (ret)
+		return ret;
+
+	return (alen > blen) - (alen < blen);
+}
+
+/*
+ * Binary search in the entries of the block in dirbuf. Returns 0 with the
+ * nid if found, otherwise the comparison with the first (< 0) or last (> 0)
+ * entry, which tells the block search where to continue.
+ */
+static int erofs_dir_search_block(erofs_t *erofs, size_t blklen, uint count,
+				  const char *name, size_t namelen, erofs_nid_t *nid)
+{
+	const struct erofs_dirent *de = (const void *)erofs->dirbuf;
+	int lo = 0, hi = count - 1, mid, cmp = 0;
+	const char *dname;
+	size_t dlen;
+
+	while (lo <= hi) {
+		mid = lo + (hi - lo) / 2;
+		dname = erofs_dir_name(erofs, blklen, count, mid, &dlen);
+		if (!dname)
+			return ERR_NOT_VALID;
+
+		cmp = erofs_namecmp(name, namelen, dname, dlen);
+		if (!cmp) {
+			*nid = LE64(de[mid].nid);
+			return 0;
+		}
+
+		if (cmp < 0) {
+			if (mid == 0)
+				return -1;
+			hi = mid - 1;
+		} else {
+			lo = mid + 1;
+		}
+	}
+
+	/* between two entries of this block, so not in any other block */
+	return (lo >= (int)count) ? 1 : ERR_NOT_FOUND;
+}
+
+static int erofs_dir_lookup(erofs_t *erofs, struct erofs_inode *dir,
+			    const char *name, size_t namelen, erofs_nid_t *nid)
+{
+	off_t lo = 0, hi, mid;
+	size_t blklen;
+	int count, ret;
+
+	if (!EROFS_S_ISDIR(dir->mode))
+		return ERR_NOT_DIR;
+
+	hi = (dir->size + EROFS_DIRBLKSIZ(erofs) - 1) / EROFS_DIRBLKSIZ(erofs) - 1;
+	while (lo <= hi) {
+		mid = lo + (hi - lo) / 2;
+
+		count = erofs_dir_load_block(erofs, dir, mid, &blklen);
+		if (count < 0)
+			return count;
+
+		ret = erofs_dir_search_block(erofs, blklen, count, name, namelen, nid);
+		if (ret == 0 || ret == ERR_NOT_FOUND || ret == ERR_NOT_VALID)
+			return ret;
+
+		if (ret < 0)
+			hi = mid - 1;
+		else
+			lo = mid + 1;
+	}
+
+	return ERR_NOT_FOUND;
+}
+
+/* note, trashes path */
+static int erofs_walk(erofs_t *erofs, char *path, const struct erofs_inode *start,
+		      struct erofs_inode *inode, int recurse)
+{
+	struct erofs_inode dir = *start;
+	char *ptr = path, *next;
+	erofs_nid_t nid;
+	int err;
+
+	if (recurse > 4)
+		return ERR_RECURSE_TOO_DEEP;
+
+	*inode = dir;
+	for (;;) {
+		while (*ptr == '/')
+			ptr++;
+		if (!*ptr)
+			return 0;
+
+		next = strchr(ptr, '/');
+		if (next)
+			*next++ = '\0';
+
+		LTRACEF("component '%s'\n", ptr);
+
+		err = erofs_dir_lookup(erofs, &dir, ptr, strlen(ptr), &nid);
+		if (err < 0)
+			return err;
+
+		err = erofs_load_inode(erofs, nid, inode);
+		if (err < 0)
+			return err;
+
+		if (EROFS_S_ISLNK(inode->mode)) {
+			char link[512];
+			ssize_t ret;
+
+			if (inode->size >= (off_t)sizeof(link))
+				return ERR_NO_MEMORY;
+
+			ret = erofs_read_inode(erofs, inode, link, 0, inode->size);
+			if (ret < 0)
+				return ret;
+			link[ret] = '\0';
+
+			LTRACEF("symlink to '%s'\n", link);
+
+			err = erofs_walk(erofs, link, link[0] == '/' ? &erofs->root : &dir,
+					 inode, recurse + 1);
+			if (err < 0)
+				return err;
+		}
+
+		if (!next)
+			return 0;
+
+		/* we aren't done and this walked over a nondir */
+		if (!EROFS_S_ISDIR(inode->mode))
+			return ERR_NOT_FOUND;
+
+		dir = *inode;
+		ptr = next;
+	}
+}
+
+int erofs_lookup(erofs_t *erofs, const char *_path, struct erofs_inode *inode)
+{
+	char path[512];
+
+	LTRACEF("path '%s'\n", _path);
+
+	strlcpy(path, _path, sizeof(path));
+	return erofs_walk(erofs, path, &erofs->root, inode, 1);
+}
+
+status_t erofs_open_directory(fscookie *cookie, const char *path, dircookie **dcookie)
+{
+	erofs_dir_t *dir;
+	int err;
+
+	dir = calloc(1, sizeof(*dir));
+	if (!dir)
+		return ERR_NO_MEMORY;
+
+	err = erofs_open_file(cookie, path, (filecookie **)&dir->file);
+	if (err < 0) {
+		free(dir);
+		return err;
+	}
+
+	if (!EROFS_S_ISDIR(dir->file->inode.mode)) {
+		erofs_close_file((filecookie *)dir->file);
+		free(dir);
+		return ERR_NOT_DIR;
+	}
+
+	*dcookie = (dircookie *)dir;
+	return 0;
+}
+
+status_t erofs_read_directory(dircookie *dcookie, struct dirent *ent)
+{
+	erofs_dir_t *dir = (erofs_dir_t *)dcookie;
+	erofs_t *erofs = dir->file->erofs;
+	const char *name;
+	size_t namelen;
+	int count;
+
+	/*
+	 * dirbuf is shared with lookups, so the block is reloaded for every
+	 * entry. It normally still is in the block cache.
+	 */
+	for (;;) {
+		if (dir->offset >= dir->file->inode.size)
+			return ERR_NOT_FOUND;
+
+		count = erofs_dir_load_block(erofs, &dir->file->inode,
+					     dir->offset / EROFS_DIRBLKSIZ(erofs), &dir->blklen);
+		if (count < 0)
+			return count;
+
+		if (dir->index < (uint)count)
+			break;
+
+		dir->offset += EROFS_DIRBLKSIZ(erofs);
+		dir->index = 0;
+	}
+
+	name = erofs_dir_name(erofs, dir->blklen, count, dir->index, &namelen);
+	if (!name)
+		return ERR_NOT_VALID;
+
+	namelen = MIN(namelen, FS_MAX_FILE_LEN - 1);
+	memcpy(ent->name, name, namelen);
+	ent->name[namelen] = '\0';
+
+	dir->index++;
+	return 0;
+}
+
+status_t erofs_close_directory(dircookie *dcookie)
+{
+	erofs_dir_t *dir = (erofs_dir_t *)dcookie;
+
+	erofs_close_file((filecookie *)dir->file);
+	free(dir);
+
+	return 0;
+}
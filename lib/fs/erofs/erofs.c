@@ -0,0 +1,238 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <debug.h>
+#include <endian.h>
+#include <err.h>
+#include <stdlib.h>
+#include <string.h>
+#include <lib/fs.h>
+
+#include "erofs_priv.h"
+
+/*
+ * erofs.c - Read-only driver for EROFS (Enhanced Read-Only File System).
+ *
+ * EROFS keeps the metadata compact: inodes are 32 or 64 bytes, addressed
+ * directly by their number, and small files or the tails of files are
+ * stored inline after the inode. File data is either stored in contiguous
+ * blocks or compressed into fixed-size physical clusters (see zdata.c).
+ * Metadata goes through a block cache, file data through a readahead
+ * window like on ext2.
+ *
+ * Not supported: extra devices, xattrs (skipped), and compressed files
+ * using fragments or tail packing.
+ */
+
+#define LOCAL_TRACE 0
+
+/* the features this driver knows, it refuses to mount anything else */
+#define EROFS_FEATURE_INCOMPAT_SUPPORTED \
+	(EROFS_FEATURE_INCOMPAT_ZERO_PADDING | EROFS_FEATURE_INCOMPAT_BIG_PCLUSTER | \
+	 EROFS_FEATURE_INCOMPAT_CHUNKED_FILE | EROFS_FEATURE_INCOMPAT_DEVICE_TABLE | \
+	 EROFS_FEATURE_INCOMPAT_ZTAILPACKING | EROFS_FEATURE_INCOMPAT_FRAGMENTS | \
+	 EROFS_FEATURE_INCOMPAT_XATTR_PREFIXES)
+
+int erofs_read_meta(erofs_t *erofs, void *_buf, off_t offset, size_t len)
+{
+	uint8_t *buf = _buf;
+	uint blkoff;
+	size_t n;
+	void *ptr;
+	int err;
+
+	while (len) {
+		blkoff = offset & (EROFS_BLKSIZ(erofs) - 1);
+		n = MIN(len, EROFS_BLKSIZ(erofs) - blkoff);
+
+		err = bcache_get_block(erofs->cache, &ptr, offset >> erofs->blkszbits);
+		if (err < 0)
+			return err;
+
+		memcpy(buf, (uint8_t *)ptr + blkoff, n);
+		bcache_put_block(erofs->cache, offset >> erofs->blkszbits);
+
+		buf += n;
+		offset += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+int erofs_read_data(erofs_t *erofs, void *buf, off_t offset, size_t len)
+{
+	ssize_t ret;
+
+	ret = bio_readahead_read(erofs->ra, erofs->dev, buf, offset, len);
+	if (ret < 0)
+		return ret;
+
+	return (ret == (ssize_t)len) ? 0 : ERR_IO;
+}
+
+int erofs_load_inode(erofs_t *erofs, erofs_nid_t nid, struct erofs_inode *inode)
+{
+	union {
+		struct erofs_inode_compact c;
+		struct erofs_inode_extended e;
+	} di;
+	uint16_t format, icount;
+	int err;
+
+	inode->nid = nid;
+	inode->iloc = ((off_t)erofs->meta_blkaddr << erofs->blkszbits) + (off_t)(nid << 5);
+
+	err = erofs_read_meta(erofs, &di.c, inode->iloc, sizeof(di.c));
+	if (err < 0)
+		return err;
+
+	format = LE16(di.c.i_format);
+	icount = LE16(di.c.i_xattr_icount);
+	inode->datalayout = (format >> EROFS_I_DATALAYOUT_SHIFT) & EROFS_I_DATALAYOUT_MASK;
+
+	switch (format & EROFS_I_VERSION_MASK) {
+	case EROFS_INODE_LAYOUT_COMPACT:
+		inode->isize = sizeof(di.c);
+		inode->mode = LE16(di.c.i_mode);
+		inode->size = LE32(di.c.i_size);
+		inode->u = LE32(di.c.i_u);
+		break;
+	case EROFS_INODE_LAYOUT_EXTENDED:
+		err = erofs_read_meta(erofs, &di.e, inode->iloc, sizeof(di.e));
+		if (err < 0)
+			return err;
+
+		inode->isize = sizeof(di.e);
+		inode->mode = LE16(di.e.i_mode);
+		inode->size = LE64(di.e.i_size);
+		inode->u = LE32(di.e.i_u);
+		break;
+	}
+
+	if (icount)
+		inode->isize += EROFS_XATTR_IBODY_HEADER_SIZE +
+				(icount - 1) * EROFS_XATTR_ENTRY_SIZE;
+
+	LTRACEF("nid %llu: format 0x%x, mode 0%o, size %lld\n",
+		nid, format, inode->mode, inode->size);
+
+	if (inode->datalayout > EROFS_INODE_CHUNK_BASED || inode->size < 0) {
+		dprintf(INFO, "erofs: Unsupported inode %llu (format 0x%x)\n", nid, format);
+		return ERR_NOT_SUPPORTED;
+	}
+
+	return 0;
+}
+
+static bool erofs_probe(const void *buf, size_t len)
+{
+	const struct erofs_super_block *sb =
+		(const void *)((const uint8_t *)buf + EROFS_SUPER_OFFSET);
+
+	if (len < EROFS_SUPER_OFFSET + sizeof(*sb))
+		return true;
+
+	return LE32(sb->magic) == EROFS_SUPER_MAGIC;
+}
+
+status_t erofs_mount(bdev_t *dev, fscookie **cookie)
+{
+	struct erofs_super_block sb;
+	erofs_t *erofs;
+	int err;
+
+	err = bio_read(dev, &sb, EROFS_SUPER_OFFSET, sizeof(sb));
+	if (err < 0)
+		return err;
+
+	if (LE32(sb.magic) != EROFS_SUPER_MAGIC)
+		return ERR_NOT_VALID;
+
+	LTRACEF("blkszbits %u, root nid %u, meta block %u, incompat 0x%x\n",
+		sb.blkszbits, LE16(sb.root_nid), LE32(sb.meta_blkaddr),
+		LE32(sb.feature_incompat));
+
+	if (LE32(sb.feature_incompat) & ~EROFS_FEATURE_INCOMPAT_SUPPORTED) {
+		dprintf(INFO, "erofs: Unsupported features 0x%x\n",
+			LE32(sb.feature_incompat) & ~EROFS_FEATURE_INCOMPAT_SUPPORTED);
+		return ERR_NOT_SUPPORTED;
+	}
+	if (LE16(sb.extra_devices)) {
+		dprintf(INFO, "erofs: Extra devices are not supported\n");
+		return ERR_NOT_SUPPORTED;
+	}
+	if (sb.blkszbits < 9 || sb.blkszbits > 16 || sb.dirblkbits > 4 ||
+	    (1U << sb.blkszbits) < dev->block_size) {
+		dprintf(INFO, "erofs: Unsupported block size 2^%u\n", sb.blkszbits);
+		return ERR_NOT_SUPPORTED;
+	}
+
+	erofs = calloc(1, sizeof(*erofs));
+	if (!erofs)
+		return ERR_NO_MEMORY;
+
+	erofs->dev = dev;
+	erofs->blkszbits = sb.blkszbits;
+	erofs->dirblkbits = sb.dirblkbits;
+	erofs->meta_blkaddr = LE32(sb.meta_blkaddr);
+	erofs->feature_incompat = LE32(sb.feature_incompat);
+
+	erofs->dirbuf = malloc(EROFS_DIRBLKSIZ(erofs));
+	erofs->cache = bcache_create(dev, EROFS_BLKSIZ(erofs), EROFS_BCACHE_BLOCKS);
+	if (!erofs->dirbuf || !erofs->cache) {
+		err = ERR_NO_MEMORY;
+		goto err;
+	}
+
+	err = erofs_load_inode(erofs, LE16(sb.root_nid), &erofs->root);
+	if (err < 0)
+		goto err;
+
+	if (!EROFS_S_ISDIR(erofs->root.mode)) {
+		err = ERR_NOT_VALID;
+		goto err;
+	}
+
+	/* file data is read through a readahead window */
+	erofs->ra = bio_readahead_create(dev);
+
+	*cookie = (fscookie *)erofs;
+	return 0;
+
+err:
+	if (erofs->cache)
+		bcache_destroy(erofs->cache);
+	free(erofs->dirbuf);
+	free(erofs);
+	return err;
+}
+
+status_t erofs_unmount(fscookie *cookie)
+{
+	erofs_t *erofs = (erofs_t *)cookie;
+
+	bio_readahead_destroy(erofs->ra);
+	bcache_destroy(erofs->cache);
+	free(erofs->dirbuf);
+	free(erofs);
+
+	return 0;
+}
+
+static const struct fs_api erofs_api = {
+	.probe = erofs_probe,
+	.mount = erofs_mount,
+	.unmount = erofs_unmount,
+	.open = erofs_open_file,
+	.stat = erofs_stat_file,
+	.read = erofs_read_file,
+	.close = erofs_close_file,
+	.opendir = erofs_open_directory,
+	.readdir = erofs_read_directory,
+	.closedir = erofs_close_directory,
+};
+
+void erofs_init(void)
+{
+	fs_register_type("erofs", &erofs_api);
+}
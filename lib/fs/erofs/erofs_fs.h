@@ -0,0 +1,164 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#ifndef __EROFS_FS_H
+#define __EROFS_FS_H
+
+#include <compiler.h>
+#include <stdint.h>
+
+/*
+ * On-disk format of EROFS, as documented in Documentation/filesystems/erofs.rst
+ * of Linux and defined in fs/erofs/erofs_fs.h. All fields are little endian.
+ */
+
+#define EROFS_SUPER_OFFSET		1024
+#define EROFS_SUPER_MAGIC		0xE0F5E1E2
+
+#define EROFS_FEATURE_INCOMPAT_ZERO_PADDING	0x00000001
+#define EROFS_FEATURE_INCOMPAT_BIG_PCLUSTER	0x00000002
+#define EROFS_FEATURE_INCOMPAT_CHUNKED_FILE	0x00000004
+#define EROFS_FEATURE_INCOMPAT_DEVICE_TABLE	0x00000008
+#define EROFS_FEATURE_INCOMPAT_ZTAILPACKING	0x00000010
+#define EROFS_FEATURE_INCOMPAT_FRAGMENTS	0x00000020
+#define EROFS_FEATURE_INCOMPAT_DEDUPE		0x00000020
+#define EROFS_FEATURE_INCOMPAT_XATTR_PREFIXES	0x00000040
+
+struct erofs_super_block {
+	uint32_t magic;
+	uint32_t checksum;
+	uint32_t feature_compat;
+	uint8_t blkszbits;
+	uint8_t sb_extslots;
+	uint16_t root_nid;
+	uint64_t inos;
+	uint64_t build_time;
+	uint32_t build_time_nsec;
+	uint32_t blocks;
+	uint32_t meta_blkaddr;
+	uint32_t xattr_blkaddr;
+	uint8_t uuid[16];
+	uint8_t volume_name[16];
+	uint32_t feature_incompat;
+	uint16_t available_compr_algs;	/* or lz4_max_distance */
+	uint16_t extra_devices;
+	uint16_t devt_slotoff;
+	uint8_t dirblkbits;
+	uint8_t xattr_prefix_count;
+	uint32_t xattr_prefix_start;
+	uint64_t packed_nid;
+	uint8_t xattr_filter_reserved;
+	uint8_t reserved2[23];
+} __PACKED;
+
+/* i_format: bit 0 selects the inode version, bits 1-3 the data layout */
+#define EROFS_I_VERSION_MASK		0x01
+#define EROFS_I_DATALAYOUT_SHIFT	1
+#define EROFS_I_DATALAYOUT_MASK		0x07
+
+#define EROFS_INODE_LAYOUT_COMPACT	0
+#define EROFS_INODE_LAYOUT_EXTENDED	1
+
+#define EROFS_INODE_FLAT_PLAIN			0
+#define EROFS_INODE_COMPRESSED_FULL		1
+#define EROFS_INODE_FLAT_INLINE			2
+#define EROFS_INODE_COMPRESSED_COMPACT		3
+#define EROFS_INODE_CHUNK_BASED			4
+
+/* i_u.c.format of chunk based inodes */
+#define EROFS_CHUNK_FORMAT_BLKBITS_MASK	0x001F
+#define EROFS_CHUNK_FORMAT_INDEXES	0x0020
+
+#define EROFS_NULL_ADDR			0xFFFFFFFF
+
+/* 32-byte inode */
+struct erofs_inode_compact {
+	uint16_t i_format;
+	uint16_t i_xattr_icount;
+	uint16_t i_mode;
+	uint16_t i_nlink;
+	uint32_t i_size;
+	uint32_t i_reserved;
+	uint32_t i_u;		/* raw_blkaddr, compressed_blocks or chunk format */
+	uint32_t i_ino;
+	uint16_t i_uid;
+	uint16_t i_gid;
+	uint32_t i_reserved2;
+} __PACKED;
+
+/* 64-byte inode, for large files and full timestamps */
+struct erofs_inode_extended {
+	uint16_t i_format;
+	uint16_t i_xattr_icount;
+	uint16_t i_mode;
+	uint16_t i_reserved;
+	uint64_t i_size;
+	uint32_t i_u;
+	uint32_t i_ino;
+	uint32_t i_uid;
+	uint32_t i_gid;
+	uint64_t i_mtime;
+	uint32_t i_mtime_nsec;
+	uint32_t i_nlink;
+	uint8_t i_reserved2[16];
+} __PACKED;
+
+/* the inline xattrs start with a 12 byte header and take 4 bytes per count */
+#define EROFS_XATTR_IBODY_HEADER_SIZE	12
+#define EROFS_XATTR_ENTRY_SIZE		4
+
+/* chunk index of chunk based inodes with EROFS_CHUNK_FORMAT_INDEXES */
+struct erofs_inode_chunk_index {
+	uint16_t advise;
+	uint16_t device_id;
+	uint32_t blkaddr;
+} __PACKED;
+
+struct erofs_dirent {
+	uint64_t nid;
+	uint16_t nameoff;
+	uint8_t file_type;
+	uint8_t reserved;
+} __PACKED;
+
+#define EROFS_FT_DIR			2
+
+/* compressed inodes: the map header follows the inode and xattrs, 8-byte aligned */
+struct z_erofs_map_header {
+	uint16_t h_reserved1;
+	uint16_t h_idata_size;
+	uint16_t h_advise;
+	uint8_t h_algorithmtype;	/* bits 0-3: HEAD1, bits 4-7: HEAD2 */
+	uint8_t h_clusterbits;		/* bits 0-2: lclusterbits - blkszbits */
+} __PACKED;
+
+#define Z_EROFS_ADVISE_COMPACTED_2B		0x0001
+#define Z_EROFS_ADVISE_BIG_PCLUSTER_1		0x0002
+#define Z_EROFS_ADVISE_BIG_PCLUSTER_2		0x0004
+#define Z_EROFS_ADVISE_INLINE_PCLUSTER		0x0008
+#define Z_EROFS_ADVISE_INTERLACED_PCLUSTER	0x0010
+#define Z_EROFS_ADVISE_FRAGMENT_PCLUSTER	0x0020
+
+#define Z_EROFS_COMPRESSION_LZ4		0
+
+/* lcluster types */
+#define Z_EROFS_LCLUSTER_TYPE_PLAIN	0
+#define Z_EROFS_LCLUSTER_TYPE_HEAD1	1
+#define Z_EROFS_LCLUSTER_TYPE_NONHEAD	2
+#define Z_EROFS_LCLUSTER_TYPE_HEAD2	3
+#define Z_EROFS_LI_LCLUSTER_TYPE_MASK	0x0003
+
+/* delta[0] of the first NONHEAD lcluster holds the pcluster size in blocks */
+#define Z_EROFS_LI_D0_CBLKCNT		(1 << 11)
+
+/* full (legacy) lcluster index, after the map header and 8 reserved bytes */
+struct z_erofs_lcluster_index {
+	uint16_t di_advise;
+	uint16_t di_clusterofs;
+	union {
+		uint32_t blkaddr;	/* HEAD and PLAIN */
+		uint16_t delta[2];	/* NONHEAD */
+	} di_u;
+} __PACKED;
+
+#define Z_EROFS_FULL_INDEX_RESERVED	8
+
+#endif
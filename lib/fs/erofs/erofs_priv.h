@@ -0,0 +1,103 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#ifndef __EROFS_PRIV_H
+#define __EROFS_PRIV_H
+
+#include <lib/bio.h>
+#include <lib/bcache.h>
+#include <lib/fs.h>
+#include "erofs_fs.h"
+
+typedef uint64_t erofs_nid_t;
+
+struct erofs_inode {
+	erofs_nid_t nid;
+	off_t iloc;		/* position of the inode on the device */
+	unsigned int isize;	/* inode and inline xattrs */
+	uint16_t mode;
+	uint8_t datalayout;
+	off_t size;
+	uint32_t u;		/* i_u, meaning depends on the layout */
+
+	/* compressed files, from the map header */
+	uint16_t z_advise;
+	uint8_t z_algorithmtype;
+	uint8_t z_lclusterbits;
+};
+
+typedef struct {
+	bdev_t *dev;
+	bcache_t cache;
+	struct bio_readahead *ra;
+
+	uint8_t blkszbits;
+	uint8_t dirblkbits;
+	uint32_t meta_blkaddr;
+	uint32_t feature_incompat;
+
+	struct erofs_inode root;
+	uint8_t *dirbuf;	/* one directory block */
+} erofs_t;
+
+#define EROFS_BLKSIZ(erofs)	(1U << (erofs)->blkszbits)
+#define EROFS_DIRBLKSIZ(erofs)	(1U << ((erofs)->blkszbits + (erofs)->dirblkbits))
+
+/* open file handle */
+typedef struct {
+	erofs_t *erofs;
+	struct erofs_inode inode;
+
+	/* compressed data of the current physical cluster */
+	uint8_t *cbuf;
+	size_t cbuf_size;
+
+	/* last extent of a compressed file that was only partially read */
+	uint8_t *zbuf;
+	size_t zbuf_size;
+	off_t zla;
+	size_t zllen;
+} erofs_file_t;
+
+typedef struct {
+	erofs_file_t *file;
+	off_t offset;		/* of the current directory block */
+	size_t blklen;		/* its length */
+	unsigned int index;	/* next entry in it */
+} erofs_dir_t;
+
+/* io */
+int erofs_read_meta(erofs_t *erofs, void *buf, off_t offset, size_t len);
+int erofs_read_data(erofs_t *erofs, void *buf, off_t offset, size_t len);
+
+/* inodes */
+int erofs_load_inode(erofs_t *erofs, erofs_nid_t nid, struct erofs_inode *inode);
+int erofs_map_flat(erofs_t *erofs, struct erofs_inode *inode, off_t offset, off_t *pa, off_t *plen);
+ssize_t erofs_read_inode(erofs_t *erofs, struct erofs_inode *inode, void *buf, off_t offset, size_t len);
+int erofs_lookup(erofs_t *erofs, const char *path, struct erofs_inode *inode);
+
+/* compressed files */
+int z_erofs_init_inode(erofs_t *erofs, struct erofs_inode *inode);
+ssize_t z_erofs_read_file(erofs_file_t *file, void *buf, off_t offset, size_t len);
+
+/* fs api */
+status_t erofs_mount(bdev_t *dev, fscookie **cookie);
+status_t erofs_unmount(fscookie *cookie);
+
+status_t erofs_open_file(fscookie *cookie, const char *path, filecookie **fcookie);
+ssize_t erofs_read_file(filecookie *fcookie, void *buf, off_t offset, size_t len);
+status_t erofs_close_file(filecookie *fcookie);
+status_t erofs_stat_file(filecookie *fcookie, struct file_stat *);
+
+status_t erofs_open_directory(fscookie *cookie, const char *path, dircookie **dcookie);
+status_t erofs_read_directory(dircookie *dcookie, struct dirent *ent);
+status_t erofs_close_directory(dircookie *dcookie);
+
+#define EROFS_S_IFMT	0170000
+#define EROFS_S_IFDIR	0040000
+#define EROFS_S_IFREG	0100000
+#define EROFS_S_IFLNK	0120000
+
+#define EROFS_S_ISDIR(mode)	(((mode) & EROFS_S_IFMT) == EROFS_S_IFDIR)
+#define EROFS_S_ISREG(mode)	(((mode) & EROFS_S_IFMT) == EROFS_S_IFREG)
+#define EROFS_S_ISLNK(mode)	(((mode) & EROFS_S_IFMT) == EROFS_S_IFLNK)
+
+#endif
@@ -0,0 +1,18 @@
+LOCAL_DIR := $(GET_LOCAL_DIR)
+
+MODULES += \
+	lib/fs \
+	lib/bcache \
+	lib/bio \
+	lib/lz4
+
+OBJS += \
+	$(LOCAL_DIR)/erofs.o \
+	$(LOCAL_DIR)/data.o \
+	$(LOCAL_DIR)/dir.o \
+	$(LOCAL_DIR)/zdata.o
+
+# Number of metadata blocks cached per mounted volume (inodes, indexes, directories)
+EROFS_BCACHE_BLOCKS ?= 16
+
+DEFINES += EROFS_BCACHE_BLOCKS=$(EROFS_BCACHE_BLOCKS)
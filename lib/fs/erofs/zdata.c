@@ -0,0 +1,473 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <debug.h>
+#include <endian.h>
+#include <err.h>
+#include <stdlib.h>
+#include <string.h>
+#include <lib/lz4.h>
+
+#include "erofs_priv.h"
+
+#define LOCAL_TRACE 0
+
+/*
+ * zdata.c - Compressed files of EROFS.
+ *
+ * The file is divided into logical clusters (lclusters) of usually one
+ * block, each of them has an index entry. The data is compressed into
+ * physical clusters (pclusters) of a fixed size, one block or a few with
+ * big pclusters, so an extent of decompressed data can start anywhere in
+ * an lcluster: HEAD lclusters hold the offset where a new extent starts
+ * and the block of its pcluster, NONHEAD lclusters are fully covered by
+ * the extent of an earlier HEAD and hold the distances to the HEAD before
+ * and after. PLAIN extents are stored without compression.
+ *
+ * The index entries are either 8 bytes each (COMPRESSED_FULL) or packed
+ * into 2 or 4 bytes per lcluster (COMPRESSED_COMPACT). Only LZ4 is
+ * supported.
+ */
+
+struct z_erofs_lcluster {
+	uint8_t type;
+	uint clusterofs;
+	uint delta[2];
+	uint32_t pblk;
+	uint compressedblks;
+};
+
+struct z_erofs_extent {
+	uint8_t type;		/* of the HEAD lcluster */
+	off_t la;		/* logical start */
+	size_t llen;		/* decompressed length */
+	off_t pa;		/* position of the pcluster */
+	size_t plen;		/* length of the pcluster */
+};
+
+static inline off_t z_erofs_map_header_pos(const struct erofs_inode *inode)
+{
+	return ROUNDUP(inode->iloc + inode->isize, (off_t)8);
+}
+
+int z_erofs_init_inode(erofs_t *erofs, struct erofs_inode *inode)
+{
+	struct z_erofs_map_header h;
+	int err;
+
+	err = erofs_read_meta(erofs, &h, z_erofs_map_header_pos(inode), sizeof(h));
+	if (err < 0)
+		return err;
+
+	inode->z_advise = LE16(h.h_advise);
+	inode->z_algorithmtype = h.h_algorithmtype;
+	inode->z_lclusterbits = erofs->blkszbits + (h.h_clusterbits & 7);
+
+	LTRACEF("nid %llu: advise 0x%x, algorithms 0x%x, lclusterbits %u\n",
+		inode->nid, inode->z_advise, inode->z_algorithmtype, inode->z_lclusterbits);
+
+	if (inode->z_advise & (Z_EROFS_ADVISE_INLINE_PCLUSTER | Z_EROFS_ADVISE_FRAGMENT_PCLUSTER)) {
+		dprintf(INFO, "erofs: Tail packing and fragments are not supported (nid %llu)\n",
+			inode->nid);
+		return ERR_NOT_SUPPORTED;
+	}
+
+	if ((inode->z_algorithmtype & 0xf) != Z_EROFS_COMPRESSION_LZ4) {
+		dprintf(INFO, "erofs: Unsupported compression %u (nid %llu)\n",
+			inode->z_algorithmtype & 0xf, inode->nid);
+		return ERR_NOT_SUPPORTED;
+	}
+
+	if (inode->datalayout == EROFS_INODE_COMPRESSED_COMPACT &&
+	    (inode->z_lclusterbits > 14 ||
+	     !(inode->z_advise & Z_EROFS_ADVISE_BIG_PCLUSTER_1) !=
+	     !(inode->z_advise & Z_EROFS_ADVISE_BIG_PCLUSTER_2)))
+		return ERR_NOT_VALID;
+
+	return 0;
+}
+
+static int z_erofs_load_full_lcluster(erofs_t *erofs, struct erofs_inode *inode,
+				      off_t lcn, struct z_erofs_lcluster *m)
+{
+	struct z_erofs_lcluster_index di;
+	int err;
+
+	err = erofs_read_meta(erofs, &di, z_erofs_map_header_pos(inode) +
+			      sizeof(struct z_erofs_map_header) +
+			      Z_EROFS_FULL_INDEX_RESERVED + lcn * sizeof(di), sizeof(di));
+	if (err < 0)
+		return err;
+
+	m->type = LE16(di.di_advise) & Z_EROFS_LI_LCLUSTER_TYPE_MASK;
+	if (m->type == Z_EROFS_LCLUSTER_TYPE_NONHEAD) {
+		m->clusterofs = 1 << inode->z_lclusterbits;
+		m->delta[0] = LE16(di.di_u.delta[0]);
+		m->delta[1] = LE16(di.di_u.delta[1]);
+		if (m->delta[0] & Z_EROFS_LI_D0_CBLKCNT) {
+			if (!(inode->z_advise & (Z_EROFS_ADVISE_BIG_PCLUSTER_1 |
+						 Z_EROFS_ADVISE_BIG_PCLUSTER_2)))
+				return ERR_NOT_VALID;
+			m->compressedblks = m->delta[0] & ~Z_EROFS_LI_D0_CBLKCNT;
+			m->delta[0] = 1;
+		}
+	} else {
+		m->clusterofs = LE16(di.di_clusterofs);
+		if (m->clusterofs >= 1U << inode->z_lclusterbits)
+			return ERR_NOT_VALID;
+		m->pblk = LE32(di.di_u.blkaddr);
+	}
+
+	return 0;
+}
+
+static uint z_erofs_decode_compactedbits(const uint8_t *in, uint lobits,
+					 uint pos, uint8_t *type)
+{
+	const uint8_t *p = in + pos / 8;
+	uint32_t v = (p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24) >> (pos & 7);
+
+	*type = (v >> lobits) & 3;
+	return v & ((1 << lobits) - 1);
+}
+
+/*
+ * Compact indexes come in packs of 2 entries in 8 bytes or 16 entries in
+ * 32 bytes, each ending with the block of the pack's first pcluster. The
+ * block of a HEAD is found by counting the pclusters before it in the pack.
+ * The last entry of a pack holds delta[1] instead of delta[0].
+ */
+static int z_erofs_load_compact_lcluster(erofs_t *erofs, struct erofs_inode *inode,
+					 off_t lcn, struct z_erofs_lcluster *m)
+{
+	const uint lclusterbits = inode->z_lclusterbits;
+	const uint lobits = MAX(lclusterbits, 12U);
+	const bool big_pcluster = inode->z_advise & Z_EROFS_ADVISE_BIG_PCLUSTER_1;
+	const off_t ebase = z_erofs_map_header_pos(inode) + sizeof(struct z_erofs_map_header);
+	const off_t totalidx = (inode->size + (1 << lclusterbits) - 1) >> lclusterbits;
+	uint compacted_4b_initial, compacted_2b, amortizedshift;
+	uint vcnt, packsize, encodebits, nblk, lo, d1;
+	uint8_t pack[32], type;
+	off_t pos;
+	int i, err;
+
+	if (lcn >= totalidx)
+		return ERR_NOT_VALID;
+
+	/* 4 byte entries until the 2 byte packs are 32 byte aligned */
+	compacted_4b_initial = ((32 - ebase % 32) / 4) & 7;
+	if ((inode->z_advise & Z_EROFS_ADVISE_COMPACTED_2B) && compacted_4b_initial < totalidx)
+		compacted_2b = ROUNDDOWN(totalidx - compacted_4b_initial, 16);
+	else
+		compacted_2b = 0;
+
+	pos = ebase;
+	if (lcn < compacted_4b_initial) {
+		amortizedshift = 2;
+	} else if (lcn < compacted_4b_initial + compacted_2b) {
+		amortizedshift = 1;
+		pos += compacted_4b_initial * 4;
+		lcn -= compacted_4b_initial;
+	} else {
+		amortizedshift = 2;
+		pos += compacted_4b_initial * 4 + compacted_2b * 2;
+		lcn -= compacted_4b_initial + compacted_2b;
+	}
+	pos += lcn << amortizedshift;
+
+	if (amortizedshift == 2)
+		vcnt = 2;
+	else if (lclusterbits <= 12)
+		vcnt = 16;
+	else
+		return ERR_NOT_SUPPORTED;
+
+	packsize = vcnt << amortizedshift;
+	encodebits = (packsize - 4) * 8 / vcnt;
+	i = (pos & (packsize - 1)) >> amortizedshift;
+
+	err = erofs_read_meta(erofs, pack, pos & ~(off_t)(packsize - 1), packsize);
+	if (err < 0)
+		return err;
+
+	lo = z_erofs_decode_compactedbits(pack, lobits, encodebits * i, &m->type);
+	if (m->type == Z_EROFS_LCLUSTER_TYPE_NONHEAD) {
+		m->clusterofs = 1 << lclusterbits;
+
+		/* delta[1]: the NONHEADs up to the next HEAD in or after the pack */
+		for (d1 = 0; i + d1 < vcnt; d1++) {
+			lo = z_erofs_decode_compactedbits(pack, lobits,
+							  encodebits * (i + d1), &type);
+			if (type != Z_EROFS_LCLUSTER_TYPE_NONHEAD)
+				break;
+		}
+		if (i + d1 == vcnt && !(lo & Z_EROFS_LI_D0_CBLKCNT))
+			d1 += lo - 1;
+		m->delta[1] = d1;
+
+		lo = z_erofs_decode_compactedbits(pack, lobits, encodebits * i, &type);
+		if (lo & Z_EROFS_LI_D0_CBLKCNT) {
+			if (!big_pcluster)
+				return ERR_NOT_VALID;
+			m->compressedblks = lo & ~Z_EROFS_LI_D0_CBLKCNT;
+			m->delta[0] = 1;
+			return 0;
+		} else if (i + 1 != (int)vcnt) {
+			m->delta[0] = lo;
+			return 0;
+		}
+
+		/* the last one holds delta[1], derive delta[0] from the previous one */
+		lo = z_erofs_decode_compactedbits(pack, lobits, encodebits * (i - 1), &type);
+		if (type != Z_EROFS_LCLUSTER_TYPE_NONHEAD)
+			lo = 0;
+		else if (lo & Z_EROFS_LI_D0_CBLKCNT)
+			lo = 1;
+		m->delta[0] = lo + 1;
+		return 0;
+	}
+
+	m->clusterofs = lo;
+	m->delta[0] = 0;
+
+	/* count the pclusters before this HEAD in the pack */
+	if (!big_pcluster) {
+		nblk = 1;
+		while (i > 0) {
+			--i;
+			lo = z_erofs_decode_compactedbits(pack, lobits, encodebits * i, &type);
+			if (type == Z_EROFS_LCLUSTER_TYPE_NONHEAD)
+				i -= lo;
+			if (i >= 0)
+				++nblk;
+		}
+	} else {
+		nblk = 0;
+		while (i > 0) {
+			--i;
+			lo = z_erofs_decode_compactedbits(pack, lobits, encodebits * i, &type);
+			if (type == Z_EROFS_LCLUSTER_TYPE_NONHEAD) {
+				if (lo & Z_EROFS_LI_D0_CBLKCNT) {
+					--i;
+					nblk += lo & ~Z_EROFS_LI_D0_CBLKCNT;
+					continue;
+				}
+				/* big pclusters don't have a plain delta[0] of 1 */
+				if (lo <= 1)
+					return ERR_NOT_VALID;
+				i -= lo - 2;
+				continue;
+			}
+			++nblk;
+		}
+	}
+
+	m->pblk = (pack[packsize - 4] | pack[packsize - 3] << 8 |
+		   pack[packsize - 2] << 16 | (uint32_t)pack[packsize - 1] << 24) + nblk;
+	return 0;
+}
+
+static int z_erofs_load_lcluster(erofs_t *erofs, struct erofs_inode *inode,
+				 off_t lcn, struct z_erofs_lcluster *m)
+{
+	memset(m, 0, sizeof(*m));
+
+	if (inode->datalayout == EROFS_INODE_COMPRESSED_FULL)
+		return z_erofs_load_full_lcluster(erofs, inode, lcn, m);
+
+	return z_erofs_load_compact_lcluster(erofs, inode, lcn, m);
+}
+
+/* Find the whole extent that contains offset. */
+static int z_erofs_map(erofs_t *erofs, struct erofs_inode *inode, off_t offset,
+		       struct z_erofs_extent *ext)
+{
+	const uint lclusterbits = inode->z_lclusterbits;
+	struct z_erofs_lcluster m;
+	off_t lcn = offset >> lclusterbits;
+	uint lookback = 0, cblks;
+	int err;
+
+	err = z_erofs_load_lcluster(erofs, inode, lcn, &m);
+	if (err < 0)
+		return err;
+
+	if (m.type == Z_EROFS_LCLUSTER_TYPE_NONHEAD)
+		lookback = m.delta[0];
+	else if ((offset & ((1 << lclusterbits) - 1)) < m.clusterofs)
+		lookback = 1;	/* before the extent that starts here */
+
+	/* walk back to the HEAD of the extent */
+	while (lookback) {
+		if (lcn < lookback)
+			return ERR_NOT_VALID;
+		lcn -= lookback;
+
+		err = z_erofs_load_lcluster(erofs, inode, lcn, &m);
+		if (err < 0)
+			return err;
+
+		lookback = (m.type == Z_EROFS_LCLUSTER_TYPE_NONHEAD) ? m.delta[0] : 0;
+		if (m.type == Z_EROFS_LCLUSTER_TYPE_NONHEAD && !lookback)
+			return ERR_NOT_VALID;
+	}
+
+	ext->type = m.type;
+	ext->la = (lcn << lclusterbits) + m.clusterofs;
+	ext->pa = (off_t)m.pblk << erofs->blkszbits;
+
+	if (m.type == Z_EROFS_LCLUSTER_TYPE_HEAD2 &&
+	    (inode->z_algorithmtype >> 4) != Z_EROFS_COMPRESSION_LZ4)
+		return ERR_NOT_SUPPORTED;
+
+	/* big pclusters store their size in the first NONHEAD lcluster */
+	cblks = 1 << (lclusterbits - erofs->blkszbits);
+	if (((m.type == Z_EROFS_LCLUSTER_TYPE_HEAD1 &&
+	      (inode->z_advise & Z_EROFS_ADVISE_BIG_PCLUSTER_1)) ||
+	     (m.type == Z_EROFS_LCLUSTER_TYPE_HEAD2 &&
+	      (inode->z_advise & Z_EROFS_ADVISE_BIG_PCLUSTER_2))) &&
+	    ((lcn + 1) << lclusterbits) < inode->size) {
+		err = z_erofs_load_lcluster(erofs, inode, lcn + 1, &m);
+		if (err < 0)
+			return err;
+
+		if (m.type == Z_EROFS_LCLUSTER_TYPE_NONHEAD) {
+			if (m.delta[0] != 1 || !m.compressedblks)
+				return ERR_NOT_VALID;
+			cblks = m.compressedblks;
+		}
+	}
+	ext->plen = (size_t)cblks << erofs->blkszbits;
+
+	/* the extent ends where the next one starts */
+	for (lcn++; (lcn << lclusterbits) < inode->size; lcn += m.delta[1] ?: 1) {
+		err = z_erofs_load_lcluster(erofs, inode, lcn, &m);
+		if (err < 0)
+			return err;
+
+		if (m.type != Z_EROFS_LCLUSTER_TYPE_NONHEAD) {
+			ext->llen = (lcn << lclusterbits) + m.clusterofs - ext->la;
+			return 0;
+		}
+	}
+
+	ext->llen = inode->size - ext->la;
+	return 0;
+}
+
+/* Decompress the whole extent into out, which has room for ext->llen bytes. */
+static int z_erofs_decompress(erofs_file_t *file, const struct z_erofs_extent *ext,
+			      uint8_t *out)
+{
+	erofs_t *erofs = file->erofs;
+	const uint8_t *in;
+	size_t inlen, n;
+	ssize_t ret;
+	uint ofs;
+	int err;
+
+	LTRACEF("type %u, la %lld+%zu, pa %lld+%zu\n",
+		ext->type, ext->la, ext->llen, ext->pa, ext->plen);
+
+	if (ext->type == Z_EROFS_LCLUSTER_TYPE_PLAIN) {
+		if (ext->llen > ext->plen)
+			return ERR_NOT_VALID;
+
+		if (!(file->inode.z_advise & Z_EROFS_ADVISE_INTERLACED_PCLUSTER))
+			return erofs_read_data(erofs, out, ext->pa, ext->llen);
+
+		/* interlaced: the data starts at the offset of the extent in the block */
+		ofs = ext->la & (EROFS_BLKSIZ(erofs) - 1);
+		n = MIN(ext->llen, EROFS_BLKSIZ(erofs) - ofs);
+		err = erofs_read_data(erofs, out, ext->pa + ofs, n);
+		if (err < 0 || n == ext->llen)
+			return err;
+		return erofs_read_data(erofs, out + n, ext->pa, ext->llen - n);
+	}
+
+	if (file->cbuf_size < ext->plen) {
+		free(file->cbuf);
+		file->cbuf = malloc(ext->plen);
+		file->cbuf_size = file->cbuf ? ext->plen : 0;
+		if (!file->cbuf)
+			return ERR_NO_MEMORY;
+	}
+
+	err = erofs_read_data(erofs, file->cbuf, ext->pa, ext->plen);
+	if (err < 0)
+		return err;
+
+	/* with zero padding the data is at the end of the pcluster */
+	in = file->cbuf;
+	inlen = ext->plen;
+	if (erofs->feature_incompat & EROFS_FEATURE_INCOMPAT_ZERO_PADDING) {
+		while (inlen && !*in) {
+			in++;
+			inlen--;
+		}
+	}
+
+	ret = lz4_decompress_raw(in, inlen, out, ext->llen);
+	if (ret < 0 || (size_t)ret != ext->llen) {
+		dprintf(INFO, "erofs: Failed to decompress %lld+%zu of nid %llu: %ld\n",
+			ext->la, ext->llen, file->inode.nid, (long)ret);
+		return ERR_NOT_VALID;
+	}
+
+	return 0;
+}
+
+/*
+ * Extents that are read completely are decompressed straight into buf,
+ * others into zbuf, which is kept for the next read.
+ */
+ssize_t z_erofs_read_file(erofs_file_t *file, void *_buf, off_t offset, size_t len)
+{
+	struct z_erofs_extent ext;
+	uint8_t *buf = _buf;
+	size_t done = 0, n;
+	int err;
+
+	while (done < len) {
+		if (file->zllen && offset >= file->zla &&
+		    offset < file->zla + (off_t)file->zllen) {
+			n = MIN(len - done, file->zla + file->zllen - offset);
+			memcpy(buf + done, file->zbuf + (offset - file->zla), n);
+			done += n;
+			offset += n;
+			continue;
+		}
+
+		err = z_erofs_map(file->erofs, &file->inode, offset, &ext);
+		if (err < 0)
+			return err;
+
+		if (ext.la > offset || ext.llen == 0)
+			return ERR_NOT_VALID;
+
+		if (ext.la == offset && ext.llen <= len - done) {
+			err = z_erofs_decompress(file, &ext, buf + done);
+			if (err < 0)
+				return err;
+			done += ext.llen;
+			offset += ext.llen;
+			continue;
+		}
+
+		if (file->zbuf_size < ext.llen) {
+			free(file->zbuf);
+			file->zbuf = malloc(ext.llen);
+			file->zbuf_size = file->zbuf ? ext.llen : 0;
+			if (!file->zbuf)
+				return ERR_NO_MEMORY;
+		}
+
+		file->zllen = 0;
+		err = z_erofs_decompress(file, &ext, file->zbuf);
+		if (err < 0)
+			return err;
+		file->zla = ext.la;
+		file->zllen = ext.llen;
+	}
+
+	return done;
+}
@@ -28,68 +28,232 @@
 
 #define LOCAL_TRACE 0
 
-/* read in the dir, look for the entry */
-static int ext2_dir_lookup(ext2_t *ext2, struct ext2_inode *dir_inode, const char *name, inodenum_t *inum)
+static bool ext2_dcache_find(ext2_t *ext2, inodenum_t dir, const char *name, size_t namelen, inodenum_t *inum)
+{
+    struct ext2_dentry *d;
+    uint i;
+
+    for (i = 0; i < EXT2_DCACHE_ENTRIES; i++) {
+        d = &ext2->dcache[i];
+        if (d->dir == dir && d->name_len == namelen && memcmp(d->name, name, namelen) == 0) {
+            *inum = d->inum;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void ext2_dcache_add(ext2_t *ext2, inodenum_t dir, const char *name, size_t namelen, inodenum_t inum)
+{
+    struct ext2_dentry *d;
+
+    if (namelen > EXT2_DCACHE_NAME_LEN)
+        return;
+
+    d = &ext2->dcache[ext2->dcache_next];
+    ext2->dcache_next = (ext2->dcache_next + 1) % EXT2_DCACHE_ENTRIES;
+
+    d->dir = dir;
+    d->inum = inum;
+    d->name_len = namelen;
+    memcpy(d->name, name, namelen);
+}
+
+/* walk through the directory entries of one block, looking for the one that matches */
+static bool ext2_dir_search_block(ext2_t *ext2, const uint8_t *buf, const char *name, size_t namelen, inodenum_t *inum)
+{
+    const struct ext2_dir_entry_2 *ent;
+    uint pos = 0;
+
+    while (pos + 8 <= EXT2_BLOCK_SIZE(ext2->sb)) {
+        ent = (const struct ext2_dir_entry_2 *)&buf[pos];
+
+        LTRACEF("ent %d: inode 0x%x, reclen %d, namelen %d\n",
+                pos, LE32(ent->inode), LE16(ent->rec_len), ent->name_len/* , ent->name*/);
+
+        /* sanity check the record length */
+        if (LE16(ent->rec_len) == 0)
+            break;
+
+        if (LE32(ent->inode) != 0 && ent->name_len == namelen &&
+                pos + 8 + namelen <= EXT2_BLOCK_SIZE(ext2->sb) &&
+                memcmp(name, ent->name, ent->name_len) == 0) {
+            // match
+            *inum = LE32(ent->inode);
+            LTRACEF("match: inode %d\n", *inum);
+            return true;
+        }
+
+        pos += ROUNDUP(LE16(ent->rec_len), 4);
+    }
+
+    return false;
+}
+
+/* read in the dir block by block, look for the entry */
+static int ext2_dir_scan(ext2_t *ext2, struct ext2_inode *dir_inode, uint8_t *buf, const char *name, size_t namelen, inodenum_t *inum)
 {
     uint file_blocknum;
     int err;
-    uint8_t *buf;
-    size_t namelen = strlen(name);
 
-    if (!S_ISDIR(dir_inode->i_mode))
-        return ERR_NOT_DIR;
-
-    buf = malloc(EXT2_BLOCK_SIZE(ext2->sb));
+    for (file_blocknum = 0;; file_blocknum++) {
+        /* sanity check the directory. 4MB should be enough */
+        if (file_blocknum > 1024)
+            return ERR_NOT_FOUND;
 
-    file_blocknum = 0;
-    for (;;) {
         /* read in the offset */
         err = ext2_read_inode(ext2, dir_inode, buf, file_blocknum * EXT2_BLOCK_SIZE(ext2->sb), EXT2_BLOCK_SIZE(ext2->sb));
-        if (err <= 0) {
-            free(buf);
-            return -1;
-        }
+        if (err < 0)
+            return err;
+        if (err == 0)
+            return ERR_NOT_FOUND;
 
-        /* walk through the directory entries, looking for the one that matches */
-        struct ext2_dir_entry_2 *ent;
-        uint pos = 0;
-        while (pos < EXT2_BLOCK_SIZE(ext2->sb)) {
-            ent = (struct ext2_dir_entry_2 *)&buf[pos];
-
-            LTRACEF("ent %d:%d: inode 0x%x, reclen %d, namelen %d\n",
-                    file_blocknum, pos, LE32(ent->inode), LE16(ent->rec_len), ent->name_len/* , ent->name*/);
-
-            /* sanity check the record length */
-            if (LE16(ent->rec_len) == 0)
-                break;
-
-            if (ent->name_len == namelen && memcmp(name, ent->name, ent->name_len) == 0) {
-                // match
-                *inum = LE32(ent->inode);
-                LTRACEF("match: inode %d\n", *inum);
-                free(buf);
-                return 1;
-            }
+        if (ext2_dir_search_block(ext2, buf, name, namelen, inum))
+            return 1;
+    }
+}
 
-            pos += ROUNDUP(LE16(ent->rec_len), 4);
-        }
+/*
+ * Look up the entry through the htree index of the directory, reading only
+ * the index blocks and the leaf block the hash of the name falls into.
+ * Returns ERR_NOT_SUPPORTED if the directory has to be scanned instead,
+ * e.g. for unknown hashes or collisions that continue in the next leaf.
+ */
+static int ext2_dir_htree_lookup(ext2_t *ext2, struct ext2_inode *dir_inode, uint8_t *buf, const char *name, size_t namelen, inodenum_t *inum)
+{
+    const uint block_size = EXT2_BLOCK_SIZE(ext2->sb);
+    const struct ext2_dx_root_info *root;
+    const struct ext2_dx_countlimit *cl;
+    const struct ext2_dx_entry *entries;
+    uint32_t hash, next_hash = 0;
+    uint count, limit, lo, hi, mid;
+    uint version, levels, offset;
+    blocknum_t block = 0;
+    bool has_next = false;
+    int err;
 
-        file_blocknum++;
+    err = ext2_read_inode(ext2, dir_inode, buf, 0, block_size);
+    if (err < 0)
+        return err;
+    if ((uint)err < block_size)
+        return ERR_NOT_SUPPORTED;
+
+    root = (const struct ext2_dx_root_info *)&buf[EXT2_DX_ROOT_OFFSET];
+    if (root->reserved_zero != 0 || root->info_length != sizeof(*root) ||
+            root->indirect_levels >= EXT2_DX_MAX_LEVELS)
+        return ERR_NOT_SUPPORTED;
+
+    version = root->hash_version;
+    if (version <= EXT2_DX_HASH_TEA) {
+        if (ext2->sb.s_flags & EXT2_FLAGS_UNSIGNED_HASH)
+            version += EXT2_DX_HASH_LEGACY_UNSIGNED;
+#ifdef __CHAR_UNSIGNED__
+        else if (!(ext2->sb.s_flags & EXT2_FLAGS_SIGNED_HASH))
+            version += EXT2_DX_HASH_LEGACY_UNSIGNED;
+#endif
+    }
 
-        /* sanity check the directory. 4MB should be enough */
-        if (file_blocknum > 1024) {
-            free(buf);
-            return -1;
+    if (ext2_dx_hash(name, namelen, version, ext2->sb.s_hash_seed, &hash) < 0)
+        return ERR_NOT_SUPPORTED;
+
+    LTRACEF("name '%s', hash version %u, hash 0x%x, levels %u\n", name, version, hash, root->indirect_levels);
+
+    levels = root->indirect_levels;
+    offset = EXT2_DX_ROOT_OFFSET + root->info_length;
+    for (;;) {
+        cl = (const struct ext2_dx_countlimit *)&buf[offset];
+        entries = (const struct ext2_dx_entry *)&buf[offset];
+        count = LE16(cl->count);
+        limit = LE16(cl->limit);
+        if (count == 0 || count > limit || offset + limit * sizeof(*entries) > block_size)
+            return ERR_NOT_SUPPORTED;
+
+        /* find the last entry with a hash <= the one looked up, the first has none */
+        lo = 1;
+        hi = count;
+        while (lo < hi) {
+            mid = lo + (hi - lo) / 2;
+            if (LE32(entries[mid].hash) > hash)
+                hi = mid;
+            else
+                lo = mid + 1;
         }
+        block = LE32(entries[lo - 1].block) & EXT2_DX_BLOCK_MASK;
+
+        has_next = lo < count;
+        if (has_next)
+            next_hash = LE32(entries[lo].hash);
+
+        err = ext2_read_inode(ext2, dir_inode, buf, (off_t)block * block_size, block_size);
+        if (err < 0)
+            return err;
+        if ((uint)err < block_size)
+            return ERR_NOT_SUPPORTED;
+
+        if (levels-- == 0)
+            break;
+        offset = EXT2_DX_NODE_OFFSET;
+    }
+
+    if (ext2_dir_search_block(ext2, buf, name, namelen, inum))
+        return 1;
+
+    /*
+     * The name may still be in the following leaf if it shares the hash,
+     * or in the next index block if this was the last entry of a lower level.
+     */
+    if ((has_next && (next_hash & ~1U) == hash) || (!has_next && root->indirect_levels > 0))
+        return ERR_NOT_SUPPORTED;
+
+    return ERR_NOT_FOUND;
+}
+
+/* look up one path component in a directory */
+static int ext2_dir_lookup(ext2_t *ext2, inodenum_t dir_inum, struct ext2_inode *dir_inode, const char *name, inodenum_t *inum)
+{
+    size_t namelen = strlen(name);
+    uint8_t *buf;
+    int err;
+
+    if (!S_ISDIR(dir_inode->i_mode))
+        return ERR_NOT_DIR;
+
+    if (namelen > EXT2_NAME_LEN)
+        return ERR_NOT_FOUND;
+
+    if (ext2_dcache_find(ext2, dir_inum, name, namelen, inum)) {
+        LTRACEF("dcache: '%s' in %u is inode %u\n", name, dir_inum, *inum);
+        return *inum ? 1 : ERR_NOT_FOUND;
     }
+
+    buf = malloc(EXT2_BLOCK_SIZE(ext2->sb));
+    if (!buf)
+        return ERR_NO_MEMORY;
+
+    err = ERR_NOT_SUPPORTED;
+    if ((ext2->sb.s_feature_compat & EXT2_FEATURE_COMPAT_DIR_INDEX) &&
+            (dir_inode->i_flags & EXT2_INDEX_FL))
+        err = ext2_dir_htree_lookup(ext2, dir_inode, buf, name, namelen, inum);
+    if (err == ERR_NOT_SUPPORTED)
+        err = ext2_dir_scan(ext2, dir_inode, buf, name, namelen, inum);
+
+    free(buf);
+
+    if (err == 1)
+        ext2_dcache_add(ext2, dir_inum, name, namelen, *inum);
+    else if (err == ERR_NOT_FOUND)
+        ext2_dcache_add(ext2, dir_inum, name, namelen, 0);
+
+    return err;
 }
 
 /* note, trashes path */
-static int ext2_walk(ext2_t *ext2, char *path, struct ext2_inode *start_inode, inodenum_t *inum, int recurse)
+static int ext2_walk(ext2_t *ext2, char *path, inodenum_t start_inum, struct ext2_inode *start_inode, inodenum_t *inum, int recurse)
 {
     char *ptr;
     struct ext2_inode inode;
     struct ext2_inode dir_inode;
+    inodenum_t dir_inum;
     int err;
     bool done;
 
@@ -104,6 +268,7 @@ static int ext2_walk(ext2_t *ext2, char *path, struct ext2_inode *start_inode, i
         ptr++;
 
     done = false;
+    dir_inum = start_inum;
     memcpy(&dir_inode, start_inode, sizeof(struct ext2_inode));
     while (!done) {
         /* process the first component */
@@ -119,7 +284,7 @@ static int ext2_walk(ext2_t *ext2, char *path, struct ext2_inode *start_inode, i
         LTRACEF("component '%s', done %d\n", ptr, done);
 
         /* do the lookup on this component */
-        err = ext2_dir_lookup(ext2, &dir_inode, ptr, inum);
+        err = ext2_dir_lookup(ext2, dir_inum, &dir_inode, ptr, inum);
         if (err < 0)
             return err;
 
@@ -146,9 +311,9 @@ nextcomponent:
             /* recurse, parsing the link */
             if (link[0] == '/') {
                 /* link starts with '/', so start over again at the rootfs */
-                err = ext2_walk(ext2, link, &ext2->root_inode, inum, recurse + 1);
+                err = ext2_walk(ext2, link, EXT2_ROOT_INO, &ext2->root_inode, inum, recurse + 1);
             } else {
-                err = ext2_walk(ext2, link, &dir_inode, inum, recurse + 1);
+                err = ext2_walk(ext2, link, dir_inum, &dir_inode, inum, recurse + 1);
             }
 
             LTRACEF("recursive walk returns %d\n", err);
@@ -162,6 +327,7 @@ nextcomponent:
             }
         } else if (S_ISDIR(inode.i_mode)) {
             /* for the next cycle, point the dir inode at our new directory */
+            dir_inum = *inum;
             memcpy(&dir_inode, &inode, sizeof(struct ext2_inode));
         } else {
             if (!done) {
@@ -192,7 +358,7 @@ int ext2_lookup(ext2_t *ext2, const char *_path, inodenum_t *inum)
     char path[512];
     strlcpy(path, _path, sizeof(path));
 
-    return ext2_walk(ext2, path, &ext2->root_inode, inum, 1);
+    return ext2_walk(ext2, path, EXT2_ROOT_INO, &ext2->root_inode, inum, 1);
 }
 
 status_t ext2_open_directory(fscookie *cookie, const char *path, dircookie **dcookie) {
@@ -68,8 +68,16 @@ static void endian_swap_superblock(struct ext2_super_block *sb)
     LE32SWAP(sb->s_journal_inum);
     LE32SWAP(sb->s_journal_dev);
     LE32SWAP(sb->s_last_orphan);
+    LE16SWAP(sb->s_desc_size);
     LE32SWAP(sb->s_default_mount_opts);
     LE32SWAP(sb->s_first_meta_bg);
+
+    /* htree */
+    LE32SWAP(sb->s_hash_seed[0]);
+    LE32SWAP(sb->s_hash_seed[1]);
+    LE32SWAP(sb->s_hash_seed[2]);
+    LE32SWAP(sb->s_hash_seed[3]);
+    LE32SWAP(sb->s_flags);
 }
 
 static void endian_swap_inode(struct ext2_inode *inode)
@@ -107,13 +115,23 @@ static void endian_swap_group_desc(struct ext2_group_desc *gd)
     LE16SWAP(gd->bg_used_dirs_count);
 }
 
+static bool ext2_probe(const void *buf, size_t len)
+{
+    const struct ext2_super_block *sb = (const void *)((const uint8_t *)buf + 1024);
+
+    if (len < 1024 + sizeof(*sb))
+        return true;
+
+    return LE16(sb->s_magic) == EXT2_SUPER_MAGIC;
+}
+
 status_t ext2_mount(bdev_t *dev, fscookie **cookie)
 {
     int err;
 
     LTRACEF("dev %p\n", dev);
 
-    ext2_t *ext2 = malloc(sizeof(ext2_t));
+    ext2_t *ext2 = calloc(1, sizeof(ext2_t));
     ext2->dev = dev;
 
     err = bio_read(dev, &ext2->sb, 1024, sizeof(struct ext2_super_block));
@@ -125,7 +143,7 @@ status_t ext2_mount(bdev_t *dev, fscookie **cookie)
     /* see if the superblock is good */
     if (ext2->sb.s_magic != EXT2_SUPER_MAGIC) {
         err = -1;
-        return err;
+        goto err;
     }
 
     /* calculate group count, rounded up */
@@ -146,45 +164,44 @@ status_t ext2_mount(bdev_t *dev, fscookie **cookie)
     /* we only support dynamic revs */
     if (ext2->sb.s_rev_level > EXT2_DYNAMIC_REV) {
         err = -2;
-        return err;
-    }
-
-    /* make sure it doesn't have any ro features we don't support */
-    if (ext2->sb.s_feature_ro_compat & ~(EXT2_FEATURE_RO_COMPAT_SPARSE_SUPER|EXT2_FEATURE_RO_COMPAT_LARGE_FILE)) {
-        err = -3;
-        return err;
+        goto err;
     }
 
-    /* read in all the group descriptors */
-    ext2->gd = malloc(sizeof(struct ext2_group_desc) * ext2->s_group_count);
-    err = bio_read(ext2->dev, (void *)ext2->gd,
-                   (EXT2_BLOCK_SIZE(ext2->sb) == 4096) ? 4096 : 2048,
-                   sizeof(struct ext2_group_desc) * ext2->s_group_count);
-    if (err < 0) {
+    /*
+     * ro_compat features only matter when writing to the volume, which
+     * is not supported anyway, so they are deliberately not checked here.
+     */
+
+    /* 64bit volumes may use larger group descriptors, only the low half is used */
+    ext2->gd_size = sizeof(struct ext2_group_desc);
+    if ((ext2->sb.s_feature_incompat & EXT4_FEATURE_INCOMPAT_64BIT) &&
+            ext2->sb.s_desc_size > ext2->gd_size)
+        ext2->gd_size = ext2->sb.s_desc_size;
+
+    /*
+     * The group descriptors are only read when an inode of the group is
+     * loaded, there can be tens of thousands of them on large volumes.
+     */
+    ext2->gd_offset = (EXT2_BLOCK_SIZE(ext2->sb) == 4096) ? 4096 : 2048;
+    ext2->gd_per_chunk = EXT2_BLOCK_SIZE(ext2->sb) / ext2->gd_size;
+    if (ext2->gd_per_chunk == 0) {
         err = -4;
-        return err;
-    }
-
-    int i;
-    for (i=0; i < ext2->s_group_count; i++) {
-        endian_swap_group_desc(&ext2->gd[i]);
-        LTRACEF("group %d:\n", i);
-        LTRACEF("\tblock bitmap %d\n", ext2->gd[i].bg_block_bitmap);
-        LTRACEF("\tinode bitmap %d\n", ext2->gd[i].bg_inode_bitmap);
-        LTRACEF("\tinode table %d\n", ext2->gd[i].bg_inode_table);
-        LTRACEF("\tfree blocks %d\n", ext2->gd[i].bg_free_blocks_count);
-        LTRACEF("\tfree inodes %d\n", ext2->gd[i].bg_free_inodes_count);
-        LTRACEF("\tused dirs %d\n", ext2->gd[i].bg_used_dirs_count);
+        goto err;
     }
+    for (int i = 0; i < EXT2_GD_CHUNKS; i++)
+        ext2->gd_chunks[i].count = 0;
 
     /* initialize the block cache */
-    ext2->cache = bcache_create(ext2->dev, EXT2_BLOCK_SIZE(ext2->sb), 4);
+    ext2->cache = bcache_create(ext2->dev, EXT2_BLOCK_SIZE(ext2->sb), EXT2_BCACHE_BLOCKS);
 
     /* load the first inode */
     err = ext2_load_inode(ext2, EXT2_ROOT_INO, &ext2->root_inode);
     if (err < 0)
         goto err;
 
+    /* file data is read through a readahead window */
+    ext2->ra = bio_readahead_create(ext2->dev);
+
 //  TRACE("successfully mounted volume\n");
 
     *cookie = (fscookie *)ext2;
@@ -203,37 +220,143 @@ status_t ext2_unmount(fscookie *cookie)
     // free it up
     ext2_t *ext2 = (ext2_t *)cookie;
 
+    bio_readahead_destroy(ext2->ra);
     bcache_destroy(ext2->cache);
-    free(ext2->gd);
+    for (int i = 0; i < EXT2_GD_CHUNKS; i++)
+        free(ext2->gd_chunks[i].gd);
     free(ext2);
 
     return 0;
 }
 
-static void get_inode_addr(ext2_t *ext2, inodenum_t num, blocknum_t *block, size_t *block_offset)
+/* read the block of group descriptors that @group is in, replacing the oldest one */
+static struct ext2_gd_chunk *load_gd_chunk(ext2_t *ext2, groupnum_t group)
+{
+    struct ext2_gd_chunk *chunk = &ext2->gd_chunks[ext2->gd_next];
+    groupnum_t first = group - group % ext2->gd_per_chunk;
+    uint count = MIN(ext2->gd_per_chunk, (uint)ext2->s_group_count - first);
+    size_t len = count * ext2->gd_size;
+    uint8_t *raw;
+    int err;
+
+    if (!chunk->gd) {
+        chunk->gd = malloc(sizeof(struct ext2_group_desc) * ext2->gd_per_chunk);
+        if (!chunk->gd)
+            return NULL;
+    }
+
+    /* larger descriptors are read in place and packed afterwards */
+    raw = (uint8_t *)chunk->gd;
+    if (ext2->gd_size != sizeof(struct ext2_group_desc)) {
+        raw = malloc(len);
+        if (!raw)
+            return NULL;
+    }
+
+    chunk->count = 0;
+    err = bio_read(ext2->dev, raw, ext2->gd_offset + (off_t)first * ext2->gd_size, len);
+    if (err < 0 || (size_t)err != len) {
+        if (raw != (uint8_t *)chunk->gd)
+            free(raw);
+        return NULL;
+    }
+
+    for (uint i = 0; i < count; i++) {
+        if (raw != (uint8_t *)chunk->gd)
+            memcpy(&chunk->gd[i], raw + i * ext2->gd_size, sizeof(struct ext2_group_desc));
+        endian_swap_group_desc(&chunk->gd[i]);
+        LTRACEF("group %u: inode table %u\n", first + i, chunk->gd[i].bg_inode_table);
+    }
+    if (raw != (uint8_t *)chunk->gd)
+        free(raw);
+
+    chunk->first = first;
+    chunk->count = count;
+    ext2->gd_next = (ext2->gd_next + 1) % EXT2_GD_CHUNKS;
+    return chunk;
+}
+
+static struct ext2_group_desc *get_group_desc(ext2_t *ext2, groupnum_t group)
 {
+    struct ext2_gd_chunk *chunk;
+
+    if (group >= (groupnum_t)ext2->s_group_count)
+        return NULL;
+
+    for (int i = 0; i < EXT2_GD_CHUNKS; i++) {
+        chunk = &ext2->gd_chunks[i];
+        if (chunk->count && group >= chunk->first && group - chunk->first < chunk->count)
+            return &chunk->gd[group - chunk->first];
+    }
+
+    chunk = load_gd_chunk(ext2, group);
+    if (!chunk)
+        return NULL;
+
+    return &chunk->gd[group - chunk->first];
+}
+
+static int get_inode_addr(ext2_t *ext2, inodenum_t num, blocknum_t *block, size_t *block_offset)
+{
+    struct ext2_group_desc *gd;
+
     num--;
 
     uint32_t group = num / ext2->sb.s_inodes_per_group;
 
     // calculate the start of the inode table for the group it's in
-    *block = ext2->gd[group].bg_inode_table;
+    gd = get_group_desc(ext2, group);
+    if (!gd)
+        return -1;
+    *block = gd->bg_inode_table;
 
     // add the offset of the inode within the group
     size_t offset = (num % EXT2_INODES_PER_GROUP(ext2->sb)) * EXT2_INODE_SIZE(ext2->sb);
     *block_offset = offset % EXT2_BLOCK_SIZE(ext2->sb);
     *block += offset / EXT2_BLOCK_SIZE(ext2->sb);
+    return 0;
+}
+
+/* look up an inode in the inode cache, or pick the least recently used entry */
+static struct ext2_icache_entry *icache_find(ext2_t *ext2, inodenum_t num, bool *hit)
+{
+    struct ext2_icache_entry *entry, *oldest = &ext2->icache[0];
+
+    for (int i = 0; i < EXT2_ICACHE_ENTRIES; i++) {
+        entry = &ext2->icache[i];
+        if (entry->inum == num) {
+            *hit = true;
+            return entry;
+        }
+        if (entry->last_use < oldest->last_use)
+            oldest = entry;
+    }
+
+    *hit = false;
+    return oldest;
 }
 
 int ext2_load_inode(ext2_t *ext2, inodenum_t num, struct ext2_inode *inode)
 {
+    struct ext2_icache_entry *entry;
+    bool hit;
     int err;
 
     LTRACEF("num %d, inode %p\n", num, inode);
 
+    /* config files and dtbs are opened repeatedly while booting */
+    entry = icache_find(ext2, num, &hit);
+    entry->last_use = ++ext2->icache_use;
+    if (hit) {
+        memcpy(inode, &entry->inode, sizeof(struct ext2_inode));
+        return 0;
+    }
+
     blocknum_t bnum;
     size_t block_offset;
-    get_inode_addr(ext2, num, &bnum, &block_offset);
+    err = get_inode_addr(ext2, num, &bnum, &block_offset);
+    if (err < 0)
+        goto err;
 
     LTRACEF("bnum %u, offset %zd\n", bnum, block_offset);
 
@@ -241,7 +364,7 @@ int ext2_load_inode(ext2_t *ext2, inodenum_t num, struct ext2_inode *inode)
     void *cache_ptr;
     err = bcache_get_block(ext2->cache, &cache_ptr, bnum);
     if (err < 0)
-        return err;
+        goto err;
 
     /* copy the inode out */
     memcpy(inode, (uint8_t *)cache_ptr + block_offset, sizeof(struct ext2_inode));
@@ -254,10 +377,19 @@ int ext2_load_inode(ext2_t *ext2, inodenum_t num, struct ext2_inode *inode)
 
     LTRACEF("read inode: mode 0x%x, size %d\n", inode->i_mode, inode->i_size);
 
+    entry->inum = num;
+    memcpy(&entry->inode, inode, sizeof(struct ext2_inode));
     return 0;
+
+err:
+    /* the entry may have held another inode before */
+    entry->inum = 0;
+    entry->last_use = 0;
+    return err;
 }
 
 static const struct fs_api ext2_api = {
+    .probe = ext2_probe,
     .mount = ext2_mount,
     .unmount = ext2_unmount,
     .open = ext2_open_file,
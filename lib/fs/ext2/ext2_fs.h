@@ -156,6 +156,43 @@ struct ext2_inode {
 
 #define i_size_high i_dir_acl
 
+/*
+ * Inode flags
+ */
+#define EXT2_INDEX_FL           0x00001000 /* hash-indexed directory */
+#define EXT4_EXTENTS_FL         0x00080000 /* Inode uses extents */
+
+/*
+ * ext4 extent tree, rooted in i_block[] of inodes with EXT4_EXTENTS_FL
+ */
+#define EXT4_EXT_MAGIC          0xf30a
+#define EXT4_EXT_MAX_DEPTH      5
+#define EXT4_EXT_INIT_MAX_LEN   (1U << 15) /* longer extents are uninitialized */
+
+struct ext4_extent_header {
+    uint16_t    eh_magic;   /* EXT4_EXT_MAGIC */
+    uint16_t    eh_entries; /* Number of valid entries */
+    uint16_t    eh_max;     /* Capacity of the node */
+    uint16_t    eh_depth;   /* 0 for leaf nodes */
+    uint32_t    eh_generation;
+};
+
+/* Entry of an index node, points to the next level of the tree */
+struct ext4_extent_idx {
+    uint32_t    ei_block;   /* First file block covered */
+    uint32_t    ei_leaf_lo; /* Block of the next level node */
+    uint16_t    ei_leaf_hi;
+    uint16_t    ei_unused;
+};
+
+/* Entry of a leaf node, maps a run of file blocks */
+struct ext4_extent {
+    uint32_t    ee_block;   /* First file block covered */
+    uint16_t    ee_len;     /* Number of blocks covered */
+    uint16_t    ee_start_hi;
+    uint32_t    ee_start_lo; /* First physical block */
+};
+
 #define i_reserved1 osd1.linux1.l_i_reserved1
 #define i_frag      osd2.linux2.l_i_frag
 #define i_fsize     osd2.linux2.l_i_fsize
@@ -281,13 +318,27 @@ struct ext2_super_block {
     uint32_t    s_last_orphan;      /* start of list of inodes to delete */
     uint32_t    s_hash_seed[4];     /* HTREE hash seed */
     uint8_t s_def_hash_version; /* Default hash version to use */
-    uint8_t s_reserved_char_pad;
-    uint16_t    s_reserved_word_pad;
+    uint8_t s_jnl_backup_type;
+    uint16_t    s_desc_size;        /* Group descriptor size (64bit) */
     uint32_t    s_default_mount_opts;
     uint32_t    s_first_meta_bg;    /* First metablock block group */
-    uint32_t    s_reserved[190];    /* Padding to the end of the block */
+    uint32_t    s_mkfs_time;        /* When the filesystem was created */
+    uint32_t    s_jnl_blocks[17];   /* Backup of the journal inode */
+    uint32_t    s_blocks_count_hi;  /* Blocks count (high 32 bits, 64bit) */
+    uint32_t    s_r_blocks_count_hi; /* Reserved blocks count (high 32 bits) */
+    uint32_t    s_free_blocks_count_hi; /* Free blocks count (high 32 bits) */
+    uint16_t    s_min_extra_isize;  /* All inodes have at least # bytes */
+    uint16_t    s_want_extra_isize; /* New inodes should reserve # bytes */
+    uint32_t    s_flags;        /* Miscellaneous flags */
+    uint32_t    s_reserved[167];    /* Padding to the end of the block */
 };
 
+/*
+ * Superblock flags
+ */
+#define EXT2_FLAGS_SIGNED_HASH      0x0001  /* Directory hashes use signed char */
+#define EXT2_FLAGS_UNSIGNED_HASH    0x0002  /* Directory hashes use unsigned char */
+
 /*
  * Codes for operating systems
  */
@@ -349,6 +400,8 @@ struct ext2_super_block {
 #define EXT3_FEATURE_INCOMPAT_RECOVER       0x0004
 #define EXT3_FEATURE_INCOMPAT_JOURNAL_DEV   0x0008
 #define EXT2_FEATURE_INCOMPAT_META_BG       0x0010
+#define EXT4_FEATURE_INCOMPAT_EXTENTS       0x0040
+#define EXT4_FEATURE_INCOMPAT_64BIT     0x0080
 #define EXT2_FEATURE_INCOMPAT_ANY       0xffffffff
 
 #define EXT2_FEATURE_COMPAT_SUPP    EXT2_FEATURE_COMPAT_EXT_ATTR
@@ -406,6 +459,43 @@ struct ext2_dir_entry_2 {
     char    name[EXT2_NAME_LEN];    /* File name */
 };
 
+/*
+ * Hash-indexed (htree) directories: the first block holds the "." and ".."
+ * entries, followed by the root info and the first level of the index.
+ * Index blocks below the root start with an empty entry spanning the block.
+ * Each level maps the lowest hash of a block to the block number, the
+ * first entry has no hash but holds the count and limit of the entries.
+ */
+#define EXT2_DX_HASH_LEGACY             0
+#define EXT2_DX_HASH_HALF_MD4           1
+#define EXT2_DX_HASH_TEA                2
+#define EXT2_DX_HASH_LEGACY_UNSIGNED    3
+#define EXT2_DX_HASH_HALF_MD4_UNSIGNED  4
+#define EXT2_DX_HASH_TEA_UNSIGNED       5
+
+#define EXT2_DX_ROOT_OFFSET     24  /* after the "." and ".." entries */
+#define EXT2_DX_NODE_OFFSET     8   /* after the empty entry */
+#define EXT2_DX_MAX_LEVELS      3
+#define EXT2_DX_BLOCK_MASK      0x0fffffff
+
+struct ext2_dx_root_info {
+    uint32_t    reserved_zero;
+    uint8_t hash_version;
+    uint8_t info_length;        /* 8 */
+    uint8_t indirect_levels;
+    uint8_t unused_flags;
+};
+
+struct ext2_dx_countlimit {
+    uint16_t    limit;
+    uint16_t    count;
+};
+
+struct ext2_dx_entry {
+    uint32_t    hash;
+    uint32_t    block;
+};
+
 /*
  * Ext2 directory file types.  Only the low 3 bits are used.  The
  * other bits are reserved for now.
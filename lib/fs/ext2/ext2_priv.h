@@ -33,14 +33,54 @@ typedef uint32_t blocknum_t;
 typedef uint32_t inodenum_t;
 typedef uint32_t groupnum_t;
 
+/* small cache of directory lookups, inum 0 caches a name that does not exist */
+#define EXT2_DCACHE_ENTRIES 32
+#define EXT2_DCACHE_NAME_LEN 48
+
+struct ext2_dentry {
+    inodenum_t dir;
+    inodenum_t inum;
+    uint8_t name_len;
+    char name[EXT2_DCACHE_NAME_LEN];
+};
+
+/* recently loaded inodes, ordered by the last use */
+#define EXT2_ICACHE_ENTRIES 16
+
+struct ext2_icache_entry {
+    inodenum_t inum;
+    uint last_use;
+    struct ext2_inode inode;
+};
+
+/* group descriptors are read on demand, one block of them at a time */
+#define EXT2_GD_CHUNKS 4
+
+struct ext2_gd_chunk {
+    groupnum_t first;
+    uint count;
+    struct ext2_group_desc *gd;
+};
+
 typedef struct {
     bdev_t *dev;
     bcache_t cache;
+    struct bio_readahead *ra;
 
     struct ext2_super_block sb;
     int s_group_count;
-    struct ext2_group_desc *gd;
+    off_t gd_offset;
+    size_t gd_size;
+    uint gd_per_chunk;
+    struct ext2_gd_chunk gd_chunks[EXT2_GD_CHUNKS];
+    uint gd_next;
     struct ext2_inode root_inode;
+
+    struct ext2_icache_entry icache[EXT2_ICACHE_ENTRIES];
+    uint icache_use;
+
+    struct ext2_dentry dcache[EXT2_DCACHE_ENTRIES];
+    uint dcache_next;
 } ext2_t;
 
 struct cache_block {
@@ -65,6 +105,7 @@ typedef struct {
 /* internal routines */
 int ext2_load_inode(ext2_t *ext2, inodenum_t num, struct ext2_inode *inode);
 int ext2_lookup(ext2_t *ext2, const char *path, inodenum_t *inum); // path to inode
+int ext2_dx_hash(const char *name, size_t len, uint version, const uint32_t seed[4], uint32_t *hash);
 
 /* io */
 int ext2_read_block(ext2_t *ext2, void *buf, blocknum_t bnum);
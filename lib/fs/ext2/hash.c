@@ -0,0 +1,187 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/*
+ * Directory hashes of hash-indexed (htree) directories.
+ *
+ * These must produce exactly the values the filesystem was created with,
+ * so they follow the on-disk format of ext3/ext4: the legacy hash,
+ * half MD4 and TEA, each in a variant for signed and unsigned char.
+ */
+#include <err.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ext2_priv.h"
+
+#define ROL32(x, s) (((x) << (s)) | ((x) >> (32 - (s))))
+
+static uint32_t dx_hack_hash(const char *name, size_t len, bool is_signed)
+{
+    uint32_t hash, hash0 = 0x12a3fe2d, hash1 = 0x37abe8f9;
+    int c;
+
+    while (len--) {
+        c = is_signed ? (int)(signed char)*name : (int)(unsigned char)*name;
+        name++;
+
+        hash = hash1 + (hash0 ^ (uint32_t)(c * 7152373));
+        if (hash & 0x80000000)
+            hash -= 0x7fffffff;
+        hash1 = hash0;
+        hash0 = hash;
+    }
+    return hash0 << 1;
+}
+
+/* Pack (up to) num words of the name, padded with its length */
+static void str2hashbuf(const char *msg, size_t len, uint32_t *buf, int num,
+                        bool is_signed)
+{
+    uint32_t pad, val;
+    size_t i;
+    int c;
+
+    pad = (uint32_t)len | ((uint32_t)len << 8);
+    pad |= pad << 16;
+
+    val = pad;
+    if (len > (size_t)num * 4)
+        len = num * 4;
+    for (i = 0; i < len; i++) {
+        c = is_signed ? (int)(signed char)msg[i] : (int)(unsigned char)msg[i];
+        val = (uint32_t)c + (val << 8);
+        if ((i % 4) == 3) {
+            *buf++ = val;
+            val = pad;
+            num--;
+        }
+    }
+    if (--num >= 0)
+        *buf++ = val;
+    while (--num >= 0)
+        *buf++ = pad;
+}
+
+#define F(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
+#define G(x, y, z) (((x) & (y)) + (((x) ^ (y)) & (z)))
+#define H(x, y, z) ((x) ^ (y) ^ (z))
+
+#define ROUND(f, a, b, c, d, x, s) \
+    (a += f(b, c, d) + (x), a = ROL32(a, s))
+
+#define K1 0
+#define K2 013240474631U
+#define K3 015666365641U
+
+static void half_md4_transform(uint32_t buf[4], const uint32_t in[8])
+{
+    uint32_t a = buf[0], b = buf[1], c = buf[2], d = buf[3];
+
+    /* Round 1 */
+    ROUND(F, a, b, c, d, in[0] + K1,  3);
+    ROUND(F, d, a, b, c, in[1] + K1,  7);
+    ROUND(F, c, d, a, b, in[2] + K1, 11);
+    ROUND(F, b, c, d, a, in[3] + K1, 19);
+    ROUND(F, a, b, c, d, in[4] + K1,  3);
+    ROUND(F, d, a, b, c, in[5] + K1,  7);
+    ROUND(F, c, d, a, b, in[6] + K1, 11);
+    ROUND(F, b, c, d, a, in[7] + K1, 19);
+
+    /* Round 2 */
+    ROUND(G, a, b, c, d, in[1] + K2,  3);
+    ROUND(G, d, a, b, c, in[3] + K2,  5);
+    ROUND(G, c, d, a, b, in[5] + K2,  9);
+    ROUND(G, b, c, d, a, in[7] + K2, 13);
+    ROUND(G, a, b, c, d, in[0] + K2,  3);
+    ROUND(G, d, a, b, c, in[2] + K2,  5);
+    ROUND(G, c, d, a, b, in[4] + K2,  9);
+    ROUND(G, b, c, d, a, in[6] + K2, 13);
+
+    /* Round 3 */
+    ROUND(H, a, b, c, d, in[3] + K3,  3);
+    ROUND(H, d, a, b, c, in[7] + K3,  9);
+    ROUND(H, c, d, a, b, in[2] + K3, 11);
+    ROUND(H, b, c, d, a, in[6] + K3, 15);
+    ROUND(H, a, b, c, d, in[1] + K3,  3);
+    ROUND(H, d, a, b, c, in[5] + K3,  9);
+    ROUND(H, c, d, a, b, in[0] + K3, 11);
+    ROUND(H, b, c, d, a, in[4] + K3, 15);
+
+    buf[0] += a;
+    buf[1] += b;
+    buf[2] += c;
+    buf[3] += d;
+}
+
+#define TEA_DELTA 0x9E3779B9
+
+static void tea_transform(uint32_t buf[4], const uint32_t in[4])
+{
+    uint32_t sum = 0;
+    uint32_t b0 = buf[0], b1 = buf[1];
+    uint32_t a = in[0], b = in[1], c = in[2], d = in[3];
+    int n = 16;
+
+    do {
+        sum += TEA_DELTA;
+        b0 += ((b1 << 4) + a) ^ (b1 + sum) ^ ((b1 >> 5) + b);
+        b1 += ((b0 << 4) + c) ^ (b0 + sum) ^ ((b0 >> 5) + d);
+    } while (--n);
+
+    buf[0] += b0;
+    buf[1] += b1;
+}
+
+/* Compute the major hash of a name, as stored in the htree index */
+int ext2_dx_hash(const char *name, size_t len, uint version, const uint32_t seed[4], uint32_t *hash)
+{
+    uint32_t buf[4], in[8];
+    bool is_signed = version < EXT2_DX_HASH_LEGACY_UNSIGNED;
+    int i;
+
+    /* the default seed, used unless the filesystem has one */
+    buf[0] = 0x67452301;
+    buf[1] = 0xefcdab89;
+    buf[2] = 0x98badcfe;
+    buf[3] = 0x10325476;
+    for (i = 0; i < 4; i++) {
+        if (seed[i]) {
+            memcpy(buf, seed, sizeof(buf));
+            break;
+        }
+    }
+
+    switch (version) {
+        case EXT2_DX_HASH_LEGACY:
+        case EXT2_DX_HASH_LEGACY_UNSIGNED:
+            *hash = dx_hack_hash(name, len, is_signed);
+            break;
+        case EXT2_DX_HASH_HALF_MD4:
+        case EXT2_DX_HASH_HALF_MD4_UNSIGNED:
+            while (len > 0) {
+                str2hashbuf(name, len, in, 8, is_signed);
+                half_md4_transform(buf, in);
+                name += MIN(len, 32);
+                len -= MIN(len, 32);
+            }
+            *hash = buf[1];
+            break;
+        case EXT2_DX_HASH_TEA:
+        case EXT2_DX_HASH_TEA_UNSIGNED:
+            while (len > 0) {
+                str2hashbuf(name, len, in, 4, is_signed);
+                tea_transform(buf, in);
+                name += MIN(len, 16);
+                len -= MIN(len, 16);
+            }
+            *hash = buf[0];
+            break;
+        default:
+            return ERR_NOT_SUPPORTED;
+    }
+
+    /* the lowest bit marks hash collisions continuing in the next block */
+    *hash &= ~1U;
+    if (*hash == (0x7fffffffU << 1))
+        *hash = (0x7fffffffU - 1) << 1;
+
+    return 0;
+}
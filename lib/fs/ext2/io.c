@@ -24,10 +24,18 @@
 #include <string.h>
 #include <stdlib.h>
 #include <debug.h>
+#include <err.h>
 #include "ext2_priv.h"
 
+#if WITH_LK2ND_PERF
+#include <lk2nd/perf.h>
+#endif
+
 #define LOCAL_TRACE 0
 
+/* number of extents of a file read submitted together with bio_readv() */
+#define EXT2_READV_VECS 16
+
 int ext2_read_block(ext2_t *ext2, void *buf, blocknum_t bnum)
 {
     return bcache_read_block(ext2->cache, buf, bnum);
@@ -43,6 +51,34 @@ int ext2_put_block(ext2_t *ext2, blocknum_t bnum)
     return bcache_put_block(ext2->cache, bnum);
 }
 
+/*
+ * Copy part of a file data block. Data goes through the readahead window
+ * rather than the block cache, which is left to the metadata.
+ */
+static int ext2_read_data(ext2_t *ext2, void *buf, blocknum_t bnum, size_t offset, size_t len)
+{
+    ssize_t ret;
+    void *ptr;
+    int err;
+
+    if (ext2->ra) {
+        ret = bio_readahead_read(ext2->ra, ext2->dev, buf,
+                                 (off_t)EXT2_BLOCK_SIZE(ext2->sb) * bnum + offset, len);
+        if (ret < 0)
+            return ret;
+        return (ret == (ssize_t)len) ? 0 : ERR_IO;
+    }
+
+    err = ext2_get_block(ext2, &ptr, bnum);
+    if (err < 0)
+        return err;
+
+    memcpy(buf, (uint8_t *)ptr + offset, len);
+    ext2_put_block(ext2, bnum);
+
+    return 0;
+}
+
 static int ext2_calculate_block_pointer_pos(ext2_t *ext2, blocknum_t block_to_find, uint32_t *level, uint32_t pos[])
 {
     uint32_t block_ptr_per_block, block_ptr_per_2nd_block;
@@ -141,6 +177,98 @@ error:
     return err;
 }
 
+/*
+ * Walk the extent tree of an inode to find the extent containing fileblock.
+ * Returns the physical block of fileblock in *block (0 for holes and
+ * uninitialized extents) and the number of blocks in *count that follow
+ * it contiguously until the end of the extent or hole.
+ */
+static int ext4_extent_lookup(ext2_t *ext2, struct ext2_inode *inode, uint fileblock, blocknum_t *block, uint *count)
+{
+    const struct ext4_extent_header *eh = (const void *)inode->i_block;
+    blocknum_t cache_block = 0;
+    uint32_t next = UINT32_MAX;
+    int depth, err = 0;
+    uint i, entries;
+
+    LTRACEF("inode %p, fileblock %u\n", inode, fileblock);
+
+    for (depth = 0; ; depth++) {
+        if (LE16(eh->eh_magic) != EXT4_EXT_MAGIC || depth > EXT4_EXT_MAX_DEPTH) {
+            err = -1;
+            break;
+        }
+
+        entries = LE16(eh->eh_entries);
+
+        if (LE16(eh->eh_depth) == 0) {
+            const struct ext4_extent *ex = (const void *)(eh + 1);
+
+            /* not covered by any extent, it's a hole until the next one */
+            *block = 0;
+            *count = next - fileblock;
+
+            for (i = 0; i < entries; i++) {
+                uint32_t start = LE32(ex[i].ee_block);
+                uint32_t len = LE16(ex[i].ee_len);
+                bool uninit = len > EXT4_EXT_INIT_MAX_LEN;
+
+                if (fileblock < start) {
+                    *count = start - fileblock;
+                    break;
+                }
+
+                if (uninit)
+                    len -= EXT4_EXT_INIT_MAX_LEN;
+
+                if (fileblock - start < len) {
+                    *count = len - (fileblock - start);
+                    if (LE16(ex[i].ee_start_hi) != 0)
+                        err = -1;
+                    else if (!uninit)
+                        *block = LE32(ex[i].ee_start_lo) + (fileblock - start);
+                    break;
+                }
+            }
+            break;
+        }
+
+        /* index node, descend into the last entry starting at or before fileblock */
+        const struct ext4_extent_idx *ix = (const void *)(eh + 1);
+        if (entries == 0) {
+            err = -1;
+            break;
+        }
+
+        for (i = 0; i + 1 < entries && LE32(ix[i + 1].ei_block) <= fileblock; i++)
+            ;
+        if (i + 1 < entries)
+            next = LE32(ix[i + 1].ei_block);
+
+        if (LE16(ix[i].ei_leaf_hi) != 0) {
+            err = -1;
+            break;
+        }
+        blocknum_t leaf = LE32(ix[i].ei_leaf_lo);
+
+        if (cache_block)
+            ext2_put_block(ext2, cache_block);
+        cache_block = 0;
+
+        err = ext2_get_block(ext2, (void **)(void *)&eh, leaf);
+        if (err < 0)
+            break;
+        cache_block = leaf;
+    }
+
+    if (cache_block)
+        ext2_put_block(ext2, cache_block);
+
+    LTRACEF("err %d, block %u, count %u\n", err, *block, *count);
+
+    return err;
+}
+
 /* translate a file block to a physical block */
 static blocknum_t file_block_to_fs_block(ext2_t *ext2, struct ext2_inode *inode, uint fileblock)
 {
@@ -149,6 +277,16 @@ static blocknum_t file_block_to_fs_block(ext2_t *ext2, struct ext2_inode *inode,
 
     LTRACEF("inode %p, fileblock %u\n", inode, fileblock);
 
+    if (inode->i_flags & EXT4_EXTENTS_FL) {
+        uint count;
+
+        err = ext4_extent_lookup(ext2, inode, fileblock, &block, &count);
+        if (err < 0)
+            return 0;
+
+        return block;
+    }
+
     uint32_t pos[4];
     uint32_t level = 0;
     ext2_calculate_block_pointer_pos(ext2, fileblock, &level, pos);
@@ -179,11 +317,45 @@ static blocknum_t file_block_to_fs_block(ext2_t *ext2, struct ext2_inode *inode,
     return block;
 }
 
+/*
+ * translate a file block to a run of up to max_blocks physically contiguous blocks,
+ * *block is 0 if the run is a hole
+ */
+static int file_block_to_fs_run(ext2_t *ext2, struct ext2_inode *inode, uint fileblock, uint max_blocks, blocknum_t *block, uint *count)
+{
+    int err;
+
+    if (inode->i_flags & EXT4_EXTENTS_FL) {
+        err = ext4_extent_lookup(ext2, inode, fileblock, block, count);
+        if (err < 0)
+            return err;
+
+        *count = MIN(*count, max_blocks);
+        return 0;
+    }
+
+    /* no extents, look for contiguous blocks one by one */
+    *block = file_block_to_fs_block(ext2, inode, fileblock);
+    *count = 1;
+    if (*block == 0)
+        return 0;
+
+    while (*count < max_blocks && file_block_to_fs_block(ext2, inode, fileblock + *count) == *block + *count)
+        (*count)++;
+
+    return 0;
+}
+
 ssize_t ext2_read_inode(ext2_t *ext2, struct ext2_inode *inode, void *_buf, off_t offset, size_t len)
 {
     int err = 0;
     size_t bytes_read = 0;
     uint8_t *buf = _buf;
+    struct bio_vec vecs[EXT2_READV_VECS];
+    uint nvecs = 0;
+#if WITH_LK2ND_PERF
+    LK2ND_PERF_SCOPE("ext2_read_inode");
+#endif
 
     /* calculate the file size */
     off_t file_size = ext2_file_len(ext2, inode);
@@ -203,21 +375,19 @@ ssize_t ext2_read_inode(ext2_t *ext2, struct ext2_inode *inode, void *_buf, off_
 
     /* handle partial first block */
     if ((offset % EXT2_BLOCK_SIZE(ext2->sb)) != 0) {
-        uint8_t temp[EXT2_BLOCK_SIZE(ext2->sb)];
+        size_t block_offset = offset % EXT2_BLOCK_SIZE(ext2->sb);
+        size_t tocopy = MIN(len, EXT2_BLOCK_SIZE(ext2->sb) - block_offset);
 
-        /* calculate the block and read it */
+        /* calculate the block and copy out what we need */
         blocknum_t phys_block = file_block_to_fs_block(ext2, inode, file_block);
         if (phys_block == 0) {
-            memset(temp, 0, EXT2_BLOCK_SIZE(ext2->sb));
+            memset(buf, 0, tocopy);
         } else {
-            ext2_read_block(ext2, temp, phys_block);
+            err = ext2_read_data(ext2, buf, phys_block, block_offset, tocopy);
+            if (err < 0)
+                goto out;
         }
 
-        /* copy out what we need */
-        size_t block_offset = offset % EXT2_BLOCK_SIZE(ext2->sb);
-        size_t tocopy = MIN(len, EXT2_BLOCK_SIZE(ext2->sb) - block_offset);
-        memcpy(buf, temp + block_offset, tocopy);
-
         /* increment our stuff */
         file_block++;
         len -= tocopy;
@@ -227,21 +397,32 @@ ssize_t ext2_read_inode(ext2_t *ext2, struct ext2_inode *inode, void *_buf, off_
 
     /* handle middle blocks */
     while (len >= EXT2_BLOCK_SIZE(ext2->sb)) {
-        /* calculate the block and read it */
-        blocknum_t phys_block = file_block_to_fs_block(ext2, inode, file_block);
-        blocknum_t count_cont_blks = 1;
-        blocknum_t max_blocks = len / EXT2_BLOCK_SIZE(ext2->sb);
+        /* calculate the run of blocks and read it */
+        blocknum_t phys_block;
+        uint count_cont_blks;
+        uint max_blocks = len / EXT2_BLOCK_SIZE(ext2->sb);
+
+        err = file_block_to_fs_run(ext2, inode, file_block, max_blocks, &phys_block, &count_cont_blks);
+        if (err < 0)
+            break;
+
         if (phys_block == 0) {
-            memset(buf, 0, EXT2_BLOCK_SIZE(ext2->sb));
+            memset(buf, 0, EXT2_BLOCK_SIZE(ext2->sb) * count_cont_blks);
         } else {
-	    if ((addr_t)buf % CACHE_LINE) {
-	        ext2_read_block(ext2, buf, phys_block);
-	    } else {
-                while (count_cont_blks < max_blocks && file_block_to_fs_block(ext2, inode, file_block + count_cont_blks) == phys_block + count_cont_blks) {
-                    count_cont_blks++;
-                }
-                bio_read(ext2->dev, buf, EXT2_BLOCK_SIZE(ext2->sb) * phys_block, EXT2_BLOCK_SIZE(ext2->sb) * count_cont_blks);
-	    }
+            /*
+             * straight into buf, bio bounces it if buf is not aligned.
+             * The runs are collected so the device can merge them.
+             */
+            vecs[nvecs].buf = buf;
+            vecs[nvecs].offset = (off_t)EXT2_BLOCK_SIZE(ext2->sb) * phys_block;
+            vecs[nvecs].len = EXT2_BLOCK_SIZE(ext2->sb) * count_cont_blks;
+            if (++nvecs == EXT2_READV_VECS) {
+                err = bio_readv(ext2->dev, vecs, nvecs);
+                nvecs = 0;
+                if (err < 0)
+                    break;
+                err = 0;
+            }
         }
 
         /* increment our stuff */
@@ -251,25 +432,29 @@ ssize_t ext2_read_inode(ext2_t *ext2, struct ext2_inode *inode, void *_buf, off_
         buf += EXT2_BLOCK_SIZE(ext2->sb) * count_cont_blks;
     }
 
-    /* handle partial last block */
-    if (len > 0) {
-        uint8_t temp[EXT2_BLOCK_SIZE(ext2->sb)];
+    if (err == 0 && nvecs > 0) {
+        err = bio_readv(ext2->dev, vecs, nvecs);
+        if (err > 0)
+            err = 0;
+    }
 
-        /* calculate the block and read it */
+    /* handle partial last block */
+    if (err == 0 && len > 0) {
+        /* calculate the block and copy out what we need */
         blocknum_t phys_block = file_block_to_fs_block(ext2, inode, file_block);
         if (phys_block == 0) {
-            memset(temp, 0, EXT2_BLOCK_SIZE(ext2->sb));
+            memset(buf, 0, len);
         } else {
-            ext2_read_block(ext2, temp, phys_block);
+            err = ext2_read_data(ext2, buf, phys_block, 0, len);
+            if (err < 0)
+                goto out;
         }
 
-        /* copy out what we need */
-        memcpy(buf, temp, len);
-
         /* increment our stuff */
         bytes_read += len;
     }
 
+out:
     LTRACEF("err %d, bytes_read %zu\n", err, bytes_read);
 
     return (err < 0) ? err : (ssize_t)bytes_read;
@@ -8,5 +8,11 @@ MODULES += \
 OBJS += \
 	$(LOCAL_DIR)/ext2.o \
 	$(LOCAL_DIR)/dir.o \
+	$(LOCAL_DIR)/hash.o \
 	$(LOCAL_DIR)/io.o \
 	$(LOCAL_DIR)/file.o
+
+# Number of blocks cached per mounted volume (indirect blocks, directories, inodes)
+EXT2_BCACHE_BLOCKS ?= 16
+
+DEFINES += EXT2_BCACHE_BLOCKS=$(EXT2_BCACHE_BLOCKS)
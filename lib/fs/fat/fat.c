@@ -21,6 +21,7 @@
 struct fat_volume {
 	FATFS fs;
 	bdev_t *dev;
+	struct bio_readahead *ra;
 	bool used;
 };
 
@@ -71,8 +72,9 @@ DRESULT disk_read(BYTE pdrv, BYTE *buff, LBA_t sector, UINT count)
 		return RES_NOTRDY;
 
 	dev = volumes[pdrv].dev;
-	ret = bio_read(dev, buff, (off_t)sector * dev->block_size,
-		       count * dev->block_size);
+	ret = bio_readahead_read(volumes[pdrv].ra, dev, buff,
+				 (off_t)sector * dev->block_size,
+				 count * dev->block_size);
 	if (ret != (ssize_t)(count * dev->block_size))
 		return RES_ERROR;
 
@@ -102,6 +104,45 @@ DRESULT disk_ioctl(BYTE pdrv, BYTE cmd, void *buff)
  * LK fs_api implementation.
  */
 
+static WORD fat_ld16(const BYTE *p)
+{
+	return p[0] | p[1] << 8;
+}
+
+static DWORD fat_ld32(const BYTE *p)
+{
+	return p[0] | p[1] << 8 | p[2] << 16 | (DWORD)p[3] << 24;
+}
+
+/*
+ * Same checks as check_fs() in ff.c, sector 0 must be a FAT boot sector.
+ * Anything with a boot signature might still be a MBR with a FAT volume
+ * in it, so leave that to f_mount().
+ */
+static bool fat_probe(const void *buf, size_t len)
+{
+	const BYTE *bs = buf;
+	WORD ss;
+
+	if (len < FF_MAX_SS)
+		return true;
+
+	if (fat_ld16(bs + 510) == 0xAA55)
+		return true;
+
+	/* Old FAT volumes without the signature, check the BPB instead */
+	if (bs[0] != 0xEB && bs[0] != 0xE9 && bs[0] != 0xE8)
+		return false;
+
+	ss = fat_ld16(bs + 11);
+	return (ss & (ss - 1)) == 0 && ss >= FF_MIN_SS && ss <= FF_MAX_SS &&
+	       bs[13] != 0 && (bs[13] & (bs[13] - 1)) == 0 &&
+	       fat_ld16(bs + 14) != 0 && (UINT)bs[16] - 1 <= 1 &&
+	       fat_ld16(bs + 17) != 0 &&
+	       (fat_ld16(bs + 19) >= 128 || fat_ld32(bs + 32) >= 0x10000) &&
+	       fat_ld16(bs + 22) != 0;
+}
+
 static status_t fat_mount(bdev_t *dev, fscookie **cookie)
 {
 	struct fat_volume *vol = NULL;
@@ -122,11 +163,13 @@ static status_t fat_mount(bdev_t *dev, fscookie **cookie)
 		return ERR_NO_MEMORY;
 
 	vol->dev = dev;
+	vol->ra = bio_readahead_create(dev);
 	vol->used = true;
 
 	snprintf(drive, sizeof(drive), "%d:", i);
 	res = f_mount(&vol->fs, drive, 1);
 	if (res != FR_OK) {
+		bio_readahead_destroy(vol->ra);
 		vol->used = false;
 		return fresult_to_status(res);
 	}
@@ -142,6 +185,7 @@ static status_t fat_unmount(fscookie *cookie)
 
 	snprintf(drive, sizeof(drive), "%d:", (int)(vol - volumes));
 	f_unmount(drive);
+	bio_readahead_destroy(vol->ra);
 	vol->used = false;
 
 	return NO_ERROR;
@@ -153,6 +197,51 @@ static void fat_path(struct fat_volume *vol, char *out, size_t out_len,
 	snprintf(out, out_len, "%d:%s", (int)(vol - volumes), path);
 }
 
+#if FF_USE_FASTSEEK
+/* Initial size of the cluster link map: 16 fragments */
+#define FAT_CLMT_INITIAL	34
+
+/*
+ * Build the cluster link map table of the file, so that seeking does not
+ * need to follow the FAT chain and f_read() can read whole fragments of
+ * contiguous clusters with one disk_read(). Without it the file is still
+ * readable, just slower.
+ */
+static void fat_create_linkmap(FIL *fil)
+{
+	DWORD *tbl, *new_tbl;
+	DWORD size = FAT_CLMT_INITIAL;
+	FRESULT res;
+
+	tbl = malloc(size * sizeof(*tbl));
+	if (!tbl)
+		return;
+
+	for (;;) {
+		tbl[0] = size;
+		fil->cltbl = tbl;
+		res = f_lseek(fil, CREATE_LINKMAP);
+		if (res != FR_NOT_ENOUGH_CORE)
+			break;
+
+		/* Required number of items is returned in the first item */
+		size = tbl[0];
+		new_tbl = realloc(tbl, size * sizeof(*tbl));
+		if (!new_tbl) {
+			res = FR_NOT_ENOUGH_CORE;
+			break;
+		}
+		tbl = new_tbl;
+	}
+
+	if (res != FR_OK) {
+		dprintf(INFO, "fat: Failed to create cluster link map: %d\n", res);
+		free(tbl);
+		fil->cltbl = NULL;
+	}
+}
+#endif
+
 static status_t fat_open_file(fscookie *cookie, const char *path,
 			      filecookie **fcookie)
 {
@@ -172,6 +261,15 @@ static status_t fat_open_file(fscookie *cookie, const char *path,
 		return fresult_to_status(res);
 	}
 
+#if FF_USE_FASTSEEK
+	/*
+	 * exFAT files marked NoFatChain are contiguous, f_read() reads them
+	 * without looking at the FAT and does not need the link map.
+	 */
+	if (!(fil->obj.fs->fs_type == FS_EXFAT && fil->obj.stat == 2))
+		fat_create_linkmap(fil);
+#endif
+
 	*fcookie = (filecookie *)fil;
 	return NO_ERROR;
 }
@@ -209,6 +307,9 @@ static status_t fat_close_file(filecookie *fcookie)
 	FIL *fil = (FIL *)fcookie;
 
 	f_close(fil);
+#if FF_USE_FASTSEEK
+	free(fil->cltbl);
+#endif
 	free(fil);
 
 	return NO_ERROR;
@@ -266,6 +367,7 @@ static status_t fat_close_directory(dircookie *dcookie)
 }
 
 static const struct fs_api fat_api = {
+	.probe = fat_probe,
 	.mount = fat_mount,
 	.unmount = fat_unmount,
 	.open = fat_open_file,
@@ -1662,6 +1662,33 @@ static DWORD clmt_clust (	/* <2:Error, >=2:Cluster number */
 	return cl + *tbl;	/* Return the cluster number */
 }
 
+
+
+/*-----------------------------------------------------------------------*/
+/* FAT handling - Get number of contiguous clusters from an offset       */
+/*-----------------------------------------------------------------------*/
+
+static DWORD clmt_contig (	/* 0:Error, >=1:Clusters up to the end of the fragment */
+	FIL* fp,		/* Pointer to the file object */
+	FSIZE_t ofs		/* File offset to be converted to cluster# */
+)
+{
+	DWORD cl, ncl;
+	DWORD *tbl;
+	FATFS *fs = fp->obj.fs;
+
+
+	tbl = fp->cltbl + 1;	/* Top of CLMT */
+	cl = (DWORD)(ofs / SS(fs) / fs->csize);	/* Cluster order from top of the file */
+	for (;;) {
+		ncl = *tbl++;			/* Number of cluters in the fragment */
+		if (ncl == 0) return 0;	/* End of table? (error) */
+		if (cl < ncl) break;	/* In this fragment? */
+		cl -= ncl; tbl++;		/* Next fragment */
+	}
+	return ncl - cl;	/* Return the clusters left in the fragment */
+}
+
 #endif	/* FF_USE_FASTSEEK */
 
 
@@ -4042,10 +4069,30 @@ FRESULT f_read (
 			sect += csect;
 			cc = btr / SS(fs);					/* When remaining bytes >= sector size, */
 			if (cc > 0) {						/* Read maximum contiguous sectors directly */
-				if (csect + cc > fs->csize) {	/* Clip at cluster boundary */
-					cc = fs->csize - csect;
+				if (csect + cc > fs->csize) {
+#if FF_FS_EXFAT
+					if (fs->fs_type == FS_EXFAT && fp->obj.stat == 2) {
+						/* Contiguous file (NoFatChain), btr never goes past its end */
+					} else
+#endif
+#if FF_USE_FASTSEEK
+					if (fp->cltbl) {			/* Clip at the end of the fragment */
+						DWORD ncl = clmt_contig(fp, fp->fptr);
+
+						if (ncl == 0) ABORT(fs, FR_INT_ERR);
+						if (csect + cc > ncl * fs->csize) {
+							cc = ncl * fs->csize - csect;
+						}
+					} else
+#endif
+					{							/* Clip at cluster boundary */
+						cc = fs->csize - csect;
+					}
 				}
 				if (disk_read(fs->pdrv, rbuff, sect, cc) != RES_OK) ABORT(fs, FR_DISK_ERR);
+#if FF_USE_FASTSEEK || FF_FS_EXFAT
+				fp->clust += (csect + cc - 1) / fs->csize;	/* Cluster of the last sector read */
+#endif
 #if !FF_FS_READONLY && FF_FS_MINIMIZE <= 2		/* Replace one of the read sectors with cached data if it contains a dirty sector */
 #if FF_FS_TINY
 				if (fs->wflag && fs->winsect - sect < cc) {
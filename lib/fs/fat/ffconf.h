@@ -34,8 +34,11 @@
 /* This option switches f_mkfs(). (0:Disable or 1:Enable) */
 
 
+#ifndef FF_USE_FASTSEEK
 #define FF_USE_FASTSEEK	0
-/* This option switches fast seek feature. (0:Disable or 1:Enable) */
+#endif
+/* This option switches fast seek feature. (0:Disable or 1:Enable)
+/  Can be overridden from the build (e.g. DEFINES += FF_USE_FASTSEEK=1). */
 
 
 #define FF_USE_EXPAND	0
@@ -236,14 +239,17 @@
 / System Configurations
 /---------------------------------------------------------------------------*/
 
+#ifndef FF_FS_TINY
 #define FF_FS_TINY		1
+#endif
 /* This option switches tiny buffer configuration. (0:Normal or 1:Tiny)
+/  Can be overridden from the build (e.g. DEFINES += FF_FS_TINY=0).
 /  At the tiny configuration, size of file object (FIL) is reduced FF_MAX_SS bytes.
 /  Instead of private sector buffer eliminated from the file object, common sector
 /  buffer in the filesystem object (FATFS) is used for the file data transfer. */
 
 
-#define FF_FS_EXFAT		0
+#define FF_FS_EXFAT		1
 /* This option switches support for exFAT filesystem. (0:Disable or 1:Enable)
 /  To enable exFAT, also LFN needs to be enabled. (FF_USE_LFN >= 1)
 /  Note that enabling exFAT discards ANSI C (C89) compatibility. */
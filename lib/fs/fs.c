@@ -28,6 +28,10 @@
 #include <lib/fs.h>
 #include <lib/bio.h>
 
+#if WITH_LK2ND_TRACE
+#include <lk2nd/trace.h>
+#endif
+
 #define LOCAL_TRACE 0
 
 struct fs_mount {
@@ -37,6 +41,7 @@ struct fs_mount {
     bdev_t *dev;
     fscookie *cookie;
     int refs;
+    bool stale;
     const struct fs_api *api;
 };
 
@@ -57,15 +62,30 @@ struct fs {
 };
 
 static struct list_node mounts = LIST_INITIAL_VALUE(mounts);
+
+/*
+ * Mounts are not torn down when they are unmounted, but kept here with the
+ * filesystem state and caches until the same device is mounted again, e.g.
+ * by the next boot attempt or a menu action. fs_invalidate() drops them once
+ * the device may have been written behind the back of the filesystem.
+ */
+#define FS_MAX_IDLE_MOUNTS 8
+
+static struct list_node idle_mounts = LIST_INITIAL_VALUE(idle_mounts);
+static int idle_count;
 static struct list_node fses = LIST_INITIAL_VALUE(fses);
 
 /* qualcomm runs fs_init() manually, so we use it to init filesystem submodules */
 void ext2_init(void);
+void erofs_init(void);
 void fat_init(void);
+void squashfs_init(void);
 
 void fs_init(void) {
 	ext2_init();
+	erofs_init();
 	fat_init();
+	squashfs_init();
 }
 
 static struct fs *find_fs(const char *name)
@@ -117,8 +137,22 @@ status_t fs_register_type(const char *name, const struct fs_api *api)
     return NO_ERROR;
 }
 
-static status_t mount(const char *path, const char *device, const struct fs_api *api)
+static void destroy_mount(struct fs_mount *mount)
+{
+    mount->api->unmount(mount->cookie);
+    free(mount->path);
+    bio_close(mount->dev);
+    free(mount);
+}
+
+/*
+ * Reuse the filesystem of device if it is still mounted on path or was
+ * unmounted before, api NULL accepts any filesystem.
+ * Returns ERR_NOT_FOUND if the device has to be mounted from scratch.
+ */
+static status_t reuse_mount(const char *path, const char *device, const struct fs_api *api)
 {
+    struct fs_mount *mount;
     char temppath[512];
 
     strlcpy(temppath, path, sizeof(temppath));
@@ -127,15 +161,51 @@ static status_t mount(const char *path, const char *device, const struct fs_api
     if (temppath[0] != '/')
         return ERR_BAD_PATH;
 
-    if (find_mount(temppath, NULL))
+    mount = find_mount(temppath, NULL);
+    if (mount) {
+        if (!strcmp(mount->path, temppath) && !strcmp(mount->dev->name, device) &&
+                (!api || mount->api == api)) {
+            /* balanced by the fs_unmount() of this caller */
+            mount->refs++;
+            return NO_ERROR;
+        }
         return ERR_ALREADY_MOUNTED;
+    }
+
+    list_for_every_entry(&idle_mounts, mount, struct fs_mount, node) {
+        if (strcmp(mount->dev->name, device) || (api && mount->api != api))
+            continue;
+
+        LTRACEF("reusing %s for %s\n", device, temppath);
+        list_delete(&mount->node);
+        idle_count--;
+
+        mount->path = strdup(temppath);
+        mount->refs = 1;
+        list_add_head(&mounts, &mount->node);
+        return NO_ERROR;
+    }
+
+    return ERR_NOT_FOUND;
+}
+
+static status_t mount(const char *path, const char *device, const struct fs_api *api)
+{
+    char temppath[512];
+
+    status_t err = reuse_mount(path, device, api);
+    if (err != ERR_NOT_FOUND)
+        return err;
+
+    strlcpy(temppath, path, sizeof(temppath));
+    fs_normalize_path(temppath);
 
     bdev_t *dev = bio_open(device);
     if (!dev)
         return ERR_NOT_FOUND;
 
     fscookie *cookie;
-    status_t err = api->mount(dev, &cookie);
+    err = api->mount(dev, &cookie);
     if (err < 0) {
         bio_close(dev);
         return err;
@@ -147,6 +217,7 @@ static status_t mount(const char *path, const char *device, const struct fs_api
     mount->dev = dev;
     mount->cookie = cookie;
     mount->refs = 1;
+    mount->stale = false;
     mount->api = api;
 
     list_add_head(&mounts, &mount->node);
@@ -163,14 +234,110 @@ status_t fs_mount(const char *path, const char *fsname, const char *device)
     return mount(path, device, fs->api);
 }
 
+/*
+ * Read the start of the device once and only try the filesystems that
+ * recognize it, instead of letting every driver read its own superblock.
+ */
+status_t fs_mount_auto(const char *path, const char *device)
+{
+    status_t err = ERR_NOT_FOUND;
+    ssize_t len;
+    struct fs *fs;
+    void *buf;
+
+    err = reuse_mount(path, device, NULL);
+    if (err != ERR_NOT_FOUND)
+        return err;
+
+    bdev_t *dev = bio_open(device);
+    if (!dev)
+        return ERR_NOT_FOUND;
+
+    buf = malloc(FS_PROBE_SIZE);
+    if (!buf) {
+        bio_close(dev);
+        return ERR_NO_MEMORY;
+    }
+
+    len = bio_read(dev, buf, 0, MIN(dev->size, FS_PROBE_SIZE));
+    bio_close(dev);
+    if (len < 0) {
+        free(buf);
+        return len;
+    }
+
+    list_for_every_entry(&fses, fs, struct fs, node) {
+        if (fs->api->probe && !fs->api->probe(buf, len))
+            continue;
+
+        LTRACEF("trying %s on %s\n", fs->name, device);
+        err = mount(path, device, fs->api);
+        if (err >= 0)
+            break;
+    }
+
+    free(buf);
+    return err;
+}
+
 static void put_mount(struct fs_mount *mount)
 {
-    if (!(--mount->refs)) {
+    if (--mount->refs)
+        return;
+
+    /* invalidated mounts were taken off the list already */
+    if (mount->stale) {
+        destroy_mount(mount);
+        return;
+    }
+
+    /* keep it for the next mount of the device, dropping the oldest one */
+    list_delete(&mount->node);
+    free(mount->path);
+    mount->path = NULL;
+    list_add_head(&idle_mounts, &mount->node);
+    if (++idle_count > FS_MAX_IDLE_MOUNTS) {
+        mount = list_remove_tail_type(&idle_mounts, struct fs_mount, node);
+        idle_count--;
+        destroy_mount(mount);
+    }
+}
+
+/* device itself or one of the partitions found inside of it */
+static bool mount_on_device(struct fs_mount *mount, const char *device)
+{
+    const char *name = mount->dev->name;
+    size_t len;
+
+    if (!device)
+        return true;
+
+    len = strlen(device);
+    return !strncmp(name, device, len) && (name[len] == '\0' || name[len] == 'p');
+}
+
+void fs_invalidate(const char *device)
+{
+    struct fs_mount *mount, *temp;
+
+    list_for_every_entry_safe(&idle_mounts, mount, temp, struct fs_mount, node) {
+        if (!mount_on_device(mount, device))
+            continue;
+
+        list_delete(&mount->node);
+        idle_count--;
+        destroy_mount(mount);
+    }
+
+    /* mounted ones are unmounted, files that are still open keep working */
+    list_for_every_entry_safe(&mounts, mount, temp, struct fs_mount, node) {
+        if (!mount_on_device(mount, device))
+            continue;
+
+        LTRACEF("invalidating %s on %s\n", mount->dev->name, mount->path);
         list_delete(&mount->node);
-        mount->api->unmount(mount->cookie);
-        free(mount->path);
-        bio_close(mount->dev);
-        free(mount);
+        mount->stale = true;
+        put_mount(mount);
     }
 }
 
@@ -194,6 +361,9 @@ status_t fs_unmount(const char *path)
 status_t fs_open_file(const char *path, filehandle **handle)
 {
     char temppath[512];
+#if WITH_LK2ND_TRACE
+    LK2ND_TRACE_SCOPE("fs_open", 0);
+#endif
 
     strlcpy(temppath, path, sizeof(temppath));
     fs_normalize_path(temppath);
@@ -313,17 +483,13 @@ status_t fs_open_dir(const char *path, dirhandle **handle)
 
     LTRACEF("path %s temppath %s newpath %s\n", path, temppath, newpath);
 
-    if (!mount->api->opendir) {
-        put_mount(mount);
+    if (!mount->api->opendir)
         return ERR_NOT_SUPPORTED;
-    }
 
     dircookie *cookie;
     status_t err = mount->api->opendir(mount->cookie, newpath, &cookie);
-    if (err < 0) {
-        put_mount(mount);
+    if (err < 0)
         return err;
-    }
 
     dirhandle *d = malloc(sizeof(*d));
     d->cookie = cookie;
@@ -2,7 +2,9 @@ LOCAL_DIR := $(GET_LOCAL_DIR)
 
 MODULES += \
 	lib/fs/ext2 \
-	lib/fs/fat
+	lib/fs/erofs \
+	lib/fs/fat \
+	lib/fs/squashfs
 
 OBJS += \
 	$(LOCAL_DIR)/fs.o \
@@ -0,0 +1,222 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <debug.h>
+#include <endian.h>
+#include <err.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "squashfs_priv.h"
+
+#define LOCAL_TRACE 0
+
+static int squashfs_load_fragment(squashfs_file_t *file)
+{
+	squashfs_t *sqfs = file->sqfs;
+	uint32_t frag = file->inode.fragment;
+	struct squashfs_fragment_entry entry;
+	struct squashfs_meta_pos pos;
+	uint64_t block;
+	int err;
+
+	if (frag >= sqfs->fragments)
+		return ERR_NOT_VALID;
+
+	/* the table is a list of the metadata blocks with the entries */
+	err = bio_read(sqfs->dev, &block, sqfs->fragment_table +
+		       (frag / SQUASHFS_FRAGMENTS_PER_BLOCK) * sizeof(block), sizeof(block));
+	if (err < 0)
+		return err;
+
+	pos.block = LE64(block);
+	pos.offset = (frag % SQUASHFS_FRAGMENTS_PER_BLOCK) * sizeof(entry);
+	err = squashfs_read_meta(sqfs, &pos, &entry, sizeof(entry));
+	if (err < 0)
+		return err;
+
+	file->frag_block = LE64(entry.start_block);
+	file->frag_size = LE32(entry.size);
+	return 0;
+}
+
+status_t squashfs_open_file(fscookie *cookie, const char *path, filecookie **fcookie)
+{
+	squashfs_t *sqfs = (squashfs_t *)cookie;
+	struct squashfs_meta_pos pos;
+	squashfs_file_t *file;
+	unsigned int i;
+	int err;
+
+	file = calloc(1, sizeof(*file));
+	if (!file)
+		return ERR_NO_MEMORY;
+
+	file->sqfs = sqfs;
+	err = squashfs_lookup(sqfs, path, &file->inode);
+	if (err < 0)
+		goto err;
+
+	if (!SQUASHFS_IS_REG(&file->inode)) {
+		*fcookie = (filecookie *)file;
+		return 0;
+	}
+
+	if (file->inode.fragment == SQUASHFS_INVALID_FRAG) {
+		file->nblocks = (file->inode.size + SQUASHFS_BLKSIZ(sqfs) - 1) >> sqfs->block_log;
+	} else {
+		file->nblocks = file->inode.size >> sqfs->block_log;
+		err = squashfs_load_fragment(file);
+		if (err < 0)
+			goto err;
+	}
+
+	/* the sizes of the blocks follow the inode */
+	if (file->nblocks) {
+		file->sizes = malloc(file->nblocks * sizeof(*file->sizes));
+		if (!file->sizes) {
+			err = ERR_NO_MEMORY;
+			goto err;
+		}
+
+		pos = file->inode.next;
+		err = squashfs_read_meta(sqfs, &pos, file->sizes,
+					 file->nblocks * sizeof(*file->sizes));
+		if (err < 0)
+			goto err;
+
+		for (i = 0; i < file->nblocks; i++)
+			file->sizes[i] = LE32(file->sizes[i]);
+	}
+
+	file->cur_pos = file->inode.start_block;
+
+	*fcookie = (filecookie *)file;
+	return 0;
+
+err:
+	free(file->sizes);
+	free(file);
+	return err;
+}
+
+/* Position of data block idx, the blocks are stored one after the other */
+static off_t squashfs_block_pos(squashfs_file_t *file, unsigned int idx)
+{
+	if (idx < file->cur_idx) {
+		file->cur_idx = 0;
+		file->cur_pos = file->inode.start_block;
+	}
+
+	for (; file->cur_idx < idx; file->cur_idx++)
+		file->cur_pos += SQUASHFS_BLOCK_SIZE(file->sizes[file->cur_idx]);
+
+	return file->cur_pos;
+}
+
+static ssize_t squashfs_read_tail(squashfs_file_t *file, uint8_t *buf,
+				  size_t offset, size_t len)
+{
+	const uint8_t *data;
+	ssize_t ret;
+
+	ret = squashfs_get_block(file->sqfs, file->frag_block, file->frag_size, &data);
+	if (ret < 0)
+		return ret;
+
+	offset += file->inode.frag_offset;
+	if (offset + len > (size_t)ret)
+		return ERR_NOT_VALID;
+
+	memcpy(buf, data + offset, len);
+	return len;
+}
+
+ssize_t squashfs_read_file(filecookie *fcookie, void *_buf, off_t offset, size_t len)
+{
+	squashfs_file_t *file = (squashfs_file_t *)fcookie;
+	squashfs_t *sqfs = file->sqfs;
+	const uint32_t blksz = SQUASHFS_BLKSIZ(sqfs);
+	uint8_t *buf = _buf;
+	const uint8_t *data;
+	unsigned int idx;
+	size_t done = 0, n, blen, boff;
+	uint32_t size;
+	off_t block;
+	ssize_t ret;
+	int err;
+
+	LTRACEF("offset %lld, len %zu\n", offset, len);
+
+	if (!SQUASHFS_IS_REG(&file->inode))
+		return ERR_NOT_FILE;
+	if (offset < 0)
+		return ERR_INVALID_ARGS;
+	if (offset >= file->inode.size)
+		return 0;
+	len = MIN((off_t)len, file->inode.size - offset);
+
+	while (done < len) {
+		idx = (offset + done) >> sqfs->block_log;
+		boff = (offset + done) & (blksz - 1);
+
+		if (idx >= file->nblocks) {
+			ret = squashfs_read_tail(file, buf + done, boff, len - done);
+			if (ret < 0)
+				return ret;
+			done += ret;
+			break;
+		}
+
+		blen = MIN((off_t)blksz, file->inode.size - ((off_t)idx << sqfs->block_log));
+		n = MIN(len - done, blen - boff);
+		size = file->sizes[idx];
+		block = squashfs_block_pos(file, idx);
+
+		if (!SQUASHFS_BLOCK_SIZE(size)) {
+			/* sparse */
+			memset(buf + done, 0, n);
+		} else if (size & SQUASHFS_BLOCK_UNCOMPRESSED) {
+			err = squashfs_read_data(sqfs, buf + done, block + boff, n);
+			if (err < 0)
+				return err;
+		} else if (n == blen) {
+			/* the whole block, decompress it in place */
+			ret = squashfs_read_block(sqfs, block, size, buf + done, blen);
+			if (ret < 0)
+				return ret;
+			if ((size_t)ret != blen)
+				return ERR_NOT_VALID;
+		} else {
+			ret = squashfs_get_block(sqfs, block, size, &data);
+			if (ret < 0)
+				return ret;
+			if ((size_t)ret != blen)
+				return ERR_NOT_VALID;
+			memcpy(buf + done, data + boff, n);
+		}
+
+		done += n;
+	}
+
+	return done;
+}
+
+status_t squashfs_stat_file(filecookie *fcookie, struct file_stat *stat)
+{
+	squashfs_file_t *file = (squashfs_file_t *)fcookie;
+
+	stat->size = file->inode.size;
+	stat->is_dir = SQUASHFS_IS_DIR(&file->inode);
+
+	return 0;
+}
+
+status_t squashfs_close_file(filecookie *fcookie)
+{
+	squashfs_file_t *file = (squashfs_file_t *)fcookie;
+
+	free(file->sizes);
+	free(file);
+
+	return 0;
+}
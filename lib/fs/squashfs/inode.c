@@ -0,0 +1,412 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <debug.h>
+#include <endian.h>
+#include <err.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "squashfs_priv.h"
+
+#define LOCAL_TRACE 0
+
+/* deepest directory that ".." can go back from */
+#define SQUASHFS_MAX_DEPTH	16
+
+int squashfs_load_inode(squashfs_t *sqfs, uint64_t ref, struct squashfs_inode *inode)
+{
+	struct squashfs_meta_pos pos = {
+		.block = sqfs->inode_table + SQUASHFS_REF_BLOCK(ref),
+		.offset = SQUASHFS_REF_OFFSET(ref),
+	};
+	struct squashfs_meta_pos start = pos;
+	union {
+		struct squashfs_base_inode base;
+		struct squashfs_dir_inode dir;
+		struct squashfs_ldir_inode ldir;
+		struct squashfs_reg_inode reg;
+		struct squashfs_lreg_inode lreg;
+		struct squashfs_symlink_inode symlink;
+	} di;
+	size_t len;
+	int err;
+
+	err = squashfs_read_meta(sqfs, &pos, &di.base, sizeof(di.base));
+	if (err < 0)
+		return err;
+
+	memset(inode, 0, sizeof(*inode));
+	inode->type = LE16(di.base.inode_type);
+	inode->fragment = SQUASHFS_INVALID_FRAG;
+
+	switch (inode->type) {
+	case SQUASHFS_DIR_TYPE:
+		len = sizeof(di.dir);
+		break;
+	case SQUASHFS_LDIR_TYPE:
+		len = sizeof(di.ldir);
+		break;
+	case SQUASHFS_REG_TYPE:
+		len = sizeof(di.reg);
+		break;
+	case SQUASHFS_LREG_TYPE:
+		len = sizeof(di.lreg);
+		break;
+	case SQUASHFS_SYMLINK_TYPE:
+	case SQUASHFS_LSYMLINK_TYPE:
+		len = sizeof(di.symlink);
+		break;
+	default:
+		/* devices, fifos and sockets have no data */
+		inode->next = pos;
+		return 0;
+	}
+
+	pos = start;
+	err = squashfs_read_meta(sqfs, &pos, &di, len);
+	if (err < 0)
+		return err;
+	inode->next = pos;
+
+	switch (inode->type) {
+	case SQUASHFS_DIR_TYPE:
+		inode->size = LE16(di.dir.file_size);
+		inode->dir_block = LE32(di.dir.start_block);
+		inode->dir_offset = LE16(di.dir.offset);
+		break;
+	case SQUASHFS_LDIR_TYPE:
+		inode->size = LE32(di.ldir.file_size);
+		inode->dir_block = LE32(di.ldir.start_block);
+		inode->dir_offset = LE16(di.ldir.offset);
+		inode->i_count = LE16(di.ldir.i_count);
+		break;
+	case SQUASHFS_REG_TYPE:
+		inode->size = LE32(di.reg.file_size);
+		inode->start_block = LE32(di.reg.start_block);
+		inode->fragment = LE32(di.reg.fragment);
+		inode->frag_offset = LE32(di.reg.offset);
+		break;
+	case SQUASHFS_LREG_TYPE:
+		inode->size = LE64(di.lreg.file_size);
+		inode->start_block = LE64(di.lreg.start_block);
+		inode->fragment = LE32(di.lreg.fragment);
+		inode->frag_offset = LE32(di.lreg.offset);
+		break;
+	default:
+		inode->size = LE32(di.symlink.symlink_size);
+		break;
+	}
+
+	LTRACEF("ref 0x%llx: type %u, size %lld\n", ref, inode->type, inode->size);
+
+	if (inode->size < 0)
+		return ERR_NOT_VALID;
+
+	return 0;
+}
+
+static int squashfs_namecmp(const char *a, size_t alen, const char *b, size_t blen)
+{
+	int ret = memcmp(a, b, MIN(alen, blen));
+
+	if (ret)
+		return ret;
+
+	return (alen > blen) - (alen < blen);
+}
+
+/* Position of the listing of a directory and its length in bytes */
+static void squashfs_dir_start(squashfs_t *sqfs, struct squashfs_inode *dir,
+			       struct squashfs_meta_pos *pos, off_t *left)
+{
+	pos->block = sqfs->dir_table + dir->dir_block;
+	pos->offset = dir->dir_offset;
+
+	/* file_size counts 3 more bytes for the "." and ".." that aren't stored */
+	*left = dir->size - 3;
+}
+
+/*
+ * Large directories have an index with the first name of each metadata
+ * block of the listing. Skip ahead to the last block that starts with a
+ * name before the one we are looking for.
+ */
+static int squashfs_dir_index(squashfs_t *sqfs, struct squashfs_inode *dir,
+			      const char *name, size_t namelen,
+			      struct squashfs_meta_pos *pos, off_t *left)
+{
+	struct squashfs_meta_pos ipos = dir->next;
+	struct squashfs_dir_index idx;
+	char iname[SQUASHFS_NAME_LEN];
+	uint32_t size;
+	uint i;
+	int err;
+
+	for (i = 0; i < dir->i_count; i++) {
+		err = squashfs_read_meta(sqfs, &ipos, &idx, sizeof(idx));
+		if (err < 0)
+			return err;
+
+		size = LE32(idx.size) + 1;
+		if (size > sizeof(iname))
+			return ERR_NOT_VALID;
+
+		err = squashfs_read_meta(sqfs, &ipos, iname, size);
+		if (err < 0)
+			return err;
+
+		if (squashfs_namecmp(name, namelen, iname, size) < 0)
+			break;
+
+		pos->block = sqfs->dir_table + LE32(idx.start_block);
+		pos->offset = (dir->dir_offset + LE32(idx.index)) % SQUASHFS_METADATA_SIZE;
+		*left = dir->size - 3 - LE32(idx.index);
+	}
+
+	return 0;
+}
+
+static int squashfs_dir_lookup(squashfs_t *sqfs, struct squashfs_inode *dir,
+			       const char *name, size_t namelen, uint64_t *ref)
+{
+	struct squashfs_meta_pos pos;
+	struct squashfs_dir_header hdr;
+	struct squashfs_dir_entry ent;
+	char ename[SQUASHFS_NAME_LEN];
+	uint32_t count, size;
+	off_t left;
+	int cmp, err;
+
+	if (!SQUASHFS_IS_DIR(dir))
+		return ERR_NOT_DIR;
+
+	squashfs_dir_start(sqfs, dir, &pos, &left);
+	if (dir->i_count) {
+		err = squashfs_dir_index(sqfs, dir, name, namelen, &pos, &left);
+		if (err < 0)
+			return err;
+	}
+
+	while (left > 0) {
+		err = squashfs_read_meta(sqfs, &pos, &hdr, sizeof(hdr));
+		if (err < 0)
+			return err;
+		left -= sizeof(hdr);
+
+		count = LE32(hdr.count) + 1;
+		if (count > SQUASHFS_DIR_COUNT)
+			return ERR_NOT_VALID;
+
+		while (count--) {
+			err = squashfs_read_meta(sqfs, &pos, &ent, sizeof(ent));
+			if (err < 0)
+				return err;
+
+			size = LE16(ent.size) + 1;
+			if (size > sizeof(ename))
+				return ERR_NOT_VALID;
+
+			err = squashfs_read_meta(sqfs, &pos, ename, size);
+			if (err < 0)
+				return err;
+			left -= sizeof(ent) + size;
+
+			/* entries are sorted by name */
+			cmp = squashfs_namecmp(name, namelen, ename, size);
+			if (cmp < 0)
+				return ERR_NOT_FOUND;
+			if (!cmp) {
+				*ref = (uint64_t)LE32(hdr.start_block) << 16 | LE16(ent.offset);
+				return 0;
+			}
+		}
+	}
+
+	return ERR_NOT_FOUND;
+}
+
+/*
+ * squashfs doesn't store "." and "..", so the walk keeps the directories
+ * from the root down to the current one.
+ */
+struct squashfs_walk {
+	struct squashfs_inode dirs[SQUASHFS_MAX_DEPTH];
+	int depth;
+};
+
+/* note, trashes path */
+static int squashfs_walk(squashfs_t *sqfs, char *path, struct squashfs_walk *w,
+			 struct squashfs_inode *inode, int recurse)
+{
+	char *ptr = path, *next;
+	uint64_t ref;
+	int err;
+
+	if (recurse > 4)
+		return ERR_RECURSE_TOO_DEEP;
+
+	if (*path == '/')
+		w->depth = 1;
+
+	*inode = w->dirs[w->depth - 1];
+	for (;;) {
+		while (*ptr == '/')
+			ptr++;
+		if (!*ptr)
+			return 0;
+
+		next = strchr(ptr, '/');
+		if (next)
+			*next++ = '\0';
+
+		LTRACEF("component '%s'\n", ptr);
+
+		if (!strcmp(ptr, ".") || !strcmp(ptr, "..")) {
+			if (ptr[1] && w->depth > 1)
+				w->depth--;
+			*inode = w->dirs[w->depth - 1];
+			if (!next)
+				return 0;
+			ptr = next;
+			continue;
+		}
+
+		err = squashfs_dir_lookup(sqfs, &w->dirs[w->depth - 1], ptr, strlen(ptr), &ref);
+		if (err < 0)
+			return err;
+
+		err = squashfs_load_inode(sqfs, ref, inode);
+		if (err < 0)
+			return err;
+
+		if (SQUASHFS_IS_SYMLINK(inode)) {
+			struct squashfs_meta_pos pos = inode->next;
+			char link[512];
+
+			if (inode->size >= (off_t)sizeof(link))
+				return ERR_NO_MEMORY;
+
+			err = squashfs_read_meta(sqfs, &pos, link, inode->size);
+			if (err < 0)
+				return err;
+			link[inode->size] = '\0';
+
+			LTRACEF("symlink to '%s'\n", link);
+
+			err = squashfs_walk(sqfs, link, w, inode, recurse + 1);
+			if (err < 0)
+				return err;
+		}
+
+		if (!next)
+			return 0;
+
+		/* we aren't done and this walked over a nondir */
+		if (!SQUASHFS_IS_DIR(inode))
+			return ERR_NOT_FOUND;
+
+		if (w->depth == SQUASHFS_MAX_DEPTH)
+			return ERR_RECURSE_TOO_DEEP;
+
+		w->dirs[w->depth++] = *inode;
+		ptr = next;
+	}
+}
+
+int squashfs_lookup(squashfs_t *sqfs, const char *_path, struct squashfs_inode *inode)
+{
+	struct squashfs_walk *w;
+	char path[512];
+	int err;
+
+	LTRACEF("path '%s'\n", _path);
+
+	w = malloc(sizeof(*w));
+	if (!w)
+		return ERR_NO_MEMORY;
+
+	w->dirs[0] = sqfs->root;
+	w->depth = 1;
+
+	strlcpy(path, _path, sizeof(path));
+	err = squashfs_walk(sqfs, path, w, inode, 1);
+
+	free(w);
+	return err;
+}
+
+status_t squashfs_open_directory(fscookie *cookie, const char *path, dircookie **dcookie)
+{
+	squashfs_t *sqfs = (squashfs_t *)cookie;
+	struct squashfs_inode inode;
+	squashfs_dir_t *dir;
+	int err;
+
+	err = squashfs_lookup(sqfs, path, &inode);
+	if (err < 0)
+		return err;
+
+	if (!SQUASHFS_IS_DIR(&inode))
+		return ERR_NOT_DIR;
+
+	dir = calloc(1, sizeof(*dir));
+	if (!dir)
+		return ERR_NO_MEMORY;
+
+	dir->sqfs = sqfs;
+	squashfs_dir_start(sqfs, &inode, &dir->pos, &dir->left);
+
+	*dcookie = (dircookie *)dir;
+	return 0;
+}
+
+status_t squashfs_read_directory(dircookie *dcookie, struct dirent *ent)
+{
+	squashfs_dir_t *dir = (squashfs_dir_t *)dcookie;
+	struct squashfs_dir_header hdr;
+	struct squashfs_dir_entry de;
+	char name[SQUASHFS_NAME_LEN];
+	uint32_t size;
+	int err;
+
+	if (!dir->count) {
+		if (dir->left <= 0)
+			return ERR_NOT_FOUND;
+
+		err = squashfs_read_meta(dir->sqfs, &dir->pos, &hdr, sizeof(hdr));
+		if (err < 0)
+			return err;
+		dir->left -= sizeof(hdr);
+
+		dir->count = LE32(hdr.count) + 1;
+		if (dir->count > SQUASHFS_DIR_COUNT)
+			return ERR_NOT_VALID;
+	}
+
+	err = squashfs_read_meta(dir->sqfs, &dir->pos, &de, sizeof(de));
+	if (err < 0)
+		return err;
+
+	size = LE16(de.size) + 1;
+	if (size > sizeof(name))
+		return ERR_NOT_VALID;
+
+	err = squashfs_read_meta(dir->sqfs, &dir->pos, name, size);
+	if (err < 0)
+		return err;
+
+	dir->left -= sizeof(de) + size;
+	dir->count--;
+
+	size = MIN(size, FS_MAX_FILE_LEN - 1);
+	memcpy(ent->name, name, size);
+	ent->name[size] = '\0';
+
+	return 0;
+}
+
+status_t squashfs_close_directory(dircookie *dcookie)
+{
+	free(dcookie);
+	return 0;
+}
@@ -0,0 +1,22 @@
+LOCAL_DIR := $(GET_LOCAL_DIR)
+
+MODULES += \
+	lib/fs \
+	lib/bio \
+	lib/lz4 \
+	lib/zlib_inflate \
+	lib/zstd
+
+OBJS += \
+	$(LOCAL_DIR)/squashfs.o \
+	$(LOCAL_DIR)/inode.o \
+	$(LOCAL_DIR)/file.o
+
+# Decompressed blocks cached per mounted volume: metadata blocks (8 KiB each,
+# inodes and directories) and fragment/data blocks (block size of the volume)
+SQUASHFS_META_CACHE ?= 8
+SQUASHFS_BLOCK_CACHE ?= 2
+
+DEFINES += \
+	SQUASHFS_META_CACHE=$(SQUASHFS_META_CACHE) \
+	SQUASHFS_BLOCK_CACHE=$(SQUASHFS_BLOCK_CACHE)
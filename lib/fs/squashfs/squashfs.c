@@ -0,0 +1,387 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <debug.h>
+#include <endian.h>
+#include <err.h>
+#include <stdlib.h>
+#include <string.h>
+#include <lib/fs.h>
+#include <lib/lz4.h>
+#include <lib/zstd.h>
+
+#include "squashfs_priv.h"
+
+/*
+ * squashfs.c - Read-only driver for squashfs 4.0.
+ *
+ * Everything but the superblock is compressed: inodes and directories in
+ * metadata blocks of up to 8 KiB, file data in blocks of up to 1 MiB, and
+ * the tails of files packed together into fragment blocks. A few
+ * decompressed metadata blocks and fragment/data blocks are cached per
+ * volume. Whole data blocks of a file are decompressed straight into the
+ * buffer of the caller, the caches only serve partial reads and tails.
+ *
+ * Supported compressors: gzip, LZ4 and zstd. Not supported: xz, lzma and
+ * lzo, xattrs (skipped), and device/uid tables which LK has no use for.
+ */
+
+#define LOCAL_TRACE 0
+
+static ssize_t squashfs_zlib(squashfs_t *sqfs, const void *src, size_t src_len,
+			     void *dst, size_t dst_len)
+{
+	z_stream *zs = &sqfs->zstream;
+	int rc;
+
+	rc = inflateReset(zs);
+	if (rc != Z_OK)
+		return ERR_NOT_VALID;
+
+	zs->next_in = (Bytef *)src;
+	zs->avail_in = src_len;
+	zs->next_out = dst;
+	zs->avail_out = dst_len;
+
+	rc = inflate(zs, Z_FINISH);
+	if (rc != Z_STREAM_END) {
+		dprintf(INFO, "squashfs: inflate failed: %d\n", rc);
+		return ERR_NOT_VALID;
+	}
+
+	return zs->total_out;
+}
+
+static ssize_t squashfs_lz4(squashfs_t *sqfs, const void *src, size_t src_len,
+			    void *dst, size_t dst_len)
+{
+	return lz4_decompress_raw(src, src_len, dst, dst_len);
+}
+
+static ssize_t squashfs_zstd(squashfs_t *sqfs, const void *src, size_t src_len,
+			     void *dst, size_t dst_len)
+{
+	size_t out_len;
+	int ret;
+
+	ret = zstd_decompress(src, src_len, dst, dst_len, &out_len);
+	if (ret < 0)
+		return ret;
+
+	return out_len;
+}
+
+int squashfs_read_data(squashfs_t *sqfs, void *buf, off_t offset, size_t len)
+{
+	ssize_t ret;
+
+	if (offset + (off_t)len > sqfs->bytes_used)
+		return ERR_NOT_VALID;
+
+	ret = bio_readahead_read(sqfs->ra, sqfs->dev, buf, offset, len);
+	if (ret < 0)
+		return ret;
+
+	return (ret == (ssize_t)len) ? 0 : ERR_IO;
+}
+
+static int squashfs_meta_get(squashfs_t *sqfs, off_t block,
+			     struct squashfs_meta_entry **entry)
+{
+	struct squashfs_meta_entry *e, *victim = &sqfs->meta[0];
+	uint16_t hdr;
+	size_t n, len;
+	ssize_t ret;
+	int i;
+
+	for (i = 0; i < SQUASHFS_META_CACHE; i++) {
+		e = &sqfs->meta[i];
+		if (e->len && e->block == block) {
+			e->lru = ++sqfs->lru;
+			*entry = e;
+			return 0;
+		}
+		if (e->lru < victim->lru)
+			victim = e;
+	}
+
+	/*
+	 * The length is only known after reading the header, so read as much
+	 * as the largest block could need in one go.
+	 */
+	if (block < 0 || block >= sqfs->bytes_used)
+		return ERR_NOT_VALID;
+
+	n = MIN(sizeof(hdr) + SQUASHFS_METADATA_SIZE, (size_t)(sqfs->bytes_used - block));
+	ret = bio_read(sqfs->dev, sqfs->mbuf, block, n);
+	if (ret < 0)
+		return ret;
+	if (ret != (ssize_t)n || n < sizeof(hdr))
+		return ERR_IO;
+
+	hdr = sqfs->mbuf[0] | sqfs->mbuf[1] << 8;
+	len = SQUASHFS_METADATA_LEN(hdr);
+	if (!len || len > n - sizeof(hdr)) {
+		dprintf(INFO, "squashfs: Invalid metadata block at %lld\n", block);
+		return ERR_NOT_VALID;
+	}
+
+	LTRACEF("block %lld, len %zu, hdr 0x%x\n", block, len, hdr);
+
+	victim->len = 0;
+	if (hdr & SQUASHFS_METADATA_UNCOMPRESSED) {
+		memcpy(victim->data, sqfs->mbuf + sizeof(hdr), len);
+		ret = len;
+	} else {
+		ret = sqfs->decompress(sqfs, sqfs->mbuf + sizeof(hdr), len,
+				       victim->data, sizeof(victim->data));
+		if (ret < 0)
+			return ret;
+		if (!ret)
+			return ERR_NOT_VALID;
+	}
+
+	victim->block = block;
+	victim->next = block + sizeof(hdr) + len;
+	victim->len = ret;
+	victim->lru = ++sqfs->lru;
+	*entry = victim;
+	return 0;
+}
+
+/* Read len bytes of a metadata table at pos and advance it (skip if !buf) */
+int squashfs_read_meta(squashfs_t *sqfs, struct squashfs_meta_pos *pos,
+		       void *_buf, size_t len)
+{
+	struct squashfs_meta_entry *e = NULL;
+	uint8_t *buf = _buf;
+	size_t n;
+	int err;
+
+	while (len) {
+		err = squashfs_meta_get(sqfs, pos->block, &e);
+		if (err < 0)
+			return err;
+
+		if (pos->offset >= e->len) {
+			/* continues in the next block */
+			pos->offset -= e->len;
+			pos->block = e->next;
+			continue;
+		}
+
+		n = MIN(len, e->len - pos->offset);
+		if (buf) {
+			memcpy(buf, e->data + pos->offset, n);
+			buf += n;
+		}
+		pos->offset += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+/*
+ * Read a data or fragment block with the given on-disk size into dst,
+ * returns the decompressed length.
+ */
+ssize_t squashfs_read_block(squashfs_t *sqfs, off_t block, uint32_t size,
+			    void *dst, size_t dst_len)
+{
+	size_t csize = SQUASHFS_BLOCK_SIZE(size);
+	int err;
+
+	if (!csize || csize > SQUASHFS_BLKSIZ(sqfs))
+		return ERR_NOT_VALID;
+
+	if (size & SQUASHFS_BLOCK_UNCOMPRESSED) {
+		csize = MIN(csize, dst_len);
+		err = squashfs_read_data(sqfs, dst, block, csize);
+		return err < 0 ? err : (ssize_t)csize;
+	}
+
+	err = squashfs_read_data(sqfs, sqfs->cbuf, block, csize);
+	if (err < 0)
+		return err;
+
+	return sqfs->decompress(sqfs, sqfs->cbuf, csize, dst, dst_len);
+}
+
+/* Get a decompressed block from the cache, returns its length */
+ssize_t squashfs_get_block(squashfs_t *sqfs, off_t block, uint32_t size,
+			   const uint8_t **data)
+{
+	struct squashfs_block_entry *e, *victim = &sqfs->blocks[0];
+	ssize_t ret;
+	int i;
+
+	for (i = 0; i < SQUASHFS_BLOCK_CACHE; i++) {
+		e = &sqfs->blocks[i];
+		if (e->len && e->block == block) {
+			e->lru = ++sqfs->lru;
+			*data = e->data;
+			return e->len;
+		}
+		if (e->lru < victim->lru)
+			victim = e;
+	}
+
+	if (!victim->data) {
+		victim->data = malloc(SQUASHFS_BLKSIZ(sqfs));
+		if (!victim->data)
+			return ERR_NO_MEMORY;
+	}
+
+	victim->len = 0;
+	ret = squashfs_read_block(sqfs, block, size, victim->data, SQUASHFS_BLKSIZ(sqfs));
+	if (ret <= 0)
+		return ret ? ret : ERR_NOT_VALID;
+
+	victim->block = block;
+	victim->len = ret;
+	victim->lru = ++sqfs->lru;
+	*data = victim->data;
+	return ret;
+}
+
+static bool squashfs_probe(const void *buf, size_t len)
+{
+	const struct squashfs_super_block *sb = buf;
+
+	if (len < sizeof(*sb))
+		return true;
+
+	return LE32(sb->s_magic) == SQUASHFS_MAGIC;
+}
+
+static void squashfs_free(squashfs_t *sqfs)
+{
+	int i;
+
+	for (i = 0; i < SQUASHFS_BLOCK_CACHE; i++)
+		free(sqfs->blocks[i].data);
+	if (sqfs->decompress == squashfs_zlib)
+		inflateEnd(&sqfs->zstream);
+	free(sqfs->cbuf);
+	free(sqfs->mbuf);
+	free(sqfs);
+}
+
+static status_t squashfs_mount(bdev_t *dev, fscookie **cookie)
+{
+	struct squashfs_super_block sb;
+	squashfs_t *sqfs;
+	int err;
+
+	err = bio_read(dev, &sb, 0, sizeof(sb));
+	if (err < 0)
+		return err;
+
+	if (LE32(sb.s_magic) != SQUASHFS_MAGIC)
+		return ERR_NOT_VALID;
+
+	LTRACEF("version %u.%u, compression %u, block_log %u, flags 0x%x\n",
+		LE16(sb.s_major), LE16(sb.s_minor), LE16(sb.compression),
+		LE16(sb.block_log), LE16(sb.flags));
+
+	if (LE16(sb.s_major) != SQUASHFS_MAJOR) {
+		dprintf(INFO, "squashfs: Unsupported version %u.%u\n",
+			LE16(sb.s_major), LE16(sb.s_minor));
+		return ERR_NOT_SUPPORTED;
+	}
+	if (LE16(sb.block_log) < SQUASHFS_MIN_BLOCK_LOG ||
+	    LE16(sb.block_log) > SQUASHFS_MAX_BLOCK_LOG ||
+	    LE32(sb.block_size) != 1U << LE16(sb.block_log)) {
+		dprintf(INFO, "squashfs: Invalid block size %u\n", LE32(sb.block_size));
+		return ERR_NOT_VALID;
+	}
+
+	sqfs = calloc(1, sizeof(*sqfs));
+	if (!sqfs)
+		return ERR_NO_MEMORY;
+
+	sqfs->dev = dev;
+	sqfs->block_log = LE16(sb.block_log);
+	sqfs->fragments = LE32(sb.fragments);
+	sqfs->bytes_used = LE64(sb.bytes_used);
+	sqfs->inode_table = LE64(sb.inode_table_start);
+	sqfs->dir_table = LE64(sb.directory_table_start);
+	sqfs->fragment_table = LE64(sb.fragment_table_start);
+
+	/* The compressor options only matter for compression */
+	switch (LE16(sb.compression)) {
+	case SQUASHFS_COMP_ZLIB:
+		if (inflateInit(&sqfs->zstream) != Z_OK) {
+			free(sqfs);
+			return ERR_NO_MEMORY;
+		}
+		sqfs->decompress = squashfs_zlib;
+		break;
+	case SQUASHFS_COMP_LZ4:
+		sqfs->decompress = squashfs_lz4;
+		break;
+	case SQUASHFS_COMP_ZSTD:
+		sqfs->decompress = squashfs_zstd;
+		break;
+	default:
+		dprintf(INFO, "squashfs: Unsupported compression %u\n", LE16(sb.compression));
+		free(sqfs);
+		return ERR_NOT_SUPPORTED;
+	}
+
+	sqfs->mbuf = malloc(sizeof(uint16_t) + SQUASHFS_METADATA_SIZE);
+	sqfs->cbuf = malloc(SQUASHFS_BLKSIZ(sqfs));
+	if (!sqfs->mbuf || !sqfs->cbuf) {
+		err = ERR_NO_MEMORY;
+		goto err;
+	}
+
+	/* file data is read through a readahead window */
+	sqfs->ra = bio_readahead_create(dev);
+
+	err = squashfs_load_inode(sqfs, LE64(sb.root_inode), &sqfs->root);
+	if (err < 0)
+		goto err_ra;
+
+	if (!SQUASHFS_IS_DIR(&sqfs->root)) {
+		err = ERR_NOT_VALID;
+		goto err_ra;
+	}
+
+	*cookie = (fscookie *)sqfs;
+	return 0;
+
+err_ra:
+	bio_readahead_destroy(sqfs->ra);
+err:
+	squashfs_free(sqfs);
+	return err;
+}
+
+static status_t squashfs_unmount(fscookie *cookie)
+{
+	squashfs_t *sqfs = (squashfs_t *)cookie;
+
+	bio_readahead_destroy(sqfs->ra);
+	squashfs_free(sqfs);
+
+	return 0;
+}
+
+static const struct fs_api squashfs_api = {
+	.probe = squashfs_probe,
+	.mount = squashfs_mount,
+	.unmount = squashfs_unmount,
+	.open = squashfs_open_file,
+	.stat = squashfs_stat_file,
+	.read = squashfs_read_file,
+	.close = squashfs_close_file,
+	.opendir = squashfs_open_directory,
+	.readdir = squashfs_read_directory,
+	.closedir = squashfs_close_directory,
+};
+
+void squashfs_init(void)
+{
+	fs_register_type("squashfs", &squashfs_api);
+}
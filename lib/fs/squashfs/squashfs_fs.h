@@ -0,0 +1,169 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#ifndef __SQUASHFS_FS_H
+#define __SQUASHFS_FS_H
+
+#include <compiler.h>
+#include <stdint.h>
+
+/*
+ * On-disk format of squashfs 4.0, as documented in
+ * Documentation/filesystems/squashfs.rst of Linux and defined in
+ * fs/squashfs/squashfs_fs.h. All fields are little endian.
+ */
+
+#define SQUASHFS_MAGIC			0x73717368
+#define SQUASHFS_MAJOR			4
+
+#define SQUASHFS_METADATA_SIZE		8192
+#define SQUASHFS_MIN_BLOCK_LOG		12
+#define SQUASHFS_MAX_BLOCK_LOG		20
+
+/* metadata blocks start with a 16-bit header: length and this flag */
+#define SQUASHFS_METADATA_UNCOMPRESSED	0x8000
+#define SQUASHFS_METADATA_LEN(hdr)	((hdr) & ~SQUASHFS_METADATA_UNCOMPRESSED)
+
+/* data blocks and fragments: on-disk size with this flag */
+#define SQUASHFS_BLOCK_UNCOMPRESSED	(1 << 24)
+#define SQUASHFS_BLOCK_SIZE(size)	((size) & ~SQUASHFS_BLOCK_UNCOMPRESSED)
+
+#define SQUASHFS_INVALID_FRAG		0xffffffff
+#define SQUASHFS_FRAGMENTS_PER_BLOCK	(SQUASHFS_METADATA_SIZE / sizeof(struct squashfs_fragment_entry))
+
+/* an inode reference is the metadata block (relative to the table) << 16 | offset */
+#define SQUASHFS_REF_BLOCK(ref)		((ref) >> 16)
+#define SQUASHFS_REF_OFFSET(ref)	((ref) & 0xffff)
+
+#define SQUASHFS_COMP_ZLIB		1
+#define SQUASHFS_COMP_LZMA		2
+#define SQUASHFS_COMP_LZO		3
+#define SQUASHFS_COMP_XZ		4
+#define SQUASHFS_COMP_LZ4		5
+#define SQUASHFS_COMP_ZSTD		6
+
+#define SQUASHFS_FLAG_COMP_OPT		0x0400
+
+struct squashfs_super_block {
+	uint32_t s_magic;
+	uint32_t inodes;
+	uint32_t mkfs_time;
+	uint32_t block_size;
+	uint32_t fragments;
+	uint16_t compression;
+	uint16_t block_log;
+	uint16_t flags;
+	uint16_t no_ids;
+	uint16_t s_major;
+	uint16_t s_minor;
+	uint64_t root_inode;
+	uint64_t bytes_used;
+	uint64_t id_table_start;
+	uint64_t xattr_id_table_start;
+	uint64_t inode_table_start;
+	uint64_t directory_table_start;
+	uint64_t fragment_table_start;
+	uint64_t lookup_table_start;
+} __PACKED;
+
+#define SQUASHFS_DIR_TYPE		1
+#define SQUASHFS_REG_TYPE		2
+#define SQUASHFS_SYMLINK_TYPE		3
+#define SQUASHFS_BLKDEV_TYPE		4
+#define SQUASHFS_CHRDEV_TYPE		5
+#define SQUASHFS_FIFO_TYPE		6
+#define SQUASHFS_SOCKET_TYPE		7
+#define SQUASHFS_LDIR_TYPE		8
+#define SQUASHFS_LREG_TYPE		9
+#define SQUASHFS_LSYMLINK_TYPE		10
+
+struct squashfs_base_inode {
+	uint16_t inode_type;
+	uint16_t mode;
+	uint16_t uid;
+	uint16_t guid;
+	uint32_t mtime;
+	uint32_t inode_number;
+} __PACKED;
+
+struct squashfs_dir_inode {
+	struct squashfs_base_inode base;
+	uint32_t start_block;
+	uint32_t nlink;
+	uint16_t file_size;
+	uint16_t offset;
+	uint32_t parent_inode;
+} __PACKED;
+
+/* followed by i_count struct squashfs_dir_index */
+struct squashfs_ldir_inode {
+	struct squashfs_base_inode base;
+	uint32_t nlink;
+	uint32_t file_size;
+	uint32_t start_block;
+	uint32_t parent_inode;
+	uint16_t i_count;
+	uint16_t offset;
+	uint32_t xattr;
+} __PACKED;
+
+/* followed by the size + 1 bytes of the name */
+struct squashfs_dir_index {
+	uint32_t index;
+	uint32_t start_block;
+	uint32_t size;
+} __PACKED;
+
+/* both followed by the list of the on-disk sizes of the data blocks */
+struct squashfs_reg_inode {
+	struct squashfs_base_inode base;
+	uint32_t start_block;
+	uint32_t fragment;
+	uint32_t offset;
+	uint32_t file_size;
+} __PACKED;
+
+struct squashfs_lreg_inode {
+	struct squashfs_base_inode base;
+	uint64_t start_block;
+	uint64_t file_size;
+	uint64_t sparse;
+	uint32_t nlink;
+	uint32_t fragment;
+	uint32_t offset;
+	uint32_t xattr;
+} __PACKED;
+
+/* followed by the target */
+struct squashfs_symlink_inode {
+	struct squashfs_base_inode base;
+	uint32_t nlink;
+	uint32_t symlink_size;
+} __PACKED;
+
+/*
+ * A directory is a list of headers, each followed by count + 1 entries
+ * that all have their inode in the same metadata block.
+ */
+struct squashfs_dir_header {
+	uint32_t count;
+	uint32_t start_block;
+	uint32_t inode_number;
+} __PACKED;
+
+/* followed by the size + 1 bytes of the name */
+struct squashfs_dir_entry {
+	uint16_t offset;
+	int16_t inode_number;
+	uint16_t type;
+	uint16_t size;
+} __PACKED;
+
+#define SQUASHFS_DIR_COUNT		256
+#define SQUASHFS_NAME_LEN		256
+
+struct squashfs_fragment_entry {
+	uint64_t start_block;
+	uint32_t size;
+	uint32_t unused;
+} __PACKED;
+
+#endif
@@ -0,0 +1,128 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#ifndef __SQUASHFS_PRIV_H
+#define __SQUASHFS_PRIV_H
+
+#include <lib/bio.h>
+#include <lib/fs.h>
+#include <zlib.h>
+#include "squashfs_fs.h"
+
+/* position in a metadata table: the block on the device and the offset in its data */
+struct squashfs_meta_pos {
+	off_t block;
+	unsigned int offset;
+};
+
+struct squashfs_inode {
+	uint16_t type;
+	off_t size;
+
+	/* regular files */
+	off_t start_block;
+	uint32_t fragment;
+	uint32_t frag_offset;
+
+	/* directories */
+	uint32_t dir_block;
+	uint16_t dir_offset;
+	uint16_t i_count;
+
+	/* what follows the inode: block list, directory index or symlink target */
+	struct squashfs_meta_pos next;
+};
+
+#define SQUASHFS_IS_DIR(inode) \
+	((inode)->type == SQUASHFS_DIR_TYPE || (inode)->type == SQUASHFS_LDIR_TYPE)
+#define SQUASHFS_IS_REG(inode) \
+	((inode)->type == SQUASHFS_REG_TYPE || (inode)->type == SQUASHFS_LREG_TYPE)
+#define SQUASHFS_IS_SYMLINK(inode) \
+	((inode)->type == SQUASHFS_SYMLINK_TYPE || (inode)->type == SQUASHFS_LSYMLINK_TYPE)
+
+/* a decompressed metadata block */
+struct squashfs_meta_entry {
+	off_t block;		/* position on the device */
+	off_t next;		/* position of the following block */
+	unsigned int len;	/* 0 if unused */
+	unsigned int lru;
+	uint8_t data[SQUASHFS_METADATA_SIZE];
+};
+
+/* a decompressed fragment or data block */
+struct squashfs_block_entry {
+	off_t block;
+	size_t len;		/* 0 if unused */
+	unsigned int lru;
+	uint8_t *data;
+};
+
+typedef struct squashfs {
+	bdev_t *dev;
+	struct bio_readahead *ra;
+
+	uint16_t block_log;
+	uint32_t fragments;
+	off_t bytes_used;
+	off_t inode_table;
+	off_t dir_table;
+	off_t fragment_table;
+
+	ssize_t (*decompress)(struct squashfs *sqfs, const void *src, size_t src_len,
+			      void *dst, size_t dst_len);
+	z_stream zstream;
+
+	uint8_t *mbuf;		/* one compressed metadata block with its header */
+	uint8_t *cbuf;		/* one compressed data block */
+
+	unsigned int lru;
+	struct squashfs_meta_entry meta[SQUASHFS_META_CACHE];
+	struct squashfs_block_entry blocks[SQUASHFS_BLOCK_CACHE];
+
+	struct squashfs_inode root;
+} squashfs_t;
+
+#define SQUASHFS_BLKSIZ(sqfs)	(1U << (sqfs)->block_log)
+
+/* open file handle */
+typedef struct {
+	squashfs_t *sqfs;
+	struct squashfs_inode inode;
+
+	/* data blocks, the tail is in a fragment unless it is SQUASHFS_INVALID_FRAG */
+	unsigned int nblocks;
+	uint32_t *sizes;	/* on-disk size of each block */
+	off_t frag_block;
+	uint32_t frag_size;
+
+	/* position of data block cur_idx, for sequential reads */
+	unsigned int cur_idx;
+	off_t cur_pos;
+} squashfs_file_t;
+
+typedef struct {
+	squashfs_t *sqfs;
+	struct squashfs_meta_pos pos;
+	off_t left;		/* bytes of the listing left */
+	unsigned int count;	/* entries left after the current header */
+} squashfs_dir_t;
+
+/* io and caches */
+int squashfs_read_meta(squashfs_t *sqfs, struct squashfs_meta_pos *pos, void *buf, size_t len);
+int squashfs_read_data(squashfs_t *sqfs, void *buf, off_t offset, size_t len);
+ssize_t squashfs_read_block(squashfs_t *sqfs, off_t block, uint32_t size, void *dst, size_t dst_len);
+ssize_t squashfs_get_block(squashfs_t *sqfs, off_t block, uint32_t size, const uint8_t **data);
+
+/* inodes and directories */
+int squashfs_load_inode(squashfs_t *sqfs, uint64_t ref, struct squashfs_inode *inode);
+int squashfs_lookup(squashfs_t *sqfs, const char *path, struct squashfs_inode *inode);
+
+/* fs api */
+status_t squashfs_open_file(fscookie *cookie, const char *path, filecookie **fcookie);
+ssize_t squashfs_read_file(filecookie *fcookie, void *buf, off_t offset, size_t len);
+status_t squashfs_close_file(filecookie *fcookie);
+status_t squashfs_stat_file(filecookie *fcookie, struct file_stat *);
+
+status_t squashfs_open_directory(fscookie *cookie, const char *path, dircookie **dcookie);
+status_t squashfs_read_directory(dircookie *dcookie, struct dirent *ent);
+status_t squashfs_close_directory(dircookie *dcookie);
+
+#endif
@@ -138,110 +138,6 @@ static void putpixel32(gfx_surface *surface, uint x, uint y, uint color)
 	*dest = color;
 }
 
-static void copyrect16(gfx_surface *surface, uint x, uint y, uint width, uint height, uint x2, uint y2)
-{
-	// copy
-	const uint16_t *src = &((const uint16_t *)surface->ptr)[x + y * surface->stride];
-	uint16_t *dest = &((uint16_t *)surface->ptr)[x2 + y2 * surface->stride];
-	uint stride_diff = surface->stride - width;
-
-	if (dest < src) {
-		uint i, j;
-		for (i=0; i < height; i++) {
-			for (j=0; j < width; j++) {
-				*dest = *src;
-				dest++;
-				src++;
-			}
-			dest += stride_diff;
-			src += stride_diff;
-		}
-	} else {
-		// copy backwards
-		src += height * surface->stride + width;
-		dest += height * surface->stride + width;
-
-		uint i, j;
-		for (i=0; i < height; i++) {
-			for (j=0; j < width; j++) {
-				*dest = *src;
-				dest--;
-				src--;
-			}
-			dest -= stride_diff;
-			src -= stride_diff;
-		}
-	}
-}
-
-static void fillrect16(gfx_surface *surface, uint x, uint y, uint width, uint height, uint color)
-{
-	uint16_t *dest = &((uint16_t *)surface->ptr)[x + y * surface->stride];
-	uint stride_diff = surface->stride - width;
-
-	uint16_t color16 = ARGB8888_to_RGB565(color);
-	
-	uint i, j;
-	for (i=0; i < height; i++) {
-		for (j=0; j < width; j++) {
-			*dest = color16;
-			dest++;
-		}
-		dest += stride_diff;
-	}
-}
-
-static void copyrect32(gfx_surface *surface, uint x, uint y, uint width, uint height, uint x2, uint y2)
-{
-	// copy
-	const uint32_t *src = &((const uint32_t *)surface->ptr)[x + y * surface->stride];
-	uint32_t *dest = &((uint32_t *)surface->ptr)[x2 + y2 * surface->stride];
-	uint stride_diff = surface->stride - width;
-
-	if (dest < src) {
-		uint i, j;
-		for (i=0; i < height; i++) {
-			for (j=0; j < width; j++) {
-				*dest = *src;
-				dest++;
-				src++;
-			}
-			dest += stride_diff;
-			src += stride_diff;
-		}
-	} else {
-		// copy backwards
-		src += height * surface->stride + width;
-		dest += height * surface->stride + width;
-
-		uint i, j;
-		for (i=0; i < height; i++) {
-			for (j=0; j < width; j++) {
-				*dest = *src;
-				dest--;
-				src--;
-			}
-			dest -= stride_diff;
-			src -= stride_diff;
-		}
-	}
-}
-
-static void fillrect32(gfx_surface *surface, uint x, uint y, uint width, uint height, uint color)
-{
-	uint32_t *dest = &((uint32_t *)surface->ptr)[x + y * surface->stride];
-	uint stride_diff = surface->stride - width;
-	
-	uint i, j;
-	for (i=0; i < height; i++) {
-		for (j=0; j < width; j++) {
-			*dest = color;
-			dest++;
-		}
-		dest += stride_diff;
-	}
-}
-
 uint32_t alpha32_add_ignore_destalpha(uint32_t dest, uint32_t src)
 {
 	uint32_t cdest[3];
@@ -279,14 +175,155 @@ uint32_t alpha32_add_ignore_destalpha(uint32_t dest, uint32_t src)
 	return (srca << 24) | (cres[0] << 16) | (cres[1] << 8) | (cres[2]);
 }
 
+#if ARM_WITH_NEON
+void gfx_fill16_neon(uint16_t *dest, uint16_t color, uint count);
+void gfx_fill32_neon(uint32_t *dest, uint32_t color, uint count);
+void gfx_copy_neon(void *dest, const void *src, size_t len);
+void gfx_argb8888_to_rgb565_neon(uint16_t *dest, const uint32_t *src, uint count);
+void gfx_blend32_neon(uint32_t *dest, const uint32_t *src, uint count);
+#endif
+
+// row kernels, the NEON versions do the bulk and leave the rest of the row
+static void fill_row16(uint16_t *dest, uint16_t color, uint count)
+{
+#if ARM_WITH_NEON
+	uint n = count & ~15;
+
+	if (n) {
+		gfx_fill16_neon(dest, color, n);
+		dest += n;
+		count -= n;
+	}
+#endif
+	while (count--)
+		*dest++ = color;
+}
+
+static void fill_row32(uint32_t *dest, uint32_t color, uint count)
+{
+#if ARM_WITH_NEON
+	uint n = count & ~7;
+
+	if (n) {
+		gfx_fill32_neon(dest, color, n);
+		dest += n;
+		count -= n;
+	}
+#endif
+	while (count--)
+		*dest++ = color;
+}
+
+static void copy_row(void *dest, const void *src, size_t len)
+{
+#if ARM_WITH_NEON
+	size_t n = len & ~63;
+
+	// a forward copy would overwrite the source if dest is after it
+	if (n && !(dest > src && dest < src + len)) {
+		gfx_copy_neon(dest, src, n);
+		dest += n;
+		src += n;
+		len -= n;
+	}
+#endif
+	memmove(dest, src, len);
+}
+
+static void argb8888_to_rgb565_row(uint16_t *dest, const uint32_t *src, uint count)
+{
+#if ARM_WITH_NEON
+	uint n = count & ~7;
+
+	if (n) {
+		gfx_argb8888_to_rgb565_neon(dest, src, n);
+		dest += n;
+		src += n;
+		count -= n;
+	}
+#endif
+	while (count--)
+		*dest++ = ARGB8888_to_RGB565(*src++);
+}
+
+static void blend_row32(uint32_t *dest, const uint32_t *src, uint count)
+{
+#if ARM_WITH_NEON
+	uint n = count & ~7;
+
+	if (n) {
+		gfx_blend32_neon(dest, src, n);
+		dest += n;
+		src += n;
+		count -= n;
+	}
+#endif
+	while (count--) {
+		// XXX ignores destination alpha
+		*dest = alpha32_add_ignore_destalpha(*dest, *src);
+		dest++;
+		src++;
+	}
+}
+
+static void copyrect(gfx_surface *surface, uint x, uint y, uint width, uint height, uint x2, uint y2)
+{
+	size_t row = surface->stride * surface->pixelsize;
+	size_t len = width * surface->pixelsize;
+	const uint8_t *src = (const uint8_t *)surface->ptr + y * row + x * surface->pixelsize;
+	uint8_t *dest = (uint8_t *)surface->ptr + y2 * row + x2 * surface->pixelsize;
+	uint i;
+
+	if (dest <= src) {
+		for (i=0; i < height; i++) {
+			copy_row(dest, src, len);
+			dest += row;
+			src += row;
+		}
+	} else {
+		// copy backwards, starting with the last row
+		src += (height - 1) * row;
+		dest += (height - 1) * row;
+		for (i=0; i < height; i++) {
+			copy_row(dest, src, len);
+			dest -= row;
+			src -= row;
+		}
+	}
+}
+
+static void fillrect16(gfx_surface *surface, uint x, uint y, uint width, uint height, uint color)
+{
+	uint16_t *dest = &((uint16_t *)surface->ptr)[x + y * surface->stride];
+	uint16_t color16 = ARGB8888_to_RGB565(color);
+
+	uint i;
+	for (i=0; i < height; i++) {
+		fill_row16(dest, color16, width);
+		dest += surface->stride;
+	}
+}
+
+static void fillrect32(gfx_surface *surface, uint x, uint y, uint width, uint height, uint color)
+{
+	uint32_t *dest = &((uint32_t *)surface->ptr)[x + y * surface->stride];
+
+	uint i;
+	for (i=0; i < height; i++) {
+		fill_row32(dest, color, width);
+		dest += surface->stride;
+	}
+}
+
 /**
  * @brief  Copy pixels from source to dest.
  *
- * Currently does not support alpha channel.
+ * ARGB 8888 sources are alpha blended, ignoring the destination alpha.
+ * 32 bit sources can also be converted to an RGB 565 dest.
  */
 void gfx_surface_blend(struct gfx_surface *target, struct gfx_surface *source, uint destx, uint desty)
 {
-	DEBUG_ASSERT(target->format == source->format);
+	DEBUG_ASSERT(target->format == source->format || target->format == GFX_FORMAT_RGB_565);
 
 	LTRACEF("target %p, source %p, destx %u, desty %u\n", target, source, destx, desty);
 
@@ -308,59 +345,53 @@ void gfx_surface_blend(struct gfx_surface *target, struct gfx_surface *source, u
 		// 16 bit to 16 bit
 		const uint16_t *src = (const uint16_t *)source->ptr;
 		uint16_t *dest = &((uint16_t *)target->ptr)[destx + desty * target->stride];
-		uint dest_stride_diff = target->stride - width;
-		uint source_stride_diff = source->stride - width;
 
-		LTRACEF("w %u h %u dstride %u sstride %u\n", width, height, dest_stride_diff, source_stride_diff);
+		LTRACEF("w %u h %u dstride %u sstride %u\n", width, height, target->stride, source->stride);
 
-		uint i, j;
+		uint i;
 		for (i=0; i < height; i++) {
-			for (j=0; j < width; j++) {
-				*dest = *src;
-				dest++;
-				src++;
-			}
-			dest += dest_stride_diff;
-			src += source_stride_diff;
+			copy_row(dest, src, width * sizeof(*dest));
+			dest += target->stride;
+			src += source->stride;
 		}
 	} else if (source->format == GFX_FORMAT_ARGB_8888 && target->format == GFX_FORMAT_ARGB_8888) {
 		// both are 32 bit modes, both alpha
 		const uint32_t *src = (const uint32_t *)source->ptr;
 		uint32_t *dest = &((uint32_t *)target->ptr)[destx + desty * target->stride];
-		uint dest_stride_diff = target->stride - width;
-		uint source_stride_diff = source->stride - width;
 
-		LTRACEF("w %u h %u dstride %u sstride %u\n", width, height, dest_stride_diff, source_stride_diff);
+		LTRACEF("w %u h %u dstride %u sstride %u\n", width, height, target->stride, source->stride);
 
-		uint i, j;
+		uint i;
 		for (i=0; i < height; i++) {
-			for (j=0; j < width; j++) {
-				// XXX ignores destination alpha
-				*dest = alpha32_add_ignore_destalpha(*dest, *src);
-				dest++;
-				src++;
-			}
-			dest += dest_stride_diff;
-			src += source_stride_diff;
+			blend_row32(dest, src, width);
+			dest += target->stride;
+			src += source->stride;
 		}
 	} else if (source->format == GFX_FORMAT_RGB_x888 && target->format == GFX_FORMAT_RGB_x888) {
 		// both are 32 bit modes, no alpha
 		const uint32_t *src = (const uint32_t *)source->ptr;
 		uint32_t *dest = &((uint32_t *)target->ptr)[destx + desty * target->stride];
-		uint dest_stride_diff = target->stride - width;
-		uint source_stride_diff = source->stride - width;
 
-		LTRACEF("w %u h %u dstride %u sstride %u\n", width, height, dest_stride_diff, source_stride_diff);
+		LTRACEF("w %u h %u dstride %u sstride %u\n", width, height, target->stride, source->stride);
 
-		uint i, j;
+		uint i;
 		for (i=0; i < height; i++) {
-			for (j=0; j < width; j++) {
-				*dest = *src;
-				dest++;
-				src++;
-			}
-			dest += dest_stride_diff;
-			src += source_stride_diff;
+			copy_row(dest, src, width * sizeof(*dest));
+			dest += target->stride;
+			src += source->stride;
+		}
+	} else if (source->pixelsize == 4 && target->format == GFX_FORMAT_RGB_565) {
+		// 32 bit to 16 bit, alpha is ignored
+		const uint32_t *src = (const uint32_t *)source->ptr;
+		uint16_t *dest = &((uint16_t *)target->ptr)[destx + desty * target->stride];
+
+		LTRACEF("w %u h %u dstride %u sstride %u\n", width, height, target->stride, source->stride);
+
+		uint i;
+		for (i=0; i < height; i++) {
+			argb8888_to_rgb565_row(dest, src, width);
+			dest += target->stride;
+			src += source->stride;
 		}
 	} else {
 		panic("gfx_surface_blend: unimplemented colorspace combination (source %d target %d)\n", source->format, target->format);
@@ -424,7 +455,7 @@ gfx_surface *gfx_create_surface(void *ptr, uint width, uint height, uint stride,
 	// set up some function pointers
 	switch (format) {
 		case GFX_FORMAT_RGB_565:
-			surface->copyrect = &copyrect16;
+			surface->copyrect = &copyrect;
 			surface->fillrect = &fillrect16;
 			surface->putpixel = &putpixel16;
 			surface->pixelsize = 2;
@@ -432,7 +463,7 @@ gfx_surface *gfx_create_surface(void *ptr, uint width, uint height, uint stride,
 			break;
 		case GFX_FORMAT_RGB_x888:
 		case GFX_FORMAT_ARGB_8888:
-			surface->copyrect = &copyrect32;
+			surface->copyrect = &copyrect;
 			surface->fillrect = &fillrect32;
 			surface->putpixel = &putpixel32;
 			surface->pixelsize = 4;
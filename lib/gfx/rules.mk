@@ -1,4 +1,5 @@
 LOCAL_DIR := $(GET_LOCAL_DIR)
 
 OBJS += \
-	$(LOCAL_DIR)/gfx.o
+	$(LOCAL_DIR)/gfx.o \
+	$(if $(filter ARM_WITH_NEON=1, $(DEFINES)), $(LOCAL_DIR)/gfx-neon.o)
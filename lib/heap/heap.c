@@ -28,6 +28,7 @@
 #include <string.h>
 #include <kernel/thread.h>
 #include <lib/heap.h>
+#include <platform.h>
 
 #define LOCAL_TRACE 0
 
@@ -63,10 +64,47 @@ struct free_heap_chunk {
 	size_t len;
 };
 
+/*
+ * Small allocations are served from per size class caches of freed chunks
+ * in front of the free list, so that they do not need to walk and split it.
+ * The sizes are those of whole chunks, including the allocation header.
+ */
+static const size_t heap_class_size[] = {
+	32, 48, 64, 96, 128, 192, 256, 384, 512,
+};
+#define HEAP_NUM_CLASSES (sizeof(heap_class_size) / sizeof(heap_class_size[0]))
+
+// maximum number of free chunks kept in each size class
+#define HEAP_CLASS_MAX_FREE 8
+
+struct heap_class {
+	struct list_node free_list;
+	unsigned int free_count;
+	unsigned int hits;
+};
+
+/*
+ * When the heap runs out it is grown by regions from heap_get_region(), e.g.
+ * from memory set aside by the platform. They are given back with
+ * heap_release_regions() once nothing is allocated from them anymore.
+ */
+#define HEAP_MAX_REGIONS 8
+#define HEAP_GROW_SIZE (1024 * 1024)
+
+struct heap_region {
+	void *base;
+	size_t len;
+};
+
 struct heap {
 	void *base;
 	size_t len;
+	struct heap_region regions[HEAP_MAX_REGIONS];
+	uint region_count;
 	struct list_node free_list;
+	struct heap_class classes[HEAP_NUM_CLASSES];
+	size_t used;
+	size_t peak_used;
 };
 
 // heap static vars
@@ -81,8 +119,127 @@ struct alloc_struct_begin {
 	void *padding_start;
 	size_t padding_size;
 #endif
+#if HEAP_PROFILE
+	struct list_node node;	// in heap_live_list
+	void *caller;
+	time_t time;
+#endif
 };
 
+#if HEAP_PROFILE
+/*
+ * Allocation profiling: every allocation records the return address of the
+ * caller and when it was made, and is kept in a list until it is freed. The
+ * usage is also summed up per call site in a small hash table, so the peak
+ * of each site is known even after its allocations were freed.
+ */
+#define HEAP_PROFILE_SITES 256
+
+static struct heap_site heap_sites[HEAP_PROFILE_SITES];
+static struct heap_site heap_site_other;
+static struct list_node heap_live_list = LIST_INITIAL_VALUE(heap_live_list);
+
+static struct heap_site *heap_get_site(void *caller)
+{
+	uint i, idx = ((addr_t)caller >> 2) % HEAP_PROFILE_SITES;
+
+	for (i = 0; i < HEAP_PROFILE_SITES; i++) {
+		struct heap_site *site = &heap_sites[idx];
+
+		if (site->caller == caller)
+			return site;
+		if (!site->caller) {
+			site->caller = caller;
+			return site;
+		}
+		idx = (idx + 1) % HEAP_PROFILE_SITES;
+	}
+	return &heap_site_other;
+}
+
+// must be called in a critical section
+static void heap_profile_alloc(struct alloc_struct_begin *as, void *caller)
+{
+	struct heap_site *site = heap_get_site(caller);
+
+	as->caller = caller;
+	as->time = current_time();
+	list_add_tail(&heap_live_list, &as->node);
+
+	site->used += as->size;
+	site->allocs++;
+	site->live++;
+	if (site->used > site->peak_used) {
+		site->peak_used = site->used;
+		site->peak_time = as->time;
+	}
+}
+
+// must be called in a critical section
+static void heap_profile_free(struct alloc_struct_begin *as)
+{
+	struct heap_site *site = heap_get_site(as->caller);
+
+	list_delete(&as->node);
+	site->used -= as->size;
+	site->live--;
+}
+
+unsigned int heap_get_sites(struct heap_site *sites, unsigned int count)
+{
+	struct heap_site *site;
+	uint i, j, n = 0;
+
+	enter_critical_section();
+	for (i = 0; i <= HEAP_PROFILE_SITES; i++) {
+		site = i < HEAP_PROFILE_SITES ? &heap_sites[i] : &heap_site_other;
+		if (!site->allocs)
+			continue;
+
+		// insert sorted by the peak usage, the smallest one falls off the end
+		for (j = n; j > 0 && sites[j - 1].peak_used < site->peak_used; j--) {
+			if (j < count)
+				sites[j] = sites[j - 1];
+		}
+		if (j < count) {
+			sites[j] = *site;
+			if (n < count)
+				n++;
+		}
+	}
+	exit_critical_section();
+
+	return n;
+}
+
+static void heap_dump_sites(void)
+{
+	struct heap_site sites[32];
+	uint i, n;
+
+	n = heap_get_sites(sites, countof(sites));
+	dprintf(INFO, "Heap call sites by peak usage:\n");
+	for (i = 0; i < n; i++) {
+		dprintf(INFO, "\t%p: used 0x%zx, peak 0x%zx at %lu ms, %u allocs, %u live\n",
+				sites[i].caller, sites[i].used, sites[i].peak_used,
+				sites[i].peak_time, sites[i].allocs, sites[i].live);
+	}
+}
+
+static void heap_dump_allocs(void)
+{
+	struct alloc_struct_begin *as;
+
+	dprintf(INFO, "Heap allocations:\n");
+	enter_critical_section();
+	list_for_every_entry(&heap_live_list, as, struct alloc_struct_begin, node) {
+		dprintf(INFO, "\t%p: size 0x%zx, caller %p, at %lu ms\n",
+				as + 1, as->size, as->caller, as->time);
+	}
+	exit_critical_section();
+}
+#endif
+
 static void dump_free_chunk(struct free_heap_chunk *chunk)
 {
 	dprintf(INFO, "\t\tbase %p, end 0x%lx, len 0x%zx\n", chunk, (vaddr_t)chunk + chunk->len, chunk->len);
@@ -90,8 +247,26 @@ static void dump_free_chunk(struct free_heap_chunk *chunk)
 
 static void heap_dump(void)
 {
+	struct heap_stats stats;
+	uint i;
+
+	heap_get_stats(&stats);
+
 	dprintf(INFO, "Heap dump:\n");
 	dprintf(INFO, "\tbase %p, len 0x%zx\n", theheap.base, theheap.len);
+	for (i = 0; i < theheap.region_count; i++) {
+		dprintf(INFO, "\tregion %p, len 0x%zx\n", theheap.regions[i].base,
+				theheap.regions[i].len);
+	}
+	dprintf(INFO, "\tused 0x%zx, peak 0x%zx, free 0x%zx in %u chunks, cached 0x%zx\n",
+			stats.used, stats.peak_used, stats.free, stats.free_chunks, stats.cached);
+	dprintf(INFO, "\tlargest free chunk 0x%zx, fragmentation %u%%\n",
+			stats.largest_free, stats.fragmentation);
+	dprintf(INFO, "\tsize classes:\n");
+	for (i = 0; i < HEAP_NUM_CLASSES; i++) {
+		dprintf(INFO, "\t\tsize %zu, %u free, %u hits\n", heap_class_size[i],
+				theheap.classes[i].free_count, theheap.classes[i].hits);
+	}
 	dprintf(INFO, "\tfree list:\n");
 
 	struct free_heap_chunk *chunk;
@@ -224,9 +399,171 @@ struct free_heap_chunk *heap_create_free_chunk(void *ptr, size_t len)
 	return chunk;
 }
 
+// returns the index of the smallest size class for a chunk of this size, or -1
+static int heap_size_class(size_t size)
+{
+	uint i;
+
+	for (i = 0; i < HEAP_NUM_CLASSES; i++) {
+		if (heap_class_size[i] >= size)
+			return i;
+	}
+	return -1;
+}
+
+// take a chunk of at least size bytes from the free list, must be called in a critical section
+static struct free_heap_chunk *heap_alloc_chunk(size_t size)
+{
+	struct free_heap_chunk *chunk;
+	list_for_every_entry(&theheap.free_list, chunk, struct free_heap_chunk, node) {
+		DEBUG_ASSERT((chunk->len % sizeof(void *)) == 0); // len should always be a multiple of pointer size
+
+		// is it big enough to service our allocation?
+		if (chunk->len >= size) {
+			// remove it from the list
+			struct list_node *next_node = list_next(&theheap.free_list, &chunk->node);
+			list_delete(&chunk->node);
+
+			if (chunk->len > size + sizeof(struct free_heap_chunk)) {
+				// there's enough space in this chunk to create a new one after the allocation
+				struct free_heap_chunk *newchunk = heap_create_free_chunk((uint8_t *)chunk + size, chunk->len - size);
+
+				// truncate this chunk
+				chunk->len -= chunk->len - size;
+
+				// add the new one where chunk used to be
+				if (next_node)
+					list_add_before(next_node, &newchunk->node);
+				else
+					list_add_tail(&theheap.free_list, &newchunk->node);
+			}
+
+			// the allocated size is actually the length of this chunk, not the size requested
+			DEBUG_ASSERT(chunk->len >= size);
+			return chunk;
+		}
+	}
+
+	return NULL;
+}
+
+// give all cached chunks back to the free list, so that they can be merged
+static void heap_flush_classes(void)
+{
+	struct free_heap_chunk *chunk;
+	uint i;
+
+	for (i = 0; i < HEAP_NUM_CLASSES; i++) {
+		while ((chunk = list_remove_head_type(&theheap.classes[i].free_list,
+						struct free_heap_chunk, node))) {
+			heap_insert_free_chunk(chunk);
+		}
+		theheap.classes[i].free_count = 0;
+	}
+}
+
+__WEAK void *heap_get_region(size_t *len)
+{
+	return NULL;
+}
+
+__WEAK void heap_put_region(void *base, size_t len)
+{
+}
+
+// add a new region for at least size bytes to the free list, must be called in a critical section
+static bool heap_grow(size_t size)
+{
+	struct heap_region *region;
+	size_t len;
+	void *base;
+
+	if (theheap.region_count == HEAP_MAX_REGIONS)
+		return false;
+
+	len = ROUNDUP(size, HEAP_GROW_SIZE);
+	if (len < size)
+		return false;
+
+	base = heap_get_region(&len);
+	if (!base)
+		return false;
+
+	LTRACEF("base %p, len 0x%zx\n", base, len);
+
+	region = &theheap.regions[theheap.region_count++];
+	region->base = base;
+	region->len = len;
+	theheap.len += len;
+
+	heap_insert_free_chunk(heap_create_free_chunk(base, len));
+	return true;
+}
+
+// take a region out of the free list if it is completely free, must be called in a critical section
+static bool heap_remove_region(struct heap_region *region)
+{
+	vaddr_t start = (vaddr_t)region->base;
+	vaddr_t end = start + region->len;
+	struct free_heap_chunk *chunk, *after;
+	vaddr_t chunk_end;
+
+	list_for_every_entry(&theheap.free_list, chunk, struct free_heap_chunk, node) {
+		chunk_end = (vaddr_t)chunk + chunk->len;
+		if ((vaddr_t)chunk > start || chunk_end < end)
+			continue;
+
+		// the chunk may have been merged with the memory around the region
+		if (chunk_end > end) {
+			after = heap_create_free_chunk((void *)end, chunk_end - end);
+			list_add_after(&chunk->node, &after->node);
+		}
+		if ((vaddr_t)chunk < start)
+			chunk->len = start - (vaddr_t)chunk;
+		else
+			list_delete(&chunk->node);
+		return true;
+	}
+
+	return false;
+}
+
+uint heap_release_regions(void)
+{
+	struct heap_region *region;
+	uint i;
+
+	enter_critical_section();
+
+	heap_flush_classes();
+	for (i = theheap.region_count; i-- > 0; ) {
+		region = &theheap.regions[i];
+		if (!heap_remove_region(region))
+			continue;
+
+		LTRACEF("base %p, len 0x%zx\n", region->base, region->len);
+		heap_put_region(region->base, region->len);
+
+		theheap.len -= region->len;
+		theheap.region_count--;
+		memmove(region, region + 1, (theheap.region_count - i) * sizeof(*region));
+	}
+	i = theheap.region_count;
+
+	exit_critical_section();
+
+	return i;
+}
+
 void *heap_alloc(size_t size, unsigned int alignment)
+{
+	return heap_alloc_caller(size, alignment, __builtin_return_address(0));
+}
+
+void *heap_alloc_caller(size_t size, unsigned int alignment, void *caller)
 {
 	void *ptr;
+	int cls = -1;
 #if DEBUG_HEAP
 	size_t original_size = size;
 #endif
@@ -274,69 +611,71 @@ void *heap_alloc(size_t size, unsigned int alignment)
 			return NULL;
 		}
 		size += alignment;
+	} else {
+		// small unaligned allocations are rounded up to their size class
+		cls = heap_size_class(size);
+		if (cls >= 0)
+			size = heap_class_size[cls];
 	}
 
 	// critical section
 	enter_critical_section();
 
-	// walk through the list
-	ptr = NULL;
-	struct free_heap_chunk *chunk;
-	list_for_every_entry(&theheap.free_list, chunk, struct free_heap_chunk, node) {
-		DEBUG_ASSERT((chunk->len % sizeof(void *)) == 0); // len should always be a multiple of pointer size
-
-		// is it big enough to service our allocation?
-		if (chunk->len >= size) {
-			ptr = chunk;
-
-			// remove it from the list
-			struct list_node *next_node = list_next(&theheap.free_list, &chunk->node);
-			list_delete(&chunk->node);
-
-			if (chunk->len > size + sizeof(struct free_heap_chunk)) {
-				// there's enough space in this chunk to create a new one after the allocation
-				struct free_heap_chunk *newchunk = heap_create_free_chunk((uint8_t *)ptr + size, chunk->len - size);
+	struct free_heap_chunk *chunk = NULL;
+	if (cls >= 0) {
+		chunk = list_remove_head_type(&theheap.classes[cls].free_list,
+				struct free_heap_chunk, node);
+		if (chunk) {
+			theheap.classes[cls].free_count--;
+			theheap.classes[cls].hits++;
+		}
+	}
 
-				// truncate this chunk
-				chunk->len -= chunk->len - size;
+	if (!chunk)
+		chunk = heap_alloc_chunk(size);
+	if (!chunk) {
+		// the cached chunks might be enough when merged into the free list
+		heap_flush_classes();
+		chunk = heap_alloc_chunk(size);
+	}
+	if (!chunk && heap_grow(size))
+		chunk = heap_alloc_chunk(size);
 
-				// add the new one where chunk used to be
-				if (next_node)
-					list_add_before(next_node, &newchunk->node);
-				else
-					list_add_tail(&theheap.free_list, &newchunk->node);
-			}
+	ptr = NULL;
+	if (chunk) {
+		ptr = chunk;
+		size = chunk->len;
 
-			// the allocated size is actually the length of this chunk, not the size requested
-			DEBUG_ASSERT(chunk->len >= size);
-			size = chunk->len;
+		theheap.used += size;
+		if (theheap.used > theheap.peak_used)
+			theheap.peak_used = theheap.used;
 
 #if DEBUG_HEAP
-			memset(ptr, ALLOC_FILL, size);
+		memset(ptr, ALLOC_FILL, size);
 #endif
 
-			ptr = (void *)((addr_t)ptr + sizeof(struct alloc_struct_begin));
+		ptr = (void *)((addr_t)ptr + sizeof(struct alloc_struct_begin));
 
-			// align the output if requested
-			if (alignment > 0) {
-				ptr = (void *)ROUNDUP((addr_t)ptr, alignment);
-			}
+		// align the output if requested
+		if (alignment > 0) {
+			ptr = (void *)ROUNDUP((addr_t)ptr, alignment);
+		}
 
-			struct alloc_struct_begin *as = (struct alloc_struct_begin *)ptr;
-			as--;
-			as->magic = HEAP_MAGIC;
-			as->ptr = (void *)chunk;
-			as->size = size;
+		struct alloc_struct_begin *as = (struct alloc_struct_begin *)ptr;
+		as--;
+		as->magic = HEAP_MAGIC;
+		as->ptr = (void *)chunk;
+		as->size = size;
 #if DEBUG_HEAP
-			as->padding_start = ((uint8_t *)ptr + original_size);
-			as->padding_size = (((addr_t)chunk + size) - ((addr_t)ptr + original_size));
-//			printf("padding start %p, size %u, chunk %p, size %u\n", as->padding_start, as->padding_size, chunk, size);
+		as->padding_start = ((uint8_t *)ptr + original_size);
+		as->padding_size = (((addr_t)chunk + size) - ((addr_t)ptr + original_size));
+//		printf("padding start %p, size %u, chunk %p, size %u\n", as->padding_start, as->padding_size, chunk, size);
 
-			memset(as->padding_start, PADDING_FILL, as->padding_size);
+		memset(as->padding_start, PADDING_FILL, as->padding_size);
+#endif
+#if HEAP_PROFILE
+		heap_profile_alloc(as, caller);
 #endif
-
-			break;
-		}
 	}
 
 	LTRACEF("returning ptr %p\n", ptr);
@@ -349,6 +688,11 @@ void *heap_alloc(size_t size, unsigned int alignment)
 }
 
 void *heap_realloc(void *ptr, size_t size)
+{
+	return heap_realloc_caller(ptr, size, __builtin_return_address(0));
+}
+
+void *heap_realloc_caller(void *ptr, size_t size, void *caller)
 {
 	void * tmp_ptr = NULL;
 	size_t min_size;
@@ -356,7 +700,7 @@ void *heap_realloc(void *ptr, size_t size)
 	as--;
 
 	if (size != 0){
-		tmp_ptr = heap_alloc(size, 0);
+		tmp_ptr = heap_alloc_caller(size, 0, caller);
 		if (ptr != NULL && tmp_ptr != NULL){
 			min_size = (size < as->size) ? size : as->size;
 			memcpy(tmp_ptr, ptr, min_size);
@@ -402,7 +746,21 @@ void heap_free(void *ptr)
 
 	// looks good, create a free chunk and add it to the pool
 	enter_critical_section();
-	heap_insert_free_chunk(heap_create_free_chunk(as->ptr, as->size));
+	theheap.used -= as->size;
+#if HEAP_PROFILE
+	heap_profile_free(as);
+#endif
+
+	// chunks of exactly a class size are cached for the next allocation of that size
+	int cls = heap_size_class(as->size);
+	if (cls >= 0 && heap_class_size[cls] == as->size &&
+	    theheap.classes[cls].free_count < HEAP_CLASS_MAX_FREE) {
+		struct free_heap_chunk *chunk = heap_create_free_chunk(as->ptr, as->size);
+		list_add_head(&theheap.classes[cls].free_list, &chunk->node);
+		theheap.classes[cls].free_count++;
+	} else {
+		heap_insert_free_chunk(heap_create_free_chunk(as->ptr, as->size));
+	}
 	exit_critical_section();
 
 //	heap_dump();
@@ -420,6 +778,8 @@ void heap_init(void)
 
 	// initialize the free list
 	list_initialize(&theheap.free_list);
+	for (uint i = 0; i < HEAP_NUM_CLASSES; i++)
+		list_initialize(&theheap.classes[i].free_list);
 
 	// create an initial free chunk
 	heap_insert_free_chunk(heap_create_free_chunk(theheap.base, theheap.len));
@@ -431,6 +791,37 @@ void heap_init(void)
 //	heap_test();
 }
 
+void heap_get_stats(struct heap_stats *stats)
+{
+	struct free_heap_chunk *chunk;
+	uint i;
+
+	memset(stats, 0, sizeof(*stats));
+
+	enter_critical_section();
+
+	stats->size = theheap.len;
+	stats->used = theheap.used;
+	stats->peak_used = theheap.peak_used;
+	stats->regions = theheap.region_count;
+
+	list_for_every_entry(&theheap.free_list, chunk, struct free_heap_chunk, node) {
+		stats->free += chunk->len;
+		stats->free_chunks++;
+		if (chunk->len > stats->largest_free)
+			stats->largest_free = chunk->len;
+	}
+
+	for (i = 0; i < HEAP_NUM_CLASSES; i++)
+		stats->cached += theheap.classes[i].free_count * heap_class_size[i];
+
+	exit_critical_section();
+
+	// share of the free memory that is not usable for the largest allocation
+	if (stats->free)
+		stats->fragmentation = 100 - (uint64_t)stats->largest_free * 100 / stats->free;
+}
+
 #if DEBUGLEVEL > 1
 #if WITH_LIB_CONSOLE
 
@@ -451,6 +842,12 @@ static int cmd_heap(int argc, const cmd_args *argv)
 
 	if (strcmp(argv[1].str, "info") == 0) {
 		heap_dump();
+#if HEAP_PROFILE
+	} else if (strcmp(argv[1].str, "sites") == 0) {
+		heap_dump_sites();
+	} else if (strcmp(argv[1].str, "allocs") == 0) {
+		heap_dump_allocs();
+#endif
 	} else {
 		printf("unrecognized command\n");
 		return -1;
@@ -28,13 +28,13 @@
 
 void *malloc(size_t size)
 {
-	return heap_alloc(size, 0);
+	return heap_alloc_caller(size, 0, __builtin_return_address(0));
 }
 
 void *memalign(size_t boundary, size_t size)
 {
 	void *ptr;
-	ptr = heap_alloc(size, boundary);
+	ptr = heap_alloc_caller(size, boundary, __builtin_return_address(0));
 	/* Clean the cache before giving the memory */
 	arch_clean_invalidate_cache_range((addr_t) ptr, size);
 	return ptr;
@@ -45,7 +45,7 @@ void *calloc(size_t count, size_t size)
 	void *ptr;
 	size_t realsize = count * size;
 
-	ptr = heap_alloc(realsize, 0);
+	ptr = heap_alloc_caller(realsize, 0, __builtin_return_address(0));
 	if (!ptr)
 		return NULL;
 
@@ -60,6 +60,6 @@ void free(void *ptr)
 
 void *realloc(void *ptr, size_t size)
 {
-	return(heap_realloc(ptr, size));
+	return heap_realloc_caller(ptr, size, __builtin_return_address(0));
 }
 
@@ -812,35 +812,48 @@ static int overlay_symbol_update(void *fdt, void *fdto)
 	return 0;
 }
 
-int fdt_overlay_apply(void *fdt, void *fdto)
+static int overlay_apply(void *fdt, void *fdto, uint32_t *max_phandle)
 {
-	uint32_t delta;
+	uint32_t delta = *max_phandle;
 	int ret;
 
-	FDT_RO_PROBE(fdt);
-	FDT_RO_PROBE(fdto);
-
-	ret = fdt_find_max_phandle(fdt, &delta);
-	if (ret)
-		goto err;
-
 	ret = overlay_adjust_local_phandles(fdto, delta);
 	if (ret)
-		goto err;
+		return ret;
 
 	ret = overlay_update_local_references(fdto, delta);
 	if (ret)
-		goto err;
+		return ret;
 
 	ret = overlay_fixup_phandles(fdt, fdto);
 	if (ret)
-		goto err;
+		return ret;
+
+	/*
+	 * The phandles of the overlay are all above the ones of the base
+	 * tree now, so its maximum is the new one after merging.
+	 */
+	ret = fdt_find_max_phandle(fdto, max_phandle);
+	if (ret)
+		return ret;
+	if (*max_phandle < delta)
+		*max_phandle = delta;
 
 	ret = overlay_merge(fdt, fdto);
 	if (ret)
-		goto err;
+		return ret;
 
-	ret = overlay_symbol_update(fdt, fdto);
+	return overlay_symbol_update(fdt, fdto);
+}
+
+int fdt_overlay_apply_max_phandle(void *fdt, void *fdto, uint32_t *max_phandle)
+{
+	int ret;
+
+	FDT_RO_PROBE(fdt);
+	FDT_RO_PROBE(fdto);
+
+	ret = overlay_apply(fdt, fdto, max_phandle);
 	if (ret)
 		goto err;
 
@@ -865,3 +878,21 @@ err:
 
 	return ret;
 }
+
+int fdt_overlay_apply(void *fdt, void *fdto)
+{
+	uint32_t max_phandle;
+	int ret;
+
+	FDT_RO_PROBE(fdt);
+	FDT_RO_PROBE(fdto);
+
+	ret = fdt_find_max_phandle(fdt, &max_phandle);
+	if (ret) {
+		fdt_set_magic(fdto, ~0);
+		fdt_set_magic(fdt, ~0);
+		return ret;
+	}
+
+	return fdt_overlay_apply_max_phandle(fdt, fdto, &max_phandle);
+}
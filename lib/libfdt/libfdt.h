@@ -2123,6 +2123,23 @@ int fdt_del_node(void *fdt, int nodeoffset);
  */
 int fdt_overlay_apply(void *fdt, void *fdto);
 
+/**
+ * fdt_overlay_apply_max_phandle - Applies a DT overlay with a known max phandle
+ * @fdt: pointer to the base device tree blob
+ * @fdto: pointer to the device tree overlay blob
+ * @max_phandle: the highest phandle in the base device tree
+ *
+ * Like fdt_overlay_apply(), but the highest phandle of the base device tree
+ * is passed in instead of being searched for in the whole tree, and it is
+ * updated for the resulting tree. This allows to apply several overlays
+ * with only a single fdt_find_max_phandle() for the base device tree.
+ *
+ * returns:
+ *	0, on success
+ *	Negative error code on error, see fdt_overlay_apply()
+ */
+int fdt_overlay_apply_max_phandle(void *fdt, void *fdto, uint32_t *max_phandle);
+
 /**
  * fdt_overlay_target_offset - retrieves the offset of a fragment's target
  * @fdt: Base device tree blob
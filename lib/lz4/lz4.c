@@ -0,0 +1,657 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <debug.h>
+#include <err.h>
+#include <stdlib.h>
+#include <string.h>
+#include <lib/lz4.h>
+
+/*
+ * lz4.c - Decompressor and simple compressor for LZ4 files.
+ *
+ * Both the frame format written by lz4(1) and the legacy format that is
+ * used by the Linux kernel build (Image.lz4, lz4 -l) are supported. The
+ * whole output is kept in one buffer, so blocks may refer back to any
+ * earlier block and no separate window is needed. Block and content
+ * checksums are not verified, like the CRC of gzip kernels.
+ *
+ * The compressor writes the legacy format, which needs no checksums. It
+ * uses a single hash table lookup per position (like the fast mode of
+ * the reference implementation), which is good enough for logs and
+ * mostly empty memory.
+ */
+
+#define LZ4_FRAME_MAGIC		0x184D2204
+#define LZ4_LEGACY_MAGIC	0x184C2102
+#define LZ4_SKIP_MAGIC		0x184D2A50
+#define LZ4_SKIP_MASK		0xFFFFFFF0
+
+#define LZ4_FLG_VERSION_MASK	0xC0
+#define LZ4_FLG_VERSION		0x40
+#define LZ4_FLG_BLOCK_CHECKSUM	0x10
+#define LZ4_FLG_CONTENT_SIZE	0x08
+#define LZ4_FLG_CONTENT_CHECKSUM 0x04
+#define LZ4_FLG_DICT_ID		0x01
+
+#define LZ4_BLOCK_UNCOMPRESSED	0x80000000
+
+#define LZ4_MIN_MATCH		4
+#define LZ4_LAST_LITERALS	5	/* the last 5 bytes are always literals */
+#define LZ4_MF_LIMIT		12	/* no match starts in the last 12 bytes */
+#define LZ4_MAX_OFFSET		0xFFFF
+#define LZ4_HASH_BITS		12
+#define LZ4_LEGACY_BLOCK_SIZE	(8 * 1024 * 1024)
+
+struct lz4_out {
+	unsigned char *start;
+	unsigned char *pos;
+	unsigned char *end;
+	bool partial;	/* stop once the output is full */
+};
+
+static inline uint32_t lz4_read32(const unsigned char *p)
+{
+	return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+/* Copy literals, or as much of them as fits into the output. */
+static int lz4_copy(struct lz4_out *out, const unsigned char *src, size_t len)
+{
+	size_t room = out->end - out->pos;
+	int ret = 0;
+
+	if (len > room) {
+		len = room;
+		ret = ERR_TOO_BIG;
+	}
+
+	memcpy(out->pos, src, len);
+	out->pos += len;
+	return ret;
+}
+
+/* Copy a match that may overlap with the data it is copied to. */
+static int lz4_copy_match(struct lz4_out *out, size_t offset, size_t len)
+{
+	size_t room = out->end - out->pos;
+	const unsigned char *from = out->pos - offset;
+	int ret = 0;
+
+	if (len > room) {
+		len = room;
+		ret = ERR_TOO_BIG;
+	}
+
+	/* Repeat the pattern until whole copies don't overlap anymore */
+	while (offset < len) {
+		memcpy(out->pos, from, offset);
+		out->pos += offset;
+		len -= offset;
+		offset += offset;
+	}
+
+	memcpy(out->pos, from, len);
+	out->pos += len;
+	return ret;
+}
+
+static int lz4_read_length(const unsigned char **src, const unsigned char *end,
+			   size_t *len)
+{
+	const unsigned char *p = *src;
+	unsigned char b;
+
+	do {
+		if (p >= end)
+			return ERR_NOT_VALID;
+		b = *p++;
+		*len += b;
+	} while (b == 255);
+
+	*src = p;
+	return 0;
+}
+
+static int lz4_decompress_block(const unsigned char *src, size_t size,
+				struct lz4_out *out)
+{
+	const unsigned char *end = src + size;
+	size_t len, offset;
+	unsigned char token;
+	int ret;
+
+	while (src < end) {
+		if (out->partial && out->pos == out->end)
+			break;
+
+		token = *src++;
+
+		len = token >> 4;
+		if (len == 15 && lz4_read_length(&src, end, &len))
+			return ERR_NOT_VALID;
+		if (len > (size_t)(end - src))
+			return ERR_NOT_VALID;
+
+		ret = lz4_copy(out, src, len);
+		if (ret)
+			return ret;
+		src += len;
+
+		/* The last sequence has no match */
+		if (src == end || (out->partial && out->pos == out->end))
+			break;
+
+		if (end - src < 2)
+			return ERR_NOT_VALID;
+		offset = src[0] | src[1] << 8;
+		src += 2;
+		if (offset == 0 || offset > (size_t)(out->pos - out->start))
+			return ERR_NOT_VALID;
+
+		len = token & 0xf;
+		if (len == 15 && lz4_read_length(&src, end, &len))
+			return ERR_NOT_VALID;
+		len += LZ4_MIN_MATCH;
+
+		ret = lz4_copy_match(out, offset, len);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+/* Returns the number of bytes used from src or a negative error. */
+static int lz4_decompress_legacy(const unsigned char *src, size_t size,
+				 struct lz4_out *out)
+{
+	const unsigned char *p = src + 4, *end = src + size;
+	uint32_t block;
+	int ret;
+
+	/*
+	 * There is no end mark: the file ends or is followed by something
+	 * that is not a block (e.g. the size appended by the kernel build).
+	 */
+	while (end - p >= 4) {
+		block = lz4_read32(p);
+		if (block == LZ4_LEGACY_MAGIC) {
+			p += 4;
+			continue;
+		}
+		if (block > (size_t)(end - p - 4))
+			break;
+
+		ret = lz4_decompress_block(p + 4, block, out);
+		if (ret)
+			return ret;
+		p += 4 + block;
+	}
+
+	return p - src;
+}
+
+/* Returns the number of bytes used from src or a negative error. */
+static int lz4_decompress_frame(const unsigned char *src, size_t size,
+				struct lz4_out *out)
+{
+	const unsigned char *p = src + 4, *end = src + size;
+	size_t extra = 0;
+	uint32_t block;
+	unsigned char flg;
+	int ret;
+
+	if (end - p < 3)
+		return ERR_NOT_VALID;
+
+	flg = p[0];
+	if ((flg & LZ4_FLG_VERSION_MASK) != LZ4_FLG_VERSION)
+		return ERR_NOT_VALID;
+	if (flg & LZ4_FLG_DICT_ID) {
+		dprintf(INFO, "lz4: Dictionaries are not supported\n");
+		return ERR_NOT_SUPPORTED;
+	}
+	if (flg & LZ4_FLG_BLOCK_CHECKSUM)
+		extra = 4;
+
+	/* FLG, BD, optional content size and header checksum */
+	p += 3;
+	if (flg & LZ4_FLG_CONTENT_SIZE)
+		p += 8;
+
+	for (;;) {
+		if (end - p < 4)
+			return ERR_NOT_VALID;
+		block = lz4_read32(p);
+		p += 4;
+		if (block == 0)
+			break;
+
+		if ((block & ~LZ4_BLOCK_UNCOMPRESSED) + extra > (size_t)(end - p))
+			return ERR_NOT_VALID;
+
+		if (block & LZ4_BLOCK_UNCOMPRESSED) {
+			block &= ~LZ4_BLOCK_UNCOMPRESSED;
+			ret = lz4_copy(out, p, block);
+		} else {
+			ret = lz4_decompress_block(p, block, out);
+		}
+		if (ret)
+			return ret;
+		p += block + extra;
+	}
+
+	if (flg & LZ4_FLG_CONTENT_CHECKSUM)
+		p += 4;
+	if (p > end)
+		return ERR_NOT_VALID;
+
+	return p - src;
+}
+
+bool lz4_is_compressed(const void *buf, size_t len)
+{
+	uint32_t magic;
+
+	if (len < 4)
+		return false;
+
+	magic = lz4_read32(buf);
+	return magic == LZ4_FRAME_MAGIC || magic == LZ4_LEGACY_MAGIC;
+}
+
+int lz4_decompress(const void *src, size_t src_size, void *dst,
+		   size_t dst_size, size_t *out_len)
+{
+	const unsigned char *p = src, *end = p + src_size;
+	struct lz4_out out = {
+		.start = dst,
+		.pos = dst,
+		.end = (unsigned char *)dst + dst_size,
+	};
+	uint32_t magic;
+	int ret;
+
+	if (!lz4_is_compressed(src, src_size))
+		return ERR_NOT_VALID;
+
+	/* Concatenated frames are decompressed one after another */
+	while (end - p >= 4) {
+		magic = lz4_read32(p);
+		if (magic == LZ4_FRAME_MAGIC) {
+			ret = lz4_decompress_frame(p, end - p, &out);
+		} else if (magic == LZ4_LEGACY_MAGIC) {
+			ret = lz4_decompress_legacy(p, end - p, &out);
+		} else if ((magic & LZ4_SKIP_MASK) == LZ4_SKIP_MAGIC) {
+			if (end - p < 8 || lz4_read32(p + 4) > (size_t)(end - p - 8))
+				return ERR_NOT_VALID;
+			ret = 8 + lz4_read32(p + 4);
+		} else {
+			break;
+		}
+
+		*out_len = out.pos - out.start;
+		if (ret < 0)
+			return ret;
+		p += ret;
+	}
+
+	*out_len = out.pos - out.start;
+	return 0;
+}
+
+ssize_t lz4_decompress_raw(const void *src, size_t src_size, void *dst,
+			   size_t dst_size)
+{
+	struct lz4_out out = {
+		.start = dst,
+		.pos = dst,
+		.end = (unsigned char *)dst + dst_size,
+		.partial = true,
+	};
+	int ret;
+
+	ret = lz4_decompress_block(src, src_size, &out);
+	if (ret && ret != ERR_TOO_BIG)
+		return ret;
+
+	return out.pos - out.start;
+}
+
+/*
+ * The stream decoder collects every header and block in the input buffer,
+ * unless a block is contained in one piece of the input. Blocks are
+ * decompressed into the window behind the last 64 KiB of output, which
+ * linked blocks may refer to.
+ */
+#define LZ4_STREAM_IN_SIZE	(LZ4_LEGACY_BLOCK_SIZE + LZ4_LEGACY_BLOCK_SIZE / 255 + 16)
+#define LZ4_HISTORY_SIZE	(LZ4_MAX_OFFSET + 1)
+#define LZ4_STREAM_WIN_SIZE	(LZ4_HISTORY_SIZE + LZ4_LEGACY_BLOCK_SIZE)
+
+enum lz4_stream_state {
+	LZ4_STREAM_MAGIC,
+	LZ4_STREAM_FLG,		/* FLG and BD */
+	LZ4_STREAM_HEADER,	/* optional content size and header checksum */
+	LZ4_STREAM_BLOCK_SIZE,
+	LZ4_STREAM_BLOCK,
+	LZ4_STREAM_CHECKSUM,
+	LZ4_STREAM_LEGACY_SIZE,
+	LZ4_STREAM_LEGACY_BLOCK,
+	LZ4_STREAM_SKIP_SIZE,
+	LZ4_STREAM_SKIP,
+};
+
+void lz4_stream_init(struct lz4_stream *s, void *work, lz4_stream_out out,
+		     void *arg)
+{
+	memset(s, 0, sizeof(*s));
+	s->out = out;
+	s->arg = arg;
+	s->in = work;
+	s->win = s->in + LZ4_STREAM_IN_SIZE;
+	s->state = LZ4_STREAM_MAGIC;
+	s->need = 4;
+}
+
+static void lz4_stream_next(struct lz4_stream *s, int state, size_t need)
+{
+	s->state = state;
+	s->need = need;
+}
+
+/* Decompress a block into the window and pass it on */
+static int lz4_stream_block(struct lz4_stream *s, const unsigned char *src,
+			    size_t size, bool compressed)
+{
+	struct lz4_out out;
+	int ret;
+
+	if (s->win_pos + s->block_max > LZ4_STREAM_WIN_SIZE) {
+		memmove(s->win, s->win + s->win_pos - LZ4_HISTORY_SIZE,
+			LZ4_HISTORY_SIZE);
+		s->win_pos = LZ4_HISTORY_SIZE;
+	}
+
+	out.start = s->win;
+	out.pos = s->win + s->win_pos;
+	out.end = out.pos + s->block_max;
+	out.partial = false;
+
+	if (compressed)
+		ret = lz4_decompress_block(src, size, &out);
+	else
+		ret = lz4_copy(&out, src, size);
+	if (ret)
+		return ERR_NOT_VALID;
+
+	ret = s->out(s->arg, s->win + s->win_pos, out.pos - s->win - s->win_pos);
+	s->win_pos = out.pos - s->win;
+	return ret;
+}
+
+/* Handle the s->need bytes at p that are complete for the current state */
+static int lz4_stream_process(struct lz4_stream *s, const unsigned char *p)
+{
+	uint32_t val = s->need >= 4 ? lz4_read32(p) : 0;
+	size_t size;
+	int ret;
+
+	switch (s->state) {
+	case LZ4_STREAM_MAGIC:
+		if (val == LZ4_FRAME_MAGIC) {
+			lz4_stream_next(s, LZ4_STREAM_FLG, 2);
+		} else if (val == LZ4_LEGACY_MAGIC) {
+			s->block_max = LZ4_LEGACY_BLOCK_SIZE;
+			lz4_stream_next(s, LZ4_STREAM_LEGACY_SIZE, 4);
+		} else if ((val & LZ4_SKIP_MASK) == LZ4_SKIP_MAGIC) {
+			lz4_stream_next(s, LZ4_STREAM_SKIP_SIZE, 4);
+		} else {
+			return ERR_NOT_VALID;
+		}
+		break;
+
+	case LZ4_STREAM_FLG:
+		s->flg = p[0];
+		if ((s->flg & LZ4_FLG_VERSION_MASK) != LZ4_FLG_VERSION)
+			return ERR_NOT_VALID;
+		if (s->flg & LZ4_FLG_DICT_ID) {
+			dprintf(INFO, "lz4: Dictionaries are not supported\n");
+			return ERR_NOT_VALID;
+		}
+		/* Maximum block size: 64 KiB, 256 KiB, 1 MiB or 4 MiB */
+		if (((p[1] >> 4) & 0x7) < 4)
+			return ERR_NOT_VALID;
+		s->block_max = 1 << (2 * ((p[1] >> 4) & 0x7) + 8);
+		lz4_stream_next(s, LZ4_STREAM_HEADER,
+				s->flg & LZ4_FLG_CONTENT_SIZE ? 9 : 1);
+		break;
+
+	case LZ4_STREAM_HEADER:
+		lz4_stream_next(s, LZ4_STREAM_BLOCK_SIZE, 4);
+		break;
+
+	case LZ4_STREAM_BLOCK_SIZE:
+		if (val == 0) {
+			if (s->flg & LZ4_FLG_CONTENT_CHECKSUM)
+				lz4_stream_next(s, LZ4_STREAM_CHECKSUM, 4);
+			else
+				lz4_stream_next(s, LZ4_STREAM_MAGIC, 4);
+			break;
+		}
+
+		size = val & ~LZ4_BLOCK_UNCOMPRESSED;
+		if (size > s->block_max)
+			return ERR_NOT_VALID;
+		s->block = val;
+		lz4_stream_next(s, LZ4_STREAM_BLOCK,
+				size + (s->flg & LZ4_FLG_BLOCK_CHECKSUM ? 4 : 0));
+		break;
+
+	case LZ4_STREAM_BLOCK:
+		ret = lz4_stream_block(s, p, s->block & ~LZ4_BLOCK_UNCOMPRESSED,
+				       !(s->block & LZ4_BLOCK_UNCOMPRESSED));
+		if (ret)
+			return ret;
+		lz4_stream_next(s, LZ4_STREAM_BLOCK_SIZE, 4);
+		break;
+
+	case LZ4_STREAM_CHECKSUM:
+		lz4_stream_next(s, LZ4_STREAM_MAGIC, 4);
+		break;
+
+	case LZ4_STREAM_LEGACY_SIZE:
+		/* Concatenated legacy files repeat the magic */
+		if (val == LZ4_LEGACY_MAGIC)
+			break;
+		if (val == LZ4_FRAME_MAGIC || (val & LZ4_SKIP_MASK) == LZ4_SKIP_MAGIC) {
+			s->state = LZ4_STREAM_MAGIC;
+			return lz4_stream_process(s, p);
+		}
+		if (val == 0 || val > LZ4_STREAM_IN_SIZE)
+			return ERR_NOT_VALID;
+		lz4_stream_next(s, LZ4_STREAM_LEGACY_BLOCK, val);
+		break;
+
+	case LZ4_STREAM_LEGACY_BLOCK:
+		ret = lz4_stream_block(s, p, s->need, true);
+		if (ret)
+			return ret;
+		lz4_stream_next(s, LZ4_STREAM_LEGACY_SIZE, 4);
+		break;
+
+	case LZ4_STREAM_SKIP_SIZE:
+		s->skip = val;
+		lz4_stream_next(s, val ? LZ4_STREAM_SKIP : LZ4_STREAM_MAGIC,
+				val ? 0 : 4);
+		break;
+	}
+
+	return 0;
+}
+
+int lz4_stream_write(struct lz4_stream *s, const void *buf, size_t len)
+{
+	const unsigned char *p = buf;
+	size_t n;
+	int ret;
+
+	while (len) {
+		if (s->state == LZ4_STREAM_SKIP) {
+			n = MIN(len, s->skip);
+			s->skip -= n;
+			if (!s->skip)
+				lz4_stream_next(s, LZ4_STREAM_MAGIC, 4);
+		} else if (!s->in_len && len >= s->need) {
+			/* Complete in this piece, no need to copy it */
+			n = s->need;
+			ret = lz4_stream_process(s, p);
+			if (ret)
+				return ret;
+		} else {
+			n = MIN(len, s->need - s->in_len);
+			memcpy(s->in + s->in_len, p, n);
+			s->in_len += n;
+			if (s->in_len == s->need) {
+				s->in_len = 0;
+				ret = lz4_stream_process(s, s->in);
+				if (ret)
+					return ret;
+			}
+		}
+
+		p += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+int lz4_stream_finish(struct lz4_stream *s)
+{
+	/* Legacy files have no end mark, they end between two blocks */
+	if (s->in_len || (s->state != LZ4_STREAM_MAGIC &&
+			  s->state != LZ4_STREAM_LEGACY_SIZE))
+		return ERR_NOT_VALID;
+
+	return 0;
+}
+
+static inline void lz4_write32(unsigned char *p, uint32_t val)
+{
+	p[0] = val;
+	p[1] = val >> 8;
+	p[2] = val >> 16;
+	p[3] = val >> 24;
+}
+
+static inline uint32_t lz4_hash(uint32_t seq)
+{
+	return (seq * 2654435761U) >> (32 - LZ4_HASH_BITS);
+}
+
+static unsigned char *lz4_write_length(unsigned char *dst, size_t len)
+{
+	for (; len >= 255; len -= 255)
+		*dst++ = 255;
+	*dst++ = len;
+	return dst;
+}
+
+static unsigned char *lz4_write_sequence(unsigned char *dst,
+					 const unsigned char *lit, size_t lit_len,
+					 size_t offset, size_t match_len)
+{
+	unsigned char *token = dst++;
+
+	*token = (lit_len < 15 ? lit_len : 15) << 4;
+	if (lit_len >= 15)
+		dst = lz4_write_length(dst, lit_len - 15);
+	memcpy(dst, lit, lit_len);
+	dst += lit_len;
+
+	/* The last sequence has no match */
+	if (!match_len)
+		return dst;
+
+	dst[0] = offset;
+	dst[1] = offset >> 8;
+	dst += 2;
+
+	match_len -= LZ4_MIN_MATCH;
+	*token |= match_len < 15 ? match_len : 15;
+	if (match_len >= 15)
+		dst = lz4_write_length(dst, match_len - 15);
+	return dst;
+}
+
+/* Returns the compressed size, dst must have room for the worst case. */
+static size_t lz4_compress_block(const unsigned char *src, size_t size,
+				 unsigned char *dst, uint32_t *table)
+{
+	const unsigned char *ip = src, *anchor = src, *ref;
+	const unsigned char *end = src + size;
+	unsigned char *op = dst;
+	uint32_t seq, h;
+	size_t len;
+
+	memset(table, 0, sizeof(*table) << LZ4_HASH_BITS);
+
+	while (size > LZ4_MF_LIMIT && ip < end - LZ4_MF_LIMIT) {
+		seq = lz4_read32(ip);
+		h = lz4_hash(seq);
+		ref = src + table[h];
+		table[h] = ip - src;
+
+		if (ref >= ip || ip - ref > LZ4_MAX_OFFSET || lz4_read32(ref) != seq) {
+			ip++;
+			continue;
+		}
+
+		len = LZ4_MIN_MATCH;
+		while (ip + len < end - LZ4_LAST_LITERALS && ref[len] == ip[len])
+			len++;
+
+		op = lz4_write_sequence(op, anchor, ip - anchor, ip - ref, len);
+		ip += len;
+		anchor = ip;
+	}
+
+	op = lz4_write_sequence(op, anchor, end - anchor, 0, 0);
+	return op - dst;
+}
+
+size_t lz4_compress_bound(size_t size)
+{
+	size_t blocks = size / LZ4_LEGACY_BLOCK_SIZE + 1;
+
+	return 4 + size + size / 255 + blocks * 16;
+}
+
+size_t lz4_compress(const void *src, size_t src_size, void *dst)
+{
+	const unsigned char *p = src, *end = p + src_size;
+	unsigned char *op = dst;
+	uint32_t *table;
+	size_t len, block;
+
+	table = malloc(sizeof(*table) << LZ4_HASH_BITS);
+	if (!table)
+		return 0;
+
+	lz4_write32(op, LZ4_LEGACY_MAGIC);
+	op += 4;
+
+	while (p < end) {
+		len = end - p;
+		if (len > LZ4_LEGACY_BLOCK_SIZE)
+			len = LZ4_LEGACY_BLOCK_SIZE;
+
+		block = lz4_compress_block(p, len, op + 4, table);
+		lz4_write32(op, block);
+		op += 4 + block;
+		p += len;
+	}
+
+	free(table);
+	return op - (unsigned char *)dst;
+}
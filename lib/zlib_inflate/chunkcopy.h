@@ -0,0 +1,95 @@
+/* chunkcopy.h -- fast chunk copy and set operations
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+/* WARNING: this file should *not* be used by applications. It is
+   part of the implementation of the compression library and is
+   subject to change. Applications should only use zlib.h.
+ */
+
+#ifndef CHUNKCOPY_H
+#define CHUNKCOPY_H
+
+#include <stdint.h>
+#include "zutil.h"
+
+/*
+   The copies below move CHUNKCOPY_CHUNK_SIZE bytes at a time with unaligned
+   loads and stores. They are "relaxed": up to CHUNKCOPY_CHUNK_SIZE - 1 bytes
+   after the requested length are written with garbage and the same amount
+   may be read after the end of the source, so callers must leave enough
+   slack in both buffers.
+ */
+
+#define CHUNKCOPY_CHUNK_SIZE 16
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+
+typedef uint8x16_t z_vec128i_t;
+
+local inline z_vec128i_t loadchunk(const unsigned char FAR *s) {
+    return vld1q_u8(s);
+}
+
+local inline void storechunk(unsigned char FAR *d, z_vec128i_t c) {
+    vst1q_u8(d, c);
+}
+#else
+typedef struct {
+    uint32_t w[4];
+} z_vec128i_t;
+
+local inline z_vec128i_t loadchunk(const unsigned char FAR *s) {
+    z_vec128i_t c;
+    zmemcpy(&c, s, sizeof(c));
+    return c;
+}
+
+local inline void storechunk(unsigned char FAR *d, z_vec128i_t c) {
+    zmemcpy(d, &c, sizeof(c));
+}
+#endif
+
+/*
+   Copy len (> 0) bytes from "from" to "out", which may overlap as long as
+   "from" is at least CHUNKCOPY_CHUNK_SIZE bytes before "out". The odd part
+   is copied first so that the rest are whole chunks.
+ */
+local inline unsigned char FAR *chunkcopy_core(unsigned char FAR *out,
+                                               const unsigned char FAR *from,
+                                               unsigned len) {
+    unsigned bump = (--len % CHUNKCOPY_CHUNK_SIZE) + 1;
+
+    storechunk(out, loadchunk(from));
+    out += bump;
+    from += bump;
+    len /= CHUNKCOPY_CHUNK_SIZE;
+    while (len-- > 0) {
+        storechunk(out, loadchunk(from));
+        out += CHUNKCOPY_CHUNK_SIZE;
+        from += CHUNKCOPY_CHUNK_SIZE;
+    }
+    return out;
+}
+
+/*
+   Copy len (> 0) bytes from the output dist bytes back, like the byte by
+   byte copy of a match does. Short distances are first unrolled by copying
+   the pattern onto itself until it is at least a chunk long.
+ */
+local inline unsigned char FAR *chunkcopy_lapped(unsigned char FAR *out,
+                                                 unsigned dist,
+                                                 unsigned len) {
+    const unsigned char FAR *from = out - dist;
+
+    while (dist < len && dist < CHUNKCOPY_CHUNK_SIZE) {
+        storechunk(out, loadchunk(from));
+        out += dist;
+        len -= dist;
+        dist += dist;
+    }
+    return chunkcopy_core(out, out - dist, len);
+}
+
+#endif /* CHUNKCOPY_H */
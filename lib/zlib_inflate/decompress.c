@@ -41,10 +41,24 @@
 #include "inffast.h"
 #include "decompress.h"
 #include <sys/types.h>	/* for size_t */
+#include <arch/defines.h>
+#include <stdlib.h>
 #include <string.h>
 #include <debug.h>
 #include <malloc.h>
 
+#if WITH_LK2ND_PERF
+#include <lk2nd/perf.h>
+#endif
+#if WITH_LK2ND_TRACE
+#include <lk2nd/trace.h>
+#endif
+#if WITH_LK2ND_SMP
+#include <arch/ops.h>
+#include <list.h>
+#include <lk2nd/smp.h>
+#endif
+
 #define GZIP_HEADER_LEN 10
 #define GZIP_FILENAME_LIMIT 256
 
@@ -53,11 +67,268 @@ static void zlib_free(voidpf qpaque, void *addr)
 	return free(addr);
 }
 
-static void *zlib_alloc(voidpf qpaque, uInt items, size_t size)
+static void *zlib_alloc(voidpf qpaque, uInt items, uInt size)
 {
 	return malloc(items * size);
 }
 
+/*
+ * BGZF (as written by bgzip from htslib) is a series of small gzip members
+ * that each store their compressed size in a "BC" extra field. The members
+ * can be found without decompressing them and each one has the size of its
+ * output in the trailer, so they can be inflated independently and straight
+ * to their offset in out_buf, split between the boot CPU and the secondary
+ * CPUs if lk2nd has them available. Any gzip decompressor still reads the
+ * whole file, e.g. "bgzip -c Image > Image.gz" works for the kernel.
+ */
+#define GZIP_FLG_FEXTRA		0x04
+#define BGZF_HEADER_LEN		(GZIP_HEADER_LEN + 2)
+#define BGZF_TRAILER_LEN	8
+#define BGZF_MAX_PARTS		4
+#define BGZF_SMP_MIN		(256 * 1024)
+/* inflate state and the window, inflate_chunk pads the window a bit */
+#define BGZF_ARENA_SIZE		ROUNDUP(sizeof(struct inflate_state) + \
+					(1U << MAX_WBITS) + 64, CACHE_LINE)
+
+struct bgzf_part {
+#if WITH_LK2ND_SMP
+	struct lk2nd_smp_job job;
+#endif
+	const unsigned char *in;
+	unsigned int in_len;
+	unsigned char *out;
+	unsigned int out_len;
+	unsigned char *arena;
+	unsigned int arena_used;
+	int rc;
+} __ALIGNED(CACHE_LINE);
+
+static struct bgzf_part bgzf_parts[BGZF_MAX_PARTS];
+
+static inline unsigned int get_le16(const unsigned char *p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static inline unsigned int get_le32(const unsigned char *p)
+{
+	return get_le16(p) | (get_le16(p + 2) << 16);
+}
+
+/* Returns the length of the BGZF member at buf, or 0 if there is none */
+static unsigned int bgzf_member_len(const unsigned char *buf, unsigned int len)
+{
+	unsigned int xlen, pos, slen, size;
+
+	/* bgzip writes the extra field only, no file name or comment */
+	if (len < BGZF_HEADER_LEN || buf[0] != 0x1f || buf[1] != 0x8b ||
+	    buf[2] != 0x08 || buf[3] != GZIP_FLG_FEXTRA)
+		return 0;
+
+	xlen = get_le16(buf + GZIP_HEADER_LEN);
+	if (xlen > len - BGZF_HEADER_LEN)
+		return 0;
+
+	for (pos = 0; pos + 4 <= xlen; pos += 4 + slen) {
+		const unsigned char *sub = buf + BGZF_HEADER_LEN + pos;
+
+		slen = get_le16(sub + 2);
+		if (sub[0] != 'B' || sub[1] != 'C' || slen != 2)
+			continue;
+		if (pos + 6 > xlen)
+			return 0;
+
+		size = get_le16(sub + 4) + 1;
+		if (size < BGZF_HEADER_LEN + xlen + BGZF_TRAILER_LEN || size > len)
+			return 0;
+		return size;
+	}
+	return 0;
+}
+
+static voidpf bgzf_alloc(voidpf opaque, uInt items, uInt size)
+{
+	struct bgzf_part *p = opaque;
+	unsigned int n = ROUNDUP(items * size, 8);
+	voidpf addr;
+
+	if (n > BGZF_ARENA_SIZE - p->arena_used)
+		return Z_NULL;
+
+	addr = p->arena + p->arena_used;
+	p->arena_used += n;
+	return addr;
+}
+
+static void bgzf_free(voidpf opaque, voidpf addr)
+{
+}
+
+/*
+ * Inflate the members of one part. This may run on a secondary CPU, so it
+ * must not print anything or use the heap.
+ */
+static int bgzf_inflate_part(struct bgzf_part *p)
+{
+	const unsigned char *in = p->in, *end = p->in + p->in_len;
+	unsigned char *out = p->out;
+	struct z_stream_s stream = {
+		.zalloc = bgzf_alloc,
+		.zfree = bgzf_free,
+		.opaque = p,
+	};
+	unsigned int mlen, isize, hlen;
+	int rc;
+
+	p->arena_used = 0;
+	if (inflateInit2(&stream, -MAX_WBITS) != Z_OK)
+		return -1;
+
+	rc = 0;
+	while (in < end) {
+		mlen = bgzf_member_len(in, end - in);
+		if (!mlen) {
+			rc = -1;
+			break;
+		}
+		hlen = BGZF_HEADER_LEN + get_le16(in + GZIP_HEADER_LEN);
+		isize = get_le32(in + mlen - 4);
+
+		inflateReset(&stream);
+		stream.next_in = (unsigned char *)in + hlen;
+		stream.avail_in = mlen - hlen - BGZF_TRAILER_LEN;
+		stream.next_out = out;
+		stream.avail_out = isize;
+		if (inflate(&stream, Z_FINISH) != Z_STREAM_END || stream.avail_out) {
+			rc = -1;
+			break;
+		}
+
+		in += mlen;
+		out += isize;
+	}
+
+	inflateEnd(&stream);
+	return rc;
+}
+
+#if WITH_LK2ND_SMP
+static void bgzf_job(struct lk2nd_smp_job *job)
+{
+	struct bgzf_part *p = containerof(job, struct bgzf_part, job);
+
+	/* The worker only invalidated the job, the boot CPU cleaned all of it */
+	arch_invalidate_cache_range((addr_t)p, sizeof(*p));
+	p->rc = bgzf_inflate_part(p);
+
+	/* Nothing of the arena may be written back once it is freed */
+	arch_clean_invalidate_cache_range((addr_t)p->arena, BGZF_ARENA_SIZE);
+	arch_clean_cache_range((addr_t)p, sizeof(*p));
+}
+#endif
+
+static int bgzf_decompress(unsigned char *in_buf, unsigned int in_len,
+			   unsigned char *out_buf, unsigned int out_buf_len,
+			   unsigned int *pos, unsigned int *out_len)
+{
+	unsigned int in_pos = 0, out_pos = 0, end, total, mlen, isize, n, i;
+	unsigned int workers = 0;
+	struct bgzf_part *p;
+	unsigned char *arena;
+	int rc = 0;
+
+	/* Find the end of the members and the size of the output first */
+	while ((mlen = bgzf_member_len(in_buf + in_pos, in_len - in_pos))) {
+		isize = get_le32(in_buf + in_pos + mlen - 4);
+		if (isize > out_buf_len - out_pos) {
+			dprintf(INFO, "the avaiable length of out_buf is not enough.\n");
+			return -1;
+		}
+		in_pos += mlen;
+		out_pos += isize;
+	}
+	end = in_pos;
+	total = out_pos;
+
+#if WITH_LK2ND_SMP
+	if (total >= BGZF_SMP_MIN)
+		workers = MIN(lk2nd_smp_start(), BGZF_MAX_PARTS - 1);
+#endif
+
+	/*
+	 * Split the output into about equal parts at the start of a member.
+	 * The boot CPU takes the first part, the parts of the workers must
+	 * start on a cache line of out_buf.
+	 */
+	memset(bgzf_parts, 0, sizeof(bgzf_parts));
+	n = 1;
+	p = &bgzf_parts[0];
+	p->in = in_buf;
+	p->out = out_buf;
+	for (in_pos = 0, out_pos = 0; in_pos < end; in_pos += mlen, out_pos += isize) {
+		mlen = bgzf_member_len(in_buf + in_pos, end - in_pos);
+		isize = get_le32(in_buf + in_pos + mlen - 4);
+
+		if (n <= workers &&
+		    out_pos >= (unsigned long long)total * n / (workers + 1) &&
+		    !((uintptr_t)(out_buf + out_pos) & (CACHE_LINE - 1))) {
+			p = &bgzf_parts[n++];
+			p->in = in_buf + in_pos;
+			p->out = out_buf + out_pos;
+		}
+		p->in_len += mlen;
+		p->out_len += isize;
+	}
+
+	arena = memalign(CACHE_LINE, n * BGZF_ARENA_SIZE);
+	if (!arena) {
+		dprintf(INFO, "allocating inflate memory failed.\n");
+		return -1;
+	}
+	for (i = 0; i < n; i++)
+		bgzf_parts[i].arena = arena + i * BGZF_ARENA_SIZE;
+
+#if WITH_LK2ND_SMP
+	for (i = 1; i < n; i++) {
+		p = &bgzf_parts[i];
+		p->job.func = bgzf_job;
+		p->job.in = p->in;
+		p->job.in_len = p->in_len;
+		p->job.out = p->out;
+		p->job.out_len = p->out_len;
+		arch_clean_cache_range((addr_t)p, sizeof(*p));
+		arch_clean_invalidate_cache_range((addr_t)p->arena, BGZF_ARENA_SIZE);
+		lk2nd_smp_run(i - 1, &p->job);
+	}
+#endif
+
+	bgzf_parts[0].rc = bgzf_inflate_part(&bgzf_parts[0]);
+
+#if WITH_LK2ND_SMP
+	for (i = 1; i < n; i++) {
+		p = &bgzf_parts[i];
+		lk2nd_smp_wait(i - 1);
+		arch_invalidate_cache_range((addr_t)p, sizeof(*p));
+	}
+#endif
+
+	for (i = 0; i < n; i++)
+		if (bgzf_parts[i].rc)
+			rc = -1;
+
+	free(arena);
+	if (rc) {
+		dprintf(INFO, "uncompression error \n");
+		return rc;
+	}
+
+	if (pos)
+		*pos = end;
+	if (out_len)
+		*out_len = total;
+	return 0;
+}
+
 /* decompress gzip file "in_buf", return 0 if decompressed successful,
  * return -1 if decompressed failed.
  * in_buf - input gzip file
@@ -75,6 +346,12 @@ int decompress(unsigned char *in_buf, unsigned int in_len,
 	struct z_stream_s *stream;
 	int rc = -1;
 	int i;
+#if WITH_LK2ND_PERF
+	LK2ND_PERF_SCOPE("decompress");
+#endif
+#if WITH_LK2ND_TRACE
+	LK2ND_TRACE_SCOPE("decompress", in_len);
+#endif
 
 	if (in_len < GZIP_HEADER_LEN) {
 		dprintf(INFO, "the input data is not a gzip package.\n");
@@ -85,6 +362,10 @@ int decompress(unsigned char *in_buf, unsigned int in_len,
 		return rc;
 	}
 
+	if (bgzf_member_len(in_buf, in_len))
+		return bgzf_decompress(in_buf, in_len, out_buf, out_buf_len,
+				       pos, out_len);
+
 	stream = malloc(sizeof(*stream));
 	if (stream == NULL) {
 		dprintf(INFO, "allocating z_stream failed.\n");
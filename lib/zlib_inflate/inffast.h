@@ -9,3 +9,16 @@
  */
 
 void ZLIB_INTERNAL inflate_fast(z_streamp strm, unsigned start);
+
+#if INFLATE_CHUNK
+/* inffast_chunk.c */
+#include "chunkcopy.h"
+
+#define INFLATE_FAST_MIN_INPUT 16
+#define INFLATE_FAST_MIN_OUTPUT (258 + CHUNKCOPY_CHUNK_SIZE)
+
+void ZLIB_INTERNAL inflate_fast_chunk_(z_streamp strm, unsigned start);
+#else
+#define INFLATE_FAST_MIN_INPUT 6
+#define INFLATE_FAST_MIN_OUTPUT 258
+#endif
@@ -375,9 +375,16 @@ local int updatewindow(z_streamp strm, const Bytef *end, unsigned copy) {
 
     /* if it hasn't been done already, allocate space for the window */
     if (state->window == Z_NULL) {
+#if INFLATE_CHUNK
+        /* inflate_fast_chunk_() may read a chunk past the end */
+        state->window = (unsigned char FAR *)
+                        ZALLOC(strm, (1U << state->wbits) + CHUNKCOPY_CHUNK_SIZE,
+                               sizeof(unsigned char));
+#else
         state->window = (unsigned char FAR *)
                         ZALLOC(strm, 1U << state->wbits,
                                sizeof(unsigned char));
+#endif
         if (state->window == Z_NULL) return 1;
     }
 
@@ -1026,9 +1033,14 @@ int ZEXPORT inflate(z_streamp strm, int flush) {
             state->mode = LEN;
                 /* fallthrough */
         case LEN:
-            if (have >= 6 && left >= 258) {
+            if (have >= INFLATE_FAST_MIN_INPUT &&
+                left >= INFLATE_FAST_MIN_OUTPUT) {
                 RESTORE();
+#if INFLATE_CHUNK
+                inflate_fast_chunk_(strm, out);
+#else
                 inflate_fast(strm, out);
+#endif
                 LOAD();
                 if (state->mode == TYPE)
                     state->back = -1;
@@ -5,6 +5,19 @@ OBJS += \
 	$(LOCAL_DIR)/adler32.o \
 	$(LOCAL_DIR)/inftrees.o \
 	$(LOCAL_DIR)/inflate.o \
-	$(LOCAL_DIR)/inffast.o \
 	$(LOCAL_DIR)/uncompr.o \
 	$(LOCAL_DIR)/decompress.o
+
+# Chunked match copies and a 64-bit bit buffer in inflate_fast(), the copies
+# use NEON on ARMv7 (see inffast_chunk.c)
+ifeq ($(ARM_CPU),cortex-a8)
+DEFINES += INFLATE_CHUNK=1
+OBJS += \
+	$(LOCAL_DIR)/inffast_chunk.o
+ifneq ($(ENABLE_HARD_FPU),1)
+$(BUILDDIR)/$(LOCAL_DIR)/inffast_chunk.o: CFLAGS += -mfpu=neon -mfloat-abi=softfp
+endif
+else
+OBJS += \
+	$(LOCAL_DIR)/inffast.o
+endif
@@ -0,0 +1,1013 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <debug.h>
+#include <err.h>
+#include <stdlib.h>
+#include <string.h>
+#include <lib/zstd.h>
+
+/*
+ * zstd.c - Decompressor for Zstandard frames, see RFC 8878.
+ *
+ * The decompressed data is written to one flat buffer, so matches can
+ * refer back to any earlier data and no separate window is needed. This
+ * also means that dictionaries are not supported. The content checksum is
+ * not verified, like the CRC of gzip kernels.
+ */
+
+#define ZSTD_MAGIC		0xFD2FB528
+#define ZSTD_SKIP_MAGIC		0x184D2A50
+#define ZSTD_SKIP_MASK		0xFFFFFFF0
+
+#define ZSTD_BLOCK_MAX		(128 * 1024)
+
+enum {
+	ZSTD_BLOCK_RAW,
+	ZSTD_BLOCK_RLE,
+	ZSTD_BLOCK_COMPRESSED,
+};
+
+enum {
+	ZSTD_LIT_RAW,
+	ZSTD_LIT_RLE,
+	ZSTD_LIT_COMPRESSED,
+	ZSTD_LIT_TREELESS,
+};
+
+enum {
+	ZSTD_SEQ_PREDEFINED,
+	ZSTD_SEQ_RLE,
+	ZSTD_SEQ_FSE,
+	ZSTD_SEQ_REPEAT,
+};
+
+#define FSE_MAX_LOG		9
+#define FSE_MAX_SYMBOL		255
+
+#define HUF_MAX_LOG		11
+#define HUF_MAX_WEIGHT_LOG	6
+#define HUF_MAX_SYMBOLS		256
+
+#define LL_MAX_LOG		9
+#define LL_MAX_SYMBOL		35
+#define OF_MAX_LOG		8
+#define OF_MAX_SYMBOL		31
+#define ML_MAX_LOG		9
+#define ML_MAX_SYMBOL		52
+
+struct fse_entry {
+	uint8_t symbol;
+	uint8_t bits;
+	uint16_t base;
+};
+
+struct fse_table {
+	struct fse_entry e[1 << FSE_MAX_LOG];
+	unsigned log;
+	bool valid;
+};
+
+struct huf_entry {
+	uint8_t symbol;
+	uint8_t bits;
+};
+
+struct zstd_out {
+	unsigned char *start;
+	unsigned char *pos;
+	unsigned char *end;
+};
+
+struct zstd_dctx {
+	struct zstd_out out;
+
+	/* Tables of the previous block, for the repeat modes */
+	struct fse_table ll, of, ml;
+	struct huf_entry huf[1 << HUF_MAX_LOG];
+	unsigned huf_log;
+	bool huf_valid;
+
+	/* Temporary table for the Huffman weights */
+	struct fse_table weights;
+
+	uint32_t rep[3];
+
+	unsigned char lit[ZSTD_BLOCK_MAX];
+};
+
+/* Predefined distributions and length codes, see RFC 8878 3.1.1.3.2 */
+static const int16_t ll_default[LL_MAX_SYMBOL + 1] = {
+	4, 3, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 1, 1, 1,
+	2, 2, 2, 2, 2, 2, 2, 2, 2, 3, 2, 1, 1, 1, 1, 1,
+	-1, -1, -1, -1,
+};
+
+static const int16_t of_default[29] = {
+	1, 1, 1, 1, 1, 1, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, -1, -1, -1, -1, -1,
+};
+
+static const int16_t ml_default[ML_MAX_SYMBOL + 1] = {
+	1, 4, 3, 2, 2, 2, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, -1, -1,
+	-1, -1, -1, -1, -1,
+};
+
+static const uint32_t ll_base[LL_MAX_SYMBOL + 1] = {
+	0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+	16, 18, 20, 22, 24, 28, 32, 40, 48, 64, 128, 256,
+	512, 1024, 2048, 4096, 8192, 16384, 32768, 65536,
+};
+
+static const uint8_t ll_bits[LL_MAX_SYMBOL + 1] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	1, 1, 1, 1, 2, 2, 3, 3, 4, 6, 7, 8,
+	9, 10, 11, 12, 13, 14, 15, 16,
+};
+
+static const uint32_t ml_base[ML_MAX_SYMBOL + 1] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18,
+	19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34,
+	35, 37, 39, 41, 43, 47, 51, 59, 67, 83, 99, 131,
+	259, 515, 1027, 2051, 4099, 8195, 16387, 32771, 65539,
+};
+
+static const uint8_t ml_bits[ML_MAX_SYMBOL + 1] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	1, 1, 1, 1, 2, 2, 3, 3, 4, 4, 5, 7,
+	8, 9, 10, 11, 12, 13, 14, 15, 16,
+};
+
+static inline unsigned zstd_highbit(uint32_t v)
+{
+	return 31 - __builtin_clz(v);
+}
+
+static inline uint32_t zstd_read16(const unsigned char *p)
+{
+	return p[0] | p[1] << 8;
+}
+
+static inline uint32_t zstd_read32(const unsigned char *p)
+{
+	return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static inline uint64_t zstd_read64(const unsigned char *p)
+{
+	return zstd_read32(p) | (uint64_t)zstd_read32(p + 4) << 32;
+}
+
+/*
+ * Entropy coded streams are read backwards, starting with the highest
+ * bit of the last byte after the final set (padding) bit. consumed counts
+ * the bits used from the top of value, which holds the 8 bytes at ptr.
+ */
+struct zstd_bits {
+	const unsigned char *start;
+	const unsigned char *ptr;
+	uint64_t value;
+	unsigned consumed;
+};
+
+static int zstd_bits_init(struct zstd_bits *b, const unsigned char *src,
+			  size_t size)
+{
+	size_t i;
+
+	if (size == 0 || src[size - 1] == 0)
+		return ERR_NOT_VALID;
+
+	b->start = src;
+	if (size >= sizeof(b->value)) {
+		b->ptr = src + size - sizeof(b->value);
+		b->value = zstd_read64(b->ptr);
+		b->consumed = 0;
+	} else {
+		b->ptr = src;
+		b->value = 0;
+		for (i = 0; i < size; i++)
+			b->value |= (uint64_t)src[i] << (8 * i);
+		b->consumed = (sizeof(b->value) - size) * 8;
+	}
+	b->consumed += 8 - zstd_highbit(src[size - 1]);
+
+	return 0;
+}
+
+static inline uint64_t zstd_bits_peek(const struct zstd_bits *b, unsigned n)
+{
+	return (b->value << (b->consumed & 63)) >> 1 >> (63 - n);
+}
+
+static inline uint64_t zstd_bits_read(struct zstd_bits *b, unsigned n)
+{
+	uint64_t v = zstd_bits_peek(b, n);
+
+	b->consumed += n;
+	return v;
+}
+
+/* Refill value so that at least 57 bits can be read, unless at the start. */
+static inline void zstd_bits_reload(struct zstd_bits *b)
+{
+	size_t bytes;
+
+	if (b->consumed > 64)
+		return;
+
+	bytes = b->consumed >> 3;
+	if (b->ptr < b->start + sizeof(b->value) &&
+	    bytes > (size_t)(b->ptr - b->start))
+		bytes = b->ptr - b->start;
+
+	b->ptr -= bytes;
+	b->consumed -= bytes * 8;
+	b->value = zstd_read64(b->ptr);
+}
+
+static inline bool zstd_bits_overflow(const struct zstd_bits *b)
+{
+	return b->consumed > 64;
+}
+
+static inline bool zstd_bits_end(const struct zstd_bits *b)
+{
+	return b->ptr == b->start && b->consumed == 64;
+}
+
+/* Forward little-endian bits for the FSE table descriptions. */
+static uint32_t zstd_fwd_peek(const unsigned char *src, size_t size, size_t pos)
+{
+	size_t byte = pos >> 3;
+	uint32_t v = 0;
+	unsigned i;
+
+	for (i = 0; i < 4 && byte + i < size; i++)
+		v |= (uint32_t)src[byte + i] << (8 * i);
+
+	return v >> (pos & 7);
+}
+
+/*
+ * Read the normalized probabilities of an FSE table description.
+ * Returns the number of bytes used or a negative error.
+ */
+static int fse_read_ncount(int16_t *norm, unsigned *max_symbol, unsigned *log,
+			   unsigned max_log, const unsigned char *src, size_t size)
+{
+	int remaining, threshold, count;
+	unsigned nbits, symbol = 0, rep, i;
+	uint32_t bits, max;
+	size_t pos = 4;
+
+	if (size == 0)
+		return ERR_NOT_VALID;
+
+	*log = (src[0] & 0xf) + 5;
+	if (*log > max_log)
+		return ERR_NOT_VALID;
+
+	remaining = (1 << *log) + 1;
+	threshold = 1 << *log;
+	nbits = *log + 1;
+
+	while (remaining > 1) {
+		if (symbol > *max_symbol)
+			return ERR_NOT_VALID;
+
+		bits = zstd_fwd_peek(src, size, pos);
+		max = (2 * threshold - 1) - remaining;
+		if ((bits & (threshold - 1)) < max) {
+			count = bits & (threshold - 1);
+			pos += nbits - 1;
+		} else {
+			count = bits & (2 * threshold - 1);
+			if (count >= threshold)
+				count -= max;
+			pos += nbits;
+		}
+
+		/* The value is the probability + 1, "less than 1" is -1 */
+		count--;
+		remaining -= count < 0 ? -count : count;
+		norm[symbol++] = count;
+		if (remaining < 1)
+			return ERR_NOT_VALID;
+
+		/* A zero probability is followed by a number of repeats */
+		if (count == 0) {
+			do {
+				rep = zstd_fwd_peek(src, size, pos) & 3;
+				pos += 2;
+				for (i = 0; i < rep; i++) {
+					if (symbol > *max_symbol)
+						return ERR_NOT_VALID;
+					norm[symbol++] = 0;
+				}
+			} while (rep == 3);
+		}
+
+		while (remaining < threshold) {
+			nbits--;
+			threshold >>= 1;
+		}
+	}
+
+	pos = (pos + 7) / 8;
+	if (pos > size)
+		return ERR_NOT_VALID;
+
+	*max_symbol = symbol - 1;
+	return pos;
+}
+
+static int fse_build(struct fse_table *t, const int16_t *norm,
+		     unsigned max_symbol, unsigned log)
+{
+	unsigned size = 1 << log, high = size - 1, mask = size - 1;
+	unsigned step = (size >> 1) + (size >> 3) + 3;
+	uint16_t next[FSE_MAX_SYMBOL + 1];
+	unsigned s, u, pos = 0, n;
+	int i;
+
+	/* "Less than 1" probabilities take single cells at the end */
+	for (s = 0; s <= max_symbol; s++) {
+		if (norm[s] == -1) {
+			t->e[high--].symbol = s;
+			next[s] = 1;
+		} else {
+			next[s] = norm[s];
+		}
+	}
+
+	for (s = 0; s <= max_symbol; s++) {
+		for (i = 0; i < norm[s]; i++) {
+			t->e[pos].symbol = s;
+			do {
+				pos = (pos + step) & mask;
+			} while (pos > high);
+		}
+	}
+	if (pos != 0)
+		return ERR_NOT_VALID;
+
+	for (u = 0; u < size; u++) {
+		n = next[t->e[u].symbol]++;
+		t->e[u].bits = log - zstd_highbit(n);
+		t->e[u].base = (n << t->e[u].bits) - size;
+	}
+
+	t->log = log;
+	t->valid = true;
+	return 0;
+}
+
+static void fse_build_rle(struct fse_table *t, uint8_t symbol)
+{
+	t->e[0].symbol = symbol;
+	t->e[0].bits = 0;
+	t->e[0].base = 0;
+	t->log = 0;
+	t->valid = true;
+}
+
+/*
+ * Read the Huffman weights, which are either 4 bit values or FSE
+ * compressed with two interleaved states.
+ * Returns the number of bytes used or a negative error.
+ */
+static int huf_read_weights(struct zstd_dctx *d, uint8_t *weights,
+			    unsigned *count, const unsigned char *src, size_t size)
+{
+	int16_t norm[FSE_MAX_SYMBOL + 1];
+	struct fse_table *t = &d->weights;
+	unsigned max_symbol = FSE_MAX_SYMBOL, log, s1, s2, n = 0, i;
+	struct zstd_bits b;
+	size_t csize;
+	int ret;
+
+	if (size == 0)
+		return ERR_NOT_VALID;
+
+	if (src[0] >= 128) {
+		n = src[0] - 127;
+		csize = (n + 1) / 2;
+		if (1 + csize > size)
+			return ERR_NOT_VALID;
+		for (i = 0; i < n; i++)
+			weights[i] = (src[1 + i / 2] >> (i & 1 ? 0 : 4)) & 0xf;
+		*count = n;
+		return 1 + csize;
+	}
+
+	csize = src[0];
+	if (1 + csize > size)
+		return ERR_NOT_VALID;
+
+	ret = fse_read_ncount(norm, &max_symbol, &log, HUF_MAX_WEIGHT_LOG,
+			      src + 1, csize);
+	if (ret < 0)
+		return ret;
+	if (fse_build(t, norm, max_symbol, log))
+		return ERR_NOT_VALID;
+	if (zstd_bits_init(&b, src + 1 + ret, csize - ret))
+		return ERR_NOT_VALID;
+
+	s1 = zstd_bits_read(&b, log);
+	s2 = zstd_bits_read(&b, log);
+	zstd_bits_reload(&b);
+
+	for (;;) {
+		if (n >= HUF_MAX_SYMBOLS - 2)
+			return ERR_NOT_VALID;
+
+		weights[n++] = t->e[s1].symbol;
+		s1 = t->e[s1].base + zstd_bits_read(&b, t->e[s1].bits);
+		zstd_bits_reload(&b);
+		if (zstd_bits_overflow(&b)) {
+			weights[n++] = t->e[s2].symbol;
+			break;
+		}
+
+		weights[n++] = t->e[s2].symbol;
+		s2 = t->e[s2].base + zstd_bits_read(&b, t->e[s2].bits);
+		zstd_bits_reload(&b);
+		if (zstd_bits_overflow(&b)) {
+			weights[n++] = t->e[s1].symbol;
+			break;
+		}
+	}
+
+	*count = n;
+	return 1 + csize;
+}
+
+static int huf_read_table(struct zstd_dctx *d, const unsigned char *src,
+			  size_t size)
+{
+	unsigned rank_count[HUF_MAX_LOG + 2] = { 0 };
+	unsigned rank_start[HUF_MAX_LOG + 2];
+	uint8_t weights[HUF_MAX_SYMBOLS];
+	unsigned count, max_bits, s, i, len, w;
+	uint32_t total = 0, rest;
+	int ret;
+
+	ret = huf_read_weights(d, weights, &count, src, size);
+	if (ret < 0)
+		return ret;
+	if (count >= HUF_MAX_SYMBOLS)
+		return ERR_NOT_VALID;
+
+	for (s = 0; s < count; s++) {
+		if (weights[s] > HUF_MAX_LOG)
+			return ERR_NOT_VALID;
+		if (weights[s])
+			total += 1 << (weights[s] - 1);
+	}
+	if (total == 0)
+		return ERR_NOT_VALID;
+
+	/* The weight of the last symbol makes the total a power of two */
+	max_bits = zstd_highbit(total) + 1;
+	if (max_bits > HUF_MAX_LOG)
+		return ERR_NOT_VALID;
+	rest = (1 << max_bits) - total;
+	if (rest & (rest - 1))
+		return ERR_NOT_VALID;
+	weights[count++] = zstd_highbit(rest) + 1;
+
+	for (s = 0; s < count; s++)
+		rank_count[weights[s]]++;
+
+	/* Codes of the lowest weight (longest) come first */
+	rank_start[1] = 0;
+	for (w = 1; w <= max_bits; w++)
+		rank_start[w + 1] = rank_start[w] + (rank_count[w] << (w - 1));
+
+	for (s = 0; s < count; s++) {
+		w = weights[s];
+		if (!w)
+			continue;
+
+		len = 1 << (w - 1);
+		for (i = rank_start[w]; i < rank_start[w] + len; i++) {
+			d->huf[i].symbol = s;
+			d->huf[i].bits = max_bits + 1 - w;
+		}
+		rank_start[w] += len;
+	}
+
+	d->huf_log = max_bits;
+	d->huf_valid = true;
+	return ret;
+}
+
+static int huf_decode_stream(struct zstd_dctx *d, unsigned char *dst, size_t n,
+			     const unsigned char *src, size_t size)
+{
+	const struct huf_entry *e;
+	struct zstd_bits b;
+	size_t i;
+
+	if (zstd_bits_init(&b, src, size))
+		return ERR_NOT_VALID;
+
+	/* 4 codes of at most 11 bits fit between two reloads */
+	for (i = 0; i < n; i++) {
+		if ((i & 3) == 0)
+			zstd_bits_reload(&b);
+		e = &d->huf[zstd_bits_peek(&b, d->huf_log)];
+		dst[i] = e->symbol;
+		b.consumed += e->bits;
+	}
+
+	zstd_bits_reload(&b);
+	if (!zstd_bits_end(&b))
+		return ERR_NOT_VALID;
+
+	return 0;
+}
+
+static int huf_decode(struct zstd_dctx *d, unsigned char *dst, size_t n,
+		      const unsigned char *src, size_t size, bool four)
+{
+	size_t sizes[4], seg;
+	unsigned i;
+	int ret;
+
+	if (!four)
+		return huf_decode_stream(d, dst, n, src, size);
+
+	if (size < 6)
+		return ERR_NOT_VALID;
+	sizes[0] = zstd_read16(src);
+	sizes[1] = zstd_read16(src + 2);
+	sizes[2] = zstd_read16(src + 4);
+	src += 6;
+	size -= 6;
+	if (sizes[0] + sizes[1] + sizes[2] > size)
+		return ERR_NOT_VALID;
+	sizes[3] = size - sizes[0] - sizes[1] - sizes[2];
+
+	seg = (n + 3) / 4;
+	if (3 * seg > n)
+		return ERR_NOT_VALID;
+
+	for (i = 0; i < 4; i++) {
+		ret = huf_decode_stream(d, dst, i < 3 ? seg : n - 3 * seg,
+					src, sizes[i]);
+		if (ret)
+			return ret;
+		dst += seg;
+		src += sizes[i];
+	}
+
+	return 0;
+}
+
+/*
+ * Decode the literals section of a compressed block.
+ * Returns the number of bytes used or a negative error.
+ */
+static int zstd_read_literals(struct zstd_dctx *d, const unsigned char *src,
+			      size_t size, const unsigned char **lit,
+			      size_t *lit_len)
+{
+	unsigned type, format, hlen, i;
+	size_t regen, csize;
+	uint64_t v = 0;
+	int ret;
+
+	if (size == 0)
+		return ERR_NOT_VALID;
+
+	type = src[0] & 3;
+	format = (src[0] >> 2) & 3;
+
+	if (type == ZSTD_LIT_RAW || type == ZSTD_LIT_RLE)
+		hlen = format == 1 ? 2 : format == 3 ? 3 : 1;
+	else
+		hlen = format == 2 ? 4 : format == 3 ? 5 : 3;
+	if (hlen > size)
+		return ERR_NOT_VALID;
+
+	for (i = 0; i < hlen; i++)
+		v |= (uint64_t)src[i] << (8 * i);
+
+	if (type == ZSTD_LIT_RAW || type == ZSTD_LIT_RLE) {
+		regen = hlen == 1 ? v >> 3 : v >> 4;
+		*lit_len = regen;
+
+		if (type == ZSTD_LIT_RLE) {
+			if (hlen + 1 > size || regen > ZSTD_BLOCK_MAX)
+				return ERR_NOT_VALID;
+			memset(d->lit, src[hlen], regen);
+			*lit = d->lit;
+			return hlen + 1;
+		}
+
+		if (hlen + regen > size)
+			return ERR_NOT_VALID;
+		*lit = src + hlen;
+		return hlen + regen;
+	}
+
+	switch (format) {
+	case 2:
+		regen = (v >> 4) & 0x3fff;
+		csize = (v >> 18) & 0x3fff;
+		break;
+	case 3:
+		regen = (v >> 4) & 0x3ffff;
+		csize = (v >> 22) & 0x3ffff;
+		break;
+	default:
+		regen = (v >> 4) & 0x3ff;
+		csize = (v >> 14) & 0x3ff;
+		break;
+	}
+
+	if (regen > ZSTD_BLOCK_MAX || hlen + csize > size)
+		return ERR_NOT_VALID;
+
+	src += hlen;
+	ret = 0;
+	if (type == ZSTD_LIT_COMPRESSED) {
+		ret = huf_read_table(d, src, csize);
+		if (ret < 0)
+			return ret;
+	} else if (!d->huf_valid) {
+		return ERR_NOT_VALID;
+	}
+
+	if (huf_decode(d, d->lit, regen, src + ret, csize - ret, format != 0))
+		return ERR_NOT_VALID;
+
+	*lit = d->lit;
+	*lit_len = regen;
+	return hlen + csize;
+}
+
+static int zstd_read_table(struct fse_table *t, unsigned mode,
+			   const int16_t *def, unsigned def_max, unsigned def_log,
+			   unsigned max_symbol, unsigned max_log,
+			   const unsigned char *src, size_t size)
+{
+	int16_t norm[FSE_MAX_SYMBOL + 1];
+	unsigned log;
+	int ret;
+
+	switch (mode) {
+	case ZSTD_SEQ_PREDEFINED:
+		return fse_build(t, def, def_max, def_log);
+	case ZSTD_SEQ_RLE:
+		if (size < 1 || src[0] > max_symbol)
+			return ERR_NOT_VALID;
+		fse_build_rle(t, src[0]);
+		return 1;
+	case ZSTD_SEQ_FSE:
+		ret = fse_read_ncount(norm, &max_symbol, &log, max_log, src, size);
+		if (ret < 0)
+			return ret;
+		if (fse_build(t, norm, max_symbol, log))
+			return ERR_NOT_VALID;
+		return ret;
+	default:
+		return t->valid ? 0 : ERR_NOT_VALID;
+	}
+}
+
+/* Copy literals, or as much of them as fits into the output. */
+static int zstd_copy(struct zstd_out *out, const unsigned char *src, size_t len)
+{
+	size_t room = out->end - out->pos;
+	int ret = 0;
+
+	if (len > room) {
+		len = room;
+		ret = ERR_TOO_BIG;
+	}
+
+	memcpy(out->pos, src, len);
+	out->pos += len;
+	return ret;
+}
+
+/* Copy a match that may overlap with the data it is copied to. */
+static int zstd_copy_match(struct zstd_out *out, size_t offset, size_t len)
+{
+	size_t room = out->end - out->pos;
+	const unsigned char *from = out->pos - offset;
+	int ret = 0;
+
+	if (len > room) {
+		len = room;
+		ret = ERR_TOO_BIG;
+	}
+
+	/* Repeat the pattern until whole copies don't overlap anymore */
+	while (offset < len) {
+		memcpy(out->pos, from, offset);
+		out->pos += offset;
+		len -= offset;
+		offset += offset;
+	}
+
+	memcpy(out->pos, from, len);
+	out->pos += len;
+	return ret;
+}
+
+static inline unsigned fse_update(const struct fse_table *t, unsigned state,
+				  struct zstd_bits *b)
+{
+	return t->e[state].base + zstd_bits_read(b, t->e[state].bits);
+}
+
+static int zstd_sequences(struct zstd_dctx *d, const unsigned char *src,
+			  size_t size, const unsigned char *lit, size_t lit_len)
+{
+	const unsigned char *lit_end = lit + lit_len;
+	unsigned nseq, ll_state, of_state, ml_state, code, idx, hlen, i;
+	uint32_t ll, ml, offset;
+	struct zstd_bits b;
+	int ret;
+
+	if (size < 1)
+		return ERR_NOT_VALID;
+
+	if (src[0] < 128) {
+		nseq = src[0];
+		hlen = 1;
+	} else if (src[0] < 255) {
+		if (size < 2)
+			return ERR_NOT_VALID;
+		nseq = ((src[0] - 128) << 8) + src[1];
+		hlen = 2;
+	} else {
+		if (size < 3)
+			return ERR_NOT_VALID;
+		nseq = zstd_read16(src + 1) + 0x7f00;
+		hlen = 3;
+	}
+
+	if (nseq == 0)
+		return zstd_copy(&d->out, lit, lit_len);
+
+	if (hlen + 1 > size || (src[hlen] & 3))
+		return ERR_NOT_VALID;
+
+	code = src[hlen];
+	src += hlen + 1;
+	size -= hlen + 1;
+
+	ret = zstd_read_table(&d->ll, code >> 6, ll_default, LL_MAX_SYMBOL, 6,
+			      LL_MAX_SYMBOL, LL_MAX_LOG, src, size);
+	if (ret < 0)
+		return ret;
+	src += ret;
+	size -= ret;
+
+	ret = zstd_read_table(&d->of, (code >> 4) & 3, of_default,
+			      ARRAY_SIZE(of_default) - 1, 5,
+			      OF_MAX_SYMBOL, OF_MAX_LOG, src, size);
+	if (ret < 0)
+		return ret;
+	src += ret;
+	size -= ret;
+
+	ret = zstd_read_table(&d->ml, (code >> 2) & 3, ml_default, ML_MAX_SYMBOL, 6,
+			      ML_MAX_SYMBOL, ML_MAX_LOG, src, size);
+	if (ret < 0)
+		return ret;
+	src += ret;
+	size -= ret;
+
+	if (zstd_bits_init(&b, src, size))
+		return ERR_NOT_VALID;
+
+	ll_state = zstd_bits_read(&b, d->ll.log);
+	of_state = zstd_bits_read(&b, d->of.log);
+	ml_state = zstd_bits_read(&b, d->ml.log);
+
+	for (i = 0; i < nseq; i++) {
+		/* Offset, match and literal length bits are read in this order */
+		zstd_bits_reload(&b);
+		code = d->of.e[of_state].symbol;
+		offset = (1U << code) + zstd_bits_read(&b, code);
+
+		zstd_bits_reload(&b);
+		code = d->ml.e[ml_state].symbol;
+		ml = ml_base[code] + zstd_bits_read(&b, ml_bits[code]);
+		code = d->ll.e[ll_state].symbol;
+		ll = ll_base[code] + zstd_bits_read(&b, ll_bits[code]);
+
+		/* Offset values 1-3 select one of the repeated offsets */
+		if (offset > 3) {
+			offset -= 3;
+			d->rep[2] = d->rep[1];
+			d->rep[1] = d->rep[0];
+			d->rep[0] = offset;
+		} else {
+			idx = offset - 1 + (ll == 0);
+			if (idx == 0) {
+				offset = d->rep[0];
+			} else {
+				offset = idx == 3 ? d->rep[0] - 1 : d->rep[idx];
+				if (idx > 1)
+					d->rep[2] = d->rep[1];
+				d->rep[1] = d->rep[0];
+				d->rep[0] = offset;
+			}
+		}
+
+		if (i + 1 < nseq) {
+			zstd_bits_reload(&b);
+			ll_state = fse_update(&d->ll, ll_state, &b);
+			ml_state = fse_update(&d->ml, ml_state, &b);
+			of_state = fse_update(&d->of, of_state, &b);
+		}
+
+		if (ll > (size_t)(lit_end - lit))
+			return ERR_NOT_VALID;
+		ret = zstd_copy(&d->out, lit, ll);
+		if (ret)
+			return ret;
+		lit += ll;
+
+		if (offset == 0 || offset > (size_t)(d->out.pos - d->out.start))
+			return ERR_NOT_VALID;
+		ret = zstd_copy_match(&d->out, offset, ml);
+		if (ret)
+			return ret;
+	}
+
+	zstd_bits_reload(&b);
+	if (!zstd_bits_end(&b))
+		return ERR_NOT_VALID;
+
+	return zstd_copy(&d->out, lit, lit_end - lit);
+}
+
+static int zstd_block(struct zstd_dctx *d, const unsigned char *src, size_t size)
+{
+	const unsigned char *lit;
+	size_t lit_len;
+	int ret;
+
+	ret = zstd_read_literals(d, src, size, &lit, &lit_len);
+	if (ret < 0)
+		return ret;
+
+	return zstd_sequences(d, src + ret, size - ret, lit, lit_len);
+}
+
+/* Returns the number of bytes used from src or a negative error. */
+static int zstd_frame(struct zstd_dctx *d, const unsigned char *src, size_t size)
+{
+	static const unsigned char dict_sizes[] = { 0, 1, 2, 4 };
+	static const unsigned char fcs_sizes[] = { 0, 2, 4, 8 };
+	const unsigned char *p = src + 4, *end = src + size;
+	unsigned char fhd, type;
+	uint32_t block, dict = 0;
+	size_t len, i;
+	size_t room;
+	bool last;
+	int ret;
+
+	if (end - p < 1)
+		return ERR_NOT_VALID;
+
+	fhd = *p++;
+	if (fhd & 0x08)
+		return ERR_NOT_VALID;
+
+	/* Window descriptor, unless the frame is a single segment */
+	len = fhd & 0x20 ? 0 : 1;
+	if ((size_t)(end - p) < len + dict_sizes[fhd & 3])
+		return ERR_NOT_VALID;
+	p += len;
+
+	for (i = 0; i < dict_sizes[fhd & 3]; i++)
+		dict |= (uint32_t)*p++ << (8 * i);
+	if (dict) {
+		dprintf(INFO, "zstd: Dictionaries are not supported\n");
+		return ERR_NOT_SUPPORTED;
+	}
+
+	/* Frame content size is not needed, the output size is known */
+	len = fcs_sizes[fhd >> 6];
+	if (len == 0 && (fhd & 0x20))
+		len = 1;
+	p += len;
+
+	d->rep[0] = 1;
+	d->rep[1] = 4;
+	d->rep[2] = 8;
+	d->ll.valid = d->of.valid = d->ml.valid = false;
+	d->huf_valid = false;
+
+	do {
+		if (end - p < 3)
+			return ERR_NOT_VALID;
+		block = p[0] | p[1] << 8 | p[2] << 16;
+		p += 3;
+
+		last = block & 1;
+		type = (block >> 1) & 3;
+		len = block >> 3;
+		if (len > ZSTD_BLOCK_MAX)
+			return ERR_NOT_VALID;
+
+		switch (type) {
+		case ZSTD_BLOCK_RAW:
+			if (len > (size_t)(end - p))
+				return ERR_NOT_VALID;
+			ret = zstd_copy(&d->out, p, len);
+			p += len;
+			break;
+		case ZSTD_BLOCK_RLE:
+			if (end - p < 1)
+				return ERR_NOT_VALID;
+			room = d->out.end - d->out.pos;
+			ret = len > room ? ERR_TOO_BIG : 0;
+			len = MIN(len, room);
+			memset(d->out.pos, *p, len);
+			d->out.pos += len;
+			p++;
+			break;
+		case ZSTD_BLOCK_COMPRESSED:
+			if (len > (size_t)(end - p))
+				return ERR_NOT_VALID;
+			ret = zstd_block(d, p, len);
+			p += len;
+			break;
+		default:
+			return ERR_NOT_VALID;
+		}
+		if (ret)
+			return ret;
+	} while (!last);
+
+	/* Content checksum */
+	if (fhd & 0x04)
+		p += 4;
+	if (p > end)
+		return ERR_NOT_VALID;
+
+	return p - src;
+}
+
+bool zstd_is_compressed(const void *buf, size_t len)
+{
+	return len >= 4 && zstd_read32(buf) == ZSTD_MAGIC;
+}
+
+int zstd_decompress(const void *src, size_t src_size, void *dst,
+		    size_t dst_size, size_t *out_len)
+{
+	const unsigned char *p = src, *end = p + src_size;
+	struct zstd_dctx *d;
+	uint32_t magic;
+	int ret = 0;
+
+	if (!zstd_is_compressed(src, src_size))
+		return ERR_NOT_VALID;
+
+	d = malloc(sizeof(*d));
+	if (!d)
+		return ERR_NO_MEMORY;
+
+	d->out.start = dst;
+	d->out.pos = dst;
+	d->out.end = (unsigned char *)dst + dst_size;
+
+	/* Concatenated frames are decompressed one after another */
+	while (end - p >= 4) {
+		magic = zstd_read32(p);
+		if (magic == ZSTD_MAGIC) {
+			ret = zstd_frame(d, p, end - p);
+		} else if ((magic & ZSTD_SKIP_MASK) == ZSTD_SKIP_MAGIC) {
+			if (end - p < 8 || zstd_read32(p + 4) > (size_t)(end - p - 8))
+				ret = ERR_NOT_VALID;
+			else
+				ret = 8 + zstd_read32(p + 4);
+		} else {
+			/* e.g. the size appended by the kernel build */
+			ret = 0;
+			break;
+		}
+
+		if (ret < 0)
+			break;
+		p += ret;
+		ret = 0;
+	}
+
+	*out_len = d->out.pos - d->out.start;
+	free(d);
+	return ret;
+}
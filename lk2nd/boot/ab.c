@@ -23,6 +23,7 @@
  * Optional configuration via extlinux.conf (global directives):
  *   ab_env_part <partition>
  *   ab_env_offset <bytes>
+ *   ab_env_offset_redund <bytes>  (second copy of a redundant env)
  *   ab_env_size <bytes>
  *   ab_slot_offset_a <bytes>
  *   ab_slot_offset_b <bytes>
@@ -48,6 +49,7 @@ static struct {
 	struct uboot_env env;
 	char partition[64];
 	uint64_t offset;
+	uint64_t offset_redund;
 	size_t size;
 	bool initialized;
 	char current_slot;  /* Cached current boot slot */
@@ -159,9 +161,11 @@ static bool resolve_base_device(const char *spec, char *out, size_t out_len)
  * Initialize A/B boot from U-Boot environment
  * partition: Name of partition containing uboot.env (typically "userdata")
  * offset: Byte offset within partition where uboot.env starts
+ * offset_redund: Byte offset of the redundant copy (0 = single copy)
  * size: Size of uboot.env in bytes (typically 0x20000 / 128KB)
  */
-void lk2nd_boot_ab_init(const char *partition, uint64_t offset, size_t size)
+void lk2nd_boot_ab_init(const char *partition, uint64_t offset, uint64_t offset_redund,
+			size_t size)
 {
 	int ret;
 	char resolved[64];
@@ -184,10 +188,10 @@ void lk2nd_boot_ab_init(const char *partition, uint64_t offset, size_t size)
 		return;
 	}
 
-	dprintf(INFO, "Initializing RAUC-style A/B boot from %s (resolved from '%s') at offset 0x%llx (size: 0x%zx)\n",
-		resolved, partition, offset, size);
+	dprintf(INFO, "Initializing RAUC-style A/B boot from %s (resolved from '%s') at offset 0x%llx/0x%llx (size: 0x%zx)\n",
+		resolved, partition, offset, offset_redund, size);
 
-	ret = uboot_env_init(&ab_state.env, resolved, offset, size);
+	ret = uboot_env_init(&ab_state.env, resolved, offset, offset_redund, size);
 	if (ret < 0) {
 		dprintf(CRITICAL, "A/B boot: Failed to initialize U-Boot environment: %d\n", ret);
 		return;
@@ -195,6 +199,7 @@ void lk2nd_boot_ab_init(const char *partition, uint64_t offset, size_t size)
 
 	strlcpy(ab_state.partition, resolved, sizeof(ab_state.partition));
 	ab_state.offset = offset;
+	ab_state.offset_redund = offset_redund;
 	ab_state.size = size;
 	ab_state.initialized = true;
 
@@ -236,7 +241,8 @@ int lk2nd_boot_ab_ensure_init(void)
 #ifdef LK2ND_AB_BOOT
 	if (!ab_state.initialized) {
 		lk2nd_boot_ab_set_offsets(LK2ND_AB_SLOT_OFFSET_A, LK2ND_AB_SLOT_OFFSET_B);
-		lk2nd_boot_ab_init(xstr(LK2ND_AB_ENV_PART), LK2ND_AB_ENV_OFFSET, LK2ND_AB_ENV_SIZE);
+		lk2nd_boot_ab_init(xstr(LK2ND_AB_ENV_PART), LK2ND_AB_ENV_OFFSET,
+				   LK2ND_AB_ENV_OFFSET_REDUND, LK2ND_AB_ENV_SIZE);
 	}
 #endif
 	return ab_state.initialized ? 0 : -1;
@@ -278,7 +284,7 @@ int lk2nd_boot_ab_env_save(void)
 	if (!ab_state.initialized)
 		return -1;
 
-	ret = uboot_env_save(&ab_state.env, ab_state.partition, ab_state.offset);
+	ret = uboot_env_save(&ab_state.env, ab_state.partition);
 	if (ret == 0 && !ab_state.env_valid) {
 		/* The env on storage is valid now; re-derive the A/B state */
 		ab_state.env_valid = true;
@@ -345,8 +351,8 @@ void lk2nd_boot_ab_pre_boot(void)
 		}
 	}
 
-	/* Save state before booting (critical for boot counting) */
-	uboot_env_save(&ab_state.env, ab_state.partition, ab_state.offset);
+	/* Save state before booting (critical for boot counting), skipped if unchanged */
+	uboot_env_save(&ab_state.env, ab_state.partition);
 }
 
 /* Return the base device name used for boot (same as U-Boot env partition) */
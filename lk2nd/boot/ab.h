@@ -15,7 +15,8 @@
  */
 
 /* Initialize A/B boot system with U-Boot environment location */
-void lk2nd_boot_ab_init(const char *partition, uint64_t offset, size_t size);
+void lk2nd_boot_ab_init(const char *partition, uint64_t offset, uint64_t offset_redund,
+			size_t size);
 
 /* Get current active boot slot ('A'/'B') based on BOOT_ORDER and counters,
  * or '\0' if A/B is not initialized */
@@ -2,6 +2,7 @@
 /* Copyright (c) 2023 Nikita Travkin <nikita@trvn.ru> */
 
 #include <debug.h>
+#include <err.h>
 #include <lib/bio.h>
 #include <lib/fs.h>
 #include <list.h>
@@ -10,6 +11,7 @@
 
 #include <lk2nd/boot.h>
 #include <lk2nd/hw/bdev.h>
+#include <lk2nd/timeline.h>
 
 #include "ab.h"
 #include "boot.h"
@@ -19,20 +21,17 @@
 #endif
 
 /**
- * lk2nd_mount() - Mount a device on mountpoint, trying all supported
- * filesystems (ext2/3/4 and FAT).
+ * lk2nd_mount() - Mount a device on mountpoint with the filesystem found
+ * on it (ext2/3/4, EROFS, FAT or squashfs).
  */
 static int lk2nd_mount(const char *mountpoint, const char *device)
 {
-	static const char * const filesystems[] = { "ext2", "fat" };
-	unsigned int i;
-	int ret = -1;
+	unsigned int stage;
+	int ret;
 
-	for (i = 0; i < ARRAY_SIZE(filesystems); i++) {
-		ret = fs_mount(mountpoint, filesystems[i], device);
-		if (ret >= 0)
-			return ret;
-	}
+	stage = lk2nd_timeline_begin("mount", device);
+	ret = fs_mount_auto(mountpoint, device);
+	lk2nd_timeline_end(stage);
 
 	return ret;
 }
@@ -42,11 +41,37 @@ static int lk2nd_mount(const char *mountpoint, const char *device)
  *
  * Returns only if no kernel was launched.
  */
+static void lk2nd_try_boot_bdev(bdev_t *bdev);
+
+/* Try the partitions that were just found inside of @parent */
+static void lk2nd_try_boot_subdevices(bdev_t *parent)
+{
+	struct bdev_struct *bdevs = bio_get_bdevs();
+	size_t len = strlen(parent->name);
+	bdev_t *bdev;
+
+	list_for_every_entry(&bdevs->list, bdev, bdev_t, node) {
+		if (bdev->is_leaf && !strncmp(bdev->name, parent->name, len) &&
+		    bdev->name[len] == 'p')
+			lk2nd_try_boot_bdev(bdev);
+	}
+}
+
 static void lk2nd_try_boot_bdev(bdev_t *bdev)
 {
 	char mountpoint[128];
 	int ret;
 
+	/*
+	 * Nested partition tables are only looked at once the scan gets here.
+	 * The new partitions are added at the head of the list, so the scan
+	 * would not see them anymore.
+	 */
+	if (lk2nd_bdev_probe_partitions(bdev) > 0) {
+		lk2nd_try_boot_subdevices(bdev);
+		return;
+	}
+
 	/*
 	 * Skip partitions that are too small to have a boot fs on.
 	 *
@@ -69,9 +94,103 @@ static void lk2nd_try_boot_bdev(bdev_t *bdev)
 		lk2nd_print_file_tree(mountpoint, " ");
 	}
 
+	/* Remember eMMC partitions with a config to try them first next time */
+	if (strncmp(bdev->name, "mmc", 3)) {
+		char path[160];
+		filehandle *fileh;
+
+		snprintf(path, sizeof(path), "%s/extlinux/extlinux.conf", mountpoint);
+		if (fs_open_file(path, &fileh) >= 0) {
+			fs_close_file(fileh);
+			lk2nd_boot_hint_save(bdev);
+		}
+	}
+
 	lk2nd_try_extlinux(mountpoint);
 }
 
+/*
+ * A/B slot subdevices and their mounts are kept after a failed attempt,
+ * so retrying a slot (e.g. on the next lk2nd_boot() call) or falling back
+ * to it again only costs a lookup instead of a publish/mount cycle.
+ */
+struct ab_slot_mount {
+	uint64_t offset;
+	bool mounted;
+};
+
+static struct ab_slot_mount ab_slot_mounts[2];
+
+/**
+ * lk2nd_mount_ab_slot() - Publish and mount the subdevice for an A/B slot.
+ *
+ * Returns: 0 if the slot is mounted on @mountpoint, negative otherwise.
+ */
+static int lk2nd_mount_ab_slot(const char *base_device, char slot, uint64_t offset,
+			       char *mountpoint, size_t mountpoint_len)
+{
+	struct ab_slot_mount *m = &ab_slot_mounts[slot == 'B'];
+	char subdev_name[16];
+	bdev_t *bdev;
+	bnum_t start_block;
+	size_t subdev_len;
+	int ret;
+
+	/* Per-slot name so retries don't clash */
+	snprintf(subdev_name, sizeof(subdev_name), "ab-slot-%c", slot);
+	snprintf(mountpoint, mountpoint_len, "/%s", subdev_name);
+
+	if (m->mounted) {
+		if (m->offset == offset)
+			return 0;
+
+		/* The slot offset was changed in the env, start over */
+		m->mounted = false;
+	}
+
+	/* Drop a subdevice left over from a failed mount or an old offset */
+	fs_invalidate(subdev_name);
+	bdev = bio_open(subdev_name);
+	if (bdev) {
+		bio_unregister_device(bdev);
+		bio_close(bdev);
+	}
+
+	bdev = bio_open(base_device);
+	if (!bdev) {
+		dprintf(CRITICAL, "boot: Failed to open base device '%s'\n", base_device);
+		return -1;
+	}
+
+	start_block = offset / bdev->block_size;
+	subdev_len = bdev->block_count - start_block;
+	bio_close(bdev);
+
+	ret = bio_publish_subdevice(base_device, subdev_name, start_block, subdev_len);
+	if (ret < 0) {
+		dprintf(CRITICAL, "boot: Failed to create subdevice for slot %c: %d\n", slot, ret);
+		return ret;
+	}
+
+	dprintf(INFO, "boot: Mounting slot %c: subdevice '%s' at block %u\n",
+		slot, subdev_name, (unsigned)start_block);
+
+	ret = lk2nd_mount(mountpoint, subdev_name);
+	if (ret < 0) {
+		dprintf(CRITICAL, "boot: Failed to mount slot %c subdevice '%s'\n", slot, subdev_name);
+		return ret;
+	}
+
+	if (DEBUGLEVEL >= SPEW) {
+		dprintf(SPEW, "Scanning %s ...\n", subdev_name);
+		lk2nd_print_file_tree(mountpoint, " ");
+	}
+
+	m->offset = offset;
+	m->mounted = true;
+	return 0;
+}
+
 /**
  * lk2nd_scan_devices() - Scan filesystems and try to boot
  */
@@ -79,11 +198,10 @@ static void lk2nd_scan_devices(void)
 {
 	struct bdev_struct *bdevs = bio_get_bdevs();
 	char mountpoint[128];
-	bdev_t *bdev;
+	bdev_t *bdev, *hint;
 	int ret;
 	const char *base_device = NULL;
 	uint64_t target_offset = 0;
-	char subdev_name[64];
 	bool sd_tried = false;
 
 	dprintf(INFO, "boot: Trying to boot from the file system...\n");
@@ -132,7 +250,7 @@ static void lk2nd_scan_devices(void)
 			/*
 			 * Try each slot until one boots. lk2nd_try_extlinux()
 			 * only returns if no kernel was launched, so on return we
-			 * unmount and move on to the next slot.
+			 * move on to the next slot. The slot stays mounted.
 			 */
 			do {
 				char slot = lk2nd_boot_ab_get_slot();
@@ -145,45 +263,20 @@ static void lk2nd_scan_devices(void)
 					continue;
 				}
 
-				bdev_t *parent_bdev = bio_open(base_device);
-				if (!parent_bdev) {
-					dprintf(CRITICAL, "boot: Failed to open base device '%s'\n", base_device);
-					break;
-				}
-
-				size_t block_size = parent_bdev->block_size;
-				bnum_t start_block = target_offset / block_size;
-				size_t subdev_len = parent_bdev->block_count - start_block;
-				bio_close(parent_bdev);
-
-				/* Per-slot name so retries don't clash */
-				snprintf(subdev_name, sizeof(subdev_name), "ab-slot-%c", slot);
-
-				ret = bio_publish_subdevice(base_device, subdev_name, start_block, subdev_len);
-				if (ret < 0) {
-					dprintf(CRITICAL, "boot: Failed to create subdevice for slot %c: %d\n", slot, ret);
+				if (lk2nd_mount_ab_slot(base_device, slot, target_offset,
+							mountpoint, sizeof(mountpoint)) < 0)
 					continue;
-				}
-
-				dprintf(INFO, "boot: Trying slot %c: subdevice '%s' at block %u\n",
-					slot, subdev_name, (unsigned)start_block);
 
-				snprintf(mountpoint, sizeof(mountpoint), "/%s", subdev_name);
-				ret = lk2nd_mount(mountpoint, subdev_name);
-				if (ret < 0) {
-					dprintf(CRITICAL, "boot: Failed to mount slot %c subdevice '%s'\n", slot, subdev_name);
+				/* Don't touch the boot counter of a slot that can't boot */
+				if (!lk2nd_probe_extlinux(mountpoint)) {
+					dprintf(CRITICAL, "boot: Slot %c is not bootable\n", slot);
 					continue;
 				}
 
-				if (DEBUGLEVEL >= SPEW) {
-					dprintf(SPEW, "Scanning %s ...\n", subdev_name);
-					lk2nd_print_file_tree(mountpoint, " ");
-				}
-
+				dprintf(INFO, "boot: Trying slot %c\n", slot);
 				lk2nd_try_extlinux(mountpoint);
 
 				dprintf(CRITICAL, "boot: Slot %c did not boot\n", slot);
-				fs_unmount(mountpoint);
 
 			} while (lk2nd_boot_ab_advance_slot());
 
@@ -207,6 +300,13 @@ static void lk2nd_scan_devices(void)
 		return;
 	}
 
+	/* Try the partition that had extlinux.conf on the last boot first */
+	hint = lk2nd_boot_hint_get();
+	if (hint) {
+		dprintf(INFO, "boot: Trying %s from the last boot first\n", hint->name);
+		lk2nd_try_boot_bdev(hint);
+	}
+
 	/* Fallback: scan all devices as before (non-A/B mode) */
 	list_for_every_entry(&bdevs->list, bdev, bdev_t, node) {
 
@@ -218,12 +318,81 @@ static void lk2nd_scan_devices(void)
 		if (!strncmp(bdev->name, "mmc", 3))
 			continue;
 
+		if (bdev == hint)
+			continue;
+
 		lk2nd_try_boot_bdev(bdev);
 	}
 
+	if (hint)
+		bio_close(hint);
+
 	dprintf(INFO, "boot: Bootable file system not found. Reverting to android boot.\n");
 }
 
+/**
+ * lk2nd_boot_init() - Find the block devices to boot from, once.
+ */
+void lk2nd_boot_init(void)
+{
+	static bool init_done = false;
+	unsigned int stage;
+
+	if (init_done)
+		return;
+
+	stage = lk2nd_timeline_begin("bdev", NULL);
+	lk2nd_bdev_init();
+	lk2nd_timeline_end(stage);
+	init_done = true;
+}
+
+/**
+ * lk2nd_boot_find_root() - Mount the file system that is tried first.
+ * @mountpoint: Returns where it was mounted
+ *
+ * This is the current A/B slot or the partition from the last boot. There
+ * is no single one if an SD card is inserted, since all of its partitions
+ * are scanned first.
+ *
+ * Returns: 0 on success or negative error.
+ */
+int lk2nd_boot_find_root(char *mountpoint, size_t len)
+{
+	struct bdev_struct *bdevs = bio_get_bdevs();
+	const char *base_device;
+	uint64_t offset;
+	bdev_t *bdev;
+	int ret;
+
+	lk2nd_boot_init();
+
+	list_for_every_entry(&bdevs->list, bdev, bdev_t, node)
+		if (bdev->is_leaf && !strncmp(bdev->name, "mmc", 3))
+			return ERR_NOT_FOUND;
+
+	lk2nd_boot_ab_ensure_init();
+	base_device = lk2nd_boot_ab_get_base_device();
+	if (base_device) {
+		offset = lk2nd_boot_ab_get_offset();
+		if (offset > 0)
+			return lk2nd_mount_ab_slot(base_device, lk2nd_boot_ab_get_slot(),
+						   offset, mountpoint, len);
+
+		snprintf(mountpoint, len, "/%s", base_device);
+		return lk2nd_mount(mountpoint, base_device);
+	}
+
+	bdev = lk2nd_boot_hint_get();
+	if (!bdev)
+		return ERR_NOT_FOUND;
+
+	snprintf(mountpoint, len, "/%s", bdev->name);
+	ret = lk2nd_mount(mountpoint, bdev->name);
+	bio_close(bdev);
+	return ret;
+}
+
 /**
  * lk2nd_boot() - Try to boot the OS.
  *
@@ -233,12 +402,15 @@ static void lk2nd_scan_devices(void)
  */
 void lk2nd_boot(void)
 {
-	static bool init_done = false;
+	unsigned int stage;
 
-	if (!init_done) {
-		lk2nd_bdev_init();
-		init_done = true;
-	}
+	lk2nd_boot_preload_wait();
+	lk2nd_boot_init();
 
+	stage = lk2nd_timeline_begin("scan", NULL);
 	lk2nd_scan_devices();
+	lk2nd_timeline_end(stage);
+
+	/* Nothing booted, the preloaded files are not needed anymore */
+	lk2nd_boot_preload_discard();
 }
@@ -2,15 +2,174 @@
 #ifndef LK2ND_BOOT_BOOT_H
 #define LK2ND_BOOT_BOOT_H
 
+#include <kernel/event.h>
+#include <lib/bio.h>
 #include <list.h>
 #include <string.h>
 
 #include <lk2nd/boot.h>
 
+/* boot.c */
+void lk2nd_boot_init(void);
+int lk2nd_boot_find_root(char *mountpoint, size_t len);
+
 /* util.c */
 void lk2nd_print_file_tree(char *root, char *prefix);
 
+/* hint.c */
+bdev_t *lk2nd_boot_hint_get(void);
+void lk2nd_boot_hint_save(bdev_t *bdev);
+uint32_t lk2nd_boot_hint_dtb_key(const void *conf, size_t len, const char *root);
+const char *lk2nd_boot_hint_get_dtb(uint32_t key);
+void lk2nd_boot_hint_save_dtb(uint32_t key, const char *path);
+
+/* extlinux-conf.c */
+struct label {
+	const char *name;
+	const char *kernel;
+	const char **initramfs;
+	const char *dtb;
+	const char *dtbdir;
+	const char **dtboverlays;
+	const char *cmdline;
+	const char *splash;
+};
+
+int lk2nd_parse_extlinux_conf(char *data, size_t size, struct label *label);
+
 /* extlinux.c */
+#define MAX_TAGS_SIZE			(2 * 1024 * 1024)
+
+struct load_addrs {
+	void *kernel;
+	void *tags;
+	void *ramdisk;
+	uint32_t kernel_max_size;
+	uint32_t ramdisk_max_size;
+};
+
+struct kernel64_hdr;
+
+void choose_addrs(const struct kernel64_hdr *kptr, uint32_t ramdisk_size, struct load_addrs *addrs);
+bool kernel_fits(const struct kernel64_hdr *kptr, uint64_t size,
+		 const struct load_addrs *addrs);
+int lk2nd_read_extlinux(const char *root, struct label *label);
 void lk2nd_try_extlinux(const char *mountpoint);
+bool lk2nd_probe_extlinux(const char *mountpoint);
+
+/* fit.c */
+struct filehandle;
+
+/**
+ * struct fit_image - Image of the selected FIT configuration.
+ * @fit:    FIT tree the image is described in
+ * @name:   Name of the image node
+ * @node:   Offset of the image node in @fit
+ * @offset: Position of the data in the FIT file
+ * @size:   Size of the data
+ */
+struct fit_image {
+	const void *fit;
+	const char *name;
+	int node;
+	off_t offset;
+	uint32_t size;
+};
+
+#define FIT_MAX_FDTS			8
+
+/**
+ * struct fit_config - Images of the selected FIT configuration.
+ * @fit:       FIT tree, read from the start of the file
+ * @kernel:    Kernel image
+ * @ramdisk:   Ramdisk image, size 0 if there is none
+ * @fdts:      Base dtb followed by the overlays to apply
+ * @fdt_count: Number of dtbs in @fdts, at least one
+ */
+struct fit_config {
+	void *fit;
+	struct fit_image kernel;
+	struct fit_image ramdisk;
+	struct fit_image fdts[FIT_MAX_FDTS];
+	unsigned int fdt_count;
+};
+
+bool lk2nd_fit_detect(const char *path);
+int lk2nd_fit_open(struct filehandle *fileh, off_t size, struct fit_config *cfg);
+int lk2nd_fit_verify(const struct fit_image *img, const void *data);
+void lk2nd_fit_close(struct fit_config *cfg);
+
+/* loader.c */
+/*
+ * Several initramfs files are concatenated like the cpio archives they are.
+ * The kernel skips zeros between archives that start 4-byte aligned.
+ */
+#define INITRAMFS_ALIGN			4
+
+/**
+ * struct load_file - File read by the loader thread.
+ * @path:     Path of the file, or name of the data on @bdev
+ * @fileh:    Opened file
+ * @bdev:     Block device to read from instead of @fileh
+ * @offset:   Position of the data in the file or on @bdev
+ * @size:     Size of the data
+ * @fit:      FIT image the data is verified against, or NULL
+ * @buf:      Destination, at least @size bytes
+ * @done:     Amount of data in @buf so far, or negative error
+ */
+struct load_file {
+	const char *path;
+	struct filehandle *fileh;
+	bdev_t *bdev;
+	off_t offset;
+	off_t size;
+	const struct fit_image *fit;
+	void *buf;
+	volatile ssize_t done;
+};
+
+/**
+ * struct loader - Reads all files of a label in the background.
+ * @files:    Files in the order they are read
+ * @count:    Number of files
+ * @progress: Signalled whenever more data is available
+ * @finished: Signalled once all files are read
+ *
+ * All file reads are queued up front and done one after another by a
+ * separate thread, so the boot thread can decompress the kernel while
+ * the other files (most importantly the initramfs) are still loading.
+ * Only the loader thread accesses the filesystem while it is running.
+ */
+struct loader {
+	struct load_file *files;
+	unsigned count;
+	event_t progress;
+	event_t finished;
+};
+
+enum kernel_format {
+	KERNEL_RAW,
+	KERNEL_GZIP,
+	KERNEL_LZ4,
+	KERNEL_ZSTD,
+};
+
+int loader_open(struct loader *l, const char **paths, unsigned count);
+int loader_open_fit(struct loader *l, const char *path, struct fit_config *cfg);
+void loader_start(struct loader *l);
+ssize_t loader_wait(struct loader *l, struct load_file *f, off_t len);
+void loader_finish(struct loader *l, bool started);
+int loader_verify(struct load_file *f);
+int probe_kernel(struct load_file *f, uint32_t ramdisk_size,
+		 struct load_addrs *addrs);
+int load_kernel(struct loader *l, struct load_file *f,
+		enum kernel_format format, uint32_t ramdisk_size,
+		struct load_addrs *addrs, unsigned int *kernel_size);
+
+/* preload.c */
+bool lk2nd_boot_preload_copy(struct load_file *f);
+
+/* splash.c */
+void lk2nd_boot_splash(const char *path);
 
 #endif /* LK2ND_BOOT_BOOT_H */
@@ -0,0 +1,401 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <boot.h>
+#include <debug.h>
+#include <err.h>
+#include <lib/bio.h>
+#include <libfdt.h>
+#include <platform.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../app/aboot/bootimg.h"
+
+#include <lk2nd/boot.h>
+#include <lk2nd/device.h>
+#include <lk2nd/util/region.h>
+
+#include "boot.h"
+
+/*
+ * Android boot images with header version 3 and 4 only hold the generic
+ * kernel and ramdisk. The board specific parts (dtb, vendor ramdisk and
+ * cmdline) are in a separate vendor_boot partition:
+ *
+ * boot:                          vendor_boot:
+ * +-----------------+            +------------------------+
+ * | boot header     | 4096       | vendor header          | page_size aligned
+ * +-----------------+            +------------------------+
+ * | kernel          |            | vendor ramdisk         |
+ * +-----------------+            +------------------------+
+ * | ramdisk         |            | dtb                    |
+ * +-----------------+            +------------------------+
+ * | signature (v4)  |            | ramdisk table (v4)     |
+ * +-----------------+            +------------------------+
+ *                                | bootconfig (v4)        |
+ *                                +------------------------+
+ *
+ * Every section is read straight to its load address, so unlike the
+ * older versions the image is never copied as a whole to the scratch
+ * memory first. Only compressed kernels are read to the scratch memory,
+ * gzip ones are inflated while they are still being read.
+ */
+#define BOOT_IMG_V3_PAGE_SIZE		4096
+#define BOOT_IMG_V3_ARGS_SIZE		1536
+#define VENDOR_BOOT_MAGIC		"VNDRBOOT"
+#define VENDOR_BOOT_MAGIC_SIZE		8
+#define VENDOR_BOOT_ARGS_SIZE		2048
+#define VENDOR_BOOT_NAME_SIZE		16
+
+struct boot_img_hdr_v3 {
+	uint8_t magic[BOOT_MAGIC_SIZE];
+	uint32_t kernel_size;
+	uint32_t ramdisk_size;
+	uint32_t os_version;
+	uint32_t header_size;
+	/* Zero where older headers have the addresses and the page size */
+	uint32_t reserved[4];
+	uint32_t header_version;
+	char cmdline[BOOT_IMG_V3_ARGS_SIZE];
+	/* v4: uint32_t signature_size; */
+} __PACKED;
+
+struct vendor_boot_img_hdr_v3 {
+	uint8_t magic[VENDOR_BOOT_MAGIC_SIZE];
+	uint32_t header_version;
+	uint32_t page_size;
+	uint32_t kernel_addr;
+	uint32_t ramdisk_addr;
+	uint32_t vendor_ramdisk_size;
+	char cmdline[VENDOR_BOOT_ARGS_SIZE];
+	uint32_t tags_addr;
+	uint8_t name[VENDOR_BOOT_NAME_SIZE];
+	uint32_t header_size;
+	uint32_t dtb_size;
+	uint64_t dtb_addr;
+	/* v4: ramdisk table and bootconfig sizes, not used here */
+} __PACKED;
+
+extern void boot_linux(void *kernel, unsigned *tags,
+		const char *cmdline, unsigned machtype,
+		void *ramdisk, unsigned ramdisk_size,
+		enum boot_type boot_type);
+
+enum bootimg_part {
+	BOOTIMG_KERNEL,
+	BOOTIMG_DTB,
+	BOOTIMG_VENDOR_RAMDISK,
+	BOOTIMG_RAMDISK,
+	BOOTIMG_COUNT,
+};
+
+/**
+ * lk2nd_bootimg_is_v3() - Check if a boot image has a v3 or newer header.
+ * @hdr: First page of the boot image, with a valid magic
+ *
+ * These headers have the header version at the same offset as the newer
+ * v0 headers, but v0 has the page size right before it, which is always
+ * set and reserved in v3.
+ */
+bool lk2nd_bootimg_is_v3(const void *hdr)
+{
+	const struct boot_img_hdr_v3 *v3 = hdr;
+
+	return v3->header_version >= 3 && !v3->reserved[3];
+}
+
+static int bootimg_read_hdr(bdev_t *bdev, void *hdr, size_t len)
+{
+	if (bio_read(bdev, hdr, 0, len) != (ssize_t)len)
+		return ERR_IO;
+	return 0;
+}
+
+/* Add a section of a partition to the loader, checking that it is there */
+static int bootimg_add(bdev_t *bdev, struct load_file *f, const char *name,
+		       off_t offset, uint32_t size)
+{
+	if (offset + size > bdev->size) {
+		dprintf(INFO, "%s: %s is outside of the partition\n",
+			bdev->name, name);
+		return ERR_NOT_VALID;
+	}
+
+	f->path = name;
+	f->bdev = bdev;
+	f->offset = offset;
+	f->size = size;
+	return 0;
+}
+
+/* libfdt only works on 8-byte aligned trees, check others on a copy */
+static bool bootimg_dtb_matches(const void *dtb, uint32_t len, const char *compatible)
+{
+	void *copy;
+	bool match;
+
+	if (!((uintptr_t)dtb & 7))
+		return fdt_node_check_compatible(dtb, 0, compatible) == 0;
+
+	copy = memalign(8, len);
+	if (!copy)
+		return false;
+
+	memcpy(copy, dtb, len);
+	match = fdt_node_check_compatible(copy, 0, compatible) == 0;
+	free(copy);
+	return match;
+}
+
+/**
+ * bootimg_select_dtb() - Pick the dtb of the device from the dtb section.
+ * @dtbs: dtb section, several dtbs may be concatenated
+ * @size: Size of the section
+ *
+ * The dtb with the compatible of the device is moved to the start of
+ * @dtbs, otherwise the first one is used.
+ *
+ * Returns: 0 on success or negative error.
+ */
+static int bootimg_select_dtb(void *dtbs, uint32_t size)
+{
+	const char *compatible = lk2nd_device_get_compatible();
+	struct fdt_header hdr __ALIGNED(8);
+	uint32_t pos = 0, len;
+	unsigned int count = 0;
+	void *dtb;
+
+	while (pos + sizeof(hdr) <= size) {
+		dtb = (char *)dtbs + pos;
+		memcpy(&hdr, dtb, sizeof(hdr));
+		if (fdt_magic(&hdr) != FDT_MAGIC)
+			break;
+
+		len = fdt_totalsize(&hdr);
+		if (len < sizeof(hdr) || len > size - pos)
+			break;
+
+		if (compatible && bootimg_dtb_matches(dtb, len, compatible)) {
+			if (pos)
+				memmove(dtbs, dtb, len);
+			return 0;
+		}
+		pos += ROUNDUP(len, 4);
+		count++;
+	}
+
+	if (!count || fdt_check_header(dtbs)) {
+		dprintf(INFO, "No valid dtb in vendor_boot\n");
+		return ERR_NOT_VALID;
+	}
+
+	if (count > 1)
+		dprintf(INFO, "No dtb for %s in vendor_boot, using the first one\n",
+			compatible ? compatible : "this device");
+	return 0;
+}
+
+/* The vendor cmdline comes first so that the generic one can override it */
+static char *bootimg_cmdline(const struct vendor_boot_img_hdr_v3 *vhdr,
+			     const struct boot_img_hdr_v3 *hdr)
+{
+	size_t vlen = strnlen(vhdr->cmdline, sizeof(vhdr->cmdline));
+	size_t len = strnlen(hdr->cmdline, sizeof(hdr->cmdline));
+	char *cmdline;
+
+	cmdline = malloc(vlen + 1 + len + 1);
+	if (!cmdline)
+		return NULL;
+
+	memcpy(cmdline, vhdr->cmdline, vlen);
+	cmdline[vlen] = ' ';
+	memcpy(cmdline + vlen + 1, hdr->cmdline, len);
+	cmdline[vlen + 1 + len] = 0;
+	return cmdline;
+}
+
+/**
+ * lk2nd_boot_bootimg_v3() - Boot an Android boot image with a v3/v4 header.
+ * @ptn_name: Partition with the boot image, "boot" or "recovery"
+ *
+ * The sections are read by the loader in the order kernel, dtb, vendor
+ * ramdisk and ramdisk while the kernel is decompressed. The addresses are
+ * chosen like for extlinux, the ones in the headers are ignored. Only
+ * returns if booting failed.
+ *
+ * Returns: Negative error.
+ */
+int lk2nd_boot_bootimg_v3(const char *ptn_name)
+{
+	struct boot_img_hdr_v3 *hdr = NULL;
+	struct vendor_boot_img_hdr_v3 *vhdr = NULL;
+	bdev_t *bdev, *vbdev = NULL;
+	struct loader loader = {0};
+	struct load_file *files, *f;
+	struct load_addrs addrs;
+	unsigned int kernel_size, ramdisk_size, i;
+	bool started = false;
+	char *cmdline = NULL;
+	void *scratch = NULL;
+	uint32_t page_size;
+	off_t offset;
+	int ret, format;
+
+	bdev = bio_open_by_label(ptn_name);
+	if (!bdev) {
+		dprintf(CRITICAL, "No %s partition found\n", ptn_name);
+		return ERR_NOT_FOUND;
+	}
+
+	vbdev = bio_open_by_label("vendor_boot");
+	if (!vbdev) {
+		dprintf(CRITICAL, "Boot image v3 needs a vendor_boot partition\n");
+		ret = ERR_NOT_FOUND;
+		goto out;
+	}
+
+	hdr = memalign(CACHE_LINE, ROUNDUP(sizeof(*hdr), CACHE_LINE));
+	vhdr = memalign(CACHE_LINE, ROUNDUP(sizeof(*vhdr), CACHE_LINE));
+	files = calloc(BOOTIMG_COUNT, sizeof(*files));
+	if (!hdr || !vhdr || !files) {
+		free(files);
+		ret = ERR_NO_MEMORY;
+		goto out;
+	}
+	loader.files = files;
+	loader.count = BOOTIMG_COUNT;
+
+	ret = bootimg_read_hdr(bdev, hdr, sizeof(*hdr));
+	if (ret >= 0)
+		ret = bootimg_read_hdr(vbdev, vhdr, sizeof(*vhdr));
+	if (ret < 0) {
+		dprintf(CRITICAL, "Failed to read the boot image headers\n");
+		goto out;
+	}
+
+	if (memcmp(vhdr->magic, VENDOR_BOOT_MAGIC, VENDOR_BOOT_MAGIC_SIZE) ||
+	    vhdr->header_version != hdr->header_version || !vhdr->page_size) {
+		dprintf(CRITICAL, "Invalid vendor_boot header\n");
+		ret = ERR_NOT_VALID;
+		goto out;
+	}
+
+	dprintf(INFO, "Boot image header v%u\n", hdr->header_version);
+
+	offset = BOOT_IMG_V3_PAGE_SIZE;
+	ret = bootimg_add(bdev, &files[BOOTIMG_KERNEL], "kernel",
+			  offset, hdr->kernel_size);
+	offset += ROUNDUP((off_t)hdr->kernel_size, BOOT_IMG_V3_PAGE_SIZE);
+	if (ret >= 0)
+		ret = bootimg_add(bdev, &files[BOOTIMG_RAMDISK], "ramdisk",
+				  offset, hdr->ramdisk_size);
+
+	page_size = vhdr->page_size;
+	offset = ROUNDUP((off_t)vhdr->header_size, page_size);
+	if (ret >= 0)
+		ret = bootimg_add(vbdev, &files[BOOTIMG_VENDOR_RAMDISK], "vendor_ramdisk",
+				  offset, vhdr->vendor_ramdisk_size);
+	offset += ROUNDUP((off_t)vhdr->vendor_ramdisk_size, page_size);
+	if (ret >= 0)
+		ret = bootimg_add(vbdev, &files[BOOTIMG_DTB], "dtb",
+				  offset, vhdr->dtb_size);
+	if (ret < 0)
+		goto out;
+
+	if (!hdr->kernel_size || !vhdr->dtb_size) {
+		dprintf(CRITICAL, "Boot image without kernel or dtb\n");
+		ret = ERR_NOT_VALID;
+		goto out;
+	}
+	if (vhdr->dtb_size >= MAX_TAGS_SIZE) {
+		dprintf(CRITICAL, "DTB is too big\n");
+		ret = ERR_TOO_BIG;
+		goto out;
+	}
+
+	cmdline = bootimg_cmdline(vhdr, hdr);
+	if (!cmdline) {
+		ret = ERR_NO_MEMORY;
+		goto out;
+	}
+
+	/* Both ramdisks are placed back to back, the vendor one first */
+	ramdisk_size = ROUNDUP(vhdr->vendor_ramdisk_size, INITRAMFS_ALIGN) +
+		       hdr->ramdisk_size;
+
+	f = &files[BOOTIMG_KERNEL];
+	format = probe_kernel(f, ramdisk_size, &addrs);
+	if (format < 0) {
+		dprintf(CRITICAL, "Failed to load the kernel: %d\n", format);
+		ret = format;
+		goto out;
+	}
+	if (format != KERNEL_RAW) {
+		scratch = lk2nd_region_alloc("bootimg", f->size);
+		if (!scratch) {
+			ret = ERR_NO_MEMORY;
+			goto out;
+		}
+		f->buf = scratch;
+	}
+
+	files[BOOTIMG_DTB].buf = addrs.tags;
+	files[BOOTIMG_VENDOR_RAMDISK].buf = addrs.ramdisk;
+	f = &files[BOOTIMG_RAMDISK];
+	offset = ROUNDUP(vhdr->vendor_ramdisk_size, INITRAMFS_ALIGN);
+	memset((char *)addrs.ramdisk + vhdr->vendor_ramdisk_size, 0,
+	       offset - vhdr->vendor_ramdisk_size);
+	f->buf = (char *)addrs.ramdisk + offset;
+
+	loader_start(&loader);
+	started = true;
+
+	ret = load_kernel(&loader, &files[BOOTIMG_KERNEL], format, ramdisk_size,
+			  &addrs, &kernel_size);
+	if (ret < 0) {
+		dprintf(CRITICAL, "Failed to load the kernel: %d\n", ret);
+		goto out;
+	}
+
+	f = &files[BOOTIMG_DTB];
+	ret = loader_wait(&loader, f, f->size);
+	if (ret >= 0)
+		ret = bootimg_select_dtb(f->buf, f->size);
+	if (ret < 0) {
+		dprintf(CRITICAL, "Failed to load the dtb: %d\n", ret);
+		goto out;
+	}
+
+	for (i = BOOTIMG_VENDOR_RAMDISK; i <= BOOTIMG_RAMDISK; i++) {
+		f = &files[i];
+		ret = loader_wait(&loader, f, f->size);
+		if (ret < 0) {
+			dprintf(CRITICAL, "Failed to load the %s: %d\n", f->path, ret);
+			goto out;
+		}
+	}
+
+	loader_finish(&loader, started);
+	if (scratch)
+		lk2nd_region_free(scratch);
+	bio_close(vbdev);
+	bio_close(bdev);
+	free(vhdr);
+	free(hdr);
+
+	boot_linux(addrs.kernel, addrs.tags, cmdline, board_machtype(),
+		   addrs.ramdisk, ramdisk_size, 0);
+	return ERROR;
+
+out:
+	loader_finish(&loader, started);
+	if (scratch)
+		lk2nd_region_free(scratch);
+	if (vbdev)
+		bio_close(vbdev);
+	bio_close(bdev);
+	free(cmdline);
+	free(vhdr);
+	free(hdr);
+	return ret;
+}
@@ -0,0 +1,465 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright (c) 2023 Nikita Travkin <nikita@trvn.ru> */
+
+#include <debug.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "ab.h"
+#include "boot.h"
+
+enum token {
+	CMD_LABEL,
+	CMD_DEFAULT,
+	CMD_KERNEL,
+	CMD_APPEND,
+	CMD_INITRD,
+	CMD_FDT,
+	CMD_FDTDIR,
+	CMD_FDTOVERLAY,
+	CMD_SPLASH,
+	/* Generic A/B directives */
+	CMD_AB_ENV_PART,
+	CMD_AB_ENV_OFFSET,
+	CMD_AB_ENV_OFFSET_REDUND,
+	CMD_AB_ENV_SIZE,
+	CMD_AB_SLOT_OFFSET_A,
+	CMD_AB_SLOT_OFFSET_B,
+	CMD_UNKNOWN,
+};
+
+static const struct {
+	char *command;
+	enum token token;
+} token_map[] = {
+	{"label", 		CMD_LABEL},
+	{"default", 		CMD_DEFAULT},
+	{"kernel", 		CMD_KERNEL},
+	{"linux", 		CMD_KERNEL},
+	{"fdtdir", 		CMD_FDTDIR},
+	{"devicetreedir", 	CMD_FDTDIR},
+	{"fdt", 			CMD_FDT},
+	{"devicetree", 		CMD_FDT},
+	{"fdtoverlays", 	CMD_FDTOVERLAY},
+	{"devicetree-overlay", 	CMD_FDTOVERLAY},
+	{"initrd", 		CMD_INITRD},
+	{"append", 		CMD_APPEND},
+	{"splash", 		CMD_SPLASH},
+	/* Generic A/B */
+	{"ab_env_part", 	CMD_AB_ENV_PART},
+	{"ab_env_offset", 	CMD_AB_ENV_OFFSET},
+	{"ab_env_offset_redund", CMD_AB_ENV_OFFSET_REDUND},
+	{"ab_env_size", 	CMD_AB_ENV_SIZE},
+	{"ab_slot_offset_a", 	CMD_AB_SLOT_OFFSET_A},
+	{"ab_slot_offset_b", 	CMD_AB_SLOT_OFFSET_B},
+};
+
+static enum token cmd_to_tok(char *command)
+{
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(token_map); i++)
+		if (!strcasecmp(command, token_map[i].command))
+			return token_map[i].token;
+
+	return CMD_UNKNOWN;
+}
+
+#ifndef EOF
+#define EOF -1
+#endif
+
+/* Parse unsigned 64-bit value from string (supports hex with 0x prefix) */
+static uint64_t parse_u64(const char *str)
+{
+	uint64_t val = 0;
+	int base = 10;
+
+	if (!str)
+		return 0;
+
+	/* Check for hex prefix */
+	if (str[0] == '0' && (str[1] == 'x' || str[1] == 'X')) {
+		base = 16;
+		str += 2;
+	}
+
+	while (*str) {
+		int digit;
+
+		if (*str >= '0' && *str <= '9')
+			digit = *str - '0';
+		else if (base == 16 && *str >= 'a' && *str <= 'f')
+			digit = *str - 'a' + 10;
+		else if (base == 16 && *str >= 'A' && *str <= 'F')
+			digit = *str - 'A' + 10;
+		else
+			break;
+
+		val = val * base + digit;
+		str++;
+	}
+
+	return val;
+}
+
+/**
+ * parse_list() - Split a value into a NULL-terminated array of strings.
+ * @val:   Value, modified to terminate the strings
+ * @delim: Characters that separate the strings
+ *
+ * Returns: Newly allocated array pointing into @val, or NULL.
+ */
+static const char **parse_list(char *val, const char *delim)
+{
+	char *item, *saveptr;
+	const char **list;
+	int cnt = 2;
+
+	for (char *c = val; *c; c++)
+		if (strchr(delim, *c))
+			cnt++;
+
+	list = calloc(cnt, sizeof(*list));
+	if (!list)
+		return NULL;
+
+	cnt = 0;
+	for (item = strtok_r(val, delim, &saveptr); item;
+	     item = strtok_r(NULL, delim, &saveptr))
+		list[cnt++] = item;
+
+	return list;
+}
+
+/**
+ * parse_char() - Get one char from the file.
+ * @data:    File contents
+ * @size:    remaining size of data
+ *
+ * Update pointers and return the next character.
+ *
+ * Returns: char value or EOF.
+ */
+static int parse_char(char **data, size_t *size)
+{
+	char c = **data;
+
+	if (*size == 0)
+		return EOF;
+
+	(*size)--;
+	(*data)++;
+
+	return c;
+}
+
+/**
+ * parse_line() - Read one command from the file.
+ * @data:    File contents
+ * @size:    remaining size of data
+ * @command: returns pointer to the command string
+ * @value:   returns pointer to the value string
+ *
+ * Function scans one line from the data blob, ignoring comments and
+ * whitespace; returns pointers to the start of the command and it's
+ * value after replacing whitespace and newline after them with \0.
+ * @data and @size will be updated to remove the parsed line(s).
+ *
+ * Returns: 0 on success, negative value on error or EOF.
+ */
+static int parse_command(char **data, size_t *size, char **command, char **value)
+{
+	int c;
+
+	/* Step 1: Ignore leading comments and whitespace. */
+
+	while (*size != 0 && (**data == '#' || **data == ' ' || **data == '\t' || **data == '\n')) {
+		/* Skip leading whitespace. */
+		while (*size != 0 && (**data == ' ' || **data == '\t' || **data == '\n')) {
+			c = parse_char(data, size);
+			if (c == EOF)
+				return -1;
+		}
+
+		if (*size != 0 && **data == '#') {
+			do {
+				c = parse_char(data, size);
+				if (c == EOF)
+					return -1;
+			} while (c != '\n');
+		}
+	}
+
+	if (*size == 0)
+		return -1;
+
+	/* Step 2: Read the command. */
+	*command = *data;
+	while (*size != 0 && **data != ' ' && **data != '\t' && **data != '\n') {
+		c = parse_char(data, size);
+		if (c == EOF)
+			return -1;
+	}
+
+	if (*size != 0 && (**data == ' ' || **data == '\t')) {
+		**data = '\0';
+		(*data)++;
+		(*size)--;
+	}
+
+	if (*size == 0 || **data == '\n')
+		return -1;
+
+	/* Step 3: Read the value. */
+
+	/* Skip whitespace. */
+	while (*size != 0 && (**data == ' ' || **data == '\t' || **data == '\n')) {
+		c = parse_char(data, size);
+		if (c == EOF || c == '\n')
+			return -1;
+	}
+
+	*value = *data;
+	while (*size != 0 && **data != '\n')
+		parse_char(data, size);
+
+	/* The last command may not have a newline. */
+	if (*size == 0 || **data == '\n') {
+		**data = '\0';
+		(*data)++;
+		(*size)--;
+	}
+
+	return 0;
+}
+
+/**
+ * count_lines() - Count the amount of lines in the string.
+ */
+static int count_lines(char *data, size_t size)
+{
+	int acc = 0;
+	size_t i;
+
+	for (i = 0; i < size; ++i) {
+		if (data[i] == '\n')
+			acc++;
+
+		if (data[i] == '\0')
+			break;
+	}
+
+	return acc;
+}
+
+/**
+ * lk2nd_parse_extlinux_conf() - Extract default label from extlinux.conf
+ * @data: File contents
+ * @size: Length of the file
+ * @label: structure to write strings to
+ *
+ * Find the default label in the file and extract strings from it.
+ * This function may destroy the file by changing some newlines to nulls
+ * as it may be implemented by pointing into the data buffer to return
+ * the configuration strings.
+ *
+ * NOTE: The data buffer must be one byte longer than the actual data.
+ *
+ * Returns: 0 on success or negative error on parse failure.
+ */
+int lk2nd_parse_extlinux_conf(char *data, size_t size, struct label *label)
+{
+	char *command = NULL, *value = NULL;
+	struct {
+		enum token cmd;
+		char *val;
+	} *commands;
+	int commands_count;
+	struct label *labels;
+	struct label *default_label = NULL;
+	const char *default_name = "";
+	const char *splash = NULL;
+	int labels_count = 0;
+	int label_idx;
+	int i;
+
+	/* Generic A/B environment configuration (global directives) */
+	const char *ab_env_part = NULL;
+	uint64_t ab_env_offset = 0;
+	uint64_t ab_env_offset_redund = 0;
+	size_t ab_env_size = 0;
+	uint64_t ab_slot_offset_a = 0;
+	uint64_t ab_slot_offset_b = 0;
+
+	commands_count = count_lines(data, size);
+	commands = calloc(commands_count, sizeof(*commands));
+
+	i = 0;
+	while (parse_command(&data, &size, &command, &value) == 0) {
+		if (i >= commands_count) {
+			dprintf(INFO, "Failed to parse the extlinux.conf\n");
+			free(commands);
+			return -1;
+		}
+
+		commands[i].cmd = cmd_to_tok(command);
+		commands[i].val = value;
+		i++;
+	}
+
+	commands_count = i;
+
+	i = 0;
+	for (i = 0; i < commands_count; ++i) {
+		if (commands[i].cmd == CMD_LABEL)
+			labels_count++;
+	}
+
+	if (labels_count == 0) {
+		dprintf(INFO, "No labels in the extlinux.conf\n");
+		free(commands);
+		return -1;
+	}
+
+	labels = calloc(labels_count, sizeof(*labels));
+
+	label_idx = -1;
+	for (i = 0; i < commands_count; ++i) {
+		if (commands[i].cmd == CMD_DEFAULT) {
+			default_name = commands[i].val;
+		} else if (commands[i].cmd == CMD_AB_ENV_PART) {
+			ab_env_part = commands[i].val; /* env partition name */
+		} else if (commands[i].cmd == CMD_AB_ENV_OFFSET) {
+			ab_env_offset = parse_u64(commands[i].val);
+		} else if (commands[i].cmd == CMD_AB_ENV_OFFSET_REDUND) {
+			ab_env_offset_redund = parse_u64(commands[i].val);
+		} else if (commands[i].cmd == CMD_AB_ENV_SIZE) {
+			ab_env_size = (size_t)parse_u64(commands[i].val);
+		} else if (commands[i].cmd == CMD_AB_SLOT_OFFSET_A) {
+			ab_slot_offset_a = parse_u64(commands[i].val);
+		} else if (commands[i].cmd == CMD_AB_SLOT_OFFSET_B) {
+			ab_slot_offset_b = parse_u64(commands[i].val);
+		} else if (commands[i].cmd == CMD_SPLASH && label_idx < 0) {
+			splash = commands[i].val; /* default for all labels */
+		} else if (commands[i].cmd == CMD_LABEL) {
+			label_idx++;
+			labels[label_idx].name = commands[i].val;
+		} else if (label_idx >= 0 && label_idx < labels_count) {
+			switch (commands[i].cmd) {
+			case CMD_KERNEL:
+				labels[label_idx].kernel = commands[i].val;
+				break;
+			case CMD_INITRD:
+				/* Several initrds are separated by commas like in U-Boot */
+				labels[label_idx].initramfs = parse_list(commands[i].val, ",");
+				break;
+			case CMD_APPEND:
+				labels[label_idx].cmdline = commands[i].val;
+				break;
+			case CMD_FDT:
+				labels[label_idx].dtb = commands[i].val;
+				break;
+			case CMD_FDTDIR:
+				labels[label_idx].dtbdir = commands[i].val;
+				break;
+			case CMD_FDTOVERLAY:
+				labels[label_idx].dtboverlays = parse_list(commands[i].val, " ");
+				break;
+			case CMD_SPLASH:
+				labels[label_idx].splash = commands[i].val;
+				break;
+			default:
+				break;
+			}
+		}
+	}
+
+	default_label = &labels[0];
+
+	/* Initialize generic A/B boot if configured */
+	if (ab_env_part && ab_env_offset > 0) {
+		dprintf(INFO, "extlinux: A/B env %s offset 0x%llx/0x%llx size 0x%zx\n",
+			ab_env_part, ab_env_offset, ab_env_offset_redund, ab_env_size);
+		lk2nd_boot_ab_init(ab_env_part, ab_env_offset, ab_env_offset_redund,
+				   ab_env_size);
+		if (ab_slot_offset_a > 0 || ab_slot_offset_b > 0)
+			lk2nd_boot_ab_set_offsets(ab_slot_offset_a, ab_slot_offset_b);
+	}
+
+	/*
+	 * A/B slot selection
+	 * Try labels suffixed with _A or _B if A/B boot is configured.
+	 * Falls back to standard label matching if A/B is not enabled.
+	 */
+	char slot = lk2nd_boot_ab_get_slot();
+
+	/* If A/B slot is active, force selection of the _A or _B label; otherwise fallback to the default label. */
+	if (slot == 'A' || slot == 'B') {
+		char slot_name[128];
+		bool found = false;
+
+		/* 1) If a default label name is set, try "<default>_<slot>" */
+		if (default_name && default_name[0] != '\0') {
+			snprintf(slot_name, sizeof(slot_name), "%s_%c", default_name, slot);
+			for (i = 0; i < labels_count; ++i) {
+				if (!strcmp(slot_name, labels[i].name)) {
+					default_label = &labels[i];
+					dprintf(INFO, "extlinux: Using A/B label '%s' for slot %c\n", slot_name, slot);
+					memcpy(label, default_label, sizeof(*label));
+					found = true;
+					break;
+				}
+			}
+		}
+
+		/* 2) If not found (or no default), try any label that ends with _A/_B */
+		if (!found) {
+			char suffix[4] = { '_', slot, '\0' };
+			for (i = 0; i < labels_count; ++i) {
+				const char *n = labels[i].name;
+				size_t ln = strlen(n), ls = strlen(suffix);
+				if (ln >= ls && !strcmp(n + (ln - ls), suffix)) {
+					default_label = &labels[i];
+					dprintf(INFO, "extlinux: Using A/B label '%s' (suffix match) for slot %c\n", n, slot);
+					memcpy(label, default_label, sizeof(*label));
+					found = true;
+					break;
+				}
+			}
+		}
+
+		if (!found) {
+			snprintf(slot_name, sizeof(slot_name), "%s_%c", (default_name && default_name[0]) ? default_name : "<default>", slot);
+			dprintf(CRITICAL, "extlinux: No label for slot '%s' found (no suffix match either), aborting boot!\n", slot_name);
+			free(labels);
+			free(commands);
+			return -1;
+		}
+		goto cleanup;
+	} else {
+		/* Standard label matching: exact match for default label */
+		for (i = 0; i < labels_count; ++i) {
+			if (!strcmp(default_name, labels[i].name)) {
+				default_label = &labels[i];
+				dprintf(INFO, "extlinux: Using label '%s'\n", default_name);
+				memcpy(label, default_label, sizeof(*label));
+				goto cleanup;
+			}
+		}
+		/* If default is not set or not found, fallback to the first label */
+		default_label = &labels[0];
+		dprintf(INFO, "extlinux: Default label '%s' not found, using first label '%s'\n",
+				default_name, default_label->name ? default_label->name : "<unnamed>");
+		memcpy(label, default_label, sizeof(*label));
+		goto cleanup;
+	}
+
+cleanup:
+	if (!label->splash)
+		label->splash = splash;
+	free(labels);
+	free(commands);
+	return 0;
+}
@@ -2,504 +2,346 @@
 /* Copyright (c) 2023 Nikita Travkin <nikita@trvn.ru> */
 
 #include <debug.h>
-#include <decompress.h>
+#include <err.h>
 #include <lib/fs.h>
 #include <libfdt.h>
+#include <limits.h>
 #include <platform.h>
 #include <platform/iomap.h>
 #include <smem.h>
 #include <strings.h>
 #include <stdlib.h>
 #include <target.h>
+#include <crc32.h>
 
 #include "../../app/aboot/bootimg.h"
 
 #include <lk2nd/boot.h>
 #include <lk2nd/device.h>
+#include <lk2nd/perf.h>
+#include <lk2nd/timeline.h>
+#include <lk2nd/util/region.h>
 
 #include "ab.h"
 #include "boot.h"
 
-struct label {
-	const char *name;
-	const char *kernel;
-	const char *initramfs;
-	const char *dtb;
-	const char *dtbdir;
-	const char **dtboverlays;
-	const char *cmdline;
-};
-
-enum token {
-	CMD_LABEL,
-	CMD_DEFAULT,
-	CMD_KERNEL,
-	CMD_APPEND,
-	CMD_INITRD,
-	CMD_FDT,
-	CMD_FDTDIR,
-	CMD_FDTOVERLAY,
-	/* Generic A/B directives */
-	CMD_AB_ENV_PART,
-	CMD_AB_ENV_OFFSET,
-	CMD_AB_ENV_SIZE,
-	CMD_AB_SLOT_OFFSET_A,
-	CMD_AB_SLOT_OFFSET_B,
-	CMD_UNKNOWN,
-};
-
-static const struct {
-	char *command;
-	enum token token;
-} token_map[] = {
-	{"label", 		CMD_LABEL},
-	{"default", 		CMD_DEFAULT},
-	{"kernel", 		CMD_KERNEL},
-	{"linux", 		CMD_KERNEL},
-	{"fdtdir", 		CMD_FDTDIR},
-	{"devicetreedir", 	CMD_FDTDIR},
-	{"fdt", 			CMD_FDT},
-	{"devicetree", 		CMD_FDT},
-	{"fdtoverlays", 	CMD_FDTOVERLAY},
-	{"devicetree-overlay", 	CMD_FDTOVERLAY},
-	{"initrd", 		CMD_INITRD},
-	{"append", 		CMD_APPEND},
-	/* Generic A/B */
-	{"ab_env_part", 	CMD_AB_ENV_PART},
-	{"ab_env_offset", 	CMD_AB_ENV_OFFSET},
-	{"ab_env_size", 	CMD_AB_ENV_SIZE},
-	{"ab_slot_offset_a", 	CMD_AB_SLOT_OFFSET_A},
-	{"ab_slot_offset_b", 	CMD_AB_SLOT_OFFSET_B},
-};
-
-static enum token cmd_to_tok(char *command)
-{
-	size_t i;
-
-	for (i = 0; i < ARRAY_SIZE(token_map); i++)
-		if (!strcasecmp(command, token_map[i].command))
-			return token_map[i].token;
-
-	return CMD_UNKNOWN;
-}
-
-#define EOF -1
-
-/* Parse unsigned 64-bit value from string (supports hex with 0x prefix) */
-static uint64_t parse_u64(const char *str)
+static bool fs_file_exists(const char *file)
 {
-	uint64_t val = 0;
-	int base = 10;
-
-	if (!str)
-		return 0;
-
-	/* Check for hex prefix */
-	if (str[0] == '0' && (str[1] == 'x' || str[1] == 'X')) {
-		base = 16;
-		str += 2;
-	}
-
-	while (*str) {
-		int digit;
+	struct filehandle *fileh;
+	int ret;
 
-		if (*str >= '0' && *str <= '9')
-			digit = *str - '0';
-		else if (base == 16 && *str >= 'a' && *str <= 'f')
-			digit = *str - 'a' + 10;
-		else if (base == 16 && *str >= 'A' && *str <= 'F')
-			digit = *str - 'A' + 10;
-		else
-			break;
+	if (!file)
+		return false;
 
-		val = val * base + digit;
-		str++;
-	}
+	ret = fs_open_file(file, &fileh);
+	if (ret < 0)
+		return false;
 
-	return val;
+	fs_close_file(fileh);
+	return true;
 }
 
 /**
- * parse_char() - Get one char from the file.
- * @data:    File contents
- * @size:    remaining size of data
+ * normalize_path() - Normalize path against given root.
  *
- * Update pointers and return the next character.
+ * Given some path (absolute or relative), normalize it to
+ * the lk "vfs" path; prepending /extlinux/ if the path is
+ * relative.
  *
- * Returns: char value or EOF.
+ * Returns: Newly allocated copy of the string with normalized
+ * path.
  */
-static int parse_char(char **data, size_t *size)
+static char *normalize_path(const char *path, const char *root)
 {
-	char c = **data;
-
-	if (*size == 0)
-		return EOF;
+	char tmp[256];
 
-	(*size)--;
-	(*data)++;
+	if (path[0] == '/')
+		snprintf(tmp, sizeof(tmp), "%s/%s", root, path);
+	else
+		snprintf(tmp, sizeof(tmp), "%s/extlinux/%s", root, path);
 
-	return c;
+	return strndup(tmp, sizeof(tmp));
 }
 
+/*
+ * Index of the dtbs in the fdtdir, generated when the kernel is installed.
+ * One line per dtb with its path relative to the fdtdir, followed by the
+ * compatible strings of its root node:
+ *	qcom/msm8916-samsung-a3u-eur.dtb samsung,a3u-eur qcom,msm8916
+ */
+#define DTB_INDEX_NAME		"dtb.index"
+#define DTB_INDEX_MAX_SIZE	(64 * 1024)
+
+/* Locations of the dtb files relative to the fdtdir, best first */
+static const char *const dtb_patterns[] = {
+	"qcom/%s.dtb",		/* arm64 style path */
+	"qcom-%s.dtb",		/* arm32 style path */
+	"%s.dtb",		/* boot-deploy drops the vendor dir */
+};
+
+/* Directories with the files of dtb_patterns, listed by find_dtb_scan() */
+static const char *const dtb_dirs[] = { "qcom", "" };
+
 /**
- * parse_line() - Read one command from the file.
- * @data:    File contents
- * @size:    remaining size of data
- * @command: returns pointer to the command string
- * @value:   returns pointer to the value string
- *
- * Function scans one line from the data blob, ignoring comments and
- * whitespace; returns pointers to the start of the command and it's
- * value after replacing whitespace and newline after them with \0.
- * @data and @size will be updated to remove the parsed line(s).
- *
- * Returns: 0 on success, negative value on error or EOF.
+ * struct dtb_candidates - Possible paths of the dtb relative to the fdtdir.
+ * @paths: Paths for the dtb hints with each of the patterns, best first
+ * @count: Number of paths
  */
-static int parse_command(char **data, size_t *size, char **command, char **value)
+struct dtb_candidates {
+	char **paths;
+	unsigned int count;
+};
+
+static bool dtb_candidates_init(struct dtb_candidates *c,
+				const char *const *dtbfiles)
 {
-	int c;
+	unsigned int i, p, n = 0;
+	char tmp[128];
 
-	/* Step 1: Ignore leading comments and whitespace. */
+	while (dtbfiles[n])
+		n++;
 
-	while (*size != 0 && (**data == '#' || **data == ' ' || **data == '\t' || **data == '\n')) {
-		/* Skip leading whitespace. */
-		while (*size != 0 && (**data == ' ' || **data == '\t' || **data == '\n')) {
-			c = parse_char(data, size);
-			if (c == EOF)
-				return -1;
-		}
+	c->count = 0;
+	c->paths = calloc(n * ARRAY_SIZE(dtb_patterns), sizeof(*c->paths));
+	if (!c->paths)
+		return false;
 
-		if (*size != 0 && **data == '#') {
-			do {
-				c = parse_char(data, size);
-				if (c == EOF)
-					return -1;
-			} while (c != '\n');
+	for (i = 0; i < n; i++) {
+		for (p = 0; p < ARRAY_SIZE(dtb_patterns); p++) {
+			snprintf(tmp, sizeof(tmp), dtb_patterns[p], dtbfiles[i]);
+			c->paths[c->count] = strdup(tmp);
+			if (!c->paths[c->count])
+				return false;
+			c->count++;
 		}
 	}
 
-	if (*size == 0)
-		return -1;
-
-	/* Step 2: Read the command. */
-	*command = *data;
-	while (*size != 0 && **data != ' ' && **data != '\t' && **data != '\n') {
-		c = parse_char(data, size);
-		if (c == EOF)
-			return -1;
-	}
-
-	if (*size != 0 && (**data == ' ' || **data == '\t')) {
-		**data = '\0';
-		(*data)++;
-		(*size)--;
-	}
+	return true;
+}
 
-	if (*size == 0 || **data == '\n')
-		return -1;
+static void dtb_candidates_free(struct dtb_candidates *c)
+{
+	unsigned int i;
 
-	/* Step 3: Read the value. */
+	for (i = 0; i < c->count; i++)
+		free(c->paths[i]);
+	free(c->paths);
+}
 
-	/* Skip whitespace. */
-	while (*size != 0 && (**data == ' ' || **data == '\t' || **data == '\n')) {
-		c = parse_char(data, size);
-		if (c == EOF || c == '\n')
-			return -1;
-	}
+/* Returns the position of the path in the candidates, or UINT_MAX */
+static unsigned int dtb_candidates_rank(const struct dtb_candidates *c,
+					const char *path)
+{
+	unsigned int i;
 
-	*value = *data;
-	while (*size != 0 && **data != '\n')
-		parse_char(data, size);
+	if (!strncmp(path, "./", 2))
+		path += 2;
 
-	/* The last command may not have a newline. */
-	if (*size == 0 || **data == '\n') {
-		**data = '\0';
-		(*data)++;
-		(*size)--;
-	}
+	for (i = 0; i < c->count; i++)
+		if (!strcmp(c->paths[i], path))
+			return i;
 
-	return 0;
+	return UINT_MAX;
 }
 
 /**
- * count_lines() - Count the amount of lines in the string.
+ * find_dtb_index() - Look up the dtb of the device in the index of the fdtdir.
+ *
+ * A dtb with the compatible of the device is preferred, otherwise the
+ * best of the candidates listed in the index.
+ *
+ * Returns: Newly allocated path relative to the fdtdir or NULL.
  */
-static int count_lines(char *data, size_t size)
+static char *find_dtb_index(const char *dtbdir, const char *root,
+			    const struct dtb_candidates *c)
 {
-	int acc = 0;
-	size_t i;
-
-	for (i = 0; i < size; ++i) {
-		if (data[i] == '\n')
-			acc++;
+	const char *compatible = lk2nd_device_get_compatible();
+	unsigned int rank, best_rank = UINT_MAX;
+	char *data, *line, *path, *token, *lsp, *tsp;
+	char *index, *best = NULL;
+	char tmp[256];
+	ssize_t len;
+
+	snprintf(tmp, sizeof(tmp), "%s/%s", dtbdir, DTB_INDEX_NAME);
+	index = normalize_path(tmp, root);
+	data = malloc(DTB_INDEX_MAX_SIZE + 1);
+	if (!index || !data)
+		goto out;
+
+	len = fs_load_file(index, data, DTB_INDEX_MAX_SIZE);
+	if (len < 0)
+		goto out;
+	data[len] = '\0';
+
+	for (line = strtok_r(data, "\n", &lsp); line; line = strtok_r(NULL, "\n", &lsp)) {
+		path = strtok_r(line, " \t\r", &tsp);
+		if (!path || *path == '#')
+			continue;
+
+		while (compatible && (token = strtok_r(NULL, " \t\r", &tsp))) {
+			if (!strcmp(token, compatible)) {
+				best = path;
+				goto out;
+			}
+		}
 
-		if (data[i] == '\0')
-			break;
+		rank = dtb_candidates_rank(c, path);
+		if (rank < best_rank) {
+			best_rank = rank;
+			best = path;
+		}
 	}
 
-	return acc;
+out:
+	if (best)
+		best = strdup(best);
+	free(data);
+	free(index);
+	return best;
 }
 
 /**
- * parse_conf() - Extract default label from extlinux.conf
- * @data: File contents
- * @size: Length of the file
- * @label: structure to write strings to
+ * find_dtb_scan() - Find the dtb of the device by listing the fdtdir.
  *
- * Find the default label in the file and extract strings from it.
- * This function may destroy the file by changing some newlines to nulls
- * as it may be implemented by pointing into the data buffer to return
- * the configuration strings.
+ * Each directory is listed only once and all of its entries are matched
+ * against all candidates, instead of a separate path lookup for each
+ * candidate.
  *
- * NOTE: The data buffer must be one byte longer than the actual data.
- *
- * Returns: 0 on success or negative error on parse failure.
+ * Returns: Newly allocated path relative to the fdtdir or NULL.
  */
-static int parse_conf(char *data, size_t size, struct label *label)
+static char *find_dtb_scan(const char *dtbdir, const char *root,
+			   const struct dtb_candidates *c)
 {
-	char *command = NULL, *value = NULL;
-	char *overlay, *saveptr;
-	int cnt = 0;
-	struct {
-		enum token cmd;
-		char *val;
-	} *commands;
-	int commands_count;
-	struct label *labels;
-	struct label *default_label = NULL;
-	const char *default_name = "";
-	int labels_count = 0;
-	int label_idx;
-	int i;
-
-	/* Generic A/B environment configuration (global directives) */
-	const char *ab_env_part = NULL;
-	uint64_t ab_env_offset = 0;
-	size_t ab_env_size = 0;
-	uint64_t ab_slot_offset_a = 0;
-	uint64_t ab_slot_offset_b = 0;
-
-	commands_count = count_lines(data, size);
-	commands = calloc(commands_count, sizeof(*commands));
-
-	i = 0;
-	while (parse_command(&data, &size, &command, &value) == 0) {
-		if (i >= commands_count) {
-			dprintf(INFO, "Failed to parse the extlinux.conf\n");
-			free(commands);
-			return -1;
-		}
+	unsigned int d, rank, best_rank = UINT_MAX;
+	struct dirhandle *dirh;
+	struct dirent ent;
+	char tmp[256];
+	char *dir;
+	int ret;
 
-		commands[i].cmd = cmd_to_tok(command);
-		commands[i].val = value;
-		i++;
+	for (d = 0; d < ARRAY_SIZE(dtb_dirs); d++) {
+		snprintf(tmp, sizeof(tmp), "%s/%s", dtbdir, dtb_dirs[d]);
+		dir = normalize_path(tmp, root);
+		ret = fs_open_dir(dir, &dirh);
+		free(dir);
+		if (ret < 0)
+			continue;
+
+		while (fs_read_dir(dirh, &ent) >= 0) {
+			if (*dtb_dirs[d])
+				snprintf(tmp, sizeof(tmp), "%s/%s", dtb_dirs[d], ent.name);
+			else
+				strlcpy(tmp, ent.name, sizeof(tmp));
+
+			rank = dtb_candidates_rank(c, tmp);
+			if (rank < best_rank)
+				best_rank = rank;
+		}
+		fs_close_dir(dirh);
 	}
 
-	commands_count = i;
+	if (best_rank == UINT_MAX)
+		return NULL;
 
-	i = 0;
-	for (i = 0; i < commands_count; ++i) {
-		if (commands[i].cmd == CMD_LABEL)
-			labels_count++;
-	}
+	return strdup(c->paths[best_rank]);
+}
 
-	if (labels_count == 0) {
-		dprintf(INFO, "No labels in the extlinux.conf\n");
-		free(commands);
-		return -1;
-	}
+/**
+ * find_dtb() - Find the dtb of the device in the fdtdir.
+ *
+ * The index of the fdtdir is used if there is one and it lists an existing
+ * dtb for the device. Otherwise the directories are listed.
+ *
+ * Returns: Newly allocated normalized path or NULL if none was found.
+ */
+static char *find_dtb(const char *dtbdir, const char *root,
+		      const char *const *dtbfiles)
+{
+	struct dtb_candidates c;
+	char *dtb, *normalized = NULL;
+	char tmp[256];
 
-	labels = calloc(labels_count, sizeof(*labels));
-
-	label_idx = -1;
-	for (i = 0; i < commands_count; ++i) {
-		if (commands[i].cmd == CMD_DEFAULT) {
-			default_name = commands[i].val;
-		} else if (commands[i].cmd == CMD_AB_ENV_PART) {
-			ab_env_part = commands[i].val; /* env partition name */
-		} else if (commands[i].cmd == CMD_AB_ENV_OFFSET) {
-			ab_env_offset = parse_u64(commands[i].val);
-		} else if (commands[i].cmd == CMD_AB_ENV_SIZE) {
-			ab_env_size = (size_t)parse_u64(commands[i].val);
-		} else if (commands[i].cmd == CMD_AB_SLOT_OFFSET_A) {
-			ab_slot_offset_a = parse_u64(commands[i].val);
-		} else if (commands[i].cmd == CMD_AB_SLOT_OFFSET_B) {
-			ab_slot_offset_b = parse_u64(commands[i].val);
-		} else if (commands[i].cmd == CMD_LABEL) {
-			label_idx++;
-			labels[label_idx].name = commands[i].val;
-		} else if (label_idx >= 0 && label_idx < labels_count) {
-			switch (commands[i].cmd) {
-			case CMD_KERNEL:
-				labels[label_idx].kernel = commands[i].val;
-				break;
-			case CMD_INITRD:
-				labels[label_idx].initramfs = commands[i].val;
-				break;
-			case CMD_APPEND:
-				labels[label_idx].cmdline = commands[i].val;
-				break;
-			case CMD_FDT:
-				labels[label_idx].dtb = commands[i].val;
-				break;
-			case CMD_FDTDIR:
-				labels[label_idx].dtbdir = commands[i].val;
-				break;
-			case CMD_FDTOVERLAY: {
-				for (char *c = commands[i].val; *c; c++)
-					if (*c == ' ')
-						cnt++;
-				cnt += 2;
-				labels[label_idx].dtboverlays = calloc(cnt, sizeof(*labels[label_idx].dtboverlays));
-				cnt = 0;
-				for (overlay = strtok_r(commands[i].val, " ", &saveptr); overlay;
-				     overlay = strtok_r(NULL,  " ", &saveptr)) {
-					labels[label_idx].dtboverlays[cnt] = overlay;
-					cnt++;
-				}
-				break; }
-			default:
-				break;
-			}
-		}
-	}
+	if (!dtb_candidates_init(&c, dtbfiles))
+		goto out;
 
-	default_label = &labels[0];
+	dtb = find_dtb_index(dtbdir, root, &c);
+	if (dtb) {
+		snprintf(tmp, sizeof(tmp), "%s/%s", dtbdir, dtb);
+		free(dtb);
+		normalized = normalize_path(tmp, root);
+		if (fs_file_exists(normalized))
+			goto out;
 
-	/* Initialize generic A/B boot if configured */
-	if (ab_env_part && ab_env_offset > 0) {
-		dprintf(INFO, "extlinux: A/B env %s offset 0x%llx size 0x%zx\n",
-			ab_env_part, ab_env_offset, ab_env_size);
-		lk2nd_boot_ab_init(ab_env_part, ab_env_offset, ab_env_size);
-		if (ab_slot_offset_a > 0 || ab_slot_offset_b > 0)
-			lk2nd_boot_ab_set_offsets(ab_slot_offset_a, ab_slot_offset_b);
+		dprintf(INFO, "Stale %s in %s\n", DTB_INDEX_NAME, dtbdir);
+		free(normalized);
+		normalized = NULL;
 	}
 
-	/*
-	 * A/B slot selection
-	 * Try labels suffixed with _A or _B if A/B boot is configured.
-	 * Falls back to standard label matching if A/B is not enabled.
-	 */
-	char slot = lk2nd_boot_ab_get_slot();
-
-	/* If A/B slot is active, force selection of the _A or _B label; otherwise fallback to the default label. */
-	if (slot == 'A' || slot == 'B') {
-		char slot_name[128];
-		bool found = false;
-
-		/* 1) If a default label name is set, try "<default>_<slot>" */
-		if (default_name && default_name[0] != '\0') {
-			snprintf(slot_name, sizeof(slot_name), "%s_%c", default_name, slot);
-			for (i = 0; i < labels_count; ++i) {
-				if (!strcmp(slot_name, labels[i].name)) {
-					default_label = &labels[i];
-					dprintf(INFO, "extlinux: Using A/B label '%s' for slot %c\n", slot_name, slot);
-					memcpy(label, default_label, sizeof(*label));
-					found = true;
-					break;
-				}
-			}
-		}
-
-		/* 2) If not found (or no default), try any label that ends with _A/_B */
-		if (!found) {
-			char suffix[4] = { '_', slot, '\0' };
-			for (i = 0; i < labels_count; ++i) {
-				const char *n = labels[i].name;
-				size_t ln = strlen(n), ls = strlen(suffix);
-				if (ln >= ls && !strcmp(n + (ln - ls), suffix)) {
-					default_label = &labels[i];
-					dprintf(INFO, "extlinux: Using A/B label '%s' (suffix match) for slot %c\n", n, slot);
-					memcpy(label, default_label, sizeof(*label));
-					found = true;
-					break;
-				}
-			}
-		}
-
-		if (!found) {
-			snprintf(slot_name, sizeof(slot_name), "%s_%c", (default_name && default_name[0]) ? default_name : "<default>", slot);
-			dprintf(CRITICAL, "extlinux: No label for slot '%s' found (no suffix match either), aborting boot!\n", slot_name);
-			free(labels);
-			free(commands);
-			return -1;
-		}
-		goto cleanup;
-	} else {
-		/* Standard label matching: exact match for default label */
-		for (i = 0; i < labels_count; ++i) {
-			if (!strcmp(default_name, labels[i].name)) {
-				default_label = &labels[i];
-				dprintf(INFO, "extlinux: Using label '%s'\n", default_name);
-				memcpy(label, default_label, sizeof(*label));
-				goto cleanup;
-			}
-		}
-		/* If default is not set or not found, fallback to the first label */
-		default_label = &labels[0];
-		dprintf(INFO, "extlinux: Default label '%s' not found, using first label '%s'\n",
-				default_name, default_label->name ? default_label->name : "<unnamed>");
-		memcpy(label, default_label, sizeof(*label));
-		goto cleanup;
+	dtb = find_dtb_scan(dtbdir, root, &c);
+	if (dtb) {
+		snprintf(tmp, sizeof(tmp), "%s/%s", dtbdir, dtb);
+		free(dtb);
+		normalized = normalize_path(tmp, root);
 	}
 
-cleanup:
-	free(labels);
-	free(commands);
-	return 0;
-}
-
-static bool fs_file_exists(const char *file)
-{
-	struct filehandle *fileh;
-	int ret;
-
-	if (!file)
-		return false;
-
-	ret = fs_open_file(file, &fileh);
-	if (ret < 0)
-		return false;
-
-	fs_close_file(fileh);
-	return true;
+out:
+	dtb_candidates_free(&c);
+	return normalized;
 }
 
 /**
- * normalize_path() - Normalize path against given root.
+ * dtbdir_key() - Add the names of the files in the fdtdir to the dtb hint key.
  *
- * Given some path (absolute or relative), normalize it to
- * the lk "vfs" path; prepending /extlinux/ if the path is
- * relative.
- *
- * Returns: Newly allocated copy of the string with normalized
- * path.
+ * Files that are added, renamed or removed in the fdtdir (e.g. a better
+ * matching dtb installed with a new kernel) invalidate the dtb hint, even
+ * if the config itself did not change.
  */
-static char *normalize_path(const char *path, const char *root)
+static uint32_t dtbdir_key(uint32_t key, const char *dtbdir, const char *root)
 {
+	struct dirhandle *dirh;
+	struct dirent ent;
 	char tmp[256];
+	unsigned int d;
+	char *dir;
+	int ret;
 
-	if (path[0] == '/')
-		snprintf(tmp, sizeof(tmp), "%s/%s", root, path);
-	else
-		snprintf(tmp, sizeof(tmp), "%s/extlinux/%s", root, path);
+	for (d = 0; d < ARRAY_SIZE(dtb_dirs); d++) {
+		snprintf(tmp, sizeof(tmp), "%s/%s", dtbdir, dtb_dirs[d]);
+		dir = normalize_path(tmp, root);
+		ret = fs_open_dir(dir, &dirh);
+		free(dir);
+		key = crc32(key, (const unsigned char *)tmp, strlen(tmp) + 1);
+		if (ret < 0)
+			continue;
 
-	return strndup(tmp, sizeof(tmp));
+		while (fs_read_dir(dirh, &ent) >= 0)
+			key = crc32(key, (const unsigned char *)ent.name,
+				    strnlen(ent.name, sizeof(ent.name)) + 1);
+		fs_close_dir(dirh);
+	}
+
+	return key;
 }
 
 /**
  * expand_conf() - Sanity check and rewrite the parsed config.
+ * @dtb_key: Key for the dtb hint, from lk2nd_boot_hint_dtb_key()
  *
- * This function checks if all the values in the config are sane,
- * all mentioned files exists. It then appends the paths with the
- * root directory and rewrites the dtb field based on dtbdir if
- * possible. This function allocates new strings for all values.
+ * This function checks if all the values in the config are sane.
+ * It then appends the paths with the root directory and rewrites the
+ * dtb field based on dtbdir if possible. The dtb found in the dtbdir is
+ * remembered for the same config, root, device and fdtdir contents, so it
+ * does not need to be searched again on the next boot. All files must
+ * exist, also when the dtb comes from the hint. This function allocates
+ * new strings for all values.
  *
  * Returns: True if the config seems bootable, false otherwise.
  */
-static bool expand_conf(struct label *label, const char *root)
+static bool expand_conf(struct label *label, const char *root, uint32_t dtb_key)
 {
 	const char *const *dtbfiles = lk2nd_device_get_dtb_hints();
+	const char *hint;
+	char *dtb;
 	int i = 0;
 
 	/* Cant boot without any kernel. */
@@ -515,58 +357,42 @@ static bool expand_conf(struct label *label, const char *root)
 		return false;
 	}
 
-	/* lk2nd needs to patch the dtb to boot. */
+	/*
+	 * lk2nd needs to patch the dtb to boot. A FIT brings its own, and
+	 * the initramfs and overlays of the selected configuration as well.
+	 */
 	if (!label->dtbdir && !label->dtb) {
-		dprintf(INFO, "Neither fdt nor fdtdir is specified\n");
-		return false;
-	}
-
-	if (label->dtbdir) {
+		if (!lk2nd_fit_detect(label->kernel)) {
+			dprintf(INFO, "Neither fdt nor fdtdir is specified\n");
+			return false;
+		}
+		label->initramfs = NULL;
+		label->dtboverlays = NULL;
+	} else if (label->dtbdir) {
 		if (!dtbfiles) {
 			dprintf(INFO, "The dtb-files for this device is not set\n");
 			return false;
 		}
 
-		while (dtbfiles[i]) {
-			char dtb[128];
-			char *normalized = NULL;
-
-			/* Try arm64 style path. */
-			snprintf(dtb, sizeof(dtb), "%s/qcom/%s.dtb", label->dtbdir, dtbfiles[i]);
-			normalized = normalize_path(dtb, root);
-			if (fs_file_exists(normalized)) {
-				label->dtb = normalized;
-				break;
-			}
-			free(normalized);
-
-			/* Try arm32 style path. */
-			snprintf(dtb, sizeof(dtb), "%s/qcom-%s.dtb", label->dtbdir, dtbfiles[i]);
-			normalized = normalize_path(dtb, root);
-			if (fs_file_exists(normalized)) {
-				label->dtb = normalized;
-				break;
-			}
-			free(normalized);
-
-			/* boot-deploy drops the vendor dir when copying dtbs. */
-			snprintf(dtb, sizeof(dtb), "%s/%s.dtb", label->dtbdir, dtbfiles[i]);
-			normalized = normalize_path(dtb, root);
-			if (fs_file_exists(normalized)) {
-				label->dtb = normalized;
-				break;
+		dtb_key = dtbdir_key(dtb_key, label->dtbdir, root);
+		hint = lk2nd_boot_hint_get_dtb(dtb_key);
+		if (hint && fs_file_exists(hint)) {
+			dtb = strdup(hint);
+		} else {
+			dtb = find_dtb(label->dtbdir, root, dtbfiles);
+			if (!dtb) {
+				dprintf(INFO, "No dtb for this device in %s\n", label->dtbdir);
+				return false;
 			}
-			free(normalized);
-
-			i++;
+			lk2nd_boot_hint_save_dtb(dtb_key, dtb);
 		}
+		label->dtb = dtb;
 	} else {
 		label->dtb = normalize_path(label->dtb, root);
-	}
-
-	if (!fs_file_exists(label->dtb)) {
-		dprintf(INFO, "FDT %s does not exist\n", label->dtb);
-		return false;
+		if (!fs_file_exists(label->dtb)) {
+			dprintf(INFO, "FDT %s does not exist\n", label->dtb);
+			return false;
+		}
 	}
 
 	if (label->dtboverlays) {
@@ -577,20 +403,25 @@ static bool expand_conf(struct label *label, const char *root)
 				dprintf(INFO, "FDT overlay %s does not exist\n", label->dtboverlays[i]);
 				return false;
 			}
-
 			i++;
 		}
 	}
 
 	if (label->initramfs) {
-		label->initramfs = normalize_path(label->initramfs, root);
-
-		if (!fs_file_exists(label->initramfs)) {
-			dprintf(INFO, "Initramfs %s does not exist\n", label->initramfs);
-			return false;
+		i = 0;
+		while (label->initramfs[i]) {
+			label->initramfs[i] = normalize_path(label->initramfs[i], root);
+			if (!fs_file_exists(label->initramfs[i])) {
+				dprintf(INFO, "Initramfs %s does not exist\n", label->initramfs[i]);
+				return false;
+			}
+			i++;
 		}
 	}
 
+	if (label->splash)
+		label->splash = normalize_path(label->splash, root);
+
 	if (label->cmdline)
 		label->cmdline = strdup(label->cmdline);
 	else
@@ -606,17 +437,7 @@ extern void boot_linux(void *kernel, unsigned *tags,
 
 #define IS_ARM64(ptr) (ptr->magic_64 == KERNEL64_HDR_MAGIC)
 
-#define MAX_TAGS_SIZE			(2 * 1024 * 1024)
-
-struct load_addrs {
-	void *kernel;
-	void *tags;
-	void *ramdisk;
-	uint32_t kernel_max_size;
-	uint32_t ramdisk_max_size;
-};
-
-static void choose_addrs(const struct kernel64_hdr *kptr, uint32_t ramdisk_size, struct load_addrs *addrs)
+void choose_addrs(const struct kernel64_hdr *kptr, uint32_t ramdisk_size, struct load_addrs *addrs)
 {
 	uint32_t kernel_offset, ramdisk_offset, tags_offset;
 	void *base;
@@ -664,121 +485,214 @@ static void choose_addrs(const struct kernel64_hdr *kptr, uint32_t ramdisk_size,
 	}
 }
 
+/*
+ * The kernel is always loaded or decompressed straight to the address from
+ * choose_addrs() and booted in place. arm64 kernels since Linux 3.17 occupy
+ * image_size bytes from there, including the BSS and the initial page tables
+ * that are not part of the file, so check that these fit as well. Otherwise
+ * clearing the BSS would overwrite the dtb before the kernel reads it.
+ */
+bool kernel_fits(const struct kernel64_hdr *kptr, uint64_t size,
+		const struct load_addrs *addrs)
+{
+	if (IS_ARM64(kptr) && kptr->image_size > size)
+		size = kptr->image_size;
+
+	return size <= addrs->kernel_max_size;
+}
+
 /**
  * lk2nd_boot_label() - Load all files from the label and boot.
+ *
+ * The files are read in the order kernel, dtb, overlays, initramfs by
+ * the loader while the kernel is decompressed and the overlays applied.
+ * For a FIT these are the images of the selected configuration instead.
  */
 static void lk2nd_boot_label(struct label *label)
 {
-	unsigned int scratch_size = target_get_max_flash_size();
-	void *scratch = target_get_scratch_address();
 	unsigned int kernel_size, ramdisk_size = 0;
+	struct load_file *kernel, *dtb, *overlays, *initramfs;
+	unsigned int overlays_count = 0, initramfs_count = 0, count, i, stage;
+	struct fit_config fit = {0};
+	uint32_t max_phandle;
+	struct loader loader = {0};
 	struct load_addrs addrs;
-	void *kernel_scratch;
-	int ret, i = 0;
+	bool started = false;
+	const char **paths;
+	void *scratch = NULL;
+	size_t scratch_size, pos;
+	int ret, format;
 
 	dprintf(INFO, "Trying to boot '%s'\n", label->name);
 
-	if (label->initramfs) {
-		struct filehandle *fileh;
-		struct file_stat stat;
+	/* Before the loader thread owns the file systems */
+	if (label->splash)
+		lk2nd_boot_splash(label->splash);
 
-		ret = fs_open_file(label->initramfs, &fileh);
-		if (ret < 0) {
-			dprintf(INFO, "Failed to open initramfs: %d\n", ret);
-			return;
-		}
-		ret = fs_stat_file(fileh, &stat);
-		if (ret < 0) {
-			dprintf(INFO, "Failed to stat initramfs: %d\n", ret);
-			fs_close_file(fileh);
+	if (!label->dtb) {
+		/* expand_conf() only allows this if the kernel is a FIT */
+		ret = loader_open_fit(&loader, label->kernel, &fit);
+		if (ret < 0)
+			goto out;
+
+		overlays_count = fit.fdt_count - 1;
+		initramfs_count = !!fit.ramdisk.size;
+	} else {
+		if (label->dtboverlays)
+			while (label->dtboverlays[overlays_count])
+				overlays_count++;
+		if (label->initramfs)
+			while (label->initramfs[initramfs_count])
+				initramfs_count++;
+
+		count = 2 + overlays_count + initramfs_count;
+		paths = calloc(count, sizeof(*paths));
+		if (!paths)
 			return;
-		}
-		ramdisk_size = stat.size;
-		fs_close_file(fileh);
+
+		paths[0] = label->kernel;
+		paths[1] = label->dtb;
+		for (i = 0; i < overlays_count; i++)
+			paths[2 + i] = label->dtboverlays[i];
+		for (i = 0; i < initramfs_count; i++)
+			paths[2 + overlays_count + i] = label->initramfs[i];
+
+		ret = loader_open(&loader, paths, count);
+		free(paths);
+		if (ret < 0)
+			goto out;
 	}
 
-	ret = fs_load_file(label->kernel, scratch, scratch_size);
-	if (ret < 0) {
-		dprintf(INFO, "Failed to load the kernel: %d\n", ret);
-		return;
+	kernel = &loader.files[0];
+	dtb = &loader.files[1];
+	overlays = &loader.files[2];
+	initramfs = &loader.files[2 + overlays_count];
+
+	/* The initramfs files are placed back to back */
+	for (i = 0; i < initramfs_count; i++)
+		ramdisk_size = ROUNDUP(ramdisk_size, INITRAMFS_ALIGN) + initramfs[i].size;
+
+	format = probe_kernel(kernel, ramdisk_size, &addrs);
+	if (format < 0) {
+		dprintf(INFO, "Failed to load the kernel: %d\n", format);
+		goto out;
 	}
 
-	kernel_size = ((ret >> 4) + 1) << 4;
+	/* Compressed kernels and the overlays are loaded to the scratch memory */
+	pos = format == KERNEL_RAW ? 0 : ROUNDUP(kernel->size, CACHE_LINE);
+	scratch_size = pos;
+	for (i = 0; i < overlays_count; i++)
+		scratch_size += ROUNDUP(overlays[i].size, CACHE_LINE);
+	if (scratch_size) {
+		scratch = lk2nd_region_alloc("extlinux", scratch_size);
+		if (!scratch)
+			goto out;
+	}
+	if (format != KERNEL_RAW)
+		kernel->buf = scratch;
 
-	if (is_gzip_package(scratch, kernel_size)) {
-		dprintf(INFO, "Decompressing the kernel...\n");
-		kernel_scratch = scratch + kernel_size;
-		ret = decompress(scratch, kernel_size, kernel_scratch,
-				 scratch_size - kernel_size, NULL, &kernel_size);
-		if (ret) {
-			dprintf(INFO, "Failed to decompress the kernel: %d\n", ret);
-			return;
-		}
-	} else {
-		kernel_scratch = scratch;
+	if (dtb->size >= MAX_TAGS_SIZE) {
+		dprintf(INFO, "DTB is too big\n");
+		goto out;
 	}
+	dtb->buf = addrs.tags;
 
-	choose_addrs(kernel_scratch, ramdisk_size, &addrs);
+	/* Overlays go to the scratch memory after the compressed kernel */
+	for (i = 0; i < overlays_count; i++) {
+		overlays[i].buf = (char *)scratch + pos;
+		pos += ROUNDUP(overlays[i].size, CACHE_LINE);
+	}
 
-	if (kernel_size > addrs.kernel_max_size) {
-		dprintf(INFO, "Kernel too big: %u > %u\n",
-			kernel_size, addrs.kernel_max_size);
-		return;
+	pos = 0;
+	for (i = 0; i < initramfs_count; i++) {
+		memset((char *)addrs.ramdisk + pos, 0, ROUNDUP(pos, INITRAMFS_ALIGN) - pos);
+		pos = ROUNDUP(pos, INITRAMFS_ALIGN);
+		initramfs[i].buf = (char *)addrs.ramdisk + pos;
+		pos += initramfs[i].size;
 	}
-	memmove(addrs.kernel, kernel_scratch, kernel_size);
 
-	ret = fs_load_file(label->dtb, addrs.tags, MAX_TAGS_SIZE);
+	loader_start(&loader);
+	started = true;
+
+	ret = load_kernel(&loader, kernel, format, ramdisk_size, &addrs, &kernel_size);
+	if (ret >= 0)
+		ret = loader_verify(kernel);
 	if (ret < 0) {
-		dprintf(INFO, "Failed to load the dtb: %d\n", ret);
-		return;
+		dprintf(INFO, "Failed to load the kernel: %d\n", ret);
+		goto out;
 	}
-	if (ret == MAX_TAGS_SIZE) {
-		dprintf(INFO, "DTB is too big\n");
-		return;
+
+	ret = loader_wait(&loader, dtb, dtb->size);
+	if (ret >= 0)
+		ret = loader_verify(dtb);
+	if (ret < 0) {
+		dprintf(INFO, "Failed to load the dtb: %d\n", ret);
+		goto out;
 	}
 
-	if (label->dtboverlays) {
+	if (overlays_count) {
+		stage = lk2nd_timeline_begin("overlays", NULL);
 		ret = fdt_open_into(addrs.tags, addrs.tags, MAX_TAGS_SIZE);
 		if (ret < 0) {
 			dprintf(INFO, "Failed to open the dtb: %d\n", ret);
-			return;
+			goto out;
 		}
 
-		while (label->dtboverlays[i]) {
-			ret = fs_load_file(label->dtboverlays[i], scratch, scratch_size);
+		/* Only search the whole dtb once, each overlay updates it */
+		ret = fdt_find_max_phandle(addrs.tags, &max_phandle);
+		if (ret < 0) {
+			dprintf(INFO, "Failed to find the phandles of the dtb: %d\n", ret);
+			goto out;
+		}
+
+		for (i = 0; i < overlays_count; i++) {
+			ret = loader_wait(&loader, &overlays[i], overlays[i].size);
+			if (ret >= 0)
+				ret = loader_verify(&overlays[i]);
 			if (ret < 0) {
-				dprintf(INFO, "Failed to load the dtb overlay %s: %d\n", label->dtboverlays[i], ret);
-				return;
+				dprintf(INFO, "Failed to load the dtb overlay %s: %d\n", overlays[i].path, ret);
+				goto out;
 			}
 
-			ret = fdt_overlay_apply(addrs.tags, scratch);
+			{
+				LK2ND_PERF_SCOPE("fdt_overlay_apply");
+				ret = fdt_overlay_apply_max_phandle(addrs.tags, overlays[i].buf,
+								    &max_phandle);
+			}
 			if (ret < 0) {
-				dprintf(INFO, "Failed to apply the dtb overlay %s: %d\n", label->dtboverlays[i], ret);
-				return;
+				dprintf(INFO, "Failed to apply the dtb overlay %s: %d\n", overlays[i].path, ret);
+				goto out;
 			}
-			i++;
 		}
 
 		ret = fdt_pack(addrs.tags);
 		if (ret < 0) {
 			dprintf(INFO, "Failed to pack the dtb: %d\n", ret);
-			return;
+			goto out;
 		}
+		lk2nd_timeline_end(stage);
 	}
 
-	if (label->initramfs) {
-		ret = fs_load_file(label->initramfs, addrs.ramdisk, ramdisk_size);
+	for (i = 0; i < initramfs_count; i++) {
+		ret = loader_wait(&loader, &initramfs[i], initramfs[i].size);
+		if (ret >= 0)
+			ret = loader_verify(&initramfs[i]);
 		if (ret < 0) {
-			dprintf(INFO, "Failed to load the initramfs: %d\n", ret);
-			return;
-		}
-		if ((uint32_t)ret != ramdisk_size) {
-			dprintf(INFO, "Failed to read full initramfs: %d != %u\n", ret, ramdisk_size);
-			return;
+			dprintf(INFO, "Failed to load the initramfs %s: %d\n", initramfs[i].path, ret);
+			goto out;
 		}
-		arch_clean_invalidate_cache_range((addr_t)addrs.ramdisk, ramdisk_size);
+		/*
+		 * No need to clean it here, boot_linux() cleans the whole
+		 * data cache by set/way with arch_disable_cache() right
+		 * before jumping to the kernel anyway.
+		 */
 	}
 
+	loader_finish(&loader, started);
+	lk2nd_fit_close(&fit);
+	if (scratch)
+		lk2nd_region_free(scratch);
+
 	/* A/B partition pre-boot: increment boot counter and check for fallback */
 	lk2nd_boot_ab_pre_boot();
 
@@ -788,28 +702,34 @@ static void lk2nd_boot_label(struct label *label)
 		   board_machtype(),
 		   addrs.ramdisk, ramdisk_size,
 		   0);
+	return;
+
+out:
+	loader_finish(&loader, started);
+	lk2nd_fit_close(&fit);
+	if (scratch)
+		lk2nd_region_free(scratch);
 }
 
 /**
- * lk2nd_try_extlinux() - Try to boot with extlinux
+ * lk2nd_read_extlinux() - Read, parse and expand extlinux.conf
  *
- * Check if /extlinux/extlinux.conf exists and try to
- * boot it if so.
+ * Returns: 0 on success, negative if there is no usable config.
  */
-void lk2nd_try_extlinux(const char *root)
+int lk2nd_read_extlinux(const char *root, struct label *label)
 {
 	struct filehandle *fileh;
 	struct file_stat stat;
-	struct label label = {0};
+	uint32_t dtb_key;
 	char path[64];
 	char *data;
-	int ret;
+	int ret, i;
 
 	snprintf(path, sizeof(path), "%s/extlinux/extlinux.conf", root);
 	ret = fs_open_file(path, &fileh);
 	if (ret < 0) {
 		dprintf(SPEW, "No extlinux config in %s: %d\n", root, ret);
-		return;
+		return ret;
 	}
 
 	fs_stat_file(fileh, &stat);
@@ -817,27 +737,61 @@ void lk2nd_try_extlinux(const char *root)
 	fs_read_file(fileh, data, 0, stat.size);
 	fs_close_file(fileh);
 
-	ret = parse_conf(data, stat.size, &label);
+	/* lk2nd_parse_extlinux_conf() modifies the data */
+	dtb_key = lk2nd_boot_hint_dtb_key(data, stat.size, root);
+
+	ret = lk2nd_parse_extlinux_conf(data, stat.size, label);
 	if (ret < 0)
 		goto error;
 
-	if (!expand_conf(&label, root))
+	if (!expand_conf(label, root, dtb_key))
 		goto error;
 
 	free(data);
 
 	dprintf(SPEW, "Parsed %s\n", path);
-	dprintf(SPEW, "kernel    = %s\n", label.kernel);
-	dprintf(SPEW, "dtb       = %s\n", label.dtb);
-	dprintf(SPEW, "dtbdir    = %s\n", label.dtbdir);
-	dprintf(SPEW, "initramfs = %s\n", label.initramfs);
-	dprintf(SPEW, "cmdline   = %s\n", label.cmdline);
+	dprintf(SPEW, "kernel    = %s\n", label->kernel);
+	dprintf(SPEW, "dtb       = %s\n", label->dtb);
+	dprintf(SPEW, "dtbdir    = %s\n", label->dtbdir);
+	for (i = 0; label->initramfs && label->initramfs[i]; i++)
+		dprintf(SPEW, "initramfs = %s\n", label->initramfs[i]);
+	dprintf(SPEW, "cmdline   = %s\n", label->cmdline);
+	dprintf(SPEW, "splash    = %s\n", label->splash);
 
-	lk2nd_boot_label(&label);
-
-	return;
+	return 0;
 
 error:
 	dprintf(INFO, "Failed to parse extlinux.conf\n");
 	free(data);
+	return -1;
+}
+
+/**
+ * lk2nd_probe_extlinux() - Check if extlinux would boot something
+ *
+ * Only checks that there is a config and that the files of the
+ * selected label exist, without loading anything. Used to skip an
+ * A/B slot before its boot counter is touched.
+ */
+bool lk2nd_probe_extlinux(const char *root)
+{
+	struct label label = {0};
+
+	return lk2nd_read_extlinux(root, &label) >= 0;
+}
+
+/**
+ * lk2nd_try_extlinux() - Try to boot with extlinux
+ *
+ * Check if /extlinux/extlinux.conf exists and try to
+ * boot it if so.
+ */
+void lk2nd_try_extlinux(const char *root)
+{
+	struct label label = {0};
+
+	if (lk2nd_read_extlinux(root, &label) < 0)
+		return;
+
+	lk2nd_boot_label(&label);
 }
@@ -0,0 +1,282 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <boot.h>
+#include <debug.h>
+#include <decompress.h>
+#include <fastboot.h>
+#include <lib/bio.h>
+#include <lib/fs.h>
+#include <lib/lz4.h>
+#include <lib/zstd.h>
+#include <platform.h>
+#include <reboot.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <lk2nd/util/region.h>
+
+#include "../../app/aboot/bootimg.h"
+
+#include "boot.h"
+
+/*
+ * oem boot-files <kernel size> <dtb size> [<initramfs size> [<cmdline size>]]
+ * boots a kernel, dtb and initramfs without a boot image, from the following
+ * downloads that are received straight at their load addresses:
+ *	fastboot oem boot-files $(stat -c %s Image board.dtb initramfs cmdline)
+ *	fastboot stage Image
+ *	fastboot stage board.dtb
+ *	fastboot stage initramfs
+ *	fastboot stage cmdline
+ * The sizes are needed up front to choose the load addresses like extlinux
+ * does, each file is one download in this order. Files with size 0 are left
+ * out. The kernel must be uncompressed, the cmdline is a plain text file.
+ */
+enum boot_files_part {
+	BOOT_FILES_KERNEL,
+	BOOT_FILES_DTB,
+	BOOT_FILES_INITRAMFS,
+	BOOT_FILES_CMDLINE,
+	BOOT_FILES_COUNT,
+};
+
+static const char *const boot_files_names[BOOT_FILES_COUNT] = {
+	"kernel", "dtb", "initramfs", "cmdline",
+};
+
+struct boot_files {
+	struct fastboot_stream stream;
+	unsigned size[BOOT_FILES_COUNT];
+	unsigned part;
+	struct load_addrs addrs;
+	const char *error;
+	/* start of the kernel until the load address is known, then the cmdline */
+	char buf[FASTBOOT_PLACE_ALIGN] __ALIGNED(CACHE_LINE);
+};
+
+static struct boot_files boot_files;
+
+extern void boot_linux(void *kernel, unsigned *tags,
+		const char *cmdline, unsigned machtype,
+		void *ramdisk, unsigned ramdisk_size,
+		enum boot_type boot_type);
+
+static void boot_files_next(struct boot_files *bf)
+{
+	while (bf->part < BOOT_FILES_COUNT && !bf->size[bf->part])
+		bf->part++;
+}
+
+static int boot_files_begin(struct fastboot_stream *stream, unsigned len)
+{
+	struct boot_files *bf = containerof(stream, struct boot_files, stream);
+	char response[MAX_RSP_SIZE];
+
+	if (len != bf->size[bf->part]) {
+		snprintf(response, sizeof(response), "expected the %s with %u bytes",
+			 boot_files_names[bf->part], bf->size[bf->part]);
+		fastboot_fail(response);
+		return -1;
+	}
+
+	bf->error = NULL;
+	return 0;
+}
+
+/* Choose the load addresses from the start of the kernel */
+static const char *boot_files_layout(struct boot_files *bf)
+{
+	struct kernel64_hdr *kptr = (struct kernel64_hdr *)bf->buf;
+	unsigned len = MIN(bf->size[BOOT_FILES_KERNEL], sizeof(bf->buf));
+
+	if (is_gzip_package((unsigned char *)bf->buf, len) ||
+	    lz4_is_compressed(bf->buf, len) || zstd_is_compressed(bf->buf, len))
+		return "compressed kernels are not supported";
+
+	choose_addrs(kptr, bf->size[BOOT_FILES_INITRAMFS], &bf->addrs);
+	if (!kernel_fits(kptr, bf->size[BOOT_FILES_KERNEL], &bf->addrs))
+		return "kernel too big";
+
+	memcpy(bf->addrs.kernel, bf->buf, len);
+	return NULL;
+}
+
+static void *boot_files_place(struct fastboot_stream *stream, unsigned offset, unsigned *len)
+{
+	struct boot_files *bf = containerof(stream, struct boot_files, stream);
+
+	switch (bf->part) {
+	case BOOT_FILES_KERNEL:
+		if (offset == 0) {
+			*len = MIN(*len, sizeof(bf->buf));
+			return bf->buf;
+		}
+		if (offset == sizeof(bf->buf)) {
+			bf->error = boot_files_layout(bf);
+			if (bf->error)
+				return NULL;
+		}
+		return (char *)bf->addrs.kernel + offset;
+	case BOOT_FILES_DTB:
+		return (char *)bf->addrs.tags + offset;
+	case BOOT_FILES_INITRAMFS:
+		return (char *)bf->addrs.ramdisk + offset;
+	case BOOT_FILES_CMDLINE:
+		return bf->buf + offset;
+	}
+
+	return NULL;
+}
+
+static void boot_files_end(struct fastboot_stream *stream, int status)
+{
+	struct boot_files *bf = containerof(stream, struct boot_files, stream);
+	const char *cmdline = "";
+	char *end;
+
+	if (status) {
+		fastboot_fail(bf->error ? bf->error : "download failed");
+		return;
+	}
+
+	/* The start of the kernel is moved once the rest is there */
+	if (bf->part == BOOT_FILES_KERNEL && bf->size[bf->part] <= sizeof(bf->buf)) {
+		bf->error = boot_files_layout(bf);
+		if (bf->error) {
+			fastboot_fail(bf->error);
+			return;
+		}
+	}
+
+	bf->part++;
+	boot_files_next(bf);
+	if (bf->part < BOOT_FILES_COUNT) {
+		fastboot_stream_download(&bf->stream);
+		fastboot_okay("");
+		return;
+	}
+
+	if (bf->size[BOOT_FILES_CMDLINE]) {
+		bf->buf[bf->size[BOOT_FILES_CMDLINE]] = 0;
+		end = strchr(bf->buf, '\n');
+		if (end)
+			*end = 0;
+		cmdline = bf->buf;
+	}
+
+	fastboot_okay("");
+	fastboot_stop();
+
+	boot_linux(bf->addrs.kernel, bf->addrs.tags, cmdline, board_machtype(),
+		   bf->addrs.ramdisk, bf->size[BOOT_FILES_INITRAMFS], 0);
+}
+
+static void cmd_oem_boot_files(const char *arg, void *data, unsigned sz)
+{
+	struct boot_files *bf = &boot_files;
+	char *token, *sp;
+	unsigned i;
+
+	memset(bf->size, 0, sizeof(bf->size));
+	token = strtok_r((char *)arg, " ", &sp);
+	for (i = 0; token && i < BOOT_FILES_COUNT; i++) {
+		bf->size[i] = atoul(token);
+		token = strtok_r(NULL, " ", &sp);
+	}
+
+	if (i < BOOT_FILES_INITRAMFS || token) {
+		fastboot_fail("usage: oem boot-files <kernel> <dtb> [<initrd> [<cmdline>]]");
+		return;
+	}
+	if (!bf->size[BOOT_FILES_KERNEL] || !bf->size[BOOT_FILES_DTB]) {
+		fastboot_fail("kernel and dtb are required");
+		return;
+	}
+	if (bf->size[BOOT_FILES_DTB] >= MAX_TAGS_SIZE) {
+		fastboot_fail("dtb too big");
+		return;
+	}
+	if (bf->size[BOOT_FILES_CMDLINE] >= sizeof(bf->buf)) {
+		fastboot_fail("cmdline too long");
+		return;
+	}
+
+	/* The initramfs and the dtb are placed at the end of the boot memory */
+	if (bf->size[BOOT_FILES_INITRAMFS] > LK2ND_BOOT_MEM_SIZE - MAX_TAGS_SIZE) {
+		fastboot_fail("initramfs too big");
+		return;
+	}
+
+	bf->part = BOOT_FILES_KERNEL;
+	bf->stream.begin = boot_files_begin;
+	bf->stream.place = boot_files_place;
+	bf->stream.end = boot_files_end;
+	fastboot_stream_download(&bf->stream);
+	fastboot_okay("");
+}
+FASTBOOT_REGISTER("oem boot-files", cmd_oem_boot_files);
+
+/*
+ * oem boot-fs boots from a filesystem image with an extlinux.conf in the last
+ * download, e.g. an ext4 or EROFS /boot image from CI, without flashing it:
+ *	fastboot stage boot.ext4
+ *	fastboot oem boot-fs
+ * The download is mounted as a memory block device. The filesystems read
+ * their metadata in place there, only the files are copied to their load
+ * addresses.
+ */
+#define BOOT_FS_DEVICE		"download"
+#define BOOT_FS_MOUNTPOINT	"/download"
+
+static void boot_fs_cleanup(void *data, bool reserved)
+{
+	bdev_t *bdev;
+
+	/* A new download has to be mounted from scratch */
+	fs_invalidate(BOOT_FS_DEVICE);
+	bdev = bio_open(BOOT_FS_DEVICE);
+	if (bdev) {
+		bio_unregister_device(bdev);
+		bio_close(bdev);
+	}
+	if (reserved)
+		lk2nd_region_free(data);
+}
+
+static void cmd_oem_boot_fs(const char *arg, void *data, unsigned sz)
+{
+	bool reserved;
+
+	if (!sz) {
+		fastboot_fail("nothing downloaded");
+		return;
+	}
+
+	/* The download may have changed since the last attempt */
+	boot_fs_cleanup(data, false);
+	create_membdev(BOOT_FS_DEVICE, data, sz);
+
+	/* Keep the scratch memory for the kernel from overlapping the image */
+	reserved = lk2nd_region_reserve("download", data, sz);
+
+	if (fs_mount_auto(BOOT_FS_MOUNTPOINT, BOOT_FS_DEVICE) < 0) {
+		fastboot_fail("no supported filesystem found");
+		boot_fs_cleanup(data, reserved);
+		return;
+	}
+	if (!lk2nd_probe_extlinux(BOOT_FS_MOUNTPOINT)) {
+		fastboot_fail("nothing to boot in extlinux.conf");
+		boot_fs_cleanup(data, reserved);
+		return;
+	}
+
+	fastboot_okay("");
+	fastboot_stop();
+
+	lk2nd_try_extlinux(BOOT_FS_MOUNTPOINT);
+
+	/* USB is already gone, come back so that the host can try again */
+	dprintf(CRITICAL, "Failed to boot from the download\n");
+	reboot_device(FASTBOOT_MODE);
+}
+FASTBOOT_REGISTER("oem boot-fs", cmd_oem_boot_fs);
@@ -0,0 +1,380 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <crypto_hash.h>
+#include <debug.h>
+#include <err.h>
+#include <lib/fs.h>
+#include <libfdt.h>
+#include <stdlib.h>
+#include <string.h>
+#include <target.h>
+#include <crc32.h>
+
+#include <lk2nd/device.h>
+
+#include "boot.h"
+
+/*
+ * fit.c - Boot the kernel, dtb and ramdisk from a U-Boot FIT image.
+ *
+ * A FIT is a devicetree that describes a set of images and configurations
+ * that combine them. Built with external data ("mkimage -E"), the tree
+ * itself is small and the data of the images follows it in the same file.
+ * Only the tree is read here to select the configuration, the loader in
+ * extlinux.c then reads the selected images straight to their load
+ * addresses. Images with the data embedded in the tree work as well, but
+ * then the whole FIT has to fit into FIT_MAX_SIZE.
+ */
+
+#define FIT_MAX_SIZE		(1024 * 1024)
+
+#define FIT_IMAGES_PATH		"/images"
+#define FIT_CONFS_PATH		"/configurations"
+
+/**
+ * lk2nd_fit_detect() - Check if a file is a FIT image.
+ *
+ * Returns: True if the file starts with a devicetree header.
+ */
+bool lk2nd_fit_detect(const char *path)
+{
+	struct filehandle *fileh;
+	fdt32_t magic;
+	ssize_t read;
+
+	if (fs_open_file(path, &fileh) < 0)
+		return false;
+
+	read = fs_read_file(fileh, &magic, 0, sizeof(magic));
+	fs_close_file(fileh);
+
+	return read == sizeof(magic) && fdt32_to_cpu(magic) == FDT_MAGIC;
+}
+
+/* Compare a dtb file name from the FIT with a name from the dtb hints */
+static bool fit_name_matches(const char *name, const char *hint)
+{
+	const char *base = strrchr(name, '/');
+	size_t len = strlen(hint);
+
+	base = base ? base + 1 : name;
+	if (!strncmp(base, "qcom-", 5))
+		base += 5;
+
+	return !strncmp(base, hint, len) &&
+	       (base[len] == '\0' || !strcmp(base + len, ".dtb"));
+}
+
+static bool fit_conf_matches_hint(const void *fit, int images, int conf,
+				  const char *hint)
+{
+	const char *desc, *fdt;
+	int node;
+
+	desc = fdt_getprop(fit, conf, "description", NULL);
+	if (desc && fit_name_matches(desc, hint))
+		return true;
+
+	/* mkimage -f auto names the dtb images after the files */
+	fdt = fdt_stringlist_get(fit, conf, "fdt", 0, NULL);
+	if (!fdt)
+		return false;
+
+	node = fdt_subnode_offset(fit, images, fdt);
+	if (node < 0)
+		return false;
+
+	desc = fdt_getprop(fit, node, "description", NULL);
+	return desc && fit_name_matches(desc, hint);
+}
+
+/**
+ * fit_select_config() - Choose the configuration for this device.
+ *
+ * Configurations with the compatible of the device are preferred, then
+ * those named after one of the dtb files of the device. Otherwise the
+ * default configuration of the FIT is used.
+ *
+ * Returns: Offset of the configuration node or negative error.
+ */
+static int fit_select_config(const void *fit, int images, int confs)
+{
+	const char *const *dtbfiles = lk2nd_device_get_dtb_hints();
+	const char *compatible = lk2nd_device_get_compatible();
+	const char *name;
+	int conf;
+
+	if (compatible) {
+		fdt_for_each_subnode(conf, fit, confs)
+			if (fdt_node_check_compatible(fit, conf, compatible) == 0)
+				return conf;
+	}
+
+	for (; dtbfiles && *dtbfiles; dtbfiles++) {
+		fdt_for_each_subnode(conf, fit, confs)
+			if (fit_conf_matches_hint(fit, images, conf, *dtbfiles))
+				return conf;
+	}
+
+	name = fdt_getprop(fit, confs, "default", NULL);
+	if (!name) {
+		dprintf(INFO, "FIT: No configuration for this device and no default\n");
+		return -FDT_ERR_NOTFOUND;
+	}
+
+	return fdt_subnode_offset(fit, confs, name);
+}
+
+/**
+ * fit_find_image() - Find the position of an image in the FIT file.
+ * @images: Offset of the /images node
+ * @name:   Name of the image node
+ * @img:    Returns the image
+ *
+ * Returns: 0 on success or negative error.
+ */
+static int fit_find_image(const void *fit, int images, const char *name,
+			  struct fit_image *img)
+{
+	const fdt32_t *val;
+	const void *data;
+	int len;
+
+	img->fit = fit;
+	img->name = name;
+	img->node = fdt_subnode_offset(fit, images, name);
+	if (img->node < 0) {
+		dprintf(INFO, "FIT: Image %s not found\n", name);
+		return ERR_NOT_FOUND;
+	}
+
+	data = fdt_getprop(fit, img->node, "data", &len);
+	if (data) {
+		img->offset = (const char *)data - (const char *)fit;
+		img->size = len;
+		return 0;
+	}
+
+	/* External data, either relative to the end of the tree or absolute */
+	val = fdt_getprop(fit, img->node, "data-offset", NULL);
+	if (val) {
+		img->offset = ROUNDUP(fdt_totalsize(fit), 4) + fdt32_to_cpu(*val);
+	} else {
+		val = fdt_getprop(fit, img->node, "data-position", NULL);
+		if (!val) {
+			dprintf(INFO, "FIT: Image %s has no data\n", name);
+			return ERR_NOT_VALID;
+		}
+		img->offset = fdt32_to_cpu(*val);
+	}
+
+	val = fdt_getprop(fit, img->node, "data-size", NULL);
+	if (!val) {
+		dprintf(INFO, "FIT: Image %s has no data-size\n", name);
+		return ERR_NOT_VALID;
+	}
+	img->size = fdt32_to_cpu(*val);
+	return 0;
+}
+
+/**
+ * lk2nd_fit_open() - Read the FIT tree and select the configuration.
+ * @fileh: Opened FIT file
+ * @size:  Size of the file
+ * @cfg:   Returns the images of the selected configuration
+ *
+ * Only the tree is read, the images are left for the caller to load from
+ * the positions in @cfg. lk2nd_fit_close() must be called afterwards on
+ * success, the images point into the tree.
+ *
+ * Returns: 0 on success or negative error.
+ */
+int lk2nd_fit_open(struct filehandle *fileh, off_t size, struct fit_config *cfg)
+{
+	struct fdt_header hdr;
+	int images, confs, conf, count, i, ret;
+	const char *name, *compression;
+	uint32_t totalsize;
+	ssize_t read;
+
+	memset(cfg, 0, sizeof(*cfg));
+
+	read = fs_read_file(fileh, &hdr, 0, sizeof(hdr));
+	if (read != sizeof(hdr) || fdt_check_header(&hdr) < 0)
+		return ERR_NOT_VALID;
+
+	totalsize = fdt_totalsize(&hdr);
+	if (totalsize > size)
+		return ERR_NOT_VALID;
+	if (totalsize > FIT_MAX_SIZE) {
+		dprintf(INFO, "FIT: Too big, build it with external data (mkimage -E)\n");
+		return ERR_TOO_BIG;
+	}
+
+	cfg->fit = malloc(totalsize);
+	if (!cfg->fit)
+		return ERR_NO_MEMORY;
+
+	read = fs_read_file(fileh, cfg->fit, 0, totalsize);
+	if (read < 0 || (uint32_t)read != totalsize) {
+		ret = ERR_IO;
+		goto err;
+	}
+
+	images = fdt_path_offset(cfg->fit, FIT_IMAGES_PATH);
+	confs = fdt_path_offset(cfg->fit, FIT_CONFS_PATH);
+	if (images < 0 || confs < 0) {
+		dprintf(INFO, "FIT: No images or configurations\n");
+		ret = ERR_NOT_VALID;
+		goto err;
+	}
+
+	conf = fit_select_config(cfg->fit, images, confs);
+	if (conf < 0) {
+		ret = ERR_NOT_FOUND;
+		goto err;
+	}
+	dprintf(INFO, "FIT: Using configuration %s\n",
+		fdt_get_name(cfg->fit, conf, NULL));
+
+	name = fdt_getprop(cfg->fit, conf, "kernel", NULL);
+	if (!name) {
+		dprintf(INFO, "FIT: Configuration has no kernel\n");
+		ret = ERR_NOT_VALID;
+		goto err;
+	}
+	ret = fit_find_image(cfg->fit, images, name, &cfg->kernel);
+	if (ret < 0)
+		goto err;
+
+	/* gzip, LZ4 and zstd are detected from the data like for other kernels */
+	compression = fdt_getprop(cfg->fit, cfg->kernel.node, "compression", NULL);
+	if (compression && strcmp(compression, "none") && strcmp(compression, "gzip") &&
+	    strcmp(compression, "lz4") && strcmp(compression, "zstd")) {
+		dprintf(INFO, "FIT: Unsupported kernel compression: %s\n", compression);
+		ret = ERR_NOT_SUPPORTED;
+		goto err;
+	}
+
+	/* The first dtb is the base, the others are applied as overlays */
+	count = fdt_stringlist_count(cfg->fit, conf, "fdt");
+	if (count <= 0) {
+		dprintf(INFO, "FIT: Configuration has no fdt\n");
+		ret = ERR_NOT_VALID;
+		goto err;
+	}
+	if (count > FIT_MAX_FDTS) {
+		dprintf(INFO, "FIT: Too many fdts: %d\n", count);
+		ret = ERR_TOO_BIG;
+		goto err;
+	}
+	for (i = 0; i < count; i++) {
+		name = fdt_stringlist_get(cfg->fit, conf, "fdt", i, NULL);
+		ret = fit_find_image(cfg->fit, images, name, &cfg->fdts[i]);
+		if (ret < 0)
+			goto err;
+	}
+	cfg->fdt_count = count;
+
+	name = fdt_getprop(cfg->fit, conf, "ramdisk", NULL);
+	if (name) {
+		ret = fit_find_image(cfg->fit, images, name, &cfg->ramdisk);
+		if (ret < 0)
+			goto err;
+	}
+
+	return 0;
+
+err:
+	free(cfg->fit);
+	cfg->fit = NULL;
+	return ret;
+}
+
+void lk2nd_fit_close(struct fit_config *cfg)
+{
+	free(cfg->fit);
+	cfg->fit = NULL;
+}
+
+static int fit_verify_hash(const struct fit_image *img, int node, const void *data)
+{
+	uint8_t digest[SHA256_INIT_VECTOR_SIZE * sizeof(uint32_t)];
+	static bool crypto_init_done;
+	const char *algo;
+	const uint8_t *value;
+	unsigned char alg;
+	int len, digest_len;
+	uint32_t crc;
+
+	algo = fdt_getprop(img->fit, node, "algo", NULL);
+	value = fdt_getprop(img->fit, node, "value", &len);
+	if (!algo || !value) {
+		dprintf(INFO, "FIT: Invalid hash node in %s\n", img->name);
+		return ERR_NOT_VALID;
+	}
+
+	if (!strcmp(algo, "crc32")) {
+		/* U-Boot stores the result of the conditioned CRC32 as big endian */
+		crc = crc32(0xFFFFFFFF, data, img->size) ^ 0xFFFFFFFF;
+		if (len != sizeof(crc) || fdt32_to_cpu(*(const fdt32_t *)value) != crc)
+			goto mismatch;
+		return 0;
+	}
+
+	if (!strcmp(algo, "sha1")) {
+		alg = CRYPTO_AUTH_ALG_SHA1;
+		digest_len = SHA1_INIT_VECTOR_SIZE * sizeof(uint32_t);
+	} else if (!strcmp(algo, "sha256")) {
+		alg = CRYPTO_AUTH_ALG_SHA256;
+		digest_len = SHA256_INIT_VECTOR_SIZE * sizeof(uint32_t);
+	} else {
+		dprintf(INFO, "FIT: Unsupported hash algo %s in %s\n", algo, img->name);
+		return ERR_NOT_SUPPORTED;
+	}
+
+	if (!crypto_init_done) {
+		target_crypto_init_params();
+		crypto_init_done = true;
+	}
+
+	if (hash_find((unsigned char *)data, img->size, digest, alg) != CRYPTO_SHA_ERR_NONE) {
+		dprintf(INFO, "FIT: Failed to compute the %s of %s\n", algo, img->name);
+		return ERROR;
+	}
+	if (len != digest_len || memcmp(value, digest, digest_len))
+		goto mismatch;
+	return 0;
+
+mismatch:
+	dprintf(INFO, "FIT: Wrong %s of %s\n", algo, img->name);
+	return ERR_NOT_VALID;
+}
+
+/**
+ * lk2nd_fit_verify() - Check the loaded data of an image against its hashes.
+ * @img:  Image from lk2nd_fit_open()
+ * @data: Loaded data of the image, @img->size bytes
+ *
+ * All hash nodes of the image are checked, images without any are
+ * accepted as is.
+ *
+ * Returns: 0 if the data is valid or negative error.
+ */
+int lk2nd_fit_verify(const struct fit_image *img, const void *data)
+{
+	const char *name;
+	int node, ret;
+
+	fdt_for_each_subnode(node, img->fit, img->node) {
+		name = fdt_get_name(img->fit, node, NULL);
+		if (strncmp(name, "hash", 4))
+			continue;
+
+		ret = fit_verify_hash(img, node, data);
+		if (ret < 0)
+			return ret;
+	}
+
+	return 0;
+}
@@ -0,0 +1,299 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <debug.h>
+#include <lib/bio.h>
+#include <list.h>
+#include <partition_parser.h>
+#include <stdlib.h>
+#include <string.h>
+#include <crc32.h>
+
+#include <lk2nd/device.h>
+
+#include "../../app/aboot/devinfo.h"
+#include "boot.h"
+
+/*
+ * hint.c - Remember where the boot files were found last time.
+ *
+ * Mounting every eMMC partition while looking for extlinux.conf takes a
+ * while on devices with many partitions. The partition that had it on the
+ * last boot is recorded in the last block of the "devinfo" partition (the
+ * device info of aboot is at its start) and tried before all the others.
+ * Partitions too small to keep the records clear of the device info are
+ * not used.
+ * The record is only used while the partition still has the same name,
+ * label, size and unique GPT GUID, so changing the partition table just
+ * results in a full scan again.
+ *
+ * The block before it remembers which of the candidate files in the fdtdir
+ * of the config matched, so it does not have to be searched on every boot.
+ */
+
+#define BOOT_HINT_MAGIC		0x544e4948	/* "HINT" */
+#define DTB_HINT_MAGIC		0x48544446	/* "FDTH" */
+#define BOOT_HINT_PARTITION	"devinfo"
+
+/* Blocks from the end of the storage partition */
+#define BOOT_HINT_BLOCK		0
+#define DTB_HINT_BLOCK		1
+
+struct boot_hint {
+	uint32_t magic;
+	uint32_t crc;
+	char name[32];
+	char label[MAX_GPT_NAME_SIZE];
+	uint64_t size;
+	uint8_t guid[UNIQUE_PARTITION_GUID_SIZE];
+};
+
+struct dtb_hint {
+	uint32_t magic;
+	uint32_t crc;
+	uint32_t key;
+	char path[256];
+};
+
+static struct boot_hint stored_hint;
+static bool stored_hint_read;
+
+static struct dtb_hint stored_dtb_hint;
+static bool stored_dtb_hint_read;
+
+static uint32_t boot_hint_crc(const struct boot_hint *hint)
+{
+	return crc32(0, (const unsigned char *)&hint->name,
+		     sizeof(*hint) - offsetof(struct boot_hint, name));
+}
+
+static void boot_hint_fill(struct boot_hint *hint, bdev_t *bdev)
+{
+	struct partition_entry *entries = partition_get_partition_entries();
+	unsigned int index;
+
+	memset(hint, 0, sizeof(*hint));
+	hint->magic = BOOT_HINT_MAGIC;
+	strlcpy(hint->name, bdev->name, sizeof(hint->name));
+	if (bdev->label)
+		strlcpy(hint->label, bdev->label, sizeof(hint->label));
+	hint->size = bdev->size;
+
+	/* wrp0pN is the N-th entry of the eMMC partition table */
+	if (!strncmp(bdev->name, "wrp0p", strlen("wrp0p"))) {
+		index = atoi(bdev->name + strlen("wrp0p"));
+		if (entries && index < partition_get_partition_count())
+			memcpy(hint->guid, entries[index].unique_partition_guid,
+			       sizeof(hint->guid));
+	}
+
+	hint->crc = boot_hint_crc(hint);
+}
+
+/* The devinfo partition on the eMMC, SD cards are not used for the hint */
+static bdev_t *boot_hint_open_storage(void)
+{
+	struct bdev_struct *bdevs = bio_get_bdevs();
+	bdev_t *bdev;
+
+	list_for_every_entry(&bdevs->list, bdev, bdev_t, node) {
+		if (!bdev->is_leaf || !bdev->label || !strncmp(bdev->name, "mmc", 3))
+			continue;
+		if (!strcmp(bdev->label, BOOT_HINT_PARTITION))
+			return bio_open(bdev->name);
+	}
+
+	return NULL;
+}
+
+/*
+ * Read or update a record of @len bytes at the start of the @block-th block
+ * from the end of the storage partition. The rest of the block is kept.
+ */
+static bool boot_hint_io(unsigned int block, void *rec, size_t len, bool write)
+{
+	bdev_t *storage;
+	bool ret = false;
+	off_t offset;
+	void *buf;
+
+	storage = boot_hint_open_storage();
+	if (!storage)
+		return false;
+
+	offset = storage->size - (off_t)(block + 1) * storage->block_size;
+	buf = malloc(storage->block_size);
+	/* Never touch the blocks aboot keeps its device info in */
+	if (!buf || storage->block_size < len ||
+	    offset < (off_t)ROUNDUP(sizeof(struct device_info), storage->block_size) ||
+	    bio_read(storage, buf, offset, storage->block_size) != (ssize_t)storage->block_size)
+		goto out;
+
+	if (write) {
+		memcpy(buf, rec, len);
+		ret = bio_write(storage, buf, offset, storage->block_size) ==
+		      (ssize_t)storage->block_size;
+	} else {
+		memcpy(rec, buf, len);
+		ret = true;
+	}
+
+out:
+	free(buf);
+	bio_close(storage);
+	return ret;
+}
+
+static void boot_hint_read(void)
+{
+	stored_hint_read = true;
+
+	if (!boot_hint_io(BOOT_HINT_BLOCK, &stored_hint, sizeof(stored_hint), false) ||
+	    stored_hint.magic != BOOT_HINT_MAGIC ||
+	    stored_hint.crc != boot_hint_crc(&stored_hint))
+		memset(&stored_hint, 0, sizeof(stored_hint));
+}
+
+/**
+ * lk2nd_boot_hint_get() - Get the partition extlinux.conf was last found on.
+ *
+ * Returns: Opened block device or NULL if there is no (valid) hint.
+ */
+bdev_t *lk2nd_boot_hint_get(void)
+{
+	struct boot_hint current;
+	bdev_t *bdev;
+
+	if (!stored_hint_read)
+		boot_hint_read();
+
+	if (stored_hint.magic != BOOT_HINT_MAGIC)
+		return NULL;
+
+	stored_hint.name[sizeof(stored_hint.name) - 1] = '\0';
+	bdev = bio_open(stored_hint.name);
+	if (!bdev)
+		return NULL;
+
+	boot_hint_fill(&current, bdev);
+	if (memcmp(&current, &stored_hint, sizeof(current))) {
+		dprintf(INFO, "boot: Partition %s changed, ignoring hint\n",
+			stored_hint.name);
+		bio_close(bdev);
+		return NULL;
+	}
+
+	return bdev;
+}
+
+/**
+ * lk2nd_boot_hint_save() - Record that extlinux.conf was found on @bdev.
+ *
+ * The record is only written if it changed.
+ */
+void lk2nd_boot_hint_save(bdev_t *bdev)
+{
+	struct boot_hint hint;
+
+	if (!stored_hint_read)
+		boot_hint_read();
+
+	boot_hint_fill(&hint, bdev);
+	if (!memcmp(&hint, &stored_hint, sizeof(hint)))
+		return;
+
+	if (!boot_hint_io(BOOT_HINT_BLOCK, &hint, sizeof(hint), true)) {
+		dprintf(INFO, "boot: Failed to save the boot partition hint\n");
+		return;
+	}
+
+	memcpy(&stored_hint, &hint, sizeof(hint));
+}
+
+static uint32_t dtb_hint_crc(const struct dtb_hint *hint)
+{
+	return crc32(0, (const unsigned char *)&hint->key,
+		     sizeof(*hint) - offsetof(struct dtb_hint, key));
+}
+
+/**
+ * lk2nd_boot_hint_dtb_key() - Identify what the dtb in the fdtdir is chosen by.
+ * @conf: Contents of the config, before parsing it
+ * @len:  Length of the config
+ * @root: Where the config was found
+ *
+ * The chosen dtb also depends on the dtb names of the detected device.
+ *
+ * Returns: Key for lk2nd_boot_hint_get_dtb() and lk2nd_boot_hint_save_dtb().
+ */
+uint32_t lk2nd_boot_hint_dtb_key(const void *conf, size_t len, const char *root)
+{
+	const char *const *dtbfiles = lk2nd_device_get_dtb_hints();
+	uint32_t key;
+
+	key = crc32(0, conf, len);
+	key = crc32(key, root, strlen(root) + 1);
+	for (; dtbfiles && *dtbfiles; dtbfiles++)
+		key = crc32(key, *dtbfiles, strlen(*dtbfiles) + 1);
+
+	return key;
+}
+
+static void dtb_hint_read(void)
+{
+	stored_dtb_hint_read = true;
+
+	if (!boot_hint_io(DTB_HINT_BLOCK, &stored_dtb_hint, sizeof(stored_dtb_hint), false) ||
+	    stored_dtb_hint.magic != DTB_HINT_MAGIC ||
+	    stored_dtb_hint.crc != dtb_hint_crc(&stored_dtb_hint))
+		memset(&stored_dtb_hint, 0, sizeof(stored_dtb_hint));
+
+	stored_dtb_hint.path[sizeof(stored_dtb_hint.path) - 1] = '\0';
+}
+
+/**
+ * lk2nd_boot_hint_get_dtb() - Get the dtb that was found for @key last time.
+ * @key: Identifies the config and everything else the dtb was chosen by
+ *
+ * Returns: Path of the dtb or NULL if there is no (valid) hint for @key.
+ */
+const char *lk2nd_boot_hint_get_dtb(uint32_t key)
+{
+	if (!stored_dtb_hint_read)
+		dtb_hint_read();
+
+	if (stored_dtb_hint.magic != DTB_HINT_MAGIC || stored_dtb_hint.key != key)
+		return NULL;
+
+	return stored_dtb_hint.path;
+}
+
+/**
+ * lk2nd_boot_hint_save_dtb() - Record that @path was found for @key.
+ *
+ * The record is only written if it changed.
+ */
+void lk2nd_boot_hint_save_dtb(uint32_t key, const char *path)
+{
+	struct dtb_hint hint = {
+		.magic = DTB_HINT_MAGIC,
+		.key = key,
+	};
+
+	if (strlen(path) >= sizeof(hint.path))
+		return;
+
+	if (!stored_dtb_hint_read)
+		dtb_hint_read();
+
+	strlcpy(hint.path, path, sizeof(hint.path));
+	hint.crc = dtb_hint_crc(&hint);
+	if (!memcmp(&hint, &stored_dtb_hint, sizeof(hint)))
+		return;
+
+	if (!boot_hint_io(DTB_HINT_BLOCK, &hint, sizeof(hint), true)) {
+		dprintf(INFO, "boot: Failed to save the dtb hint\n");
+		return;
+	}
+
+	memcpy(&stored_dtb_hint, &hint, sizeof(hint));
+}
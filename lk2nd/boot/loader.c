@@ -0,0 +1,564 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <debug.h>
+#include <decompress.h>
+#include <err.h>
+#include <kernel/thread.h>
+#include <lib/bio.h>
+#include <lib/fs.h>
+#include <lib/lz4.h>
+#include <lib/zstd.h>
+#include <libfdt.h>
+#include <rpm-ipc.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+#include "../../app/aboot/bootimg.h"
+
+#include <lk2nd/cpufreq.h>
+#include <lk2nd/perf.h>
+#include <lk2nd/timeline.h>
+#include <lk2nd/trace.h>
+
+#include "boot.h"
+
+/* Amount of data read from a file at a time by the loader. */
+#define LOAD_CHUNK_SIZE			(1024 * 1024)
+
+/* Amount of the compressed kernel fed to inflate() at a time. */
+#define KERNEL_CHUNK_SIZE		(1024 * 1024)
+
+/* Read part of a file, or of the block device for data outside of a file */
+static ssize_t load_file_read(struct load_file *f, void *buf, off_t offset, size_t len)
+{
+	if (f->bdev)
+		return bio_read(f->bdev, buf, f->offset + offset, len);
+
+	return fs_read_file(f->fileh, buf, f->offset + offset, len);
+}
+
+static int loader_thread(void *arg)
+{
+	struct loader *l = arg;
+	unsigned int i, stage;
+	struct load_file *f;
+	const char *name;
+	ssize_t read;
+	size_t len;
+
+	for (i = 0; i < l->count; i++) {
+		f = &l->files[i];
+		name = strrchr(f->path, '/');
+		if (lk2nd_boot_preload_copy(f)) {
+			f->done = f->size;
+			event_signal(&l->progress, false);
+			continue;
+		}
+
+		stage = lk2nd_timeline_begin("load", f->fit ? f->fit->name :
+					     name ? name + 1 : f->path);
+
+		while (f->done < f->size) {
+			len = MIN(LOAD_CHUNK_SIZE, (size_t)(f->size - f->done));
+			read = load_file_read(f, (char *)f->buf + f->done, f->done, len);
+			if (read < 0 || (size_t)read != len) {
+				dprintf(INFO, "Failed to read %s: %ld\n", f->path, read);
+				f->done = read < 0 ? read : ERR_IO;
+				break;
+			}
+
+			f->done += len;
+			event_signal(&l->progress, false);
+		}
+		lk2nd_timeline_end(stage);
+		event_signal(&l->progress, false);
+	}
+
+	event_signal(&l->finished, false);
+	return 0;
+}
+
+/**
+ * loader_open() - Open all files of the label.
+ *
+ * The files are only opened here to find out their size, so that the
+ * destinations can be set up before loader_start().
+ *
+ * Returns: 0 on success or negative error.
+ */
+int loader_open(struct loader *l, const char **paths, unsigned count)
+{
+	struct file_stat stat;
+	unsigned i;
+	int ret;
+
+	l->files = calloc(count, sizeof(*l->files));
+	if (!l->files)
+		return ERR_NO_MEMORY;
+	l->count = count;
+
+	for (i = 0; i < count; i++) {
+		struct load_file *f = &l->files[i];
+
+		f->path = paths[i];
+		ret = fs_open_file(f->path, &f->fileh);
+		if (ret < 0) {
+			dprintf(INFO, "Failed to open %s: %d\n", f->path, ret);
+			return ret;
+		}
+
+		ret = fs_stat_file(f->fileh, &stat);
+		if (ret < 0) {
+			dprintf(INFO, "Failed to stat %s: %d\n", f->path, ret);
+			return ret;
+		}
+		f->size = stat.size;
+	}
+
+	return 0;
+}
+
+/**
+ * loader_open_fit() - Open the images of a FIT instead of separate files.
+ * @path: Path of the FIT
+ * @cfg:  Returns the selected configuration
+ *
+ * The files are laid out like for loader_open() with the kernel, the
+ * dtbs and the ramdisk, but all of them are read from the same file.
+ *
+ * Returns: 0 on success or negative error.
+ */
+int loader_open_fit(struct loader *l, const char *path,
+			   struct fit_config *cfg)
+{
+	const struct fit_image *images[1 + FIT_MAX_FDTS + 1];
+	struct filehandle *fileh;
+	struct file_stat stat;
+	unsigned i, count = 0;
+	int ret;
+
+	ret = fs_open_file(path, &fileh);
+	if (ret < 0) {
+		dprintf(INFO, "Failed to open %s: %d\n", path, ret);
+		return ret;
+	}
+
+	ret = fs_stat_file(fileh, &stat);
+	if (ret >= 0)
+		ret = lk2nd_fit_open(fileh, stat.size, cfg);
+	if (ret < 0) {
+		dprintf(INFO, "Failed to open the FIT %s: %d\n", path, ret);
+		fs_close_file(fileh);
+		return ret;
+	}
+
+	images[count++] = &cfg->kernel;
+	for (i = 0; i < cfg->fdt_count; i++)
+		images[count++] = &cfg->fdts[i];
+	if (cfg->ramdisk.size)
+		images[count++] = &cfg->ramdisk;
+
+	l->files = calloc(count, sizeof(*l->files));
+	if (!l->files) {
+		fs_close_file(fileh);
+		return ERR_NO_MEMORY;
+	}
+	l->count = count;
+
+	for (i = 0; i < count; i++) {
+		l->files[i].path = path;
+		l->files[i].fileh = fileh;
+		l->files[i].offset = images[i]->offset;
+		l->files[i].size = images[i]->size;
+		l->files[i].fit = images[i];
+	}
+
+	return 0;
+}
+
+void loader_start(struct loader *l)
+{
+	thread_t *thread;
+	unsigned i;
+
+	for (i = 0; i < l->count; i++) {
+		ASSERT(l->files[i].buf);
+		l->files[i].done = 0;
+	}
+
+	/* Decompressing and hashing the files are limited by the CPU */
+	lk2nd_cpufreq_boost();
+	rpm_bw_request();
+
+	event_init(&l->progress, false, EVENT_FLAG_AUTOUNSIGNAL);
+	event_init(&l->finished, false, 0);
+
+	/* Higher priority so that the next read starts as soon as possible */
+	thread = thread_create("boot-load", loader_thread, l,
+			       HIGH_PRIORITY, DEFAULT_STACK_SIZE);
+	if (!thread) {
+		loader_thread(l);
+		return;
+	}
+	thread_resume(thread);
+}
+
+/**
+ * loader_wait() - Wait until a part of a file has been loaded.
+ * @l:   Loader
+ * @f:   File to wait for
+ * @len: Minimum amount of data needed, clamped to the file size
+ *
+ * Returns: Amount of data available in the file buffer or negative error.
+ */
+ssize_t loader_wait(struct loader *l, struct load_file *f, off_t len)
+{
+	ssize_t done;
+
+	len = MIN(len, f->size);
+	for (;;) {
+		done = f->done;
+		if (done < 0 || done >= len)
+			return done;
+		event_wait(&l->progress);
+	}
+}
+
+/* Stop using the loader, must be called after loader_start() on all paths. */
+void loader_finish(struct loader *l, bool started)
+{
+	unsigned i;
+
+	if (started) {
+		event_wait(&l->finished);
+		event_destroy(&l->finished);
+		event_destroy(&l->progress);
+		rpm_bw_release();
+		lk2nd_cpufreq_unboost();
+	}
+
+	/* The images of a FIT all share the handle of the file */
+	for (i = 0; i < l->count; i++)
+		if (l->files[i].fileh &&
+		    (i == 0 || l->files[i].fileh != l->files[i - 1].fileh))
+			fs_close_file(l->files[i].fileh);
+	free(l->files);
+}
+
+/* Check a completely loaded file against the hashes in the FIT */
+int loader_verify(struct load_file *f)
+{
+	unsigned int stage;
+	int ret;
+
+	if (!f->fit)
+		return 0;
+
+	stage = lk2nd_timeline_begin("verify", f->fit->name);
+	ret = lk2nd_fit_verify(f->fit, f->buf);
+	lk2nd_timeline_end(stage);
+	return ret;
+}
+
+/* gzip member header flags, see RFC 1952 */
+#define GZIP_HEADER_LEN			10
+#define GZIP_FHCRC			0x02
+#define GZIP_FEXTRA			0x04
+#define GZIP_FNAME			0x08
+#define GZIP_FCOMMENT			0x10
+
+/**
+ * gzip_header_len() - Find the start of the deflate stream.
+ * @buf: Start of the gzip file
+ * @len: Amount of valid data in @buf
+ *
+ * Returns: Length of the gzip header or negative value if it
+ * doesn't fit into @buf.
+ */
+static int gzip_header_len(const unsigned char *buf, size_t len)
+{
+	size_t pos = GZIP_HEADER_LEN;
+	unsigned char flags = buf[3];
+
+	if (flags & GZIP_FEXTRA) {
+		if (pos + 2 > len)
+			return -1;
+		pos += 2 + (buf[pos] | buf[pos + 1] << 8);
+	}
+
+	if (flags & GZIP_FNAME) {
+		while (pos < len && buf[pos])
+			pos++;
+		pos++;
+	}
+
+	if (flags & GZIP_FCOMMENT) {
+		while (pos < len && buf[pos])
+			pos++;
+		pos++;
+	}
+
+	if (flags & GZIP_FHCRC)
+		pos += 2;
+
+	if (pos > len)
+		return -1;
+
+	return pos;
+}
+
+/**
+ * inflate_kernel() - Decompress the kernel while it is loaded.
+ * @l:            Loader reading the kernel
+ * @f:            Kernel file, loaded to a scratch buffer
+ * @ramdisk_size: Size of the ramdisk for choose_addrs()
+ * @addrs:        Returns the chosen load addresses
+ * @kernel_size:  Returns the decompressed size of the kernel
+ *
+ * The file is fed into inflate() in chunks as soon as they have been
+ * read, inflate() writes the decompressed kernel to its final location.
+ * The first bytes are inflated separately since the load address depends
+ * on the header of the decompressed image.
+ *
+ * Returns: 0 on success or negative error.
+ */
+static int inflate_kernel(struct loader *l, struct load_file *f,
+			  uint32_t ramdisk_size, struct load_addrs *addrs,
+			  unsigned int *kernel_size)
+{
+	unsigned char *buf = f->buf;
+	struct kernel64_hdr hdr;
+	z_stream stream = {0};
+	bool hdr_done = false;
+	ssize_t avail;
+	off_t offset;
+	int hlen, rc;
+
+	/* The first chunk contains the gzip header */
+	avail = loader_wait(l, f, KERNEL_CHUNK_SIZE);
+	if (avail < 0)
+		return ERR_IO;
+	offset = avail;
+
+	hlen = gzip_header_len(buf, offset);
+	if (hlen < 0) {
+		dprintf(INFO, "Invalid gzip header\n");
+		return ERR_NOT_VALID;
+	}
+
+	stream.next_in = buf + hlen;
+	stream.avail_in = offset - hlen;
+	stream.next_out = (Bytef *)&hdr;
+	stream.avail_out = sizeof(hdr);
+
+	rc = inflateInit2(&stream, -MAX_WBITS);
+	if (rc != Z_OK) {
+		dprintf(INFO, "inflateInit2 failed: %d\n", rc);
+		return ERR_NO_MEMORY;
+	}
+
+	do {
+		if (stream.avail_in == 0 && offset < f->size) {
+			avail = loader_wait(l, f, offset + KERNEL_CHUNK_SIZE);
+			if (avail < 0) {
+				inflateEnd(&stream);
+				return ERR_IO;
+			}
+
+			stream.next_in = buf + offset;
+			stream.avail_in = avail - offset;
+			offset = avail;
+		}
+
+		{
+			LK2ND_PERF_SCOPE("inflate_kernel");
+			LK2ND_TRACE_SCOPE("inflate_kernel", stream.avail_in);
+			rc = inflate(&stream, Z_NO_FLUSH);
+		}
+
+		if (!hdr_done && (stream.avail_out == 0 || rc == Z_STREAM_END)) {
+			choose_addrs(&hdr, ramdisk_size, addrs);
+			if (!kernel_fits(&hdr, stream.total_out, addrs))
+				break;
+
+			memcpy(addrs->kernel, &hdr, stream.total_out);
+			stream.next_out = addrs->kernel + stream.total_out;
+			stream.avail_out = addrs->kernel_max_size - stream.total_out;
+			hdr_done = true;
+		}
+	} while (rc == Z_OK);
+
+	inflateEnd(&stream);
+
+	if (rc == Z_STREAM_END && hdr_done) {
+		*kernel_size = stream.total_out;
+		return 0;
+	}
+
+	if (!hdr_done || stream.avail_out == 0) {
+		dprintf(INFO, "Kernel too big: > %u\n", addrs->kernel_max_size);
+		return ERR_TOO_BIG;
+	}
+
+	dprintf(INFO, "Failed to decompress the kernel: %d\n", rc);
+	return ERR_NOT_VALID;
+}
+
+typedef int (*unpack_func)(const void *src, size_t src_size, void *dst,
+			   size_t dst_size, size_t *out_len);
+
+/**
+ * unpack_kernel() - Decompress a LZ4 or zstd compressed kernel.
+ * @l:            Loader reading the kernel
+ * @f:            Kernel file, loaded to a scratch buffer
+ * @unpack:       Decompressor for the format of the file
+ * @ramdisk_size: Size of the ramdisk for choose_addrs()
+ * @addrs:        Returns the chosen load addresses
+ * @kernel_size:  Returns the decompressed size of the kernel
+ *
+ * Unlike inflate_kernel() this waits for the whole file first. The
+ * header of the decompressed image is unpacked on its own to choose the
+ * load address, then the kernel is decompressed straight to it.
+ *
+ * Returns: 0 on success or negative error.
+ */
+static int unpack_kernel(struct loader *l, struct load_file *f,
+			 unpack_func unpack, uint32_t ramdisk_size,
+			 struct load_addrs *addrs, unsigned int *kernel_size)
+{
+	struct kernel64_hdr hdr = {0};
+	size_t out_len;
+	int ret;
+
+	if (loader_wait(l, f, f->size) < 0)
+		return ERR_IO;
+
+	LK2ND_PERF_SCOPE("unpack_kernel");
+	ret = unpack(f->buf, f->size, &hdr, sizeof(hdr), &out_len);
+	if (ret < 0 && ret != ERR_TOO_BIG)
+		goto err;
+
+	choose_addrs(&hdr, ramdisk_size, addrs);
+	if (!kernel_fits(&hdr, 0, addrs)) {
+		dprintf(INFO, "Kernel too big: > %u\n", addrs->kernel_max_size);
+		return ERR_TOO_BIG;
+	}
+
+	ret = unpack(f->buf, f->size, addrs->kernel, addrs->kernel_max_size, &out_len);
+	if (ret == ERR_TOO_BIG) {
+		dprintf(INFO, "Kernel too big: > %u\n", addrs->kernel_max_size);
+		return ret;
+	}
+	if (ret < 0)
+		goto err;
+
+	*kernel_size = out_len;
+	return 0;
+
+err:
+	dprintf(INFO, "Failed to decompress the kernel: %d\n", ret);
+	return ret;
+}
+
+/**
+ * probe_kernel() - Read the header of the kernel and set up its destination.
+ * @f:            Kernel file
+ * @ramdisk_size: Size of the ramdisk for choose_addrs()
+ * @addrs:        Returns the chosen load addresses
+ *
+ * Only the start of the file is read here, which is enough to detect the
+ * format and to choose the load address of uncompressed kernels. Those are
+ * then loaded straight to their final location. Compressed kernels need a
+ * buffer in the scratch memory from the caller, their load address is
+ * chosen again once the header has been decompressed.
+ *
+ * Returns: Format of the kernel or negative error.
+ */
+int probe_kernel(struct load_file *f, uint32_t ramdisk_size,
+			struct load_addrs *addrs)
+{
+	size_t len = MIN(sizeof(struct kernel64_hdr), (size_t)f->size);
+	struct kernel64_hdr hdr = {0};
+	unsigned char *probe = (unsigned char *)&hdr;
+	enum kernel_format format;
+	ssize_t read;
+
+	read = load_file_read(f, probe, 0, len);
+	if (read < 0 || (size_t)read != len)
+		return ERR_IO;
+
+	if (!f->fit && fdt_magic(probe) == FDT_MAGIC) {
+		dprintf(INFO, "FIT images are booted without fdt and fdtdir\n");
+		return ERR_NOT_SUPPORTED;
+	}
+
+	if (is_gzip_package(probe, len))
+		format = KERNEL_GZIP;
+	else if (lz4_is_compressed(probe, len))
+		format = KERNEL_LZ4;
+	else if (zstd_is_compressed(probe, len))
+		format = KERNEL_ZSTD;
+	else
+		format = KERNEL_RAW;
+
+	if (format != KERNEL_RAW) {
+		memset(&hdr, 0, sizeof(hdr));
+		choose_addrs(&hdr, ramdisk_size, addrs);
+		return format;
+	}
+
+	choose_addrs(&hdr, ramdisk_size, addrs);
+
+	if (!kernel_fits(&hdr, f->size, addrs)) {
+		dprintf(INFO, "Kernel too big: %lld > %u\n",
+			f->size, addrs->kernel_max_size);
+		return ERR_TOO_BIG;
+	}
+
+	/*
+	 * Load the whole kernel in place, reading the small probed part
+	 * again is cheaper than copying it over.
+	 */
+	f->buf = addrs->kernel;
+	return format;
+}
+
+/**
+ * load_kernel() - Wait for the kernel and decompress it if needed.
+ * @l:            Loader reading the kernel
+ * @f:            Kernel file
+ * @format:       Format returned by probe_kernel()
+ * @ramdisk_size: Size of the ramdisk for choose_addrs()
+ * @addrs:        Returns the chosen load addresses
+ * @kernel_size:  Returns the size of the loaded kernel
+ *
+ * Returns: 0 on success or negative error.
+ */
+int load_kernel(struct loader *l, struct load_file *f,
+		       enum kernel_format format, uint32_t ramdisk_size,
+		       struct load_addrs *addrs, unsigned int *kernel_size)
+{
+	unsigned int stage;
+	int ret;
+
+	if (format == KERNEL_RAW) {
+		if (loader_wait(l, f, f->size) < 0)
+			return ERR_IO;
+		*kernel_size = f->size;
+		return 0;
+	}
+
+	dprintf(INFO, "Decompressing the kernel...\n");
+	stage = lk2nd_timeline_begin("decompress", NULL);
+
+	if (format == KERNEL_GZIP)
+		ret = inflate_kernel(l, f, ramdisk_size, addrs, kernel_size);
+	else
+		ret = unpack_kernel(l, f, format == KERNEL_LZ4 ?
+				    lz4_decompress : zstd_decompress,
+				    ramdisk_size, addrs, kernel_size);
+
+	lk2nd_timeline_end(stage);
+	return ret;
+}
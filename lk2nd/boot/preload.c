@@ -0,0 +1,249 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <debug.h>
+#include <err.h>
+#include <kernel/event.h>
+#include <kernel/thread.h>
+#include <lib/fs.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <lk2nd/boot.h>
+#include <lk2nd/timeline.h>
+#include <lk2nd/util/region.h>
+
+#include "boot.h"
+
+/*
+ * preload.c - Read the default label while the boot menu waits for input.
+ *
+ * The files of the label that lk2nd_boot() tries first are read into a
+ * region of the scratch memory by a separate thread. The loader copies them
+ * from there instead of reading them again, as long as the path and the size
+ * match. The kernel is not decompressed here, its destination depends on the
+ * boot memory layout that lk2nd_boot_label() chooses later. Only one thread
+ * may access the file systems at a time, so the preload is either waited for
+ * or cancelled before anything else uses them.
+ */
+
+#define PRELOAD_MAX_FILES		16
+#define PRELOAD_CHUNK_SIZE		(1024 * 1024)
+
+struct preload_file {
+	const char *path;
+	struct filehandle *fileh;
+	off_t size;
+	void *buf;
+};
+
+static struct preload_file preload_files[PRELOAD_MAX_FILES];
+static unsigned int preload_count;
+static void *preload_region;
+static volatile bool preload_cancel;
+static bool preload_running;
+static event_t preload_finished;
+
+static void preload_add(const char *path)
+{
+	if (preload_count < PRELOAD_MAX_FILES)
+		preload_files[preload_count].path = path;
+	preload_count++;
+}
+
+static void preload_free(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < preload_count && i < PRELOAD_MAX_FILES; i++)
+		if (preload_files[i].fileh)
+			fs_close_file(preload_files[i].fileh);
+	memset(preload_files, 0, sizeof(preload_files));
+	preload_count = 0;
+
+	if (preload_region)
+		lk2nd_region_free(preload_region);
+	preload_region = NULL;
+}
+
+static int preload_read(struct preload_file *f)
+{
+	off_t done;
+	ssize_t ret;
+	size_t len;
+
+	for (done = 0; done < f->size; done += len) {
+		if (preload_cancel)
+			return ERR_NOT_READY;
+
+		len = MIN(PRELOAD_CHUNK_SIZE, (size_t)(f->size - done));
+		ret = fs_read_file(f->fileh, (char *)f->buf + done, done, len);
+		if (ret < 0 || (size_t)ret != len)
+			return ret < 0 ? ret : ERR_IO;
+	}
+
+	return 0;
+}
+
+static int preload_label(const struct label *label)
+{
+	struct file_stat stat;
+	unsigned int i;
+	size_t size = 0;
+	char *pos;
+	int ret;
+
+	/* A FIT is read by image, only separate files are preloaded */
+	if (!label->dtb)
+		return ERR_NOT_SUPPORTED;
+
+	preload_add(label->kernel);
+	preload_add(label->dtb);
+	for (i = 0; label->dtboverlays && label->dtboverlays[i]; i++)
+		preload_add(label->dtboverlays[i]);
+	for (i = 0; label->initramfs && label->initramfs[i]; i++)
+		preload_add(label->initramfs[i]);
+	if (preload_count > PRELOAD_MAX_FILES)
+		return ERR_TOO_BIG;
+
+	for (i = 0; i < preload_count; i++) {
+		struct preload_file *f = &preload_files[i];
+
+		ret = fs_open_file(f->path, &f->fileh);
+		if (ret < 0)
+			return ret;
+
+		ret = fs_stat_file(f->fileh, &stat);
+		if (ret < 0)
+			return ret;
+
+		f->size = stat.size;
+		size += ROUNDUP(f->size, CACHE_LINE);
+	}
+
+	preload_region = lk2nd_region_alloc("preload", size);
+	if (!preload_region)
+		return ERR_NO_MEMORY;
+
+	pos = preload_region;
+	for (i = 0; i < preload_count; i++) {
+		struct preload_file *f = &preload_files[i];
+
+		f->buf = pos;
+		pos += ROUNDUP(f->size, CACHE_LINE);
+
+		ret = preload_read(f);
+		if (ret < 0)
+			return ret;
+
+		fs_close_file(f->fileh);
+		f->fileh = NULL;
+	}
+
+	return 0;
+}
+
+static int preload_thread(void *arg)
+{
+	struct label label = {0};
+	char mountpoint[128];
+	unsigned int stage;
+	int ret;
+
+	stage = lk2nd_timeline_begin("preload", NULL);
+
+	ret = lk2nd_boot_find_root(mountpoint, sizeof(mountpoint));
+	if (ret >= 0)
+		ret = lk2nd_read_extlinux(mountpoint, &label);
+	if (ret >= 0)
+		ret = preload_label(&label);
+
+	if (ret < 0) {
+		if (!preload_cancel)
+			dprintf(INFO, "boot: Nothing preloaded: %d\n", ret);
+		preload_free();
+	} else {
+		dprintf(INFO, "boot: Preloaded %u files of '%s'\n",
+			preload_count, label.name);
+	}
+
+	lk2nd_timeline_end(stage);
+	event_signal(&preload_finished, false);
+	return 0;
+}
+
+/**
+ * lk2nd_boot_preload_start() - Start reading the default label.
+ *
+ * Must be followed by lk2nd_boot_preload_wait() or
+ * lk2nd_boot_preload_discard() before the file systems are used again.
+ */
+void lk2nd_boot_preload_start(void)
+{
+	thread_t *thread;
+
+	if (preload_running || preload_count)
+		return;
+
+	preload_cancel = false;
+	event_init(&preload_finished, false, 0);
+
+	/* Low priority so that it does not get in the way of the menu */
+	thread = thread_create("boot-preload", preload_thread, NULL,
+			       LOW_PRIORITY, DEFAULT_STACK_SIZE);
+	if (!thread) {
+		event_destroy(&preload_finished);
+		return;
+	}
+
+	preload_running = true;
+	thread_resume(thread);
+}
+
+/**
+ * lk2nd_boot_preload_wait() - Wait until the default label is read.
+ *
+ * The preloaded files are kept for the next boot attempt.
+ */
+void lk2nd_boot_preload_wait(void)
+{
+	if (!preload_running)
+		return;
+
+	event_wait(&preload_finished);
+	event_destroy(&preload_finished);
+	preload_running = false;
+}
+
+/**
+ * lk2nd_boot_preload_discard() - Stop reading and free the preloaded files.
+ */
+void lk2nd_boot_preload_discard(void)
+{
+	preload_cancel = true;
+	lk2nd_boot_preload_wait();
+	preload_free();
+}
+
+/**
+ * lk2nd_boot_preload_copy() - Fill a file of the loader from the preload.
+ *
+ * Returns: True if @f was loaded completely, false if it must be read.
+ */
+bool lk2nd_boot_preload_copy(struct load_file *f)
+{
+	unsigned int i;
+
+	if (f->bdev || f->fit || f->offset)
+		return false;
+
+	for (i = 0; i < preload_count; i++) {
+		struct preload_file *p = &preload_files[i];
+
+		if (p->size == f->size && !strcmp(p->path, f->path)) {
+			memcpy(f->buf, p->buf, f->size);
+			return true;
+		}
+	}
+
+	return false;
+}
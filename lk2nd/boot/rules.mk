@@ -4,11 +4,21 @@ LOCAL_DIR := $(GET_LOCAL_DIR)
 MODULES += \
 	lib/bio \
 	lib/fs \
+	lib/lz4 \
+	lib/zstd \
 	lk2nd/hw/bdev \
 
 OBJS += \
 	$(LOCAL_DIR)/boot.o \
+	$(LOCAL_DIR)/bootimg.o \
 	$(LOCAL_DIR)/extlinux.o \
+	$(LOCAL_DIR)/extlinux-conf.o \
+	$(LOCAL_DIR)/fastboot.o \
+	$(LOCAL_DIR)/fit.o \
+	$(LOCAL_DIR)/hint.o \
+	$(LOCAL_DIR)/loader.o \
+	$(LOCAL_DIR)/preload.o \
+	$(LOCAL_DIR)/splash.o \
 	$(LOCAL_DIR)/util.o \
 	$(LOCAL_DIR)/ab.o \
 	$(LOCAL_DIR)/ubootenv.o \
@@ -17,3 +27,7 @@ OBJS += \
 LK2ND_BOOT_MEM_SIZE ?= 0x03200000
 
 DEFINES += LK2ND_BOOT_MEM_SIZE=$(LK2ND_BOOT_MEM_SIZE)
+
+# Read large files from FAT partitions with a cluster link map and a
+# private sector buffer per file instead of walking the FAT chain
+DEFINES += FF_USE_FASTSEEK=1 FF_FS_TINY=0
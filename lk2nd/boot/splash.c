@@ -0,0 +1,212 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <debug.h>
+#include <dev/fbcon.h>
+#include <lib/fs.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "boot.h"
+
+/*
+ * splash.c - Show an image from the boot filesystem while the kernel loads.
+ *
+ * The image is a QOI file ("Quite OK Image Format", https://qoiformat.org/),
+ * the same format "fastboot oem screenshot qoi" produces. It is decoded while
+ * the file is read in small chunks, straight into the framebuffer in its pixel
+ * format, so there is no buffer for the whole image.
+ */
+
+#define SPLASH_CHUNK_SIZE	(16 * 1024)
+
+#define QOI_OP_INDEX	0x00
+#define QOI_OP_DIFF	0x40
+#define QOI_OP_LUMA	0x80
+#define QOI_OP_RUN	0xc0
+#define QOI_OP_RGB	0xfe
+#define QOI_OP_RGBA	0xff
+#define QOI_OP_MASK	0xc0
+
+#define QOI_HEADER_SIZE	14
+
+struct qoi_px {
+	uint8_t r, g, b, a;
+};
+
+struct splash_reader {
+	struct filehandle *fileh;
+	off_t pos;
+	uint8_t *buf;
+	size_t len;
+	size_t off;
+};
+
+static int splash_getc(struct splash_reader *rd)
+{
+	ssize_t ret;
+
+	if (rd->off == rd->len) {
+		ret = fs_read_file(rd->fileh, rd->buf, rd->pos, SPLASH_CHUNK_SIZE);
+		if (ret <= 0)
+			return -1;
+		rd->pos += ret;
+		rd->len = ret;
+		rd->off = 0;
+	}
+
+	return rd->buf[rd->off++];
+}
+
+static inline unsigned qoi_hash(struct qoi_px px)
+{
+	return (px.r * 3 + px.g * 5 + px.b * 7 + px.a * 11) % 64;
+}
+
+/* Transparent parts of the image are drawn on black */
+static inline void splash_put(uint8_t *p, struct qoi_px px, unsigned bpp)
+{
+	uint16_t rgb565;
+
+	if (px.a != 0xff) {
+		px.r = px.r * px.a / 0xff;
+		px.g = px.g * px.a / 0xff;
+		px.b = px.b * px.a / 0xff;
+	}
+
+	switch (bpp) {
+	case 16:
+		rgb565 = (px.r >> 3) << 11 | (px.g >> 2) << 5 | px.b >> 3;
+		p[0] = rgb565;
+		p[1] = rgb565 >> 8;
+		break;
+	case 32:
+		p[3] = 0xff;
+		/* fallthrough */
+	case 24:
+		p[0] = px.b;
+		p[1] = px.g;
+		p[2] = px.r;
+		break;
+	}
+}
+
+static int splash_decode(struct splash_reader *rd, struct fbcon_config *fb)
+{
+	struct qoi_px index[64] = {0};
+	struct qoi_px px = { 0, 0, 0, 0xff };
+	uint8_t hdr[QOI_HEADER_SIZE];
+	unsigned bytes = fb->bpp / 8, width, height, x, y, run = 0;
+	int c, i, vg;
+	uint8_t *p;
+
+	for (i = 0; i < QOI_HEADER_SIZE; i++) {
+		c = splash_getc(rd);
+		if (c < 0)
+			return -1;
+		hdr[i] = c;
+	}
+
+	if (memcmp(hdr, "qoif", 4)) {
+		dprintf(INFO, "splash: Not a QOI image\n");
+		return -1;
+	}
+
+	width = hdr[4] << 24 | hdr[5] << 16 | hdr[6] << 8 | hdr[7];
+	height = hdr[8] << 24 | hdr[9] << 16 | hdr[10] << 8 | hdr[11];
+	if (!width || !height || width > fb->width || height > fb->height) {
+		dprintf(INFO, "splash: Image size %ux%u does not fit the display\n",
+			width, height);
+		return -1;
+	}
+
+	memset(fb->base, 0, fb->stride * fb->height * bytes);
+
+	/* Centered on the screen */
+	x = (fb->width - width) / 2;
+	y = (fb->height - height) / 2;
+	p = (uint8_t *)fb->base + (y * fb->stride + x) * bytes;
+
+	for (y = 0; y < height; y++, p += fb->stride * bytes) {
+		for (x = 0; x < width; x++) {
+			if (run) {
+				run--;
+				splash_put(p + x * bytes, px, fb->bpp);
+				continue;
+			}
+
+			c = splash_getc(rd);
+			if (c < 0)
+				return -1;
+
+			if (c == QOI_OP_RGB || c == QOI_OP_RGBA) {
+				px.r = splash_getc(rd);
+				px.g = splash_getc(rd);
+				px.b = splash_getc(rd);
+				if (c == QOI_OP_RGBA)
+					px.a = splash_getc(rd);
+			} else {
+				switch (c & QOI_OP_MASK) {
+				case QOI_OP_INDEX:
+					px = index[c];
+					break;
+				case QOI_OP_DIFF:
+					px.r += ((c >> 4) & 0x03) - 2;
+					px.g += ((c >> 2) & 0x03) - 2;
+					px.b += (c & 0x03) - 2;
+					break;
+				case QOI_OP_LUMA:
+					vg = (c & 0x3f) - 32;
+					c = splash_getc(rd);
+					px.r += vg - 8 + ((c >> 4) & 0x0f);
+					px.g += vg;
+					px.b += vg - 8 + (c & 0x0f);
+					break;
+				case QOI_OP_RUN:
+					run = c & 0x3f;
+					break;
+				}
+			}
+
+			index[qoi_hash(px)] = px;
+			splash_put(p + x * bytes, px, fb->bpp);
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * lk2nd_boot_splash() - Show a QOI image from the boot filesystem.
+ * @path: Path of the image
+ *
+ * Must be called before the loader thread starts, it reads the file itself.
+ */
+void lk2nd_boot_splash(const char *path)
+{
+	struct fbcon_config *fb = fbcon_display();
+	struct splash_reader rd = {0};
+	int ret;
+
+	if (!fb || (fb->bpp != 16 && fb->bpp != 24 && fb->bpp != 32)) {
+		dprintf(INFO, "splash: No usable display\n");
+		return;
+	}
+
+	ret = fs_open_file(path, &rd.fileh);
+	if (ret < 0) {
+		dprintf(INFO, "splash: Failed to open %s: %d\n", path, ret);
+		return;
+	}
+
+	rd.buf = malloc(SPLASH_CHUNK_SIZE);
+	if (rd.buf) {
+		ret = splash_decode(&rd, fb);
+		if (ret < 0)
+			dprintf(INFO, "splash: Failed to decode %s\n", path);
+		free(rd.buf);
+	}
+	fs_close_file(rd.fileh);
+
+	/* Even a partially decoded image replaces whatever was shown before */
+	fbcon_flush();
+}
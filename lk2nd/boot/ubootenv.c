@@ -59,16 +59,53 @@ void uboot_env_parse_rauc_vars(struct uboot_env *env)
 		env->boot_order, env->boot_a_left, env->boot_b_left);
 }
 
-int uboot_env_init(struct uboot_env *env, const char *partition, uint64_t offset, size_t size)
+/* Check the CRC of one env copy */
+static bool uboot_env_check(const uint8_t *buffer, size_t size, bool has_flags)
+{
+	size_t hdr = has_flags ? 5 : 4;
+
+	/* U-Boot stores CRC32 in little-endian format regardless of system endianness */
+	return LE32(*(uint32_t *)buffer) == uboot_env_crc(buffer + hdr, size - hdr);
+}
+
+/* Pick the newer of two valid redundant copies, same rules as U-Boot */
+static int uboot_env_newer(uint8_t flags0, uint8_t flags1)
+{
+	if (flags0 == 0xFF && flags1 == 0)
+		return 1;
+	if (flags1 == 0xFF && flags0 == 0)
+		return 0;
+	return flags1 > flags0 ? 1 : 0;
+}
+
+static ssize_t uboot_env_read_copy(bdev_t *bdev, uint8_t *buffer, uint64_t offset, size_t size)
+{
+	ssize_t ret = bio_read(bdev, buffer, offset, size);
+
+	if (ret != (ssize_t)size)
+		dprintf(CRITICAL, "ubootenv: Failed to read environment at 0x%llx: %ld\n",
+			offset, ret);
+	return ret;
+}
+
+int uboot_env_init(struct uboot_env *env, const char *partition, uint64_t offset,
+		   uint64_t offset_redund, size_t size)
 {
 	bdev_t *bdev;
-	uint8_t *buffer;
-	ssize_t ret;
+	uint8_t *buffer[2] = { NULL, NULL };
+	bool readable[2] = { false, false };
+	bool valid[2] = { false, false };
+	size_t hdr;
+	int copy;
 
-	if (!env || !partition || size == 0)
+	if (!env || !partition || size <= 5)
 		return -1;
 
 	memset(env, 0, sizeof(*env));
+	env->size = size;
+	env->offset[0] = offset;
+	env->offset[1] = offset_redund;
+	env->redundant = offset_redund != 0;
 
 	bdev = bio_open(partition);
 	if (!bdev) {
@@ -76,78 +113,62 @@ int uboot_env_init(struct uboot_env *env, const char *partition, uint64_t offset
 		return -1;
 	}
 
-	/* Allocate buffer for environment (header + data) */
-	buffer = malloc(size);
-	if (!buffer) {
-		bio_close(bdev);
-		return -1;
+	/* Read all copies of the environment (header + data) */
+	for (copy = 0; copy <= env->redundant; copy++) {
+		buffer[copy] = malloc(size);
+		if (!buffer[copy]) {
+			bio_close(bdev);
+			free(buffer[0]);
+			return -1;
+		}
+		readable[copy] = uboot_env_read_copy(bdev, buffer[copy],
+						     env->offset[copy], size) == (ssize_t)size;
 	}
-
-	/* Read environment from partition */
-	ret = bio_read(bdev, buffer, offset, size);
 	bio_close(bdev);
 
-	if (ret != (ssize_t)size) {
-		dprintf(CRITICAL, "ubootenv: Failed to read environment: %ld\n", ret);
-		free(buffer);
+	if (!readable[0] && !readable[1]) {
+		free(buffer[0]);
+		free(buffer[1]);
 		return -1;
 	}
 
-	/* Try to parse as either redundant (CRC+flags+data) or non-redundant (CRC+data)
-	 * U-Boot stores CRC32 in little-endian format regardless of system endianness */
-	env->size = size;
-	uint32_t stored_crc = LE32(*(uint32_t *)buffer);
-
-	/* First, attempt redundant format (flags at byte 4) */
-	uint8_t flags_candidate = buffer[4];
-	size_t data_size_redundant = size - 5;
-	uint32_t crc_redundant = uboot_env_crc(buffer + 5, data_size_redundant);
-
-	/* Then, attempt non-redundant format (no flags byte) */
-	size_t data_size_plain = size - 4;
-	uint32_t crc_plain = uboot_env_crc(buffer + 4, data_size_plain);
-
-	if (crc_redundant == stored_crc && (flags_candidate == 0 || flags_candidate == 1)) {
-		/* Accept redundant format */
+	if (env->redundant) {
+		/* Both copies always have the flags byte */
 		env->has_flags = true;
-		env->crc = stored_crc;
-		env->flags = flags_candidate;
-		env->data_size = data_size_redundant;
-		env->data = malloc(env->data_size);
-		if (!env->data) {
-			free(buffer);
-			return -1;
-		}
-		memcpy(env->data, buffer + 5, env->data_size);
-		free(buffer);
-	} else if (crc_plain == stored_crc) {
-		/* Accept non-redundant format */
-		env->has_flags = false;
-		env->crc = stored_crc;
-		env->flags = 0; /* not used */
-		env->data_size = data_size_plain;
-		env->data = malloc(env->data_size);
-		if (!env->data) {
-			free(buffer);
-			return -1;
-		}
-		memcpy(env->data, buffer + 4, env->data_size);
-		free(buffer);
+		valid[0] = readable[0] && uboot_env_check(buffer[0], size, true);
+		valid[1] = readable[1] && uboot_env_check(buffer[1], size, true);
+		if (valid[0] && valid[1])
+			env->active = uboot_env_newer(buffer[0][4], buffer[1][4]);
+		else
+			env->active = valid[1] ? 1 : 0;
+	} else if (uboot_env_check(buffer[0], size, true) &&
+		   (buffer[0][4] == 0 || buffer[0][4] == 1)) {
+		/* Single copy, but in redundant format (flags at byte 4) */
+		env->has_flags = true;
+		valid[0] = true;
 	} else {
-		/* Neither matched: initialize empty environment using non-redundant format by default */
+		/* Non-redundant format (no flags byte) */
 		env->has_flags = false;
-		env->crc = 0;
-		env->flags = 0;
-		env->data_size = data_size_plain;
-		env->data = malloc(env->data_size);
-		if (!env->data) {
-			free(buffer);
-			return -1;
-		}
+		valid[0] = uboot_env_check(buffer[0], size, false);
+	}
+
+	hdr = env->has_flags ? 5 : 4;
+	env->data_size = size - hdr;
+	env->data = malloc(env->data_size);
+	if (!env->data) {
+		free(buffer[0]);
+		free(buffer[1]);
+		return -1;
+	}
+
+	if (!valid[env->active]) {
+		/* Nothing matched: initialize empty environment */
 		memset(env->data, 0, env->data_size);
-		free(buffer);
+		free(buffer[0]);
+		free(buffer[1]);
 		env->dirty = true;
-		dprintf(INFO, "ubootenv: CRC mismatch, initializing clean env (non-redundant)\n");
+		dprintf(INFO, "ubootenv: CRC mismatch, initializing clean env (%s)\n",
+			env->redundant ? "redundant" : "non-redundant");
 
 		/* Parse (i.e. seed) the RAUC A/B boot variables */
 		uboot_env_parse_rauc_vars(env);
@@ -156,10 +177,18 @@ int uboot_env_init(struct uboot_env *env, const char *partition, uint64_t offset
 		return 1;
 	}
 
+	copy = env->active;
+	env->crc = LE32(*(uint32_t *)buffer[copy]);
+	env->flags = env->has_flags ? buffer[copy][4] : 0;
+	memcpy(env->data, buffer[copy] + hdr, env->data_size);
+	free(buffer[0]);
+	free(buffer[1]);
+
 	/* Parse RAUC A/B boot variables */
 	uboot_env_parse_rauc_vars(env);
 
-	dprintf(INFO, "ubootenv: Initialized from %s at offset 0x%llx\n", partition, offset);
+	dprintf(INFO, "ubootenv: Initialized from %s at offset 0x%llx\n",
+		partition, env->offset[copy]);
 
 	return 0;
 }
@@ -209,6 +238,10 @@ int uboot_env_set(struct uboot_env *env, const char *key, const char *value)
 	}
 
 	if (existing) {
+		/* Nothing to do (and nothing to write back) if the value is the same */
+		if (strcmp(existing + key_len + 1, value) == 0)
+			return 0;
+
 		/* Update existing entry */
 		if (entry_len <= existing_len) {
 			/* New value fits in place - safe to use snprintf */
@@ -253,15 +286,26 @@ int uboot_env_set(struct uboot_env *env, const char *key, const char *value)
 	return 0;
 }
 
-int uboot_env_save(struct uboot_env *env, const char *partition, uint64_t offset)
+int uboot_env_save(struct uboot_env *env, const char *partition)
 {
 	bdev_t *bdev;
 	uint8_t *buffer;
+	uint8_t flags;
 	ssize_t ret;
+	int copy;
 
 	if (!env || !partition || !env->dirty)
 		return 0;
 
+	/* A redundant env is written to the other copy with the next flags value */
+	if (env->redundant) {
+		copy = !env->active;
+		flags = env->flags + 1;
+	} else {
+		copy = 0;
+		flags = UBOOT_ENV_FLAG_ACTIVE;
+	}
+
 	/* Recalculate CRC */
 	env->crc = uboot_env_crc((uint8_t *)env->data, env->data_size);
 
@@ -270,11 +314,10 @@ int uboot_env_save(struct uboot_env *env, const char *partition, uint64_t offset
 	if (!buffer)
 		return -1;
 
-	memset(buffer, 0, env->size);
 	/* Write CRC in little-endian format (U-Boot standard) */
 	*(uint32_t *)buffer = LE32(env->crc);
 	if (env->has_flags) {
-		buffer[4] = UBOOT_ENV_FLAG_ACTIVE;
+		buffer[4] = flags;
 		memcpy(buffer + 5, env->data, env->data_size);
 	} else {
 		/* Non-redundant format: CRC + data */
@@ -288,7 +331,7 @@ int uboot_env_save(struct uboot_env *env, const char *partition, uint64_t offset
 		return -1;
 	}
 
-	ret = bio_write(bdev, buffer, offset, env->size);
+	ret = bio_write(bdev, buffer, env->offset[copy], env->size);
 	bio_close(bdev);
 	free(buffer);
 
@@ -297,8 +340,10 @@ int uboot_env_save(struct uboot_env *env, const char *partition, uint64_t offset
 		return -1;
 	}
 
+	env->flags = flags;
+	env->active = copy;
 	env->dirty = false;
-	dprintf(INFO, "ubootenv: Saved to %s at offset 0x%llx\n", partition, offset);
+	dprintf(INFO, "ubootenv: Saved to %s at offset 0x%llx\n", partition, env->offset[copy]);
 	return 0;
 }
 
@@ -40,25 +40,37 @@ struct uboot_env {
 	bool dirty;
 	bool has_flags;        /* true: format is [CRC][flags][data], false: [CRC][data] */
 
+	/*
+	 * Redundant env (CONFIG_SYS_REDUNDAND_ENVIRONMENT): two copies, the
+	 * flags byte is a counter and the copy with the newer one is used.
+	 * Saving writes the other copy, so one valid copy always remains.
+	 */
+	bool redundant;
+	uint64_t offset[2];    /* Byte offset of each copy */
+	int active;            /* Copy the env was read from / last saved to */
+
 	/* Parsed RAUC-style boot state (cached for performance) */
 	char boot_order[32];     /* BOOT_ORDER value (e.g., "A B") */
 	int boot_a_left;         /* BOOT_A_LEFT counter */
 	int boot_b_left;         /* BOOT_B_LEFT counter */
 };
 
-/* Initialize U-Boot environment from partition at given offset.
+/* Initialize U-Boot environment from partition at given offset, and from
+ * the redundant copy at offset_redund unless it is 0.
  * Returns 0 when a valid env was read, 1 when no valid env was found
  * (a clean one is set up in memory), negative on error. */
-int uboot_env_init(struct uboot_env *env, const char *partition, uint64_t offset, size_t size);
+int uboot_env_init(struct uboot_env *env, const char *partition, uint64_t offset,
+		   uint64_t offset_redund, size_t size);
 
 /* Get environment variable value (returns pointer into env->data) */
 const char *uboot_env_get(struct uboot_env *env, const char *key);
 
-/* Set environment variable and mark environment as dirty */
+/* Set environment variable and mark environment as dirty if it changed */
 int uboot_env_set(struct uboot_env *env, const char *key, const char *value);
 
-/* Save environment back to partition (only if dirty) */
-int uboot_env_save(struct uboot_env *env, const char *partition, uint64_t offset);
+/* Save environment back to partition (only if dirty). With a redundant
+ * env the copy that was not read from is written. */
+int uboot_env_save(struct uboot_env *env, const char *partition);
 
 /* Free environment resources */
 void uboot_env_free(struct uboot_env *env);
@@ -0,0 +1,95 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <debug.h>
+#include <kernel/thread.h>
+#include <reg.h>
+
+#include <clock.h>
+#include <clock_lib2.h>
+
+#include <lk2nd/cpufreq.h>
+
+#include "cpufreq.h"
+
+/*
+ * The boot cluster keeps running at the clock the previous bootloader chose.
+ * Only rates from the frequency table of the clock mux (i.e. from GPLL0) are
+ * used for the boost. These are the ones lk2nd/smp already sets up for the
+ * secondary clusters without changing any regulator, so no vote is needed.
+ * If the cluster runs from its own PLL or already at the boost rate, it is
+ * left alone. Switching the mux only takes a few register writes, so it is
+ * done in a critical section as the loader thread may boost concurrently.
+ */
+static unsigned int boost_count;
+static struct clk *boost_clk;
+static unsigned long restore_rate;
+
+/* Rate of the table entry the mux is set to, 0 if there is none */
+static unsigned long cpufreq_current_rate(struct clk *clk)
+{
+	struct rcg_clk *rclk = to_rcg_clk(clk);
+	struct clk_freq_tbl *f;
+	uint32_t cfg;
+
+	cfg = readl(rclk->cfg_reg) & (CFG_SRC_SEL_MASK | CFG_SRC_DIV_MASK);
+	for (f = rclk->freq_tbl; f->freq_hz != FREQ_END; f++)
+		if (f->div_src_val == cfg)
+			return f->freq_hz;
+
+	return 0;
+}
+
+static void cpufreq_start(void)
+{
+	const struct cpufreq_soc *soc = cpufreq_get_soc();
+	unsigned long rate;
+	struct clk *clk;
+
+	if (!soc)
+		return;
+
+	clk = clk_get((char *)soc->clk);
+	if (!clk)
+		return;
+
+	rate = cpufreq_current_rate(clk);
+	if (!rate || rate >= soc->rate)
+		return;
+
+	if (clk_set_rate(clk, soc->rate)) {
+		dprintf(CRITICAL, "cpufreq: Failed to set %s to %lu Hz\n",
+			soc->clk, soc->rate);
+		return;
+	}
+
+	dprintf(SPEW, "cpufreq: %s %lu -> %lu Hz\n", soc->clk, rate, soc->rate);
+	boost_clk = clk;
+	restore_rate = rate;
+}
+
+static void cpufreq_stop(void)
+{
+	if (!boost_clk)
+		return;
+
+	if (clk_set_rate(boost_clk, restore_rate))
+		dprintf(CRITICAL, "cpufreq: Failed to restore %lu Hz\n", restore_rate);
+	boost_clk = NULL;
+}
+
+void lk2nd_cpufreq_boost(void)
+{
+	enter_critical_section();
+	if (!boost_count++)
+		cpufreq_start();
+	exit_critical_section();
+}
+
+void lk2nd_cpufreq_unboost(void)
+{
+	enter_critical_section();
+	ASSERT(boost_count);
+	if (!--boost_count)
+		cpufreq_stop();
+	exit_critical_section();
+}
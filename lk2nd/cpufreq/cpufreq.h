@@ -0,0 +1,18 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#ifndef LK2ND_CPUFREQ_CPUFREQ_H
+#define LK2ND_CPUFREQ_CPUFREQ_H
+
+/**
+ * struct cpufreq_soc - CPU clock of the boot cluster.
+ * @clk:  Name of the clock mux of the cluster
+ * @rate: Rate to boost to, must be in the frequency table of @clk
+ */
+struct cpufreq_soc {
+	const char *clk;
+	unsigned long rate;
+};
+
+/* soc-<platform>.c, NULL if the SoC is not supported */
+const struct cpufreq_soc *cpufreq_get_soc(void);
+
+#endif /* LK2ND_CPUFREQ_CPUFREQ_H */
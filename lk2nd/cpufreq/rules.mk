@@ -0,0 +1,6 @@
+# SPDX-License-Identifier: BSD-3-Clause
+LOCAL_DIR := $(GET_LOCAL_DIR)
+
+OBJS += \
+	$(LOCAL_DIR)/cpufreq.o \
+	$(LOCAL_DIR)/soc-$(PLATFORM).o \
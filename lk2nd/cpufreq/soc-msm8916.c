@@ -0,0 +1,16 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "cpufreq.h"
+
+#define MHZ				1000000
+
+/* Boot cluster, MSM8939 has the second one on a53ssmux_lc */
+static const struct cpufreq_soc msm8916_soc = {
+	.clk = "a53ssmux",
+	.rate = 800 * MHZ,
+};
+
+const struct cpufreq_soc *cpufreq_get_soc(void)
+{
+	return &msm8916_soc;
+}
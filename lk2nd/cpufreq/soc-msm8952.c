@@ -0,0 +1,26 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <platform.h>
+
+#include "cpufreq.h"
+
+#define MHZ				1000000
+
+/* The boot cluster is the one lk2nd/smp does not set up for secondary CPUs */
+static const struct cpufreq_soc msm8952_soc = {
+	.clk = "a53ssmux_c1",
+	.rate = 800 * MHZ,
+};
+
+static const struct cpufreq_soc msm8956_soc = {
+	.clk = "a53ssmux_c0",
+	.rate = 800 * MHZ,
+};
+
+const struct cpufreq_soc *cpufreq_get_soc(void)
+{
+	if (platform_is_msm8956())
+		return &msm8956_soc;
+
+	return &msm8952_soc;
+}
@@ -0,0 +1,16 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "cpufreq.h"
+
+#define MHZ				1000000
+
+/* a53ssmux_c0 is set up for the secondary cluster by lk2nd/smp */
+static const struct cpufreq_soc msm8953_soc = {
+	.clk = "a53ssmux_c1",
+	.rate = 800 * MHZ,
+};
+
+const struct cpufreq_soc *cpufreq_get_soc(void)
+{
+	return &msm8953_soc;
+}
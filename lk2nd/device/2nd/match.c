@@ -50,44 +50,44 @@ static bool match_panel(const void *dtb, int node, const char *panel_name)
 	return fdt_subnode_offset(dtb, node, panel_name) >= 0;
 }
 
+#define MATCH_PREFIX		"lk2nd,match-"
+#define MATCH_PREFIX_LEN	(sizeof(MATCH_PREFIX) - 1)
+
+/*
+ * The properties of each node are walked only once, instead of looking up
+ * every lk2nd,match-* property separately (which scans them each time).
+ * All match properties that are present must match, and there must be one.
+ */
 static bool match_device_node(const void *dtb, int node)
 {
-	bool matched = false;
+	bool matched = false, ok;
 	const fdt32_t *num;
-	const char *str;
-	int len;
-
-	str = fdt_getprop(dtb, node, "lk2nd,match-bootloader", &len);
-	if (len != -FDT_ERR_NOTFOUND) {
-		if (!match_string(lk2nd_dev.bootloader, str, len))
-			return false;
-		matched = true;
-	}
-
-	str = fdt_getprop(dtb, node, "lk2nd,match-cmdline", &len);
-	if (len != -FDT_ERR_NOTFOUND) {
-		if (!match_string(lk2nd_dev.cmdline, str, len))
-			return false;
-		matched = true;
-	}
-
-	str = fdt_getprop(dtb, node, "lk2nd,match-device", &len);
-	if (len != -FDT_ERR_NOTFOUND) {
-		if (!match_string(lk2nd_dev.device, str, len))
-			return false;
-		matched = true;
-	}
-
-	num = fdt_getprop(dtb, node, "lk2nd,match-machtype", &len);
-	if (len != -FDT_ERR_NOTFOUND) {
-		if (len != sizeof(*num) || board_machtype() != fdt32_to_cpu(*num))
-			return false;
-		matched = true;
-	}
+	const char *name;
+	const void *val;
+	int prop, len;
+
+	fdt_for_each_property_offset(prop, dtb, node) {
+		val = fdt_getprop_by_offset(dtb, prop, &name, &len);
+		if (!val || strncmp(name, MATCH_PREFIX, MATCH_PREFIX_LEN) != 0)
+			continue;
+		name += MATCH_PREFIX_LEN;
+
+		if (strcmp(name, "bootloader") == 0) {
+			ok = match_string(lk2nd_dev.bootloader, val, len);
+		} else if (strcmp(name, "cmdline") == 0) {
+			ok = match_string(lk2nd_dev.cmdline, val, len);
+		} else if (strcmp(name, "device") == 0) {
+			ok = match_string(lk2nd_dev.device, val, len);
+		} else if (strcmp(name, "machtype") == 0) {
+			num = val;
+			ok = len == sizeof(*num) && board_machtype() == fdt32_to_cpu(*num);
+		} else if (strcmp(name, "panel") == 0) {
+			ok = match_panel(dtb, node, lk2nd_dev.panel.name);
+		} else {
+			continue;
+		}
 
-	fdt_getprop(dtb, node, "lk2nd,match-panel", &len);
-	if (len != -FDT_ERR_NOTFOUND) {
-		if (len < 0 || !match_panel(dtb, node, lk2nd_dev.panel.name))
+		if (!ok)
 			return false;
 		matched = true;
 	}
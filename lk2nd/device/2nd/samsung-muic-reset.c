@@ -5,7 +5,7 @@
 #include <platform/timer.h>
 
 #include <libfdt.h>
-#include <lk2nd/hw/gpio_i2c.h>
+#include <lk2nd/hw/i2c.h>
 
 #include "device.h"
 
@@ -26,15 +26,15 @@
 
 static int samsung_muic_reset(const void *dtb, int node)
 {
-	uint8_t addr, val = 1;
-	gpio_i2c_info_t i2c;
+	struct lk2nd_i2c i2c;
+	uint8_t val = 1;
 	status_t status;
 
-	status = gpio_i2c_get(dtb, node, &i2c, &addr);
+	status = lk2nd_i2c_get(dtb, node, &i2c);
 	if (status)
 		return status;
 
-	status = gpio_i2c_write_reg_bytes(&i2c, addr, MUIC_RESET_REG, &val, 1);
+	status = lk2nd_i2c_write_reg_bytes(&i2c, MUIC_RESET_REG, &val, 1);
 	if (status) {
 		dprintf(CRITICAL, "muic-reset: I2C write error: %d\n", status);
 		return status;
@@ -3,7 +3,10 @@
 
 #include <debug.h>
 #include <dev/fbcon.h>
+#include <kernel/event.h>
+#include <kernel/thread.h>
 #include <mdp4.h>
+#include <stdlib.h>
 #include <string.h>
 #include <target/display.h>
 
@@ -11,9 +14,83 @@
 
 #include "device.h"
 
-static void mdss_spi_flush(void)
+/* Wait up to 10 ms for drawing to pause for 2 ms before sending, like refresh.c */
+#define SPI_FLUSH_SETTLE_MS	2
+#define SPI_FLUSH_SETTLE_MAX_MS	10
+
+static event_t spi_flush_event;
+
+/* Rows that changed since the last transfer, empty if y0 >= y1 */
+static unsigned spi_dirty_y0, spi_dirty_y1;
+
+static void mdss_spi_flush_rows(unsigned y, unsigned h)
+{
+	mdss_spi_update_rows(fbcon_display(), y, h);
+}
+
+static int mdss_spi_flush_loop(void *data)
 {
-	mdss_spi_on(NULL, fbcon_display());
+	unsigned y0, y1;
+	int i;
+
+	while (true) {
+		event_wait(&spi_flush_event);
+
+		for (i = 0; i < SPI_FLUSH_SETTLE_MAX_MS / SPI_FLUSH_SETTLE_MS; i++)
+			if (event_wait_timeout(&spi_flush_event, SPI_FLUSH_SETTLE_MS) < 0)
+				break;
+
+		enter_critical_section();
+		y0 = spi_dirty_y0;
+		y1 = spi_dirty_y1;
+		spi_dirty_y0 = spi_dirty_y1 = 0;
+		exit_critical_section();
+
+		if (y0 < y1)
+			mdss_spi_flush_rows(y0, y1 - y0);
+	}
+	return 0;
+}
+
+static void mdss_spi_signal_flush(unsigned y, unsigned h)
+{
+	enter_critical_section();
+	if (spi_dirty_y0 >= spi_dirty_y1) {
+		spi_dirty_y0 = y;
+		spi_dirty_y1 = y + h;
+	} else {
+		spi_dirty_y0 = MIN(spi_dirty_y0, y);
+		spi_dirty_y1 = MAX(spi_dirty_y1, y + h);
+	}
+	exit_critical_section();
+
+	event_signal(&spi_flush_event, false);
+}
+
+static void mdss_spi_setup_flush(struct fbcon_config *fb)
+{
+	thread_t *thr;
+
+	fb->update_rows = mdss_spi_flush_rows;
+
+	/*
+	 * Each line printed by the display menu is flushed on its own, which
+	 * sends the rows of that line over SPI. Coalesce bursts of them.
+	 */
+	if (!IS_ENABLED(FBCON_DISPLAY_MSG))
+		return;
+
+	event_init(&spi_flush_event, false, EVENT_FLAG_AUTOUNSIGNAL);
+
+	thr = thread_create("spi-display-flush", &mdss_spi_flush_loop,
+			    NULL, HIGH_PRIORITY, DEFAULT_STACK_SIZE);
+	if (!thr) {
+		dprintf(CRITICAL, "Failed to create spi-display-flush thread\n");
+		return;
+	}
+
+	thread_resume(thr);
+	fb->update_rows = mdss_spi_signal_flush;
 }
 
 static void lk2nd_device2nd_init_spi_display(void)
@@ -41,7 +118,7 @@ static void lk2nd_device2nd_init_spi_display(void)
 	fb.stride = fb.width;
 	fb.bpp = 16;
 	fb.format = FB_FORMAT_RGB565;
-	fb.update_start = mdss_spi_flush;
+	mdss_spi_setup_flush(&fb);
 
 	ret = mdss_spi_init();
 	if (ret) {
@@ -52,3 +129,4 @@ static void lk2nd_device2nd_init_spi_display(void)
 	fbcon_setup(&fb);
 }
 LK2ND_INIT(lk2nd_device2nd_init_spi_display);
+LK2ND_INIT_AFTER(lk2nd_device2nd_init_spi_display, lk2nd_device_init);
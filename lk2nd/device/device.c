@@ -8,8 +8,10 @@
 
 #include <libfdt.h>
 #include <lk2nd/device.h>
+#include <lk2nd/hw/gpio.h>
 #include <lk2nd/init.h>
 #include <lk2nd/panel.h>
+#include <lk2nd/timeline.h>
 #include <lk2nd/util/lkfdt.h>
 
 #include "device.h"
@@ -17,6 +19,14 @@
 
 struct lk2nd_device lk2nd_dev;
 
+/**
+ * lk2nd_device_get_dtb() - Get the DTB the device was detected from.
+ */
+const void *lk2nd_device_get_dtb(void)
+{
+	return lk2nd_dev.dtb;
+}
+
 /**
  * lk2nd_device_get_dtb_hints() - Get a null-terminated array of DTB names.
  */
@@ -25,6 +35,14 @@ const char *const *lk2nd_device_get_dtb_hints(void)
 	return lk2nd_dev.dtbfiles;
 }
 
+/**
+ * lk2nd_device_get_compatible() - Get the compatible of the detected device.
+ */
+const char *lk2nd_device_get_compatible(void)
+{
+	return lk2nd_dev.compatible;
+}
+
 /**
  * lk2nd_device_get_sd_mmc_slot_num() - Get an uint32_t indicating the SDHC slot number for the SD card.
  */
@@ -70,7 +88,9 @@ static bool do_device_init(const void *dtb, int node,
 	int ret = fdt_node_check_compatible(dtb, node, di->compatible);
 	switch (ret) {
 	case 0:
-		ret = di->init(dtb, node);
+		ret = gpiol_pinctrl_apply(dtb, node);
+		if (!ret)
+			ret = di->init(dtb, node);
 		if (ret)
 			dprintf(CRITICAL, "lk2nd device init for %s failed: %d\n",
 				di->compatible, ret);
@@ -164,6 +184,7 @@ INCFILE(lk2nd_bundled_dtb, lk2nd_bundled_dtb_size, LK2ND_BUNDLE_DTB);
 
 static void lk2nd_device_init(void)
 {
+	unsigned int stage;
 	const void *dtb;
 
 #ifdef LK2ND_COMPATIBLE
@@ -183,7 +204,10 @@ static void lk2nd_device_init(void)
 	}
 
 	lk2nd_dev.dtb = dtb;
+
+	stage = lk2nd_timeline_begin("device", NULL);
 	parse_dtb(dtb);
+	lk2nd_timeline_end(stage);
 }
 LK2ND_INIT(lk2nd_device_init);
 
@@ -3,6 +3,9 @@
 
 #include <debug.h>
 #include <dev/keys.h>
+#include <err.h>
+#include <kernel/event.h>
+#include <kernel/thread.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
@@ -84,6 +87,115 @@ static void lk2nd_keys_publish(void)
 	}
 }
 LK2ND_INIT(lk2nd_keys_publish);
+LK2ND_INIT_AFTER(lk2nd_keys_publish, lk2nd_device_init);
+
+/*
+ * Key events are produced by a thread that scans the keys periodically.
+ * A key must read the same for LK2ND_KEYS_DEBOUNCE scans in a row before
+ * the change is reported, so bouncing contacts do not produce events.
+ */
+#define LK2ND_KEYS_SCAN_MS	10
+#define LK2ND_KEYS_DEBOUNCE	2
+#define LK2ND_KEYS_QUEUE_LEN	16
+
+static struct {
+	bool pressed;
+	uint8_t count;
+} key_state[ARRAY_SIZE(published_keys)];
+
+static struct lk2nd_key_event key_queue[LK2ND_KEYS_QUEUE_LEN];
+static unsigned int key_queue_head, key_queue_tail;
+static event_t key_queue_event;
+
+static void lk2nd_keys_queue_push(uint16_t code, bool pressed)
+{
+	unsigned int next;
+
+	enter_critical_section();
+	next = (key_queue_head + 1) % LK2ND_KEYS_QUEUE_LEN;
+	if (next != key_queue_tail) {
+		key_queue[key_queue_head].code = code;
+		key_queue[key_queue_head].pressed = pressed;
+		key_queue_head = next;
+	}
+	exit_critical_section();
+
+	event_signal(&key_queue_event, true);
+}
+
+static bool lk2nd_keys_queue_pop(struct lk2nd_key_event *ev)
+{
+	bool ret = false;
+
+	enter_critical_section();
+	if (key_queue_tail != key_queue_head) {
+		*ev = key_queue[key_queue_tail];
+		key_queue_tail = (key_queue_tail + 1) % LK2ND_KEYS_QUEUE_LEN;
+		ret = true;
+	}
+	exit_critical_section();
+
+	return ret;
+}
+
+static int lk2nd_keys_scan(void *arg)
+{
+	unsigned int i;
+	bool pressed;
+
+	while (true) {
+		for (i = 0; i < ARRAY_SIZE(published_keys); ++i) {
+			pressed = lk2nd_keys_pressed(published_keys[i]);
+			if (pressed == key_state[i].pressed) {
+				key_state[i].count = 0;
+				continue;
+			}
+			if (++key_state[i].count < LK2ND_KEYS_DEBOUNCE)
+				continue;
+
+			key_state[i].pressed = pressed;
+			key_state[i].count = 0;
+			keys_post_event(published_keys[i], pressed);
+			lk2nd_keys_queue_push(published_keys[i], pressed);
+		}
+		thread_sleep(LK2ND_KEYS_SCAN_MS);
+	}
+
+	return 0;
+}
+
+static void lk2nd_keys_scan_start(void)
+{
+	static bool started;
+	thread_t *thread;
+
+	if (started)
+		return;
+	started = true;
+
+	event_init(&key_queue_event, false, EVENT_FLAG_AUTOUNSIGNAL);
+	thread = thread_create("lk2nd-keys", lk2nd_keys_scan, NULL,
+			       HIGH_PRIORITY, SMALL_STACK_SIZE);
+	if (thread)
+		thread_resume(thread);
+	else
+		dprintf(CRITICAL, "keys: Failed to start key scan thread\n");
+}
+
+int lk2nd_keys_wait_event(struct lk2nd_key_event *ev, time_t timeout)
+{
+	status_t ret;
+
+	lk2nd_keys_scan_start();
+
+	while (!lk2nd_keys_queue_pop(ev)) {
+		ret = event_wait_timeout(&key_queue_event, timeout);
+		if (ret < 0)
+			return ret;
+	}
+
+	return NO_ERROR;
+}
 
 static int lk2nd_keys_init(const void *dtb, int node)
 {
@@ -6,6 +6,7 @@
 #include <debug.h>
 #include <dev/fbcon.h>
 #include <display_menu.h>
+#include <err.h>
 #include <kernel/thread.h>
 #include <platform.h>
 #include <platform/timer.h>
@@ -14,6 +15,7 @@
 #include <sys/types.h>
 #include <stdbool.h>
 
+#include <lk2nd/boot.h>
 #include <lk2nd/device/keys.h>
 #include <lk2nd/device/menu.h>
 #include <lk2nd/util/minmax.h>
@@ -75,54 +77,36 @@ static __PRINTFLIKE(4, 5) void fbcon_printf(unsigned type, int y, bool center, c
 	fbcon_puts(buf, type, y, center);
 }
 
-static const uint16_t published_keys[] = {
-	KEY_VOLUMEUP,
-	KEY_VOLUMEDOWN,
-	KEY_POWER,
-	KEY_HOME,
-};
-
-/**
- * lk2nd_boot_pressed_key() - Get the pressed key, if any.
- */
-static uint16_t lk2nd_boot_pressed_key(void)
-{
-	unsigned int i;
-
-	for (i = 0; i < ARRAY_SIZE(published_keys); ++i)
-		if (lk2nd_keys_pressed(published_keys[i]))
-			return published_keys[i];
-
-	return 0;
-}
-
 #define LONG_PRESS_DURATION 1000
 
 static uint16_t wait_key(void)
 {
-	uint16_t keycode = 0;
-	int press_start = 0;
-	int press_duration;
+	struct lk2nd_key_event ev;
+	time_t press_start, timeout;
+	uint16_t keycode;
 
-	while (!(keycode = lk2nd_boot_pressed_key()))
-		thread_sleep(1);
+	do {
+		lk2nd_keys_wait_event(&ev, INFINITE_TIME);
+	} while (!ev.pressed);
 
+	keycode = ev.code;
 	press_start = current_time();
 
-	while (lk2nd_keys_pressed(keycode)) {
-		thread_sleep(1);
-
-		press_duration = current_time() - press_start;
-		if (lk2nd_dev.single_key && press_duration > LONG_PRESS_DURATION)
+	/* Wait until the key is released again */
+	do {
+		timeout = INFINITE_TIME;
+		if (lk2nd_dev.single_key) {
+			timeout = current_time() - press_start;
+			timeout = timeout < LONG_PRESS_DURATION ?
+				  LONG_PRESS_DURATION - timeout : 0;
+		}
+		if (lk2nd_keys_wait_event(&ev, timeout) == ERR_TIMED_OUT)
 			return KEY_POWER;
-	}
+	} while (ev.code != keycode || ev.pressed);
 
 	if (lk2nd_dev.single_key)
 		keycode = KEY_VOLUMEDOWN;
 
-	/* A small debounce delay */
-	thread_sleep(5);
-
 	return keycode;
 }
 
@@ -192,6 +176,34 @@ static struct {
 
 #define NUM_OPTIONS  ARRAY_SIZE(menu_options)
 
+/*
+ * What is currently shown for each option, so that a selection change
+ * only redraws the two lines whose highlight changed.
+ */
+static struct {
+	int y;
+	bool selected;
+	bool drawn;
+} menu_lines[NUM_OPTIONS];
+
+static void menu_clear_line(int y)
+{
+	fbcon_clear_msg(y / FONT_HEIGHT, y / FONT_HEIGHT + scale_factor);
+}
+
+static void menu_draw_option(unsigned int i, bool selected)
+{
+	int y = menu_lines[i].y;
+
+	menu_clear_line(y);
+	fbcon_printf(selected ? menu_options[i].color : SILVER, y, true,
+		     "%c %s %c", selected ? '>' : ' ', menu_options[i].name,
+		     selected ? '<' : ' ');
+
+	menu_lines[i].selected = selected;
+	menu_lines[i].drawn = true;
+}
+
 #define fbcon_printf_ln(color, y, incr, x...) \
 	do { \
 		fbcon_printf(color, y, x); \
@@ -207,7 +219,7 @@ static struct {
 void display_fastboot_menu(void)
 {
 	struct fbcon_config *fb = fbcon_display();
-	int y, y_menu, old_scale, incr;
+	int y, old_scale, incr;
 	unsigned int sel = 0, i;
 	bool armv8 = is_scm_armv8_support();
 
@@ -247,7 +259,10 @@ void display_fastboot_menu(void)
 	y += incr;
 
 	/* Skip lines for the menu */
-	y_menu = y;
+	for (i = 0; i < ARRAY_SIZE(menu_options); ++i) {
+		menu_lines[i].y = y + incr * i;
+		menu_lines[i].drawn = false;
+	}
 	y += incr * (ARRAY_SIZE(menu_options) + 1);
 
 	if (lk2nd_dev.single_key) {
@@ -288,30 +303,20 @@ void display_fastboot_menu(void)
 	 */
 
 	scale_factor = old_scale;
-	incr = FONT_HEIGHT * scale_factor;
 	while (true) {
-		y = y_menu;
-		fbcon_clear_msg(y / FONT_HEIGHT, (y / FONT_HEIGHT + ARRAY_SIZE(menu_options) * scale_factor));
-		for (i = 0; i < ARRAY_SIZE(menu_options); ++i) {
-			fbcon_printf_ln(
-				i == sel ? menu_options[i].color : SILVER,
-				y, incr, true, "%c %s %c",
-				i == sel ? '>' : ' ',
-				menu_options[i].name,
-				i == sel ? '<' : ' '
-			);
-		}
+		for (i = 0; i < ARRAY_SIZE(menu_options); ++i)
+			if (!menu_lines[i].drawn || menu_lines[i].selected != (i == sel))
+				menu_draw_option(i, i == sel);
 
 		fbcon_flush();
 
 		switch (wait_key()) {
 		case KEY_POWER:
-			y = y_menu + incr * sel;
-			fbcon_printf_ln(
-				menu_options[sel].color,
-				y, incr, true, ">> %s <<",
-				menu_options[sel].name
-			);
+			y = menu_lines[sel].y;
+			menu_clear_line(y);
+			fbcon_printf(menu_options[sel].color, y, true, ">> %s <<",
+				     menu_options[sel].name);
+			menu_lines[sel].drawn = false;
 			menu_options[sel].action();
 			break;
 		case KEY_VOLUMEUP:
@@ -349,6 +354,27 @@ void display_default_image_on_screen(void)
 	fbcon_flush();
 }
 
+/**
+ * boot_menu_quick_check() - Check for a pending keypress without waiting
+ *
+ * Used instead of the countdown for quick boot. Only input that is already
+ * buffered by the serial console is considered, the USB console is not
+ * started so nothing delays the boot when no key was pressed.
+ *
+ * Return: 1 if a key was pressed (enter menu), 0 otherwise (normal boot)
+ */
+int boot_menu_quick_check(void)
+{
+	char c;
+
+	if (dgetc(&c, false))
+		return 0;
+
+	dprintf(ALWAYS, "Key pressed -- entering lk2nd shell\n");
+	lk2nd_shell();
+	return 1;
+}
+
 /**
  * boot_menu_countdown_check() - Display boot countdown and wait for keypress
  *
@@ -378,6 +404,9 @@ int boot_menu_countdown_check(void)
 	/* Drain any buffered input first */
 	while (dgetc(&c, false) == 0) { /* drain */ }
 
+	/* Read the default boot entry while nobody presses a key */
+	lk2nd_boot_preload_start();
+
 	while (countdown > 0 && !triggered) {
 		dprintf(ALWAYS, "\rBooting in %2d ...  ", countdown);
 
@@ -396,6 +425,8 @@ int boot_menu_countdown_check(void)
 	}
 
 	if (triggered) {
+		lk2nd_boot_preload_discard();
+
 		/*
 		 * Run the shell right here, before fastboot mode claims
 		 * the USB controller, so a session over the USB serial
@@ -410,6 +441,7 @@ int boot_menu_countdown_check(void)
 	}
 
 	dprintf(ALWAYS, "\rNo key pressed -- continuing normal boot   \n\n");
+	lk2nd_boot_preload_wait();
 #ifdef LK2ND_USB_CONSOLE
 	lk2nd_usbcon_stop();
 #endif
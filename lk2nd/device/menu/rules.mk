@@ -10,5 +10,6 @@ OBJS += \
 	$(LOCAL_DIR)/shell.o
 
 ifeq ($(LK2ND_USB_CONSOLE),1)
+MODULES += lib/cbuf
 OBJS += $(LOCAL_DIR)/usbcon.o
 endif
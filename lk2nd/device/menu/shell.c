@@ -329,9 +329,7 @@ static int cmd_ls(int argc, char **argv)
 	lk2nd_bdev_init();
 
 	snprintf(mountpoint, sizeof(mountpoint), "/%s", argv[1]);
-	ret = fs_mount(mountpoint, "ext2", argv[1]);
-	if (ret < 0)
-		ret = fs_mount(mountpoint, "fat", argv[1]);
+	ret = fs_mount_auto(mountpoint, argv[1]);
 	if (ret < 0) {
 		printf("failed to mount '%s' (ext2/fat): %d\n", argv[1], ret);
 		return -1;
@@ -440,7 +438,7 @@ static const struct shell_cmd shell_cmds[] = {
 	{ "ls",       "<device> - list files on a device",          cmd_ls },
 	{ "md",       "<hex-addr> [count] - display memory",        cmd_md },
 #ifdef LK2ND_UMS
-	{ "ums",      "[device] - USB mass storage mode",           cmd_ums },
+	{ "ums",      "[device,...] - USB mass storage mode",       cmd_ums },
 #endif
 	{ "fastboot", "leave the shell, start fastboot mode",       cmd_fastboot },
 	{ "reset",    "reboot the device",                          cmd_reset },
@@ -14,9 +14,10 @@
  * and open /dev/ttyUSB0 with minicom/picocom. Interrupting the boot
  * countdown from there drops into the shell, no UART wires needed.
  *
- * All I/O is non-blocking: output is buffered in a ring and flushed
- * whenever the host is reading; if no terminal is attached, output is
- * simply dropped and boot is never delayed.
+ * All I/O is non-blocking: output is buffered in a ring and sent to the
+ * host straight from there, as soon as the previous transfer completes;
+ * if no terminal is attached, output is simply dropped and boot is never
+ * delayed.
  */
 
 #include <debug.h>
@@ -32,6 +33,7 @@
 #endif
 #include <arch/ops.h>
 #include <arch/defines.h>
+#include <lib/cbuf.h>
 #include <stdbool.h>
 
 #include <lk2nd/device/menu.h>
@@ -51,8 +53,8 @@ typedef struct {
 
 static usbcon_usb_if_t usb_if;
 
-#define USBCON_TX_RING  1024
-#define USBCON_TX_CHUNK 512
+#define USBCON_TX_RING  4096
+#define USBCON_TX_CHUNK 512 /* start sending at a newline or this much data */
 #define USBCON_RX_CHUNK 64
 
 static struct udc_endpoint *usbcon_endpoints[2];
@@ -62,11 +64,14 @@ static struct udc_request *usbcon_req_out;
 static bool usbcon_up;
 static volatile bool usbcon_online;
 
-/* TX: ring filled by putc, drained into a DMA buffer one chunk at a time */
-static char tx_ring[USBCON_TX_RING];
-static unsigned int tx_head, tx_tail; /* head = write pos, tail = read pos */
-static uint8_t tx_dma[USBCON_TX_CHUNK] __attribute__((aligned(CACHE_LINE)));
-static volatile bool tx_pending;
+/*
+ * TX: ring filled by putc (producer), each transfer sends the largest
+ * contiguous span of it without copying (consumer). The consumer runs in
+ * the completion interrupt or with interrupts disabled.
+ */
+static char tx_ring[USBCON_TX_RING] __attribute__((aligned(CACHE_LINE)));
+static cbuf_t tx_cbuf;
+static volatile unsigned int tx_len; /* length of the span in flight */
 
 /* RX: one chunk in flight, drained by getc */
 static uint8_t rx_dma[USBCON_RX_CHUNK] __attribute__((aligned(CACHE_LINE)));
@@ -102,9 +107,15 @@ static struct udc_gadget usbcon_gadget = {
 	.ept           = usbcon_endpoints,
 };
 
+static void usbcon_tx_start(void);
+
 static void usbcon_tx_complete(struct udc_request *req, unsigned actual, int status)
 {
-	tx_pending = false;
+	cbuf_spsc_consume(&tx_cbuf, tx_len);
+	tx_len = 0;
+
+	/* Send what was written meanwhile, or the part after the wrap */
+	usbcon_tx_start();
 }
 
 static void usbcon_rx_complete(struct udc_request *req, unsigned actual, int status)
@@ -113,31 +124,36 @@ static void usbcon_rx_complete(struct udc_request *req, unsigned actual, int sta
 	rx_ready = true;
 }
 
-/* Push out the next TX chunk if the ring has data and the ep is free */
-static void usbcon_tx_flush(void)
+/* Send the data at the start of the ring if the ep is free */
+static void usbcon_tx_start(void)
 {
-	unsigned int len = 0;
+	unsigned int len;
+	char *data;
 
-	if (!usbcon_up || !usbcon_online || tx_pending)
+	if (!usbcon_up || !usbcon_online || tx_len)
 		return;
 
-	while (tx_tail != tx_head && len < USBCON_TX_CHUNK) {
-		tx_dma[len++] = tx_ring[tx_tail];
-		tx_tail = (tx_tail + 1) % USBCON_TX_RING;
-	}
+	len = cbuf_spsc_peek(&tx_cbuf, &data);
 	if (!len)
 		return;
 
-	arch_clean_invalidate_cache_range((addr_t)tx_dma,
-					  ROUNDUP(len, CACHE_LINE));
+	/* Only clean, putc may write to the rest of the cache lines meanwhile */
+	arch_clean_cache_range((addr_t)data, len);
 
-	usbcon_req_in->buf = (void *)PA((addr_t)tx_dma);
+	usbcon_req_in->buf = (void *)PA((addr_t)data);
 	usbcon_req_in->length = len;
 	usbcon_req_in->complete = usbcon_tx_complete;
 
-	tx_pending = true;
+	tx_len = len;
 	if (usb_if.udc_request_queue(usbcon_endpoints[0], usbcon_req_in) < 0)
-		tx_pending = false;
+		tx_len = 0;
+}
+
+static void usbcon_tx_flush(void)
+{
+	enter_critical_section();
+	usbcon_tx_start();
+	exit_critical_section();
 }
 
 /**
@@ -148,7 +164,7 @@ static void usbcon_tx_flush(void)
  */
 void lk2nd_usbcon_putc(char c)
 {
-	unsigned int next;
+	char *data;
 
 	if (!usbcon_up)
 		return;
@@ -156,14 +172,15 @@ void lk2nd_usbcon_putc(char c)
 	if (c == '\n')
 		lk2nd_usbcon_putc('\r');
 
-	next = (tx_head + 1) % USBCON_TX_RING;
-	if (next != tx_tail) { /* drop when full */
-		tx_ring[tx_head] = c;
-		tx_head = next;
-	}
-
-	if (c == '\n' || ((tx_head - tx_tail) % USBCON_TX_RING) >= USBCON_TX_CHUNK)
-		usbcon_tx_flush();
+	/*
+	 * Several threads may print, so they are kept from entering the ring
+	 * at the same time. It never waits for the consumer or the host.
+	 */
+	enter_critical_section();
+	cbuf_spsc_put(&tx_cbuf, c); /* drop when full */
+	if (c == '\n' || cbuf_spsc_peek(&tx_cbuf, &data) >= USBCON_TX_CHUNK)
+		usbcon_tx_start();
+	exit_critical_section();
 }
 
 /**
@@ -275,8 +292,8 @@ int lk2nd_usbcon_start(void)
 
 	dprintf(INFO, "usbcon: started (%s)\n", target_usb_controller());
 
-	tx_head = tx_tail = 0;
-	tx_pending = false;
+	cbuf_initialize_etc(&tx_cbuf, sizeof(tx_ring), tx_ring);
+	tx_len = 0;
 	rx_queued = rx_ready = false;
 	rx_pos = 0;
 	usbcon_up = true;
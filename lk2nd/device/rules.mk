@@ -7,12 +7,10 @@ MODULES += \
 
 LK2ND_DEVICE_OBJ := $(LOCAL_DIR)/device.o
 
-# NOTE: The init functions are performed in the order of linking
-# thus the order might be important here. Notably:
-#
-# - keys.o must be after device.o as device.o will (if needed) probe
-#   the keys driver and the keys.o will then rely on the created data
-#   to report the keys.
+# NOTE: The init functions are performed in the order of linking unless
+# they declare dependencies with LK2ND_INIT_AFTER()/LK2ND_INIT_BEFORE().
+# Notably, keys.o relies on device.o probing the keys driver (if needed)
+# to report the keys, which is declared explicitly in keys.c.
 
 OBJS += \
 	$(LK2ND_DEVICE_OBJ) \
@@ -7,6 +7,7 @@
 #include <dev/fbcon.h>
 #include <reg.h>
 #include <arch/ops.h>
+#include <lk2nd/smp.h>
 
 #include "cont-splash.h"
 #include "mdp.h"
@@ -193,7 +194,7 @@ void mdp_relocate(struct fbcon_config *fb, void *target)
 
 	fb_size = fb->stride * (fb->bpp / 8) * fb->height;
 
-	memcpy(target, fb->base, fb_size);
+	lk2nd_smp_memcpy(target, fb->base, fb_size);
 	arch_clean_cache_range((addr_t)target, fb_size);
 
 #if MDP4
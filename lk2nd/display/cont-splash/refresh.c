@@ -4,13 +4,24 @@
 #include <bits.h>
 #include <debug.h>
 #include <dev/fbcon.h>
+#include <err.h>
 #include <kernel/event.h>
 #include <kernel/thread.h>
+#include <platform/interrupts.h>
+#include <platform/irqs.h>
 #include <reg.h>
 
 #include "cont-splash.h"
 #include "mdp.h"
 
+/* Wait up to 10 ms for drawing to pause for 2 ms before refreshing */
+#define REFRESH_SETTLE_MS	2
+#define REFRESH_SETTLE_MAX_MS	10
+
+/* Fallback if the end of a refresh cannot be detected, limits to 50 Hz */
+#define REFRESH_DONE_MS		20
+#define REFRESH_DONE_MAX_MS	100
+
 static event_t refresh_event;
 
 static void mdp_refresh(void)
@@ -25,13 +36,93 @@ static void mdp_refresh(void)
 #endif
 }
 
+#if MDP5 && defined(MDSS_MDP_IRQ)
+#define MDP_INTR_STATUS		(MDP_INTR_EN + 0x4)
+#define MDP_INTR_PP_0_DONE	BIT(8)
+
+static event_t refresh_done_event;
+static bool refresh_done_irq;
+
+static enum handler_return mdp_refresh_done_irq(void *arg)
+{
+	uint32_t status = readl(MDP_INTR_STATUS) & readl(MDP_INTR_EN);
+
+	writel(status, MDP_INTR_CLEAR);
+	if (!(status & MDP_INTR_PP_0_DONE)) {
+		/* Some other MDSS interrupt is enabled, go back to sleeping */
+		dprintf(INFO, "Unexpected MDSS interrupt (status: %#x)\n", status);
+		mask_interrupt(MDSS_MDP_IRQ);
+		refresh_done_irq = false;
+	}
+
+	event_signal(&refresh_done_event, false);
+	return INT_RESCHEDULE;
+}
+
+static void mdp_setup_refresh_done(void)
+{
+	event_init(&refresh_done_event, false, EVENT_FLAG_AUTOUNSIGNAL);
+
+	writel(MDP_INTR_PP_0_DONE, MDP_INTR_CLEAR);
+	writel(readl(MDP_INTR_EN) | MDP_INTR_PP_0_DONE, MDP_INTR_EN);
+	register_int_handler(MDSS_MDP_IRQ, mdp_refresh_done_irq, NULL);
+	refresh_done_irq = true;
+	unmask_interrupt(MDSS_MDP_IRQ);
+}
+
+static void mdp_disable_refresh_done(void)
+{
+	mask_interrupt(MDSS_MDP_IRQ);
+	writel(readl(MDP_INTR_EN) & ~MDP_INTR_PP_0_DONE, MDP_INTR_EN);
+	writel(MDP_INTR_PP_0_DONE, MDP_INTR_CLEAR);
+	refresh_done_irq = false;
+}
+
+static void mdp_refresh_and_wait(void)
+{
+	/* Drop a late signal from a refresh that timed out before */
+	event_unsignal(&refresh_done_event);
+	mdp_refresh();
+
+	if (refresh_done_irq &&
+	    event_wait_timeout(&refresh_done_event, REFRESH_DONE_MAX_MS) == NO_ERROR)
+		return;
+
+	thread_sleep(REFRESH_DONE_MS);
+}
+#else
+static inline void mdp_setup_refresh_done(void) { }
+static inline void mdp_disable_refresh_done(void) { }
+
+static void mdp_refresh_and_wait(void)
+{
+	mdp_refresh();
+	thread_sleep(REFRESH_DONE_MS);
+}
+#endif
+
 static int mdp_cmd_refresh_loop(void *data)
 {
+	int i;
+
 	while (true) {
-		/* Limit refresh to 50 Hz to avoid overlapping display updates */
 		event_wait(&refresh_event);
-		mdp_refresh();
-		thread_sleep(20);
+
+		/*
+		 * There is only a single buffer, so a refresh in the middle of
+		 * drawing shows half of the new content. Let a burst of updates
+		 * (e.g. a redrawn menu) finish first, so it shows up at once.
+		 */
+		for (i = 0; i < REFRESH_SETTLE_MAX_MS / REFRESH_SETTLE_MS; i++)
+			if (event_wait_timeout(&refresh_event, REFRESH_SETTLE_MS) < 0)
+				break;
+
+		/*
+		 * Do not start the next refresh before the panel has received
+		 * the previous one. Updates signalled in the meantime are
+		 * combined into the next refresh.
+		 */
+		mdp_refresh_and_wait();
 	}
 	return 0;
 }
@@ -48,12 +139,13 @@ static void mdp_cmd_refresh_start_thread(struct fbcon_config *fb)
 	event_init(&refresh_event, false, EVENT_FLAG_AUTOUNSIGNAL);
 
 	thr = thread_create("display-refresh", &mdp_cmd_refresh_loop,
-			    fb, HIGH_PRIORITY, DEFAULT_STACK_SIZE);
+			    fb, HIGH_PRIORITY, SMALL_STACK_SIZE);
 	if (!thr) {
 		dprintf(CRITICAL, "Failed to create display-refresh thread\n");
 		return;
 	}
 
+	mdp_setup_refresh_done();
 	thread_resume(thr);
 	fb->update_start = mdp_cmd_signal_refresh;
 }
@@ -62,8 +154,8 @@ static void mdp_setup_cmd_refresh(struct fbcon_config *fb)
 {
 	/*
 	 * Qualcomm's display menu calls update_start() for every line that is
-	 * printed which is very slow. Throttle this using a thread that limits
-	 * refreshes to ~50 Hz.
+	 * printed which is very slow. Throttle this using a thread that starts
+	 * the next refresh once the previous one is done.
 	 */
 	if (IS_ENABLED(FBCON_DISPLAY_MSG))
 		mdp_cmd_refresh_start_thread(fb);
@@ -159,6 +251,7 @@ void mdp_enable_autorefresh(struct fbcon_config *fb)
 
 	fb->update_start = NULL;
 	thread_sleep(42);
+	mdp_disable_refresh_done();
 
 #ifdef MDSS_MDP_REG_PP_AUTOREFRESH_CONFIG /* MDP5 */
 	mdp5_enable_auto_refresh(fb);
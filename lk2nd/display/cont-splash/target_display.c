@@ -20,7 +20,7 @@ static bool mdp_prepare_fb(struct fbcon_config *fb)
 	if (fb->stride == 0 || fb->width == 0 || fb->height == 0)
 		return false;
 
-	return lk2nd_mmu_map_ram_dynamic("continuous splash", base, size);
+	return lk2nd_mmu_map_ram_wc("continuous splash", base, size);
 }
 
 __WEAK bool mdp_read_dma_config(struct fbcon_config *fb) { return false; }
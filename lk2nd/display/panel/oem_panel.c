@@ -52,11 +52,30 @@ const char *lk2nd_oem_panel_name(void)
 	return panel.paneldata->panel_node_id;
 }
 
+#if LK2ND_DISPLAY_PACK_CMDS
+/*
+ * Clear the "last" bit of commands without delay, so mdss_dsi_cmds_tx()
+ * sends them in the same DMA transfer as the following commands.
+ */
+static void oem_panel_pack_cmds(struct mipi_dsi_cmd *cmds, int count)
+{
+	int i;
+
+	for (i = 0; i < count - 1; i++)
+		if (!cmds[i].wait && cmds[i].size >= 4)
+			cmds[i].payload[3] &= ~DSI_HDR_LAST;
+}
+#endif
+
 int oem_panel_select(const char *panel_name, struct panel_struct *panel,
 		     struct msm_panel_info *pinfo, struct mdss_dsi_phy_ctrl *phy_db)
 {
 	panel_select(LK2ND_DISPLAY)(panel, pinfo, phy_db);
 
+#if LK2ND_DISPLAY_PACK_CMDS
+	oem_panel_pack_cmds(pinfo->mipi.panel_on_cmds, pinfo->mipi.num_of_panel_on_cmds);
+#endif
+
 #if TARGET_MSM8916
 	if (phy_db->regulator_mode == DSI_PHY_REGULATOR_LDO_MODE)
 		memcpy(panel_regulator_settings, ldo_regulator_settings, REGULATOR_SIZE);
@@ -5,3 +5,6 @@ LOCAL_DIR := $(GET_LOCAL_DIR)
 OBJS := $(filter-out target/$(TARGET)/oem_panel.o, $(OBJS))
 
 OBJS += $(LOCAL_DIR)/oem_panel.o
+
+LK2ND_DISPLAY_PACK_CMDS ?= 0
+DEFINES += LK2ND_DISPLAY_PACK_CMDS=$(LK2ND_DISPLAY_PACK_CMDS)
@@ -11,6 +11,7 @@
 
 #include <lk2nd/util/cmdline.h>
 #include <lk2nd/util/lkfdt.h>
+#include <lk2nd/util/region.h>
 
 #include "cont-splash/cont-splash.h"
 
@@ -25,21 +26,26 @@
 static int lk2nd_simplefb_dt_update(void *dtb, const char *cmdline,
 				    enum boot_type boot_type)
 {
-	struct fbcon_config *fb = fbcon_display();
+	struct fbcon_config *fb;
 	int ret, resmem_offset, chosen_offset, offset;
 	uint32_t mem_ph, fb_size;
 	char tmp[32], args[64];
 	void *rel_base;
 
-	if (!fb)
-		return 0;
-
 	if (boot_type & (BOOT_DOWNSTREAM | BOOT_LK2ND))
 		return 0;
 
 	if (!lk2nd_cmdline_scan_arg(cmdline, "lk2nd.pass-simplefb", args, sizeof(args)))
 		return 0;
 
+#if DISPLAY_SPLASH_SCREEN && LK2ND_QUICK_BOOT
+	/* Quick boot skipped the display, the OS wants it now */
+	aboot_display_init();
+#endif
+	fb = fbcon_display();
+	if (!fb)
+		return 0;
+
 	if (IS_ENABLED(LK2ND_DISPLAY_CONT_SPLASH)) {
 		if (strstr(args, "autorefresh")) {
 			dprintf(INFO, "simplefb: Enabling autorefresh\n");
@@ -47,12 +53,13 @@ static int lk2nd_simplefb_dt_update(void *dtb, const char *cmdline,
 		}
 
 		if (strstr(args, "relocate")) {
-			rel_base = target_get_scratch_address()
-				+ target_get_max_flash_size()
-				- (10 * 1024 * 1024); /* 8MiB~=fhd 32bpp, +512k ramoops at the end. */
-
-			dprintf(INFO, "simplefb: Framebuffer will be relocated to 0x%x\n", (uint32_t)rel_base);
-			mdp_relocate(fb, rel_base);
+			/* Large enough to convert to xrgb8888 later */
+			rel_base = lk2nd_region_alloc("simplefb",
+						      fb->stride * 4 * fb->height);
+			if (rel_base) {
+				dprintf(INFO, "simplefb: Framebuffer will be relocated to 0x%x\n", (uint32_t)rel_base);
+				mdp_relocate(fb, rel_base);
+			}
 		}
 
 		if (strstr(args, "rgb565"))
@@ -73,7 +80,7 @@ static int lk2nd_simplefb_dt_update(void *dtb, const char *cmdline,
 	if (offset < 0)
 		return 0;
 
-	ret = fdt_appendprop_addrrange(dtb, resmem_offset, offset, "reg", (uint32_t)fb->base, fb_size);
+	ret = lkfdt_set_reg(dtb, resmem_offset, offset, (uint32_t)fb->base, fb_size);
 	if (ret < 0)
 		return 0;
 
@@ -120,11 +127,7 @@ static int lk2nd_simplefb_dt_update(void *dtb, const char *cmdline,
 			return 0;
 	}
 
-	ret = fdt_setprop_empty(dtb, offset, "reg");
-	if (ret < 0)
-		return 0;
-
-	ret = fdt_appendprop_addrrange(dtb, chosen_offset, offset, "reg", (uint32_t)fb->base, fb_size);
+	ret = lkfdt_set_reg(dtb, chosen_offset, offset, (uint32_t)fb->base, fb_size);
 	if (ret < 0)
 		return 0;
 
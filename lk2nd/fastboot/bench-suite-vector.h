@@ -0,0 +1,320 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#ifndef LK2ND_FASTBOOT_BENCH_SUITE_VECTOR_H
+#define LK2ND_FASTBOOT_BENCH_SUITE_VECTOR_H
+
+/*
+ * 16 KiB of text made of words picked by an LCG, compressed with
+ * gzip.compress(data, 9, mtime=0) in Python:
+ *
+ *	words = (b"the lk2nd bootloader reads boot images from emmc sd cards "
+ *		 b"and nand flash then it decompresses the kernel applies "
+ *		 b"device tree overlays and jumps into linux").split()
+ *	x, out, col = 12345, bytearray(), 0
+ *	while len(out) < 16384:
+ *		x = (x * 1103515245 + 12345) & 0x7fffffff
+ *		w = words[(x >> 16) % len(words)]
+ *		out += w
+ *		col += len(w) + 1
+ *		if col > 64:
+ *			out += b"\n"
+ *			col = 0
+ *		else:
+ *			out += b" "
+ *	data = bytes(out[:16384])
+ */
+#define BENCH_GZIP_VECTOR_SIZE	16384
+#define BENCH_GZIP_VECTOR_CRC32	0xbafd978b
+
+static const unsigned char bench_gzip_vector[] = {
+	0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x7d, 0x5b,
+	0x5b, 0x92, 0xe3, 0x36, 0x12, 0xfc, 0xc7, 0x29, 0x74, 0x86, 0xbd, 0x91,
+	0x76, 0x24, 0x7b, 0xb4, 0xee, 0x46, 0x4f, 0x34, 0x69, 0xc7, 0xfa, 0xf6,
+	0x16, 0x50, 0x8f, 0xcc, 0x2c, 0x80, 0x8e, 0xf0, 0xc8, 0x2d, 0x8a, 0xc4,
+	0xa3, 0x50, 0x8f, 0xac, 0xac, 0xe2, 0xfd, 0xd7, 0xaf, 0x8f, 0xd7, 0xf3,
+	0xb8, 0xfd, 0xf7, 0xeb, 0xeb, 0xbc, 0xfd, 0xf1, 0xfc, 0xee, 0xcf, 0x8f,
+	0xdb, 0xeb, 0xbc, 0x7d, 0xfc, 0xf1, 0x9f, 0xfe, 0xb8, 0x7d, 0x3f, 0xef,
+	0x8f, 0xe3, 0xf6, 0xfc, 0xfc, 0xfc, 0x71, 0xfb, 0xed, 0xfb, 0xeb, 0xf3,
+	0xf6, 0xdb, 0xc7, 0xfd, 0xf8, 0x79, 0x7b, 0x3c, 0x7f, 0x7c, 0x7d, 0xfe,
+	0xfa, 0x7e, 0x1e, 0xc7, 0xfb, 0xb9, 0x79, 0xa9, 0xf9, 0x83, 0xc7, 0xc3,
+	0x1f, 0x7c, 0x7d, 0xde, 0x7f, 0x7f, 0xff, 0xf8, 0xea, 0xe7, 0xd7, 0xed,
+	0xe3, 0xd5, 0xff, 0xfc, 0xff, 0x1c, 0xff, 0xe3, 0xeb, 0xfe, 0x78, 0x7e,
+	0xdb, 0x78, 0x79, 0xeb, 0x9c, 0xa3, 0x3d, 0x9e, 0x7f, 0xbd, 0x7e, 0x3c,
+	0x7d, 0x02, 0x1f, 0xed, 0xfe, 0xfe, 0xf5, 0xfc, 0x7e, 0x3e, 0x73, 0xda,
+	0x79, 0xcb, 0xbc, 0x32, 0x87, 0x98, 0xa3, 0xcf, 0x0f, 0x7b, 0xa0, 0xbd,
+	0xc7, 0x7c, 0xff, 0xf7, 0xbf, 0x3f, 0x3f, 0x7f, 0x1d, 0xbe, 0x74, 0x9a,
+	0xd5, 0x66, 0x7b, 0xff, 0xfe, 0xe3, 0xfe, 0xfd, 0xfe, 0x25, 0x46, 0xfb,
+	0xf9, 0xf4, 0x0b, 0xe3, 0xd6, 0x66, 0x6b, 0x1d, 0x17, 0xed, 0xf6, 0x39,
+	0xcf, 0x14, 0x8d, 0xfd, 0xd2, 0xc7, 0x9a, 0x62, 0x00, 0x92, 0x02, 0xe6,
+	0x69, 0x34, 0xe5, 0x5b, 0x8e, 0xe3, 0x7e, 0x5b, 0x90, 0xc9, 0x42, 0xa4,
+	0x63, 0xff, 0xc3, 0x4a, 0x6d, 0x0d, 0xf3, 0xc6, 0x8e, 0xcd, 0x0f, 0xc1,
+	0xaf, 0x22, 0xe7, 0xad, 0xbd, 0x37, 0xc5, 0x37, 0x34, 0xbd, 0x7b, 0x3c,
+	0x6f, 0x73, 0x8c, 0x31, 0xdf, 0x6b, 0x92, 0x9f, 0x43, 0xd6, 0xae, 0x06,
+	0x73, 0x6f, 0xed, 0xeb, 0xaf, 0xe7, 0xf7, 0xc7, 0xfd, 0x6f, 0x7f, 0xf8,
+	0x9e, 0x9a, 0x90, 0x8b, 0xba, 0x87, 0x6c, 0x86, 0xa8, 0xc6, 0x3f, 0x17,
+	0x27, 0xc9, 0x61, 0xde, 0xe7, 0xfb, 0x1d, 0x3b, 0x12, 0x05, 0x1b, 0x17,
+	0x6c, 0x1b, 0x31, 0xb1, 0x09, 0xc9, 0x3e, 0xfd, 0xda, 0x38, 0xcf, 0x39,
+	0xca, 0x7c, 0xd4, 0xa5, 0x35, 0x67, 0xb5, 0xd5, 0xf8, 0x60, 0x53, 0x54,
+	0xfe, 0xeb, 0xbc, 0x33, 0x86, 0x1c, 0xcf, 0xb6, 0xb1, 0x38, 0x3e, 0x92,
+	0x31, 0x33, 0x4e, 0x75, 0x3c, 0x3a, 0xff, 0xf9, 0x23, 0x8b, 0xae, 0x8a,
+	0x5c, 0xc7, 0x58, 0xbe, 0xea, 0x3c, 0xd6, 0x54, 0xa8, 0xb9, 0x52, 0x12,
+	0xc3, 0xee, 0x98, 0x5a, 0xcc, 0x33, 0x9e, 0xdf, 0x1d, 0xc3, 0x94, 0xb7,
+	0xd9, 0xdb, 0x7c, 0xba, 0xac, 0xfe, 0xfd, 0x58, 0xb3, 0x69, 0xf3, 0x84,
+	0x4c, 0xc2, 0x32, 0xd6, 0x7b, 0x49, 0xf4, 0x8c, 0xc9, 0x6a, 0x0c, 0x34,
+	0x8f, 0x7e, 0xac, 0x6f, 0x08, 0x96, 0x04, 0xe6, 0x37, 0xbe, 0x6f, 0xe9,
+	0x39, 0xdc, 0xdc, 0x46, 0x4a, 0x65, 0x5e, 0x24, 0xdd, 0xa7, 0x63, 0xb6,
+	0xe5, 0xc8, 0xfc, 0x53, 0x12, 0xa4, 0xee, 0x07, 0xe4, 0x3b, 0x86, 0xc8,
+	0xa5, 0x8b, 0x6c, 0xe7, 0xfd, 0xa6, 0x49, 0x3c, 0xd4, 0xb0, 0xc4, 0x79,
+	0x26, 0xfc, 0x69, 0xfa, 0x90, 0x2a, 0x21, 0xfb, 0x4d, 0x11, 0xcf, 0x9b,
+	0x6c, 0x75, 0x6a, 0x2a, 0xb6, 0x28, 0x1b, 0x49, 0x26, 0x7b, 0xa5, 0xea,
+	0xb4, 0x79, 0x0e, 0xb6, 0xd7, 0x8e, 0xb3, 0x86, 0x00, 0xc6, 0xba, 0xee,
+	0x57, 0x32, 0xb1, 0xb1, 0x75, 0x21, 0xa1, 0x68, 0xaf, 0x93, 0x34, 0x48,
+	0x66, 0x27, 0x87, 0x64, 0x47, 0x66, 0x8e, 0x71, 0x7c, 0x77, 0xe5, 0x50,
+	0xc7, 0x35, 0x84, 0x7c, 0xb8, 0x15, 0xda, 0x96, 0x4c, 0xee, 0xe2, 0xaa,
+	0xe6, 0xba, 0x5b, 0x5d, 0x9a, 0x6f, 0x67, 0xe3, 0xc7, 0xe6, 0x10, 0x53,
+	0x11, 0xb0, 0xb1, 0x90, 0x89, 0x4b, 0xdb, 0x9e, 0x9d, 0x02, 0x82, 0xf3,
+	0x4c, 0xb7, 0x6b, 0x9b, 0xcb, 0x5f, 0xe1, 0x36, 0xe6, 0x12, 0xd3, 0xcd,
+	0x23, 0x98, 0xd8, 0x1d, 0x7e, 0x7d, 0x6e, 0xa6, 0xe7, 0xed, 0xea, 0x95,
+	0xa6, 0xf6, 0xe3, 0xc8, 0xfd, 0x2f, 0xb6, 0xde, 0xf7, 0xde, 0x73, 0xed,
+	0xc3, 0x77, 0xf8, 0x21, 0xd1, 0xf6, 0x43, 0xf7, 0xda, 0x9c, 0xc9, 0x86,
+	0x1d, 0x8a, 0x04, 0xe5, 0x83, 0xfd, 0x8a, 0x2f, 0x11, 0x29, 0x85, 0x44,
+	0xc2, 0xf9, 0xd9, 0x4e, 0xcc, 0x1f, 0x86, 0xbf, 0xf2, 0x09, 0xe7, 0x66,
+	0xc2, 0xeb, 0xd9, 0x8a, 0xe7, 0x13, 0x53, 0x40, 0xc3, 0x3f, 0xf9, 0x8c,
+	0x26, 0x3d, 0xbf, 0x91, 0x9d, 0xc1, 0x6e, 0xe2, 0xb9, 0xd1, 0x31, 0x91,
+	0x79, 0x6b, 0x9a, 0x62, 0xae, 0xb9, 0xa7, 0x77, 0x5e, 0xd4, 0x7f, 0x31,
+	0x30, 0x0b, 0xdf, 0x31, 0xee, 0x9c, 0xd1, 0xa4, 0x08, 0x33, 0x3d, 0x1e,
+	0x71, 0x09, 0xf1, 0xe8, 0x78, 0x88, 0xa8, 0x6c, 0x67, 0x4d, 0xed, 0x2c,
+	0xc2, 0xbc, 0x9b, 0x67, 0x6c, 0xdf, 0x34, 0x30, 0x35, 0xa4, 0x7a, 0xaa,
+	0x38, 0x61, 0x89, 0x94, 0x47, 0xd8, 0xab, 0x4b, 0xbc, 0xe7, 0xe9, 0xb3,
+	0x8d, 0x99, 0x56, 0xbd, 0x3f, 0x9a, 0xa0, 0x06, 0xb6, 0x70, 0x8a, 0x21,
+	0x33, 0x96, 0xfd, 0x9c, 0x36, 0x44, 0x21, 0x92, 0xa1, 0x46, 0x5b, 0xd0,
+	0x43, 0x86, 0xbc, 0xce, 0x6a, 0x07, 0x0f, 0x6b, 0x7f, 0x99, 0xd4, 0xe7,
+	0xe9, 0xde, 0x05, 0x43, 0xcc, 0x8f, 0x98, 0xcf, 0x35, 0x9c, 0x1d, 0xa2,
+	0x2f, 0x2f, 0x5d, 0x4c, 0x77, 0xfb, 0x35, 0xa0, 0x03, 0xed, 0xc9, 0x00,
+	0xe7, 0xfa, 0x57, 0x9d, 0xf8, 0x18, 0x94, 0xe6, 0x30, 0x2d, 0xa1, 0x50,
+	0x3c, 0x6f, 0x12, 0x6f, 0x02, 0xaf, 0xe6, 0x8a, 0x94, 0x7b, 0xea, 0xf0,
+	0x7d, 0x84, 0x8e, 0x12, 0x08, 0xf8, 0x5e, 0x7f, 0x3e, 0xf3, 0xb8, 0xed,
+	0x78, 0x4e, 0x42, 0x30, 0xb0, 0xa1, 0x29, 0x55, 0x8a, 0x0c, 0x53, 0x20,
+	0xb9, 0xfd, 0x1e, 0x4e, 0x32, 0x54, 0x6c, 0xde, 0x59, 0x5d, 0xb4, 0x8f,
+	0x42, 0x03, 0xd8, 0x1a, 0xfa, 0x95, 0x47, 0xf5, 0x1d, 0xad, 0x81, 0xb2,
+	0x45, 0x0c, 0x98, 0xb7, 0xb9, 0x7c, 0x43, 0x31, 0xfb, 0x8a, 0x05, 0xe8,
+	0xcf, 0x79, 0xd7, 0x44, 0x6b, 0x74, 0x91, 0x60, 0x2b, 0x41, 0x02, 0x0c,
+	0x38, 0x25, 0x24, 0x2b, 0x34, 0x8d, 0x57, 0xb4, 0xe5, 0x8e, 0x8b, 0x51,
+	0xac, 0x99, 0xa5, 0xad, 0x6f, 0xe3, 0x22, 0xc6, 0xd1, 0x08, 0x44, 0x56,
+	0x00, 0xc0, 0xf1, 0x2e, 0x45, 0x9c, 0x1e, 0x6f, 0x8e, 0x30, 0x2e, 0x37,
+	0x3d, 0x0c, 0x76, 0xe7, 0x05, 0x0e, 0x8a, 0xda, 0xcf, 0x81, 0x6c, 0x1f,
+	0x36, 0x05, 0xf9, 0xe5, 0x2e, 0x33, 0x11, 0x8a, 0xf0, 0x3d, 0xe2, 0xaa,
+	0xb9, 0xa1, 0xb4, 0x2c, 0x11, 0x52, 0x0f, 0x4b, 0xe5, 0x25, 0x89, 0xf6,
+	0xa6, 0x14, 0x02, 0x58, 0x9f, 0x6c, 0x2d, 0x66, 0xed, 0xec, 0xe1, 0xb6,
+	0x08, 0xc4, 0x8e, 0x73, 0x71, 0x90, 0x53, 0x2a, 0xe9, 0x30, 0xe6, 0xb7,
+	0x30, 0x39, 0xb8, 0x63, 0xa4, 0x39, 0xe3, 0xce, 0x46, 0xa1, 0xbc, 0xe0,
+	0xf8, 0x94, 0x4a, 0x28, 0xdd, 0x49, 0xea, 0x02, 0x93, 0x6d, 0x24, 0x5b,
+	0x01, 0xa3, 0x70, 0xb9, 0x12, 0x37, 0x97, 0x7b, 0xda, 0x2a, 0x41, 0xc4,
+	0x56, 0x52, 0xaa, 0x94, 0x04, 0x80, 0x56, 0x42, 0xd0, 0x56, 0x91, 0x58,
+	0xb8, 0x02, 0x4d, 0x5f, 0xd2, 0x93, 0xdb, 0x49, 0xda, 0x2d, 0xb6, 0x8b,
+	0x5e, 0xe1, 0x75, 0x9c, 0xa4, 0x9d, 0xe1, 0xf1, 0xc8, 0x0b, 0xec, 0x38,
+	0x53, 0xaa, 0x16, 0x54, 0x4c, 0x36, 0x24, 0x90, 0x8b, 0xc4, 0x0b, 0xe2,
+	0x0e, 0x27, 0xe4, 0x90, 0x71, 0x2e, 0x25, 0xd4, 0xad, 0xe7, 0x09, 0xec,
+	0x1c, 0xe7, 0x9a, 0x38, 0x49, 0x74, 0x68, 0xbb, 0xd9, 0x44, 0xbd, 0xc8,
+	0xee, 0x09, 0x80, 0xa4, 0x1d, 0xb8, 0xd7, 0xda, 0xeb, 0x5f, 0x85, 0x0e,
+	0x5b, 0x55, 0xe4, 0xe4, 0x8a, 0xe1, 0x4e, 0x2c, 0x80, 0xa3, 0x36, 0x34,
+	0x72, 0x7c, 0xe3, 0x34, 0xa9, 0xf8, 0x1d, 0x09, 0xb9, 0x19, 0xe3, 0xfc,
+	0x78, 0x28, 0x97, 0x61, 0x90, 0x61, 0x41, 0xe5, 0x75, 0x2e, 0x6e, 0x40,
+	0x43, 0x0a, 0x42, 0x06, 0xc2, 0x20, 0xce, 0x60, 0xaa, 0x59, 0x7a, 0x7c,
+	0x79, 0xf0, 0x78, 0x70, 0x62, 0x1c, 0xc7, 0x27, 0xfa, 0x1a, 0xc3, 0x34,
+	0x89, 0x87, 0x2e, 0x19, 0xa8, 0x7b, 0xfc, 0x6a, 0xb8, 0x72, 0xae, 0xc7,
+	0xa6, 0x08, 0xc9, 0x04, 0x9c, 0xf3, 0xf9, 0xc9, 0x7a, 0x43, 0x16, 0x1d,
+	0x5a, 0xbe, 0xcf, 0x53, 0x7a, 0x6c, 0xc2, 0x76, 0x03, 0x3c, 0x08, 0x17,
+	0xe8, 0xc3, 0x42, 0x20, 0x66, 0xee, 0xf6, 0xd5, 0x17, 0x4d, 0x27, 0x9c,
+	0x89, 0x4a, 0x6e, 0x99, 0xb2, 0x82, 0xdc, 0x13, 0x65, 0xb2, 0x7c, 0xc5,
+	0x4d, 0x47, 0x76, 0x6e, 0x8b, 0x5a, 0xdd, 0xeb, 0x9a, 0x08, 0x26, 0xdf,
+	0xd3, 0xe8, 0x04, 0x20, 0x95, 0x4e, 0xc1, 0x9b, 0x54, 0x95, 0xf2, 0xfd,
+	0x6b, 0x32, 0x02, 0xbb, 0x3f, 0x1e, 0x35, 0x19, 0x9c, 0xe3, 0xaf, 0x27,
+	0x66, 0x10, 0x88, 0x41, 0xdf, 0x1a, 0x42, 0xe1, 0x58, 0x22, 0x2e, 0xc7,
+	0x1c, 0x90, 0xaf, 0x3b, 0x12, 0x02, 0x0b, 0xc7, 0x43, 0xf5, 0x9a, 0x52,
+	0x29, 0xc9, 0x2a, 0xaa, 0xd3, 0xb1, 0x48, 0xa9, 0x19, 0x0a, 0x0f, 0x81,
+	0x83, 0x9f, 0xab, 0x76, 0xf1, 0x5d, 0xe5, 0x0f, 0x49, 0x70, 0x20, 0xa7,
+	0x61, 0x2d, 0x2f, 0x40, 0xad, 0x90, 0x01, 0x69, 0xa0, 0x88, 0x7c, 0x10,
+	0x81, 0x06, 0xea, 0x0c, 0x44, 0xa1, 0x88, 0xd3, 0x2f, 0x86, 0xa5, 0x68,
+	0xaa, 0x5f, 0x40, 0x0f, 0x51, 0x3d, 0xc0, 0x7c, 0x4b, 0x76, 0xe2, 0x29,
+	0x3c, 0x4d, 0x71, 0x99, 0xed, 0x8b, 0x19, 0x66, 0xe8, 0x69, 0x14, 0x18,
+	0x5d, 0x9e, 0x69, 0x71, 0x39, 0x8c, 0x1d, 0x52, 0xa8, 0x51, 0xd7, 0x4d,
+	0x36, 0xe4, 0xe9, 0x2a, 0x70, 0xcb, 0xbc, 0x09, 0x76, 0x00, 0x08, 0x31,
+	0x09, 0x67, 0x4e, 0x0d, 0x01, 0x29, 0x67, 0xcd, 0x3f, 0x14, 0x24, 0xe1,
+	0xce, 0x74, 0x00, 0xe6, 0xe7, 0x4d, 0xaf, 0x24, 0x67, 0x21, 0x1a, 0x75,
+	0xc5, 0x8c, 0x8b, 0xb5, 0xe7, 0xc1, 0x54, 0xbe, 0x8e, 0xd3, 0xde, 0xbe,
+	0xa3, 0x71, 0xe4, 0x48, 0x8e, 0xcc, 0x0c, 0x6d, 0x45, 0x12, 0xc0, 0x99,
+	0x49, 0x08, 0x7f, 0x4a, 0xce, 0xcf, 0x49, 0x55, 0x20, 0x95, 0x02, 0xae,
+	0x79, 0x51, 0xe3, 0x88, 0x28, 0x6d, 0x59, 0x99, 0x05, 0x8f, 0x7c, 0x74,
+	0xac, 0xc8, 0x1c, 0x40, 0x23, 0xd0, 0x10, 0xec, 0x33, 0x35, 0x49, 0xe5,
+	0x0c, 0x08, 0xd6, 0xca, 0x8c, 0xb3, 0xd8, 0x33, 0x34, 0xad, 0x25, 0x04,
+	0x13, 0x2a, 0x03, 0x3a, 0x23, 0x96, 0xe0, 0xa2, 0x3a, 0x89, 0x06, 0x6a,
+	0xa2, 0xd0, 0xe6, 0xf0, 0x00, 0xab, 0x35, 0xcb, 0xdf, 0xf2, 0x4b, 0x8d,
+	0x26, 0x07, 0xd5, 0x97, 0xec, 0x46, 0xc1, 0x64, 0x73, 0x2f, 0x34, 0xf2,
+	0x5c, 0xc2, 0x14, 0x4e, 0x7c, 0x2c, 0xf6, 0x48, 0xda, 0x21, 0x58, 0xdd,
+	0x99, 0x8e, 0xa1, 0x9a, 0x2c, 0x46, 0x1c, 0x47, 0x4f, 0x1f, 0xb4, 0x02,
+	0x21, 0x82, 0xe8, 0x6e, 0xa8, 0xb9, 0x44, 0xe5, 0x4d, 0x85, 0x11, 0xf6,
+	0x7c, 0x93, 0xac, 0x25, 0x74, 0xd6, 0x3c, 0xba, 0x73, 0x56, 0x39, 0x35,
+	0x98, 0x59, 0xb1, 0xeb, 0x44, 0x03, 0x61, 0x0d, 0x71, 0x4b, 0x63, 0x1c,
+	0xbd, 0x58, 0x7b, 0x40, 0x91, 0x8a, 0xe7, 0x8a, 0x95, 0x05, 0x04, 0x80,
+	0x0e, 0xd8, 0x4e, 0xc4, 0x68, 0xf6, 0xd9, 0x48, 0x8e, 0x11, 0xdb, 0x92,
+	0xd0, 0x95, 0x08, 0x77, 0x85, 0xef, 0x9c, 0xc6, 0x84, 0x5f, 0x68, 0xe0,
+	0x07, 0x48, 0x6b, 0x41, 0x2c, 0xb8, 0xf0, 0x21, 0x32, 0x81, 0x5a, 0x43,
+	0x1a, 0xca, 0xce, 0xc5, 0xe0, 0xbd, 0xa0, 0x69, 0x36, 0x18, 0x66, 0x47,
+	0xfd, 0x5c, 0x17, 0xf4, 0xb9, 0x35, 0xfd, 0xee, 0x8f, 0x27, 0xb1, 0x09,
+	0x56, 0x66, 0x28, 0xd8, 0x42, 0x87, 0x82, 0x73, 0x60, 0x09, 0x91, 0xfe,
+	0xc5, 0x18, 0xe2, 0x30, 0x16, 0xfa, 0x9c, 0xd3, 0xef, 0xf5, 0x5c, 0x3c,
+	0xef, 0x00, 0x4b, 0x2c, 0x89, 0x43, 0xb8, 0xb7, 0xa5, 0x2a, 0x54, 0x32,
+	0x93, 0xce, 0x17, 0x22, 0xa1, 0xcd, 0xea, 0x85, 0x62, 0x2f, 0x80, 0x2a,
+	0x10, 0xc7, 0xcc, 0xf3, 0xa6, 0xb5, 0xc6, 0xb5, 0x0b, 0x66, 0xdb, 0x6d,
+	0x13, 0x09, 0x2b, 0x25, 0x43, 0xcc, 0x64, 0x29, 0x2a, 0xc0, 0xec, 0xa0,
+	0x9b, 0x4a, 0x7a, 0xef, 0x28, 0x50, 0xb3, 0xaa, 0x90, 0x44, 0x29, 0x23,
+	0x14, 0x94, 0xc9, 0xb2, 0xb3, 0x85, 0x64, 0xb5, 0xc3, 0xcf, 0xac, 0x32,
+	0xe2, 0xac, 0xa1, 0x3b, 0x9c, 0x36, 0x74, 0xb4, 0x52, 0x39, 0x41, 0x15,
+	0x55, 0x62, 0x25, 0x8d, 0x47, 0x58, 0x8d, 0x4c, 0xe4, 0xfa, 0x12, 0x45,
+	0x89, 0x5a, 0xe0, 0x83, 0xe8, 0x85, 0xfd, 0x75, 0x73, 0x6c, 0x1b, 0xc5,
+	0xd1, 0xa3, 0xa5, 0x8a, 0xdd, 0x55, 0xca, 0xb7, 0xc9, 0xb0, 0x8b, 0x48,
+	0x77, 0xae, 0x49, 0x2b, 0x17, 0x8d, 0x72, 0x44, 0xd1, 0x02, 0xd9, 0x77,
+	0x05, 0x63, 0xc5, 0xb2, 0x4a, 0x31, 0x67, 0x75, 0xb7, 0x41, 0xea, 0x9a,
+	0x4e, 0x9c, 0xec, 0x07, 0xc5, 0x8f, 0x71, 0x7e, 0x81, 0x90, 0x94, 0xb6,
+	0x9d, 0x50, 0x8c, 0x2a, 0x70, 0x4a, 0xbf, 0xce, 0x28, 0x5d, 0x97, 0x48,
+	0x39, 0x63, 0x35, 0x39, 0x2a, 0xd3, 0x71, 0xf4, 0x6a, 0x44, 0xa7, 0x00,
+	0x1d, 0xdb, 0x77, 0x71, 0x5c, 0x49, 0xa2, 0x5f, 0x94, 0x94, 0x3c, 0x33,
+	0x3d, 0xb9, 0x4a, 0xa3, 0x27, 0xac, 0xe5, 0x66, 0x81, 0xcb, 0x5a, 0xc3,
+	0x81, 0xdb, 0x0c, 0xe7, 0xc7, 0x22, 0x67, 0x6e, 0x24, 0x7d, 0xdd, 0x12,
+	0x47, 0x5b, 0x4d, 0xb1, 0x88, 0x63, 0xdd, 0x96, 0x0d, 0x0e, 0x2a, 0x17,
+	0x39, 0x18, 0x5b, 0x72, 0x60, 0x9c, 0x63, 0x52, 0xa3, 0x1b, 0xa3, 0xce,
+	0x92, 0x53, 0x0b, 0x93, 0xcb, 0xb2, 0xa5, 0xd4, 0x96, 0x9c, 0x01, 0x62,
+	0xa9, 0x88, 0xfa, 0x6a, 0xdc, 0x2c, 0xf9, 0xa9, 0x64, 0x0a, 0x7d, 0x5f,
+	0xcb, 0xcb, 0x01, 0x5c, 0xf3, 0xfd, 0x54, 0x99, 0x9c, 0x63, 0xa7, 0xd8,
+	0xc1, 0xb9, 0x89, 0x7b, 0x1b, 0x13, 0x34, 0x51, 0x74, 0x8a, 0x26, 0x07,
+	0x57, 0xe4, 0x4c, 0x34, 0x99, 0x1c, 0x11, 0x3f, 0x33, 0x83, 0x26, 0x81,
+	0xcc, 0xe2, 0x01, 0xf7, 0x81, 0x07, 0x07, 0xcf, 0x0a, 0x9b, 0xb8, 0x5f,
+	0x19, 0xfc, 0x8c, 0x8f, 0xc5, 0xc5, 0x11, 0x81, 0xe9, 0x81, 0x7a, 0xa4,
+	0xa7, 0x8e, 0xb2, 0x52, 0xa7, 0x09, 0x0c, 0xe4, 0x19, 0x93, 0x22, 0x13,
+	0xb9, 0xe5, 0x96, 0xd7, 0x15, 0x9d, 0x42, 0x27, 0xf3, 0x1a, 0x83, 0xec,
+	0x2c, 0xcd, 0x66, 0x89, 0xa5, 0x71, 0x7d, 0x4a, 0x6a, 0xf3, 0x36, 0x97,
+	0x02, 0x5f, 0x4e, 0x1e, 0xc0, 0x2f, 0x20, 0xe0, 0x11, 0x6d, 0xc4, 0xe4,
+	0x0e, 0xb6, 0x56, 0xb5, 0xdd, 0x12, 0x76, 0x85, 0xd8, 0x02, 0xc3, 0x72,
+	0xc5, 0x6e, 0xd7, 0xec, 0x2a, 0xb3, 0x92, 0x37, 0x5d, 0x33, 0xe5, 0x20,
+	0x44, 0x35, 0xb0, 0xc4, 0x36, 0x45, 0x28, 0x06, 0x53, 0x5c, 0x6c, 0x66,
+	0x8c, 0x6c, 0x8a, 0xc3, 0x44, 0x47, 0x66, 0x4b, 0xaf, 0x93, 0x5d, 0x5d,
+	0x39, 0x8c, 0x8b, 0xd3, 0xa7, 0x6c, 0x00, 0x19, 0xd1, 0x52, 0x25, 0x68,
+	0x1b, 0xb4, 0x03, 0x0f, 0x03, 0x35, 0xa9, 0x3d, 0x00, 0x04, 0xbd, 0x1b,
+	0xea, 0x63, 0x88, 0xdb, 0xe4, 0xb0, 0xb6, 0x28, 0x7a, 0x53, 0xf9, 0x6c,
+	0x4c, 0x2f, 0x8a, 0xd5, 0x6e, 0xdd, 0x04, 0x2b, 0x81, 0xb0, 0xb9, 0xa5,
+	0x7b, 0xa1, 0x78, 0x5e, 0x75, 0x2b, 0xec, 0x68, 0x55, 0x2c, 0x94, 0xf0,
+	0xac, 0x49, 0x8b, 0x78, 0xca, 0x32, 0x1f, 0xdb, 0xae, 0x12, 0x2a, 0x28,
+	0x55, 0xdf, 0xa8, 0x05, 0x20, 0xb2, 0x22, 0xf1, 0x38, 0x1c, 0x26, 0xd6,
+	0x3c, 0x83, 0x40, 0xd9, 0xba, 0x36, 0xc6, 0x62, 0xcc, 0xd7, 0xa5, 0xcb,
+	0x25, 0xa6, 0x50, 0x53, 0x42, 0xe4, 0x19, 0x1c, 0x9a, 0x89, 0x27, 0xdb,
+	0x70, 0x63, 0x28, 0x0a, 0x09, 0x3a, 0xdb, 0xd5, 0x86, 0x9d, 0x33, 0x6f,
+	0x42, 0xd3, 0x81, 0xee, 0xd5, 0x2a, 0xf5, 0xbd, 0x96, 0x2f, 0x89, 0x34,
+	0x90, 0x2a, 0xa2, 0x17, 0x39, 0xa2, 0x9b, 0x47, 0x4a, 0x57, 0x0c, 0x20,
+	0xe0, 0x8c, 0x7c, 0x14, 0x46, 0x24, 0xe9, 0xbc, 0xe3, 0x56, 0x82, 0x5c,
+	0x14, 0x37, 0x36, 0x5c, 0x49, 0xa3, 0x10, 0x70, 0x3c, 0x16, 0xe6, 0x27,
+	0xb3, 0xec, 0x52, 0x35, 0x03, 0xfe, 0xe8, 0x28, 0xb0, 0x51, 0xba, 0x5f,
+	0xd1, 0x21, 0x91, 0xac, 0xab, 0x07, 0x9d, 0x6c, 0x2a, 0xdd, 0x2c, 0x2d,
+	0x43, 0xb5, 0x06, 0x70, 0xd5, 0x24, 0xd4, 0x98, 0xaf, 0x48, 0x1e, 0x9a,
+	0xb8, 0x17, 0x58, 0xf9, 0x9a, 0xe7, 0xd4, 0x4e, 0x3b, 0x96, 0x3c, 0x63,
+	0x6f, 0xc5, 0x53, 0x9c, 0x87, 0x92, 0x93, 0x6c, 0x25, 0x71, 0x4b, 0x87,
+	0x5f, 0x4a, 0x08, 0x24, 0x66, 0xed, 0xd8, 0x6b, 0xaa, 0xd6, 0x35, 0x94,
+	0x77, 0x29, 0xe6, 0xb0, 0x77, 0x46, 0x44, 0x69, 0x9c, 0xf1, 0xad, 0x92,
+	0x5c, 0x5c, 0x2e, 0x11, 0x29, 0x51, 0x88, 0x4e, 0x58, 0x50, 0x21, 0xe9,
+	0x4a, 0x6e, 0x69, 0x5c, 0xb5, 0xdc, 0xa5, 0xf0, 0xb7, 0xcc, 0x90, 0x87,
+	0x5b, 0x8a, 0x5e, 0x39, 0x2d, 0x99, 0xe5, 0x33, 0x4c, 0xc6, 0x74, 0x8d,
+	0x96, 0xd5, 0xa1, 0xc4, 0x9d, 0x51, 0x16, 0x77, 0xe1, 0x14, 0x9f, 0x91,
+	0x24, 0xef, 0x2e, 0x05, 0xdb, 0xa4, 0xe4, 0x83, 0x93, 0x42, 0x43, 0xe5,
+	0xe2, 0x40, 0xc9, 0xcb, 0x5c, 0x51, 0x8c, 0x5a, 0x8f, 0x4f, 0x63, 0xfa,
+	0x97, 0xc8, 0x5f, 0xbc, 0x2d, 0xd5, 0x3c, 0x72, 0x55, 0xbe, 0x9a, 0xf9,
+	0x9c, 0x29, 0x5f, 0x64, 0x4a, 0x64, 0x1a, 0x07, 0xb1, 0x49, 0x39, 0x52,
+	0x5b, 0x92, 0xc0, 0x54, 0xc6, 0x60, 0x33, 0xd0, 0x7b, 0x08, 0x04, 0x8a,
+	0xaa, 0x80, 0xfb, 0x3e, 0x1f, 0x7c, 0x23, 0x5d, 0x60, 0x5b, 0xb4, 0x2c,
+	0x65, 0x9d, 0x33, 0x71, 0x10, 0x77, 0x3b, 0xd6, 0x50, 0x26, 0xe7, 0x89,
+	0xf6, 0x00, 0x80, 0x0b, 0x11, 0x29, 0x63, 0xf2, 0x82, 0xe4, 0x8a, 0x56,
+	0xb9, 0x66, 0x2a, 0xea, 0x6f, 0x88, 0x10, 0xe4, 0x74, 0x4c, 0x08, 0x59,
+	0xd3, 0x3a, 0xa9, 0x70, 0x21, 0xec, 0xf8, 0x10, 0xc8, 0x26, 0x83, 0x63,
+	0x38, 0xba, 0x69, 0x99, 0xa4, 0x73, 0xcb, 0xa2, 0x3a, 0x42, 0x66, 0x49,
+	0xb7, 0xb8, 0xc9, 0x53, 0xb4, 0x13, 0xf4, 0xea, 0x84, 0xfb, 0x10, 0x4f,
+	0x69, 0xfe, 0xdd, 0x70, 0x95, 0xd4, 0x27, 0xf5, 0x3a, 0x37, 0x5c, 0xa0,
+	0x90, 0xa0, 0x12, 0xd4, 0x34, 0x85, 0x5e, 0x6d, 0x11, 0x86, 0xda, 0x88,
+	0xf3, 0xac, 0xc4, 0x06, 0xaa, 0x01, 0x29, 0xa6, 0x5d, 0x2f, 0x8b, 0xa5,
+	0x51, 0xea, 0x5a, 0x10, 0x3b, 0xf2, 0x2b, 0x75, 0x07, 0x54, 0x9e, 0xb3,
+	0x69, 0xb9, 0x44, 0xcb, 0xe9, 0x80, 0xf8, 0x28, 0xce, 0xba, 0xae, 0x64,
+	0x62, 0xd5, 0x36, 0xfd, 0xa3, 0xc1, 0x15, 0xa0, 0x6e, 0x44, 0x34, 0xb5,
+	0xe4, 0x8b, 0x16, 0x19, 0x9d, 0x5f, 0x90, 0xda, 0x02, 0x81, 0x64, 0x6a,
+	0x2d, 0x40, 0x5d, 0x94, 0x1d, 0x5f, 0x7b, 0x81, 0x46, 0xb4, 0xd4, 0x94,
+	0x88, 0x4e, 0xad, 0xe8, 0x91, 0x2f, 0xa5, 0x64, 0xa6, 0xa1, 0x0b, 0x79,
+	0x21, 0x76, 0x20, 0xc0, 0x78, 0x5e, 0xfa, 0x81, 0xd2, 0xfc, 0x1a, 0x41,
+	0x89, 0xf9, 0x21, 0x3c, 0x17, 0x47, 0x7f, 0xd6, 0x1d, 0x3e, 0xbb, 0x46,
+	0x64, 0x7c, 0xf6, 0xbc, 0xa5, 0xab, 0x26, 0x66, 0x1e, 0xd6, 0x2e, 0xeb,
+	0xe5, 0xd6, 0x11, 0xae, 0x86, 0xa2, 0x66, 0x0e, 0x73, 0x3b, 0xa8, 0x0f,
+	0x3b, 0x3b, 0x78, 0xb2, 0x22, 0x98, 0x3e, 0x09, 0x95, 0xf6, 0xc8, 0x62,
+	0xd2, 0x88, 0xa8, 0x4f, 0xa3, 0x74, 0xd8, 0x34, 0xf1, 0x4f, 0xa0, 0x15,
+	0xb2, 0x4e, 0x24, 0x99, 0x17, 0x28, 0x21, 0x52, 0xad, 0x16, 0xec, 0x30,
+	0x37, 0x9a, 0x3a, 0x9b, 0x7a, 0x16, 0x0e, 0xe6, 0xb2, 0xaa, 0xd4, 0x98,
+	0x8a, 0xc2, 0x31, 0xae, 0xe6, 0x28, 0x41, 0xb4, 0xbc, 0x3b, 0xa0, 0x31,
+	0x5a, 0x3d, 0x54, 0xe6, 0xaa, 0x32, 0x24, 0x27, 0xe6, 0xa6, 0x5d, 0x95,
+	0x47, 0xd0, 0xd6, 0x26, 0x86, 0x48, 0x0b, 0xf7, 0x46, 0xb4, 0x4d, 0x6d,
+	0x04, 0x48, 0x45, 0x21, 0x86, 0x9a, 0xc2, 0x56, 0x4a, 0x2b, 0xeb, 0xdf,
+	0x0a, 0xdf, 0x15, 0x40, 0x11, 0x0d, 0x84, 0x35, 0x22, 0xc9, 0x94, 0x80,
+	0xb2, 0xef, 0x28, 0x8d, 0xd0, 0x2b, 0x68, 0x7e, 0xad, 0xf1, 0x56, 0xe6,
+	0x95, 0x23, 0xf5, 0xae, 0xf9, 0xae, 0xea, 0xbe, 0x57, 0x9d, 0x89, 0x2b,
+	0x41, 0x7a, 0x52, 0x3a, 0x46, 0x7a, 0x04, 0xe1, 0x5c, 0x5b, 0xfc, 0x03,
+	0xae, 0xef, 0xac, 0x66, 0x94, 0xb1, 0x49, 0x23, 0x66, 0x6c, 0x84, 0x6b,
+	0x83, 0x54, 0x10, 0xe4, 0xa4, 0xa4, 0xb6, 0x72, 0x5e, 0xbf, 0x64, 0xa1,
+	0x6f, 0x17, 0x50, 0xc8, 0xa2, 0xb5, 0x84, 0x16, 0x24, 0x3b, 0xa1, 0x45,
+	0xad, 0xcc, 0xce, 0x25, 0x62, 0x22, 0x5e, 0x13, 0xa2, 0xe6, 0x9c, 0x32,
+	0x14, 0x5a, 0x5b, 0xf5, 0x5a, 0xd8, 0x70, 0xc9, 0xb0, 0xd9, 0x34, 0x37,
+	0x7a, 0x8e, 0x77, 0x0d, 0x28, 0xc0, 0xfa, 0x42, 0xa4, 0x17, 0xfc, 0x78,
+	0x6c, 0x9a, 0x4d, 0xc0, 0xb8, 0x4d, 0xbe, 0xa1, 0x49, 0xaf, 0x91, 0xe7,
+	0xbd, 0x89, 0x9c, 0x4a, 0x0d, 0x6b, 0xd7, 0x5b, 0x58, 0x02, 0x22, 0x39,
+	0x2e, 0x51, 0xcb, 0xa5, 0xda, 0x87, 0x94, 0xa8, 0x51, 0x73, 0x1b, 0x71,
+	0x82, 0xca, 0x19, 0x73, 0xbb, 0xbc, 0x80, 0xfb, 0xe5, 0x6d, 0x0f, 0xa4,
+	0x8d, 0x6b, 0xf5, 0x25, 0x8f, 0x83, 0x1a, 0x6e, 0x29, 0x54, 0x47, 0x82,
+	0x20, 0xf5, 0xe0, 0x42, 0x3f, 0xe3, 0x54, 0x41, 0x1f, 0x49, 0x21, 0xe5,
+	0x6c, 0xa5, 0xde, 0x9f, 0x7a, 0xb1, 0x84, 0x8e, 0xc2, 0xcf, 0xa1, 0x2d,
+	0xab, 0x65, 0xea, 0x8c, 0x84, 0x47, 0x83, 0x5f, 0x61, 0x38, 0x69, 0x59,
+	0x04, 0xce, 0xf3, 0xf4, 0x83, 0x2e, 0x80, 0xb2, 0x4b, 0x44, 0x05, 0xd0,
+	0xcb, 0xba, 0x2a, 0xf5, 0xaa, 0x57, 0xa0, 0x01, 0x0d, 0xca, 0xca, 0x04,
+	0x5e, 0xf1, 0xa8, 0xba, 0x62, 0x4a, 0xd6, 0xb5, 0xe0, 0x4a, 0x11, 0x5d,
+	0xfb, 0x17, 0x2f, 0x7a, 0x3e, 0xad, 0x4b, 0x4b, 0x15, 0x38, 0x3d, 0xcc,
+	0xbe, 0x00, 0xba, 0xa6, 0xa7, 0x24, 0x97, 0xec, 0x99, 0x17, 0x9b, 0xcc,
+	0xcc, 0x5c, 0x3d, 0x08, 0xe8, 0x25, 0xe6, 0x66, 0xda, 0xea, 0x50, 0xf7,
+	0x86, 0xba, 0x67, 0xd9, 0xde, 0x32, 0xa1, 0xbf, 0x09, 0x1e, 0x23, 0x35,
+	0x52, 0xe7, 0x60, 0xd2, 0x66, 0x1c, 0xe3, 0x1e, 0x95, 0x0c, 0xe3, 0xd8,
+	0xe9, 0x19, 0x53, 0x37, 0xf0, 0xbe, 0xa5, 0xe2, 0xd5, 0xa4, 0xce, 0xaf,
+	0xb8, 0x53, 0xb0, 0x9b, 0xa4, 0x53, 0x40, 0x17, 0xa5, 0x3e, 0x47, 0x8d,
+	0xde, 0xc0, 0x82, 0x3b, 0x87, 0x86, 0x34, 0xa8, 0x2d, 0x6d, 0x21, 0x64,
+	0x97, 0x07, 0xc5, 0x56, 0x4a, 0xbb, 0xb5, 0xfb, 0xae, 0x70, 0x39, 0x44,
+	0x9c, 0x4a, 0x41, 0x88, 0xf9, 0x5f, 0xc9, 0x7c, 0x1b, 0xe9, 0x22, 0x35,
+	0xb5, 0xd0, 0xab, 0x2d, 0xb5, 0x70, 0x94, 0x6b, 0xa2, 0x84, 0xb4, 0x2d,
+	0xb9, 0x95, 0xc1, 0x63, 0x16, 0x01, 0x77, 0x41, 0xd0, 0x2e, 0x4b, 0x84,
+	0xc9, 0x15, 0x6a, 0xdd, 0x0e, 0xd8, 0x4a, 0xf9, 0x6a, 0xcd, 0xa2, 0xa6,
+	0xc5, 0xd8, 0xfe, 0xa4, 0x20, 0x70, 0x41, 0x2c, 0x92, 0x45, 0x66, 0xe0,
+	0x1b, 0x87, 0xb2, 0xab, 0x62, 0x23, 0x2e, 0xe7, 0x0a, 0x29, 0x3f, 0xa7,
+	0xd6, 0x52, 0x6f, 0x01, 0xa2, 0xce, 0x69, 0xa2, 0xed, 0x0e, 0x46, 0xba,
+	0x44, 0x56, 0x41, 0x5f, 0xa8, 0x51, 0xbc, 0x6d, 0xde, 0xa5, 0x64, 0x76,
+	0xd3, 0x93, 0x91, 0x1c, 0x1f, 0x1a, 0x9a, 0x55, 0x05, 0x69, 0x3d, 0xa1,
+	0x88, 0x72, 0x50, 0x3e, 0xc1, 0x0c, 0x79, 0x75, 0x7a, 0xa5, 0x89, 0x66,
+	0x69, 0x6a, 0x5d, 0xcb, 0xa7, 0xda, 0xbd, 0x81, 0xf6, 0xc1, 0x4e, 0xd5,
+	0x53, 0x6e, 0xd3, 0x21, 0xd2, 0x63, 0xdf, 0xea, 0xb9, 0xad, 0x94, 0x12,
+	0x21, 0xba, 0x9c, 0x02, 0xef, 0x16, 0xc2, 0x8d, 0xa5, 0x10, 0x1f, 0x53,
+	0x78, 0x02, 0x62, 0x2b, 0xa9, 0x03, 0x75, 0x5b, 0x5d, 0x5b, 0xdb, 0x8a,
+	0xd8, 0xad, 0xbd, 0xf4, 0x15, 0x50, 0xe2, 0x9b, 0x50, 0x37, 0x69, 0xc7,
+	0x43, 0x75, 0xb3, 0xb6, 0xae, 0x54, 0xba, 0x1b, 0xb9, 0x69, 0x9c, 0x70,
+	0xdb, 0x1c, 0x42, 0x82, 0xb9, 0x1d, 0xc2, 0xad, 0xac, 0x6e, 0x13, 0xfa,
+	0x9e, 0xdf, 0xfa, 0x3d, 0x17, 0x3e, 0x74, 0x53, 0x1a, 0xc8, 0x37, 0x3c,
+	0xb7, 0x5d, 0x23, 0x52, 0x9a, 0xcd, 0xb8, 0x1e, 0x21, 0x88, 0x8f, 0xb1,
+	0x5d, 0xbe, 0x44, 0x56, 0xbb, 0x8c, 0x18, 0x70, 0x70, 0xdc, 0x64, 0xe8,
+	0xc1, 0x29, 0x20, 0x32, 0xbe, 0x4d, 0x42, 0xc6, 0x2d, 0x29, 0x78, 0xab,
+	0x44, 0x3d, 0x58, 0x0d, 0xb4, 0xe1, 0xf9, 0x89, 0x4e, 0xd2, 0x68, 0xbd,
+	0xe0, 0x3d, 0x7d, 0xb5, 0xd0, 0x79, 0x03, 0x7e, 0x41, 0x8a, 0xea, 0xc4,
+	0x23, 0xa0, 0x94, 0x3a, 0xa8, 0x79, 0xd1, 0x4d, 0x94, 0x91, 0x04, 0x08,
+	0x54, 0x40, 0xba, 0x51, 0x2d, 0x6c, 0x5d, 0x99, 0x13, 0xe7, 0x85, 0xdb,
+	0xbe, 0xdf, 0xfa, 0x2a, 0x56, 0x2d, 0x49, 0xc0, 0xa6, 0x4b, 0xc0, 0x5d,
+	0xde, 0x29, 0xd6, 0xb7, 0xe5, 0x94, 0x05, 0xea, 0xd4, 0x33, 0xc1, 0xc7,
+	0x42, 0x34, 0xe0, 0xfb, 0x86, 0x7f, 0x00, 0x8b, 0x97, 0xfd, 0xba, 0x00,
+	0x40, 0x00, 0x00,
+};
+
+#endif /* LK2ND_FASTBOOT_BENCH_SUITE_VECTOR_H */
@@ -0,0 +1,403 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <board.h>
+#include <crc32.h>
+#include <crypto_hash.h>
+#include <debug.h>
+#include <decompress.h>
+#include <dev/fbcon.h>
+#include <fastboot.h>
+#include <lib/bcache.h>
+#include <lib/bio.h>
+#include <lib/lz4.h>
+#include <platform.h>
+#include <printf.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <target.h>
+#if WITH_LIB_OPENSSL
+#include <sha.h>
+#endif
+
+#include <lk2nd/util/region.h>
+#include <lk2nd/version.h>
+
+#if WITH_LK2ND_DEVICE
+#include "../device/device.h"
+#endif
+#include "bench-suite-vector.h"
+
+/*
+ * A fixed set of benchmarks to compare devices and lk2nd releases:
+ * "fastboot oem bench-suite" runs all of them with fixed sizes and a fixed
+ * random seed, shows the results and stages them as text, so the output of
+ * "fastboot get_staged" can be diffed between runs.
+ *
+ * Rates are in MB/s (bytes per us). Storage is only read, from the start
+ * of each top-level block device, partitions share the same hardware.
+ */
+
+#define BENCH_REPORT_SIZE	4096
+#define BENCH_SCRATCH_SIZE	(16 * 1024 * 1024)
+
+#define BENCH_MEM_TOTAL		(32 * 1024 * 1024)
+#define BENCH_BDEVS		8
+#define BENCH_BIO_SEQ_SIZE	(512 * 1024)
+#define BENCH_BIO_SEQ_TOTAL	(16 * 1024 * 1024)
+#define BENCH_BIO_RAND_SIZE	4096
+#define BENCH_BIO_RAND_COUNT	256
+#define BENCH_BCACHE_HITS	4096
+#define BENCH_BCACHE_MISSES	256
+#define BENCH_DECOMPRESS_RUNS	64
+#define BENCH_HASH_SIZE		(1024 * 1024)
+#define BENCH_HASH_RUNS		16
+#define BENCH_CRC32_RUNS	16
+#define BENCH_GLYPHS		4096
+
+struct bench_suite {
+	char *report;
+	size_t len;
+	uint8_t *scratch;
+	size_t size;
+	uint32_t seed;
+};
+
+static void bench_printf(struct bench_suite *s, const char *fmt, ...)
+{
+	char line[MAX_RSP_SIZE - 4];
+	va_list ap;
+
+	va_start(ap, fmt);
+	vsnprintf(line, sizeof(line), fmt, ap);
+	va_end(ap);
+
+	fastboot_info(line);
+	s->len += snprintf(s->report + s->len, BENCH_REPORT_SIZE - s->len, "%s\n", line);
+	s->len = MIN(s->len, BENCH_REPORT_SIZE - 1);
+}
+
+/* Restarted with the same seed for every run, unlike rand() */
+static uint32_t bench_rand(struct bench_suite *s)
+{
+	s->seed = s->seed * 1103515245 + 12345;
+	return s->seed >> 8;
+}
+
+static unsigned bench_rate(uint64_t bytes, bigtime_t us)
+{
+	return us ? bytes / us : 0;
+}
+
+static void bench_mem(struct bench_suite *s)
+{
+	static const size_t sizes[] = { 4 * 1024, 64 * 1024, 1024 * 1024, 8 * 1024 * 1024 };
+	uint8_t *src = s->scratch, *dst = s->scratch + s->size / 2;
+	unsigned i, n, loops, rate[3];
+	bigtime_t start;
+	size_t size;
+
+	for (i = 0; i < countof(sizes); i++) {
+		size = sizes[i];
+		if (2 * size > s->size)
+			break;
+		loops = MAX(BENCH_MEM_TOTAL / size, 1U);
+
+		start = current_time_hires();
+		for (n = 0; n < loops; n++)
+			memcpy(dst, src, size);
+		rate[0] = bench_rate((uint64_t)loops * size, current_time_hires() - start);
+
+		start = current_time_hires();
+		for (n = 0; n < loops; n++)
+			memmove(src + 64, src, size - 64);
+		rate[1] = bench_rate((uint64_t)loops * size, current_time_hires() - start);
+
+		start = current_time_hires();
+		for (n = 0; n < loops; n++)
+			memset(dst, n, size);
+		rate[2] = bench_rate((uint64_t)loops * size, current_time_hires() - start);
+
+		bench_printf(s, "mem %uK: cpy %u move %u set %u", size / 1024,
+			     rate[0], rate[1], rate[2]);
+	}
+}
+
+#if WITH_LIB_BIO
+static void bench_bio(struct bench_suite *s, bdev_t *dev)
+{
+	uint64_t blocks, offset, seq, total = MIN(BENCH_BIO_SEQ_TOTAL, (uint64_t)dev->size);
+	unsigned rand_size = ROUNDUP(BENCH_BIO_RAND_SIZE, dev->block_size);
+	bigtime_t start, seq_us, rand_us;
+	unsigned i;
+
+	if (total < BENCH_BIO_SEQ_SIZE || s->size < BENCH_BIO_SEQ_SIZE)
+		return;
+
+	start = current_time_hires();
+	for (offset = 0; offset + BENCH_BIO_SEQ_SIZE <= total; offset += BENCH_BIO_SEQ_SIZE)
+		if (bio_read(dev, s->scratch, offset, BENCH_BIO_SEQ_SIZE) != BENCH_BIO_SEQ_SIZE)
+			goto err;
+	seq_us = current_time_hires() - start;
+	seq = offset;
+
+	blocks = (dev->size - rand_size) / dev->block_size + 1;
+	start = current_time_hires();
+	for (i = 0; i < BENCH_BIO_RAND_COUNT; i++) {
+		offset = ((uint64_t)bench_rand(s) * bench_rand(s) % blocks) * dev->block_size;
+		if (bio_read(dev, s->scratch, offset, rand_size) != (ssize_t)rand_size)
+			goto err;
+	}
+	rand_us = current_time_hires() - start;
+
+	bench_printf(s, "bio %s: seq %u rand4k %llu IOPS", dev->name,
+		     bench_rate(seq, seq_us),
+		     rand_us ? BENCH_BIO_RAND_COUNT * 1000000ULL / rand_us : 0);
+	return;
+
+err:
+	bench_printf(s, "bio %s: read failed", dev->name);
+}
+
+#if WITH_LIB_BCACHE
+/* A cache of 4 blocks: one block read repeatedly, then blocks far apart */
+static void bench_bcache(struct bench_suite *s, bdev_t *dev)
+{
+	bigtime_t start, hit_us, miss_us;
+	bcache_t cache;
+	unsigned i;
+
+	if (dev->block_count < BENCH_BCACHE_MISSES * 64)
+		return;
+
+	cache = bcache_create(dev, dev->block_size, 4);
+	if (!cache)
+		return;
+
+	start = current_time_hires();
+	for (i = 0; i < BENCH_BCACHE_HITS; i++)
+		if (bcache_read_block(cache, s->scratch, 0) < 0)
+			goto err;
+	hit_us = current_time_hires() - start;
+
+	start = current_time_hires();
+	for (i = 1; i <= BENCH_BCACHE_MISSES; i++)
+		if (bcache_read_block(cache, s->scratch, i * 64) < 0)
+			goto err;
+	miss_us = current_time_hires() - start;
+
+	bench_printf(s, "bcache %s: hit %llu ns miss %llu us", dev->name,
+		     hit_us * 1000 / BENCH_BCACHE_HITS, miss_us / BENCH_BCACHE_MISSES);
+	bcache_destroy(cache);
+	return;
+
+err:
+	bench_printf(s, "bcache %s: read failed", dev->name);
+	bcache_destroy(cache);
+}
+#endif
+
+static void bench_storage(struct bench_suite *s)
+{
+	struct bdev_struct *bdevs = bio_get_bdevs();
+	const char *names[BENCH_BDEVS];
+	unsigned i, count = 0;
+	bdev_t *dev;
+
+	mutex_acquire(&bdevs->lock);
+	list_for_every_entry(&bdevs->list, dev, bdev_t, node) {
+		if (dev->is_leaf || count == BENCH_BDEVS)
+			continue;
+		names[count++] = dev->name;
+	}
+	mutex_release(&bdevs->lock);
+
+	for (i = 0; i < count; i++) {
+		dev = bio_open(names[i]);
+		if (!dev)
+			continue;
+#if WITH_LIB_BCACHE
+		if (i == 0)
+			bench_bcache(s, dev);
+#endif
+		bench_bio(s, dev);
+		bio_close(dev);
+	}
+}
+#endif
+
+static void bench_decompress(struct bench_suite *s)
+{
+	uint8_t *in = s->scratch, *out = s->scratch + BENCH_GZIP_VECTOR_SIZE;
+	unsigned pos, out_len, i;
+	bigtime_t start, us;
+#if WITH_LIB_LZ4
+	size_t lz4_len, len;
+	uint8_t *lz4 = out + BENCH_GZIP_VECTOR_SIZE;
+#endif
+
+	/* decompress() may look at up to out_buf_len bytes of input */
+	memset(in, 0, BENCH_GZIP_VECTOR_SIZE);
+	memcpy(in, bench_gzip_vector, sizeof(bench_gzip_vector));
+
+	start = current_time_hires();
+	for (i = 0; i < BENCH_DECOMPRESS_RUNS; i++)
+		if (decompress(in, sizeof(bench_gzip_vector), out, BENCH_GZIP_VECTOR_SIZE,
+			       &pos, &out_len) || out_len != BENCH_GZIP_VECTOR_SIZE)
+			goto err;
+	us = current_time_hires() - start;
+
+	if ((crc32(~0U, out, out_len) ^ ~0U) != BENCH_GZIP_VECTOR_CRC32)
+		goto err;
+	bench_printf(s, "gzip: %u", bench_rate(BENCH_DECOMPRESS_RUNS * BENCH_GZIP_VECTOR_SIZE, us));
+
+#if WITH_LIB_LZ4
+	/* The same data compressed with LZ4, compared with the gzip output */
+	lz4_len = lz4_compress(out, BENCH_GZIP_VECTOR_SIZE, lz4);
+	if (!lz4_len)
+		return;
+
+	start = current_time_hires();
+	for (i = 0; i < BENCH_DECOMPRESS_RUNS; i++)
+		if (lz4_decompress(lz4, lz4_len, in, BENCH_GZIP_VECTOR_SIZE, &len) < 0 ||
+		    len != BENCH_GZIP_VECTOR_SIZE)
+			goto err;
+	us = current_time_hires() - start;
+
+	if (memcmp(in, out, BENCH_GZIP_VECTOR_SIZE))
+		goto err;
+	bench_printf(s, "lz4: %u", bench_rate(BENCH_DECOMPRESS_RUNS * BENCH_GZIP_VECTOR_SIZE, us));
+#endif
+	return;
+
+err:
+	bench_printf(s, "decompress: wrong result");
+}
+
+static unsigned bench_hash_run(struct bench_suite *s, int backend, uint8_t *digest)
+{
+	bigtime_t start = current_time_hires();
+	unsigned i;
+
+	for (i = 0; i < BENCH_HASH_RUNS; i++) {
+		switch (backend) {
+		case 0:
+#if WITH_SHA_ARMV8
+			if (sha_armv8_supported() &&
+			    hash_find_armv8(s->scratch, BENCH_HASH_SIZE, digest,
+					    CRYPTO_AUTH_ALG_SHA256) == CRYPTO_SHA_ERR_NONE)
+				break;
+#endif
+			return 0;
+		case 1:
+			if (board_ce_type() == CRYPTO_ENGINE_TYPE_HW &&
+			    hash_find_engine(s->scratch, BENCH_HASH_SIZE, digest,
+					     CRYPTO_AUTH_ALG_SHA256) == CRYPTO_SHA_ERR_NONE)
+				break;
+			return 0;
+		default:
+#if WITH_LIB_OPENSSL
+			SHA256(s->scratch, BENCH_HASH_SIZE, digest);
+			break;
+#else
+			return 0;
+#endif
+		}
+	}
+
+	return bench_rate((uint64_t)BENCH_HASH_RUNS * BENCH_HASH_SIZE,
+			  current_time_hires() - start);
+}
+
+static void bench_checksum(struct bench_suite *s)
+{
+	uint8_t digest[32];
+	unsigned cpu, engine, sw, i;
+	bigtime_t start;
+	uint32_t crc = ~0U;
+
+	if (s->size < BENCH_HASH_SIZE)
+		return;
+
+	for (i = 0; i < BENCH_HASH_SIZE; i++)
+		s->scratch[i] = bench_rand(s);
+
+	target_crypto_init_params();
+	cpu = bench_hash_run(s, 0, digest);
+	engine = bench_hash_run(s, 1, digest);
+	sw = bench_hash_run(s, 2, digest);
+	bench_printf(s, "sha256: cpu %u engine %u sw %u", cpu, engine, sw);
+
+	start = current_time_hires();
+	for (i = 0; i < BENCH_CRC32_RUNS; i++)
+		crc = crc32(crc, s->scratch, BENCH_HASH_SIZE);
+	bench_printf(s, "crc32: %u", bench_rate((uint64_t)BENCH_CRC32_RUNS * BENCH_HASH_SIZE,
+						current_time_hires() - start));
+}
+
+#if DISPLAY_SPLASH_SCREEN
+/* Draw into the first text line and put back what was there before */
+static void bench_fbcon(struct bench_suite *s)
+{
+	struct fbcon_config *fb = fbcon_display();
+	size_t line;
+	bigtime_t start, us;
+	unsigned i;
+
+	if (!fb || !fb->base)
+		return;
+
+	line = fb->stride * (fb->bpp / 8) * 16;
+	if (line > s->size)
+		return;
+	memcpy(s->scratch, fb->base, line);
+
+	start = current_time_hires();
+	for (i = 0; i < BENCH_GLYPHS; i++)
+		fbcon_putc_factor_xy('A' + i % 26, FBCON_COMMON_MSG, 1,
+				     (i % 32) * 6, 0);
+	us = current_time_hires() - start;
+
+	memcpy(fb->base, s->scratch, line);
+	fbcon_flush();
+
+	bench_printf(s, "fbcon: %llu glyphs/s", us ? BENCH_GLYPHS * 1000000ULL / us : 0);
+}
+#endif
+
+static void cmd_oem_bench_suite(const char *arg, void *data, unsigned sz)
+{
+	struct bench_suite s = { .seed = 12345 };
+
+	s.size = MIN(BENCH_SCRATCH_SIZE, target_get_max_flash_size());
+	s.scratch = lk2nd_region_alloc("bench-suite", s.size);
+	s.report = malloc(BENCH_REPORT_SIZE);
+	if (!s.scratch || !s.report) {
+		fastboot_fail("out of memory");
+		goto out;
+	}
+
+	bench_printf(&s, "lk2nd %s", LK2ND_VERSION);
+	bench_printf(&s, "platform %u, hw %u", board_platform_id(), board_hardware_id());
+#if WITH_LK2ND_DEVICE
+	if (lk2nd_dev.model)
+		bench_printf(&s, "model %s", lk2nd_dev.model);
+#endif
+	bench_mem(&s);
+#if WITH_LIB_BIO
+	bench_storage(&s);
+#endif
+	bench_decompress(&s);
+	bench_checksum(&s);
+#if DISPLAY_SPLASH_SCREEN
+	bench_fbcon(&s);
+#endif
+
+	fastboot_stage(s.report, s.len);
+
+out:
+	free(s.report);
+	if (s.scratch)
+		lk2nd_region_free(s.scratch);
+}
+FASTBOOT_REGISTER("oem bench-suite", cmd_oem_bench_suite);
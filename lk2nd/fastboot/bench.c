@@ -0,0 +1,272 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <lib/bio.h>
+#include <fastboot.h>
+#include <platform.h>
+#include <printf.h>
+#include <rand.h>
+#include <stdlib.h>
+#include <string.h>
+#include <target.h>
+
+#include <lk2nd/util/region.h>
+
+/*
+ * Throughput benchmarks to find out whether the USB link or the storage
+ * limits the transfer speed on a particular device:
+ *
+ * - oem bench-usb <MiB>: the following download is discarded and the
+ *   following upload sends <MiB> of garbage, so only USB is measured.
+ * - oem bench-bdev <dev> <MiB> [seq|rand] [write]: time bio_read() (and
+ *   writing the same data back) with a latency histogram per request.
+ *
+ * Like the UMS statistics, rates are computed from bytes per ms.
+ */
+#define BENCH_SEQ_REQ_SIZE	(512 * 1024)
+#define BENCH_RAND_REQ_SIZE	(4 * 1024)
+#define BENCH_HIST_BUCKETS	12	/* < 64 us, < 128 us, ..., >= 64 ms */
+#define BENCH_HIST_MIN_US	64
+
+static void bench_report(const char *what, uint64_t bytes, time_t ms)
+{
+	char response[MAX_RSP_SIZE];
+	/* bytes/ms ~= KB/s */
+	uint32_t kbps = ms ? (uint32_t)(bytes / ms) : 0;
+
+	snprintf(response, sizeof(response), "%s: %llu KiB in %lu ms, %u.%u MB/s",
+		 what, bytes / 1024, ms, kbps / 1000, (kbps % 1000) / 100);
+	fastboot_info(response);
+}
+
+static unsigned bench_parse_mib(const char **arg)
+{
+	unsigned mib;
+
+	while (**arg == ' ')
+		(*arg)++;
+	mib = atoi(*arg);
+	while (**arg && **arg != ' ')
+		(*arg)++;
+
+	return mib;
+}
+
+struct bench_usb {
+	struct fastboot_stream stream;
+	time_t start;
+	unsigned len;
+};
+
+static struct bench_usb bench_download, bench_upload;
+
+static int bench_usb_begin(struct fastboot_stream *stream, unsigned len)
+{
+	struct bench_usb *b = containerof(stream, struct bench_usb, stream);
+
+	/* Only one of them is used, do not keep the other one armed */
+	fastboot_stream_download(NULL);
+	fastboot_stream_upload(NULL, 0);
+
+	b->len = len;
+	b->start = current_time();
+	return 0;
+}
+
+static int bench_usb_sink(struct fastboot_stream *stream, void *data, unsigned len)
+{
+	return 0;
+}
+
+static int bench_usb_source(struct fastboot_stream *stream, void *data, unsigned len)
+{
+	return 0;
+}
+
+static void bench_usb_end(struct fastboot_stream *stream, int status)
+{
+	struct bench_usb *b = containerof(stream, struct bench_usb, stream);
+
+	bench_report(b == &bench_download ? "download" : "upload",
+		     b->len, current_time() - b->start);
+	fastboot_okay("");
+}
+
+static struct bench_usb bench_download = {
+	.stream = {
+		.begin = bench_usb_begin,
+		.write = bench_usb_sink,
+		.end = bench_usb_end,
+	},
+};
+
+static struct bench_usb bench_upload = {
+	.stream = {
+		.begin = bench_usb_begin,
+		.read = bench_usb_source,
+		.end = bench_usb_end,
+	},
+};
+
+static void cmd_oem_bench_usb(const char *arg, void *data, unsigned sz)
+{
+	unsigned mib = bench_parse_mib(&arg);
+
+	if (!mib || mib > 4095) {
+		fastboot_fail("usage: fastboot oem bench-usb <MiB>");
+		return;
+	}
+
+	fastboot_stream_download(&bench_download.stream);
+	fastboot_stream_upload(&bench_upload.stream, mib * 1024 * 1024);
+	fastboot_info("next download is discarded, next upload sends garbage");
+	fastboot_okay("");
+}
+FASTBOOT_REGISTER("oem bench-usb", cmd_oem_bench_usb);
+
+#if WITH_LIB_BIO
+struct bench_hist {
+	unsigned count[BENCH_HIST_BUCKETS];
+	uint64_t bytes;
+	bigtime_t total_us;
+	bigtime_t max_us;
+};
+
+static void bench_hist_add(struct bench_hist *h, unsigned len, bigtime_t us)
+{
+	unsigned i = 0;
+
+	while (i < BENCH_HIST_BUCKETS - 1 && us >= ((bigtime_t)BENCH_HIST_MIN_US << i))
+		i++;
+
+	h->count[i]++;
+	h->bytes += len;
+	h->total_us += us;
+	h->max_us = MAX(h->max_us, us);
+}
+
+static void bench_hist_report(const char *what, struct bench_hist *h)
+{
+	char response[MAX_RSP_SIZE];
+	unsigned i;
+
+	bench_report(what, h->bytes, h->total_us / 1000);
+	for (i = 0; i < BENCH_HIST_BUCKETS; i++) {
+		if (!h->count[i])
+			continue;
+		if (i < BENCH_HIST_BUCKETS - 1)
+			snprintf(response, sizeof(response), "  < %6u us: %u",
+				 BENCH_HIST_MIN_US << i, h->count[i]);
+		else
+			snprintf(response, sizeof(response), "  >=%6u us: %u",
+				 BENCH_HIST_MIN_US << (i - 1), h->count[i]);
+		fastboot_info(response);
+	}
+	snprintf(response, sizeof(response), "  max %llu us", h->max_us);
+	fastboot_info(response);
+}
+
+static void cmd_oem_bench_bdev(const char *arg, void *data, unsigned sz)
+{
+	struct bench_hist rd = {0}, wr = {0};
+	char name[32];
+	bool random = false, write = false;
+	uint64_t total, done, blocks, offset = 0;
+	unsigned req_size, len;
+	bigtime_t start, us;
+	bdev_t *dev;
+	uint8_t *buf;
+	ssize_t ret;
+
+	while (*arg == ' ')
+		arg++;
+	for (len = 0; arg[len] && arg[len] != ' '; len++)
+		;
+	if (!len || len >= sizeof(name))
+		goto usage;
+	strlcpy(name, arg, len + 1);
+	arg += len;
+
+	total = (uint64_t)bench_parse_mib(&arg) * 1024 * 1024;
+	if (!total)
+		goto usage;
+
+	while (*arg) {
+		while (*arg == ' ')
+			arg++;
+		if (!strncmp(arg, "rand", 4))
+			random = true;
+		else if (!strncmp(arg, "write", 5))
+			write = true;
+		else if (*arg && strncmp(arg, "seq", 3))
+			goto usage;
+		while (*arg && *arg != ' ')
+			arg++;
+	}
+
+	dev = bio_open(name);
+	if (!dev) {
+		fastboot_fail("block device not found");
+		return;
+	}
+
+	req_size = random ? BENCH_RAND_REQ_SIZE : BENCH_SEQ_REQ_SIZE;
+	req_size = ROUNDUP(req_size, dev->block_size);
+	total = MIN(total, (uint64_t)dev->size);
+	if (total < req_size) {
+		bio_close(dev);
+		fastboot_fail("device too small");
+		return;
+	}
+	blocks = (dev->size - req_size) / dev->block_size;
+
+	buf = lk2nd_region_alloc("bench", req_size);
+	if (!buf) {
+		bio_close(dev);
+		fastboot_fail("not enough scratch memory");
+		return;
+	}
+
+	for (done = 0; done + req_size <= total; done += req_size) {
+		if (random)
+			offset = ((uint64_t)rand() * rand() % (blocks + 1)) * dev->block_size;
+
+		start = current_time_hires();
+		ret = bio_read(dev, buf, offset, req_size);
+		us = current_time_hires() - start;
+		if (ret != (ssize_t)req_size) {
+			fastboot_fail("read failed");
+			goto out;
+		}
+		bench_hist_add(&rd, req_size, us);
+
+		/* Write back what was just read, so the data stays the same */
+		if (write) {
+			start = current_time_hires();
+			ret = bio_write(dev, buf, offset, req_size);
+			us = current_time_hires() - start;
+			if (ret != (ssize_t)req_size) {
+				fastboot_fail("write failed");
+				goto out;
+			}
+			bench_hist_add(&wr, req_size, us);
+		}
+
+		if (!random)
+			offset += req_size;
+	}
+
+	bench_hist_report("read", &rd);
+	if (write)
+		bench_hist_report("write", &wr);
+	fastboot_okay("");
+
+out:
+	lk2nd_region_free(buf);
+	bio_close(dev);
+	return;
+
+usage:
+	fastboot_fail("usage: fastboot oem bench-bdev <dev> <MiB> [seq|rand] [write]");
+}
+FASTBOOT_REGISTER("oem bench-bdev", cmd_oem_bench_bdev);
+#endif
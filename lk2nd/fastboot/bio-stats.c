@@ -0,0 +1,82 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <lib/bio.h>
+#include <fastboot.h>
+#include <printf.h>
+#include <string.h>
+
+/*
+ * oem bio-stats [reset]: show the I/O accounting of the block devices
+ * (struct bio_stats) that saw any requests, e.g. to compare how an SD card
+ * and the eMMC behave during boot. The latency histogram shows the number
+ * of requests below each power of two in us.
+ */
+
+static void bio_stats_report(const char *what, const struct bio_stats_dir *dir)
+{
+	char response[MAX_RSP_SIZE];
+	size_t len;
+	unsigned i;
+
+	if (!dir->ops)
+		return;
+
+	snprintf(response, sizeof(response), "  %s: %u ops, %llu KiB, avg %llu us, %u errors",
+		 what, dir->ops, dir->bytes / 1024, dir->total_us / dir->ops, dir->errors);
+	fastboot_info(response);
+
+	len = strlcpy(response, "   ", sizeof(response));
+	for (i = 0; i < BIO_STATS_HIST_BUCKETS; i++) {
+		char bucket[24];
+
+		if (!dir->hist[i])
+			continue;
+
+		if (i < BIO_STATS_HIST_BUCKETS - 1)
+			snprintf(bucket, sizeof(bucket), " <%u:%u", 2U << i, dir->hist[i]);
+		else
+			snprintf(bucket, sizeof(bucket), " >=%u:%u", 1U << i, dir->hist[i]);
+
+		if (len + strlen(bucket) >= sizeof(response)) {
+			fastboot_info(response);
+			len = strlcpy(response, "   ", sizeof(response));
+		}
+		len = strlcat(response, bucket, sizeof(response));
+	}
+	fastboot_info(response);
+}
+
+static void cmd_oem_bio_stats(const char *arg, void *data, unsigned sz)
+{
+	struct bdev_struct *bdevs = bio_get_bdevs();
+	char response[MAX_RSP_SIZE];
+	bdev_t *dev;
+
+	while (*arg == ' ')
+		arg++;
+
+	if (!strcmp(arg, "reset")) {
+		bio_reset_stats();
+		fastboot_okay("");
+		return;
+	} else if (*arg) {
+		fastboot_fail("usage: oem bio-stats [reset]");
+		return;
+	}
+
+	mutex_acquire(&bdevs->lock);
+	list_for_every_entry(&bdevs->list, dev, bdev_t, node) {
+		if (!dev->stats.read.ops && !dev->stats.write.ops)
+			continue;
+
+		snprintf(response, sizeof(response), "%s: merged %u, bounced %u",
+			 dev->name, dev->stats.merged, dev->stats.bounced);
+		fastboot_info(response);
+		bio_stats_report("read", &dev->stats.read);
+		bio_stats_report("write", &dev->stats.write);
+	}
+	mutex_release(&bdevs->lock);
+
+	fastboot_okay("");
+}
+FASTBOOT_REGISTER("oem bio-stats", cmd_oem_bio_stats);
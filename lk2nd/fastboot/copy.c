@@ -0,0 +1,330 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <crypto_hash.h>
+#include <debug.h>
+#include <fastboot.h>
+#include <lib/bio.h>
+#include <lib/fs.h>
+#include <platform.h>
+#include <printf.h>
+#include <stdlib.h>
+#include <string.h>
+#include <target.h>
+
+#include <lk2nd/util/region.h>
+
+/*
+ * oem copy-partition <src>[:offset[:size]] <dst>[:offset[:size]] [verify]
+ * copies between block devices (or partitions by label) on the device,
+ * without a round trip through the host, e.g. to clone an A/B slot:
+ *	fastboot oem copy-partition boot_a boot_b
+ *	fastboot oem copy-partition userdata:0x1000000:0x800000 userdata:0x2000000
+ * The whole source range is copied, it must fit into the destination range.
+ *
+ * The next chunk is read while the previous one is written. Runs of zeros
+ * are erased instead of written if the destination reads erased blocks
+ * back as zeros. With "verify" the SHA-256 of both ranges is compared.
+ */
+#if WITH_LIB_BIO
+#define COPY_CHUNK_SIZE		(1024 * 1024)
+#define COPY_ZERO_SIZE		(64 * 1024)
+/* size_t is 32-bit, so erase large runs in pieces */
+#define COPY_ERASE_MAX		(1024 * 1024 * 1024)
+
+struct copy_range {
+	bdev_t *dev;
+	off_t offset;
+	off_t size;
+};
+
+struct copy_state {
+	struct copy_range src, dst;
+	off_t done;
+	bool erase;
+
+	/* zeros in the destination that were not erased yet */
+	off_t zero_start;
+	off_t zero_len;
+	off_t erased;
+};
+
+static bool copy_parse_range(struct copy_range *r, char *spec)
+{
+	const char *name, *token;
+	unsigned long long n;
+	char *sp;
+
+	name = strtok_r(spec, ":", &sp);
+	if (!name) {
+		fastboot_fail("no device specified");
+		return false;
+	}
+
+	r->dev = bio_open(name);
+	if (!r->dev)
+		r->dev = bio_open_by_label(name);
+	if (!r->dev) {
+		fastboot_fail("device not found");
+		return false;
+	}
+
+	r->offset = 0;
+	r->size = r->dev->size;
+
+	token = strtok_r(NULL, ":", &sp);
+	if (token) {
+		n = atoull(token);
+		if (n > (unsigned long long)r->size) {
+			fastboot_fail("offset larger than device");
+			return false;
+		}
+		r->offset = n;
+		r->size -= n;
+
+		token = strtok_r(NULL, ":", &sp);
+		if (token) {
+			n = atoull(token);
+			if (n > (unsigned long long)r->size) {
+				fastboot_fail("size larger than remaining device");
+				return false;
+			}
+			r->size = n;
+		}
+	}
+
+	return true;
+}
+
+static bool copy_buf_is_zero(const void *data, unsigned len)
+{
+	const uint32_t *p = data;
+	unsigned i;
+
+	for (i = 0; i < len / sizeof(*p); ++i)
+		if (p[i])
+			return false;
+
+	return true;
+}
+
+static int copy_erase_zeros(struct copy_state *c)
+{
+	off_t offset = c->dst.offset + c->zero_start;
+	size_t n;
+
+	while (c->zero_len) {
+		n = MIN(c->zero_len, COPY_ERASE_MAX);
+		if (bio_erase(c->dst.dev, offset, n) != (ssize_t)n)
+			return -1;
+
+		offset += n;
+		c->zero_len -= n;
+		c->erased += n;
+	}
+
+	return 0;
+}
+
+static bool copy_unit_is_zero(struct copy_state *c, const uint8_t *buf,
+			      unsigned pos, unsigned len)
+{
+	return c->erase && pos + COPY_ZERO_SIZE <= len &&
+	       copy_buf_is_zero(buf + pos, COPY_ZERO_SIZE);
+}
+
+/* Write one chunk at c->done, holding back whole units of zeros */
+static int copy_write_chunk(struct copy_state *c, const uint8_t *buf, unsigned len)
+{
+	unsigned pos = 0, end;
+
+	while (pos < len) {
+		if (copy_unit_is_zero(c, buf, pos, len)) {
+			if (!c->zero_len)
+				c->zero_start = c->done + pos;
+			c->zero_len += COPY_ZERO_SIZE;
+			pos += COPY_ZERO_SIZE;
+			continue;
+		}
+
+		/* Write everything up to the next unit of zeros at once */
+		end = pos;
+		do {
+			end = MIN(end + COPY_ZERO_SIZE, len);
+		} while (end < len && !copy_unit_is_zero(c, buf, end, len));
+
+		if (copy_erase_zeros(c))
+			return -1;
+		if (bio_write(c->dst.dev, buf + pos, c->dst.offset + c->done + pos,
+			      end - pos) != (ssize_t)(end - pos))
+			return -1;
+		pos = end;
+	}
+
+	return 0;
+}
+
+static int copy_data(struct copy_state *c, uint8_t *buf)
+{
+	struct bio_request req[2] = {0};
+	unsigned cur = 0, len = 0;
+	off_t next;
+
+	/* Keep the read of the following chunk queued while writing */
+	req[0].buf = buf;
+	req[0].offset = c->src.offset;
+	req[0].len = MIN(c->src.size, COPY_CHUNK_SIZE);
+	bio_submit(c->src.dev, &req[0], 1);
+	next = req[0].len;
+
+	while (c->done < c->src.size) {
+		len = req[cur].len;
+		if (bio_wait(&req[cur]) != (ssize_t)len) {
+			fastboot_fail("read failed");
+			goto err;
+		}
+
+		if (next < c->src.size) {
+			req[cur ^ 1].buf = buf + (cur ^ 1) * COPY_CHUNK_SIZE;
+			req[cur ^ 1].offset = c->src.offset + next;
+			req[cur ^ 1].len = MIN(c->src.size - next, COPY_CHUNK_SIZE);
+			bio_submit(c->src.dev, &req[cur ^ 1], 1);
+			next += req[cur ^ 1].len;
+		}
+
+		if (copy_write_chunk(c, buf + cur * COPY_CHUNK_SIZE, len)) {
+			fastboot_fail("write failed");
+			goto err;
+		}
+
+		c->done += len;
+		cur ^= 1;
+	}
+
+	if (copy_erase_zeros(c)) {
+		fastboot_fail("erase failed");
+		return -1;
+	}
+
+	return 0;
+
+err:
+	/* The buffer must not be freed while a read is still queued */
+	if (next > c->done + len)
+		bio_wait(&req[cur ^ 1]);
+	return -1;
+}
+
+struct copy_hash {
+	struct copy_range *r;
+	off_t offset;
+};
+
+static int copy_hash_read(void *cookie, unsigned char *buf, unsigned int size)
+{
+	struct copy_hash *h = cookie;
+
+	if (bio_read(h->r->dev, buf, h->r->offset + h->offset, size) != (ssize_t)size)
+		return -1;
+
+	h->offset += size;
+	return 0;
+}
+
+static bool copy_hash(struct copy_range *r, off_t size, uint8_t *buf, uint8_t *digest)
+{
+	struct copy_hash h = { .r = r };
+
+	return hash_find_read(copy_hash_read, &h, size, buf, COPY_CHUNK_SIZE,
+			      digest, CRYPTO_AUTH_ALG_SHA256) == CRYPTO_SHA_ERR_NONE;
+}
+
+static bool copy_verify(struct copy_state *c, uint8_t *buf)
+{
+	uint8_t src[SHA256_INIT_VECTOR_SIZE * sizeof(uint32_t)];
+	uint8_t dst[sizeof(src)];
+
+	target_crypto_init_params();
+	if (!copy_hash(&c->src, c->src.size, buf, src) ||
+	    !copy_hash(&c->dst, c->src.size, buf, dst)) {
+		fastboot_fail("failed to compute hash");
+		return false;
+	}
+
+	if (memcmp(src, dst, sizeof(src))) {
+		fastboot_fail("verification failed");
+		return false;
+	}
+
+	fastboot_info("verified SHA-256");
+	return true;
+}
+
+static void cmd_oem_copy_partition(const char *arg, void *data, unsigned sz)
+{
+	struct copy_state c = {0};
+	char response[MAX_RSP_SIZE];
+	char *src, *dst, *opt, *sp;
+	bool verify = false;
+	time_t start, ms;
+	int ret;
+	uint8_t *buf;
+
+	src = strtok_r((char *)arg, " ", &sp);
+	dst = strtok_r(NULL, " ", &sp);
+	opt = strtok_r(NULL, " ", &sp);
+	if (!src || !dst || (opt && strcmp(opt, "verify"))) {
+		fastboot_fail("usage: fastboot oem copy-partition <src>[:offset[:size]] <dst>[:offset[:size]] [verify]");
+		return;
+	}
+	verify = opt != NULL;
+
+	if (!copy_parse_range(&c.src, src) || !copy_parse_range(&c.dst, dst))
+		goto out;
+
+	if (c.src.size == 0) {
+		fastboot_fail("no data left to copy");
+		goto out;
+	}
+	if (c.src.size > c.dst.size) {
+		fastboot_fail("source larger than destination");
+		goto out;
+	}
+	if (c.src.dev == c.dst.dev && c.src.offset < c.dst.offset + c.src.size &&
+	    c.dst.offset < c.src.offset + c.src.size) {
+		fastboot_fail("source and destination overlap");
+		goto out;
+	}
+
+	/* Erase needs whole blocks, units of zeros start at multiples of their size */
+	c.erase = (c.dst.dev->flags & BIO_FLAG_ERASE_ZEROES) &&
+		  !(c.dst.offset % c.dst.dev->block_size);
+
+	buf = lk2nd_region_alloc("copy", 2 * COPY_CHUNK_SIZE);
+	if (!buf) {
+		fastboot_fail("not enough scratch memory");
+		goto out;
+	}
+
+	start = current_time();
+	ret = copy_data(&c, buf);
+#if WITH_LIB_FS
+	/* Filesystems kept mounted on the destination are stale, even if it failed */
+	fs_invalidate(c.dst.dev->name);
+#endif
+	if (!ret && (!verify || copy_verify(&c, buf))) {
+		ms = current_time() - start;
+		snprintf(response, sizeof(response), "copied %llu KiB (%llu KiB erased) in %lu ms",
+			 c.done / 1024, c.erased / 1024, ms);
+		fastboot_info(response);
+		fastboot_okay("");
+	}
+
+	lk2nd_region_free(buf);
+out:
+	if (c.src.dev)
+		bio_close(c.src.dev);
+	if (c.dst.dev)
+		bio_close(c.dst.dev);
+}
+FASTBOOT_REGISTER("oem copy-partition", cmd_oem_copy_partition);
+#endif
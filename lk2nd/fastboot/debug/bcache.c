@@ -0,0 +1,32 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <fastboot.h>
+#include <lib/bcache.h>
+#include <printf.h>
+
+/* lib/bcache is only pulled in by the file system drivers */
+#if WITH_LIB_BCACHE
+
+static void cmd_oem_debug_bcache(const char *arg, void *data, unsigned sz)
+{
+	char response[MAX_RSP_SIZE];
+	struct bcache_info info;
+	bcache_t cache = NULL;
+	uint32_t finds;
+
+	while ((cache = bcache_next(cache))) {
+		bcache_get_info(cache, &info);
+		finds = info.stats.hits + info.stats.misses;
+
+		snprintf(response, sizeof(response),
+			 "%s: %d x %zu, hits=%u(%u%%) misses=%u reads=%u",
+			 info.name, info.count, info.block_size,
+			 info.stats.hits,
+			 finds ? (info.stats.hits * 100) / finds : 0,
+			 info.stats.misses, info.stats.reads);
+		fastboot_info(response);
+	}
+	fastboot_okay("");
+}
+FASTBOOT_REGISTER("oem debug bcache", cmd_oem_debug_bcache);
+#endif
@@ -0,0 +1,80 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <arch/arm.h>
+#include <arch/defines.h>
+#include <fastboot.h>
+#include <platform.h>
+#include <printf.h>
+#include <stdlib.h>
+#include <string.h>
+#include <target.h>
+
+#include <lk2nd/util/region.h>
+
+/*
+ * Compare the time needed for cleaning the cache line by line with
+ * cleaning the whole cache by set/way, to find a good value for
+ * CACHE_SETWAY_THRESHOLD. The buffer is made dirty before each run.
+ */
+
+#define CACHEBENCH_MIN_SIZE	(64 * 1024)
+#define CACHEBENCH_MAX_SIZE	(64 * 1024 * 1024)
+
+static bigtime_t cachebench_lines(uint8_t *buf, size_t size, bool invalidate)
+{
+	bigtime_t start;
+
+	memset(buf, size, size);
+	start = current_time_hires();
+	if (invalidate)
+		arm_clean_invalidate_cache_lines((addr_t)buf, size);
+	else
+		arm_clean_cache_lines((addr_t)buf, size);
+	return current_time_hires() - start;
+}
+
+static bigtime_t cachebench_all(uint8_t *buf, size_t size, bool invalidate)
+{
+	bigtime_t start;
+
+	memset(buf, size, size);
+	start = current_time_hires();
+	if (invalidate)
+		arm_clean_invalidate_cache_all();
+	else
+		arm_clean_cache_all();
+	return current_time_hires() - start;
+}
+
+static void cmd_oem_debug_cachebench(const char *arg, void *data, unsigned sz)
+{
+	char response[MAX_RSP_SIZE];
+	size_t max = MIN(CACHEBENCH_MAX_SIZE, target_get_max_flash_size());
+	uint8_t *buf;
+	size_t size;
+
+	buf = lk2nd_region_alloc("cachebench", max);
+	if (!buf) {
+		fastboot_fail("not enough scratch memory");
+		return;
+	}
+
+	snprintf(response, sizeof(response), "set/way threshold: %u KiB",
+		 CACHE_SETWAY_THRESHOLD / 1024);
+	fastboot_info(response);
+
+	for (size = CACHEBENCH_MIN_SIZE; size <= max; size *= 2) {
+		snprintf(response, sizeof(response),
+			 "%zu KiB: clean %llu/%llu us, clean+inv %llu/%llu us (line/set-way)",
+			 size / 1024,
+			 cachebench_lines(buf, size, false),
+			 cachebench_all(buf, size, false),
+			 cachebench_lines(buf, size, true),
+			 cachebench_all(buf, size, true));
+		fastboot_info(response);
+	}
+
+	lk2nd_region_free(buf);
+	fastboot_okay("");
+}
+FASTBOOT_REGISTER("oem debug cachebench", cmd_oem_debug_cachebench);
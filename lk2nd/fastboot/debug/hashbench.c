@@ -0,0 +1,113 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <crypto_hash.h>
+#include <fastboot.h>
+#include <platform.h>
+#include <printf.h>
+#include <stdlib.h>
+#include <string.h>
+#include <target.h>
+#if WITH_LIB_OPENSSL
+#include <sha.h>
+#endif
+
+#include <lk2nd/util/region.h>
+
+/*
+ * Compare the SHA-256 throughput of the ARMv8 SHA instructions, the crypto
+ * engine and the software implementation for different buffer sizes.
+ * Small buffers are hashed repeatedly until HASHBENCH_MIN_TOTAL bytes
+ * were processed, so the per-call overhead shows up in the result.
+ */
+
+#define HASHBENCH_MIN_SIZE	(4 * 1024)
+#define HASHBENCH_MAX_SIZE	(16 * 1024 * 1024)
+#define HASHBENCH_MIN_TOTAL	(16 * 1024 * 1024)
+
+enum hashbench_backend {
+	HASHBENCH_CPU,
+	HASHBENCH_ENGINE,
+	HASHBENCH_SW,
+};
+
+static bool hashbench_one(enum hashbench_backend backend, uint8_t *buf,
+			  size_t size, uint8_t *digest)
+{
+	switch (backend) {
+	case HASHBENCH_CPU:
+#if WITH_SHA_ARMV8
+		if (sha_armv8_supported())
+			return hash_find_armv8(buf, size, digest,
+					       CRYPTO_AUTH_ALG_SHA256) == CRYPTO_SHA_ERR_NONE;
+#endif
+		return false;
+	case HASHBENCH_ENGINE:
+		if (board_ce_type() != CRYPTO_ENGINE_TYPE_HW)
+			return false;
+		return hash_find_engine(buf, size, digest,
+					CRYPTO_AUTH_ALG_SHA256) == CRYPTO_SHA_ERR_NONE;
+	case HASHBENCH_SW:
+#if WITH_LIB_OPENSSL
+		SHA256(buf, size, digest);
+		return true;
+#else
+		return false;
+#endif
+	}
+	return false;
+}
+
+/* Returns the throughput in MB/s, 0 if the backend is not available */
+static unsigned hashbench_run(enum hashbench_backend backend, uint8_t *buf,
+			      size_t size, uint8_t *digest)
+{
+	unsigned i, count = MAX(1, HASHBENCH_MIN_TOTAL / size);
+	bigtime_t start, us;
+
+	start = current_time_hires();
+	for (i = 0; i < count; i++)
+		if (!hashbench_one(backend, buf, size, digest))
+			return 0;
+	us = current_time_hires() - start;
+
+	/* bytes/us = MB/s */
+	return us ? (uint64_t)size * count / us : 0;
+}
+
+static void cmd_oem_debug_hashbench(const char *arg, void *data, unsigned sz)
+{
+	char response[MAX_RSP_SIZE];
+	uint8_t digest[3][32];
+	size_t max = MIN(HASHBENCH_MAX_SIZE, target_get_max_flash_size());
+	unsigned cpu, engine, sw;
+	uint8_t *buf;
+	size_t size;
+
+	buf = lk2nd_region_alloc("hashbench", max);
+	if (!buf) {
+		fastboot_fail("not enough scratch memory");
+		return;
+	}
+	memset(buf, 0x5a, max);
+	target_crypto_init_params();
+
+	fastboot_info("SHA-256 in MB/s (cpu/engine/sw), 0 = not available");
+	for (size = HASHBENCH_MIN_SIZE; size <= max; size *= 4) {
+		memset(digest, 0, sizeof(digest));
+		cpu = hashbench_run(HASHBENCH_CPU, buf, size, digest[0]);
+		engine = hashbench_run(HASHBENCH_ENGINE, buf, size, digest[1]);
+		sw = hashbench_run(HASHBENCH_SW, buf, size, digest[2]);
+
+		snprintf(response, sizeof(response), "%zu KiB: %u/%u/%u%s",
+			 size / 1024, cpu, engine, sw,
+			 (cpu && engine && memcmp(digest[0], digest[1], 32)) ||
+			 (cpu && sw && memcmp(digest[0], digest[2], 32)) ||
+			 (engine && sw && memcmp(digest[1], digest[2], 32)) ?
+			 " (digest mismatch!)" : "");
+		fastboot_info(response);
+	}
+
+	lk2nd_region_free(buf);
+	fastboot_okay("");
+}
+FASTBOOT_REGISTER("oem debug hashbench", cmd_oem_debug_hashbench);
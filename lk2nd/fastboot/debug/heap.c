@@ -0,0 +1,59 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <fastboot.h>
+#include <lib/heap.h>
+#include <printf.h>
+
+static void heap_report_stats(void)
+{
+	char response[MAX_RSP_SIZE];
+	struct heap_stats stats;
+
+	heap_get_stats(&stats);
+
+	snprintf(response, sizeof(response),
+		 "size=%zu regions=%u used=%zu peak=%zu cached=%zu",
+		 stats.size, stats.regions, stats.used, stats.peak_used,
+		 stats.cached);
+	fastboot_info(response);
+
+	snprintf(response, sizeof(response),
+		 "free=%zu chunks=%u largest=%zu fragmentation=%u%%",
+		 stats.free, stats.free_chunks, stats.largest_free,
+		 stats.fragmentation);
+	fastboot_info(response);
+}
+
+static void cmd_oem_debug_heap(const char *arg, void *data, unsigned sz)
+{
+	heap_report_stats();
+	fastboot_okay("");
+}
+FASTBOOT_REGISTER("oem debug heap", cmd_oem_debug_heap);
+
+#if HEAP_PROFILE
+/*
+ * The call sites are return addresses, resolve them with
+ * "addr2line -f -e lk" from the same build.
+ */
+static void cmd_oem_heap(const char *arg, void *data, unsigned sz)
+{
+	char response[MAX_RSP_SIZE];
+	struct heap_site sites[32];
+	unsigned int i, n;
+
+	heap_report_stats();
+
+	n = heap_get_sites(sites, countof(sites));
+	fastboot_info("call site: used, peak (at ms), allocations, live");
+	for (i = 0; i < n; i++) {
+		snprintf(response, sizeof(response), "%p: %zu %zu (%lu) %u %u",
+			 sites[i].caller, sites[i].used, sites[i].peak_used,
+			 sites[i].peak_time, sites[i].allocs, sites[i].live);
+		fastboot_info(response);
+	}
+
+	fastboot_okay("");
+}
+FASTBOOT_REGISTER("oem heap", cmd_oem_heap);
+#endif
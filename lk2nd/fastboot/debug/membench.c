@@ -0,0 +1,98 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <fastboot.h>
+#include <platform.h>
+#include <printf.h>
+#include <stdlib.h>
+#include <string.h>
+#include <target.h>
+
+#include <lk2nd/util/region.h>
+
+/*
+ * Measure the bandwidth of the string functions on buffers in the scratch
+ * memory. The default is larger than the caches so that it shows the
+ * throughput to RAM, smaller sizes (in KiB) can be given to look at the
+ * caches instead: "fastboot oem debug membench 16".
+ */
+
+#define MEMBENCH_DEFAULT_SIZE	(8 * 1024 * 1024)
+#define MEMBENCH_TOTAL		(64 * 1024 * 1024)
+
+enum membench_op {
+	MEMBENCH_MEMCPY,
+	MEMBENCH_MEMCPY_UNALIGNED,
+	MEMBENCH_MEMMOVE_OVERLAP,
+	MEMBENCH_MEMSET,
+};
+
+static const char *const membench_names[] = {
+	[MEMBENCH_MEMCPY] = "memcpy",
+	[MEMBENCH_MEMCPY_UNALIGNED] = "memcpy (unaligned)",
+	[MEMBENCH_MEMMOVE_OVERLAP] = "memmove (overlapping)",
+	[MEMBENCH_MEMSET] = "memset",
+};
+
+static void membench_run(enum membench_op op, uint8_t *dst, uint8_t *src,
+			 size_t size)
+{
+	char response[MAX_RSP_SIZE];
+	unsigned loops = MAX(MEMBENCH_TOTAL / size, 1U), i;
+	bigtime_t start, time;
+	uint64_t kib;
+
+	start = current_time_hires();
+	for (i = 0; i < loops; i++) {
+		switch (op) {
+		case MEMBENCH_MEMCPY:
+			memcpy(dst, src, size);
+			break;
+		case MEMBENCH_MEMCPY_UNALIGNED:
+			memcpy(dst + 1, src + 3, size - 3);
+			break;
+		case MEMBENCH_MEMMOVE_OVERLAP:
+			memmove(src + 64, src, size - 64);
+			break;
+		case MEMBENCH_MEMSET:
+			memset(dst, i, size);
+			break;
+		}
+	}
+	time = current_time_hires() - start;
+
+	kib = (uint64_t)loops * size / 1024;
+	snprintf(response, sizeof(response), "%s: %llu KiB in %llu us, %llu MiB/s",
+		 membench_names[op], kib, time,
+		 time ? kib * 1000000 / 1024 / time : 0);
+	fastboot_info(response);
+}
+
+static void cmd_oem_debug_membench(const char *arg, void *data, unsigned sz)
+{
+	size_t size = MEMBENCH_DEFAULT_SIZE;
+	uint8_t *scratch;
+	unsigned op;
+
+	while (*arg == ' ')
+		arg++;
+	if (*arg)
+		size = atoi(arg) * 1024;
+	if (size < 1024 || 2 * size > target_get_max_flash_size()) {
+		fastboot_fail("invalid size");
+		return;
+	}
+
+	scratch = lk2nd_region_alloc("membench", 2 * size);
+	if (!scratch) {
+		fastboot_fail("not enough scratch memory");
+		return;
+	}
+
+	memset(scratch, 0x5a, 2 * size);
+	for (op = 0; op < countof(membench_names); op++)
+		membench_run(op, scratch + size, scratch, size);
+
+	lk2nd_region_free(scratch);
+	fastboot_okay("");
+}
+FASTBOOT_REGISTER("oem debug membench", cmd_oem_debug_membench);
@@ -0,0 +1,22 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <arch/arm/mmu.h>
+#include <fastboot.h>
+#include <printf.h>
+
+static void print_mapping(const struct arm_mmu_mapping *map, void *data)
+{
+	char response[MAX_RSP_SIZE];
+
+	snprintf(response, sizeof(response), "%#08lx -> %#08lx (size: %#x) %s %#x",
+		 map->vaddr, map->paddr, map->size,
+		 map->supersection ? "16M" : "1M", map->flags);
+	fastboot_info(response);
+}
+
+static void cmd_oem_debug_mmu(const char *arg, void *data, unsigned sz)
+{
+	arm_mmu_walk_mappings(print_mapping, NULL);
+	fastboot_okay("");
+}
+FASTBOOT_REGISTER("oem debug mmu", cmd_oem_debug_mmu);
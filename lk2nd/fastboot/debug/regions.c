@@ -0,0 +1,28 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <fastboot.h>
+#include <printf.h>
+#include <target.h>
+
+#include <lk2nd/util/region.h>
+
+static void cmd_oem_debug_regions(const char *arg, void *data, unsigned sz)
+{
+	char response[MAX_RSP_SIZE];
+	const struct lk2nd_region *regions;
+	unsigned int count, i;
+
+	snprintf(response, sizeof(response), "scratch: %p (size: %#x)",
+		 target_get_scratch_address(), target_get_max_flash_size());
+	fastboot_info(response);
+
+	regions = lk2nd_region_list(&count);
+	for (i = 0; i < count; i++) {
+		snprintf(response, sizeof(response), "%s: %#08lx (size: %#zx)",
+			 regions[i].name, regions[i].start, regions[i].size);
+		fastboot_info(response);
+	}
+
+	fastboot_okay("");
+}
+FASTBOOT_REGISTER("oem debug regions", cmd_oem_debug_regions);
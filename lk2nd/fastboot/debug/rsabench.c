@@ -0,0 +1,227 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+#if WITH_LIB_OPENSSL
+#include <bn.h>
+#include <fastboot.h>
+#include <limits.h>
+#include <platform.h>
+#include <printf.h>
+#include <rand.h>
+#include <stdlib.h>
+#include <string.h>
+#if WITH_MONT_ARM
+#include <mont_arm.h>
+#endif
+
+/*
+ * Compare the time for the public key operation of RSA verification
+ * (m^65537 mod n) with the Montgomery multiplication of libavb in C, with
+ * UMAAL (mont-arm.S) and with the OpenSSL bignum code used by the boot
+ * image verification. A random odd modulus is good enough for timing, the
+ * results are compared to make sure all of them compute the same thing.
+ */
+
+#define RSABENCH_RUNS	16
+
+struct rsabench_key {
+	unsigned len;
+	uint32_t n0inv;
+	uint32_t *n;
+	uint32_t *rr;
+};
+
+typedef uint32_t (*rsabench_mul_add_t)(uint32_t *c, uint32_t a, const uint32_t *b,
+				       const uint32_t *n, uint32_t n0inv, uint32_t len);
+
+/* Same as montMulAdd() in avb_rsa.c */
+static uint32_t rsabench_mul_add_c(uint32_t *c, uint32_t a, const uint32_t *b,
+				   const uint32_t *n, uint32_t n0inv, uint32_t len)
+{
+	uint64_t A = (uint64_t)a * b[0] + c[0];
+	uint32_t d0 = (uint32_t)A * n0inv;
+	uint64_t B = (uint64_t)d0 * n[0] + (uint32_t)A;
+	uint32_t i;
+
+	for (i = 1; i < len; ++i) {
+		A = (A >> 32) + (uint64_t)a * b[i] + c[i];
+		B = (B >> 32) + (uint64_t)d0 * n[i] + (uint32_t)A;
+		c[i - 1] = (uint32_t)B;
+	}
+
+	A = (A >> 32) + (B >> 32);
+	c[i - 1] = (uint32_t)A;
+	return A >> 32;
+}
+
+static void rsabench_sub(const struct rsabench_key *key, uint32_t *a)
+{
+	int64_t A = 0;
+	unsigned i;
+
+	for (i = 0; i < key->len; ++i) {
+		A += (uint64_t)a[i] - key->n[i];
+		a[i] = (uint32_t)A;
+		A >>= 32;
+	}
+}
+
+static void rsabench_mul(const struct rsabench_key *key, rsabench_mul_add_t mul_add,
+			 uint32_t *c, const uint32_t *a, const uint32_t *b)
+{
+	unsigned i;
+
+	memset(c, 0, key->len * sizeof(*c));
+	for (i = 0; i < key->len; ++i)
+		if (mul_add(c, a[i], b, key->n, key->n0inv, key->len))
+			rsabench_sub(key, c);
+}
+
+/* Same as modpowF4() in avb_rsa.c, on little endian word arrays */
+static void rsabench_modpow(const struct rsabench_key *key, rsabench_mul_add_t mul_add,
+			    uint32_t *out, const uint32_t *a, uint32_t *tmp)
+{
+	unsigned i;
+
+	rsabench_mul(key, mul_add, tmp, a, key->rr);
+	for (i = 0; i < 16; i += 2) {
+		rsabench_mul(key, mul_add, out, tmp, tmp);
+		rsabench_mul(key, mul_add, tmp, out, out);
+	}
+	rsabench_mul(key, mul_add, out, tmp, a);
+
+	/* out is at most n too large */
+	for (i = key->len; i--;)
+		if (out[i] != key->n[i])
+			break;
+	if (i == UINT_MAX || out[i] > key->n[i])
+		rsabench_sub(key, out);
+}
+
+static void rsabench_to_words(const BIGNUM *bn, uint32_t *words, unsigned len,
+			      uint8_t *bytes)
+{
+	unsigned i, size = len * 4;
+	int n = BN_num_bytes(bn);
+
+	memset(bytes, 0, size);
+	BN_bn2bin(bn, bytes + size - n);
+	for (i = 0; i < len; i++)
+		words[i] = bytes[size - 4 * i - 4] << 24 | bytes[size - 4 * i - 3] << 16 |
+			   bytes[size - 4 * i - 2] << 8 | bytes[size - 4 * i - 1];
+}
+
+static BIGNUM *rsabench_random(uint8_t *bytes, unsigned size, bool modulus)
+{
+	unsigned i;
+
+	for (i = 0; i < size; i++)
+		bytes[i] = rand();
+	if (modulus) {
+		bytes[0] |= 0x80;
+		bytes[size - 1] |= 1;
+	} else {
+		bytes[0] &= 0x7f;
+	}
+	return BN_bin2bn(bytes, size, NULL);
+}
+
+static bigtime_t rsabench_mont(const struct rsabench_key *key, rsabench_mul_add_t mul_add,
+			       uint32_t *out, const uint32_t *a, uint32_t *tmp)
+{
+	bigtime_t start = current_time_hires();
+	int i;
+
+	for (i = 0; i < RSABENCH_RUNS; i++)
+		rsabench_modpow(key, mul_add, out, a, tmp);
+	return (current_time_hires() - start) / RSABENCH_RUNS;
+}
+
+static bool rsabench_bits(unsigned bits)
+{
+	char response[MAX_RSP_SIZE];
+	struct rsabench_key key = { .len = bits / 32 };
+	unsigned size = bits / 8;
+	bigtime_t us_c, us_arm = 0, us_ssl, start;
+	BIGNUM *n, *m, *e, *r, *rr;
+	uint32_t *buf, *a, *out, *tmp, *ref, inv;
+	uint8_t *bytes;
+	BN_CTX *ctx;
+	bool ok = false, match;
+	int i;
+
+	ctx = BN_CTX_new();
+	bytes = malloc(size);
+	buf = malloc(6 * key.len * sizeof(uint32_t));
+	n = m = e = r = rr = NULL;
+	if (!ctx || !bytes || !buf)
+		goto out;
+
+	key.n = buf;
+	key.rr = buf + key.len;
+	a = buf + 2 * key.len;
+	out = buf + 3 * key.len;
+	tmp = buf + 4 * key.len;
+	ref = buf + 5 * key.len;
+
+	n = rsabench_random(bytes, size, true);
+	m = rsabench_random(bytes, size, false);
+	e = BN_new();
+	r = BN_new();
+	rr = BN_new();
+	if (!n || !m || !e || !r || !rr || !BN_set_word(e, 65537) ||
+	    !BN_set_word(rr, 1) || !BN_lshift(rr, rr, 2 * bits) ||
+	    !BN_mod(rr, rr, n, ctx))
+		goto out;
+
+	rsabench_to_words(n, key.n, key.len, bytes);
+	rsabench_to_words(rr, key.rr, key.len, bytes);
+	rsabench_to_words(m, a, key.len, bytes);
+
+	/* n0inv = -1 / n[0] mod 2^32, each Newton step doubles the valid bits */
+	inv = key.n[0];
+	for (i = 0; i < 4; i++)
+		inv *= 2 - key.n[0] * inv;
+	key.n0inv = -inv;
+
+	start = current_time_hires();
+	for (i = 0; i < RSABENCH_RUNS; i++)
+		BN_mod_exp_mont(r, m, e, n, ctx, NULL);
+	us_ssl = (current_time_hires() - start) / RSABENCH_RUNS;
+	rsabench_to_words(r, ref, key.len, bytes);
+
+	us_c = rsabench_mont(&key, rsabench_mul_add_c, out, a, tmp);
+	match = !memcmp(out, ref, key.len * sizeof(uint32_t));
+#if WITH_MONT_ARM
+	us_arm = rsabench_mont(&key, mont_mul_add_arm, out, a, tmp);
+	match = match && !memcmp(out, ref, key.len * sizeof(uint32_t));
+#endif
+
+	snprintf(response, sizeof(response),
+		 "%u bit: c %llu us, umaal %llu us, openssl %llu us%s",
+		 bits, us_c, us_arm, us_ssl, match ? "" : " (result mismatch!)");
+	fastboot_info(response);
+	ok = true;
+
+out:
+	BN_free(rr);
+	BN_free(r);
+	BN_free(e);
+	BN_free(m);
+	BN_free(n);
+	free(buf);
+	free(bytes);
+	if (ctx)
+		BN_CTX_free(ctx);
+	return ok;
+}
+
+static void cmd_oem_debug_rsabench(const char *arg, void *data, unsigned sz)
+{
+	if (!rsabench_bits(2048) || !rsabench_bits(4096)) {
+		fastboot_fail("out of memory");
+		return;
+	}
+	fastboot_okay("");
+}
+FASTBOOT_REGISTER("oem debug rsabench", cmd_oem_debug_rsabench);
+#endif
@@ -2,8 +2,23 @@
 LOCAL_DIR := $(GET_LOCAL_DIR)
 
 OBJS += \
+	$(LOCAL_DIR)/bcache.o \
+	$(LOCAL_DIR)/cachebench.o \
 	$(LOCAL_DIR)/cpuid.o \
+	$(LOCAL_DIR)/hashbench.o \
+	$(LOCAL_DIR)/heap.o \
+	$(LOCAL_DIR)/membench.o \
+	$(LOCAL_DIR)/regions.o \
 	$(LOCAL_DIR)/register.o \
+	$(LOCAL_DIR)/rsabench.o \
+	$(LOCAL_DIR)/threads.o \
+
+ifneq ($(ENABLE_LPAE_SUPPORT),1)
+OBJS += $(LOCAL_DIR)/mmu.o
+endif
+
+# Per-thread runtime and context switch statistics for "oem debug threads"
+DEFINES += THREAD_STATS=1
 
 # Currently the regulator fastboot debug code is only used for SPMI regulators
 ifneq ($(filter dev/pmic/pm8x41, $(ALLMODULES)),)
@@ -0,0 +1,17 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <fastboot.h>
+#include <kernel/thread.h>
+
+/*
+ * The output of dump_all_threads() goes to the log, where it can be read with
+ * "fastboot oem log" (or on the serial console). With THREAD_STATS it shows
+ * the time each thread has been running and how often it was switched to.
+ */
+static void cmd_oem_debug_threads(const char *arg, void *data, unsigned sz)
+{
+	dump_all_threads();
+	fastboot_info("Thread list written to the log");
+	fastboot_okay("");
+}
+FASTBOOT_REGISTER("oem debug threads", cmd_oem_debug_threads);
@@ -1,18 +1,77 @@
 // SPDX-License-Identifier: BSD-3-Clause
 /* Copyright (c) 2022, Stephan Gerhold <stephan@gerhold.net> */
 
+#include <list.h>
+#include <printf.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include <dev/flash.h>
 #include <fastboot.h>
 #include <lib/ptable.h>
+#include <mmc.h>
 #include <partition_parser.h>
+#include <sparse_format.h>
 #include <target.h>
 
+/*
+ * On eMMC, fetch: streams the data: the next chunk is read from the card
+ * while the previous one is sent, so the size is only limited by the 32-bit
+ * length of the fastboot data phase. Everything else is read into the
+ * download buffer first.
+ */
+#define FETCH_STREAM_MAX_SIZE	0xfffff000
+
 extern char max_download_size[MAX_RSP_SIZE];
+static char max_fetch_size[MAX_RSP_SIZE];
+
+struct fetch_stream {
+	struct fastboot_stream stream;
+	uint64_t offset;
+};
+
+/*
+ * oem fetch-sparse produces an Android sparse image of a partition, with
+ * blocks of zeros replaced by fill chunks. The size of the fastboot data
+ * phase must be known in advance, so the partition is scanned once for
+ * zero blocks by the oem command and read again by the following upload.
+ */
+#define FETCH_SPARSE_SCAN_SIZE		(1024 * 1024)
+#define FETCH_SPARSE_BOUNCE_SIZE	(256 * 1024)
+#define FETCH_SPARSE_BLOCK_SIZE		4096
+
+struct fetch_sparse {
+	struct fastboot_stream stream;
+	uint64_t offset;
+	uint32_t blk_sz;
+	uint32_t blocks;
+
+	/* one bit per block, set if the block only contains zeros */
+	uint32_t *zero;
+
+	/* next block without a chunk header yet */
+	uint32_t block;
+
+	/* header waiting to be sent, may be split between two chunks */
+	union {
+		sparse_header_t file;
+		struct {
+			chunk_header_t chunk;
+			uint32_t fill_val;
+		};
+		uint8_t bytes[sizeof(sparse_header_t)];
+	} hdr;
+	unsigned hdr_len, hdr_pos;
+
+	/* raw data of the current chunk, read through the bounce buffer */
+	uint8_t *bounce;
+	uint64_t raw_offset;
+	uint32_t raw_left;
+	unsigned bounce_len, bounce_pos;
+};
 
-static bool cmd_fetch_parse_args(uint64_t *offset, uint64_t *size, char **sp)
+static bool cmd_fetch_parse_args(uint64_t *offset, uint64_t *size, char **sp,
+				 uint64_t max_size)
 {
 	const char *token = strtok_r(NULL, ":", sp);
 	unsigned long n;
@@ -41,7 +100,7 @@ static bool cmd_fetch_parse_args(uint64_t *offset, uint64_t *size, char **sp)
 		fastboot_fail("no data left to fetch");
 		return false;
 	}
-	if (*size > target_get_max_flash_size()) {
+	if (*size > max_size) {
 		fastboot_fail("partition too large");
 		return false;
 	}
@@ -58,7 +117,8 @@ static unsigned cmd_fetch_read_mmc(const char *pname, void *data, char **sp)
 		return 0;
 	}
 
-	if (!cmd_fetch_parse_args(&part.offset, &part.size, sp))
+	if (!cmd_fetch_parse_args(&part.offset, &part.size, sp,
+				  target_get_max_flash_size()))
 		return 0;
 
 	if (mmc_read(part.offset, data, part.size)) {
@@ -88,7 +148,7 @@ static unsigned cmd_fetch_read_flash(const char *pname, void *data, char **sp)
 	}
 
 	size = ptn->length * flash_block_size();
-	if (!cmd_fetch_parse_args(&offset, &size, sp))
+	if (!cmd_fetch_parse_args(&offset, &size, sp, target_get_max_flash_size()))
 		return 0;
 
 	if (flash_read(ptn, offset, data, size)) {
@@ -111,13 +171,306 @@ static unsigned cmd_fetch_read(const char *arg, void *data)
 		return cmd_fetch_read_flash(pname, data, &sp);
 }
 
+static int fetch_stream_read(struct fastboot_stream *stream, void *data, unsigned len)
+{
+	struct fetch_stream *fs = containerof(stream, struct fetch_stream, stream);
+
+	/* The chunks are block aligned, only the last one may be rounded up */
+	if (mmc_read(fs->offset, data, ROUNDUP(len, mmc_get_device_blocksize())))
+		return -1;
+
+	fs->offset += len;
+	return 0;
+}
+
+static void fetch_stream_end(struct fastboot_stream *stream, int status)
+{
+	if (status)
+		fastboot_fail("failed to read partition");
+	else
+		fastboot_okay("");
+}
+
+static void cmd_fetch_stream_mmc(const char *arg)
+{
+	static struct fetch_stream fs = {
+		.stream = {
+			.read = fetch_stream_read,
+			.end = fetch_stream_end,
+		},
+	};
+	struct partition_info part;
+	const char *pname;
+	char *sp;
+
+	pname = strtok_r((char *)arg, ":", &sp);
+	part = partition_get_info(pname);
+	if (!part.offset) {
+		fastboot_fail("partition not found");
+		return;
+	}
+
+	if (!cmd_fetch_parse_args(&part.offset, &part.size, &sp, FETCH_STREAM_MAX_SIZE))
+		return;
+
+	if (part.offset % mmc_get_device_blocksize()) {
+		fastboot_fail("offset not aligned to block size");
+		return;
+	}
+
+	fs.offset = part.offset;
+	fastboot_write_data_stream(&fs.stream, part.size);
+}
+
 static void cmd_fetch(const char *arg, void *data, unsigned sz)
 {
+	if (target_is_emmc_boot()) {
+		cmd_fetch_stream_mmc(arg);
+		return;
+	}
+
 	sz = cmd_fetch_read(arg, data);
 	if (sz)
 		fastboot_write_data(data, sz);
 }
 
+static inline bool fetch_sparse_is_zero(struct fetch_sparse *fsp, uint32_t block)
+{
+	return fsp->zero[block / 32] & (1U << (block % 32));
+}
+
+/* Return the number of blocks at block with the same zero state */
+static uint32_t fetch_sparse_run(struct fetch_sparse *fsp, uint32_t block)
+{
+	bool zero = fetch_sparse_is_zero(fsp, block);
+	uint32_t end = block + 1;
+
+	while (end < fsp->blocks && fetch_sparse_is_zero(fsp, end) == zero)
+		++end;
+
+	return end - block;
+}
+
+static bool fetch_sparse_buf_is_zero(const void *data, unsigned len)
+{
+	const uint32_t *p = data;
+	unsigned i;
+
+	for (i = 0; i < len / sizeof(*p); ++i)
+		if (p[i])
+			return false;
+
+	return true;
+}
+
+static void fetch_sparse_free(struct fetch_sparse *fsp)
+{
+	free(fsp->zero);
+	free(fsp->bounce);
+	fsp->zero = NULL;
+	fsp->bounce = NULL;
+}
+
+static int fetch_sparse_scan(struct fetch_sparse *fsp, uint8_t *data)
+{
+	uint64_t offset = fsp->offset;
+	uint32_t block = 0, n, i;
+
+	while (block < fsp->blocks) {
+		n = MIN(fsp->blocks - block, FETCH_SPARSE_SCAN_SIZE / fsp->blk_sz);
+		if (mmc_read(offset, (uint32_t *)data, n * fsp->blk_sz))
+			return -1;
+
+		for (i = 0; i < n; ++i, ++block)
+			if (fetch_sparse_buf_is_zero(data + i * fsp->blk_sz, fsp->blk_sz))
+				fsp->zero[block / 32] |= 1U << (block % 32);
+
+		offset += (uint64_t)n * fsp->blk_sz;
+	}
+
+	return 0;
+}
+
+/* Return the size of the sparse image, or 0 if it would be too large */
+static uint32_t fetch_sparse_size(struct fetch_sparse *fsp, uint32_t *chunks)
+{
+	uint64_t size = sizeof(sparse_header_t);
+	uint32_t block, run;
+
+	*chunks = 0;
+	for (block = 0; block < fsp->blocks; block += run) {
+		run = fetch_sparse_run(fsp, block);
+		if (fetch_sparse_is_zero(fsp, block))
+			size += sizeof(chunk_header_t) + sizeof(uint32_t);
+		else
+			size += sizeof(chunk_header_t) + (uint64_t)run * fsp->blk_sz;
+		++*chunks;
+	}
+
+	if (size > FETCH_STREAM_MAX_SIZE)
+		return 0;
+	return size;
+}
+
+static void fetch_sparse_next_chunk(struct fetch_sparse *fsp)
+{
+	uint32_t run = fetch_sparse_run(fsp, fsp->block);
+
+	fsp->hdr.chunk.reserved1 = 0;
+	fsp->hdr.chunk.chunk_sz = run;
+	if (fetch_sparse_is_zero(fsp, fsp->block)) {
+		fsp->hdr.chunk.chunk_type = CHUNK_TYPE_FILL;
+		fsp->hdr.chunk.total_sz = sizeof(chunk_header_t) + sizeof(uint32_t);
+		fsp->hdr.fill_val = 0;
+		fsp->hdr_len = sizeof(chunk_header_t) + sizeof(uint32_t);
+	} else {
+		fsp->hdr.chunk.chunk_type = CHUNK_TYPE_RAW;
+		fsp->hdr.chunk.total_sz = sizeof(chunk_header_t) + run * fsp->blk_sz;
+		fsp->raw_offset = fsp->offset + (uint64_t)fsp->block * fsp->blk_sz;
+		fsp->raw_left = run * fsp->blk_sz;
+		fsp->hdr_len = sizeof(chunk_header_t);
+	}
+	fsp->hdr_pos = 0;
+	fsp->block += run;
+}
+
+static int fetch_sparse_read(struct fastboot_stream *stream, void *data, unsigned len)
+{
+	struct fetch_sparse *fsp = containerof(stream, struct fetch_sparse, stream);
+	uint8_t *out = data;
+	unsigned n;
+
+	while (len) {
+		if (fsp->hdr_pos < fsp->hdr_len) {
+			n = MIN(len, fsp->hdr_len - fsp->hdr_pos);
+			memcpy(out, fsp->hdr.bytes + fsp->hdr_pos, n);
+			fsp->hdr_pos += n;
+		} else if (fsp->bounce_pos < fsp->bounce_len) {
+			n = MIN(len, fsp->bounce_len - fsp->bounce_pos);
+			memcpy(out, fsp->bounce + fsp->bounce_pos, n);
+			fsp->bounce_pos += n;
+		} else if (fsp->raw_left) {
+			/* The output is not block aligned due to the headers */
+			n = MIN(fsp->raw_left, FETCH_SPARSE_BOUNCE_SIZE);
+			if (mmc_read(fsp->raw_offset, (uint32_t *)fsp->bounce, n))
+				return -1;
+			fsp->raw_offset += n;
+			fsp->raw_left -= n;
+			fsp->bounce_len = n;
+			fsp->bounce_pos = 0;
+			continue;
+		} else if (fsp->block < fsp->blocks) {
+			fetch_sparse_next_chunk(fsp);
+			continue;
+		} else {
+			return -1;
+		}
+
+		out += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+static void fetch_sparse_end(struct fastboot_stream *stream, int status)
+{
+	struct fetch_sparse *fsp = containerof(stream, struct fetch_sparse, stream);
+
+	fetch_sparse_free(fsp);
+	fetch_stream_end(stream, status);
+}
+
+static void fetch_sparse_cancel(struct fastboot_stream *stream)
+{
+	fetch_sparse_free(containerof(stream, struct fetch_sparse, stream));
+}
+
+static void cmd_oem_fetch_sparse(const char *arg, void *data, unsigned sz)
+{
+	static struct fetch_sparse fsp = {
+		.stream = {
+			.read = fetch_sparse_read,
+			.end = fetch_sparse_end,
+			.cancel = fetch_sparse_cancel,
+		},
+	};
+	uint32_t bsize = mmc_get_device_blocksize();
+	struct partition_info part;
+	const char *pname;
+	uint32_t chunks;
+	char *sp;
+
+	if (!target_is_emmc_boot()) {
+		fastboot_fail("only supported on eMMC");
+		return;
+	}
+
+	pname = strtok_r((char *)arg, ":", &sp);
+	if (!pname) {
+		fastboot_fail("usage: fastboot oem fetch-sparse <partition>[:offset:size]");
+		return;
+	}
+
+	part = partition_get_info(pname);
+	if (!part.offset) {
+		fastboot_fail("partition not found");
+		return;
+	}
+
+	if (!cmd_fetch_parse_args(&part.offset, &part.size, &sp, UINT32_MAX * 512ULL))
+		return;
+
+	if (part.offset % bsize || part.size % bsize) {
+		fastboot_fail("offset or size not aligned to block size");
+		return;
+	}
+
+	fsp.offset = part.offset;
+	fsp.blk_sz = part.size % FETCH_SPARSE_BLOCK_SIZE ? bsize : FETCH_SPARSE_BLOCK_SIZE;
+	fsp.blocks = part.size / fsp.blk_sz;
+	fsp.zero = calloc(ROUNDUP(fsp.blocks, 32) / 32, sizeof(uint32_t));
+	fsp.bounce = memalign(CACHE_LINE, FETCH_SPARSE_BOUNCE_SIZE);
+	if (!fsp.zero || !fsp.bounce) {
+		fetch_sparse_free(&fsp);
+		fastboot_fail("out of memory");
+		return;
+	}
+
+	if (fetch_sparse_scan(&fsp, data)) {
+		fetch_sparse_free(&fsp);
+		fastboot_fail("failed to read partition");
+		return;
+	}
+
+	sz = fetch_sparse_size(&fsp, &chunks);
+	if (!sz) {
+		fetch_sparse_free(&fsp);
+		fastboot_fail("sparse image too large");
+		return;
+	}
+
+	fsp.hdr.file = (sparse_header_t) {
+		.magic = SPARSE_HEADER_MAGIC,
+		.major_version = 1,
+		.minor_version = 0,
+		.file_hdr_sz = sizeof(sparse_header_t),
+		.chunk_hdr_sz = sizeof(chunk_header_t),
+		.blk_sz = fsp.blk_sz,
+		.total_blks = fsp.blocks,
+		.total_chunks = chunks,
+		.image_checksum = 0,
+	};
+	fsp.hdr_len = sizeof(sparse_header_t);
+	fsp.hdr_pos = 0;
+	fsp.block = 0;
+	fsp.raw_left = 0;
+	fsp.bounce_len = fsp.bounce_pos = 0;
+
+	fastboot_stream_upload(&fsp.stream, sz);
+	fastboot_okay("");
+}
+
 static void cmd_oem_read_partition(const char *arg, void *data, unsigned sz)
 {
 	sz = cmd_fetch_read(arg, data);
@@ -127,8 +480,15 @@ static void cmd_oem_read_partition(const char *arg, void *data, unsigned sz)
 
 static void lk2nd_fastboot_register_fetch(void)
 {
-	fastboot_publish("max-fetch-size", max_download_size);
+	if (target_is_emmc_boot()) {
+		snprintf(max_fetch_size, sizeof(max_fetch_size), "0x%x",
+			 FETCH_STREAM_MAX_SIZE);
+		fastboot_publish("max-fetch-size", max_fetch_size);
+	} else {
+		fastboot_publish("max-fetch-size", max_download_size);
+	}
 	fastboot_register("oem read-partition", cmd_oem_read_partition);
+	fastboot_register("oem fetch-sparse", cmd_oem_fetch_sparse);
 	fastboot_register("fetch:", cmd_fetch);
 }
 FASTBOOT_INIT(lk2nd_fastboot_register_fetch);
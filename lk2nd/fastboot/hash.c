@@ -4,9 +4,14 @@
 #include <crypto_hash.h>
 #include <debug.h>
 #include <fastboot.h>
+#include <lib/bio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <target.h>
 
+/* Two buffers of this size are used to read while the other one is hashed */
+#define HASH_BDEV_CHUNK_SIZE	(256 * 1024)
+
 static void buf2hex(const uint8_t *buf, unsigned size, char *out)
 {
 	static const char hex[] = "0123456789abcdef";
@@ -19,6 +24,121 @@ static void buf2hex(const uint8_t *buf, unsigned size, char *out)
 	*out = 0;
 }
 
+#if WITH_LIB_BIO
+static bdev_t *hash_bdev_open(const char *name)
+{
+	bdev_t *dev = bio_open(name);
+
+	/* Allow partitions to be specified by their label */
+	return dev ? dev : bio_open_by_label(name);
+}
+
+static bool hash_bdev_parse_range(off_t *offset, off_t *size, char **sp)
+{
+	const char *token = strtok_r(NULL, ":", sp);
+	unsigned long long n;
+
+	if (token) {
+		n = atoull(token);
+		if (n > (unsigned long long)*size) {
+			fastboot_fail("offset larger than device");
+			return false;
+		}
+		*offset = n;
+		*size -= n;
+
+		token = strtok_r(NULL, ":", sp);
+		if (token) {
+			n = atoull(token);
+			if (n > (unsigned long long)*size) {
+				fastboot_fail("size larger than remaining device");
+				return false;
+			}
+			*size = n;
+		}
+	}
+
+	if (*size == 0) {
+		fastboot_fail("no data left to hash");
+		return false;
+	}
+
+	return true;
+}
+
+struct hash_bdev {
+	bdev_t *dev;
+	off_t offset;
+};
+
+static int hash_bdev_read(void *cookie, unsigned char *buf, unsigned int size)
+{
+	struct hash_bdev *hb = cookie;
+
+	if (bio_read(hb->dev, buf, hb->offset, size) != (ssize_t)size)
+		return -1;
+
+	hb->offset += size;
+	return 0;
+}
+
+static bool hash_target(crypto_auth_alg_type alg, char *spec, uint8_t *digest)
+{
+	struct hash_bdev hb;
+	crypto_result_type ret;
+	off_t offset = 0, size;
+	const char *name;
+	uint8_t *buf;
+	bdev_t *dev;
+	bool ok;
+	char *sp;
+
+	name = strtok_r(spec, ":", &sp);
+	if (!name) {
+		fastboot_fail("no device specified");
+		return false;
+	}
+
+	dev = hash_bdev_open(name);
+	if (!dev) {
+		fastboot_fail("device not found");
+		return false;
+	}
+
+	size = dev->size;
+	if (!hash_bdev_parse_range(&offset, &size, &sp)) {
+		bio_close(dev);
+		return false;
+	}
+
+	buf = memalign(CACHE_LINE, 2 * HASH_BDEV_CHUNK_SIZE);
+	if (!buf) {
+		bio_close(dev);
+		fastboot_fail("out of memory");
+		return false;
+	}
+
+	hb.dev = dev;
+	hb.offset = offset;
+	target_crypto_init_params();
+	ret = hash_find_read(hash_bdev_read, &hb, size, buf, HASH_BDEV_CHUNK_SIZE,
+			     digest, alg);
+	ok = (ret == CRYPTO_SHA_ERR_NONE);
+	if (!ok)
+		fastboot_fail("failed to compute hash");
+
+	free(buf);
+	bio_close(dev);
+	return ok;
+}
+#else
+static bool hash_target(crypto_auth_alg_type alg, char *spec, uint8_t *digest)
+{
+	fastboot_fail("block devices are not supported");
+	return false;
+}
+#endif
+
 static void cmd_oem_hash(const char *arg, void *data, unsigned sz)
 {
 	/* Two chars per byte for hexadecimal and null terminator */
@@ -26,27 +146,38 @@ static void cmd_oem_hash(const char *arg, void *data, unsigned sz)
 	uint32_t digest[SHA256_INIT_VECTOR_SIZE];
 	crypto_auth_alg_type alg;
 	unsigned digest_size;
+	char *spec = NULL;
+	char *sp;
+
+	arg = strtok_r((char *)arg, " ", &sp);
+	if (arg)
+		spec = strtok_r(NULL, " ", &sp);
 
-	if (strcmp(arg, "sha1") == 0) {
+	if (arg && strcmp(arg, "sha1") == 0) {
 		alg = CRYPTO_AUTH_ALG_SHA1;
 		digest_size = SHA1_INIT_VECTOR_SIZE * sizeof(digest[0]);
-	} else if (strcmp(arg, "sha256") == 0) {
+	} else if (arg && strcmp(arg, "sha256") == 0) {
 		alg = CRYPTO_AUTH_ALG_SHA256;
 		digest_size = SHA256_INIT_VECTOR_SIZE * sizeof(digest[0]);
 	} else {
-		fastboot_fail("usage: fastboot oem hash <sha1|sha256>");
+		fastboot_fail("usage: fastboot oem hash <sha1|sha256> [<bdev|partition>[:offset:size]]");
 		return;
 	}
 
-	if (!sz) {
-		fastboot_fail("no data staged to hash");
-		return;
-	}
+	if (spec) {
+		if (!hash_target(alg, spec, (void *)digest))
+			return;
+	} else {
+		if (!sz) {
+			fastboot_fail("no data staged to hash");
+			return;
+		}
 
-	target_crypto_init_params();
-	if (hash_find(data, sz, (void *)digest, alg) != CRYPTO_SHA_ERR_NONE) {
-		fastboot_fail("failed to compute hash");
-		return;
+		target_crypto_init_params();
+		if (hash_find(data, sz, (void *)digest, alg) != CRYPTO_SHA_ERR_NONE) {
+			fastboot_fail("failed to compute hash");
+			return;
+		}
 	}
 
 	buf2hex((void *)digest, digest_size, response);
@@ -54,3 +185,21 @@ static void cmd_oem_hash(const char *arg, void *data, unsigned sz)
 	fastboot_okay("");
 }
 FASTBOOT_REGISTER("oem hash", cmd_oem_hash);
+
+static void cmd_oem_hash_download(const char *arg, void *data, unsigned sz)
+{
+	while (*arg == ' ')
+		arg++;
+
+	if (!strcmp(arg, "on")) {
+		target_crypto_init_params();
+		fastboot_download_hash(true);
+	} else if (!strcmp(arg, "off")) {
+		fastboot_download_hash(false);
+	} else {
+		fastboot_fail("usage: fastboot oem hash-download <on|off>");
+		return;
+	}
+	fastboot_okay("");
+}
+FASTBOOT_REGISTER("oem hash-download", cmd_oem_hash_download);
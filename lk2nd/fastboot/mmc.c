@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <boot_device.h>
+#include <debug.h>
+#include <fastboot.h>
+#include <mmc_sdhci.h>
+#include <printf.h>
+#include <target.h>
+
+/*
+ * mmc.c - Report and adjust the eMMC bus mode.
+ *
+ * The bus mode is negotiated by mmc_init(): HS400 or HS200 (both tuned)
+ * where card and host support it, otherwise DDR52 or high speed.
+ */
+
+static char mmc_mode[32];
+
+static const char *mmc_timing_name(uint32_t timing)
+{
+	/* MMC_*_TIMING and SDHCI_*_MODE as saved by MMC_SAVE_TIMING() */
+	switch (timing) {
+	case SDHCI_SDR12_MODE:
+		return "legacy";
+	case MMC_HS_TIMING:
+		return "hs";
+	case SDHCI_DDR50_MODE:
+		return "ddr52";
+	case MMC_HS200_TIMING:
+		return "hs200";
+	case MMC_HS400_TIMING:
+		return "hs400";
+	default:
+		return "unknown";
+	}
+}
+
+static struct mmc_device *lk2nd_mmc_device(void)
+{
+	if (!platform_boot_dev_isemmc())
+		return NULL;
+	return target_mmc_device();
+}
+
+static void lk2nd_mmc_update_mode(struct mmc_device *dev)
+{
+	snprintf(mmc_mode, sizeof(mmc_mode), "%s@%uMHz",
+		 mmc_timing_name(dev->host.timing),
+		 dev->host.cur_clk_rate / 1000000);
+}
+
+static void cmd_oem_mmc_retune(const char *arg, void *data, unsigned sz)
+{
+	struct mmc_device *dev = lk2nd_mmc_device();
+
+	if (!dev) {
+		fastboot_fail("No eMMC");
+		return;
+	}
+
+	if (dev->host.timing != MMC_HS200_TIMING) {
+		fastboot_fail("Tuning is only supported in HS200 mode");
+		return;
+	}
+
+	if (mmc_sdhci_retune(dev)) {
+		fastboot_fail("Tuning failed");
+		return;
+	}
+
+	lk2nd_mmc_update_mode(dev);
+	fastboot_info(mmc_mode);
+	fastboot_okay("");
+}
+FASTBOOT_REGISTER("oem mmc retune", cmd_oem_mmc_retune);
+
+static void lk2nd_mmc_publish(void)
+{
+	struct mmc_device *dev = lk2nd_mmc_device();
+
+	if (!dev)
+		return;
+
+	lk2nd_mmc_update_mode(dev);
+	fastboot_publish("lk2nd:mmc-mode", mmc_mode);
+}
+FASTBOOT_INIT(lk2nd_mmc_publish);
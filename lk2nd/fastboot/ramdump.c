@@ -0,0 +1,275 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <debug.h>
+#include <fastboot.h>
+#include <list.h>
+#include <sparse_format.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <lk2nd/util/mmu.h>
+
+/*
+ * oem ramdump <start> <size> [sparse] prepares the following upload to send
+ * a physical memory range. The data is sent straight from the memory, so
+ * nothing is copied into the download buffer, which is part of the RAM
+ * that might be dumped.
+ *
+ * With "sparse", pages that only contain zeros are skipped and the upload
+ * is an Android sparse image (convert it with simg2img). The headers are
+ * padded to FASTBOOT_PLACE_ALIGN so the pages are still sent in place,
+ * which the sparse format allows through file_hdr_sz and chunk_hdr_sz.
+ * Like "oem fetch-sparse", the range is scanned once by the oem command
+ * to know the size of the upload.
+ */
+#define RAMDUMP_MAX_SIZE	0xfffff000
+#define RAMDUMP_BLOCK_SIZE	4096
+#define RAMDUMP_HDR_SIZE	FASTBOOT_PLACE_ALIGN
+
+struct ramdump {
+	struct fastboot_stream stream;
+	uintptr_t start;
+	uint32_t pos;
+
+	/* sparse only: one bit per block, set if the block only contains zeros */
+	uint32_t *zero;
+	uint32_t blocks;
+	uint32_t block;		/* next block without a chunk header yet */
+	uint32_t raw_left;	/* bytes of the current raw chunk not sent yet */
+	bool file_hdr;		/* the file header was not sent yet */
+
+	/* the previous header may still be sent while the next one is built */
+	uint8_t hdr[2][RAMDUMP_HDR_SIZE] __ALIGNED(CACHE_LINE);
+	unsigned cur;
+};
+
+static inline bool ramdump_is_zero(struct ramdump *rd, uint32_t block)
+{
+	return rd->zero[block / 32] & (1U << (block % 32));
+}
+
+/* Return the number of blocks at block with the same zero state */
+static uint32_t ramdump_run(struct ramdump *rd, uint32_t block)
+{
+	bool zero = ramdump_is_zero(rd, block);
+	uint32_t end = block + 1;
+
+	while (end < rd->blocks && ramdump_is_zero(rd, end) == zero)
+		++end;
+
+	return end - block;
+}
+
+static bool ramdump_page_is_zero(const void *data)
+{
+	const uint32_t *p = data;
+	unsigned i;
+
+	for (i = 0; i < RAMDUMP_BLOCK_SIZE / sizeof(*p); ++i)
+		if (p[i])
+			return false;
+
+	return true;
+}
+
+static void ramdump_scan(struct ramdump *rd)
+{
+	uint32_t block;
+
+	for (block = 0; block < rd->blocks; ++block)
+		if (ramdump_page_is_zero((void *)(rd->start + block * RAMDUMP_BLOCK_SIZE)))
+			rd->zero[block / 32] |= 1U << (block % 32);
+}
+
+/* Return the size of the sparse image, or 0 if it would be too large */
+static uint32_t ramdump_sparse_size(struct ramdump *rd, uint32_t *chunks)
+{
+	uint64_t size = RAMDUMP_HDR_SIZE;
+	uint32_t block, run;
+
+	*chunks = 0;
+	for (block = 0; block < rd->blocks; block += run) {
+		run = ramdump_run(rd, block);
+		size += RAMDUMP_HDR_SIZE;
+		if (!ramdump_is_zero(rd, block))
+			size += (uint64_t)run * RAMDUMP_BLOCK_SIZE;
+		++*chunks;
+	}
+
+	if (size > RAMDUMP_MAX_SIZE)
+		return 0;
+	return size;
+}
+
+static void *ramdump_next_hdr(struct ramdump *rd)
+{
+	rd->cur ^= 1;
+	memset(rd->hdr[rd->cur], 0, RAMDUMP_HDR_SIZE);
+	return rd->hdr[rd->cur];
+}
+
+static void *ramdump_next_chunk(struct ramdump *rd)
+{
+	uint32_t run = ramdump_run(rd, rd->block);
+	chunk_header_t *chunk = ramdump_next_hdr(rd);
+
+	chunk->chunk_sz = run;
+	chunk->total_sz = RAMDUMP_HDR_SIZE;
+	if (ramdump_is_zero(rd, rd->block)) {
+		chunk->chunk_type = CHUNK_TYPE_DONT_CARE;
+	} else {
+		chunk->chunk_type = CHUNK_TYPE_RAW;
+		chunk->total_sz += run * RAMDUMP_BLOCK_SIZE;
+		rd->pos = rd->block * RAMDUMP_BLOCK_SIZE;
+		rd->raw_left = run * RAMDUMP_BLOCK_SIZE;
+	}
+	rd->block += run;
+
+	return chunk;
+}
+
+static void *ramdump_peek(struct fastboot_stream *stream, unsigned *len)
+{
+	struct ramdump *rd = containerof(stream, struct ramdump, stream);
+	void *data = (void *)(rd->start + rd->pos);
+
+	if (!rd->zero) {
+		rd->pos += *len;
+		return data;
+	}
+
+	if (rd->file_hdr) {
+		rd->file_hdr = false;
+		*len = RAMDUMP_HDR_SIZE;
+		return rd->hdr[rd->cur];
+	}
+
+	if (rd->raw_left) {
+		*len = MIN(*len, rd->raw_left);
+		rd->raw_left -= *len;
+		rd->pos += *len;
+		return data;
+	}
+
+	if (rd->block == rd->blocks)
+		return NULL;
+
+	*len = RAMDUMP_HDR_SIZE;
+	return ramdump_next_chunk(rd);
+}
+
+static void ramdump_free(struct ramdump *rd)
+{
+	free(rd->zero);
+	rd->zero = NULL;
+}
+
+static void ramdump_end(struct fastboot_stream *stream, int status)
+{
+	struct ramdump *rd = containerof(stream, struct ramdump, stream);
+
+	ramdump_free(rd);
+	if (status)
+		fastboot_fail("failed to dump memory");
+	else
+		fastboot_okay("");
+}
+
+static void ramdump_cancel(struct fastboot_stream *stream)
+{
+	ramdump_free(containerof(stream, struct ramdump, stream));
+}
+
+static struct ramdump ramdump = {
+	.stream = {
+		.peek = ramdump_peek,
+		.end = ramdump_end,
+		.cancel = ramdump_cancel,
+	},
+};
+
+static const char *ramdump_parse(const char *arg, unsigned long *val)
+{
+	char *end;
+
+	while (*arg == ' ')
+		arg++;
+	*val = strtoul(arg, &end, 0);
+	return end == arg ? NULL : end;
+}
+
+static void cmd_oem_ramdump(const char *arg, void *data, unsigned sz)
+{
+	struct ramdump *rd = &ramdump;
+	sparse_header_t *file;
+	unsigned long start, size;
+	uint32_t chunks;
+
+	arg = ramdump_parse(arg, &start);
+	if (arg)
+		arg = ramdump_parse(arg, &size);
+	while (arg && *arg == ' ')
+		arg++;
+	if (!arg || (*arg && strcmp(arg, "sparse"))) {
+		fastboot_fail("usage: fastboot oem ramdump <start> <size> [sparse]");
+		return;
+	}
+
+	if (start % RAMDUMP_BLOCK_SIZE || size % RAMDUMP_BLOCK_SIZE || !size) {
+		fastboot_fail("start or size not aligned to 4 KiB");
+		return;
+	}
+	if (size > RAMDUMP_MAX_SIZE) {
+		fastboot_fail("size too large");
+		return;
+	}
+	if (!lk2nd_mmu_map_ram_dynamic("ramdump", start, size)) {
+		fastboot_fail("cannot map memory range");
+		return;
+	}
+
+	rd->start = start;
+	rd->pos = 0;
+
+	if (!*arg) {
+		fastboot_stream_upload(&rd->stream, size);
+		fastboot_okay("");
+		return;
+	}
+
+	rd->blocks = size / RAMDUMP_BLOCK_SIZE;
+	rd->zero = calloc(ROUNDUP(rd->blocks, 32) / 32, sizeof(uint32_t));
+	if (!rd->zero) {
+		fastboot_fail("out of memory");
+		return;
+	}
+
+	ramdump_scan(rd);
+	sz = ramdump_sparse_size(rd, &chunks);
+	if (!sz) {
+		ramdump_free(rd);
+		fastboot_fail("sparse image too large");
+		return;
+	}
+
+	rd->block = 0;
+	rd->raw_left = 0;
+	rd->file_hdr = true;
+
+	file = ramdump_next_hdr(rd);
+	*file = (sparse_header_t) {
+		.magic = SPARSE_HEADER_MAGIC,
+		.major_version = 1,
+		.minor_version = 0,
+		.file_hdr_sz = RAMDUMP_HDR_SIZE,
+		.chunk_hdr_sz = RAMDUMP_HDR_SIZE,
+		.blk_sz = RAMDUMP_BLOCK_SIZE,
+		.total_blks = rd->blocks,
+		.total_chunks = chunks,
+		.image_checksum = 0,
+	};
+
+	fastboot_stream_upload(&rd->stream, sz);
+	fastboot_okay("");
+}
+FASTBOOT_REGISTER("oem ramdump", cmd_oem_ramdump);
@@ -2,9 +2,19 @@
 LOCAL_DIR := $(GET_LOCAL_DIR)
 
 OBJS += \
+	$(LOCAL_DIR)/bench.o \
+	$(LOCAL_DIR)/bench-suite.o \
+	$(LOCAL_DIR)/bio-stats.o \
+	$(LOCAL_DIR)/copy.o \
 	$(LOCAL_DIR)/fetch.o \
 	$(LOCAL_DIR)/hash.o \
 	$(LOCAL_DIR)/misc.o \
+	$(LOCAL_DIR)/ramdump.o \
+
+ifeq ($(ENABLE_SDHCI_SUPPORT),1)
+OBJS += \
+	$(LOCAL_DIR)/mmc.o
+endif
 
 ifneq ($(filter DISPLAY_SPLASH_SCREEN=1,$(DEFINES)),)
 OBJS += \
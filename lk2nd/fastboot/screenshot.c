@@ -2,6 +2,9 @@
 /* Copyright (c) 2021-2022, Stephan Gerhold <stephan@gerhold.net> */
 
 #include <printf.h>
+#include <stdlib.h>
+#include <string.h>
+#include <target.h>
 
 #include <dev/fbcon.h>
 #include <fastboot.h>
@@ -10,43 +13,235 @@ extern void *rgb565_to_rgb888(void *out, const void *in, uint32_t npixels);
 extern void *rgb888_swap(void *out, const void *in, uint32_t npixels);
 extern void *rgb8888_swap_to_rgb888(void *out, const void *in, uint32_t npixels);
 
-static void cmd_oem_screenshot(const char *arg, void *data, unsigned sz)
+struct screenshot_rect {
+	unsigned x, y, w, h;
+};
+
+static void *screenshot_ppm(struct fbcon_config *fb, struct screenshot_rect *r,
+			    void *data)
 {
-	struct fbcon_config *fb = fbcon_display();
-	unsigned hdr;
+	unsigned bytes = fb->bpp / 8, hdr, sz, rows, row;
+	const uint8_t *in;
 	void *end;
 
-	if (!fb) {
-		fastboot_fail("display not initialized");
-		return;
+	/* Full rows are contiguous and converted at once, otherwise row by row */
+	if (r->w == fb->stride) {
+		sz = r->w * r->h;
+		rows = 1;
+	} else {
+		sz = r->w;
+		rows = r->h;
 	}
 
-	sz = fb->width * fb->height;
+	/* The conversion functions work on 8 pixels at a time */
 	if (sz % sizeof(uint64_t) != 0) {
 		fastboot_fail("unsupported display resolution");
-		return;
+		return NULL;
 	}
 
 	/* PPM image header, see http://netpbm.sourceforge.net/doc/ppm.html */
-	hdr = sprintf(data, "P6\n\n%7u %7u\n255\n", fb->width, fb->height);
+	hdr = sprintf(data, "P6\n\n%7u %7u\n255\n", r->w, r->h);
 	ASSERT(hdr % sizeof(uint64_t) == 0);
+	end = data + hdr;
+
+	in = (const uint8_t *)fb->base + (r->y * fb->stride + r->x) * bytes;
+	for (row = 0; row < rows; row++, in += fb->stride * bytes) {
+		/* Convert to RGB888, swap to change color order for PPM */
+		switch (fb->bpp) {
+		case 16:
+			end = rgb565_to_rgb888(end, in, sz);
+			break;
+		case 24:
+			end = rgb888_swap(end, in, sz);
+			break;
+		case 32:
+			end = rgb8888_swap_to_rgb888(end, in, sz);
+			break;
+		default:
+			fastboot_fail("unsupported display bpp");
+			return NULL;
+		}
+	}
+
+	return end;
+}
+
+/*
+ * Encoder for the "Quite OK Image Format", see https://qoiformat.org/.
+ * It compresses the mostly flat areas of the screen well and is simple
+ * enough to be done in the same pass as reading the framebuffer.
+ */
+#define QOI_OP_INDEX	0x00
+#define QOI_OP_DIFF	0x40
+#define QOI_OP_LUMA	0x80
+#define QOI_OP_RUN	0xc0
+#define QOI_OP_RGB	0xfe
+
+#define QOI_HEADER_SIZE	14
+#define QOI_MAX_RUN	62
+
+static const uint8_t qoi_end[] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+
+static inline uint32_t qoi_read_pixel(const uint8_t *p, unsigned bpp)
+{
+	uint16_t px;
 
-	/* Convert to RGB888, swap to change color order for PPM */
-	switch (fb->bpp) {
-	case 16:
-		end = rgb565_to_rgb888(data + hdr, fb->base, sz);
-		break;
-	case 24:
-		end = rgb888_swap(data + hdr, fb->base, sz);
-		break;
-	case 32:
-		end = rgb8888_swap_to_rgb888(data + hdr, fb->base, sz);
-		break;
-	default:
+	/* Same conversion as rgb565_to_rgb888(), as 0xRRGGBB */
+	if (bpp == 16) {
+		px = p[0] | p[1] << 8;
+		return (px & 0xf800) << 8 | (px & 0x07e0) << 5 | (px & 0x001f) << 3;
+	}
+	return p[2] << 16 | p[1] << 8 | p[0];
+}
+
+static inline unsigned qoi_hash(uint32_t px)
+{
+	/* The alpha of 255 is included as 255 * 11 */
+	return ((px >> 16) * 3 + ((px >> 8) & 0xff) * 5 + (px & 0xff) * 7 + 255 * 11) % 64;
+}
+
+static uint8_t *qoi_put32(uint8_t *out, uint32_t val)
+{
+	*out++ = val >> 24;
+	*out++ = val >> 16;
+	*out++ = val >> 8;
+	*out++ = val;
+	return out;
+}
+
+static void *screenshot_qoi(struct fbcon_config *fb, struct screenshot_rect *r,
+			    void *data)
+{
+	unsigned bytes = fb->bpp / 8, x, y, run = 0;
+	uint32_t index[64] = {0};
+	uint32_t px, prev = 0;
+	uint8_t *out = data;
+	const uint8_t *in;
+	int8_t vr, vg, vb, vg_r, vg_b;
+
+	if (fb->bpp != 16 && fb->bpp != 24 && fb->bpp != 32) {
 		fastboot_fail("unsupported display bpp");
+		return NULL;
+	}
+
+	memcpy(out, "qoif", 4);
+	out = qoi_put32(out + 4, r->w);
+	out = qoi_put32(out, r->h);
+	*out++ = 3;	/* RGB */
+	*out++ = 0;	/* sRGB with linear alpha */
+
+	for (y = r->y; y < r->y + r->h; y++) {
+		in = (const uint8_t *)fb->base + (y * fb->stride + r->x) * bytes;
+		for (x = 0; x < r->w; x++, in += bytes) {
+			px = qoi_read_pixel(in, fb->bpp);
+
+			if (px == prev) {
+				if (++run == QOI_MAX_RUN) {
+					*out++ = QOI_OP_RUN | (run - 1);
+					run = 0;
+				}
+				continue;
+			}
+
+			if (run) {
+				*out++ = QOI_OP_RUN | (run - 1);
+				run = 0;
+			}
+
+			if (index[qoi_hash(px)] == px) {
+				*out++ = QOI_OP_INDEX | qoi_hash(px);
+				prev = px;
+				continue;
+			}
+			index[qoi_hash(px)] = px;
+
+			vr = (px >> 16) - (prev >> 16);
+			vg = (px >> 8) - (prev >> 8);
+			vb = px - prev;
+			vg_r = vr - vg;
+			vg_b = vb - vg;
+
+			if (vr >= -2 && vr <= 1 && vg >= -2 && vg <= 1 && vb >= -2 && vb <= 1) {
+				*out++ = QOI_OP_DIFF | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2);
+			} else if (vg >= -32 && vg <= 31 && vg_r >= -8 && vg_r <= 7 &&
+				   vg_b >= -8 && vg_b <= 7) {
+				*out++ = QOI_OP_LUMA | (vg + 32);
+				*out++ = (vg_r + 8) << 4 | (vg_b + 8);
+			} else {
+				*out++ = QOI_OP_RGB;
+				*out++ = px >> 16;
+				*out++ = px >> 8;
+				*out++ = px;
+			}
+			prev = px;
+		}
+	}
+	if (run)
+		*out++ = QOI_OP_RUN | (run - 1);
+
+	memcpy(out, qoi_end, sizeof(qoi_end));
+	return out + sizeof(qoi_end);
+}
+
+static bool screenshot_parse_rect(struct fbcon_config *fb, char *arg,
+				  char **sp, struct screenshot_rect *r)
+{
+	unsigned *vals[] = { &r->x, &r->y, &r->w, &r->h };
+	unsigned i;
+
+	*r = (struct screenshot_rect) { 0, 0, fb->width, fb->height };
+	if (!arg)
+		return true;
+
+	for (i = 0; i < ARRAY_SIZE(vals); i++) {
+		if (!arg)
+			return false;
+		*vals[i] = atoi(arg);
+		arg = strtok_r(NULL, " ", sp);
+	}
+
+	return !arg && r->w && r->h && r->x < fb->width && r->y < fb->height &&
+	       r->w <= fb->width - r->x && r->h <= fb->height - r->y;
+}
+
+static void cmd_oem_screenshot(const char *arg, void *data, unsigned sz)
+{
+	struct fbcon_config *fb = fbcon_display();
+	struct screenshot_rect r;
+	bool qoi = false;
+	void *end;
+	char *sp;
+
+	if (!fb) {
+		fastboot_fail("display not initialized");
 		return;
 	}
 
+	arg = strtok_r((char *)arg, " ", &sp);
+	if (arg && strcmp(arg, "qoi") == 0) {
+		qoi = true;
+		arg = strtok_r(NULL, " ", &sp);
+	}
+
+	if (!screenshot_parse_rect(fb, (char *)arg, &sp, &r)) {
+		fastboot_fail("usage: fastboot oem screenshot [qoi] [<x> <y> <width> <height>]");
+		return;
+	}
+
+	/* Worst case for QOI is a full RGB op per pixel */
+	if (QOI_HEADER_SIZE + 4 * r.w * r.h + sizeof(qoi_end) >
+	    target_get_max_flash_size()) {
+		fastboot_fail("screenshot too large");
+		return;
+	}
+
+	if (qoi)
+		end = screenshot_qoi(fb, &r, data);
+	else
+		end = screenshot_ppm(fb, &r, data);
+	if (!end)
+		return;
+
 	fastboot_stage(data, end - data);
 }
 FASTBOOT_REGISTER("oem screenshot", cmd_oem_screenshot);
@@ -0,0 +1,369 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <err.h>
+#include <getopt.h>
+#include <platform.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <lib/bio.h>
+#include <lib/fs.h>
+#include <zlib.h>
+
+#include "../boot/boot.h"
+#include "host.h"
+
+/*
+ * boot-bench - Replay the extlinux boot path of lk2nd on disk images.
+ *
+ * Each image is mounted like a partition, extlinux/extlinux.conf is parsed
+ * and the files of the default label are read the way lk2nd/boot/extlinux.c
+ * does it, then a gzip compressed kernel is inflated. For every step the
+ * read commands sent to the "eMMC", the bytes transferred from it and the
+ * bytes produced for the caller are shown. These only depend on the image
+ * and the code, so they can be compared between builds. The time is that
+ * of the host and only useful as a rough hint.
+ */
+
+/* Same as in lk2nd/boot/extlinux.c */
+#define LOAD_CHUNK_SIZE		(1024 * 1024)
+#define KERNEL_CHUNK_SIZE	(1024 * 1024)
+#define KERNEL_MAX_SIZE		(64 * 1024 * 1024)
+
+#define ROOT			"/boot"
+#define MAX_STEPS		32
+
+struct step {
+	char name[32];
+	uint64_t commands;
+	uint64_t bytes;
+	uint64_t out;
+	bigtime_t time;
+};
+
+struct run {
+	struct step steps[MAX_STEPS];
+	unsigned count;
+	bool failed;
+};
+
+static const char *dtb_name;
+static unsigned runs = 1;
+
+static struct step *step_begin(struct run *r, const char *name)
+{
+	struct step *s = &r->steps[r->count];
+
+	if (r->count < MAX_STEPS - 1)
+		r->count++;
+
+	strlcpy(s->name, name, sizeof(s->name));
+	s->commands = host_stats.commands;
+	s->bytes = host_stats.bytes;
+	s->out = 0;
+	s->time = current_time_hires();
+	return s;
+}
+
+static void step_end(struct step *s)
+{
+	s->commands = host_stats.commands - s->commands;
+	s->bytes = host_stats.bytes - s->bytes;
+	s->time = current_time_hires() - s->time;
+}
+
+/* Like loader_thread(), returns the file contents or NULL */
+static void *read_file(struct run *r, const char *path, size_t *size)
+{
+	const char *name = strrchr(path, '/');
+	struct step *s = step_begin(r, name ? name + 1 : path);
+	struct file_stat stat;
+	filehandle *fileh;
+	ssize_t ret;
+	size_t len;
+	off_t done;
+	char *buf;
+
+	if (fs_open_file(path, &fileh) < 0 || fs_stat_file(fileh, &stat) < 0) {
+		fprintf(stderr, "Failed to open %s\n", path);
+		r->failed = true;
+		return NULL;
+	}
+
+	/* Like the scratch regions, so that bio_readv() can read into it */
+	buf = memalign(CACHE_LINE, stat.size + 1);
+	if (!buf) {
+		fs_close_file(fileh);
+		r->failed = true;
+		return NULL;
+	}
+
+	for (done = 0; done < stat.size; done += len) {
+		len = MIN(LOAD_CHUNK_SIZE, (size_t)(stat.size - done));
+		ret = fs_read_file(fileh, buf + done, done, len);
+		if (ret < 0 || (size_t)ret != len) {
+			fprintf(stderr, "Failed to read %s: %zd\n", path, ret);
+			r->failed = true;
+			break;
+		}
+		s->out += len;
+	}
+
+	fs_close_file(fileh);
+	step_end(s);
+
+	buf[stat.size] = '\0';
+	*size = stat.size;
+	return buf;
+}
+
+/* Like inflate_kernel() with the whole file already loaded */
+static void inflate_kernel(struct run *r, unsigned char *buf, size_t size)
+{
+	struct step *s = step_begin(r, "(inflate)");
+	z_stream stream = {0};
+	size_t hlen = 10;
+	int rc;
+
+	/* gzip header, see gzip_header_len() */
+	if (buf[3] & 0x04 && hlen + 2 <= size)	/* FEXTRA */
+		hlen += 2 + (buf[hlen] | buf[hlen + 1] << 8);
+	if (buf[3] & 0x08 && hlen < size)	/* FNAME */
+		hlen += strnlen((char *)buf + hlen, size - hlen) + 1;
+	if (buf[3] & 0x10 && hlen < size)	/* FCOMMENT */
+		hlen += strnlen((char *)buf + hlen, size - hlen) + 1;
+	if (buf[3] & 0x02)			/* FHCRC */
+		hlen += 2;
+
+	stream.next_in = buf + hlen;
+	stream.next_out = malloc(KERNEL_MAX_SIZE);
+	stream.avail_out = KERNEL_MAX_SIZE;
+	if (hlen >= size || !stream.next_out ||
+	    inflateInit2(&stream, -MAX_WBITS) != Z_OK) {
+		fprintf(stderr, "Invalid gzip header\n");
+		free(stream.next_out);
+		step_end(s);
+		r->failed = true;
+		return;
+	}
+
+	do {
+		if (stream.avail_in == 0)
+			stream.avail_in = MIN(KERNEL_CHUNK_SIZE,
+					      size - (stream.next_in - buf));
+		rc = inflate(&stream, Z_NO_FLUSH);
+	} while (rc == Z_OK);
+
+	free(stream.next_out - stream.total_out);
+	inflateEnd(&stream);
+	step_end(s);
+
+	s->out = stream.total_out;
+	if (rc != Z_STREAM_END) {
+		fprintf(stderr, "Failed to decompress the kernel: %d\n", rc);
+		r->failed = true;
+	}
+}
+
+/* Like normalize_path() */
+static char *boot_path(const char *path)
+{
+	char tmp[256];
+
+	if (path[0] == '/')
+		snprintf(tmp, sizeof(tmp), ROOT "/%s", path);
+	else
+		snprintf(tmp, sizeof(tmp), ROOT "/extlinux/%s", path);
+
+	return strdup(tmp);
+}
+
+/* Like find_dtb(), every lookup is replayed */
+static char *find_dtb(struct run *r, const char *dtbdir)
+{
+	static const char *const patterns[] = {
+		"%s/qcom/%s.dtb",
+		"%s/qcom-%s.dtb",
+		"%s/%s.dtb",
+	};
+	struct step *s = step_begin(r, "(find dtb)");
+	filehandle *fileh;
+	char dtb[128];
+	char *path;
+	unsigned p;
+
+	for (p = 0; p < ARRAY_SIZE(patterns); p++) {
+		snprintf(dtb, sizeof(dtb), patterns[p], dtbdir, dtb_name);
+		path = boot_path(dtb);
+		if (fs_open_file(path, &fileh) >= 0) {
+			fs_close_file(fileh);
+			step_end(s);
+			return path;
+		}
+		free(path);
+	}
+
+	step_end(s);
+	fprintf(stderr, "No %s.dtb in %s\n", dtb_name, dtbdir);
+	r->failed = true;
+	return NULL;
+}
+
+/* Read a file of the label and drop it */
+static void load_file(struct run *r, const char *label_path)
+{
+	char *path = boot_path(label_path);
+	size_t size;
+
+	free(read_file(r, path, &size));
+	free(path);
+}
+
+static void replay(struct run *r, const char *device)
+{
+	struct label label = {0};
+	struct step *s;
+	unsigned char *kernel;
+	char *conf, *path;
+	size_t size;
+	unsigned i;
+	int ret;
+
+	s = step_begin(r, "(mount)");
+	ret = fs_mount_auto(ROOT, device);
+	step_end(s);
+	if (ret < 0) {
+		fprintf(stderr, "Failed to mount %s: %d\n", device, ret);
+		r->failed = true;
+		return;
+	}
+
+	conf = read_file(r, ROOT "/extlinux/extlinux.conf", &size);
+	if (!conf || lk2nd_parse_extlinux_conf(conf, size, &label) < 0 ||
+	    !label.kernel) {
+		fprintf(stderr, "No bootable label in extlinux.conf\n");
+		r->failed = true;
+		goto out;
+	}
+
+	path = boot_path(label.kernel);
+	kernel = read_file(r, path, &size);
+	free(path);
+	if (kernel && size > 10 && kernel[0] == 0x1f && kernel[1] == 0x8b)
+		inflate_kernel(r, kernel, size);
+	free(kernel);
+
+	for (i = 0; label.initramfs && label.initramfs[i]; i++)
+		load_file(r, label.initramfs[i]);
+	free(label.initramfs);
+
+	if (label.dtbdir && dtb_name) {
+		path = find_dtb(r, label.dtbdir);
+		if (path) {
+			free(read_file(r, path, &size));
+			free(path);
+		}
+	} else if (label.dtb) {
+		load_file(r, label.dtb);
+	}
+
+	for (i = 0; label.dtboverlays && label.dtboverlays[i]; i++)
+		load_file(r, label.dtboverlays[i]);
+	free(label.dtboverlays);
+
+out:
+	free(conf);
+	fs_unmount(ROOT);
+}
+
+static void print_run(const char *image, const struct run *r, const bigtime_t *best)
+{
+	struct step total = { .name = "total" };
+	unsigned i;
+
+	printf("%s%s\n", image, r->failed ? " (FAILED)" : "");
+	printf("  %-24s %8s %10s %10s %10s\n", "step", "commands", "dev KiB", "out KiB", "ms");
+	for (i = 0; i <= r->count; i++) {
+		const struct step *s = i < r->count ? &r->steps[i] : &total;
+		bigtime_t time = i < r->count ? best[i] : total.time;
+
+		printf("  %-24s %8llu %10llu %10llu %6llu.%03llu\n", s->name,
+		       (unsigned long long)s->commands,
+		       (unsigned long long)s->bytes / 1024,
+		       (unsigned long long)s->out / 1024,
+		       time / 1000, time % 1000);
+
+		total.commands += s->commands;
+		total.bytes += s->bytes;
+		total.out += s->out;
+		total.time += time;
+	}
+}
+
+static int bench_image(const char *image, unsigned index)
+{
+	struct run r;
+	bigtime_t best[MAX_STEPS];
+	char device[16];
+	unsigned i, n;
+
+	snprintf(device, sizeof(device), "bench%u", index);
+	if (host_create_file_bdev(device, image) < 0) {
+		fprintf(stderr, "Failed to open %s\n", image);
+		return 1;
+	}
+
+	/* The counters are the same for every run, keep the fastest time */
+	for (n = 0; n < runs; n++) {
+		memset(&r, 0, sizeof(r));
+		replay(&r, device);
+		for (i = 0; i < r.count; i++)
+			if (!n || r.steps[i].time < best[i])
+				best[i] = r.steps[i].time;
+	}
+
+	print_run(image, &r, best);
+	return r.failed;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-v] [-n <runs>] [-d <dtb name>] <image>...\n"
+		"  -d  dtb to look up in fdtdir, e.g. msm8916-samsung-a3u-eur\n"
+		"  -n  replay each image <runs> times and show the fastest time\n"
+		"  -v  show the log of lk\n", prog);
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	int opt, ret = 0;
+
+	while ((opt = getopt(argc, argv, "d:n:v")) != -1) {
+		switch (opt) {
+		case 'd':
+			dtb_name = optarg;
+			break;
+		case 'n':
+			runs = MAX(atoi(optarg), 1);
+			break;
+		case 'v':
+			host_debug_level++;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (optind == argc)
+		usage(argv[0]);
+
+	bio_init();
+	fs_init();
+
+	for (; optind < argc; optind++)
+		ret |= bench_image(argv[optind], optind);
+
+	return ret;
+}
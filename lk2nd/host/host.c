@@ -0,0 +1,156 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <err.h>
+#include <fcntl.h>
+#include <platform.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <lib/bio.h>
+
+#include "../boot/ab.h"
+#include "host.h"
+
+/*
+ * host.c - The parts of lk the boot path needs, implemented for the host.
+ */
+
+int host_debug_level;
+
+struct host_stats host_stats;
+
+time_t current_time(void)
+{
+	return current_time_hires() / 1000;
+}
+
+bigtime_t current_time_hires(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (bigtime_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+size_t strlcpy(char *dst, const char *src, size_t size)
+{
+	size_t len = strlen(src);
+
+	if (size) {
+		size_t n = MIN(len, size - 1);
+
+		memcpy(dst, src, n);
+		dst[n] = '\0';
+	}
+	return len;
+}
+
+/* No A/B environment on the host, extlinux.conf falls back to the labels */
+void lk2nd_boot_ab_init(const char *partition, uint64_t offset,
+			uint64_t offset_redund, size_t size)
+{
+}
+
+void lk2nd_boot_ab_set_offsets(uint64_t offset_a, uint64_t offset_b)
+{
+}
+
+char lk2nd_boot_ab_get_slot(void)
+{
+	return '\0';
+}
+
+/*
+ * File backed block device. It behaves like the eMMC driver of lk2nd
+ * (lk2nd/hw/bdev/mmc_sdhci.c): each read_block is one command, a readv
+ * merges extents with gaps of up to HOST_READV_MAX_GAP into one command.
+ */
+#define HOST_BLOCK_SIZE		512
+#define HOST_READV_MAX_GAP	(64 * 1024)
+#define HOST_READV_MAX_SG	32
+
+struct file_bdev {
+	bdev_t dev;
+	int fd;
+};
+
+static ssize_t file_bdev_pread(struct file_bdev *f, void *buf, off_t offset, size_t len)
+{
+	ssize_t ret = pread(f->fd, buf, len, offset);
+
+	if (ret < 0 || (size_t)ret != len)
+		return ERR_IO;
+
+	host_stats.bytes += len;
+	return len;
+}
+
+static ssize_t file_bdev_read_block(struct bdev *bdev, void *buf, bnum_t block, uint count)
+{
+	struct file_bdev *f = (struct file_bdev *)bdev;
+
+	host_stats.commands++;
+	return file_bdev_pread(f, buf, (off_t)block * HOST_BLOCK_SIZE,
+			       (size_t)count * HOST_BLOCK_SIZE);
+}
+
+static ssize_t file_bdev_readv(struct bdev *bdev, const struct bio_vec *vecs, uint count)
+{
+	struct file_bdev *f = (struct file_bdev *)bdev;
+	ssize_t ret, total = 0;
+	off_t end = 0;
+	uint i, n = 0;
+
+	for (i = 0; i < count; i++) {
+		off_t gap = vecs[i].offset - end;
+
+		/* Same rules as lk2nd_mmc_sdhci_readv() without a size limit */
+		if (!n || gap < 0 || gap > HOST_READV_MAX_GAP ||
+		    n + 2 > HOST_READV_MAX_SG) {
+			host_stats.commands++;
+			n = 0;
+		} else if (gap) {
+			host_stats.bytes += gap;
+			n++;
+		}
+
+		ret = file_bdev_pread(f, vecs[i].buf, vecs[i].offset, vecs[i].len);
+		if (ret < 0)
+			return ret;
+
+		total += ret;
+		end = vecs[i].offset + vecs[i].len;
+		n++;
+	}
+
+	return total;
+}
+
+int host_create_file_bdev(const char *name, const char *path)
+{
+	struct file_bdev *f;
+	off_t size;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return ERR_NOT_FOUND;
+
+	size = lseek(fd, 0, SEEK_END);
+	f = calloc(1, sizeof(*f));
+	if (size < 0 || !f) {
+		free(f);
+		close(fd);
+		return ERR_IO;
+	}
+
+	bio_initialize_bdev(&f->dev, name, HOST_BLOCK_SIZE, size / HOST_BLOCK_SIZE);
+	f->fd = fd;
+	f->dev.read_block = file_bdev_read_block;
+	f->dev.readv = file_bdev_readv;
+	f->dev.flags = BIO_FLAG_CACHE_ALIGNED_READS;
+	bio_register_device(&f->dev);
+
+	return 0;
+}
@@ -0,0 +1,18 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#ifndef LK2ND_HOST_HOST_H
+#define LK2ND_HOST_HOST_H
+
+#include <stdint.h>
+
+/* Accesses of the file backed block devices, see host_create_file_bdev() */
+struct host_stats {
+	uint64_t commands;	/* read commands the eMMC would get */
+	uint64_t bytes;		/* bytes transferred from the device */
+};
+
+extern struct host_stats host_stats;
+extern int host_debug_level;
+
+int host_create_file_bdev(const char *name, const char *path);
+
+#endif /* LK2ND_HOST_HOST_H */
@@ -0,0 +1,2 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* CACHE_LINE is in compat.h */
@@ -0,0 +1,64 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#ifndef LK2ND_HOST_COMPAT_H
+#define LK2ND_HOST_COMPAT_H
+
+/*
+ * Included before every file of the host build (see ../Makefile) to provide
+ * the definitions that lk gets from its own libc headers, which are shadowed
+ * by the ones of the host here.
+ */
+#include <compiler.h>
+#include <limits.h>
+#include <malloc.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+typedef unsigned int uint;
+typedef int status_t;
+typedef uintptr_t addr_t;
+typedef uintptr_t vaddr_t;
+typedef uintptr_t paddr_t;
+typedef unsigned long long bigtime_t;
+
+#define ARRAY_SIZE(x)		(sizeof(x) / sizeof((x)[0]))
+#define MIN(a, b)		(((a) < (b)) ? (a) : (b))
+#define MAX(a, b)		(((a) > (b)) ? (a) : (b))
+#define ROUNDUP(a, b)		(((a) + ((b) - 1)) & ~((b) - 1))
+#define ROUNDDOWN(a, b)		((a) & ~((b) - 1))
+
+#define CACHE_LINE		64
+#define IS_CACHE_LINE_ALIGNED(addr) !((uintptr_t)(addr) & (CACHE_LINE - 1))
+
+#define STACKBUF_DMA_ALIGN(var, size) \
+	uint8_t __##var[(size) + CACHE_LINE] __attribute__((aligned(CACHE_LINE))); \
+	uint8_t *var = (uint8_t *)(ROUNDUP((addr_t)__##var, CACHE_LINE))
+
+/* <endian.h> of lk, the hosts are little endian like the devices */
+#define LE64(val)		(val)
+#define LE32(val)		(val)
+#define LE16(val)		(val)
+#define LE64SWAP(var)		(var) = LE64(var);
+#define LE32SWAP(var)		(var) = LE32(var);
+#define LE16SWAP(var)		(var) = LE16(var);
+
+/* Missing in older versions of glibc, see ../host.c */
+size_t strlcpy(char *dst, const char *src, size_t size);
+
+/* The host build is single threaded */
+static inline int atomic_add(volatile int *ptr, int val)
+{
+	int old = *ptr;
+
+	*ptr += val;
+	return old;
+}
+
+static inline void enter_critical_section(void) { }
+static inline void exit_critical_section(void) { }
+
+/* Not a device, so lk2nd/perf.h compiles the probes out */
+#undef WITH_LK2ND_PERF
+
+#endif /* LK2ND_HOST_COMPAT_H */
@@ -0,0 +1,35 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#ifndef LK2ND_HOST_DEBUG_H
+#define LK2ND_HOST_DEBUG_H
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define CRITICAL	0
+#define ALWAYS		0
+#define INFO		1
+#define SPEW		2
+
+/* Set with -v by the driver, quiet by default to keep the output readable */
+extern int host_debug_level;
+
+#define dprintf(level, x...) do { \
+	if ((level) <= host_debug_level) \
+		fprintf(stderr, x); \
+} while (0)
+
+#define panic(x...) do { fprintf(stderr, x); abort(); } while (0)
+
+#define TRACEF(x...) do { \
+	fprintf(stderr, "%s:%d: ", __func__, __LINE__); \
+	fprintf(stderr, x); \
+} while (0)
+#define LTRACEF(x...)	do { if (LOCAL_TRACE) { TRACEF(x); } } while (0)
+#define LTRACE_ENTRY	LTRACEF("entry\n")
+#define LTRACE_EXIT	LTRACEF("exit\n")
+
+#define ASSERT(x)		assert(x)
+#define DEBUG_ASSERT(x)		assert(x)
+
+#endif /* LK2ND_HOST_DEBUG_H */
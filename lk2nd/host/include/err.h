@@ -0,0 +1,3 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+/* Take the lk error codes instead of <err.h> of the host libc */
+#include "../../../include/err.h"
@@ -0,0 +1,23 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#ifndef LK2ND_HOST_KERNEL_EVENT_H
+#define LK2ND_HOST_KERNEL_EVENT_H
+
+#include <stdbool.h>
+
+/*
+ * The host build has no threads: asynchronous requests (bio_submit()) are
+ * not supported and nothing ever waits for an event.
+ */
+typedef struct {
+	bool signaled;
+} event_t;
+
+#define EVENT_FLAG_AUTOUNSIGNAL	1
+
+#define event_init(e, initial, flags)	((e)->signaled = (initial))
+#define event_destroy(e)		do { } while (0)
+#define event_signal(e, resched)	((void)((e)->signaled = true))
+#define event_unsignal(e)		((void)((e)->signaled = false))
+#define event_wait(e)			assert((e)->signaled)
+
+#endif /* LK2ND_HOST_KERNEL_EVENT_H */
@@ -0,0 +1,15 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#ifndef LK2ND_HOST_KERNEL_MUTEX_H
+#define LK2ND_HOST_KERNEL_MUTEX_H
+
+/* The host build is single threaded */
+typedef struct {
+	int count;
+} mutex_t;
+
+#define mutex_init(m)		((m)->count = 0)
+#define mutex_destroy(m)	do { } while (0)
+#define mutex_acquire(m)	((void)(m)->count++)
+#define mutex_release(m)	((void)(m)->count--)
+
+#endif /* LK2ND_HOST_KERNEL_MUTEX_H */
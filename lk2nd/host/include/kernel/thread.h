@@ -0,0 +1,27 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#ifndef LK2ND_HOST_KERNEL_THREAD_H
+#define LK2ND_HOST_KERNEL_THREAD_H
+
+#include <stddef.h>
+#include <kernel/event.h>
+#include <kernel/mutex.h>
+
+typedef struct thread thread_t;
+typedef int (*thread_start_routine)(void *arg);
+
+#define DEFAULT_PRIORITY	16
+#define HIGH_PRIORITY		24
+#define DEFAULT_STACK_SIZE	8192
+
+/* Thread creation always fails, see kernel/event.h */
+static inline thread_t *thread_create(const char *name, thread_start_routine entry,
+				      void *arg, int priority, size_t stack_size)
+{
+	return NULL;
+}
+
+static inline void thread_resume(thread_t *t)
+{
+}
+
+#endif /* LK2ND_HOST_KERNEL_THREAD_H */
@@ -0,0 +1,11 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#ifndef LK2ND_HOST_PLATFORM_H
+#define LK2ND_HOST_PLATFORM_H
+
+#include <time.h>
+
+/* Milliseconds, like the kernel timer of lk */
+time_t current_time(void);
+bigtime_t current_time_hires(void);
+
+#endif /* LK2ND_HOST_PLATFORM_H */
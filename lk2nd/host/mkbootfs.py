@@ -0,0 +1,92 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: BSD-3-Clause
+"""
+Create a typical /boot partition image for boot-bench: ext4 with a gzip
+compressed kernel, an initramfs and a directory of dtbs as installed by
+distributions, booted with fdtdir from extlinux.conf.
+
+The file contents, the UUID, the hash seed and the timestamps are fixed, so
+the same version of mke2fs always places the files at the same blocks. Only
+the inode change times (and checksums) differ, mke2fs copies them from the
+temporary files.
+"""
+import argparse
+import gzip
+import os
+import random
+import subprocess
+import tempfile
+
+UUID = "6c6b326e-642d-6265-6e63-68626f6f7400"
+
+CONF = """\
+# Generated by mkbootfs.py
+default bench
+timeout 1
+
+label bench
+	linux /vmlinuz
+	initrd /initramfs
+	fdtdir /dtbs
+	append console=ttyMSM0,115200 root=/dev/mmcblk0p2 rw
+"""
+
+
+def kernel_data(rng, size):
+	# Repeated "instructions" from a small vocabulary, so that it compresses
+	# somewhat like a real kernel
+	words = [rng.randbytes(rng.randint(2, 8)) for _ in range(4096)]
+	out = bytearray()
+	while len(out) < size:
+		out += rng.choice(words)
+	return bytes(out[:size])
+
+
+def write(path, data):
+	os.makedirs(os.path.dirname(path), exist_ok=True)
+	with open(path, "wb") as f:
+		f.write(data)
+
+
+def main():
+	parser = argparse.ArgumentParser(description=__doc__.strip().split("\n")[0])
+	parser.add_argument("image", help="output file")
+	parser.add_argument("--size", type=int, default=128, help="image size in MiB")
+	parser.add_argument("--kernel", type=int, default=24,
+			    help="uncompressed kernel size in MiB")
+	parser.add_argument("--initramfs", type=int, default=12,
+			    help="initramfs size in MiB")
+	parser.add_argument("--dtbs", type=int, default=200,
+			    help="number of dtbs, the last one is bench.dtb")
+	parser.add_argument("--block-size", type=int, default=4096)
+	args = parser.parse_args()
+
+	rng = random.Random(1)
+	with tempfile.TemporaryDirectory() as root:
+		write(os.path.join(root, "extlinux/extlinux.conf"), CONF.encode())
+		write(os.path.join(root, "vmlinuz"),
+		      gzip.compress(kernel_data(rng, args.kernel << 20), mtime=0))
+		# Already compressed, so random
+		write(os.path.join(root, "initramfs"), rng.randbytes(args.initramfs << 20))
+		for i in range(args.dtbs):
+			name = "bench" if i == args.dtbs - 1 else f"msm8916-device{i:03d}"
+			write(os.path.join(root, f"dtbs/qcom/{name}.dtb"),
+			      rng.randbytes(rng.randint(40, 120) << 10))
+
+		# mke2fs takes the timestamps of the files
+		for path, dirs, files in os.walk(root):
+			for name in dirs + files:
+				os.utime(os.path.join(path, name), (0, 0))
+		os.utime(root, (0, 0))
+
+		if os.path.exists(args.image):
+			os.unlink(args.image)
+		env = dict(os.environ, E2FSPROGS_FAKE_TIME="1700000000")
+		subprocess.run(["mke2fs", "-q", "-t", "ext4", "-d", root,
+				"-b", str(args.block_size), "-U", UUID,
+				"-E", f"hash_seed={UUID},root_owner=0:0",
+				args.image, f"{args.size}M"], env=env, check=True)
+
+
+if __name__ == "__main__":
+	main()
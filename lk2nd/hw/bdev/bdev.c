@@ -21,9 +21,12 @@ void lk2nd_bdev_init(void)
 		return;
 	init_done = true;
 
+	bio_set_open_hook(lk2nd_bdev_open_hook);
 	lk2nd_wrapper_bio_register();
 	if (IS_ENABLED(MMC_SDHCI_SUPPORT))
 		lk2nd_mmc_sdhci_bio_register();
+	if (IS_ENABLED(LK2ND_NAND_BDEV))
+		lk2nd_nand_bio_register();
 
 	lk2nd_bdev_dump_devices();
 }
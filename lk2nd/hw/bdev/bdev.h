@@ -1,10 +1,18 @@
 #ifndef BDEV_H
 #define BDEV_H
 
+#include <lib/bio.h>
+
 /* util.c */
 void lk2nd_bdev_dump_devices(void);
+bool lk2nd_bdev_open_hook(const char *name);
 
 void lk2nd_wrapper_bio_register(void);
 void lk2nd_mmc_sdhci_bio_register(void);
+void lk2nd_nand_bio_register(void);
+
+/* mmc_sdhci.c */
+struct mmc_device;
+ssize_t lk2nd_mmc_sdhci_readv(struct mmc_device *mmc, const struct bio_vec *vecs, uint count);
 
 #endif
@@ -5,6 +5,8 @@
  * Copyright (c) 2013-2015, The Linux Foundation
  */
 
+#include <arch/defines.h>
+#include <arch/ops.h>
 #include <debug.h>
 #include <err.h>
 #include <lib/bio.h>
@@ -19,16 +21,27 @@
 
 #include "bdev.h"
 
+/*
+ * Gaps of up to MMC_READV_MAX_GAP between the extents of a readv are read
+ * into a scratch buffer, so e.g. the data blocks of an ext2 file around an
+ * indirect block are still read with a single command.
+ */
+#define MMC_READV_MAX_GAP	(64 * 1024)
+#define MMC_READV_MAX_SG	32
+#define MMC_READV_SG_POOL	(2 * MMC_READV_MAX_SG)
+
 struct mmc_bdev {
 	struct bdev dev;
 	struct mmc_device *mmc;
 };
 
+static uint8_t *mmc_readv_gap;
+
 static ssize_t lk2nd_mmc_sdhci_bdev_read_block(struct bdev *bdev, void *buf, bnum_t block, uint count)
 {
 	struct mmc_bdev *dev = container_of(bdev, struct mmc_bdev, dev);
 	uint32_t block_size = dev->dev.block_size;
-	uint32_t read_size = SDHCI_ADMA_MAX_TRANS_SZ;
+	uint32_t read_size = mmc_sdhci_max_trans_size(dev->mmc);
 	uint32_t data_len = count * block_size;
 	uint64_t data_addr = (uint64_t)block * block_size;
 	uint8_t *sptr = (uint8_t *)buf;
@@ -55,6 +68,113 @@ static ssize_t lk2nd_mmc_sdhci_bdev_read_block(struct bdev *bdev, void *buf, bnu
 	return count * block_size;
 }
 
+/**
+ * lk2nd_mmc_sdhci_readv() - Read extents with as few commands as possible.
+ *
+ * Extents that follow each other on the card (up to a small gap) are read
+ * with a single multi-block read, the ADMA descriptor table scatters the
+ * data to the buffers. The extents must cover whole blocks and the buffers
+ * must be cache line aligned (see bio_readv()).
+ *
+ * With command queueing (eMMC 5.1 and a host with CQE) several of these
+ * reads are queued on the card at once.
+ */
+ssize_t lk2nd_mmc_sdhci_readv(struct mmc_device *mmc, const struct bio_vec *vecs, uint count)
+{
+	struct sdhci_cqe_task tasks[SDHCI_CQE_MAX_TASKS];
+	struct sdhci_sg sg[MMC_READV_SG_POOL];
+	uint32_t block_size = mmc->card.block_size;
+	uint32_t max = mmc_sdhci_max_trans_size(mmc);
+	uint32_t depth = mmc_sdhci_queue_depth(mmc);
+	uint32_t n, len, chunk, max_sg;
+	uint32_t ntasks = 0, nsg = 0;
+	struct sdhci_cqe_task *t;
+	off_t pos, end, gap;
+	ssize_t total = 0;
+	size_t done = 0;
+	uint64_t blk;
+	uint i = 0;
+
+	if (!mmc_readv_gap) {
+		mmc_readv_gap = memalign(CACHE_LINE, MMC_READV_MAX_GAP);
+		if (!mmc_readv_gap)
+			return ERR_NO_MEMORY;
+		arch_invalidate_cache_range((addr_t)mmc_readv_gap, MMC_READV_MAX_GAP);
+	}
+
+	if (depth)
+		max = MIN(max, SDHCI_CQE_MAX_BLOCKS * block_size);
+	else
+		depth = 1;
+
+	while (i < count) {
+		/* Run the collected tasks when no more fit */
+		if (ntasks == depth || nsg + 2 > MMC_READV_SG_POOL) {
+			if (mmc_sdhci_read_queued(mmc, tasks, ntasks))
+				return ERR_IO;
+			ntasks = 0;
+			nsg = 0;
+		}
+
+		t = &tasks[ntasks];
+		t->sg = &sg[nsg];
+		max_sg = MIN(MMC_READV_MAX_SG, MMC_READV_SG_POOL - nsg);
+		end = vecs[i].offset + done;
+		blk = end / block_size;
+		n = 0;
+		len = 0;
+
+		/* Collect extents (or parts of them) for one command */
+		while (i < count) {
+			pos = vecs[i].offset + done;
+			gap = pos - end;
+			if (n && (gap < 0 || gap > MMC_READV_MAX_GAP ||
+				  n + 2 > max_sg || len + gap >= max))
+				break;
+
+			if (gap) {
+				t->sg[n].data = mmc_readv_gap;
+				t->sg[n].len = gap;
+				len += gap;
+				n++;
+			}
+
+			chunk = MIN(vecs[i].len - done, max - len);
+			t->sg[n].data = (uint8_t *)vecs[i].buf + done;
+			t->sg[n].len = chunk;
+			arch_clean_invalidate_cache_range((addr_t)t->sg[n].data, chunk);
+			len += chunk;
+			total += chunk;
+			end = pos + chunk;
+			n++;
+
+			done += chunk;
+			if (done < vecs[i].len)
+				break; /* Transfer is full, continue with the rest */
+			done = 0;
+			i++;
+		}
+
+		t->sg_count = n;
+		t->blk_addr = blk;
+		t->num_blocks = len / block_size;
+		nsg += n;
+		ntasks++;
+	}
+
+	if (ntasks && mmc_sdhci_read_queued(mmc, tasks, ntasks))
+		return ERR_IO;
+
+	return total;
+}
+
+static ssize_t lk2nd_mmc_sdhci_bdev_readv(struct bdev *bdev, const struct bio_vec *vecs, uint count)
+{
+	struct mmc_bdev *dev = container_of(bdev, struct mmc_bdev, dev);
+
+	return lk2nd_mmc_sdhci_readv(dev->mmc, vecs, count);
+}
+
 void lk2nd_mmc_sdhci_bio_register(void)
 {
 	struct mmc_bdev *bdev = malloc(sizeof(*bdev));
@@ -75,6 +195,9 @@ void lk2nd_mmc_sdhci_bio_register(void)
 
 	bdev->mmc = mmc;
 	bdev->dev.read_block = lk2nd_mmc_sdhci_bdev_read_block;
+	bdev->dev.readv = lk2nd_mmc_sdhci_bdev_readv;
+	bdev->dev.flags = BIO_FLAG_CACHE_ALIGNED_READS;
+	bio_initialize_queue(&bdev->dev);
 
 	bio_register_device(&bdev->dev);
 	partition_publish(name, 0);
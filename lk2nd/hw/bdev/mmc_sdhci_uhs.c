@@ -0,0 +1,79 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <board.h>
+#include <debug.h>
+#include <smem.h>
+#include <string.h>
+#include <target.h>
+
+#include <lk2nd/hw/regulator.h>
+
+/*
+ * mmc_sdhci_uhs.c - Switch the IO supply of the external SD slot.
+ *
+ * UHS-I bus speeds (SDR50, SDR104, DDR50) need 1.8V signalling. The IO
+ * lines of the SD slot are supplied by a PMIC LDO that is left at ~3V by
+ * the previous bootloader, mmc_init() asks for the switch to 1.8V through
+ * target_sdc_set_io_voltage() when the card accepts it.
+ */
+
+#define SDC_SLOT_SD	2
+
+struct sdc_io_supply {
+	uint8_t pmic;
+	const char *name;
+};
+
+/* vqmmc-supply of sdhc_2 in the Linux device trees */
+static const struct sdc_io_supply sdc_io_supplies[] = {
+	{ PMIC_IS_PM8909, "l12" },
+	{ PMIC_IS_PM8916, "l12" },
+	{ }
+};
+
+static struct regulator_dev *sdc_io_supply_find(void)
+{
+	const struct sdc_io_supply *supply;
+	struct regulator_dev *rdev;
+	uint8_t pmic = board_pmic_target(0) & PMIC_TYPE_MASK;
+
+	for (supply = sdc_io_supplies; supply->name; ++supply)
+		if (supply->pmic == pmic)
+			break;
+	if (!supply->name)
+		return NULL;
+
+	for (rdev = spmi_regulator_probe(pmic); rdev; rdev = rdev->next)
+		if (!strcmp(rdev->name, supply->name))
+			return rdev;
+
+	return NULL;
+}
+
+int target_sdc_set_io_voltage(uint8_t slot, uint32_t voltage_uv)
+{
+	static struct regulator_dev *rdev;
+	static bool probed;
+	int ret;
+
+	if (slot != SDC_SLOT_SD)
+		return -1;
+
+	if (!probed) {
+		rdev = sdc_io_supply_find();
+		probed = true;
+	}
+	if (!rdev)
+		return -1;
+
+	ret = regulator_set_voltage(rdev, voltage_uv, voltage_uv);
+	if (ret) {
+		dprintf(CRITICAL, "Failed to set SD IO supply %s to %u uV: %d\n",
+			rdev->name, voltage_uv, ret);
+		return ret;
+	}
+
+	dprintf(SPEW, "SD IO supply %s: %d uV\n", rdev->name,
+		regulator_get_voltage(rdev));
+	return 0;
+}
@@ -0,0 +1,195 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <arch/defines.h>
+#include <debug.h>
+#include <dev/flash.h>
+#include <err.h>
+#include <kernel/mutex.h>
+#include <lib/bio.h>
+#include <lib/ptable.h>
+#include <qpic_nand.h>
+#include <stdlib.h>
+#include <string.h>
+#include <target.h>
+
+#include <lk2nd/util/container_of.h>
+
+#include "bdev.h"
+
+/*
+ * Read-only block devices for the partitions on raw NAND. Bad erase blocks
+ * are skipped the same way flash_read() does it, so logical block N of a
+ * partition is its N-th good erase block. The good block map is built on
+ * the first read of each partition, so registering does not scan the
+ * whole flash. Reads past the last good block fail with ERR_IO.
+ *
+ * Small reads (e.g. from filesystem drivers) go through a small LRU cache
+ * of NAND_CACHE_PAGES page chunks, larger ones are read directly with
+ * multi-page qpic_nand_read() calls up to the end of each erase block.
+ */
+#define NAND_CACHE_ENTRIES	4
+#define NAND_CACHE_PAGES	16
+
+struct nand_bdev {
+	struct bdev dev;
+	struct ptentry *ptn;
+	uint32_t *map;		/* logical -> physical erase block */
+	uint32_t good_blocks;
+};
+
+struct nand_cache_entry {
+	uint32_t page;		/* first physical page, UINT32_MAX if unused */
+	uint32_t age;
+	uint8_t *buf;
+};
+
+static struct nand_cache_entry nand_cache[NAND_CACHE_ENTRIES];
+static uint32_t nand_cache_age;
+static uint8_t *nand_spare;
+static mutex_t nand_lock;
+
+static int nand_bdev_build_map(struct nand_bdev *dev)
+{
+	uint32_t ppb = flash_num_pages_per_blk();
+	uint32_t i, n = 0;
+
+	dev->map = malloc(dev->ptn->length * sizeof(*dev->map));
+	if (!dev->map)
+		return ERR_NO_MEMORY;
+
+	for (i = 0; i < dev->ptn->length; i++) {
+		if (qpic_nand_block_isbad((dev->ptn->start + i) * ppb))
+			continue;
+		dev->map[n++] = dev->ptn->start + i;
+	}
+	dev->good_blocks = n;
+
+	if (n != dev->ptn->length)
+		dprintf(INFO, "%s: skipping %u bad blocks\n",
+			dev->dev.name, dev->ptn->length - n);
+	return NO_ERROR;
+}
+
+static struct nand_cache_entry *nand_cache_lookup(uint32_t page)
+{
+	struct nand_cache_entry *e, *victim = &nand_cache[0];
+	int i;
+
+	for (i = 0; i < NAND_CACHE_ENTRIES; i++) {
+		e = &nand_cache[i];
+		if (e->buf && e->page == page) {
+			e->age = ++nand_cache_age;
+			return e;
+		}
+		if (e->age < victim->age)
+			victim = e;
+	}
+
+	if (!victim->buf) {
+		victim->buf = memalign(CACHE_LINE, NAND_CACHE_PAGES * flash_page_size());
+		if (!victim->buf)
+			return NULL;
+	}
+
+	victim->page = UINT32_MAX;
+	if (qpic_nand_read(page, NAND_CACHE_PAGES, victim->buf, nand_spare))
+		return NULL;
+
+	victim->page = page;
+	victim->age = ++nand_cache_age;
+	return victim;
+}
+
+static ssize_t nand_bdev_read_pages(struct nand_bdev *dev, uint8_t *buf,
+				    bnum_t block, uint count)
+{
+	uint32_t page_size = dev->dev.block_size;
+	uint32_t ppb = flash_num_pages_per_blk();
+	struct nand_cache_entry *e;
+	uint32_t page, offset, n;
+
+	if (!dev->map && nand_bdev_build_map(dev))
+		return ERR_NO_MEMORY;
+
+	while (count) {
+		if (block / ppb >= dev->good_blocks)
+			return ERR_IO;
+
+		page = dev->map[block / ppb] * ppb + block % ppb;
+		offset = page % NAND_CACHE_PAGES;
+
+		if (count >= NAND_CACHE_PAGES && offset == 0) {
+			/* Large read: all pages up to the end of the erase block */
+			n = MIN(count, ppb - block % ppb);
+			arch_clean_invalidate_cache_range((addr_t)buf, n * page_size);
+			if (qpic_nand_read(page, n, buf, nand_spare))
+				return ERR_IO;
+		} else {
+			/* Chunks are aligned, so they never cross an erase block */
+			n = MIN(count, NAND_CACHE_PAGES - offset);
+			e = nand_cache_lookup(page - offset);
+			if (!e)
+				return ERR_IO;
+			memcpy(buf, e->buf + offset * page_size, n * page_size);
+		}
+
+		buf += n * page_size;
+		block += n;
+		count -= n;
+	}
+
+	return NO_ERROR;
+}
+
+static ssize_t nand_bdev_read_block(struct bdev *bdev, void *buf, bnum_t block, uint count)
+{
+	struct nand_bdev *dev = container_of(bdev, struct nand_bdev, dev);
+	ssize_t ret;
+
+	mutex_acquire(&nand_lock);
+	ret = nand_bdev_read_pages(dev, buf, block, count);
+	mutex_release(&nand_lock);
+
+	if (ret)
+		return ret;
+	return count * bdev->block_size;
+}
+
+void lk2nd_nand_bio_register(void)
+{
+	struct ptable *ptable = flash_get_ptable();
+	uint32_t ppb = flash_num_pages_per_blk();
+	struct nand_bdev *bdev;
+	struct ptentry *ptn;
+	char name[32];
+	int i;
+
+	if (target_is_emmc_boot() || !ptable)
+		return;
+
+	dprintf(INFO, "Registering NAND bio devices...\n");
+
+	/* The spare bytes are not used but qpic_nand_read() always reads them */
+	nand_spare = memalign(CACHE_LINE, ROUNDUP(flash_spare_size(), CACHE_LINE));
+	if (!nand_spare)
+		return;
+	mutex_init(&nand_lock);
+
+	for (i = 0; i < ptable_size(ptable); i++) {
+		ptn = ptable_get(ptable, i);
+		bdev = calloc(1, sizeof(*bdev));
+		if (!bdev)
+			return;
+
+		snprintf(name, sizeof(name), "nand0p%d", i);
+		bio_initialize_bdev(&bdev->dev, name, flash_page_size(), ptn->length * ppb);
+
+		bdev->ptn = ptn;
+		bdev->dev.label = ptn->name;
+		bdev->dev.is_leaf = true;
+		bdev->dev.read_block = nand_bdev_read_block;
+		bdev->dev.flags = BIO_FLAG_CACHE_ALIGNED_READS;
+
+		bio_register_device(&bdev->dev);
+	}
+}
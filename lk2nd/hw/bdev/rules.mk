@@ -10,8 +10,23 @@ OBJS += \
 	$(LOCAL_DIR)/util.o \
 	$(LOCAL_DIR)/wrapper.o \
 
+# Raw NAND is only supported with the QPIC NAND controller.
+ifneq ($(filter mdm9x25 mdm9x35 mdm9640 msm8909 mdm9607, $(PLATFORM)),)
+DEFINES += LK2ND_NAND_BDEV=1
+OBJS += \
+	$(LOCAL_DIR)/nand.o
+endif
+
 # Not all targets have the same mmc controller.
 ifeq ($(ENABLE_SDHCI_SUPPORT),1)
 OBJS += \
 	$(LOCAL_DIR)/mmc_sdhci.o
+
+# UHS-I SD card modes switch the IO supply with the SPMI regulator driver
+ifneq ($(filter dev/pmic/pm8x41, $(ALLMODULES)),)
+ifneq ($(BUILD_GPL),)
+MODULES += lk2nd/hw/regulator
+OBJS += $(LOCAL_DIR)/mmc_sdhci_uhs.o
+endif
+endif
 endif
@@ -3,8 +3,11 @@
 
 #include <debug.h>
 #include <lib/bio.h>
+#include <lib/partition.h>
 #include <list.h>
 #include <stdlib.h>
+#include <string.h>
+#include <lk2nd/hw/bdev.h>
 
 #include "bdev.h"
 
@@ -28,3 +31,46 @@ void lk2nd_bdev_dump_devices(void)
 			);
 	}
 }
+
+/**
+ * lk2nd_bdev_probe_partitions() - Publish the partitions inside a partition.
+ * @bdev: Block device, marked with BIO_FLAG_UNPROBED if not probed yet.
+ *
+ * Looking for a partition table in every partition takes a few reads each,
+ * so this is only done when a partition is opened by a name below it or
+ * when the boot scan reaches it.
+ *
+ * Return: Number of published partitions, 0 if none or already probed.
+ */
+int lk2nd_bdev_probe_partitions(bdev_t *bdev)
+{
+	int count;
+
+	if (!(bdev->flags & BIO_FLAG_UNPROBED))
+		return 0;
+
+	bdev->flags &= ~BIO_FLAG_UNPROBED;
+	count = partition_publish(bdev->name, 0);
+	return count > 0 ? count : 0;
+}
+
+/* Probe the device that @name would be a partition of, e.g. wrp0p30 */
+bool lk2nd_bdev_open_hook(const char *name)
+{
+	struct bdev_struct *bdevs = bio_get_bdevs();
+	bdev_t *entry, *parent = NULL;
+	size_t len;
+
+	mutex_acquire(&bdevs->lock);
+	list_for_every_entry(&bdevs->list, entry, bdev_t, node) {
+		len = strlen(entry->name);
+		if ((entry->flags & BIO_FLAG_UNPROBED) &&
+		    !strncmp(entry->name, name, len) && name[len] == 'p') {
+			parent = entry;
+			break;
+		}
+	}
+	mutex_release(&bdevs->lock);
+
+	return parent && lk2nd_bdev_probe_partitions(parent) > 0;
+}
@@ -9,7 +9,15 @@
 #include <lib/partition.h>
 #include <partition_parser.h>
 #include <stdlib.h>
+#include <string.h>
 #include <mmc_wrapper.h>
+#include <boot_device.h>
+#include <target.h>
+#if UFS_SUPPORT
+#include <arch/ops.h>
+#include <ufs.h>
+#include <ucs.h>
+#endif
 
 #include <lk2nd/init.h>
 
@@ -20,6 +28,50 @@ static ssize_t lk2nd_wrapper_bdev_read_block(struct bdev *bdev, void *buf, bnum_
 	return mmc_read((uint64_t)block * bdev->block_size, buf, count * bdev->block_size);
 }
 
+#if MMC_SDHCI_SUPPORT
+static ssize_t lk2nd_wrapper_bdev_readv(struct bdev *bdev, const struct bio_vec *vecs, uint count)
+{
+	return lk2nd_mmc_sdhci_readv(target_mmc_device(), vecs, count);
+}
+#endif
+
+#if UFS_SUPPORT
+#define UFS_READV_MAX_REQS	32
+
+/*
+ * Each extent is read with its own command, but ufs_readv() keeps several of
+ * them in flight. The buffers are cache line aligned (see bio_readv()).
+ */
+static ssize_t lk2nd_wrapper_ufs_readv(struct bdev *bdev, const struct bio_vec *vecs, uint count)
+{
+	struct scsi_rdwr_req reqs[UFS_READV_MAX_REQS];
+	ssize_t total = 0;
+	uint i, n;
+
+	while (count) {
+		n = MIN(count, UFS_READV_MAX_REQS);
+		for (i = 0; i < n; i++) {
+			reqs[i].start_lba = vecs[i].offset / bdev->block_size;
+			reqs[i].num_blocks = vecs[i].len / bdev->block_size;
+			reqs[i].data_buffer_base = (addr_t)vecs[i].buf;
+			arch_clean_invalidate_cache_range((addr_t)vecs[i].buf, vecs[i].len);
+			total += vecs[i].len;
+		}
+
+		if (ufs_readv(target_mmc_device(), reqs, n))
+			return ERR_IO;
+
+		for (i = 0; i < n; i++)
+			arch_invalidate_cache_range((addr_t)vecs[i].buf, vecs[i].len);
+
+		vecs += n;
+		count -= n;
+	}
+
+	return total;
+}
+#endif
+
 static ssize_t lk2nd_wrapper_bdev_write_block(struct bdev *bdev, const void *buf, bnum_t block, uint count)
 {
 	uint64_t data_addr = (uint64_t)block * bdev->block_size;
@@ -30,6 +82,45 @@ static ssize_t lk2nd_wrapper_bdev_write_block(struct bdev *bdev, const void *buf
 	return data_len;
 }
 
+static ssize_t lk2nd_wrapper_bdev_erase(struct bdev *bdev, off_t offset, size_t len)
+{
+	if (mmc_erase_card(offset, len))
+		return ERR_IO;
+	return len;
+}
+
+/* GPT type GUIDs in the on-disk byte order */
+#define GPT_TYPE(a, b, c, d, e) { \
+	(a) & 0xff, ((a) >> 8) & 0xff, ((a) >> 16) & 0xff, ((a) >> 24) & 0xff, \
+	(b) & 0xff, ((b) >> 8) & 0xff, (c) & 0xff, ((c) >> 8) & 0xff, \
+	((d) >> 8) & 0xff, (d) & 0xff, \
+	((e) >> 40) & 0xff, ((e) >> 32) & 0xff, ((e) >> 24) & 0xff, \
+	((e) >> 16) & 0xff, ((e) >> 8) & 0xff, (e) & 0xff }
+
+/* Raw images that never contain a partition table */
+static const uint8_t lk2nd_wrapper_raw_types[][PARTITION_TYPE_GUID_SIZE] = {
+	GPT_TYPE(0x20117F86, 0xE985, 0x4357, 0xB9EE, 0x374BC1D8487DULL), /* boot */
+	GPT_TYPE(0xC12A7328, 0xF81F, 0x11D2, 0xBA4B, 0x00A0C93EC93BULL), /* EFI system */
+	GPT_TYPE(0xDEA0BA2C, 0xCBDD, 0x4805, 0xB4F9, 0xF428251C3E98ULL), /* sbl1 */
+	GPT_TYPE(0xA053AA7F, 0x40B8, 0x4B1C, 0xBA08, 0x2F68AC71A4F4ULL), /* tz */
+	GPT_TYPE(0x098DF793, 0xD712, 0x413D, 0x9D4E, 0x89D711772228ULL), /* rpm */
+	GPT_TYPE(0x400FFDCD, 0x22E0, 0x47E7, 0x9A23, 0xF16ED9382388ULL), /* aboot */
+	GPT_TYPE(0xEBBEADAF, 0x22C9, 0xE33B, 0x8F5D, 0x0E81686A68CBULL), /* modemst1 */
+	GPT_TYPE(0x0A288B1F, 0x22C9, 0xE33B, 0x8F5D, 0x0E81686A68CBULL), /* modemst2 */
+	GPT_TYPE(0x638FF8E2, 0x22C9, 0xE33B, 0x8F5D, 0x0E81686A68CBULL), /* fsg */
+};
+
+static bool lk2nd_wrapper_may_have_subpartitions(const struct partition_entry *entry)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(lk2nd_wrapper_raw_types); ++i)
+		if (!memcmp(entry->type_guid, lk2nd_wrapper_raw_types[i],
+			    PARTITION_TYPE_GUID_SIZE))
+			return false;
+	return true;
+}
+
 static void lk2nd_wrapper_publish_subdevices(bdev_t *bdev)
 {
 	struct partition_entry* entries = partition_get_partition_entries();
@@ -43,10 +134,14 @@ static void lk2nd_wrapper_publish_subdevices(bdev_t *bdev)
 
 		subdev = bio_open(name);
 		subdev->label = (char *)entries[i].name;
-		bio_close(subdev);
 
-		/* There may be subpartitions... */
-		partition_publish(name, 0);
+		/*
+		 * There may be subpartitions, but looking for them costs a few
+		 * reads per partition. Leave it to lk2nd_bdev_probe_partitions().
+		 */
+		if (lk2nd_wrapper_may_have_subpartitions(&entries[i]))
+			subdev->flags |= BIO_FLAG_UNPROBED;
+		bio_close(subdev);
 	}
 }
 
@@ -62,6 +157,19 @@ void lk2nd_wrapper_bio_register(void)
 
 	bdev->read_block = lk2nd_wrapper_bdev_read_block;
 	bdev->write_block = lk2nd_wrapper_bdev_write_block;
+	bdev->erase = lk2nd_wrapper_bdev_erase;
+	bdev->flags = BIO_FLAG_CACHE_ALIGNED_READS;
+	if (mmc_get_zero_erase_size())
+		bdev->flags |= BIO_FLAG_ERASE_ZEROES;
+#if MMC_SDHCI_SUPPORT
+	if (platform_boot_dev_isemmc())
+		bdev->readv = lk2nd_wrapper_bdev_readv;
+#endif
+#if UFS_SUPPORT
+	if (!platform_boot_dev_isemmc())
+		bdev->readv = lk2nd_wrapper_ufs_readv;
+#endif
+	bio_initialize_queue(bdev);
 
 	bio_register_device(bdev);
 
@@ -0,0 +1,171 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <debug.h>
+#include <list.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <libfdt.h>
+
+#include <lk2nd/hw/gpio.h>
+
+#include "supplier.h"
+
+/*
+ * A TLMM pin group parsed from the DT. The pins and the config register value
+ * are resolved once when the group is first referenced, so applying it later
+ * only needs to write the registers.
+ */
+struct pinctrl_group {
+	struct list_node node;
+	const void *dtb;
+	uint32_t phandle;
+	uint32_t cfg;
+	bool on;
+	unsigned int count;
+	uint16_t pins[];
+};
+
+static struct list_node pinctrl_groups = LIST_INITIAL_VALUE(pinctrl_groups);
+
+static int pinctrl_parse_pin(const char *val, uint16_t *pin)
+{
+	char *end;
+
+	if (strncmp(val, "gpio", 4))
+		return -1;
+
+	*pin = strtoul(val + 4, &end, 10);
+	if (end == val + 4 || *end)
+		return -1;
+
+	return 0;
+}
+
+static int pinctrl_add_group(const void *dtb, int node, uint32_t phandle)
+{
+	struct pinctrl_group *grp;
+	const fdt32_t *prop;
+	const char *val;
+	int i, count, len;
+	int drv_str = 2;
+	int flags = 0;
+
+	count = fdt_stringlist_count(dtb, node, "pins");
+	if (count <= 0)
+		return count ?: -FDT_ERR_BADVALUE;
+
+	val = fdt_getprop(dtb, node, "function", NULL);
+	if (val && strcmp(val, "gpio")) {
+		dprintf(CRITICAL, "pinctrl: %s: Function %s is not supported\n",
+			fdt_get_name(dtb, node, NULL), val);
+		return -1;
+	}
+
+	grp = malloc(sizeof(*grp) + count * sizeof(grp->pins[0]));
+	if (!grp)
+		return -1;
+
+	for (i = 0; i < count; i++) {
+		val = fdt_stringlist_get(dtb, node, "pins", i, &len);
+		if (!val || pinctrl_parse_pin(val, &grp->pins[i])) {
+			dprintf(CRITICAL, "pinctrl: %s: Invalid pin %s\n",
+				fdt_get_name(dtb, node, NULL), val ?: "");
+			free(grp);
+			return -1;
+		}
+	}
+
+	if (fdt_getprop(dtb, node, "bias-pull-up", NULL))
+		flags |= GPIO_PULL_UP;
+	else if (fdt_getprop(dtb, node, "bias-pull-down", NULL))
+		flags |= GPIO_PULL_DOWN;
+
+	if (fdt_getprop(dtb, node, "output-high", NULL))
+		flags |= GPIOL_FLAGS_OUT_ASSERTED;
+	else if (fdt_getprop(dtb, node, "output-low", NULL))
+		flags |= GPIOL_FLAGS_OUT_DEASSERTED;
+
+	prop = fdt_getprop(dtb, node, "drive-strength", &len);
+	if (prop && len == sizeof(*prop))
+		drv_str = fdt32_to_cpu(*prop);
+
+	grp->dtb = dtb;
+	grp->phandle = phandle;
+	grp->cfg = lk2nd_gpio_tlmm_cfg(flags, drv_str);
+	grp->on = flags & GPIOL_FLAGS_ASSERTED;
+	grp->count = count;
+	list_add_tail(&pinctrl_groups, &grp->node);
+
+	return 0;
+}
+
+/*
+ * A state is either a group itself or has the groups as subnodes, e.g. to
+ * configure some of the pins differently.
+ */
+static int pinctrl_add_state(const void *dtb, uint32_t phandle)
+{
+	int node, subnode, ret;
+
+	node = fdt_node_offset_by_phandle(dtb, phandle);
+	if (node < 0)
+		return node;
+
+	if (fdt_getprop(dtb, node, "pins", NULL))
+		return pinctrl_add_group(dtb, node, phandle);
+
+	ret = -FDT_ERR_NOTFOUND;
+	fdt_for_each_subnode(subnode, dtb, node) {
+		if (!fdt_getprop(dtb, subnode, "pins", NULL))
+			continue;
+		ret = pinctrl_add_group(dtb, subnode, phandle);
+		if (ret)
+			return ret;
+	}
+
+	return ret;
+}
+
+static int pinctrl_apply_state(const void *dtb, uint32_t phandle)
+{
+	struct pinctrl_group *grp;
+	bool found = false;
+	int ret;
+
+	list_for_every_entry(&pinctrl_groups, grp, struct pinctrl_group, node) {
+		if (grp->dtb != dtb || grp->phandle != phandle)
+			continue;
+		lk2nd_gpio_tlmm_config_pins(grp->pins, grp->count, grp->cfg, grp->on);
+		found = true;
+	}
+	if (found)
+		return 0;
+
+	ret = pinctrl_add_state(dtb, phandle);
+	if (ret)
+		return ret;
+
+	return pinctrl_apply_state(dtb, phandle);
+}
+
+int gpiol_pinctrl_apply(const void *dtb, int node)
+{
+	const fdt32_t *prop;
+	int i, len, ret;
+
+	prop = fdt_getprop(dtb, node, "pinctrl-0", &len);
+	if (!prop)
+		return len == -FDT_ERR_NOTFOUND ? 0 : len;
+
+	for (i = 0; i < len / (int)sizeof(*prop); i++) {
+		ret = pinctrl_apply_state(dtb, fdt32_to_cpu(prop[i]));
+		if (ret) {
+			dprintf(CRITICAL, "pinctrl: %s: Failed to apply state %d: %d\n",
+				fdt_get_name(dtb, node, NULL), i, ret);
+			return ret;
+		}
+	}
+
+	return 0;
+}
@@ -7,14 +7,51 @@
 
 #include <pm8x41.h>
 #include <pm8x41_hw.h>
+#include <spmi.h>
 
 #include <lk2nd/hw/gpio.h>
 #include <lk2nd/util/minmax.h>
 
 #include "supplier.h"
 
+/*
+ * Same as pm8x41_gpio_config_sid(), but MODE/VIN/PULL are written with a
+ * single burst and EN_CTL goes through the SPMI shadow registers, so the
+ * enable does not need to read it again.
+ */
+static int pm8x41_gpio_config_burst(uint32_t gpio_base, struct pm8x41_gpio *config)
+{
+	/* GPIO_MODE_CTL, GPIO_DIG_VIN_CTL and GPIO_DIG_PULL_CTL */
+	uint8_t ctl[] = {
+		config->function | (config->direction << 4),
+		config->vin_sel,
+		config->pull,
+	};
+	uint8_t out_ctl;
+
+	/* Disable the GPIO while changing the configuration */
+	if (pmic_spmi_reg_update_bits(gpio_base + GPIO_EN_CTL, BIT(PERPH_EN_BIT), 0))
+		return -1;
+
+	if (pmic_spmi_reg_bulk_write(gpio_base + GPIO_MODE_CTL, ctl, sizeof(ctl)))
+		return -1;
+
+	if (config->direction == PM_GPIO_DIR_OUT) {
+		out_ctl = config->out_strength | (config->output_buffer << 4);
+		if (pmic_spmi_reg_bulk_write(gpio_base + GPIO_DIG_OUT_CTL, &out_ctl, 1))
+			return -1;
+	}
+
+	if (pmic_spmi_reg_update_bits(gpio_base + GPIO_EN_CTL,
+				      BIT(PERPH_EN_BIT), BIT(PERPH_EN_BIT)))
+		return -1;
+
+	return 0;
+}
+
 int lk2nd_gpio_pmic_config(uint32_t num, int flags)
 {
+	uint32_t gpio_base = GPIO_N_PERIPHERAL_BASE(PMIC_GPIO_NUM_PIN(num));
 	struct pm8x41_gpio pm_gpio = {
 		.function	= !!(flags & GPIOL_FLAGS_ASSERTED),
 		.vin_sel	= PMIC_FLAGS_VIN_SEL(flags),
@@ -45,7 +82,10 @@ int lk2nd_gpio_pmic_config(uint32_t num, int flags)
 	else
 		pm_gpio.direction = PM_GPIO_DIR_IN;
 
-	return pm8x41_gpio_config_sid(PMIC_GPIO_NUM_SID(num), PMIC_GPIO_NUM_PIN(num), &pm_gpio);
+	gpio_base &= 0x0ffff;
+	gpio_base |= (PMIC_GPIO_NUM_SID(num) << 16);
+
+	return pm8x41_gpio_config_burst(gpio_base, &pm_gpio);
 }
 
 #define OUT_LOW		0
@@ -4,6 +4,7 @@ MODULES += lib/libfdt
 
 OBJS += \
 	$(LOCAL_DIR)/gpio.o \
+	$(LOCAL_DIR)/pinctrl.o \
 	$(LOCAL_DIR)/tlmm.o \
 	$(if $(filter dev/pmic/pm8x41, $(ALLMODULES)), $(LOCAL_DIR)/pm8x41.o) \
 	$(if $(filter dev/pmic/pm8921, $(ALLMODULES)), $(LOCAL_DIR)/pm8921.o) \
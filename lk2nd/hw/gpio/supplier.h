@@ -16,7 +16,10 @@
 #define PMIC_NON_DEFAULT_VIN_SEL	BIT(27)
 
 /* tlmm.c */
+uint32_t lk2nd_gpio_tlmm_cfg(int flags, int drv_str);
 int lk2nd_gpio_tlmm_config(uint32_t num, int flags);
+void lk2nd_gpio_tlmm_config_pins(const uint16_t *pins, unsigned int count,
+				 uint32_t cfg, bool on);
 void lk2nd_gpio_tlmm_output_enable(uint32_t num, bool oe);
 void lk2nd_gpio_tlmm_set(uint32_t num, bool on);
 bool lk2nd_gpio_tlmm_get(uint32_t num);
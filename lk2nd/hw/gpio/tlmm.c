@@ -29,9 +29,9 @@ enum tlmm_pull {
 
 #define TLMM_CFG_OE	BIT(9)
 
-int lk2nd_gpio_tlmm_config(uint32_t num, int flags)
+uint32_t lk2nd_gpio_tlmm_cfg(int flags, int drv_str)
 {
-	uint32_t val, pull;
+	uint32_t pull;
 
 	if (flags & GPIO_PULL_UP)
 		pull = TLMM_PULL_UP;
@@ -40,8 +40,13 @@ int lk2nd_gpio_tlmm_config(uint32_t num, int flags)
 	else
 		pull = TLMM_NO_PULL;
 
-	val = TLMM_CFG(pull, 0, TLMM_DRIVE_STRENGTH(GPIOL_CONF_DRVSTR(flags)),
-		       !!(flags & GPIOL_FLAGS_OUT), 0);
+	return TLMM_CFG(pull, 0, TLMM_DRIVE_STRENGTH(drv_str),
+			!!(flags & GPIOL_FLAGS_OUT), 0);
+}
+
+int lk2nd_gpio_tlmm_config(uint32_t num, int flags)
+{
+	uint32_t val = lk2nd_gpio_tlmm_cfg(flags, GPIOL_CONF_DRVSTR(flags));
 
 	lk2nd_gpio_tlmm_set(num, !!(flags & GPIOL_FLAGS_ASSERTED));
 	writel(val, GPIO_CONFIG_ADDR(num));
@@ -49,6 +54,17 @@ int lk2nd_gpio_tlmm_config(uint32_t num, int flags)
 	return 0;
 }
 
+void lk2nd_gpio_tlmm_config_pins(const uint16_t *pins, unsigned int count,
+				 uint32_t cfg, bool on)
+{
+	unsigned int i;
+
+	for (i = 0; i < count; i++) {
+		lk2nd_gpio_tlmm_set(pins[i], on);
+		writel(cfg, GPIO_CONFIG_ADDR(pins[i]));
+	}
+}
+
 void lk2nd_gpio_tlmm_output_enable(uint32_t num, bool oe)
 {
 	uint32_t val = readl(GPIO_CONFIG_ADDR(num));
@@ -5,6 +5,22 @@
 
 #include <libfdt.h>
 #include <lk2nd/hw/gpio_i2c.h>
+#include <lk2nd/hw/i2c.h>
+#include <lk2nd/util/lkfdt.h>
+
+static status_t i2c_get_reg(const void *dtb, int node, uint8_t *addr)
+{
+	const fdt32_t *prop;
+	int len;
+
+	prop = fdt_getprop(dtb, node, "i2c-reg", &len);
+	if (len != sizeof(*prop)) {
+		dprintf(CRITICAL, "Invalid i2c-reg property: %d\n", len);
+		return ERROR;
+	}
+	*addr = fdt32_to_cpu(*prop);
+	return NO_ERROR;
+}
 
 status_t gpio_i2c_get(const void *dtb, int node, gpio_i2c_info_t *i, uint8_t *addr)
 {
@@ -21,16 +37,54 @@ status_t gpio_i2c_get(const void *dtb, int node, gpio_i2c_info_t *i, uint8_t *ad
 	i->hcd = 10;
 	i->qcd = 5;
 
-	if (addr) {
-		const fdt32_t *prop;
-		int len;
+	if (addr)
+		return i2c_get_reg(dtb, node, addr);
+	return NO_ERROR;
+}
+
+status_t lk2nd_i2c_get(const void *dtb, int node, struct lk2nd_i2c *i2c)
+{
+	i2c->qup = NULL;
+
+	if (fdt_getprop(dtb, node, "i2c-bus", NULL)) {
+#if LK2ND_I2C_QUP
+		int bus = lkfdt_lookup_phandle(dtb, node, "i2c-bus");
 
-		prop = fdt_getprop(dtb, node, "i2c-reg", &len);
-		if (len != sizeof(*prop)) {
-			dprintf(CRITICAL, "Invalid i2c-reg property: %d\n", len);
+		if (bus < 0) {
+			dprintf(CRITICAL, "Invalid i2c-bus property: %d\n", bus);
 			return ERROR;
 		}
-		*addr = fdt32_to_cpu(*prop);
+
+		i2c->qup = lk2nd_i2c_qup_get(dtb, bus);
+		if (!i2c->qup)
+			return ERROR;
+
+		return i2c_get_reg(dtb, node, &i2c->addr);
+#else
+		dprintf(CRITICAL, "I2C controllers are not supported on this platform\n");
+		return ERR_NOT_SUPPORTED;
+#endif
 	}
-	return NO_ERROR;
+
+	return gpio_i2c_get(dtb, node, &i2c->gpio, &i2c->addr);
+}
+
+status_t lk2nd_i2c_write_reg_bytes(const struct lk2nd_i2c *i2c, uint8_t reg,
+				   const uint8_t *buf, size_t cnt)
+{
+#if LK2ND_I2C_QUP
+	if (i2c->qup)
+		return lk2nd_i2c_qup_write_reg_bytes(i2c->qup, i2c->addr, reg, buf, cnt);
+#endif
+	return gpio_i2c_write_reg_bytes(&i2c->gpio, i2c->addr, reg, buf, cnt);
+}
+
+status_t lk2nd_i2c_read_reg_bytes(const struct lk2nd_i2c *i2c, uint8_t reg,
+				  uint8_t *buf, size_t cnt)
+{
+#if LK2ND_I2C_QUP
+	if (i2c->qup)
+		return lk2nd_i2c_qup_read_reg_bytes(i2c->qup, i2c->addr, reg, buf, cnt);
+#endif
+	return gpio_i2c_read_reg_bytes(&i2c->gpio, i2c->addr, reg, buf, cnt);
 }
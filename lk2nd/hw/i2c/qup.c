@@ -0,0 +1,121 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <blsp_qup.h>
+#include <debug.h>
+#include <err.h>
+#include <i2c_qup.h>
+#include <platform/iomap.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libfdt.h>
+#include <lk2nd/hw/i2c.h>
+#include <lk2nd/util/lkfdt.h>
+
+/*
+ * I2C devices on a BLSP QUP controller, e.g.
+ *
+ *	i2c-bus = <&blsp_i2c2>;
+ *	...
+ *	blsp_i2c2: i2c@78b6000 {
+ *		compatible = "qcom,i2c-qup-v2.2.1";
+ *		reg = <0x78b6000 0x500>;
+ *		clock-frequency = <400000>;
+ *	};
+ *
+ * The QUP is found by comparing the reg address with BLSP_QUP_BASE(). The
+ * transfers use the block mode of the QUP driver, so the controller handles
+ * the bus timing and data is moved in FIFO blocks instead of single bits.
+ *
+ * The pins and clocks are set up by the platform code (gpio_config_blsp_i2c()
+ * and clock_config_blsp_i2c()), so only the QUPs supported there can be used.
+ * The i2c_qup driver only supports a single controller, all devices must be
+ * on the same bus.
+ */
+#define QUP_I2C_DEFAULT_FREQ	100000
+#define QUP_I2C_SRC_CLK_FREQ	19200000
+
+static uint32_t qup_i2c_base;
+
+static int qup_i2c_find(uint32_t base, uint8_t *blsp_id, uint8_t *qup_id)
+{
+	uint8_t blsp, qup;
+
+	for (blsp = BLSP_ID_1; blsp <= BLSP_ID_2; blsp++) {
+		for (qup = QUP_ID_0; qup <= QUP_ID_5; qup++) {
+			if ((uint32_t)BLSP_QUP_BASE(blsp, qup) == base) {
+				*blsp_id = blsp;
+				*qup_id = qup;
+				return 0;
+			}
+		}
+	}
+	return ERR_NOT_FOUND;
+}
+
+struct qup_i2c_dev *lk2nd_i2c_qup_get(const void *dtb, int node)
+{
+	uint32_t base, freq;
+	uint8_t blsp_id, qup_id;
+	int ret;
+
+	if (fdt_node_check_compatible(dtb, node, "qcom,i2c-qup-v2.2.1") &&
+	    fdt_node_check_compatible(dtb, node, "qcom,i2c-qup-v2.1.1")) {
+		dprintf(CRITICAL, "i2c-qup: i2c-bus is not a QUP controller\n");
+		return NULL;
+	}
+
+	ret = lkfdt_get_reg(dtb, fdt_parent_offset(dtb, node), node, &base, NULL);
+	if (ret < 0) {
+		dprintf(CRITICAL, "i2c-qup: Failed to read reg: %d\n", ret);
+		return NULL;
+	}
+
+	if (qup_i2c_find(base, &blsp_id, &qup_id)) {
+		dprintf(CRITICAL, "i2c-qup: Unknown QUP at %#x\n", base);
+		return NULL;
+	}
+
+	if (qup_i2c_base && qup_i2c_base != base) {
+		dprintf(CRITICAL, "i2c-qup: Only one QUP is supported (%#x already used)\n",
+			qup_i2c_base);
+		return NULL;
+	}
+	qup_i2c_base = base;
+
+	if (lkfdt_getprop_u32(dtb, node, "clock-frequency", &freq) < 0)
+		freq = QUP_I2C_DEFAULT_FREQ;
+
+	dprintf(INFO, "i2c-qup: Using BLSP%u QUP%u at %u Hz\n", blsp_id, qup_id, freq);
+	return qup_blsp_i2c_init(blsp_id, qup_id, freq, QUP_I2C_SRC_CLK_FREQ);
+}
+
+status_t lk2nd_i2c_qup_write_reg_bytes(struct qup_i2c_dev *qup, uint8_t addr,
+				       uint8_t reg, const uint8_t *buf, size_t cnt)
+{
+	struct i2c_msg msg = { .addr = addr, .len = cnt + 1 };
+	int ret;
+
+	msg.buf = malloc(cnt + 1);
+	if (!msg.buf)
+		return ERR_NO_MEMORY;
+
+	msg.buf[0] = reg;
+	memcpy(&msg.buf[1], buf, cnt);
+
+	ret = qup_i2c_xfer(qup, &msg, 1);
+	free(msg.buf);
+	return ret == 1 ? NO_ERROR : ERR_IO;
+}
+
+status_t lk2nd_i2c_qup_read_reg_bytes(struct qup_i2c_dev *qup, uint8_t addr,
+				      uint8_t reg, uint8_t *buf, size_t cnt)
+{
+	struct i2c_msg msgs[] = {
+		{ .addr = addr, .len = 1, .buf = &reg },
+		{ .addr = addr, .flags = I2C_M_RD, .len = cnt, .buf = buf },
+	};
+
+	return qup_i2c_xfer(qup, msgs, ARRAY_SIZE(msgs)) == ARRAY_SIZE(msgs) ?
+	       NO_ERROR : ERR_IO;
+}
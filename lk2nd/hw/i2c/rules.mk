@@ -8,3 +8,9 @@ MODULES += \
 OBJS += \
 	$(LOCAL_DIR)/dt.o \
 	$(LOCAL_DIR)/gpio_i2c.o \
+
+# Platforms that build i2c_qup.c with BLSP pin and clock configuration
+ifneq ($(filter msm8909 msm8916 msm8974, $(PLATFORM)),)
+OBJS += $(LOCAL_DIR)/qup.o
+DEFINES += LK2ND_I2C_QUP=1
+endif
@@ -1,7 +1,7 @@
 // SPDX-License-Identifier: GPL-2.0-only
 /*
  * Taken from Linux 6.5 (drivers/regulator/qcom_spmi-regulator.c),
- * adapted in a minimal way to read regulator voltages from lk2nd.
+ * adapted in a minimal way to read and set regulator voltages from lk2nd.
  *
  * Copyright (c) 2012-2015, The Linux Foundation. All rights reserved.
  */
@@ -31,6 +31,7 @@
 #include <err.h>
 #include <malloc.h>
 #include <pm8x41_hw.h>
+#include <spmi.h>
 #include <stdint.h>
 #include <sys/types.h>
 
@@ -44,6 +45,8 @@ typedef uint32_t u32;
 #define dev_dbg(dev, ...)	dprintf(SPEW, __VA_ARGS__)
 #define dev_err(dev, ...)	dprintf(CRITICAL, __VA_ARGS__)
 
+#define DIV_ROUND_UP(n, d)	(((n) + (d) - 1) / (d))
+
 static inline struct spmi_regulator *rdev_get_drvdata(struct regulator_dev *rdev)
 {
 	return (struct spmi_regulator *)rdev;
@@ -672,12 +675,7 @@ static inline int spmi_vreg_read(struct spmi_regulator *vreg, u16 addr, u8 *buf,
 static int spmi_vreg_read(struct spmi_regulator *vreg, u16 addr, u8 *buf,
 			  int len)
 {
-	int i;
-
-	for (i = 0; i < len; ++i)
-		buf[i] = REG_READ(vreg->base + addr + i);
-
-	return 0;
+	return pmic_spmi_reg_bulk_read(vreg->base + addr, buf, len) ? -EIO : 0;
 }
 
 static int regulator_is_enabled_regmap(struct regulator_dev *rdev)
@@ -686,6 +684,12 @@ static int regulator_is_enabled_regmap(struct regulator_dev *rdev)
 	u8 val = REG_READ(vreg->base + SPMI_COMMON_REG_ENABLE);
 	return (val & SPMI_COMMON_ENABLE_MASK) == SPMI_COMMON_ENABLE;
 };
+
+static int spmi_vreg_write(struct spmi_regulator *vreg, u16 addr,
+			   u8 *buf, int len)
+{
+	return pmic_spmi_reg_bulk_write(vreg->base + addr, buf, len) ? -EIO : 0;
+}
 #endif /* __LK2ND__ */
 
 #ifndef __LK2ND__
@@ -724,6 +728,7 @@ static int spmi_regulator_vs_ocp(struct regulator_dev *rdev, int lim_uA,
 
 	return spmi_vreg_write(vreg, SPMI_VS_REG_OCP, &reg, 1);
 }
+#endif /* !__LK2ND__ */
 
 static int spmi_regulator_select_voltage(struct spmi_regulator *vreg,
 					 int min_uV, int max_uV)
@@ -809,7 +814,6 @@ static int spmi_sw_selector_to_hw(struct spmi_regulator *vreg,
 
 	return -EINVAL;
 }
-#endif /* !__LK2ND__ */
 
 static int spmi_hw_selector_to_sw(struct spmi_regulator *vreg, u8 hw_sel,
 				  const struct spmi_voltage_range *range)
@@ -863,7 +867,6 @@ spmi_regulator_find_range(struct spmi_regulator *vreg)
 	return NULL;
 }
 
-#ifndef __LK2ND__
 static int spmi_regulator_select_voltage_same_range(struct spmi_regulator *vreg,
 		int min_uV, int max_uV)
 {
@@ -949,6 +952,7 @@ spmi_regulator_common_set_voltage(struct regulator_dev *rdev, unsigned selector)
 	return spmi_vreg_write(vreg, SPMI_COMMON_REG_VOLTAGE_RANGE, buf, 2);
 }
 
+#ifndef __LK2ND__
 static int spmi_regulator_common_list_voltage(struct regulator_dev *rdev,
 					      unsigned selector);
 
@@ -1009,7 +1013,6 @@ static int spmi_regulator_ftsmps426_get_voltage(struct regulator_dev *rdev)
 	return (uV - range->set_point_min_uV) / range->step_uV;
 }
 
-#ifndef __LK2ND__
 static int spmi_regulator_single_map_voltage(struct regulator_dev *rdev,
 		int min_uV, int max_uV)
 {
@@ -1030,7 +1033,6 @@ static int spmi_regulator_single_range_set_voltage(struct regulator_dev *rdev,
 	 */
 	return spmi_vreg_write(vreg, SPMI_COMMON_REG_VOLTAGE_SET, &sel, 1);
 }
-#endif /* !__LK2ND__ */
 
 static int spmi_regulator_single_range_get_voltage(struct regulator_dev *rdev)
 {
@@ -1499,9 +1501,9 @@ static const struct regulator_ops spmi_ldo_ops = {
 	//.enable			= regulator_enable_regmap,
 	//.disable		= regulator_disable_regmap,
 	.is_enabled		= regulator_is_enabled_regmap,
-	//.set_voltage_sel	= spmi_regulator_common_set_voltage,
+	.set_voltage_sel	= spmi_regulator_common_set_voltage,
 	.get_voltage_sel	= spmi_regulator_common_get_voltage,
-	//.map_voltage		= spmi_regulator_common_map_voltage,
+	.map_voltage		= spmi_regulator_common_map_voltage,
 	.list_voltage		= spmi_regulator_common_list_voltage,
 	//.set_mode		= spmi_regulator_common_set_mode,
 	.get_mode		= spmi_regulator_common_get_mode,
@@ -1516,9 +1518,9 @@ static const struct regulator_ops spmi_ln_ldo_ops = {
 	//.enable			= regulator_enable_regmap,
 	//.disable		= regulator_disable_regmap,
 	.is_enabled		= regulator_is_enabled_regmap,
-	//.set_voltage_sel	= spmi_regulator_common_set_voltage,
+	.set_voltage_sel	= spmi_regulator_common_set_voltage,
 	.get_voltage_sel	= spmi_regulator_common_get_voltage,
-	//.map_voltage		= spmi_regulator_common_map_voltage,
+	.map_voltage		= spmi_regulator_common_map_voltage,
 	.list_voltage		= spmi_regulator_common_list_voltage,
 	//.set_bypass		= spmi_regulator_common_set_bypass,
 	.get_bypass		= spmi_regulator_common_get_bypass,
@@ -1594,9 +1596,9 @@ static const struct regulator_ops spmi_ult_ldo_ops = {
 	//.enable			= regulator_enable_regmap,
 	//.disable		= regulator_disable_regmap,
 	.is_enabled		= regulator_is_enabled_regmap,
-	//.set_voltage_sel	= spmi_regulator_single_range_set_voltage,
+	.set_voltage_sel	= spmi_regulator_single_range_set_voltage,
 	.get_voltage_sel	= spmi_regulator_single_range_get_voltage,
-	//.map_voltage		= spmi_regulator_single_map_voltage,
+	.map_voltage		= spmi_regulator_single_map_voltage,
 	.list_voltage		= spmi_regulator_common_list_voltage,
 	//.set_mode		= spmi_regulator_common_set_mode,
 	.get_mode		= spmi_regulator_common_get_mode,
@@ -2,7 +2,22 @@
 #ifndef LK2ND_BOOT_H
 #define LK2ND_BOOT_H
 
+#include <stdbool.h>
+
 void lk2nd_boot(void);
 
-#endif /* LK2ND_BOOT_H */
+/* Read the default label in the background while waiting for input */
+#if WITH_LK2ND_BOOT
+void lk2nd_boot_preload_start(void);
+void lk2nd_boot_preload_wait(void);
+void lk2nd_boot_preload_discard(void);
+#else
+static inline void lk2nd_boot_preload_start(void) {}
+static inline void lk2nd_boot_preload_wait(void) {}
+static inline void lk2nd_boot_preload_discard(void) {}
+#endif
 
+bool lk2nd_bootimg_is_v3(const void *hdr);
+int lk2nd_boot_bootimg_v3(const char *ptn_name);
+
+#endif /* LK2ND_BOOT_H */
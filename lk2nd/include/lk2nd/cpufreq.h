@@ -0,0 +1,19 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#ifndef LK2ND_CPUFREQ_H
+#define LK2ND_CPUFREQ_H
+
+/*
+ * Raise the clock of the CPU cluster lk2nd runs on for work that is limited
+ * by the CPU, e.g. decompressing the kernel (see lk2nd/cpufreq). Calls nest,
+ * the clock left by the previous bootloader is restored by the last
+ * lk2nd_cpufreq_unboost(). Without the module both do nothing.
+ */
+#if WITH_LK2ND_CPUFREQ
+void lk2nd_cpufreq_boost(void);
+void lk2nd_cpufreq_unboost(void);
+#else
+static inline void lk2nd_cpufreq_boost(void) {}
+static inline void lk2nd_cpufreq_unboost(void) {}
+#endif
+
+#endif /* LK2ND_CPUFREQ_H */
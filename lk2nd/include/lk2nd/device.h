@@ -11,10 +11,14 @@ void lk2nd_device2nd_copy_atags(void *tags, const char *cmdline,
 				void *ramdisk, unsigned ramdisk_size);
 
 #if WITH_LK2ND_DEVICE
+const void *lk2nd_device_get_dtb(void);
 const char *const *lk2nd_device_get_dtb_hints(void);
+const char *lk2nd_device_get_compatible(void);
 uint32_t lk2nd_device_get_sd_mmc_slot_num(void);
 #else
+static inline const void *lk2nd_device_get_dtb(void) { return NULL; };
 static inline const char *const *lk2nd_device_get_dtb_hints(void) { return NULL; };
+static inline const char *lk2nd_device_get_compatible(void) { return NULL; };
 static inline uint32_t lk2nd_device_get_sd_mmc_slot_num(void) { return 0; };
 #endif
 
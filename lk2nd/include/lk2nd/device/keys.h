@@ -3,8 +3,14 @@
 #define LK2ND_DEVICE_KEYS_H
 
 #include <stdint.h>
+#include <sys/types.h>
 #include <dev/keys.h>
 
+struct lk2nd_key_event {
+	uint16_t code;
+	bool pressed;
+};
+
 /**
  * lk2nd_keys_pressed() - Check if the key is pressed.
  * @keycode: Keycode to check.
@@ -22,4 +28,17 @@
  */
 bool lk2nd_keys_pressed(uint32_t keycode);
 
+/**
+ * lk2nd_keys_wait_event() - Wait for a key to be pressed or released.
+ * @ev:      Filled with the key event.
+ * @timeout: Maximum time to wait in ms, or INFINITE_TIME.
+ *
+ * The keys are scanned in the background (debounced) once this is first
+ * called. All keys are considered released at that point, so keys that
+ * are already held down produce a press event.
+ *
+ * Returns: 0 on success, ERR_TIMED_OUT if there was no event in time.
+ */
+int lk2nd_keys_wait_event(struct lk2nd_key_event *ev, time_t timeout);
+
 #endif /* LK2ND_DEVICE_KEYS_H */
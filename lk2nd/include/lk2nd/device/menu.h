@@ -15,6 +15,15 @@
  */
 int boot_menu_countdown_check(void);
 
+/**
+ * boot_menu_quick_check() - Enter the shell if a key is already pending
+ *
+ * Non-blocking replacement of the countdown for LK2ND_QUICK_BOOT.
+ *
+ * Return: 1 if key pressed (enter menu), 0 otherwise (normal boot)
+ */
+int boot_menu_quick_check(void);
+
 /**
  * lk2nd_shell() - Interactive U-Boot-style serial command prompt.
  *
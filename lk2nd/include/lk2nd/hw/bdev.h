@@ -2,7 +2,10 @@
 #ifndef LK2ND_BDEV_H
 #define LK2ND_BDEV_H
 
+struct bdev;
+
 void lk2nd_bdev_init(void);
 void lk2nd_bdev_dump_devices(void);
+int lk2nd_bdev_probe_partitions(struct bdev *bdev);
 
 #endif
@@ -82,4 +82,17 @@ void gpiol_set_asserted(struct gpiol_desc desc, bool value);
  */
 int gpiol_set_config(struct gpiol_desc *desc, uint32_t config);
 
+/**
+ * gpiol_pinctrl_apply() - Configure the TLMM pin groups of a DT node.
+ * @dtb:  pointer to the DT.
+ * @node: Offset of the node with the pinctrl-0 property.
+ *
+ * All pins of each group referenced in pinctrl-0 are configured in one pass.
+ * The groups are parsed on first use and cached, so applying a group again
+ * does not look at the DT anymore.
+ *
+ * Returns: 0 on success (or if the node has no pinctrl-0) or an error code.
+ */
+int gpiol_pinctrl_apply(const void *dtb, int node);
+
 #endif /* LK2ND_HW_GPIO_H */
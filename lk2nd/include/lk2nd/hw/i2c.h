@@ -0,0 +1,53 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#ifndef LK2ND_HW_I2C_H
+#define LK2ND_HW_I2C_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <lk2nd/hw/gpio_i2c.h>
+
+struct qup_i2c_dev;
+
+/**
+ * struct lk2nd_i2c - I2C device described in the DT.
+ * @addr: I2C address of the device (i2c-reg).
+ * @qup:  QUP controller, or %NULL if the bus is bit-banged.
+ * @gpio: GPIO pins of the bit-banged bus.
+ */
+struct lk2nd_i2c {
+	uint8_t addr;
+	struct qup_i2c_dev *qup;
+	gpio_i2c_info_t gpio;
+};
+
+/**
+ * lk2nd_i2c_get() - Get an I2C device from the DT definition.
+ * @dtb:  Pointer to the DT.
+ * @node: Offset of the node describing the device.
+ * @i2c:  Pointer to the I2C device that will be filled.
+ *
+ * The node either points to a QUP controller node with the i2c-bus phandle,
+ * or has the i2c-sda/scl-gpios properties of a bit-banged bus. The I2C
+ * address is always taken from the i2c-reg property.
+ *
+ * Returns: Status code (0 on success)
+ */
+status_t lk2nd_i2c_get(const void *dtb, int node, struct lk2nd_i2c *i2c);
+
+status_t lk2nd_i2c_write_reg_bytes(const struct lk2nd_i2c *i2c, uint8_t reg,
+				   const uint8_t *buf, size_t cnt);
+status_t lk2nd_i2c_read_reg_bytes(const struct lk2nd_i2c *i2c, uint8_t reg,
+				  uint8_t *buf, size_t cnt);
+
+#if LK2ND_I2C_QUP
+struct qup_i2c_dev *lk2nd_i2c_qup_get(const void *dtb, int node);
+status_t lk2nd_i2c_qup_write_reg_bytes(struct qup_i2c_dev *qup, uint8_t addr,
+				       uint8_t reg, const uint8_t *buf, size_t cnt);
+status_t lk2nd_i2c_qup_read_reg_bytes(struct qup_i2c_dev *qup, uint8_t addr,
+				      uint8_t reg, uint8_t *buf, size_t cnt);
+#endif
+
+#endif /* LK2ND_HW_I2C_H */
@@ -29,6 +29,8 @@ struct regulator_dev {
 struct regulator_ops {
 	int (*list_voltage)(struct regulator_dev *, unsigned selector);
 	int (*get_voltage_sel)(struct regulator_dev *);
+	int (*set_voltage_sel)(struct regulator_dev *, unsigned selector);
+	int (*map_voltage)(struct regulator_dev *, int min_uV, int max_uV);
 	int (*is_enabled)(struct regulator_dev *);
 	unsigned int (*get_mode)(struct regulator_dev *);
 	int (*get_bypass)(struct regulator_dev *, bool *enable);
@@ -48,6 +50,21 @@ static inline int regulator_get_voltage(struct regulator_dev *rdev)
 	return rdev->ops->list_voltage(rdev, sel);
 }
 
+static inline int regulator_set_voltage(struct regulator_dev *rdev,
+					int min_uV, int max_uV)
+{
+	int sel;
+
+	if (!rdev->ops || !rdev->ops->map_voltage || !rdev->ops->set_voltage_sel)
+		return -1;
+
+	sel = rdev->ops->map_voltage(rdev, min_uV, max_uV);
+	if (sel < 0)
+		return sel;
+
+	return rdev->ops->set_voltage_sel(rdev, sel);
+}
+
 static inline int regulator_is_enabled(struct regulator_dev *rdev)
 {
 	if (!rdev->ops || !rdev->ops->is_enabled)
@@ -2,9 +2,79 @@
 #ifndef LK2ND_INIT_H
 #define LK2ND_INIT_H
 
+#include <compiler.h>
+#include <kernel/event.h>
+#include <sys/types.h>
+
+/* Run the stage in its own thread, lk2nd_init() does not wait for it */
+#define LK2ND_INIT_ASYNC	(1 << 0)
+
+struct lk2nd_init_state {
+	event_t done;
+	unsigned int pos;	/* position in the order of lk2nd_init() */
+	bigtime_t time;		/* runtime of the stage function in us */
+};
+
+struct lk2nd_init_stage {
+	const char *name;
+	void (*func)(void);
+	unsigned int flags;
+	struct lk2nd_init_state *state;
+};
+
+struct lk2nd_init_dep {
+	const struct lk2nd_init_stage *stage;
+	const struct lk2nd_init_stage *after;
+};
+
 void lk2nd_init(void);
 
-#define LK2ND_INIT(func) static void (*_lk2nd_init_##func)(void) \
-	__SECTION(".lk2nd_init") __USED = (func)
+/**
+ * lk2nd_init_wait() - Wait until an init stage has finished.
+ * @name: Name of the stage (i.e. its function).
+ */
+void lk2nd_init_wait(const char *name);
+
+/**
+ * lk2nd_init_wait_all() - Wait until all init stages have finished.
+ *
+ * This must be called before anything that might interfere with the
+ * asynchronous stages, e.g. before booting the kernel.
+ */
+void lk2nd_init_wait_all(void);
+
+/**
+ * LK2ND_INIT_STAGE() - Register a function to be called by lk2nd_init().
+ * @func:  Function to call, also the name of the stage.
+ * @flags: LK2ND_INIT_* flags.
+ *
+ * Stages run in link order unless LK2ND_INIT_AFTER() or LK2ND_INIT_BEFORE()
+ * say otherwise.
+ */
+#define LK2ND_INIT_STAGE(func, flags) \
+	static struct lk2nd_init_state _lk2nd_init_state_##func; \
+	const struct lk2nd_init_stage _lk2nd_init_##func \
+	__SECTION(".lk2nd_init") __USED = { \
+		#func, (func), (flags), &_lk2nd_init_state_##func, \
+	}
+
+#define LK2ND_INIT(func) LK2ND_INIT_STAGE(func, 0)
+
+#define _LK2ND_INIT_DEP(name, stage, after) \
+	extern const struct lk2nd_init_stage _lk2nd_init_##stage; \
+	extern const struct lk2nd_init_stage _lk2nd_init_##after; \
+	static const struct lk2nd_init_dep _lk2nd_init_dep_##name \
+	__SECTION(".lk2nd_init_deps") __USED = { \
+		&_lk2nd_init_##stage, &_lk2nd_init_##after, \
+	}
+
+/*
+ * Dependencies refer to the stages by symbol, so depending on a stage
+ * that is not built fails at link time.
+ */
+#define LK2ND_INIT_AFTER(func, dep) \
+	_LK2ND_INIT_DEP(func##_after_##dep, func, dep)
+#define LK2ND_INIT_BEFORE(func, dep) \
+	_LK2ND_INIT_DEP(func##_before_##dep, dep, func)
 
 #endif /* LK2ND_INIT_H */
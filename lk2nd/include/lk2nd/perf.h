@@ -0,0 +1,65 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#ifndef LK2ND_PERF_H
+#define LK2ND_PERF_H
+
+#include <list.h>
+#include <stdint.h>
+
+struct arm_iframe;
+
+/*
+ * Profiling with the performance monitors of the CPU (see lk2nd/perf).
+ * A probe accumulates the calls, CPU cycles, L1 data cache refills and
+ * mispredicted branches of a code section, a counter just sums up values.
+ * Both are listed by "fastboot oem perf" once they were used:
+ *
+ *	LK2ND_PERF_SCOPE("bio_read");		measure until the end of the block
+ *	LK2ND_PERF_COUNT("bio_read_bytes", len);
+ *
+ * The names must stay valid, e.g. string literals. Without the lk2nd/perf
+ * module the macros expand to nothing.
+ */
+struct lk2nd_perf_probe {
+	const char *name;
+	struct list_node node;	/* in the report list after the first use */
+	uint32_t calls;
+	uint64_t cycles;
+	uint64_t l1d_refill;
+	uint64_t br_mispred;
+	uint64_t value;		/* sum of the LK2ND_PERF_COUNT() values */
+};
+
+struct lk2nd_perf_sample {
+	struct lk2nd_perf_probe *probe;
+	uint32_t cycles;
+	uint32_t l1d_refill;
+	uint32_t br_mispred;
+};
+
+#if WITH_LK2ND_PERF
+/* Set by platform_irq() for the sampling profiler ("fastboot oem profile") */
+extern struct arm_iframe *lk2nd_profile_irq_frame;
+
+struct lk2nd_perf_sample lk2nd_perf_begin(struct lk2nd_perf_probe *probe);
+void lk2nd_perf_end(struct lk2nd_perf_sample *sample);
+void lk2nd_perf_add(struct lk2nd_perf_probe *probe, uint64_t value);
+
+#define LK2ND_PERF_PROBE(var, pname) \
+	static struct lk2nd_perf_probe var = { .name = (pname) }
+
+#define LK2ND_PERF_SCOPE(pname) \
+	LK2ND_PERF_PROBE(_lk2nd_perf_probe, pname); \
+	struct lk2nd_perf_sample _lk2nd_perf_sample \
+	__attribute__((cleanup(lk2nd_perf_end))) = \
+		lk2nd_perf_begin(&_lk2nd_perf_probe)
+
+#define LK2ND_PERF_COUNT(pname, n) do { \
+	LK2ND_PERF_PROBE(_lk2nd_perf_counter, pname); \
+	lk2nd_perf_add(&_lk2nd_perf_counter, (n)); \
+} while (0)
+#else
+#define LK2ND_PERF_SCOPE(pname)
+#define LK2ND_PERF_COUNT(pname, n)	do { } while (0)
+#endif
+
+#endif /* LK2ND_PERF_H */
@@ -0,0 +1,20 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#ifndef LK2ND_RANDOM_H
+#define LK2ND_RANDOM_H
+
+#include <stddef.h>
+
+/**
+ * lk2nd_random() - Fill a buffer with random bytes.
+ * @buf: Buffer to fill
+ * @len: Number of bytes
+ *
+ * The bytes come from a ChaCha20 based generator that is seeded once with
+ * scm_random() and rekeys itself after every request, so bulk randomness
+ * does not need a secure world call for every few bytes.
+ *
+ * Return: 0 on success, negative error code if the seed could not be obtained
+ */
+int lk2nd_random(void *buf, size_t len);
+
+#endif /* LK2ND_RANDOM_H */
@@ -0,0 +1,48 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#ifndef LK2ND_SMP_H
+#define LK2ND_SMP_H
+
+#include <string.h>
+#include <sys/types.h>
+
+/*
+ * Jobs for the secondary CPUs. LK maps RAM as non-shareable, so the data
+ * caches are not coherent between the CPUs: the job struct and @in are
+ * cleaned before the job is started, @out is written back by the worker
+ * when it is done. @out must be cache line aligned and must not be touched
+ * by the boot CPU while the job is running. Jobs must not use the heap,
+ * threads or anything else in LK that is not safe to call from another CPU.
+ */
+struct lk2nd_smp_job {
+	void (*func)(struct lk2nd_smp_job *job);
+	const void *in;
+	size_t in_len;
+	void *out;
+	size_t out_len;
+};
+
+#if WITH_LK2ND_SMP
+unsigned lk2nd_smp_start(void);
+void lk2nd_smp_stop(void);
+void lk2nd_smp_run(unsigned worker, struct lk2nd_smp_job *job);
+void lk2nd_smp_wait(unsigned worker);
+void lk2nd_smp_memcpy(void *dst, const void *src, size_t len);
+void lk2nd_smp_memmove_async(void *dst, const void *src, size_t len);
+void lk2nd_smp_memmove_wait(void);
+#else
+static inline unsigned lk2nd_smp_start(void) { return 0; }
+static inline void lk2nd_smp_stop(void) {}
+static inline void lk2nd_smp_run(unsigned worker, struct lk2nd_smp_job *job) {}
+static inline void lk2nd_smp_wait(unsigned worker) {}
+static inline void lk2nd_smp_memcpy(void *dst, const void *src, size_t len)
+{
+	memcpy(dst, src, len);
+}
+static inline void lk2nd_smp_memmove_async(void *dst, const void *src, size_t len)
+{
+	memmove(dst, src, len);
+}
+static inline void lk2nd_smp_memmove_wait(void) {}
+#endif
+
+#endif /* LK2ND_SMP_H */
@@ -0,0 +1,21 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#ifndef LK2ND_TIMELINE_H
+#define LK2ND_TIMELINE_H
+
+/*
+ * Timestamps of the lk2nd boot stages (see lk2nd/timeline). @stage must stay
+ * valid (e.g. a string literal), the optional @detail is copied. The value
+ * returned by lk2nd_timeline_begin() is passed to lk2nd_timeline_end().
+ */
+#if WITH_LK2ND_TIMELINE
+unsigned lk2nd_timeline_begin(const char *stage, const char *detail);
+void lk2nd_timeline_end(unsigned id);
+#else
+static inline unsigned lk2nd_timeline_begin(const char *stage, const char *detail)
+{
+	return 0;
+}
+static inline void lk2nd_timeline_end(unsigned id) {}
+#endif
+
+#endif /* LK2ND_TIMELINE_H */
@@ -0,0 +1,54 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#ifndef LK2ND_TRACE_H
+#define LK2ND_TRACE_H
+
+#include <stdint.h>
+
+struct thread;
+
+/*
+ * Event trace of storage, USB and CPU activity on one timeline (see
+ * lk2nd/trace), exported as Chrome trace JSON by "fastboot oem trace".
+ * Begin/end pairs must nest within a thread, operations that complete
+ * somewhere else (e.g. in an interrupt) are async events with an id:
+ *
+ *	LK2ND_TRACE_SCOPE("bio_read", len);	until the end of the block
+ *	LK2ND_TRACE_BEGIN("dt_update", 0); ... LK2ND_TRACE_END("dt_update");
+ *	LK2ND_TRACE_ASYNC_BEGIN("usb_req", req, len);
+ *	LK2ND_TRACE_ASYNC_END("usb_req", req, actual);
+ *	LK2ND_TRACE_INSTANT("usb_reset", 0);
+ *
+ * The names must stay valid, e.g. string literals. Without the lk2nd/trace
+ * module the macros expand to nothing.
+ */
+#if WITH_LK2ND_TRACE
+void lk2nd_trace_event(const char *name, char phase, uintptr_t id, uint32_t arg);
+void lk2nd_trace_switch(struct thread *newthread);
+
+static inline void lk2nd_trace_scope_end(const char **name)
+{
+	lk2nd_trace_event(*name, 'E', 0, 0);
+}
+
+#define LK2ND_TRACE_BEGIN(name, arg)	lk2nd_trace_event((name), 'B', 0, (arg))
+#define LK2ND_TRACE_END(name)		lk2nd_trace_event((name), 'E', 0, 0)
+#define LK2ND_TRACE_INSTANT(name, arg)	lk2nd_trace_event((name), 'i', 0, (arg))
+#define LK2ND_TRACE_ASYNC_BEGIN(name, id, arg) \
+	lk2nd_trace_event((name), 'b', (uintptr_t)(id), (arg))
+#define LK2ND_TRACE_ASYNC_END(name, id, arg) \
+	lk2nd_trace_event((name), 'e', (uintptr_t)(id), (arg))
+
+#define LK2ND_TRACE_SCOPE(name, arg) \
+	const char *_lk2nd_trace_scope \
+	__attribute__((cleanup(lk2nd_trace_scope_end))) = (name); \
+	LK2ND_TRACE_BEGIN(_lk2nd_trace_scope, (arg))
+#else
+#define LK2ND_TRACE_BEGIN(name, arg)		do { } while (0)
+#define LK2ND_TRACE_END(name)			do { } while (0)
+#define LK2ND_TRACE_INSTANT(name, arg)		do { } while (0)
+#define LK2ND_TRACE_ASYNC_BEGIN(name, id, arg)	do { } while (0)
+#define LK2ND_TRACE_ASYNC_END(name, id, arg)	do { } while (0)
+#define LK2ND_TRACE_SCOPE(name, arg)
+#endif
+
+#endif /* LK2ND_TRACE_H */
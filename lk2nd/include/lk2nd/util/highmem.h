@@ -0,0 +1,34 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#ifndef LK2ND_UTIL_HIGHMEM_H
+#define LK2ND_UTIL_HIGHMEM_H
+
+#include <lk2nd/util/region.h>
+
+/**
+ * lk2nd_highmem_map() - Map the free RAM above the scratch memory.
+ * @ranges: Returns the mapped ranges, sorted by their start address
+ *
+ * The DDR after the end of the scratch memory is not used by lk otherwise,
+ * so it is mapped on the first call and can be used as large staging buffer
+ * (e.g. for fastboot downloads or the UMS write cache). Memory reserved in
+ * the device DT or by the RAM partition table is left out. The ranges are
+ * aligned to 1 MiB and end below 4 GiB, so they are mapped 1:1 and can be
+ * used for DMA. Users are responsible to not use them at the same time.
+ *
+ * Return: Number of ranges, 0 if there is no RAM above the scratch memory
+ */
+unsigned int lk2nd_highmem_map(const struct lk2nd_region **ranges);
+
+/**
+ * lk2nd_highmem_heap() - Get the high memory set aside for the heap.
+ * @size: Returns the size of the memory
+ *
+ * The top of the high memory is left out of the ranges of lk2nd_highmem_map(),
+ * so the heap can grow into it without overlapping fastboot downloads or any
+ * other user of the high memory or the scratch memory.
+ *
+ * Return: Start of the memory, NULL if there is none
+ */
+void *lk2nd_highmem_heap(size_t *size);
+
+#endif /* LK2ND_UTIL_HIGHMEM_H */
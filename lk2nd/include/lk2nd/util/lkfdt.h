@@ -48,6 +48,21 @@ bool lkfdt_node_is_available(const void *fdt, int node) __PURE;
  */
 int lkfdt_get_reg(const void *fdt, int parent, int node, uint32_t *addr, uint32_t *size) __PURE;
 
+/**
+ * lkfdt_set_reg() - Replace "reg" of a device tree node with one range.
+ * @fdt: Device tree blob
+ * @parent: Parent device tree node offset (should have #address/size-cells)
+ * @node: Device tree node offset
+ * @addr: Address of the range
+ * @size: Size of the range
+ *
+ * Counterpart of lkfdt_get_reg(). Unlike fdt_appendprop_addrrange() on an
+ * empty "reg", the property is written with a single fdt_setprop().
+ *
+ * Return: 0 if successful, <0 libfdt error
+ */
+int lkfdt_set_reg(void *fdt, int parent, int node, uint32_t addr, uint32_t size);
+
 /**
  * lkfdt_getprop_u32() - Read 32-bit number (e.g. phandle) from property.
  * @fdt: Device tree blob
@@ -74,6 +89,21 @@ int lkfdt_getprop_u32(const void *fdt, int node, const char *prop, uint32_t *val
 int lkfdt_u32list_get(const void *fdt, int node, const char *prop,
 		      int idx, uint32_t *val) __PURE;
 
+/**
+ * lkfdt_node_offset_by_phandle() - Find the node with the specified phandle.
+ * @fdt: Device tree blob
+ * @phandle: The phandle to search for
+ *
+ * Like fdt_node_offset_by_phandle(), but the phandles of the device tree are
+ * cached in a table, so that repeated lookups do not walk the whole tree.
+ * The table is rebuilt automatically if the device tree was modified.
+ *
+ * Return:
+ * * >= 0 - The offset of the phandle node, if successful
+ * *  < 0 - libfdt error, otherwise
+ */
+int lkfdt_node_offset_by_phandle(const void *fdt, uint32_t phandle);
+
 /**
  * lkfdt_lookup_phandle() - Read phandle from property and search for the node.
  * @fdt: Device tree blob
@@ -84,7 +114,7 @@ int lkfdt_u32list_get(const void *fdt, int node, const char *prop,
  * * >= 0 - The offset of the phandle node, if successful
  * *  < 0 - libfdt error, otherwise
  */
-int lkfdt_lookup_phandle(const void *fdt, int node, const char *prop) __PURE;
+int lkfdt_lookup_phandle(const void *fdt, int node, const char *prop);
 
 /**
  * lkfdt_subnode_offset_by_phandle() - Return subnode that matches a phandle.
@@ -48,4 +48,21 @@ bool lk2nd_mmu_map_ram_wt(const char *name, uintptr_t start, uint32_t size);
  */
 bool lk2nd_mmu_map_ram_dynamic(const char *name, uintptr_t start, uint32_t size);
 
+/**
+ * lk2nd_mmu_map_ram_wc() - Validate and map RAM as write-combined if possible
+ * @name: Name of the memory region (for debugging purposes)
+ * @start: Start address of the memory region
+ * @size: Total size of the memory region
+ *
+ * Check that @start is really part of the RAM, then try to map it as normal
+ * non-cacheable memory, where writes are combined in the write buffer but
+ * bypass the cache. This suits memory that is mostly written by the CPU and
+ * read by the hardware, e.g. framebuffers. If there are existing mappings
+ * with other flags, fall back to lk2nd_mmu_map_ram_dynamic(), so the caller
+ * must still flush the cache where necessary.
+ *
+ * Return: true if mapping was successful, false otherwise
+ */
+bool lk2nd_mmu_map_ram_wc(const char *name, uintptr_t start, uint32_t size);
+
 #endif /* LK2ND_UTIL_MMU_H */
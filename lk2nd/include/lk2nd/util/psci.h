@@ -7,6 +7,9 @@
 
 enum {
 	PSCI_F_PSCI_VERSION = 0x84000000,
+	PSCI_F_CPU_OFF = 0x84000002,
+	PSCI_F_CPU_ON = 0x84000003,
+	PSCI_F_AFFINITY_INFO = 0x84000004,
 };
 
 #define PSCI_VERSION_MAJOR(val)	BITS_SHIFT(val, 31, 16)
@@ -15,6 +18,14 @@ enum {
 enum {
 	PSCI_RET_SUCCESS = 0,
 	PSCI_RET_NOT_SUPPORTED = -1,
+	PSCI_RET_INVALID_PARAMS = -2,
+	PSCI_RET_ALREADY_ON = -4,
+};
+
+enum {
+	PSCI_AFFINITY_ON = 0,
+	PSCI_AFFINITY_OFF = 1,
+	PSCI_AFFINITY_ON_PENDING = 2,
 };
 
 static inline int32_t psci_version(void)
@@ -23,4 +34,26 @@ static inline int32_t psci_version(void)
 	return scm_call2(&arg, NULL);
 }
 
+/*
+ * scm_call2() retries while the result is 1, which is a valid result of
+ * AFFINITY_INFO, and logs all non-zero results. Make the SMC directly.
+ */
+static inline int32_t psci_call(uint32_t fn, uint32_t arg0, uint32_t arg1,
+				uint32_t arg2)
+{
+	register uint32_t r0 __asm__("r0") = fn;
+	register uint32_t r1 __asm__("r1") = arg0;
+	register uint32_t r2 __asm__("r2") = arg1;
+	register uint32_t r3 __asm__("r3") = arg2;
+
+	__asm__ volatile(
+		".arch_extension sec\n"
+		"smc	#0"
+		: "+r" (r0), "+r" (r1), "+r" (r2), "+r" (r3)
+		:
+		: "memory");
+
+	return r0;
+}
+
 #endif /* LK2ND_UTIL_PSCI_H */
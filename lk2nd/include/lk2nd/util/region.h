@@ -0,0 +1,63 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#ifndef LK2ND_UTIL_REGION_H
+#define LK2ND_UTIL_REGION_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * struct lk2nd_region - Named region of the scratch memory.
+ * @name:  Name of the region, for debugging purposes
+ * @start: Start address of the region
+ * @size:  Size of the region
+ */
+struct lk2nd_region {
+	const char *name;
+	uintptr_t start;
+	size_t size;
+};
+
+/**
+ * lk2nd_region_alloc() - Allocate a named region of the scratch memory.
+ * @name: Name of the region (for debugging purposes)
+ * @size: Size of the region
+ *
+ * Regions are placed as high as possible in the scratch memory, aligned to
+ * 1 MiB, below all other regions that are still allocated. The beginning of
+ * the scratch memory is shared with the fastboot download buffer, so data
+ * that must survive fastboot commands should be kept in a region.
+ *
+ * Return: Start of the region or %NULL if there is not enough space
+ */
+void *lk2nd_region_alloc(const char *name, size_t size);
+
+/**
+ * lk2nd_region_reserve() - Reserve a fixed range of the scratch memory.
+ * @name: Name of the region (for debugging purposes)
+ * @base: Start address of the region
+ * @size: Size of the region
+ *
+ * This is for memory that must stay at the same place, e.g. because it is
+ * shared with the OS. Reserving the same range with the same name again
+ * has no effect.
+ *
+ * Return: true if the range is reserved, false if it overlaps another region
+ */
+bool lk2nd_region_reserve(const char *name, void *base, size_t size);
+
+/**
+ * lk2nd_region_free() - Free a region of the scratch memory.
+ * @base: Start of the region, as returned by lk2nd_region_alloc()
+ */
+void lk2nd_region_free(void *base);
+
+/**
+ * lk2nd_region_list() - Get all currently allocated regions.
+ * @count: Returns the number of regions
+ *
+ * Return: The regions, sorted by their start address
+ */
+const struct lk2nd_region *lk2nd_region_list(unsigned int *count);
+
+#endif /* LK2ND_UTIL_REGION_H */
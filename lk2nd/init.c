@@ -2,15 +2,157 @@
 /* Copyright (c) 2022, Stephan Gerhold <stephan@gerhold.net> */
 
 #include <debug.h>
+#include <kernel/thread.h>
+#include <limits.h>
+#include <platform.h>
+#include <string.h>
+
 #include <lk2nd/init.h>
 
+extern const struct lk2nd_init_stage __lk2nd_init_start;
+extern const struct lk2nd_init_stage __lk2nd_init_end;
+extern const struct lk2nd_init_dep __lk2nd_init_deps_start;
+extern const struct lk2nd_init_dep __lk2nd_init_deps_end;
+
+#define for_each_stage(stage) \
+	for (stage = &__lk2nd_init_start; stage < &__lk2nd_init_end; ++stage)
+#define for_each_dep(dep) \
+	for (dep = &__lk2nd_init_deps_start; dep < &__lk2nd_init_deps_end; ++dep)
+
+#define LK2ND_INIT_UNORDERED	UINT_MAX
+
+static bool lk2nd_init_started;
+
+static bool lk2nd_init_ready(const struct lk2nd_init_stage *stage)
+{
+	const struct lk2nd_init_dep *dep;
+
+	for_each_dep(dep)
+		if (dep->stage == stage &&
+		    dep->after->state->pos == LK2ND_INIT_UNORDERED)
+			return false;
+	return true;
+}
+
+/*
+ * Assign each stage its position, in link order as far as the dependencies
+ * allow it. Stages in a dependency cycle are appended in link order and
+ * do not wait for the stages that come after them.
+ */
+static void lk2nd_init_sort(void)
+{
+	const struct lk2nd_init_stage *stage;
+	unsigned int pos = 0;
+	bool progress = true;
+
+	for_each_stage(stage)
+		stage->state->pos = LK2ND_INIT_UNORDERED;
+
+	while (progress) {
+		progress = false;
+		for_each_stage(stage) {
+			if (stage->state->pos != LK2ND_INIT_UNORDERED ||
+			    !lk2nd_init_ready(stage))
+				continue;
+			stage->state->pos = pos++;
+			progress = true;
+			break;
+		}
+	}
+
+	for_each_stage(stage) {
+		if (stage->state->pos != LK2ND_INIT_UNORDERED)
+			continue;
+		dprintf(CRITICAL, "lk2nd_init: %s is part of a dependency cycle\n",
+			stage->name);
+		stage->state->pos = pos++;
+	}
+}
+
+static void lk2nd_init_run(const struct lk2nd_init_stage *stage)
+{
+	const struct lk2nd_init_dep *dep;
+	bigtime_t start;
+
+	for_each_dep(dep)
+		if (dep->stage == stage &&
+		    dep->after->state->pos < stage->state->pos)
+			event_wait(&dep->after->state->done);
+
+	start = current_time_hires();
+	stage->func();
+	stage->state->time = current_time_hires() - start;
+
+	dprintf(INFO, "lk2nd_init: %s took %llu us\n",
+		stage->name, stage->state->time);
+	event_signal(&stage->state->done, true);
+}
+
+static int lk2nd_init_thread(void *arg)
+{
+	lk2nd_init_run(arg);
+	return 0;
+}
+
+static void lk2nd_init_start(const struct lk2nd_init_stage *stage)
+{
+	thread_t *thread;
+
+	if (stage->flags & LK2ND_INIT_ASYNC) {
+		thread = thread_create(stage->name, lk2nd_init_thread,
+				       (void *)stage, DEFAULT_PRIORITY,
+				       DEFAULT_STACK_SIZE);
+		if (thread) {
+			thread_resume(thread);
+			return;
+		}
+	}
+	lk2nd_init_run(stage);
+}
+
 void lk2nd_init(void)
 {
-	extern void (*__lk2nd_init_start)(void);
-	extern void (*__lk2nd_init_end)(void);
-	void (**func)(void);
+	const struct lk2nd_init_stage *stage;
+	unsigned int pos, count = 0;
 
 	dprintf(INFO, "lk2nd_init()\n");
-	for (func = &__lk2nd_init_start; func < &__lk2nd_init_end; ++func)
-		(*func)();
+
+	for_each_stage(stage) {
+		event_init(&stage->state->done, false, 0);
+		count++;
+	}
+	lk2nd_init_sort();
+	lk2nd_init_started = true;
+
+	for (pos = 0; pos < count; ++pos)
+		for_each_stage(stage)
+			if (stage->state->pos == pos)
+				lk2nd_init_start(stage);
+}
+
+void lk2nd_init_wait(const char *name)
+{
+	const struct lk2nd_init_stage *stage;
+
+	if (!lk2nd_init_started)
+		return;
+
+	for_each_stage(stage) {
+		if (!strcmp(stage->name, name)) {
+			event_wait(&stage->state->done);
+			return;
+		}
+	}
+	dprintf(CRITICAL, "lk2nd_init: Unknown stage: %s\n", name);
+}
+
+void lk2nd_init_wait_all(void)
+{
+	const struct lk2nd_init_stage *stage;
+
+	if (!lk2nd_init_started)
+		return;
+
+	for_each_stage(stage)
+		event_wait(&stage->state->done);
 }
@@ -0,0 +1,213 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <bits.h>
+#include <debug.h>
+#include <fastboot.h>
+#include <kernel/thread.h>
+#include <list.h>
+#include <printf.h>
+#include <string.h>
+
+#include <lk2nd/init.h>
+#include <lk2nd/perf.h>
+
+/*
+ * perf.c - Cycle-accurate profiling with the ARMv7 performance monitors.
+ *
+ * The cycle counter (PMCCNTR) and two event counters are enabled on the
+ * boot CPU. The event counters count the architectural events for L1 data
+ * cache refills and mispredicted branches, which are implemented by all
+ * the Cortex-A cores and Krait.
+ *
+ * A sample is the difference of the 32-bit counters, so a single probed
+ * section must take less than 2^32 cycles (a few seconds). Probes are
+ * inclusive: a probe around bio_read() also counts the cycles spent in the
+ * mmc_sdhci_read() probe it calls, and in other threads that ran meanwhile.
+ * Probes used before the PMU is set up in lk2nd_init() only count calls.
+ */
+
+#define PMCR_E			(1 << 0)
+#define PMCR_P			(1 << 1)
+#define PMCR_C			(1 << 2)
+#define PMCR_D			(1 << 3)
+#define PMCR_N(pmcr)		(((pmcr) >> 11) & 0x1f)
+#define PMCNTEN_CYCLES		(1U << 31)
+
+#define PERF_EVENT_L1D_REFILL	0x03
+#define PERF_EVENT_BR_MISPRED	0x10
+
+#define PERF_COUNTER_L1D_REFILL	0
+#define PERF_COUNTER_BR_MISPRED	1
+
+static struct list_node perf_probes = LIST_INITIAL_VALUE(perf_probes);
+static bool perf_cycles, perf_events;
+
+#if ARM_ISA_ARMV7
+static inline uint32_t perf_read_cycles(void)
+{
+	uint32_t val;
+
+	__asm__ volatile("mrc p15, 0, %0, c9, c13, 0" : "=r"(val));
+	return val;
+}
+
+static inline void perf_select(uint32_t counter)
+{
+	__asm__ volatile("mcr p15, 0, %0, c9, c12, 5" :: "r"(counter));
+	__asm__ volatile("isb");
+}
+
+static inline uint32_t perf_read_event(uint32_t counter)
+{
+	uint32_t val;
+
+	perf_select(counter);
+	__asm__ volatile("mrc p15, 0, %0, c9, c13, 2" : "=r"(val));
+	return val;
+}
+
+static void perf_set_event(uint32_t counter, uint32_t event)
+{
+	perf_select(counter);
+	__asm__ volatile("mcr p15, 0, %0, c9, c13, 1" :: "r"(event));
+}
+
+static void lk2nd_perf_init(void)
+{
+	uint32_t dfr0, pmcr, enable = PMCNTEN_CYCLES;
+
+	/* ID_DFR0.PerfMon: 1 = PMUv1, 2 = PMUv2, 0 and 0xf = none */
+	__asm__ volatile("mrc p15, 0, %0, c0, c1, 2" : "=r"(dfr0));
+	dfr0 = (dfr0 >> 24) & 0xf;
+	if (dfr0 == 0 || dfr0 == 0xf) {
+		dprintf(INFO, "perf: No performance monitors\n");
+		return;
+	}
+
+	__asm__ volatile("mrc p15, 0, %0, c9, c12, 0" : "=r"(pmcr));
+	if (PMCR_N(pmcr) >= 2) {
+		perf_set_event(PERF_COUNTER_L1D_REFILL, PERF_EVENT_L1D_REFILL);
+		perf_set_event(PERF_COUNTER_BR_MISPRED, PERF_EVENT_BR_MISPRED);
+		enable |= BIT(PERF_COUNTER_L1D_REFILL) | BIT(PERF_COUNTER_BR_MISPRED);
+		perf_events = true;
+	}
+
+	/* Count every cycle and start all counters from 0 */
+	pmcr = (pmcr & ~PMCR_D) | PMCR_E | PMCR_P | PMCR_C;
+	__asm__ volatile("mcr p15, 0, %0, c9, c12, 1" :: "r"(enable));
+	__asm__ volatile("mcr p15, 0, %0, c9, c12, 0" :: "r"(pmcr));
+	__asm__ volatile("isb");
+	perf_cycles = true;
+
+	dprintf(INFO, "perf: Counting cycles%s\n",
+		perf_events ? ", L1D refills and branch mispredicts" : "");
+}
+LK2ND_INIT(lk2nd_perf_init);
+#else
+static inline uint32_t perf_read_cycles(void) { return 0; }
+static inline uint32_t perf_read_event(uint32_t counter) { return 0; }
+#endif
+
+struct lk2nd_perf_sample lk2nd_perf_begin(struct lk2nd_perf_probe *probe)
+{
+	struct lk2nd_perf_sample sample = { .probe = probe };
+
+	if (perf_events) {
+		sample.l1d_refill = perf_read_event(PERF_COUNTER_L1D_REFILL);
+		sample.br_mispred = perf_read_event(PERF_COUNTER_BR_MISPRED);
+	}
+	if (perf_cycles)
+		sample.cycles = perf_read_cycles();
+	return sample;
+}
+
+static void perf_register(struct lk2nd_perf_probe *probe)
+{
+	if (!probe->node.next)
+		list_add_tail(&perf_probes, &probe->node);
+}
+
+void lk2nd_perf_end(struct lk2nd_perf_sample *sample)
+{
+	struct lk2nd_perf_probe *probe = sample->probe;
+	uint32_t cycles = 0, l1d_refill = 0, br_mispred = 0;
+
+	if (perf_cycles)
+		cycles = perf_read_cycles() - sample->cycles;
+	if (perf_events) {
+		l1d_refill = perf_read_event(PERF_COUNTER_L1D_REFILL) - sample->l1d_refill;
+		br_mispred = perf_read_event(PERF_COUNTER_BR_MISPRED) - sample->br_mispred;
+	}
+
+	/* Probes are also used in interrupt handlers */
+	enter_critical_section();
+	perf_register(probe);
+	probe->calls++;
+	probe->cycles += cycles;
+	probe->l1d_refill += l1d_refill;
+	probe->br_mispred += br_mispred;
+	exit_critical_section();
+}
+
+void lk2nd_perf_add(struct lk2nd_perf_probe *probe, uint64_t value)
+{
+	enter_critical_section();
+	perf_register(probe);
+	probe->calls++;
+	probe->value += value;
+	exit_critical_section();
+}
+
+static void perf_report(const char *line)
+{
+	dprintf(INFO, "perf: %s\n", line);
+	fastboot_info(line);
+}
+
+/*
+ * The report is also written to the log, so it ends up in ramoops (see
+ * lk2nd/ramoops) if the device is rebooted before it can be read out.
+ */
+static void cmd_oem_perf(const char *arg, void *data, unsigned sz)
+{
+	char response[MAX_RSP_SIZE];
+	struct lk2nd_perf_probe *p;
+	uint32_t calls;
+
+	while (*arg == ' ')
+		arg++;
+
+	if (!strcmp(arg, "reset")) {
+		enter_critical_section();
+		list_for_every_entry(&perf_probes, p, struct lk2nd_perf_probe, node) {
+			p->calls = 0;
+			p->cycles = p->l1d_refill = p->br_mispred = p->value = 0;
+		}
+		exit_critical_section();
+		fastboot_okay("");
+		return;
+	}
+
+	if (!perf_cycles)
+		fastboot_info("No performance monitors, only counting calls");
+	else
+		perf_report("per call: cycles, L1D refills, branch mispredicts");
+
+	list_for_every_entry(&perf_probes, p, struct lk2nd_perf_probe, node) {
+		calls = p->calls;
+		if (!calls)
+			continue;
+
+		if (p->value)
+			snprintf(response, sizeof(response), "%s: %llu (%u calls)",
+				 p->name, p->value, calls);
+		else
+			snprintf(response, sizeof(response), "%s: %ux %llu %llu %llu",
+				 p->name, calls, p->cycles / calls,
+				 p->l1d_refill / calls, p->br_mispred / calls);
+		perf_report(response);
+	}
+
+	fastboot_okay("");
+}
+FASTBOOT_REGISTER("oem perf", cmd_oem_perf);
@@ -0,0 +1,221 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <arch/arm.h>
+#include <debug.h>
+#include <fastboot.h>
+#include <kernel/thread.h>
+#include <kernel/timer.h>
+#include <printf.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <lk2nd/perf.h>
+
+/*
+ * profile.c - Statistical profiler driven by the kernel timer.
+ *
+ * A periodic timer records the PC interrupted by the timer interrupt. The
+ * timer runs at the resolution of the kernel timers, which is 1 ms with
+ * PLATFORM_HAS_DYNAMIC_TIMER and 10 ms with the periodic tick otherwise.
+ * Samples in arch_idle() show the time the CPU was waiting, e.g. for USB.
+ * Code running with interrupts disabled is attributed to the place where
+ * they are enabled again.
+ *
+ * "fastboot oem profile dump" stages a text file with the build ID of lk
+ * and the sampled addresses with their number of samples, most frequent
+ * first. The addresses can be resolved with the ELF file of the same build:
+ *
+ *	awk '/^0x/ { print $1 }' profile.txt | addr2line -f -e lk
+ */
+
+#define PROFILE_SAMPLES		16384
+#define PROFILE_PERIOD		1	/* ms */
+
+struct profile_entry {
+	uint32_t pc;
+	uint32_t count;
+};
+
+extern const uint32_t __build_id_start[];
+extern const uint32_t __build_id_end[];
+
+struct arm_iframe *lk2nd_profile_irq_frame;
+
+static timer_t profile_timer;
+static uint32_t *profile_buf;
+static unsigned profile_count, profile_dropped;
+static bool profile_running;
+
+static enum handler_return profile_sample(struct timer *t, time_t now, void *arg)
+{
+	struct arm_iframe *frame = lk2nd_profile_irq_frame;
+
+	if (!frame)
+		return INT_NO_RESCHEDULE;
+
+	if (profile_count < PROFILE_SAMPLES)
+		profile_buf[profile_count++] = frame->pc;
+	else
+		profile_dropped++;
+	return INT_NO_RESCHEDULE;
+}
+
+static void profile_stop(void)
+{
+	if (!profile_running)
+		return;
+
+	timer_cancel(&profile_timer);
+	profile_running = false;
+}
+
+/* The note is "GNU\0" followed by the SHA-1 of the build, see ld --build-id */
+static void profile_build_id(char *buf, size_t size)
+{
+	const uint32_t *note = __build_id_start;
+	const uint8_t *id;
+	size_t pos = 0;
+	uint32_t i;
+
+	strlcpy(buf, "unknown", size);
+	if (__build_id_end - __build_id_start < 3)
+		return;
+
+	id = (const uint8_t *)&note[3] + ROUNDUP(note[0], 4);
+	if (id + note[1] > (const uint8_t *)__build_id_end)
+		return;
+
+	for (i = 0; i < note[1] && pos + 3 <= size; i++)
+		pos += snprintf(buf + pos, size - pos, "%02x", id[i]);
+}
+
+static int profile_cmp_pc(const void *a, const void *b)
+{
+	uint32_t pa = *(const uint32_t *)a, pb = *(const uint32_t *)b;
+
+	return (pa > pb) - (pa < pb);
+}
+
+static int profile_cmp_count(const void *a, const void *b)
+{
+	const struct profile_entry *ea = a, *eb = b;
+
+	if (ea->count != eb->count)
+		return ea->count < eb->count ? 1 : -1;
+	return profile_cmp_pc(&ea->pc, &eb->pc);
+}
+
+/*
+ * LK has no qsort(), so sort with a Shell sort (a gapped insertion sort),
+ * which is fast enough for the sample buffer.
+ */
+static void profile_sort(void *base, unsigned n, size_t size,
+			 int (*cmp)(const void *, const void *))
+{
+	struct profile_entry tmp;
+	uint8_t *b = base;
+	unsigned gap, i, j;
+
+	ASSERT(size <= sizeof(tmp));
+
+	for (gap = n / 2; gap; gap /= 2) {
+		for (i = gap; i < n; i++) {
+			memcpy(&tmp, b + i * size, size);
+			for (j = i; j >= gap && cmp(b + (j - gap) * size, &tmp) > 0; j -= gap)
+				memcpy(b + j * size, b + (j - gap) * size, size);
+			memcpy(b + j * size, &tmp, size);
+		}
+	}
+}
+
+static void profile_dump(void)
+{
+	struct profile_entry *entries;
+	unsigned i, n = 0, len = 0, size;
+	char build_id[48];
+	char *buf;
+
+	profile_sort(profile_buf, profile_count, sizeof(*profile_buf), profile_cmp_pc);
+
+	entries = malloc(profile_count * sizeof(*entries));
+	if (!entries) {
+		fastboot_fail("out of memory");
+		return;
+	}
+
+	for (i = 0; i < profile_count; i++) {
+		if (n && entries[n - 1].pc == profile_buf[i]) {
+			entries[n - 1].count++;
+			continue;
+		}
+		entries[n].pc = profile_buf[i];
+		entries[n].count = 1;
+		n++;
+	}
+	profile_sort(entries, n, sizeof(*entries), profile_cmp_count);
+
+	/* "0x12345678 12345\n" for each address, plus the header */
+	size = n * 20 + 256;
+	buf = malloc(size);
+	if (!buf) {
+		free(entries);
+		fastboot_fail("out of memory");
+		return;
+	}
+
+	profile_build_id(build_id, sizeof(build_id));
+	len += snprintf(buf + len, size - len,
+			"# lk2nd profile\n# build-id: %s\n"
+			"# samples: %u, dropped: %u, period: %u ms\n",
+			build_id, profile_count, profile_dropped, PROFILE_PERIOD);
+	for (i = 0; i < n; i++)
+		len += snprintf(buf + len, size - len, "0x%08x %u\n",
+				entries[i].pc, entries[i].count);
+
+	fastboot_stage(buf, len);
+	free(buf);
+	free(entries);
+}
+
+static void cmd_oem_profile(const char *arg, void *data, unsigned sz)
+{
+	char response[MAX_RSP_SIZE];
+
+	while (*arg == ' ')
+		arg++;
+
+	if (!strcmp(arg, "start")) {
+		profile_stop();
+		if (!profile_buf)
+			profile_buf = malloc(PROFILE_SAMPLES * sizeof(*profile_buf));
+		if (!profile_buf) {
+			fastboot_fail("out of memory");
+			return;
+		}
+
+		profile_count = profile_dropped = 0;
+		profile_running = true;
+		timer_initialize(&profile_timer);
+		timer_set_periodic(&profile_timer, PROFILE_PERIOD, profile_sample, NULL);
+		fastboot_okay("");
+	} else if (!strcmp(arg, "stop")) {
+		profile_stop();
+		snprintf(response, sizeof(response), "%u samples, %u dropped",
+			 profile_count, profile_dropped);
+		fastboot_info(response);
+		fastboot_okay("");
+	} else if (!strcmp(arg, "dump")) {
+		if (profile_running) {
+			fastboot_fail("profiler is running");
+			return;
+		}
+		if (!profile_count) {
+			fastboot_fail("no samples");
+			return;
+		}
+		profile_dump();
+	} else {
+		fastboot_fail("usage: oem profile start|stop|dump");
+	}
+}
+FASTBOOT_REGISTER("oem profile", cmd_oem_profile);
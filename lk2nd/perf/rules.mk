@@ -0,0 +1,9 @@
+# SPDX-License-Identifier: BSD-3-Clause
+LOCAL_DIR := $(GET_LOCAL_DIR)
+
+OBJS += \
+	$(LOCAL_DIR)/perf.o \
+	$(LOCAL_DIR)/profile.o \
+
+# The build ID identifies the lk ELF file for the "oem profile" addresses
+LDFLAGS += --build-id
@@ -31,6 +31,7 @@ MODULES += \
 	lk2nd/serialno \
 	lk2nd/smp \
 	lk2nd/smp/spin-table \
+	lk2nd/timeline \
 	lk2nd/version \
 
 ifneq ($(filter ENABLE_KASLRSEED_SUPPORT=1,$(DEFINES)),)
@@ -64,6 +65,18 @@ ifdef LK2ND_FASTBOOT_DELAY
 	DEFINES += LK2ND_FASTBOOT_DELAY=$(LK2ND_FASTBOOT_DELAY)
 endif
 
+ifeq ($(LK2ND_PERF), 1)
+MODULES += lk2nd/perf
+endif
+
+ifeq ($(LK2ND_TRACE), 1)
+MODULES += lk2nd/trace
+endif
+
+ifeq ($(LK2ND_HEAP_PROFILE), 1)
+DEFINES += HEAP_PROFILE=1
+endif
+
 # Keep the kernel command line clean when booting other operating systems
 DEFINES += GENERATE_CMDLINE_ONLY_FOR_ANDROID=1
 
@@ -81,7 +94,10 @@ DEFINES := $(filter-out CHECK_BAT_VOLTAGE=1, $(DEFINES))
 
 include $(if $(filter msm8660 msm8960, $(TARGET)), lk2nd/project/msm8x60.mk)
 
-# Enable extlinux boot module for all targets with eMMC/UFS
+# Enable extlinux boot module for all targets with eMMC/UFS, and for raw NAND
+# targets through the NAND block devices of lk2nd/hw/bdev
 ifeq ($(EMMC_BOOT), 1)
 MODULES += lk2nd/boot
+else ifneq ($(filter mdm9607 mdm9625 mdm9635 mdm9640, $(TARGET)),)
+MODULES += lk2nd/boot
 endif
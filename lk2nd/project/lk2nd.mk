@@ -1,6 +1,8 @@
 # SPDX-License-Identifier: BSD-3-Clause
 LK2ND_PROJECT := lk2nd
 LK2ND_DISPLAY ?= cont-splash
+# Initialize the display in a separate thread while the boot image is loaded
+LK2ND_DISPLAY_ASYNC ?= 0
 LK2ND_SKIP_GDSC_CHECK ?= 0
 # When set to 1, render the fastboot/lk2nd menu on the serial console instead of the framebuffer
 LK2ND_SERIAL_MENU ?= 0
@@ -11,9 +13,13 @@ LK2ND_BOOT_COUNTDOWN ?= 1
 LK2ND_USB_CONSOLE ?= 1
 # Boot menu countdown duration in seconds (before auto-booting)
 LK2ND_MENU_TIMEOUT ?= 10
+# Boot without countdown, display and USB console, bring them up on failure
+LK2ND_QUICK_BOOT ?= 0
 # USB Mass Storage configuration
 LK2ND_UMS ?= 0
 LK2ND_UMS_PARTITION ?= userdata
+LK2ND_UMS_UAS ?= 0
+LK2ND_UMS_WRITE_CACHE ?= 0
 # RAUC-style A/B boot bootstrap: where the U-Boot environment lives.
 # The partition is resolved by name or GPT label; slot offsets are fallback
 # defaults, overridable at runtime via the BOOT_A_OFFSET/BOOT_B_OFFSET env
@@ -23,6 +29,8 @@ LK2ND_UMS_PARTITION ?= userdata
 LK2ND_AB_BOOT ?= 1
 LK2ND_AB_ENV_PART ?= userdata
 LK2ND_AB_ENV_OFFSET ?= 0x10000
+# Second copy of a redundant env (U-Boot CONFIG_ENV_OFFSET_REDUND), 0 = none
+LK2ND_AB_ENV_OFFSET_REDUND ?= 0
 LK2ND_AB_ENV_SIZE ?= 0x20000
 LK2ND_AB_SLOT_OFFSET_A ?= 0
 LK2ND_AB_SLOT_OFFSET_B ?= 0
@@ -48,10 +56,26 @@ DEFINES += LK2ND_USB_CONSOLE=1
 endif
 DEFINES += LK2ND_MENU_TIMEOUT=$(LK2ND_MENU_TIMEOUT)
 
+# Quick boot (replaces the countdown and defers display init)
+ifeq ($(LK2ND_QUICK_BOOT),1)
+DEFINES += LK2ND_QUICK_BOOT=1
+endif
+
 # USB Mass Storage support
 ifeq ($(LK2ND_UMS),1)
 DEFINES += LK2ND_UMS=1
 DEFINES += LK2ND_UMS_PARTITION=$(LK2ND_UMS_PARTITION)
+ifeq ($(LK2ND_UMS_UAS),1)
+DEFINES += LK2ND_UMS_UAS=1
+endif
+ifeq ($(LK2ND_UMS_WRITE_CACHE),1)
+DEFINES += LK2ND_UMS_WRITE_CACHE=1
+endif
+endif
+
+# Asynchronous display initialization
+ifeq ($(LK2ND_DISPLAY_ASYNC),1)
+DEFINES += LK2ND_DISPLAY_ASYNC=1
 endif
 
 # Serial menu support
@@ -64,6 +88,7 @@ ifeq ($(LK2ND_AB_BOOT),1)
 DEFINES += LK2ND_AB_BOOT=1
 DEFINES += LK2ND_AB_ENV_PART=$(LK2ND_AB_ENV_PART)
 DEFINES += LK2ND_AB_ENV_OFFSET=$(LK2ND_AB_ENV_OFFSET)
+DEFINES += LK2ND_AB_ENV_OFFSET_REDUND=$(LK2ND_AB_ENV_OFFSET_REDUND)
 DEFINES += LK2ND_AB_ENV_SIZE=$(LK2ND_AB_ENV_SIZE)
 DEFINES += LK2ND_AB_SLOT_OFFSET_A=$(LK2ND_AB_SLOT_OFFSET_A)
 DEFINES += LK2ND_AB_SLOT_OFFSET_B=$(LK2ND_AB_SLOT_OFFSET_B)
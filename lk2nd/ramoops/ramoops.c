@@ -5,14 +5,19 @@
 #include <compiler.h>
 #include <debug.h>
 #include <fastboot.h>
+#include <lib/lz4.h>
 #include <libfdt.h>
 #include <printf.h>
+#include <stdlib.h>
 #include <string.h>
 #include <target.h>
 #include <zlib.h>
 
+#include <lk2nd/init.h>
 #include <lk2nd/ramoops.h>
 #include <lk2nd/util/cmdline.h>
+#include <lk2nd/util/lkfdt.h>
+#include <lk2nd/util/region.h>
 
 #define PERSISTENT_RAM_SIG (0x43474244) /* DBGC */
 
@@ -48,12 +53,55 @@ static void get_ramoops_region(struct ramoops_region *region)
 	 */
 	region->record_size	= 8 * 1024;
 	region->console_size	= 256 * 1024;
+#if WITH_DEBUG_LOG_BUF
+	/* The lk log, see lk2nd_ramoops_init() */
+	region->pmsg_size	= 32 * 1024;
+#else
 	region->pmsg_size	= 0;
+#endif
 	region->ftrace_size	= 0;
 
 	region->dump_size	= region->size - region->console_size - region->ftrace_size - region->pmsg_size;
 	region->base		= (scratch + scratch_size - region->size);
+
+	/* Keep other users of the scratch memory away from the records */
+	lk2nd_region_reserve("ramoops", region->base, region->size);
+}
+
+/*
+ * The lk log is written directly into the pmsg record, in the same format
+ * as the kernel uses for the records. When the region is passed to the
+ * kernel it shows up as /sys/fs/pstore/pmsg-ramoops-0 without copying
+ * anything before booting.
+ */
+static struct pram_buf *ramoops_pmsg_record(struct ramoops_region *region)
+{
+	return (struct pram_buf *)((uint8_t *)region->base + region->dump_size +
+				   region->console_size + region->ftrace_size);
+}
+
+static void ramoops_zap(struct ramoops_region *region)
+{
+	/* Keep the lk log of the current boot */
+	memset(region->base, 0, region->size - region->pmsg_size);
+}
+
+static void lk2nd_ramoops_init(void)
+{
+	struct ramoops_region region;
+	struct pram_buf *record;
+
+	get_ramoops_region(&region);
+
+	if (!region.pmsg_size)
+		return;
+
+	record = ramoops_pmsg_record(&region);
+	record->sig = PERSISTENT_RAM_SIG;
+	log_relocate(record->data, region.pmsg_size - sizeof(*record),
+		     &record->offt, &record->size);
 }
+LK2ND_INIT(lk2nd_ramoops_init);
 
 
 static int lk2nd_ramoops_dt_update(void *dtb, const char *cmdline, enum boot_type boot_type)
@@ -71,7 +119,7 @@ static int lk2nd_ramoops_dt_update(void *dtb, const char *cmdline, enum boot_typ
 	get_ramoops_region(&region);
 
 	if (!strcmp(args, "zap"))
-		memset(region.base, 0, region.size);
+		ramoops_zap(&region);
 
 	rmem_offset = fdt_path_offset(dtb, "/reserved-memory");
 	if (rmem_offset < 0)
@@ -92,12 +140,7 @@ static int lk2nd_ramoops_dt_update(void *dtb, const char *cmdline, enum boot_typ
 			return 0;
 	}
 
-	ret = fdt_setprop_empty(dtb, offset, "reg");
-	if (ret < 0)
-		return 0;
-
-	ret = fdt_appendprop_addrrange(dtb, rmem_offset, offset, "reg",
-				       (uint32_t)region.base, region.size);
+	ret = lkfdt_set_reg(dtb, rmem_offset, offset, (uint32_t)region.base, region.size);
 	if (ret < 0)
 		return 0;
 
@@ -125,12 +168,48 @@ static int lk2nd_ramoops_dt_update(void *dtb, const char *cmdline, enum boot_typ
 }
 DEV_TREE_UPDATE(lk2nd_ramoops_dt_update);
 
+/*
+ * All ramoops commands take an optional "lz4" argument to compress the
+ * staged data (decompress with "lz4 -d" on the host). Most of the region
+ * is usually empty or repetitive text, so this is much faster over USB.
+ */
+static bool ramoops_want_lz4(const char *arg)
+{
+	while (*arg == ' ')
+		arg++;
+	return !strcmp(arg, "lz4");
+}
+
+static void ramoops_stage(const void *data, size_t size, bool lz4)
+{
+	size_t bound = lz4_compress_bound(size);
+	void *buf;
+
+	if (!lz4) {
+		fastboot_stage(data, size);
+		return;
+	}
+
+	buf = lk2nd_region_alloc("ramoops-lz4", bound);
+	if (!buf) {
+		fastboot_fail("not enough scratch memory");
+		return;
+	}
+
+	size = lz4_compress(data, size, buf);
+	if (size)
+		fastboot_stage(buf, size);
+	else
+		fastboot_fail("out of memory");
+	lk2nd_region_free(buf);
+}
+
 static void cmd_oem_ramoops_raw(const char *arg, void *data, unsigned sz)
 {
 	struct ramoops_region region;
 
 	get_ramoops_region(&region);
-	fastboot_stage(region.base, region.size);
+	ramoops_stage(region.base, region.size, ramoops_want_lz4(arg));
 }
 FASTBOOT_REGISTER("oem ramoops raw", cmd_oem_ramoops_raw);
 
@@ -201,50 +280,79 @@ static void cmd_oem_ramoops_console(const char *arg, void *data, unsigned sz)
 	record_base = region.base + region.dump_size;
 	record = (struct pram_buf*)record_base;
 
-	fastboot_stage(record->data, record->size);
+	ramoops_stage(record->data, record->size, ramoops_want_lz4(arg));
 }
 FASTBOOT_REGISTER("oem ramoops console", cmd_oem_ramoops_console);
 
-static void cmd_oem_ramoops_dump(const char *arg, void *data, unsigned sz)
+/*
+ * Collect the text of all dump records into buf, each with a header line.
+ * Records that were never written (or are corrupted) are skipped.
+ */
+static size_t ramoops_collect_dumps(struct ramoops_region *region,
+				   uint8_t *buf, size_t size)
 {
-	unsigned long size = target_get_max_flash_size();
-	void *scratch = target_get_scratch_address();
-	struct ramoops_region region;
-	char response[MAX_RSP_SIZE];
 	struct pram_buf *record;
 	struct kmsg_hdr *header;
 	uint8_t *record_base;
-	int ret;
+	unsigned long len;
+	unsigned int i, count;
+	size_t pos = 0;
 
-	get_ramoops_region(&region);
+	record_base = region->base;
+	count = region->dump_size / region->record_size;
+	for (i = 0; i < count && pos < size; i++, record_base += region->record_size) {
+		record = (struct pram_buf *)record_base;
+		if (record->sig != PERSISTENT_RAM_SIG ||
+		    record->size < sizeof(*header))
+			continue;
 
-	record_base = region.base;
-	record = (struct pram_buf*)record_base;
-	header = (struct kmsg_hdr*)record->data;
+		header = (struct kmsg_hdr *)record->data;
+		if (header->magic != RAMOOPS_KERNMSG_HDR)
+			continue;
 
-	/*
-	 * FIXME: this is pretty much useless right now.
-	 * 1) This only checks the first record, not all of them.
-	 * 2) This can't really work without ECC...
-	 */
+		pos += snprintf((char *)buf + pos, size - pos,
+				"--- dump %u (%.17s) ---\n", i, header->time);
+		if (pos >= size)
+			return size;
 
-	memset(scratch, 0, record->size);
+		len = size - pos;
+		if (header->compressed == 'C') {
+			if (uncompress(buf + pos, &len, header->data,
+				       record->size) != Z_OK)
+				len = snprintf((char *)buf + pos, size - pos,
+					       "(decompression failed)\n");
+		} else {
+			len = MIN(len, record->size - sizeof(*header));
+			memcpy(buf + pos, header->data, len);
+		}
+		pos += MIN(len, size - pos);
+	}
 
-	if (header->magic != RAMOOPS_KERNMSG_HDR)
-		fastboot_fail("Dump corrupted.");
+	return pos;
+}
 
-	if (header->compressed == 'C') {
-		ret = uncompress(scratch, &size, header->data, record->size);
-		snprintf(response, sizeof(response), "ramoops decompress is %d", ret);
-		fastboot_info(response);
-		if (ret < 0)
-			fastboot_fail("Decompression failed.");
-	} else {
-		size = record->size - sizeof(struct kmsg_hdr);
-		memcpy(scratch, header->data, size);
+static void cmd_oem_ramoops_dump(const char *arg, void *data, unsigned sz)
+{
+	struct ramoops_region region;
+	size_t size;
+	uint8_t *buf;
+
+	get_ramoops_region(&region);
+
+	/* Compressed records may expand to a few times their size */
+	size = 4 * region.dump_size;
+	buf = lk2nd_region_alloc("ramoops-dump", size);
+	if (!buf) {
+		fastboot_fail("not enough scratch memory");
+		return;
 	}
 
-	fastboot_stage(scratch, size);
+	size = ramoops_collect_dumps(&region, buf, size);
+	if (size)
+		ramoops_stage(buf, size, ramoops_want_lz4(arg));
+	else
+		fastboot_fail("No dump records.");
+	lk2nd_region_free(buf);
 }
 FASTBOOT_REGISTER("oem ramoops dump", cmd_oem_ramoops_dump);
 
@@ -350,7 +458,7 @@ void lk2nd_ramoops_print_dumps(void)
 			/* Decompress into the scratch region, like
 			 * cmd_oem_ramoops_dump does */
 			scratch = target_get_scratch_address();
-			scratch_size = target_get_max_flash_size();
+			scratch_size = (uint8_t *)region.base - scratch;
 			if (uncompress(scratch, &scratch_size, header->data,
 				       record->size) != Z_OK) {
 				printf("(decompression failed)\n");
@@ -372,6 +480,6 @@ void lk2nd_ramoops_zap(void)
 	struct ramoops_region region;
 
 	get_ramoops_region(&region);
-	memset(region.base, 0, region.size);
+	ramoops_zap(&region);
 	printf("ramoops region cleared\n");
 }
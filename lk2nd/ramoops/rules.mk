@@ -1,6 +1,8 @@
 # SPDX-License-Identifier: BSD-3-Clause
 LOCAL_DIR := $(GET_LOCAL_DIR)
-MODULES += lib/libfdt
+MODULES += \
+	lib/libfdt \
+	lib/lz4 \
 
 OBJS += \
 	$(LOCAL_DIR)/ramoops.o \
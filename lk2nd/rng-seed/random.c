@@ -0,0 +1,115 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <debug.h>
+#include <err.h>
+#include <kernel/thread.h>
+#include <scm.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <lk2nd/random.h>
+
+/*
+ * ChaCha20 (RFC 8439) keystream generator with "fast key erasure": the first
+ * half of the first block of every request replaces the key, and the rest of
+ * the request comes from the following blocks. The state never allows
+ * reconstructing output that was already handed out. The block counter
+ * starts at 0 for every request since the key is different each time.
+ */
+#define CHACHA_BLOCK_WORDS	16
+#define CHACHA_KEY_WORDS	8
+
+static uint32_t random_key[CHACHA_KEY_WORDS];
+static bool random_seeded;
+
+#define ROTL32(v, n)	((v) << (n) | (v) >> (32 - (n)))
+
+#define CHACHA_QR(a, b, c, d) do {		\
+	a += b; d ^= a; d = ROTL32(d, 16);	\
+	c += d; b ^= c; b = ROTL32(b, 12);	\
+	a += b; d ^= a; d = ROTL32(d, 8);	\
+	c += d; b ^= c; b = ROTL32(b, 7);	\
+} while (0)
+
+static void chacha20_block(uint32_t x[CHACHA_BLOCK_WORDS],
+			   const uint32_t key[CHACHA_KEY_WORDS], uint32_t counter)
+{
+	const uint32_t in[CHACHA_BLOCK_WORDS] = {
+		0x61707865, 0x3320646e, 0x79622d32, 0x6b206574,	/* "expand 32-byte k" */
+		key[0], key[1], key[2], key[3],
+		key[4], key[5], key[6], key[7],
+		counter, 0, 0, 0,
+	};
+	int i;
+
+	memcpy(x, in, sizeof(in));
+	for (i = 0; i < 10; i++) {
+		CHACHA_QR(x[0], x[4], x[8], x[12]);
+		CHACHA_QR(x[1], x[5], x[9], x[13]);
+		CHACHA_QR(x[2], x[6], x[10], x[14]);
+		CHACHA_QR(x[3], x[7], x[11], x[15]);
+		CHACHA_QR(x[0], x[5], x[10], x[15]);
+		CHACHA_QR(x[1], x[6], x[11], x[12]);
+		CHACHA_QR(x[2], x[7], x[8], x[13]);
+		CHACHA_QR(x[3], x[4], x[9], x[14]);
+	}
+	for (i = 0; i < CHACHA_BLOCK_WORDS; i++)
+		x[i] += in[i];
+}
+
+static int lk2nd_random_seed(void)
+{
+	uint32_t seed[CHACHA_KEY_WORDS];
+	int ret;
+
+	ret = scm_random((uintptr_t *)seed, sizeof(seed));
+	if (ret) {
+		dprintf(INFO, "random: scm_random() failed: %d\n", ret);
+		return ERR_NOT_READY;
+	}
+
+	enter_critical_section();
+	if (!random_seeded) {
+		memcpy(random_key, seed, sizeof(random_key));
+		random_seeded = true;
+	}
+	exit_critical_section();
+
+	memset(seed, 0, sizeof(seed));
+	return NO_ERROR;
+}
+
+int lk2nd_random(void *buf, size_t len)
+{
+	uint32_t key[CHACHA_KEY_WORDS], block[CHACHA_BLOCK_WORDS];
+	uint8_t *out = buf;
+	uint32_t counter = 0;
+	size_t n;
+
+	if (!random_seeded && lk2nd_random_seed())
+		return ERR_NOT_READY;
+
+	/* Take the current key and replace it before generating anything */
+	enter_critical_section();
+	memcpy(key, random_key, sizeof(key));
+	chacha20_block(block, key, counter++);
+	memcpy(random_key, block, sizeof(random_key));
+	exit_critical_section();
+
+	n = MIN(len, sizeof(block) - sizeof(random_key));
+	memcpy(out, &block[CHACHA_KEY_WORDS], n);
+	out += n;
+	len -= n;
+
+	while (len) {
+		chacha20_block(block, key, counter++);
+		n = MIN(len, sizeof(block));
+		memcpy(out, block, n);
+		out += n;
+		len -= n;
+	}
+
+	memset(key, 0, sizeof(key));
+	memset(block, 0, sizeof(block));
+	return NO_ERROR;
+}
@@ -12,25 +12,23 @@
 /**
  * lk2nd_rng_seed_dt_update() - write a random seed to /chosen/rng-seed
  *
- * scm_random() is used to generate the entropy in a best-effort manner.
+ * scm_random() is used to generate the entropy in a best-effort manner,
+ * the whole seed is requested with a single call into the secure world.
  * failures are logged, but do not fail the boot
  */
 static int lk2nd_rng_seed_dt_update(void *dtb, const char *cmdline,
 				    enum boot_type boot_type)
 {
 	uintptr_t rngseed[RNG_SEED_BYTES / sizeof(uintptr_t)];
-	unsigned int i;
 	int offset, ret;
 
 	if (boot_type & (BOOT_DOWNSTREAM | BOOT_LK2ND))
 		return 0;
 
-	for (i = 0; i < ARRAY_SIZE(rngseed); i++) {
-		ret = scm_random(&rngseed[i], sizeof(rngseed[i]));
-		if (ret) {
-			dprintf(INFO, "rng-seed: scm_call for random failed: %d\n", ret);
-			return 0;
-		}
+	ret = scm_random(rngseed, sizeof(rngseed));
+	if (ret) {
+		dprintf(INFO, "rng-seed: scm_call for random failed: %d\n", ret);
+		return 0;
 	}
 
 	offset = fdt_path_offset(dtb, "/chosen");
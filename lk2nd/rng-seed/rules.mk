@@ -3,4 +3,5 @@ LOCAL_DIR := $(GET_LOCAL_DIR)
 MODULES += lib/libfdt
 
 OBJS += \
-	$(LOCAL_DIR)/rng-seed.o
+	$(LOCAL_DIR)/random.o \
+	$(LOCAL_DIR)/rng-seed.o \
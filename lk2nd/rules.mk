@@ -22,4 +22,14 @@ endif
 $(BUILDDIR)/$(LOCAL_DIR)/%.o: CFLAGS := $(CFLAGS) -Wmissing-prototypes
 
 OBJS += $(LOCAL_DIR)/init.o
+
+# CPU clock boost, only for SoCs with a table for the clock of the boot
+# cluster. The Krait clocks of e.g. msm8974 have no driver in lk.
+LK2ND_CPUFREQ ?= 1
+ifeq ($(LK2ND_CPUFREQ), 1)
+ifneq ($(wildcard $(LOCAL_DIR)/cpufreq/soc-$(PLATFORM).c),)
+MODULES += lk2nd/cpufreq
+endif
+endif
+
 include $(LOCAL_DIR)/util/rules.mk
@@ -0,0 +1,161 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: BSD-3-Clause
+"""
+Convert the RSA public key of a certificate into a C header with a
+struct rsa_key (see platform/msm_shared/include/rsa_key.h), so that
+signatures can be checked without parsing the certificate at runtime.
+
+The modulus and R^2 mod n are stored as little endian arrays of 32-bit
+words, together with -1 / n[0] mod 2^32 for the Montgomery multiplication.
+PEM or DER encoded X.509 certificates, SubjectPublicKeyInfo ("PUBLIC KEY")
+and PKCS#1 ("RSA PUBLIC KEY") keys are accepted.
+"""
+import argparse
+import base64
+import re
+import sys
+
+RSA_ENCRYPTION = bytes.fromhex("2a864886f70d010101")  # 1.2.840.113549.1.1.1
+
+
+def der_read(data, pos):
+    """Return tag, value and the position after one DER element."""
+    tag = data[pos]
+    length = data[pos + 1]
+    pos += 2
+    if length & 0x80:
+        n = length & 0x7f
+        length = int.from_bytes(data[pos:pos + n], "big")
+        pos += n
+    if pos + length > len(data):
+        raise ValueError("truncated DER data")
+    return tag, data[pos:pos + length], pos + length
+
+
+def der_items(data):
+    items = []
+    pos = 0
+    while pos < len(data):
+        tag, value, pos = der_read(data, pos)
+        items.append((tag, value))
+    return items
+
+
+def rsa_public_key(data):
+    """RSAPublicKey ::= SEQUENCE { modulus INTEGER, publicExponent INTEGER }"""
+    tag, value, _ = der_read(data, 0)
+    items = der_items(value) if tag == 0x30 else []
+    if len(items) != 2 or items[0][0] != 0x02 or items[1][0] != 0x02:
+        raise ValueError("not an RSA public key")
+    return (int.from_bytes(items[0][1], "big"),
+            int.from_bytes(items[1][1], "big"))
+
+
+def spki_key(items):
+    """SubjectPublicKeyInfo ::= SEQUENCE { algorithm, subjectPublicKey }"""
+    if len(items) != 2 or items[0][0] != 0x30 or items[1][0] != 0x03:
+        return None
+    alg = der_items(items[0][1])
+    if not alg or alg[0] != (0x06, RSA_ENCRYPTION):
+        return None
+    # Skip the number of unused bits of the BIT STRING
+    return rsa_public_key(items[1][1][1:])
+
+
+def find_key(der):
+    tag, value, _ = der_read(der, 0)
+    if tag != 0x30:
+        raise ValueError("not a DER sequence")
+    items = der_items(value)
+
+    key = spki_key(items)
+    if key:
+        return key
+
+    # Certificate: the key is somewhere in the tbsCertificate sequence
+    if items and items[0][0] == 0x30:
+        for tag, value in der_items(items[0][1]):
+            if tag == 0x30:
+                key = spki_key(der_items(value))
+                if key:
+                    return key
+
+    return rsa_public_key(der)
+
+
+def read_der(path):
+    with open(path, "rb") as f:
+        data = f.read()
+
+    m = re.search(rb"-----BEGIN ([A-Z ]+)-----(.*?)-----END \1-----",
+                  data, re.S)
+    if m:
+        return base64.b64decode(b"".join(m.group(2).split()))
+    return data
+
+
+def words(value, count):
+    return [(value >> (32 * i)) & 0xffffffff for i in range(count)]
+
+
+def c_array(name, values):
+    lines = ["static const uint32_t %s[%d] = {" % (name, len(values))]
+    for i in range(0, len(values), 4):
+        lines.append("\t" + " ".join("0x%08x," % v for v in values[i:i + 4]))
+    lines.append("};")
+    return lines
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().split("\n")[0])
+    parser.add_argument("name", help="name of the struct rsa_key")
+    parser.add_argument("input", help="certificate or public key (PEM or DER)")
+    parser.add_argument("output", help="C header to write")
+    args = parser.parse_args()
+
+    try:
+        n, e = find_key(read_der(args.input))
+    except (ValueError, IndexError) as ex:
+        sys.exit("%s: %s" % (args.input, ex))
+
+    bits = n.bit_length()
+    if bits % 32 or not n & 1:
+        sys.exit("%s: unsupported %d bit modulus" % (args.input, bits))
+    if e < 3 or not e & 1 or e >> 32:
+        sys.exit("%s: unsupported exponent %d" % (args.input, e))
+
+    count = bits // 32
+    n0inv = -pow(n, -1, 1 << 32) % (1 << 32)
+    rr = (1 << (2 * bits)) % n
+    guard = "__" + re.sub(r"\W", "_", args.name).upper() + "_H"
+
+    lines = [
+        "/* Generated by rsakey2c.py from %s, do not edit */" % args.input,
+        "#ifndef " + guard,
+        "#define " + guard,
+        "",
+        "#include <rsa_key.h>",
+        "",
+    ]
+    lines += c_array(args.name + "_n", words(n, count))
+    lines.append("")
+    lines += c_array(args.name + "_rr", words(rr, count))
+    lines += [
+        "",
+        "static const struct rsa_key %s = {" % args.name,
+        "\t.len = %d," % count,
+        "\t.n0inv = 0x%08x," % n0inv,
+        "\t.e = %d," % e,
+        "\t.n = %s_n," % args.name,
+        "\t.rr = %s_rr," % args.name,
+        "};",
+        "",
+        "#endif",
+    ]
+
+    with open(args.output, "w") as f:
+        f.write("\n".join(lines) + "\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -109,7 +109,14 @@ bool cpu_boot(const void *dtb, int node, uint32_t mpidr)
 #error Unsupported CPU boot method!
 #endif
 
-	/* Give CPU some time to boot */
-	udelay(100);
 	return true;
 }
+
+/*
+ * Give the CPUs started with cpu_boot() some time to boot. The cores come up
+ * in parallel, so this is only needed once after all of them were started.
+ */
+void cpu_boot_wait(void)
+{
+	udelay(100);
+}
@@ -17,3 +17,8 @@ DEFINES += CPU_BOOT_KPSSV1=1
 endif
 
 OBJS += $(if $(CPU_BOOT_OBJ), $(LOCAL_DIR)/cpu-boot.o $(CPU_BOOT_OBJ))
+
+# Worker mode for using the secondary CPUs inside lk2nd (PSCI only)
+OBJS += \
+	$(LOCAL_DIR)/worker.o \
+	$(LOCAL_DIR)/worker-entry.o
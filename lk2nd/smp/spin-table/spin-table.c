@@ -254,6 +254,10 @@ static int lk2nd_smp_spin_table_setup(void *dtb, const char *cmdline,
 		if (strcmp(name, "idle-states") == 0)
 			setup_idle_states(dtb, node);
 	}
+
+	/* The CPUs were all started above, wait only once for them to boot */
+	cpu_boot_wait();
+
 	if (node < 0 && node != -FDT_ERR_NOTFOUND) {
 		dprintf(CRITICAL, "Failed to read /cpus subnodes: %d\n", node);
 		return node;
@@ -0,0 +1,397 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <arch/defines.h>
+#include <arch/ops.h>
+#include <compiler.h>
+#include <debug.h>
+#include <kernel/thread.h>
+#include <platform/timer.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <lk2nd/smp.h>
+#include <lk2nd/timeline.h>
+#include <lk2nd/util/psci.h>
+
+#include "worker.h"
+
+/*
+ * Worker mode for the secondary CPUs: while lk2nd is running, the other CPUs
+ * of the boot cluster are started through PSCI and wait for jobs from the
+ * boot CPU. They share the translation table and the vectors of the boot CPU,
+ * but LK has no SMP support, so jobs cannot use anything that would need it.
+ * RAM is mapped non-shareable, so all data passed between the CPUs goes
+ * through explicit cache maintenance. Before booting the OS the workers are
+ * turned off with PSCI CPU_OFF again, so it can bring them up as usual.
+ */
+
+#define SMP_MAX_WORKERS		3
+#define SMP_CPUS_PER_CLUSTER	4
+#define SMP_STACK_SIZE		8192
+#define SMP_MEMCPY_MIN		(256 * 1024)
+#define SMP_TIMEOUT_US		100000
+
+#define MPIDR_AFF_MASK		0xffffff
+#define MPIDR_AFF0_MASK		0xff
+
+struct smp_worker {
+	/* Written by the boot CPU before the worker is started */
+	uint32_t regs[SMP_REG_COUNT] __ALIGNED(CACHE_LINE);
+	uint32_t mpidr;
+
+	/* Written by the boot CPU only */
+	struct {
+		struct lk2nd_smp_job *job;
+		volatile uint32_t seq;
+		bool exit;
+	} cmd __ALIGNED(CACHE_LINE);
+
+	/* Written by the worker only */
+	struct {
+		volatile uint32_t seq;
+		volatile bool ready;
+	} done __ALIGNED(CACHE_LINE);
+
+	uint8_t stack[SMP_STACK_SIZE] __ALIGNED(CACHE_LINE);
+};
+
+static struct smp_worker smp_workers[SMP_MAX_WORKERS];
+static unsigned smp_num_workers;
+static bool smp_started;
+
+void lk2nd_smp_worker_main(struct smp_worker *w);
+
+static inline void smp_sev(void)
+{
+	__asm__ volatile("sev" ::: "memory");
+}
+
+static inline void smp_wfe(void)
+{
+	__asm__ volatile("wfe" ::: "memory");
+}
+
+static inline uint32_t smp_read_mpidr(void)
+{
+	uint32_t val;
+	__asm__ volatile("mrc p15, 0, %0, c0, c0, 5" : "=r" (val));
+	return val;
+}
+
+static void smp_worker_setup(struct smp_worker *w, uint32_t mpidr)
+{
+	uint32_t *regs = w->regs;
+
+	__asm__ volatile("mrc p15, 0, %0, c1, c0, 0" : "=r" (regs[SMP_REG_SCTLR]));
+	__asm__ volatile("mrc p15, 0, %0, c2, c0, 2" : "=r" (regs[SMP_REG_TTBCR]));
+	__asm__ volatile("mrc p15, 0, %0, c2, c0, 0" : "=r" (regs[SMP_REG_TTBR0]));
+	__asm__ volatile("mrc p15, 0, %0, c3, c0, 0" : "=r" (regs[SMP_REG_DACR]));
+	__asm__ volatile("mrc p15, 0, %0, c12, c0, 0" : "=r" (regs[SMP_REG_VBAR]));
+	regs[SMP_REG_STACK] = (uintptr_t)w->stack + sizeof(w->stack);
+	w->mpidr = mpidr;
+
+	w->cmd.job = NULL;
+	w->cmd.seq = 0;
+	w->cmd.exit = false;
+	w->done.seq = 0;
+	w->done.ready = false;
+
+	/*
+	 * The worker starts with the MMU and caches off, so everything must
+	 * be in RAM. Also drop all lines of the boot CPU (e.g. from clearing
+	 * the BSS) so that they cannot be written back over the worker later.
+	 */
+	arch_clean_invalidate_cache_range((addr_t)w, sizeof(*w));
+}
+
+static bool smp_worker_wait_ready(struct smp_worker *w)
+{
+	int timeout = SMP_TIMEOUT_US / 100;
+
+	while (timeout--) {
+		arch_invalidate_cache_range((addr_t)&w->done, sizeof(w->done));
+		if (w->done.ready)
+			return true;
+		udelay(100);
+	}
+	return false;
+}
+
+static bool smp_worker_wait_off(struct smp_worker *w)
+{
+	int timeout = SMP_TIMEOUT_US / 100;
+
+	while (timeout--) {
+		if (psci_call(PSCI_F_AFFINITY_INFO, w->mpidr, 0, 0) == PSCI_AFFINITY_OFF)
+			return true;
+		udelay(100);
+	}
+	return false;
+}
+
+unsigned lk2nd_smp_start(void)
+{
+	struct smp_worker *w;
+	unsigned int i, stage;
+	uint32_t self, mpidr;
+	int32_t ret;
+
+	if (smp_started)
+		return smp_num_workers;
+	smp_started = true;
+
+	if (!is_scm_armv8_support() || psci_version() == PSCI_RET_NOT_SUPPORTED) {
+		dprintf(INFO, "SMP workers need PSCI, using the boot CPU only\n");
+		return 0;
+	}
+
+	stage = lk2nd_timeline_begin("smp", NULL);
+	self = smp_read_mpidr() & MPIDR_AFF_MASK;
+	for (i = 0; i < SMP_CPUS_PER_CLUSTER; i++) {
+		mpidr = (self & ~MPIDR_AFF0_MASK) | i;
+		if (mpidr == self || smp_num_workers == SMP_MAX_WORKERS)
+			continue;
+
+		w = &smp_workers[smp_num_workers];
+		smp_worker_setup(w, mpidr);
+
+		ret = psci_call(PSCI_F_CPU_ON, mpidr, (uintptr_t)lk2nd_smp_entry,
+				(uintptr_t)w);
+		if (ret) {
+			if (ret != PSCI_RET_INVALID_PARAMS)
+				dprintf(INFO, "Failed to start CPU 0x%x: %d\n", mpidr, ret);
+			continue;
+		}
+
+		if (!smp_worker_wait_ready(w)) {
+			dprintf(CRITICAL, "CPU 0x%x did not come up as SMP worker\n", mpidr);
+			continue;
+		}
+		smp_num_workers++;
+	}
+
+	lk2nd_timeline_end(stage);
+
+	dprintf(INFO, "Started %u SMP worker(s)\n", smp_num_workers);
+	return smp_num_workers;
+}
+
+static void smp_worker_post(struct smp_worker *w, struct lk2nd_smp_job *job,
+			    bool exit)
+{
+	w->cmd.job = job;
+	w->cmd.exit = exit;
+	w->cmd.seq++;
+	arch_clean_cache_range((addr_t)&w->cmd, sizeof(w->cmd));
+	smp_sev();
+}
+
+static void smp_worker_wait(struct smp_worker *w)
+{
+	for (;;) {
+		arch_invalidate_cache_range((addr_t)&w->done, sizeof(w->done));
+		if (w->done.seq == w->cmd.seq)
+			break;
+		thread_yield();
+	}
+}
+
+void lk2nd_smp_run(unsigned worker, struct lk2nd_smp_job *job)
+{
+	struct smp_worker *w = &smp_workers[worker];
+
+	ASSERT(worker < smp_num_workers);
+	ASSERT(IS_CACHE_LINE_ALIGNED(job->out));
+	smp_worker_wait(w);
+
+	arch_clean_cache_range((addr_t)job, sizeof(*job));
+	if (job->in_len)
+		arch_clean_cache_range((addr_t)job->in, job->in_len);
+	if (job->out_len)
+		arch_clean_invalidate_cache_range((addr_t)job->out, job->out_len);
+
+	smp_worker_post(w, job, false);
+}
+
+void lk2nd_smp_wait(unsigned worker)
+{
+	struct smp_worker *w = &smp_workers[worker];
+	struct lk2nd_smp_job *job = w->cmd.job;
+
+	ASSERT(worker < smp_num_workers);
+	smp_worker_wait(w);
+
+	/* Drop lines that might have been fetched speculatively meanwhile */
+	if (job && job->out_len)
+		arch_invalidate_cache_range((addr_t)job->out, job->out_len);
+}
+
+void lk2nd_smp_stop(void)
+{
+	struct smp_worker *w;
+	unsigned i;
+
+	for (i = 0; i < smp_num_workers; i++) {
+		w = &smp_workers[i];
+		smp_worker_wait(w);
+		smp_worker_post(w, NULL, true);
+	}
+
+	for (i = 0; i < smp_num_workers; i++) {
+		w = &smp_workers[i];
+		if (!smp_worker_wait_off(w))
+			dprintf(CRITICAL, "CPU 0x%x did not turn off\n", w->mpidr);
+	}
+
+	/* Workers cannot be started again without the OS noticing */
+	smp_num_workers = 0;
+	smp_started = true;
+}
+
+/* Runs on the secondary CPUs, called from lk2nd_smp_entry() */
+void lk2nd_smp_worker_main(struct smp_worker *w)
+{
+	struct lk2nd_smp_job *job;
+
+	w->done.ready = true;
+	arch_clean_cache_range((addr_t)&w->done, sizeof(w->done));
+	smp_sev();
+
+	for (;;) {
+		arch_invalidate_cache_range((addr_t)&w->cmd, sizeof(w->cmd));
+		if (w->cmd.seq == w->done.seq) {
+			smp_wfe();
+			continue;
+		}
+		if (w->cmd.exit)
+			break;
+
+		job = w->cmd.job;
+		arch_invalidate_cache_range((addr_t)job, sizeof(*job));
+		if (job->in_len)
+			arch_invalidate_cache_range((addr_t)job->in, job->in_len);
+
+		job->func(job);
+
+		if (job->out_len)
+			arch_clean_invalidate_cache_range((addr_t)job->out, job->out_len);
+
+		w->done.seq = w->cmd.seq;
+		arch_clean_cache_range((addr_t)&w->done, sizeof(w->done));
+		smp_sev();
+	}
+
+	w->done.seq = w->cmd.seq;
+	arch_clean_cache_range((addr_t)&w->done, sizeof(w->done));
+	lk2nd_smp_worker_exit();
+}
+
+static void smp_memcpy_func(struct lk2nd_smp_job *job)
+{
+	memcpy(job->out, job->in, job->out_len);
+}
+
+/*
+ * Give @parts equal parts of the copy to the first workers. Only whole cache
+ * lines of the destination are given to them, the unaligned head and the
+ * rest from the returned position to the end are left to the boot CPU.
+ */
+static uintptr_t smp_memcpy_post(struct lk2nd_smp_job *jobs, unsigned parts,
+				 void *dst, const void *src, size_t len)
+{
+	uintptr_t start, end, pos;
+	unsigned workers = MIN(parts, smp_num_workers), i;
+	size_t part;
+
+	start = ROUNDUP((uintptr_t)dst, CACHE_LINE);
+	end = ROUNDDOWN((uintptr_t)dst + len, CACHE_LINE);
+	part = ROUNDDOWN((end - start) / parts, CACHE_LINE);
+
+	pos = start;
+	for (i = 0; i < workers; i++) {
+		jobs[i] = (struct lk2nd_smp_job) {
+			.func = smp_memcpy_func,
+			.in = (const uint8_t *)src + (pos - (uintptr_t)dst),
+			.in_len = part,
+			.out = (void *)pos,
+			.out_len = part,
+		};
+		lk2nd_smp_run(i, &jobs[i]);
+		pos += part;
+	}
+	return pos;
+}
+
+static void smp_memcpy_rest(uintptr_t pos, void *dst, const void *src, size_t len)
+{
+	uintptr_t start = ROUNDUP((uintptr_t)dst, CACHE_LINE);
+
+	memcpy(dst, src, start - (uintptr_t)dst);
+	memcpy((void *)pos, (const uint8_t *)src + (pos - (uintptr_t)dst),
+	       (uintptr_t)dst + len - pos);
+}
+
+/*
+ * memcpy() that splits large copies between the boot CPU and the workers.
+ * The buffers must not overlap.
+ */
+void lk2nd_smp_memcpy(void *dst, const void *src, size_t len)
+{
+	struct lk2nd_smp_job jobs[SMP_MAX_WORKERS];
+	unsigned workers, i;
+	uintptr_t pos;
+
+	if (len < SMP_MEMCPY_MIN) {
+		memcpy(dst, src, len);
+		return;
+	}
+
+	workers = lk2nd_smp_start();
+	if (!workers) {
+		memcpy(dst, src, len);
+		return;
+	}
+
+	/* The boot CPU copies one part as well */
+	pos = smp_memcpy_post(jobs, workers + 1, dst, src, len);
+	smp_memcpy_rest(pos, dst, src, len);
+
+	for (i = 0; i < workers; i++)
+		lk2nd_smp_wait(i);
+}
+
+static struct lk2nd_smp_job smp_async_jobs[SMP_MAX_WORKERS];
+static unsigned smp_async_workers;
+
+/*
+ * Start copying in the background on the workers, so that the boot CPU can
+ * do something else meanwhile (e.g. move another image or decompress). Until
+ * lk2nd_smp_memmove_wait() neither buffer may be touched and no other jobs
+ * may be started. Small copies, overlapping buffers and systems without
+ * workers are handled with memmove() right away.
+ */
+void lk2nd_smp_memmove_async(void *dst, const void *src, size_t len)
+{
+	uintptr_t d = (uintptr_t)dst, s = (uintptr_t)src, pos;
+
+	ASSERT(!smp_async_workers);
+
+	if (len < SMP_MEMCPY_MIN || (d < s + len && s < d + len) ||
+	    !lk2nd_smp_start()) {
+		memmove(dst, src, len);
+		return;
+	}
+
+	smp_async_workers = smp_num_workers;
+	pos = smp_memcpy_post(smp_async_jobs, smp_async_workers, dst, src, len);
+	smp_memcpy_rest(pos, dst, src, len);
+}
+
+void lk2nd_smp_memmove_wait(void)
+{
+	unsigned i;
+
+	for (i = 0; i < smp_async_workers; i++)
+		lk2nd_smp_wait(i);
+	smp_async_workers = 0;
+}
@@ -0,0 +1,19 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#ifndef LK2ND_SMP_WORKER_H
+#define LK2ND_SMP_WORKER_H
+
+/* Registers set up by lk2nd_smp_entry(), read with the MMU still off */
+#define SMP_REG_SCTLR		0
+#define SMP_REG_TTBCR		1
+#define SMP_REG_TTBR0		2
+#define SMP_REG_DACR		3
+#define SMP_REG_VBAR		4
+#define SMP_REG_STACK		5
+#define SMP_REG_COUNT		6
+
+#ifndef ASSEMBLY
+void lk2nd_smp_entry(void);
+void lk2nd_smp_worker_exit(void) __NO_RETURN;
+#endif
+
+#endif /* LK2ND_SMP_WORKER_H */
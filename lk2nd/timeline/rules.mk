@@ -0,0 +1,6 @@
+# SPDX-License-Identifier: BSD-3-Clause
+LOCAL_DIR := $(GET_LOCAL_DIR)
+MODULES += lib/libfdt
+
+OBJS += \
+	$(LOCAL_DIR)/timeline.o \
@@ -0,0 +1,162 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <boot.h>
+#include <debug.h>
+#include <fastboot.h>
+#include <kernel/thread.h>
+#include <libfdt.h>
+#include <platform.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <lk2nd/timeline.h>
+
+/*
+ * timeline.c - Record how long the lk2nd boot stages take.
+ *
+ * Stages are kept in a small ring, the oldest ones are dropped when it is
+ * full. The times are microseconds from current_time_hires(), which counts
+ * from the start of the global timer on platforms with a QTimer. This is
+ * the same counter the arch timer of the OS uses, so the numbers can be
+ * compared to the timestamps of the kernel.
+ *
+ * The timeline is shown by "fastboot oem boot-timeline" and passed to the
+ * OS in /chosen: "lk2nd,boot-timeline-stages" has the stage names and
+ * "lk2nd,boot-timeline" a <start end> pair for each of them. The end is 0
+ * for stages that were still running when the OS was started.
+ */
+
+#define TIMELINE_ENTRIES	64
+#define TIMELINE_DETAIL_LEN	24
+
+/*
+ * The 32-bit microsecond times wrap after about 71 minutes, durations are
+ * computed with unsigned subtraction and any value is a valid end time.
+ */
+struct timeline_entry {
+	unsigned id;
+	const char *stage;
+	char detail[TIMELINE_DETAIL_LEN];
+	uint32_t start;
+	uint32_t end;
+	bool running;
+};
+
+static struct timeline_entry timeline[TIMELINE_ENTRIES];
+static unsigned timeline_next = 1;
+
+unsigned lk2nd_timeline_begin(const char *stage, const char *detail)
+{
+	uint32_t now = current_time_hires();
+	struct timeline_entry *e;
+	unsigned id;
+
+	enter_critical_section();
+	id = timeline_next++;
+	e = &timeline[id % TIMELINE_ENTRIES];
+	e->id = id;
+	e->stage = stage;
+	strlcpy(e->detail, detail ? detail : "", sizeof(e->detail));
+	e->start = now;
+	e->end = 0;
+	e->running = true;
+	exit_critical_section();
+
+	return id;
+}
+
+void lk2nd_timeline_end(unsigned id)
+{
+	struct timeline_entry *e = &timeline[id % TIMELINE_ENTRIES];
+	uint32_t now = current_time_hires();
+
+	enter_critical_section();
+	if (id && e->id == id && e->running) {
+		e->end = now;
+		e->running = false;
+	}
+	exit_critical_section();
+}
+
+static unsigned timeline_first(void)
+{
+	if (timeline_next > TIMELINE_ENTRIES)
+		return timeline_next - TIMELINE_ENTRIES;
+	return 1;
+}
+
+static int lk2nd_timeline_dt_update(void *dtb, const char *cmdline,
+				    enum boot_type boot_type)
+{
+	unsigned first = timeline_first(), count = timeline_next - first;
+	struct timeline_entry *e;
+	size_t names_len = 0, pos = 0;
+	fdt32_t *times;
+	char *names;
+	unsigned id, i = 0;
+	int offset, ret;
+
+	if (boot_type & (BOOT_DOWNSTREAM | BOOT_LK2ND) || !count)
+		return 0;
+
+	offset = fdt_path_offset(dtb, "/chosen");
+	if (offset < 0)
+		return 0;
+
+	for (id = first; id < timeline_next; id++) {
+		e = &timeline[id % TIMELINE_ENTRIES];
+		names_len += strlen(e->stage) + strlen(e->detail) + 2;
+	}
+
+	names = malloc(names_len);
+	times = calloc(count * 2, sizeof(*times));
+	if (!names || !times)
+		goto out;
+
+	for (id = first; id < timeline_next; id++) {
+		e = &timeline[id % TIMELINE_ENTRIES];
+		if (e->detail[0])
+			pos += sprintf(names + pos, "%s:%s", e->stage, e->detail) + 1;
+		else
+			pos += sprintf(names + pos, "%s", e->stage) + 1;
+		times[i++] = cpu_to_fdt32(e->start);
+		/* 0 marks a running stage, a real end time of 0 is off by 1 us */
+		times[i++] = cpu_to_fdt32(e->running ? 0 : e->end ?: 1);
+	}
+
+	ret = fdt_setprop(dtb, offset, "lk2nd,boot-timeline-stages", names, pos);
+	if (ret < 0)
+		goto out;
+
+	ret = fdt_setprop(dtb, offset, "lk2nd,boot-timeline", times,
+			  count * 2 * sizeof(*times));
+
+out:
+	free(names);
+	free(times);
+	return 0;
+}
+DEV_TREE_UPDATE(lk2nd_timeline_dt_update);
+
+static void cmd_oem_boot_timeline(const char *arg, void *data, unsigned sz)
+{
+	char response[MAX_RSP_SIZE];
+	struct timeline_entry *e;
+	unsigned id;
+
+	fastboot_info("start (us) time (us) stage");
+	for (id = timeline_first(); id < timeline_next; id++) {
+		e = &timeline[id % TIMELINE_ENTRIES];
+		if (!e->running)
+			snprintf(response, sizeof(response), "%10u %9u %s %s",
+				 e->start, (uint32_t)(e->end - e->start),
+				 e->stage, e->detail);
+		else
+			snprintf(response, sizeof(response), "%10u   running %s %s",
+				 e->start, e->stage, e->detail);
+		fastboot_info(response);
+	}
+
+	fastboot_okay("");
+}
+FASTBOOT_REGISTER("oem boot-timeline", cmd_oem_boot_timeline);
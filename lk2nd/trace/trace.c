@@ -0,0 +1,195 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <debug.h>
+#include <fastboot.h>
+#include <kernel/thread.h>
+#include <platform.h>
+#include <printf.h>
+#include <string.h>
+#include <target.h>
+
+#include <lk2nd/trace.h>
+
+/*
+ * trace.c - Record events of the storage, USB and CPU activity on one
+ * timeline.
+ *
+ * Events are kept in a static ring, the oldest ones are overwritten when it
+ * is full. The timestamps are microseconds from current_time_hires(), which
+ * reads the QTimer on platforms that have one. Recording only stores the
+ * name pointer, so it is cheap enough for every storage command and USB
+ * request.
+ *
+ * Threads get small ids in the order they are first seen, with the thread
+ * name copied so it survives the thread. The context switches are drawn
+ * as slices on a separate "cpu0" track. Everything runs on the boot CPU,
+ * the jobs of the SMP workers are not traced.
+ *
+ * "fastboot oem trace" stages the ring as Chrome trace JSON, which can be
+ * opened with https://ui.perfetto.dev or chrome://tracing.
+ * "fastboot oem trace reset" drops all events.
+ */
+
+#define TRACE_ENTRIES		4096
+#define TRACE_THREADS		32
+#define TRACE_TID_CPU		0
+
+struct trace_entry {
+	const char *name;
+	uint32_t ts;
+	uint32_t arg;
+	uintptr_t id;
+	uint8_t tid;
+	char phase;
+};
+
+struct trace_thread {
+	thread_t *thread;
+	char name[sizeof(((thread_t *)0)->name)];
+};
+
+static struct trace_entry trace[TRACE_ENTRIES];
+static unsigned trace_next;
+static struct trace_thread trace_threads[TRACE_THREADS];
+static unsigned trace_num_threads;
+
+/*
+ * Thread structs are freed and reused when threads exit, so the name is
+ * compared as well. Threads beyond the table all end up in the last one.
+ */
+static unsigned trace_tid(thread_t *t)
+{
+	struct trace_thread *tt;
+	unsigned i;
+
+	for (i = 0; i < trace_num_threads; i++) {
+		tt = &trace_threads[i];
+		if (tt->thread == t && !strcmp(tt->name, t->name))
+			return i + 1;
+	}
+
+	if (trace_num_threads == TRACE_THREADS)
+		return TRACE_THREADS;
+
+	tt = &trace_threads[trace_num_threads++];
+	tt->thread = t;
+	strlcpy(tt->name, t->name, sizeof(tt->name));
+	return trace_num_threads;
+}
+
+static void trace_add(const char *name, char phase, unsigned tid,
+		      uintptr_t id, uint32_t arg, uint32_t ts)
+{
+	struct trace_entry *e = &trace[trace_next++ % TRACE_ENTRIES];
+
+	e->name = name;
+	e->ts = ts;
+	e->arg = arg;
+	e->id = id;
+	e->tid = tid;
+	e->phase = phase;
+}
+
+void lk2nd_trace_event(const char *name, char phase, uintptr_t id, uint32_t arg)
+{
+	uint32_t now = current_time_hires();
+
+	enter_critical_section();
+	trace_add(name, phase, trace_tid(current_thread), id, arg, now);
+	exit_critical_section();
+}
+
+/* Called by thread_resched() in a critical section */
+void lk2nd_trace_switch(thread_t *newthread)
+{
+	uint32_t now = current_time_hires();
+	unsigned tid = trace_tid(newthread);
+
+	trace_add(NULL, 'E', TRACE_TID_CPU, 0, 0, now);
+	trace_add(trace_threads[tid - 1].name, 'B', TRACE_TID_CPU, 0, tid, now);
+}
+
+static size_t trace_print_entry(char *buf, size_t size, struct trace_entry *e)
+{
+	const char *name = e->name ?: "";
+
+	switch (e->phase) {
+	case 'E':
+		return snprintf(buf, size,
+				"{\"ph\":\"E\",\"ts\":%u,\"pid\":0,\"tid\":%u},\n",
+				e->ts, e->tid);
+	case 'b':
+	case 'e':
+		return snprintf(buf, size,
+				"{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%c\",\"id\":\"%#lx\","
+				"\"ts\":%u,\"pid\":0,\"tid\":%u,\"args\":{\"arg\":%u}},\n",
+				name, name, e->phase, (unsigned long)e->id,
+				e->ts, e->tid, e->arg);
+	case 'i':
+		return snprintf(buf, size,
+				"{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\","
+				"\"ts\":%u,\"pid\":0,\"tid\":%u,\"args\":{\"arg\":%u}},\n",
+				name, e->ts, e->tid, e->arg);
+	default:
+		return snprintf(buf, size,
+				"{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%u,\"pid\":0,"
+				"\"tid\":%u,\"args\":{\"arg\":%u}},\n",
+				name, e->phase, e->ts, e->tid, e->arg);
+	}
+}
+
+static size_t trace_print_thread(char *buf, size_t size, unsigned tid,
+				 const char *name)
+{
+	return snprintf(buf, size,
+			"{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,"
+			"\"tid\":%u,\"args\":{\"name\":\"%s\"}},\n", tid, name);
+}
+
+static void cmd_oem_trace(const char *arg, void *data, unsigned sz)
+{
+	size_t size = target_get_max_flash_size(), pos;
+	unsigned first = 0, i;
+	char *buf = data;
+
+	while (*arg == ' ')
+		arg++;
+
+	if (!strcmp(arg, "reset")) {
+		enter_critical_section();
+		trace_next = 0;
+		trace_num_threads = 0;
+		exit_critical_section();
+		fastboot_okay("");
+		return;
+	}
+
+	/* Stop recording while the ring is written out */
+	enter_critical_section();
+
+	if (trace_next > TRACE_ENTRIES)
+		first = trace_next - TRACE_ENTRIES;
+
+	pos = snprintf(buf, size, "{\"traceEvents\":[\n");
+	pos += trace_print_thread(buf + pos, size - pos, TRACE_TID_CPU, "cpu0");
+	for (i = 0; i < trace_num_threads && pos < size; i++)
+		pos += trace_print_thread(buf + pos, size - pos, i + 1,
+					  trace_threads[i].name);
+	for (i = first; i < trace_next && pos < size; i++)
+		pos += trace_print_entry(buf + pos, size - pos,
+					 &trace[i % TRACE_ENTRIES]);
+
+	exit_critical_section();
+
+	if (pos + 4 > size) {
+		fastboot_fail("trace too large");
+		return;
+	}
+
+	/* Replace the comma after the last event */
+	pos -= 2;
+	pos += snprintf(buf + pos, size - pos, "\n]}\n");
+
+	fastboot_stage(buf, pos);
+}
+FASTBOOT_REGISTER("oem trace", cmd_oem_trace);
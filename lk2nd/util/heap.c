@@ -0,0 +1,59 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <lib/heap.h>
+#include <stdlib.h>
+
+#include <lk2nd/util/highmem.h>
+
+/*
+ * The LK heap is only what is left of the memory of lk itself. Once it is
+ * full, it grows into the high memory set aside for it, so large buffers
+ * and caches are not limited by the memory of lk. The scratch memory is not
+ * used for this since fastboot downloads and the boot image code write all
+ * of it without allocating it first. The regions are given back before
+ * booting the kernel.
+ */
+#define HEAP_UNIT_SIZE	(1024 * 1024)
+#define HEAP_UNITS_MAX	32
+
+static uint32_t heap_units_used;
+
+static uint32_t heap_units_mask(unsigned int units)
+{
+	return units == HEAP_UNITS_MAX ? ~0U : (1U << units) - 1;
+}
+
+void *heap_get_region(size_t *len)
+{
+	unsigned int i, units, count;
+	uint32_t mask;
+	size_t size;
+	char *base;
+
+	base = lk2nd_highmem_heap(&size);
+	count = MIN(size / HEAP_UNIT_SIZE, HEAP_UNITS_MAX);
+	units = ROUNDUP(*len, HEAP_UNIT_SIZE) / HEAP_UNIT_SIZE;
+	if (!base || !units || units > count)
+		return NULL;
+
+	mask = heap_units_mask(units);
+	for (i = 0; i + units <= count; i++) {
+		if (heap_units_used & (mask << i))
+			continue;
+
+		heap_units_used |= mask << i;
+		*len = units * HEAP_UNIT_SIZE;
+		return base + i * HEAP_UNIT_SIZE;
+	}
+
+	return NULL;
+}
+
+void heap_put_region(void *base, size_t len)
+{
+	size_t size;
+	char *start = lk2nd_highmem_heap(&size);
+	unsigned int i = ((char *)base - start) / HEAP_UNIT_SIZE;
+
+	heap_units_used &= ~(heap_units_mask(len / HEAP_UNIT_SIZE) << i);
+}
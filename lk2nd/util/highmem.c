@@ -0,0 +1,223 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <debug.h>
+#include <libfdt.h>
+#include <limits.h>
+#include <smem.h>
+#include <stdlib.h>
+#include <target.h>
+
+#include <lk2nd/device.h>
+#include <lk2nd/util/highmem.h>
+#include <lk2nd/util/mmu.h>
+
+/*
+ * lk2nd uses the short-descriptor page tables without LPAE, so only the
+ * RAM below 4 GiB can be mapped, 1:1 like all other memory. The USB
+ * controllers can also only DMA to 32-bit addresses.
+ */
+#define HIGHMEM_MAX	8
+#define HIGHMEM_ALIGN	(1024 * 1024)
+#define HIGHMEM_LIMIT	ROUNDDOWN((uint64_t)UINT_MAX, HIGHMEM_ALIGN)
+
+/*
+ * Only RAM that is known to be free is used: The reserved memory of the
+ * device DT (e.g. for the modem or the framebuffer of the display) and the
+ * RAM partitions that are not plain DDR are left out. If the device DT does
+ * not describe the reserved memory at all, nothing is known to be free.
+ */
+#define HIGHMEM_RESERVED_MAX	64
+
+/* Set aside at the top for the heap, see lk2nd_highmem_heap() */
+#define HIGHMEM_HEAP_SIZE	(32 * 1024 * 1024)
+
+struct highmem_range {
+	uint64_t start, end;
+};
+
+static struct lk2nd_region highmem[HIGHMEM_MAX];
+static unsigned int highmem_count;
+static bool highmem_done;
+static uintptr_t highmem_heap;
+
+static struct highmem_range reserved[HIGHMEM_RESERVED_MAX];
+static unsigned int reserved_count;
+
+static bool highmem_reserve(uint64_t start, uint64_t size)
+{
+	if (!size)
+		return true;
+	if (reserved_count == HIGHMEM_RESERVED_MAX)
+		return false;
+
+	reserved[reserved_count++] = (struct highmem_range) {
+		.start = start,
+		.end = start + size,
+	};
+	return true;
+}
+
+static uint64_t highmem_read_cells(const fdt32_t *cells, int count)
+{
+	uint64_t val = 0;
+
+	while (count--)
+		val = (val << 32) | fdt32_to_cpu(*cells++);
+	return val;
+}
+
+/* Dynamically allocated reserved memory (only "size") is placed by Linux */
+static bool highmem_reserve_dt(const void *dtb)
+{
+	int i, n, parent, node, len, ac, sc;
+	const fdt32_t *reg;
+	uint64_t addr, size;
+
+	n = fdt_num_mem_rsv(dtb);
+	for (i = 0; i < n; i++) {
+		if (fdt_get_mem_rsv(dtb, i, &addr, &size) < 0 ||
+		    !highmem_reserve(addr, size))
+			return false;
+	}
+
+	parent = fdt_path_offset(dtb, "/reserved-memory");
+	if (parent < 0)
+		return false;
+
+	ac = fdt_address_cells(dtb, parent);
+	sc = fdt_size_cells(dtb, parent);
+	if (ac < 1 || ac > 2 || sc < 1 || sc > 2)
+		return false;
+
+	fdt_for_each_subnode(node, dtb, parent) {
+		reg = fdt_getprop(dtb, node, "reg", &len);
+		if (!reg)
+			continue;
+
+		for (; len >= (ac + sc) * (int)sizeof(*reg); len -= (ac + sc) * sizeof(*reg)) {
+			addr = highmem_read_cells(reg, ac);
+			size = highmem_read_cells(reg + ac, sc);
+			if (!highmem_reserve(addr, size))
+				return false;
+			reg += ac + sc;
+		}
+	}
+
+	return true;
+}
+
+static bool highmem_reserve_ptable(void)
+{
+	ram_partition ptn;
+	uint32_t i, len;
+
+	len = smem_get_ram_ptable_len();
+	for (i = 0; i < len; i++) {
+		smem_get_ram_ptable_entry(&ptn, i);
+		if (!smem_ram_ptn_is_ddr(&ptn) && !highmem_reserve(ptn.start, ptn.size))
+			return false;
+	}
+
+	return true;
+}
+
+static void highmem_add(uint64_t start, uint64_t end)
+{
+	if (highmem_count == HIGHMEM_MAX)
+		return;
+	if (!lk2nd_mmu_map_ram_dynamic("highmem", start, end - start))
+		return;
+
+	dprintf(INFO, "High memory: 0x%llx - 0x%llx\n", start, end);
+	highmem[highmem_count++] = (struct lk2nd_region) {
+		.name = "highmem",
+		.start = start,
+		.size = end - start,
+	};
+}
+
+/* Add the parts of [start, end) that are not reserved, in ascending order */
+static void highmem_add_free(uint64_t start, uint64_t end)
+{
+	const struct highmem_range *next;
+	unsigned int i;
+
+	while (start < end) {
+		/* The first reserved range that overlaps the rest */
+		next = NULL;
+		for (i = 0; i < reserved_count; i++) {
+			if (reserved[i].end <= start || reserved[i].start >= end)
+				continue;
+			if (!next || reserved[i].start < next->start)
+				next = &reserved[i];
+		}
+
+		if (!next || next->start > start) {
+			uint64_t s = ROUNDUP(start, HIGHMEM_ALIGN);
+			uint64_t e = ROUNDDOWN(next ? next->start : end, HIGHMEM_ALIGN);
+
+			if (s < e)
+				highmem_add(s, e);
+		}
+		if (!next)
+			break;
+		start = next->end;
+	}
+}
+
+unsigned int lk2nd_highmem_map(const struct lk2nd_region **ranges)
+{
+	uint64_t scratch_end = (uintptr_t)target_get_scratch_address() +
+			       target_get_max_flash_size();
+	const void *dtb;
+	ram_partition ptn;
+	uint64_t start, end;
+	uint32_t i, len;
+
+	*ranges = highmem;
+	if (highmem_done)
+		return highmem_count;
+
+	/* Try again once the device DT was found */
+	dtb = lk2nd_device_get_dtb();
+	if (!dtb)
+		return 0;
+	highmem_done = true;
+
+	if (!smem_ram_ptable_init_v1() ||
+	    !highmem_reserve_dt(dtb) || !highmem_reserve_ptable()) {
+		dprintf(INFO, "High memory: Reserved memory unknown, not using it\n");
+		return 0;
+	}
+
+	len = smem_get_ram_ptable_len();
+	for (i = 0; i < len; i++) {
+		smem_get_ram_ptable_entry(&ptn, i);
+		if (!smem_ram_ptn_is_ddr(&ptn))
+			continue;
+
+		start = MAX(ptn.start, scratch_end);
+		end = MIN(ptn.start + ptn.size, HIGHMEM_LIMIT);
+		highmem_add_free(start, end);
+	}
+
+	/* Take the heap from the top of the highest range if it is large */
+	if (highmem_count &&
+	    highmem[highmem_count - 1].size >= 2 * HIGHMEM_HEAP_SIZE) {
+		highmem[highmem_count - 1].size -= HIGHMEM_HEAP_SIZE;
+		highmem_heap = highmem[highmem_count - 1].start +
+			       highmem[highmem_count - 1].size;
+		dprintf(INFO, "High memory: Heap at 0x%lx\n", highmem_heap);
+	}
+
+	return highmem_count;
+}
+
+void *lk2nd_highmem_heap(size_t *size)
+{
+	const struct lk2nd_region *ranges;
+
+	lk2nd_highmem_map(&ranges);
+	*size = highmem_heap ? HIGHMEM_HEAP_SIZE : 0;
+	return (void *)highmem_heap;
+}
@@ -2,6 +2,7 @@
 
 #if WITH_LIB_LIBFDT
 #include <libfdt.h>
+#include <stdlib.h>
 #include <lk2nd/util/lkfdt.h>
 
 int lkfdt_prop_strneq(const void *fdt, int node, const char *prop, const char *cmp)
@@ -66,6 +67,33 @@ int lkfdt_get_reg(const void *fdt, int parent, int node,
 	return 0;
 }
 
+static fdt32_t *write_reg(fdt32_t *reg, int cells, uint32_t val)
+{
+	while (--cells)
+		*reg++ = 0;
+	*reg++ = cpu_to_fdt32(val);
+	return reg;
+}
+
+int lkfdt_set_reg(void *fdt, int parent, int node, uint32_t addr, uint32_t size)
+{
+	fdt32_t reg[4], *end;
+	int addr_cells, size_cells;
+
+	addr_cells = fdt_address_cells(fdt, parent);
+	if (addr_cells < 0)
+		return addr_cells;
+	size_cells = fdt_size_cells(fdt, parent);
+	if (size_cells < 0)
+		return size_cells;
+	if (addr_cells < 1 || addr_cells > 2 || size_cells < 1 || size_cells > 2)
+		return -FDT_ERR_BADNCELLS;
+
+	end = write_reg(reg, addr_cells, addr);
+	end = write_reg(end, size_cells, size);
+	return fdt_setprop(fdt, node, "reg", reg, (end - reg) * sizeof(*reg));
+}
+
 int lkfdt_getprop_u32(const void *fdt, int node, const char *prop, uint32_t *val)
 {
 	const fdt32_t *fval;
@@ -101,6 +129,112 @@ int lkfdt_u32list_get(const void *fdt, int node, const char *prop,
 	return 0;
 }
 
+/*
+ * Table of all phandles of the most recently used device tree, sorted by
+ * phandle. It is built in a single pass over the tree, instead of walking
+ * it for each lookup with fdt_node_offset_by_phandle(). A modified tree is
+ * detected by its struct size, or when a cached offset no longer has the
+ * expected phandle, and the table is built again.
+ */
+struct phandle_entry {
+	uint32_t phandle;
+	int offset;
+};
+
+static struct {
+	const void *fdt;
+	uint32_t size_dt_struct;
+	struct phandle_entry *entries;
+	int count;
+} phandle_cache;
+
+static int phandle_entry_cmp(const void *a, const void *b)
+{
+	const struct phandle_entry *ea = a, *eb = b;
+
+	if (ea->phandle == eb->phandle)
+		return 0;
+	return ea->phandle < eb->phandle ? -1 : 1;
+}
+
+static bool phandle_cache_build(const void *fdt)
+{
+	struct phandle_entry *entries = NULL, *tmp;
+	int node, count = 0, size = 0, i;
+	uint32_t phandle;
+
+	free(phandle_cache.entries);
+	phandle_cache.fdt = NULL;
+	phandle_cache.entries = NULL;
+	phandle_cache.count = 0;
+
+	for (node = fdt_next_node(fdt, -1, NULL); node >= 0;
+	     node = fdt_next_node(fdt, node, NULL)) {
+		phandle = fdt_get_phandle(fdt, node);
+		if (!phandle)
+			continue;
+
+		if (count == size) {
+			size = size ? 2 * size : 64;
+			tmp = realloc(entries, size * sizeof(*entries));
+			if (!tmp) {
+				free(entries);
+				return false;
+			}
+			entries = tmp;
+		}
+
+		/* Insert sorted, they are mostly in order of the nodes already */
+		for (i = count; i > 0 && entries[i - 1].phandle > phandle; i--)
+			entries[i] = entries[i - 1];
+		entries[i].phandle = phandle;
+		entries[i].offset = node;
+		count++;
+	}
+	if (node != -FDT_ERR_NOTFOUND) {
+		free(entries);
+		return false;
+	}
+
+	phandle_cache.fdt = fdt;
+	phandle_cache.size_dt_struct = fdt_size_dt_struct(fdt);
+	phandle_cache.entries = entries;
+	phandle_cache.count = count;
+	return true;
+}
+
+static int phandle_cache_find(const void *fdt, uint32_t phandle)
+{
+	struct phandle_entry key = { .phandle = phandle }, *entry;
+
+	entry = bsearch(&key, phandle_cache.entries, phandle_cache.count,
+			sizeof(key), phandle_entry_cmp);
+	if (!entry || fdt_get_phandle(fdt, entry->offset) != phandle)
+		return -FDT_ERR_NOTFOUND;
+	return entry->offset;
+}
+
+int lkfdt_node_offset_by_phandle(const void *fdt, uint32_t phandle)
+{
+	int offset;
+
+	if (phandle == 0 || phandle == (uint32_t)-1)
+		return -FDT_ERR_BADPHANDLE;
+
+	if (phandle_cache.fdt == fdt &&
+	    phandle_cache.size_dt_struct == fdt_size_dt_struct(fdt)) {
+		offset = phandle_cache_find(fdt, phandle);
+		if (offset >= 0)
+			return offset;
+	}
+
+	/* Not cached or changed in place, rebuild for the current tree */
+	if (!phandle_cache_build(fdt))
+		return fdt_node_offset_by_phandle(fdt, phandle);
+
+	return phandle_cache_find(fdt, phandle);
+}
+
 int lkfdt_lookup_phandle(const void *fdt, int node, const char *prop)
 {
 	uint32_t phandle;
@@ -110,7 +244,7 @@ int lkfdt_lookup_phandle(const void *fdt, int node, const char *prop)
 	if (ret < 0)
 		return ret;
 
-	return fdt_node_offset_by_phandle(fdt, phandle);
+	return lkfdt_node_offset_by_phandle(fdt, phandle);
 }
 
 int lkfdt_subnode_offset_by_phandle(const void *fdt, int parent, uint32_t phandle)
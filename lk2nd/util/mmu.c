@@ -57,3 +57,13 @@ bool lk2nd_mmu_map_ram_dynamic(const char *name, uintptr_t start, uint32_t size)
 				 MMU_MEMORY_TYPE_NORMAL_WRITE_BACK_ALLOCATE |
 				 MMU_MEMORY_AP_READ_WRITE | MMU_MEMORY_XN);
 }
+
+bool lk2nd_mmu_map_ram_wc(const char *name, uintptr_t start, uint32_t size)
+{
+	/* Regions that are already mapped differently keep their mapping */
+	if (!try_map(start, size, MMU_MEMORY_TYPE_NORMAL |
+		     MMU_MEMORY_AP_READ_WRITE | MMU_MEMORY_XN, 0))
+		return true;
+
+	return lk2nd_mmu_map_ram_dynamic(name, start, size);
+}
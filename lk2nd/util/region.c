@@ -0,0 +1,128 @@
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <debug.h>
+#include <stdlib.h>
+#include <string.h>
+#include <target.h>
+
+#include <lk2nd/util/region.h>
+
+/*
+ * The scratch memory of the target is the part of the RAM that can be used
+ * freely by the bootloader. Large buffers used at the same time (e.g. for
+ * loading the kernel and for relocating the framebuffer) are allocated as
+ * named regions from it, so they cannot overlap each other by accident.
+ */
+
+#define REGION_MAX	8
+#define REGION_ALIGN	(1024 * 1024)
+
+static struct lk2nd_region regions[REGION_MAX];
+static unsigned int region_count;
+static uintptr_t pool_start, pool_end;
+
+static void region_init(void)
+{
+	if (pool_end)
+		return;
+
+	pool_start = (uintptr_t)target_get_scratch_address();
+	pool_end = pool_start + target_get_max_flash_size();
+}
+
+static bool region_insert(unsigned int i, const char *name,
+			  uintptr_t start, size_t size)
+{
+	if (region_count == REGION_MAX) {
+		dprintf(CRITICAL, "Too many memory regions, cannot add %s\n", name);
+		return false;
+	}
+
+	memmove(&regions[i + 1], &regions[i],
+		(region_count - i) * sizeof(regions[0]));
+	regions[i] = (struct lk2nd_region) {
+		.name = name,
+		.start = start,
+		.size = size,
+	};
+	region_count++;
+
+	dprintf(SPEW, "Allocated %s memory @ %#08lx (size: %#zx)\n",
+		name, start, size);
+	return true;
+}
+
+void *lk2nd_region_alloc(const char *name, size_t size)
+{
+	uintptr_t gap_start, gap_end, start;
+	unsigned int i;
+
+	region_init();
+	if (!size || size > pool_end - pool_start)
+		return NULL;
+
+	/* Look for the highest gap that fits, starting after the last region */
+	gap_end = pool_end;
+	for (i = region_count + 1; i-- > 0; ) {
+		gap_start = i ? regions[i - 1].start + regions[i - 1].size : pool_start;
+		if (gap_end - gap_start >= size) {
+			start = ROUNDDOWN(gap_end - size, REGION_ALIGN);
+			if (start >= gap_start)
+				return region_insert(i, name, start, size) ?
+				       (void *)start : NULL;
+		}
+		if (i)
+			gap_end = regions[i - 1].start;
+	}
+
+	dprintf(CRITICAL, "Not enough scratch memory for %s (size: %#zx)\n",
+		name, size);
+	return NULL;
+}
+
+bool lk2nd_region_reserve(const char *name, void *base, size_t size)
+{
+	uintptr_t start = (uintptr_t)base;
+	unsigned int i;
+
+	region_init();
+	if (start < pool_start || start > pool_end || size > pool_end - start)
+		return false;
+
+	for (i = 0; i < region_count; i++) {
+		if (regions[i].start == start && regions[i].size == size &&
+		    strcmp(regions[i].name, name) == 0)
+			return true;
+		if (regions[i].start >= start + size)
+			break;
+		if (regions[i].start + regions[i].size > start) {
+			dprintf(CRITICAL, "%s memory overlaps with %s memory\n",
+				name, regions[i].name);
+			return false;
+		}
+	}
+
+	return region_insert(i, name, start, size);
+}
+
+void lk2nd_region_free(void *base)
+{
+	unsigned int i;
+
+	for (i = 0; i < region_count; i++) {
+		if (regions[i].start == (uintptr_t)base) {
+			region_count--;
+			memmove(&regions[i], &regions[i + 1],
+				(region_count - i) * sizeof(regions[0]));
+			return;
+		}
+	}
+
+	dprintf(CRITICAL, "Freeing unknown memory region @ %p\n", base);
+}
+
+const struct lk2nd_region *lk2nd_region_list(unsigned int *count)
+{
+	*count = region_count;
+	return regions;
+}
@@ -3,5 +3,8 @@ LOCAL_DIR := $(GET_LOCAL_DIR)
 
 OBJS += \
 	$(LOCAL_DIR)/cmdline.o \
+	$(LOCAL_DIR)/heap.o \
+	$(LOCAL_DIR)/highmem.o \
 	$(LOCAL_DIR)/lkfdt.o \
 	$(LOCAL_DIR)/mmu.o \
+	$(LOCAL_DIR)/region.o \
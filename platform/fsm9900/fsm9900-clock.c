@@ -77,6 +77,7 @@ static struct clk_ops clk_ops_cxo =
 static struct clk_ops clk_ops_pll_vote =
 {
 	.enable     = pll_vote_clk_enable,
+	.enable_nowait = pll_vote_clk_enable_nowait,
 	.disable    = pll_vote_clk_disable,
 	.auto_off   = pll_vote_clk_disable,
 	.is_enabled = pll_vote_clk_is_enabled,
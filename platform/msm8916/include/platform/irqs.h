@@ -46,6 +46,8 @@ int qtmr_irq(void);
 #define INT_QTMR_FRM_0_PHYSICAL_TIMER_EXP      qtmr_irq()
 #define INT_QTMR_FRM_0_PHYSICAL_TIMER_EXP_8x16 (GIC_SPI_START + 8)
 #define INT_QTMR_FRM_0_PHYSICAL_TIMER_EXP_8x39 (GIC_SPI_START + 257)
+#define SDCC1_IRQ                              (GIC_SPI_START + 123)
+#define SDCC2_IRQ                              (GIC_SPI_START + 125)
 #define SDCC1_PWRCTL_IRQ                       (GIC_SPI_START + 138)
 #define SDCC2_PWRCTL_IRQ                       (GIC_SPI_START + 221)
 
@@ -55,6 +57,8 @@ int qtmr_irq(void);
 /* Retrofit universal macro names */
 #define INT_USB_HS                             USB1_HS_IRQ
 
+#define MDSS_MDP_IRQ                           (GIC_SPI_START + 72)
+
 #define EE0_KRAIT_HLOS_SPMI_PERIPH_IRQ         (GIC_SPI_START + 190)
 
 #define NR_MSM_IRQS                            256
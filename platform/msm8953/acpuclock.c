@@ -35,9 +35,24 @@
 #include <clock.h>
 #include <platform/clock.h>
 #include <platform.h>
+#include <rpm-ipc.h>
 
 #define MAX_LOOPS	500
 
+/* Bus and DDR votes during large transfers, see rpm_bw_request() */
+static const struct rpm_bw_vote msm8953_bw_votes[] =
+{
+	{ RPM_BUS_CLK_TYPE, 0, 100000 },	/* pcnoc */
+	{ RPM_BUS_CLK_TYPE, 1, 200000 },	/* snoc */
+	{ RPM_MEM_CLK_TYPE, 0, 533000 },	/* bimc */
+};
+
+const struct rpm_bw_vote *platform_rpm_bw_votes(unsigned *count)
+{
+	*count = ARRAY_SIZE(msm8953_bw_votes);
+	return msm8953_bw_votes;
+}
+
 /*
  * Disable power collapse using GDSCR:
  * Globally Distributed Switch Controller Register
@@ -53,6 +53,8 @@
 /* Retrofit universal macro names */
 #define INT_USB_HS                             USB30_EE1_IRQ
 
+#define MDSS_MDP_IRQ                           (GIC_SPI_START + 72)
+
 #define EE0_KRAIT_HLOS_SPMI_PERIPH_IRQ         (GIC_SPI_START + 190)
 
 #define NR_MSM_IRQS                            256
@@ -80,6 +80,7 @@ static struct fixed_clk cxo_clk __UNUSED = {
  */
 struct clk_ops clk_ops_pll_vote = {
 	.enable = pll_vote_clk_enable,
+	.enable_nowait = pll_vote_clk_enable_nowait,
 	.disable = pll_vote_clk_disable,
 	.is_enabled = pll_vote_clk_is_enabled,
 	.get_rate = pll_vote_clk_get_rate,
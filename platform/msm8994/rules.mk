@@ -3,6 +3,13 @@ LOCAL_DIR := $(GET_LOCAL_DIR)
 ARCH    := arm
 ARM_CPU := cortex-a8
 CPU     := generic
+# Schedule for the Cortex-A53 cores the code actually runs on
+ARM_TUNE := cortex-a53
+
+# ARMv8 cores implement the CRC32 instructions in AArch32 state as well
+ENABLE_CRC32_ARMV8 := 1
+# The SHA instructions are optional, their presence is checked at runtime
+ENABLE_SHA_ARMV8 := 1
 
 DEFINES += ARM_CPU_CORE_KRAIT
 DEFINES += ARM_CORE_V8
@@ -36,6 +36,7 @@
 #include <platform/iomap.h>
 #include <pm8x41.h>
 #include <rpm-smd.h>
+#include <rpm-ipc.h>
 #include <regulator.h>
 #include <blsp_qup.h>
 #include <err.h>
@@ -58,6 +59,20 @@ uint32_t CE1_CLK[][8]=
 	},
 };
 
+/* Bus and DDR votes during large transfers, see rpm_bw_request() */
+static const struct rpm_bw_vote msm8996_bw_votes[] =
+{
+	{ RPM_BUS_CLK_TYPE, 0, 100000 },	/* pcnoc */
+	{ RPM_BUS_CLK_TYPE, 1, 200000 },	/* snoc */
+	{ RPM_MEM_CLK_TYPE, 0, 1017600 },	/* bimc */
+};
+
+const struct rpm_bw_vote *platform_rpm_bw_votes(unsigned *count)
+{
+	*count = ARRAY_SIZE(msm8996_bw_votes);
+	return msm8996_bw_votes;
+}
+
 void clock_init_mmc(uint32_t interface)
 {
 	char clk_name[64];
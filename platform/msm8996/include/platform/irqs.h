@@ -58,6 +58,8 @@ int usb_irq(void);
 /* Retrofit universal macro names */
 #define INT_USB_HS                             USB30_EE1_IRQ
 
+#define MDSS_MDP_IRQ                           (GIC_SPI_START + 83)
+
 #define SDCC1_PWRCTL_IRQ                       (GIC_SPI_START + 134)
 #define SDCC2_PWRCTL_IRQ                       (GIC_SPI_START + 221)
 
@@ -37,6 +37,10 @@
 #include "avb_util.h"
 #include "avb_vbmeta_image.h"
 
+#if WITH_MONT_ARM
+#include <mont_arm.h>
+#endif
+
 typedef struct IAvbKey {
   unsigned int len; /* Length of n[] in number of uint32_t */
   uint32_t n0inv;   /* -1 / n[0] mod 2^32 */
@@ -138,6 +142,11 @@ static void montMulAdd(const IAvbKey* key,
                        uint32_t* c,
                        const uint32_t a,
                        const uint32_t* b) {
+#if WITH_MONT_ARM
+  if (mont_mul_add_arm(c, a, b, key->n, key->n0inv, key->len)) {
+    subM(key, c);
+  }
+#else
   uint64_t A = (uint64_t)a * b[0] + c[0];
   uint32_t d0 = (uint32_t)A * key->n0inv;
   uint64_t B = (uint64_t)d0 * key->n[0] + (uint32_t)A;
@@ -156,6 +165,7 @@ static void montMulAdd(const IAvbKey* key,
   if (A >> 32) {
     subM(key, c);
   }
+#endif
 }
 
 /* montgomery c[] = a[] * b[] / R % mod */
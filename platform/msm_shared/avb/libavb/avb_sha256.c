@@ -134,6 +134,13 @@ static void SHA256_transform(AvbSHA256Ctx* ctx,
   int j;
 #endif
 
+#if WITH_SHA_ARMV8
+  if (sha_armv8_supported()) {
+    sha256_armv8_blocks(ctx->h, message, block_nb);
+    return;
+  }
+#endif
+
   for (i = 0; i < (int)block_nb; i++) {
     sub_block = message + (i << 6);
 
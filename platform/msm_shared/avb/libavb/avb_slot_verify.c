@@ -74,6 +74,9 @@
 /* Maximum size of a vbmeta image - 64 KiB. */
 #define VBMETA_MAX_SIZE (64 * 1024)
 
+/* Size of the two buffers used to hash partitions while they are read. */
+#define HASH_STREAM_CHUNK_SIZE (256 * 1024)
+
 /* Helper function to see if we should continue with verification in
  * allow_verification_error=true mode if something goes wrong. See the
  * comments for the avb_slot_verify() function for more information.
@@ -97,6 +100,82 @@ static inline bool result_should_continue(AvbSlotVerifyResult result) {
   return false;
 }
 
+/* State for hashing the salt followed by a partition that is read in
+ * chunks, see hash_find_read().
+ */
+typedef struct {
+  AvbOps* ops;
+  const char* part_name;
+  const uint8_t* salt;
+  uint32_t salt_len;
+  uint64_t pos;
+} HashStream;
+
+static int hash_stream_read(void* cookie, unsigned char* buf, unsigned int size) {
+  HashStream* hs = cookie;
+  size_t num_read = 0;
+  unsigned int n = 0;
+
+  if (hs->pos < hs->salt_len) {
+    n = hs->salt_len - hs->pos;
+    if (n > size) {
+      n = size;
+    }
+    avb_memcpy(buf, hs->salt + hs->pos, n);
+    hs->pos += n;
+  }
+
+  if (n < size) {
+    if (hs->ops->read_from_partition(hs->ops,
+                                     hs->part_name,
+                                     hs->pos - hs->salt_len,
+                                     size - n,
+                                     buf + n,
+                                     &num_read) != AVB_IO_RESULT_OK ||
+        num_read != size - n) {
+      return -1;
+    }
+    hs->pos += size - n;
+  }
+
+  return 0;
+}
+
+/* Computes the SHA-256 digest of |salt| followed by the first
+ * |image_size| bytes of |part_name| without loading the whole partition:
+ * the next chunk is read while the crypto engine hashes the previous one.
+ */
+static AvbSlotVerifyResult hash_partition_streaming(AvbOps* ops,
+                                                    const char* part_name,
+                                                    const uint8_t* salt,
+                                                    uint32_t salt_len,
+                                                    uint64_t image_size,
+                                                    uint8_t* digest) {
+  HashStream hs = {ops, part_name, salt, salt_len, 0};
+  crypto_result_type crypto_ret;
+  uint8_t* buf;
+
+  buf = avb_malloc(2 * HASH_STREAM_CHUNK_SIZE);
+  if (buf == NULL) {
+    return AVB_SLOT_VERIFY_RESULT_ERROR_OOM;
+  }
+
+  crypto_ret = hash_find_read(hash_stream_read,
+                              &hs,
+                              salt_len + image_size,
+                              buf,
+                              HASH_STREAM_CHUNK_SIZE,
+                              digest,
+                              CRYPTO_AUTH_ALG_SHA256);
+  avb_free(buf);
+
+  if (crypto_ret != CRYPTO_SHA_ERR_NONE) {
+    avb_errorv(part_name, ": Error hashing data from partition.\n", NULL);
+    return AVB_SLOT_VERIFY_RESULT_ERROR_IO;
+  }
+  return AVB_SLOT_VERIFY_RESULT_OK;
+}
+
 static AvbSlotVerifyResult load_and_verify_hash_partition(
     AvbOps* ops,
     const char* const* requested_partitions,
@@ -117,6 +196,8 @@ static AvbSlotVerifyResult load_and_verify_hash_partition(
   size_t digest_len;
   const char* found = NULL;
   uint64_t image_size;
+  void* preloaded_buf;
+  uint32_t preloaded_size;
 
   if (!avb_hash_descriptor_validate_and_byteswap(
           (const AvbHashDescriptor*)descriptor, &hash_desc)) {
@@ -182,6 +263,30 @@ static AvbSlotVerifyResult load_and_verify_hash_partition(
       image_size = hash_desc.image_size;
   }
 
+  /* Partitions that were not loaded in advance are only hashed, the data
+   * is not needed afterwards so it is not kept in memory.
+   */
+  if (avb_strncmp((const char*)hash_desc.hash_algorithm, "sha256",
+                  avb_strlen("sha256")) == 0 &&
+      getimage(&preloaded_buf, &preloaded_size, found) != 0) {
+    digest = avb_malloc(AVB_SHA256_DIGEST_SIZE);
+    if (digest == NULL) {
+      ret = AVB_SLOT_VERIFY_RESULT_ERROR_OOM;
+      goto out;
+    }
+    ret = hash_partition_streaming(ops,
+                                   part_name,
+                                   desc_salt,
+                                   hash_desc.salt_len,
+                                   hash_desc.image_size,
+                                   digest);
+    if (ret != AVB_SLOT_VERIFY_RESULT_OK) {
+      goto out;
+    }
+    digest_len = AVB_SHA256_DIGEST_SIZE;
+    goto check_digest;
+  }
+
   io_ret = ops->read_from_partition(
             ops, found, 0 /* offset */, image_size, &image_buf, &part_num_read);
 
@@ -205,18 +310,21 @@ static AvbSlotVerifyResult load_and_verify_hash_partition(
 
   if (avb_strncmp((const char*)hash_desc.hash_algorithm, "sha256",
                   avb_strlen ("sha256")) == 0) {
-    uint32_t complete_len = hash_desc.salt_len + hash_desc.image_size;
+    /* The salt is hashed from the descriptor, without copying it in front
+     * of the image.
+     */
+    struct crypto_sg sg[2] = {
+        {(unsigned char*)desc_salt, hash_desc.salt_len},
+        {ADD_SALT_BUFF_OFFSET(image_buf), hash_desc.image_size},
+    };
     digest = avb_malloc(AVB_SHA256_DIGEST_SIZE);
-    if(digest == NULL || hash_desc.salt_len > SALT_BUFF_OFFSET )
+    if(digest == NULL)
     {
         avb_errorv(part_name, ": Failed to allocate memory\n", NULL);
         ret = AVB_SLOT_VERIFY_RESULT_ERROR_IO;
         goto out;
     }
-    image_buf = ADD_SALT_BUFF_OFFSET(image_buf) - hash_desc.salt_len;
-    avb_memcpy(image_buf, desc_salt, hash_desc.salt_len);
-    hash_find(image_buf, complete_len, digest, CRYPTO_AUTH_ALG_SHA256);
-    image_buf = SUB_SALT_BUFF_OFFSET(image_buf) +  hash_desc.salt_len;
+    hash_find_sg(sg, 2, digest, CRYPTO_AUTH_ALG_SHA256);
     digest_len = AVB_SHA256_DIGEST_SIZE;
   } else if (avb_strncmp((const char*)hash_desc.hash_algorithm, "sha512",
                   avb_strlen ("sha512")) == 0) {
@@ -241,6 +349,7 @@ static AvbSlotVerifyResult load_and_verify_hash_partition(
     goto out;
   }
 
+check_digest:
   if (digest_len != hash_desc.digest_len) {
     avb_errorv(
         part_name, ": Digest in descriptor not of expected size.\n", NULL);
@@ -1235,9 +1344,9 @@ static AvbSlotVerifyResult append_options(
     case AVB_ALGORITHM_TYPE_SHA256_RSA2048:
     case AVB_ALGORITHM_TYPE_SHA256_RSA4096:
     case AVB_ALGORITHM_TYPE_SHA256_RSA8192: {
-      size_t n, prev_sz = 0, total_size = 0;
+      size_t n, total_size = 0;
       uint8_t* digest = NULL;
-      uint8_t* tbuf = NULL;
+      struct crypto_sg* sg = NULL;
 
       digest = avb_malloc(AVB_SHA256_DIGEST_SIZE);
       if(digest == NULL)
@@ -1246,25 +1355,23 @@ static AvbSlotVerifyResult append_options(
         ret = AVB_SLOT_VERIFY_RESULT_ERROR_IO;
         goto out;
       }
-      for (n = 0; n < slot_data->num_vbmeta_images; n++) {
-        total_size += slot_data->vbmeta_images[n].vbmeta_size;
-      }
-      tbuf = avb_malloc(total_size);
-      if(tbuf == NULL)
+      sg = avb_malloc(slot_data->num_vbmeta_images * sizeof(*sg));
+      if(sg == NULL)
       {
-        avb_error("Failed to allocate memory for tbuf\n");
+        avb_error("Failed to allocate memory for sg\n");
         ret = AVB_SLOT_VERIFY_RESULT_ERROR_IO;
         avb_free(digest);
         goto out;
       }
 
+      /* The vbmeta images are hashed where they are, one after another. */
       for (n = 0; n < slot_data->num_vbmeta_images; n++) {
-        avb_memcpy(tbuf + prev_sz, slot_data->vbmeta_images[n].vbmeta_data,
-                                   slot_data->vbmeta_images[n].vbmeta_size);
-        prev_sz = slot_data->vbmeta_images[n].vbmeta_size;
+        sg[n].addr = slot_data->vbmeta_images[n].vbmeta_data;
+        sg[n].len = slot_data->vbmeta_images[n].vbmeta_size;
+        total_size += slot_data->vbmeta_images[n].vbmeta_size;
       }
-      hash_find((unsigned char *)tbuf, total_size, digest, CRYPTO_AUTH_ALG_SHA256);
-      avb_free(tbuf);
+      hash_find_sg(sg, slot_data->num_vbmeta_images, digest, CRYPTO_AUTH_ALG_SHA256);
+      avb_free(sg);
 
       if (!cmdline_append_option(
               slot_data, "androidboot.vbmeta.hash_alg", "sha256") ||
@@ -93,6 +93,51 @@ out:
 	return ret;
 }
 
+int clk_enable_all(struct clk **clks, unsigned num)
+{
+	uint32_t started = 0;
+	struct clk *clk;
+	unsigned i;
+	int ret = 0, err;
+
+	ASSERT(num <= 32);
+
+	/* Start the clocks that can be waited for later */
+	for (i = 0; i < num; i++) {
+		clk = clks[i];
+		if (!clk || clk->count || !clk->ops->enable_nowait ||
+		    !clk->ops->is_enabled)
+			continue;
+
+		/* On errors it is tried again with clk_enable() below */
+		if (clk_enable(clk_get_parent(clk)))
+			continue;
+		if (clk->ops->enable_nowait(clk)) {
+			clk_disable(clk_get_parent(clk));
+			continue;
+		}
+		clk->count++;
+		started |= BIT(i);
+	}
+
+	/* Enable the others, this overlaps with the wait as well */
+	for (i = 0; i < num; i++) {
+		if (started & BIT(i))
+			continue;
+		err = clk_enable(clks[i]);
+		ret = ret ? ret : err;
+	}
+
+	for (i = 0; i < num; i++) {
+		if (!(started & BIT(i)))
+			continue;
+		while (!clks[i]->ops->is_enabled(clks[i]))
+			;
+	}
+
+	return ret;
+}
+
 void clk_disable(struct clk *clk)
 {
 	struct clk *parent;
@@ -55,10 +55,15 @@ int clock_lib2_branch_clk_enable(struct clk *clk)
 {
 	int rc = 0;
 	uint32_t cbcr_val;
-	int retry = 100;
+	int retry = 10000;
 	struct branch_clk *bclk = to_branch_clk(clk);
 
 	cbcr_val  = readl(bclk->cbcr_reg);
+
+	/* Already enabled and running, e.g. by the previous bootloader */
+	if ((cbcr_val & CBCR_BRANCH_ENABLE_BIT) && !(cbcr_val & CBCR_BRANCH_OFF_BIT))
+		return rc;
+
 	cbcr_val |= CBCR_BRANCH_ENABLE_BIT;
 	writel(cbcr_val, bclk->cbcr_reg);
 
@@ -72,14 +77,15 @@ int clock_lib2_branch_clk_enable(struct clk *clk)
 	while(readl(bclk->cbcr_reg) & CBCR_BRANCH_OFF_BIT)
 	{
 		/* Add 100 ms of time out, bail out if the clock is not enable
-		 * within 100 ms */
+		 * within 100 ms. Most clocks are on after a few microseconds,
+		 * so poll more often than once per millisecond. */
 		if (!retry)
 		{
 			rc = 1;
 			break;
 		}
 		retry--;
-		mdelay(1);
+		udelay(10);
 	}
 
 	return rc;
@@ -124,6 +130,37 @@ int clock_lib2_rcg_enable(struct clk *c)
 	return 0;
 }
 
+/* Whether the RCG already runs at @freq, e.g. set up by the previous bootloader */
+static bool clock_lib2_rcg_is_configured(struct rcg_clk *rclk, struct clk_freq_tbl *freq)
+{
+	uint32_t cfg, mode = 0;
+
+	/* Only the generic set_rate functions are known to program just this */
+	if (rclk->set_rate != clock_lib2_rcg_set_rate_mnd &&
+	    rclk->set_rate != clock_lib2_rcg_set_rate_hid)
+		return false;
+
+	/* Pending update or configuration that is not applied yet */
+	if (readl(rclk->cmd_reg) & (CMD_UPDATE_MASK | CMD_DIRTY_MASK))
+		return false;
+
+	cfg = readl(rclk->cfg_reg);
+	if ((cfg & (CFG_SRC_SEL_MASK | CFG_SRC_DIV_MASK)) != freq->div_src_val)
+		return false;
+
+	if (rclk->set_rate == clock_lib2_rcg_set_rate_hid)
+		return true;
+
+	if (freq->n_val)
+		mode = CFG_MODE_DUAL_EDGE << CFG_MODE_OFFSET;
+	if ((cfg & CFG_MODE_MASK) != mode)
+		return false;
+
+	return !freq->n_val || (readl(rclk->m_reg) == freq->m_val &&
+				readl(rclk->n_reg) == freq->n_val &&
+				readl(rclk->d_reg) == freq->d_val);
+}
+
 /* Root set rate:
  * Find the entry in the frequecy table corresponding to the requested rate.
  * Enable the source clock required for the new frequency.
@@ -151,9 +188,12 @@ int clock_lib2_rcg_set_rate(struct clk *c, unsigned rate)
 	/* First enable the source clock for this freq. */
 	clk_enable(nf->src_clk);
 
-	/* Perform clock-specific frequency switch operations. */
+	/* Perform clock-specific frequency switch operations, unless the
+	 * hardware is already configured for it the first time.
+	 */
 	ASSERT(rclk->set_rate);
-	rclk->set_rate(rclk, nf);
+	if (rclk->current_freq || !clock_lib2_rcg_is_configured(rclk, nf))
+		rclk->set_rate(rclk, nf);
 
 	/* update current freq */
 	rclk->current_freq = nf;
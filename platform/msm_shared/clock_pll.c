@@ -39,15 +39,27 @@
 /*
  * pll_vote_clk functions
  */
-int pll_vote_clk_enable(struct clk *clk)
+int pll_vote_clk_enable_nowait(struct clk *clk)
 {
 	uint32_t ena;
 	struct pll_vote_clk *pll = to_pll_vote_clk(clk);
 
 	ena = readl_relaxed(pll->en_reg);
+	if (ena & pll->en_mask)
+		return 0;
+
 	ena |= pll->en_mask;
 	writel_relaxed(ena, pll->en_reg);
 
+	return 0;
+}
+
+int pll_vote_clk_enable(struct clk *clk)
+{
+	struct pll_vote_clk *pll = to_pll_vote_clk(clk);
+
+	pll_vote_clk_enable_nowait(clk);
+
 	/* Wait until PLL is enabled */
 	while ((readl_relaxed(pll->status_reg) & pll->status_mask) == 0);
 
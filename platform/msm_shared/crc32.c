@@ -85,11 +85,69 @@ const uint32_t crc32_table[256] = {
 	0x2d02ef8dL
 };
 
+#if WITH_CRC32_ARMV8
+/* crc32-armv8.S */
+uint32_t crc32_armv8(uint32_t crc, const void *buf, size_t size);
+
+uint32_t crc32(uint32_t crc, const void *buf, size_t size)
+{
+	return crc32_armv8(crc, buf, size);
+}
+#else
+/*
+ * Slicing-by-8: crc32_slice[k][n] is the CRC of byte n followed by k zero
+ * bytes, which allows to process 8 bytes with independent table lookups.
+ * The tables are derived from crc32_table on first use.
+ */
+static uint32_t crc32_slice[8][256];
+static bool crc32_slice_init;
+
+static void crc32_init_slice(void)
+{
+	uint32_t c;
+	int i, k;
+
+	for (i = 0; i < 256; i++) {
+		c = crc32_table[i];
+		crc32_slice[0][i] = c;
+		for (k = 1; k < 8; k++) {
+			c = crc32_table[c & 0xff] ^ (c >> 8);
+			crc32_slice[k][i] = c;
+		}
+	}
+	crc32_slice_init = true;
+}
+
 uint32_t crc32(uint32_t crc, const void *buf, size_t size)
 {
 	const uint8_t *p = buf;
+	uint32_t a, b;
+
+	if (!crc32_slice_init)
+		crc32_init_slice();
+
+	while (size && ((uintptr_t)p & 3)) {
+		crc = crc32_table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+		size--;
+	}
+
+	while (size >= 8) {
+		a = *(const uint32_t *)p ^ crc;
+		b = *(const uint32_t *)(p + 4);
+		crc = crc32_slice[7][a & 0xff] ^
+		      crc32_slice[6][(a >> 8) & 0xff] ^
+		      crc32_slice[5][(a >> 16) & 0xff] ^
+		      crc32_slice[4][a >> 24] ^
+		      crc32_slice[3][b & 0xff] ^
+		      crc32_slice[2][(b >> 8) & 0xff] ^
+		      crc32_slice[1][(b >> 16) & 0xff] ^
+		      crc32_slice[0][b >> 24];
+		p += 8;
+		size -= 8;
+	}
 
 	while (size--)
 		crc = crc32_table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
 	return crc;
 }
+#endif
@@ -473,9 +473,38 @@ static void crypto5_set_auth_cfg(struct crypto_dev *dev, uint8_t **buffer,
 	REG_WRITE_EXEC(&dev->bam, 1, CRYPTO_WRITE_PIPE_INDEX);
 }
 
-uint32_t crypto5_send_data(struct crypto_dev *dev,
-						   void *ctx_ptr,
-						   uint8_t *data_ptr)
+/* Queue the read of the status and digest after the data */
+static uint32_t crypto5_add_dump_desc(struct crypto_dev *dev)
+{
+	uint32_t bam_status;
+
+	arch_clean_invalidate_cache_range((addr_t) (dev->dump), sizeof(struct output_dump));
+
+	bam_status = ADD_READ_DESC(&dev->bam,
+							   (unsigned char *)PA((addr_t)(dev->dump)),
+							   sizeof(struct output_dump),
+							   BAM_DESC_INT_FLAG);
+
+	if (bam_status)
+	{
+		dprintf(CRITICAL, "Crypto send data failed\n");
+		return CRYPTO_ERR_FAIL;
+	}
+
+	return CRYPTO_ERR_NONE;
+}
+
+/* Function: crypto5_send_data_start
+ * Arg     : dev, ctx_ptr, data_ptr
+ * Return  : CRYPTO_ERR_NONE if the data is being processed by the HW.
+ * Flow    : Queue the descriptors for the data configured with
+ *           crypto5_set_ctx() and return without waiting for the HW, so
+ *           that the CPU can prepare the next buffer. The operation must be
+ *           completed with crypto5_send_data_wait().
+ */
+uint32_t crypto5_send_data_start(struct crypto_dev *dev,
+								 void *ctx_ptr,
+								 uint8_t *data_ptr)
 {
 	uint32_t bam_status;
 	crypto_SHA256_ctx *sha256_ctx = (crypto_SHA256_ctx *) ctx_ptr;
@@ -505,12 +534,52 @@ uint32_t crypto5_send_data(struct crypto_dev *dev,
 		goto CRYPTO_SEND_DATA_ERR;
 	}
 
-	arch_clean_invalidate_cache_range((addr_t) (dev->dump), sizeof(struct output_dump));
+	ret_status = crypto5_add_dump_desc(dev);
+	if (ret_status != CRYPTO_ERR_NONE)
+		goto CRYPTO_SEND_DATA_ERR;
 
-	bam_status = ADD_READ_DESC(&dev->bam,
-							   (unsigned char *)PA((addr_t)(dev->dump)),
-							   sizeof(struct output_dump),
-							   BAM_DESC_INT_FLAG);
+	return CRYPTO_ERR_NONE;
+
+CRYPTO_SEND_DATA_ERR:
+
+	crypto5_unlock_pipes(dev);
+
+	return ret_status;
+}
+
+/* Function: crypto5_send_data_sg_start
+ * Arg     : dev, ctx_ptr, sg, count
+ * Return  : CRYPTO_ERR_NONE if the data is being processed by the HW.
+ * Flow    : Same as crypto5_send_data_start() for data in several buffers,
+ *           with one descriptor per buffer, so the data does not need to be
+ *           copied together first. The buffers must not be longer than one
+ *           descriptor and must fit into the FIFO, see
+ *           crypto5_get_max_sg_desc().
+ */
+uint32_t crypto5_send_data_sg_start(struct crypto_dev *dev,
+									void *ctx_ptr,
+									const struct crypto_sg *sg,
+									uint32_t count)
+{
+	uint32_t bam_status = 0;
+	crypto_SHA256_ctx *sha256_ctx = (crypto_SHA256_ctx *) ctx_ptr;
+	uint32_t wr_flags = BAM_DESC_NWD_FLAG | BAM_DESC_INT_FLAG | BAM_DESC_EOT_FLAG;
+	uint32_t ret_status;
+	uint8_t *buffer = NULL;
+	uint32_t total_bytes_to_write = 0;
+	uint32_t i;
+
+	crypto5_set_auth_cfg(dev, &buffer, sg[0].addr, CRYPTO_BURST_LEN - 1, sha256_ctx->bytes_to_write,
+											&total_bytes_to_write);
+
+	for (i = 0; i < count; i++)
+	{
+		arch_clean_invalidate_cache_range((addr_t) sg[i].addr, sg[i].len);
+		bam_status = ADD_WRITE_DESC(&dev->bam, (unsigned char*)PA((addr_t)sg[i].addr), sg[i].len,
+									(i == count - 1) ? wr_flags : 0);
+		if (bam_status)
+			break;
+	}
 
 	if (bam_status)
 	{
@@ -519,19 +588,43 @@ uint32_t crypto5_send_data(struct crypto_dev *dev,
 		goto CRYPTO_SEND_DATA_ERR;
 	}
 
+	ret_status = crypto5_add_dump_desc(dev);
+	if (ret_status != CRYPTO_ERR_NONE)
+		goto CRYPTO_SEND_DATA_ERR;
+
+	return CRYPTO_ERR_NONE;
+
+CRYPTO_SEND_DATA_ERR:
+
+	crypto5_unlock_pipes(dev);
+
+	return ret_status;
+}
+
+uint32_t crypto5_send_data_wait(struct crypto_dev *dev)
+{
 	crypto_wait_for_data(&dev->bam, CRYPTO_WRITE_PIPE_INDEX);
 
 	crypto_wait_for_data(&dev->bam, CRYPTO_READ_PIPE_INDEX);
 
 	arch_clean_invalidate_cache_range((addr_t) (dev->dump), sizeof(struct output_dump));
 
-	ret_status = CRYPTO_ERR_NONE;
+	crypto5_unlock_pipes(dev);
 
-CRYPTO_SEND_DATA_ERR:
+	return CRYPTO_ERR_NONE;
+}
 
-	crypto5_unlock_pipes(dev);
+uint32_t crypto5_send_data(struct crypto_dev *dev,
+						   void *ctx_ptr,
+						   uint8_t *data_ptr)
+{
+	uint32_t ret_status;
 
-	return ret_status;
+	ret_status = crypto5_send_data_start(dev, ctx_ptr, data_ptr);
+	if (ret_status != CRYPTO_ERR_NONE)
+		return ret_status;
+
+	return crypto5_send_data_wait(dev);
 }
 
 void crypto5_unlock_pipes(struct crypto_dev *dev)
@@ -611,3 +704,13 @@ uint32_t crypto5_get_max_auth_blk_size(struct crypto_dev *dev)
 {
 	return (dev->bam.max_desc_len * (dev->bam.pipe[CRYPTO_WRITE_PIPE_INDEX].fifo.size - 2));
 }
+
+/* Number of buffers crypto5_send_data_sg_start() can take, 0 if it cannot be used */
+uint32_t crypto5_get_max_sg_desc(struct crypto_dev *dev)
+{
+	/* Crypto 5.0.x needs burst aligned descriptors, see crypto5_set_auth_cfg() */
+	if (!((readl(CRYPTO_VERSION(dev->base)) & 0x00FF0000) >> 16))
+		return 0;
+
+	return (dev->bam.pipe[CRYPTO_WRITE_PIPE_INDEX].fifo.size - 2);
+}
@@ -100,6 +100,27 @@ void crypto_send_data(void *ctx_ptr,
 	*ret_status = crypto5_send_data(&dev, ctx_ptr, data_ptr);
 }
 
+void crypto_send_data_start(void *ctx_ptr,
+							unsigned char *data_ptr,
+							unsigned int bytes_to_write,
+							unsigned int *ret_status)
+{
+	*ret_status = crypto5_send_data_start(&dev, ctx_ptr, data_ptr);
+}
+
+void crypto_send_data_sg_start(void *ctx_ptr,
+							   const struct crypto_sg *sg,
+							   unsigned int count,
+							   unsigned int *ret_status)
+{
+	*ret_status = crypto5_send_data_sg_start(&dev, ctx_ptr, sg, count);
+}
+
+void crypto_send_data_wait(unsigned int *ret_status)
+{
+	*ret_status = crypto5_send_data_wait(&dev);
+}
+
 void crypto_get_digest(unsigned char *digest_ptr,
 					   unsigned int *ret_status,
 					   crypto_auth_alg_type auth_alg,
@@ -117,3 +138,8 @@ uint32_t crypto_get_max_auth_blk_size(void)
 {
 	return crypto5_get_max_auth_blk_size(&dev);
 }
+
+uint32_t crypto_get_max_sg_desc(void)
+{
+	return crypto5_get_max_sg_desc(&dev);
+}
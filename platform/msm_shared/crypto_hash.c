@@ -31,9 +31,14 @@
 #include <sha.h>
 #endif
 #include <debug.h>
+#include <stdlib.h>
 #include <sys/types.h>
 #include "crypto_hash.h"
 
+#if WITH_SHA_ARMV8
+#include <arch/arm.h>
+#endif
+
 static crypto_SHA256_ctx g_sha256_ctx;
 static crypto_SHA1_ctx g_sha1_ctx;
 static bool crypto_init_done;
@@ -49,6 +54,23 @@ extern void ce_clock_init(void);
 crypto_result_type
 hash_find(unsigned char *addr, unsigned int size, unsigned char *digest,
 	  unsigned char auth_alg)
+{
+#if WITH_SHA_ARMV8
+	/* The CPU instructions are considerably faster than the crypto engine */
+	if (sha_armv8_supported())
+		return hash_find_armv8(addr, size, digest, auth_alg);
+#endif
+	return hash_find_engine(addr, size, digest, auth_alg);
+}
+
+/*
+ * Same as hash_find() but only with the crypto engine, or in software if
+ * the platform does not have one.
+ */
+
+crypto_result_type
+hash_find_engine(unsigned char *addr, unsigned int size, unsigned char *digest,
+		 unsigned char auth_alg)
 {
 	crypto_result_type ret_val = CRYPTO_SHA_ERR_NONE;
 	crypto_engine_type platform_ce_type = board_ce_type();
@@ -229,6 +251,383 @@ crypto_sha1(unsigned char *buff_ptr,
 	return ret_val;
 }
 
+/*
+ * Functions to calculate SHAx digest of data that is not contiguous, e.g.
+ * because it is read from storage in chunks. The crypto engine cannot
+ * resume from a partial SHA block, so the size of the chunks passed to
+ * hash_update() must be a multiple of CRYPTO_SHA_BLOCK_SIZE. Only the last
+ * chunk passed to hash_final() may have any (non-zero) size.
+ */
+
+crypto_result_type
+hash_init(crypto_hash_ctx *ctx, crypto_auth_alg_type auth_alg)
+{
+	if (board_ce_type() != CRYPTO_ENGINE_TYPE_HW)
+		return CRYPTO_SHA_ERR_FAIL;
+
+	if (auth_alg == CRYPTO_AUTH_ALG_SHA1)
+		crypto_sha1_init(&ctx->sha.sha1);
+	else if (auth_alg == CRYPTO_AUTH_ALG_SHA256)
+		crypto_sha256_init(&ctx->sha.sha256);
+	else
+		return CRYPTO_SHA_ERR_INVALID_PARAM;
+
+	ctx->auth_alg = auth_alg;
+	ctx->first = TRUE;
+
+	/* Initialize crypto engine hardware for a new SHAx operation */
+	crypto_init();
+
+	return CRYPTO_SHA_ERR_NONE;
+}
+
+crypto_result_type
+hash_update(crypto_hash_ctx *ctx, unsigned char *addr, unsigned int size)
+{
+	crypto_result_type ret_val;
+
+	if ((!size) || (size % CRYPTO_SHA_BLOCK_SIZE) || (addr == NULL))
+		return CRYPTO_SHA_ERR_INVALID_PARAM;
+
+	ret_val = do_sha_update(&ctx->sha, addr, size, ctx->auth_alg,
+				ctx->first, FALSE);
+	if (ret_val != CRYPTO_SHA_ERR_NONE) {
+		dprintf(CRITICAL, "hash_update returns error %d\n", ret_val);
+		return ret_val;
+	}
+
+	ctx->first = FALSE;
+	return CRYPTO_SHA_ERR_NONE;
+}
+
+crypto_result_type
+hash_final(crypto_hash_ctx *ctx, unsigned char *addr, unsigned int size,
+	   unsigned char *digest)
+{
+	crypto_result_type ret_val;
+
+	if ((!size) || (addr == NULL) || (digest == NULL))
+		return CRYPTO_SHA_ERR_INVALID_PARAM;
+
+	ret_val = do_sha_update(&ctx->sha, addr, size, ctx->auth_alg,
+				ctx->first, TRUE);
+	if (ret_val != CRYPTO_SHA_ERR_NONE) {
+		dprintf(CRITICAL, "hash_final returns error %d\n", ret_val);
+		return ret_val;
+	}
+
+	/* Copy the digest value from context pointer to digest pointer */
+	if (ctx->auth_alg == CRYPTO_AUTH_ALG_SHA1)
+		memcpy(digest, (unsigned char *)ctx->sha.sha1.auth_iv, 20);
+	else
+		memcpy(digest, (unsigned char *)ctx->sha.sha256.auth_iv, 32);
+
+	return CRYPTO_SHA_ERR_NONE;
+}
+
+/*
+ * Crypto engines without DMA process the data while it is sent, they do
+ * not need to wait for anything.
+ */
+
+__WEAK void crypto_send_data_start(void *ctx_ptr, unsigned char *data_ptr,
+				   unsigned int bytes_to_write,
+				   unsigned int *ret_status)
+{
+	crypto_send_data(ctx_ptr, data_ptr, bytes_to_write, bytes_to_write,
+			 ret_status);
+}
+
+__WEAK void crypto_send_data_wait(unsigned int *ret_status)
+{
+	*ret_status = CRYPTO_ERR_NONE;
+}
+
+/*
+ * Read and hash the data in chunks: read() is called for the next chunk
+ * while the crypto engine hashes the previous one. The chunks are either
+ * read into the two buffers of chunk_size bytes at buf in turn, or one
+ * after another from buf on if in_place is set.
+ */
+
+static crypto_result_type
+hash_read_chunks(hash_read_func read, void *cookie, uint64_t size,
+		 unsigned char *buf, unsigned int chunk_size, bool in_place,
+		 unsigned char *digest, crypto_auth_alg_type auth_alg)
+{
+	crypto_hash_ctx ctx;
+	crypto_result_type ret_val;
+	unsigned char *cur = buf, *next = NULL;
+	unsigned int len, next_len = 0;
+	unsigned int status;
+	int read_ret = 0;
+	bool last;
+
+	/* Every chunk except the last one must be complete SHA blocks */
+	chunk_size = MIN(chunk_size, crypto_get_max_auth_blk_size());
+	chunk_size = ROUNDDOWN(chunk_size, CRYPTO_SHA_BLOCK_SIZE);
+	if ((!size) || (!chunk_size) || (digest == NULL))
+		return CRYPTO_SHA_ERR_INVALID_PARAM;
+
+	ret_val = hash_init(&ctx, auth_alg);
+	if (ret_val != CRYPTO_SHA_ERR_NONE)
+		return ret_val;
+
+	len = MIN(size, chunk_size);
+	if (read(cookie, cur, len))
+		return CRYPTO_SHA_ERR_FAIL;
+
+	for (;;) {
+		last = (len == size);
+		size -= len;
+
+		crypto_set_sha_ctx(&ctx.sha, len, auth_alg, ctx.first, last);
+		crypto_send_data_start(&ctx.sha, cur, len, &status);
+		if (status != CRYPTO_ERR_NONE) {
+			dprintf(CRITICAL, "hash_find_read returns error from crypto_send_data\n");
+			return CRYPTO_SHA_ERR_FAIL;
+		}
+
+		if (!last) {
+			if (in_place)
+				next = cur + len;
+			else
+				next = (cur == buf) ? buf + chunk_size : buf;
+			next_len = MIN(size, chunk_size);
+			read_ret = read(cookie, next, next_len);
+		}
+
+		crypto_send_data_wait(&status);
+		if (status == CRYPTO_ERR_NONE)
+			crypto_get_digest((unsigned char *)ctx.sha.sha1.auth_iv,
+					  &status, auth_alg, last);
+		if (status != CRYPTO_ERR_NONE) {
+			dprintf(CRITICAL, "hash_find_read returns error from crypto_get_digest\n");
+			return CRYPTO_SHA_ERR_FAIL;
+		}
+
+		if (last)
+			break;
+		if (read_ret)
+			return CRYPTO_SHA_ERR_FAIL;
+
+		crypto_get_ctx(&ctx.sha);
+		ctx.first = FALSE;
+		cur = next;
+		len = next_len;
+	}
+
+	if (auth_alg == CRYPTO_AUTH_ALG_SHA1)
+		memcpy(digest, (unsigned char *)ctx.sha.sha1.auth_iv, 20);
+	else
+		memcpy(digest, (unsigned char *)ctx.sha.sha256.auth_iv, 32);
+
+	return CRYPTO_SHA_ERR_NONE;
+}
+
+/*
+ * Function to calculate SHAx digest of data that is too large to be held in
+ * memory at once, e.g. a partition. read() is called to fill the two
+ * buffers of chunk_size bytes at buf in turn: the next chunk is read while
+ * the crypto engine hashes the previous one.
+ */
+
+crypto_result_type
+hash_find_read(hash_read_func read, void *cookie, uint64_t size,
+	       unsigned char *buf, unsigned int chunk_size,
+	       unsigned char *digest, crypto_auth_alg_type auth_alg)
+{
+	return hash_read_chunks(read, cookie, size, buf, chunk_size, FALSE,
+				digest, auth_alg);
+}
+
+/*
+ * Function to calculate SHAx digest of data while it is loaded to dest,
+ * e.g. an image read from storage, so it does not need a second pass over
+ * the memory afterwards. read() is called for the chunks of chunk_size
+ * bytes one after another, the next one is read while the crypto engine
+ * hashes the previous one.
+ */
+
+crypto_result_type
+hash_find_read_to(hash_read_func read, void *cookie, unsigned char *dest,
+		  unsigned int size, unsigned int chunk_size,
+		  unsigned char *digest, crypto_auth_alg_type auth_alg)
+{
+	return hash_read_chunks(read, cookie, size, dest, chunk_size, TRUE,
+				digest, auth_alg);
+}
+
+/*
+ * Crypto engines without scatter-gather support get the buffers copied
+ * together instead.
+ */
+
+__WEAK void crypto_send_data_sg_start(void *ctx_ptr,
+				      const struct crypto_sg *sg,
+				      unsigned int count,
+				      unsigned int *ret_status)
+{
+	*ret_status = CRYPTO_ERR_FAIL;
+}
+
+__WEAK uint32_t crypto_get_max_sg_desc(void)
+{
+	return 0;
+}
+
+static crypto_result_type
+hash_find_sg_copy(const struct crypto_sg *sg, unsigned int count,
+		  unsigned char *digest, crypto_auth_alg_type auth_alg)
+{
+	crypto_result_type ret_val;
+	unsigned int i, size = 0;
+	unsigned char *buf, *p;
+
+	for (i = 0; i < count; i++)
+		size += sg[i].len;
+
+	buf = malloc(size);
+	if (buf == NULL)
+		return CRYPTO_SHA_ERR_FAIL;
+
+	for (i = 0, p = buf; i < count; p += sg[i].len, i++)
+		memcpy(p, sg[i].addr, sg[i].len);
+
+	ret_val = hash_find(buf, size, digest, auth_alg);
+	free(buf);
+
+	return ret_val;
+}
+
+#define HASH_SG_BATCH	16
+
+/*
+ * Send the buffers to the crypto engine in batches of up to HASH_SG_BATCH
+ * descriptors. Every batch except the last one must be complete SHA blocks,
+ * so the end of a batch is moved back into its last buffers if necessary.
+ * Returns CRYPTO_SHA_ERR_INVALID_PARAM if the engine cannot take the buffers
+ * this way, so they are copied together instead.
+ */
+
+static crypto_result_type
+hash_find_sg_engine(const struct crypto_sg *sg, unsigned int count,
+		    unsigned char *digest, crypto_auth_alg_type auth_alg)
+{
+	struct crypto_sg batch[HASH_SG_BATCH];
+	unsigned int idx[HASH_SG_BATCH];
+	unsigned int max_desc, max_len, len, cut, n;
+	unsigned int i = 0, off = 0;
+	unsigned int status;
+	crypto_result_type ret_val;
+	crypto_hash_ctx ctx;
+	bool last;
+
+	ret_val = hash_init(&ctx, auth_alg);
+	if (ret_val != CRYPTO_SHA_ERR_NONE)
+		return ret_val;
+
+	/* Each buffer must fit into one descriptor */
+	max_desc = crypto_get_max_sg_desc();
+	if (!max_desc)
+		return CRYPTO_SHA_ERR_INVALID_PARAM;
+	max_len = crypto_get_max_auth_blk_size() / max_desc;
+	max_desc = MIN(max_desc, HASH_SG_BATCH);
+
+	do {
+		len = 0;
+		for (n = 0; n < max_desc && i < count;) {
+			if (off == sg[i].len) {
+				i++;
+				off = 0;
+				continue;
+			}
+			batch[n].addr = sg[i].addr + off;
+			batch[n].len = MIN(sg[i].len - off, max_len);
+			idx[n] = i;
+			off += batch[n].len;
+			len += batch[n].len;
+			n++;
+		}
+		while (i < count && off == sg[i].len) {
+			i++;
+			off = 0;
+		}
+		last = (i == count);
+
+		if (!last) {
+			cut = len % CRYPTO_SHA_BLOCK_SIZE;
+			len -= cut;
+			while (n && cut) {
+				if (batch[n - 1].len > cut) {
+					batch[n - 1].len -= cut;
+					break;
+				}
+				cut -= batch[n - 1].len;
+				n--;
+			}
+			if (n) {
+				i = idx[n - 1];
+				off = batch[n - 1].addr + batch[n - 1].len - sg[i].addr;
+			}
+		}
+		if (!n)
+			return CRYPTO_SHA_ERR_INVALID_PARAM;
+
+		crypto_set_sha_ctx(&ctx.sha, len, auth_alg, ctx.first, last);
+		crypto_send_data_sg_start(&ctx.sha, batch, n, &status);
+		if (status == CRYPTO_ERR_NONE)
+			crypto_send_data_wait(&status);
+		if (status == CRYPTO_ERR_NONE)
+			crypto_get_digest((unsigned char *)ctx.sha.sha1.auth_iv,
+					  &status, auth_alg, last);
+		if (status != CRYPTO_ERR_NONE) {
+			dprintf(CRITICAL, "hash_find_sg returns error from the crypto engine\n");
+			return CRYPTO_SHA_ERR_FAIL;
+		}
+
+		if (!last)
+			crypto_get_ctx(&ctx.sha);
+		ctx.first = FALSE;
+	} while (!last);
+
+	if (auth_alg == CRYPTO_AUTH_ALG_SHA1)
+		memcpy(digest, (unsigned char *)ctx.sha.sha1.auth_iv, 20);
+	else
+		memcpy(digest, (unsigned char *)ctx.sha.sha256.auth_iv, 32);
+
+	return CRYPTO_SHA_ERR_NONE;
+}
+
+/*
+ * Function to calculate SHAx digest of data in several buffers, e.g. chunks
+ * that were received or read separately, without copying them together first
+ * where the hardware allows it. The buffers may have any size.
+ */
+
+crypto_result_type
+hash_find_sg(const struct crypto_sg *sg, unsigned int count,
+	     unsigned char *digest, crypto_auth_alg_type auth_alg)
+{
+	crypto_result_type ret_val;
+
+	if ((sg == NULL && count) || (digest == NULL))
+		return CRYPTO_SHA_ERR_INVALID_PARAM;
+
+#if WITH_SHA_ARMV8
+	if (sha_armv8_supported())
+		return hash_find_sg_armv8(sg, count, digest, auth_alg);
+#endif
+
+	if (board_ce_type() == CRYPTO_ENGINE_TYPE_HW) {
+		ret_val = hash_find_sg_engine(sg, count, digest, auth_alg);
+		if (ret_val != CRYPTO_SHA_ERR_INVALID_PARAM)
+			return ret_val;
+	}
+
+	return hash_find_sg_copy(sg, count, digest, auth_alg);
+}
+
 /*
  * Common function to calculate SHA1 and SHA256 digest based on auth algorithm.
  */
@@ -414,3 +813,112 @@ calc_num_bytes_to_send(void *ctx_ptr, unsigned int buff_size, bool last)
 	}
 	return bytes_to_write;
 }
+
+#if WITH_SHA_ARMV8
+/*
+ * SHAx with the SHA1/SHA2 instructions of the ARMv8 Crypto Extensions,
+ * which are optional and also available in AArch32 state. sha-armv8.S
+ * only processes complete blocks, the padding is added here.
+ */
+
+bool sha_armv8_supported(void)
+{
+	static int supported = -1;
+	uint32_t isar5;
+
+	if (supported < 0) {
+		/* ID_ISAR5: SHA1 in bits [11:8], SHA2 in bits [15:12] */
+		__asm__("mrc p15, 0, %0, c0, c2, 5" : "=r"(isar5));
+		supported = arm_neon_enabled &&
+			    ((isar5 >> 8) & 0xf) == 1 && ((isar5 >> 12) & 0xf) == 1;
+	}
+	return supported;
+}
+
+crypto_result_type
+hash_find_armv8(unsigned char *addr, unsigned int size, unsigned char *digest,
+		unsigned char auth_alg)
+{
+	struct crypto_sg sg = { addr, size };
+
+	return hash_find_sg_armv8(&sg, 1, digest, auth_alg);
+}
+
+/* The part of a block left over from a buffer is completed by the next one */
+crypto_result_type
+hash_find_sg_armv8(const struct crypto_sg *sg, unsigned int count,
+		   unsigned char *digest, crypto_auth_alg_type auth_alg)
+{
+	static const uint32_t sha1_iv[SHA1_INIT_VECTOR_SIZE] = {
+		0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0
+	};
+	static const uint32_t sha256_iv[SHA256_INIT_VECTOR_SIZE] = {
+		0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
+		0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19
+	};
+	uint32_t state[SHA256_INIT_VECTOR_SIZE];
+	unsigned char tail[2 * CRYPTO_SHA_BLOCK_SIZE];
+	unsigned int blocks, fill = 0, tail_blocks;
+	unsigned int i, n, len, words;
+	const unsigned char *p;
+	uint64_t bits = 0;
+	void (*transform)(uint32_t *state, const void *data, size_t blocks);
+
+	if (auth_alg == CRYPTO_AUTH_ALG_SHA1) {
+		words = SHA1_INIT_VECTOR_SIZE;
+		memcpy(state, sha1_iv, sizeof(sha1_iv));
+		transform = sha1_armv8_blocks;
+	} else if (auth_alg == CRYPTO_AUTH_ALG_SHA256) {
+		words = SHA256_INIT_VECTOR_SIZE;
+		memcpy(state, sha256_iv, sizeof(sha256_iv));
+		transform = sha256_armv8_blocks;
+	} else {
+		return CRYPTO_SHA_ERR_FAIL;
+	}
+
+	if (digest == NULL)
+		return CRYPTO_SHA_ERR_INVALID_PARAM;
+
+	for (i = 0; i < count; i++) {
+		p = sg[i].addr;
+		len = sg[i].len;
+		if (p == NULL && len)
+			return CRYPTO_SHA_ERR_INVALID_PARAM;
+		bits += (uint64_t)len * 8;
+
+		if (fill) {
+			n = MIN(len, CRYPTO_SHA_BLOCK_SIZE - fill);
+			memcpy(tail + fill, p, n);
+			fill += n;
+			p += n;
+			len -= n;
+			if (fill < CRYPTO_SHA_BLOCK_SIZE)
+				continue;
+			transform(state, tail, 1);
+			fill = 0;
+		}
+
+		blocks = len / CRYPTO_SHA_BLOCK_SIZE;
+		transform(state, p, blocks);
+		fill = len % CRYPTO_SHA_BLOCK_SIZE;
+		memcpy(tail, p + blocks * CRYPTO_SHA_BLOCK_SIZE, fill);
+	}
+
+	/* 0x80, zeroes and the big endian length in bits */
+	tail_blocks = (fill < CRYPTO_SHA_BLOCK_SIZE - 8) ? 1 : 2;
+	memset(tail + fill, 0, sizeof(tail) - fill);
+	tail[fill] = 0x80;
+	for (i = 0; i < 8; i++)
+		tail[tail_blocks * CRYPTO_SHA_BLOCK_SIZE - 1 - i] = bits >> (8 * i);
+	transform(state, tail, tail_blocks);
+
+	for (i = 0; i < words; i++) {
+		digest[4 * i + 0] = state[i] >> 24;
+		digest[4 * i + 1] = state[i] >> 16;
+		digest[4 * i + 2] = state[i] >> 8;
+		digest[4 * i + 3] = state[i];
+	}
+
+	return CRYPTO_SHA_ERR_NONE;
+}
+#endif
@@ -40,6 +40,9 @@
 #include <platform/timer.h>
 #include <platform.h>
 #include <arch/ops.h>
+#include <kernel/dpc.h>
+#include <kernel/thread.h>
+#include <kernel/timer.h>
 
 #if PON_VIB_SUPPORT
 #include <vibrator.h>
@@ -89,6 +92,10 @@ struct lk_log {
 
 static struct lk_log log;
 
+/* The log can be moved with log_relocate(), e.g. to memory kept for the OS */
+static char *log_buf = log.data;
+static unsigned *log_ext_idx, *log_ext_used;
+
 static void log_init(void)
 {
 	log.header.cookie = LK_LOG_COOKIE;
@@ -97,10 +104,16 @@ static void log_init(void)
 
 static void log_putc(char c)
 {
-	log.data[log.header.idx++] = c;
+	log_buf[log.header.idx++] = c;
 	log.header.size_written++;
 	if (unlikely(log.header.idx >= log.header.max_size))
 		log.header.idx = 0;
+
+	if (log_ext_idx) {
+		*log_ext_idx = log.header.idx;
+		if (*log_ext_used < log.header.max_size)
+			(*log_ext_used)++;
+	}
 }
 
 unsigned log_copy(void *dst)
@@ -108,14 +121,48 @@ unsigned log_copy(void *dst)
 	if (log.header.size_written >= log.header.max_size) {
 		unsigned tail = log.header.max_size - log.header.idx;
 
-		memcpy(dst, &log.data[log.header.idx], tail);
-		memcpy(dst + tail, log.data, log.header.idx);
+		memcpy(dst, &log_buf[log.header.idx], tail);
+		memcpy(dst + tail, log_buf, log.header.idx);
 		return log.header.max_size;
 	} else {
-		memcpy(dst, log.data, log.header.idx);
+		memcpy(dst, log_buf, log.header.idx);
 		return log.header.idx;
 	}
 }
+
+void log_relocate(void *buf, unsigned size, unsigned *idx, unsigned *used)
+{
+	unsigned len, first, i;
+
+	enter_critical_section();
+
+	/* Copy the log in order, keeping only the end if buf is smaller */
+	if (log.header.size_written >= log.header.max_size) {
+		len = log.header.max_size;
+		first = log.header.idx;
+	} else {
+		len = log.header.idx;
+		first = 0;
+	}
+	if (len > size) {
+		first += len - size;
+		len = size;
+	}
+	for (i = 0; i < len; i++)
+		((char *)buf)[i] = log_buf[(first + i) % log.header.max_size];
+
+	log_buf = buf;
+	log.header.max_size = size;
+	log.header.idx = len % size;
+	log.header.size_written = len;
+
+	log_ext_idx = idx;
+	log_ext_used = used;
+	*idx = log.header.idx;
+	*used = len;
+
+	exit_critical_section();
+}
 #endif /* WITH_DEBUG_LOG_BUF */
 
 void display_fbcon_message(char *str)
@@ -127,11 +174,107 @@ void display_fbcon_message(char *str)
 #endif
 }
 
+#if WITH_DEBUG_FBCON && WITH_DEV_FBCON
+/*
+ * Drawing the log one character at a time scrolls the whole framebuffer and
+ * updates the display for every line. Instead, the text is kept in a ring
+ * and drawn with fbcon_write() from the dpc worker, at most every
+ * DEBUG_FBCON_INTERVAL ms while logging. Nothing is drawn from the logging
+ * context (which may be an interrupt handler) or with interrupts disabled.
+ * Text logged before the display is set up is shown once it is.
+ * debug_fbcon_flush() draws all pending text right away.
+ */
+#define DEBUG_FBCON_RING_SIZE	8192
+#define DEBUG_FBCON_CHUNK_SIZE	512
+#define DEBUG_FBCON_INTERVAL	100
+
+static char fbcon_ring[DEBUG_FBCON_RING_SIZE];
+static unsigned fbcon_head, fbcon_tail;
+static timer_t fbcon_timer;
+static struct dpc_work fbcon_work;
+static bool fbcon_timer_armed, fbcon_drawing;
+
+void debug_fbcon_flush(void)
+{
+	static char chunk[DEBUG_FBCON_CHUNK_SIZE];
+	unsigned start, len;
+
+	enter_critical_section();
+
+	/* The display driver may log while the text is drawn */
+	if (fbcon_drawing || !fbcon_display())
+		goto out;
+
+	fbcon_drawing = true;
+	for (;;) {
+		/* Like the other consoles, drop the text while the menu is shown */
+		if (debug_uart_suppress)
+			fbcon_tail = fbcon_head;
+		if (fbcon_head - fbcon_tail > DEBUG_FBCON_RING_SIZE)
+			fbcon_tail = fbcon_head - DEBUG_FBCON_RING_SIZE;
+		if (fbcon_tail == fbcon_head)
+			break;
+
+		/* Copy it out, the ring may be overwritten while drawing */
+		start = fbcon_tail % DEBUG_FBCON_RING_SIZE;
+		len = MIN(fbcon_head - fbcon_tail, DEBUG_FBCON_RING_SIZE - start);
+		len = MIN(len, DEBUG_FBCON_CHUNK_SIZE);
+		memcpy(chunk, fbcon_ring + start, len);
+		fbcon_tail += len;
+
+		exit_critical_section();
+		fbcon_write(chunk, len);
+		enter_critical_section();
+	}
+	fbcon_drawing = false;
+out:
+	exit_critical_section();
+}
+
+static void debug_fbcon_work(void *arg)
+{
+	debug_fbcon_flush();
+}
+
+static enum handler_return debug_fbcon_timer(timer_t *timer, time_t now, void *arg)
+{
+	fbcon_timer_armed = false;
+	dpc_work_queue(&fbcon_work, DPC_WORK_NORMAL, DPC_FLAG_NORESCHED);
+	return INT_RESCHEDULE;
+}
+
+static void debug_fbcon_putc(char c)
+{
+	/* Kernel timers are ready once threads run, see uart_putc() */
+	bool threads_running = !in_critical_section();
+
+	enter_critical_section();
+
+	fbcon_ring[fbcon_head++ % DEBUG_FBCON_RING_SIZE] = c;
+
+	if (!fbcon_timer_armed && threads_running && fbcon_display()) {
+		timer_set_oneshot(&fbcon_timer, DEBUG_FBCON_INTERVAL,
+				  debug_fbcon_timer, NULL);
+		fbcon_timer_armed = true;
+	}
+
+	exit_critical_section();
+}
+#else
+void debug_fbcon_flush(void)
+{
+}
+#endif
+
 void debug_init(void)
 {
 #if WITH_DEBUG_LOG_BUF
 	log_init();
 #endif
+#if WITH_DEBUG_FBCON && WITH_DEV_FBCON
+	timer_initialize(&fbcon_timer);
+	dpc_work_init(&fbcon_work, debug_fbcon_work, NULL);
+#endif
 }
 
 /*
@@ -189,7 +332,7 @@ void _dputc(char c)
 	uart_putc(0, c);
 #endif
 #if WITH_DEBUG_FBCON && WITH_DEV_FBCON
-	fbcon_putc(c, 0);
+	debug_fbcon_putc(c);
 #endif
 #if WITH_DEBUG_JTAG
 	jtag_dputc(c);
@@ -221,6 +364,10 @@ void platform_halt(void)
 	vib_turn_off();
 #endif
 	dprintf(CRITICAL, "HALT: reboot into dload mode...\n");
+#if WITH_DEBUG_UART
+	uart_flush_tx(0);
+#endif
+	debug_fbcon_flush();
 	arch_clean_cache_range(MEMBASE, MEMSIZE);
 	reboot_device(NORMAL_DLOAD);
 
@@ -50,6 +50,12 @@
 #endif
 #include <boot_stats.h>
 #include <verifiedboot.h>
+#if DTBO_CACHE
+#include <crypto_hash.h>
+#endif
+#if WITH_LK2ND_TRACE
+#include <lk2nd/trace.h>
+#endif
 
 #define NODE_PROPERTY_MAX_LEN   64
 #define ADD_OF(a, b) (UINT_MAX - b > a) ? (a + b) : UINT_MAX
@@ -96,9 +102,50 @@ static struct fstab_node fstab_table =
 #endif
 
 static struct dt_mem_node_info mem_node;
-static int platform_dt_absolute_match(struct dt_entry *cur_dt_entry, struct dt_entry_node *dt_list);
-static struct dt_entry *platform_dt_match_best(struct dt_entry_node *dt_list);
-static int update_dtb_entry_node(struct dt_entry_node *dt_list, uint32_t dtb_info);
+
+/* RAM partitions collected by dev_tree_add_mem_info() */
+#define DT_MEM_RANGES_MAX	32	/* RAM_NUM_PART_ENTRIES of smem */
+
+struct dt_mem_range
+{
+	uint64_t addr;
+	uint64_t size;
+};
+
+static struct dt_mem_range mem_ranges[DT_MEM_RANGES_MAX];
+
+/*
+ * The criteria for selecting the best DTB entry, in order of priority.
+ * Entries that pass platform_dt_absolute_match() are scored by each of them
+ * and only the best entry seen so far is kept, see dt_match_add().
+ */
+static const uint32_t dt_match_order[] = {
+	DTB_FOUNDRY,
+	DTB_PMIC_MODEL,
+	DTB_PANEL_TYPE,
+	DTB_BOOT_DEVICE,
+	DTB_SOC,
+	DTB_MAJOR_MINOR,
+	DTB_PMIC0,
+	DTB_PMIC1,
+	DTB_PMIC2,
+	DTB_PMIC3,
+};
+#define DT_MATCH_CRITERIA	ARRAY_SIZE(dt_match_order)
+
+struct dt_match {
+	struct dt_entry best;
+	uint32_t score[DT_MATCH_CRITERIA];
+	bool found;
+#if WITH_LK2ND_DEVICE
+	/* Record the entry of the DTB instead of matching it */
+	struct dt_entry *capture;
+#endif
+};
+
+static int platform_dt_absolute_match(struct dt_entry *cur_dt_entry, struct dt_match *match);
+static void dt_match_add(struct dt_match *match, const struct dt_entry *cur_dt_entry);
+static struct dt_entry *platform_dt_match_best(struct dt_match *match);
 extern int target_is_emmc_boot(void);
 extern uint32_t target_dev_tree_mem(void *fdt, uint32_t memory_node_offset);
 static int update_fstab_node(void *fdt);
@@ -154,27 +201,6 @@ int fdt_check_header_ext(const void *fdt)
    otherwise return 0xFFFFFFFF */
 #define INVALID_SOC_REV_ID 0XFFFFFFFF
 
-/* Add function to allocate dt entry list, used for recording
-*  the entry which conform to platform_dt_absolute_match()
-*/
-static struct dt_entry_node *dt_entry_list_init(void)
-{
-	struct dt_entry_node *dt_node_member = NULL;
-
-	dt_node_member = (struct dt_entry_node *)
-		malloc(sizeof(struct dt_entry_node));
-
-	ASSERT(dt_node_member);
-
-	list_clear_node(&dt_node_member->node);
-	dt_node_member->dt_entry_m = (struct dt_entry *)
-			malloc(sizeof(struct dt_entry));
-	ASSERT(dt_node_member->dt_entry_m);
-
-	memset(dt_node_member->dt_entry_m ,0 ,sizeof(struct dt_entry));
-	return dt_node_member;
-}
-
 /*
  * Function to validate dtbo image.
  * return: TRUE or FALSE.
@@ -784,22 +810,8 @@ void *get_board_dtb(void *dtbo_image_buf, uint32_t dtbo_image_sz)
 	return board_dtb;
 }
 
-static void insert_dt_entry_in_queue(struct dt_entry_node *dt_list, struct dt_entry_node *dt_node_member)
-{
-	list_add_tail(&dt_list->node, &dt_node_member->node);
-}
-
-static void dt_entry_list_delete(struct dt_entry_node *dt_node_member)
-{
-	if (list_in_list(&dt_node_member->node)) {
-			list_delete(&dt_node_member->node);
-			free(dt_node_member->dt_entry_m);
-			free(dt_node_member);
-	}
-}
-
 static int dev_tree_compatible(const void *dtb, const void *real_dtb, uint32_t dtb_size,
-			       int root_offset, struct dt_entry_node *dtb_list)
+			       int root_offset, struct dt_match *match)
 {
 	const void *prop = NULL;
 	const char *plat_prop = NULL;
@@ -872,7 +884,7 @@ if (DEBUGLEVEL >= SPEW) {
 	plat_prop = (const char *)fdt_getprop(dtb, root_offset, "qcom,msm-id", &len_plat_id);
 	if (!plat_prop || len_plat_id <= 0) {
 #if WITH_LK2ND_DEVICE
-		if (!dtb_list->dt_entry_m) /* Do not log for lk2nd device DTB */
+		if (!match->capture) /* Do not log for lk2nd device DTB */
 #endif
 		dprintf(INFO, "qcom,msm-id entry not found\n");
 		return false;
@@ -894,7 +906,7 @@ if (DEBUGLEVEL >= SPEW) {
 	if (dtb_ver == DEV_TREE_VERSION_V1) {
 #if WITH_LK2ND_DEVICE
 		/* Cannot override with more than one entry */
-		if (dtb_list->dt_entry_m && len_plat_id != min_plat_id_len) {
+		if (match->capture && len_plat_id != min_plat_id_len) {
 			if (model)
 				free(model);
 			return false;
@@ -929,7 +941,7 @@ if (DEBUGLEVEL >= SPEW) {
 				model ? model : "unknown",
 				cur_dt_entry->platform_id, cur_dt_entry->variant_id, cur_dt_entry->soc_rev);
 
-			if (platform_dt_absolute_match(cur_dt_entry, dtb_list)) {
+			if (platform_dt_absolute_match(cur_dt_entry, match)) {
 				dprintf(SPEW, "Device tree exact match the board: <%u %u 0x%x> != <%u %u 0x%x>\n",
 					cur_dt_entry->platform_id,
 					cur_dt_entry->variant_id,
@@ -967,7 +979,7 @@ if (DEBUGLEVEL >= SPEW) {
 
 #if WITH_LK2ND_DEVICE
 		/* Cannot override with more than one entry */
-		if (dtb_list->dt_entry_m && (board_data_count > 1 || msm_data_count > 1 || pmic_data_count > 1)) {
+		if (match->capture && (board_data_count > 1 || msm_data_count > 1 || pmic_data_count > 1)) {
 			if (model)
 				free(model);
 			return false;
@@ -1100,7 +1112,7 @@ if (DEBUGLEVEL >= SPEW) {
 				model ? model : "unknown",
 				dt_entry_array[i].platform_id, dt_entry_array[i].variant_id, dt_entry_array[i].board_hw_subtype, dt_entry_array[i].soc_rev);
 
-			if (platform_dt_absolute_match(&(dt_entry_array[i]), dtb_list)) {
+			if (platform_dt_absolute_match(&(dt_entry_array[i]), match)) {
 				dprintf(SPEW, "Device tree exact match the board: <%u %u %u 0x%x> == <%u %u %u 0x%x>\n",
 					dt_entry_array[i].platform_id,
 					dt_entry_array[i].variant_id,
@@ -1135,6 +1147,162 @@ if (DEBUGLEVEL >= SPEW) {
 	return true;
 }
 
+#if DTBO_CACHE
+/*
+ * The dtb with the DTBO applied is cached at the start of the
+ * DTBO_CACHE_PARTITION: a header in the first block followed by the dtb.
+ * It is keyed by the SHA-256 of the SoC dtb and the board DTBO, so the
+ * overlay is only applied again when one of them changes. The DTBO image
+ * is still loaded and validated on every boot to compute the key, and the
+ * cached dtb is checked against its own SHA-256 before it is used.
+ */
+#define str(s) #s
+#define xstr(s) str(s)
+#define DTBO_CACHE_MAGIC	0x43425444	/* "DTBC" */
+#define DTBO_CACHE_VERSION	1
+#define DTBO_CACHE_HASH_SIZE	(SHA256_INIT_VECTOR_SIZE * sizeof(uint32_t))
+
+struct dtbo_cache_hdr {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t size;
+	uint8_t key[DTBO_CACHE_HASH_SIZE];
+	uint8_t hash[DTBO_CACHE_HASH_SIZE];
+};
+
+static bool dtbo_cache_sha256(const void *data, uint32_t size, uint8_t *digest)
+{
+	static bool crypto_ready;
+
+	if (!crypto_ready) {
+		target_crypto_init_params();
+		crypto_ready = true;
+	}
+
+	return hash_find((unsigned char *)data, size, digest,
+			 CRYPTO_AUTH_ALG_SHA256) == CRYPTO_SHA_ERR_NONE;
+}
+
+/* SHA-256 over the SHA-256 of both inputs of the overlay */
+static bool dtbo_cache_key(const void *soc, const void *board, uint8_t *key)
+{
+	uint8_t digests[2 * DTBO_CACHE_HASH_SIZE];
+
+	return dtbo_cache_sha256(soc, fdt_totalsize(soc), digests) &&
+	       dtbo_cache_sha256(board, fdt_totalsize(board),
+				 digests + DTBO_CACHE_HASH_SIZE) &&
+	       dtbo_cache_sha256(digests, sizeof(digests), key);
+}
+
+/* Offset of the cache partition, 0 if it is missing or too small for @size */
+static unsigned long long dtbo_cache_ptn(uint32_t size)
+{
+	uint32_t block_size = mmc_get_device_blocksize();
+	int index = partition_get_index(xstr(DTBO_CACHE_PARTITION));
+
+	if (index == INVALID_PTN ||
+	    partition_get_size(index) < block_size + ROUNDUP((uint64_t)size, block_size))
+		return 0;
+
+	mmc_set_lun(partition_get_lun(index));
+	return partition_get_offset(index);
+}
+
+/*
+ * Read the cached dtb for @key to @tags. The SoC dtb may already be at @tags,
+ * so it is only overwritten once the cached dtb turned out to be valid.
+ * return: TRUE if there was a valid one.
+ */
+static bool dtbo_cache_load(const uint8_t *key, void *tags)
+{
+	uint32_t block_size = mmc_get_device_blocksize();
+	uint8_t hash[DTBO_CACHE_HASH_SIZE];
+	struct dtbo_cache_hdr hdr;
+	unsigned long long ptn;
+	bool found = false;
+	uint8_t *buf;
+
+	ptn = dtbo_cache_ptn(0);
+	if (!ptn)
+		return false;
+
+	buf = memalign(CACHE_LINE, ROUNDUP(block_size, CACHE_LINE));
+	if (!buf)
+		return false;
+
+	if (mmc_read(ptn, (uint32_t *)buf, block_size))
+	{
+		free(buf);
+		return false;
+	}
+	memcpy(&hdr, buf, sizeof(hdr));
+	free(buf);
+
+	if (hdr.magic != DTBO_CACHE_MAGIC || hdr.version != DTBO_CACHE_VERSION ||
+	    memcmp(hdr.key, key, sizeof(hdr.key)) ||
+	    ROUNDUP(hdr.size, block_size) > MAX_DTBO_SZ ||
+	    dtbo_cache_ptn(hdr.size) != ptn)
+		return false;
+
+	buf = memalign(CACHE_LINE, ROUNDUP(hdr.size, block_size));
+	if (!buf)
+		return false;
+
+	if (mmc_read(ptn + block_size, (uint32_t *)buf, ROUNDUP(hdr.size, block_size)))
+		goto out;
+
+	if (!dtbo_cache_sha256(buf, hdr.size, hash) ||
+	    memcmp(hash, hdr.hash, sizeof(hash)) ||
+	    fdt_check_header(buf) || fdt_totalsize(buf) != hdr.size)
+	{
+		dprintf(CRITICAL, "Cached DTBO result is corrupted, applying the overlay\n");
+		goto out;
+	}
+
+	memcpy(tags, buf, hdr.size);
+	found = true;
+out:
+	free(buf);
+	return found;
+}
+
+/* Store the dtb in @tags for @key, errors only cost the time next boot */
+static void dtbo_cache_save(const uint8_t *key, void *tags)
+{
+	uint32_t block_size = mmc_get_device_blocksize();
+	uint32_t size = fdt_totalsize(tags);
+	struct dtbo_cache_hdr *hdr;
+	unsigned long long ptn;
+
+	if (ROUNDUP(size, block_size) > MAX_DTBO_SZ)
+		return;
+
+	ptn = dtbo_cache_ptn(size);
+	if (!ptn) {
+		dprintf(INFO, "No room to cache the DTBO result\n");
+		return;
+	}
+
+	hdr = memalign(CACHE_LINE, ROUNDUP(block_size, CACHE_LINE));
+	if (!hdr)
+		return;
+
+	memset(hdr, 0, block_size);
+	hdr->magic = DTBO_CACHE_MAGIC;
+	hdr->version = DTBO_CACHE_VERSION;
+	hdr->size = size;
+	memcpy(hdr->key, key, sizeof(hdr->key));
+
+	/* The header goes last so that an interrupted write is never used */
+	if (!dtbo_cache_sha256(tags, size, hdr->hash) ||
+	    mmc_write(ptn + block_size, ROUNDUP(size, block_size), tags) ||
+	    mmc_write(ptn, block_size, hdr))
+		dprintf(CRITICAL, "Failed to cache the DTBO result\n");
+
+	free(hdr);
+}
+#endif /* DTBO_CACHE */
+
 /* function to handle the overlay in independent thread */
 static int dtb_overlay_handler(void *args)
 {
@@ -1191,6 +1359,10 @@ dtbo_error dev_tree_appended_with_dtbo(void *kernel, uint32_t kernel_size,
 {
 	void *dtbo_image_buf = NULL;
 	uint32_t dtbo_image_sz = 0;
+#if DTBO_CACHE
+	uint8_t cache_key[DTBO_CACHE_HASH_SIZE];
+	bool cache_key_valid = false;
+#endif
 
 	if (!target_is_emmc_boot())
 		return DTBO_NOT_SUPPORTED;
@@ -1223,6 +1395,15 @@ dtbo_error dev_tree_appended_with_dtbo(void *kernel, uint32_t kernel_size,
 				goto out;
 			}
 
+#if DTBO_CACHE
+			cache_key_valid = dtbo_cache_key(soc_dtb, board_dtb, cache_key);
+			if (cache_key_valid && dtbo_cache_load(cache_key, tags))
+			{
+				dprintf(INFO, "DTB overlay is cached\n");
+				goto out;
+			}
+#endif
+
 			/*
 			spawn a seperate thread for dtbo overlay with indpendent,
 			stack to avoid issues with stack corruption seen during flattening,
@@ -1256,6 +1437,14 @@ dtbo_error dev_tree_appended_with_dtbo(void *kernel, uint32_t kernel_size,
 		if (final_dtb_hdr != tags)
 			memscpy(tags, fdt_totalsize(final_dtb_hdr), final_dtb_hdr,
 						fdt_totalsize(final_dtb_hdr));
+#if DTBO_CACHE
+		if (dtbo_needed && cache_key_valid)
+		{
+			/* Only cache the used part, fdt_open_into() made it MAX_DTBO_SZ */
+			fdt_pack(tags);
+			dtbo_cache_save(cache_key, tags);
+		}
+#endif
 		dprintf(INFO, "DTB overlay is successful\n");
 	}
 	else
@@ -1286,9 +1475,7 @@ void *dev_tree_appended(void *kernel, uint32_t kernel_size, uint32_t dtb_offset,
 	void *bestmatch_tag = NULL;
 	struct dt_entry *best_match_dt_entry = NULL;
 	uint32_t bestmatch_tag_size;
-	struct dt_entry_node *dt_entry_queue = NULL;
-	struct dt_entry_node *dt_node_tmp1 = NULL;
-	struct dt_entry_node *dt_node_tmp2 = NULL;
+	struct dt_match match = {0};
 	dtbo_error ret = DTBO_NOT_SUPPORTED;
 	unsigned dtb_count = 0;
 
@@ -1306,17 +1493,6 @@ void *dev_tree_appended(void *kernel, uint32_t kernel_size, uint32_t dtb_offset,
 	else if (ret == DTBO_ERROR)
 		return NULL;
 
-	/* Initialize the dtb entry node*/
-	dt_entry_queue = (struct dt_entry_node *)
-				malloc(sizeof(struct dt_entry_node));
-
-	if (!dt_entry_queue) {
-		dprintf(CRITICAL, "Out of memory\n");
-		return NULL;
-	}
-	list_initialize(&dt_entry_queue->node);
-	dt_entry_queue->dt_entry_m = NULL;
-
 	if (((uintptr_t)kernel + (uintptr_t)app_dtb_offset) < (uintptr_t)kernel) {
 		return NULL;
 	}
@@ -1347,14 +1523,14 @@ void *dev_tree_appended(void *kernel, uint32_t kernel_size, uint32_t dtb_offset,
 			dtb_aligned = tags;
 		}
 
-		dev_tree_compatible(dtb_aligned, dtb, dtb_size, 0, dt_entry_queue);
+		dev_tree_compatible(dtb_aligned, dtb, dtb_size, 0, &match);
 
 		/* goto the next device tree if any */
 		dtb += dtb_size;
 		dtb_count++;
 	}
 
-	if (list_is_empty(&dt_entry_queue->node) && (dtb_count == 1)) {
+	if (!match.found && (dtb_count == 1)) {
 		/* Special case: If we only have one DTB appended which has not
 		 * been skales-generated, consider this DTB as the one which is
 		 * expected to be used regardless ok LK compatibility check.
@@ -1366,7 +1542,7 @@ void *dev_tree_appended(void *kernel, uint32_t kernel_size, uint32_t dtb_offset,
 		bestmatch_tag_size = dtb - (kernel + app_dtb_offset);
 	}
 
-	best_match_dt_entry = platform_dt_match_best(dt_entry_queue);
+	best_match_dt_entry = platform_dt_match_best(&match);
 	if (best_match_dt_entry){
 		bestmatch_tag = (void *)best_match_dt_entry->offset;
 		bestmatch_tag_size = best_match_dt_entry->size;
@@ -1384,12 +1560,6 @@ void *dev_tree_appended(void *kernel, uint32_t kernel_size, uint32_t dtb_offset,
 			board_pmic_target(0), board_pmic_target(1),
 			board_pmic_target(2), board_pmic_target(3));
 	}
-	/* free queue's memory */
-	list_for_every_entry(&dt_entry_queue->node, dt_node_tmp1, dt_node, node) {
-		dt_node_tmp2 = (struct dt_entry_node *) dt_node_tmp1->node.prev;
-		dt_entry_list_delete(dt_node_tmp1);
-		dt_node_tmp1 = dt_node_tmp2;
-	}
 
 	if(bestmatch_tag) {
 		if (check_aboot_addr_range_overlap((uintptr_t)tags, bestmatch_tag_size)) {
@@ -1449,13 +1619,12 @@ int dev_tree_validate(struct dt_table *table, unsigned int page_size, uint32_t *
 	return 0;
 }
 
-static int platform_dt_absolute_match(struct dt_entry *cur_dt_entry, struct dt_entry_node *dt_list)
+static int platform_dt_absolute_match(struct dt_entry *cur_dt_entry, struct dt_match *match)
 {
 	uint32_t cur_dt_hlos_ddr;
 	uint32_t cur_dt_hw_platform;
 	uint32_t cur_dt_hw_subtype;
 	uint32_t cur_dt_msm_id;
-	dt_node *dt_node_tmp = NULL;
 
 	/* Platform-id
 	* bit no |31	 24|23	16|15	0|
@@ -1473,11 +1642,11 @@ static int platform_dt_absolute_match(struct dt_entry *cur_dt_entry, struct dt_e
 		cur_dt_hw_platform = cur_dt_entry->variant_id;
 
 #if WITH_LK2ND_DEVICE
-	if (dt_list && dt_list->dt_entry_m) {
-		memcpy(dt_list->dt_entry_m, cur_dt_entry, sizeof(struct dt_entry));
+	if (match && match->capture) {
+		memcpy(match->capture, cur_dt_entry, sizeof(struct dt_entry));
 		return 1;
 	}
-	if (dt_list && lk2nd_dt_override.offset) {
+	if (match && lk2nd_dt_override.offset) {
 		/*
 		 * If the bootloader selected an unexpected DTB, we match
 		 * platform_id/variant_id/board_hw_subtype exactly, because we
@@ -1508,337 +1677,139 @@ static int platform_dt_absolute_match(struct dt_entry *cur_dt_entry, struct dt_e
 		((cur_dt_entry->pmic_rev[2] & 0x00ffff00) <= (board_pmic_target(2) & 0x00ffff00)) &&
 		((cur_dt_entry->pmic_rev[3] & 0x00ffff00) <= (board_pmic_target(3) & 0x00ffff00))) {
 
-#if WITH_LK2ND_DEVICE
-		if (!dt_list)
-			return 1;
-#endif
-
-		dt_node_tmp = dt_entry_list_init();
-		memcpy((char*)dt_node_tmp->dt_entry_m,(char*)cur_dt_entry, sizeof(struct dt_entry));
-
-		dprintf(SPEW, "Add DTB entry %u/%08x/0x%08x/%x/%x/%x/%x/%x/%x/%x\n",
-			dt_node_tmp->dt_entry_m->platform_id, dt_node_tmp->dt_entry_m->variant_id,
-			dt_node_tmp->dt_entry_m->board_hw_subtype, dt_node_tmp->dt_entry_m->soc_rev,
-			dt_node_tmp->dt_entry_m->pmic_rev[0], dt_node_tmp->dt_entry_m->pmic_rev[1],
-			dt_node_tmp->dt_entry_m->pmic_rev[2], dt_node_tmp->dt_entry_m->pmic_rev[3],
-			dt_node_tmp->dt_entry_m->offset, dt_node_tmp->dt_entry_m->size);
-
-		insert_dt_entry_in_queue(dt_list, dt_node_tmp);
+		if (match)
+			dt_match_add(match, cur_dt_entry);
 		return 1;
 	}
 	return 0;
 }
 
-static int platform_dt_absolute_compat_match(struct dt_entry_node *dt_list, uint32_t dtb_info) {
-	struct dt_entry_node *dt_node_tmp1 = NULL;
-	struct dt_entry_node *dt_node_tmp2 = NULL;
+/* Results of the compatibility checks, higher is better */
+#define DT_COMPAT_MISMATCH	0
+#define DT_COMPAT_DEFAULT	1
+#define DT_COMPAT_EXACT		2
+
+static bool dt_match_is_compat(uint32_t dtb_info)
+{
+	return dtb_info == DTB_FOUNDRY || dtb_info == DTB_PMIC_MODEL ||
+	       dtb_info == DTB_PANEL_TYPE || dtb_info == DTB_BOOT_DEVICE;
+}
+
+/*
+ * Score a DTB entry by one of the criteria in dt_match_order, higher is better.
+ *
+ * Compatibility checks (foundry id, PMIC model, panel type, boot device) must
+ * exactly match the board. If no DTB entry matches exactly, an entry with 0
+ * there is used instead. Everything else must be less than or equal to the
+ * board (see platform_dt_absolute_match()), so the highest value is the best.
+ */
+static uint32_t dt_match_score(const struct dt_entry *cur_dt_entry, uint32_t dtb_info)
+{
 	uint32_t current_info = 0;
 	uint32_t board_info = 0;
-	uint32_t best_info = 0;
-	uint32_t current_pmic_model[4] = {0, 0, 0, 0};
-	uint32_t board_pmic_model[4] = {0, 0, 0, 0};
-	uint32_t best_pmic_model[4] = {0, 0, 0, 0};
-	uint32_t delete_current_dt = 0;
 	uint32_t i;
 
 #if WITH_LK2ND_DEVICE
-	if (lk2nd_dt_override.offset && dtb_info != DTB_PMIC_MODEL)
-		return 1;
-#endif
-
-	/* start to select the exact entry
-	* default to exact match 0, if find current DTB entry info is the same as board info,
-	* then exact match board info.
-	*/
-	list_for_every_entry(&dt_list->node, dt_node_tmp1, dt_node, node) {
-		if (!dt_node_tmp1){
-			dprintf(SPEW, "Current node is the end\n");
-			break;
-		}
-		switch(dtb_info) {
-		case DTB_FOUNDRY:
-			current_info = ((dt_node_tmp1->dt_entry_m->platform_id) & 0x00ff0000);
-			board_info = board_foundry_id() << 16;
-			break;
-		case DTB_PMIC_MODEL:
-			for (i = 0; i < 4; i++) {
-				current_pmic_model[i] = (dt_node_tmp1->dt_entry_m->pmic_rev[i] & 0xff);
-				board_pmic_model[i] = (board_pmic_target(i) & 0xff);
-			}
-			break;
-		case DTB_PANEL_TYPE:
-			current_info = ((dt_node_tmp1->dt_entry_m->board_hw_subtype) & 0x1800);
-			board_info = (target_get_hlos_subtype() & 0x1800);
-			break;
-		case DTB_BOOT_DEVICE:
-			current_info = ((dt_node_tmp1->dt_entry_m->board_hw_subtype) & 0xf0000);
-			board_info = (target_get_hlos_subtype() & 0xf0000);
-			break;
-		default:
-			dprintf(CRITICAL, "ERROR: Unsupported version (%d) in dt node check \n",
-					dtb_info);
+	/* platform_dt_absolute_match() already compared with the selected DTB */
+	if (lk2nd_dt_override.offset) {
+		if (dtb_info == DTB_MAJOR_MINOR)
 			return 0;
-		}
-
-		if (dtb_info == DTB_PMIC_MODEL) {
-			if ((current_pmic_model[0] == board_pmic_model[0]) &&
-				(current_pmic_model[1] == board_pmic_model[1]) &&
-				(current_pmic_model[2] == board_pmic_model[2]) &&
-				(current_pmic_model[3] == board_pmic_model[3])) {
-
-				for (i = 0; i < 4; i++) {
-					best_pmic_model[i] = current_pmic_model[i];
-				}
-				break;
-			}
-		} else {
-			if (current_info == board_info) {
-				best_info = current_info;
-				break;
-			}
-		}
+		if (dt_match_is_compat(dtb_info) && dtb_info != DTB_PMIC_MODEL)
+			return DT_COMPAT_EXACT;
 	}
+#endif
 
-	list_for_every_entry(&dt_list->node, dt_node_tmp1, dt_node, node) {
-		if (!dt_node_tmp1){
-			dprintf(SPEW, "Current node is the end\n");
-			break;
-		}
-		switch(dtb_info) {
-		case DTB_FOUNDRY:
-			current_info = ((dt_node_tmp1->dt_entry_m->platform_id) & 0x00ff0000);
-			break;
-		case DTB_PMIC_MODEL:
-			for (i = 0; i < 4; i++) {
-				current_pmic_model[i] = (dt_node_tmp1->dt_entry_m->pmic_rev[i] & 0xff);
-			}
-			break;
-		case DTB_PANEL_TYPE:
-			current_info = ((dt_node_tmp1->dt_entry_m->board_hw_subtype) & 0x1800);
-			break;
-		case DTB_BOOT_DEVICE:
-			current_info = ((dt_node_tmp1->dt_entry_m->board_hw_subtype) & 0xf0000);
-			break;
-		default:
-			dprintf(CRITICAL, "ERROR: Unsupported version (%d) in dt node check \n",
-					dtb_info);
-			return 0;
-		}
-
-		if (dtb_info == DTB_PMIC_MODEL) {
-			if ((current_pmic_model[0] != best_pmic_model[0]) ||
-				(current_pmic_model[1] != best_pmic_model[1]) ||
-				(current_pmic_model[2] != best_pmic_model[2]) ||
-				(current_pmic_model[3] != best_pmic_model[3])) {
-
-				delete_current_dt = 1;
-			}
-		} else {
-			if (current_info != best_info) {
-				delete_current_dt = 1;
-			}
-		}
-
-		if (delete_current_dt) {
-			dprintf(SPEW, "Delete don't fit DTB entry %u/%08x/0x%08x/%x/%x/%x/%x/%x/%x/%x\n",
-				dt_node_tmp1->dt_entry_m->platform_id, dt_node_tmp1->dt_entry_m->variant_id,
-				dt_node_tmp1->dt_entry_m->board_hw_subtype, dt_node_tmp1->dt_entry_m->soc_rev,
-				dt_node_tmp1->dt_entry_m->pmic_rev[0], dt_node_tmp1->dt_entry_m->pmic_rev[1],
-				dt_node_tmp1->dt_entry_m->pmic_rev[2], dt_node_tmp1->dt_entry_m->pmic_rev[3],
-				dt_node_tmp1->dt_entry_m->offset, dt_node_tmp1->dt_entry_m->size);
-
-			dt_node_tmp2 = (struct dt_entry_node *) dt_node_tmp1->node.prev;
-			dt_entry_list_delete(dt_node_tmp1);
-			dt_node_tmp1 = dt_node_tmp2;
-			delete_current_dt = 0;
+	switch(dtb_info) {
+	case DTB_FOUNDRY:
+		current_info = ((cur_dt_entry->platform_id) & 0x00ff0000);
+		board_info = board_foundry_id() << 16;
+		break;
+	case DTB_PMIC_MODEL:
+		for (i = 0; i < 4; i++) {
+			current_info |= (cur_dt_entry->pmic_rev[i] & 0xff) << (i * 8);
+			board_info |= (board_pmic_target(i) & 0xff) << (i * 8);
 		}
+		break;
+	case DTB_PANEL_TYPE:
+		current_info = ((cur_dt_entry->board_hw_subtype) & 0x1800);
+		board_info = (target_get_hlos_subtype() & 0x1800);
+		break;
+	case DTB_BOOT_DEVICE:
+		current_info = ((cur_dt_entry->board_hw_subtype) & 0xf0000);
+		board_info = (target_get_hlos_subtype() & 0xf0000);
+		break;
+	case DTB_SOC:
+		return cur_dt_entry->soc_rev;
+	case DTB_MAJOR_MINOR:
+		return ((cur_dt_entry->variant_id) & 0x00ffff00);
+	case DTB_PMIC0:
+	case DTB_PMIC1:
+	case DTB_PMIC2:
+	case DTB_PMIC3:
+		return ((cur_dt_entry->pmic_rev[dtb_info - DTB_PMIC0]) & 0x00ffff00);
+	default:
+		dprintf(CRITICAL, "ERROR: Unsupported version (%d) in dt node check \n",
+				dtb_info);
+		return 0;
 	}
 
-	return 1;
+	if (current_info == board_info)
+		return DT_COMPAT_EXACT;
+	if (current_info == 0)
+		return DT_COMPAT_DEFAULT;
+	return DT_COMPAT_MISMATCH;
 }
 
-static int update_dtb_entry_node(struct dt_entry_node *dt_list, uint32_t dtb_info) {
-	struct dt_entry_node *dt_node_tmp1 = NULL;
-	struct dt_entry_node *dt_node_tmp2 = NULL;
-	uint32_t current_info = 0;
-	uint32_t board_info = 0;
-	uint32_t best_info = 0;
+static void dt_match_add(struct dt_match *match, const struct dt_entry *cur_dt_entry)
+{
+	uint32_t score[DT_MATCH_CRITERIA];
+	uint32_t i;
 
-#if WITH_LK2ND_DEVICE
-	if (lk2nd_dt_override.offset && dtb_info == DTB_MAJOR_MINOR)
-		return 1;
-#endif
+	dprintf(SPEW, "Add DTB entry %u/%08x/0x%08x/%x/%x/%x/%x/%x/%x/%x\n",
+		cur_dt_entry->platform_id, cur_dt_entry->variant_id,
+		cur_dt_entry->board_hw_subtype, cur_dt_entry->soc_rev,
+		cur_dt_entry->pmic_rev[0], cur_dt_entry->pmic_rev[1],
+		cur_dt_entry->pmic_rev[2], cur_dt_entry->pmic_rev[3],
+		cur_dt_entry->offset, cur_dt_entry->size);
 
-	/* start to select the best entry*/
-	list_for_every_entry(&dt_list->node, dt_node_tmp1, dt_node, node) {
-		if (!dt_node_tmp1){
-			dprintf(SPEW, "Current node is the end\n");
-			break;
-		}
-		switch(dtb_info) {
-		case DTB_SOC:
-			current_info = dt_node_tmp1->dt_entry_m->soc_rev;
-			board_info = board_soc_version();
-			break;
-		case DTB_MAJOR_MINOR:
-			current_info = ((dt_node_tmp1->dt_entry_m->variant_id) & 0x00ffff00);
-			board_info = (board_target_id() & 0x00ffff00);
-			break;
-		case DTB_PMIC0:
-			current_info = ((dt_node_tmp1->dt_entry_m->pmic_rev[0]) & 0x00ffff00);
-			board_info = (board_pmic_target(0) & 0x00ffff00);
-			break;
-		case DTB_PMIC1:
-			current_info = ((dt_node_tmp1->dt_entry_m->pmic_rev[1]) & 0x00ffff00);
-			board_info = (board_pmic_target(1) & 0x00ffff00);
-			break;
-		case DTB_PMIC2:
-			current_info = ((dt_node_tmp1->dt_entry_m->pmic_rev[2]) & 0x00ffff00);
-			board_info = (board_pmic_target(2) & 0x00ffff00);
-			break;
-		case DTB_PMIC3:
-			current_info = ((dt_node_tmp1->dt_entry_m->pmic_rev[3]) & 0x00ffff00);
-			board_info = (board_pmic_target(3) & 0x00ffff00);
-			break;
-		default:
-			dprintf(CRITICAL, "ERROR: Unsupported version (%d) in dt node check \n",
-					dtb_info);
-			return 0;
-		}
+	for (i = 0; i < DT_MATCH_CRITERIA; i++)
+		score[i] = dt_match_score(cur_dt_entry, dt_match_order[i]);
 
-		if (current_info == board_info) {
-			best_info = current_info;
-			break;
-		}
-		if ((current_info < board_info) && (current_info > best_info)) {
-			best_info = current_info;
-		}
-		if (current_info < best_info) {
-			dprintf(SPEW, "Delete don't fit DTB entry %u/%08x/0x%08x/%x/%x/%x/%x/%x/%x/%x\n",
-				dt_node_tmp1->dt_entry_m->platform_id, dt_node_tmp1->dt_entry_m->variant_id,
-				dt_node_tmp1->dt_entry_m->board_hw_subtype, dt_node_tmp1->dt_entry_m->soc_rev,
-				dt_node_tmp1->dt_entry_m->pmic_rev[0], dt_node_tmp1->dt_entry_m->pmic_rev[1],
-				dt_node_tmp1->dt_entry_m->pmic_rev[2], dt_node_tmp1->dt_entry_m->pmic_rev[3],
-				dt_node_tmp1->dt_entry_m->offset, dt_node_tmp1->dt_entry_m->size);
-
-			dt_node_tmp2 = (struct dt_entry_node *) dt_node_tmp1->node.prev;
-			dt_entry_list_delete(dt_node_tmp1);
-			dt_node_tmp1 = dt_node_tmp2;
+	/* The first criterion that differs decides, the first entry wins ties */
+	if (match->found) {
+		for (i = 0; i < DT_MATCH_CRITERIA; i++) {
+			if (score[i] != match->score[i])
+				break;
 		}
+		if (i == DT_MATCH_CRITERIA || score[i] < match->score[i])
+			return;
 	}
 
-	list_for_every_entry(&dt_list->node, dt_node_tmp1, dt_node, node) {
-		if (!dt_node_tmp1){
-			dprintf(SPEW, "Current node is the end\n");
-			break;
-		}
-		switch(dtb_info) {
-		case DTB_SOC:
-			current_info = dt_node_tmp1->dt_entry_m->soc_rev;
-			break;
-		case DTB_MAJOR_MINOR:
-			current_info = ((dt_node_tmp1->dt_entry_m->variant_id) & 0x00ffff00);
-			break;
-		case DTB_PMIC0:
-			current_info = ((dt_node_tmp1->dt_entry_m->pmic_rev[0]) & 0x00ffff00);
-			break;
-		case DTB_PMIC1:
-			current_info = ((dt_node_tmp1->dt_entry_m->pmic_rev[1]) & 0x00ffff00);
-			break;
-		case DTB_PMIC2:
-			current_info = ((dt_node_tmp1->dt_entry_m->pmic_rev[2]) & 0x00ffff00);
-			break;
-		case DTB_PMIC3:
-			current_info = ((dt_node_tmp1->dt_entry_m->pmic_rev[3]) & 0x00ffff00);
-			break;
-		default:
-			dprintf(CRITICAL, "ERROR: Unsupported version (%d) in dt node check \n",
-					dtb_info);
-			return 0;
-		}
-
-		if (current_info != best_info) {
-			dprintf(SPEW, "Delete don't fit DTB entry %u/%08x/0x%08x/%x/%x/%x/%x/%x/%x/%x\n",
-				dt_node_tmp1->dt_entry_m->platform_id, dt_node_tmp1->dt_entry_m->variant_id,
-				dt_node_tmp1->dt_entry_m->board_hw_subtype, dt_node_tmp1->dt_entry_m->soc_rev,
-				dt_node_tmp1->dt_entry_m->pmic_rev[0], dt_node_tmp1->dt_entry_m->pmic_rev[1],
-				dt_node_tmp1->dt_entry_m->pmic_rev[2], dt_node_tmp1->dt_entry_m->pmic_rev[3],
-				dt_node_tmp1->dt_entry_m->offset, dt_node_tmp1->dt_entry_m->size);
-
-			dt_node_tmp2 = (struct dt_entry_node *) dt_node_tmp1->node.prev;
-			dt_entry_list_delete(dt_node_tmp1);
-			dt_node_tmp1 = dt_node_tmp2;
-		}
-	}
-	return 1;
+	match->best = *cur_dt_entry;
+	memcpy(match->score, score, sizeof(score));
+	match->found = true;
 }
 
-static struct dt_entry *platform_dt_match_best(struct dt_entry_node *dt_list)
+static struct dt_entry *platform_dt_match_best(struct dt_match *match)
 {
-	struct dt_entry_node *dt_node_tmp1 = NULL;
-
-	/* check Foundry id
-	* the foundry id must exact match board founddry id, this is compatibility check,
-	* if couldn't find the exact match from DTB, will exact match 0x0.
-	*/
-	if (!platform_dt_absolute_compat_match(dt_list, DTB_FOUNDRY))
-		return NULL;
-
-	/* check PMIC model
-	* the PMIC model must exact match board PMIC model, this is compatibility check,
-	* if couldn't find the exact match from DTB, will exact match 0x0.
-	*/
-	if (!platform_dt_absolute_compat_match(dt_list, DTB_PMIC_MODEL))
-		return NULL;
-
-	/* check panel type
-	* the panel  type must exact match board panel type, this is compatibility check,
-	* if couldn't find the exact match from DTB, will exact match 0x0.
-	*/
-	if (!platform_dt_absolute_compat_match(dt_list, DTB_PANEL_TYPE))
-		return NULL;
-
-	/* check boot device subtype
-	* the boot device subtype must exact match board boot device subtype, this is compatibility check,
-	* if couldn't find the exact match from DTB, will exact match 0x0.
-	*/
-	if (!platform_dt_absolute_compat_match(dt_list, DTB_BOOT_DEVICE))
-		return NULL;
-
-	/* check soc version
-	* the suitable soc version must less than or equal to board soc version
-	*/
-	if (!update_dtb_entry_node(dt_list, DTB_SOC))
-		return NULL;
+	uint32_t i;
 
-	/*check major and minor version
-	* the suitable major&minor version must less than or equal to board major&minor version
-	*/
-	if (!update_dtb_entry_node(dt_list, DTB_MAJOR_MINOR))
+	if (!match->found)
 		return NULL;
 
-	/*check pmic info
-	* the suitable pmic major&minor info must less than or equal to board pmic major&minor version
-	*/
-	if (!update_dtb_entry_node(dt_list, DTB_PMIC0))
-		return NULL;
-	if (!update_dtb_entry_node(dt_list, DTB_PMIC1))
-		return NULL;
-	if (!update_dtb_entry_node(dt_list, DTB_PMIC2))
-		return NULL;
-	if (!update_dtb_entry_node(dt_list, DTB_PMIC3))
-		return NULL;
-
-	list_for_every_entry(&dt_list->node, dt_node_tmp1, dt_node, node) {
-		if (!dt_node_tmp1) {
+	/*
+	 * Compatibility checks have the highest priority, so if the best
+	 * entry failed one of them, all the other entries did too.
+	 */
+	for (i = 0; i < DT_MATCH_CRITERIA; i++) {
+		if (dt_match_is_compat(dt_match_order[i]) &&
+		    match->score[i] == DT_COMPAT_MISMATCH) {
 			dprintf(CRITICAL, "ERROR: Couldn't find the suitable DTB!\n");
 			return NULL;
 		}
-		if (dt_node_tmp1->dt_entry_m)
-			return dt_node_tmp1->dt_entry_m;
 	}
 
-	return NULL;
+	return &match->best;
 }
 
 /* Function to obtain the index information for the correct device tree
@@ -1856,10 +1827,7 @@ int dev_tree_get_entry_info(struct dt_table *table, struct dt_entry *dt_entry_in
 	struct dt_entry *best_match_dt_entry = NULL;
 	struct dt_entry_v1 *dt_entry_v1 = NULL;
 	struct dt_entry_v2 *dt_entry_v2 = NULL;
-	struct dt_entry_node *dt_entry_queue = NULL;
-	struct dt_entry_node *dt_node_tmp1 = NULL;
-	struct dt_entry_node *dt_node_tmp2 = NULL;
-	uint32_t found = 0;
+	struct dt_match match = {0};
 
 	if (!dt_entry_info) {
 		dprintf(CRITICAL, "ERROR: Bad parameter passed to %s \n",
@@ -1870,18 +1838,8 @@ int dev_tree_get_entry_info(struct dt_table *table, struct dt_entry *dt_entry_in
 	table_ptr = (unsigned char *)table + DEV_TREE_HEADER_SIZE;
 	cur_dt_entry = &dt_entry_buf_1;
 	best_match_dt_entry = NULL;
-	dt_entry_queue = (struct dt_entry_node *)
-				malloc(sizeof(struct dt_entry_node));
-
-	if (!dt_entry_queue) {
-		dprintf(CRITICAL, "Out of memory\n");
-		return -1;
-	}
-
-	list_initialize(&dt_entry_queue->node);
-	dt_entry_queue->dt_entry_m = NULL;
 	dprintf(INFO, "DTB Total entry: %d, DTB version: %d\n", table->num_entries, table->version);
-	for(i = 0; found == 0 && i < table->num_entries; i++)
+	for(i = 0; i < table->num_entries; i++)
 	{
 		memset(cur_dt_entry, 0, sizeof(struct dt_entry));
 		switch(table->version) {
@@ -1947,23 +1905,18 @@ int dev_tree_get_entry_info(struct dt_table *table, struct dt_entry *dt_entry_in
 		default:
 			dprintf(CRITICAL, "ERROR: Unsupported version (%d) in DT table \n",
 					table->version);
-			free(dt_entry_queue);
 			return -1;
 		}
 
 		/* DTBs must match the platform_id, platform_hw_id, platform_subtype and DDR size.
-		* The satisfactory DTBs are stored in dt_entry_queue
+		* The best of the satisfactory DTBs is kept in match
 		*/
-		platform_dt_absolute_match(cur_dt_entry, dt_entry_queue);
+		platform_dt_absolute_match(cur_dt_entry, &match);
 
 	}
-	best_match_dt_entry = platform_dt_match_best(dt_entry_queue);
+	best_match_dt_entry = platform_dt_match_best(&match);
 	if (best_match_dt_entry) {
 		*dt_entry_info = *best_match_dt_entry;
-		found = 1;
-	}
-
-	if (found != 0) {
 		dprintf(INFO, "Using DTB entry 0x%08x/%08x/0x%08x/%u for device 0x%08x/%08x/0x%08x/%u\n",
 				dt_entry_info->platform_id, dt_entry_info->soc_rev,
 				dt_entry_info->variant_id, dt_entry_info->board_hw_subtype,
@@ -1987,14 +1940,6 @@ int dev_tree_get_entry_info(struct dt_table *table, struct dt_entry *dt_entry_in
 	dprintf(CRITICAL, "ERROR: Unable to find suitable device tree for device (%u/0x%08x/0x%08x/%u)\n",
 			board_platform_id(), board_soc_version(),
 			board_target_id(), board_hardware_subtype());
-
-	list_for_every_entry(&dt_entry_queue->node, dt_node_tmp1, dt_node, node) {
-		/* free node memory */
-		dt_node_tmp2 = (struct dt_entry_node *) dt_node_tmp1->node.prev;
-		dt_entry_list_delete(dt_node_tmp1);
-		dt_node_tmp1 = dt_node_tmp2;
-	}
-	free(dt_entry_queue);
 	return -1;
 }
 
@@ -2096,104 +2041,93 @@ static void dev_tree_update_memory_node(uint32_t offset)
 	mem_node.size_cell_size = 1;
 }
 
-/* Function to add the subsequent RAM partition info to the device tree. */
+/* Function to add the subsequent RAM partition info to the device tree.
+ * The ranges are only collected here, adjacent ones are merged and
+ * dev_tree_write_mem_info() writes all of them with a single fdt_setprop().
+ */
 int dev_tree_add_mem_info(void *fdt, uint32_t offset, uint64_t addr, uint64_t size)
 {
+	struct dt_mem_range *last;
 	int ret = 0;
 
-	if(smem_get_ram_ptable_version() >= 1)
-	{
-		ret = dev_tree_query_memory_cell_sizes(fdt, &mem_node, offset);
-		if (ret < 0)
-		{
-			dprintf(CRITICAL, "Could not find #address-cells and #size-cells properties: ret %d\n", ret);
-			return ret;
-		}
-
-	}
-	else
-	{
-		dev_tree_update_memory_node(offset);
-	}
-
 	if (!(mem_node.mem_info_cnt))
 	{
-		/* Replace any other reg prop in the memory node. */
-
-		/* cell_size is the number of 32 bit words used to represent an address/length in the device tree.
-		 * memory node in DT can be either 32-bit(cell-size = 1) or 64-bit(cell-size = 2).So when updating
-		 * the memory node in the device tree, we write one word or two words based on cell_size = 1 or 2.
-		 */
-
-		if(mem_node.addr_cell_size == 2)
+		if(smem_get_ram_ptable_version() >= 1)
 		{
-			ret = fdt_setprop_u32(fdt, mem_node.offset, "reg", addr >> 32);
-			if(ret)
+			ret = dev_tree_query_memory_cell_sizes(fdt, &mem_node, offset);
+			if (ret < 0)
 			{
-				dprintf(CRITICAL, "ERROR: Could not set prop reg for memory node\n");
+				dprintf(CRITICAL, "Could not find #address-cells and #size-cells properties: ret %d\n", ret);
 				return ret;
 			}
 
-			ret = fdt_appendprop_u32(fdt, mem_node.offset, "reg", (uint32_t)addr);
-			if(ret)
-			{
-				dprintf(CRITICAL, "ERROR: Could not append prop reg for memory node\n");
-				return ret;
-			}
 		}
 		else
 		{
-			ret = fdt_setprop_u32(fdt, mem_node.offset, "reg", (uint32_t)addr);
-			if(ret)
-			{
-				dprintf(CRITICAL, "ERROR: Could not set prop reg for memory node\n");
-				return ret;
-			}
+			dev_tree_update_memory_node(offset);
 		}
-
-		mem_node.mem_info_cnt = 1;
 	}
 	else
 	{
-		/* Append the mem info to the reg prop for subsequent nodes.  */
-		if(mem_node.addr_cell_size == 2)
-		{
-			ret = fdt_appendprop_u32(fdt, mem_node.offset, "reg", addr >> 32);
-			if(ret)
-			{
-				dprintf(CRITICAL, "ERROR: Could not append prop reg for memory node\n");
-				return ret;
-			}
-		}
-
-		ret = fdt_appendprop_u32(fdt, mem_node.offset, "reg", (uint32_t)addr);
-		if(ret)
+		/* Extend the previous range if this one continues it and the
+		 * size still fits into the size cells.
+		 */
+		last = &mem_ranges[mem_node.mem_info_cnt - 1];
+		if (last->addr + last->size == addr &&
+			(mem_node.size_cell_size == 2 || last->size + size <= UINT32_MAX))
 		{
-			dprintf(CRITICAL, "ERROR: Could not append prop reg for memory node\n");
-			return ret;
+			last->size += size;
+			return 0;
 		}
 	}
 
-	if(mem_node.size_cell_size == 2)
+	if (mem_node.mem_info_cnt == DT_MEM_RANGES_MAX)
 	{
-		ret = fdt_appendprop_u32(fdt, mem_node.offset, "reg", size>>32);
-		if(ret)
-		{
-			dprintf(CRITICAL, "ERROR: Could not append prop reg for memory node\n");
-			return ret;
-		}
+		dprintf(CRITICAL, "ERROR: Too many memory ranges for the memory node\n");
+		return -1;
 	}
 
-	ret = fdt_appendprop_u32(fdt, mem_node.offset, "reg", (uint32_t)size);
+	mem_ranges[mem_node.mem_info_cnt].addr = addr;
+	mem_ranges[mem_node.mem_info_cnt].size = size;
+	mem_node.mem_info_cnt++;
+
+	return ret;
+}
+
+/* Replace the reg prop of the memory node with the collected ranges. */
+static int dev_tree_write_mem_info(void *fdt)
+{
+	/* cell_size is the number of 32 bit words used to represent an address/length in the device tree.
+	 * memory node in DT can be either 32-bit(cell-size = 1) or 64-bit(cell-size = 2).So when updating
+	 * the memory node in the device tree, we write one word or two words based on cell_size = 1 or 2.
+	 */
+	uint32_t reg[DT_MEM_RANGES_MAX * 4];
+	uint32_t i, len = 0;
+	int ret;
 
+	if (!(mem_node.mem_info_cnt))
+		return 0;
+
+	for (i = 0; i < mem_node.mem_info_cnt; i++)
+	{
+		if (mem_node.addr_cell_size == 2)
+			reg[len++] = cpu_to_fdt32(mem_ranges[i].addr >> 32);
+		reg[len++] = cpu_to_fdt32((uint32_t)mem_ranges[i].addr);
+
+		if (mem_node.size_cell_size == 2)
+			reg[len++] = cpu_to_fdt32(mem_ranges[i].size >> 32);
+		reg[len++] = cpu_to_fdt32((uint32_t)mem_ranges[i].size);
+	}
+	mem_node.mem_info_cnt = 0;
+
+	ret = fdt_setprop(fdt, mem_node.offset, "reg", reg, len * sizeof(uint32_t));
 	if (ret)
 	{
-		dprintf(CRITICAL, "Failed to add the memory information size: %d\n",
-				ret);
+		dprintf(CRITICAL, "ERROR: Could not set prop reg for memory node: %d\n", ret);
 		return ret;
 	}
 
-	return ret;
+	return 0;
 }
 
 static int call_dt_update_handlers(void *fdt, const char *cmdline,
@@ -2212,7 +2146,13 @@ static int call_dt_update_handlers(void *fdt, const char *cmdline,
 		boot_type |= BOOT_DOWNSTREAM;
 
 	for (dtu = &__dt_update_start; dtu < &__dt_update_end; ++dtu) {
+#if WITH_LK2ND_TRACE
+		LK2ND_TRACE_BEGIN(dtu->name, 0);
+#endif
 		ret = dtu->update_dt(fdt, cmdline, boot_type);
+#if WITH_LK2ND_TRACE
+		LK2ND_TRACE_END(dtu->name);
+#endif
 		if (ret) {
 			dprintf(CRITICAL, "%s failed: %d\n", dtu->name, ret);
 			return ret;
@@ -2268,8 +2208,11 @@ int update_device_tree(void *fdt, const char *cmdline, enum boot_type boot_type,
 	offset = ret;
 
 	ret = target_dev_tree_mem(fdt, offset);
+	if (!ret)
+		ret = dev_tree_write_mem_info(fdt);
 	if(ret)
 	{
+		mem_node.mem_info_cnt = 0;
 		dprintf(CRITICAL, "ERROR: Cannot update memory node\n");
 		return ret;
 	}
@@ -2348,12 +2291,13 @@ int update_device_tree(void *fdt, const char *cmdline, enum boot_type boot_type,
 	if (ret)
 		return ret;
 
-	fdt_pack(fdt);
-
 #if ENABLE_PARTIAL_GOODS_SUPPORT
 	update_partial_goods_dtb_nodes(fdt);
 #endif
 
+	/* Pack only once, after all updates */
+	fdt_pack(fdt);
+
 	return ret;
 }
 
@@ -2479,16 +2423,15 @@ static int update_fstab_node(void *fdt)
 #if WITH_LK2ND_DEVICE
 struct dt_entry *dev_tree_override_match(const void *fdt, int offset)
 {
-	struct dt_entry_node node = {
-		.node = LIST_INITIAL_VALUE(node.node),
-		.dt_entry_m = &lk2nd_dt_override,
+	struct dt_match match = {
+		.capture = &lk2nd_dt_override,
 	};
 
-	if (!dev_tree_compatible(fdt, fdt, fdt_totalsize(fdt), offset, &node))
+	if (!dev_tree_compatible(fdt, fdt, fdt_totalsize(fdt), offset, &match))
 		return NULL;
 
-	if (platform_dt_absolute_match(node.dt_entry_m, NULL))
-		node.dt_entry_m->offset = 0; /* No need to override */
+	if (platform_dt_absolute_match(match.capture, NULL))
+		match.capture->offset = 0; /* No need to override */
 	else
 		dprintf(INFO, "Unexpected DTB selected by bootloader, need to override\n");
 	return &lk2nd_dt_override;
@@ -496,10 +496,374 @@ out:
 	return ret;
 }
 
+/**
+ * write_vid_hdr_and_data() - Write the vid_header and the data of a PEB at once
+ * @peb: number of the physical erase block to write to
+ * @new_vidh: the vid_header to write
+ * @data: a data buffer to write
+ * @size: data size
+ * @si: pointer to struct ubi_scan_info
+ * @buf: buffer of (block size - si->vid_hdr_offs) bytes
+ *
+ * Only for the common layout where the data starts in the page after the
+ * vid_header. The header and the data pages are written with a single
+ * qpic_nand_write(), so the controller gets them queued together instead
+ * of waiting for the CPU between the header and the data.
+ *
+ * Return codes:
+ * -1 - in case of error
+ *  0 - on success
+ */
+static int write_vid_hdr_and_data(uint32_t peb, struct ubi_vid_hdr *new_vidh,
+		void *data, unsigned size, struct ubi_scan_info *si, unsigned char *buf)
+{
+	int page_size = flash_page_size();
+	int block_size = flash_block_size();
+	int num_pages_per_blk = block_size/page_size;
+	int num_pages;
+	int ret;
+
+	memset(buf, 0, page_size);
+	memcpy(buf, new_vidh, UBI_VID_HDR_SIZE);
+
+	if (size < block_size - si->data_offs)
+		num_pages = size / page_size;
+	else
+		num_pages = calc_data_len(page_size, data,
+				block_size - si->data_offs);
+	memcpy(buf + page_size, data, num_pages * page_size);
+
+	ret = qpic_nand_write(peb * num_pages_per_blk + si->vid_hdr_offs/page_size,
+			1 + num_pages, buf, 0);
+	if (ret) {
+		dprintf(CRITICAL,
+			"write_vid_hdr_and_data: qpic_nand_write failed with %d\n", ret);
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * scan_peb() - Read the headers of one PEB into the scan information
+ * @ptn: partition the PEB belongs to
+ * @si: scan information to update
+ * @i: number of the PEB, relative to the beginning of the partition
+ * @ec_hdr: buffer for the ec_header
+ */
+static void scan_peb(struct ptentry *ptn, struct ubi_scan_info *si,
+		unsigned i, struct ubi_ec_hdr *ec_hdr)
+{
+	struct ubi_vid_hdr vid_hdr;
+	int page_size = flash_page_size();
+	int ret;
+
+	ret = read_ec_hdr(ptn->start + i, ec_hdr);
+	switch (ret) {
+	case 1:
+		si->empty_cnt++;
+		si->pebs_data[i].ec = UBI_MAX_ERASECOUNTER;
+		si->pebs_data[i].status = UBI_EMPTY_PEB;
+		break;
+	case 0:
+		if (!si->vid_hdr_offs) {
+			si->vid_hdr_offs = BE32(ec_hdr->vid_hdr_offset);
+			si->data_offs = BE32(ec_hdr->data_offset);
+			if (!si->vid_hdr_offs || !si->data_offs ||
+				si->vid_hdr_offs % page_size ||
+				si->data_offs % page_size) {
+				si->bad_cnt++;
+				si->pebs_data[i].ec = UBI_MAX_ERASECOUNTER;
+				si->pebs_data[i].status = UBI_BAD_PEB;
+				si->vid_hdr_offs = 0;
+				return;
+			}
+			if (BE32(ec_hdr->vid_hdr_offset) != si->vid_hdr_offs) {
+				si->bad_cnt++;
+				si->pebs_data[i].ec = UBI_MAX_ERASECOUNTER;
+				si->pebs_data[i].status = UBI_BAD_PEB;
+				return;
+			}
+			if (BE32(ec_hdr->data_offset) != si->data_offs) {
+				si->bad_cnt++;
+				si->pebs_data[i].ec = UBI_MAX_ERASECOUNTER;
+				si->pebs_data[i].status = UBI_BAD_PEB;
+				return;
+			}
+		}
+		si->read_image_seq = BE32(ec_hdr->image_seq);
+		si->pebs_data[i].ec = BE64(ec_hdr->ec);
+		/* Now read the VID header to find if the peb is free */
+		ret = read_vid_hdr(ptn->start + i, &vid_hdr,
+				BE32(ec_hdr->vid_hdr_offset));
+		switch (ret) {
+		case 1:
+			si->pebs_data[i].status = UBI_FREE_PEB;
+			si->free_cnt++;
+			break;
+		case 0:
+			si->pebs_data[i].status = UBI_USED_PEB;
+			si->pebs_data[i].volume = BE32(vid_hdr.vol_id);
+			if (BE32(vid_hdr.vol_id) == UBI_LAYOUT_VOLUME_ID) {
+				if (si->vtbl_peb1 == -1)
+					si->vtbl_peb1 = i;
+				else if (si->vtbl_peb2 == -1)
+					si->vtbl_peb2 = i;
+				else
+					dprintf(CRITICAL,
+						"scan_partition: Found > 2 copies of vtbl");
+			}
+			if (BE32(vid_hdr.vol_id) == UBI_FM_SB_VOLUME_ID)
+				si->fastmap_sb = i;
+			si->used_cnt++;
+			break;
+		case -1:
+		default:
+			si->bad_cnt++;
+			si->pebs_data[i].ec = UBI_MAX_ERASECOUNTER;
+			si->pebs_data[i].status = UBI_BAD_PEB;
+			break;
+		}
+		break;
+	case -1:
+	default:
+		si->bad_cnt++;
+		si->pebs_data[i].ec = UBI_MAX_ERASECOUNTER;
+		si->pebs_data[i].status = UBI_BAD_PEB;
+		break;
+	}
+}
+
+/* Return the next @size bytes of the fastmap data, NULL past its end */
+static const void *fastmap_next(const uint8_t *fm, unsigned fm_size,
+		unsigned *off, unsigned size)
+{
+	const void *ptr = fm + *off;
+
+	if (size > fm_size - *off)
+		return NULL;
+
+	*off += size;
+	return ptr;
+}
+
+/**
+ * fastmap_walk() - Go through the lists and volumes of a fastmap
+ * @si: scan information, only updated if @apply is set
+ * @fm: data of all fastmap blocks, starting with struct ubi_fm_sb
+ * @fm_size: size of @fm
+ * @peb_count: number of PEBs in the partition
+ * @apply: false to only validate the fastmap
+ *
+ * Only PEBs that have not been scanned yet are taken from the fastmap.
+ * Used PEBs get their volume from the EBA tables, PEBs to be erased and
+ * the pool PEBs (which may have been written after the fastmap) are not
+ * taken and are left for scanning.
+ *
+ * Returns -1 if the fastmap is invalid, 0 otherwise.
+ */
+static int fastmap_walk(struct ubi_scan_info *si, const uint8_t *fm,
+		unsigned fm_size, unsigned peb_count, bool apply)
+{
+	const struct ubi_fm_hdr *fmh;
+	const struct ubi_fm_scan_pool *fmpl;
+	const struct ubi_fm_ec *fmec;
+	const struct ubi_fm_volhdr *fmvh;
+	const struct ubi_fm_eba *fmeba;
+	unsigned off = sizeof(struct ubi_fm_sb);
+	unsigned list_cnt[3];
+	unsigned i, j, n, pnum, vol_id;
+	struct peb_info *peb;
+
+	fmh = fastmap_next(fm, fm_size, &off, sizeof(*fmh));
+	if (!fmh || BE32(fmh->magic) != UBI_FM_HDR_MAGIC)
+		return -1;
+
+	/* Pool and wear-leveling pool */
+	for (i = 0; i < 2; i++) {
+		fmpl = fastmap_next(fm, fm_size, &off, sizeof(*fmpl));
+		if (!fmpl || BE32(fmpl->magic) != UBI_FM_POOL_MAGIC)
+			return -1;
+	}
+
+	/* Free, used and scrub PEBs, then the PEBs to be erased */
+	list_cnt[0] = BE32(fmh->free_peb_count);
+	list_cnt[1] = BE32(fmh->used_peb_count) + BE32(fmh->scrub_peb_count);
+	list_cnt[2] = BE32(fmh->erase_peb_count);
+	for (i = 0; i < 3; i++) {
+		if (list_cnt[i] > peb_count)
+			return -1;
+
+		for (n = 0; n < list_cnt[i]; n++) {
+			fmec = fastmap_next(fm, fm_size, &off, sizeof(*fmec));
+			if (!fmec || BE32(fmec->pnum) >= peb_count)
+				return -1;
+
+			peb = &si->pebs_data[BE32(fmec->pnum)];
+			if (!apply || i == 2 || peb->status != UBI_UNKNOWN)
+				continue;
+
+			peb->ec = BE32(fmec->ec);
+			peb->volume = -1;
+			if (i == 0) {
+				peb->status = UBI_FREE_PEB;
+				si->free_cnt++;
+			} else {
+				peb->status = UBI_USED_PEB;
+				si->used_cnt++;
+			}
+		}
+	}
+
+	for (i = 0; i < BE32(fmh->vol_count); i++) {
+		fmvh = fastmap_next(fm, fm_size, &off, sizeof(*fmvh));
+		if (!fmvh || BE32(fmvh->magic) != UBI_FM_VHDR_MAGIC)
+			return -1;
+		vol_id = BE32(fmvh->vol_id);
+
+		fmeba = fastmap_next(fm, fm_size, &off, sizeof(*fmeba));
+		if (!fmeba || BE32(fmeba->magic) != UBI_FM_EBA_MAGIC ||
+			BE32(fmeba->reserved_pebs) > peb_count)
+			return -1;
+		if (!fastmap_next(fm, fm_size, &off,
+				BE32(fmeba->reserved_pebs) * sizeof(uint32_t)))
+			return -1;
+
+		for (j = 0; j < BE32(fmeba->reserved_pebs); j++) {
+			pnum = BE32(fmeba->pnum[j]);
+			if (pnum == (uint32_t)-1)
+				continue;
+			if (pnum >= peb_count)
+				return -1;
+			if (!apply)
+				continue;
+
+			peb = &si->pebs_data[pnum];
+			if (peb->status == UBI_USED_PEB && peb->volume == -1)
+				peb->volume = vol_id;
+
+			if (vol_id == UBI_LAYOUT_VOLUME_ID) {
+				if (si->vtbl_peb1 == -1)
+					si->vtbl_peb1 = pnum;
+				else if (si->vtbl_peb1 != (int)pnum &&
+						si->vtbl_peb2 == -1)
+					si->vtbl_peb2 = pnum;
+			}
+		}
+	}
+
+	if (!apply)
+		return 0;
+
+	/* Used PEBs that are not in any volume are left for scanning */
+	for (i = 0; i < peb_count; i++) {
+		peb = &si->pebs_data[i];
+		if (peb->status == UBI_USED_PEB && peb->volume == -1) {
+			peb->status = UBI_UNKNOWN;
+			peb->ec = 0;
+			si->used_cnt--;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * scan_fastmap() - Fill the scan information from a UBI fastmap
+ * @ptn: partition to read the fastmap of
+ * @si: scan information to fill
+ * @ec_hdr: buffer for the ec_header
+ *
+ * The fastmap superblock is searched for in the first PEBs, which are
+ * scanned normally. On success, all PEBs described by the fastmap are
+ * filled in, the rest is left with status UBI_UNKNOWN.
+ *
+ * Returns -1 if there is no valid fastmap, 0 otherwise.
+ */
+static int scan_fastmap(struct ptentry *ptn, struct ubi_scan_info *si,
+		struct ubi_ec_hdr *ec_hdr)
+{
+	struct ubi_fm_sb *fmsb;
+	unsigned leb_size, fm_size, used_blocks, loc;
+	unsigned i, limit = ptn->length;
+	uint32_t crc;
+	uint8_t *fm;
+	int ret = -1;
+
+	if (limit > UBI_FM_MAX_START)
+		limit = UBI_FM_MAX_START;
+
+	for (i = 0; i < limit && si->fastmap_sb == -1; i++)
+		scan_peb(ptn, si, i, ec_hdr);
+
+	if (si->fastmap_sb == -1 || !si->data_offs)
+		return -1;
+
+	leb_size = flash_block_size() - si->data_offs;
+	fmsb = malloc(leb_size);
+	if (!fmsb) {
+		dprintf(CRITICAL, "scan_fastmap: Memory allocation failed\n");
+		return -1;
+	}
+
+	if (read_leb_data(ptn->start + si->fastmap_sb, fmsb, leb_size,
+			si->data_offs))
+		goto out_sb;
+
+	used_blocks = BE32(fmsb->used_blocks);
+	if (BE32(fmsb->magic) != UBI_FM_SB_MAGIC ||
+		fmsb->version != UBI_FM_FMT_VERSION ||
+		!used_blocks || used_blocks > UBI_FM_MAX_BLOCKS ||
+		BE32(fmsb->block_loc[0]) != (uint32_t)si->fastmap_sb) {
+		dprintf(INFO, "scan_fastmap: Invalid fastmap superblock\n");
+		goto out_sb;
+	}
+
+	fm_size = used_blocks * leb_size;
+	fm = malloc(fm_size);
+	if (!fm) {
+		dprintf(CRITICAL, "scan_fastmap: Memory allocation failed\n");
+		goto out_sb;
+	}
+
+	memcpy(fm, fmsb, leb_size);
+	for (i = 1; i < used_blocks; i++) {
+		loc = BE32(fmsb->block_loc[i]);
+		if (loc >= ptn->length ||
+			read_leb_data(ptn->start + loc, fm + i * leb_size,
+				leb_size, si->data_offs))
+			goto out;
+	}
+
+	/* The CRC covers all fastmap blocks, computed with data_crc = 0 */
+	((struct ubi_fm_sb *)fm)->data_crc = 0;
+	crc = mtd_crc32(UBI_CRC32_INIT, fm, fm_size);
+	if (BE32(fmsb->data_crc) != crc) {
+		dprintf(INFO, "scan_fastmap: Wrong crc: calculated %u, received %u\n",
+			crc, BE32(fmsb->data_crc));
+		goto out;
+	}
+
+	if (fastmap_walk(si, fm, fm_size, ptn->length, false)) {
+		dprintf(INFO, "scan_fastmap: Invalid fastmap data\n");
+		goto out;
+	}
+	fastmap_walk(si, fm, fm_size, ptn->length, true);
+	ret = 0;
+
+out:
+	free(fm);
+out_sb:
+	free(fmsb);
+	return ret;
+}
+
 /**
  * scan_partition() - Collect the ec_headers info of a given partition
  * @ptn: partition to read the headers of
  *
+ * If the partition has a valid UBI fastmap, only the PEBs it does not
+ * describe are scanned.
+ *
  * Returns allocated and filled struct ubi_scan_info (si).
  * Note: si should be released by caller.
  */
@@ -507,11 +871,8 @@ static struct ubi_scan_info *scan_partition(struct ptentry *ptn)
 {
 	struct ubi_scan_info *si;
 	struct ubi_ec_hdr *ec_hdr;
-	struct ubi_vid_hdr vid_hdr;
-	unsigned i;
+	unsigned i, scanned = 0;
 	unsigned long long sum = 0;
-	int page_size = flash_page_size();
-	int ret;
 
 	si = malloc(sizeof(*si));
 	if (!si) {
@@ -541,79 +902,20 @@ static struct ubi_scan_info *scan_partition(struct ptentry *ptn)
 	si->vtbl_peb1 = -1;
 	si->vtbl_peb2 = -1;
 	si->fastmap_sb = -1;
-	for (i = 0; i < ptn->length; i++){
-		ret = read_ec_hdr(ptn->start + i, ec_hdr);
-		switch (ret) {
-		case 1:
-			si->empty_cnt++;
-			si->pebs_data[i].ec = UBI_MAX_ERASECOUNTER;
-			si->pebs_data[i].status = UBI_EMPTY_PEB;
-			break;
-		case 0:
-			if (!si->vid_hdr_offs) {
-				si->vid_hdr_offs = BE32(ec_hdr->vid_hdr_offset);
-				si->data_offs = BE32(ec_hdr->data_offset);
-				if (!si->vid_hdr_offs || !si->data_offs ||
-					si->vid_hdr_offs % page_size ||
-					si->data_offs % page_size) {
-					si->bad_cnt++;
-					si->pebs_data[i].ec = UBI_MAX_ERASECOUNTER;
-					si->vid_hdr_offs = 0;
-					continue;
-				}
-				if (BE32(ec_hdr->vid_hdr_offset) != si->vid_hdr_offs) {
-					si->bad_cnt++;
-					si->pebs_data[i].ec = UBI_MAX_ERASECOUNTER;
-					continue;
-				}
-				if (BE32(ec_hdr->data_offset) != si->data_offs) {
-					si->bad_cnt++;
-					si->pebs_data[i].ec = UBI_MAX_ERASECOUNTER;
-					continue;
-				}
-			}
-			si->read_image_seq = BE32(ec_hdr->image_seq);
-			si->pebs_data[i].ec = BE64(ec_hdr->ec);
-			/* Now read the VID header to find if the peb is free */
-			ret = read_vid_hdr(ptn->start + i, &vid_hdr,
-					BE32(ec_hdr->vid_hdr_offset));
-			switch (ret) {
-			case 1:
-				si->pebs_data[i].status = UBI_FREE_PEB;
-				si->free_cnt++;
-				break;
-			case 0:
-				si->pebs_data[i].status = UBI_USED_PEB;
-				si->pebs_data[i].volume = BE32(vid_hdr.vol_id);
-				if (BE32(vid_hdr.vol_id) == UBI_LAYOUT_VOLUME_ID) {
-					if (si->vtbl_peb1 == -1)
-						si->vtbl_peb1 = i;
-					else if (si->vtbl_peb2 == -1)
-						si->vtbl_peb2 = i;
-					else
-						dprintf(CRITICAL,
-							"scan_partition: Found > 2 copies of vtbl");
-				}
-				if (BE32(vid_hdr.vol_id) == UBI_FM_SB_VOLUME_ID)
-					si->fastmap_sb = i;
-				si->used_cnt++;
-				break;
-			case -1:
-			default:
-				si->bad_cnt++;
-				si->pebs_data[i].ec = UBI_MAX_ERASECOUNTER;
-				si->pebs_data[i].status = UBI_BAD_PEB;
-				break;
-			}
-			break;
-		case -1:
-		default:
-			si->bad_cnt++;
-			si->pebs_data[i].ec = UBI_MAX_ERASECOUNTER;
-			si->pebs_data[i].status = UBI_BAD_PEB;
-			break;
-		}
+
+	if (scan_fastmap(ptn, si, ec_hdr))
+		dprintf(INFO, "scan_partition: (%s) No valid fastmap, scanning all PEBs\n",
+				ptn->name);
+
+	for (i = 0; i < ptn->length; i++) {
+		if (si->pebs_data[i].status != UBI_UNKNOWN)
+			continue;
+		scan_peb(ptn, si, i, ec_hdr);
+		scanned++;
 	}
+	dprintf(SPEW, "scan_partition: (%s) Scanned %u of %u PEBs\n",
+			ptn->name, scanned, ptn->length);
+	free(ec_hdr);
 
 	/* Sanity check */
 	if (si->bad_cnt + si->empty_cnt + si->free_cnt + si->used_cnt != (int)ptn->length) {
@@ -637,7 +939,6 @@ static struct ubi_scan_info *scan_partition(struct ptentry *ptn)
 	} else {
 		si->mean_ec = UBI_DEF_ERACE_COUNTER;
 	}
-	free(ec_hdr);
 	return si;
 
 out_failed:
@@ -1008,6 +1309,8 @@ out_free_leb:
  * @vol_id: volume ID this PEB belongs to
  * @data: data to write
  * @size: size of the data
+ * @buf: buffer for write_vid_hdr_and_data(), NULL to write the vid_header
+ *       and the data separately
  *
  * Assumption: EC header correctly written and PEB erased
  *
@@ -1017,13 +1320,25 @@ out_free_leb:
  */
 static int write_one_peb(int curr_peb, int ptn_start,
 		struct ubi_scan_info *si,
-		int lnum, int vol_id, void* data, int size)
+		int lnum, int vol_id, void* data, int size,
+		unsigned char *buf)
 {
 	int ret;
 	struct ubi_vid_hdr vidh;
 
 	memset((void *)&vidh, 0, UBI_VID_HDR_SIZE);
 	update_vid_header(&vidh, si, vol_id, lnum, 0);
+	if (buf) {
+		ret = write_vid_hdr_and_data(curr_peb + ptn_start, &vidh,
+				data, size, si, buf);
+		if (ret)
+			dprintf(CRITICAL, "update_ubi_vol: writing peb-%d failed\n",
+					curr_peb);
+		else
+			si->pebs_data[curr_peb].status = UBI_USED_PEB;
+		goto out;
+	}
+
 	if (write_vid_header(curr_peb + ptn_start, &vidh, si->vid_hdr_offs)) {
 		dprintf(CRITICAL,
 				"update_ubi_vol: write_vid_header for peb %d failed \n",
@@ -1060,6 +1375,7 @@ int update_ubi_vol(struct ptentry *ptn, const char* vol_name,
 	int vol_id, vol_pebs, curr_peb = 0, ret = -1;
 	unsigned block_size = flash_block_size();
 	void *img_peb;
+	unsigned char *buf = NULL;
 	struct ubi_vtbl_record curr_vol;
 	int img_pebs, lnum = 0;
 
@@ -1107,6 +1423,13 @@ int update_ubi_vol(struct ptentry *ptn, const char* vol_name,
 		curr_peb++;
 	}
 
+	/*
+	 * With the data right after the vid_header, both go to the flash in
+	 * one write. Otherwise, or without memory for it, write them apart.
+	 */
+	if (si->data_offs == si->vid_hdr_offs + flash_page_size())
+		buf = malloc(block_size - si->vid_hdr_offs);
+
 	/* Flash the image */
 	img_peb = data;
 	lnum = 0;
@@ -1120,7 +1443,7 @@ int update_ubi_vol(struct ptentry *ptn, const char* vol_name,
 		if (write_one_peb(curr_peb, ptn->start, si,
 				lnum++, vol_id, img_peb,
 				(size < block_size - si->data_offs ? size :
-						block_size - si->data_offs))) {
+						block_size - si->data_offs), buf)) {
 			dprintf(CRITICAL, "update_ubi_vol: write_one_peb failed\n");
 			goto out;
 		}
@@ -1139,6 +1462,7 @@ int update_ubi_vol(struct ptentry *ptn, const char* vol_name,
 	}
 	ret = 0;
 out:
+	free(buf);
 	free(si->pebs_data);
 	free(si);
 	return ret;
@@ -888,6 +888,31 @@ glink_err_type xport_rpm_isr( xport_rpm_ctx_type *ctx_ptr )
   return GLINK_STATUS_SUCCESS;
 }
 
+/*===========================================================================
+FUNCTION      xport_rpm_irq
+===========================================================================*/
+/**
+
+  Interrupt handler of RPM transport.
+
+  The RX callbacks wake up the thread waiting for the RPM answer, e.g. in
+  rpm_glink_send_data(). Without a reschedule that thread would only run at
+  the next timer tick, so every vote would take up to a full tick.
+
+  @param[in]  arg   Pointer to transport context.
+
+  @return     Always requests a reschedule.
+
+  @sideeffects  None.
+*/
+/*=========================================================================*/
+static enum handler_return xport_rpm_irq( void *arg )
+{
+  xport_rpm_isr((xport_rpm_ctx_type *)arg);
+
+  return INT_RESCHEDULE;
+}
+
 /*===========================================================================
 FUNCTION      xport_rpm_ssr
 ===========================================================================*/
@@ -1134,7 +1159,7 @@ glink_err_type xport_rpm_init(void *arg)
     }
 
     if ( !glink_os_register_isr( xport_rpm_ctx[ind].pcfg->irq_in,
-                                (os_isr_cb_fn)xport_rpm_isr,
+                                xport_rpm_irq,
                                 &xport_rpm_ctx[ind]) )
     {
        /* ISR registration failed, set index to invalid.
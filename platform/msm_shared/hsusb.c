@@ -48,13 +48,20 @@
 #include <target.h>
 #include "hsusb.h"
 
+#if WITH_LK2ND_PERF
+#include <lk2nd/perf.h>
+#endif
+#if WITH_LK2ND_TRACE
+#include <lk2nd/trace.h>
+#endif
+
 #define MAX_TD_XFER_SIZE  (16 * 1024)
 
 /*
  * Number of transfer descriptors pre-allocated per request. Each TD
- * moves up to MAX_TD_XFER_SIZE, so one request can transfer up to
- * MAX_TDS_PER_REQUEST * MAX_TD_XFER_SIZE (512 KiB) with a single
- * completion interrupt. UMS_HSUSB_MAX_XFER relies on this limit.
+ * moves up to MAX_TD_XFER_SIZE, larger requests grow the TD pool when
+ * they are queued, so one request can cover megabytes with a single
+ * completion interrupt.
  */
 #define MAX_TDS_PER_REQUEST  32
 #define TD_STRIDE  ROUNDUP(sizeof(struct ept_queue_item), CACHE_LINE)
@@ -158,6 +165,9 @@ __WEAK void hsusb_clock_init(void)
 struct usb_request {
 	struct udc_request req;
 	struct ept_queue_item *item;	/* first TD of the per-request pool */
+	unsigned max_tds;		/* TDs in the pool */
+	unsigned tds;			/* TDs used by the queued transfer */
+	struct usb_request *next;	/* next request queued on the endpoint */
 };
 
 /* TD i of a request's pool (TDs are laid out contiguously, TD_STRIDE apart) */
@@ -170,7 +180,7 @@ struct udc_endpoint {
 	struct udc_endpoint *next;
 	unsigned bit;
 	struct ept_queue_head *head;
-	struct usb_request *req;
+	struct usb_request *req;	/* oldest of the queued requests */
 	unsigned char num;
 	unsigned char in;
 	unsigned short maxpkt;
@@ -294,6 +304,7 @@ struct udc_request *udc_request_alloc(void)
 	req->req.length = 0;
 	req->item = memalign(CACHE_LINE, MAX_TDS_PER_REQUEST * TD_STRIDE);
 	ASSERT(req->item);
+	req->max_tds = MAX_TDS_PER_REQUEST;
 	return &req->req;
 }
 
@@ -306,9 +317,55 @@ void udc_request_free(struct udc_request *req)
 }
 
 /*
- * Builds the TD chain for the transfer from the request's TD pool.
- * A request can carry at most MAX_TDS_PER_REQUEST * MAX_TD_XFER_SIZE
- * bytes; callers must chunk larger transfers.
+ * Appends the TD chain of req to the requests already queued on ept.
+ * If the controller has not retired the endpoint yet it continues
+ * into the new TDs on its own, the ATDTW tripwire makes sure ENDPTSTAT
+ * is sampled consistently with the TD list. Must be called in a
+ * critical section.
+ */
+static void ept_append_req(struct udc_endpoint *ept, struct usb_request *req)
+{
+	struct usb_request *last = ept->req;
+	struct ept_queue_item *last_td;
+	unsigned stat;
+
+	/* A request that is queued twice would turn the list into a cycle */
+	ASSERT(last != req);
+	while (last->next) {
+		last = last->next;
+		ASSERT(last != req);
+	}
+	last->next = req;
+
+	last_td = req_td(last, last->tds - 1);
+	last_td->next = PA((addr_t)req->item);
+	arch_clean_invalidate_cache_range((addr_t) last_td,
+					  sizeof(struct ept_queue_item));
+
+	if (readl(USB_ENDPTPRIME) & ept->bit)
+		return;
+
+	do {
+		writel(readl(USB_USBCMD) | USBCMD_ATDTW, USB_USBCMD);
+		stat = readl(USB_ENDPTSTAT) & ept->bit;
+	} while (!(readl(USB_USBCMD) & USBCMD_ATDTW));
+	writel(readl(USB_USBCMD) & ~USBCMD_ATDTW, USB_USBCMD);
+
+	if (stat)
+		return;
+
+	/* Endpoint went idle before it saw the new TDs, prime it again */
+	ept->head->next = PA((addr_t)req->item);
+	ept->head->info = 0;
+	arch_clean_invalidate_cache_range((addr_t) ept->head,
+					  sizeof(struct ept_queue_head));
+	writel(ept->bit, USB_ENDPTPRIME);
+}
+
+/*
+ * Builds the TD chain for the transfer from the request's TD pool,
+ * growing the pool if the transfer needs more TDs. Several requests
+ * can be queued on a bulk endpoint, they complete in order.
  */
 int udc_request_queue(struct udc_endpoint *ept, struct udc_request *_req)
 {
@@ -319,7 +376,17 @@ int udc_request_queue(struct udc_endpoint *ept, struct udc_request *_req)
 	unsigned len = req->req.length;
 	unsigned tds_used, i;
 
-	ASSERT(len <= MAX_TDS_PER_REQUEST * MAX_TD_XFER_SIZE);
+	/* The request is not queued, so its TDs are not in use */
+	tds_used = len ? (len + MAX_TD_XFER_SIZE - 1) / MAX_TD_XFER_SIZE : 1;
+	if (tds_used > req->max_tds) {
+		free(req->item);
+		req->item = memalign(CACHE_LINE, tds_used * TD_STRIDE);
+		if (!req->item) {
+			req->max_tds = 0;
+			return -1;
+		}
+		req->max_tds = tds_used;
+	}
 
 	/*
 	 * Fill one TD from the request's pool per MAX_TD_XFER_SIZE of
@@ -350,7 +417,32 @@ int udc_request_queue(struct udc_endpoint *ept, struct udc_request *_req)
 	/* Terminate and set interrupt for last TD */
 	curr_item->next = TERMINATE;
 	curr_item->info |= INFO_IOC;
+	req->tds = tds_used;
+	req->next = NULL;
+
+	arch_clean_invalidate_cache_range((addr_t) VA((addr_t)req->req.buf),
+					  req->req.length);
+
+	/* Write all TD's to memory from cache */
+	for (i = 0; i < tds_used; i++)
+		arch_clean_invalidate_cache_range((addr_t) req_td(req, i),
+					  sizeof(struct ept_queue_item));
+
 	enter_critical_section();
+	DBG("ept%d %s queue req=%p\n", ept->num, ept->in ? "in" : "out", req);
+#if WITH_LK2ND_TRACE
+	LK2ND_TRACE_ASYNC_BEGIN("usb_req", req, len);
+#endif
+	/*
+	 * ep0 reuses a single request for the data & status stages and a
+	 * new SETUP restarts the transfer, so it always replaces the queue.
+	 */
+	if (ept->req && ept->num != 0) {
+		ept_append_req(ept, req);
+		exit_critical_section();
+		return 0;
+	}
+
 	ept->head->next = PA((addr_t)req->item);
 	ept->head->info = 0;
 	ept->req = req;
@@ -360,26 +452,70 @@ int udc_request_queue(struct udc_endpoint *ept, struct udc_request *_req)
 					  sizeof(struct ept_queue_head));
 	arch_clean_invalidate_cache_range((addr_t) ept->req,
 					  sizeof(struct usb_request));
-	arch_clean_invalidate_cache_range((addr_t) VA((addr_t)req->req.buf),
-					  req->req.length);
-
-	/* Write all TD's to memory from cache */
-	for (i = 0; i < tds_used; i++)
-		arch_clean_invalidate_cache_range((addr_t) req_td(req, i),
-					  sizeof(struct ept_queue_item));
 
-	DBG("ept%d %s queue req=%p\n", ept->num, ept->in ? "in" : "out", req);
 	writel(ept->bit, USB_ENDPTPRIME);
 	exit_critical_section();
 	return 0;
 }
 
+/* Stop the endpoint, the controller forgets the TDs it had primed */
+static void ept_flush(struct udc_endpoint *ept)
+{
+	writel(ept->bit, USB_ENDPTFLUSH);
+	while (readl(USB_ENDPTFLUSH) & ept->bit)
+		;
+}
+
+/*
+ * Cancels req and the requests queued after it without completing them,
+ * the requests before it must have completed. Afterwards all of them can
+ * be queued again.
+ */
+int udc_request_cancel(struct udc_endpoint *ept, struct udc_request *_req)
+{
+	struct usb_request *req = (struct usb_request *)_req;
+	struct usb_request *next;
+
+	enter_critical_section();
+	if (ept->req != req) {
+		exit_critical_section();
+		return -1;
+	}
+
+	ept_flush(ept);
+	ept->req = NULL;
+	for (; req; req = next) {
+		next = req->next;
+		req->next = NULL;
+#if WITH_LK2ND_TRACE
+		LK2ND_TRACE_ASYNC_END("usb_req", req, 0);
+#endif
+	}
+	exit_critical_section();
+	return 0;
+}
+
+static void ept_complete_req(struct usb_request *req, unsigned actual, int status)
+{
+	/* Unlinked first, the callback may queue it again */
+	req->next = NULL;
+#if WITH_LK2ND_TRACE
+	LK2ND_TRACE_ASYNC_END("usb_req", req, actual);
+#endif
+	if (req->req.complete) {
+#if WITH_LK2ND_PERF
+		LK2ND_PERF_SCOPE("usb_req_complete");
+#endif
+		req->req.complete(&req->req, actual, status);
+	}
+}
+
 static void handle_ept_complete(struct udc_endpoint *ept)
 {
 	struct ept_queue_item *item;
-	unsigned actual, total_len;
+	unsigned actual, total_len, i;
 	int status;
-	struct usb_request *req=NULL;
+	struct usb_request *req;
 
 	DBG("ept%d %s complete req=%p\n",
 	    ept->num, ept->in ? "in" : "out", ept->req);
@@ -387,32 +523,32 @@ static void handle_ept_complete(struct udc_endpoint *ept)
 	arch_invalidate_cache_range((addr_t) ept,
 					  sizeof(struct udc_endpoint));
 
-	if(ept->req)
-	{
+	/*
+	 * Requests are retired in the order they were queued, stop at the
+	 * first one the controller is still working on.
+	 */
+	while (ept->req) {
 		req = (struct usb_request *)VA((addr_t)ept->req);
-		arch_invalidate_cache_range((addr_t) ept->req,
+		arch_invalidate_cache_range((addr_t) req,
 						sizeof(struct usb_request));
-	}
 
-	if (req) {
-		item = (struct ept_queue_item *)VA((addr_t)req->item);
 		/* total transfer length for transacation */
 		total_len = req->req.length;
-		ept->req = 0;
 		actual = 0;
-		while(1) {
+		status = 0;
 
-			do {
-				/*
-				 * Must clean/invalidate cached item
-				 * data before checking the status
-				 * every time.
-				 */
-				arch_invalidate_cache_range((addr_t)(item),
-							sizeof(
-							struct ept_queue_item));
+		for (i = 0; i < req->tds; i++) {
+			item = req_td(req, i);
+			/*
+			 * Must clean/invalidate cached item
+			 * data before checking the status
+			 * every time.
+			 */
+			arch_invalidate_cache_range((addr_t)(item),
+						sizeof(struct ept_queue_item));
 
-			} while(readl(&item->info) & INFO_ACTIVE);
+			if (readl(&item->info) & INFO_ACTIVE)
+				return;
 
 			if ((item->info) & 0xff) {
 				/* error */
@@ -421,18 +557,17 @@ static void handle_ept_complete(struct udc_endpoint *ept)
 					ept->num, ept->in ? "in" : "out",
 					item->info,
 					item->page0);
-				goto out;
+				break;
 			}
 
 			/* Check if we are processing last TD */
-			if (item->next == TERMINATE) {
+			if (i == req->tds - 1) {
 				/*
 				 * Record the data transferred for the last TD
 				 */
 				actual += (total_len - (item->info >> 16))
 								& 0x7FFF;
 				total_len = 0;
-				break;
 			} else {
 				/*
 				 * Since we are not in last TD
@@ -442,14 +577,28 @@ static void handle_ept_complete(struct udc_endpoint *ept)
 				 */
 				actual += (MAX_TD_XFER_SIZE - (item->info >> 16)) & 0x7FFF;
 				total_len -= (MAX_TD_XFER_SIZE - (item->info >> 16)) & 0x7FFF;
-				/*Move to next item in chain*/
-				item = (struct ept_queue_item *)VA(item->next);
 			}
 		}
-		status = 0;
-out:
-		if (req->req.complete)
-			req->req.complete(&req->req, actual, status);
+
+		if (status < 0) {
+			/*
+			 * The endpoint halted, the requests queued after this
+			 * one will never complete. Fail all of them.
+			 */
+			ept_flush(ept);
+			ept->req = NULL;
+			while (req) {
+				struct usb_request *next = req->next;
+
+				ept_complete_req(req, actual, status);
+				actual = 0;
+				req = next;
+			}
+			return;
+		}
+
+		ept->req = req->next;
+		ept_complete_req(req, actual, status);
 	}
 }
 
@@ -654,9 +803,9 @@ static void handle_setup(struct udc_endpoint *ept)
 			break;
 		}
 	case SETUP(INTERFACE_READ, MASS_STORAGE_GET_MAX_LUN):
-		/* USB MSC class request: return number of LUNs (0 => only LUN0) */
+		/* USB MSC class request: return highest LUN (0 => only LUN0) */
 		if (s.length == 1) {
-			unsigned char lun = 0; /* single LUN */
+			unsigned char lun = the_gadget->max_lun;
 			setup_tx(&lun, 1);
 			return; /* 3-stage handled */
 		}
@@ -821,7 +970,10 @@ enum handler_return udc_interrupt(void *arg)
 			 * this to be an error state
 			 */
 			if (ept->req) {
-				ept->req->item->info = INFO_HALTED;
+				struct usb_request *req;
+
+				for (req = ept->req; req; req = req->next)
+					req->item->info = INFO_HALTED;
 				handle_ept_complete(ept);
 			}
 		}
@@ -894,6 +1046,8 @@ static void udc_ept_desc_fill(struct udc_endpoint *ept, unsigned char *data)
 
 static unsigned udc_ifc_desc_size(struct udc_gadget *g)
 {
+	if (g->pipe_usage)
+		return 9 + g->ifc_endpoints * (7 + 4);
 	return 9 + g->ifc_endpoints * 7;
 }
 
@@ -915,6 +1069,14 @@ static void udc_ifc_desc_fill(struct udc_gadget *g, unsigned char *data)
 	for (n = 0; n < g->ifc_endpoints; n++) {
 		udc_ept_desc_fill(g->ept[n], data);
 		data += 7;
+
+		if (g->pipe_usage) {
+			data[0] = 4;
+			data[1] = TYPE_PIPE_USAGE;
+			data[2] = g->pipe_usage[n];
+			data[3] = 0x00;
+			data += 4;
+		}
 	}
 }
 
@@ -36,6 +36,11 @@
 
 #include <LEOEMCertificate.h>
 
+#if IMAGE_VERIFY_KEY
+#include <rsa_key.h>
+#include <image_verify_key.h>
+#endif
+
 const char hash_identifier[] = {
 	0x30, 0x31, 0x30, 0x0D, 0x06, 0x09, 0x60, 0x86, 0x48, 0x01, 0x65, 0x03,
 	0x04, 0x02, 0x01, 0x05, 0x00, 0x04, 0x20
@@ -76,6 +81,13 @@ image_decrypt_signature(unsigned char *signature_ptr, unsigned char *plain_text)
 	const unsigned char *cert_ptr = NULL;
 	unsigned int cert_size = 0;
 
+#if IMAGE_VERIFY_KEY
+	/* Key from IMAGE_VERIFY_CERT, no need to parse certBuffer */
+	if (!is_vb_le_enabled())
+		return rsa_key_public_decrypt(&image_verify_key, signature_ptr,
+					      SIGNATURE_SIZE, plain_text);
+#endif
+
 	if (is_vb_le_enabled()) {
 		cert_ptr = (const unsigned char *)LE_OEM_CERTIFICATE;
 		cert_size = sizeof(LE_OEM_CERTIFICATE);
@@ -152,11 +164,30 @@ image_verify(unsigned char *image_ptr,
 	     unsigned char *signature_ptr,
 	     unsigned int image_size, unsigned hash_type)
 {
+	unsigned int digest[8];
+
+	/*
+	 * Calculate hash of image and save calculated hash on TZ.
+	 */
+	image_find_digest(image_ptr, image_size, hash_type,
+			(unsigned char *)&digest);
+
+	return image_verify_digest((unsigned char *)&digest, signature_ptr,
+				   hash_type);
+}
+
+/*
+ * Same as image_verify() with the digest of the image calculated already,
+ * e.g. while the image was read.
+ */
+int
+image_verify_digest(unsigned char *digest,
+		    unsigned char *signature_ptr, unsigned hash_type)
+{
 
 	int ret = -1;
 	int auth = 0;
 	unsigned char *plain_text = NULL;
-	unsigned int digest[8];
 	int hash_size;
 
 	plain_text = (unsigned char *)calloc(sizeof(char), SIGNATURE_SIZE);
@@ -165,15 +196,10 @@ image_verify(unsigned char *image_ptr,
 		goto cleanup;
 	}
 
-	/*
-	 * Calculate hash of image and save calculated hash on TZ.
-	 */
 	hash_size =
 	    (hash_type == CRYPTO_AUTH_ALG_SHA256) ? SHA256_SIZE : SHA1_SIZE;
-	image_find_digest(image_ptr, image_size, hash_type,
-			(unsigned char *)&digest);
 #ifdef TZ_SAVE_KERNEL_HASH
-	save_kernel_hash((unsigned char *) &digest, hash_type);
+	save_kernel_hash(digest, hash_type);
 #endif
 
 	/*
@@ -48,6 +48,8 @@ enum clk_reset_action {
 struct clk;
 struct clk_ops {
 	int (*enable)(struct clk *clk);
+	/* Like enable() but without waiting, done once is_enabled() is true */
+	int (*enable_nowait)(struct clk *clk);
 	void (*disable)(struct clk *clk);
 	void (*auto_off)(struct clk *clk);
 	int (*reset)(struct clk *clk, enum clk_reset_action action);
@@ -105,6 +107,19 @@ struct clk *clk_get(const char *id);
  */
 int clk_enable(struct clk *clk);
 
+/**
+ * clk_enable_all - enable several clocks at once
+ * @clks: clocks to enable
+ * @num: number of clocks, at most 32
+ *
+ * Clocks that can be enabled without waiting (enable_nowait, e.g. PLLs that
+ * need to lock) are all started first and then waited for together, so the
+ * wait only takes as long as the slowest of them.
+ *
+ * Returns success (0) or negative errno.
+ */
+int clk_enable_all(struct clk **clks, unsigned num);
+
 /**
  * clk_disable - inform the system when the clock source is no longer required.
  * @clk: clock source
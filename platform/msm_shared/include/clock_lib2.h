@@ -101,6 +101,7 @@
 /* Root Clock Bits */
 #define CMD_UPDATE_BIT          BIT(0)
 #define CMD_UPDATE_MASK         1
+#define CMD_DIRTY_MASK          BM(7, 4)
 
 #define CFG_SRC_DIV_OFFSET      0
 #define CFG_SRC_DIV_MASK        (0x1F << CFG_SRC_DIV_OFFSET)
@@ -171,12 +171,21 @@ void crypto5_set_ctx(struct crypto_dev *dev,
 uint32_t crypto5_send_data(struct crypto_dev *dev,
 						   void *ctx_ptr,
 						   uint8_t *data_ptr);
+uint32_t crypto5_send_data_start(struct crypto_dev *dev,
+								 void *ctx_ptr,
+								 uint8_t *data_ptr);
+uint32_t crypto5_send_data_sg_start(struct crypto_dev *dev,
+									void *ctx_ptr,
+									const struct crypto_sg *sg,
+									uint32_t count);
+uint32_t crypto5_send_data_wait(struct crypto_dev *dev);
 void crypto5_cleanup(struct crypto_dev *dev);
 uint32_t crypto5_get_digest(struct crypto_dev *dev,
 							uint8_t *digest_ptr,
 							crypto_auth_alg_type auth_alg);
 void crypto5_get_ctx(struct crypto_dev *dev, void *ctx_ptr);
 uint32_t crypto5_get_max_auth_blk_size(struct crypto_dev *dev);
+uint32_t crypto5_get_max_sg_desc(struct crypto_dev *dev);
 void crypto5_unlock_pipes(struct crypto_dev *dev);
 
 #endif
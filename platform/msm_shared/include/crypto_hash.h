@@ -84,6 +84,21 @@ typedef struct {
 	unsigned int auth_iv[8];
 } crypto_SHA256_ctx;
 
+/* One of the buffers that are hashed together by hash_find_sg() */
+struct crypto_sg {
+	unsigned char *addr;
+	unsigned int len;
+};
+
+typedef struct {
+	crypto_auth_alg_type auth_alg;
+	bool first;
+	union {
+		crypto_SHA1_ctx sha1;
+		crypto_SHA256_ctx sha256;
+	} sha;
+} crypto_hash_ctx;
+
 extern void crypto_eng_reset(void);
 
 extern void crypto_eng_init(void);
@@ -98,6 +113,18 @@ extern void crypto_send_data(void *ctx_ptr,
 			     unsigned int bytes_to_write,
 			     unsigned int *ret_status);
 
+extern void crypto_send_data_start(void *ctx_ptr,
+				   unsigned char *data_ptr,
+				   unsigned int bytes_to_write,
+				   unsigned int *ret_status);
+
+extern void crypto_send_data_sg_start(void *ctx_ptr,
+				      const struct crypto_sg *sg,
+				      unsigned int count,
+				      unsigned int *ret_status);
+
+extern void crypto_send_data_wait(unsigned int *ret_status);
+
 extern void crypto_get_digest(unsigned char *digest_ptr,
 			      unsigned int *ret_status,
 			      crypto_auth_alg_type auth_alg, bool last);
@@ -106,6 +133,8 @@ extern void crypto_get_ctx(void *ctx_ptr);
 
 extern uint32_t crypto_get_max_auth_blk_size(void);
 
+extern uint32_t crypto_get_max_sg_desc(void);
+
 static void crypto_init(void);
 
 static crypto_result_type do_sha(unsigned char *buff_ptr,
@@ -135,5 +164,47 @@ crypto_result_type
 hash_find(unsigned char *addr, unsigned int size, unsigned char *digest,
           unsigned char auth_alg);
 
+crypto_result_type
+hash_find_engine(unsigned char *addr, unsigned int size, unsigned char *digest,
+		 unsigned char auth_alg);
+
+#if WITH_SHA_ARMV8
+bool sha_armv8_supported(void);
+crypto_result_type
+hash_find_armv8(unsigned char *addr, unsigned int size, unsigned char *digest,
+		unsigned char auth_alg);
+crypto_result_type
+hash_find_sg_armv8(const struct crypto_sg *sg, unsigned int count,
+		   unsigned char *digest, crypto_auth_alg_type auth_alg);
+
+/* sha-armv8.S: hash complete 64 byte blocks, state in host byte order */
+void sha1_armv8_blocks(uint32_t *state, const void *data, size_t blocks);
+void sha256_armv8_blocks(uint32_t *state, const void *data, size_t blocks);
+#endif
+
+crypto_result_type hash_init(crypto_hash_ctx *ctx, crypto_auth_alg_type auth_alg);
+crypto_result_type hash_update(crypto_hash_ctx *ctx, unsigned char *addr,
+			       unsigned int size);
+crypto_result_type hash_final(crypto_hash_ctx *ctx, unsigned char *addr,
+			      unsigned int size, unsigned char *digest);
+
+/* Read the next size bytes of the data to hash into buf, 0 on success */
+typedef int (*hash_read_func)(void *cookie, unsigned char *buf,
+			      unsigned int size);
+
+crypto_result_type hash_find_read(hash_read_func read, void *cookie,
+				  uint64_t size, unsigned char *buf,
+				  unsigned int chunk_size, unsigned char *digest,
+				  crypto_auth_alg_type auth_alg);
+crypto_result_type hash_find_read_to(hash_read_func read, void *cookie,
+				     unsigned char *dest, unsigned int size,
+				     unsigned int chunk_size,
+				     unsigned char *digest,
+				     crypto_auth_alg_type auth_alg);
+
+crypto_result_type hash_find_sg(const struct crypto_sg *sg, unsigned int count,
+				unsigned char *digest,
+				crypto_auth_alg_type auth_alg);
+
 crypto_engine_type board_ce_type(void);
 #endif
@@ -223,11 +223,6 @@ enum dt_err_codes
 	DT_OP_FAILURE = -1,
 };
 
-typedef struct dt_entry_node {
-	struct list_node node;
-	struct dt_entry * dt_entry_m;
-}dt_node;
-
 struct dtbo_table_hdr {
 	uint32_t magic;           //dtb table magic
 	uint32_t total_size;       //Includes dt_table_hdr + all dt_table_entry and all dtb/dtbo
@@ -40,6 +40,8 @@ static int image_decrypt_signature(unsigned char *signature_ptr,
 int image_verify(unsigned char *image_ptr,
 		 unsigned char *signature_ptr,
 		 unsigned int image_size, unsigned hash_type);
+int image_verify_digest(unsigned char *digest,
+			unsigned char *signature_ptr, unsigned hash_type);
 
 /* Decrypt signature with RSA public key */
 int image_decrypt_signature_rsa(unsigned char *signature_ptr,
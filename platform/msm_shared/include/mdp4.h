@@ -147,5 +147,6 @@ int mdss_hdmi_config(struct msm_panel_info *pinfo, struct fbcon_config *fb);
 int mdss_spi_init(void);
 int mdss_spi_panel_init(struct msm_panel_info *pinfo);
 int mdss_spi_on(struct msm_panel_info *pinfo, struct fbcon_config *fb);
+int mdss_spi_update_rows(struct fbcon_config *fb, unsigned y, unsigned h);
 int mdss_spi_cmd_post_on(struct msm_panel_info *pinfo);
 #endif
@@ -79,6 +79,9 @@
 #define DTYPE_GEN_LWRITE 0x29	/* 4th Byte is 0xc0 */
 #define DTYPE_DCS_WRITE1 0x15	/* 4th Byte is 0x80 */
 
+/* 4th byte of the command header: last packet of a DMA transfer */
+#define DSI_HDR_LAST	0x80
+
 #ifndef RDBK_DATA0
 #define RDBK_DATA0 0x06C
 #endif
@@ -631,6 +631,8 @@ unsigned mmc_get_psn(void);
 
 unsigned int mmc_erase_card(unsigned long long data_addr,
 			    unsigned long long data_len);
+uint32_t mmc_get_zero_erase_size(void);
+uint32_t mmc_zero_erase(uint64_t addr, uint64_t len);
 
 void mmc_mclk_reg_wr_delay(void);
 void mmc_boot_mci_clk_enable(void);
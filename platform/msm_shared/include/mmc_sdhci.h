@@ -43,12 +43,14 @@
 #define CMD8_SEND_EXT_CSD                         8
 #define CMD9_SEND_CSD                             9
 #define CMD10_SEND_CID                            10
+#define CMD11_VOLTAGE_SWITCH                      11
 #define CMD12_STOP_TRANSMISSION                   12
 #define CMD13_SEND_STATUS                         13
 #define CMD15_GO_INACTIVE_STATUS                  15
 #define CMD16_SET_BLOCKLEN                        16
 #define CMD17_READ_SINGLE_BLOCK                   17
 #define CMD18_READ_MULTIPLE_BLOCK                 18
+#define CMD19_SEND_TUNING_BLOCK                   19
 #define CMD21_SEND_TUNING_BLOCK                   21
 #define CMD23_SET_BLOCK_COUNT                     23
 #define CMD24_WRITE_SINGLE_BLOCK                  24
@@ -61,6 +63,7 @@
 #define CMD35_ERASE_GROUP_START                   35
 #define CMD36_ERASE_GROUP_END                     36
 #define CMD38_ERASE                               38
+#define CMD48_CMDQ_TASK_MGMT                      48
 
 /* Card type */
 #define MMC_TYPE_STD_SD                           0
@@ -99,11 +102,20 @@
 #define MMC_SEC_COUNT1                            212
 #define MMC_PART_CONFIG                           179
 #define MMC_ERASE_GRP_DEF                         175
+#define MMC_ERASED_MEM_CONT                       181
 #define MMC_USR_WP                                171
 #define MMC_ERASE_TIMEOUT_MULT                    223
 #define MMC_HC_ERASE_GRP_SIZE                     224
+#define MMC_SEC_FEATURE_SUPPORT                   231
+#define MMC_TRIM_MULT                             232
 #define MMC_PARTITION_CONFIG                      179
 #define MMC_EXT_CSD_EN_RPMB_REL_WR                166 //emmc 5.1 and above
+#define MMC_EXT_CSD_CMDQ_MODE_EN                  15  //emmc 5.1 and above
+#define MMC_EXT_CSD_FLUSH_CACHE                   32  //emmc 4.5 and above
+#define MMC_EXT_CSD_CACHE_CTRL                    33  //emmc 4.5 and above
+#define MMC_EXT_CSD_CACHE_SIZE                    249 //emmc 4.5 and above, 4 bytes
+#define MMC_EXT_CSD_CMDQ_DEPTH                    307 //emmc 5.1 and above
+#define MMC_EXT_CSD_CMDQ_SUPPORT                  308 //emmc 5.1 and above
 
 /* Values for ext csd fields */
 #define MMC_HS_TIMING                             0x1
@@ -119,6 +131,19 @@
 #define MMC_SEC_COUNT2_SHIFT                      8
 #define MMC_HC_ERASE_MULT                         (512 * 1024)
 #define RST_N_FUNC_ENABLE                         BIT(0)
+#define MMC_SEC_GB_CL_EN                          BIT(4)
+#define MMC_EXT_CSD_REV_4_5                       6
+#define MMC_EXT_CSD_REV_5_1                       8
+#define MMC_CACHE_EN                              BIT(0)
+#define MMC_FLUSH_CACHE                           BIT(0)
+#define MMC_CMDQ_SUPPORTED                        BIT(0)
+#define MMC_CMDQ_DEPTH_MASK                       0x1F
+#define MMC_CMDQ_DISCARD_QUEUE                    0x1
+
+/* CMD38 arguments */
+#define MMC_ERASE_ARG                             0x00000000
+#define MMC_TRIM_ARG                              0x00000001
+#define MMC_DISCARD_ARG                           0x00000003
 
 /* RPMB Related */
 #define RPMB_PART_MIN_SIZE                        (128 * 1024)
@@ -176,10 +201,27 @@
 #define MMC_SD_OCR                                0x00FF8000
 #define MMC_SD_HC_HCS                             0x40000000
 #define MMC_SD_DEV_READY                          0x80000000
+#define MMC_SD_S18R                               BIT(24)
 #define MMC_CARD_TYPE_SDHC                        0x1
 #define MMC_CARD_TYPE_STD_SD                      0x0
 #define SD_CARD_RCA                               0x0
 #define MMC_SD_SWITCH_HS                          0x80FFFFF1
+#define MMC_SD_SWITCH_CHECK                       0x00FFFFF0
+#define MMC_SD_SWITCH_SET                         0x80FFFFF0
+
+/* SD 3.0 bus speed modes (CMD6 function group 1) */
+#define SD_ACCESS_MODE_SDR25                      1
+#define SD_ACCESS_MODE_SDR50                      2
+#define SD_ACCESS_MODE_SDR104                     3
+#define SD_ACCESS_MODE_DDR50                      4
+/* Byte offsets in the 64 byte CMD6 switch status */
+#define SD_SWITCH_GRP1_SUPPORT                    13
+#define SD_SWITCH_GRP1_SELECT                     16
+#define SD_SWITCH_GRP1_SELECT_MASK                0xF
+
+/* Signal voltages requested from target_sdc_set_io_voltage() */
+#define SD_IO_VOLTAGE_3_0                         2950000
+#define SD_IO_VOLTAGE_1_8                         1800000
 
 #define SD_CMD8_MAX_RETRY                         0x3
 #define SD_ACMD41_MAX_RETRY                       0x14
@@ -315,6 +357,9 @@ struct mmc_card {
 	struct mmc_csd csd;      /* CSD structure */
 	struct mmc_sd_scr scr;   /* SCR structure */
 	struct mmc_sd_ssr ssr;   /* SSR Register */
+	uint8_t sd_uhs;          /* SD card switched to 1.8V signalling */
+	uint8_t cache_en;        /* Volatile write cache enabled */
+	uint8_t cache_dirty;     /* Writes since the last cache flush */
 };
 
 /* mmc device config data */
@@ -328,6 +373,7 @@ struct mmc_config_data {
 	uint8_t hs200_support; /* SDHC HS200 mode supported or not */
 	uint8_t hs400_support; /* SDHC HS400 mode supported or not */
 	uint8_t use_io_switch; /* IO pad switch flag for shared sdc controller */
+	uint32_t cqe_base;     /* Base address for the command queue engine, 0 if none */
 };
 
 /* mmc device structure */
@@ -344,14 +390,31 @@ struct mmc_device {
 struct mmc_device *mmc_init(struct mmc_config_data *);
 /* API: Read required number of blocks from card into destination */
 uint32_t mmc_sdhci_read(struct mmc_device *dev, void *dest, uint64_t blk_addr, uint32_t num_blocks);
+/* API: Read consecutive blocks from card into a list of destinations */
+uint32_t mmc_sdhci_read_sg(struct mmc_device *dev, struct sdhci_sg *sg, uint32_t sg_count,
+						   uint64_t blk_addr, uint32_t num_blocks);
+/* API: Number of tasks the card & host can queue, 0 without command queueing */
+uint32_t mmc_sdhci_queue_depth(struct mmc_device *dev);
+/* API: Read several block ranges, queued on the card when it supports it */
+uint32_t mmc_sdhci_read_queued(struct mmc_device *dev, struct sdhci_cqe_task *tasks, uint32_t count);
+/* API: Run the HS200 tuning sequence again */
+uint32_t mmc_sdhci_retune(struct mmc_device *dev);
+/* API: Max number of bytes a single read or write can transfer */
+uint32_t mmc_sdhci_max_trans_size(struct mmc_device *dev);
 /* API: Write requried number of blocks from source to card */
 uint32_t mmc_sdhci_write(struct mmc_device *dev, void *src, uint64_t blk_addr, uint32_t num_blocks);
 /* API: Erase len bytes (after converting to number of erase groups), from specified address */
 uint32_t mmc_sdhci_erase(struct mmc_device *dev, uint32_t blk_addr, uint64_t len);
+/* API: TRIM or DISCARD num_blks write blocks from specified address, no erase group alignment needed */
+uint32_t mmc_sdhci_trim(struct mmc_device *dev, uint32_t blk_addr, uint32_t num_blks, uint32_t arg);
 /* API: Write protect or release len bytes (after converting to number of write protect groups) from specified start address*/
 uint32_t mmc_set_clr_power_on_wp_user(struct mmc_device *dev, uint32_t addr, uint64_t len, uint8_t set_clr);
 /* API: Get the WP status of write protect groups starting at addr */
 uint32_t mmc_get_wp_status(struct mmc_device *dev, uint32_t addr, uint8_t *wp_status);
+/* API: Turn the volatile write cache of the card on or off */
+uint32_t mmc_sdhci_set_cache(struct mmc_device *dev, bool enable);
+/* API: Write the data in the volatile cache of the card to the flash */
+uint32_t mmc_sdhci_flush_cache(struct mmc_device *dev);
 /* API: Put the mmc card in sleep mode */
 void mmc_put_card_to_sleep(struct mmc_device *dev);
 /* API: Change the driver type of the card */
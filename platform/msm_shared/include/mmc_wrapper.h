@@ -39,15 +39,20 @@ uint32_t mmc_get_psn(void);
 
 uint32_t mmc_read(uint64_t data_addr, uint32_t *out, uint32_t data_len);
 uint32_t mmc_write(uint64_t data_addr, uint32_t data_len, void *in);
+uint32_t mmc_enable_write_cache(void);
+uint32_t mmc_flush_write_cache(void);
 uint32_t mmc_erase_card(uint64_t, uint64_t);
 uint64_t mmc_get_device_capacity(void);
 uint32_t mmc_erase_card(uint64_t addr, uint64_t len);
+uint32_t mmc_get_zero_erase_size(void);
+uint32_t mmc_zero_erase(uint64_t addr, uint64_t len);
 uint32_t mmc_get_device_blocksize(void);
 uint32_t mmc_page_size(void);
 void mmc_device_sleep(void);
 void mmc_set_lun(uint8_t lun);
 uint8_t mmc_get_lun(void);
 void  mmc_read_partition_table(uint8_t arg);
+bool mmc_read_next_partition_table(void);
 uint32_t mmc_write_protect(const char *name, int set_clr);
 int ufs_set_boot_lun(uint32_t boot_lun_id);
 int ufs_get_boot_lun(void);
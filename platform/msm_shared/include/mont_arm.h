@@ -0,0 +1,11 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#ifndef __MONT_ARM_H
+#define __MONT_ARM_H
+
+#include <stdint.h>
+
+/* mont-arm.S: c[] = (c[] + a * b[]) / 2^32 mod n[], returns the carry */
+uint32_t mont_mul_add_arm(uint32_t *c, uint32_t a, const uint32_t *b,
+			  const uint32_t *n, uint32_t n0inv, uint32_t len);
+
+#endif
@@ -28,6 +28,7 @@
 
 #include <sys/types.h>
 #include <platform/timer.h>
+#include <platform/interrupts.h>
 
 
 #define QTMR_TIMER_CTRL_ENABLE          (1 << 0)
@@ -37,6 +38,7 @@
 
 void qtimer_set_physical_timer(time_t msecs_interval,
 	platform_timer_callback tmr_callback, void *tmr_arg);
+void qtimer_set_physical_deadline(uint64_t cval, int_handler handler, void *arg);
 void qtimer_disable(void);
 uint64_t qtimer_get_phy_timer_cnt(void);
 uint32_t qtimer_current_time(void);
@@ -95,8 +95,27 @@ typedef struct
 
 typedef rpm_cmd rpm_ack_msg;
 int rpm_send_data(uint32_t *data, uint32_t len, msg_type type);
+int rpm_send_data_noack(uint32_t *data, uint32_t len, msg_type type);
+int rpm_wait_acks(void);
 void rpm_clk_enable(uint32_t *data, uint32_t len);
 
+#define RPM_BUS_CLK_TYPE	0x316b6c63 //clk1
+#define RPM_MEM_CLK_TYPE	0x326b6c63 //clk2
+
+/* Bus or memory clock vote for large transfers, see rpm_bw_request() */
+struct rpm_bw_vote
+{
+	uint32_t type;
+	uint32_t id;
+	uint32_t rate;	/* KHz */
+};
+
+/* Platforms that opt in to the bandwidth votes provide their table */
+const struct rpm_bw_vote *platform_rpm_bw_votes(unsigned *count);
+
+void rpm_bw_request(void);
+void rpm_bw_release(void);
+
 void fill_kvp_object(kvp_data **kdata, uint32_t *data, uint32_t len);
 void free_kvp_object(kvp_data **kdata);
 #endif
@@ -36,6 +36,8 @@
 #include <rpm-ipc.h>
 
 int rpm_smd_send_data(uint32_t *data, uint32_t len, msg_type type);
+int rpm_smd_send_data_noack(uint32_t *data, uint32_t len, msg_type type);
+int rpm_smd_wait_acks(void);
 uint32_t rpm_smd_recv_data(uint32_t *len);
 void rpm_smd_init(void);
 void rpm_smd_uninit(void);
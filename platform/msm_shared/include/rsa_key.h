@@ -0,0 +1,28 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#ifndef __RSA_KEY_H
+#define __RSA_KEY_H
+
+#include <stdint.h>
+
+/*
+ * RSA public key with the constants for Montgomery multiplication, usually
+ * generated from a certificate by lk2nd/scripts/rsakey2c.py at build time.
+ */
+struct rsa_key {
+	uint32_t len;		/* number of 32-bit words of the modulus */
+	uint32_t n0inv;		/* -1 / n[0] mod 2^32 */
+	uint32_t e;		/* public exponent */
+	const uint32_t *n;	/* modulus, little endian words */
+	const uint32_t *rr;	/* R^2 mod n with R = 2^(32 * len) */
+};
+
+#define RSA_KEY_MAX_BITS	4096
+
+/*
+ * Same as RSA_public_decrypt() with RSA_PKCS1_PADDING: returns the length of
+ * the data in the signature, written to out, or -1 if it is invalid.
+ */
+int rsa_key_public_decrypt(const struct rsa_key *key, const unsigned char *sig,
+			   unsigned int sig_len, unsigned char *out);
+
+#endif
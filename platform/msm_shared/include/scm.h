@@ -416,6 +416,8 @@ int scm_call_atomic2(uint32_t svc, uint32_t cmd, uint32_t arg1, uint32_t arg2);
 int restore_secure_cfg(uint32_t id);
 
 void scm_elexec_call(paddr_t kernel_entry, paddr_t dtb_offset);
+/* Maximum number of random bytes returned by a single TZ call */
+#define SCM_RANDOM_MAX_LEN 64
 int scm_random(uintptr_t * rbuf, uint32_t  r_len);
 uintptr_t get_canary(void);
 /* API to configure XPU violations as fatal */
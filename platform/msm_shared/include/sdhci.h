@@ -51,6 +51,7 @@ struct host_caps {
 	uint32_t max_blk_len;    /* Max block len supported */
 	uint8_t bus_width_8bit;  /* 8 Bit mode supported */
 	uint8_t adma_support;    /* Adma support */
+	uint8_t adma_64bit;      /* 64 bit Adma2 descriptors (version 4 mode) */
 	uint8_t voltage;         /* Supported voltage */
 	uint8_t sdr_support;     /* Single Data rate */
 	uint8_t ddr_support;     /* Dual Data rate */
@@ -60,6 +61,9 @@ struct host_caps {
 	uint8_t hs400_support;   /* Hs400 mode, with 400 MHZ clock */
 };
 
+/* Tasks the command queue engine runs at once, the card may take less */
+#define SDHCI_CQE_MAX_TASKS                       8
+
 /*
  * sdhci host structure, holding information about host
  * controller parameters
@@ -72,9 +76,36 @@ struct sdhci_host {
 	uint8_t major;           /* host controller minor ver */
 	uint16_t minor;          /* host controller major ver */
 	bool use_cdclp533;       /* Use cdclp533 calibration circuit */
+	uint8_t spec_version;    /* SD host controller spec version */
+	bool v4_mode;            /* Version 4 mode, 32 bit block count */
 	event_t* sdhc_event;     /* Event for power control irqs */
+	uint32_t irq;            /* Host controller irq, 0 to poll */
+	event_t irq_event;       /* Signalled by the host controller irq */
 	struct host_caps caps;   /* Host capabilities */
 	struct sdhci_msm_data *msm_host; /* MSM specific host info */
+	uint32_t cqe_base;       /* Command queue engine registers, 0 if none */
+	void *cqe_tdl;           /* Task descriptor list of the command queue */
+	void *cqe_tables[SDHCI_CQE_MAX_TASKS]; /* Adma tables of queued tasks */
+	uint16_t cqe_int_sts_en; /* Normal int status enable saved by the cqe */
+};
+
+/*
+ * Scatter/gather segment, one transfer can fill several buffers
+ */
+struct sdhci_sg {
+	void *data;
+	uint32_t len;
+};
+
+/*
+ * One read or write queued on the command queue engine
+ */
+struct sdhci_cqe_task {
+	struct sdhci_sg *sg;     /* Segments of the transfer */
+	uint32_t sg_count;       /* Number of segments */
+	uint32_t blk_addr;       /* Block address on the card */
+	uint32_t num_blocks;     /* Number of blocks, up to SDHCI_CQE_MAX_BLOCKS */
+	uint8_t read;            /* Read from the card, else write */
 };
 
 /*
@@ -84,6 +115,8 @@ struct mmc_data {
 	void *data_ptr;      /* Points to stream of data */
 	uint32_t blk_sz;     /* Block size for the data */
 	uint32_t num_blocks; /* num of blocks, each always of size SDHCI_MMC_BLK_SZ */
+	struct sdhci_sg *sg; /* Optional segments used instead of data_ptr */
+	uint32_t sg_count;   /* Number of segments in sg */
 };
 
 /*
@@ -114,6 +147,17 @@ struct desc_entry {
 	uint32_t addr;       /* Address of the data */
 };
 
+/*
+ * 128 bit descriptor used with 64 bit addressing in version 4 mode
+ */
+struct desc_entry_64 {
+	uint16_t tran_att;   /* Attribute for transfer data */
+	uint16_t len;        /* Length of data */
+	uint32_t addr_lo;    /* Address of the data, bits 31:0 */
+	uint32_t addr_hi;    /* Address of the data, bits 63:32 */
+	uint32_t reserved;
+};
+
 /*
  * Command types for sdhci
  */
@@ -148,10 +192,14 @@ typedef enum {
 #define REG_READ16(host, a)                      readhw(host->base + a)
 #define REG_WRITE16(host, v, a)                  writehw(v, (host->base + a))
 
+#define CQE_READ32(host, a)                       readl(host->cqe_base + a)
+#define CQE_WRITE32(host, v, a)                   writel(v, (host->cqe_base + a))
+
 /*
  * SDHCI registers, as per the host controller spec v 3.0
  */
 #define SDHCI_ARG2_REG                            (0x000)
+#define SDHCI_BLK_CNT_32_REG                      (0x000) /* version 4 mode */
 #define SDHCI_BLKSZ_REG                           (0x004)
 #define SDHCI_BLK_CNT_REG                         (0x006)
 #define SDHCI_ARGUMENT_REG                        (0x008)
@@ -176,6 +224,8 @@ typedef enum {
 #define SDHCI_CAPS_REG2                           (0x044)
 #define SDHCI_ADM_ERR_REG                         (0x054)
 #define SDHCI_ADM_ADDR_REG                        (0x058)
+#define SDHCI_ADM_ADDR_HI_REG                     (0x05C)
+#define SDHCI_HOST_VERSION_REG                    (0x0FE)
 
 /*
  * Helper macros for register writes
@@ -193,6 +243,8 @@ typedef enum {
 #define SDHCI_ERR_INT_STS_EN                      0xFFFF
 #define SDHCI_NRML_INT_SIG_EN                     0x000B
 #define SDHCI_ERR_INT_SIG_EN                      0xFFFF
+#define SDHCI_PWR_IRQ_TIMEOUT                     100 /* ms */
+#define SDHCI_IRQ_TIMEOUT_MIN                     10 /* ms */
 
 #define SDCC_HC_INT_CARD_REMOVE                   BIT(7)
 #define SDCC_HC_INT_CARD_INSERT                   BIT(6)
@@ -221,6 +273,7 @@ typedef enum {
 
 #define SDHCI_CMD_ACT                             BIT(0)
 #define SDHCI_DAT_ACT                             BIT(1)
+#define SDHCI_DAT_LVL_MASK                        (0xF << 20)
 
 /*
  * Bus voltage related macros
@@ -255,6 +308,7 @@ typedef enum {
 #define SDHCI_ERR_INT_STAT_MASK                   0x8000
 #define SDHCI_ADMA_DESC_LINE_SZ                   65536
 #define SDHCI_ADMA_MAX_TRANS_SZ                   (65535 * 512)
+#define SDHCI_V4_MAX_TRANS_SZ                     (131072 * 512)
 #define SDHCI_ADMA_TRANS_VALID                    BIT(0)
 #define SDHCI_ADMA_TRANS_END                      BIT(1)
 #define SDHCI_ADMA_TRANS_DATA                     BIT(5)
@@ -269,6 +323,15 @@ typedef enum {
 #define SDHCI_AUTO_CMD12_EN                       BIT(2)
 #define SDHCI_ADMA_32BIT                          BIT(4)
 
+/*
+ * Version 4 mode related macros
+ */
+#define SDHCI_SPEC_VER_MASK                       0x00FF
+#define SDHCI_SPEC_410                            4
+#define SDHCI_CAP_64BIT_V4                        BIT(27)
+#define SDHCI_HOST_VER4_EN                        BIT(12)
+#define SDHCI_ADDR_64BIT_EN                       BIT(13)
+
 /*
  * Command related macros
  */
@@ -356,6 +419,46 @@ typedef enum {
 #define SDHCI_SDR25_MODE                          0x1
 #define SDHCI_SDR12_MODE                          0x0
 
+/*
+ * Command queue engine registers, as per the eMMC 5.1 CQHCI spec.
+ * The offsets are relative to sdhci_host.cqe_base.
+ */
+#define SDHCI_CQE_CAP_REG                         (0x004)
+#define SDHCI_CQE_CFG_REG                         (0x008)
+#define SDHCI_CQE_CTL_REG                         (0x00C)
+#define SDHCI_CQE_IS_REG                          (0x010)
+#define SDHCI_CQE_ISTE_REG                        (0x014)
+#define SDHCI_CQE_ISGE_REG                        (0x018)
+#define SDHCI_CQE_TDLBA_REG                       (0x020)
+#define SDHCI_CQE_TDLBAU_REG                      (0x024)
+#define SDHCI_CQE_TDBR_REG                        (0x028)
+#define SDHCI_CQE_TCN_REG                         (0x02C)
+#define SDHCI_CQE_TCLR_REG                        (0x038)
+#define SDHCI_CQE_SSC2_REG                        (0x044)
+#define SDHCI_CQE_TERRI_REG                       (0x054)
+
+#define SDHCI_CQE_CFG_ENABLE                      BIT(0)
+#define SDHCI_CQE_CFG_TASK_DESC_128               BIT(8)
+#define SDHCI_CQE_CTL_HALT                        BIT(0)
+#define SDHCI_CQE_IS_TCC                          BIT(1)
+#define SDHCI_CQE_IS_RED                          BIT(2)
+#define SDHCI_CQE_IS_TERR                         BIT(4)
+#define SDHCI_CQE_IS_ERR                          (SDHCI_CQE_IS_RED | SDHCI_CQE_IS_TERR)
+
+/* Task descriptor fields */
+#define SDHCI_CQE_TASK_VALID                      BIT(0)
+#define SDHCI_CQE_TASK_END                        BIT(1)
+#define SDHCI_CQE_TASK_INT                        BIT(2)
+#define SDHCI_CQE_TASK_ACT_TASK                   (0x5 << 3)
+#define SDHCI_CQE_TASK_ACT_LINK                   (0x6 << 3)
+#define SDHCI_CQE_TASK_DATA_READ                  BIT(12)
+#define SDHCI_CQE_TASK_BLK_CNT_SHIFT              16
+
+#define SDHCI_CQE_MAX_SLOTS                       32
+#define SDHCI_CQE_MAX_BLOCKS                      0xFFFF
+#define SDHCI_CQE_INT_STS                         BIT(14)
+#define SDHCI_CQE_HALT_RETRY                      100000
+
 /*
  * APIs and macros exposed for mmc/sd drivers
  */
@@ -378,6 +481,18 @@ uint8_t  sdhci_set_bus_width(struct sdhci_host *, uint16_t);
 uint32_t sdhci_clk_supply(struct sdhci_host *, uint32_t);
 /* API: To enable SDR/DDR mode */
 void sdhci_set_uhs_mode(struct sdhci_host *, uint32_t);
+/* API: Switch the bus to 1.8V signalling after CMD11 */
+uint32_t sdhci_switch_signal_voltage(struct sdhci_host *host);
 /* API: Soft reset for the controller */
 void sdhci_reset(struct sdhci_host *host, uint8_t mask);
+/* API: Wait for command completion on the host controller irq */
+void sdhci_enable_irq(struct sdhci_host *host, uint32_t irq);
+/* API: Hand the bus to the command queue engine, the card must be in cmdq mode */
+uint32_t sdhci_cqe_enable(struct sdhci_host *host, uint32_t rca);
+/* API: Halt the command queue engine & give the bus back to sdhci_send_command */
+void sdhci_cqe_disable(struct sdhci_host *host);
+/* API: Queue a read or write task on the command queue engine */
+void sdhci_cqe_queue(struct sdhci_host *host, uint32_t tag, struct sdhci_cqe_task *task);
+/* API: Wait until one of the queued tasks is complete */
+uint32_t sdhci_cqe_wait(struct sdhci_host *host, uint32_t tags, uint32_t *done);
 #endif
@@ -138,6 +138,7 @@ struct sdhci_msm_data
 	uint8_t slot;
 	uint8_t use_io_switch;
 	event_t*  sdhc_event;
+	event_t pwr_event;       /* Backs sdhc_event for the lifetime of the host */
 };
 
 void sdhci_msm_init(struct sdhci_host *host, struct sdhci_msm_data *data);
@@ -146,4 +147,6 @@ void sdhci_mode_disable(struct sdhci_host *host);
 /* API: Toggle the bit for clock-data recovery */
 void sdhci_msm_toggle_cdr(struct sdhci_host *host, bool enable);
 void sdhci_msm_set_mci_clk(struct sdhci_host *host);
+/* API: Switch the IO pads between 3V & 1.8V signalling */
+void sdhci_msm_set_io_pad(struct sdhci_host *host, bool low_voltage);
 #endif
@@ -55,6 +55,7 @@ struct send_cmd_rsp
 
 int get_secapp_handle(void);
 bool is_sec_app_loaded(void);
+bool is_sec_app_started(void);
 int load_sec_app(void);
 int get_secapp_handle(void);
 int send_milestone_call_to_tz(void);
@@ -152,5 +152,9 @@ unsigned int pmic_arb_read_cmd(struct pmic_arb_cmd *cmd,
 uint8_t pmic_spmi_reg_read(uint32_t addr);
 void pmic_spmi_reg_write(uint32_t addr, uint8_t val);
 void pmic_spmi_reg_mask_write(uint32_t addr, uint8_t mask, uint8_t val);
+unsigned int pmic_spmi_reg_bulk_read(uint32_t addr, uint8_t *buf, size_t len);
+unsigned int pmic_spmi_reg_bulk_write(uint32_t addr, const uint8_t *buf, size_t len);
+unsigned int pmic_spmi_reg_update_bits(uint32_t addr, uint8_t mask, uint8_t val);
+void pmic_spmi_shadow_invalidate(uint32_t addr);
 bool spmi_initialized(void);
 #endif
@@ -34,6 +34,9 @@
 #define SCSI_MAX_DATA_TRANS_BLK_LEN    0xFFFF
 #define UFS_DEFAULT_SECTORE_SIZE       4096
 
+/* Commands kept in flight by ucs_do_scsi_readv() */
+#define UCS_QUEUE_DEPTH                8
+
 #define SCSI_STATUS_GOOD               0x00
 #define SCSI_STATUS_CHK_COND           0x02
 #define SCSI_STATUS_BUSY               0x08
@@ -163,6 +166,7 @@ struct scsi_failure_sense_data
 int ucs_scsi_send_inquiry(struct ufs_dev *dev);
 int ucs_do_scsi_cmd(struct ufs_dev *dev, struct scsi_req_build_type *req);
 int ucs_do_scsi_read(struct ufs_dev *dev, struct scsi_rdwr_req *req);
+int ucs_do_scsi_readv(struct ufs_dev *dev, struct scsi_rdwr_req *reqs, uint32_t count);
 int ucs_do_scsi_write(struct ufs_dev *dev, struct scsi_rdwr_req *req);
 int ucs_do_scsi_unmap(struct ufs_dev *dev, struct scsi_unmap_req *req);
 /*
@@ -114,8 +114,11 @@ struct ufs_dev
 #define UFS_WLUN_BOOT            0xB0
 #define UFS_WLUN_RPMB            0xC4
 
+struct scsi_rdwr_req;
+
 int ufs_init(struct ufs_dev *dev);
 int ufs_read(struct ufs_dev* dev, uint64_t start_lba, addr_t buffer, uint32_t num_blocks);
+int ufs_readv(struct ufs_dev* dev, struct scsi_rdwr_req *reqs, uint32_t count);
 int ufs_write(struct ufs_dev* dev, uint64_t start_lba, addr_t buffer, uint32_t num_blocks);
 int ufs_erase(struct ufs_dev* dev, uint64_t start_lba, uint32_t num_blocks);
 uint64_t ufs_get_dev_capacity(struct ufs_dev* dev);
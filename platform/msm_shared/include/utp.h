@@ -144,7 +144,20 @@ struct utp_bitmap_access_type
 	mutex_t *mutx;
 };
 
+/* A UPIU in flight, see utp_submit_upiu(). */
+struct utp_queued_req
+{
+	struct upiu_req_build_type *upiu_data;
+	struct upiu_gen_hdr        *req_upiu;
+	struct utp_trans_req_desc  *desc;
+	uint32_t                   cmd_desc_len;
+	uint32_t                   door_bell_bit;
+	uint32_t                   reserved_bits;
+};
+
 int utp_enqueue_upiu(struct ufs_dev *dev, struct upiu_req_build_type *upiu_data);
+int utp_submit_upiu(struct ufs_dev *dev, struct upiu_req_build_type *upiu_data, struct utp_queued_req *qreq);
+int utp_wait_upiu(struct ufs_dev *dev, struct utp_queued_req *qreq);
 void utp_process_req_completion(struct ufs_req_irq_type *irq);
 int utp_poll_utrd_complete(struct ufs_dev *dev);
 #endif
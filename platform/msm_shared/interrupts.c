@@ -33,10 +33,17 @@
 #include <debug.h>
 #include <qgic.h>
 
+#if WITH_LK2ND_PERF
+#include <lk2nd/perf.h>
+#endif
+
 extern int target_supports_qgic(void);
 
 enum handler_return platform_irq(struct arm_iframe *frame)
 {
+#if WITH_LK2ND_PERF
+	lk2nd_profile_irq_frame = frame;
+#endif
 #if TARGET_USES_GIC_VIC
 	if(target_supports_qgic())
 		return gic_platform_irq(frame);
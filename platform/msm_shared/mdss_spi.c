@@ -38,6 +38,11 @@
 #define SUCCESS           0
 #define FAIL              1
 
+/* MIPI DCS commands to write a window of the panel memory */
+#define DCS_SET_COLUMN_ADDRESS    0x2a
+#define DCS_SET_PAGE_ADDRESS      0x2b
+#define DCS_WRITE_MEMORY_START    0x2c
+
 static struct qup_spi_dev *dev = NULL;
 
 #if QM215_MDSS_SPI
@@ -214,6 +219,46 @@ int mdss_spi_on(struct msm_panel_info *pinfo, struct fbcon_config *fb)
 	return ret;
 }
 
+/* Send only rows y to y + h - 1 of the framebuffer, using a DCS window */
+int mdss_spi_update_rows(struct fbcon_config *fb, unsigned y, unsigned h)
+{
+	unsigned char caset[] = { DCS_SET_COLUMN_ADDRESS };
+	unsigned char raset[] = { DCS_SET_PAGE_ADDRESS };
+	unsigned char ramwr[] = { DCS_WRITE_MEMORY_START };
+	unsigned char window[4];
+	unsigned row_bytes = fb->stride * (fb->bpp / 8);
+	unsigned y1 = y + h - 1;
+	int ret = 0;
+
+	if (!h)
+		return SUCCESS;
+
+	window[0] = 0;
+	window[1] = 0;
+	window[2] = (fb->width - 1) >> 8;
+	window[3] = (fb->width - 1) & 0xff;
+	ret |= mdss_spi_write_cmd(caset);
+	ret |= mdss_spi_write_data(window, sizeof(window));
+
+	window[0] = y >> 8;
+	window[1] = y & 0xff;
+	window[2] = y1 >> 8;
+	window[3] = y1 & 0xff;
+	ret |= mdss_spi_write_cmd(raset);
+	ret |= mdss_spi_write_data(window, sizeof(window));
+
+	ret |= mdss_spi_write_cmd(ramwr);
+	if (ret)
+		return ret;
+
+	ret = mdss_spi_write_frame((unsigned char *)fb->base + y * row_bytes,
+				   h * row_bytes);
+	if (ret)
+		dprintf(CRITICAL, "Send SPI frame data to panel failed\n");
+
+	return ret;
+}
+
 int mdss_spi_cmd_post_on(struct msm_panel_info *pinfo)
 {
 	int cmd_count = 0;
@@ -176,6 +176,12 @@ static int mdss_dsi_wait4_video_done(uint32_t ctl_base)
 	return status;
 }
 
+/*
+ * Consecutive commands are packed into a single DMA transfer if the "last"
+ * bit in the header of a command is not set and it has no delay. The
+ * controller sends the packets back to back, so a sequence of commands
+ * needs only one trigger and one wait for completion.
+ */
 int mdss_dsi_cmds_tx(struct mipi_panel_info *mipi,
 	struct mipi_dsi_cmd *cmds, int count, char dual_dsi)
 {
@@ -185,7 +191,8 @@ int mdss_dsi_cmds_tx(struct mipi_panel_info *mipi,
 	int i = 0;
 	uint8_t pload[256];
 	uint32_t off;
-	uint32_t size;
+	uint32_t size, len;
+	uint8_t *hdr;
 	uint32_t ctl_base, sctl_base;
 
 	/* if dest controller is not specified, default to DSI0 */
@@ -205,34 +212,49 @@ int mdss_dsi_cmds_tx(struct mipi_panel_info *mipi,
 	off += (uint32_t) pload;
 
 	cm = cmds;
-	for (i = 0; i < count; i++) {
+	while (i < count) {
 		/* Wait for VIDEO_MODE_DONE */
 		ret = mdss_dsi_wait4_video_done(ctl_base);
 		if (ret)
 			goto wait4video_error;
 
-		/* The payload size has to be a multiple of 4 */
-		size = cm->size;
-		size &= 0x03;
-		if (size)
-			size = 4 - size;
-		size += cm->size;
-		memcpy((uint8_t *)off, (cm->payload), size);
-		arch_clean_invalidate_cache_range((addr_t)(off), size);
+		len = 0;
+		do {
+			/* The payload size has to be a multiple of 4 */
+			size = cm->size;
+			size &= 0x03;
+			if (size)
+				size = 4 - size;
+			size += cm->size;
+
+			/* Start a new transfer if the packet does not fit anymore */
+			if (len && off + len + size > (uint32_t)pload + sizeof(pload))
+				break;
+
+			hdr = (uint8_t *)off + len;
+			memcpy(hdr, (cm->payload), size);
+			len += size;
+			cm++;
+			i++;
+		} while (i < count && !(hdr[3] & DSI_HDR_LAST) && !cm[-1].wait);
+
+		/* The final packet of the transfer must have the last bit set */
+		hdr[3] |= DSI_HDR_LAST;
+
+		arch_clean_invalidate_cache_range((addr_t)(off), len);
 		writel(off, ctl_base + DMA_CMD_OFFSET);
-		writel(size, ctl_base + DMA_CMD_LENGTH);
+		writel(len, ctl_base + DMA_CMD_LENGTH);
 		if (dual_dsi) {
 			writel(off, sctl_base + DMA_CMD_OFFSET);
-			writel(size, sctl_base + DMA_CMD_LENGTH);
+			writel(len, sctl_base + DMA_CMD_LENGTH);
 		}
 		dsb();
 		ret += mdss_dsi_cmd_dma_trigger_for_panel(dual_dsi, ctl_base,
 			sctl_base);
-		if (cm->wait)
-			mdelay(cm->wait);
+		if (cm[-1].wait)
+			mdelay(cm[-1].wait);
 		else
 			udelay(80);
-		cm++;
 	}
 wait4video_error:
 #endif
@@ -33,6 +33,7 @@
 #include <mipi_dsi.h>
 #include <platform/iomap.h>
 #include <qtimer.h>
+#include <kernel/thread.h>
 #include <arch/defines.h>
 
 #define LPFR_LUT_SIZE 10
@@ -135,7 +136,7 @@ uint32_t mdss_dsi_pll_20nm_lock_status(uint32_t pll_base)
 		status &= 0x20; /* bit 5 */
 		if (status)
 			break;
-		udelay(5000);
+		thread_usleep(5000);
 	}
 
 	if (!status)
@@ -149,7 +150,7 @@ uint32_t mdss_dsi_pll_20nm_lock_status(uint32_t pll_base)
 		status &= 0x40; /* bit 6 */
 		if (status)
 			break;
-		udelay(5000);
+		thread_usleep(5000);
 	}
 
 pll_done:
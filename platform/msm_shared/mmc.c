@@ -3482,6 +3482,17 @@ uint32_t mmc_get_device_blocksize(void)
 	return mmc_card.block_size;
 }
 
+/* Erased blocks are not known to read as zero, zeros must be written */
+uint32_t mmc_get_zero_erase_size(void)
+{
+	return 0;
+}
+
+uint32_t mmc_zero_erase(uint64_t addr, uint64_t len)
+{
+	return 1;
+}
+
 void mmc_put_card_to_sleep(void)
 {
 	uint32_t mmc_ret;
@@ -37,6 +37,11 @@
 #include <platform/iomap.h>
 #include <platform/timer.h>
 #include <platform.h>
+#include <target.h>
+
+#if WITH_LK2ND_PERF
+#include <lk2nd/perf.h>
+#endif
 
 extern void clock_init_mmc(uint32_t);
 extern void clock_config_mmc(uint32_t, uint32_t);
@@ -857,6 +862,26 @@ static uint8_t mmc_card_supports_ddr_mode(struct mmc_card *card)
 		return 0;
 }
 
+/*
+ * Function : mmc get bus width
+ * Arg      : Host & config data
+ * Return   : Bus width for eMMC cards
+ * Flow     : Pick the widest bus supported by the target & host
+ */
+static uint32_t mmc_get_bus_width(struct sdhci_host *host, struct mmc_config_data *cfg)
+{
+	if (cfg->bus_width == DATA_BUS_WIDTH_8BIT && host->caps.bus_width_8bit)
+		return DATA_BUS_WIDTH_8BIT;
+	/*
+	 * Host contoller by default supports 4 bit & 1 bit mode.
+	 * No need to check for host support here
+	 */
+	else if (cfg->bus_width == DATA_BUS_WIDTH_4BIT)
+		return DATA_BUS_WIDTH_4BIT;
+	else
+		return DATA_BUS_WIDTH_1BIT;
+}
+
 /*
  * Function : Enable HS200 mode
  * Arg      : Host, card structure and bus width
@@ -1099,22 +1124,23 @@ static uint8_t mmc_host_init(struct mmc_device *dev)
 	struct mmc_config_data *cfg;
 	struct sdhci_msm_data *data;
 
-	event_t sdhc_event;
-
 	host = &dev->host;
 	cfg = &dev->config;
 
-	event_init(&sdhc_event, false, EVENT_FLAG_AUTOUNSIGNAL);
+	data = (struct sdhci_msm_data *) malloc(sizeof(struct sdhci_msm_data));
+	ASSERT(data);
+
+	/* The power irq is also used after init for the voltage switch */
+	event_init(&data->pwr_event, false, EVENT_FLAG_AUTOUNSIGNAL);
 
 	host->base = cfg->sdhc_base;
-	host->sdhc_event = &sdhc_event;
+	host->sdhc_event = &data->pwr_event;
 	host->caps.hs200_support = cfg->hs200_support;
 	host->caps.hs400_support = cfg->hs400_support;
+	host->irq = 0;
+	host->cqe_base = cfg->cqe_base;
 
-	data = (struct sdhci_msm_data *) malloc(sizeof(struct sdhci_msm_data));
-	ASSERT(data);
-
-	data->sdhc_event = &sdhc_event;
+	data->sdhc_event = &data->pwr_event;
 	data->pwrctl_base = cfg->pwrctl_base;
 	data->pwr_irq = cfg->pwr_irq;
 	data->slot = cfg->slot;
@@ -1250,9 +1276,50 @@ static uint32_t mmc_send_app_cmd(struct sdhci_host *host, struct mmc_card *card)
 	return 0;
 }
 
+/*
+ * Function: mmc sd uhs supported
+ * Arg     : host structure
+ * Return  : true if 1.8V signalling can be requested from the card
+ * Flow    : The host needs one of the UHS-I modes & the target has to be
+ *           able to switch the IO supply, which starts out at 3V
+ */
+static bool mmc_sd_uhs_supported(struct sdhci_host *host)
+{
+	if (!host->caps.sdr50_support && !host->caps.sdr104_support &&
+	    !host->caps.ddr_support)
+		return false;
+
+	return !target_sdc_set_io_voltage(host->msm_host->slot, SD_IO_VOLTAGE_3_0);
+}
+
+/*
+ * Function: mmc sd switch voltage
+ * Arg     : host & card structure
+ * Return  : 0 on Success, 1 on Failure
+ * Flow    : Send CMD11 & switch the host to 1.8V signalling
+ */
+static uint32_t mmc_sd_switch_voltage(struct sdhci_host *host, struct mmc_card *card)
+{
+	struct mmc_command cmd = {0};
+
+	cmd.cmd_index = CMD11_VOLTAGE_SWITCH;
+	cmd.argument = 0x0;
+	cmd.cmd_type = SDHCI_CMD_TYPE_NORMAL;
+	cmd.resp_type = SDHCI_CMD_RESP_R1;
+
+	if (sdhci_send_command(host, &cmd))
+	{
+		dprintf(CRITICAL, "Failed sending CMD11\n");
+		return 1;
+	}
+
+	return sdhci_switch_signal_voltage(host);
+}
+
 uint32_t mmc_sd_card_init(struct sdhci_host *host, struct mmc_card *card)
 {
 	uint8_t i;
+	bool uhs;
 	struct mmc_command cmd;
 
 	memset((struct mmc_command *)&cmd, 0, sizeof(struct mmc_command));
@@ -1291,6 +1358,8 @@ uint32_t mmc_sd_card_init(struct sdhci_host *host, struct mmc_card *card)
 		return 1;
 	}
 
+	uhs = mmc_sd_uhs_supported(host);
+
 	/* Send ACMD41 for OCR */
 	for (i = 0; i < SD_ACMD41_MAX_RETRY; i++)
 	{
@@ -1304,6 +1373,8 @@ uint32_t mmc_sd_card_init(struct sdhci_host *host, struct mmc_card *card)
 		/* APP_CMD is successful, send ACMD41 now */
 		cmd.cmd_index = ACMD41_SEND_OP_COND;
 		cmd.argument = MMC_SD_OCR | MMC_SD_HC_HCS;
+		if (uhs)
+			cmd.argument |= MMC_SD_S18R;
 		cmd.cmd_type = SDHCI_CMD_TYPE_NORMAL;
 		cmd.resp_type = SDHCI_CMD_RESP_R3;
 
@@ -1336,6 +1407,17 @@ uint32_t mmc_sd_card_init(struct sdhci_host *host, struct mmc_card *card)
 		return 1;
 	}
 
+	/* Card accepted 1.8V signalling (S18A) */
+	if (uhs && (cmd.resp[0] & MMC_SD_S18R))
+	{
+		if (mmc_sd_switch_voltage(host, card))
+		{
+			dprintf(CRITICAL, "Failed to switch the SD card to 1.8V\n");
+			return 1;
+		}
+		card->sd_uhs = 1;
+	}
+
 	return 0;
 }
 
@@ -1488,6 +1570,113 @@ uint32_t mmc_sd_set_hs(struct sdhci_host *host, struct mmc_card *card)
 	return 0;
 }
 
+/*
+ * Function: mmc sd switch func
+ * Arg     : host structure, CMD6 argument & status buffer
+ * Return  : 0 on Success, 1 on Failure
+ * Flow    : Send CMD6 & read the 64 byte switch status into status
+ */
+static uint32_t mmc_sd_switch_func(struct sdhci_host *host, uint32_t arg, uint8_t *status)
+{
+	struct mmc_command cmd = {0};
+
+	cmd.cmd_index = CMD6_SWITCH_FUNC;
+	cmd.argument = arg;
+	cmd.cmd_type = SDHCI_CMD_TYPE_NORMAL;
+	cmd.resp_type = SDHCI_CMD_RESP_R1;
+	cmd.trans_mode = SDHCI_MMC_READ;
+	cmd.data_present = 0x1;
+	cmd.data.data_ptr = status;
+	cmd.data.num_blocks = 0x1;
+	cmd.data.blk_sz = 0x40;
+
+	return sdhci_send_command(host, &cmd);
+}
+
+/*
+ * Function: mmc sd set uhs
+ * Arg     : host, card structure & bus width
+ * Return  : 0 on Success, 1 on Failure
+ * Flow    : 1. Pick the fastest bus speed supported by host & card in the
+ *              order SDR104, DDR50, SDR50, stay in SDR25 otherwise
+ *           2. Switch the card with CMD6 & check the selected function
+ *           3. Set the mode in the controller & tune SDR104/SDR50
+ */
+static uint32_t mmc_sd_set_uhs(struct sdhci_host *host, struct mmc_card *card,
+							   uint32_t bus_width)
+{
+	BUF_DMA_ALIGN(switch_resp, 64);
+	uint8_t support;
+	uint32_t func;
+	uint32_t mode;
+	uint32_t mmc_ret;
+
+	if (mmc_sd_switch_func(host, MMC_SD_SWITCH_CHECK, switch_resp))
+	{
+		dprintf(CRITICAL, "Failed to read the SD card bus speed modes\n");
+		return 1;
+	}
+
+	support = switch_resp[SD_SWITCH_GRP1_SUPPORT];
+
+	if (host->caps.sdr104_support && (support & BIT(SD_ACCESS_MODE_SDR104)))
+	{
+		func = SD_ACCESS_MODE_SDR104;
+		mode = SDHCI_SDR104_MODE;
+	}
+	else if (host->caps.ddr_support && (support & BIT(SD_ACCESS_MODE_DDR50)))
+	{
+		func = SD_ACCESS_MODE_DDR50;
+		mode = SDHCI_DDR50_MODE;
+	}
+	else if (host->caps.sdr50_support && (support & BIT(SD_ACCESS_MODE_SDR50)))
+	{
+		func = SD_ACCESS_MODE_SDR50;
+		mode = SDHCI_SDR50_MODE;
+	}
+	else
+		return 0;
+
+	if (mmc_sd_switch_func(host, MMC_SD_SWITCH_SET | func, switch_resp))
+	{
+		dprintf(CRITICAL, "Failed to switch the SD card bus speed\n");
+		return 1;
+	}
+
+	if ((switch_resp[SD_SWITCH_GRP1_SELECT] & SD_SWITCH_GRP1_SELECT_MASK) != func)
+	{
+		dprintf(CRITICAL, "SD card rejected bus speed function %u\n", func);
+		return 0;
+	}
+
+	/*
+	 * SDHCI_SDR104_MODE would read as MMC_HS400_TIMING, which switches
+	 * the MCLK divider in sdhci_msm_set_mci_clk(). Both tuned SD modes
+	 * are saved as MMC_HS200_TIMING (same as SDHCI_SDR50_MODE).
+	 */
+	if (mode == SDHCI_DDR50_MODE)
+		MMC_SAVE_TIMING(host, SDHCI_DDR50_MODE);
+	else
+		MMC_SAVE_TIMING(host, MMC_HS200_TIMING);
+
+	sdhci_set_uhs_mode(host, mode);
+
+	if (mode == SDHCI_DDR50_MODE)
+	{
+		dprintf(INFO, "SDHC Running in DDR50 mode\n");
+		return 0;
+	}
+
+	dprintf(INFO, "SDHC Running in %s mode\n",
+			(mode == SDHCI_SDR104_MODE) ? "SDR104" : "SDR50");
+
+	mmc_ret = sdhci_msm_execute_tuning(host, card, bus_width);
+	if (mmc_ret)
+		dprintf(CRITICAL, "Tuning for the SD card failed\n");
+
+	return mmc_ret;
+}
+
 static const char *mmc_card_type_str(struct mmc_card *card)
 {
 	switch (card->type) {
@@ -1612,16 +1801,7 @@ static uint32_t mmc_card_init(struct mmc_device *dev)
 	if (MMC_CARD_MMC(card))
 	{
 		/* Set the bus width based on host, target capbilities */
-		if (cfg->bus_width == DATA_BUS_WIDTH_8BIT && host->caps.bus_width_8bit)
-				bus_width = DATA_BUS_WIDTH_8BIT;
-		/*
-		 * Host contoller by default supports 4 bit & 1 bit mode.
-		 * No need to check for host support here
-		 */
-		else if (cfg->bus_width == DATA_BUS_WIDTH_4BIT)
-				bus_width = DATA_BUS_WIDTH_4BIT;
-		else
-				bus_width = DATA_BUS_WIDTH_1BIT;
+		bus_width = mmc_get_bus_width(host, cfg);
 
 		/* Set 4/8 bit SDR bus width in controller */
 		mmc_return = sdhci_set_bus_width(host, bus_width);
@@ -1711,6 +1891,17 @@ static uint32_t mmc_card_init(struct mmc_device *dev)
 			dprintf(CRITICAL, "Failed to set bus width for host controller\n");
 			return mmc_return;
 		}
+
+		/* UHS-I bus speeds need 1.8V signalling & the 4 bit bus */
+		if (card->sd_uhs && bus_width == DATA_BUS_WIDTH_4BIT)
+		{
+			mmc_return = mmc_sd_set_uhs(host, card, bus_width);
+			if (mmc_return)
+			{
+				dprintf(CRITICAL, "Failed to set UHS-I mode for the SD card\n");
+				return mmc_return;
+			}
+		}
 	}
 
 
@@ -1873,17 +2064,60 @@ static uint32_t mmc_stop_command(struct mmc_device *dev)
 }
 
 /*
- * Function: mmc sdhci read
- * Arg     : mmc device structure, block address, number of blocks & destination
+ * Function: mmc sdhci retune
+ * Arg     : mmc device structure
+ * Return  : 0 on Success, 1 on Failure
+ * Flow    : Run the tuning sequence again for an eMMC card in HS200 mode.
+ *           HS400 needs to go through HS200 & calibration again, that is
+ *           not supported.
+ */
+uint32_t mmc_sdhci_retune(struct mmc_device *dev)
+{
+	struct sdhci_host *host = &dev->host;
+	struct mmc_card *card = &dev->card;
+
+	if (!MMC_CARD_MMC(card) || host->timing != MMC_HS200_TIMING)
+		return 1;
+
+	return sdhci_msm_execute_tuning(host, card, mmc_get_bus_width(host, &dev->config));
+}
+
+/*
+ * Function: mmc sdhci max trans size
+ * Arg     : mmc device structure
+ * Return  : Max number of bytes moved by a single read/write command
+ * Flow    : The 16 bit block count register limits the transfer unless the
+ *           host runs in version 4 mode. eMMC always uses CMD23, which only
+ *           carries a 16 bit block count.
+ */
+uint32_t mmc_sdhci_max_trans_size(struct mmc_device *dev)
+{
+	struct mmc_card *card = &dev->card;
+
+	if (dev->host.v4_mode && MMC_CARD_SD(card))
+		return SDHCI_V4_MAX_TRANS_SZ;
+
+	return SDHCI_ADMA_MAX_TRANS_SZ;
+}
+
+/*
+ * Function: mmc sdhci read common
+ * Arg     : mmc device structure, destination or segments, block address
+ *           & number of blocks
  * Return  : 0 on Success, non zero on success
  * Flow    : Fill in the command structure & send the command
  */
-uint32_t mmc_sdhci_read(struct mmc_device *dev, void *dest,
-						uint64_t blk_addr, uint32_t num_blocks)
+static uint32_t mmc_sdhci_read_common(struct mmc_device *dev, void *dest,
+									  struct sdhci_sg *sg, uint32_t sg_count,
+									  uint64_t blk_addr, uint32_t num_blocks)
 {
 	uint32_t mmc_ret = 0;
 	struct mmc_command cmd;
 	struct mmc_card *card = &dev->card;
+#if WITH_LK2ND_PERF
+	LK2ND_PERF_SCOPE("mmc_sdhci_read");
+	LK2ND_PERF_COUNT("mmc_sdhci_read_blocks", num_blocks);
+#endif
 
 	memset((struct mmc_command *)&cmd, 0, sizeof(struct mmc_command));
 
@@ -1924,6 +2158,8 @@ uint32_t mmc_sdhci_read(struct mmc_device *dev, void *dest,
 
 	cmd.data.data_ptr = dest;
 	cmd.data.num_blocks = num_blocks;
+	cmd.data.sg = sg;
+	cmd.data.sg_count = sg_count;
 
 	/* send command */
 	mmc_ret = sdhci_send_command(&dev->host, &cmd);
@@ -1941,6 +2177,142 @@ uint32_t mmc_sdhci_read(struct mmc_device *dev, void *dest,
 	return mmc_parse_response(cmd.resp[0]);
 }
 
+/*
+ * Function: mmc sdhci read
+ * Arg     : mmc device structure, block address, number of blocks & destination
+ * Return  : 0 on Success, non zero on success
+ * Flow    : Fill in the command structure & send the command
+ */
+uint32_t mmc_sdhci_read(struct mmc_device *dev, void *dest,
+						uint64_t blk_addr, uint32_t num_blocks)
+{
+	return mmc_sdhci_read_common(dev, dest, NULL, 0, blk_addr, num_blocks);
+}
+
+/*
+ * Function: mmc sdhci read sg
+ * Arg     : mmc device structure, segments, number of segments, block
+ *           address & number of blocks
+ * Return  : 0 on Success, non zero on success
+ * Flow    : Read consecutive blocks with a single command, the data is
+ *           scattered over the segments by the ADMA descriptor table.
+ *           The segment lengths must add up to num_blocks blocks.
+ */
+uint32_t mmc_sdhci_read_sg(struct mmc_device *dev, struct sdhci_sg *sg, uint32_t sg_count,
+						   uint64_t blk_addr, uint32_t num_blocks)
+{
+	return mmc_sdhci_read_common(dev, NULL, sg, sg_count, blk_addr, num_blocks);
+}
+
+/*
+ * Function: mmc sdhci queue depth
+ * Arg     : mmc device structure
+ * Return  : Number of tasks that can be queued, 0 if not supported
+ * Flow    : Command queueing needs an eMMC 5.1 card & a host with a
+ *           command queue engine (config.cqe_base)
+ */
+uint32_t mmc_sdhci_queue_depth(struct mmc_device *dev)
+{
+	struct mmc_card *card = &dev->card;
+
+	if (!dev->host.cqe_base || card->type != MMC_TYPE_MMCHC || !card->ext_csd)
+		return 0;
+
+	if (card->ext_csd[MMC_EXT_CSD_REV] < MMC_EXT_CSD_REV_5_1 ||
+		!(card->ext_csd[MMC_EXT_CSD_CMDQ_SUPPORT] & MMC_CMDQ_SUPPORTED))
+		return 0;
+
+	return MIN((card->ext_csd[MMC_EXT_CSD_CMDQ_DEPTH] & MMC_CMDQ_DEPTH_MASK) + 1U,
+			   SDHCI_CQE_MAX_TASKS);
+}
+
+/*
+ * Function: mmc cmdq discard
+ * Arg     : mmc device structure
+ * Return  : 0 on Success, non zero on failure
+ * Flow    : Drop the tasks the card still has queued after an error
+ */
+static uint32_t mmc_cmdq_discard(struct mmc_device *dev)
+{
+	struct mmc_command cmd;
+
+	memset((struct mmc_command *)&cmd, 0, sizeof(struct mmc_command));
+
+	cmd.cmd_index = CMD48_CMDQ_TASK_MGMT;
+	cmd.argument = MMC_CMDQ_DISCARD_QUEUE;
+	cmd.cmd_type = SDHCI_CMD_TYPE_NORMAL;
+	cmd.resp_type = SDHCI_CMD_RESP_R1B;
+
+	return sdhci_send_command(&dev->host, &cmd);
+}
+
+/*
+ * Function: mmc sdhci read queued
+ * Arg     : mmc device structure, tasks & number of tasks
+ * Return  : 0 on Success, non zero on failure
+ * Flow    : 1. Switch the card to command queue mode
+ *           2. Keep up to queue depth read tasks queued on the engine,
+ *              the card runs them in the order it prefers
+ *           3. Switch back, other commands are not allowed in this mode
+ *           Without command queueing the tasks are read one by one.
+ */
+uint32_t mmc_sdhci_read_queued(struct mmc_device *dev, struct sdhci_cqe_task *tasks, uint32_t count)
+{
+	struct sdhci_host *host = &dev->host;
+	struct mmc_card *card = &dev->card;
+	uint32_t depth = mmc_sdhci_queue_depth(dev);
+	uint32_t busy = 0;
+	uint32_t done = 0;
+	uint32_t mmc_ret = 0;
+	uint32_t tag;
+	uint32_t i = 0;
+
+	if (!depth || count == 1)
+	{
+		for (i = 0; i < count; i++)
+		{
+			mmc_ret = mmc_sdhci_read_sg(dev, tasks[i].sg, tasks[i].sg_count,
+										tasks[i].blk_addr, tasks[i].num_blocks);
+			if (mmc_ret)
+				return mmc_ret;
+		}
+		return 0;
+	}
+
+	mmc_ret = mmc_switch_cmd(host, card, MMC_ACCESS_WRITE, MMC_EXT_CSD_CMDQ_MODE_EN, 1);
+	if (mmc_ret)
+		return mmc_ret;
+
+	mmc_ret = sdhci_cqe_enable(host, card->rca);
+
+	while (!mmc_ret && (i < count || busy))
+	{
+		/* Refill the slots of the completed tasks */
+		for (tag = 0; tag < depth && i < count; tag++)
+		{
+			if (busy & (1 << tag))
+				continue;
+
+			tasks[i].read = 1;
+			sdhci_cqe_queue(host, tag, &tasks[i++]);
+			busy |= 1 << tag;
+		}
+
+		mmc_ret = sdhci_cqe_wait(host, busy, &done);
+		busy &= ~done;
+	}
+
+	sdhci_cqe_disable(host);
+
+	if (mmc_ret)
+		mmc_cmdq_discard(dev);
+
+	if (mmc_switch_cmd(host, card, MMC_ACCESS_WRITE, MMC_EXT_CSD_CMDQ_MODE_EN, 0))
+		mmc_ret = 1;
+
+	return mmc_ret;
+}
+
 /*
  * Function: mmc sdhci write
  * Arg     : mmc device structure, block address, number of blocks & source
@@ -1994,6 +2366,10 @@ uint32_t mmc_sdhci_write(struct mmc_device *dev, void *src,
 	cmd.data.data_ptr = src;
 	cmd.data.num_blocks = num_blocks;
 
+	/* The data may only be in the cache until the next flush */
+	if (card->cache_en)
+		card->cache_dirty = 1;
+
 	/* send command */
 	mmc_ret = sdhci_send_command(&dev->host, &cmd);
 
@@ -2097,9 +2473,9 @@ static uint32_t mmc_send_erase_grp_end(struct mmc_device *dev, uint32_t erase_en
 }
 
 /*
- * Send the erase CMD38, to erase the selected erase groups
+ * Send the erase CMD38, to erase (or trim/discard) the selected range
  */
-static uint32_t mmc_send_erase(struct mmc_device *dev, uint64_t erase_timeout)
+static uint32_t mmc_send_erase(struct mmc_device *dev, uint32_t arg, uint64_t erase_timeout)
 {
 	struct mmc_command cmd;
 	uint32_t status;
@@ -2108,7 +2484,7 @@ static uint32_t mmc_send_erase(struct mmc_device *dev, uint64_t erase_timeout)
 	memset((struct mmc_command *)&cmd, 0, sizeof(struct mmc_command));
 
 	cmd.cmd_index = CMD38_ERASE;
-	cmd.argument = 0x00000000;
+	cmd.argument = arg;
 	cmd.cmd_type = SDHCI_CMD_TYPE_NORMAL;
 	cmd.resp_type = SDHCI_CMD_RESP_R1B;
 	cmd.cmd_timeout = erase_timeout;
@@ -2231,7 +2607,7 @@ uint32_t mmc_sdhci_erase(struct mmc_device *dev, uint32_t blk_addr, uint64_t len
 		erase_timeout = (300 * 1000 * num_erase_grps);
 
 	/* Send CMD38 to perform erase */
-	if (mmc_send_erase(dev, erase_timeout))
+	if (mmc_send_erase(dev, MMC_ERASE_ARG, erase_timeout))
 	{
 		dprintf(CRITICAL, "Failed to erase the specified partition\n");
 		return 1;
@@ -2240,6 +2616,56 @@ uint32_t mmc_sdhci_erase(struct mmc_device *dev, uint32_t blk_addr, uint64_t len
 	return 0;
 }
 
+/*
+ * Function: mmc sdhci trim
+ * Arg     : mmc device structure, block address, number of blocks & CMD38 argument
+ * Return  : 0 on Success, non zero on failure
+ * Flow    : TRIM and DISCARD work on write blocks, so unlike mmc_sdhci_erase()
+ *           the range does not need to be aligned to erase groups
+ */
+uint32_t mmc_sdhci_trim(struct mmc_device *dev, uint32_t blk_addr, uint32_t num_blks, uint32_t arg)
+{
+	struct mmc_card *card = &dev->card;
+	uint32_t erase_unit_sz;
+	uint32_t num_erase_grps;
+	uint64_t trim_timeout;
+
+	if (!MMC_CARD_MMC(card) || !num_blks)
+		return 1;
+
+	if (card->ext_csd[MMC_ERASE_GRP_DEF])
+		erase_unit_sz = (MMC_HC_ERASE_MULT * card->ext_csd[MMC_HC_ERASE_GRP_SIZE]) / MMC_BLK_SZ;
+	else
+		erase_unit_sz = (card->csd.erase_grp_size + 1) * (card->csd.erase_grp_mult + 1);
+
+	if (mmc_send_erase_grp_start(dev, blk_addr))
+	{
+		dprintf(CRITICAL, "Failed to send trim start address\n");
+		return 1;
+	}
+
+	if (mmc_send_erase_grp_end(dev, blk_addr + num_blks - 1))
+	{
+		dprintf(CRITICAL, "Failed to send trim end address\n");
+		return 1;
+	}
+
+	/*
+	 * As per emmc 4.5 spec section 7.4.52 a trim takes up to
+	 * 300ms * TRIM_MULT, for every erase group that is touched
+	 */
+	num_erase_grps = (blk_addr + num_blks - 1) / erase_unit_sz - blk_addr / erase_unit_sz + 1;
+	trim_timeout = (300 * 1000 * card->ext_csd[MMC_TRIM_MULT] * (uint64_t)num_erase_grps);
+
+	if (mmc_send_erase(dev, arg, trim_timeout))
+	{
+		dprintf(CRITICAL, "Failed to trim the specified range\n");
+		return 1;
+	}
+
+	return 0;
+}
+
 /*
  * Function: mmc get wp status
  * Arg     : mmc device structure, block address and buffer for getting wp status
@@ -2392,6 +2818,83 @@ uint32_t mmc_set_clr_power_on_wp_user(struct mmc_device *dev, uint32_t addr, uin
 	return 0;
 }
 
+/*
+ * Function: mmc card has cache
+ * Arg     : Card structure
+ * Return  : true if the card has a volatile write cache
+ */
+static bool mmc_card_has_cache(struct mmc_card *card)
+{
+	if (!MMC_CARD_MMC(card) || !card->ext_csd ||
+		card->ext_csd[MMC_EXT_CSD_REV] < MMC_EXT_CSD_REV_4_5)
+		return false;
+
+	return card->ext_csd[MMC_EXT_CSD_CACHE_SIZE] || card->ext_csd[MMC_EXT_CSD_CACHE_SIZE + 1] ||
+		   card->ext_csd[MMC_EXT_CSD_CACHE_SIZE + 2] || card->ext_csd[MMC_EXT_CSD_CACHE_SIZE + 3];
+}
+
+/*
+ * Function: mmc sdhci set cache
+ * Arg     : mmc device structure & enable
+ * Return  : 0 on Success, non zero on failure
+ * Flow    : Turn the volatile write cache on or off with CMD6, the data
+ *           in the cache is flushed before turning it off. Cards without
+ *           a cache are left alone.
+ */
+uint32_t mmc_sdhci_set_cache(struct mmc_device *dev, bool enable)
+{
+	struct mmc_card *card = &dev->card;
+	uint32_t mmc_ret;
+
+	if (!mmc_card_has_cache(card) || card->cache_en == enable)
+		return 0;
+
+	if (!enable)
+	{
+		mmc_ret = mmc_sdhci_flush_cache(dev);
+		if (mmc_ret)
+			return mmc_ret;
+	}
+
+	mmc_ret = mmc_switch_cmd(&dev->host, card, MMC_ACCESS_WRITE, MMC_EXT_CSD_CACHE_CTRL,
+							 enable ? MMC_CACHE_EN : 0);
+	if (mmc_ret)
+	{
+		dprintf(CRITICAL, "Failed to %s the cache\n", enable ? "enable" : "disable");
+		return mmc_ret;
+	}
+
+	card->cache_en = enable;
+	return 0;
+}
+
+/*
+ * Function: mmc sdhci flush cache
+ * Arg     : mmc device structure
+ * Return  : 0 on Success, non zero on failure
+ * Flow    : Make the writes since the last flush persistent, the card
+ *           is busy until the cache is written to the flash
+ */
+uint32_t mmc_sdhci_flush_cache(struct mmc_device *dev)
+{
+	struct mmc_card *card = &dev->card;
+	uint32_t mmc_ret;
+
+	if (!card->cache_dirty)
+		return 0;
+
+	mmc_ret = mmc_switch_cmd(&dev->host, card, MMC_ACCESS_WRITE, MMC_EXT_CSD_FLUSH_CACHE,
+							 MMC_FLUSH_CACHE);
+	if (mmc_ret)
+	{
+		dprintf(CRITICAL, "Failed to flush the cache\n");
+		return mmc_ret;
+	}
+
+	card->cache_dirty = 0;
+	return 0;
+}
+
 /* Function to put the mmc card to sleep */
 void mmc_put_card_to_sleep(struct mmc_device *dev)
 {
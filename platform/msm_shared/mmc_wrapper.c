@@ -169,6 +169,39 @@ uint32_t mmc_write(uint64_t data_addr, uint32_t data_len, void *in)
 	return val;
 }
 
+/*
+ * Function: mmc_enable_write_cache
+ * Arg     : None
+ * Return  : 0 on Success, non zero on failure
+ * Flow    : Let the eMMC cache the writes of a flashing or mass storage
+ *           session, mmc_flush_write_cache() makes them persistent
+ */
+uint32_t mmc_enable_write_cache(void)
+{
+	void *dev = target_mmc_device();
+
+	if (!platform_boot_dev_isemmc() || !dev)
+		return 0;
+
+	return mmc_sdhci_set_cache((struct mmc_device *)dev, true);
+}
+
+/*
+ * Function: mmc_flush_write_cache
+ * Arg     : None
+ * Return  : 0 on Success, non zero on failure
+ * Flow    : Write the data still in the eMMC cache to the flash
+ */
+uint32_t mmc_flush_write_cache(void)
+{
+	void *dev = target_mmc_device();
+
+	if (!platform_boot_dev_isemmc() || !dev)
+		return 0;
+
+	return mmc_sdhci_flush_cache((struct mmc_device *)dev);
+}
+
 /*
  * Function: mmc_read
  * Arg     : Data address on card, o/p buffer & data length
@@ -421,6 +454,65 @@ uint32_t mmc_erase_card(uint64_t addr, uint64_t len)
 	return 0;
 }
 
+/*
+ * Function: mmc get zero erase size
+ * Arg     : None
+ * Return  : Alignment in bytes needed by mmc_zero_erase(), 0 if erased
+ *           blocks do not read back as zeros
+ * Flow    : TRIM works on single write blocks, ERASE on whole erase groups
+ */
+uint32_t mmc_get_zero_erase_size(void)
+{
+	struct mmc_device *dev;
+	struct mmc_card *card;
+
+	if (!platform_boot_dev_isemmc())
+		return 0;
+
+	dev = target_mmc_device();
+	card = &dev->card;
+
+	if (!MMC_CARD_MMC(card) || card->ext_csd[MMC_ERASED_MEM_CONT])
+		return 0;
+
+	if (card->ext_csd[MMC_SEC_FEATURE_SUPPORT] & MMC_SEC_GB_CL_EN)
+		return mmc_get_device_blocksize();
+
+	return mmc_get_eraseunit_size() * MMC_BLK_SZ;
+}
+
+/*
+ * Function: mmc zero erase
+ * Arg     : Byte address & length, aligned to mmc_get_zero_erase_size()
+ * Return  : 0 on Success, non zero on failure
+ * Flow    : TRIM or erase the range instead of writing zeros to it
+ */
+uint32_t mmc_zero_erase(uint64_t addr, uint64_t len)
+{
+	struct mmc_device *dev;
+	struct mmc_card *card;
+	uint32_t block_size;
+	uint32_t erase_size;
+
+	erase_size = mmc_get_zero_erase_size();
+	if (!erase_size)
+		return 1;
+
+	ASSERT(!(addr % erase_size));
+	ASSERT(!(len % erase_size));
+
+	dev = target_mmc_device();
+	card = &dev->card;
+	block_size = mmc_get_device_blocksize();
+
+	dprintf(SPEW, "Zero erase: 0x%llx:0x%llx\n", addr / block_size, len / block_size);
+
+	if (card->ext_csd[MMC_SEC_FEATURE_SUPPORT] & MMC_SEC_GB_CL_EN)
+		return mmc_sdhci_trim(dev, addr / block_size, len / block_size, MMC_TRIM_ARG);
+
+	return mmc_sdhci_erase(dev, addr / block_size, len);
+}
+
 /*
  * Function: mmc get psn
  * Arg     : None
@@ -609,30 +701,53 @@ uint8_t mmc_get_lun(void)
 	return lun;
 }
 
+/* LUNs with a partition table that has not been read yet */
+static uint8_t ptn_next_lun;
+static uint8_t ptn_max_luns;
+
+/*
+ * Function     : Read the partition table of the next LUN that was not read yet
+ * Return type  : false if the tables of all LUNs have been read already
+ */
+bool mmc_read_next_partition_table(void)
+{
+	uint8_t lun, cur_lun;
+
+	if (ptn_next_lun >= ptn_max_luns)
+		return false;
+
+	lun = ptn_next_lun++;
+	cur_lun = mmc_get_lun();
+	mmc_set_lun(lun);
+
+	if(partition_read_table())
+	{
+		dprintf(CRITICAL, "Error reading the partition table info for lun %d\n", lun);
+	}
+
+	mmc_set_lun(cur_lun);
+	return true;
+}
+
 void mmc_read_partition_table(uint8_t arg)
 {
 	void *dev;
-	uint8_t lun = 0;
-	uint8_t max_luns;
 
 	dev = target_mmc_device();
 
 	if(!platform_boot_dev_isemmc())
 	{
-		max_luns = ufs_get_num_of_luns((struct ufs_dev*)dev);
-
-		ASSERT(max_luns);
+		ptn_next_lun = arg;
+		ptn_max_luns = ufs_get_num_of_luns((struct ufs_dev*)dev);
 
-		for(lun = arg; lun < max_luns; lun++)
-		{
-			mmc_set_lun(lun);
+		ASSERT(ptn_max_luns);
 
-			if(partition_read_table())
-			{
-				dprintf(CRITICAL, "Error reading the partition table info for lun %d\n", lun);
-			}
-		}
+		/*
+		 * Only the first LUN is read now, the others when a partition
+		 * is not found in the LUNs read so far or all are enumerated.
+		 */
 		mmc_set_lun(0);
+		mmc_read_next_partition_table();
 	}
 	else
 	{
@@ -75,13 +75,11 @@ void update_partial_goods_dtb_nodes(void *fdt)
 		return;
 	}
 
-	ret = fdt_open_into(fdt, fdt, fdt_totalsize(fdt));
-	if (ret != 0)
-	{
-		dprintf(CRITICAL, "Failed to move/resize dtb buffer: %d\n", ret);
-		ASSERT(0);
-	}
-
+	/*
+	 * Only called from update_device_tree() on the opened tree, which is
+	 * packed afterwards. The properties are replaced in place, so the
+	 * tree does not need any space for them.
+	 */
 	for (i = 0; i < tbl_sz; i++)
 	{
 		if ((uint32_t)reg == table[i].val)
@@ -165,6 +163,4 @@ void update_partial_goods_dtb_nodes(void *fdt)
 			}
 		}
 	}
-
-	fdt_pack(fdt);
 }
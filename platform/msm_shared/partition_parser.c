@@ -53,6 +53,11 @@ __WEAK void mmc_read_partition_table(uint8_t arg)
 	}
 }
 
+__WEAK bool mmc_read_next_partition_table(void)
+{
+	return false;
+}
+
 static uint32_t mmc_boot_read_gpt(uint32_t block_size);
 static uint32_t mmc_boot_read_mbr(uint32_t block_size);
 static void mbr_fill_name(struct partition_entry *partition_ent,
@@ -86,8 +91,85 @@ static unsigned partition_count;
 /* this is a pointer to ptn_entries_buffer */
 static unsigned char *new_buffer = NULL;
 
+/*
+ * Hash table of the partition names for partition_get_index(), with open
+ * addressing. Each bucket holds the partition index + 1, or 0 if empty.
+ */
+#define PTN_INDEX_BUCKETS	(2 * NUM_PARTITIONS)
+static uint8_t ptn_index[PTN_INDEX_BUCKETS];
+/* number of partition entries that are in ptn_index */
+static unsigned ptn_index_count;
+/* set while a partition table is read, to avoid reading the next one meanwhile */
+static bool ptn_reading;
+
+static uint32_t ptn_index_hash(const char *name, size_t len)
+{
+	uint32_t hash = 2166136261U;	/* FNV-1a */
+
+	while (len--) {
+		hash ^= (uint8_t)*name++;
+		hash *= 16777619U;
+	}
+	return hash;
+}
+
+static int ptn_index_lookup(const char *name, size_t len)
+{
+	uint32_t i = ptn_index_hash(name, len) % PTN_INDEX_BUCKETS;
+	const char *ptn_name;
+
+	while (ptn_index[i]) {
+		ptn_name = (const char *)partition_entries[ptn_index[i] - 1].name;
+		if (!strncmp(ptn_name, name, len) && ptn_name[len] == '\0')
+			return ptn_index[i] - 1;
+		i = (i + 1) % PTN_INDEX_BUCKETS;
+	}
+	return INVALID_PTN;
+}
+
+/* Add new partition entries to the index, rebuilding it if entries were removed */
+static void ptn_index_update(void)
+{
+	const char *name;
+	uint32_t i;
+	size_t len;
+
+	if (partition_count < ptn_index_count) {
+		memset(ptn_index, 0, sizeof(ptn_index));
+		ptn_index_count = 0;
+	}
+
+	for (; ptn_index_count < partition_count; ptn_index_count++) {
+		name = (const char *)partition_entries[ptn_index_count].name;
+		len = strnlen(name, MAX_GPT_NAME_SIZE);
+
+		/* Like the linear search before, the first partition of a name wins */
+		if (ptn_index_lookup(name, len) != INVALID_PTN)
+			continue;
+
+		i = ptn_index_hash(name, len) % PTN_INDEX_BUCKETS;
+		while (ptn_index[i])
+			i = (i + 1) % PTN_INDEX_BUCKETS;
+		ptn_index[i] = ptn_index_count + 1;
+	}
+}
+
+/*
+ * Read the partition tables of the LUNs that were left to be read on demand
+ * by mmc_read_partition_table(), so that all partitions can be enumerated.
+ */
+static void partition_read_remaining(void)
+{
+	if (ptn_reading)
+		return;
+
+	while (mmc_read_next_partition_table())
+		;
+}
+
 unsigned partition_get_partition_count(void)
 {
+	partition_read_remaining();
 	return partition_count;
 }
 
@@ -117,10 +199,13 @@ unsigned int partition_read_table(void)
 		ASSERT(partition_entries);
 	}
 
+	ptn_reading = true;
+
 	/* Read MBR of the card */
 	ret = mmc_boot_read_mbr(block_size);
 	if (ret) {
 		dprintf(CRITICAL, "MMC Boot: MBR read failed!\n");
+		ptn_reading = false;
 		return 1;
 	}
 
@@ -129,6 +214,7 @@ unsigned int partition_read_table(void)
 		ret = mmc_boot_read_gpt(block_size);
 		if (ret) {
 			dprintf(CRITICAL, "MMC Boot: GPT read failed!\n");
+			ptn_reading = false;
 			return 1;
 		}
 	}
@@ -137,6 +223,12 @@ unsigned int partition_read_table(void)
 	/* TODO: Move this to mmc_boot_read_gpt() */
 	partition_scan_for_multislot();
 
+	/* Index the names of the new table from scratch */
+	memset(ptn_index, 0, sizeof(ptn_index));
+	ptn_index_count = 0;
+	ptn_index_update();
+
+	ptn_reading = false;
 	return 0;
 }
 
@@ -942,58 +1034,59 @@ mbr_fill_name(struct partition_entry *partition_ent, unsigned int type)
 	};
 }
 
+static int partition_find_index(const char *name)
+{
+	unsigned int input_string_length = strlen(name);
+	int index, curr_slot;
+	const char *suffix_curr_actv_slot;
+	char name_slot[MAX_GPT_NAME_SIZE];
+
+	/* Partitions added with partition_allocate() are indexed lazily */
+	ptn_index_update();
+
+	index = ptn_index_lookup(name, input_string_length);
+	if (index != INVALID_PTN)
+		return index;
+
+	/* Otherwise look for the partition of the active slot */
+	if (!partition_multislot_is_supported())
+		return INVALID_PTN;
+
+	curr_slot = partition_find_active_slot();
+	if (curr_slot == INVALID)
+	{
+		/* No valid active slot */
+		return INVALID_PTN;
+	}
+
+	suffix_curr_actv_slot = SUFFIX_SLOT(curr_slot);
+	if (input_string_length + strlen(suffix_curr_actv_slot) >= sizeof(name_slot))
+		return INVALID_PTN;
+
+	strlcpy(name_slot, name, sizeof(name_slot));
+	strlcat(name_slot, suffix_curr_actv_slot, sizeof(name_slot));
+	return ptn_index_lookup(name_slot, strlen(name_slot));
+}
+
 /*
  * Find index of parition in array of partition entries
  */
 int partition_get_index(const char *name)
 {
-	unsigned int input_string_length = strlen(name);
-	unsigned n;
-	int curr_slot = INVALID;
-	const char *suffix_curr_actv_slot = NULL;
-	char *curr_suffix = NULL;
+	int index;
 
 	if( partition_count >= NUM_PARTITIONS)
 	{
 		return INVALID_PTN;
 	}
 
-	/*	We iterate through the parition entries list,
-		to find the partition with active slot suffix.
-	*/
-	for (n = 0; n < partition_count; n++)
-	{
-		if (!strncmp((const char*)name, (const char *)partition_entries[n].name,
-					input_string_length))
-		{
-			curr_suffix = (char *)(partition_entries[n].name+input_string_length);
-
-			/* if partition_entries.name is NULL terminated return the index */
-			if (*curr_suffix == '\0')
-				return n;
+	/* Read the tables of the remaining LUNs one by one until it is found */
+	do {
+		index = partition_find_index(name);
+		if (index != INVALID_PTN)
+			return index;
+	} while (!ptn_reading && mmc_read_next_partition_table());
 
-			if (partition_multislot_is_supported())
-			{
-				curr_slot = partition_find_active_slot();
-
-				/* If suffix string matches with current active slot suffix return index */
-				if (curr_slot != INVALID)
-				{
-					suffix_curr_actv_slot = SUFFIX_SLOT(curr_slot);
-					if (!strncmp((const char *)curr_suffix, suffix_curr_actv_slot,
-							strlen(suffix_curr_actv_slot)))
-						return n;
-					else
-						continue;
-				}
-				else
-				{
-					/* No valid active slot */
-					return INVALID_PTN;
-				}
-			}
-		}
-	}
 	return INVALID_PTN;
 }
 
@@ -1007,6 +1100,8 @@ int partition_get_index_in_lun(const char *name, unsigned int lun)
 	int curr_slot = INVALID;
 	const char *suffix_curr_actv_slot = NULL;
 	char *curr_suffix = NULL;
+
+	partition_read_remaining();
 	for (n = 0; n < partition_count; n++)
 	{
 		if (lun == partition_entries[n].lun)
@@ -33,6 +33,8 @@
 #include <debug.h>
 #include <string.h>
 #include <malloc.h>
+#include <stdlib.h>
+#include <arch/defines.h>
 #include <bits.h>
 #include <sys/types.h>
 #include <platform.h>
@@ -1624,29 +1626,80 @@ qpic_nand_read_page_error:
 	return nand_ret;
 }
 
-/* Note: No support for raw reads. */
-static int
-qpic_nand_read_page(uint32_t page, unsigned char* buffer, unsigned char* spareaddr)
+/* Status of a codeword read, written by the BAM */
+struct qpic_nand_cw_status {
+	uint32_t flash;
+	uint32_t buffer;
+	uint32_t erased;
+};
+
+/*
+ * qpic_nand_read() and qpic_nand_write() queue several pages to the BAM at
+ * once so the controller moves on to the next page without waiting for the
+ * CPU. The number of pages per batch is limited by the descriptor FIFOs and
+ * the command elements.
+ */
+#define QPIC_NAND_PIPE_PAGES             8
+#define QPIC_NAND_PIPE_CE                512
+/* Erased CW reset, address/config, ECC config and read location 1 */
+#define QPIC_NAND_READ_PAGE_CE(cws)      (8 + 6 * (cws))
+/* ECC config, address/config, command and read status reset of the last CW */
+#define QPIC_NAND_WRITE_PAGE_CE(cws)     (7 + 3 * (cws))
+
+static struct cmd_element ce_pipe_array[QPIC_NAND_PIPE_CE] __attribute__ ((aligned(16)));
+static struct qpic_nand_cw_status pipe_sts[QPIC_NAND_PIPE_PAGES][QPIC_NAND_MAX_CWS_IN_PAGE]
+	__attribute__ ((aligned(CACHE_LINE)));
+
+/* Like qpic_nand_erased_status_reset(), but queued without waiting. */
+static struct cmd_element*
+qpic_nand_add_erased_status_reset_ce(struct cmd_element *cmd_list_ptr)
+{
+	bam_add_cmd_element(cmd_list_ptr, NAND_ERASED_CW_DETECT_CFG,
+						NAND_ERASED_CW_DETECT_CFG_RESET_CTRL, CE_WRITE_TYPE);
+	bam_add_one_desc(&bam,
+					 CMD_PIPE_INDEX,
+					 (unsigned char*)PA((addr_t)cmd_list_ptr),
+					 BAM_CE_SIZE,
+					 BAM_DESC_CMD_FLAG | BAM_DESC_LOCK_FLAG);
+	cmd_list_ptr++;
+
+	bam_add_cmd_element(cmd_list_ptr, NAND_ERASED_CW_DETECT_CFG,
+						NAND_ERASED_CW_DETECT_CFG_ACTIVATE_CTRL | NAND_ERASED_CW_DETECT_ERASED_CW_ECC_MASK,
+						CE_WRITE_TYPE);
+	bam_add_one_desc(&bam,
+					 CMD_PIPE_INDEX,
+					 (unsigned char*)PA((addr_t)cmd_list_ptr),
+					 BAM_CE_SIZE,
+					 BAM_DESC_CMD_FLAG);
+	cmd_list_ptr++;
+
+	bam_sys_gen_event(&bam, CMD_PIPE_INDEX, 2);
+
+	return cmd_list_ptr;
+}
+
+/*
+ * Queue the command and data descriptors for all the codewords in a page.
+ * int_flag is set on the last data and command descriptor of the page.
+ * The BAM must be locked, it is unlocked after the last codeword.
+ */
+static struct cmd_element*
+qpic_nand_add_read_page_ce(uint32_t page, unsigned char* buffer,
+						   unsigned char* spareaddr,
+						   struct cmd_element *cmd_list_ptr,
+						   struct qpic_nand_cw_status *sts,
+						   uint8_t int_flag)
 {
 	struct cfg_params params;
 	uint32_t ecc;
-	uint32_t flash_sts[QPIC_NAND_MAX_CWS_IN_PAGE] = {0};
-	uint32_t buffer_sts[QPIC_NAND_MAX_CWS_IN_PAGE] = {0};
-	uint32_t erased_cw_sts[QPIC_NAND_MAX_CWS_IN_PAGE] = {0};
 	uint32_t addr_loc_0;
 	uint32_t addr_loc_1;
-	struct cmd_element *cmd_list_ptr = ce_array;
-	struct cmd_element *cmd_list_ptr_start = ce_array;
+	struct cmd_element *cmd_list_ptr_start = cmd_list_ptr;
 	uint32_t num_cmd_desc = 0;
 	uint32_t num_data_desc = 0;
-	uint32_t status;
 	uint32_t i;
-	int nand_ret = NANDC_RESULT_SUCCESS;
 	uint8_t flags = 0;
 	uint32_t *cmd_list_temp = NULL;
-#if DEBUG_QPIC_NAND
-    uint8_t *buffer_temp = buffer;
-#endif
 
 	/* UD bytes in last CW is 512 - cws_per_page *4.
 	 * Since each of the CW read earlier reads 4 spare bytes.
@@ -1672,13 +1725,9 @@ qpic_nand_read_page(uint32_t page, unsigned char* buffer, unsigned char* sparead
 	addr_loc_1 |= NAND_RD_LOC_SIZE(oob_bytes);
 	addr_loc_1 |= NAND_RD_LOC_LAST_BIT(1);
 
-	status = qpic_nand_block_isbad(page);
-
-	if (status)
-		return status;
-
-	/* Reset and Configure erased CW/page detection controller */
-	qpic_nand_erased_status_reset(ce_array, BAM_DESC_LOCK_FLAG);
+	/* The BAM writes the status, do not let stale lines overwrite it */
+	memset(sts, 0, flash.cws_per_page * sizeof(*sts));
+	arch_clean_invalidate_cache_range((addr_t)sts, flash.cws_per_page * sizeof(*sts));
 
 	/* Queue up the command and data descriptors for all the codewords in a page
 	 * and do a single bam transfer at the end.*/
@@ -1722,7 +1771,7 @@ qpic_nand_read_page(uint32_t page, unsigned char* buffer, unsigned char* sparead
 							 DATA_PRODUCER_PIPE_INDEX,
 							 (unsigned char *)PA((addr_t)spareaddr),
 							 oob_bytes,
-							 BAM_DESC_INT_FLAG);
+							 int_flag);
 			num_data_desc++;
 
 			bam_sys_gen_event(&bam, DATA_PRODUCER_PIPE_INDEX, num_data_desc);
@@ -1760,22 +1809,22 @@ qpic_nand_read_page(uint32_t page, unsigned char* buffer, unsigned char* sparead
 					 BAM_DESC_NWD_FLAG | BAM_DESC_CMD_FLAG);
 		num_cmd_desc++;
 
-		bam_add_cmd_element(cmd_list_ptr, NAND_FLASH_STATUS, (uint32_t)PA((addr_t)&(flash_sts[i])), CE_READ_TYPE);
+		bam_add_cmd_element(cmd_list_ptr, NAND_FLASH_STATUS, (uint32_t)PA((addr_t)&(sts[i].flash)), CE_READ_TYPE);
 
 		cmd_list_temp = (uint32_t *)cmd_list_ptr;
 
 		cmd_list_ptr++;
 
-		bam_add_cmd_element(cmd_list_ptr, NAND_BUFFER_STATUS, (uint32_t)PA((addr_t)&(buffer_sts[i])), CE_READ_TYPE);
+		bam_add_cmd_element(cmd_list_ptr, NAND_BUFFER_STATUS, (uint32_t)PA((addr_t)&(sts[i].buffer)), CE_READ_TYPE);
 		cmd_list_ptr++;
 
 		/* Read erased CW status */
-		bam_add_cmd_element(cmd_list_ptr, NAND_ERASED_CW_DETECT_STATUS, (uint32_t)PA((addr_t)&erased_cw_sts[i]), CE_READ_TYPE);
+		bam_add_cmd_element(cmd_list_ptr, NAND_ERASED_CW_DETECT_STATUS, (uint32_t)PA((addr_t)&(sts[i].erased)), CE_READ_TYPE);
 		cmd_list_ptr++;
 
 		if (i == flash.cws_per_page - 1)
 		{
-			flags = BAM_DESC_CMD_FLAG | BAM_DESC_UNLOCK_FLAG;
+			flags = BAM_DESC_CMD_FLAG | BAM_DESC_UNLOCK_FLAG | int_flag;
 		}
 		else
 			flags = BAM_DESC_CMD_FLAG;
@@ -1794,26 +1843,45 @@ qpic_nand_read_page(uint32_t page, unsigned char* buffer, unsigned char* sparead
 		bam_sys_gen_event(&bam, CMD_PIPE_INDEX, num_cmd_desc);
 	}
 
-	qpic_nand_wait_for_data(DATA_PRODUCER_PIPE_INDEX);
+	return cmd_list_ptr;
+}
+
+/* Wait until the descriptors queued with BAM_DESC_INT_FLAG are processed */
+static void
+qpic_nand_wait_for_batch(uint32_t data_pipe)
+{
+	qpic_nand_wait_for_data(data_pipe);
+
+	/* The status is read after the data, make sure it has arrived */
+	bam_wait_for_interrupt(&bam, CMD_PIPE_INDEX, P_PRCSD_DESC_EN_MASK);
+	bam_read_offset_update(&bam, CMD_PIPE_INDEX);
+}
+
+/* Check flash read status & errors of all codewords in a page */
+static int
+qpic_nand_check_read_page(uint32_t page, struct qpic_nand_cw_status *sts)
+{
+	uint32_t i;
+
+	arch_invalidate_cache_range((addr_t)sts, flash.cws_per_page * sizeof(*sts));
 
-	/* Check flash read status & errors */
 	for (i = 0; i < flash.cws_per_page ; i ++)
 	{
 #if DEBUG_QPIC_NAND
 		dprintf(INFO, "FLASH STATUS: 0x%08x, BUFFER STATUS: 0x%08x, ERASED CW STATUS: 0x%08x\n",
-				flash_sts[i], buffer_sts[i], erased_cw_sts[i]);
+				sts[i].flash, sts[i].buffer, sts[i].erased);
 #endif
 
 		/* If MPU or flash op erros are set, look for erased cw status.
 		 * If erased CW status is not set then look for bit flips to confirm
 		 * if the page is and erased page or a bad page
 		 */
-		if (flash_sts[i] & (NAND_FLASH_OP_ERR | NAND_FLASH_MPU_ERR))
+		if (sts[i].flash & (NAND_FLASH_OP_ERR | NAND_FLASH_MPU_ERR))
 		{
-			if ((erased_cw_sts[i] & NAND_ERASED_CW) != NAND_ERASED_CW)
+			if ((sts[i].erased & NAND_ERASED_CW) != NAND_ERASED_CW)
 			{
 #if DEBUG_QPIC_NAND
-			dprintf(CRITICAL, "Page: 0x%08x, addr0: 0x%08x, addr1: 0x%08x\n", page, params.addr0, params.addr1);
+			dprintf(CRITICAL, "Page: 0x%08x\n", page);
 #endif
 			/*
 			 * Depending on the process technology used there could be bit flips on
@@ -1827,26 +1895,49 @@ qpic_nand_read_page(uint32_t page, unsigned char* buffer, unsigned char* sparead
 			 * bit flips then we should ignore the uncorrectable ECC error and consider
 			 * the page as an erased page.
 			 */
-#if DEBUG_QPIC_NAND
-				for(i = 0; i < 4096; i += 8)
-				{
-					printf("DATA: %x %x %x %x %x %x %x %x",
-									buffer_temp[i], buffer_temp[i+1], buffer_temp[i+2], buffer_temp[i+3],
-									buffer_temp[i+4], buffer_temp[i+5], buffer_temp[i+6], buffer_temp[i+7]);
-					i += 8;
-					printf("DATA: %x %x %x %x %x %x %x %x\n",
-									buffer_temp[i], buffer_temp[i+1], buffer_temp[i+2], buffer_temp[i+3],
-									buffer_temp[i+4], buffer_temp[i+5], buffer_temp[i+6], buffer_temp[i+7]);
-				}
-#endif
-				nand_ret = qpic_nand_read_erased_page(page);
-				goto qpic_nand_read_page_error;
-				}
+				return qpic_nand_read_erased_page(page);
+			}
 		}
 	}
 
-qpic_nand_read_page_error:
-	return nand_ret;
+	return NANDC_RESULT_SUCCESS;
+}
+
+/* Note: No support for raw reads. */
+static int
+qpic_nand_read_page(uint32_t page, unsigned char* buffer, unsigned char* spareaddr)
+{
+	struct qpic_nand_cw_status *sts = pipe_sts[0];
+	uint32_t status;
+
+	status = qpic_nand_block_isbad(page);
+
+	if (status)
+		return status;
+
+	/* Reset and Configure erased CW/page detection controller */
+	qpic_nand_erased_status_reset(ce_array, BAM_DESC_LOCK_FLAG);
+
+	qpic_nand_add_read_page_ce(page, buffer, spareaddr, ce_array, sts,
+							   BAM_DESC_INT_FLAG);
+	qpic_nand_wait_for_batch(DATA_PRODUCER_PIPE_INDEX);
+
+	return qpic_nand_check_read_page(page, sts);
+}
+
+/* Number of pages qpic_nand_read() queues to the BAM at once */
+static uint32_t
+qpic_nand_read_pipe_pages(void)
+{
+	uint32_t cws = flash.cws_per_page;
+	uint32_t pages = QPIC_NAND_PIPE_PAGES;
+
+	/* One descriptor of each FIFO stays unused to tell full from empty */
+	pages = MIN(pages, (QPIC_BAM_CMD_FIFO_SIZE - 1) / (2 + 2 * cws));
+	pages = MIN(pages, (QPIC_BAM_DATA_FIFO_SIZE - 1) / (cws + 1));
+	pages = MIN(pages, QPIC_NAND_PIPE_CE / QPIC_NAND_READ_PAGE_CE(cws));
+
+	return MAX(pages, 1U);
 }
 
 /**
@@ -1861,21 +1952,53 @@ qpic_nand_read_page_error:
  * read data in buffer. Note that it's in the caller responsibility to make
  * sure the read pages are all from same partition.
  *
+ * The descriptors of several pages are queued at once and the status of
+ * the codewords is checked after the whole batch was transferred.
+ *
  * Returns nand_result_t
  */
 nand_result_t qpic_nand_read(uint32_t start_page, uint32_t num_pages,
 		unsigned char* buffer, unsigned char* spareaddr)
 {
-	unsigned i = 0, ret = 0;
+	uint32_t pipe_pages = qpic_nand_read_pipe_pages();
+	struct cmd_element *cmd_list_ptr;
+	unsigned i = 0, n, batch, bad, ret = 0;
 
 	if (!buffer) {
 		dprintf(CRITICAL, "qpic_nand_read: buffer = null\n");
 		return NANDC_RESULT_PARAM_INVALID;
 	}
 	while (i < num_pages) {
-		ret = qpic_nand_read_page(start_page + i, buffer + flash.page_size * i,
-				spareaddr);
-		i++;
+		batch = MIN(num_pages - i, pipe_pages);
+
+		/* Bad blocks may need to be read, do it before queuing anything */
+		for (n = 0, bad = 0; n < batch; n++) {
+			bad = qpic_nand_block_isbad(start_page + i + n);
+			if (bad)
+				break;
+		}
+		batch = n;
+
+		cmd_list_ptr = ce_pipe_array;
+		for (n = 0; n < batch; n++) {
+			cmd_list_ptr = qpic_nand_add_erased_status_reset_ce(cmd_list_ptr);
+			cmd_list_ptr = qpic_nand_add_read_page_ce(start_page + i + n,
+					buffer + flash.page_size * (i + n), spareaddr,
+					cmd_list_ptr, pipe_sts[n],
+					n == batch - 1 ? BAM_DESC_INT_FLAG : 0);
+		}
+		if (batch)
+			qpic_nand_wait_for_batch(DATA_PRODUCER_PIPE_INDEX);
+
+		for (n = 0; n < batch; n++) {
+			ret = qpic_nand_check_read_page(start_page + i + n, pipe_sts[n]);
+			if (ret)
+				break;
+		}
+		i += n;
+		if (!ret)
+			ret = bad;
+
 		if (ret == NANDC_RESULT_BAD_PAGE)
 			qpic_nand_mark_badblock(start_page + i);
 		if (ret) {
@@ -1888,6 +2011,197 @@ nand_result_t qpic_nand_read(uint32_t start_page, uint32_t num_pages,
 	return NANDC_RESULT_SUCCESS;
 }
 
+/*
+ * Queue the data and command descriptors to program a page with ECC. The
+ * status of every codeword is read into sts[].flash. int_flag is set on the
+ * last data and command descriptor of the page.
+ */
+static struct cmd_element*
+qpic_nand_add_write_page_ce(uint32_t page, const unsigned char *buffer,
+							const unsigned char *spareaddr,
+							struct cmd_element *cmd_list_ptr,
+							struct qpic_nand_cw_status *sts,
+							uint8_t int_flag)
+{
+	struct cfg_params cfg;
+	struct cmd_element *cmd_list_ptr_start = cmd_list_ptr;
+	uint32_t num_cmd_desc = 0;
+	uint32_t num_data_desc = 0;
+	uint32_t last = flash.cws_per_page - 1;
+	uint32_t i;
+
+	cfg.addr0 = page << 16;
+	cfg.addr1 = (page >> 16) & 0xff;
+	cfg.cfg0 = cfg0;
+	cfg.cfg1 = cfg1;
+	cfg.cmd = NAND_CMD_PRG_PAGE;
+	cfg.exec = 1;
+
+	/* The BAM writes the status, do not let stale lines overwrite it */
+	memset(sts, 0, flash.cws_per_page * sizeof(*sts));
+	arch_clean_invalidate_cache_range((addr_t)sts, flash.cws_per_page * sizeof(*sts));
+
+	/* Same layout as qpic_add_wr_page_cws_data_desc() */
+	for (i = 0; i < last; i++)
+	{
+		bam_add_one_desc(&bam,
+						 DATA_CONSUMER_PIPE_INDEX,
+						 (unsigned char*)PA((addr_t)buffer + i * DATA_BYTES_IN_IMG_PER_CW),
+						 DATA_BYTES_IN_IMG_PER_CW,
+						 BAM_DESC_EOT_FLAG);
+		num_data_desc++;
+	}
+
+	/* Allow space for spare bytes in the last CW */
+	bam_add_one_desc(&bam,
+					 DATA_CONSUMER_PIPE_INDEX,
+					 (unsigned char*)PA((addr_t)buffer + last * DATA_BYTES_IN_IMG_PER_CW),
+					 USER_DATA_BYTES_PER_CW - (last << 2),
+					 0);
+	num_data_desc++;
+
+	bam_add_one_desc(&bam,
+					 DATA_CONSUMER_PIPE_INDEX,
+					 (unsigned char*)PA((addr_t)spareaddr),
+					 flash.cws_per_page << 2,
+					 BAM_DESC_EOT_FLAG | int_flag);
+	num_data_desc++;
+
+	bam_sys_gen_event(&bam, DATA_CONSUMER_PIPE_INDEX, num_data_desc);
+
+	bam_add_cmd_element(cmd_list_ptr, NAND_DEV0_ECC_CFG,
+						(uint32_t)ecc_bch_cfg, CE_WRITE_TYPE);
+	cmd_list_ptr++;
+	cmd_list_ptr = qpic_nand_add_addr_n_cfg_ce(&cfg, cmd_list_ptr);
+
+	bam_add_cmd_element(cmd_list_ptr, NAND_FLASH_CMD,
+						(uint32_t)cfg.cmd, CE_WRITE_TYPE);
+	cmd_list_ptr++;
+
+	bam_add_one_desc(&bam,
+					 CMD_PIPE_INDEX,
+					 (unsigned char*)PA((addr_t)cmd_list_ptr_start),
+					 PA((uint32_t)cmd_list_ptr - (uint32_t)cmd_list_ptr_start),
+					 BAM_DESC_CMD_FLAG | BAM_DESC_LOCK_FLAG);
+	num_cmd_desc++;
+
+	for (i = 0; i < flash.cws_per_page; i++)
+	{
+		cmd_list_ptr_start = cmd_list_ptr;
+		bam_add_cmd_element(cmd_list_ptr, NAND_EXEC_CMD, (uint32_t)cfg.exec, CE_WRITE_TYPE);
+		cmd_list_ptr++;
+
+		bam_add_one_desc(&bam,
+						 CMD_PIPE_INDEX,
+						 (unsigned char*)PA((addr_t)cmd_list_ptr_start),
+						 PA((uint32_t)cmd_list_ptr - (uint32_t)cmd_list_ptr_start),
+						 BAM_DESC_NWD_FLAG | BAM_DESC_CMD_FLAG);
+
+		cmd_list_ptr_start = cmd_list_ptr;
+		cmd_list_ptr = qpic_nand_add_read_ce(cmd_list_ptr, &sts[i].flash);
+
+		bam_add_one_desc(&bam,
+						 CMD_PIPE_INDEX,
+						 (unsigned char*)PA((addr_t)cmd_list_ptr_start),
+						 PA((uint32_t)cmd_list_ptr - (uint32_t)cmd_list_ptr_start),
+						 BAM_DESC_CMD_FLAG);
+
+		/* Reset NAND_READ_STATUS only after the last CW */
+		cmd_list_ptr_start = cmd_list_ptr;
+		cmd_list_ptr = qpic_nand_reset_status_ce(cmd_list_ptr, i == last);
+
+		bam_add_one_desc(&bam,
+						 CMD_PIPE_INDEX,
+						 (unsigned char*)PA((addr_t)cmd_list_ptr_start),
+						 PA((uint32_t)cmd_list_ptr - (uint32_t)cmd_list_ptr_start),
+						 BAM_DESC_CMD_FLAG | (i == last ? int_flag : 0));
+		num_cmd_desc += 3;
+	}
+
+	bam_sys_gen_event(&bam, CMD_PIPE_INDEX, num_cmd_desc);
+
+	return cmd_list_ptr;
+}
+
+/* Number of pages qpic_nand_write_pages() queues to the BAM at once */
+static uint32_t
+qpic_nand_write_pipe_pages(void)
+{
+	uint32_t cws = flash.cws_per_page;
+	uint32_t pages = QPIC_NAND_PIPE_PAGES;
+
+	/* One descriptor of each FIFO stays unused to tell full from empty */
+	pages = MIN(pages, (QPIC_BAM_CMD_FIFO_SIZE - 1) / (1 + 3 * cws));
+	pages = MIN(pages, (QPIC_BAM_DATA_FIFO_SIZE - 1) / (cws + 1));
+	pages = MIN(pages, QPIC_NAND_PIPE_CE / QPIC_NAND_WRITE_PAGE_CE(cws));
+
+	return MAX(pages, 1U);
+}
+
+/*
+ * Program @num_pages pages with ECC starting at @start_page. Like
+ * qpic_nand_read(), the pages are queued in batches and the status of the
+ * codewords is checked after each batch. The data is sent straight from
+ * @buffer, where each page is followed by its spare bytes if
+ * @write_extra_bytes is set. @written is set to the number of pages
+ * written before a failure.
+ */
+static nand_result_t
+qpic_nand_write_pages(uint32_t start_page, uint32_t num_pages,
+					  const unsigned char *buffer,
+					  unsigned write_extra_bytes,
+					  uint32_t *written)
+{
+	uint32_t pipe_pages = qpic_nand_write_pipe_pages();
+	uint32_t spare_byte_count = (flash.cw_size * flash.cws_per_page) - flash.page_size;
+	const unsigned char *spare = flash_spare_bytes;
+	const unsigned char *page_buf;
+	struct cmd_element *cmd_list_ptr;
+	uint32_t wsize = flash.page_size;
+	uint32_t i = 0, n, cw, batch;
+	nand_result_t ret;
+
+	if (write_extra_bytes)
+		wsize += spare_byte_count;
+	else
+		memset(flash_spare_bytes, 0xff, (spare_byte_count / flash.cws_per_page));
+
+	while (i < num_pages) {
+		batch = MIN(num_pages - i, pipe_pages);
+
+		cmd_list_ptr = ce_pipe_array;
+		for (n = 0; n < batch; n++) {
+			page_buf = buffer + (i + n) * wsize;
+			if (write_extra_bytes)
+				spare = page_buf + flash.page_size;
+			cmd_list_ptr = qpic_nand_add_write_page_ce(start_page + i + n,
+					page_buf, spare, cmd_list_ptr, pipe_sts[n],
+					n == batch - 1 ? BAM_DESC_INT_FLAG : 0);
+		}
+		qpic_nand_wait_for_batch(DATA_CONSUMER_PIPE_INDEX);
+
+		for (n = 0; n < batch; n++) {
+			arch_invalidate_cache_range((addr_t)pipe_sts[n],
+					flash.cws_per_page * sizeof(pipe_sts[n][0]));
+
+			for (cw = 0; cw < flash.cws_per_page; cw++) {
+				ret = qpic_nand_check_status(pipe_sts[n][cw].flash);
+				if (ret) {
+					dprintf(CRITICAL,
+							"Failed to write CW %d for page: %d\n",
+							cw, start_page + i + n);
+					*written = i + n;
+					return ret;
+				}
+			}
+		}
+		i += batch;
+	}
+
+	*written = num_pages;
+	return NANDC_RESULT_SUCCESS;
+}
+
 /**
  * qpic_nand_write() - read data
  * @start_page: number of page to begin writing to
@@ -1904,47 +2218,24 @@ nand_result_t qpic_nand_read(uint32_t start_page, uint32_t num_pages,
 nand_result_t qpic_nand_write(uint32_t start_page, uint32_t num_pages,
 		unsigned char* buffer, unsigned  write_extra_bytes)
 {
-	int i = 0, ret = NANDC_RESULT_SUCCESS;
-	uint32_t *spare = (unsigned *)flash_spare_bytes;
-	uint32_t wsize;
-	uint32_t spare_byte_count = 0;
+	nand_result_t ret;
+	uint32_t written;
 
 	if (!buffer) {
 		dprintf(CRITICAL, "qpic_nand_write: buffer = null\n");
 		return NANDC_RESULT_PARAM_INVALID;
 	}
-	spare_byte_count = ((flash.cw_size * flash.cws_per_page)- flash.page_size);
 
-	if (write_extra_bytes)
-		wsize = flash.page_size + spare_byte_count;
-	else
-		wsize = flash.page_size;
-
-	memset(spare, 0xff, (spare_byte_count / flash.cws_per_page));
-
-	for (i = 0; i < (int)num_pages; i++) {
-		memcpy(rdwr_buf, buffer, flash.page_size);
-		if (write_extra_bytes) {
-			memcpy(rdwr_buf + flash.page_size,
-					buffer + flash.page_size, spare_byte_count);
-			ret = qpic_nand_write_page(start_page + i,
-					NAND_CFG, rdwr_buf, rdwr_buf + flash.page_size);
-		} else {
-			ret = qpic_nand_write_page(start_page + i,
-					NAND_CFG, rdwr_buf, spare);
-		}
-		if (ret) {
-			dprintf(CRITICAL,
-					"flash_write: write failure @ page %d, block %d\n",
-					start_page + i,
-					(start_page + i) / flash.num_pages_per_blk);
-			if (ret == NANDC_RESULT_BAD_PAGE)
-				qpic_nand_mark_badblock(start_page + i);
-			goto out;
-		}
-		buffer += wsize;
+	ret = qpic_nand_write_pages(start_page, num_pages, buffer,
+			write_extra_bytes, &written);
+	if (ret) {
+		dprintf(CRITICAL,
+				"flash_write: write failure @ page %d, block %d\n",
+				start_page + written,
+				(start_page + written) / flash.num_pages_per_blk);
+		if (ret == NANDC_RESULT_BAD_PAGE)
+			qpic_nand_mark_badblock(start_page + written);
 	}
-out:
 	return ret;
 }
 
@@ -2089,10 +2380,10 @@ flash_write(struct ptentry *ptn,
 {
 	uint32_t page = ptn->start * flash.num_pages_per_blk;
 	uint32_t lastpage = (ptn->start + ptn->length) * flash.num_pages_per_blk;
-	uint32_t *spare = (unsigned *)flash_spare_bytes;
 	const unsigned char *image = data;
 	uint32_t wsize;
 	uint32_t spare_byte_count = 0;
+	uint32_t count, written;
 	int r;
 
 	spare_byte_count = ((flash.cw_size * flash.cws_per_page)- flash.page_size);
@@ -2102,8 +2393,6 @@ flash_write(struct ptentry *ptn,
 	else
 		wsize = flash.page_size;
 
-	memset(spare, 0xff, (spare_byte_count / flash.cws_per_page));
-
 	while (bytes > 0)
 	{
 		if (bytes < wsize)
@@ -2134,20 +2423,14 @@ flash_write(struct ptentry *ptn,
 			}
 		}
 
-		memcpy(rdwr_buf, image, flash.page_size);
+		/* Write the rest of the block, or of the image, in one go */
+		count = MIN(bytes / wsize,
+					flash.num_pages_per_blk - (page & flash.num_pages_per_blk_mask));
+		r = qpic_nand_write_pages(page, count, image, write_extra_bytes, &written);
 
-		if (write_extra_bytes)
-		{
-			memcpy(rdwr_buf + flash.page_size, image + flash.page_size, spare_byte_count);
-			r = qpic_nand_write_page(page,
-									 NAND_CFG,
-									 rdwr_buf,
-									 rdwr_buf + flash.page_size);
-		}
-		else
-		{
-			r = qpic_nand_write_page(page, NAND_CFG, rdwr_buf, spare);
-		}
+		page += written;
+		image += written * wsize;
+		bytes -= written * wsize;
 
 		if (r)
 		{
@@ -2175,9 +2458,6 @@ flash_write(struct ptentry *ptn,
 			page += flash.num_pages_per_blk;
 			continue;
 		}
-		page++;
-		image += wsize;
-		bytes -= wsize;
 	}
 
 	/* erase any remaining pages in the partition */
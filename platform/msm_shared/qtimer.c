@@ -34,6 +34,13 @@
 
 static uint32_t ticks_per_sec;
 
+#if PLATFORM_HAS_DYNAMIC_TIMER
+static uint32_t ticks_per_msec;
+static uint64_t start_cnt;
+static platform_timer_callback oneshot_callback;
+static void *oneshot_arg;
+#endif
+
 status_t platform_set_periodic_timer(platform_timer_callback callback,
 	void *arg, time_t interval)
 {
@@ -46,10 +53,64 @@ status_t platform_set_periodic_timer(platform_timer_callback callback,
 	return 0;
 }
 
+#if PLATFORM_HAS_DYNAMIC_TIMER
+/*
+ * Without a periodic tick the time is derived from the global counter
+ * directly, so it stays exact no matter how long the CPU was idle.
+ */
+static uint64_t qtimer_msecs(uint64_t cnt)
+{
+	return (cnt - start_cnt) / ticks_per_msec;
+}
+
+time_t current_time(void)
+{
+	if (!ticks_per_msec)
+		return 0;
+
+	return qtimer_msecs(qtimer_get_phy_timer_cnt());
+}
+
+static enum handler_return qtimer_oneshot_irq(void *arg)
+{
+	/* The interrupt stays asserted until the timer is programmed again */
+	qtimer_disable();
+
+	return oneshot_callback(oneshot_arg, current_time());
+}
+
+status_t platform_set_oneshot_timer(platform_timer_callback callback,
+	void *arg, time_t interval)
+{
+	uint64_t deadline;
+
+	enter_critical_section();
+
+	oneshot_callback = callback;
+	oneshot_arg = arg;
+
+	/*
+	 * Expire on a millisecond boundary, so that current_time() has
+	 * reached the requested time in the interrupt.
+	 */
+	deadline = qtimer_msecs(qtimer_get_phy_timer_cnt()) + interval;
+	qtimer_set_physical_deadline(start_cnt + deadline * ticks_per_msec,
+				     qtimer_oneshot_irq, NULL);
+
+	exit_critical_section();
+	return 0;
+}
+
+void platform_stop_timer(void)
+{
+	qtimer_disable();
+}
+#else
 time_t current_time(void)
 {
 	return qtimer_current_time();
 }
+#endif
 
 void qtimer_uninit(void)
 {
@@ -93,8 +154,13 @@ void mdelay(unsigned msecs)
 {
 	uint64_t ticks;
 
-	ticks = ((uint64_t) msecs * ticks_per_sec) / 1000;
+	if (!in_critical_section()) {
+		/* Let other threads (e.g. asynchronous init stages) run meanwhile */
+		thread_usleep(msecs * 1000);
+		return;
+	}
 
+	ticks = ((uint64_t) msecs * ticks_per_sec) / 1000;
 	delay(ticks);
 }
 
@@ -107,15 +173,25 @@ void udelay(unsigned usecs)
 	delay(ticks);
 }
 
-/* Return current time in micro seconds */
+/* Return current time in micro seconds since the global counter started */
 bigtime_t current_time_hires(void)
 {
-	return qtimer_current_time() * 1000000ULL;
+	uint64_t cnt = qtimer_get_phy_timer_cnt();
+
+	if (!ticks_per_sec)
+		return 0;
+
+	return (cnt / ticks_per_sec) * 1000000ULL +
+	       (cnt % ticks_per_sec) * 1000000ULL / ticks_per_sec;
 }
 
 void qtimer_init(void)
 {
 	ticks_per_sec = qtimer_get_frequency();
+#if PLATFORM_HAS_DYNAMIC_TIMER
+	start_cnt = qtimer_get_phy_timer_cnt();
+	ticks_per_msec = ticks_per_sec / 1000;
+#endif
 }
 
 uint32_t qtimer_tick_rate(void)
@@ -85,6 +85,25 @@ void qtimer_set_physical_timer(time_t msecs_interval,
 	qtimer_enable();
 }
 
+#if PLATFORM_HAS_DYNAMIC_TIMER
+/* Programs the Physical Secure timer to expire once at an absolute count.
+ * cval : Value of the global counter when the interrupt is fired.
+ */
+void qtimer_set_physical_deadline(uint64_t cval, int_handler handler, void *arg)
+{
+	qtimer_disable();
+
+	writel(cval, QTMR_V1_CNTP_CVAL_LO);
+	writel(cval >> 32, QTMR_V1_CNTP_CVAL_HI);
+	dsb();
+
+	register_int_handler(INT_QTMR_FRM_0_PHYSICAL_TIMER_EXP, handler, arg);
+
+	unmask_interrupt(INT_QTMR_FRM_0_PHYSICAL_TIMER_EXP);
+
+	qtimer_enable();
+}
+#endif
 
 /* Function to return the frequency of the timer */
 uint32_t qtimer_get_frequency(void)
@@ -27,6 +27,7 @@
 */
 
 #include <debug.h>
+#include <dev/uart.h>
 #include <platform/iomap.h>
 #include <reg.h>
 #include <target.h>
@@ -38,6 +39,9 @@
 #include <reboot.h>
 #include <qtimer.h>
 #include <smem.h>
+#if MMC_SDHCI_SUPPORT
+#include <mmc.h>
+#endif
 
 #if USER_FORCE_RESET_SUPPORT
 /* Return 1 if it is a force resin triggered by user. */
@@ -118,6 +122,12 @@ void reboot_device(unsigned reboot_reason)
 	uint8_t value;
 #endif
 
+#if MMC_SDHCI_SUPPORT
+	/* Writes still in the eMMC cache would be lost with the reset */
+	if (mmc_flush_write_cache())
+		dprintf(CRITICAL, "Failed to flush the eMMC write cache\n");
+#endif
+
 	/* Set cookie for dload mode */
 	if(set_download_mode(reboot_reason)) {
 		dprintf(CRITICAL, "HALT: set_download_mode not supported\n");
@@ -163,6 +173,9 @@ void reboot_device(unsigned reboot_reason)
 			dprintf(CRITICAL , "Failed to halt pmic arbiter: %d\n", ret);
 	}
 
+#if WITH_DEBUG_UART
+	uart_flush_tx(0);
+#endif
 	/* Drop PS_HOLD for MSM */
 	writel(0x00, MPM2_MPM_PS_HOLD);
 
@@ -178,6 +191,9 @@ void shutdown_device(void)
 	/* Configure PMIC for shutdown. */
 	pmic_reset_configure(PON_PSHOLD_SHUTDOWN);
 
+#if WITH_DEBUG_UART
+	uart_flush_tx(0);
+#endif
 	/* Drop PS_HOLD for MSM */
 	writel(0x00, MPM2_MPM_PS_HOLD);
 
@@ -30,6 +30,8 @@
 #include <arch/defines.h>
 #include <stdint.h>
 #include <sys/types.h>
+#include <debug.h>
+#include <kernel/thread.h>
 #include <platform.h>
 #include <rpm-ipc.h>
 #include <rpm-glink.h>
@@ -46,6 +48,16 @@ __WEAK int rpm_smd_send_data(uint32_t *data, uint32_t len, msg_type type)
 	return -1;
 }
 
+__WEAK int rpm_smd_send_data_noack(uint32_t *data, uint32_t len, msg_type type)
+{
+	return -1;
+}
+
+__WEAK int rpm_smd_wait_acks(void)
+{
+	return 0;
+}
+
 void fill_kvp_object(kvp_data **kdata, uint32_t *data, uint32_t len)
 {
 	*kdata = (kvp_data *) memalign(CACHE_LINE, ROUNDUP(len, CACHE_LINE));
@@ -73,6 +85,27 @@ int rpm_send_data(uint32_t *data, uint32_t len, msg_type type)
 	return ret;
 }
 
+/*
+ * Like rpm_send_data(), but do not wait for the ack. Used to queue several
+ * votes and collect their acks with rpm_wait_acks(). glink requests are
+ * still sent one by one.
+ */
+int rpm_send_data_noack(uint32_t *data, uint32_t len, msg_type type)
+{
+	if (platform_is_glink_enabled())
+		return rpm_glink_send_data(data, len, type);
+
+	return rpm_smd_send_data_noack(data, len, type);
+}
+
+int rpm_wait_acks(void)
+{
+	if (platform_is_glink_enabled())
+		return 0;
+
+	return rpm_smd_wait_acks();
+}
+
 void rpm_clk_enable(uint32_t *data, uint32_t len)
 {
 	if(rpm_send_data(data, len, RPM_REQUEST_TYPE))
@@ -81,3 +114,83 @@ void rpm_clk_enable(uint32_t *data, uint32_t len)
 		ASSERT(0);
 	}
 }
+
+/*
+ * Bandwidth votes for large DMA transfers (eMMC, USB). The bus and memory
+ * clocks are left at whatever the other RPM masters need while lk runs,
+ * which is usually the minimum. The resource IDs and useful rates differ
+ * between SoCs, so only platforms that provide platform_rpm_bw_votes()
+ * vote at all.
+ */
+#define RPM_KEY_RATE		0x007a484b //KHz
+
+__WEAK const struct rpm_bw_vote *platform_rpm_bw_votes(unsigned *count)
+{
+	*count = 0;
+	return NULL;
+}
+
+static unsigned rpm_bw_count;
+static bool rpm_bw_unsupported;
+
+static void rpm_bw_send(bool high)
+{
+	const struct rpm_bw_vote *votes;
+	unsigned i, count;
+	uint32_t data[5];
+	int ret = 0;
+
+	if (rpm_bw_unsupported)
+		return;
+
+	votes = platform_rpm_bw_votes(&count);
+	if (!count) {
+		rpm_bw_unsupported = true;
+		return;
+	}
+
+	for (i = 0; i < count; i++) {
+		data[RESOURCETYPE] = votes[i].type;
+		data[RESOURCEID] = votes[i].id;
+		data[KVP_KEY] = RPM_KEY_RATE;
+		data[KVP_LENGTH] = 4;
+		data[KVP_VALUE] = high ? votes[i].rate : 0;
+		ret |= rpm_send_data_noack(data, 12, RPM_REQUEST_TYPE);
+	}
+	ret |= rpm_wait_acks();
+
+	/* No RPM channel on this platform, don't try again */
+	if (ret) {
+		dprintf(INFO, "RPM bandwidth vote failed, disabling\n");
+		rpm_bw_unsupported = true;
+	}
+}
+
+/*
+ * Request high bus and DDR bandwidth until the matching rpm_bw_release().
+ * Requests nest and must all be released before the kernel is started.
+ */
+void rpm_bw_request(void)
+{
+	bool first;
+
+	enter_critical_section();
+	first = !rpm_bw_count++;
+	exit_critical_section();
+
+	if (first)
+		rpm_bw_send(true);
+}
+
+void rpm_bw_release(void)
+{
+	bool last;
+
+	enter_critical_section();
+	ASSERT(rpm_bw_count);
+	last = !--rpm_bw_count;
+	exit_critical_section();
+
+	if (last)
+		rpm_bw_send(false);
+}
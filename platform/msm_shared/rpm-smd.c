@@ -39,6 +39,11 @@
 static uint32_t msg_id;
 smd_channel_info_t ch;
 
+/* Requests that were sent without waiting for their ack */
+static uint32_t pending_acks;
+
+static int rpm_smd_write_data(uint32_t *data, uint32_t len, msg_type type);
+
 void rpm_smd_init(void)
 {
 	smd_init(&ch, SMD_APPS_RPM);
@@ -46,17 +51,58 @@ void rpm_smd_init(void)
 
 void rpm_smd_uninit(void)
 {
+	rpm_smd_wait_acks();
 	smd_uninit(&ch);
 }
 
+/* Send a request and wait for its ack (and the ones of earlier requests) */
 int rpm_smd_send_data(uint32_t *data, uint32_t len, msg_type type)
+{
+	int ret;
+
+	ret = rpm_smd_write_data(data, len, type);
+	rpm_smd_wait_acks();
+
+	return ret;
+}
+
+/*
+ * Send a request without waiting for the ack. The RPM processes the requests
+ * in order, so several votes can be queued and their acks collected at once
+ * with rpm_smd_wait_acks(). Acks that are not collected explicitly are read
+ * by the next rpm_smd_send_data() or rpm_smd_uninit().
+ */
+int rpm_smd_send_data_noack(uint32_t *data, uint32_t len, msg_type type)
+{
+	return rpm_smd_write_data(data, len, type);
+}
+
+/* Read the acks of all requests sent so far, returns 1 if any was an error */
+int rpm_smd_wait_acks(void)
+{
+	uint32_t ack_msg_len = 0;
+	uint32_t rlen = 0;
+	int ret = 0;
+
+	while (pending_acks)
+	{
+		ack_msg_len = rpm_smd_recv_data(&rlen);
+		if (ack_msg_len == 1)
+			ret = 1;
+
+		smd_signal_read_complete(&ch, ack_msg_len);
+		pending_acks--;
+	}
+
+	return ret;
+}
+
+static int rpm_smd_write_data(uint32_t *data, uint32_t len, msg_type type)
 {
 	rpm_req req;
 	rpm_cmd cmd;
 	uint32_t len_to_smd = 0;
 	int ret = 0;
-	uint32_t ack_msg_len = 0;
-	uint32_t rlen = 0;
 	void *smd_data = NULL;
 
 	switch(type)
@@ -82,10 +128,9 @@ int rpm_smd_send_data(uint32_t *data, uint32_t len, msg_type type)
 
 			ret = smd_write(&ch, smd_data, len_to_smd, SMD_APPS_RPM);
 
-			/* Read the response */
-			ack_msg_len = rpm_smd_recv_data(&rlen);
-
-			smd_signal_read_complete(&ch, ack_msg_len);
+			/* Every request is acked, see rpm_smd_wait_acks() */
+			if (!ret)
+				pending_acks++;
 
 			free(smd_data);
 			free_kvp_object(&req.data);
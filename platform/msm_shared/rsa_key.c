@@ -0,0 +1,154 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#include <debug.h>
+#include <rsa_key.h>
+#include <string.h>
+
+#if WITH_MONT_ARM
+#include <mont_arm.h>
+#endif
+
+/*
+ * RSA public key operation with a precomputed key. The key is used as it is,
+ * so there is no ASN.1 parsing and no bignum setup before the first
+ * multiplication. The Montgomery multiplication is the same as in libavb.
+ */
+#define RSA_KEY_MAX_WORDS	(RSA_KEY_MAX_BITS / 32)
+
+/* a[] -= n[] */
+static void rsa_sub_n(const struct rsa_key *key, uint32_t *a)
+{
+	int64_t A = 0;
+	uint32_t i;
+
+	for (i = 0; i < key->len; i++) {
+		A += (uint64_t)a[i] - key->n[i];
+		a[i] = (uint32_t)A;
+		A >>= 32;
+	}
+}
+
+/* a[] >= n[] */
+static int rsa_ge_n(const struct rsa_key *key, const uint32_t *a)
+{
+	uint32_t i;
+
+	for (i = key->len; i;) {
+		i--;
+		if (a[i] != key->n[i])
+			return a[i] > key->n[i];
+	}
+	return 1;
+}
+
+/* c[] = (c[] + a * b[]) / R mod n */
+static void rsa_mont_mul_add(const struct rsa_key *key, uint32_t *c,
+			     uint32_t a, const uint32_t *b)
+{
+#if WITH_MONT_ARM
+	if (mont_mul_add_arm(c, a, b, key->n, key->n0inv, key->len))
+		rsa_sub_n(key, c);
+#else
+	uint64_t A = (uint64_t)a * b[0] + c[0];
+	uint32_t d0 = (uint32_t)A * key->n0inv;
+	uint64_t B = (uint64_t)d0 * key->n[0] + (uint32_t)A;
+	uint32_t i;
+
+	for (i = 1; i < key->len; i++) {
+		A = (A >> 32) + (uint64_t)a * b[i] + c[i];
+		B = (B >> 32) + (uint64_t)d0 * key->n[i] + (uint32_t)A;
+		c[i - 1] = (uint32_t)B;
+	}
+
+	A = (A >> 32) + (B >> 32);
+	c[i - 1] = (uint32_t)A;
+
+	if (A >> 32)
+		rsa_sub_n(key, c);
+#endif
+}
+
+/* c[] = a[] * b[] / R mod n */
+static void rsa_mont_mul(const struct rsa_key *key, uint32_t *c,
+			 const uint32_t *a, const uint32_t *b)
+{
+	uint32_t i;
+
+	memset(c, 0, key->len * sizeof(*c));
+	for (i = 0; i < key->len; i++)
+		rsa_mont_mul_add(key, c, a[i], b);
+}
+
+/* a[] = a[]^e mod n */
+static void rsa_modexp(const struct rsa_key *key, uint32_t *a)
+{
+	uint32_t aR[RSA_KEY_MAX_WORDS], accR[RSA_KEY_MAX_WORDS];
+	uint32_t tmp[RSA_KEY_MAX_WORDS];
+	size_t size = key->len * sizeof(*a);
+	int bit = 31 - __builtin_clz(key->e);
+
+	rsa_mont_mul(key, aR, a, key->rr);		/* aR = a * R */
+	memcpy(accR, aR, size);
+	while (bit--) {
+		rsa_mont_mul(key, tmp, accR, accR);
+		if (key->e & (1U << bit))
+			rsa_mont_mul(key, accR, tmp, aR);
+		else
+			memcpy(accR, tmp, size);
+	}
+
+	/* Leave the Montgomery domain: a^e * R * 1 / R */
+	memset(tmp, 0, size);
+	tmp[0] = 1;
+	rsa_mont_mul(key, a, accR, tmp);
+
+	/* The result is at most n too large */
+	if (rsa_ge_n(key, a))
+		rsa_sub_n(key, a);
+}
+
+int rsa_key_public_decrypt(const struct rsa_key *key, const unsigned char *sig,
+			   unsigned int sig_len, unsigned char *out)
+{
+	uint32_t m[RSA_KEY_MAX_WORDS];
+	unsigned char em[RSA_KEY_MAX_BITS / 8];
+	unsigned int i, pad;
+
+	if (!key->len || key->len > RSA_KEY_MAX_WORDS || sig_len != key->len * 4) {
+		dprintf(CRITICAL, "ERROR: Signature does not match the key size\n");
+		return -1;
+	}
+
+	/* Big endian bytes to little endian words */
+	for (i = 0; i < key->len; i++) {
+		const unsigned char *p = sig + sig_len - 4 * (i + 1);
+
+		m[i] = p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+	}
+
+	if (rsa_ge_n(key, m))
+		return -1;
+
+	rsa_modexp(key, m);
+
+	for (i = 0; i < key->len; i++) {
+		unsigned char *p = em + sig_len - 4 * (i + 1);
+
+		p[0] = m[i] >> 24;
+		p[1] = m[i] >> 16;
+		p[2] = m[i] >> 8;
+		p[3] = m[i];
+	}
+
+	/* PKCS #1 v1.5 block type 1: 00 01 FF ... FF 00 data, >= 8 bytes FF */
+	if (em[0] != 0x00 || em[1] != 0x01)
+		return -1;
+
+	for (pad = 2; pad < sig_len && em[pad] == 0xff; pad++)
+		;
+	if (pad == sig_len || em[pad] != 0x00 || pad - 2 < 8)
+		return -1;
+	pad++;
+
+	memcpy(out, em + pad, sig_len - pad);
+	return sig_len - pad;
+}
@@ -17,6 +17,26 @@ OBJS += \
 	$(LOCAL_DIR)/qgic_common.o \
 	$(LOCAL_DIR)/crc32.o
 
+ifeq ($(ENABLE_CRC32_ARMV8),1)
+DEFINES += WITH_CRC32_ARMV8=1
+OBJS += \
+	$(LOCAL_DIR)/crc32-armv8.o
+endif
+
+# Montgomery multiplication with UMAAL (ARMv6+) for RSA verification
+ifeq ($(ARCH),arm)
+DEFINES += WITH_MONT_ARM=1
+OBJS += \
+	$(LOCAL_DIR)/mont-arm.o
+endif
+
+# Only used if the CPU implements the optional ARMv8 Crypto Extensions
+ifeq ($(ENABLE_SHA_ARMV8),1)
+DEFINES += WITH_SHA_ARMV8=1
+OBJS += \
+	$(LOCAL_DIR)/sha-armv8.o
+endif
+
 ifneq ($(filter $(DEFINES), WITH_DEBUG_JTAG=1),)
 OBJS += \
 	$(LOCAL_DIR)/jtag_hook.o \
@@ -684,6 +704,12 @@ DEFINES += DISPLAY_TYPE_MDSS=1
 			$(LOCAL_DIR)/mipi_dsi_autopll_thulium.o
 endif
 
+# The memory mapped QTimer is programmed for the next timer expiry directly,
+# so the kernel does not need a periodic tick.
+ifneq ($(filter $(LOCAL_DIR)/qtimer_mmap.o, $(OBJS)),)
+DEFINES += PLATFORM_HAS_DYNAMIC_TIMER=1
+endif
+
 ifneq ($(filter DEVICE_TREE=1, $(DEFINES)),)
 # Add dev_tree.o if it is not already there
 OBJS += $(if $(filter $(LOCAL_DIR)/dev_tree.o,$(OBJS)),,$(LOCAL_DIR)/dev_tree.o)
@@ -724,6 +750,13 @@ else
 $(error Unknown DTBO backend: $(DTBO_BACKEND))
 endif
 
+# Optionally cache the dtb with the DTBO applied at the start of a partition
+ifneq ($(DTBO_CACHE_PARTITION),)
+ifneq ($(DTBO_BACKEND), none)
+DEFINES += DTBO_CACHE=1 DTBO_CACHE_PARTITION=$(DTBO_CACHE_PARTITION)
+endif
+endif
+
 CRYPTO_SW_BACKEND ?= openssl
 ifeq ($(CRYPTO_SW_BACKEND), openssl)
 MODULES += lib/openssl
@@ -736,6 +769,25 @@ else
 $(error Unknown crypto software backend: $(CRYPTO_SW_BACKEND))
 endif
 
+# RSA key for image_verify() precomputed from a certificate at build time,
+# instead of parsing the built-in certificate with OpenSSL on every boot
+IMAGE_VERIFY_CERT ?=
+ifneq ($(IMAGE_VERIFY_CERT),)
+ifneq ($(filter $(LOCAL_DIR)/image_verify.o, $(OBJS)),)
+IMAGE_VERIFY_KEY := $(BUILDDIR)/image_verify_key.h
+DEFINES += IMAGE_VERIFY_KEY=1
+GENERATED += $(IMAGE_VERIFY_KEY)
+OBJS += \
+	$(LOCAL_DIR)/rsa_key.o
+
+$(BUILDDIR)/$(LOCAL_DIR)/image_verify.o: $(IMAGE_VERIFY_KEY)
+$(IMAGE_VERIFY_KEY): $(IMAGE_VERIFY_CERT) lk2nd/scripts/rsakey2c.py
+	@$(MKDIR)
+	@echo generating $@
+	$(NOECHO)lk2nd/scripts/rsakey2c.py image_verify_key $< $@
+endif
+endif
+
 ifneq ($(filter MDP4=1, $(DEFINES)),)
 ifeq ($(ENABLE_DISPLAY), 0)
 MODULES := $(filter-out dev/panel/msm, $(MODULES))
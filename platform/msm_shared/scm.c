@@ -606,6 +606,15 @@ int scm_svc_version(uint32 * major, uint32 * minor)
 	int                 ret = 0;
 	scmcall_arg scm_arg = {0};
 	scmcall_ret scm_ret = {0};
+	/* The version cannot change, fastboot asks for it on every flash */
+	static uint32 ssd_version;
+	static bool ssd_version_read;
+
+	if (ssd_version_read)
+	{
+		*major = TZBSP_GET_FEATURE_VERSION(ssd_version);
+		return 0;
+	}
 
 	feature_req.feature_id = TZBSP_FVER_SSD;
 
@@ -629,7 +638,11 @@ int scm_svc_version(uint32 * major, uint32 * minor)
 	}
 
 	if(!ret)
+	{
+		ssd_version = feature_rsp.version;
+		ssd_version_read = true;
 		*major = TZBSP_GET_FEATURE_VERSION(feature_rsp.version);
+	}
 
 	return ret;
 }
@@ -1086,20 +1099,11 @@ void scm_elexec_call(paddr_t kernel_entry, paddr_t dtb_offset)
 }
 
 /* SCM Random Command */
-int scm_random(uintptr_t * rbuf, uint32_t  r_len)
+static int scm_random_chunk(uint8_t *rand_buf, uint32_t r_len)
 {
 	int ret;
 	struct tz_prng_data data;
 	scmcall_arg scm_arg = {0};
-	// Memory passed to TZ should be algined to cache line
-	BUF_DMA_ALIGN(rand_buf, sizeof(uintptr_t));
-
-	// r_len must be less than or equal to sizeof(rand_buf) to avoid memory corruption.
-	if (r_len > sizeof(rand_buf))
-	{
-		dprintf(CRITICAL, "r_len is larger than sizeof(randbuf).");
-		return -1;
-	}
 
 	if (!is_scm_armv8_support())
 	{
@@ -1132,8 +1136,35 @@ int scm_random(uintptr_t * rbuf, uint32_t  r_len)
 			dprintf(CRITICAL, "Secure canary SCM failed: %x\n", ret);
 	}
 
-	//Copy back into the return buffer
-	memscpy(rbuf, r_len, rand_buf, sizeof(rand_buf));
+	return ret;
+}
+
+/*
+ * Requests larger than SCM_RANDOM_MAX_LEN are split into several calls,
+ * each call returns up to SCM_RANDOM_MAX_LEN bytes.
+ */
+int scm_random(uintptr_t * rbuf, uint32_t  r_len)
+{
+	int ret = 0;
+	uint8_t *out = (uint8_t *) rbuf;
+	uint32_t len;
+	// Memory passed to TZ should be algined to cache line
+	BUF_DMA_ALIGN(rand_buf, SCM_RANDOM_MAX_LEN);
+
+	while (r_len)
+	{
+		len = MIN(r_len, sizeof(rand_buf));
+		ret = scm_random_chunk(rand_buf, len);
+		if (ret)
+			break;
+
+		//Copy back into the return buffer
+		memscpy(out, r_len, rand_buf, len);
+		out += len;
+		r_len -= len;
+	}
+
+	memset(rand_buf, 0, sizeof(rand_buf));
 	return ret;
 }
 
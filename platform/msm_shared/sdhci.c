@@ -39,6 +39,10 @@
 #include <sdhci.h>
 #include <sdhci_msm.h>
 
+#if WITH_LK2ND_TRACE
+#include <lk2nd/trace.h>
+#endif
+
 static void sdhci_dumpregs(struct sdhci_host *host)
 {
 	DBG("****************** SDHC REG DUMP START ********************\n");
@@ -133,11 +137,77 @@ static void sdhci_error_status_enable(struct sdhci_host *host)
 	/* Enable all interrupt status */
 	REG_WRITE16(host, SDHCI_NRML_INT_STS_EN, SDHCI_NRML_INT_STS_EN_REG);
 	REG_WRITE16(host, SDHCI_ERR_INT_STS_EN, SDHCI_ERR_INT_STS_EN_REG);
-	/* Enable all interrupt signal */
+	/*
+	 * Enable all interrupt signal, unless the irq is used to wait for
+	 * completion, signals are then enabled for each wait
+	 */
+	if (host->irq)
+		return;
 	REG_WRITE16(host, SDHCI_NRML_INT_SIG_EN, SDHCI_NRML_INT_SIG_EN_REG);
 	REG_WRITE16(host, SDHCI_ERR_INT_SIG_EN, SDHCI_ERR_INT_SIG_EN_REG);
 }
 
+/*
+ * Function: sdhci irq handler
+ * Arg     : Host structure
+ * Return  : INT_RESCHEDULE to run the waiting thread
+ * Flow:   : Mask the interrupt signals & wake up the waiting thread, the
+ *           status bits are left for the thread to handle
+ */
+static enum handler_return sdhci_irq_handler(void *arg)
+{
+	struct sdhci_host *host = arg;
+
+	REG_WRITE16(host, 0, SDHCI_NRML_INT_SIG_EN_REG);
+	REG_WRITE16(host, 0, SDHCI_ERR_INT_SIG_EN_REG);
+
+	event_signal(&host->irq_event, false);
+
+	return INT_RESCHEDULE;
+}
+
+/*
+ * Function: sdhci enable irq
+ * Arg     : Host structure & host controller irq
+ * Return  : None
+ * Flow:   : Register the irq handler, commands sent after this block the
+ *           calling thread instead of spinning on the status registers.
+ */
+void sdhci_enable_irq(struct sdhci_host *host, uint32_t irq)
+{
+	REG_WRITE16(host, 0, SDHCI_NRML_INT_SIG_EN_REG);
+	REG_WRITE16(host, 0, SDHCI_ERR_INT_SIG_EN_REG);
+
+	event_init(&host->irq_event, false, EVENT_FLAG_AUTOUNSIGNAL);
+	host->irq = irq;
+
+	register_int_handler(irq, sdhci_irq_handler, host);
+	unmask_interrupt(irq);
+}
+
+/*
+ * Function: sdhci irq wait
+ * Arg     : Host structure, interrupt status to wait for & timeout in us
+ * Return  : None
+ * Flow:   : Sleep until the host raises one of the status bits or an error.
+ *           The caller still polls the status afterwards, so a missed or
+ *           late irq only costs the timeout.
+ */
+static void sdhci_irq_wait(struct sdhci_host *host, uint16_t mask, uint64_t timeout)
+{
+	/* Threads can't block in irq context or with interrupts disabled */
+	if (!host->irq || in_critical_section())
+		return;
+
+	REG_WRITE16(host, SDHCI_ERR_INT_SIG_EN, SDHCI_ERR_INT_SIG_EN_REG);
+	REG_WRITE16(host, mask, SDHCI_NRML_INT_SIG_EN_REG);
+
+	event_wait_timeout(&host->irq_event, MAX(timeout / 1000, SDHCI_IRQ_TIMEOUT_MIN));
+
+	REG_WRITE16(host, 0, SDHCI_NRML_INT_SIG_EN_REG);
+	REG_WRITE16(host, 0, SDHCI_ERR_INT_SIG_EN_REG);
+}
+
 /*
  * Function: sdhci clock supply
  * Arg     : Host structure
@@ -323,6 +393,68 @@ void sdhci_set_uhs_mode(struct sdhci_host *host, uint32_t mode)
 	sdhci_clk_supply(host, clk_val);
 }
 
+/*
+ * Function: sdhci switch signal voltage
+ * Arg     : Host structure
+ * Return  : 0 on Success, 1 on Failure
+ * Flow:   : Voltage switch sequence from the SD 3.0 spec, CMD11 has
+ *           already been accepted by the card:
+ *           1. Stop the clock & check the card drives DAT[3:0] low
+ *           2. Switch the IO supply & the IO pads to 1.8V
+ *           3. Enable 1.8V signalling & wait for the power irq
+ *           4. Run the clock again after 5ms & check DAT[3:0] are high
+ */
+uint32_t sdhci_switch_signal_voltage(struct sdhci_host *host)
+{
+	uint16_t clk;
+	uint16_t ctrl;
+
+	clk = REG_READ16(host, SDHCI_CLK_CTRL_REG);
+	REG_WRITE16(host, clk & ~SDHCI_CLK_EN, SDHCI_CLK_CTRL_REG);
+
+	if (REG_READ32(host, SDHCI_PRESENT_STATE_REG) & SDHCI_DAT_LVL_MASK) {
+		dprintf(CRITICAL, "Error: Card did not start the voltage switch\n");
+		goto err;
+	}
+
+	if (target_sdc_set_io_voltage(host->msm_host->slot, SD_IO_VOLTAGE_1_8)) {
+		dprintf(CRITICAL, "Error: Failed to switch the IO supply to 1.8V\n");
+		goto err;
+	}
+
+	sdhci_msm_set_io_pad(host, true);
+
+	ctrl = REG_READ16(host, SDHCI_HOST_CTRL2_REG);
+	REG_WRITE16(host, ctrl | SDHCI_1_8_VOL_SET, SDHCI_HOST_CTRL2_REG);
+
+	/* The power irq acks the IO level change */
+	if (event_wait_timeout(host->sdhc_event, SDHCI_PWR_IRQ_TIMEOUT))
+		dprintf(INFO, "No power irq for the voltage switch\n");
+
+	mdelay(5);
+
+	if (!(REG_READ16(host, SDHCI_HOST_CTRL2_REG) & SDHCI_1_8_VOL_SET)) {
+		dprintf(CRITICAL, "Error: Host did not switch to 1.8V signalling\n");
+		goto err;
+	}
+
+	REG_WRITE16(host, clk | SDHCI_CLK_EN, SDHCI_CLK_CTRL_REG);
+
+	/* Card drives DAT[3:0] high within 1ms when the switch is complete */
+	mdelay(1);
+
+	if ((REG_READ32(host, SDHCI_PRESENT_STATE_REG) & SDHCI_DAT_LVL_MASK) != SDHCI_DAT_LVL_MASK) {
+		dprintf(CRITICAL, "Error: Card failed the voltage switch\n");
+		return 1;
+	}
+
+	return 0;
+
+err:
+	REG_WRITE16(host, clk, SDHCI_CLK_CTRL_REG);
+	return 1;
+}
+
 /*
  * Function: sdhci set adma mode
  * Arg     : Host structure
@@ -331,6 +463,20 @@ void sdhci_set_uhs_mode(struct sdhci_host *host, uint32_t mode)
  */
 static void sdhci_set_adma_mode(struct sdhci_host *host)
 {
+	uint16_t ctrl;
+
+	/*
+	 * In version 4 mode the DMA select field only picks ADMA2,
+	 * the descriptor format follows the addressing mode
+	 */
+	if (host->v4_mode) {
+		ctrl = REG_READ16(host, SDHCI_HOST_CTRL2_REG);
+		ctrl |= SDHCI_HOST_VER4_EN;
+		if (host->caps.adma_64bit)
+			ctrl |= SDHCI_ADDR_64BIT_EN;
+		REG_WRITE16(host, ctrl, SDHCI_HOST_CTRL2_REG);
+	}
+
 	/* Select 32 Bit ADMA2 type */
 	REG_WRITE8(host, SDHCI_ADMA_32BIT, SDHCI_HOST_CTRL1_REG);
 }
@@ -436,6 +582,8 @@ static uint8_t sdhci_cmd_complete(struct sdhci_host *host, struct mmc_command *c
 	uint32_t err_status;
 	uint64_t max_trans_retry = (cmd->cmd_timeout ? cmd->cmd_timeout : SDHCI_MAX_TRANS_RETRY);
 
+	sdhci_irq_wait(host, SDHCI_INT_STS_CMD_COMPLETE, SDHCI_MAX_CMD_RETRY);
+
 	do {
 
 		int_status = REG_READ16(host, SDHCI_NRML_INT_STS_REG);
@@ -505,6 +653,8 @@ static uint8_t sdhci_cmd_complete(struct sdhci_host *host, struct mmc_command *c
 	 * Clear the transfer complete interrupt
 	 */
 	if (cmd->data_present || cmd->resp_type == SDHCI_CMD_RESP_R1B) {
+		sdhci_irq_wait(host, SDHCI_INT_STS_TRANS_COMPLETE, max_trans_retry);
+
 		do {
 			int_status = REG_READ16(host, SDHCI_NRML_INT_STS_REG);
 
@@ -591,93 +741,95 @@ err:
 }
 
 /*
- * Function: sdhci prep desc table
- * Arg     : Pointer data & length
- * Return  : Pointer to desc table
- * Flow:   : Prepare the adma table as per the sd spec v 3.0
+ * Function: sdhci fill desc
+ * Arg     : Host structure, desc table, index, data, length & attributes
+ * Return  : None
+ * Flow:   : Fill one descriptor line in the format selected for the host
  */
-static struct desc_entry *sdhci_prep_desc_table(void *data, uint32_t len)
+static void sdhci_fill_desc(struct sdhci_host *host, void *table, uint32_t i,
+							void *data, uint32_t len, uint16_t attr)
 {
-	struct desc_entry *sg_list;
-	uint32_t sg_len = 0;
-	uint32_t remain = 0;
-	uint32_t i;
-	uint32_t table_len = 0;
+	/*
+	 * Length attribute is 16 bit value & max transfer size for one
+	 * descriptor line is 65536 bytes, As per SD Spec3.0 'len = 0'
+	 * implies 65536 bytes. Truncate the length to limit to 16 bit
+	 * range.
+	 */
+	if (host->caps.adma_64bit) {
+		struct desc_entry_64 *desc = (struct desc_entry_64 *)table + i;
 
-	if (len <= SDHCI_ADMA_DESC_LINE_SZ) {
-		/* Allocate only one descriptor */
-		sg_list = (struct desc_entry *) memalign(lcm(4, CACHE_LINE), ROUNDUP(sizeof(struct desc_entry), CACHE_LINE));
+		desc->addr_lo = (uint32_t)data;
+		desc->addr_hi = 0;
+		desc->len = len & 0xffff;
+		desc->tran_att = attr;
+	} else {
+		struct desc_entry *desc = (struct desc_entry *)table + i;
 
-		if (!sg_list) {
-			dprintf(CRITICAL, "Error allocating memory\n");
-			ASSERT(0);
-		}
+		desc->addr = (uint32_t)data;
+		desc->len = len & 0xffff;
+		desc->tran_att = attr;
+	}
 
-		sg_list[0].addr = (uint32_t)data;
-		sg_list[0].len = (len < SDHCI_ADMA_DESC_LINE_SZ) ? len : (SDHCI_ADMA_DESC_LINE_SZ & 0xffff);
-		sg_list[0].tran_att = SDHCI_ADMA_TRANS_VALID | SDHCI_ADMA_TRANS_DATA
-							  | SDHCI_ADMA_TRANS_END;
+	DBG("\n %s: sg_list: addr: 0x%08x len: 0x%04x attr: 0x%04x\n", __func__, (uint32_t)data,
+		len, attr);
+}
 
-		sg_len = 1;
-		table_len = sizeof(struct desc_entry);
-	} else {
-		/* Calculate the number of entries in desc table */
-		sg_len = len / SDHCI_ADMA_DESC_LINE_SZ;
-		remain = len - (sg_len * SDHCI_ADMA_DESC_LINE_SZ);
+/*
+ * Function: sdhci prep desc table
+ * Arg     : Host structure, segments & number of segments
+ * Return  : Pointer to desc table
+ * Flow:   : Prepare the adma table as per the sd spec v 3.0, or with
+ *           128 bit descriptors as per v 4.10 in 64 bit addressing mode.
+ *           The whole transfer is described by a single table, each
+ *           segment takes one line per SDHCI_ADMA_DESC_LINE_SZ bytes.
+ */
+static void *sdhci_prep_desc_table(struct sdhci_host *host, struct sdhci_sg *sg, uint32_t sg_count)
+{
+	void *sg_list;
+	uint32_t sg_len = 0;
+	uint32_t i, n;
+	uint32_t desc_sz;
+	uint32_t table_len;
+	uint32_t len, line;
+	uint8_t *data;
 
-		/* Allocate sg_len + 1 entries if there are remaining bytes at the end */
-		if (remain)
-			sg_len++;
+	desc_sz = host->caps.adma_64bit ? sizeof(struct desc_entry_64) : sizeof(struct desc_entry);
 
-		table_len = (sg_len * sizeof(struct desc_entry));
+	/* Calculate the number of entries in desc table */
+	for (i = 0; i < sg_count; i++)
+		sg_len += MAX(ROUNDUP(sg[i].len, SDHCI_ADMA_DESC_LINE_SZ) / SDHCI_ADMA_DESC_LINE_SZ, 1U);
 
-		sg_list = (struct desc_entry *) memalign(lcm(4, CACHE_LINE), ROUNDUP(table_len, CACHE_LINE));
+	table_len = sg_len * desc_sz;
 
-		if (!sg_list) {
-			dprintf(CRITICAL, "Error allocating memory\n");
-			ASSERT(0);
-		}
+	sg_list = memalign(lcm(8, CACHE_LINE), ROUNDUP(table_len, CACHE_LINE));
 
-		memset((void *) sg_list, 0, table_len);
+	if (!sg_list) {
+		dprintf(CRITICAL, "Error allocating memory\n");
+		ASSERT(0);
+	}
 
-		/*
-		 * Prepare sglist in the format:
-		 *  ___________________________________________________
-		 * |Transfer Len | Transfer ATTR | Data Address        |
-		 * | (16 bit)    | (16 bit)      | (32 bit)            |
-		 * |_____________|_______________|_____________________|
-		 */
-		for (i = 0; i < (sg_len - 1); i++) {
-				sg_list[i].addr = (uint32_t)data;
-				/*
-				 * Length attribute is 16 bit value & max transfer size for one
-				 * descriptor line is 65536 bytes, As per SD Spec3.0 'len = 0'
-				 * implies 65536 bytes. Truncate the length to limit to 16 bit
-				 * range.
-				 */
-				sg_list[i].len = (SDHCI_ADMA_DESC_LINE_SZ & 0xffff);
-				sg_list[i].tran_att = SDHCI_ADMA_TRANS_VALID | SDHCI_ADMA_TRANS_DATA;
-				data += SDHCI_ADMA_DESC_LINE_SZ;
-				len -= SDHCI_ADMA_DESC_LINE_SZ;
-			}
+	memset(sg_list, 0, table_len);
+
+	for (i = 0, n = 0; i < sg_count; i++) {
+		data = sg[i].data;
+		len = sg[i].len;
+		do {
+			line = MIN(len, SDHCI_ADMA_DESC_LINE_SZ);
 
 			/* Fill the last entry of the table with Valid & End
 			 * attributes
 			 */
-			sg_list[sg_len - 1].addr = (uint32_t)data;
-			sg_list[sg_len - 1].len = (len < SDHCI_ADMA_DESC_LINE_SZ) ? len : (SDHCI_ADMA_DESC_LINE_SZ & 0xffff);
-			sg_list[sg_len - 1].tran_att = SDHCI_ADMA_TRANS_VALID | SDHCI_ADMA_TRANS_DATA |
-										   SDHCI_ADMA_TRANS_END;
-		}
+			sdhci_fill_desc(host, sg_list, n, data, line,
+							SDHCI_ADMA_TRANS_VALID | SDHCI_ADMA_TRANS_DATA |
+							(n == sg_len - 1 ? SDHCI_ADMA_TRANS_END : 0));
+			data += line;
+			len -= line;
+			n++;
+		} while (len);
+	}
 
 	arch_clean_invalidate_cache_range((addr_t)sg_list, table_len);
 
-	for (i = 0; i < sg_len; i++)
-	{
-		DBG("\n %s: sg_list: addr: 0x%08x len: 0x%04x attr: 0x%04x\n", __func__, sg_list[i].addr,
-			(sg_list[i].len ? sg_list[i].len : SDHCI_ADMA_DESC_LINE_SZ), sg_list[i].tran_att);
-	}
-
 	return sg_list;
 }
 
@@ -689,17 +841,16 @@ static struct desc_entry *sdhci_prep_desc_table(void *data, uint32_t len)
  *           2. Write adma register
  *           3. Write block size & block count register
  */
-static struct desc_entry *sdhci_adma_transfer(struct sdhci_host *host,
-											  struct mmc_command *cmd)
+static void *sdhci_adma_transfer(struct sdhci_host *host,
+								 struct mmc_command *cmd)
 {
 	uint32_t num_blks = 0;
 	uint32_t sz;
-	void *data;
-	struct desc_entry *adma_addr;
+	struct sdhci_sg single;
+	void *adma_addr;
 
 
 	num_blks = cmd->data.num_blocks;
-	data = cmd->data.data_ptr;
 
 	/*
 	 * Some commands send data on DAT lines which is less
@@ -715,10 +866,18 @@ static struct desc_entry *sdhci_adma_transfer(struct sdhci_host *host,
 		sz = num_blks * SDHCI_MMC_BLK_SZ;
 
 	/* Prepare adma descriptor table */
-	adma_addr = sdhci_prep_desc_table(data, sz);
+	if (cmd->data.sg) {
+		adma_addr = sdhci_prep_desc_table(host, cmd->data.sg, cmd->data.sg_count);
+	} else {
+		single.data = cmd->data.data_ptr;
+		single.len = sz;
+		adma_addr = sdhci_prep_desc_table(host, &single, 1);
+	}
 
 	/* Write adma address to adma register */
 	REG_WRITE32(host, (uint32_t) adma_addr, SDHCI_ADM_ADDR_REG);
+	if (host->caps.adma_64bit)
+		REG_WRITE32(host, 0, SDHCI_ADM_ADDR_HI_REG);
 
 	/* Write the block size */
 	if (cmd->data.blk_sz)
@@ -727,9 +886,15 @@ static struct desc_entry *sdhci_adma_transfer(struct sdhci_host *host,
 		REG_WRITE16(host, SDHCI_MMC_BLK_SZ, SDHCI_BLKSZ_REG);
 
 	/*
-	 * Set block count in block count register
+	 * Set block count in block count register, in version 4 mode
+	 * the 32 bit register is used when the 16 bit one is zero
 	 */
-	REG_WRITE16(host, num_blks, SDHCI_BLK_CNT_REG);
+	if (host->v4_mode) {
+		REG_WRITE16(host, 0, SDHCI_BLK_CNT_REG);
+		REG_WRITE32(host, num_blks, SDHCI_BLK_CNT_32_REG);
+	} else {
+		REG_WRITE16(host, num_blks, SDHCI_BLK_CNT_REG);
+	}
 
 	return adma_addr;
 }
@@ -751,13 +916,18 @@ uint32_t sdhci_send_command(struct sdhci_host *host, struct mmc_command *cmd)
 	uint16_t trans_mode = 0;
 	uint16_t present_state;
 	uint32_t flags;
-	struct desc_entry *sg_list = NULL;
+	void *sg_list = NULL;
+	uint32_t i;
 
 	DBG("\n %s: START: cmd:%04d, arg:0x%08x, resp_type:0x%04x, data_present:%d\n",
 				__func__, cmd->cmd_index, cmd->argument, cmd->resp_type, cmd->data_present);
 
+#if WITH_LK2ND_TRACE
+	LK2ND_TRACE_SCOPE("sdhci_cmd", cmd->cmd_index);
+#endif
+
 	if (cmd->data_present)
-		ASSERT(cmd->data.data_ptr);
+		ASSERT(cmd->data.data_ptr || cmd->data.sg);
 
 	/*
 	 * Assert if the data buffer is not aligned to cache
@@ -768,8 +938,14 @@ uint32_t sdhci_send_command(struct sdhci_host *host, struct mmc_command *cmd)
 	 * may not be aligned to cache boundary due to
 	 * certain image formats like sparse image.
 	 */
-	if (cmd->trans_mode == SDHCI_READ_MODE)
-		ASSERT(IS_CACHE_LINE_ALIGNED(cmd->data.data_ptr));
+	if (cmd->trans_mode == SDHCI_READ_MODE) {
+		if (cmd->data.sg) {
+			for (i = 0; i < cmd->data.sg_count; i++)
+				ASSERT(IS_CACHE_LINE_ALIGNED(cmd->data.sg[i].data));
+		} else {
+			ASSERT(IS_CACHE_LINE_ALIGNED(cmd->data.data_ptr));
+		}
+	}
 
 	do {
 		present_state = REG_READ32(host, SDHCI_PRESENT_STATE_REG);
@@ -861,7 +1037,8 @@ uint32_t sdhci_send_command(struct sdhci_host *host, struct mmc_command *cmd)
 		if (cmd->trans_mode == SDHCI_MMC_READ)
 		{
 			trans_mode |= SDHCI_READ_MODE;
-			if(cmd->cmd_index == CMD21_SEND_TUNING_BLOCK)
+			if(cmd->cmd_index == CMD21_SEND_TUNING_BLOCK ||
+			   cmd->cmd_index == CMD19_SEND_TUNING_BLOCK)
 				sdhci_msm_toggle_cdr(host, false);
 			else
 				sdhci_msm_toggle_cdr(host, true);
@@ -906,9 +1083,15 @@ uint32_t sdhci_send_command(struct sdhci_host *host, struct mmc_command *cmd)
 		/* Read can be performed on block size < SDHCI_MMC_BLK_SZ, make sure to flush
 		 * the data only for the read size instead
 		 */
-		arch_invalidate_cache_range((addr_t)cmd->data.data_ptr, (cmd->data.blk_sz) ? \
-									(cmd->data.num_blocks * cmd->data.blk_sz) : \
-									(cmd->data.num_blocks * SDHCI_MMC_BLK_SZ));
+		if (cmd->data.sg) {
+			for (i = 0; i < cmd->data.sg_count; i++)
+				arch_invalidate_cache_range((addr_t)cmd->data.sg[i].data,
+											cmd->data.sg[i].len);
+		} else {
+			arch_invalidate_cache_range((addr_t)cmd->data.data_ptr, (cmd->data.blk_sz) ? \
+										(cmd->data.num_blocks * cmd->data.blk_sz) : \
+										(cmd->data.num_blocks * SDHCI_MMC_BLK_SZ));
+		}
 	}
 
 	DBG("\n %s: END: cmd:%04d, arg:0x%08x, resp:0x%08x 0x%08x 0x%08x 0x%08x\n",
@@ -959,6 +1142,16 @@ void sdhci_init(struct sdhci_host *host)
 	if (caps[0] & SDHCI_BLK_ADMA_MASK)
 		host->caps.adma_support = 1;
 
+	/*
+	 * Version 4.10 hosts have a 32 bit block count, use it to
+	 * avoid splitting large transfers into several commands
+	 */
+	host->spec_version = REG_READ16(host, SDHCI_HOST_VERSION_REG) & SDHCI_SPEC_VER_MASK;
+	host->v4_mode = (host->spec_version >= SDHCI_SPEC_410);
+
+	/* 64 bit addressing with 128 bit descriptors, version 4 mode only */
+	host->caps.adma_64bit = (host->v4_mode && (caps[0] & SDHCI_CAP_64BIT_V4)) ? 1 : 0;
+
 	/* Supported voltage */
 	if (caps[0] & SDHCI_3_3_VOL_MASK)
 		host->caps.voltage = SDHCI_VOL_3_3;
@@ -1003,3 +1196,201 @@ void sdhci_init(struct sdhci_host *host)
 	 */
 	sdhci_error_status_enable(host);
 }
+
+/*
+ * Function: sdhci cqe desc sz
+ * Arg     : Host structure
+ * Return  : Size of one task or link descriptor
+ * Flow:   : The descriptors follow the adma format of the host, 128 bit
+ *           ones are used together with 64 bit adma descriptors.
+ */
+static uint32_t sdhci_cqe_desc_sz(struct sdhci_host *host)
+{
+	return host->caps.adma_64bit ? sizeof(struct desc_entry_64) : sizeof(struct desc_entry);
+}
+
+/*
+ * Function: sdhci cqe enable
+ * Arg     : Host structure & relative card address
+ * Return  : 0 on Success, 1 on Failure
+ * Flow:   : 1. Allocate the task descriptor list
+ *           2. Program the list & the card address for status polling
+ *           3. Enable the engine & leave the halt state
+ *           Commands can't be sent with sdhci_send_command until the
+ *           engine is disabled again.
+ */
+uint32_t sdhci_cqe_enable(struct sdhci_host *host, uint32_t rca)
+{
+	uint32_t tdl_len = SDHCI_CQE_MAX_SLOTS * 2 * sdhci_cqe_desc_sz(host);
+	uint32_t cfg = 0;
+
+	if (!host->cqe_base)
+		return 1;
+
+	if (!host->cqe_tdl)
+	{
+		host->cqe_tdl = memalign(lcm(8, CACHE_LINE), ROUNDUP(tdl_len, CACHE_LINE));
+		if (!host->cqe_tdl)
+		{
+			dprintf(CRITICAL, "Error allocating memory\n");
+			return 1;
+		}
+
+		memset(host->cqe_tdl, 0, tdl_len);
+		arch_clean_invalidate_cache_range((addr_t)host->cqe_tdl, tdl_len);
+	}
+
+	/* The engine sets up each transfer, only the block size is fixed */
+	REG_WRITE16(host, SDHCI_MMC_BLK_SZ, SDHCI_BLKSZ_REG);
+	host->cqe_int_sts_en = REG_READ16(host, SDHCI_NRML_INT_STS_EN_REG);
+	REG_WRITE16(host, SDHCI_CQE_INT_STS, SDHCI_NRML_INT_STS_EN_REG);
+
+	if (host->caps.adma_64bit)
+		cfg |= SDHCI_CQE_CFG_TASK_DESC_128;
+
+	CQE_WRITE32(host, cfg, SDHCI_CQE_CFG_REG);
+	CQE_WRITE32(host, (uint32_t)host->cqe_tdl, SDHCI_CQE_TDLBA_REG);
+	CQE_WRITE32(host, 0, SDHCI_CQE_TDLBAU_REG);
+	CQE_WRITE32(host, rca, SDHCI_CQE_SSC2_REG);
+
+	/* Status is polled, the engine never raises the irq */
+	CQE_WRITE32(host, SDHCI_CQE_IS_TCC | SDHCI_CQE_IS_ERR, SDHCI_CQE_ISTE_REG);
+	CQE_WRITE32(host, 0, SDHCI_CQE_ISGE_REG);
+	CQE_WRITE32(host, CQE_READ32(host, SDHCI_CQE_IS_REG), SDHCI_CQE_IS_REG);
+	CQE_WRITE32(host, CQE_READ32(host, SDHCI_CQE_TCN_REG), SDHCI_CQE_TCN_REG);
+
+	CQE_WRITE32(host, cfg | SDHCI_CQE_CFG_ENABLE, SDHCI_CQE_CFG_REG);
+	CQE_WRITE32(host, 0, SDHCI_CQE_CTL_REG);
+
+	return 0;
+}
+
+/*
+ * Function: sdhci cqe disable
+ * Arg     : Host structure
+ * Return  : None
+ * Flow:   : 1. Halt the engine
+ *           2. Clear the tasks that did not complete, e.g. after an error
+ *           3. Disable the engine & restore the interrupt status enables
+ */
+void sdhci_cqe_disable(struct sdhci_host *host)
+{
+	uint32_t retry = 0;
+	uint32_t pending;
+	uint32_t tag;
+
+	CQE_WRITE32(host, SDHCI_CQE_CTL_HALT, SDHCI_CQE_CTL_REG);
+	while (!(CQE_READ32(host, SDHCI_CQE_CTL_REG) & SDHCI_CQE_CTL_HALT))
+	{
+		if (++retry == SDHCI_CQE_HALT_RETRY)
+		{
+			dprintf(CRITICAL, "Error: Command queue engine did not halt\n");
+			break;
+		}
+		udelay(1);
+	}
+
+	pending = CQE_READ32(host, SDHCI_CQE_TDBR_REG);
+	if (pending)
+		CQE_WRITE32(host, pending, SDHCI_CQE_TCLR_REG);
+
+	CQE_WRITE32(host, 0, SDHCI_CQE_CFG_REG);
+
+	for (tag = 0; tag < SDHCI_CQE_MAX_TASKS; tag++)
+	{
+		free(host->cqe_tables[tag]);
+		host->cqe_tables[tag] = NULL;
+	}
+
+	if (pending)
+		sdhci_reset(host, (SOFT_RESET_CMD | SOFT_RESET_DATA));
+
+	REG_WRITE16(host, SDHCI_CQE_INT_STS, SDHCI_NRML_INT_STS_REG);
+	REG_WRITE16(host, host->cqe_int_sts_en, SDHCI_NRML_INT_STS_EN_REG);
+}
+
+/*
+ * Function: sdhci cqe queue
+ * Arg     : Host structure, task slot & task
+ * Return  : None
+ * Flow:   : 1. Prepare the adma table of the task
+ *           2. Fill the task descriptor & the link to the adma table
+ *           3. Ring the doorbell of the slot
+ */
+void sdhci_cqe_queue(struct sdhci_host *host, uint32_t tag, struct sdhci_cqe_task *task)
+{
+	uint32_t desc_sz = sdhci_cqe_desc_sz(host);
+	uint8_t *slot = (uint8_t *)host->cqe_tdl + tag * 2 * desc_sz;
+	uint32_t *desc = (uint32_t *)slot;
+	void *table;
+
+	ASSERT(tag < SDHCI_CQE_MAX_TASKS && task->num_blocks <= SDHCI_CQE_MAX_BLOCKS);
+
+	table = sdhci_prep_desc_table(host, task->sg, task->sg_count);
+	host->cqe_tables[tag] = table;
+
+	memset(slot, 0, 2 * desc_sz);
+	desc[0] = SDHCI_CQE_TASK_VALID | SDHCI_CQE_TASK_END | SDHCI_CQE_TASK_INT |
+			  SDHCI_CQE_TASK_ACT_TASK | (task->read ? SDHCI_CQE_TASK_DATA_READ : 0) |
+			  (task->num_blocks << SDHCI_CQE_TASK_BLK_CNT_SHIFT);
+	desc[1] = task->blk_addr;
+
+	sdhci_fill_desc(host, slot + desc_sz, 0, table, 0,
+					SDHCI_ADMA_TRANS_VALID | SDHCI_CQE_TASK_ACT_LINK);
+
+	arch_clean_invalidate_cache_range((addr_t)slot, 2 * desc_sz);
+
+	CQE_WRITE32(host, 1 << tag, SDHCI_CQE_TDBR_REG);
+}
+
+/*
+ * Function: sdhci cqe wait
+ * Arg     : Host structure, slots of the queued tasks & completed slots
+ * Return  : 0 on Success, 1 on Failure
+ * Flow:   : Poll the task completion notification until at least one of
+ *           the tasks is complete. On errors the caller disables the
+ *           engine, which drops the remaining tasks.
+ */
+uint32_t sdhci_cqe_wait(struct sdhci_host *host, uint32_t tags, uint32_t *done)
+{
+	uint64_t retry = 0;
+	uint32_t status;
+	uint32_t tcn;
+	uint32_t tag;
+
+	do {
+		status = CQE_READ32(host, SDHCI_CQE_IS_REG);
+		if (status & SDHCI_CQE_IS_ERR)
+		{
+			dprintf(CRITICAL, "Error: Command queue task failed, status: 0x%08x, task: 0x%08x\n",
+					status, CQE_READ32(host, SDHCI_CQE_TERRI_REG));
+			CQE_WRITE32(host, status, SDHCI_CQE_IS_REG);
+			return 1;
+		}
+
+		tcn = CQE_READ32(host, SDHCI_CQE_TCN_REG) & tags;
+		if (tcn)
+			break;
+
+		if (++retry == SDHCI_MAX_TRANS_RETRY)
+		{
+			dprintf(CRITICAL, "Error: Command queue task never completed\n");
+			return 1;
+		}
+		udelay(1);
+	} while (1);
+
+	CQE_WRITE32(host, tcn, SDHCI_CQE_TCN_REG);
+	CQE_WRITE32(host, SDHCI_CQE_IS_TCC, SDHCI_CQE_IS_REG);
+
+	for (tag = 0; tag < SDHCI_CQE_MAX_TASKS; tag++)
+	{
+		if (!(tcn & (1 << tag)))
+			continue;
+		free(host->cqe_tables[tag]);
+		host->cqe_tables[tag] = NULL;
+	}
+
+	*done = tcn;
+	return 0;
+}
@@ -192,6 +192,14 @@ void sdhci_msm_init(struct sdhci_host *host, struct sdhci_msm_data *config)
 	/* Enable pwr control interrupt */
 	writel(SDCC_HC_PWR_CTRL_INT, (config->pwrctl_base + SDCC_HC_PWRCTL_MASK_REG));
 
+#if defined(SDCC1_IRQ) && defined(SDCC2_IRQ)
+	/*
+	 * Platforms that define the host controller irqs wait for command
+	 * completion on the irq instead of busy polling
+	 */
+	sdhci_enable_irq(host, (config->slot == 1) ? SDCC1_IRQ : SDCC2_IRQ);
+#endif
+
 	version = readl(host->msm_host->pwrctl_base + MCI_VERSION);
 
 	host->major = (version & CORE_VERSION_MAJOR_MASK) >> CORE_VERSION_MAJOR_SHIFT;
@@ -216,6 +224,26 @@ void sdhci_msm_init(struct sdhci_host *host, struct sdhci_msm_data *config)
 	host->tuning_in_progress = false;
 }
 
+/*
+ * Function: sdhci msm set io pad
+ * Arg     : Host structure & 1.8V signalling enable
+ * Return  : None
+ * Flow:   : Select the IO pad voltage to match the IO supply
+ */
+void sdhci_msm_set_io_pad(struct sdhci_host *host, bool low_voltage)
+{
+	uint32_t io_switch;
+
+	io_switch = REG_READ32(host, SDCC_VENDOR_SPECIFIC_FUNC);
+
+	if (low_voltage)
+		io_switch |= HC_IO_PAD_PWR_SWITCH | HC_IO_PAD_PWR_SWITCH_EN;
+	else
+		io_switch &= ~HC_IO_PAD_PWR_SWITCH;
+
+	REG_WRITE32(host, io_switch, SDCC_VENDOR_SPECIFIC_FUNC);
+}
+
 /*
  * Function: sdhci msm set mci clk
  * Arg     : Host structure
@@ -710,10 +738,17 @@ uint32_t sdhci_msm_execute_tuning(struct sdhci_host *host, struct mmc_card *card
 	int ret = 0;
 	uint32_t i;
 	uint32_t err = 0;
+	uint32_t tuning_cmd;
 	struct sdhci_msm_data *msm_host;
 
 	msm_host = host->msm_host;
 
+	/* SD cards tune with CMD19, eMMC with CMD21 */
+	if (MMC_CARD_SD(card))
+		tuning_cmd = CMD19_SEND_TUNING_BLOCK;
+	else
+		tuning_cmd = CMD21_SEND_TUNING_BLOCK;
+
 	/* In Tuning mode */
 	host->tuning_in_progress = true;
 
@@ -765,7 +800,7 @@ retry_tuning:
 			goto out;
 		}
 
-		cmd.cmd_index = CMD21_SEND_TUNING_BLOCK;
+		cmd.cmd_index = tuning_cmd;
 		cmd.argument = 0x0;
 		cmd.cmd_type = SDHCI_CMD_TYPE_NORMAL;
 		cmd.resp_type = SDHCI_CMD_RESP_R1;
@@ -806,8 +841,9 @@ retry_tuning:
 	}
 
 	/*
-	 * Check if all the tuning phases passed */
-	if (tuned_phase_cnt == MAX_PHASES)
+	 * Check if all the tuning phases passed, the driver type
+	 * can only be changed for eMMC */
+	if (tuned_phase_cnt == MAX_PHASES && MMC_CARD_MMC(card))
 	{
 		/* Change the driver type & rerun tuning */
 		while(++drv_type <= MX_DRV_SUPPORTED_HS200)
@@ -867,12 +903,12 @@ retry_tuning:
 	}
 
 out:
-	/* If all the tuning phases passed, send CMD21 after enabling
+	/* If all the tuning phases passed, send the tuning command after enabling
 	 * CDR to make sure right tuning phase is selected by CDR
 	 */
 	if (attempt_cdr_unlock)
 	{
-		cmd.cmd_index = CMD21_SEND_TUNING_BLOCK;
+		cmd.cmd_index = tuning_cmd;
 		cmd.argument = 0x0;
 		cmd.cmd_type = SDHCI_CMD_TYPE_NORMAL;
 		cmd.resp_type = SDHCI_CMD_RESP_R1;
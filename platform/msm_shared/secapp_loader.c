@@ -26,15 +26,59 @@
  * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <debug.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include <rpmb.h>
 #include <secapp_loader.h>
 #include <qseecom_lk_api.h>
 
 static bool lksec_app_loaded;
+static bool lksec_app_started;
 static int app_handle;
 
+/*
+ * qseecom, the RPMB listener and the keymaster app are started on first use
+ * rather than in target_init(): a boot that never needs them (e.g. without
+ * verified boot) then skips all the SCM calls and RPMB reads.
+ */
+static void start_sec_app(void)
+{
+	if (lksec_app_started)
+		return;
+	lksec_app_started = true;
+
+	/* Initialize Qseecom */
+	if (qseecom_init() < 0)
+	{
+		dprintf(CRITICAL, "Failed to initialize qseecom\n");
+		ASSERT(0);
+	}
+
+	/* Start Qseecom */
+	if (qseecom_tz_init() < 0)
+	{
+		dprintf(CRITICAL, "Failed to start qseecom\n");
+		ASSERT(0);
+	}
+
+	if (rpmb_init() < 0)
+	{
+		dprintf(CRITICAL, "RPMB init failed\n");
+		ASSERT(0);
+	}
+
+	/*
+	 * Load the sec app for first time
+	 */
+	if (load_sec_app() < 0)
+	{
+		dprintf(CRITICAL, "Failed to load App for verified\n");
+		ASSERT(0);
+	}
+}
+
 int load_sec_app(void)
 {
 	/* start TZ app */
@@ -51,6 +95,7 @@ int load_sec_app(void)
 
 int get_secapp_handle(void)
 {
+	start_sec_app();
 	dprintf(INFO, "LK SEC APP Handle: 0x%x\n", app_handle);
 	return app_handle;
 }
@@ -62,6 +107,8 @@ int send_delete_keys_to_tz(void)
 	key_op_delete_all_rsp_t rsp = {0};
 	req.cmd_id = KEYMASTER_DELETE_ALL_KEYS;
 
+	start_sec_app();
+
 	// send delete all keys command
 	ret = qseecom_send_command(app_handle, (void *)&req, sizeof(req), (void *)&rsp, sizeof(rsp));
 
@@ -110,3 +157,9 @@ bool is_sec_app_loaded(void)
 {
 	return lksec_app_loaded;
 }
+
+/* Whether qseecom and RPMB were started and need rpmb_uninit() */
+bool is_sec_app_started(void)
+{
+	return lksec_app_started;
+}
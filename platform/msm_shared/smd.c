@@ -294,10 +294,11 @@ int smd_write(smd_channel_info_t *ch, void *data, uint32_t len, int ch_type)
 {
 	smd_pkt_hdr smd_hdr;
 	uint32_t size = 0;
+	uint32_t used;
 
 	memset(&smd_hdr, 0, sizeof(smd_pkt_hdr));
 
-	if(len + sizeof(smd_hdr) > ch->fifo_size)
+	if(len + sizeof(smd_hdr) >= ch->fifo_size)
 	{
 		dprintf(CRITICAL,"%s: len is greater than fifo sz\n", __func__);
 		return -1;
@@ -324,6 +325,14 @@ int smd_write(smd_channel_info_t *ch, void *data, uint32_t len, int ch_type)
 		return -1;
 	}
 
+	/* Several packets may be queued, wait until the RPM made room for this one */
+	do {
+		arch_invalidate_cache_range((addr_t) ch->port_info, ROUNDUP(size, CACHE_LINE));
+		used = ch->port_info->ch0.write_index - ch->port_info->ch0.read_index;
+		if (ch->port_info->ch0.write_index < ch->port_info->ch0.read_index)
+			used += ch->fifo_size;
+	} while (used + len + sizeof(smd_hdr) >= ch->fifo_size);
+
 	/* Clear the data_read flag */
 	ch->port_info->ch1.data_read = 0;
 
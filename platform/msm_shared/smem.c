@@ -79,40 +79,77 @@ uint32_t smem_get_base_addr(void)
 }
 #endif
 
-/* buf MUST be 4byte aligned, and len MUST be a multiple of 8. */
-unsigned smem_read_alloc_entry(smem_mem_type_t type, void *buf, int len)
+static uint32_t smem_get_addr(void)
 {
-	struct smem_alloc_info *ainfo;
-	unsigned *dest = buf;
-	unsigned src;
-	unsigned size;
-	uint32_t smem_addr = 0;
-
 #if DYNAMIC_SMEM
-	smem_addr = smem_get_base_addr();
+	return smem_get_base_addr();
 #else
-	smem_addr = platform_get_smem_base_addr();
+	return platform_get_smem_base_addr();
 #endif
+}
 
-	smem = (struct smem *)smem_addr;
+/*
+ * Entries of the allocation table that were looked up already. The same few
+ * items (board info, RAM partition table, ...) are read several times while
+ * booting. An allocated entry never changes, so only those are kept.
+ */
+#define SMEM_CACHE_ENTRIES	8
 
-	if (((len & 0x3) != 0) || (((unsigned)buf & 0x3) != 0))
-		return 1;
+static struct smem_cache_entry {
+	smem_mem_type_t type;
+	struct smem_alloc_info info;
+} smem_cache[SMEM_CACHE_ENTRIES];
+static unsigned smem_cache_next;
+
+/* Return the allocation info of an item, NULL if it is not allocated. */
+static const struct smem_alloc_info *smem_get_alloc_info(smem_mem_type_t type)
+{
+	struct smem_cache_entry *entry;
+	struct smem_alloc_info *ainfo;
+	unsigned i;
 
 	if (type < SMEM_FIRST_VALID_TYPE || type > SMEM_LAST_VALID_TYPE)
-		return 1;
+		return NULL;
+
+	for (i = 0; i < SMEM_CACHE_ENTRIES; i++)
+		if (smem_cache[i].info.allocated && smem_cache[i].type == type)
+			return &smem_cache[i].info;
+
+	smem = (struct smem *)smem_get_addr();
 
 	/* TODO: Use smem spinlocks */
 	ainfo = &smem->alloc_info[type];
 	if (readl(&ainfo->allocated) == 0)
+		return NULL;
+
+	entry = &smem_cache[smem_cache_next++ % SMEM_CACHE_ENTRIES];
+	entry->type = type;
+	entry->info.offset = readl(&ainfo->offset);
+	entry->info.size = readl(&ainfo->size);
+	entry->info.base_ext = readl(&ainfo->base_ext);
+	entry->info.allocated = 1;
+
+	return &entry->info;
+}
+
+/* buf MUST be 4byte aligned, and len MUST be a multiple of 8. */
+unsigned smem_read_alloc_entry(smem_mem_type_t type, void *buf, int len)
+{
+	const struct smem_alloc_info *ainfo;
+	unsigned *dest = buf;
+	unsigned src;
+
+	if (((len & 0x3) != 0) || (((unsigned)buf & 0x3) != 0))
 		return 1;
 
-	size = readl(&ainfo->size);
+	ainfo = smem_get_alloc_info(type);
+	if (!ainfo)
+		return 1;
 
-	if (size < (unsigned)((len + 7) & ~0x00000007))
+	if (ainfo->size < (unsigned)((len + 7) & ~0x00000007))
 		return 1;
 
-	src = smem_addr + readl(&ainfo->offset);
+	src = smem_get_addr() + ainfo->offset;
 	for (; len > 0; src += 4, len -= 4)
 		*(dest++) = readl(src);
 
@@ -122,37 +159,22 @@ unsigned smem_read_alloc_entry(smem_mem_type_t type, void *buf, int len)
 /* Return a pointer to smem_item with size */
 void* smem_get_alloc_entry(smem_mem_type_t type, uint32_t* size)
 {
-	struct smem_alloc_info *ainfo = NULL;
-	uint32_t smem_addr = 0;
-	uint32_t base_ext = 0;
-	uint32_t offset = 0;
+	const struct smem_alloc_info *ainfo = NULL;
 	void *ret = NULL;
 
-#if DYNAMIC_SMEM
-	smem_addr = smem_get_base_addr();
-#else
-	smem_addr = platform_get_smem_base_addr();
-#endif
-	smem = (struct smem *)smem_addr;
-
-	if (type < SMEM_FIRST_VALID_TYPE || type > SMEM_LAST_VALID_TYPE)
+	ainfo = smem_get_alloc_info(type);
+	if (!ainfo)
 		return ret;
 
-	ainfo = &smem->alloc_info[type];
-	if (readl(&ainfo->allocated) == 0)
-		return ret;
-
-	*size = readl(&ainfo->size);
-	base_ext = readl(&ainfo->base_ext);
-	offset = readl(&ainfo->offset);
+	*size = ainfo->size;
 
-	if(base_ext)
+	if(ainfo->base_ext)
 	{
-		ret = (void*)base_ext + offset;
+		ret = (void*)ainfo->base_ext + ainfo->offset;
 	}
 	else
 	{
-		ret = (void*) smem_addr + offset;
+		ret = (void*) smem_get_addr() + ainfo->offset;
 	}
 
 	return ret;
@@ -163,11 +185,7 @@ void *smem_alloc_entry(smem_mem_type_t type, uint32_t size)
 	uint32_t smem_addr, remaining, offset;
 	struct smem_alloc_info *ainfo;
 
-#if DYNAMIC_SMEM
-	smem_addr = smem_get_base_addr();
-#else
-	smem_addr = platform_get_smem_base_addr();
-#endif
+	smem_addr = smem_get_addr();
 	smem = (struct smem *)smem_addr;
 
 	if (type < SMEM_FIRST_VALID_TYPE || type > SMEM_LAST_VALID_TYPE)
@@ -206,31 +224,19 @@ unsigned
 smem_read_alloc_entry_offset(smem_mem_type_t type, void *buf, int len,
 			     int offset)
 {
-	struct smem_alloc_info *ainfo;
+	const struct smem_alloc_info *ainfo;
 	unsigned *dest = buf;
 	unsigned src;
 	unsigned size = len;
-	uint32_t smem_addr = 0;
-
-#if DYNAMIC_SMEM
-	smem_addr = smem_get_base_addr();
-#else
-	smem_addr = platform_get_smem_base_addr();
-#endif
-
-	smem = (struct smem *)smem_addr;
 
 	if (((len & 0x3) != 0) || (((unsigned)buf & 0x3) != 0))
 		return 1;
 
-	if (type < SMEM_FIRST_VALID_TYPE || type > SMEM_LAST_VALID_TYPE)
-		return 1;
-
-	ainfo = &smem->alloc_info[type];
-	if (readl(&ainfo->allocated) == 0)
+	ainfo = smem_get_alloc_info(type);
+	if (!ainfo)
 		return 1;
 
-	src = smem_addr + readl(&ainfo->offset) + offset;
+	src = smem_get_addr() + ainfo->offset + offset;
 	for (; size > 0; src += 4, size -= 4)
 		*(dest++) = readl(src);
 
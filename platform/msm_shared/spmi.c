@@ -35,6 +35,9 @@
 #include <platform/interrupts.h>
 #include <malloc.h>
 #include <platform.h>
+#include <stdlib.h>
+#include <string.h>
+#include <kernel/thread.h>
 
 #define PMIC_ARB_V2 0x20010000
 #define CHNL_IDX(sid, pid) ((sid << 8) | pid)
@@ -46,6 +49,27 @@ static uint8_t *chnl_tbl;
 static uint32_t max_peripherals;
 static bool spmi_init_done;
 
+/* Max number of bytes transferred by a single PMIC arbiter command */
+#define PMIC_ARB_MAX_BYTES 8
+
+/*
+ * Shadow copies of the registers of a few peripherals, used by
+ * pmic_spmi_reg_update_bits() to skip the read (and the write if nothing
+ * changes). Every successful arbiter command updates the copy, so only
+ * changes made by the hardware itself are missed.
+ */
+#define PMIC_SPMI_SHADOW_ENTRIES 4
+
+struct pmic_spmi_shadow {
+	uint32_t periph;	/* SID and peripheral ID | 1, 0 if unused */
+	uint32_t age;
+	uint8_t valid[256 / 8];
+	uint8_t regs[256];
+};
+
+static struct pmic_spmi_shadow spmi_shadow[PMIC_SPMI_SHADOW_ENTRIES];
+static uint32_t spmi_shadow_age;
+
 static void spmi_lookup_chnl_number(void)
 {
 	uint32_t i;
@@ -93,6 +117,38 @@ void spmi_init(uint32_t chnl_num, uint32_t owner_id)
 	spmi_init_done = true;
 }
 
+static struct pmic_spmi_shadow *pmic_spmi_shadow_find(uint32_t periph)
+{
+	int i;
+
+	for (i = 0; i < PMIC_SPMI_SHADOW_ENTRIES; i++)
+	{
+		if (spmi_shadow[i].periph == periph)
+			return &spmi_shadow[i];
+	}
+
+	return NULL;
+}
+
+/* Keep the shadow registers in sync with every successful command */
+static void pmic_spmi_shadow_update(struct pmic_arb_cmd *cmd,
+                                    struct pmic_arb_param *param)
+{
+	uint32_t periph = (cmd->slave_id << 16) | (cmd->address << 8) | 1;
+	struct pmic_spmi_shadow *shadow = pmic_spmi_shadow_find(periph);
+	uint32_t i, reg;
+
+	if (!shadow)
+		return;
+
+	for (i = 0; i < param->size && cmd->offset + i < 256; i++)
+	{
+		reg = cmd->offset + i;
+		shadow->regs[reg] = param->buffer[i];
+		shadow->valid[reg / 8] |= BIT(reg % 8);
+	}
+}
+
 static void write_wdata_from_array(uint8_t *array,
 	                               uint8_t reg_num,
 	                               uint8_t array_size,
@@ -128,8 +184,8 @@ static void write_wdata_from_array(uint8_t *array,
  *
  * return value : 0 if success, the error bit set on error
  */
-unsigned int pmic_arb_write_cmd(struct pmic_arb_cmd *cmd,
-                                struct pmic_arb_param *param)
+static unsigned int pmic_arb_do_write_cmd(struct pmic_arb_cmd *cmd,
+                                          struct pmic_arb_param *param)
 {
 	uint32_t bytes_written = 0;
 	uint32_t error;
@@ -197,8 +253,24 @@ unsigned int pmic_arb_write_cmd(struct pmic_arb_cmd *cmd,
 			cmd_id = %u, error = %u\n", cmd->opcode, error);
 		return error;
 	}
-	else
-		return 0;
+
+	pmic_spmi_shadow_update(cmd, param);
+	return 0;
+}
+
+/* The channel registers are shared, so commands must not be interleaved
+ * when several threads (e.g. asynchronous init stages) access the PMIC.
+ */
+unsigned int pmic_arb_write_cmd(struct pmic_arb_cmd *cmd,
+                                struct pmic_arb_param *param)
+{
+	unsigned int ret;
+
+	enter_critical_section();
+	ret = pmic_arb_do_write_cmd(cmd, param);
+	exit_critical_section();
+
+	return ret;
 }
 
 static void read_rdata_into_array(uint8_t *array,
@@ -240,8 +312,8 @@ static void read_rdata_into_array(uint8_t *array,
  *
  * return value : 0 if success, the error bit set on error
  */
-unsigned int pmic_arb_read_cmd(struct pmic_arb_cmd *cmd,
-                               struct pmic_arb_param *param)
+static unsigned int pmic_arb_do_read_cmd(struct pmic_arb_cmd *cmd,
+                                         struct pmic_arb_param *param)
 {
 	uint32_t val = 0;
 	uint32_t error;
@@ -320,9 +392,22 @@ unsigned int pmic_arb_read_cmd(struct pmic_arb_cmd *cmd,
 
 	}
 
+	pmic_spmi_shadow_update(cmd, param);
 	return 0;
 }
 
+unsigned int pmic_arb_read_cmd(struct pmic_arb_cmd *cmd,
+                               struct pmic_arb_param *param)
+{
+	unsigned int ret;
+
+	enter_critical_section();
+	ret = pmic_arb_do_read_cmd(cmd, param);
+	exit_critical_section();
+
+	return ret;
+}
+
 /* SPMI helper functions */
 uint8_t pmic_spmi_reg_read(uint32_t addr)
 {
@@ -370,6 +455,109 @@ void pmic_spmi_reg_mask_write(uint32_t addr, uint8_t mask, uint8_t val)
 	pmic_spmi_reg_write(addr, reg);
 }
 
+/* Split the transfer into commands of up to 8 bytes within one peripheral */
+static unsigned int pmic_spmi_reg_bulk(uint32_t addr, uint8_t *buf, size_t len,
+                                       bool write)
+{
+	struct pmic_arb_cmd cmd;
+	struct pmic_arb_param param;
+	unsigned int ret;
+	size_t n;
+
+	while (len)
+	{
+		n = MIN(len, PMIC_ARB_MAX_BYTES);
+		n = MIN(n, 0x100 - SPMI_REG_OFFSET(addr));
+
+		cmd.address  = SPMI_PERIPH_ID(addr);
+		cmd.offset   = SPMI_REG_OFFSET(addr);
+		cmd.slave_id = SPMI_SLAVE_ID(addr);
+		cmd.priority = 0;
+
+		param.buffer = buf;
+		param.size   = n;
+
+		if (write)
+			ret = pmic_arb_write_cmd(&cmd, &param);
+		else
+			ret = pmic_arb_read_cmd(&cmd, &param);
+		if (ret)
+			return ret;
+
+		addr += n;
+		buf += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+/* Read len consecutive registers starting at addr */
+unsigned int pmic_spmi_reg_bulk_read(uint32_t addr, uint8_t *buf, size_t len)
+{
+	return pmic_spmi_reg_bulk(addr, buf, len, false);
+}
+
+/* Write len consecutive registers starting at addr */
+unsigned int pmic_spmi_reg_bulk_write(uint32_t addr, const uint8_t *buf, size_t len)
+{
+	return pmic_spmi_reg_bulk(addr, (uint8_t *)buf, len, true);
+}
+
+/*
+ * Like pmic_spmi_reg_mask_write(), but the current value is taken from the
+ * shadow registers of the peripheral if possible and nothing is written if
+ * the value does not change. Only use this for registers that are not
+ * changed by the hardware itself.
+ */
+unsigned int pmic_spmi_reg_update_bits(uint32_t addr, uint8_t mask, uint8_t val)
+{
+	uint32_t periph = (addr & 0xFFFF00) | 1;
+	uint32_t reg = SPMI_REG_OFFSET(addr);
+	struct pmic_spmi_shadow *shadow = pmic_spmi_shadow_find(periph);
+	unsigned int ret;
+	uint8_t old, new;
+	int i;
+
+	if (!shadow)
+	{
+		/* Replace the least recently used peripheral */
+		shadow = &spmi_shadow[0];
+		for (i = 1; i < PMIC_SPMI_SHADOW_ENTRIES; i++)
+		{
+			if (spmi_shadow[i].age < shadow->age)
+				shadow = &spmi_shadow[i];
+		}
+		memset(shadow, 0, sizeof(*shadow));
+		shadow->periph = periph;
+	}
+	shadow->age = ++spmi_shadow_age;
+
+	if (!(shadow->valid[reg / 8] & BIT(reg % 8)))
+	{
+		ret = pmic_spmi_reg_bulk_read(addr, &old, 1);
+		if (ret)
+			return ret;
+	}
+
+	old = shadow->regs[reg];
+	new = (old & ~mask) | (val & mask);
+	if (new == old)
+		return 0;
+
+	return pmic_spmi_reg_bulk_write(addr, &new, 1);
+}
+
+/* Drop the shadow registers, e.g. after the hardware changed them */
+void pmic_spmi_shadow_invalidate(uint32_t addr)
+{
+	struct pmic_spmi_shadow *shadow;
+
+	shadow = pmic_spmi_shadow_find((addr & 0xFFFF00) | 1);
+	if (shadow)
+		memset(shadow, 0, sizeof(*shadow));
+}
+
 void spmi_uninit(void)
 {
 	mask_interrupt(EE0_KRAIT_HLOS_SPMI_PERIPH_IRQ);
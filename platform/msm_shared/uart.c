@@ -194,6 +194,11 @@ int uart_putc(int port, char c)
 	_uart_putc(0, c);
 }
 
+/* Output is not buffered */
+void uart_flush_tx(int port)
+{
+}
+
 int uart_getc(int port, bool wait)
 {
 	if (!uart_ready)
@@ -30,6 +30,7 @@
 #include <stdlib.h>
 #include <debug.h>
 #include <kernel/thread.h>
+#include <kernel/timer.h>
 #include <reg.h>
 #include <sys/types.h>
 #include <platform/iomap.h>
@@ -38,6 +39,7 @@
 #include <platform/clock.h>
 #include <platform/gpio.h>
 #include <uart_dm.h>
+#include <dev/uart.h>
 #include <gsbi.h>
 
 #ifndef NULL
@@ -54,7 +56,9 @@ static int uart_init_flag = 0;
  *   use of static variables. TX path shouldn't have any problem though. If
  *   multi-threaded support is required, a simple data-structure can
  *   be maintained for each thread.
- * - Right now we are using polling method than interrupt based.
+ * - Right now we are using polling method than interrupt based. Output
+ *   from uart_putc() is buffered though and sent in larger transfers when
+ *   the transmitter is idle, from uart_putc() or a timer.
  * - We are using legacy UART protocol without Data Mover.
  * - Not all interrupts and error events are handled.
  * - While waiting Watchdog hasn't been taken into consideration.
@@ -110,6 +114,19 @@ static unsigned int msm_boot_uart_dm_reset(uint32_t base);
  */
 static uint32_t port_lookup[4];
 
+#define UART_DM_TX_BUF_SIZE	2048
+#define UART_DM_TX_CHUNK	64	/* fits into the TX FIFO, even with \r */
+#define UART_DM_TX_POLL_MS	1
+
+struct uart_dm_tx {
+	char buf[UART_DM_TX_BUF_SIZE];
+	unsigned int head, tail;
+	timer_t timer;
+	bool timer_armed;
+};
+
+static struct uart_dm_tx uart_tx[ARRAY_SIZE(port_lookup)];
+
 /* Extern functions */
 void udelay(unsigned usecs);
 
@@ -374,6 +391,46 @@ msm_boot_uart_dm_write(uint32_t base, char *data, unsigned int num_of_chars)
 	return MSM_BOOT_UART_DM_E_SUCCESS;
 }
 
+static bool msm_boot_uart_dm_tx_idle(uint32_t base)
+{
+	return (readl(MSM_BOOT_UART_DM_SR(base)) & MSM_BOOT_UART_DM_SR_TXEMT) ||
+	       (readl(MSM_BOOT_UART_DM_ISR(base)) & MSM_BOOT_UART_DM_TX_READY);
+}
+
+/*
+ * Send the next chunk of buffered characters, but only if the previous
+ * transfer is done so this never waits for the UART. Must be called in
+ * a critical section.
+ */
+static void uart_dm_tx_kick(int port)
+{
+	struct uart_dm_tx *tx = &uart_tx[port];
+	char chunk[UART_DM_TX_CHUNK];
+	unsigned int n = 0;
+
+	if (tx->head == tx->tail || !msm_boot_uart_dm_tx_idle(port_lookup[port]))
+		return;
+
+	while (n < sizeof(chunk) && tx->tail != tx->head) {
+		chunk[n++] = tx->buf[tx->tail];
+		tx->tail = (tx->tail + 1) % UART_DM_TX_BUF_SIZE;
+	}
+	msm_boot_uart_dm_write(port_lookup[port], chunk, n);
+}
+
+static enum handler_return uart_dm_tx_timer(timer_t *timer, time_t now, void *arg)
+{
+	int port = (int)arg;
+
+	uart_dm_tx_kick(port);
+	if (uart_tx[port].head != uart_tx[port].tail)
+		timer_set_oneshot(timer, UART_DM_TX_POLL_MS, uart_dm_tx_timer, arg);
+	else
+		uart_tx[port].timer_armed = false;
+
+	return INT_NO_RESCHEDULE;
+}
+
 /* Defining functions that's exposed to outside world and in coformance to
  * existing uart implemention. These functions are being called to initialize
  * UART and print debug messages in bootloader.
@@ -414,6 +471,7 @@ void uart_dm_init(uint8_t id, uint32_t gsbi_base, uint32_t uart_dm_base)
 	msm_boot_uart_dm_write(uart_dm_base, data, 44);
 
 	ASSERT(port < ARRAY_SIZE(port_lookup));
+	timer_initialize(&uart_tx[port].timer);
 	port_lookup[port++] = uart_dm_base;
 
 	/* Set UART init flag */
@@ -427,17 +485,58 @@ void uart_dm_init(uint8_t id, uint32_t gsbi_base, uint32_t uart_dm_base)
  */
 int uart_putc(int port, char c)
 {
-	uint32_t uart_base = port_lookup[port];
+	struct uart_dm_tx *tx = &uart_tx[port];
+	bool threads_running;
+	unsigned int next;
 
 	/* Don't do anything if UART is not initialized */
 	if (!uart_init_flag)
 		return -1;
 
-	msm_boot_uart_dm_write(uart_base, &c, 1);
+	/*
+	 * Before the first thread runs (and in interrupts) we are always in
+	 * a critical section. Only then the kernel timers may not be ready.
+	 */
+	threads_running = !in_critical_section();
+
+	enter_critical_section();
+
+	/* The buffer is full: wait for the UART, like without buffering */
+	next = (tx->head + 1) % UART_DM_TX_BUF_SIZE;
+	while (next == tx->tail)
+		uart_dm_tx_kick(port);
+
+	tx->buf[tx->head] = c;
+	tx->head = next;
+	uart_dm_tx_kick(port);
+
+	if (tx->head != tx->tail && !tx->timer_armed && threads_running) {
+		timer_set_oneshot(&tx->timer, UART_DM_TX_POLL_MS,
+				  uart_dm_tx_timer, (void *)port);
+		tx->timer_armed = true;
+	}
+
+	exit_critical_section();
 
 	return 0;
 }
 
+/* Send all buffered characters, e.g. before rebooting. */
+void uart_flush_tx(int port)
+{
+	struct uart_dm_tx *tx = &uart_tx[port];
+
+	if (!uart_init_flag)
+		return;
+
+	enter_critical_section();
+	while (tx->head != tx->tail)
+		uart_dm_tx_kick(port);
+	while (!msm_boot_uart_dm_tx_idle(port_lookup[port]))
+		;
+	exit_critical_section();
+}
+
 /* UART_DM uses four character word FIFO whereas uart_getc
  * is supposed to read only one character. So we need to
  * read a word and keep track of each character in the word.
@@ -33,56 +33,67 @@
 #include <utp.h>
 #include <rpmb.h>
 
-int ucs_do_scsi_cmd(struct ufs_dev *dev, struct scsi_req_build_type *req)
+static void ucs_fill_scsi_upiu(struct scsi_req_build_type *req, struct upiu_req_build_type *req_upiu,
+							   struct upiu_basic_resp_hdr *resp_upiu)
 {
-	struct upiu_req_build_type req_upiu;
-	struct upiu_basic_resp_hdr      resp_upiu;
-
-	memset(&req_upiu, 0 , sizeof(struct upiu_req_build_type));
-
-	req_upiu.cmd_set_type	   = UPIU_SCSI_CMD_SET;
-	req_upiu.trans_type	       = UPIU_TYPE_COMMAND;
-	req_upiu.data_buffer_addr  = req->data_buffer_addr;
-	req_upiu.expected_data_len = req->data_len;
-	req_upiu.data_seg_len	   = 0;
-	req_upiu.ehs_len		   = 0;
-	req_upiu.flags			   = req->flags;
-	req_upiu.lun			   = req->lun;
-	req_upiu.query_mgmt_func   = 0;
-	req_upiu.cdb			   = req->cdb;
-	req_upiu.cmd_type		   = UTRD_SCSCI_CMD;
-	req_upiu.dd			       = req->dd;
-	req_upiu.resp_ptr		   = &resp_upiu;
-	req_upiu.resp_len		   = sizeof(resp_upiu);
-	req_upiu.timeout_msecs	   = UTP_GENERIC_CMD_TIMEOUT;
-
-	if (utp_enqueue_upiu(dev, &req_upiu))
-	{
-		dprintf(CRITICAL, "ucs_do_scsi_cmd: enqueue failed\n");
-		return -UFS_FAILURE;
-	}
+	memset(req_upiu, 0 , sizeof(struct upiu_req_build_type));
+
+	req_upiu->cmd_set_type	   = UPIU_SCSI_CMD_SET;
+	req_upiu->trans_type	       = UPIU_TYPE_COMMAND;
+	req_upiu->data_buffer_addr  = req->data_buffer_addr;
+	req_upiu->expected_data_len = req->data_len;
+	req_upiu->data_seg_len	   = 0;
+	req_upiu->ehs_len		   = 0;
+	req_upiu->flags			   = req->flags;
+	req_upiu->lun			   = req->lun;
+	req_upiu->query_mgmt_func   = 0;
+	req_upiu->cdb			   = req->cdb;
+	req_upiu->cmd_type		   = UTRD_SCSCI_CMD;
+	req_upiu->dd			       = req->dd;
+	req_upiu->resp_ptr		   = resp_upiu;
+	req_upiu->resp_len		   = sizeof(*resp_upiu);
+	req_upiu->timeout_msecs	   = UTP_GENERIC_CMD_TIMEOUT;
+}
 
-	if (resp_upiu.status != SCSI_STATUS_GOOD)
+static int ucs_check_scsi_resp(struct scsi_req_build_type *req, struct upiu_basic_resp_hdr *resp_upiu)
+{
+	if (resp_upiu->status != SCSI_STATUS_GOOD)
 	{
-		if (resp_upiu.status == SCSI_STATUS_CHK_COND && (*((uint8_t *)(req->cdb)) != SCSI_CMD_SENSE_REQ))
+		if (resp_upiu->status == SCSI_STATUS_CHK_COND && (*((uint8_t *)(req->cdb)) != SCSI_CMD_SENSE_REQ))
 		{
-			dprintf(CRITICAL, "Data segment length: %x\n", BE16(resp_upiu.data_seg_len));
-			if (BE16(resp_upiu.data_seg_len))
+			dprintf(CRITICAL, "Data segment length: %x\n", BE16(resp_upiu->data_seg_len));
+			if (BE16(resp_upiu->data_seg_len))
 			{
 				dprintf(CRITICAL, "SCSI Request failed and we have sense data\n");
-				dprintf(CRITICAL, "Sense Data Length/Response Code: 0x%x/0x%x\n", BE16(resp_upiu.sense_length), BE16(resp_upiu.sense_response_code));
-				parse_sense_key(resp_upiu.sense_data[0]);
-				dprintf(CRITICAL, "Sense Buffer (HEX): 0x%x 0x%x 0x%x 0x%x\n", BE32(resp_upiu.sense_data[0]), BE32(resp_upiu.sense_data[1]), BE32(resp_upiu.sense_data[2]), BE32(resp_upiu.sense_data[3]));
+				dprintf(CRITICAL, "Sense Data Length/Response Code: 0x%x/0x%x\n", BE16(resp_upiu->sense_length), BE16(resp_upiu->sense_response_code));
+				parse_sense_key(resp_upiu->sense_data[0]);
+				dprintf(CRITICAL, "Sense Buffer (HEX): 0x%x 0x%x 0x%x 0x%x\n", BE32(resp_upiu->sense_data[0]), BE32(resp_upiu->sense_data[1]), BE32(resp_upiu->sense_data[2]), BE32(resp_upiu->sense_data[3]));
 			}
 		}
 
-		dprintf(CRITICAL, "ucs_do_scsi_cmd failed status = %x\n", resp_upiu.status);
+		dprintf(CRITICAL, "ucs_do_scsi_cmd failed status = %x\n", resp_upiu->status);
 		return -UFS_FAILURE;
 	}
 
 	return UFS_SUCCESS;
 }
 
+int ucs_do_scsi_cmd(struct ufs_dev *dev, struct scsi_req_build_type *req)
+{
+	struct upiu_req_build_type req_upiu;
+	struct upiu_basic_resp_hdr      resp_upiu;
+
+	ucs_fill_scsi_upiu(req, &req_upiu, &resp_upiu);
+
+	if (utp_enqueue_upiu(dev, &req_upiu))
+	{
+		dprintf(CRITICAL, "ucs_do_scsi_cmd: enqueue failed\n");
+		return -UFS_FAILURE;
+	}
+
+	return ucs_check_scsi_resp(req, &resp_upiu);
+}
+
 int parse_sense_key(uint32_t sense_data)
 {
 	uint32_t key = BE32(sense_data) >> 24;
@@ -298,6 +309,103 @@ int ucs_do_scsi_read(struct ufs_dev *dev, struct scsi_rdwr_req *req)
 	return UFS_SUCCESS;
 }
 
+/* A READ(10) in flight, see ucs_do_scsi_readv(). */
+struct ucs_queued_cmd
+{
+	struct scsi_rdwr_cdb       cdb;
+	struct scsi_req_build_type req;
+	struct upiu_req_build_type req_upiu;
+	struct upiu_basic_resp_hdr resp_upiu;
+	struct utp_queued_req      utp;
+};
+
+static int ucs_submit_scsi_read(struct ufs_dev *dev, struct ucs_queued_cmd *cmd, uint8_t lun,
+								uint32_t start_blk, uint16_t blks, addr_t buf)
+{
+	memset(cmd, 0, sizeof(struct ucs_queued_cmd));
+	cmd->cdb.opcode    = SCSI_CMD_READ10;
+	cmd->cdb.cdb1      = SCSI_READ_WRITE_10_CDB1(0, 0, 1, 0);
+	cmd->cdb.lba       = BE32(start_blk);
+	cmd->cdb.trans_len = BE16(blks);
+
+	/* The cdb is copied into the request UPIU, no need to flush it. */
+	cmd->req.cdb              = (addr_t) &cmd->cdb;
+	cmd->req.data_buffer_addr = buf;
+	cmd->req.data_len         = blks * UFS_DEFAULT_SECTORE_SIZE;
+	cmd->req.flags            = UPIU_FLAGS_READ;
+	cmd->req.lun              = lun;
+	cmd->req.dd               = UTRD_TARGET_TO_SYSTEM;
+
+	ucs_fill_scsi_upiu(&cmd->req, &cmd->req_upiu, &cmd->resp_upiu);
+
+	return utp_submit_upiu(dev, &cmd->req_upiu, &cmd->utp);
+}
+
+static int ucs_wait_scsi_read(struct ufs_dev *dev, struct ucs_queued_cmd *cmd)
+{
+	if (utp_wait_upiu(dev, &cmd->utp))
+	{
+		dprintf(CRITICAL, "ucs_do_scsi_readv: command failed\n");
+		return -UFS_FAILURE;
+	}
+
+	return ucs_check_scsi_resp(&cmd->req, &cmd->resp_upiu);
+}
+
+/*
+ * Read several extents with up to UCS_QUEUE_DEPTH READ(10) commands in
+ * flight, instead of waiting for each command before sending the next one.
+ */
+int ucs_do_scsi_readv(struct ufs_dev *dev, struct scsi_rdwr_req *reqs, uint32_t count)
+{
+	struct ucs_queued_cmd *cmds;
+	uint32_t              head = 0, tail = 0;
+	uint32_t              i = 0, done = 0;
+	uint16_t              blks;
+	int                   ret = UFS_SUCCESS;
+
+	cmds = (struct ucs_queued_cmd *) malloc(UCS_QUEUE_DEPTH * sizeof(struct ucs_queued_cmd));
+	if (!cmds)
+		return -UFS_FAILURE;
+
+	for (;;)
+	{
+		/* Skip empty requests. */
+		while (i < count && !reqs[i].num_blocks)
+			i++;
+
+		/* Keep the queue full, stop sending after an error. */
+		if (i < count && head - tail < UCS_QUEUE_DEPTH && ret == UFS_SUCCESS)
+		{
+			blks = MIN(reqs[i].num_blocks - done, SCSI_MAX_DATA_TRANS_BLK_LEN);
+
+			if (ucs_submit_scsi_read(dev, &cmds[head % UCS_QUEUE_DEPTH], reqs[i].lun, reqs[i].start_lba + done,
+									 blks, reqs[i].data_buffer_base + done * UFS_DEFAULT_SECTORE_SIZE))
+				ret = -UFS_FAILURE;
+			else
+				head++;
+
+			done += blks;
+			if (done == reqs[i].num_blocks)
+			{
+				done = 0;
+				i++;
+			}
+			continue;
+		}
+
+		if (tail == head)
+			break;
+
+		if (ucs_wait_scsi_read(dev, &cmds[tail % UCS_QUEUE_DEPTH]))
+			ret = -UFS_FAILURE;
+		tail++;
+	}
+
+	free(cmds);
+	return ret;
+}
+
 int ucs_do_scsi_write(struct ufs_dev *dev, struct scsi_rdwr_req *req)
 {
 	struct scsi_req_build_type     req_upiu;
@@ -141,6 +141,28 @@ int ufs_read(struct ufs_dev* dev, uint64_t start_lba, addr_t buffer, uint32_t nu
 	return ret;
 }
 
+/*
+ * Read several extents at once, the commands are queued to the device.
+ * Unlike ufs_read(), start_lba of the requests is in blocks.
+ */
+int ufs_readv(struct ufs_dev* dev, struct scsi_rdwr_req *reqs, uint32_t count)
+{
+	uint32_t i;
+	int      ret;
+
+	for (i = 0; i < count; i++)
+		reqs[i].lun = dev->current_lun;
+
+	ret = ucs_do_scsi_readv(dev, reqs, count);
+	if (ret)
+	{
+		dprintf(CRITICAL, "UFS read failed.\n");
+		ufs_dump_hc_registers(dev);
+	}
+
+	return ret;
+}
+
 int ufs_write(struct ufs_dev* dev, uint64_t start_lba, addr_t buffer, uint32_t num_blocks)
 {
 	struct scsi_rdwr_req req;
@@ -136,6 +136,9 @@ typedef enum
 /* master bus data width (DWC_USB3_MDWIDTH in snps data book) */
 #define DWC_MASTER_BUS_WIDTH   8
 
+/* bMaxBurst / DEPCFG burst size: number of packets - 1 */
+#define DWC_MAX_BURST          15
+
 /* super speed link states */
 typedef enum
 {
@@ -405,6 +405,28 @@ void dwc_device_accept_u1u2(dwc_dev_t *dev)
 	REG_WRITE_FIELD(dev, DCTL, ACCEPTU2ENA, 1);
 }
 
+/* Largest SuperSpeed burst (number of packets - 1) supported by an ep.
+ * IN eps share tx fifo 1, which must be able to hold the whole burst
+ * (snps 6.3.2.5.1: each packet needs max_pkt_size + one bus width).
+ * OUT data is flow controlled by the core, so the max burst can be used.
+ */
+uint8_t dwc_ep_max_burst(dwc_dev_t *dev, uint8_t in, uint16_t max_pkt_size)
+{
+	uint32_t fifo_bytes;
+	uint32_t pkts;
+
+	if (!in)
+		return DWC_MAX_BURST;
+
+	fifo_bytes = REG_READ_FIELDI(dev, GTXFIFOSIZ, 1, TXFDEP_N) * DWC_MASTER_BUS_WIDTH;
+	pkts = fifo_bytes / (max_pkt_size + DWC_MASTER_BUS_WIDTH);
+
+	if (pkts == 0)
+		return 0;
+
+	return MIN(pkts - 1, DWC_MAX_BURST);
+}
+
 bool dwc_device_u1_enabled(dwc_dev_t *dev)
 {
 	uint32_t val;
@@ -55,6 +55,7 @@ void dwc_device_enter_test_mode(dwc_dev_t *dev);
 void dwc_device_enable_u1(dwc_dev_t *dev, uint8_t val);
 void dwc_device_enable_u2(dwc_dev_t *dev, uint8_t val);
 void dwc_device_accept_u1u2(dwc_dev_t *dev);
+uint8_t dwc_ep_max_burst(dwc_dev_t *dev, uint8_t in, uint16_t max_pkt_size);
 bool dwc_device_u1_enabled(dwc_dev_t *dev);
 bool dwc_device_u2_enabled(dwc_dev_t *dev);
 #endif
@@ -54,6 +54,13 @@
 #include <qmp_phy.h>
 #include <usb30_dwc_hw.h>
 
+#if WITH_LK2ND_PERF
+#include <lk2nd/perf.h>
+#endif
+#if WITH_LK2ND_TRACE
+#include <lk2nd/trace.h>
+#endif
+
 /* Fallback for CACHE_LINE if target CPU macro isn't set early */
 #ifndef CACHE_LINE
 #define CACHE_LINE 64
@@ -631,7 +638,8 @@ static int udc_handle_setup(void *context, uint8_t *data)
 						ep->dir           = ept->in;
 						ep->type          = ept->type;
 						ep->max_pkt_size  = ept->maxpkt;
-						ep->burst_size    = ept->maxburst;
+						/* bursts only exist at SuperSpeed */
+						ep->burst_size    = (udc->speed == UDC_SPEED_SS) ? ept->maxburst : 0;
 						ep->zlp           = 0;
 						ep->trb_count     = ept->trb_count;
 						ep->trb           = ept->trb;
@@ -694,7 +702,7 @@ static int udc_handle_setup(void *context, uint8_t *data)
 		{
 			DBG("\n MSC CLASS : GET_MAX_LUN");
 			if (s.length == 1) {
-				uint8_t lun = 0; /* single LUN */
+				uint8_t lun = udc->gadget->max_lun;
 				memcpy(udc->ctrl_tx_buf, &lun, 1);
 				arch_clean_invalidate_cache_range((addr_t) udc->ctrl_tx_buf, 1);
 				dwc_transfer_request(udc->dwc, 0, DWC_EP_DIRECTION_IN, udc->ctrl_tx_buf, 1, NULL, NULL);
@@ -708,7 +716,7 @@ static int udc_handle_setup(void *context, uint8_t *data)
 		{
 			DBG("\n MSC CLASS(CLASS) : GET_MAX_LUN");
 			if (s.length == 1) {
-				uint8_t lun = 0;
+				uint8_t lun = udc->gadget->max_lun;
 				memcpy(udc->ctrl_tx_buf, &lun, 1);
 				arch_clean_invalidate_cache_range((addr_t) udc->ctrl_tx_buf, 1);
 				dwc_transfer_request(udc->dwc, 0, DWC_EP_DIRECTION_IN, udc->ctrl_tx_buf, 1, NULL, NULL);
@@ -913,8 +921,15 @@ void udc_request_complete(void *context, uint32_t actual, int status)
 	/* clear the queued request. */
 	((udc_t *) context)->queued_req = NULL;
 
+#if WITH_LK2ND_TRACE
+	LK2ND_TRACE_ASYNC_END("usb_req", req, actual);
+#endif
+
 	if (req->complete)
 	{
+#if WITH_LK2ND_PERF
+		LK2ND_PERF_SCOPE("usb_req_complete");
+#endif
 		req->complete(req, actual, status);
 	}
 
@@ -958,6 +973,10 @@ int usb30_udc_request_queue(struct udc_endpoint *ept, struct udc_request *req)
 	/* save the queued request. */
 	udc_dev->queued_req = req;
 
+#if WITH_LK2ND_TRACE
+	LK2ND_TRACE_ASYNC_BEGIN("usb_req", req, req->length);
+#endif
+
 	ret = dwc_transfer_request(dwc_dev,
 							   ept->num,
 							   ept->in ? DWC_EP_DIRECTION_IN : DWC_EP_DIRECTION_OUT,
@@ -1090,7 +1109,7 @@ static struct udc_endpoint *_udc_endpoint_alloc(uint8_t num,
 	ept->num        = num;
 	ept->type       = type;
 	ept->in         = !!in;
-	ept->maxburst   = 4;      /* no performance improvement is seen beyond burst size of 4 */
+	ept->maxburst   = dwc_ep_max_burst(udc->dwc, in, max_pkt); /* SuperSpeed only */
 	ept->trb_count  = 66;     /* each trb can transfer (16MB - 1). 65 for 1GB transfer + 1 for roundup/zero length pkt. */
 	ept->trb        = memalign(lcm(CACHE_LINE, 16), ROUNDUP(ept->trb_count*sizeof(dwc_trb_t), CACHE_LINE)); /* TRB must be aligned to 16 */
 	ASSERT(ept->trb);
@@ -46,6 +46,10 @@
 #include <stdlib.h>
 #include <sys/types.h>
 
+#if WITH_LK2ND_TRACE
+#include <lk2nd/trace.h>
+#endif
+
 void utp_process_req_completion(struct ufs_req_irq_type *irq)
 {
 	struct ufs_req_node *req;
@@ -445,13 +449,13 @@ static void utp_fill_prdt_entries(struct upiu_req_build_type *upiu_data, struct
 
 }
 
-int utp_enqueue_upiu(struct ufs_dev *dev, struct upiu_req_build_type *upiu_data)
+/* Allocate and fill the UTP command descriptor (request UPIU, response UPIU and PRDT). */
+static struct upiu_gen_hdr *utp_build_cmd_desc(struct ufs_dev *dev, struct upiu_req_build_type *upiu_data,
+											   struct utp_utrd_req_build_type *utrd, uint32_t *desc_len)
 {
 	struct upiu_gen_hdr            *req_upiu;
-	struct utp_utrd_req_build_type utrd;
 	uint32_t                       num_prdt;
 	struct utp_prdt_entry          *prdt_entry;
-	int                            ret = UFS_SUCCESS;
 	uint32_t                       resp_len;
 	uint32_t                       cmd_desc_len;
 	struct utrd_cmd_desc           cmd_desc;
@@ -462,7 +466,7 @@ int utp_enqueue_upiu(struct ufs_dev *dev, struct upiu_req_build_type *upiu_data)
 	resp_len = ROUNDUP(upiu_data->resp_data_len, 4) + UPIU_HDR_LEN;
 
 	if (utp_get_prdt_len(upiu_data->expected_data_len, &num_prdt))
-		return -UFS_FAILURE;
+		return NULL;
 
 	/* Calculate the length. */
 	cmd_desc_len = UPIU_HDR_LEN + resp_len + num_prdt * sizeof(struct utp_prdt_entry);
@@ -472,21 +476,21 @@ int utp_enqueue_upiu(struct ufs_dev *dev, struct upiu_req_build_type *upiu_data)
 	if (!req_upiu)
 	{
 		dprintf(CRITICAL, "%s:%d Unable to allocate request upiu\n",__func__, __LINE__);
-		return -UFS_FAILURE;
+		return NULL;
 	}
 
 	/* Fill req upiu. */
-	ret = utp_fill_req_upiu(dev, upiu_data, req_upiu);
-	if (ret)
+	if (utp_fill_req_upiu(dev, upiu_data, req_upiu))
 	{
-		goto utp_enqueue_upiu_err;
+		free(req_upiu);
+		return NULL;
 	}
 
 	/* Fill UTRD properties. */
 	cmd_desc.num_prdt      = num_prdt;
 	cmd_desc.req_upiu      = req_upiu;
 	cmd_desc.resp_upiu_len = resp_len;
-	utp_fill_utrd_properties(upiu_data, &utrd, &cmd_desc);
+	utp_fill_utrd_properties(upiu_data, utrd, &cmd_desc);
 
 	prdt_entry         = (struct utp_prdt_entry *) ((uint32_t) req_upiu + UPIU_HDR_LEN + resp_len);
 
@@ -498,6 +502,36 @@ int utp_enqueue_upiu(struct ufs_dev *dev, struct upiu_req_build_type *upiu_data)
 	dsb();
 	arch_clean_invalidate_cache_range((addr_t) req_upiu, cmd_desc_len);
 
+	*desc_len = cmd_desc_len;
+	return req_upiu;
+}
+
+/* UPIU processed: copy the response to the caller. */
+static void utp_save_resp(struct upiu_req_build_type *upiu_data, struct upiu_gen_hdr *req_upiu, uint32_t cmd_desc_len)
+{
+	/* Invalidate cache to update resp. */
+	arch_invalidate_cache_range((addr_t) req_upiu, cmd_desc_len);
+
+	/* Save the response. */
+	memcpy(upiu_data->resp_ptr, (void *) ((uint32_t)req_upiu + UPIU_HDR_LEN), upiu_data->resp_len);
+	memcpy((void *) upiu_data->resp_data_ptr, (void *) ((uint32_t)req_upiu + 2 * UPIU_HDR_LEN), upiu_data->resp_data_len);
+}
+
+int utp_enqueue_upiu(struct ufs_dev *dev, struct upiu_req_build_type *upiu_data)
+{
+	struct upiu_gen_hdr            *req_upiu;
+	struct utp_utrd_req_build_type utrd;
+	int                            ret = UFS_SUCCESS;
+	uint32_t                       cmd_desc_len;
+
+#if WITH_LK2ND_TRACE
+	LK2ND_TRACE_SCOPE("ufs_cmd", upiu_data->data_buffer_len);
+#endif
+
+	req_upiu = utp_build_cmd_desc(dev, upiu_data, &utrd, &cmd_desc_len);
+	if (!req_upiu)
+		return -UFS_FAILURE;
+
 	/* Check the response. */
 	ret = utp_enqueue_utrd(dev, &utrd);
 	if (ret)
@@ -506,14 +540,149 @@ int utp_enqueue_upiu(struct ufs_dev *dev, struct upiu_req_build_type *upiu_data)
 		goto utp_enqueue_upiu_err;
 	}
 
-	/* UPIU processed. Invalidate cache to update resp. */
-	arch_invalidate_cache_range((addr_t) req_upiu, cmd_desc_len);
-
-	/* Save the response. */
-	memcpy(upiu_data->resp_ptr, (void *) ((uint32_t)req_upiu + UPIU_HDR_LEN), upiu_data->resp_len);
-	memcpy((void *) upiu_data->resp_data_ptr, (void *) ((uint32_t)req_upiu + 2 * UPIU_HDR_LEN), upiu_data->resp_data_len);
+	utp_save_resp(upiu_data, req_upiu, cmd_desc_len);
 
 utp_enqueue_upiu_err:
 	free(req_upiu);
 	return ret;
 }
+
+/*
+ * Queued mode: several transfer requests are kept in flight, each one is
+ * completed when the controller clears its doorbell bit. The UTRDs are
+ * only 32 bytes, so a UTRD must not share its cache line with one that is
+ * still in flight: cleaning the line after filling the new UTRD would write
+ * back a stale copy of the other one over the status the controller wrote.
+ * All slots of a cache line are therefore reserved together.
+ */
+#define UTP_UTRD_PER_LINE	MAX(CACHE_LINE / sizeof(struct utp_trans_req_desc), 1U)
+
+static struct utp_trans_req_desc *utp_get_queued_slot(struct ufs_dev *dev, struct utp_queued_req *qreq)
+{
+	uint32_t group = (UTP_UTRD_PER_LINE >= 32) ? ~0U : (1U << UTP_UTRD_PER_LINE) - 1;
+	uint32_t busy, slot;
+
+	if (mutex_acquire(&(dev->utrd_data.bitmap_mutex)))
+		return NULL;
+
+	busy = readl(UFS_UTRLDBR(dev->base)) | dev->utrd_data.bitmap;
+	for (slot = 0; slot < 32; slot += UTP_UTRD_PER_LINE)
+	{
+		if (!(busy & (group << slot)))
+			break;
+	}
+
+	if (slot < 32)
+	{
+		qreq->door_bell_bit = 1U << slot;
+		qreq->reserved_bits = group << slot;
+		dev->utrd_data.bitmap |= qreq->reserved_bits;
+	}
+
+	mutex_release(&(dev->utrd_data.bitmap_mutex));
+
+	if (slot >= 32)
+		return NULL;
+
+	return (struct utp_trans_req_desc *) ((addr_t)dev->utrd_data.list_base_addr + slot * sizeof(struct utp_trans_req_desc));
+}
+
+static void utp_put_queued_slot(struct ufs_dev *dev, struct utp_queued_req *qreq)
+{
+	struct utp_bitmap_access_type bitmap_req;
+
+	bitmap_req.bitmap        = &dev->utrd_data.bitmap;
+	bitmap_req.door_bell_bit = qreq->reserved_bits;
+	bitmap_req.mutx          = &(dev->utrd_data.bitmap_mutex);
+
+	utp_remove_from_bitmap(&bitmap_req);
+}
+
+/*
+ * Start a UPIU without waiting for it. @upiu_data and the buffers it points
+ * to must stay valid until utp_wait_upiu() returns for @qreq.
+ */
+int utp_submit_upiu(struct ufs_dev *dev, struct upiu_req_build_type *upiu_data, struct utp_queued_req *qreq)
+{
+	struct utp_utrd_req_build_type utrd;
+
+	qreq->upiu_data = upiu_data;
+	qreq->req_upiu  = utp_build_cmd_desc(dev, upiu_data, &utrd, &qreq->cmd_desc_len);
+	if (!qreq->req_upiu)
+		return -UFS_FAILURE;
+
+	qreq->desc = utp_get_queued_slot(dev, qreq);
+	if (!qreq->desc)
+	{
+		dprintf(CRITICAL, "%s:%d Unable to find a free slot for transaction.\n",__func__, __LINE__);
+		goto utp_submit_upiu_err;
+	}
+
+	/* Check register UTRLRSR and make sure it is read 1 before continuing. */
+	if (!readl(UFS_UTRLRSR(dev->base)))
+	{
+		utp_put_queued_slot(dev, qreq);
+		goto utp_submit_upiu_err;
+	}
+
+	utp_enqueue_utrd_fill_desc(qreq->desc, &utrd);
+
+#if WITH_LK2ND_TRACE
+	LK2ND_TRACE_ASYNC_BEGIN("ufs_cmd", qreq, upiu_data->data_buffer_len);
+#endif
+	dsb();
+	utp_ring_door_bell(UFS_UTRLDBR(dev->base), qreq->door_bell_bit);
+	dsb();
+
+	return UFS_SUCCESS;
+
+utp_submit_upiu_err:
+	free(qreq->req_upiu);
+	return -UFS_FAILURE;
+}
+
+/* Wait for a UPIU started with utp_submit_upiu() and release its slot. */
+int utp_wait_upiu(struct ufs_dev *dev, struct utp_queued_req *qreq)
+{
+	uint32_t retry = 0;
+	int      ret = UFS_SUCCESS;
+
+	while (readl(UFS_UTRLDBR(dev->base)) & qreq->door_bell_bit)
+	{
+		if (++retry == UTP_MAX_COMMAND_RETRY)
+		{
+			dprintf(CRITICAL, "%s:%d UTP command never completed.\n", __func__, __LINE__);
+			writel(~qreq->door_bell_bit, UFS_UTRLCLR(dev->base));
+			ret = ERR_TIMED_OUT;
+			goto utp_wait_upiu_err;
+		}
+		udelay(1);
+	}
+
+	/*
+	 * Acknowledge the completion, utp_poll_utrd_complete() waits for this
+	 * bit for the next request that is not queued.
+	 */
+	writel(UFS_IS_UTRCS, UFS_IS(dev->base));
+
+	/* Force read UTRD from memory. */
+	dsb();
+	arch_invalidate_cache_range((addr_t) qreq->desc, sizeof(struct utp_trans_req_desc));
+
+	if (qreq->desc->overall_cmd_status != UTRD_OCS_SUCCESS)
+	{
+		dprintf(CRITICAL, "%s:%d Command failed. ocs = %x\n", __func__, __LINE__, qreq->desc->overall_cmd_status);
+		ret = -UFS_FAILURE;
+		goto utp_wait_upiu_err;
+	}
+
+	utp_save_resp(qreq->upiu_data, qreq->req_upiu, qreq->cmd_desc_len);
+
+utp_wait_upiu_err:
+#if WITH_LK2ND_TRACE
+	LK2ND_TRACE_ASYNC_END("ufs_cmd", qreq, ret);
+#endif
+	utp_put_queued_slot(dev, qreq);
+	free(qreq->req_upiu);
+	return ret;
+}
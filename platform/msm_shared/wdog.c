@@ -54,7 +54,7 @@ static void wdog_feed_func_thread(void)
 
 	if (!is_thread_start) {
 		thr = thread_create("wdogfeed", wdog_feed_handler,
-			0, DEFAULT_PRIORITY, DEFAULT_STACK_SIZE);
+			0, DEFAULT_PRIORITY, SMALL_STACK_SIZE);
 		if (!thr) {
 			dprintf(CRITICAL, "ERROR: create feed dog thread failed!!\n");
 			return;
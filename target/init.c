@@ -257,6 +257,12 @@ __WEAK struct mmc_device *target_get_sd_mmc(void)
 	return NULL;
 }
 
+/* Switch the IO supply of an SD slot, targets without it stay at 3V */
+__WEAK int target_sdc_set_io_voltage(uint8_t slot, uint32_t voltage_uv)
+{
+	return -1;
+}
+
 __WEAK unsigned int qseecom_get_version(void)
 {
 	return 0;
@@ -360,9 +360,6 @@ static void set_ebi2_config(void)
 }
 void target_init(void)
 {
-#if VERIFIED_BOOT || VERIFIED_BOOT_2
-	int ret = 0;
-#endif
 	dprintf(INFO, "target_init()\n");
 
 	spmi_init(PMIC_ARB_CHANNEL_NUM, PMIC_ARB_OWNER_ID);
@@ -424,38 +421,7 @@ void target_init(void)
 	{
 		clock_ce_enable(CE1_INSTANCE);
 
-		/* Initialize Qseecom */
-		ret = qseecom_init();
-
-		if (ret < 0)
-		{
-			dprintf(CRITICAL, "Failed to initialize qseecom, error: %d\n", ret);
-			ASSERT(0);
-		}
-
-		/* Start Qseecom */
-		ret = qseecom_tz_init();
-
-		if (ret < 0)
-		{
-			dprintf(CRITICAL, "Failed to start qseecom, error: %d\n", ret);
-			ASSERT(0);
-		}
-
-		if (rpmb_init() < 0)
-		{
-			dprintf(CRITICAL, "RPMB init failed\n");
-			ASSERT(0);
-		}
-
-		/*
-		 * Load the sec app for first time
-		*/
-		if (load_sec_app() < 0)
-		{
-			dprintf(CRITICAL, "Failed to load App for verified\n");
-			ASSERT(0);
-		}
+		/* qseecom and the sec app are started on first use */
 	}
 #endif
 
@@ -778,7 +744,7 @@ void target_uninit(void)
 			}
 		}
 
-		if (rpmb_uninit() < 0)
+		if (is_sec_app_started() && rpmb_uninit() < 0)
 		{
 			dprintf(CRITICAL, "RPMB uninit failed\n");
 			ASSERT(0);
@@ -114,6 +114,7 @@ void target_sdc_init(void)
 	config.sdhc_base    = mmc_sdhci_base[config.slot - 1];
 	config.pwrctl_base  = mmc_pwrctl_base[config.slot - 1];
 	config.pwr_irq      = mmc_sdc_pwrctl_irq[config.slot - 1];
+	config.hs200_support = 1;
 	config.hs400_support = 0;
 
 	if (!(dev = mmc_init(&config))) {
@@ -152,6 +153,7 @@ struct mmc_device *target_get_sd_mmc(void)
 	config.sdhc_base     = mmc_sdhci_base[config.slot - 1];
 	config.pwrctl_base   = mmc_pwrctl_base[config.slot - 1];
 	config.pwr_irq       = mmc_sdc_pwrctl_irq[config.slot - 1];
+	config.hs200_support = 1;
 	config.hs400_support = 0;
 
 	return mmc_init(&config);
@@ -37,6 +37,7 @@
 #include <board.h>
 #include <mdp5.h>
 #include <scm.h>
+#include <kernel/thread.h>
 #include <platform/clock.h>
 #include <platform/gpio.h>
 #include <platform/iomap.h>
@@ -360,7 +361,7 @@ static int dsi2HDMI_i2c_write_regs(struct mipi_dsi_i2c_cmd *cfg, int size)
 			goto w_regs_fail;
 		}
 		if (cfg[i].sleep_in_ms) {
-			udelay(cfg[i].sleep_in_ms*1000);
+			thread_usleep(cfg[i].sleep_in_ms*1000);
 		}
 	}
 w_regs_fail:
@@ -193,62 +193,66 @@ void regulator_enable(uint32_t enable)
 
 	if (platform_is_msm8956()) {
 		if (enable & REG_LDO1)
-			rpm_send_data(&ldo1[GENERIC_ENABLE][0], 36, RPM_REQUEST_TYPE);
+			rpm_send_data_noack(&ldo1[GENERIC_ENABLE][0], 36, RPM_REQUEST_TYPE);
 
 	} else if (platform_is_sdm439() || platform_is_sdm429() || platform_is_sdm429w() || platform_is_sda429w()) {
 		if (enable & REG_LDO5)
-			rpm_send_data(&ldo5[GENERIC_ENABLE][0],
+			rpm_send_data_noack(&ldo5[GENERIC_ENABLE][0],
 				36, RPM_REQUEST_TYPE);
 	} else {
 		if (enable & REG_LDO2)
-			rpm_send_data(&ldo2[GENERIC_ENABLE][0], 36, RPM_REQUEST_TYPE);
+			rpm_send_data_noack(&ldo2[GENERIC_ENABLE][0], 36, RPM_REQUEST_TYPE);
 	}
 
 	if ((platform_is_sdm429() && (board_hardware_subtype() == HW_PLATFORM_SUBTYPE_429W_PM660)) || platform_is_sdm429w() || platform_is_sda429w()) {
 		if (enable & REG_LDO13)
-			rpm_send_data(&ldo13_pm660[GENERIC_ENABLE][0],
+			rpm_send_data_noack(&ldo13_pm660[GENERIC_ENABLE][0],
 				36, RPM_REQUEST_TYPE);
 		if (enable & REG_LDO15)
-			rpm_send_data(&ldo15_pm660[GENERIC_ENABLE][0],
+			rpm_send_data_noack(&ldo15_pm660[GENERIC_ENABLE][0],
 				36, RPM_REQUEST_TYPE);
 	}
 
 	if (enable & REG_LDO17)
-		rpm_send_data(&ldo17[GENERIC_ENABLE][0], 36, RPM_REQUEST_TYPE);
+		rpm_send_data_noack(&ldo17[GENERIC_ENABLE][0], 36, RPM_REQUEST_TYPE);
 
 	if (enable & REG_LDO6) {
 		if ((platform_is_sdm429() || platform_is_sdm429w() || platform_is_sda429w()) && hw_subtype
 				== HW_PLATFORM_SUBTYPE_429W_PM660)
-			rpm_send_data(&ldo6_pm660[GENERIC_ENABLE][0], 36, RPM_REQUEST_TYPE);
+			rpm_send_data_noack(&ldo6_pm660[GENERIC_ENABLE][0], 36, RPM_REQUEST_TYPE);
 		else
-			rpm_send_data(&ldo6[GENERIC_ENABLE][0], 36, RPM_REQUEST_TYPE);
+			rpm_send_data_noack(&ldo6[GENERIC_ENABLE][0], 36, RPM_REQUEST_TYPE);
 	}
 
 	if (enable & REG_LDO11)
-		rpm_send_data(&ldo11[GENERIC_ENABLE][0], 36, RPM_REQUEST_TYPE);
+		rpm_send_data_noack(&ldo11[GENERIC_ENABLE][0], 36, RPM_REQUEST_TYPE);
+
+	rpm_wait_acks();
 }
 
 void regulator_disable(uint32_t enable)
 {
 	if (platform_is_msm8956()) {
 		if (enable & REG_LDO1)
-			rpm_send_data(&ldo1[GENERIC_DISABLE][0], 36, RPM_REQUEST_TYPE);
+			rpm_send_data_noack(&ldo1[GENERIC_DISABLE][0], 36, RPM_REQUEST_TYPE);
 
 	} else if (platform_is_sdm439() || platform_is_sdm429() || platform_is_sdm429w() || platform_is_sda429w()) {
 		if (enable & REG_LDO5)
-			rpm_send_data(&ldo5[GENERIC_DISABLE][0],
+			rpm_send_data_noack(&ldo5[GENERIC_DISABLE][0],
 				36, RPM_REQUEST_TYPE);
 	} else {
 		if (enable & REG_LDO2)
-			rpm_send_data(&ldo2[GENERIC_DISABLE][0], 36, RPM_REQUEST_TYPE);
+			rpm_send_data_noack(&ldo2[GENERIC_DISABLE][0], 36, RPM_REQUEST_TYPE);
 	}
 
 	if (enable & REG_LDO17)
-		rpm_send_data(&ldo17[GENERIC_DISABLE][0], 36, RPM_REQUEST_TYPE);
+		rpm_send_data_noack(&ldo17[GENERIC_DISABLE][0], 36, RPM_REQUEST_TYPE);
 
 	if (enable & REG_LDO6)
-		rpm_send_data(&ldo6[GENERIC_DISABLE][0], 36, RPM_REQUEST_TYPE);
+		rpm_send_data_noack(&ldo6[GENERIC_DISABLE][0], 36, RPM_REQUEST_TYPE);
 
 	if (enable & REG_LDO11)
-		rpm_send_data(&ldo11[GENERIC_DISABLE][0], 36, RPM_REQUEST_TYPE);
+		rpm_send_data_noack(&ldo11[GENERIC_DISABLE][0], 36, RPM_REQUEST_TYPE);
+
+	rpm_wait_acks();
 }
@@ -404,34 +404,7 @@ void target_init(void)
 	{
 		clock_ce_enable(CE1_INSTANCE);
 
-		/* Initialize Qseecom */
-		if (qseecom_init() < 0)
-		{
-			dprintf(CRITICAL, "Failed to initialize qseecom\n");
-			ASSERT(0);
-		}
-
-		/* Start Qseecom */
-		if (qseecom_tz_init() < 0)
-		{
-			dprintf(CRITICAL, "Failed to start qseecom\n");
-			ASSERT(0);
-		}
-
-		if (rpmb_init() < 0)
-		{
-			dprintf(CRITICAL, "RPMB init failed\n");
-			ASSERT(0);
-		}
-
-		/*
-		 * Load the sec app for first time
-		 */
-		if (load_sec_app() < 0)
-		{
-			dprintf(CRITICAL, "Failed to load App for verified\n");
-			ASSERT(0);
-		}
+		/* qseecom and the sec app are started on first use */
 	}
 
 #if SMD_SUPPORT
@@ -561,7 +534,7 @@ void target_uninit(void)
 			}
 		}
 
-		if (rpmb_uninit() < 0)
+		if (is_sec_app_started() && rpmb_uninit() < 0)
 		{
 			dprintf(CRITICAL, "RPMB uninit failed\n");
 			ASSERT(0);
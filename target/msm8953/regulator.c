@@ -106,29 +106,33 @@ static uint32_t ldo17[][11]=
 void regulator_enable(uint32_t enable)
 {
 	if (enable & REG_LDO3)
-		rpm_send_data(&ldo3[GENERIC_ENABLE][0], 36, RPM_REQUEST_TYPE);
+		rpm_send_data_noack(&ldo3[GENERIC_ENABLE][0], 36, RPM_REQUEST_TYPE);
 
 	if (enable & REG_LDO17)
-		rpm_send_data(&ldo17[GENERIC_ENABLE][0], 36, RPM_REQUEST_TYPE);
+		rpm_send_data_noack(&ldo17[GENERIC_ENABLE][0], 36, RPM_REQUEST_TYPE);
 
 	if (enable & REG_LDO6)
-		rpm_send_data(&ldo6[GENERIC_ENABLE][0], 36, RPM_REQUEST_TYPE);
+		rpm_send_data_noack(&ldo6[GENERIC_ENABLE][0], 36, RPM_REQUEST_TYPE);
 
 	if (enable & REG_SMPS3)
-		rpm_send_data(&smps3[GENERIC_ENABLE][0], 36, RPM_REQUEST_TYPE);
+		rpm_send_data_noack(&smps3[GENERIC_ENABLE][0], 36, RPM_REQUEST_TYPE);
+
+	rpm_wait_acks();
 }
 
 void regulator_disable(uint32_t enable)
 {
 	if (enable & REG_LDO3)
-		rpm_send_data(&ldo3[GENERIC_DISABLE][0], 36, RPM_REQUEST_TYPE);
+		rpm_send_data_noack(&ldo3[GENERIC_DISABLE][0], 36, RPM_REQUEST_TYPE);
 
 	if (enable & REG_LDO17)
-		rpm_send_data(&ldo17[GENERIC_DISABLE][0], 36, RPM_REQUEST_TYPE);
+		rpm_send_data_noack(&ldo17[GENERIC_DISABLE][0], 36, RPM_REQUEST_TYPE);
 
 	if (enable & REG_LDO6)
-		rpm_send_data(&ldo6[GENERIC_DISABLE][0], 36, RPM_REQUEST_TYPE);
+		rpm_send_data_noack(&ldo6[GENERIC_DISABLE][0], 36, RPM_REQUEST_TYPE);
 
 	if (enable & REG_SMPS3)
-		rpm_send_data(&smps3[GENERIC_DISABLE][0], 36, RPM_REQUEST_TYPE);
+		rpm_send_data_noack(&smps3[GENERIC_DISABLE][0], 36, RPM_REQUEST_TYPE);
+
+	rpm_wait_acks();
 }
@@ -181,7 +181,7 @@ void target_uninit(void)
 		}
 	}
 
-	if (rpmb_uninit() < 0)
+	if (is_sec_app_started() && rpmb_uninit() < 0)
 	{
 		dprintf(CRITICAL, "RPMB uninit failed\n");
 		ASSERT(0);
@@ -338,10 +338,6 @@ void *target_mmc_device(void)
 
 void target_init(void)
 {
-#if VERIFIED_BOOT
-	int ret = 0;
-#endif
-
 	dprintf(INFO, "target_init()\n");
 
 	spmi_init(PMIC_ARB_CHANNEL_NUM, PMIC_ARB_OWNER_ID);
@@ -370,41 +366,6 @@ void target_init(void)
 	/* Storage initialization is complete, read the partition table info */
 	mmc_read_partition_table(0);
 
-#if VERIFIED_BOOT
-	/* Initialize Qseecom */
-	ret = qseecom_init();
-
-	if (ret < 0)
-	{
-		dprintf(CRITICAL, "Failed to initialize qseecom, error: %d\n", ret);
-		ASSERT(0);
-	}
-
-	/* Start Qseecom */
-	ret = qseecom_tz_init();
-
-	if (ret < 0)
-	{
-		dprintf(CRITICAL, "Failed to start qseecom, error: %d\n", ret);
-		ASSERT(0);
-	}
-
-	if (rpmb_init() < 0)
-	{
-		dprintf(CRITICAL, "RPMB init failed\n");
-		ASSERT(0);
-	}
-
-	/*
-	 * Load the sec app for first time
-	 */
-	if (load_sec_app() < 0)
-	{
-		dprintf(CRITICAL, "Failed to load App for verified\n");
-		ASSERT(0);
-	}
-#endif
-
 	rpm_smd_init();
 
 	/* QPNP LED init for boot process notification */
@@ -215,7 +215,7 @@ void target_uninit(void)
 
 	if (target_get_vb_version() >= VB_M)
 	{
-		if (rpmb_uninit() < 0)
+		if (is_sec_app_started() && rpmb_uninit() < 0)
 		{
 			dprintf(CRITICAL, "RPMB uninit failed\n");
 			ASSERT(0);
@@ -408,37 +408,6 @@ void target_init(void)
 	};
 #endif
 
-	if (VB_M <= target_get_vb_version())
-	{
-		/* Initialize Qseecom */
-		if (qseecom_init() < 0)
-		{
-			dprintf(CRITICAL, "Failed to initialize qseecom\n");
-			ASSERT(0);
-		}
-
-		/* Start Qseecom */
-		if (qseecom_tz_init() < 0)
-		{
-			dprintf(CRITICAL, "Failed to start qseecom\n");
-			ASSERT(0);
-		}
-
-		if (rpmb_init() < 0)
-		{
-			dprintf(CRITICAL, "RPMB init failed\n");
-			ASSERT(0);
-		}
-
-		/*
-		 * Load the sec app for first time
-		 */
-		if (load_sec_app() < 0)
-		{
-			dprintf(CRITICAL, "Failed to load App for verified\n");
-			ASSERT(0);
-		}
-	}
 }
 
 unsigned board_machtype(void)
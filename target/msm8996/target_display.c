@@ -42,6 +42,7 @@
 #include <endian.h>
 #include <regulator.h>
 #include <qtimer.h>
+#include <kernel/thread.h>
 #include <arch/defines.h>
 #include <platform/gpio.h>
 #include <platform/clock.h>
@@ -378,7 +379,7 @@ static int dsi2HDMI_i2c_write_regs(struct msm_panel_info *pinfo,
 			goto w_regs_fail;
 		}
 		if (cfg[i].sleep_in_ms) {
-			udelay(cfg[i].sleep_in_ms*1000);
+			thread_usleep(cfg[i].sleep_in_ms*1000);
 		}
 	}
 w_regs_fail: